@@ -0,0 +1,266 @@
+// handle.h
+//	Data structures for a table of objects named by handles: integers
+//	that can be given out, to user programs say, and looked up again
+//	in constant time.
+//
+//	A handle is the number of the object's slot in the table, in its
+//	low HandleSlotBits bits, and the slot's generation above them.
+//	Each time a slot is freed its generation goes up, so a handle
+//	kept after its object is gone -- a stale handle -- no longer
+//	matches, and Lookup says so, rather than returning whatever is
+//	in the slot now.  Handles are always positive, so -1 can mean
+//	"none".
+//
+//	The table starts small and doubles when every slot is in use, up
+//	to MaxHandleSlots.  Freed slots are reused, most recently freed
+//	first.
+//
+// Copyright (c) 1992-1996 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#ifndef HANDLE_H
+#define HANDLE_H
+
+#include "copyright.h"
+#include "debug.h"
+
+const int HandleSlotBits = 16;
+const int MaxHandleSlots = 1 << HandleSlotBits;
+const int MaxGeneration = (1 << (30 - HandleSlotBits)) - 1;
+				// so that a handle is below 2^30
+
+inline int HandleSlot(int handle) { return handle & (MaxHandleSlots - 1); }
+				// the slot a handle names: small, and
+				// reused once the handle is stale
+
+// The following class defines a table of items of type T, which must
+// have a default constructor and assignment.  Enter leaves a slot's
+// item as its last user left it, so that the new one can tidy up
+// after it; Remove doesn't touch it either.
+
+template <class T>
+class HandleTable {
+  public:
+    HandleTable(int initialSlots = 8);	// initialize an empty table
+    ~HandleTable();			// de-allocate it
+
+    int Enter();		// claim a free slot; return its handle, or
+				// -1 if all MaxHandleSlots are in use
+    T *Lookup(int handle);	// the item named by "handle", or NULL if
+				// it is stale, or was never given out
+    void Remove(int handle);	// free the slot of a valid handle
+
+    int NumInTable() { return numInUse; }
+    int Next(int handle);	// the handle of the next item in use,
+				// after "handle" (or the first, if -1);
+				// -1 if there is none
+
+    void SelfTest();		// verify module is working
+
+  private:
+    T *items;			// the item in each slot
+    int *generation;		// each slot's generation
+    bool *inUse;		// is each slot's item in use?
+    int *freeSlots;		// slots not in use, most recently freed last
+    int numFree;		// how many there are
+    int numSlots;		// size of the arrays
+    int numInUse;		// items in the table
+
+    int HandleOf(int slot) { return (generation[slot] << HandleSlotBits) | slot; }
+    void Grow(int newSlots);	// make room for more items
+};
+
+//----------------------------------------------------------------------
+// HandleTable<T>::HandleTable
+//	Initialize an empty table, with room for "initialSlots" items
+//	before it has to grow.
+//----------------------------------------------------------------------
+
+template <class T>
+HandleTable<T>::HandleTable(int initialSlots)
+{
+    ASSERT(initialSlots > 0 && initialSlots <= MaxHandleSlots);
+    numSlots = 0;
+    items = NULL;
+    generation = NULL;
+    inUse = NULL;
+    freeSlots = NULL;
+    numFree = 0;
+    numInUse = 0;
+    Grow(initialSlots);
+}
+
+//----------------------------------------------------------------------
+// HandleTable<T>::~HandleTable
+//	De-allocate the table.  The items are not ours to clean up.
+//----------------------------------------------------------------------
+
+template <class T>
+HandleTable<T>::~HandleTable()
+{
+    delete [] items;
+    delete [] generation;
+    delete [] inUse;
+    delete [] freeSlots;
+}
+
+//----------------------------------------------------------------------
+// HandleTable<T>::Grow
+//	Make the table "newSlots" slots long, copying the items over.
+//	Only called when every slot is in use; the new slots are handed
+//	out lowest first.
+//----------------------------------------------------------------------
+
+template <class T>
+void
+HandleTable<T>::Grow(int newSlots)
+{
+    T *newItems = new T[newSlots];
+    int *newGeneration = new int[newSlots];
+    bool *newInUse = new bool[newSlots];
+    int i;
+
+    ASSERT(numFree == 0 && newSlots > numSlots);
+    for (i = 0; i < numSlots; i++) {
+	newItems[i] = items[i];
+	newGeneration[i] = generation[i];
+	newInUse[i] = inUse[i];
+    }
+    delete [] freeSlots;
+    freeSlots = new int[newSlots];
+    for (i = newSlots - 1; i >= numSlots; i--) {
+	newGeneration[i] = 1;
+	newInUse[i] = FALSE;
+	freeSlots[numFree++] = i;
+    }
+    delete [] items;
+    delete [] generation;
+    delete [] inUse;
+    items = newItems;
+    generation = newGeneration;
+    inUse = newInUse;
+    numSlots = newSlots;
+}
+
+//----------------------------------------------------------------------
+// HandleTable<T>::Enter
+//	Claim a free slot, growing the table if there is none, and
+//	return its handle.  The item in the slot is as its last user
+//	left it (or as T's default constructor made it); fill it in with
+//	Lookup.  Returns -1 if the table can't grow any more.
+//----------------------------------------------------------------------
+
+template <class T>
+int
+HandleTable<T>::Enter()
+{
+    int slot;
+
+    if (numFree == 0) {
+	if (numSlots == MaxHandleSlots)
+	    return -1;
+	Grow(min(2 * numSlots, MaxHandleSlots));
+    }
+    slot = freeSlots[--numFree];
+    ASSERT(!inUse[slot]);
+    inUse[slot] = TRUE;
+    numInUse++;
+    return HandleOf(slot);
+}
+
+//----------------------------------------------------------------------
+// HandleTable<T>::Lookup
+//	Return the item named by "handle", or NULL if the handle is not
+//	one Enter gave out, or its item has been removed since.
+//----------------------------------------------------------------------
+
+template <class T>
+T *
+HandleTable<T>::Lookup(int handle)
+{
+    int slot = HandleSlot(handle);
+
+    if (handle < 0 || slot >= numSlots || !inUse[slot]
+		|| HandleOf(slot) != handle)
+	return NULL;
+    return &items[slot];
+}
+
+//----------------------------------------------------------------------
+// HandleTable<T>::Remove
+//	Free the slot named by "handle", which must be valid.  From now
+//	on the handle is stale.
+//----------------------------------------------------------------------
+
+template <class T>
+void
+HandleTable<T>::Remove(int handle)
+{
+    int slot = HandleSlot(handle);
+
+    ASSERT(Lookup(handle) != NULL);
+    inUse[slot] = FALSE;
+    if (++generation[slot] > MaxGeneration)
+	generation[slot] = 1;
+    freeSlots[numFree++] = slot;
+    numInUse--;
+}
+
+//----------------------------------------------------------------------
+// HandleTable<T>::Next
+//	Return the handle of the first item in use in a slot after the
+//	one "handle" names, or in the first slot if "handle" is -1; or -1
+//	if there is none.  Items may be removed while stepping through
+//	the table this way.
+//----------------------------------------------------------------------
+
+template <class T>
+int
+HandleTable<T>::Next(int handle)
+{
+    int slot = (handle == -1) ? 0 : HandleSlot(handle) + 1;
+
+    for (; slot < numSlots; slot++)
+	if (inUse[slot])
+	    return HandleOf(slot);
+    return -1;
+}
+
+//----------------------------------------------------------------------
+// HandleTable<T>::SelfTest
+//	Test whether this module is working: fill the table past its
+//	first size, check every handle, free them all, and check that
+//	they have all gone stale even though their slots are in use
+//	again.
+//----------------------------------------------------------------------
+
+template <class T>
+void
+HandleTable<T>::SelfTest()
+{
+    const int count = 20;
+    int handle[count], again[count];
+    int i, n;
+
+    ASSERT(NumInTable() == 0 && Next(-1) == -1 && Lookup(0) == NULL);
+    for (i = 0; i < count; i++) {
+	handle[i] = Enter();
+	ASSERT(handle[i] > 0 && Lookup(handle[i]) != NULL);
+    }
+    for (n = 0, i = Next(-1); i != -1; i = Next(i))
+	n++;
+    ASSERT(n == count && NumInTable() == count);
+    for (i = 0; i < count; i++)
+	Remove(handle[i]);
+    ASSERT(NumInTable() == 0);
+    for (i = 0; i < count; i++) {
+	again[i] = Enter();
+	ASSERT(Lookup(handle[i]) == NULL && Lookup(again[i]) != NULL);
+    }
+    for (i = 0; i < count; i++)
+	Remove(again[i]);
+    ASSERT(NumInTable() == 0 && Lookup(-1) == NULL);
+}
+
+#endif // HANDLE_H
@@ -11,6 +11,7 @@
 #include "bitmap.h"
 #include "list.h"
 #include "hash.h"
+#include "handle.h"
 #include "sysdep.h"
 
 //----------------------------------------------------------------------
@@ -60,8 +61,8 @@ static char *hashTestVector[] = { "0", "1", "2", "3", "4", "5", "6",
 
 //----------------------------------------------------------------------
 // LibSelfTest
-//	Run self tests on bitmaps, lists, sorted lists, and 
-//	hash tables.
+//	Run self tests on bitmaps, lists, sorted lists, 
+//	hash tables, and handle tables.
 //----------------------------------------------------------------------
 
 void
@@ -71,15 +72,18 @@ LibSelfTest () {
     SortedList<int> *sortList = new SortedList<int>(IntCompare);
     HashTable<int, char *> *hashTable = 
 	new HashTable<int, char *>(HashKey, HashInt);
+    HandleTable<int> *handles = new HandleTable<int>(4);
 	
 		
     map->SelfTest();
     list->SelfTest(listTestVector, sizeof(listTestVector)/sizeof(int));
     sortList->SelfTest(listTestVector, sizeof(listTestVector)/sizeof(int));
     hashTable->SelfTest(hashTestVector, sizeof(hashTestVector)/sizeof(char *));
+    handles->SelfTest();
 
     delete map;
     delete list;
     delete sortList;
     delete hashTable;
+    delete handles;
 }
@@ -0,0 +1,85 @@
+// config.h
+//	The configuration Nachos is compiled for: the sizes of the
+//	simulated machine's memory, TLB and disk, and whether it has a
+//	TLB at all.
+//
+//	Each setting is a parameter of the KernelConfig template, and
+//	comes out of it as a compile-time constant, so code that uses
+//	one is compiled exactly as if the number had been written in.
+//	A test of a setting folds away too: on a build without a TLB,
+//	"if (Config::UseTLB && ...)" is dead code, and the compiler
+//	drops it, where a run-time flag would be tested on every
+//	memory reference.
+//
+//	A specialized build picks its settings with -D flags in the
+//	Makefile's DEFINES, for example
+//
+//		DEFINES = -DUSE_TLB -DCONFIG_TLB_SIZE=16 -DCONFIG_NUM_PHYS_PAGES=64
+//
+//	Anything not given keeps the default below.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#ifndef CONFIG_H
+#define CONFIG_H
+
+#include "copyright.h"
+
+// The following class holds one configuration of the kernel.  It has
+// nothing but constants; a bad one fails to compile, on the array
+// with a negative size.
+
+template <int pageSize, int numPhysPages, int tlbSize, int sectorSize,
+	  int sectorsPerTrack, int numTracks, bool useTLB>
+class KernelConfig {
+  public:
+    enum {
+	PageSize = pageSize,		// bytes in a page of memory
+	NumPhysPages = numPhysPages,	// pages of physical memory
+	TLBSize = tlbSize,		// entries in the TLB, if there is one
+	SectorSize = sectorSize,	// bytes in a disk sector
+	SectorsPerTrack = sectorsPerTrack,
+	NumTracks = numTracks
+    };
+    static const bool UseTLB = useTLB;	// translate through a TLB,
+					// rather than a page table?
+
+  private:
+    typedef char CheckSizes[(pageSize > 0 && (pageSize & (pageSize - 1)) == 0
+			&& numPhysPages > 0 && tlbSize > 0
+			&& sectorSize > 0 && sectorsPerTrack > 0
+			&& numTracks > 0) ? 1 : -1];
+};
+
+#ifndef CONFIG_PAGE_SIZE
+#define CONFIG_PAGE_SIZE	128	// the disk sector size, for
+#endif					// simplicity
+#ifndef CONFIG_NUM_PHYS_PAGES
+#define CONFIG_NUM_PHYS_PAGES	128
+#endif
+#ifndef CONFIG_TLB_SIZE
+#define CONFIG_TLB_SIZE		4	// if there is a TLB, make it small
+#endif
+#ifndef CONFIG_SECTOR_SIZE
+#define CONFIG_SECTOR_SIZE	128
+#endif
+#ifndef CONFIG_SECTORS_PER_TRACK
+#define CONFIG_SECTORS_PER_TRACK 32
+#endif
+#ifndef CONFIG_NUM_TRACKS
+#define CONFIG_NUM_TRACKS	32
+#endif
+#ifdef USE_TLB
+#define CONFIG_USE_TLB		true
+#else
+#define CONFIG_USE_TLB		false
+#endif
+
+typedef KernelConfig<CONFIG_PAGE_SIZE, CONFIG_NUM_PHYS_PAGES,
+		     CONFIG_TLB_SIZE, CONFIG_SECTOR_SIZE,
+		     CONFIG_SECTORS_PER_TRACK, CONFIG_NUM_TRACKS,
+		     CONFIG_USE_TLB> Config;	// the one compiled in
+
+#endif // CONFIG_H
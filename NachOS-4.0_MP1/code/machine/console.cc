@@ -131,6 +131,7 @@ ConsoleOutput::ConsoleOutput(char *writeFile, CallBackObj *toCall)
 
     callWhenDone = toCall;
     putBusy = FALSE;
+    numPutting = 0;
 }
 
 //----------------------------------------------------------------------
@@ -154,7 +155,7 @@ void
 ConsoleOutput::CallBack()
 {
     putBusy = FALSE;
-    kernel->stats->numConsoleCharsWritten++;
+    kernel->stats->numConsoleCharsWritten += numPutting;
     callWhenDone->CallBack();
 }
 
@@ -170,36 +171,26 @@ ConsoleOutput::PutChar(char ch)
     ASSERT(putBusy == FALSE);
     WriteFile(writeFileNo, &ch, sizeof(char));
     putBusy = TRUE;
+    numPutting = 1;
     kernel->interrupt->Schedule(this, ConsoleTime, ConsoleWriteInt);
 }
 
+//----------------------------------------------------------------------
+// ConsoleOutput::PutBuffer()
+// 	Write a line of characters to the simulated display with one 
+//	UNIX write, and schedule a single interrupt, ConsoleTime later:
+//	the display takes a line as it does a character.
+//
+//	"buf" -- the characters to write
+//	"numChars" -- how many; at least one
+//----------------------------------------------------------------------
+
 void
-ConsoleOutput::PrintInt(int number)
+ConsoleOutput::PutBuffer(char *buf, int numChars)
 {
-	//turn int into char first
-	char a[10]={};
-	int count = 0;
-	int k = number;
-	while(k != 0)
-	{
-		a[count] = k%10 + '0';
-		k = k/10;
-		count++;
-	}
-
-	char a_new[10]={};
-	for(int i=0 ; i<count ; i++)
-	{
-		a_new[i] = a [count-1-i];
-	}
-	a_new[count] = '\n';
-
-	//do the same job as PutChar
-	ASSERT(putBusy == FALSE);
-	WriteFile(writeFileNo, a_new, sizeof(a_new));
-	putBusy = TRUE;
-	kernel->interrupt->Schedule(this, ConsoleTime, ConsoleWriteInt);
-
+    ASSERT(putBusy == FALSE && numChars > 0);
+    WriteFile(writeFileNo, buf, numChars);
+    putBusy = TRUE;
+    numPutting = numChars;
+    kernel->interrupt->Schedule(this, ConsoleTime, ConsoleWriteInt);
 }
-
-
@@ -76,9 +76,14 @@ class ConsoleOutput : public CallBackObj {
     void PutChar(char ch);	// Write "ch" to the console display, 
 				// and return immediately.  "callWhenDone" 
 				// will called when the I/O completes. 
+    void PutBuffer(char *buf, int numChars);
+				// Write a line of "numChars" characters 
+				// at once, with one UNIX write, and 
+				// return immediately.  "callWhenDone" is 
+				// called once, when the line has gone out.
+
     void CallBack();		// Invoked when next character can be put
 				// out to the display.
-    void PrintInt(int number);
 
   private:
     int writeFileNo;			// UNIX file emulating the display
@@ -86,6 +91,7 @@ class ConsoleOutput : public CallBackObj {
 					// the next char can be put 
     bool putBusy;    			// Is a PutChar operation in progress?
 					// If so, you can't do another one!
+    int numPutting;			// characters being put out
 };
 
 #endif // CONSOLE_H
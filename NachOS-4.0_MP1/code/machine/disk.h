@@ -20,6 +20,7 @@
 #include "copyright.h"
 #include "utility.h"
 #include "callback.h"
+#include "config.h"
 
 // The following class defines a physical disk I/O device.  The disk
 // has a single surface, split up into "tracks", and each track split
@@ -47,9 +48,11 @@
 //
 // The track buffer simulation can be disabled by compiling with -DNOTRACKBUF
 
-const int SectorSize = 128;		// number of bytes per disk sector
-const int SectorsPerTrack  = 32;	// number of sectors per disk track 
-const int NumTracks = 32;		// number of tracks per disk
+const int SectorSize = Config::SectorSize;
+					// number of bytes per disk sector
+const int SectorsPerTrack = Config::SectorsPerTrack;
+					// number of sectors per disk track 
+const int NumTracks = Config::NumTracks;	// number of tracks per disk
 const int NumSectors = (SectorsPerTrack * NumTracks);
 					// total # of sectors per disk
 
@@ -24,10 +24,11 @@
 #include "copyright.h"
 #include "utility.h"
 #include "translate.h"
+#include "config.h"
 
 // Definitions related to the size, and format of user memory
 
-const int PageSize = 128; 		// set the page size equal to
+const int PageSize = Config::PageSize; 	// set the page size equal to
 					// the disk sector size, for simplicity
 
 //
@@ -35,10 +36,10 @@ const int PageSize = 128; 		// set the page size equal to
 // Doing so will change the number of pages of physical memory
 // available on the simulated machine.
 //
-const int NumPhysPages = 128;
+const int NumPhysPages = Config::NumPhysPages;
 
 const int MemorySize = (NumPhysPages * PageSize);
-const int TLBSize = 4;			// if there is a TLB, make it small
+const int TLBSize = Config::TLBSize;	// if there is a TLB, make it small
 
 enum ExceptionType { NoException,           // Everything ok!
 		     SyscallException,      // A program executed a system call.
@@ -134,6 +135,9 @@ class Machine {
 
     TranslationEntry *tlb;		// this pointer should be considered 
 					// "read-only" to Nachos kernel code
+    bool HasTLB() { return Config::UseTLB && tlb != NULL; }
+					// known at compile time, on a
+					// build without a TLB
 
     TranslationEntry *pageTable;
     unsigned int pageTableSize;
@@ -86,6 +86,8 @@ bool
 Machine::ReadMem(int addr, int size, int *value)
 {
     int data;
+    unsigned short half;
+    unsigned int word;
     ExceptionType exception;
     int physicalAddress;
     
@@ -102,14 +104,16 @@ Machine::ReadMem(int addr, int size, int *value)
 	*value = data;
 	break;
 	
-      case 2:
-	data = *(unsigned short *) &mainMemory[physicalAddress];
-	*value = ShortToHost(data);
+      case 2:			// memory is chars: copy them out, as
+				// reading them through a short pointer
+				// breaks the aliasing rules -O relies on
+	memcpy(&half, &mainMemory[physicalAddress], sizeof(half));
+	*value = ShortToHost(half);
 	break;
 	
       case 4:
-	data = *(unsigned int *) &mainMemory[physicalAddress];
-	*value = WordToHost(data);
+	memcpy(&word, &mainMemory[physicalAddress], sizeof(word));
+	*value = WordToHost(word);
 	break;
 
       default: ASSERT(FALSE);
@@ -137,6 +141,8 @@ Machine::WriteMem(int addr, int size, int value)
 {
     ExceptionType exception;
     int physicalAddress;
+    unsigned short half;
+    unsigned int word;
      
     DEBUG(dbgAddr, "Writing VA " << addr << ", size " << size << ", value " << value);
 
@@ -150,14 +156,14 @@ Machine::WriteMem(int addr, int size, int value)
 	mainMemory[physicalAddress] = (unsigned char) (value & 0xff);
 	break;
 
-      case 2:
-	*(unsigned short *) &mainMemory[physicalAddress]
-		= ShortToMachine((unsigned short) (value & 0xffff));
+      case 2:			// copied, as in ReadMem
+	half = ShortToMachine((unsigned short) (value & 0xffff));
+	memcpy(&mainMemory[physicalAddress], &half, sizeof(half));
 	break;
       
       case 4:
-	*(unsigned int *) &mainMemory[physicalAddress]
-		= WordToMachine((unsigned int) value);
+	word = WordToMachine((unsigned int) value);
+	memcpy(&mainMemory[physicalAddress], &word, sizeof(word));
 	break;
 	
       default: ASSERT(FALSE);
@@ -205,7 +211,7 @@ Machine::Translate(int virtAddr, int* physAddr, int size, bool writing)
     vpn = (unsigned) virtAddr / PageSize;
     offset = (unsigned) virtAddr % PageSize;
     
-    if (tlb == NULL) {		// => page table => vpn is index into table
+    if (!HasTLB()) {		// => page table => vpn is index into table
 	if (vpn >= pageTableSize) {
 	    DEBUG(dbgAddr, "Illegal virtual page # " << virtAddr);
 	    return AddressErrorException;
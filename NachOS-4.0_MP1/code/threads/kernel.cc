@@ -36,6 +36,9 @@ Kernel::Kernel(int argc, char **argv)
     reliability = 1;            // network reliability, default is 1.0
     hostName = 0;               // machine id, also UNIX socket name
                                 // 0 is the default machine id
+    execfile = new char *[argc];	// more than there can be -e flags
+    execfileNum = 0;
+    threads = new HandleTable<Thread *>;
     for (int i = 1; i < argc; i++) {
         if (strcmp(argv[i], "-rs") == 0) {
  	    	ASSERT(i + 1 < argc);
@@ -95,7 +98,7 @@ Kernel::Initialize()
     // object to save its state. 
 
 	
-    currentThread = new Thread("main", threadNum++);		
+    currentThread = NewThread("main");
     currentThread->setStatus(RUNNING);
 
     stats = new Statistics();		// collect statistics
@@ -127,6 +130,8 @@ Kernel::~Kernel()
     delete stats;
     delete interrupt;
     delete scheduler;
+    delete threads;			// no thread is deleted after this
+    delete [] execfile;
     delete alarm;
     delete machine;
     delete synchConsoleIn;
@@ -188,30 +193,16 @@ Kernel::ConsoleTest() {
     cout << "\n";
 
 }
+
+//----------------------------------------------------------------------
+// Kernel::ConsoleInteger
+//      Print a number and a newline on the console display, for the
+//	PrintInt system call.  They go out as one line.
+//----------------------------------------------------------------------
+
 void
 Kernel::ConsoleInteger(int number) {
-	char ch[10];
-	int digit = 1;
-	bool neg = (number < 0)? true : false;
-
-	ch[0] = '\n';
-
-	if(number == 0)
-		ch[digit++] = '0';
-	else {
-		number = (neg)? -(number) : (number);
-		while(number) {
-			ch[digit++] = (number % 10) + '0';
-			number = number / 10;
-		}
-		if(neg)
-			ch[digit++] = '-';
-	}
-		
-	while(digit) 
-		synchConsoleOut->PutChar(ch[--digit]);   // echo it!
-	
-
+    synchConsoleOut->PrintInt(number);
 }
 
 //----------------------------------------------------------------------
@@ -295,12 +286,13 @@ void Kernel::ExecAll()
 
 int Kernel::Exec(char* name)
 {
-	t[threadNum] = new Thread(name, threadNum);
-	t[threadNum]->space = new AddrSpace();
-	t[threadNum]->Fork((VoidFunctionPtr) &ForkExecute, (void *)t[threadNum]);
-	threadNum++;
+	Thread *t = NewThread(name);
 
-	return threadNum-1;
+	if (t == NULL)
+		return -1;
+	t->space = new AddrSpace();
+	t->Fork((VoidFunctionPtr) &ForkExecute, (void *)t);
+	return t->getID();
 /*
     cout << "Total threads number is " << execfileNum << endl;
     for (int n=1;n<=execfileNum;n++) {
@@ -328,6 +320,39 @@ int Kernel::Exec(char* name)
 //  cout << "after ThreadedKernel:Run();" << endl;  // unreachable
 }
 
+//----------------------------------------------------------------------
+// Kernel::NewThread
+// 	Make a thread called "name", and give it an ID -- its handle in
+//	the table of threads -- that getThread finds it by until it is
+//	deleted, and that is stale after.  Returns NULL if there are
+//	MaxHandleSlots threads already.
+//----------------------------------------------------------------------
+
+Thread *
+Kernel::NewThread(char *name)
+{
+	int id = threads->Enter();
+
+	if (id == -1)
+		return NULL;
+	*threads->Lookup(id) = new Thread(name, id);
+	return *threads->Lookup(id);
+}
+
+//----------------------------------------------------------------------
+// Kernel::ForgetThread
+// 	Called when "thread" is deleted: give back its ID, if NewThread
+//	gave it one.  Threads made directly have made-up IDs, which
+//	getThread doesn't find.
+//----------------------------------------------------------------------
+
+void
+Kernel::ForgetThread(Thread *thread)
+{
+	if (getThread(thread->getID()) == thread)
+		threads->Remove(thread->getID());
+}
+
 int Kernel::CreateFile(char *filename)
 {
 	return fileSystem->Create(filename);
@@ -335,7 +360,7 @@ int Kernel::CreateFile(char *filename)
 
 int Kernel::OpenFile(char *filename)
 {
-	return (int)fileSystem->Open(filename);
+	return fileSystem->Open_File(filename);
 }
 
 int Kernel::CloseFile(int openfileId)
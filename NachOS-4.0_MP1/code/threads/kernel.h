@@ -18,6 +18,7 @@
 #include "alarm.h"
 #include "filesys.h"
 #include "machine.h"
+#include "handle.h"
 
 class PostOfficeInput;
 class PostOfficeOutput;
@@ -43,7 +44,13 @@ class Kernel {
     void ConsoleTest();         // interactive console self test
     void ConsoleInteger(int number); // Print integer onto display
     void NetworkTest();         // interactive 2-machine network test
-	  Thread* getThread(int threadID){return t[threadID];}    
+	  Thread* getThread(int threadID)
+		{ Thread **p = threads->Lookup(threadID);
+		  return (p == NULL) ? NULL : *p; }
+				// NULL if "threadID" is stale
+	  Thread *NewThread(char *name);	// a thread with an ID of its own,
+				// or NULL if there are too many
+	  void ForgetThread(Thread *thread);	// it is being deleted
 	
 	  int CreateFile(char* filename); // fileSystem call
     int OpenFile(char *filename);  // fileSSystem call for opening a file
@@ -71,10 +78,9 @@ class Kernel {
 
   private:
 
-	Thread* t[10];
-	char*   execfile[10];
-	int execfileNum;
-	int threadNum;
+	HandleTable<Thread *> *threads;	// threads by ID
+	char **execfile;		// programs to run, from -e; 1 to
+	int execfileNum;		// execfileNum
     bool randomSlice;		// enable pseudo-random time slicing
     bool debugUserProg;         // single step user program
     double reliability;         // likelihood messages are dropped
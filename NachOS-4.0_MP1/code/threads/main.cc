@@ -45,6 +45,7 @@
 #include "filesys.h"
 #include "openfile.h"
 #include "sysdep.h"
+#include "memops.h"
 
 // global variables
 Kernel *kernel;
@@ -246,6 +247,8 @@ main(int argc, char **argv)
     debug = new Debug(debugArg);
     
     DEBUG(dbgThread, "Entering main");
+    MemOpsInit();
+    DEBUG(dbgThread, "Copying memory with " << MemOpsKind() << " routines");
 
     kernel = new Kernel(argc, argv);
 
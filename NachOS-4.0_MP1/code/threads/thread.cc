@@ -66,6 +66,7 @@ Thread::~Thread()
     ASSERT(this != kernel->currentThread);
     if (stack != NULL)
 	DeallocBoundedArray((char *) stack, StackSize * sizeof(int));
+    kernel->ForgetThread(this);
 }
 
 //----------------------------------------------------------------------
@@ -95,7 +96,7 @@ Thread::Fork(VoidFunctionPtr func, void *arg)
     Scheduler *scheduler = kernel->scheduler;
     IntStatus oldLevel;
     
-    DEBUG(dbgThread, "Forking thread: " << name << " f(a): " << (int) func << " " << arg);
+    DEBUG(dbgThread, "Forking thread: " << name << " f(a): " << (void *) func << " " << arg);
     StackAllocate(func, arg);
 
     oldLevel = interrupt->SetLevel(IntOff);
@@ -345,6 +346,23 @@ Thread::StackAllocate (VoidFunctionPtr func, void *arg)
     *(--stackTop) = (int) ThreadRoot;
     *stack = STACK_FENCEPOST;
 #endif
+
+#ifdef x86_64
+    // As on the x86, SWITCH() returns to ThreadRoot the first time, through 
+    // a return address on the stack -- a 64-bit one.  The stack must be 
+    // 16-byte aligned at a call, so the slot holding it is too.
+    stackTop = (int *) (((unsigned long) (stack + StackSize - 4)) & ~15UL);
+    stackTop -= 16 / sizeof(int);
+    *(void **) stackTop = (void *) ThreadRoot;
+    *stack = STACK_FENCEPOST;
+#endif
+
+#ifdef AARCH64
+    // SWITCH() "returns" to the address in x30, so ThreadRoot is only 
+    // in machineState.  The stack pointer must be 16-byte aligned.
+    stackTop = (int *) (((unsigned long) (stack + StackSize - 4)) & ~15UL);
+    *stack = STACK_FENCEPOST;
+#endif
     
 #ifdef PARISC
     machineState[PCState] = PLabelToAddr(ThreadRoot);
@@ -20,6 +20,7 @@
 #include "addrspace.h"
 #include "machine.h"
 #include "noff.h"
+#include "memops.h"
 
 //----------------------------------------------------------------------
 // SwapHeader
@@ -78,7 +79,7 @@ AddrSpace::AddrSpace()
     }
     
     // zero out the entire address space
-    bzero(kernel->machine->mainMemory, MemorySize);
+    MemZero(kernel->machine->mainMemory, MemorySize);
 }
 
 //----------------------------------------------------------------------
@@ -25,6 +25,7 @@
 #include "main.h"
 #include "syscall.h"
 #include "ksyscall.h"
+#include "memops.h"
 //----------------------------------------------------------------------
 // ExceptionHandler
 // 	Entry point into the Nachos kernel.  Called when a user program
@@ -146,9 +147,11 @@ ExceptionHandler(ExceptionType which)
 				char *buffer;
 				
 				buffer = SysRead(Buffersize, fileId);
-				strcpy(&kernel->machine->mainMemory[val], buffer);
+				int length = strlen(buffer);
 
-				kernel->machine->WriteRegister(2, strlen(buffer));
+				MemCopy(&kernel->machine->mainMemory[val], buffer,
+					length + 1);	// and the null
+				kernel->machine->WriteRegister(2, length);
 			}
 
 			kernel->machine->WriteRegister(PrevPCReg, kernel->machine->ReadRegister(PCReg));
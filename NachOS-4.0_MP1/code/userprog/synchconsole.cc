@@ -118,13 +118,47 @@ SynchConsoleOutput::CallBack()
     waitFor->V();
 }
 
+//----------------------------------------------------------------------
+// SynchConsoleOutput::PutBuffer
+//      Write a line of characters to the console display, waiting 
+//	if necessary.  The device puts it out with one write and one 
+//	interrupt, rather than one of each per character.
+//
+//	"buf" -- the characters to write
+//	"numChars" -- how many
+//----------------------------------------------------------------------
+
+void
+SynchConsoleOutput::PutBuffer(char *buf, int numChars)
+{
+    if (numChars <= 0)
+	return;
+    lock->Acquire();
+    consoleOutput->PutBuffer(buf, numChars);
+    waitFor->P();
+    lock->Release();
+}
+
+//----------------------------------------------------------------------
+// SynchConsoleOutput::PrintInt
+//      Write a number to the console display in decimal, and a newline,
+//	as one line.
+//----------------------------------------------------------------------
 
 void
 SynchConsoleOutput::PrintInt(int number)
 {
-	lock->Acquire();
-	consoleOutput->PrintInt(number);
-	waitFor->P();
-	lock->Release();
+    char buf[12];		// enough for "-2147483648\n"
+    int i = sizeof(buf);
+    unsigned int n = (number < 0) ? -(unsigned int) number : number;
+
+    buf[--i] = '\n';
+    do {
+	buf[--i] = (n % 10) + '0';
+	n /= 10;
+    } while (n != 0);
+    if (number < 0)
+	buf[--i] = '-';
+    PutBuffer(&buf[i], sizeof(buf) - i);
 }
 
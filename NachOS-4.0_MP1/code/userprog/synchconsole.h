@@ -41,7 +41,11 @@ class SynchConsoleOutput : public CallBackObj {
     ~SynchConsoleOutput();
 
     void PutChar(char ch);	// Write a character, waiting if necessary
-	void PrintInt(int number);
+    void PutBuffer(char *buf, int numChars);
+				// Write a line of characters, waiting 
+				// once for all of them
+    void PrintInt(int number);	// Write a number in decimal, and a 
+				// newline
    
   private:
     ConsoleOutput *consoleOutput;// the hardware display
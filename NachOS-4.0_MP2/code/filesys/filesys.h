@@ -37,14 +37,18 @@
 #include "sysdep.h"
 #include "openfile.h"
 
+class Thread;
+
 #ifdef FILESYS_STUB 		// Temporarily implement file system calls as 
 				// calls to UNIX, until the real file system
 				// implementation is available
 class FileSystem {
   public:
     FileSystem() {
-      for (int i = 0; i < 20; i++) 
+      for (int i = 0; i < 20; i++) {
         fileDescriptorTable[i] = NULL; 
+        fileOpener[i] = NULL;
+      }
     }
 
     bool Create(char *name) {
@@ -58,72 +62,66 @@ class FileSystem {
   	}
 
     OpenFile* Open(char *name) {
-	    int fileDescriptor = OpenForReadWrite(name, FALSE);
-      int id;
-      OpenFile *open;  
-      
-	    if (fileDescriptor == -1) return NULL;
-     
-      open = new OpenFile(fileDescriptor);
-      
+	  int fileDescriptor = OpenForReadWrite(name, FALSE);
+
+	  if (fileDescriptor == -1) return NULL;
+	  return new OpenFile(fileDescriptor);
+    }
+
+    // A user program's OpenFileId is one more than the file's place in
+    // fileDescriptorTable -- not the OpenFile itself, which doesn't fit
+    // in a MIPS register on a 64-bit host.
+
+    int Open_File(char *name, Thread *opener) {
       for(int i=0; i<20; i++) {
         if(fileDescriptorTable[i] == NULL) {
-          id = i+1;
-          fileDescriptorTable[i] = open;
-          break;
+          fileDescriptorTable[i] = Open(name);
+          fileOpener[i] = opener;
+          return (fileDescriptorTable[i] == NULL) ? 0 : i+1;
         }
       }
-	    return open;
+      return 0;		// too many open files
     }
-    
+
+    OpenFile *FileOf(int id) {	// the open file "id" names, or NULL
+      if(id <= 0 || id > 20) return NULL;
+      return fileDescriptorTable[id-1];
+    }
+
     int Close_File(int openfileId) {
-      OpenFile *close;
-      bool exist = false;
-      int file_to_close;
-      
-      if(openfileId <= 0) return 0;
-      
-      if((close = (OpenFile*)(openfileId)) == NULL) return 0;
-      
-      for(int i=0;i<20;i++) {
-         if(fileDescriptorTable[i] != NULL) {
-             if(openfileId == (int)fileDescriptorTable[i]) {
-                 delete fileDescriptorTable[i];
-                 fileDescriptorTable[i] = NULL;
-                 return true;
-             }
-         }
+      OpenFile *close = FileOf(openfileId);
+
+      if(close == NULL) return 0;
+      delete close;
+      fileDescriptorTable[openfileId-1] = NULL;
+      return 1;
+    }
+
+    void CloseAll(Thread *opener) {	// close what "opener" left open,
+      for(int i=0; i<20; i++) {		// as its program exits
+        if(fileDescriptorTable[i] != NULL && fileOpener[i] == opener) {
+          delete fileDescriptorTable[i];
+          fileDescriptorTable[i] = NULL;
+        }
       }
-      return false;
     }
     
     int Write_File(char *buffer, int size, int id) {
-        OpenFile *file;
-        int numWritten = 0;
-        
-        if(id <=0 ) return 0; //check id is larger than zero.
-        
-        file = (OpenFile*)(id);
+        OpenFile *file = FileOf(id);
         
-        if(file == NULL) return 0; // check the address is valid
+        if(file == NULL) return 0; // check the id is valid
         
-        numWritten = file->Write(buffer, size);
-        
-        return numWritten;
+        return file->Write(buffer, size);
     }
     
     char* Read_File(int size, int id) {
-      OpenFile *file;
-      char *buffer = (char *)malloc(sizeof(char *) * (size));
-      int numRead = 0;
-      
-      if(id <= 0) return 0;
-      
-      file = (OpenFile*)(id);
+      OpenFile *file = FileOf(id);
+      char *buffer;
       
       if(file == NULL) return 0;
       
-      numRead = file->Read(buffer, size);
+      buffer = (char *)malloc(sizeof(char *) * (size));
+      file->Read(buffer, size);
       
       return buffer;
     }
@@ -131,6 +129,7 @@ class FileSystem {
     bool Remove(char *name) { return Unlink(name) == 0; }
 
 	OpenFile *fileDescriptorTable[20];
+	Thread *fileOpener[20];		// the thread that opened each one
 	
 };
 
@@ -41,6 +41,7 @@ PersistentBitmap::PersistentBitmap(OpenFile *file, int numItems):Bitmap(numItems
     // but we will just overwrite that with the contents of the
     // map found in the file
     file->ReadAt((char *)map, numWords * sizeof(unsigned), 0);
+    Recount();
 }
 
 //----------------------------------------------------------------------
@@ -63,6 +64,7 @@ void
 PersistentBitmap::FetchFrom(OpenFile *file) 
 {
     file->ReadAt((char *)map, numWords * sizeof(unsigned), 0);
+    Recount();
 }
 
 //----------------------------------------------------------------------
@@ -3,7 +3,13 @@
 //	can be either on or off.
 //
 //	Represented as an array of unsigned integers, on which we do
-//	modulo arithmetic to find the bit we are interested in.
+//	modulo arithmetic to find the bit we are interested in.  Searches
+//	look at a whole word of bits at a time.
+//
+//	The bits are also divided into groups of whole words (for the
+//	disk's free map, a group is one track), and we keep count of how
+//	many bits in each group, and in the whole bitmap, are clear, so
+//	that searches can skip over full groups, and NumClear is cheap.
 //
 //	The bitmap can be parameterized with with the number of bits being 
 //	managed.
@@ -32,28 +38,68 @@ const int BitsInWord = sizeof(unsigned int) * BitsInByte;
 
 class Bitmap {
   public:
-    Bitmap(int numItems);	// Initialize a bitmap, with "numItems" bits
+    Bitmap(int numItems, int bitsInGroup = BitsInWord);
+				// Initialize a bitmap, with "numItems" bits
 				// initially, all bits are cleared.
-    ~Bitmap();			// De-allocate bitmap
+    virtual ~Bitmap();		// De-allocate bitmap
     
-    void Mark(int which);   	// Set the "nth" bit
-    void Clear(int which);  	// Clear the "nth" bit
+    virtual void Mark(int which);	// Set the "nth" bit
+    virtual void Clear(int which);	// Clear the "nth" bit
+    virtual void MarkRange(int first, int count);
+    virtual void ClearRange(int first, int count);
+				// Set/clear "count" bits starting at
+				// "first", a word at a time
+				// (virtual, so that a PersistentBitmap
+				// knows which parts of it have changed)
     bool Test(int which) const;	// Is the "nth" bit set?
     int FindAndSet();         // Return the # of a clear bit, and as a side
 				// effect, set the bit. 
 				// If no bits are clear, return -1.
-    int NumClear() const;	// Return the number of clear bits
+    int NumClear() const { return numClear; }
+				// Return the number of clear bits
+    int NumClearIn(int first, int count) const;
+				// Return the number of clear bits among
+				// "count" bits starting at "first"
+    int FindClearRun(int count, int *length, int from = 0) const;
+				// Return the start of the first run of
+				// "count" clear bits at or after "from"
+				// (wrapping around), or else of the
+				// longest run; -1 if no bits are clear
+    int FindContiguous(int count) const;
+				// Return the start of the first run of
+				// "count" clear bits, or -1 if none
+    int NextClear(int from, int end) const;
+    int NextSet(int from, int end) const;
+				// First clear/set bit at or after "from",
+				// or "end" if there is none before it
 
     void Print() const;		// Print contents of bitmap
     void SelfTest();		// Test whether bitmap is working
     
   protected:
+    void Recount();		// Recompute the counts of clear bits,
+				// after "map" has been overwritten
+
     int numBits;		// number of bits in the bitmap
     int numWords;		// number of words of bitmap storage
 				// (rounded up if numBits is not a
 				//  multiple of the number of bits in
 				//  a word)
     unsigned int *map;		// bit storage
+
+  private:
+    unsigned int ClearBits(int word) const;
+				// The bits of a word that are clear (and
+				// within the bitmap)
+    unsigned int RangeMask(int word, int first, int end) const;
+				// The bits of a word numbered from
+				// "first" up to "end"
+
+    int numClear;		// number of clear bits
+    int groupBits;		// number of bits in a group
+    int numGroups;		// number of groups (the last one may
+				// be partial)
+    int *groupClear;		// number of clear bits in each group
 };
 
 #endif // BITMAP_H
@@ -0,0 +1,36 @@
+// memops.h
+//	Routines to copy, zero and compare blocks of memory -- pages of
+//	the simulated machine's memory, disk sectors, file data, packets.
+//	The kernel moves these through here rather than calling bcopy
+//	and friends ad hoc, so that they all get the fastest routines
+//	the host has.
+//
+//	Where the compiler can build them, these are written with the
+//	host's vector instructions: 32 bytes at a time with AVX2 on x86,
+//	16 at a time with NEON on ARM.  MemOpsInit picks them at startup
+//	if the CPU has them; until then, and on any other host, the C
+//	library's routines are used.
+//
+//	Blocks copied must not overlap.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#ifndef MEMOPS_H
+#define MEMOPS_H
+
+#include "copyright.h"
+
+extern void MemOpsInit();	// pick the routines for this CPU
+extern char *MemOpsKind();	// which ones were picked
+
+extern void MemCopy(void *to, const void *from, int numBytes);
+				// copy "numBytes" bytes
+extern void MemZero(void *to, int numBytes);
+				// zero "numBytes" bytes
+extern int MemCompare(const void *a, const void *b, int numBytes);
+				// as memcmp: 0 if the same, or the
+				// sign of the first difference
+
+#endif // MEMOPS_H
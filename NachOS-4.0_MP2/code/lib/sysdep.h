@@ -19,9 +19,18 @@
 
 using namespace std;
 
-// Process control: abort, exit, and sleep
-extern void Abort();
-extern void Exit(int exitCode);
+// Process control: abort, exit, and sleep.  Abort and Exit never
+// return, and the compiler is told so: after a failed ASSERT, it
+// doesn't have to warn about, or keep code for, the way on.
+
+#ifdef __GNUC__
+#define NORETURN __attribute__((noreturn))
+#else
+#define NORETURN
+#endif
+
+extern void Abort() NORETURN;
+extern void Exit(int exitCode) NORETURN;
 extern void Delay(int seconds);
 extern void UDelay(unsigned int usec);// rcgood - to avoid spinners.
 
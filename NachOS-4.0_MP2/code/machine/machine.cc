@@ -10,6 +10,17 @@
 #include "copyright.h"
 #include "machine.h"
 #include "main.h"
+#include "memsim.h"
+
+// The size of physical memory (see SetMemorySize)
+
+int PageSize = DefaultPageSize;
+int NumPhysPages = DefaultNumPhysPages;
+int MemorySize = DefaultNumPhysPages * DefaultPageSize;
+
+// The size of the TLB
+
+int TLBSize = Config::UseTLB ? DefaultTLBSize : 0;
 
 // Textual names of the exceptions that can be generated by user program
 // execution, for debugging.
@@ -44,6 +55,25 @@ void CheckEndian()
 #endif
 }
 
+//----------------------------------------------------------------------
+// SetMemorySize
+// 	Choose the page size and the number of pages of physical memory.
+//	Must be called, if at all, before the Machine is created.
+//
+//	"pageSize" -- bytes per page; must be a power of two
+//	"numPages" -- pages of physical memory
+//----------------------------------------------------------------------
+
+void
+SetMemorySize(int pageSize, int numPages)
+{
+    ASSERT(pageSize > 0 && (pageSize & (pageSize - 1)) == 0);
+    ASSERT(numPages > 0);
+    PageSize = pageSize;
+    NumPhysPages = numPages;
+    MemorySize = NumPhysPages * PageSize;
+}
+
 //----------------------------------------------------------------------
 // Machine::Machine
 // 	Initialize the simulation of user program execution.
@@ -61,17 +91,20 @@ Machine::Machine(bool debug)
     mainMemory = new char[MemorySize];
     for (i = 0; i < MemorySize; i++)
       	mainMemory[i] = 0;
-#ifdef USE_TLB
-    tlb = new TranslationEntry[TLBSize];
-    for (i = 0; i < TLBSize; i++)
-	tlb[i].valid = FALSE;
-    pageTable = NULL;
-#else	// use linear page table
-    tlb = NULL;
+    tlb = NULL;				// unless there is a TLB, use a page
+    if (TLBSize > 0) {			// table
+	tlb = new TranslationEntry[TLBSize];
+	for (i = 0; i < TLBSize; i++)
+	    tlb[i].valid = FALSE;
+    }
+    asid = 0;
     pageTable = NULL;
-#endif
+    pageMap = NULL;
 
     singleStep = debug;
+    profiler = NULL;
+    numObservers = 0;
+    fetching = FALSE;
     CheckEndian();
 }
 
@@ -85,6 +118,33 @@ Machine::~Machine()
     delete [] mainMemory;
     if (tlb != NULL)
         delete [] tlb;
+    for (int i = 0; i < numObservers; i++)
+	delete observers[i];
+}
+
+//----------------------------------------------------------------------
+// Machine::AddObserver
+// 	Tell "observer" about every memory reference that translates,
+//	from now on.  The machine deletes it when it is deleted.
+//----------------------------------------------------------------------
+
+void
+Machine::AddObserver(MemoryObserver *observer)
+{
+    ASSERT(numObservers < MaxObservers);
+    observers[numObservers++] = observer;
+}
+
+//----------------------------------------------------------------------
+// Machine::PrintObservers
+// 	Print what each memory observer saw, as part of the statistics.
+//----------------------------------------------------------------------
+
+void
+Machine::PrintObservers()
+{
+    for (int i = 0; i < numObservers; i++)
+	observers[i]->Print();
 }
 
 //----------------------------------------------------------------------
@@ -24,21 +24,27 @@
 #include "copyright.h"
 #include "utility.h"
 #include "translate.h"
+#include "config.h"
 
-// Definitions related to the size, and format of user memory
+// Definitions related to the size, and format of user memory.
+//
+// The page size and the number of pages of physical memory are
+// chosen when Nachos starts (with -pagesize and -mem), by calling
+// SetMemorySize before the Machine is created; they don't change
+// after that.
 
-const int PageSize = 128; 		// set the page size equal to
-					// the disk sector size, for simplicity
+const int DefaultPageSize = Config::PageSize;
+const int DefaultNumPhysPages = Config::NumPhysPages;
 
-//
-// You are allowed to change this value.
-// Doing so will change the number of pages of physical memory
-// available on the simulated machine.
-//
-const int NumPhysPages = 128;
+extern int PageSize;			// bytes in a page: a power of two
+extern int NumPhysPages;		// pages of physical memory
+extern int MemorySize;			// NumPhysPages * PageSize
 
-const int MemorySize = (NumPhysPages * PageSize);
-const int TLBSize = 4;			// if there is a TLB, make it small
+extern void SetMemorySize(int pageSize, int numPages);
+const int DefaultTLBSize = Config::TLBSize;
+extern int TLBSize;			// entries in the TLB, or 0 if the
+					// machine has none (set with "-tlb"
+					// before the Machine is created)
 
 enum ExceptionType { NoException,           // Everything ok!
 		     SyscallException,      // A program executed a system call.
@@ -90,6 +96,13 @@ enum ExceptionType { NoException,           // Everything ok!
 
 class Instruction;
 class Interrupt;
+class PageTable;
+class Profiler;
+class MemoryObserver;
+
+// The most memory observers the machine can have
+
+const int MaxObservers = 4;
 
 class Machine {
   public:
@@ -134,9 +147,23 @@ class Machine {
 
     TranslationEntry *tlb;		// this pointer should be considered 
 					// "read-only" to Nachos kernel code
+    int asid;				// only TLB entries tagged with this
+					// address space id are matched, so
+					// the TLB needn't be flushed when
+					// the address space changes
 
     TranslationEntry *pageTable;
     unsigned int pageTableSize;
+    PageTable *pageMap;		// or else, a page table that has to be
+				// asked for each translation
+
+    Profiler *profiler;		// if not NULL, told the address of each
+				// instruction before it is run
+
+    void AddObserver(MemoryObserver *observer);
+				// Tell "observer" about each memory
+				// reference from now on
+    void PrintObservers();	// Print what each observer saw
 
     bool ReadMem(int addr, int size, int* value);
     bool WriteMem(int addr, int size, int value);
@@ -173,6 +200,10 @@ class Machine {
 
     int registers[NumTotalRegs]; // CPU registers, for executing user programs
 
+    MemoryObserver *observers[MaxObservers];
+    int numObservers;		// observers told about memory references
+    bool fetching;		// is ReadMem fetching an instruction?
+
     bool singleStep;		// drop back into the debugger after each
 				// simulated instruction
     int runUntilTime;		// drop back into the debugger when simulated
@@ -0,0 +1,414 @@
+// memsim.cc
+//	Routines to simulate caches and a TLB against the memory
+//	references of user programs, and to count and trace the
+//	references.
+//
+// Copyright (c) 1992-1996 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "memsim.h"
+#include "machine.h"
+#include "main.h"
+#include "sysdep.h"
+#include <stdio.h>
+
+static char *kindName[3] = { "fetches", "reads", "writes" };
+
+//----------------------------------------------------------------------
+// PrintRate
+// 	Print "n" references of some kind, and what percentage of them
+//	missed.
+//----------------------------------------------------------------------
+
+static void
+PrintRate(char *what, int n, int missed)
+{
+    char buf[30];
+
+    sprintf(buf, "%.2f", (n == 0) ? 0.0 : 100.0 * missed / n);
+    cout << what << " " << n << " (missed " << buf << "%)";
+}
+
+//----------------------------------------------------------------------
+// Cache::Cache
+// 	Initialize an empty cache.
+//
+//	"name" is what to call it when printing
+//	"size" is its capacity in bytes
+//	"ways" is the number of lines in each set; "size" / "lineSize"
+//		makes it fully associative
+//	"lineSize" is the bytes in each line, a power of 2 of at least 4,
+//		so that no reference spans two lines
+//	"next" is the level below, or NULL for memory
+//----------------------------------------------------------------------
+
+Cache::Cache(char *name, int size, int ways, int lineSize, Cache *next)
+{
+    ASSERT(lineSize >= 4 && (lineSize & (lineSize - 1)) == 0);
+    ASSERT(ways > 0 && size > 0 && size % (ways * lineSize) == 0);
+    this->name = name;
+    this->numSets = size / (ways * lineSize);
+    this->ways = ways;
+    this->lineSize = lineSize;
+    this->next = next;
+    tag = new int[numSets * ways];
+    dirty = new bool[numSets * ways];
+    lastUse = new unsigned int[numSets * ways];
+    for (int i = 0; i < numSets * ways; i++) {
+	tag[i] = -1;
+	dirty[i] = FALSE;
+	lastUse[i] = 0;
+    }
+    now = 0;
+    for (int k = 0; k < 3; k++)
+	hits[k] = misses[k] = 0;
+    writeBacks = 0;
+}
+
+//----------------------------------------------------------------------
+// Cache::~Cache
+// 	De-allocate the cache.
+//----------------------------------------------------------------------
+
+Cache::~Cache()
+{
+    delete [] tag;
+    delete [] dirty;
+    delete [] lastUse;
+}
+
+//----------------------------------------------------------------------
+// Cache::Access
+// 	Reference the line holding "physAddr".  On a miss, the least
+//	recently used line of its set is replaced (writing it to the
+//	level below if it is dirty), and the line is read from the level
+//	below -- for a write too, as the cache allocates on writes.
+//----------------------------------------------------------------------
+
+void
+Cache::Access(int physAddr, MemAccessKind kind)
+{
+    int line = physAddr / lineSize;
+    int first = (line % numSets) * ways;
+    int victim = first;
+
+    now++;
+    for (int i = first; i < first + ways; i++) {
+	if (tag[i] == line) {
+	    hits[kind]++;
+	    lastUse[i] = now;
+	    if (kind == WriteAccess)
+		dirty[i] = TRUE;
+	    return;
+	}
+	if (lastUse[i] < lastUse[victim])
+	    victim = i;
+    }
+
+    misses[kind]++;
+    if (tag[victim] != -1 && dirty[victim]) {
+	writeBacks++;
+	if (next != NULL)
+	    next->Access(tag[victim] * lineSize, WriteAccess);
+    }
+    if (next != NULL)
+	next->Access(physAddr, (kind == FetchAccess) ? FetchAccess : ReadAccess);
+    tag[victim] = line;
+    dirty[victim] = (kind == WriteAccess);
+    lastUse[victim] = now;
+}
+
+//----------------------------------------------------------------------
+// Cache::Print
+// 	Print the references to the cache of each kind, and how many
+//	missed.
+//----------------------------------------------------------------------
+
+void
+Cache::Print()
+{
+    int n = 0, missed = 0;
+
+    cout << name << " cache, " << numSets * ways * lineSize << " bytes, "
+	 << ways << "-way, " << lineSize << "-byte lines: ";
+    for (int k = 0; k < 3; k++) {
+	PrintRate(kindName[k], hits[k] + misses[k], misses[k]);
+	cout << ", ";
+	n += hits[k] + misses[k];
+	missed += misses[k];
+    }
+    PrintRate("total", n, missed);
+    cout << ", write-backs " << writeBacks << "\n";
+}
+
+//----------------------------------------------------------------------
+// CacheSim::CacheSim
+// 	Initialize an L1 cache, and an L2 cache below it unless "l2Size"
+//	is 0.
+//----------------------------------------------------------------------
+
+CacheSim::CacheSim(int l1Size, int l1Ways, int l1Line,
+		   int l2Size, int l2Ways, int l2Line)
+{
+    l2 = (l2Size == 0) ? NULL : new Cache("L2", l2Size, l2Ways, l2Line, NULL);
+    l1 = new Cache("L1", l1Size, l1Ways, l1Line, l2);
+}
+
+//----------------------------------------------------------------------
+// CacheSim::~CacheSim
+// 	De-allocate the caches.
+//----------------------------------------------------------------------
+
+CacheSim::~CacheSim()
+{
+    delete l1;
+    delete l2;
+}
+
+//----------------------------------------------------------------------
+// CacheSim::Access
+// 	Pass a memory reference to the L1 cache.
+//----------------------------------------------------------------------
+
+void
+CacheSim::Access(int virtAddr, int physAddr, int size, MemAccessKind kind)
+{
+    l1->Access(physAddr, kind);
+}
+
+//----------------------------------------------------------------------
+// CacheSim::Print
+//----------------------------------------------------------------------
+
+void
+CacheSim::Print()
+{
+    l1->Print();
+    if (l2 != NULL)
+	l2->Print();
+}
+
+//----------------------------------------------------------------------
+// TLBSim::TLBSim
+// 	Initialize the simulation, with every TLB empty.
+//----------------------------------------------------------------------
+
+TLBSim::TLBSim()
+{
+    space = NULL;
+    depth = 0;
+    accesses = 0;
+    for (int d = 0; d <= MaxTLBSim; d++)
+	atDepth[d] = 0;
+}
+
+//----------------------------------------------------------------------
+// TLBSim::Access
+// 	Find the page of "virtAddr" in the stack of pages, most recently
+//	used first.  A TLB of more entries than its depth would have held
+//	it; a smaller one would have missed.  Then move it to the top.
+//	A different address space than last time empties the stack, as
+//	a context switch flushes the TLB.
+//----------------------------------------------------------------------
+
+void
+TLBSim::Access(int virtAddr, int physAddr, int size, MemAccessKind kind)
+{
+    int vpn = (unsigned) virtAddr / PageSize;
+    int d;
+
+    if (kernel->currentThread->space != space) {
+	space = kernel->currentThread->space;
+	depth = 0;
+    }
+    accesses++;
+    for (d = 0; d < depth && stack[d] != vpn; d++)
+	;
+    if (d < depth) {
+	atDepth[d]++;
+    } else {
+	atDepth[MaxTLBSim]++;
+	if (depth < MaxTLBSim)
+	    depth++;
+	d = depth - 1;		// (dropping the least recently used)
+    }
+    for (; d > 0; d--)
+	stack[d] = stack[d - 1];
+    stack[0] = vpn;
+}
+
+//----------------------------------------------------------------------
+// TLBSim::Print
+// 	Print the misses a TLB of each power of 2 entries, up to
+//	MaxTLBSim, would have had.  A TLB of n entries misses on the
+//	references found n or more deep in the stack.
+//----------------------------------------------------------------------
+
+void
+TLBSim::Print()
+{
+    int missed = accesses;
+    int d = 0;
+
+    char buf[60];
+
+    cout << "TLB simulation (fully associative, LRU; the machine has "
+	 << TLBSize << " entries): references " << accesses << "\n";
+    for (int n = 1; n <= MaxTLBSim; n *= 2) {
+	for (; d < n; d++)
+	    missed -= atDepth[d];
+	sprintf(buf, "%9d entries: misses %d (%.2f%%)\n", n, missed,
+		(accesses == 0) ? 0.0 : 100.0 * missed / accesses);
+	cout << buf;
+    }
+}
+
+//----------------------------------------------------------------------
+// PageHeat::PageHeat
+// 	Initialize the counts, with room for a few pages.
+//----------------------------------------------------------------------
+
+PageHeat::PageHeat()
+{
+    numPages = 64;
+    for (int k = 0; k < 3; k++) {
+	refs[k] = new int[numPages];
+	bzero(refs[k], numPages * sizeof(int));
+    }
+}
+
+//----------------------------------------------------------------------
+// PageHeat::~PageHeat
+//----------------------------------------------------------------------
+
+PageHeat::~PageHeat()
+{
+    for (int k = 0; k < 3; k++)
+	delete [] refs[k];
+}
+
+//----------------------------------------------------------------------
+// PageHeat::Access
+// 	Count a reference to the virtual page of "virtAddr", growing the
+//	counts if the page is past the end of them.  The counts are of
+//	every address space together.
+//----------------------------------------------------------------------
+
+void
+PageHeat::Access(int virtAddr, int physAddr, int size, MemAccessKind kind)
+{
+    int vpn = (unsigned) virtAddr / PageSize;
+
+    if (vpn >= numPages) {
+	int size = numPages;
+
+	while (vpn >= size)
+	    size *= 2;
+	for (int k = 0; k < 3; k++) {
+	    int *bigger = new int[size];
+
+	    bzero(bigger, size * sizeof(int));
+	    bcopy(refs[k], bigger, numPages * sizeof(int));
+	    delete [] refs[k];
+	    refs[k] = bigger;
+	}
+	numPages = size;
+    }
+    refs[kind][vpn]++;
+}
+
+//----------------------------------------------------------------------
+// PageHeat::Print
+// 	Print each virtual page that was referenced, with its references
+//	of each kind and a bar as long as its share of the hottest page's.
+//----------------------------------------------------------------------
+
+void
+PageHeat::Print()
+{
+    const int BarWidth = 40;
+    int most = 0, n;
+    char buf[60], bar[BarWidth + 1];
+
+    for (int vpn = 0; vpn < numPages; vpn++) {
+	n = refs[FetchAccess][vpn] + refs[ReadAccess][vpn] + refs[WriteAccess][vpn];
+	if (n > most)
+	    most = n;
+    }
+    cout << "Page heat map:\n     page     fetches       reads      writes\n";
+    for (int vpn = 0; vpn < numPages; vpn++) {
+	n = refs[FetchAccess][vpn] + refs[ReadAccess][vpn] + refs[WriteAccess][vpn];
+	if (n == 0)
+	    continue;
+	int width = (int) ((double) BarWidth * n / most + 0.5);
+
+	for (int i = 0; i < width; i++)
+	    bar[i] = '#';
+	bar[width] = '\0';
+	sprintf(buf, "%9d  %10d  %10d  %10d  ", vpn, refs[FetchAccess][vpn],
+		refs[ReadAccess][vpn], refs[WriteAccess][vpn]);
+	cout << buf << bar << "\n";
+    }
+}
+
+//----------------------------------------------------------------------
+// MemTrace::MemTrace
+// 	Start a trace of memory references in the UNIX file "fileName".
+//	Each line is the kind of reference ("I" for an instruction
+//	fetch, "R" or "W"), the virtual and physical addresses in hex,
+//	and the size in bytes.
+//----------------------------------------------------------------------
+
+MemTrace::MemTrace(char *fileName)
+{
+    this->fileName = fileName;
+    fd = OpenForWrite(fileName);
+    used = 0;
+    numRefs = 0;
+}
+
+//----------------------------------------------------------------------
+// MemTrace::~MemTrace
+// 	Write out the rest of the trace, and close the file.
+//----------------------------------------------------------------------
+
+MemTrace::~MemTrace()
+{
+    if (used > 0)
+	WriteFile(fd, buffer, used);
+    Close(fd);
+}
+
+//----------------------------------------------------------------------
+// MemTrace::Access
+// 	Add a line for a reference to the trace, writing the buffer out
+//	when it might not have room for another.
+//----------------------------------------------------------------------
+
+void
+MemTrace::Access(int virtAddr, int physAddr, int size, MemAccessKind kind)
+{
+    used += sprintf(buffer + used, "%c %x %x %d\n", "IRW"[kind],
+		    virtAddr, physAddr, size);
+    numRefs++;
+    if (used > (int) sizeof(buffer) - 40) {
+	WriteFile(fd, buffer, used);
+	used = 0;
+    }
+}
+
+//----------------------------------------------------------------------
+// MemTrace::Print
+// 	Write out the trace so far, and say where it is.
+//----------------------------------------------------------------------
+
+void
+MemTrace::Print()
+{
+    if (used > 0)
+	WriteFile(fd, buffer, used);
+    used = 0;
+    cout << "Memory trace: " << numRefs << " references in " << fileName << "\n";
+}
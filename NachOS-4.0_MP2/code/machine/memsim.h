@@ -0,0 +1,146 @@
+// memsim.h
+//	Data structures for watching the simulated machine's memory
+//	references, to evaluate data layouts and memory hierarchies
+//	without changing the machine.
+//
+//	Machine::ReadMem and Machine::WriteMem (including instruction
+//	fetches, which go through ReadMem) tell every MemoryObserver
+//	added with Machine::AddObserver about each reference that
+//	translates.  The observers here are:
+//
+//	    CacheSim	an L1 cache, optionally backed by an L2, of any
+//			size, associativity and line size, with LRU
+//			replacement, write-allocate and write-back;
+//			physically addressed
+//	    TLBSim	a fully associative LRU TLB, of every size from 1
+//			to MaxTLBSim entries at once (an address misses in
+//			a TLB of n entries if n other pages were used since
+//			it last was), flushed on each context switch as
+//			the real one is
+//	    PageHeat	references to each virtual page, for a heat map
+//	    MemTrace	a trace of every reference, to a UNIX file
+//
+//	Each prints its results as part of Statistics::Print.
+//
+// Copyright (c) 1992-1996 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#ifndef MEMSIM_H
+#define MEMSIM_H
+
+#include "copyright.h"
+#include "utility.h"
+
+// The kinds of memory reference
+
+enum MemAccessKind { FetchAccess, ReadAccess, WriteAccess };
+
+// The following class defines the interface to something told about
+// each memory reference.
+
+class MemoryObserver {
+  public:
+    virtual ~MemoryObserver() {}
+    virtual void Access(int virtAddr, int physAddr, int size,
+			MemAccessKind kind) = 0;
+				// a reference of "size" bytes
+    virtual void Print() = 0;	// print what was observed
+};
+
+// One level of cache
+
+class Cache {
+  public:
+    Cache(char *name, int size, int ways, int lineSize, Cache *next);
+				// A cache of "size" bytes, in sets of
+				// "ways" lines; misses go to "next",
+				// or to memory if it is NULL
+    ~Cache();
+
+    void Access(int physAddr, MemAccessKind kind);
+				// Reference the line holding "physAddr"
+    void Print();
+
+  private:
+    char *name;
+    int numSets, ways, lineSize;
+    Cache *next;		// the level below
+    int *tag;			// line number held in tag[set * ways +
+				// way], or -1 if empty
+    bool *dirty;		// has the line been written?
+    unsigned int *lastUse;	// when it was last referenced, for LRU
+    unsigned int now;		// references made so far
+    int hits[3], misses[3];	// of each MemAccessKind
+    int writeBacks;		// dirty lines evicted
+};
+
+// The following class makes a cache hierarchy watch memory.
+
+class CacheSim : public MemoryObserver {
+  public:
+    CacheSim(int l1Size, int l1Ways, int l1Line,
+	     int l2Size, int l2Ways, int l2Line);
+				// L1, and L2 unless l2Size is 0
+    ~CacheSim();
+
+    void Access(int virtAddr, int physAddr, int size, MemAccessKind kind);
+    void Print();
+
+  private:
+    Cache *l1, *l2;
+};
+
+// The largest TLB TLBSim sizes
+
+const int MaxTLBSim = 64;
+
+class AddrSpace;
+
+class TLBSim : public MemoryObserver {
+  public:
+    TLBSim();
+
+    void Access(int virtAddr, int physAddr, int size, MemAccessKind kind);
+    void Print();
+
+  private:
+    AddrSpace *space;		// address space the stack is for
+    int stack[MaxTLBSim];	// pages, the most recently used first
+    int depth;			// pages on the stack
+    int accesses;
+    int atDepth[MaxTLBSim + 1];	// atDepth[d]: references to a page d
+				// deep in the stack ([MaxTLBSim]: not
+				// on it)
+};
+
+class PageHeat : public MemoryObserver {
+  public:
+    PageHeat();
+    ~PageHeat();
+
+    void Access(int virtAddr, int physAddr, int size, MemAccessKind kind);
+    void Print();
+
+  private:
+    int *refs[3];		// references to each page, of each kind
+    int numPages;		// size of the arrays (they grow)
+};
+
+class MemTrace : public MemoryObserver {
+  public:
+    MemTrace(char *fileName);	// write the trace to "fileName"
+    ~MemTrace();
+
+    void Access(int virtAddr, int physAddr, int size, MemAccessKind kind);
+    void Print();
+
+  private:
+    char *fileName;
+    int fd;			// UNIX file descriptor of the trace
+    char buffer[4096];		// trace lines not yet written
+    int used;			// bytes of buffer in use
+    int numRefs;		// references traced
+};
+
+#endif // MEMSIM_H
@@ -21,6 +21,7 @@
 #include "machine.h"
 #include "mipssim.h"
 #include "main.h"
+#include "profile.h"
 
 static void Mult(int a, int b, bool signedArith, int* hiPtr, int* loPtr);
 
@@ -64,6 +65,8 @@ Machine::Run()
     }
     kernel->interrupt->setStatus(UserMode);
     for (;;) {
+	if (profiler != NULL)
+	    profiler->Sample(registers[PCReg]);
         OneInstruction(instr);
 		kernel->interrupt->OneTick();
 		if (singleStep && (runUntilTime <= kernel->stats->totalTicks))
@@ -130,8 +133,12 @@ Machine::OneInstruction(Instruction *instr)
 				// in the future
 
     // Fetch instruction 
-    if (!ReadMem(registers[PCReg], 4, &raw))
+    fetching = TRUE;		// (for the memory observers)
+    if (!ReadMem(registers[PCReg], 4, &raw)) {
+	fetching = FALSE;
 	return;			// exception occurred
+    }
+    fetching = FALSE;
     instr->value = raw;
     instr->Decode();
 
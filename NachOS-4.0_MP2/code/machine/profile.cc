@@ -0,0 +1,356 @@
+// profile.cc
+//	Routines to count the instructions user programs run, and to
+//	report where the time went, using the symbols from coff2noff -s.
+//
+// Copyright (c) 1992-1996 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "profile.h"
+#include "debug.h"
+#include <fstream>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const int MaxReported = 20;	// lines in each part of the report
+
+//----------------------------------------------------------------------
+// Grow
+// 	Make room for one more entry at the end of "*table", which has
+//	"n" entries in "*size" slots, by doubling it if it is full.
+//----------------------------------------------------------------------
+
+static void
+Grow(ProfSymbol **table, int n, int *size)
+{
+    if (n < *size)
+	return;
+    *size = (*size == 0) ? 64 : *size * 2;
+    ProfSymbol *bigger = new ProfSymbol[*size];
+    for (int i = 0; i < n; i++)
+	bigger[i] = (*table)[i];
+    delete [] *table;
+    *table = bigger;
+}
+
+//----------------------------------------------------------------------
+// ByAddress, ByCount, BySource
+// 	Orders for qsort: by address; by count, the largest first; and
+//	by source file and line.
+//----------------------------------------------------------------------
+
+static int
+ByAddress(const void *a, const void *b)
+{
+    return ((ProfSymbol *) a)->address - ((ProfSymbol *) b)->address;
+}
+
+static int
+ByCount(const void *a, const void *b)
+{
+    unsigned int x = ((ProfSymbol *) a)->count, y = ((ProfSymbol *) b)->count;
+
+    return (x < y) ? 1 : (x > y) ? -1 : ByAddress(a, b);
+}
+
+static int
+BySource(const void *a, const void *b)
+{
+    int c = strcmp(((ProfSymbol *) a)->name, ((ProfSymbol *) b)->name);
+
+    return (c != 0) ? c : ((ProfSymbol *) a)->line - ((ProfSymbol *) b)->line;
+}
+
+//----------------------------------------------------------------------
+// Profiler::Profiler
+// 	Read the procedures and source lines from a symbol file written
+//	by coff2noff -s, and start with no samples.  A symbol file that
+//	can't be read just leaves the report without names.
+//
+//	"symbolFile" is the UNIX file to read
+//	"interval" is the number of instructions per sample
+//----------------------------------------------------------------------
+
+Profiler::Profiler(char *symbolFile, int interval)
+{
+    ifstream in(symbolFile);
+    char buf[300], kind[10], name[256];
+    int address, line, procSize = 0, lineSize = 0;
+    ProfSymbol *s;
+
+    ASSERT(interval > 0);
+    this->interval = interval;
+    countdown = interval;
+    lastPC = -1;
+    numWords = 1024;
+    counts = new unsigned int[numWords];
+    entries = new unsigned int[numWords];
+    bzero(counts, numWords * sizeof(unsigned int));
+    bzero(entries, numWords * sizeof(unsigned int));
+    total = outside = 0;
+    procs = lines = NULL;
+    numProcs = numLines = 0;
+
+    if (!in)
+	cerr << "Can't open symbol file " << symbolFile << "\n";
+    while (in.getline(buf, sizeof(buf))) {
+	line = 0;
+	if (sscanf(buf, "%9s %x %255s %d", kind, &address, name, &line) < 3)
+	    continue;
+	if (strcmp(kind, "proc") == 0) {
+	    Grow(&procs, numProcs, &procSize);
+	    s = &procs[numProcs++];
+	} else if (strcmp(kind, "line") == 0) {
+	    Grow(&lines, numLines, &lineSize);
+	    s = &lines[numLines++];
+	} else {
+	    continue;
+	}
+	s->address = address;
+	s->name = new char[strlen(name) + 1];
+	strcpy(s->name, name);
+	s->line = line;
+	s->count = 0;
+    }
+    qsort(procs, numProcs, sizeof(ProfSymbol), ByAddress);
+    qsort(lines, numLines, sizeof(ProfSymbol), ByAddress);
+}
+
+//----------------------------------------------------------------------
+// Profiler::~Profiler
+// 	De-allocate the samples and symbols.
+//----------------------------------------------------------------------
+
+Profiler::~Profiler()
+{
+    for (int i = 0; i < numProcs; i++)
+	delete [] procs[i].name;
+    for (int i = 0; i < numLines; i++)
+	delete [] lines[i].name;
+    delete [] procs;
+    delete [] lines;
+    delete [] counts;
+    delete [] entries;
+}
+
+//----------------------------------------------------------------------
+// Profiler::Count
+// 	Count a sample of the instruction at "pc", growing the counters
+//	if it is past the end of them.  When every instruction is
+//	sampled, also count arriving at "pc" by a jump or branch.
+//----------------------------------------------------------------------
+
+void
+Profiler::Count(int pc)
+{
+    int word = pc / 4;
+
+    total++;
+    if (pc < 0) {
+	outside++;
+	return;
+    }
+    if (word >= numWords) {
+	int size = numWords;
+
+	while (word >= size)
+	    size *= 2;
+	unsigned int *c = new unsigned int[size], *e = new unsigned int[size];
+	bzero(c, size * sizeof(unsigned int));
+	bzero(e, size * sizeof(unsigned int));
+	bcopy(counts, c, numWords * sizeof(unsigned int));
+	bcopy(entries, e, numWords * sizeof(unsigned int));
+	delete [] counts;
+	delete [] entries;
+	counts = c;
+	entries = e;
+	numWords = size;
+    }
+    counts[word]++;
+    if (interval == 1 && pc != lastPC + 4)
+	entries[word]++;
+}
+
+//----------------------------------------------------------------------
+// Profiler::Find
+// 	Return the index of the last entry in "table", of "n" sorted by
+//	address, that starts at or before "address"; or -1 if none does.
+//----------------------------------------------------------------------
+
+int
+Profiler::Find(ProfSymbol *table, int n, int address)
+{
+    int low = 0, high = n - 1, mid, found = -1;
+
+    while (low <= high) {
+	mid = (low + high) / 2;
+	if (table[mid].address <= address) {
+	    found = mid;
+	    low = mid + 1;
+	} else {
+	    high = mid - 1;
+	}
+    }
+    return found;
+}
+
+//----------------------------------------------------------------------
+// Profiler::Print
+// 	Print the report: the samples in each procedure, the basic blocks
+//	with the most samples, and the source lines with the most.
+//----------------------------------------------------------------------
+
+void
+Profiler::Print()
+{
+    cout << "\nProfile: " << total << " samples, one every " << interval
+	 << " user instructions\n";
+    if (total == 0)
+	return;
+    PrintProcs();
+    PrintBlocks();
+    PrintLines();
+}
+
+//----------------------------------------------------------------------
+// Profiler::PrintProcs
+// 	Print the procedures that have samples, the most first, as in
+//	gprof's flat profile.
+//----------------------------------------------------------------------
+
+void
+Profiler::PrintProcs()
+{
+    ProfSymbol *sorted = new ProfSymbol[numProcs];
+    unsigned int unknown = outside;
+    int p;
+    char buf[100];
+
+    for (p = 0; p < numProcs; p++)
+	procs[p].count = 0;
+    for (int w = 0; w < numWords; w++) {
+	if (counts[w] == 0)
+	    continue;
+	p = Find(procs, numProcs, w * 4);
+	if (p == -1)
+	    unknown += counts[w];
+	else
+	    procs[p].count += counts[w];
+    }
+    for (p = 0; p < numProcs; p++)
+	sorted[p] = procs[p];
+    qsort(sorted, numProcs, sizeof(ProfSymbol), ByCount);
+
+    cout << "\n  %time     samples  procedure\n";
+    for (p = 0; p < numProcs && sorted[p].count > 0; p++) {
+	sprintf(buf, "%7.2f  %10u  ", 100.0 * sorted[p].count / total,
+		sorted[p].count);
+	cout << buf << sorted[p].name << "\n";
+    }
+    if (unknown > 0) {
+	sprintf(buf, "%7.2f  %10u  ", 100.0 * unknown / total, unknown);
+	cout << buf << "(no symbol)\n";
+    }
+    delete [] sorted;
+}
+
+//----------------------------------------------------------------------
+// Profiler::PrintBlocks
+// 	Print the basic blocks with the most samples.  A block starts
+//	at each procedure, and at each address jumped or branched to; so
+//	they are only known when every instruction is sampled.
+//----------------------------------------------------------------------
+
+void
+Profiler::PrintBlocks()
+{
+    ProfSymbol *blocks;
+    int numBlocks = 0, size = 0, p;
+    char buf[100];
+
+    if (interval != 1) {
+	cout << "\nBasic blocks: need every instruction sampled\n";
+	return;
+    }
+    blocks = NULL;
+    for (int w = 0; w < numWords; w++) {
+	p = Find(procs, numProcs, w * 4);
+	if (numBlocks == 0 || entries[w] > 0
+			|| (p != -1 && procs[p].address == w * 4)) {
+	    if (numBlocks > 0 && blocks[numBlocks - 1].count == 0)
+		numBlocks--;		// never run; reuse it
+	    Grow(&blocks, numBlocks, &size);
+	    blocks[numBlocks].address = w * 4;
+	    blocks[numBlocks].name = (p == -1) ? (char *) "?" : procs[p].name;
+	    blocks[numBlocks].line = (p == -1) ? w * 4 : w * 4 - procs[p].address;
+	    blocks[numBlocks].count = 0;
+	    numBlocks++;
+	}
+	blocks[numBlocks - 1].count += counts[w];
+    }
+    qsort(blocks, numBlocks, sizeof(ProfSymbol), ByCount);
+
+    cout << "\n   address     entries     samples  procedure+offset\n";
+    for (int b = 0; b < numBlocks && b < MaxReported && blocks[b].count > 0;
+									b++) {
+	sprintf(buf, "%10x  %10u  %10u  ", blocks[b].address,
+		entries[blocks[b].address / 4], blocks[b].count);
+	cout << buf << blocks[b].name << "+" << blocks[b].line << "\n";
+    }
+    delete [] blocks;
+}
+
+//----------------------------------------------------------------------
+// Profiler::PrintLines
+// 	Print the source lines with the most samples (that is, user
+//	instructions, or cycles, spent on them).  Instructions of a
+//	procedure compiled without -g have no line.
+//----------------------------------------------------------------------
+
+void
+Profiler::PrintLines()
+{
+    ProfSymbol *merged;
+    int n = 0, l, p;
+    char buf[100];
+
+    if (numLines == 0) {
+	cout << "\nSource lines: none in the symbol file (compile with -g)\n";
+	return;
+    }
+    for (l = 0; l < numLines; l++)
+	lines[l].count = 0;
+    for (int w = 0; w < numWords; w++) {
+	if (counts[w] == 0)
+	    continue;
+	l = Find(lines, numLines, w * 4);
+	p = Find(procs, numProcs, w * 4);
+	if (l != -1 && (p == -1 || lines[l].address >= procs[p].address))
+	    lines[l].count += counts[w];	// (else from an earlier
+    }						// procedure)
+
+    // a line may have several runs of instructions: add them up
+    merged = new ProfSymbol[numLines];
+    for (l = 0; l < numLines; l++)
+	merged[l] = lines[l];
+    qsort(merged, numLines, sizeof(ProfSymbol), BySource);
+    for (l = 0; l < numLines; l++) {
+	if (n > 0 && BySource(&merged[n - 1], &merged[l]) == 0)
+	    merged[n - 1].count += merged[l].count;
+	else
+	    merged[n++] = merged[l];
+    }
+    qsort(merged, n, sizeof(ProfSymbol), ByCount);
+
+    cout << "\n  %time     samples  source line\n";
+    for (l = 0; l < n && l < MaxReported && merged[l].count > 0; l++) {
+	sprintf(buf, "%7.2f  %10u  ", 100.0 * merged[l].count / total,
+		merged[l].count);
+	cout << buf << merged[l].name << ":" << merged[l].line << "\n";
+    }
+    if (n == 0 || merged[0].count == 0)
+	cout << "  (none of the samples; compile with -g)\n";
+    delete [] merged;
+}
@@ -0,0 +1,82 @@
+// profile.h
+//	Data structures for profiling user programs: counting which
+//	instructions the simulated machine spends its time on, and
+//	reporting it by procedure, basic block and source line.
+//
+//	The machine calls Sample before each user instruction.  Every
+//	"interval"th call is counted against the instruction's address;
+//	with an interval of 1 every instruction is counted exactly, and
+//	the start of each basic block is seen (it is an address reached
+//	other than from the instruction before).
+//
+//	Addresses are turned into names with the symbol file written by
+//	"coff2noff -s" (see coff2noff.c).  The counts are of all user
+//	code run, so they make sense against one program's symbols when
+//	only that program (or copies of it) is running.
+//
+// Copyright (c) 1992-1996 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include "copyright.h"
+#include "utility.h"
+
+// A procedure, or the source line of a run of instructions, from the
+// symbol file
+
+class ProfSymbol {
+  public:
+    int address;		// where it starts
+    char *name;			// procedure name, or source file
+    int line;			// source line, or 0 for a procedure
+    int count;			// samples in it, when reporting
+};
+
+// The following class defines the profiler.
+
+class Profiler {
+  public:
+    Profiler(char *symbolFile, int interval);
+				// Read symbolFile; sample every
+				// "interval" instructions
+    ~Profiler();
+
+    void Sample(int pc) {	// About to run the instruction at "pc"
+	if (interval == 1 || --countdown == 0) {
+	    countdown = interval;
+	    Count(pc);
+	}
+	lastPC = pc;
+    }
+    void Print();		// Print the report
+
+  private:
+    void Count(int pc);		// Count a sample at "pc"
+    int Find(ProfSymbol *table, int n, int address);
+				// the last entry of "table" at or before
+				// "address", or -1
+    void PrintProcs();		// the three parts of the report
+    void PrintBlocks();
+    void PrintLines();
+
+    int interval;		// instructions per sample
+    int countdown;		// instructions to the next sample
+    int lastPC;			// address of the last instruction run
+
+    unsigned int *counts;	// samples at each word address
+    unsigned int *entries;	// times each address was reached other
+				// than from the one before it
+    int numWords;		// size of counts and entries (they grow)
+    unsigned int total;		// samples counted
+    unsigned int outside;	// of those, at negative addresses
+
+    ProfSymbol *procs;		// procedures, by address
+    int numProcs;
+    ProfSymbol *lines;		// source lines, by address
+    int numLines;
+};
+
+#endif // PROFILE_H
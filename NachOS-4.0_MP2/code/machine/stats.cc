@@ -10,6 +10,7 @@
 #include "copyright.h"
 #include "debug.h"
 #include "stats.h"
+#include "main.h"
 
 //----------------------------------------------------------------------
 // Statistics::Statistics
@@ -21,7 +22,12 @@ Statistics::Statistics()
     totalTicks = idleTicks = systemTicks = userTicks = 0;
     numDiskReads = numDiskWrites = 0;
     numConsoleCharsRead = numConsoleCharsWritten = 0;
-    numPageFaults = numPacketsSent = numPacketsRecvd = 0;
+    numPageFaults = numTLBMisses = numPacketsSent = numPacketsRecvd = 0;
+    numTLBLookups = 0;
+    numPrefetched = numPagesCleaned = 0;
+    numZeroMapped = numZeroFilled = numPreZeroed = 0;
+    numFramesInUse = peakFramesInUse = 0;
+    numEvictions = numLocalEvictions = numDelayedLaunches = 0;
 }
 
 //----------------------------------------------------------------------
@@ -39,7 +45,30 @@ Statistics::Print()
 		cout << ", writes " << numDiskWrites << "\n";
 		cout << "Console I/O: reads " << numConsoleCharsRead;
     cout << ", writes " << numConsoleCharsWritten << "\n";
-    cout << "Paging: faults " << numPageFaults << "\n";
+    if (kernel->machine->tlb != NULL) {
+	cout << "TLB: entries " << TLBSize << ", lookups " << numTLBLookups
+	     << ", misses " << numTLBMisses;
+	if (numTLBLookups > 0)
+	    cout << ", hit rate " << 100.0 * (numTLBLookups - numTLBMisses)
+					/ numTLBLookups << "%";
+	cout << "\n";
+    }
+    cout << "Paging: faults " << numPageFaults;
+    if (numPrefetched > 0)
+	cout << ", pages read ahead " << numPrefetched;
+    if (numPagesCleaned > 0)
+	cout << ", pages cleaned " << numPagesCleaned;
+    if (numZeroMapped > 0)
+	cout << ", zero pages mapped " << numZeroMapped << ", written "
+	     << numZeroFilled << " (" << numPreZeroed << " zeroed ahead)";
+    cout << "\n";
+    cout << "Memory: frames " << NumPhysPages << ", in use " << numFramesInUse
+	 << ", peak " << peakFramesInUse << ", evictions " << numEvictions
+	 << " (" << numLocalEvictions << " at a resident limit)";
+    if (numDelayedLaunches > 0)
+	cout << ", launches delayed " << numDelayedLaunches;
+    cout << "\n";
     cout << "Network I/O: packets received " << numPacketsRecvd;
 		cout << ", sent " << numPacketsSent << "\n";
+    kernel->machine->PrintObservers();
 }
@@ -33,6 +33,24 @@ class Statistics {
     int numConsoleCharsRead;	// number of characters read from the keyboard
     int numConsoleCharsWritten; // number of characters written to the display
     int numPageFaults;		// number of virtual memory page faults
+    int numTLBLookups;		// translations looked up in the TLB
+    int numTLBMisses;		// number of those that were TLB misses
+    int numPrefetched;		// pages read in with a faulting one
+    int numPagesCleaned;	// dirty pages written out by the page
+				// cleaner
+    int numZeroMapped;		// faults on untouched pages, mapped to
+				// the frame of zeroes
+    int numZeroFilled;		// those given a frame of their own when
+				// written
+    int numPreZeroed;		// frames of zeroes that were zeroed
+				// ahead of time
+    int numFramesInUse;		// physical frames allocated now
+    int peakFramesInUse;	// the most ever allocated at once
+    int numEvictions;		// pages evicted to free a frame
+    int numLocalEvictions;	// those evicted because their owner was
+				// at its resident set limit
+    int numDelayedLaunches;	// programs that had to wait for swap
+				// before they could be loaded
     int numPacketsSent;		// number of packets sent over the network
     int numPacketsRecvd;	// number of packets received over the network
 
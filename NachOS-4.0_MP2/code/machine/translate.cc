@@ -31,6 +31,8 @@
 
 #include "copyright.h"
 #include "main.h"
+#include "pagetable.h"
+#include "memsim.h"
 
 // Routines for converting Words and Short Words to and from the
 // simulated machine's format of little endian.  These end up
@@ -86,6 +88,8 @@ bool
 Machine::ReadMem(int addr, int size, int *value)
 {
     int data;
+    unsigned short half;
+    unsigned int word;
     ExceptionType exception;
     int physicalAddress;
     
@@ -96,20 +100,25 @@ Machine::ReadMem(int addr, int size, int *value)
 	RaiseException(exception, addr);
 	return FALSE;
     }
+    for (int i = 0; i < numObservers; i++)
+	observers[i]->Access(addr, physicalAddress, size,
+			     fetching ? FetchAccess : ReadAccess);
     switch (size) {
       case 1:
 	data = mainMemory[physicalAddress];
 	*value = data;
 	break;
 	
-      case 2:
-	data = *(unsigned short *) &mainMemory[physicalAddress];
-	*value = ShortToHost(data);
+      case 2:			// memory is chars: copy them out, as
+				// reading them through a short pointer
+				// breaks the aliasing rules -O relies on
+	memcpy(&half, &mainMemory[physicalAddress], sizeof(half));
+	*value = ShortToHost(half);
 	break;
 	
       case 4:
-	data = *(unsigned int *) &mainMemory[physicalAddress];
-	*value = WordToHost(data);
+	memcpy(&word, &mainMemory[physicalAddress], sizeof(word));
+	*value = WordToHost(word);
 	break;
 
       default: ASSERT(FALSE);
@@ -137,6 +146,8 @@ Machine::WriteMem(int addr, int size, int value)
 {
     ExceptionType exception;
     int physicalAddress;
+    unsigned short half;
+    unsigned int word;
      
     DEBUG(dbgAddr, "Writing VA " << addr << ", size " << size << ", value " << value);
 
@@ -145,19 +156,21 @@ Machine::WriteMem(int addr, int size, int value)
 	RaiseException(exception, addr);
 	return FALSE;
     }
+    for (int i = 0; i < numObservers; i++)
+	observers[i]->Access(addr, physicalAddress, size, WriteAccess);
     switch (size) {
       case 1:
 	mainMemory[physicalAddress] = (unsigned char) (value & 0xff);
 	break;
 
-      case 2:
-	*(unsigned short *) &mainMemory[physicalAddress]
-		= ShortToMachine((unsigned short) (value & 0xffff));
+      case 2:			// copied, as in ReadMem
+	half = ShortToMachine((unsigned short) (value & 0xffff));
+	memcpy(&mainMemory[physicalAddress], &half, sizeof(half));
 	break;
       
       case 4:
-	*(unsigned int *) &mainMemory[physicalAddress]
-		= WordToMachine((unsigned int) value);
+	word = WordToMachine((unsigned int) value);
+	memcpy(&mainMemory[physicalAddress], &word, sizeof(word));
 	break;
 	
       default: ASSERT(FALSE);
@@ -197,15 +210,25 @@ Machine::Translate(int virtAddr, int* physAddr, int size, bool writing)
 	return AddressErrorException;
     }
     // we must have either a TLB or a page table, but not both!
-    ASSERT(tlb == NULL || pageTable == NULL);	
-    ASSERT(tlb != NULL || pageTable != NULL);	
+    ASSERT(tlb == NULL || (pageTable == NULL && pageMap == NULL));
+    ASSERT(tlb != NULL || pageTable != NULL || pageMap != NULL);
 
 // calculate the virtual page number, and offset within the page,
 // from the virtual address
     vpn = (unsigned) virtAddr / PageSize;
     offset = (unsigned) virtAddr % PageSize;
     
-    if (tlb == NULL) {		// => page table => vpn is index into table
+    if (tlb == NULL && pageTable == NULL) {	// => ask the page table
+	if (vpn >= (unsigned) pageMap->NumPages()) {
+	    DEBUG(dbgAddr, "Illegal virtual page # " << virtAddr);
+	    return AddressErrorException;
+	}
+	entry = pageMap->Lookup(vpn);
+	if (entry == NULL) {
+	    DEBUG(dbgAddr, "Invalid virtual page # " << virtAddr);
+	    return PageFaultException;
+	}
+    } else if (tlb == NULL) {	// => page table => vpn is index into table
 	if (vpn >= pageTableSize) {
 	    DEBUG(dbgAddr, "Illegal virtual page # " << virtAddr);
 	    return AddressErrorException;
@@ -215,13 +238,16 @@ Machine::Translate(int virtAddr, int* physAddr, int size, bool writing)
 	}
 	entry = &pageTable[vpn];
     } else {
+	kernel->stats->numTLBLookups++;
         for (entry = NULL, i = 0; i < TLBSize; i++)
-    	    if (tlb[i].valid && (tlb[i].virtualPage == ((int)vpn))) {
+    	    if (tlb[i].valid && (tlb[i].virtualPage == ((int)vpn))
+			&& tlb[i].asid == asid) {
 		entry = &tlb[i];			// FOUND!
 		break;
 	    }
 	if (entry == NULL) {				// not found
     	    DEBUG(dbgAddr, "Invalid TLB entry for this virtual page!");
+	    kernel->stats->numTLBMisses++;
     	    return PageFaultException;		// really, this is a TLB fault,
 						// the page may be in memory,
 						// but not in the TLB
@@ -40,6 +40,8 @@ class TranslationEntry {
 			// page is referenced or modified.
     bool dirty;         // This bit is set by the hardware every time the
 			// page is modified.
+    int asid;		// In a TLB entry, the address space it belongs to;
+			// it only matches when Machine::asid is the same.
 };
 
 #endif
@@ -18,6 +18,7 @@
 
 #include "copyright.h"
 #include "post.h"
+#include "memops.h"
 
 //----------------------------------------------------------------------
 // Mail::Mail
@@ -35,7 +36,7 @@ Mail::Mail(PacketHeader pktH, MailHeader mailH, char *msgData)
 
     pktHdr = pktH;
     mailHdr = mailH;
-    bcopy(msgData, data, mailHdr.length);
+    MemCopy(data, msgData, mailHdr.length);
 }
 
 //----------------------------------------------------------------------
@@ -129,7 +130,7 @@ MailBox::Get(PacketHeader *pktHdr, MailHeader *mailHdr, char *data)
 	cout << "Got mail from mailbox: ";
 	PrintHeader(*pktHdr, *mailHdr);
     }
-    bcopy(mail->data, data, mail->mailHdr.length);
+    MemCopy(data, mail->data, mail->mailHdr.length);
 					// copy the message data into
 					// the caller's buffer
     delete mail;			// we've copied out the stuff we
@@ -314,8 +315,8 @@ PostOfficeOutput::Send(PacketHeader pktHdr, MailHeader mailHdr, char* data)
     pktHdr.length = mailHdr.length + sizeof(MailHeader);
 
     // concatenate MailHeader and data
-    bcopy((char *)&mailHdr, buffer, sizeof(MailHeader));
-    bcopy(data, buffer + sizeof(MailHeader), mailHdr.length);
+    MemCopy(buffer, (char *)&mailHdr, sizeof(MailHeader));
+    MemCopy(buffer + sizeof(MailHeader), data, mailHdr.length);
 
     sendLock->Acquire();   		// only one message can be sent
 					// to the network at any one time
@@ -0,0 +1,8 @@
+#include "syscall.h"
+
+/* Run by exec_test1: exit with a status it can check. */
+
+int main(void)
+{
+	Exit(7);
+}
@@ -0,0 +1,27 @@
+#include "syscall.h"
+
+/* Start exec_child several times, one after another and then all at
+ * once, checking the status each Join returns.
+ */
+
+int main(void)
+{
+	SpaceId id[3];
+	int i;
+
+	for (i = 0; i < 3; i++) {
+		id[0] = Exec("../test/exec_child");
+		if (id[0] < 0) MSG("Failed on Exec");
+		if (Join(id[0]) != 7) MSG("Wrong exit status");
+		if (Join(id[0]) != -1) MSG("Joined the same program twice");
+	}
+	for (i = 0; i < 3; i++) {
+		id[i] = Exec("../test/exec_child");
+		if (id[i] < 0) MSG("Failed on Exec");
+	}
+	for (i = 0; i < 3; i++)
+		if (Join(id[i]) != 7) MSG("Wrong exit status");
+	if (Exec("../test/no_such_program") != -1) MSG("Ran a missing program");
+	PrintInt(id[2]);
+	Halt();
+}
@@ -0,0 +1,33 @@
+#include "syscall.h"
+
+int main(void)
+{
+	int id, i, fid;
+	char *a, *b, *m;
+
+	id = ShmCreate(256);
+	if (id < 0) MSG("Failed on creating segment");
+	a = ShmAttach(id);
+	b = ShmAttach(id);
+	if (a == (char *) -1 || b == (char *) -1 || a == b)
+		MSG("Failed on attaching segment");
+	for (i = 0; i < 256; i++)
+		a[i] = i;
+	for (i = 0; i < 256; i++)
+		if (b[i] != (char) i) MSG("Shared pages differ");
+	PrintInt(b[255]);
+
+	if (Create("shm.test") != 1) MSG("Failed on creating file");
+	fid = Open("shm.test");
+	if (fid <= 0) MSG("Failed on opening file");
+	if (Write("abcdefghij", 10, fid) != 10) MSG("Failed on writing file");
+	m = Mmap(fid, 0, 10);
+	if (m == (char *) -1) MSG("Failed on mapping file");
+	PrintInt(m[9]);
+	for (i = 0; i < 10; i++)
+		m[i] = m[i] - 'a' + 'A';	/* written back by Munmap */
+	if (Munmap(m) != 1) MSG("Failed on unmapping file");
+	if (Munmap(b) != 1 || Munmap(a) != 1) MSG("Failed on detaching");
+	Close(fid);
+	Halt();
+}
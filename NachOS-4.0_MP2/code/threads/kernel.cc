@@ -17,6 +17,8 @@
 #include "synchdisk.h"
 #include "post.h"
 #include "synchconsole.h"
+#include "profile.h"
+#include "memsim.h"
 
 //----------------------------------------------------------------------
 // Kernel::Kernel
@@ -28,6 +30,18 @@ Kernel::Kernel(int argc, char **argv)
 {
     randomSlice = FALSE; 
     debugUserProg = FALSE;
+    profileSymbols = NULL;
+    profileInterval = 1;
+    l1Size = l2Size = 0;		// no caches simulated
+    tlbSim = pageHeat = FALSE;
+    memTraceFile = NULL;
+    replacePolicy = ClockReplace;	// default page replacement
+    clusterPages = DefaultClusterPages;
+    residentLimit = 0;			// no limit
+    pageTableKind = LinearPageTable;
+    int pageSize = DefaultPageSize;
+    int numPhysPages = DefaultNumPhysPages;
+    memoryManager = NULL;	// until Initialize
     consoleIn = NULL;          // default is stdin
     consoleOut = NULL;         // default is stdout
 #ifndef FILESYS_STUB
@@ -36,6 +50,10 @@ Kernel::Kernel(int argc, char **argv)
     reliability = 1;            // network reliability, default is 1.0
     hostName = 0;               // machine id, also UNIX socket name
                                 // 0 is the default machine id
+    execfile = new char *[argc];	// more than there can be -e flags
+    execfileNum = 0;
+    threadNum = 0;
+    processes = new HandleTable<Process>;
     for (int i = 1; i < argc; i++) {
         if (strcmp(argv[i], "-rs") == 0) {
  	    	ASSERT(i + 1 < argc);
@@ -45,6 +63,71 @@ Kernel::Kernel(int argc, char **argv)
 	    	i++;
         } else if (strcmp(argv[i], "-s") == 0) {
             debugUserProg = TRUE;
+		} else if (strcmp(argv[i], "-prof") == 0) {
+	    	ASSERT(i + 1 < argc);	// next argument is a symbol file
+	    	profileSymbols = argv[i + 1];
+	    	i++;
+		} else if (strcmp(argv[i], "-profint") == 0) {
+	    	ASSERT(i + 1 < argc);	// next argument is # instructions
+	    	profileInterval = atoi(argv[i + 1]);
+	    	ASSERT(profileInterval > 0);
+	    	i++;
+		} else if (strcmp(argv[i], "-l1") == 0) {
+	    	ASSERT(i + 3 < argc);	// next: bytes, ways, bytes per line
+	    	l1Size = atoi(argv[i + 1]);
+	    	l1Ways = atoi(argv[i + 2]);
+	    	l1Line = atoi(argv[i + 3]);
+	    	i += 3;
+		} else if (strcmp(argv[i], "-l2") == 0) {
+	    	ASSERT(i + 3 < argc);	// next: bytes, ways, bytes per line
+	    	l2Size = atoi(argv[i + 1]);
+	    	l2Ways = atoi(argv[i + 2]);
+	    	l2Line = atoi(argv[i + 3]);
+	    	i += 3;
+		} else if (strcmp(argv[i], "-tlbsim") == 0) {
+	    	tlbSim = TRUE;
+		} else if (strcmp(argv[i], "-heat") == 0) {
+	    	pageHeat = TRUE;
+		} else if (strcmp(argv[i], "-memtrace") == 0) {
+	    	ASSERT(i + 1 < argc);	// next argument is a UNIX file
+	    	memTraceFile = argv[i + 1];
+	    	i++;
+		} else if (strcmp(argv[i], "-rss") == 0) {
+	    	ASSERT(i + 1 < argc);	// next argument is a number of pages
+	    	residentLimit = atoi(argv[i + 1]);
+	    	i++;
+		} else if (strcmp(argv[i], "-cluster") == 0) {
+	    	ASSERT(i + 1 < argc);	// next argument is a number of pages
+	    	clusterPages = atoi(argv[i + 1]);
+	    	i++;
+		} else if (strcmp(argv[i], "-rp") == 0) {
+	    	ASSERT(i + 1 < argc);	// next argument is a policy name
+	    	if (strcmp(argv[i + 1], "fifo") == 0) {
+				replacePolicy = FIFOReplace;
+	    	} else if (strcmp(argv[i + 1], "clock") == 0) {
+				replacePolicy = ClockReplace;
+	    	} else if (strcmp(argv[i + 1], "lru") == 0) {
+				replacePolicy = LRUReplace;
+	    	} else if (strcmp(argv[i + 1], "wsclock") == 0) {
+				replacePolicy = WSClockReplace;
+	    	} else {
+				cout << "Unknown replacement policy " << argv[i + 1] << "\n";
+				ASSERTNOTREACHED();
+	    	}
+	    	i++;
+		} else if (strcmp(argv[i], "-pt") == 0) {
+	    	ASSERT(i + 1 < argc);	// next argument is a kind of table
+	    	if (strcmp(argv[i + 1], "linear") == 0) {
+				pageTableKind = LinearPageTable;
+	    	} else if (strcmp(argv[i + 1], "twolevel") == 0) {
+				pageTableKind = TwoLevelPageTable;
+	    	} else if (strcmp(argv[i + 1], "inverted") == 0) {
+				pageTableKind = InvertedPageTable;
+	    	} else {
+				cout << "Unknown page table " << argv[i + 1] << "\n";
+				ASSERTNOTREACHED();
+	    	}
+	    	i++;
 		} else if (strcmp(argv[i], "-e") == 0) {
         	execfile[++execfileNum]= argv[++i];
 			cout << execfile[execfileNum] << "\n";
@@ -60,6 +143,19 @@ Kernel::Kernel(int argc, char **argv)
 		} else if (strcmp(argv[i], "-f") == 0) {
 	    	formatFlag = TRUE;
 #endif
+		} else if (strcmp(argv[i], "-pagesize") == 0) {
+	    	ASSERT(i + 1 < argc);	// next argument is bytes per page
+	    	pageSize = atoi(argv[i + 1]);
+	    	i++;
+		} else if (strcmp(argv[i], "-mem") == 0) {
+	    	ASSERT(i + 1 < argc);	// next argument is number of pages
+	    	numPhysPages = atoi(argv[i + 1]);
+	    	i++;
+		} else if (strcmp(argv[i], "-tlb") == 0) {
+	    	ASSERT(i + 1 < argc);	// next argument is number of entries
+	    	TLBSize = atoi(argv[i + 1]);
+	    	ASSERT(TLBSize >= 0);
+	    	i++;
         } else if (strcmp(argv[i], "-n") == 0) {
             ASSERT(i + 1 < argc);   // next argument is float
             reliability = atof(argv[i + 1]);
@@ -71,6 +167,13 @@ Kernel::Kernel(int argc, char **argv)
         } else if (strcmp(argv[i], "-u") == 0) {
             cout << "Partial usage: nachos [-rs randomSeed]\n";
 	   		cout << "Partial usage: nachos [-s]\n";
+	   		cout << "Partial usage: nachos [-prof symbolFile] [-profint #]\n";
+	   		cout << "Partial usage: nachos [-l1 bytes ways lineBytes] [-l2 bytes ways lineBytes]\n";
+	   		cout << "Partial usage: nachos [-tlbsim] [-heat] [-memtrace traceFile]\n";
+	   		cout << "Partial usage: nachos [-rp fifo|clock|lru|wsclock] [-cluster pages]\n";
+	   		cout << "Partial usage: nachos [-pt linear|twolevel|inverted]\n";
+	   		cout << "Partial usage: nachos [-pagesize bytes] [-mem pages] [-rss pages]\n";
+	   		cout << "Partial usage: nachos [-tlb entries]\n";
             cout << "Partial usage: nachos [-ci consoleIn] [-co consoleOut]\n";
 #ifndef FILESYS_STUB
 	    	cout << "Partial usage: nachos [-nf]\n";
@@ -78,6 +181,13 @@ Kernel::Kernel(int argc, char **argv)
             cout << "Partial usage: nachos [-n #] [-m #]\n";
 		}
     }
+
+    // pages are swapped a whole number of sectors at a time
+    if (pageSize < SectorSize || pageSize % SectorSize != 0) {
+	cout << "Page size must be a multiple of " << SectorSize << "\n";
+	Exit(1);
+    }
+    SetMemorySize(pageSize, numPhysPages);
 }
 
 //----------------------------------------------------------------------
@@ -103,9 +213,23 @@ Kernel::Initialize()
     scheduler = new Scheduler();	// initialize the ready queue
     alarm = new Alarm(randomSlice);	// start up time slicing
     machine = new Machine(debugUserProg);
+    if (profileSymbols != NULL)
+	machine->profiler = new Profiler(profileSymbols, profileInterval);
+    ASSERT(l1Size > 0 || l2Size == 0);	// an L2 needs an L1
+    if (l1Size > 0)
+	machine->AddObserver(new CacheSim(l1Size, l1Ways, l1Line,
+					  l2Size, l2Ways, l2Line));
+    if (tlbSim)
+	machine->AddObserver(new TLBSim());
+    if (pageHeat)
+	machine->AddObserver(new PageHeat());
+    if (memTraceFile != NULL)
+	machine->AddObserver(new MemTrace(memTraceFile));
     synchConsoleIn = new SynchConsoleInput(consoleIn); // input from stdin
     synchConsoleOut = new SynchConsoleOutput(consoleOut); // output to stdout
     synchDisk = new SynchDisk();    //
+    memoryManager = new MemoryManager(replacePolicy, clusterPages,
+					residentLimit);	// uses synchDisk
 #ifdef FILESYS_STUB
     fileSystem = new FileSystem();
 #else
@@ -124,6 +248,12 @@ Kernel::Initialize()
 
 Kernel::~Kernel()
 {
+    delete processes;
+    delete [] execfile;
+    if (machine->profiler != NULL) {
+	machine->profiler->Print();
+	delete machine->profiler;
+    }
     delete stats;
     delete interrupt;
     delete scheduler;
@@ -131,6 +261,7 @@ Kernel::~Kernel()
     delete machine;
     delete synchConsoleIn;
     delete synchConsoleOut;
+    delete memoryManager;
     delete synchDisk;
     delete fileSystem;
     delete postOfficeIn;
@@ -273,33 +404,73 @@ Kernel::NetworkTest() {
     // Then we're done!
 }
 
+//----------------------------------------------------------------------
+// ForkExecute
+// 	Run a user program, in the thread made for it by Exec, which has
+//	already loaded it.
+//----------------------------------------------------------------------
+
 void ForkExecute(Thread *t)
 {
-	if ( !t->space->Load(t->getName()) ) {
-    	return;             // executable not found
-    }
     t->space->Execute(t->getName());
-
 }
 
+//----------------------------------------------------------------------
+// Kernel::ExecAll
+// 	Start every program given with -e.  No one joins them, so each
+//	one's SpaceId is given back as soon as it exits.
+//----------------------------------------------------------------------
+
 void Kernel::ExecAll()
 {
 	for (int i=1;i<=execfileNum;i++) {
 		int a = Exec(execfile[i]);
 	}
-	currentThread->Finish();
+	ExitProcess(0);			// lets go of them
     //Kernel::Exec();	
 }
 
+//----------------------------------------------------------------------
+// Kernel::Exec
+// 	Start running the program in "name", in a new thread, as a child
+//	of the current thread.  Returns its SpaceId, or -1 if it can't
+//	be loaded or too many programs are running.
+//
+//	The program is loaded here, so that the caller learns if that
+//	fails.  Loading only sets up the page table -- pages are read in
+//	as they are touched, shared ones are found in memory if anyone
+//	else is running the program, and its header comes parsed from
+//	its SharedImage if anyone ran it lately.
+//----------------------------------------------------------------------
 
 int Kernel::Exec(char* name)
 {
-	t[threadNum] = new Thread(name, threadNum);
-	t[threadNum]->space = new AddrSpace();
-	t[threadNum]->Fork((VoidFunctionPtr) &ForkExecute, (void *)t[threadNum]);
-	threadNum++;
-
-	return threadNum-1;
+	AddrSpace *space;
+	Process *p;
+	int id;
+
+	space = new AddrSpace();
+	if (!space->Load(name)) {
+		delete space;
+		return -1;
+	}
+	id = processes->Enter();
+	if (id == -1) {
+		cerr << "Too many programs running to start " << name << "\n";
+		delete space;
+		return -1;
+	}
+	p = processes->Lookup(id);
+	delete [] p->name;		// of the last program in this slot
+	p->name = new char[strlen(name) + 1];
+	strcpy(p->name, name);
+	p->exited = new Semaphore(p->name, 0);
+	p->status = -1;
+	p->parent = currentThread;
+	p->thread = new Thread(p->name, id);
+	p->thread->space = space;
+	p->thread->Fork((VoidFunctionPtr) &ForkExecute, (void *)p->thread);
+	return id;
 /*
     cout << "Total threads number is " << execfileNum << endl;
     for (int n=1;n<=execfileNum;n++) {
@@ -327,6 +498,71 @@ int Kernel::Exec(char* name)
 //  cout << "after ThreadedKernel:Run();" << endl;  // unreachable
 }
 
+//----------------------------------------------------------------------
+// Kernel::Join
+// 	Wait for the program "id", a child of the current thread, to
+//	exit, and return the status it passed to Exit (-1 if it was
+//	killed).  Its SpaceId is stale after.  Returns -1 if "id" is
+//	not a child of the current thread, or is stale already.
+//----------------------------------------------------------------------
+
+int Kernel::Join(int id)
+{
+	Process *p = processes->Lookup(id);
+	int status;
+
+	if (p == NULL || p->parent != currentThread)
+		return -1;
+	p->exited->P();
+	status = p->status;
+	delete p->exited;
+	processes->Remove(id);
+	return status;
+}
+
+//----------------------------------------------------------------------
+// Kernel::ExitProcess
+// 	End the current thread, and the program it runs, with "status",
+//	waking its parent if that is waiting in Join.  Children it will no
+//	longer Join are let go: their SpaceIds are given back when they
+//	exit, or now if they have.
+//
+//	Before the parent is woken, the program's files are closed and
+//	the frames and swap of its pages given back, both in one pass;
+//	the rest of its address space is deleted later, by the memory
+//	manager's reaper, so that Join returns just as soon however big
+//	the program was.
+//----------------------------------------------------------------------
+
+void Kernel::ExitProcess(int status)
+{
+	fileSystem->CloseAll(currentThread);
+	if (currentThread->space != NULL)
+		currentThread->space->Release();
+	for (int id = processes->Next(-1); id != -1;
+					id = processes->Next(id)) {
+		Process *p = processes->Lookup(id);
+
+		if (p->parent == currentThread) {
+			p->parent = NULL;	// an orphan now
+			if (p->thread == NULL) {	// and already exited
+				delete p->exited;
+				processes->Remove(id);
+			}
+		} else if (p->thread == currentThread) {
+			p->thread = NULL;
+			if (p->parent == NULL) {	// no one to Join it
+				delete p->exited;
+				processes->Remove(id);
+			} else {
+				p->status = status;
+				p->exited->V();
+			}
+		}
+	}
+	currentThread->Finish();
+}
+
 int Kernel::CreateFile(char *filename)
 {
 	return fileSystem->Create(filename);
@@ -334,7 +570,7 @@ int Kernel::CreateFile(char *filename)
 
 int Kernel::OpenFile(char *filename)
 {
-	return (int)fileSystem->Open(filename);
+	return fileSystem->Open_File(filename, currentThread);
 }
 
 int Kernel::CloseFile(int openfileId)
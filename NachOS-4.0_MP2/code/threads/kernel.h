@@ -18,14 +18,33 @@
 #include "alarm.h"
 #include "filesys.h"
 #include "machine.h"
+#include "memmgr.h"
+#include "pagetable.h"
+#include "handle.h"
 
 class PostOfficeInput;
 class PostOfficeOutput;
 class SynchConsoleInput;
 class SynchConsoleOutput;
 class SynchDisk;
+class Semaphore;
 
+// The following class defines a user program started with Exec.  Its
+// SpaceId is its handle in the kernel's table of programs, where it
+// stays after it exits, until its parent Joins it or exits too.
 
+class Process {
+  public:
+    Process() { thread = NULL; name = NULL; parent = NULL;
+		exited = NULL; status = -1; }
+
+    Thread *thread;		// the thread running it, or NULL once
+				// it has exited
+    char *name;			// the program it runs
+    Thread *parent;		// the thread that may Join it, or NULL
+    Semaphore *exited;		// signalled when it exits
+    int status;			// what it passed to Exit
+};
 
 class Kernel {
   public:
@@ -37,13 +56,21 @@ class Kernel {
 				// from constructor because 
 				// refers to "kernel" as a global
 	  void ExecAll();
-	  int Exec(char* name);
+	  int Exec(char* name);	// start a program; returns its SpaceId,
+				// or -1
+	  int Join(int id);	// wait for a child of the current
+				// thread to exit; returns its status
+	  void ExitProcess(int status);
+				// end the current thread's program
     void ThreadSelfTest();	// self test of threads and synchronization
 	
     void ConsoleTest();         // interactive console self test
     void ConsoleInteger(int number); // Print integer onto display
     void NetworkTest();         // interactive 2-machine network test
-	  Thread* getThread(int threadID){return t[threadID];}    
+	  Thread* getThread(int threadID)
+		{ Process *p = processes->Lookup(threadID);
+		  return (p == NULL) ? NULL : p->thread; }
+				// NULL if "threadID" is stale
 	
 	  int CreateFile(char* filename); // fileSystem call
     int OpenFile(char *filename);  // fileSSystem call for opening a file
@@ -68,17 +95,31 @@ class Kernel {
     PostOfficeOutput *postOfficeOut;
 
     int hostName;               // machine identifier
-	bool usedPhyPages[NumPhysPages];
+    MemoryManager *memoryManager;	// physical frames and swap space
+    PageTableKind pageTableKind;	// how address spaces keep their
+					// translation entries
 
 
   private:
 
-	Thread* t[10];
-	char*   execfile[10];
-	int execfileNum;
+	HandleTable<Process> *processes;	// programs by SpaceId
+	char **execfile;		// programs to run, from -e; 1 to
+	int execfileNum;		// execfileNum
 	int threadNum;
     bool randomSlice;		// enable pseudo-random time slicing
     bool debugUserProg;         // single step user program
+    char *profileSymbols;	// if not NULL, profile user programs, with
+				// the symbols in this file
+    int profileInterval;	// instructions per profile sample
+    int l1Size, l1Ways, l1Line;	// L1 cache to simulate, if l1Size > 0
+    int l2Size, l2Ways, l2Line;	// L2 cache below it, if l2Size > 0
+    bool tlbSim;		// simulate TLBs of each size?
+    bool pageHeat;		// count references to each page?
+    char *memTraceFile;		// if not NULL, trace memory references
+				// to this UNIX file
+    ReplacementPolicy replacePolicy;	// how to choose pages to evict
+    int clusterPages;		// pages to read in after a faulting one
+    int residentLimit;		// most frames a program may own, or 0
     double reliability;         // likelihood messages are dropped
     char *consoleIn;            // file to read console input from
     char *consoleOut;           // file to send console output to
@@ -4,6 +4,12 @@
 //
 // Usage: nachos -d <debugflags> -rs <random seed #>
 //              -s -x <nachos file> -ci <consoleIn> -co <consoleOut>
+//              -rp <fifo|clock|lru|wsclock> -cluster <pages>
+//              -pagesize <bytes> -mem <pages> -rss <pages> -tlb <entries>
+//              -pt <linear|twolevel|inverted>
+//              -prof <symbol file> -profint <instructions>
+//              -l1 <bytes> <ways> <line bytes> -l2 <bytes> <ways> <line bytes>
+//              -tlbsim -heat -memtrace <unix file>
 //              -f -cp <unix file> <nachos file>
 //              -p <nachos file> -r <nachos file> -l -D
 //              -n <network reliability> -m <machine id>
@@ -13,6 +19,33 @@
 //    -rs causes Yield to occur at random (but repeatable) spots
 //    -z prints the copyright message
 //    -s causes user programs to be executed in single-step mode
+//    -prof profiles user programs, and prints where their time went
+//	  when Nachos halts, by procedure, basic block and source line,
+//	  using a symbol file from "coff2noff -s" (see machine/profile.h)
+//    -profint samples every # instructions when profiling, rather
+//	  than every one (which is slower, but finds basic blocks)
+//    -l1 simulates an L1 cache of user memory references, of the given
+//	  size, associativity and line size (see machine/memsim.h); -l2
+//	  puts an L2 cache below it.  The hit rates are printed with the
+//	  statistics when Nachos halts, as are the results of:
+//    -tlbsim simulates TLBs of 1 to 64 entries, to choose TLBSize
+//    -heat counts the references to each virtual page
+//    -memtrace writes a trace of each memory reference to a UNIX file
+//    -rp picks the page replacement policy (fifo, clock, lru, or
+//	  wsclock, which also starts a thread to write out dirty pages
+//	  before they are evicted)
+//    -cluster sets how many pages after a faulting one that is on swap
+//	  are read in with it, if they follow it on swap (default 3)
+//    -pagesize sets the size of a page of memory, in bytes (a power
+//	  of two, no smaller than a disk sector; 128 is the default)
+//    -mem sets the number of pages of physical memory (default 128)
+//    -rss limits each program to that many frames of its own (its
+//	  resident set); past that, it evicts its own pages
+//    -tlb gives the machine a TLB of that many entries, which the kernel
+//	  fills on misses, instead of a page table it reads itself (0, the
+//	  default, means no TLB); the TLB hit rate is printed at the end
+//    -pt picks how page tables are kept (see userprog/pagetable.h);
+//	  linear is the default
 //    -x runs a user program
 //    -ci specify file for console input (stdin is the default)
 //    -co specify file for console output (stdout is the default)
@@ -45,6 +78,7 @@
 #include "filesys.h"
 #include "openfile.h"
 #include "sysdep.h"
+#include "memops.h"
 
 // global variables
 Kernel *kernel;
@@ -246,6 +280,8 @@ main(int argc, char **argv)
     debug = new Debug(debugArg);
     
     DEBUG(dbgThread, "Entering main");
+    MemOpsInit();
+    DEBUG(dbgThread, "Copying memory with " << MemOpsKind() << " routines");
 
     kernel = new Kernel(argc, argv);
 
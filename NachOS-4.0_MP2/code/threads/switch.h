@@ -6,7 +6,7 @@
  *	call frame, etc, are all specific to a processor architecture.
  *
  * 	This file currently supports the DEC MIPS, DEC Alpha, SUN SPARC,
- *  HP PARISC, IBM PowerPC, and Intel x86 architectures.
+ *  HP PARISC, IBM PowerPC, Intel x86, x86-64 and AArch64 architectures.
  */
 
 /*
@@ -156,6 +156,73 @@
 
 #endif // x86
 
+#ifdef x86_64
+
+/* The offsets of the registers from the beginning of the thread object.
+ * Only the registers a called function must preserve are saved: SWITCH
+ * is called like any other function, so the caller has already saved
+ * the rest.
+ */
+#define _RSP     0
+#define _RBX     8
+#define _RBP     16
+#define _R12     24
+#define _R13     32
+#define _R14     40
+#define _R15     48
+#define _PC      56
+
+/* These definitions are used in Thread::AllocateStack(). */
+#define PCState         (_PC/8-1)
+#define FPState         (_RBP/8-1)
+#define InitialPCState  (_R12/8-1)
+#define InitialArgState (_R13/8-1)
+#define WhenDonePCState (_R14/8-1)
+#define StartupPCState  (_R15/8-1)
+
+#define InitialPC       %r12
+#define InitialArg      %r13
+#define WhenDonePC      %r14
+#define StartupPC       %r15
+
+#endif // x86_64
+
+#ifdef AARCH64
+
+/* The offsets of the registers from the beginning of the thread object:
+ * the callee-saved registers, x19 to x30 and the low halves of v8 to
+ * v15.  x29 is the frame pointer, and x30 the return address.
+ */
+#define _SP      0
+#define _X19     8
+#define _X20     16
+#define _X21     24
+#define _X22     32
+#define _X23     40
+#define _X25     56
+#define _X27     72
+#define _X29     88
+#define _X30     96
+#define _D8      104
+#define _D10     120
+#define _D12     136
+#define _D14     152		/* pairs are saved together */
+
+/* These definitions are used in Thread::AllocateStack(). */
+#define PCState         (_X30/8-1)
+#define FPState         (_X29/8-1)
+#define InitialPCState  (_X19/8-1)
+#define InitialArgState (_X20/8-1)
+#define WhenDonePCState (_X21/8-1)
+#define StartupPCState  (_X22/8-1)
+
+#define InitialPC       x19
+#define InitialArg      x20
+#define WhenDonePC      x21
+#define StartupPC       x22
+
+#endif // AARCH64
+
 #ifdef PowerPC 
 
  #define	SP	  0    // stack pointer 
@@ -66,6 +66,8 @@ Thread::~Thread()
     ASSERT(this != kernel->currentThread);
     if (stack != NULL)
 	DeallocBoundedArray((char *) stack, StackSize * sizeof(int));
+    if (space != NULL)			// the reaper gives back the rest
+	kernel->memoryManager->Retire(space);	// of its memory
 }
 
 //----------------------------------------------------------------------
@@ -95,7 +97,7 @@ Thread::Fork(VoidFunctionPtr func, void *arg)
     Scheduler *scheduler = kernel->scheduler;
     IntStatus oldLevel;
     
-    DEBUG(dbgThread, "Forking thread: " << name << " f(a): " << (int) func << " " << arg);
+    DEBUG(dbgThread, "Forking thread: " << name << " f(a): " << (void *) func << " " << arg);
     StackAllocate(func, arg);
 
     oldLevel = interrupt->SetLevel(IntOff);
@@ -248,6 +250,8 @@ Thread::Sleep (bool finishing)
     status = BLOCKED;
 	//cout << "debug Thread::Sleep " << name << "wait for Idle\n";
     while ((nextThread = kernel->scheduler->FindNextToRun()) == NULL) {
+		if (kernel->memoryManager != NULL)
+		    kernel->memoryManager->ZeroFreeFrames();	// spare time
 		kernel->interrupt->Idle();	// no one to run, wait for an interrupt
 	}    
     // returns when it's time for us to run
@@ -345,6 +349,23 @@ Thread::StackAllocate (VoidFunctionPtr func, void *arg)
     *(--stackTop) = (int) ThreadRoot;
     *stack = STACK_FENCEPOST;
 #endif
+
+#ifdef x86_64
+    // As on the x86, SWITCH() returns to ThreadRoot the first time, through 
+    // a return address on the stack -- a 64-bit one.  The stack must be 
+    // 16-byte aligned at a call, so the slot holding it is too.
+    stackTop = (int *) (((unsigned long) (stack + StackSize - 4)) & ~15UL);
+    stackTop -= 16 / sizeof(int);
+    *(void **) stackTop = (void *) ThreadRoot;
+    *stack = STACK_FENCEPOST;
+#endif
+
+#ifdef AARCH64
+    // SWITCH() "returns" to the address in x30, so ThreadRoot is only 
+    // in machineState.  The stack pointer must be 16-byte aligned.
+    stackTop = (int *) (((unsigned long) (stack + StackSize - 4)) & ~15UL);
+    *stack = STACK_FENCEPOST;
+#endif
     
 #ifdef PARISC
     machineState[PCState] = PLabelToAddr(ThreadRoot);
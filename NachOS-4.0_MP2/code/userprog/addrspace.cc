@@ -20,6 +20,9 @@
 #include "addrspace.h"
 #include "machine.h"
 #include "noff.h"
+#include "memmgr.h"
+#include "synchdisk.h"
+#include "memops.h"
 
 //----------------------------------------------------------------------
 // SwapHeader
@@ -57,6 +60,46 @@ SwapHeader (NoffHeader *noffH)
 #endif
 }
 
+//----------------------------------------------------------------------
+// LzExpand
+// 	Expand "fromSize" bytes of LZ compressed data (in the format
+//	described in noff.h) into exactly "toSize" bytes.  Returns FALSE
+//	if the data is corrupt.
+//----------------------------------------------------------------------
+
+static bool
+LzExpand(char *from, int fromSize, char *to, int toSize)
+{
+    unsigned char *in = (unsigned char *) from;
+    int i = 0, o = 0, flags = 1;
+    int dist, len;
+
+    while (o < toSize) {
+	if (flags == 1) {		// used up the last flag byte
+	    if (i >= fromSize)
+		return FALSE;
+	    flags = in[i++] | 0x100;
+	}
+	if (flags & 1) {
+	    if (i >= fromSize)
+		return FALSE;
+	    to[o++] = in[i++];
+	} else {
+	    if (i + 1 >= fromSize)
+		return FALSE;
+	    dist = (in[i] | ((in[i + 1] >> 4) << 8)) + 1;
+	    len = (in[i + 1] & 0xf) + 3;
+	    i += 2;
+	    if (dist > o || o + len > toSize)
+		return FALSE;
+	    for (; len > 0; len--, o++)
+		to[o] = to[o - dist];
+	}
+	flags >>= 1;
+    }
+    return TRUE;
+}
+
 //----------------------------------------------------------------------
 // AddrSpace::AddrSpace
 // 	Create an address space to run a user program.
@@ -79,25 +122,114 @@ AddrSpace::AddrSpace()
     
     // zero out the entire address space
     //bzero(kernel->machine->mainMemory, MemorySize);
+    pageTable = NULL;			// no pages until Load
+    numPages = 0;
+    executable = NULL;
+    image = NULL;
+    initData = NULL;
+    released = FALSE;
+    for (int i = 0; i < MapPages; i++)
+	mapping[i] = NULL;
+    created = new List<SharedSegment *>;
 }
 
 //----------------------------------------------------------------------
 // AddrSpace::~AddrSpace
-// 	Dealloate an address space.
+// 	Dealloate an address space.  Unless Release gave them back
+//	already, its private frames and swap go first, so that the
+//	mappings can't be confused with them.
+//
+//	A program's address space is deleted by the memory manager's
+//	reaper thread (see MemoryManager::Retire), with faultLock held.
 //----------------------------------------------------------------------
 
 AddrSpace::~AddrSpace()
 {
-   delete pageTable;
+    TranslationEntry *entry;
+
+    if (!released)
+	FreePages();
+    for (int i = 0; i < MapPages; i++) {
+	if (mapping[i] != NULL)
+	    RemoveMapping(mapping[i]);
+    }
+    while (!created->IsEmpty())
+	kernel->memoryManager->DetachSegment(created->RemoveFront());
+    delete created;
+    if (pageTable != NULL)
+	kernel->memoryManager->FlushTLB(pageTable->Id(), -1);
+    for (unsigned int i = 0; i < numPages; i++) {
+	entry = pageTable->Lookup(i);
+	if (entry != NULL && shared[i])
+	    kernel->memoryManager->UnmapShared(image, i);
+    }
+    if (numPages > 0) {
+	delete pageTable;
+	delete [] swapSector;
+	delete [] onSwap;
+	delete [] shared;
+	delete [] zeroMapped;
+    }
+    if (image != NULL)
+	kernel->memoryManager->DetachImage(image);
+    if (executable != NULL)
+	delete executable;
 }
 
 
+//----------------------------------------------------------------------
+// AddrSpace::Release
+// 	Give back the frames and swap of our pages as soon as the program
+//	exits, before its parent is told (so that a program it starts
+//	next finds them free).  The page table, the shared pages and the
+//	mappings are left for when we are deleted, off the exit path.
+//----------------------------------------------------------------------
+
+void
+AddrSpace::Release()
+{
+    MemoryManager *memoryManager = kernel->memoryManager;
+
+    if (released)
+	return;
+    memoryManager->faultLock->Acquire();
+    FreePages();
+    memoryManager->faultLock->Release();
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::FreePages
+// 	Give back the frames of our private pages (not the shared or
+//	zero ones, nor those of mappings), in one sweep of the frame
+//	table, and the swap reserved for every page, in runs.  The page
+//	table entries are left, but nothing may be run here again.
+//----------------------------------------------------------------------
+
+void
+AddrSpace::FreePages()
+{
+    MemoryManager *memoryManager = kernel->memoryManager;
+
+    released = TRUE;
+    if (numPages == 0)
+	return;
+    memoryManager->FlushTLB(pageTable->Id(), -1);
+    memoryManager->FreeFrames(this, numPages);
+    memoryManager->FreeSwapPages(swapSector, numPages);
+}
+
 //----------------------------------------------------------------------
 // AddrSpace::Load
 // 	Load a user program into memory from a file.
 //
 //	Assumes that the page table has been initialized, and that
-//	the object code file is in NOFF format.
+//	the object code file is in NOFF format, version 1 or 2.  If the
+//	initialized data is compressed, it is expanded now, and pages of
+//	it are copied from memory when they are faulted in.
+//
+//	If the program is running already, or ran lately, its header
+//	and expanded data come from its SharedImage instead, so all
+//	that is left to do is to set up the page table.
 //
 //	"fileName" is the file containing the object code to load into memory
 //----------------------------------------------------------------------
@@ -105,20 +237,35 @@ AddrSpace::~AddrSpace()
 bool 
 AddrSpace::Load(char *fileName) 
 {
-    OpenFile *executable = kernel->fileSystem->Open(fileName);
-    NoffHeader noffH;
     unsigned int size;
 
+    executable = kernel->fileSystem->Open(fileName);
     if (executable == NULL) {
 	cerr << "Unable to open file " << fileName << "\n";
 	return FALSE;
     }
 
-    executable->ReadAt((char *)&noffH, sizeof(noffH), 0);
-    if ((noffH.noffMagic != NOFFMAGIC) && 
-		(WordToHost(noffH.noffMagic) == NOFFMAGIC))
-    	SwapHeader(&noffH);
-    ASSERT(noffH.noffMagic == NOFFMAGIC);
+    image = kernel->memoryManager->FindImage(fileName, executable->Length());
+    if (image != NULL) {
+	DEBUG(dbgAddr, "Reusing the parsed image of " << fileName);
+	noffH = image->noffH;
+	initData = image->initData;
+    } else {
+	executable->ReadAt((char *)&noffH, sizeof(noffH), 0);
+	if ((noffH.noffMagic != NOFFMAGIC) && (noffH.noffMagic != NOFFMAGIC2) &&
+		((WordToHost(noffH.noffMagic) == NOFFMAGIC) ||
+		 (WordToHost(noffH.noffMagic) == NOFFMAGIC2)))
+	    SwapHeader(&noffH);
+	ASSERT((noffH.noffMagic == NOFFMAGIC) || (noffH.noffMagic == NOFFMAGIC2));
+	if (noffH.noffMagic == NOFFMAGIC2 && !ExpandInitData()) {
+	    cerr << "Corrupt compressed data in " << fileName << "\n";
+	    delete [] initData;
+	    initData = NULL;
+	    delete executable;
+	    executable = NULL;
+	    return FALSE;
+	}
+    }
 
 #ifdef RDATA
 // how big is address space?
@@ -135,55 +282,684 @@ AddrSpace::Load(char *fileName)
 #endif
     numPages = divRoundUp(size, PageSize);
 
-	pageTable = new TranslationEntry[numPages];
-	for (unsigned int i = 0,j = 0; i < numPages; i++) {
-		pageTable[i].virtualPage = i;               // for now, virt page # = phys page #
-
-		while(kernel->usedPhyPages[j]==TRUE) j++;
+    if (!kernel->memoryManager->WaitForSwap(numPages)) {
+	cerr << "Not enough swap space to load " << fileName << "\n";
+	numPages = 0;
+	if (image != NULL)
+	    kernel->memoryManager->DetachImage(image);
+	else
+	    delete [] initData;
+	image = NULL;
+	initData = NULL;
+	delete executable;
+	executable = NULL;
+	return FALSE;
+    }
 
-		kernel->usedPhyPages[j]=TRUE;
-		pageTable[i].physicalPage = j;
-		pageTable[i].valid = TRUE;
-		pageTable[i].use = FALSE;
-		pageTable[i].dirty = FALSE;
-		pageTable[i].readOnly = FALSE; 
+// Nothing is brought into memory yet: every page starts out invalid,
+// and is read in from the executable (or from swap, once it has been
+// written out) by PageIn when it is first touched.  A swap sector is
+// reserved for each page now, so that eviction can never fail.
+	pageTable = new PageTable(kernel->pageTableKind, numPages + MapPages);
+	swapSector = new int[numPages];
+	onSwap = new bool[numPages];
+	shared = new bool[numPages];
+	zeroMapped = new bool[numPages];
+	for (unsigned int i = 0; i < numPages; i++) {
+		swapSector[i] = kernel->memoryManager->AllocSwap();
+		ASSERT(swapSector[i] >= 0);
+		onSwap[i] = FALSE;
+		shared[i] = FALSE;
+		zeroMapped[i] = FALSE;
 	}
 
     size = numPages * PageSize;
 
-    ASSERT(numPages <= NumPhysPages);		// check we're not trying
-						// to run anything too big --
-						// at least until we have
-						// virtual memory
-
     DEBUG(dbgAddr, "Initializing address space: " << numPages << ", " << size);
 
-// then, copy in the code and data segments into memory
-// Note: this code assumes that virtual address = physical address
-    if (noffH.code.size > 0) {
-        DEBUG(dbgAddr, "Initializing code segment.");
-		DEBUG(dbgAddr, noffH.code.virtualAddr << ", " << noffH.code.size);
-		Translate(noffH.code.virtualAddr, (unsigned int*)(kernel->machine->mainMemory), 1);
-        executable->ReadAt(&(kernel->machine->mainMemory[pageTable[noffH.code.virtualAddr/PageSize].physicalPage * PageSize + (noffH.code.virtualAddr%PageSize)]), noffH.code.size, noffH.code.inFileAddr);
+    if (image == NULL) {		// keep what was parsed, for next time
+	image = kernel->memoryManager->AttachImage(fileName, numPages);
+	image->fileLength = executable->Length();
+	image->noffH = noffH;
+	image->initData = initData;	// which the image now owns
+    }
+    return TRUE;			// success (executable stays open,
+					// for PageIn)
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::PageIn
+// 	Handle a page fault on virtual page "vpn": find it a frame
+//	(evicting some other page if memory is full), and fill the frame
+//	from swap if the page has been written out before, or else from
+//	the executable.
+//
+//	A page that comes only from the executable is shared, read-only,
+//	with any other address space running the same program; the first
+//	write to it gives this address space a copy of its own (see
+//	CopyOnWrite).  If pinning one more shared frame would leave too
+//	few for everything else, the page is read into a private frame
+//	instead.  A page of only uninitialized data or stack is mapped,
+//	read-only, to the memory manager's frame of zeroes, and gets a
+//	frame of its own the same way.
+//
+//	Returns FALSE if "vpn" is not part of this address space.
+//----------------------------------------------------------------------
+
+bool
+AddrSpace::PageIn(int vpn)
+{
+    MemoryManager *memoryManager = kernel->memoryManager;
+    TranslationEntry *entry;
+
+    if (vpn >= 0 && (unsigned int) vpn >= numPages) {
+	return MapIn(vpn);
+    }
+    if (vpn < 0) {
+	return FALSE;
+    }
+    memoryManager->faultLock->Acquire();
+    if (pageTable->Lookup(vpn) == NULL) {
+	int frame;
+	bool readOnly;
+
+	kernel->stats->numPageFaults++;
+	if (!onSwap[vpn] && IsShareable(vpn)) {
+	    bool share = TRUE;
+
+	    frame = memoryManager->MapShared(image, vpn);
+	    if (frame == -1) {		// first user to touch it: read it in
+		frame = memoryManager->AllocFrame(this, vpn);
+		FillFromFile(vpn,
+			&(kernel->machine->mainMemory[frame * PageSize]));
+		share = memoryManager->CanShare();
+		if (share)
+		    memoryManager->AddShared(image, vpn, frame);
+	    }
+	    shared[vpn] = share;	// else a private copy, as if it
+	    zeroMapped[vpn] = FALSE;	// weren't shareable
+	    readOnly = share;
+	} else if (!onSwap[vpn] && IsZeroFill(vpn)) {
+	    frame = memoryManager->ZeroFrame();
+	    kernel->stats->numZeroMapped++;
+	    shared[vpn] = FALSE;
+	    zeroMapped[vpn] = TRUE;
+	    readOnly = TRUE;
+	} else {
+	    frame = memoryManager->AllocFrame(this, vpn);
+	    if (onSwap[vpn]) {
+		memoryManager->ReadSwap(swapSector[vpn],
+			&(kernel->machine->mainMemory[frame * PageSize]));
+	    } else {
+		FillFromFile(vpn,
+			&(kernel->machine->mainMemory[frame * PageSize]));
+	    }
+	    shared[vpn] = FALSE;
+	    zeroMapped[vpn] = FALSE;
+	    readOnly = FALSE;
 	}
-    if (noffH.initData.size > 0) {
-        DEBUG(dbgAddr, "Initializing data segment.");
-		DEBUG(dbgAddr, noffH.initData.virtualAddr << ", " << noffH.initData.size);
-		Translate(noffH.initData.virtualAddr, (unsigned int*)(kernel->machine->mainMemory), 1);
-        executable->ReadAt(&(kernel->machine->mainMemory[pageTable[noffH.initData.virtualAddr/PageSize].physicalPage * PageSize + (noffH.code.virtualAddr%PageSize)]),noffH.initData.size, noffH.initData.inFileAddr);
+	DEBUG(dbgAddr, "Page fault on page " << vpn << ", frame " << frame);
+	entry = pageTable->Enter(vpn);	// after AllocFrame, which may
+					// evict (and remove) other entries
+	entry->physicalPage = frame;
+	entry->readOnly = readOnly;
+	entry->use = FALSE;
+	entry->dirty = FALSE;
+	entry->valid = TRUE;
+	if (onSwap[vpn])
+	    Prefetch(vpn);
     }
+    memoryManager->faultLock->Release();
+    return TRUE;
+}
 
-#ifdef RDATA
-    if (noffH.readonlyData.size > 0) {
-        DEBUG(dbgAddr, "Initializing read only data segment.");
-		DEBUG(dbgAddr, noffH.readonlyData.virtualAddr << ", " << noffH.readonlyData.size);
-		Translate(noffH.readonlyData.virtualAddr, (unsigned int*)(kernel->machine->mainMemory), 0);
-		executable->ReadAt(&(kernel->machine->mainMemory[pageTable[noffH.readonlyData.virtualAddr/PageSize].physicalPage * PageSize + (noffH.code.virtualAddr%PageSize)]),noffH.readonlyData.size, noffH.readonlyData.inFileAddr);
+//----------------------------------------------------------------------
+// AddrSpace::RefillTLB
+// 	Handle a TLB miss on virtual page "vpn": bring the page into
+//	memory if it isn't, and load its page table entry into the TLB.
+//	If the page was evicted again while PageIn let other threads run,
+//	it is left out of the TLB; the retried reference misses again.
+//
+//	Returns FALSE if "vpn" is not part of this address space.
+//----------------------------------------------------------------------
+
+bool
+AddrSpace::RefillTLB(int vpn)
+{
+    TranslationEntry *entry;
+
+    if (vpn < 0 || (unsigned int) vpn >= numPages + MapPages) {
+	return FALSE;
+    }
+    if (pageTable->Lookup(vpn) == NULL && !PageIn(vpn)) {
+	return FALSE;
+    }
+    entry = pageTable->Lookup(vpn);
+    if (entry != NULL)
+	kernel->memoryManager->LoadTLB(pageTable->Id(), entry);
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::Prefetch
+// 	Page "vpn" has just been read in from swap; read in the pages
+//	after it too, up to the memory manager's ClusterPages, as long
+//	as each is on swap in the sectors right after the last one read
+//	(so the disk reads on without seeking back) and is not in memory
+//	already.  Only free frames are used: a page that is in use is
+//	never evicted for one that may not be.
+//
+//	Must be called with faultLock held.
+//----------------------------------------------------------------------
+
+void
+AddrSpace::Prefetch(int vpn)
+{
+    MemoryManager *memoryManager = kernel->memoryManager;
+    int sectorsPerPage = PageSize / SectorSize;
+
+    for (int i = 1; i <= memoryManager->ClusterPages(); i++) {
+	unsigned int next = vpn + i;
+	TranslationEntry *entry;
+	int frame;
+
+	if (next >= numPages || !onSwap[next] || pageTable->Lookup(next) != NULL
+		|| swapSector[next] != swapSector[vpn] + i * sectorsPerPage)
+	    break;
+	frame = memoryManager->AllocFreeFrame(this, next);
+	if (frame == -1)
+	    break;
+	memoryManager->ReadSwap(swapSector[next],
+		&(kernel->machine->mainMemory[frame * PageSize]));
+	DEBUG(dbgAddr, "Read ahead page " << next << ", frame " << frame);
+	kernel->stats->numPrefetched++;
+	shared[next] = FALSE;
+	zeroMapped[next] = FALSE;
+	entry = pageTable->Enter(next);
+	entry->physicalPage = frame;
+	entry->readOnly = FALSE;
+	entry->use = FALSE;		// so it goes first if not wanted
+	entry->dirty = FALSE;
+	entry->valid = TRUE;
+    }
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::CopyOnWrite
+// 	Handle a ReadOnlyException on virtual page "vpn".  If the page is
+//	shared with other address spaces, copy it into a frame of our
+//	own, and make it writable.  If it is mapped to the frame of
+//	zeroes, just give it a zeroed frame of its own instead.
+//
+//	Returns FALSE if the page is really read-only, or not part of
+//	this address space.
+//----------------------------------------------------------------------
+
+bool
+AddrSpace::CopyOnWrite(int vpn)
+{
+    MemoryManager *memoryManager = kernel->memoryManager;
+    TranslationEntry *entry;
+    bool ok = TRUE;
+
+    if (vpn < 0 || (unsigned int) vpn >= numPages) {
+	return FALSE;
     }
+    memoryManager->faultLock->Acquire();
+    entry = pageTable->Lookup(vpn);
+    if (entry != NULL)
+	memoryManager->FlushTLB(pageTable->Id(), vpn);	// it will change
+    if (entry != NULL && shared[vpn]) {
+	int frame = memoryManager->AllocFrame(this, vpn);
+
+	DEBUG(dbgAddr, "Copy on write of page " << vpn << ", frame " << frame);
+	MemCopy(&(kernel->machine->mainMemory[frame * PageSize]),
+		&(kernel->machine->mainMemory[entry->physicalPage * PageSize]),
+		PageSize);
+	memoryManager->UnmapShared(image, vpn);
+	shared[vpn] = FALSE;
+	entry->physicalPage = frame;
+	entry->readOnly = FALSE;
+	entry->dirty = TRUE;		// differs from the executable
+    } else if (entry != NULL && zeroMapped[vpn]) {
+	int frame = memoryManager->AllocZeroedFrame(this, vpn);
+
+	DEBUG(dbgAddr, "First write to zero page " << vpn << ", frame " << frame);
+	kernel->stats->numZeroFilled++;
+	zeroMapped[vpn] = FALSE;
+	entry = pageTable->Lookup(vpn);	// AllocZeroedFrame may have
+					// evicted pages
+	entry->physicalPage = frame;
+	entry->readOnly = FALSE;
+	entry->dirty = TRUE;
+    } else if (entry != NULL) {
+	ok = FALSE;			// a genuinely read-only page
+    }					// (if no longer valid, let the
+					// retried write fault it in)
+    memoryManager->faultLock->Release();
+    return ok;
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::IsShareable
+// 	Return TRUE if virtual page "vpn" overlaps the code or initialized
+//	data of the executable, so that until it is written, every address
+//	space running the program has the same contents there.
+//----------------------------------------------------------------------
+
+bool
+AddrSpace::IsShareable(int vpn)
+{
+    int pageStart = vpn * PageSize;
+    int pageEnd = pageStart + PageSize;
+
+    if (noffH.code.size > 0 && pageStart < noffH.code.virtualAddr + noffH.code.size
+			&& noffH.code.virtualAddr < pageEnd)
+	return TRUE;
+    if (noffH.initData.size > 0
+		&& pageStart < noffH.initData.virtualAddr + noffH.initData.size
+		&& noffH.initData.virtualAddr < pageEnd)
+	return TRUE;
+    return FALSE;
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::IsZeroFill
+// 	Return TRUE if virtual page "vpn" overlaps no segment of the
+//	executable, so that it starts out as nothing but zeroes:
+//	uninitialized data, or stack.
+//----------------------------------------------------------------------
+
+bool
+AddrSpace::IsZeroFill(int vpn)
+{
+    if (IsShareable(vpn))
+	return FALSE;
+#ifdef RDATA
+    int pageStart = vpn * PageSize;
+    int pageEnd = pageStart + PageSize;
+
+    if (noffH.readonlyData.size > 0
+		&& pageStart < noffH.readonlyData.virtualAddr
+				+ noffH.readonlyData.size
+		&& noffH.readonlyData.virtualAddr < pageEnd)
+	return FALSE;
+#endif
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::FillFromFile
+// 	Fill "dest", the frame for virtual page "vpn", with that page's
+//	initial contents: whatever parts of the executable's segments
+//	fall in it, and zeroes elsewhere.
+//----------------------------------------------------------------------
+
+void
+AddrSpace::FillFromFile(int vpn, char *dest)
+{
+    MemZero(dest, PageSize);		// uninitialized data and stack
+    CopySegment(&noffH.code, vpn, dest);
+    CopySegment(&noffH.initData, vpn, dest);
+#ifdef RDATA
+    CopySegment(&noffH.readonlyData, vpn, dest);
 #endif
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::PageOut
+// 	Evict virtual page "vpn", whose frame has been taken away by the
+//	memory manager.  The page is written to its swap sector only if
+//	it was modified; otherwise the copy on swap (or in the executable)
+//	is still good.
+//
+//	The page is marked invalid, and its swap state updated, before
+//	the disk write, since the write may block.
+//----------------------------------------------------------------------
+
+void
+AddrSpace::PageOut(int vpn)
+{
+    TranslationEntry *entry = pageTable->Lookup(vpn);
+    int frame;
+    bool dirty;
 
-    delete executable;			// close file
-    return TRUE;			// success
+    ASSERT(entry != NULL);
+    kernel->memoryManager->FlushTLB(pageTable->Id(), vpn);
+    frame = entry->physicalPage;
+    dirty = entry->dirty;
+    if ((unsigned int) vpn >= numPages) {	// a mapped file page
+	pageTable->Remove(vpn);
+	if (dirty)
+	    WriteBack(mapping[vpn - numPages], vpn, frame);
+	return;
+    }
+    ASSERT(!shared[vpn] && !zeroMapped[vpn]);	// their frames are pinned
+    pageTable->Remove(vpn);		// "entry" may be freed
+    if (dirty) {
+	onSwap[vpn] = TRUE;
+	kernel->memoryManager->WriteSwap(swapSector[vpn],
+		&(kernel->machine->mainMemory[frame * PageSize]));
+    }
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::Clean
+// 	Write virtual page "vpn" out, if it is in memory and dirty, so
+//	that it can later be evicted without waiting for the disk; it
+//	stays in memory.  Returns TRUE if it was written.
+//
+//	The page is marked clean before the write, which may block: if
+//	it is written to meanwhile, it is dirty again, as it should be.
+//	Must be called with faultLock held.
+//----------------------------------------------------------------------
+
+bool
+AddrSpace::Clean(int vpn)
+{
+    TranslationEntry *entry = pageTable->Lookup(vpn);
+    int frame;
+
+    if (entry != NULL)			// for its dirty bit, which is
+	kernel->memoryManager->FlushTLB(pageTable->Id(), vpn);	// cleared
+    if (entry == NULL || !entry->dirty)
+	return FALSE;
+    frame = entry->physicalPage;
+    if ((unsigned int) vpn >= numPages) {	// a mapped file page
+	if (mapping[vpn - numPages]->segment != NULL)
+	    return FALSE;
+	entry->dirty = FALSE;
+	WriteBack(mapping[vpn - numPages], vpn, frame);
+	return TRUE;
+    }
+    entry->dirty = FALSE;
+    onSwap[vpn] = TRUE;
+    kernel->memoryManager->WriteSwap(swapSector[vpn],
+		&(kernel->machine->mainMemory[frame * PageSize]));
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::ExpandInitData
+// 	Read the extra header of a version 2 executable, and if its
+//	initialized data is compressed, expand it into memory.  Returns
+//	FALSE if it can't be expanded.
+//----------------------------------------------------------------------
+
+bool
+AddrSpace::ExpandInitData()
+{
+    NoffExtra noffX;
+    char *stored;
+    bool ok;
+
+    executable->ReadAt((char *)&noffX, sizeof(noffX), sizeof(noffH));
+    noffX.flags = WordToHost(noffX.flags);
+    noffX.initDataStored = WordToHost(noffX.initDataStored);
+    if (!(noffX.flags & NoffLzInitData) || noffH.initData.size <= 0)
+	return TRUE;
+
+    DEBUG(dbgAddr, "Expanding " << noffX.initDataStored << " bytes of data to "
+			<< noffH.initData.size);
+    stored = new char[noffX.initDataStored];
+    executable->ReadAt(stored, noffX.initDataStored, noffH.initData.inFileAddr);
+    initData = new char[noffH.initData.size];
+    ok = LzExpand(stored, noffX.initDataStored, initData, noffH.initData.size);
+    delete [] stored;
+    return ok;
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::CopySegment
+// 	Copy the part of a segment of the executable that falls in
+//	virtual page "vpn" into "dest", the frame holding that page.
+//	Compressed initialized data comes from its expanded copy.
+//
+//	"seg" is the segment, as described by the NOFF header
+//----------------------------------------------------------------------
+
+void
+AddrSpace::CopySegment(Segment *seg, int vpn, char *dest)
+{
+    int pageStart = vpn * PageSize;
+    int from = max(pageStart, seg->virtualAddr);
+    int to = min(pageStart + PageSize, seg->virtualAddr + seg->size);
+
+    if (from < to && seg == &noffH.initData && initData != NULL) {
+	MemCopy(dest + (from - pageStart), initData + (from - seg->virtualAddr),
+		to - from);
+    } else if (from < to) {
+	executable->ReadAt(dest + (from - pageStart), to - from,
+		seg->inFileAddr + (from - seg->virtualAddr));
+    }
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::CreateSegment
+// 	Make a shared segment of "size" bytes, which lives at least until
+//	this address space goes away, and return the id other address
+//	spaces attach it by; or -1 if there isn't the memory for it.
+//----------------------------------------------------------------------
+
+int
+AddrSpace::CreateSegment(int size)
+{
+    MemoryManager *memoryManager = kernel->memoryManager;
+    SharedSegment *segment;
+
+    if (size <= 0 || divRoundUp(size, PageSize) > MapPages)
+	return -1;
+    memoryManager->faultLock->Acquire();
+    segment = memoryManager->CreateSegment(divRoundUp(size, PageSize));
+    memoryManager->faultLock->Release();
+    if (segment == NULL)
+	return -1;
+    created->Append(segment);
+    return segment->id;
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::AttachSegment
+// 	Map all of shared segment "id" into the map region, and return
+//	the address it starts at; or -1 if there is no such segment, or
+//	no room for it.  Its pages are entered when first touched.
+//----------------------------------------------------------------------
+
+int
+AddrSpace::AttachSegment(int id)
+{
+    SharedSegment *segment = kernel->memoryManager->AttachSegment(id);
+    Mapping *m;
+    int addr;
+
+    if (segment == NULL)
+	return -1;
+    m = new Mapping;
+    m->numPages = segment->numPages;
+    m->segment = segment;
+    m->file = NULL;
+    m->offset = m->length = 0;
+    addr = AddMapping(m);
+    if (addr == -1) {
+	kernel->memoryManager->DetachSegment(segment);
+	delete m;
+    }
+    return addr;
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::MapFile
+// 	Map "length" bytes of "file", from byte "offset", into the map
+//	region, and return the address they start at; or -1 if there is
+//	no room.  Pages are read from the file when first touched, and
+//	written back if modified: when evicted, unmapped, or when the
+//	address space goes away.
+//
+//	The file must stay open for as long as it is mapped.
+//----------------------------------------------------------------------
+
+int
+AddrSpace::MapFile(OpenFile *file, int offset, int length)
+{
+    Mapping *m;
+    int addr;
+
+    if (file == NULL || offset < 0 || length <= 0)
+	return -1;
+    m = new Mapping;
+    m->numPages = divRoundUp(length, PageSize);
+    m->segment = NULL;
+    m->file = file;
+    m->offset = offset;
+    m->length = length;
+    addr = AddMapping(m);
+    if (addr == -1)
+	delete m;
+    return addr;
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::Unmap
+// 	Remove the mapping that starts at "addr", writing back any of its
+//	file pages that were modified.  Returns FALSE if no mapping
+//	starts there.
+//----------------------------------------------------------------------
+
+bool
+AddrSpace::Unmap(int addr)
+{
+    int index = addr / PageSize - numPages;
+    Mapping *m;
+
+    if (addr % PageSize != 0 || index < 0 || index >= MapPages)
+	return FALSE;
+    m = mapping[index];
+    if (m == NULL || m->firstPage != addr / PageSize)
+	return FALSE;
+    kernel->memoryManager->faultLock->Acquire();
+    RemoveMapping(m);
+    kernel->memoryManager->faultLock->Release();
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::AddMapping
+// 	Find the first run of free pages of the map region big enough
+//	for "m", and give them to it.  Returns the address of its first
+//	page, or -1 if there is no such run.
+//----------------------------------------------------------------------
+
+int
+AddrSpace::AddMapping(Mapping *m)
+{
+    int run = 0;
+
+    for (int i = 0; i < MapPages; i++) {
+	run = (mapping[i] == NULL) ? run + 1 : 0;
+	if (run == m->numPages) {
+	    m->firstPage = numPages + i - run + 1;
+	    for (int j = i - run + 1; j <= i; j++)
+		mapping[j] = m;
+	    DEBUG(dbgAddr, "Mapped " << m->numPages << " pages at page "
+			<< m->firstPage);
+	    return m->firstPage * PageSize;
+	}
+    }
+    return -1;
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::MapIn
+// 	Handle a page fault on page "vpn" of the map region: enter the
+//	segment's frame for it, or read it in from the file.  Returns
+//	FALSE if nothing is mapped there.
+//----------------------------------------------------------------------
+
+bool
+AddrSpace::MapIn(int vpn)
+{
+    MemoryManager *memoryManager = kernel->memoryManager;
+    Mapping *m;
+    TranslationEntry *entry;
+
+    if ((unsigned int) vpn >= numPages + MapPages
+		|| (m = mapping[vpn - numPages]) == NULL)
+	return FALSE;
+    memoryManager->faultLock->Acquire();
+    if (pageTable->Lookup(vpn) == NULL && mapping[vpn - numPages] == m) {
+	int page = vpn - m->firstPage;
+	int frame;
+
+	kernel->stats->numPageFaults++;
+	if (m->segment != NULL) {
+	    frame = m->segment->frame[page];
+	} else {
+	    char *dest;
+
+	    frame = memoryManager->AllocFrame(this, vpn);
+	    dest = &(kernel->machine->mainMemory[frame * PageSize]);
+	    MemZero(dest, PageSize);
+	    m->file->ReadAt(dest, min(PageSize, m->length - page * PageSize),
+			m->offset + page * PageSize);
+	}
+	DEBUG(dbgAddr, "Fault in mapped page " << vpn << ", frame " << frame);
+	entry = pageTable->Enter(vpn);
+	entry->physicalPage = frame;
+	entry->readOnly = FALSE;
+	entry->use = FALSE;
+	entry->dirty = FALSE;
+	entry->valid = TRUE;
+    }
+    memoryManager->faultLock->Release();
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::WriteBack
+// 	Write the part of file mapping "m" in page "vpn", held in
+//	"frame", back to the file.
+//----------------------------------------------------------------------
+
+void
+AddrSpace::WriteBack(Mapping *m, int vpn, int frame)
+{
+    int page = vpn - m->firstPage;
+
+    ASSERT(m->segment == NULL);
+    m->file->WriteAt(&(kernel->machine->mainMemory[frame * PageSize]),
+		min(PageSize, m->length - page * PageSize),
+		m->offset + page * PageSize);
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::RemoveMapping
+// 	Remove the pages of mapping "m" from the page table, write back
+//	and free those of a file that are in memory, drop the reference
+//	to a segment, and delete "m".
+//----------------------------------------------------------------------
+
+void
+AddrSpace::RemoveMapping(Mapping *m)
+{
+    for (int vpn = m->firstPage; vpn < m->firstPage + m->numPages; vpn++) {
+	TranslationEntry *entry = pageTable->Lookup(vpn);
+
+	mapping[vpn - numPages] = NULL;
+	if (entry == NULL)
+	    continue;
+	kernel->memoryManager->FlushTLB(pageTable->Id(), vpn);
+	if (m->segment == NULL) {
+	    int frame = entry->physicalPage;
+
+	    if (entry->dirty)
+		WriteBack(m, vpn, frame);
+	    kernel->memoryManager->FreeFrame(frame);
+	}
+	pageTable->Remove(vpn);
+    }
+    if (m->segment != NULL)
+	kernel->memoryManager->DetachSegment(m->segment);
+    delete m;
 }
 
 //----------------------------------------------------------------------
@@ -252,13 +1028,12 @@ AddrSpace::InitRegisters()
 // 	On a context switch, save any machine state, specific
 //	to this address space, that needs saving.
 //
-//	For now, don't need to save anything!
+//	For now, don't need to save anything!  The page table is
+//	changed in place, so the machine's pointer to it is never stale.
 //----------------------------------------------------------------------
 
 void AddrSpace::SaveState() 
 {
-	pageTable = kernel->machine->pageTable;
-    numPages = kernel->machine->pageTableSize;
 }
 
 //----------------------------------------------------------------------
@@ -266,13 +1041,30 @@ void AddrSpace::SaveState()
 // 	On a context switch, restore the machine state so that
 //	this address space can run.
 //
-//      For now, tell the machine where to find the page table.
+//      For now, tell the machine where to find the page table.  A
+//	linear one it can index directly; any other it has to ask.
+//
+//	With a TLB, the machine uses no page table at all, only the TLB,
+//	which the kernel fills on misses.  The TLB is not flushed: its
+//	entries are tagged with their address space's id, so only this
+//	address space's entries match once the machine is told its id.
 //----------------------------------------------------------------------
 
 void AddrSpace::RestoreState() 
 {
-    kernel->machine->pageTable = pageTable;
-    kernel->machine->pageTableSize = numPages;
+    kernel->machine->pageTable = NULL;
+    kernel->machine->pageTableSize = (numPages > 0) ? numPages + MapPages : 0;
+    kernel->machine->pageMap = NULL;
+    if (pageTable == NULL)
+	return;				// nothing loaded
+    if (kernel->machine->tlb != NULL) {
+	kernel->machine->asid = pageTable->Id();
+	return;
+    }
+    if (pageTable->Kind() == LinearPageTable)
+	kernel->machine->pageTable = pageTable->Linear();
+    else
+	kernel->machine->pageMap = pageTable;
 }
 
 
@@ -292,11 +1084,14 @@ AddrSpace::Translate(unsigned int vaddr, unsigned int *paddr, int isReadWrite)
     unsigned int      vpn    = vaddr / PageSize;
     unsigned int      offset = vaddr % PageSize;
 
-    if(vpn >= numPages) {
+    if(vpn >= numPages + MapPages) {
         return AddressErrorException;
     }
 
-    pte = &pageTable[vpn];
+    pte = pageTable->Lookup(vpn);
+    if (pte == NULL) {
+        return PageFaultException;
+    }
 
     if(isReadWrite && pte->readOnly) {
         return ReadOnlyException;
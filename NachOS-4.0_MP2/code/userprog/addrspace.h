@@ -15,8 +15,30 @@
 
 #include "copyright.h"
 #include "filesys.h"
+#include "noff.h"
+#include "pagetable.h"
+#include "list.h"
+
+class SharedImage;
+class SharedSegment;
 
 #define UserStackSize		1024 	// increase this as necessary!
+#define MapPages		32	// virtual pages above the stack, for
+					// shared segments and mapped files
+
+// One range of the map region: all of a shared segment, or part of a
+// file.  File pages are read in when first touched, and written back
+// (if they were modified) when evicted or unmapped.
+
+class Mapping {
+  public:
+    int firstPage;		// its first virtual page
+    int numPages;
+    SharedSegment *segment;	// the segment mapped, or NULL
+    OpenFile *file;		// else the file mapped,
+    int offset;			// the byte of it mapped at firstPage,
+    int length;			// and the number of bytes mapped
+};
 
 class AddrSpace {
   public:
@@ -33,6 +55,28 @@ class AddrSpace {
 
     void SaveState();			// Save/restore address space-specific
     void RestoreState();		// info on a context switch 
+
+    bool PageIn(int vpn);		// Bring page "vpn" into memory, on
+					// a page fault
+    bool RefillTLB(int vpn);		// Load page "vpn" into the TLB, on
+					// a TLB miss
+    bool CopyOnWrite(int vpn);		// Give page "vpn" a private copy, on
+					// a write to a shared or zero page
+    void PageOut(int vpn);		// Evict page "vpn" from memory
+    bool Clean(int vpn);		// Write page "vpn" out if it is
+					// dirty, leaving it in memory
+
+    int CreateSegment(int size);	// Make a shared segment of "size"
+					// bytes; return its id, or -1
+    int AttachSegment(int id);		// Map shared segment "id"; return
+					// its address, or -1
+    int MapFile(OpenFile *file, int offset, int length);
+					// Map "length" bytes of "file" from
+					// "offset"; return the address, or -1
+    bool Unmap(int addr);		// Remove the mapping at "addr"
+    void Release();			// Give back our private frames and
+					// swap now, as the program exits;
+					// the rest goes when we are deleted
     
 
     // Translate virtual address _vaddr_
@@ -40,7 +84,8 @@ class AddrSpace {
     // is 0 for Read, 1 for Write.
     ExceptionType Translate(unsigned int vaddr, unsigned int *paddr, int mode);
 
-	TranslationEntry *pageTable;	// Assume linear page table translation
+    PageTable *pageTable;		// translation of our pages that are
+					// in memory
 
   private:
     
@@ -51,6 +96,49 @@ class AddrSpace {
     void InitRegisters();		// Initialize user-level CPU registers,
 					// before jumping to user code
 
+    void CopySegment(Segment *seg, int vpn, char *dest);
+					// Copy the part of an executable
+					// segment in page "vpn" to "dest"
+
+    OpenFile *executable;		// where unmodified pages come from
+    NoffHeader noffH;			// layout of the executable
+    char *initData;			// its initialized data, expanded, if
+					// it is compressed; else NULL (the
+					// SharedImage owns it)
+    int *swapSector;			// swap sector reserved for each page
+    bool *onSwap;			// has the page been written to swap?
+    SharedImage *image;			// pages shared with other address
+					// spaces running the same program
+    bool *shared;			// is the page mapped from "image"?
+    bool *zeroMapped;			// is the page mapped to the frame
+					// of zeroes?
+
+    bool IsShareable(int vpn);		// does page "vpn" come only from
+					// the executable?
+    bool IsZeroFill(int vpn);		// does it hold nothing from the
+					// executable?
+    void Prefetch(int vpn);		// Read in the pages after "vpn"
+					// that follow it on swap
+    void FillFromFile(int vpn, char *dest);
+					// Read page "vpn" from the executable
+    bool ExpandInitData();		// Expand compressed data, if any
+
+    Mapping *mapping[MapPages];		// the mapping each page of the map
+					// region (from page numPages) is
+					// part of, or NULL
+    List<SharedSegment *> *created;	// segments we made, which live at
+					// least as long as we do
+    int AddMapping(Mapping *m);		// Place "m" in the map region;
+					// return its address, or -1
+    bool MapIn(int vpn);		// Fault in a page of a mapping
+
+    bool released;			// have the frames and swap of our
+					// pages been given back?
+    void FreePages();			// Give them back
+    void WriteBack(Mapping *m, int vpn, int frame);
+					// Write a mapped file page back
+    void RemoveMapping(Mapping *m);	// Unmap and delete "m"
+
 };
 
 #endif // ADDRSPACE_H
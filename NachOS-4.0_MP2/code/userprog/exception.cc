@@ -25,6 +25,108 @@
 #include "main.h"
 #include "syscall.h"
 #include "ksyscall.h"
+#include "memops.h"
+
+// The longest program or file name a system call takes, counting the null
+
+const int MaxNameLength = 128;
+
+//----------------------------------------------------------------------
+// UserToPhys
+// 	Translate user virtual address "vaddr" to a physical address in
+//	"*paddr", for a read, or for a write if "writing", as the
+//	program's own access would: faulting the page in, and giving it a
+//	copy of its own if it is shared.  Returns FALSE if the program
+//	couldn't make the access itself.
+//----------------------------------------------------------------------
+
+static bool
+UserToPhys(int vaddr, unsigned int *paddr, bool writing)
+{
+    AddrSpace *space = kernel->currentThread->space;
+
+    for (int tries = 0; tries < 3; tries++) {	// fault, then copy
+	ExceptionType e = space->Translate(vaddr, paddr, writing ? 1 : 0);
+
+	if (e == NoException)
+	    return TRUE;
+	if (e == PageFaultException) {
+	    if (!space->PageIn(vaddr / PageSize))
+		return FALSE;
+	} else if (e == ReadOnlyException) {
+	    if (!space->CopyOnWrite(vaddr / PageSize))
+		return FALSE;
+	} else {
+	    return FALSE;
+	}
+    }
+    return FALSE;
+}
+
+//----------------------------------------------------------------------
+// CopyIn, CopyOut
+// 	Copy "size" bytes from user virtual address "userAddr" into the
+//	kernel's "buffer", or from "buffer" out to "userAddr", a page at
+//	a time.  Returns FALSE if any of the user's bytes aren't valid.
+//----------------------------------------------------------------------
+
+static bool
+CopyIn(int userAddr, char *buffer, int size)
+{
+    while (size > 0) {
+	unsigned int paddr;
+	int n = min(size, PageSize - (int) ((unsigned int) userAddr % PageSize));
+
+	if (!UserToPhys(userAddr, &paddr, FALSE))
+	    return FALSE;
+	MemCopy(buffer, &(kernel->machine->mainMemory[paddr]), n);
+	userAddr += n;
+	buffer += n;
+	size -= n;
+    }
+    return TRUE;
+}
+
+static bool
+CopyOut(char *buffer, int userAddr, int size)
+{
+    while (size > 0) {
+	unsigned int paddr;
+	int n = min(size, PageSize - (int) ((unsigned int) userAddr % PageSize));
+
+	if (!UserToPhys(userAddr, &paddr, TRUE))
+	    return FALSE;
+	MemCopy(&(kernel->machine->mainMemory[paddr]), buffer, n);
+	userAddr += n;
+	buffer += n;
+	size -= n;
+    }
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// CopyInString
+// 	Copy the null-terminated string at user virtual address
+//	"userAddr" into "buffer", which holds "size" bytes, faulting its
+//	pages in as need be.  Returns FALSE if the address isn't valid, or
+//	the string doesn't fit.
+//----------------------------------------------------------------------
+
+static bool
+CopyInString(int userAddr, char *buffer, int size)
+{
+    for (int i = 0; i < size; i++) {
+	unsigned int paddr;
+
+	if (!UserToPhys(userAddr + i, &paddr, FALSE))
+	    return FALSE;
+	buffer[i] = kernel->machine->mainMemory[paddr];
+	if (buffer[i] == '\0')
+	    return TRUE;
+    }
+    return FALSE;
+}
+
 //----------------------------------------------------------------------
 // ExceptionHandler
 // 	Entry point into the Nachos kernel.  Called when a user program
@@ -69,8 +171,10 @@ ExceptionHandler(ExceptionType which)
 			DEBUG(dbgSys, "Message received.\n");
 			val = kernel->machine->ReadRegister(4);
 			{
-			char *msg = &(kernel->machine->mainMemory[val]);
-			cout << msg << endl;
+			char msg[MaxNameLength];
+
+			if (CopyInString(val, msg, MaxNameLength))
+				cout << msg << endl;
 			}
 
 			/*kernel->machine->WriteRegister(PrevPCReg, kernel->machine->ReadRegister(PCReg));
@@ -83,9 +187,12 @@ ExceptionHandler(ExceptionType which)
 		case SC_Create:
 			val = kernel->machine->ReadRegister(4);
 			{
-			char *filename = &(kernel->machine->mainMemory[val]);
-			//cout << filename << endl;
-			status = SysCreate(filename);
+			char filename[MaxNameLength];
+
+			if (CopyInString(val, filename, MaxNameLength))
+				status = SysCreate(filename);
+			else
+				status = 0;
 			kernel->machine->WriteRegister(2, (int) status);
 			}
 			kernel->machine->WriteRegister(PrevPCReg, kernel->machine->ReadRegister(PCReg));
@@ -97,8 +204,12 @@ ExceptionHandler(ExceptionType which)
 		case SC_Open:
 			val = kernel->machine->ReadRegister(4); //get filename
 			{
-				char *filename = &(kernel->machine->mainMemory[val]);
-				status = SysOpen(filename);
+				char filename[MaxNameLength];
+
+				if (CopyInString(val, filename, MaxNameLength))
+					status = SysOpen(filename);
+				else
+					status = -1;
 				kernel->machine->WriteRegister(2, (int) status);
 			}
 
@@ -126,9 +237,15 @@ ExceptionHandler(ExceptionType which)
 			Buffersize = kernel->machine->ReadRegister(5);
 			fileId = kernel->machine->ReadRegister(6);
 			{
-				char *buffer = &(kernel->machine->mainMemory[val]);
-				int numWritten = 0;
-				numWritten = SysWrite(buffer, Buffersize, fileId);
+				int numWritten = -1;
+
+				if (Buffersize >= 0) {
+					char *buffer = new char[Buffersize];
+
+					if (CopyIn(val, buffer, Buffersize))
+						numWritten = SysWrite(buffer, Buffersize, fileId);
+					delete [] buffer;
+				}
 				kernel->machine->WriteRegister(2, (int) numWritten);
 			}
 
@@ -146,9 +263,16 @@ ExceptionHandler(ExceptionType which)
 				char *buffer;
 				
 				buffer = SysRead(Buffersize, fileId);
-				strcpy(&kernel->machine->mainMemory[val], buffer);
+				if (buffer == NULL) {
+					kernel->machine->WriteRegister(2, -1);
+				} else {
+					int length = strlen(buffer);
 
-				kernel->machine->WriteRegister(2, strlen(buffer));
+					if (!CopyOut(buffer, val, length + 1))	// and the null
+						length = -1;
+					free(buffer);
+					kernel->machine->WriteRegister(2, length);
+				}
 			}
 
 			kernel->machine->WriteRegister(PrevPCReg, kernel->machine->ReadRegister(PCReg));
@@ -157,6 +281,48 @@ ExceptionHandler(ExceptionType which)
 			return;
 			ASSERTNOTREACHED();
             break;
+		case SC_ShmCreate:		// size
+			status = SysShmCreate(kernel->machine->ReadRegister(4));
+			kernel->machine->WriteRegister(2, (int) status);
+
+			kernel->machine->WriteRegister(PrevPCReg, kernel->machine->ReadRegister(PCReg));
+			kernel->machine->WriteRegister(PCReg, kernel->machine->ReadRegister(PCReg) + 4);
+			kernel->machine->WriteRegister(NextPCReg, kernel->machine->ReadRegister(PCReg)+4);
+			return;
+			ASSERTNOTREACHED();
+            break;
+		case SC_ShmAttach:		// segment id
+			status = SysShmAttach(kernel->machine->ReadRegister(4));
+			kernel->machine->WriteRegister(2, (int) status);
+
+			kernel->machine->WriteRegister(PrevPCReg, kernel->machine->ReadRegister(PCReg));
+			kernel->machine->WriteRegister(PCReg, kernel->machine->ReadRegister(PCReg) + 4);
+			kernel->machine->WriteRegister(NextPCReg, kernel->machine->ReadRegister(PCReg)+4);
+			return;
+			ASSERTNOTREACHED();
+            break;
+		case SC_Mmap:		// fileId, offset, len
+			status = SysMmap(kernel->machine->ReadRegister(4),
+				kernel->machine->ReadRegister(5),
+				kernel->machine->ReadRegister(6));
+			kernel->machine->WriteRegister(2, (int) status);
+
+			kernel->machine->WriteRegister(PrevPCReg, kernel->machine->ReadRegister(PCReg));
+			kernel->machine->WriteRegister(PCReg, kernel->machine->ReadRegister(PCReg) + 4);
+			kernel->machine->WriteRegister(NextPCReg, kernel->machine->ReadRegister(PCReg)+4);
+			return;
+			ASSERTNOTREACHED();
+            break;
+		case SC_Munmap:		// address
+			status = SysMunmap(kernel->machine->ReadRegister(4));
+			kernel->machine->WriteRegister(2, (int) status);
+
+			kernel->machine->WriteRegister(PrevPCReg, kernel->machine->ReadRegister(PCReg));
+			kernel->machine->WriteRegister(PCReg, kernel->machine->ReadRegister(PCReg) + 4);
+			kernel->machine->WriteRegister(NextPCReg, kernel->machine->ReadRegister(PCReg)+4);
+			return;
+			ASSERTNOTREACHED();
+            break;
 		case SC_PrintInt:
 			val = kernel->machine->ReadRegister(4);
 
@@ -200,18 +366,69 @@ ExceptionHandler(ExceptionType which)
 			cout << "result is " << result << "\n";	
 			return;	
 			ASSERTNOTREACHED();
+            break;
+		case SC_Exec:
+			val = kernel->machine->ReadRegister(4);
+			{
+				char name[MaxNameLength];
+
+				if (CopyInString(val, name, MaxNameLength))
+					status = SysExec(name);
+				else
+					status = -1;
+				kernel->machine->WriteRegister(2, (int) status);
+			}
+
+			kernel->machine->WriteRegister(PrevPCReg, kernel->machine->ReadRegister(PCReg));
+			kernel->machine->WriteRegister(PCReg, kernel->machine->ReadRegister(PCReg) + 4);
+			kernel->machine->WriteRegister(NextPCReg, kernel->machine->ReadRegister(PCReg)+4);
+			return;
+			ASSERTNOTREACHED();
+            break;
+		case SC_Join:
+			status = SysJoin(kernel->machine->ReadRegister(4));
+			kernel->machine->WriteRegister(2, (int) status);
+
+			kernel->machine->WriteRegister(PrevPCReg, kernel->machine->ReadRegister(PCReg));
+			kernel->machine->WriteRegister(PCReg, kernel->machine->ReadRegister(PCReg) + 4);
+			kernel->machine->WriteRegister(NextPCReg, kernel->machine->ReadRegister(PCReg)+4);
+			return;
+			ASSERTNOTREACHED();
             break;
 		case SC_Exit:
 			DEBUG(dbgAddr, "Program exit\n");
             val=kernel->machine->ReadRegister(4);
             cout << "return value:" << val << endl;
-			kernel->currentThread->Finish();
+			SysExit(val);
             break;
       	default:
 			cerr << "Unexpected system call " << type << "\n";
 			break;
 		}
 		break;
+	case PageFaultException:
+		val = kernel->machine->ReadRegister(BadVAddrReg);
+		if (kernel->machine->tlb != NULL) {	// a TLB miss
+			if (!kernel->currentThread->space->RefillTLB(val / PageSize)) {
+				cerr << "Bad page fault at " << val << "\n";
+				SysExit(-1);
+			}
+		} else if (!kernel->currentThread->space->PageIn(val / PageSize)) {
+			cerr << "Bad page fault at " << val << "\n";
+			SysExit(-1);
+		}
+		return;			// re-execute the faulting instruction
+		ASSERTNOTREACHED();
+		break;
+	case ReadOnlyException:
+		val = kernel->machine->ReadRegister(BadVAddrReg);
+		if (!kernel->currentThread->space->CopyOnWrite(val / PageSize)) {
+			cerr << "Write to read-only page at " << val << "\n";
+			SysExit(-1);
+		}
+		return;			// re-execute the faulting instruction
+		ASSERTNOTREACHED();
+		break;
 	default:
 		cerr << "Unexpected user mode exception " << (int)which << "\n";
 		break;
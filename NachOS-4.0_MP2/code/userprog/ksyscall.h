@@ -62,4 +62,42 @@ char* SysRead(int size, int id)
 {
 	return kernel->interrupt->ReadFile(size, id);
 }
+
+int SysShmCreate(int size)
+{
+  return kernel->currentThread->space->CreateSegment(size);
+}
+
+int SysShmAttach(int id)
+{
+  return kernel->currentThread->space->AttachSegment(id);
+}
+
+int SysMmap(int id, int offset, int length)
+{
+  OpenFile *file = kernel->fileSystem->FileOf(id);
+
+  if (file == NULL) return -1;
+  return kernel->currentThread->space->MapFile(file, offset, length);
+}
+
+int SysMunmap(int addr)
+{
+  return kernel->currentThread->space->Unmap(addr) ? 1 : 0;
+}
+
+int SysExec(char *name)
+{
+  return kernel->Exec(name);
+}
+
+int SysJoin(int id)
+{
+  return kernel->Join(id);
+}
+
+void SysExit(int status)
+{
+  kernel->ExitProcess(status);
+}
 #endif /* ! __USERPROG_KSYSCALL_H__ */
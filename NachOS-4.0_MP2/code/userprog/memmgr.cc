@@ -0,0 +1,987 @@
+// memmgr.cc
+//	Routines to allocate physical page frames and swap sectors,
+//	and to pick a page to evict when memory is full.
+//
+// Copyright (c) 1992-1996 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "main.h"
+#include "memmgr.h"
+#include "addrspace.h"
+#include "synch.h"
+#include "disk.h"
+#include "synchdisk.h"
+#include "memops.h"
+
+//----------------------------------------------------------------------
+// MemoryManager::MemoryManager
+// 	Initialize the memory manager; every frame and swap sector
+//	starts out free, except the last frame, which is kept as the
+//	frame of zeroes.  Main memory starts out zeroed, so every free
+//	frame is known to be zeroed already.
+//
+//	The reaper thread is started, and with WSClockReplace, the page
+//	cleaner thread too.
+//
+//	"policy" is how to choose a page to evict
+//	"clusterPages" is how many pages after a faulting one to read in
+//		with it, if they are next to it on swap
+//	"residentLimit" is the most frames one address space may have
+//		of its own, or 0 for no limit
+//----------------------------------------------------------------------
+
+static void
+PageCleaner(MemoryManager *memoryManager)
+{
+    memoryManager->CleanPages();
+}
+
+static void
+Reaper(MemoryManager *memoryManager)
+{
+    memoryManager->ReapSpaces();
+}
+
+MemoryManager::MemoryManager(ReplacementPolicy replacePolicy,
+				int numClusterPages, int maxResident)
+{
+    policy = replacePolicy;
+    clusterPages = numClusterPages;
+    residentLimit = maxResident;
+    frames = new FrameInfo[NumPhysPages];
+    for (int i = 0; i < NumPhysPages; i++) {
+	frames[i].owner = NULL;
+	frames[i].virtualPage = -1;
+	frames[i].age = 0;
+	frames[i].shareCount = 0;
+	frames[i].lastUse = 0;
+	frames[i].queued = FALSE;
+	frames[i].zeroed = TRUE;
+    }
+    usedFrames = new Bitmap(NumPhysPages);
+    zeroFrame = NumPhysPages - 1;
+    usedFrames->Mark(zeroFrame);
+    frames[zeroFrame].shareCount = 1;	// pinned
+    frames[zeroFrame].zeroed = FALSE;	// not free
+    kernel->stats->numFramesInUse = kernel->stats->peakFramesInUse = 1;
+    sectorsPerPage = PageSize / SectorSize;
+    swapMap = new Bitmap(NumSectors / sectorsPerPage);
+    hand = 0;
+    numShared = 1;			// the frame of zeroes
+    images = new List<SharedImage *>;
+    numIdle = 0;
+    segments = new List<SharedSegment *>;
+    nextSegmentId = 1;
+    faultLock = new Lock("page fault");
+    toClean = new List<int>;
+    cleanerWake = new Semaphore("page cleaner", 0);
+    retired = new List<AddrSpace *>;
+    reaperWake = new Semaphore("reaper", 0);
+    swapFreed = new Semaphore("swap freed", 0);
+    numSwapWaiters = 0;
+    tlbSource = new TranslationEntry *[max(TLBSize, 1)];
+    tlbHand = 0;
+    if (policy == WSClockReplace) {
+	Thread *cleaner = new Thread("page cleaner", 1);
+
+	cleaner->Fork((VoidFunctionPtr) PageCleaner, (void *) this);
+    }
+    Thread *reaper = new Thread("reaper", 1);
+
+    reaper->Fork((VoidFunctionPtr) Reaper, (void *) this);
+}
+
+//----------------------------------------------------------------------
+// MemoryManager::~MemoryManager
+// 	De-allocate the memory manager.
+//----------------------------------------------------------------------
+
+MemoryManager::~MemoryManager()
+{
+    delete [] frames;
+    delete usedFrames;
+    delete swapMap;
+    while (!images->IsEmpty()) {
+	SharedImage *image = images->RemoveFront();
+
+	if (image->refCount == 0)	// else its address space has it
+	    delete image;
+    }
+    delete images;
+    delete segments;
+    delete faultLock;
+    delete toClean;
+    delete cleanerWake;
+    delete retired;			// what's left is lost with the
+    delete reaperWake;			// machine
+    delete swapFreed;
+    delete [] tlbSource;
+}
+
+//----------------------------------------------------------------------
+// MemoryManager::AllocFrame
+// 	Find a physical frame to hold page "virtualPage" of "owner".
+//	If none is free, evict a page chosen by the replacement policy;
+//	its owner writes it out to swap if need be (which may block).
+//
+//	If "owner" already has as many frames as its resident set limit
+//	allows, one of its own pages is evicted instead, even if other
+//	frames are free, so one large program cannot crowd out the rest.
+//
+//	The frame is recorded as belonging to its new owner before the
+//	old page is written out, so the old owner may exit in the meantime
+//	without freeing it.
+//
+//	Must be called with faultLock held.
+//----------------------------------------------------------------------
+
+int
+MemoryManager::AllocFrame(AddrSpace *owner, int virtualPage)
+{
+    int frame = AllocFreeFrame(owner, virtualPage);
+    AddrSpace *victim;
+    int victimPage;
+
+    if (frame != -1) {
+	return frame;
+    }
+    kernel->stats->numEvictions++;
+    if (AtLimit(owner)) {
+	kernel->stats->numLocalEvictions++;
+	frame = FindVictim(owner);
+    } else {
+	frame = FindVictim(NULL);
+    }
+    victim = frames[frame].owner;
+    victimPage = frames[frame].virtualPage;
+    DEBUG(dbgAddr, "Evicting page " << victimPage << " from frame " << frame);
+    frames[frame].owner = owner;
+    frames[frame].virtualPage = virtualPage;
+    frames[frame].age = 0;
+    frames[frame].lastUse = kernel->stats->totalTicks;
+    victim->PageOut(victimPage);
+    return frame;
+}
+
+//----------------------------------------------------------------------
+// MemoryManager::AllocFreeFrame
+// 	Find a free physical frame to hold page "virtualPage" of
+//	"owner", or return -1 if every frame is in use, or "owner" is at
+//	its resident set limit.  This is for reading pages in ahead,
+//	which should never evict a page.
+//
+//	A frame that was zeroed ahead of time is only taken if
+//	"wantZeroed" (or no other is free), so they are kept for pages
+//	that need zeroes; the caller must clear FrameInfo::zeroed.
+//
+//	Must be called with faultLock held.
+//----------------------------------------------------------------------
+
+int
+MemoryManager::AllocFreeFrame(AddrSpace *owner, int virtualPage,
+				bool wantZeroed)
+{
+    Statistics *stats = kernel->stats;
+    int frame = -1;
+
+    ASSERT(faultLock->IsHeldByCurrentThread());
+    if (AtLimit(owner))
+	return -1;
+    for (int i = 0; i < NumPhysPages; i++) {
+	if (usedFrames->Test(i))
+	    continue;
+	if (frames[i].zeroed == wantZeroed) {
+	    frame = i;
+	    break;
+	}
+	if (frame == -1)
+	    frame = i;
+    }
+    if (frame != -1) {
+	usedFrames->Mark(frame);
+	if (!wantZeroed)
+	    frames[frame].zeroed = FALSE;
+	frames[frame].owner = owner;
+	frames[frame].virtualPage = virtualPage;
+	frames[frame].age = 0;
+	frames[frame].lastUse = stats->totalTicks;
+	if (++stats->numFramesInUse > stats->peakFramesInUse)
+	    stats->peakFramesInUse = stats->numFramesInUse;
+    }
+    return frame;
+}
+
+//----------------------------------------------------------------------
+// MemoryManager::AllocZeroedFrame
+// 	Find a physical frame of zeroes for page "virtualPage" of
+//	"owner", as AllocFrame does.  A free frame that was zeroed ahead
+//	of time is used if there is one; otherwise the frame is zeroed
+//	now.
+//
+//	Must be called with faultLock held.
+//----------------------------------------------------------------------
+
+int
+MemoryManager::AllocZeroedFrame(AddrSpace *owner, int virtualPage)
+{
+    int frame = AllocFreeFrame(owner, virtualPage, TRUE);
+
+    if (frame != -1 && frames[frame].zeroed) {
+	frames[frame].zeroed = FALSE;
+	kernel->stats->numPreZeroed++;
+	return frame;
+    }
+    if (frame == -1)
+	frame = AllocFrame(owner, virtualPage);
+    MemZero(&(kernel->machine->mainMemory[frame * PageSize]), PageSize);
+    return frame;
+}
+
+//----------------------------------------------------------------------
+// MemoryManager::ZeroFreeFrames
+// 	Zero every free frame that isn't already, so AllocZeroedFrame
+//	finds them ready.  Called when there is no thread to run, so it
+//	costs nothing; interrupts are off, so no one can take a frame
+//	while it is zeroed.
+//----------------------------------------------------------------------
+
+void
+MemoryManager::ZeroFreeFrames()
+{
+    for (int i = 0; i < NumPhysPages; i++) {
+	if (!usedFrames->Test(i) && !frames[i].zeroed) {
+	    MemZero(&(kernel->machine->mainMemory[i * PageSize]), PageSize);
+	    frames[i].zeroed = TRUE;
+	}
+    }
+}
+
+//----------------------------------------------------------------------
+// MemoryManager::AtLimit
+// 	Return TRUE if "owner" has as many frames of its own (not counting
+//	those it shares) as the resident set limit allows.  Kernel owned
+//	frames (owner NULL) have no limit.
+//----------------------------------------------------------------------
+
+bool
+MemoryManager::AtLimit(AddrSpace *owner)
+{
+    int resident = 0;
+
+    if (owner == NULL || residentLimit <= 0)
+	return FALSE;
+    for (int i = 0; i < NumPhysPages; i++) {
+	if (frames[i].owner == owner && frames[i].shareCount == 0)
+	    resident++;
+    }
+    return resident >= residentLimit;
+}
+
+//----------------------------------------------------------------------
+// MemoryManager::FreeFrame
+// 	Return a physical frame to the free pool, e.g., when its owner
+//	exits.
+//----------------------------------------------------------------------
+
+void
+MemoryManager::FreeFrame(int frame)
+{
+    ASSERT(frame >= 0 && frame < NumPhysPages);
+    frames[frame].owner = NULL;
+    frames[frame].virtualPage = -1;
+    usedFrames->Clear(frame);
+    kernel->stats->numFramesInUse--;
+}
+
+//----------------------------------------------------------------------
+// MemoryManager::FreeFrames
+// 	Return to the free pool every frame holding one of the first
+//	"numPages" pages of "owner" -- its private pages, not the shared
+//	ones (which have no owner) nor those of its mappings -- as it
+//	exits.  One sweep of the frame table finds them, and each run
+//	of them is cleared from the bitmap at once.
+//----------------------------------------------------------------------
+
+void
+MemoryManager::FreeFrames(AddrSpace *owner, int numPages)
+{
+    int first = -1;
+    int freed = 0;
+
+    for (int i = 0; i <= NumPhysPages; i++) {
+	if (i < NumPhysPages && frames[i].owner == owner
+		&& frames[i].shareCount == 0
+		&& frames[i].virtualPage < numPages) {
+	    frames[i].owner = NULL;
+	    frames[i].virtualPage = -1;
+	    if (first == -1)
+		first = i;
+	} else if (first != -1) {
+	    usedFrames->ClearRange(first, i - first);
+	    freed += i - first;
+	    first = -1;
+	}
+    }
+    kernel->stats->numFramesInUse -= freed;
+}
+
+//----------------------------------------------------------------------
+// MemoryManager::AllocSwap
+// 	Return the first sector of a free page of swap space (a page may
+//	take several sectors), or -1 if swap is full.
+//----------------------------------------------------------------------
+
+int
+MemoryManager::AllocSwap()
+{
+    int slot = swapMap->FindAndSet();
+
+    return (slot == -1) ? -1 : slot * sectorsPerPage;
+}
+
+//----------------------------------------------------------------------
+// MemoryManager::FreeSwap
+// 	Return a page of swap space, from AllocSwap, to the free pool.
+//----------------------------------------------------------------------
+
+void
+MemoryManager::FreeSwap(int sector)
+{
+    swapMap->Clear(sector / sectorsPerPage);
+    if (numSwapWaiters > 0) {		// wake one to look again
+	numSwapWaiters--;
+	swapFreed->V();
+    }
+}
+
+//----------------------------------------------------------------------
+// MemoryManager::FreeSwapPages
+// 	Return "count" pages of swap, whose first sectors are in
+//	"sectors", to the free pool.  Pages reserved one after the other
+//	are mostly next to each other, so they are cleared a run at a
+//	time; those waiting for swap are woken once, as many as pages
+//	were freed.
+//----------------------------------------------------------------------
+
+void
+MemoryManager::FreeSwapPages(int *sectors, int count)
+{
+    int i = 0;
+
+    while (i < count) {
+	int first = sectors[i] / sectorsPerPage;
+	int run = 1;
+
+	while (i + run < count
+		&& sectors[i + run] / sectorsPerPage == first + run)
+	    run++;
+	swapMap->ClearRange(first, run);
+	i += run;
+    }
+    for (; count > 0 && numSwapWaiters > 0; count--) {
+	numSwapWaiters--;
+	swapFreed->V();
+    }
+}
+
+//----------------------------------------------------------------------
+// MemoryManager::WaitForSwap
+// 	Wait until "numPages" pages of swap are free, for a program about
+//	to be loaded -- as other programs exit, and give theirs back.
+//	Returns FALSE at once if the swap area is not that big at all.
+//
+//	Nothing is reserved: the caller must allocate the pages before
+//	it can block again.
+//----------------------------------------------------------------------
+
+bool
+MemoryManager::WaitForSwap(int numPages)
+{
+    if (numPages > NumSectors / sectorsPerPage)
+	return FALSE;
+    if (swapMap->NumClear() < numPages) {
+	DEBUG(dbgAddr, "Waiting for " << numPages << " pages of swap");
+	kernel->stats->numDelayedLaunches++;
+    }
+    while (swapMap->NumClear() < numPages) {
+	numSwapWaiters++;
+	swapFreed->P();
+    }
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// MemoryManager::ReadSwap, MemoryManager::WriteSwap
+// 	Read or write the page of swap space starting at "sector", from
+//	or to "data", one sector at a time.
+//----------------------------------------------------------------------
+
+void
+MemoryManager::ReadSwap(int sector, char *data)
+{
+    for (int i = 0; i < sectorsPerPage; i++)
+	kernel->synchDisk->ReadSector(sector + i, data + i * SectorSize);
+}
+
+void
+MemoryManager::WriteSwap(int sector, char *data)
+{
+    for (int i = 0; i < sectorsPerPage; i++)
+	kernel->synchDisk->WriteSector(sector + i, data + i * SectorSize);
+}
+
+//----------------------------------------------------------------------
+// MemoryManager::FindVictim
+// 	Choose a frame to evict.  Every frame is in use when this is
+//	called (or "only" is at its resident set limit).  If "only" is
+//	not NULL, the frame must be one of its own.
+//
+//	Frames shared by a SharedImage are skipped; there must be at
+//	least one frame that is not shared.
+//
+//	FIFOReplace -- frames are taken in turn, which evicts the pages
+//		in the order they were brought in once memory is full
+//	ClockReplace -- as FIFO, but a page whose use bit is set gets
+//		a second chance (the bit is cleared and it is skipped)
+//	LRUReplace -- every frame's age is shifted right and the use bit
+//		moved into its top bit; the page with the smallest age
+//		has gone longest without being referenced
+//	WSClockReplace -- as clock, but a page whose use bit is set is
+//		noted as used now, and a page not used for WorkingSetTicks
+//		(out of the working set) is taken only if it is clean; if
+//		it is dirty, it is given to the page cleaner and skipped.
+//		If two turns of the hand find nothing, the page used
+//		longest ago is taken, preferring a clean one.
+//----------------------------------------------------------------------
+
+int
+MemoryManager::FindVictim(AddrSpace *only)
+{
+    int victim;
+
+    ASSERT(numShared < NumPhysPages);
+    SyncTLB();				// so the use bits are current
+    switch (policy) {
+      case FIFOReplace:
+	do {
+	    victim = hand;
+	    hand = (hand + 1) % NumPhysPages;
+	} while (frames[victim].shareCount > 0
+		 || (only != NULL && frames[victim].owner != only));
+	break;
+
+      case ClockReplace:
+	for (;;) {
+	    victim = hand;
+	    hand = (hand + 1) % NumPhysPages;
+	    if (frames[victim].shareCount > 0
+			|| (only != NULL && frames[victim].owner != only))
+		continue;
+	    TranslationEntry *entry = frames[victim].owner->pageTable->Lookup(
+					frames[victim].virtualPage);
+	    if (!entry->use)
+		break;
+	    entry->use = FALSE;		// second chance
+	}
+	break;
+
+      case LRUReplace:
+	victim = -1;
+	for (int i = 0; i < NumPhysPages; i++) {
+	    if (frames[i].shareCount > 0)
+		continue;
+	    TranslationEntry *entry =
+		    frames[i].owner->pageTable->Lookup(frames[i].virtualPage);
+	    frames[i].age >>= 1;
+	    if (entry->use)
+		frames[i].age |= 0x80000000;
+	    entry->use = FALSE;
+	    if (only != NULL && frames[i].owner != only)
+		continue;
+	    if (victim == -1 || frames[i].age < frames[victim].age)
+		victim = i;
+	}
+	break;
+
+      case WSClockReplace:
+	{
+	    int now = kernel->stats->totalTicks;
+	    int fallback = -1;		// oldest seen, clean ones first
+	    bool fallbackClean = FALSE;
+
+	    victim = -1;
+	    for (int n = 0; n < 2 * NumPhysPages && victim == -1; n++) {
+		int f = hand;
+
+		hand = (hand + 1) % NumPhysPages;
+		if (frames[f].shareCount > 0
+			|| (only != NULL && frames[f].owner != only))
+		    continue;
+		TranslationEntry *entry =
+			frames[f].owner->pageTable->Lookup(frames[f].virtualPage);
+		bool clean = !entry->dirty;
+
+		if (entry->use) {
+		    entry->use = FALSE;
+		    frames[f].lastUse = now;	// in the working set
+		} else if (now - frames[f].lastUse > WorkingSetTicks) {
+		    if (clean)
+			victim = f;
+		    else
+			QueueClean(f);
+		}
+		if (fallback == -1 || (clean && !fallbackClean)
+			|| (clean == fallbackClean
+			    && frames[f].lastUse < frames[fallback].lastUse)) {
+		    fallback = f;
+		    fallbackClean = clean;
+		}
+	    }
+	    if (victim == -1)
+		victim = fallback;
+	}
+	break;
+
+      default:
+	ASSERTNOTREACHED();
+    }
+    return victim;
+}
+
+//----------------------------------------------------------------------
+// MemoryManager::LoadTLB
+// 	Handle a TLB miss on page table "entry" of address space "asid",
+//	which is valid: copy it into a free TLB entry, or into the next
+//	one in turn, after copying that one's use and dirty bits back.
+//----------------------------------------------------------------------
+
+void
+MemoryManager::LoadTLB(int asid, TranslationEntry *entry)
+{
+    TranslationEntry *tlb = kernel->machine->tlb;
+    int slot = -1;
+
+    ASSERT(tlb != NULL && entry->valid);
+    for (int i = 0; i < TLBSize && slot == -1; i++) {
+	if (!tlb[i].valid)
+	    slot = i;
+    }
+    if (slot == -1) {
+	slot = tlbHand;
+	tlbHand = (tlbHand + 1) % TLBSize;
+	tlbSource[slot]->use |= tlb[slot].use;
+	tlbSource[slot]->dirty |= tlb[slot].dirty;
+    }
+    DEBUG(dbgAddr, "TLB entry " << slot << " <- page " << entry->virtualPage
+		<< " of address space " << asid);
+    tlb[slot] = *entry;
+    tlb[slot].asid = asid;
+    tlbSource[slot] = entry;
+}
+
+//----------------------------------------------------------------------
+// MemoryManager::FlushTLB
+// 	Drop whatever copy the TLB has of page "vpn" of address space
+//	"asid" -- or of all its pages, if "vpn" is -1 -- copying its use
+//	and dirty bits back first.  This must be done before the page
+//	table entry is changed or removed.
+//----------------------------------------------------------------------
+
+void
+MemoryManager::FlushTLB(int asid, int vpn)
+{
+    TranslationEntry *tlb = kernel->machine->tlb;
+
+    if (tlb == NULL)
+	return;
+    for (int i = 0; i < TLBSize; i++) {
+	if (tlb[i].valid && tlb[i].asid == asid
+		&& (vpn == -1 || tlb[i].virtualPage == vpn)) {
+	    tlbSource[i]->use |= tlb[i].use;
+	    tlbSource[i]->dirty |= tlb[i].dirty;
+	    tlb[i].valid = FALSE;
+	}
+    }
+}
+
+//----------------------------------------------------------------------
+// MemoryManager::SyncTLB
+// 	Copy the use and dirty bits the machine has set in the TLB back
+//	to the page table entries, and clear the TLB's use bits, so that
+//	a later reference sets them again.
+//----------------------------------------------------------------------
+
+void
+MemoryManager::SyncTLB()
+{
+    TranslationEntry *tlb = kernel->machine->tlb;
+
+    if (tlb == NULL)
+	return;
+    for (int i = 0; i < TLBSize; i++) {
+	if (tlb[i].valid) {
+	    tlbSource[i]->use |= tlb[i].use;
+	    tlbSource[i]->dirty |= tlb[i].dirty;
+	    tlb[i].use = FALSE;
+	}
+    }
+}
+
+//----------------------------------------------------------------------
+// MemoryManager::QueueClean
+// 	Ask the page cleaner to write out the dirty page in "frame",
+//	unless it has been asked already.
+//----------------------------------------------------------------------
+
+void
+MemoryManager::QueueClean(int frame)
+{
+    if (frames[frame].queued)
+	return;
+    frames[frame].queued = TRUE;
+    toClean->Append(frame);
+    cleanerWake->V();
+}
+
+//----------------------------------------------------------------------
+// MemoryManager::CleanPages
+// 	The page cleaner: wait for dirty pages to be queued by
+//	FindVictim, and write each one out (to swap, or to its mapped
+//	file), leaving it in memory but clean.  A page that has been
+//	evicted or freed since it was queued is skipped; one written to
+//	again will be queued again.  Never returns.
+//
+//	Runs with faultLock held while it writes, as PageOut's caller
+//	does, so the page cannot be evicted while it is written.
+//----------------------------------------------------------------------
+
+void
+MemoryManager::CleanPages()
+{
+    for (;;) {
+	cleanerWake->P();
+	faultLock->Acquire();
+	while (!toClean->IsEmpty()) {
+	    int frame = toClean->RemoveFront();
+
+	    frames[frame].queued = FALSE;
+	    if (frames[frame].owner != NULL && frames[frame].shareCount == 0
+		    && frames[frame].owner->Clean(frames[frame].virtualPage)) {
+		DEBUG(dbgAddr, "Cleaned frame " << frame);
+		kernel->stats->numPagesCleaned++;
+	    }
+	}
+	faultLock->Release();
+    }
+}
+
+//----------------------------------------------------------------------
+// MemoryManager::Retire
+// 	Hand the address space of a program that has exited to the
+//	reaper to delete, so that whoever runs next -- often its parent,
+//	back from Join -- doesn't delete it in the thread's place.
+//	Called as the thread is deleted, with interrupts off.
+//----------------------------------------------------------------------
+
+void
+MemoryManager::Retire(AddrSpace *space)
+{
+    retired->Append(space);
+    reaperWake->V();
+}
+
+//----------------------------------------------------------------------
+// MemoryManager::ReapSpaces
+// 	The reaper: wait for address spaces to be retired, and delete
+//	each one.  Never returns.
+//
+//	Runs with faultLock held, so that no page of a space can be
+//	evicted, or cleaned, while it is deleted.
+//----------------------------------------------------------------------
+
+void
+MemoryManager::ReapSpaces()
+{
+    for (;;) {
+	reaperWake->P();
+	faultLock->Acquire();
+	while (!retired->IsEmpty())
+	    delete retired->RemoveFront();
+	faultLock->Release();
+    }
+}
+
+//----------------------------------------------------------------------
+// SharedImage::SharedImage
+// 	Initialize the (empty) set of shared pages of an executable.
+//
+//	"fileName" is the executable
+//	"numPages" is the size of an address space running it
+//----------------------------------------------------------------------
+
+SharedImage::SharedImage(char *fileName, int pages)
+{
+    name = new char[strlen(fileName) + 1];
+    strcpy(name, fileName);
+    refCount = 0;
+    numPages = pages;
+    frame = new int[numPages];
+    for (int i = 0; i < numPages; i++)
+	frame[i] = -1;
+    fileLength = -1;
+    initData = NULL;
+    stale = FALSE;
+}
+
+//----------------------------------------------------------------------
+// SharedImage::~SharedImage
+// 	De-allocate a SharedImage.  No page may still be shared.
+//----------------------------------------------------------------------
+
+SharedImage::~SharedImage()
+{
+    for (int i = 0; i < numPages; i++)
+	ASSERT(frame[i] == -1);
+    delete [] name;
+    delete [] frame;
+    delete [] initData;
+}
+
+//----------------------------------------------------------------------
+// MemoryManager::FindImage
+// 	Return the SharedImage for "fileName", counting one more user of
+//	it, if someone is running that executable or ran it lately; or
+//	NULL if no one has.  An image of a file that has since changed
+//	length is of an old version of it: it is thrown away (once no
+//	one is running it), and NULL is returned, so a new one is made.
+//----------------------------------------------------------------------
+
+SharedImage *
+MemoryManager::FindImage(char *fileName, int fileLength)
+{
+    ListIterator<SharedImage *> iter(images);
+    SharedImage *image = NULL;
+
+    for (; !iter.IsDone(); iter.Next()) {
+	if (!iter.Item()->stale && strcmp(iter.Item()->name, fileName) == 0) {
+	    image = iter.Item();
+	    break;
+	}
+    }
+    if (image == NULL)
+	return NULL;
+    if (image->fileLength != fileLength) {
+	image->stale = TRUE;
+	if (image->refCount == 0) {
+	    images->Remove(image);
+	    numIdle--;
+	    delete image;
+	}
+	return NULL;
+    }
+    if (image->refCount++ == 0) {
+	numIdle--;
+    }
+    return image;
+}
+
+//----------------------------------------------------------------------
+// MemoryManager::AttachImage
+// 	Make a SharedImage for "fileName", which FindImage has just not
+//	found, with one user.  The caller fills in what it parsed.
+//----------------------------------------------------------------------
+
+SharedImage *
+MemoryManager::AttachImage(char *fileName, int numPages)
+{
+    SharedImage *image = new SharedImage(fileName, numPages);
+
+    images->Append(image);
+    image->refCount++;
+    return image;
+}
+
+//----------------------------------------------------------------------
+// MemoryManager::DetachImage
+// 	Drop one user of a SharedImage.  When the last one leaves, the
+//	image is kept, so the program starts quickly if it is run again,
+//	unless MaxIdleImages others are kept too; then the one idle
+//	longest goes.  An image of an old version of a file goes at once.
+//	The caller must already have unmapped all of its shared pages.
+//----------------------------------------------------------------------
+
+void
+MemoryManager::DetachImage(SharedImage *image)
+{
+    ASSERT(image->refCount > 0);
+    if (--image->refCount > 0)
+	return;
+    images->Remove(image);
+    if (image->stale) {
+	delete image;
+	return;
+    }
+    images->Append(image);		// the most recently idle
+    if (++numIdle > MaxIdleImages) {
+	ListIterator<SharedImage *> iter(images);
+
+	while (iter.Item()->refCount > 0)
+	    iter.Next();
+	image = iter.Item();
+	images->Remove(image);
+	numIdle--;
+	delete image;
+    }
+}
+
+//----------------------------------------------------------------------
+// MemoryManager::MapShared
+// 	If page "vpn" of "image" is already in memory, add a mapping to
+//	it and return its frame; otherwise return -1.
+//----------------------------------------------------------------------
+
+int
+MemoryManager::MapShared(SharedImage *image, int vpn)
+{
+    int frame = image->frame[vpn];
+
+    if (frame != -1)
+	frames[frame].shareCount++;
+    return frame;
+}
+
+//----------------------------------------------------------------------
+// MemoryManager::CanShare
+// 	Return TRUE if one more frame can be pinned for a SharedImage
+//	without going over MaxSharedPercent of memory, or leaving fewer
+//	than MinUnsharedFrames.  Shared frames are
+//	never evicted, so enough of the rest must stay for the pages of
+//	every program -- however many are running the same image.
+//----------------------------------------------------------------------
+
+bool
+MemoryManager::CanShare()
+{
+    return (numShared + 1) * 100 <= NumPhysPages * MaxSharedPercent
+	    && numShared + 1 + MinUnsharedFrames <= NumPhysPages;
+}
+
+//----------------------------------------------------------------------
+// MemoryManager::AddShared
+// 	Turn "frame", just allocated by AllocFrame and filled from the
+//	executable, into the shared copy of page "vpn" of "image".  The
+//	caller's mapping is the first one.
+//----------------------------------------------------------------------
+
+void
+MemoryManager::AddShared(SharedImage *image, int vpn, int frame)
+{
+    ASSERT(image->frame[vpn] == -1 && frames[frame].shareCount == 0);
+    ASSERT(CanShare());
+    image->frame[vpn] = frame;
+    frames[frame].owner = NULL;
+    frames[frame].virtualPage = vpn;
+    frames[frame].shareCount = 1;
+    numShared++;
+}
+
+//----------------------------------------------------------------------
+// MemoryManager::UnmapShared
+// 	Drop one mapping of shared page "vpn" of "image", either because
+//	the address space is going away or because it is taking a private
+//	copy.  The frame is freed when its last mapping goes.
+//----------------------------------------------------------------------
+
+void
+MemoryManager::UnmapShared(SharedImage *image, int vpn)
+{
+    int frame = image->frame[vpn];
+
+    ASSERT(frame != -1 && frames[frame].shareCount > 0);
+    if (--frames[frame].shareCount == 0) {
+	image->frame[vpn] = -1;
+	numShared--;
+	FreeFrame(frame);
+    }
+}
+
+//----------------------------------------------------------------------
+// MemoryManager::CreateSegment
+// 	Make a shared segment of "numPages" zeroed pages, counting one
+//	reference to it for its creator.  Its frames are pinned, as the
+//	frames of a SharedImage are, so at least one frame must be left
+//	for everything else; returns NULL if there aren't enough.
+//
+//	Must be called with faultLock held, as it may evict pages.
+//----------------------------------------------------------------------
+
+SharedSegment *
+MemoryManager::CreateSegment(int numPages)
+{
+    SharedSegment *segment;
+
+    ASSERT(faultLock->IsHeldByCurrentThread());
+    if (numPages <= 0 || numShared + numPages >= NumPhysPages)
+	return NULL;
+    segment = new SharedSegment;
+    segment->id = nextSegmentId++;
+    segment->numPages = numPages;
+    segment->frame = new int[numPages];
+    segment->refCount = 1;
+    for (int i = 0; i < numPages; i++) {
+	int frame = AllocZeroedFrame(NULL, i);
+
+	frames[frame].shareCount = 1;	// pinned
+	numShared++;
+	segment->frame[i] = frame;
+    }
+    segments->Append(segment);
+    DEBUG(dbgAddr, "Created shared segment " << segment->id << ", "
+		<< numPages << " pages");
+    return segment;
+}
+
+//----------------------------------------------------------------------
+// MemoryManager::AttachSegment
+// 	Return shared segment "id", counting one more reference to it,
+//	or NULL if there is no such segment.
+//----------------------------------------------------------------------
+
+SharedSegment *
+MemoryManager::AttachSegment(int id)
+{
+    ListIterator<SharedSegment *> iter(segments);
+
+    for (; !iter.IsDone(); iter.Next()) {
+	if (iter.Item()->id == id) {
+	    iter.Item()->refCount++;
+	    return iter.Item();
+	}
+    }
+    return NULL;
+}
+
+//----------------------------------------------------------------------
+// MemoryManager::DetachSegment
+// 	Drop one reference to a shared segment; the last one to leave
+//	frees its frames.  The caller must already have removed its
+//	mappings of it.
+//----------------------------------------------------------------------
+
+void
+MemoryManager::DetachSegment(SharedSegment *segment)
+{
+    ASSERT(segment->refCount > 0);
+    if (--segment->refCount > 0)
+	return;
+    for (int i = 0; i < segment->numPages; i++) {
+	frames[segment->frame[i]].shareCount = 0;
+	numShared--;
+	FreeFrame(segment->frame[i]);
+    }
+    segments->Remove(segment);
+    delete [] segment->frame;
+    delete segment;
+}
@@ -0,0 +1,277 @@
+// memmgr.h
+//	Data structures for managing physical memory and the swap area
+//	used for demand paging.
+//
+//	Physical page frames are handed out to address spaces one page
+//	at a time, as pages are first touched.  When no frame is free, a
+//	victim is chosen by the replacement policy and written out to the
+//	swap area (a range of sectors on the SynchDisk) if it is dirty.
+//
+//	Since MP2 uses the stub file system, the raw disk is otherwise
+//	unused, so the whole disk is used as the swap area.  A program is
+//	only started once swap can hold all of its pages; until then,
+//	its Exec waits.
+//
+//	An address space may be limited to a number of frames of its
+//	own (its resident set); once it has that many, its faults evict
+//	its own pages rather than taking frames other programs need.
+//
+//	A fault on a page that is on swap also reads in the next few
+//	pages of the address space, as long as they are on swap in the
+//	sectors right after it and a frame is free for them (see
+//	AddrSpace::Prefetch).  With WSClockReplace, a page cleaner thread
+//	writes out dirty pages that have left the working set, so that
+//	by the time they are evicted they are clean, and eviction doesn't
+//	wait for the disk.
+//
+//	Pages of uninitialized data and stack start out mapped, read-only,
+//	to a single frame of zeroes that every address space shares; a
+//	page only gets a frame of its own when it is first written.  That
+//	frame comes, if possible, from free frames that were zeroed while
+//	the CPU had nothing else to do.
+//
+//	When a program exits, the frames and swap of its private pages
+//	are given back at once, a run of the bitmaps at a time; what is
+//	left of its address space -- shared pages, mappings, the page
+//	table -- is deleted later by a reaper thread, so that a parent in
+//	Join doesn't wait for it.
+//
+//	If the machine has a TLB, the memory manager also loads it: a
+//	TLB miss copies the page table entry into the TLB, tagged with the
+//	address space's id.  The use and dirty bits the machine sets in a
+//	TLB entry are copied back to the page table before anyone looks
+//	at them there, and an entry is dropped from the TLB before its
+//	page table entry is changed or removed.
+//
+// Copyright (c) 1992-1996 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#ifndef MEMMGR_H
+#define MEMMGR_H
+
+#include "copyright.h"
+#include "utility.h"
+#include "bitmap.h"
+#include "list.h"
+#include "noff.h"
+#include "translate.h"
+
+class AddrSpace;
+class Lock;
+class Semaphore;
+
+// Which page to throw out when physical memory is full
+
+enum ReplacementPolicy {
+    FIFOReplace,		// the page that was brought in first
+    ClockReplace,		// second chance, using TranslationEntry::use
+    LRUReplace,			// aging counters, an approximation to LRU
+    WSClockReplace		// working set clock: a page not referenced
+				// for WorkingSetTicks, and clean
+};
+
+// How long a page may go unreferenced and still be in the working set,
+// for WSClockReplace
+
+const int WorkingSetTicks = 10000;
+
+// How many pages after a faulting one may be read in with it, by default
+
+const int DefaultClusterPages = 3;
+
+// What the memory manager knows about each physical page frame
+
+class FrameInfo {
+  public:
+    AddrSpace *owner;		// address space using the frame, or NULL
+    int virtualPage;		// which of the owner's pages is in it
+    unsigned int age;		// use history, for LRUReplace; the most
+				// recent reference is the high bit
+    int shareCount;		// number of address spaces mapping this
+				// frame read-only as part of a SharedImage;
+				// shared frames are never evicted
+    int lastUse;		// when the page was last seen referenced,
+				// for WSClockReplace
+    bool queued;		// waiting for the page cleaner?
+    bool zeroed;		// free, and known to hold only zeroes?
+};
+
+// The pages of one executable that are shared, copy-on-write, by every
+// address space running it.  Only pages holding code or initialized
+// data, that no one has written to yet, can be shared.
+//
+// The image also keeps the executable's header, already parsed, and
+// its initialized data, if that had to be expanded, so that starting
+// the program again needs neither.  An image no one is running (with
+// no pages in memory) is kept for this, until MaxIdleImages others are.
+
+class SharedImage {
+  public:
+    SharedImage(char *fileName, int numPages);
+    ~SharedImage();
+
+    char *name;			// the executable these pages come from
+    int refCount;		// number of address spaces running it
+    int numPages;		// size of the address space
+    int *frame;			// frame holding each shared page, or -1
+    int fileLength;		// the executable's length when parsed
+    NoffHeader noffH;		// its header, in host byte order
+    char *initData;		// its initialized data, expanded, if it
+				// is compressed; else NULL
+    bool stale;			// the file has changed since
+};
+
+// The most images kept for programs no one is running
+
+const int MaxIdleImages = 4;
+
+// The most of memory, in percent, that SharedImages may pin; past it, a
+// page that could be shared is read into a private frame instead, so
+// that enough frames are left to evict -- never fewer than
+// MinUnsharedFrames, for an instruction and the data it touches
+
+const int MaxSharedPercent = 75;
+const int MinUnsharedFrames = 2;
+
+// A segment of memory that several address spaces can map, from
+// ShmCreate/ShmAttach.  Its frames are allocated, zeroed, when it is
+// created, and stay in memory (like shared image pages) until the last
+// address space using it is gone.
+
+class SharedSegment {
+  public:
+    int id;			// what ShmAttach names it by
+    int numPages;		// its size
+    int *frame;			// the frame holding each page
+    int refCount;		// address spaces that created or attached it
+};
+
+// The following class keeps track of which physical frames and swap
+// sectors are in use, and chooses pages to evict.
+
+class MemoryManager {
+  public:
+    MemoryManager(ReplacementPolicy policy, int clusterPages,
+		  int residentLimit);
+				// Initialize, with all frames and swap free
+    ~MemoryManager();		// De-allocate the memory manager
+
+    int AllocFrame(AddrSpace *owner, int virtualPage);
+				// Return a frame for "owner"'s page,
+				// evicting another page if need be
+    int AllocFreeFrame(AddrSpace *owner, int virtualPage,
+		       bool wantZeroed = FALSE);
+				// Return a free frame for "owner"'s page,
+				// or -1 if there is none
+    int AllocZeroedFrame(AddrSpace *owner, int virtualPage);
+				// As AllocFrame, but the frame is zeroed
+    int ZeroFrame() { return zeroFrame; }
+				// the shared, read-only frame of zeroes
+    void ZeroFreeFrames();	// Zero the free frames, while idle
+    int ClusterPages() { return clusterPages; }
+				// pages to read in after a faulting one
+    void FreeFrame(int frame);	// Return a frame to the free pool
+    void FreeFrames(AddrSpace *owner, int numPages);
+				// Return every frame of "owner"'s first
+				// "numPages" pages, in one sweep
+
+    int AllocSwap();		// Return the first sector of a free page
+				// of swap, or -1
+    void FreeSwap(int sector);	// Return a page of swap to the free pool
+    void FreeSwapPages(int *sectors, int count);
+				// Return "count" pages of swap at once
+    int NumFreeSwap() { return swapMap->NumClear(); }
+				// pages of swap free
+    bool WaitForSwap(int numPages);
+				// Wait for "numPages" of swap to be free;
+				// FALSE if there will never be that many
+    void ReadSwap(int sector, char *data);
+    void WriteSwap(int sector, char *data);
+				// Move a page to or from swap
+
+    SharedImage *FindImage(char *fileName, int fileLength);
+				// Find the shared pages of an executable,
+				// and add a reference, or return NULL
+    SharedImage *AttachImage(char *fileName, int numPages);
+				// Create the shared pages of an
+				// executable, with one reference
+    void DetachImage(SharedImage *image);
+				// Drop a reference to a SharedImage
+    int MapShared(SharedImage *image, int vpn);
+				// Map an already shared page, returning
+				// its frame, or -1 if it isn't resident
+    bool CanShare();		// Is there room to pin another frame
+				// for a SharedImage?
+    void AddShared(SharedImage *image, int vpn, int frame);
+				// Share a newly read-in page
+    void UnmapShared(SharedImage *image, int vpn);
+				// Drop one mapping of a shared page
+
+    SharedSegment *CreateSegment(int numPages);
+				// Make a new shared segment, with one
+				// reference, or return NULL if memory
+				// can't spare its frames
+    SharedSegment *AttachSegment(int id);
+				// Add a reference to segment "id", or
+				// return NULL if there is none
+    void DetachSegment(SharedSegment *segment);
+				// Drop a reference to a segment; the last
+				// one frees it
+
+    void LoadTLB(int asid, TranslationEntry *entry);
+				// Put a copy of page table "entry" of
+				// address space "asid" in the TLB
+    void FlushTLB(int asid, int vpn);
+				// Drop the TLB's copy of page "vpn" of
+				// "asid" (every page, if "vpn" is -1)
+    void SyncTLB();		// Copy the use and dirty bits set in the
+				// TLB back to the page tables
+
+    Lock *faultLock;		// held while a page fault is handled,
+				// since handling it may block on the disk
+
+    void CleanPages();		// the page cleaner thread's loop
+
+    void Retire(AddrSpace *space);
+				// Have the reaper delete "space"
+    void ReapSpaces();		// the reaper thread's loop
+
+  private:
+    int FindVictim(AddrSpace *only);
+				// choose a frame to evict (of "only"'s,
+				// if not NULL)
+    bool AtLimit(AddrSpace *owner);
+				// does "owner" have all the frames its
+				// resident set limit allows?
+    void QueueClean(int frame);	// have the page cleaner write out the
+				// dirty page in "frame"
+
+    ReplacementPolicy policy;	// how FindVictim chooses
+    int clusterPages;		// pages read in after a faulting one
+    int residentLimit;		// most frames an address space may own,
+				// or 0
+    Semaphore *swapFreed;	// signalled as swap is freed, if
+    int numSwapWaiters;		// this many are waiting for it
+    List<int> *toClean;		// frames for the page cleaner to write
+    Semaphore *cleanerWake;	// signalled as frames are queued
+    List<AddrSpace *> *retired;	// address spaces for the reaper
+    Semaphore *reaperWake;	// signalled as they are retired
+    FrameInfo *frames;		// one for each physical page frame
+    Bitmap *usedFrames;		// which frames are in use
+    int zeroFrame;		// the pinned frame of zeroes
+    Bitmap *swapMap;		// which pages of swap are in use
+    int sectorsPerPage;		// sectors in a page of swap
+    int hand;			// next frame to consider, for FIFO/clock
+    int numShared;		// frames pinned by SharedImages
+    TranslationEntry **tlbSource;	// the page table entry each TLB
+					// entry is a copy of
+    int tlbHand;		// next TLB entry to replace
+    List<SharedImage *> *images;	// executables running, or run
+					// lately (see MaxIdleImages)
+    int numIdle;		// images with no references
+    List<SharedSegment *> *segments;	// shared segments in use
+    int nextSegmentId;		// the id to give the next segment
+};
+
+#endif // MEMMGR_H
@@ -5,6 +5,9 @@
  *	code (read-only), initialized data, and unitialized data
  */
 
+#ifndef NOFF_H
+#define NOFF_H
+
 #define NOFFMAGIC	0xbadfad 	/* magic number denoting Nachos 
 					 * object code file 
 					 */
@@ -26,3 +29,35 @@ typedef struct noffHeader {
 				 * should be zero'ed before use 
 				 */
 } NoffHeader;
+
+/* Version 2 of the format.  The header is followed by a NoffExtra,
+ * and each segment is placed in the file at the same offset within a
+ * page as it has in memory, so that a page of it can be read with a
+ * single, aligned transfer.  The initialized data may be stored LZ
+ * compressed.  As in version 1, the uninitialized data takes no room
+ * in the file; it is zeroed a page at a time, when each is first used.
+ */
+
+#define NOFFMAGIC2	0xbadfae	/* magic number of version 2 */
+
+#define NoffPageSize	128		/* alignment of the segments: the
+					 * machine's smallest PageSize
+					 */
+
+#define NoffLzInitData	0x1		/* initData is compressed */
+
+typedef struct noffExtra {
+   int flags;			/* NoffLzInitData, or 0 */
+   int initDataStored;		/* bytes of initData in the file;
+				 * less than initData.size if compressed
+				 */
+} NoffExtra;
+
+/* The compressed format is LZSS.  A flag byte says, low bit first,
+ * whether each of the next 8 items is a literal byte (1), or a copy
+ * (0) of earlier output.  A copy takes two bytes: the low 8 bits of
+ * (distance back - 1), then its high 4 bits above (length - 3), so a
+ * copy reaches back up to 4096 bytes, and is 3 to 18 bytes long.
+ */
+
+#endif /* NOFF_H */
@@ -0,0 +1,232 @@
+// pagetable.cc
+//	Routines to keep an address space's translation entries in a
+//	linear, two-level, or inverted page table.
+//
+// Copyright (c) 1992-1996 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "pagetable.h"
+#include "hash.h"
+
+// An entry of the inverted table: a page of some address space
+
+class InvertedEntry {
+  public:
+    unsigned long long key;	// address space id and virtual page
+    TranslationEntry entry;
+};
+
+static unsigned long long
+InvertedKey(int id, int vpn)
+{
+    return ((unsigned long long) id << 32) | (unsigned int) vpn;
+}
+
+static unsigned long long
+InvertedGetKey(InvertedEntry *e)
+{
+    return e->key;
+}
+
+static unsigned
+InvertedHash(unsigned long long key)
+{
+    return ((unsigned) (key >> 32) * 40503u) ^ ((unsigned) key * 2654435761u);
+}
+
+// The one inverted table, shared by every address space using it, and
+// the id to give the next address space
+
+static HashTable<unsigned long long, InvertedEntry *> *invertedTable = NULL;
+static int nextId = 0;
+
+//----------------------------------------------------------------------
+// PageTable::PageTable
+// 	Initialize the translation for an address space of "numPages"
+//	pages, none of which are in memory yet.  A linear table has all
+//	its entries now, marked invalid; the others start out empty.
+//----------------------------------------------------------------------
+
+PageTable::PageTable(PageTableKind kind, int numPages)
+{
+    this->kind = kind;
+    this->numPages = numPages;
+    id = nextId++;
+    linear = NULL;
+    directory = NULL;
+    switch (kind) {
+      case LinearPageTable:
+	linear = new TranslationEntry[numPages];
+	for (int i = 0; i < numPages; i++) {
+	    linear[i].virtualPage = i;
+	    linear[i].physicalPage = -1;
+	    linear[i].valid = FALSE;
+	    linear[i].use = FALSE;
+	    linear[i].dirty = FALSE;
+	    linear[i].readOnly = FALSE;
+	}
+	break;
+      case TwoLevelPageTable:
+	directory = new SecondLevel *[divRoundUp(numPages, SecondLevelSize)];
+	for (int i = 0; i < divRoundUp(numPages, SecondLevelSize); i++)
+	    directory[i] = NULL;
+	break;
+      case InvertedPageTable:
+	if (invertedTable == NULL)
+	    invertedTable = new HashTable<unsigned long long, InvertedEntry *>(
+					InvertedGetKey, InvertedHash);
+	break;
+      default:
+	ASSERTNOTREACHED();
+    }
+}
+
+//----------------------------------------------------------------------
+// PageTable::~PageTable
+// 	De-allocate the table, and any entries it still has in the
+//	inverted table.
+//----------------------------------------------------------------------
+
+PageTable::~PageTable()
+{
+    if (kind == InvertedPageTable) {
+	for (int vpn = 0; vpn < numPages; vpn++)
+	    Remove(vpn);
+    }
+    if (directory != NULL) {
+	for (int i = 0; i < divRoundUp(numPages, SecondLevelSize); i++)
+	    delete directory[i];
+	delete [] directory;
+    }
+    delete [] linear;
+}
+
+//----------------------------------------------------------------------
+// PageTable::Lookup
+// 	Return the entry for virtual page "vpn" if it is valid, or NULL
+//	if the page is not in memory.  This is on the path of every
+//	memory reference the machine makes.
+//----------------------------------------------------------------------
+
+TranslationEntry *
+PageTable::Lookup(int vpn)
+{
+    TranslationEntry *entry = NULL;
+    SecondLevel *second;
+    InvertedEntry *e;
+
+    ASSERT(vpn >= 0 && vpn < numPages);
+    switch (kind) {
+      case LinearPageTable:
+	entry = &linear[vpn];
+	break;
+      case TwoLevelPageTable:
+	second = directory[vpn / SecondLevelSize];
+	if (second != NULL)
+	    entry = &second->entry[vpn % SecondLevelSize];
+	break;
+      default:
+	if (invertedTable->Find(InvertedKey(id, vpn), &e))
+	    entry = &e->entry;
+	break;
+    }
+    return (entry != NULL && entry->valid) ? entry : NULL;
+}
+
+//----------------------------------------------------------------------
+// PageTable::Enter
+// 	Return the entry for virtual page "vpn", so that the caller can
+//	fill it in and make it valid.  If the page has no entry, make
+//	one, marked invalid.
+//----------------------------------------------------------------------
+
+TranslationEntry *
+PageTable::Enter(int vpn)
+{
+    TranslationEntry *entry;
+    SecondLevel **second;
+    InvertedEntry *e;
+
+    ASSERT(vpn >= 0 && vpn < numPages);
+    switch (kind) {
+      case LinearPageTable:
+	return &linear[vpn];
+
+      case TwoLevelPageTable:
+	second = &directory[vpn / SecondLevelSize];
+	if (*second == NULL) {
+	    *second = new SecondLevel;
+	    for (int i = 0; i < SecondLevelSize; i++) {
+		(*second)->entry[i].virtualPage = -1;	// not entered
+		(*second)->entry[i].valid = FALSE;
+	    }
+	    (*second)->numEntered = 0;
+	}
+	entry = &(*second)->entry[vpn % SecondLevelSize];
+	if (entry->virtualPage == -1)
+	    (*second)->numEntered++;
+	break;
+
+      default:
+	if (invertedTable->Find(InvertedKey(id, vpn), &e))
+	    return &e->entry;
+	e = new InvertedEntry;
+	e->key = InvertedKey(id, vpn);
+	invertedTable->Insert(e);
+	entry = &e->entry;
+	entry->virtualPage = -1;
+	break;
+    }
+    if (entry->virtualPage == -1) {
+	entry->virtualPage = vpn;
+	entry->physicalPage = -1;
+	entry->valid = FALSE;
+	entry->use = FALSE;
+	entry->dirty = FALSE;
+	entry->readOnly = FALSE;
+    }
+    return entry;
+}
+
+//----------------------------------------------------------------------
+// PageTable::Remove
+// 	Virtual page "vpn" is no longer in memory.  Mark its entry
+//	invalid, and (except in a linear table) free it, along with its
+//	second level table if that is now empty.
+//----------------------------------------------------------------------
+
+void
+PageTable::Remove(int vpn)
+{
+    SecondLevel **second;
+    InvertedEntry *e;
+
+    ASSERT(vpn >= 0 && vpn < numPages);
+    switch (kind) {
+      case LinearPageTable:
+	linear[vpn].valid = FALSE;
+	break;
+
+      case TwoLevelPageTable:
+	second = &directory[vpn / SecondLevelSize];
+	if (*second == NULL
+		|| (*second)->entry[vpn % SecondLevelSize].virtualPage == -1)
+	    break;
+	(*second)->entry[vpn % SecondLevelSize].virtualPage = -1;
+	(*second)->entry[vpn % SecondLevelSize].valid = FALSE;
+	if (--(*second)->numEntered == 0) {
+	    delete *second;
+	    *second = NULL;
+	}
+	break;
+
+      default:
+	if (invertedTable->Find(InvertedKey(id, vpn), &e)) {
+	    invertedTable->Remove(e->key);
+	    delete e;
+	}
+	break;
+    }
+}
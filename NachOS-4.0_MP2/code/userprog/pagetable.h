@@ -0,0 +1,95 @@
+// pagetable.h
+//	Data structures for translating an address space's virtual page
+//	numbers to TranslationEntry's.
+//
+//	There are three ways to keep the entries, chosen with "-pt":
+//
+//	    linear	one entry for every page of the address space, in
+//			an array indexed by virtual page number.  This is
+//			what the machine has always used, and is the
+//			fastest, but its size is that of the address space.
+//
+//	    twolevel	a directory of pointers to tables of
+//			SecondLevelSize entries.  A second level table is
+//			only allocated once one of its pages is in memory,
+//			and is freed when the last of them is evicted.
+//
+//	    inverted	a single hash table, shared by every address space,
+//			holding an entry for each page in memory, keyed on
+//			the address space's id and the virtual page number.
+//
+//	With the last two, the space an address space uses for translation
+//	grows with the number of its pages that are in memory, rather than
+//	with its size.  The price is an extra indirection, or a hash table
+//	lookup, on every memory reference.
+//
+//	Only pages that are in memory have a valid entry in any of them.
+//
+// Copyright (c) 1992-1996 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#ifndef PAGETABLE_H
+#define PAGETABLE_H
+
+#include "copyright.h"
+#include "utility.h"
+#include "translate.h"
+
+// How the entries are kept
+
+enum PageTableKind {
+    LinearPageTable,		// an array of every entry
+    TwoLevelPageTable,		// a directory of small arrays
+    InvertedPageTable		// a system-wide hash table
+};
+
+// Entries in each second level table of a TwoLevelPageTable
+
+const int SecondLevelSize = 32;
+
+// A second level table
+
+class SecondLevel {
+  public:
+    TranslationEntry entry[SecondLevelSize];
+    int numEntered;		// entries in use; freed when it reaches 0
+};
+
+// The following class defines the translation for one address space.
+
+class PageTable {
+  public:
+    PageTable(PageTableKind kind, int numPages);
+				// Initialize a table with no entries, for
+				// an address space of "numPages" pages
+    ~PageTable();		// De-allocate the table's entries
+
+    TranslationEntry *Lookup(int vpn);
+				// Return the entry of page "vpn" if it is
+				// valid, else NULL
+    TranslationEntry *Enter(int vpn);
+				// Return the entry of page "vpn", making
+				// an (invalid) one if it has none
+    void Remove(int vpn);	// Page "vpn" has left memory; invalidate
+				// its entry, and free it if we can
+
+    PageTableKind Kind() { return kind; }
+    int Id() { return id; }	// the address space's id
+    int NumPages() { return numPages; }
+    TranslationEntry *Linear() { return linear; }
+				// the array of a LinearPageTable, for
+				// the machine to index directly
+
+  private:
+    PageTableKind kind;
+    int numPages;		// size of the address space
+    int id;			// tells this address space's entries apart
+				// in the inverted table, and in the TLB
+
+    TranslationEntry *linear;	// LinearPageTable: entry[vpn]
+    SecondLevel **directory;	// TwoLevelPageTable: directory[vpn /
+				// SecondLevelSize], or NULL
+};
+
+#endif // PAGETABLE_H
@@ -34,6 +34,10 @@
 #define SC_ExecV	13
 #define SC_ThreadExit   14
 #define SC_ThreadJoin   15
+#define SC_ShmCreate	16
+#define SC_ShmAttach	17
+#define SC_Mmap		18
+#define SC_Munmap	19
 #define SC_PrintInt 40
 #define SC_Add		42
 #define SC_MSG		100
@@ -77,8 +81,8 @@ typedef int SpaceId;
 /* A unique identifier for a thread within a task */
 typedef int ThreadId;
 
-/* Run the specified executable, with no args */
-/* This can be implemented as a call to ExecV.
+/* Run the specified executable, with no args, as a child of the
+ * caller.  Return its SpaceId, or -1 if it can't be run.
  */ 
 SpaceId Exec(char* exec_name);
 
@@ -89,7 +93,8 @@ SpaceId Exec(char* exec_name);
 SpaceId ExecV(int argc, char* argv[]);
  
 /* Only return once the user program "id" has finished.  
- * Return the exit status.
+ * Return the exit status, or -1 if "id" is not a child of the caller
+ * that has not been joined yet.
  */
 int Join(SpaceId id); 	
  
@@ -181,6 +186,32 @@ int ThreadJoin(ThreadId id);
  */
 void ThreadExit(int ExitCode);	
 
+
+/* Shared memory and mapped files.  Mappings live in a region of the
+ * address space above the stack, of MapPages pages (see addrspace.h).
+ */
+
+/* Make a segment of "size" bytes of zeroed memory that any program can
+ * map.  It lasts at least as long as its creator.  Return its id, or -1.
+ */
+int ShmCreate(int size);
+
+/* Map shared segment "id"; every program that maps it sees the same
+ * memory.  Return the address it is mapped at, or -1.
+ */
+char *ShmAttach(int id);
+
+/* Map "len" bytes of open file "id", from byte "offset".  Pages are
+ * read when touched and written back when unmapped (or at exit); the
+ * file must stay open until then.  Return the address, or -1.
+ */
+char *Mmap(OpenFileId id, int offset, int len);
+
+/* Remove the mapping starting at "addr".  Return 1 on success, 0 if
+ * nothing is mapped there.
+ */
+int Munmap(char *addr);
+
 #endif /* IN_ASM */
 
 #endif /* SYSCALL_H */
@@ -47,3 +47,92 @@ struct scnhdr {
         long            s_flags;        /* flags */
       };
  
+
+/* The symbol table ("symbolic header" at f_symptr), as far as coff2noff
+ * -s reads it: the files, their procedures, and the line numbers of
+ * each procedure's instructions.  All offsets are from the start of
+ * the COFF file; indices into strings, symbols and procedures are
+ * relative to the file's base (issBase, isymBase, ipdFirst).
+ */
+
+#define magicSym	0x7009
+
+typedef struct hdrr {
+        short   magic;          /* magicSym                             */
+        short   vstamp;         /* version stamp                        */
+        long    ilineMax;       /* number of line number entries        */
+        long    cbLine;         /* bytes of packed line numbers         */
+        long    cbLineOffset;   /* file ptr to packed line numbers      */
+        long    idnMax;         /* dense numbers                        */
+        long    cbDnOffset;
+        long    ipdMax;         /* procedure descriptors                */
+        long    cbPdOffset;
+        long    isymMax;        /* local symbols                        */
+        long    cbSymOffset;
+        long    ioptMax;        /* optimization symbols                 */
+        long    cbOptOffset;
+        long    iauxMax;        /* auxiliary symbols                    */
+        long    cbAuxOffset;
+        long    issMax;         /* bytes of local strings               */
+        long    cbSsOffset;
+        long    issExtMax;      /* bytes of external strings            */
+        long    cbSsExtOffset;
+        long    ifdMax;         /* file descriptors                     */
+        long    cbFdOffset;
+        long    crfd;           /* relative file descriptors            */
+        long    cbRfdOffset;
+        long    iextMax;        /* external symbols                     */
+        long    cbExtOffset;
+      } HDRR;
+
+typedef struct fdr {            /* one source file                      */
+        long    adr;            /* address of its first instruction     */
+        long    rss;            /* its name, in its local strings       */
+        long    issBase;        /* its local strings                    */
+        long    cbSs;
+        long    isymBase;       /* its local symbols                    */
+        long    csym;
+        long    ilineBase;      /* its line numbers                     */
+        long    cline;
+        long    ioptBase;
+        long    copt;
+        unsigned short ipdFirst;/* its procedures                       */
+        unsigned short cpd;
+        long    iauxBase;
+        long    caux;
+        long    rfdBase;
+        long    crfd;
+        unsigned long flags;    /* language, etc.                       */
+        long    cbLineOffset;   /* its packed line numbers, from hdrr's */
+        long    cbLine;
+      } FDR;
+
+typedef struct pdr {            /* one procedure                        */
+        long    adr;            /* its address, from its file's adr     */
+        long    isym;           /* its local symbol                     */
+        long    iline;
+        long    regmask;
+        long    regoffset;
+        long    iopt;
+        long    fregmask;
+        long    fregoffset;
+        long    frameoffset;
+        short   framereg;
+        short   pcreg;
+        long    lnLow;          /* line of its first instruction        */
+        long    lnHigh;
+        long    cbLineOffset;   /* its packed line numbers, from fdr's  */
+      } PDR;
+
+typedef struct symr {           /* a local symbol                       */
+        long    iss;            /* its name, in its file's strings      */
+        long    value;          /* for a procedure, its address         */
+        unsigned long bits;     /* st:6, sc:5, reserved:1, index:20     */
+      } SYMR;
+
+/* Packed line numbers: one byte per run of instructions on the same
+ * line, giving in its low 4 bits the number of instructions less one,
+ * and in its high 4 bits the (signed) change in line number from the
+ * run before.  A change of -8 means the real change is in the next
+ * two bytes, big-endian.
+ */
@@ -18,6 +18,21 @@
  *      .rdata  -- read-only data (e.g., string literals).
  *                 mark this segment readonly to prevent it from being modified
 #endif
+ *
+ * With -2, the output is version 2 of NOFF (see noff.h): each segment is
+ * placed in the file at its offset within a page in memory.  With -z, it
+ * is version 2, and the initialized data is also compressed, if that
+ * makes it smaller.
+ *
+ * With -s <symbolFile>, the procedures in the COFF symbol table, and the
+ * source line of each instruction (if the program was compiled with -g),
+ * are also written to <symbolFile>, as text, for "nachos -prof":
+ *
+ *	proc <hex address> <name>
+ *	line <hex address> <source file> <line>
+ *
+ * A "line" gives the line of the instructions from its address up to
+ * the next "line" or "proc".
  *
  *
  * Copyright (c) 1992-1993 The Regents of the University of California.
@@ -148,17 +163,153 @@ void Write(int fd, char *buf, int nBytes)
     }
 }
 
+/* in version 2, move the output to where a segment starting at
+ * "virtualAddr" goes: the next offset in the same place within a page
+ */
+int Align(int fd, int inNoffFile, int virtualAddr, int version)
+{
+    if (version == 2) {
+	inNoffFile += (virtualAddr - inNoffFile) & (NoffPageSize - 1);
+	lseek(fd, inNoffFile, 0);
+    }
+    return inNoffFile;
+}
+
+/* LZ compress "size" bytes from "in" to "out", in the format described
+ * in noff.h; "out" must have room for size + size / 8 + 1 bytes.  Returns
+ * the compressed size.  The longest match is found by brute force, which
+ * is fast enough for the few kilobytes of a user program's data.
+ */
+int LzCompress(unsigned char *in, int size, unsigned char *out)
+{
+    int i = 0, o = 0, flag = 0, bit = 8;
+    int d, len, bestLen, bestDist;
+
+    while (i < size) {
+	if (bit == 8) {
+	    flag = o++;
+	    out[flag] = 0;
+	    bit = 0;
+	}
+	bestLen = bestDist = 0;
+	for (d = 1; d <= 4096 && d <= i; d++) {
+	    for (len = 0; len < 18 && i + len < size
+			&& in[i + len] == in[i - d + len]; len++)
+		;
+	    if (len > bestLen) {
+		bestLen = len;
+		bestDist = d;
+	    }
+	}
+	if (bestLen >= 3) {
+	    out[o++] = (bestDist - 1) & 0xff;
+	    out[o++] = (((bestDist - 1) >> 8) << 4) | (bestLen - 3);
+	    i += bestLen;
+	} else {
+	    out[flag] |= 1 << bit;
+	    out[o++] = in[i++];
+	}
+	bit++;
+    }
+    return o;
+}
+
+/* write the procedures and line numbers of the COFF file read into
+ * "coff" (of "size" bytes) to "symFile", in the format described
+ * above.  Returns 0 if the file has no symbol table.
+ */
+int WriteSymbols(char *coff, int size, int symptr, FILE *symFile)
+{
+    HDRR h;
+    FDR f;
+    PDR p, next;
+    SYMR sym;
+    int i, j, addr, line, delta, count;
+    unsigned char *lines, *end;
+    char *strings, *fileName;
+
+    if (symptr <= 0 || symptr + (int) sizeof(HDRR) > size)
+	return 0;
+    memcpy(&h, coff + symptr, sizeof(HDRR));
+    if (ShortToHost(h.magic) != magicSym)
+	return 0;
+    for (i = 0; i < (int) WordToHost(h.ifdMax); i++) {
+	memcpy(&f, coff + WordToHost(h.cbFdOffset) + i * sizeof(FDR),
+			sizeof(FDR));
+	strings = coff + WordToHost(h.cbSsOffset) + WordToHost(f.issBase);
+	fileName = strings + WordToHost(f.rss);
+	for (j = 0; j < ShortToHost(f.cpd); j++) {
+	    memcpy(&p, coff + WordToHost(h.cbPdOffset)
+			+ (ShortToHost(f.ipdFirst) + j) * sizeof(PDR), sizeof(PDR));
+	    memcpy(&sym, coff + WordToHost(h.cbSymOffset) + (WordToHost(f.isymBase)
+			+ WordToHost(p.isym)) * sizeof(SYMR), sizeof(SYMR));
+	    addr = WordToHost(sym.value);
+	    fprintf(symFile, "proc %x %s\n", addr, strings + WordToHost(sym.iss));
+	    if ((int) WordToHost(p.iline) < 0)
+		continue;		/* not compiled with -g */
+
+	    /* its line numbers end where the next procedure's start */
+	    lines = (unsigned char *) coff + WordToHost(h.cbLineOffset)
+			+ WordToHost(f.cbLineOffset);
+	    end = lines + WordToHost(f.cbLine);
+	    if (j + 1 < ShortToHost(f.cpd)) {
+		memcpy(&next, coff + WordToHost(h.cbPdOffset)
+			+ (ShortToHost(f.ipdFirst) + j + 1) * sizeof(PDR),
+			sizeof(PDR));
+		end = lines + WordToHost(next.cbLineOffset);
+	    }
+	    lines += WordToHost(p.cbLineOffset);
+	    line = WordToHost(p.lnLow);
+	    while (lines < end) {
+		delta = (*lines >> 4) & 0xf;
+		count = (*lines & 0xf) + 1;
+		lines++;
+		if (delta >= 8)
+		    delta -= 16;
+		if (delta == -8) {
+		    delta = (lines[0] << 8) | lines[1];
+		    if (delta >= 0x8000)
+			delta -= 0x10000;
+		    lines += 2;
+		}
+		line += delta;
+		fprintf(symFile, "line %x %s %d\n", addr, fileName, line);
+		addr += 4 * count;
+	    }
+	}
+    }
+    return 1;
+}
+
 int main(int argc, char **argv)
 {
     int fdIn, fdOut, numsections, i, inNoffFile;
+    int version = 1, compress = 0, stored, coffSize;
+    char *symFileName = NULL, *coff;
+    FILE *symFile;
     struct filehdr fileh;
     struct aouthdr systemh;
     struct scnhdr *sections;
-    char *buffer;
+    char *buffer, *packed;
     NoffHeader noffH;
+    NoffExtra noffX;
 
-    if (argc < 2) {
-	fprintf(stderr, "Usage: %s <coffFileName> <noffFileName>\n", argv[0]);
+    for (; argc > 1 && argv[1][0] == '-'; argc--, argv++) {
+	if (!strcmp(argv[1], "-2")) {
+	    version = 2;
+	} else if (!strcmp(argv[1], "-z")) {
+	    version = 2;
+	    compress = 1;
+	} else if (!strcmp(argv[1], "-s") && argc > 2) {
+	    symFileName = argv[2];
+	    argc--, argv++;
+	} else {
+	    break;
+	}
+    }
+    if (argc < 3) {
+	fprintf(stderr, "Usage: %s [-2] [-z] [-s <symbolFileName>] "
+		"<coffFileName> <noffFileName>\n", argv[0]);
 	exit(1);
     }
     
@@ -171,7 +322,7 @@ int main(int argc, char **argv)
 
 /* open the NOFF file (output) */
     fdOut = open(argv[2], O_WRONLY|O_CREAT|O_TRUNC , 0666);
-    if (fdIn == -1) {
+    if (fdOut == -1) {
 	perror(argv[2]);
 	exit(1);
     }
@@ -211,7 +362,9 @@ int main(int argc, char **argv)
  /* initialize the NOFF header, in case not all the segments are defined
   * in the COFF file
   */
-    noffH.noffMagic = NOFFMAGIC;
+    noffH.noffMagic = (version == 2) ? NOFFMAGIC2 : NOFFMAGIC;
+    noffX.flags = 0;
+    noffX.initDataStored = 0;
     noffH.code.size = 0;
     noffH.initData.size = 0;
     noffH.uninitData.size = 0;
@@ -222,6 +375,8 @@ int main(int argc, char **argv)
 
  /* Copy the segments in */
     inNoffFile = sizeof(NoffHeader);
+    if (version == 2)
+	inNoffFile += sizeof(NoffExtra);
     lseek(fdOut, inNoffFile, 0);
     printf("Loading %d sections:\n", numsections);
     for (i = 0; i < numsections; i++) {
@@ -231,6 +386,7 @@ int main(int argc, char **argv)
 	if (sections[i].s_size == 0) {
 		/* do nothing! */	
 	} else if (!strcmp(sections[i].s_name, ".text")) {
+	    inNoffFile = Align(fdOut, inNoffFile, sections[i].s_paddr, version);
 	    noffH.code.virtualAddr = sections[i].s_paddr;
 	    noffH.code.inFileAddr = inNoffFile;
 	    noffH.code.size = sections[i].s_size;
@@ -242,18 +398,39 @@ int main(int argc, char **argv)
 	    inNoffFile += sections[i].s_size;
  	} else if (!strcmp(sections[i].s_name, ".data")){
 
+	    inNoffFile = Align(fdOut, inNoffFile, sections[i].s_paddr, version);
 	    noffH.initData.virtualAddr = sections[i].s_paddr;
 	    noffH.initData.inFileAddr = inNoffFile;
 	    noffH.initData.size = sections[i].s_size;
 	    lseek(fdIn, sections[i].s_scnptr, 0);
 	    buffer = malloc(sections[i].s_size);
 	    Read(fdIn, buffer, sections[i].s_size);
-	    Write(fdOut, buffer, sections[i].s_size);
+	    stored = sections[i].s_size;
+	    packed = NULL;
+	    if (compress) {
+		packed = malloc(stored + stored / 8 + 1);
+		stored = LzCompress((unsigned char *)buffer, stored,
+				    (unsigned char *)packed);
+		if (stored < sections[i].s_size) {
+		    noffX.flags |= NoffLzInitData;
+		    printf("\tcompressed \"%s\" to 0x%x bytes\n",
+			   sections[i].s_name, stored);
+		} else {
+		    stored = sections[i].s_size;	/* no smaller */
+		}
+	    }
+	    if (noffX.flags & NoffLzInitData)
+		Write(fdOut, packed, stored);
+	    else
+		Write(fdOut, buffer, stored);
+	    free(packed);
 	    free(buffer);
-	    inNoffFile += sections[i].s_size;
+	    noffX.initDataStored = stored;
+	    inNoffFile += stored;
 #ifdef RDATA
 	} else if (!strcmp(sections[i].s_name, ".rdata")){
 
+	    inNoffFile = Align(fdOut, inNoffFile, sections[i].s_paddr, version);
 	    noffH.readonlyData.virtualAddr = sections[i].s_paddr;
 	    noffH.readonlyData.inFileAddr = inNoffFile;
 	    noffH.readonlyData.size = sections[i].s_size;
@@ -294,6 +471,28 @@ int main(int argc, char **argv)
     SwapHeader(&noffH);
     
     Write(fdOut, (char *)&noffH, sizeof(NoffHeader));
+    if (version == 2) {
+	noffX.flags = WordToMachine(noffX.flags);
+	noffX.initDataStored = WordToMachine(noffX.initDataStored);
+	Write(fdOut, (char *)&noffX, sizeof(NoffExtra));
+    }
+
+    /* write the symbols, from a copy of the whole COFF file */
+    if (symFileName != NULL) {
+	coffSize = lseek(fdIn, 0, SEEK_END);
+	coff = (char *) malloc(coffSize);
+	lseek(fdIn, 0, 0);
+	Read(fdIn, coff, coffSize);
+	symFile = fopen(symFileName, "w");
+	if (symFile == NULL) {
+	    perror(symFileName);
+	    exit(1);
+	}
+	if (!WriteSymbols(coff, coffSize, WordToHost(fileh.f_symptr), symFile))
+	    fprintf(stderr, "%s has no symbol table\n", argv[1]);
+	fclose(symFile);
+	free(coff);
+    }
     close(fdIn);
     close(fdOut);
     exit(0);
@@ -58,74 +58,54 @@ class FileSystem {
   	}
 
     OpenFile* Open(char *name) {
-	    int fileDescriptor = OpenForReadWrite(name, FALSE);
-      int id;
-      OpenFile *open;  
-      
-	    if (fileDescriptor == -1) return NULL;
-     
-      open = new OpenFile(fileDescriptor);
-      
+	  int fileDescriptor = OpenForReadWrite(name, FALSE);
+
+	  if (fileDescriptor == -1) return NULL;
+	  return new OpenFile(fileDescriptor);
+    }
+
+    // A user program's OpenFileId is one more than the file's place in
+    // fileDescriptorTable -- not the OpenFile itself, which doesn't fit
+    // in a MIPS register on a 64-bit host.
+
+    int Open_File(char *name) {
       for(int i=0; i<20; i++) {
         if(fileDescriptorTable[i] == NULL) {
-          id = i+1;
-          fileDescriptorTable[i] = open;
-          break;
+          fileDescriptorTable[i] = Open(name);
+          return (fileDescriptorTable[i] == NULL) ? 0 : i+1;
         }
       }
-	    return open;
+      return 0;		// too many open files
     }
-    
+
+    OpenFile *FileOf(int id) {	// the open file "id" names, or NULL
+      if(id <= 0 || id > 20) return NULL;
+      return fileDescriptorTable[id-1];
+    }
+
     int Close_File(int openfileId) {
-      OpenFile *close;
-      bool exist = false;
-      int file_to_close;
-      
-      if(openfileId <= 0) return 0;
-      
-      if((close = (OpenFile*)(openfileId)) == NULL) return 0;
-      
-      for(int i=0;i<20;i++) {
-         if(fileDescriptorTable[i] != NULL) {
-             if(openfileId == (int)fileDescriptorTable[i]) {
-                 delete fileDescriptorTable[i];
-                 fileDescriptorTable[i] = NULL;
-                 return true;
-             }
-         }
-      }
-      return false;
+      OpenFile *close = FileOf(openfileId);
+
+      if(close == NULL) return 0;
+      delete close;
+      fileDescriptorTable[openfileId-1] = NULL;
+      return 1;
     }
     
     int Write_File(char *buffer, int size, int id) {
-        OpenFile *file;
-        int numWritten = 0;
-        
-        if(id <=0 ) return 0; //check id is larger than zero.
-        
-        file = (OpenFile*)(id);
+        OpenFile *file = FileOf(id);
         
-        if(file == NULL) return 0; // check the address is valid
+        if(file == NULL) return 0; // check the id is valid
         
-        numWritten = file->Write(buffer, size);
-        
-        return numWritten;
+        return file->Write(buffer, size);
     }
     
-    char* Read_File(int size, int id) {
-      OpenFile *file;
-      char *buffer = (char *)malloc(sizeof(char *) * (size));
-      int numRead = 0;
-      
-      if(id <= 0) return 0;
-      
-      file = (OpenFile*)(id);
-      
-      if(file == NULL) return 0;
-      
-      numRead = file->Read(buffer, size);
-      
-      return buffer;
+    int Read_File(char *buffer, int size, int id) {
+        OpenFile *file = FileOf(id);
+
+        if(file == NULL) return 0; // check the id is valid
+
+        return file->Read(buffer, size);
     }
 
     bool Remove(char *name) { return Unlink(name) == 0; }
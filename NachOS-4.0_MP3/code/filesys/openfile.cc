@@ -17,6 +17,7 @@
 #include "filehdr.h"
 #include "openfile.h"
 #include "synchdisk.h"
+#include "memops.h"
 
 //----------------------------------------------------------------------
 // OpenFile::OpenFile
@@ -136,7 +137,7 @@ OpenFile::ReadAt(char *into, int numBytes, int position)
 					&buf[(i - firstSector) * SectorSize]);
 
     // copy the part we want
-    bcopy(&buf[position - (firstSector * SectorSize)], into, numBytes);
+    MemCopy(into, &buf[position - (firstSector * SectorSize)], numBytes);
     delete [] buf;
     return numBytes;
 }
@@ -172,7 +173,7 @@ OpenFile::WriteAt(char *from, int numBytes, int position)
 				SectorSize, lastSector * SectorSize);	
 
 // copy in the bytes we want to change 
-    bcopy(from, &buf[position - (firstSector * SectorSize)], numBytes);
+    MemCopy(&buf[position - (firstSector * SectorSize)], from, numBytes);
 
 // write modified sectors back
     for (i = firstSector; i <= lastSector; i++)	
@@ -16,6 +16,14 @@
 
 #include "copyright.h"
 #include "synchdisk.h"
+#include "main.h"
+#include "perfcount.h"
+
+static PerfCounter perfReads("synchdisk", "reads");
+static PerfCounter perfWrites("synchdisk", "writes");
+static PerfHistogram perfWait("synchdisk", "wait_ticks");
+					// from asking to having the sector,
+					// behind the others queued too
 
 
 //----------------------------------------------------------------------
@@ -30,6 +38,8 @@ SynchDisk::SynchDisk()
     semaphore = new Semaphore("synch disk", 0);
     lock = new Lock("synch disk lock");
     disk = new Disk(this);
+    numQueued = 0;
+    kernel->stats->AddCounter("disk_queue", &numQueued);
 }
 
 //----------------------------------------------------------------------
@@ -57,10 +67,16 @@ SynchDisk::~SynchDisk()
 void
 SynchDisk::ReadSector(int sectorNumber, char* data)
 {
+    int start = kernel->stats->totalTicks;
+
+    numQueued++;
     lock->Acquire();			// only one disk I/O at a time
     disk->ReadRequest(sectorNumber, data);
     semaphore->P();			// wait for interrupt
     lock->Release();
+    numQueued--;
+    perfReads.Inc();
+    perfWait.Record(kernel->stats->totalTicks - start);
 }
 
 //----------------------------------------------------------------------
@@ -75,10 +91,16 @@ SynchDisk::ReadSector(int sectorNumber, char* data)
 void
 SynchDisk::WriteSector(int sectorNumber, char* data)
 {
+    int start = kernel->stats->totalTicks;
+
+    numQueued++;
     lock->Acquire();			// only one disk I/O at a time
     disk->WriteRequest(sectorNumber, data);
     semaphore->P();			// wait for interrupt
     lock->Release();
+    numQueued--;
+    perfWrites.Inc();
+    perfWait.Record(kernel->stats->totalTicks - start);
 }
 
 //----------------------------------------------------------------------
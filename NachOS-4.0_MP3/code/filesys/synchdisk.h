@@ -50,6 +50,8 @@ class SynchDisk : public CallBackObj {
 					// with the interrupt handler
     Lock *lock;		  		// Only one read/write request
 					// can be sent to the disk at a time
+    int numQueued;			// requests waiting for the disk,
+					// or on it
 };
 
 #endif // SYNCHDISK_H
@@ -2,6 +2,10 @@
 //	Routines to manage a bitmap -- an array of bits each of which
 //	can be either on or off.  Represented as an array of integers.
 //
+//	Whole words are searched with the gcc bit-counting builtins
+//	(__builtin_ctz finds the lowest bit that is on in a word,
+//	__builtin_popcount counts them).
+//
 // Copyright (c) 1992-1996 The Regents of the University of California.
 // All rights reserved.  See copyright.h for copyright notice and limitation 
 // of liability and disclaimer of warranty provisions.
@@ -16,23 +20,26 @@
 //	it can be added somewhere on a list.
 //
 //	"numItems" is the number of bits in the bitmap.
+//	"bitsInGroup" is how many bits to keep a count of clear bits for;
+//		it is rounded up to a whole number of words
 //----------------------------------------------------------------------
 
-Bitmap::Bitmap(int numItems) 
+Bitmap::Bitmap(int numItems, int bitsInGroup) 
 { 
     int i;
 
-    ASSERT(numItems > 0);
+    ASSERT(numItems > 0 && bitsInGroup > 0);
 
     numBits = numItems;
     numWords = divRoundUp(numBits, BitsInWord);
     map = new unsigned int[numWords];
     for (i = 0; i < numWords; i++) {
-	map[i] = 0;		// initialize map to keep Purify happy
-    }
-    for (i = 0; i < numBits; i++) {
-        Clear(i);
+		map[i] = 0;		// initialize map to keep Purify happy
     }
+    groupBits = divRoundUp(bitsInGroup, BitsInWord) * BitsInWord;
+    numGroups = divRoundUp(numBits, groupBits);
+    groupClear = new int[numGroups];
+    Recount();
 }
 
 //----------------------------------------------------------------------
@@ -42,7 +49,8 @@ Bitmap::Bitmap(int numItems)
 
 Bitmap::~Bitmap()
 { 
-    delete map;
+    delete [] map;
+    delete [] groupClear;
 }
 
 //----------------------------------------------------------------------
@@ -57,6 +65,10 @@ Bitmap::Mark(int which)
 { 
     ASSERT(which >= 0 && which < numBits);
 
+    if (!Test(which)) {
+	numClear--;
+	groupClear[which / groupBits]--;
+    }
     map[which / BitsInWord] |= 1 << (which % BitsInWord);
 
     ASSERT(Test(which));
@@ -74,11 +86,53 @@ Bitmap::Clear(int which)
 {
     ASSERT(which >= 0 && which < numBits);
 
+    if (Test(which)) {
+	numClear++;
+	groupClear[which / groupBits]++;
+    }
     map[which / BitsInWord] &= ~(1 << (which % BitsInWord));
 
     ASSERT(!Test(which));
 }
 
+//----------------------------------------------------------------------
+// Bitmap::MarkRange, Bitmap::ClearRange
+// 	Set or clear "count" consecutive bits, starting with bit "first",
+//	a word at a time.
+//----------------------------------------------------------------------
+
+void
+Bitmap::MarkRange(int first, int count)
+{
+    int end = first + count;
+
+    ASSERT(first >= 0 && count >= 0 && end <= numBits);
+    for (int word = first / BitsInWord; word * BitsInWord < end; word++) {
+	unsigned int bits = RangeMask(word, first, end);
+	int n = __builtin_popcount(bits & ~map[word]);
+
+	numClear -= n;
+	groupClear[(word * BitsInWord) / groupBits] -= n;
+	map[word] |= bits;
+    }
+}
+
+void
+Bitmap::ClearRange(int first, int count)
+{
+    int end = first + count;
+
+    ASSERT(first >= 0 && count >= 0 && end <= numBits);
+    for (int word = first / BitsInWord; word * BitsInWord < end; word++) {
+	unsigned int bits = RangeMask(word, first, end);
+	int n = __builtin_popcount(bits & map[word]);
+
+	numClear += n;
+	groupClear[(word * BitsInWord) / groupBits] += n;
+	map[word] &= ~bits;
+    }
+}
+
 //----------------------------------------------------------------------
 // Bitmap::Test
 // 	Return TRUE if the "nth" bit is set.
@@ -92,9 +146,9 @@ Bitmap::Test(int which) const
     ASSERT(which >= 0 && which < numBits);
     
     if (map[which / BitsInWord] & (1 << (which % BitsInWord))) {
-	return TRUE;
+		return TRUE;
     } else {
-	return FALSE;
+		return FALSE;
     }
 }
 
@@ -110,32 +164,211 @@ Bitmap::Test(int which) const
 int 
 Bitmap::FindAndSet() 
 {
-    for (int i = 0; i < numBits; i++) {
-	if (!Test(i)) {
-	    Mark(i);
-	    return i;
+    int which = NextClear(0, numBits);
+
+    if (which == numBits)
+	return -1;
+    Mark(which);
+    return which;
+}
+
+//----------------------------------------------------------------------
+// Bitmap::FindClearRun
+// 	Look for "count" consecutive clear bits, e.g., so that a file
+//	can be given consecutive sectors.  The search starts at bit
+//	"from" and wraps around to the beginning.  Return the number of
+//	the first bit of the first such run.  If there is no run that
+//	long, return the start of the longest run of clear bits there is.
+//	Nothing is marked as in use.
+//
+//	If no bits are clear, return -1.
+//
+//	"count" is how many bits are wanted
+//	"length" is set to the length of the run found (at most "count")
+//	"from" is where to start looking
+//----------------------------------------------------------------------
+
+int
+Bitmap::FindClearRun(int count, int *length, int from) const
+{
+    int best = -1, bestLength = 0;
+
+    ASSERT(from >= 0 && from < numBits);
+
+    // first look from "from" to the end, then from the beginning
+    // up to "from"; a run does not wrap around
+    for (int pass = 0; pass < 2 && bestLength < count; pass++) {
+	int i = (pass == 0) ? from : 0;
+	int end = (pass == 0) ? numBits : from;
+
+	while (i < end) {
+	    int start = NextClear(i, end);
+
+	    if (start == end)
+		break;
+	    i = NextSet(start, min(end, start + count));
+	    if (i - start > bestLength) {
+		best = start;
+		bestLength = i - start;
+		if (bestLength == count)
+		    break;
+	    }
 	}
     }
-    return -1;
+    *length = bestLength;
+    return best;
 }
 
 //----------------------------------------------------------------------
-// Bitmap::NumClear
-// 	Return the number of clear bits in the bitmap.
-//	(In other words, how many bits are unallocated?)
+// Bitmap::FindContiguous
+// 	Return the number of the first bit of the first run of "count"
+//	clear bits, or -1 if there is no run that long.  Nothing is
+//	marked as in use.
+//----------------------------------------------------------------------
+
+int
+Bitmap::FindContiguous(int count) const
+{
+    int length;
+    int start;
+
+    ASSERT(count > 0);
+    start = FindClearRun(count, &length);
+    return (length == count) ? start : -1;
+}
+
+//----------------------------------------------------------------------
+// Bitmap::NumClearIn
+// 	Return the number of clear bits among "count" bits, starting with
+//	bit "first".  (In other words, how many of them are unallocated?)
+//	Whole groups are counted from their counts, and the rest a word
+//	at a time.
 //----------------------------------------------------------------------
 
 int 
-Bitmap::NumClear() const
+Bitmap::NumClearIn(int first, int count) const
 {
-    int count = 0;
+    int n = 0;
+    int i = first;
+    int end = first + count;
 
-    for (int i = 0; i < numBits; i++) {
-	if (!Test(i)) {
-	    count++;
+    ASSERT(first >= 0 && count >= 0 && end <= numBits);
+    while (i < end) {
+	if (i % groupBits == 0 && i + groupBits <= end) {
+	    n += groupClear[i / groupBits];	// a whole group
+	    i += groupBits;
+	    continue;
 	}
+	int word = i / BitsInWord;
+
+	n += __builtin_popcount(ClearBits(word) & RangeMask(word, i, end));
+	i = (word + 1) * BitsInWord;
+    }
+    return n;
+}
+
+//----------------------------------------------------------------------
+// Bitmap::Recount
+// 	Recompute the number of clear bits in each group and in the whole
+//	bitmap, e.g., after the bits have been read in from disk.
+//----------------------------------------------------------------------
+
+void
+Bitmap::Recount()
+{
+    numClear = 0;
+    for (int g = 0; g < numGroups; g++)
+	groupClear[g] = 0;
+    for (int w = 0; w < numWords; w++) {
+	int n = __builtin_popcount(ClearBits(w));
+
+	groupClear[(w * BitsInWord) / groupBits] += n;
+	numClear += n;
     }
-    return count;
+}
+
+//----------------------------------------------------------------------
+// Bitmap::ClearBits
+// 	Return a word of the bitmap with each of its clear bits on.  Bits
+//	past the end of the bitmap are left off.
+//----------------------------------------------------------------------
+
+unsigned int
+Bitmap::ClearBits(int word) const
+{
+    unsigned int bits = ~map[word];
+    int valid = numBits - word * BitsInWord;
+
+    if (valid < BitsInWord)
+	bits &= (1u << valid) - 1;
+    return bits;
+}
+
+//----------------------------------------------------------------------
+// Bitmap::RangeMask
+// 	Return a word with the bits of word "word" of the bitmap that are
+//	numbered from "first" up to (but not including) "end" on.
+//----------------------------------------------------------------------
+
+unsigned int
+Bitmap::RangeMask(int word, int first, int end) const
+{
+    int low = max(first - word * BitsInWord, 0);
+    int high = min(end - word * BitsInWord, BitsInWord);
+    unsigned int bits = ~0u << low;
+
+    if (high < BitsInWord)
+	bits &= (1u << high) - 1;
+    return bits;
+}
+
+//----------------------------------------------------------------------
+// Bitmap::NextClear
+// 	Return the number of the first clear bit at or after "from",
+//	or "end" if there is none before "end".  Groups with no clear
+//	bits are skipped without looking at them.
+//----------------------------------------------------------------------
+
+int
+Bitmap::NextClear(int from, int end) const
+{
+    int i = from;
+
+    while (i < end) {
+	if (i % groupBits == 0 && groupClear[i / groupBits] == 0) {
+	    i += groupBits;
+	    continue;
+	}
+	int word = i / BitsInWord;
+	unsigned int bits = ClearBits(word) & (~0u << (i % BitsInWord));
+
+	if (bits != 0)
+	    return min(end, word * BitsInWord + __builtin_ctz(bits));
+	i = (word + 1) * BitsInWord;
+    }
+    return end;
+}
+
+//----------------------------------------------------------------------
+// Bitmap::NextSet
+// 	Return the number of the first set bit at or after "from", or
+//	"end" if there is none before "end".
+//----------------------------------------------------------------------
+
+int
+Bitmap::NextSet(int from, int end) const
+{
+    int i = from;
+
+    while (i < end) {
+	int word = i / BitsInWord;
+	unsigned int bits = map[word] & (~0u << (i % BitsInWord));
+
+	if (bits != 0)
+	    return min(end, word * BitsInWord + __builtin_ctz(bits));
+	i = (word + 1) * BitsInWord;
+    }
+    return end;
 }
 
 //----------------------------------------------------------------------
@@ -177,15 +410,38 @@ Bitmap::SelfTest()
     ASSERT(Test(0) && Test(31));
 
     ASSERT(FindAndSet() == 1);
+    ASSERT(NumClear() == numBits - 3);
+    ASSERT(NumClearIn(0, BitsInWord) == BitsInWord - 3);
+    ASSERT(NumClearIn(1, 31) == 29 && NumClearIn(2, 29) == 29);
+    
+    int length;
+    ASSERT(FindClearRun(4, &length) == 2 && length == 4);
+    ASSERT(FindClearRun(30, &length) == 32 && length == 30);
+    ASSERT(FindClearRun(2, &length, 31) == 32 && length == 2);
+    ASSERT(FindContiguous(29) == 2 && NextSet(2, numBits) == 31);
     Clear(0);
     Clear(1);
     Clear(31);
 
+    MarkRange(3, 2 * BitsInWord);	// across a whole word
+    ASSERT(NumClear() == numBits - 2 * BitsInWord);
+    ASSERT(NextClear(0, numBits) == 0 && NextClear(3, numBits) == 3 + 2 * BitsInWord);
+    ASSERT(NextSet(0, numBits) == 3 && !Test(2) && Test(3 + 2 * BitsInWord - 1));
+    ASSERT(FindContiguous(4) == 3 + 2 * BitsInWord);
+    ClearRange(4, 2 * BitsInWord - 2);
+    ASSERT(NumClear() == numBits - 2 && Test(3) && Test(2 + 2 * BitsInWord));
+    ClearRange(0, numBits);
+    ASSERT(NumClear() == numBits && NumClearIn(1, numBits - 1) == numBits - 1);
+
     for (i = 0; i < numBits; i++) {
         Mark(i);
     }
     ASSERT(FindAndSet() == -1);		// bitmap should be full!
+    ASSERT(NumClear() == 0);
+    Clear(numBits - 1);
+    ASSERT(FindAndSet() == numBits - 1);
     for (i = 0; i < numBits; i++) {
         Clear(i);
     }
+    ASSERT(NumClear() == numBits);
 }
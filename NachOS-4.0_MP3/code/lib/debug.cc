@@ -18,28 +18,29 @@
 //
 //	If the flag is "+", we enable all DEBUG messages.
 //
+//	The list is turned into a table with a bit for each possible
+//	flag, so that IsEnabled doesn't have to search it.
+//
 // 	"flagList" is a string of characters for whose DEBUG messages are 
 //		to be enabled.
 //----------------------------------------------------------------------
 
 Debug::Debug(char *flagList)
 {
-    enableFlags = flagList;
-}
-
-
-//----------------------------------------------------------------------
-// Debug::IsEnabled
-//      Return TRUE if DEBUG messages with "flag" are to be printed.
-//----------------------------------------------------------------------
+    unsigned char flag;
 
-bool
-Debug::IsEnabled(char flag)
-{
-    if (enableFlags != NULL) {
-	return ((strchr(enableFlags, flag) != 0) 
-		|| (strchr(enableFlags, '+') != 0));
-    } else {
-    	return FALSE;
+    for (int i = 0; i < 256 / 32; i++)
+	enabled[i] = 0;
+    anyEnabled = FALSE;
+    if (flagList == NULL)
+	return;
+    for (char *p = flagList; *p != '\0'; p++) {
+	flag = (unsigned char) *p;
+	enabled[flag >> 5] |= 1u << (flag & 31);
+	anyEnabled = TRUE;
+    }
+    if (strchr(flagList, dbgAll) != NULL) {
+	for (int i = 0; i < 256 / 32; i++)
+	    enabled[i] = ~0u;
     }
 }
@@ -6,6 +6,12 @@
 //	passed to Nachos (-d).  You are encouraged to add your own
 //	debugging flags.  Please.... 
 //
+//	Which flags are on is worked out once, when the Debug object is
+//	made, so a DEBUG whose flag is off costs one test of "anyEnabled"
+//	-- DEBUG is used on every simulated instruction and memory
+//	reference.  Compiling with -DNDEBUG_TRACE removes the messages
+//	altogether.
+//
 // Copyright (c) 1992-1996 The Regents of the University of California.
 // All rights reserved.  See copyright.h for copyright notice and limitation 
 // of liability and disclaimer of warranty provisions.
@@ -34,10 +40,19 @@ class Debug {
   public:
     Debug(char *flagList);
 
-    bool IsEnabled(char flag);
+    bool IsEnabled(char flag) {
+#ifdef NDEBUG_TRACE
+	return FALSE;
+#else
+	return anyEnabled && ((enabled[(unsigned char) flag >> 5]
+				 >> ((unsigned char) flag & 31)) & 1);
+#endif
+    }
 
   private:
-    char *enableFlags;		// controls which DEBUG messages are printed
+    bool anyEnabled;		// is any flag on?
+    unsigned int enabled[256 / 32];	// bit "flag" is set if DEBUG
+				// messages with that flag are printed
 };
 
 extern Debug *debug;
@@ -46,11 +61,21 @@ extern Debug *debug;
 //----------------------------------------------------------------------
 // DEBUG
 //      If flag is enabled, print a message.
+//
+//	With NDEBUG_TRACE, the message is still compiled, so that it
+//	stays correct, but it is dead code.
 //----------------------------------------------------------------------
+#ifdef NDEBUG_TRACE
+#define DEBUG(flag,expr)                                                     \
+    if (TRUE) {} else { 						\
+        cerr << expr << "\n";   				        \
+    }
+#else
 #define DEBUG(flag,expr)                                                     \
     if (!debug->IsEnabled(flag)) {} else { 				\
         cerr << expr << "\n";   				        \
     }
+#endif
 
 
 //----------------------------------------------------------------------
@@ -0,0 +1,196 @@
+// dlist.h 
+//	Data structures for intrusive doubly linked lists.
+//
+//	Unlike a List, which allocates a ListElement to hold each item,
+//	a DList links the items themselves: each item embeds a DLink,
+//	which holds its neighbours on the list.  Nothing is
+//	allocated to put an item on a list or take it off, and since
+//	each item knows its neighbours (and which list it is on),
+//	removing it from the middle of a list, or checking whether it is
+//	on one, is O(1) rather than a walk down the list.
+//
+//	An item can only be on one list through each DLink it embeds.
+//	To be on several lists at once, it embeds one DLink for each,
+//	told apart by the "Tag" template argument.  The item type tells
+//	the list where the link is by defining, for each tag,
+//
+//	    DLink<T, Tag> *Link(DLink<T, Tag> *) { return &<its link>; }
+//
+//	(the argument is only there to pick the right one).  The links
+//	are members rather than base classes so that they can go after
+//	members whose offsets must not change, such as Thread's first two.
+//
+// Copyright (c) 1992-1996 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation 
+// of liability and disclaimer of warranty provisions.
+
+#ifndef DLIST_H
+#define DLIST_H
+
+#include "copyright.h"
+#include "debug.h"
+
+template <class T, int Tag> class DList;
+
+// The following class defines the links an item needs to be on one
+// DList.  It is private to DList, apart from being embedded.
+
+template <class T, int Tag = 0>
+class DLink {
+  public:
+    DLink() { dlNext = dlPrev = NULL; dlList = NULL; }
+
+  private:
+    T *dlNext;			// next item on the list, or NULL
+    T *dlPrev;			// previous item on the list, or NULL
+    DList<T, Tag> *dlList;	// the list it is on, or NULL
+
+    friend class DList<T, Tag>;
+};
+
+// The following class defines an intrusive doubly linked list of items
+// of type T, which must inherit DLink<T, Tag>.
+
+template <class T, int Tag = 0>
+class DList {
+  public:
+    DList() { first = last = NULL; numInList = 0; }
+    ~DList() {}			// the items are not ours to free
+
+    void Append(T *item) { InsertAfter(item, last); }
+				// put item at the end of the list
+    void Prepend(T *item) { InsertAfter(item, NULL); }
+				// put item at the beginning of the list
+
+    T *Front() { return first; }	// first item, or NULL
+    T *Back() { return last; }	// last item, or NULL
+    T *Next(T *item) { return Link(item)->dlNext; }
+				// the item after item, or NULL
+    T *RemoveFront() { T *item = first; if (item != NULL) Remove(item); return item; }
+				// take the first item off, or NULL
+    T *RemoveBack() { T *item = last; if (item != NULL) Remove(item); return item; }
+				// take the last item off, or NULL
+    void Remove(T *item);	// take item off the list, wherever it is
+
+    bool IsInList(T *item) { return Link(item)->dlList == this; }
+    int NumInList() { return numInList; }
+    bool IsEmpty() { return numInList == 0; }
+
+    void Apply(void (*func)(T *));	// call func on every item, in order
+
+    void SelfTest(T *p, int numEntries);
+				// verify module is working
+
+  private:
+    static DLink<T, Tag> *Link(T *item)
+	{ return item->Link((DLink<T, Tag> *) NULL); }
+    void InsertAfter(T *item, T *prev);	// link item in after prev, or
+					// at the front if prev is NULL
+
+    T *first;			// head of the list, NULL if it is empty
+    T *last;			// last item on the list
+    int numInList;		// number of items on the list
+};
+
+//----------------------------------------------------------------------
+// DList<T,Tag>::InsertAfter
+//	Link an item, which must not be on a list, into this one after
+//	"prev", or at the front if "prev" is NULL.
+//----------------------------------------------------------------------
+
+template <class T, int Tag>
+void
+DList<T,Tag>::InsertAfter(T *item, T *prev)
+{
+    DLink<T, Tag> *link = Link(item);
+    T *next = (prev == NULL) ? first : Link(prev)->dlNext;
+
+    ASSERT(link->dlList == NULL);
+    link->dlList = this;
+    link->dlPrev = prev;
+    link->dlNext = next;
+    if (prev == NULL)
+	first = item;
+    else
+	Link(prev)->dlNext = item;
+    if (next == NULL)
+	last = item;
+    else
+	Link(next)->dlPrev = item;
+    numInList++;
+}
+
+//----------------------------------------------------------------------
+// DList<T,Tag>::Remove
+//	Unlink an item from the list, using its own links to find its
+//	neighbours.
+//----------------------------------------------------------------------
+
+template <class T, int Tag>
+void
+DList<T,Tag>::Remove(T *item)
+{
+    DLink<T, Tag> *link = Link(item);
+
+    ASSERT(link->dlList == this);
+    if (link->dlPrev == NULL)
+	first = link->dlNext;
+    else
+	Link(link->dlPrev)->dlNext = link->dlNext;
+    if (link->dlNext == NULL)
+	last = link->dlPrev;
+    else
+	Link(link->dlNext)->dlPrev = link->dlPrev;
+    link->dlNext = link->dlPrev = NULL;
+    link->dlList = NULL;
+    numInList--;
+}
+
+//----------------------------------------------------------------------
+// DList<T,Tag>::Apply
+//	Call "func" on every item on the list, front to back.  "func"
+//	must not take the item off the list.
+//----------------------------------------------------------------------
+
+template <class T, int Tag>
+void
+DList<T,Tag>::Apply(void (*func)(T *))
+{
+    for (T *item = first; item != NULL; item = Link(item)->dlNext)
+	(*func)(item);
+}
+
+//----------------------------------------------------------------------
+// DList<T,Tag>::SelfTest
+//	Test whether this module is working: add the items at both ends,
+//	take one out of the middle, and take the rest off both ends.
+//
+//	"p" -- array of items to put on the list; at least three
+//	"numEntries" -- number of items in the array
+//----------------------------------------------------------------------
+
+template <class T, int Tag>
+void
+DList<T,Tag>::SelfTest(T *p, int numEntries)
+{
+    int i;
+
+    ASSERT(IsEmpty() && numEntries >= 3);
+    for (i = 1; i < numEntries; i++)
+	Append(&p[i]);
+    Prepend(&p[0]);
+    ASSERT(NumInList() == numEntries && Front() == &p[0]
+		&& Back() == &p[numEntries - 1]);
+    for (i = 0; i < numEntries - 1; i++)
+	ASSERT(Next(&p[i]) == &p[i + 1]);
+
+    Remove(&p[1]);
+    ASSERT(!IsInList(&p[1]) && Next(&p[0]) == &p[2]);
+    ASSERT(RemoveBack() == &p[numEntries - 1]);
+    ASSERT(RemoveFront() == &p[0]);
+    for (i = 2; i < numEntries - 1; i++)
+	ASSERT(RemoveFront() == &p[i]);
+    ASSERT(IsEmpty() && Front() == NULL && RemoveFront() == NULL);
+}
+
+#endif // DLIST_H
@@ -1,11 +1,15 @@
 // hash.cc 
 //     	Routines to manage a self-expanding hash table of arbitrary things.
 //	The hashing function is supplied by the objects being put into
-//	the table; we use chaining to resolve hash conflicts.
+//	the table; we use open addressing to resolve hash conflicts.
 //
-//	The hash table is implemented as an array of sorted lists,
-//	and we expand the hash table if the number of elements in the table
-//	gets too big.
+//	The hash table is implemented as an array of slots, each holding
+//	an item, its key's hash, and how far it is from the slot the hash
+//	picks (its "home").  A key is looked for from its home onwards;
+//	an insertion that passes an item closer to its own home than the
+//	new item would be takes that slot, and carries on with the item
+//	it displaced ("Robin Hood").  We expand the hash table if it gets
+//	too full.
 // 
 //     	NOTE: Mutual exclusion must be provided by the caller.
 //
@@ -13,9 +17,10 @@
 // All rights reserved.  See copyright.h for copyright notice and limitation 
 // of liability and disclaimer of warranty provisions.
 
-const int InitialBuckets = 4;	// how big a hash table do we start with
-const int ResizeRatio = 3;	// when do we grow the hash table?
-const int IncreaseSizeBy = 4;	// how much do we grow table when needed?
+const int InitialSlots = 8;	// how big a hash table do we start with
+				// (a power of two)
+const int MaxFullPercent = 75;	// when do we grow the hash table?
+const int IncreaseSizeBy = 2;	// how much do we grow table when needed?
 
 #include "copyright.h"
 
@@ -29,25 +34,30 @@ template <class Key, class T>
 HashTable<Key,T>::HashTable(Key (*get)(T x), unsigned (*hFunc)(Key x))
 { 
     numItems = 0;
-    InitBuckets(InitialBuckets);
+    InitSlots(InitialSlots);
     getKey = get;
     hash = hFunc;
 }
 
 //----------------------------------------------------------------------
-// HashTable<Key,T>::InitBuckets
-//	Initialize the bucket array for a hash table.
+// HashTable<Key,T>::InitSlots
+//	Initialize the slot arrays for a hash table, all empty.
 //	Called by the constructor and by ReHash().
 //----------------------------------------------------------------------
 
 template <class Key, class T>
 void
-HashTable<Key,T>::InitBuckets(int sz)
+HashTable<Key,T>::InitSlots(int sz)
 { 
-    numBuckets = sz;
-    buckets = new Bucket[numBuckets];
-    for (int i = 0; i < sz; i++) {
-    	buckets[i] = new List<T>;
+    numSlots = sz;
+    for (shift = 32; sz > 1; sz /= 2)
+	shift--;
+    ASSERT((1 << (32 - shift)) == numSlots);	// a power of two
+    items = new T[numSlots];
+    hashes = new unsigned[numSlots];
+    distance = new unsigned short[numSlots];
+    for (int i = 0; i < numSlots; i++) {
+    	distance[i] = 0;
     }
 }
 
@@ -60,36 +70,38 @@ template <class Key, class T>
 HashTable<Key,T>::~HashTable()
 { 
     ASSERT(IsEmpty());		// make sure table is empty
-    DeleteBuckets(buckets, numBuckets);
+    DeleteSlots();
 }
 
 //----------------------------------------------------------------------
-// HashTable<Key,T>::DeleteBuckets
-//	De-Initialize the bucket array for a hash table.
+// HashTable<Key,T>::DeleteSlots
+//	De-Initialize the slot arrays for a hash table.
 //	Called by the destructor and by ReHash().
 //----------------------------------------------------------------------
 
 template <class Key, class T>
 void
-HashTable<Key,T>::DeleteBuckets(List<T> **table, int sz)
+HashTable<Key,T>::DeleteSlots()
 { 
-    for (int i = 0; i < sz; i++) {
-    	delete table[i];
-    }
-    delete [] table;
+    delete [] items;
+    delete [] hashes;
+    delete [] distance;
 }
 
 //----------------------------------------------------------------------
-// HashTable<Key,T>::HashValue
-//      Return hash table bucket that would contain key.
+// HashTable<Key,T>::HomeSlot
+//      Return the slot an item whose key hashes to "h" belongs in.
+//	The hash is multiplied by a constant (2^32 divided by the golden
+//	ratio) and the top bits taken, so that keys whose hashes differ
+//	only in their high bits, or are in a sequence, still spread out.
 //----------------------------------------------------------------------
 
 template <class Key, class T>
 int
-HashTable<Key, T>::HashValue(Key key) const 
+HashTable<Key, T>::HomeSlot(unsigned h) const 
 {
-    int result = (*hash)(key) % numBuckets;
-    ASSERT(result >= 0 && result < numBuckets);
+    int result = (shift == 32) ? 0 : (int) ((h * 2654435769u) >> shift);
+    ASSERT(result >= 0 && result < numSlots);
     return result;
 }
 
@@ -97,11 +109,10 @@ HashTable<Key, T>::HashValue(Key key) const
 // HashTable<Key,T>::Insert
 //      Put an item into the hashtable.
 //      
-//	Resize the table if the # of elements / # of buckets is too big.
-//	Then allocate a HashElement to keep track of the key, item pair,
-//	and add it to the right bucket.
+//	Resize the table if it is too full.  Then put the item in the
+//	first slot from its home that is empty, or that holds an item
+//	closer to its own home (which moves on in turn).
 //
-//	"key" is the key we'll use to find this item.
 //	"item" is the thing to put in the table.
 //----------------------------------------------------------------------
 
@@ -113,71 +124,108 @@ HashTable<Key,T>::Insert(T item)
 
     ASSERT(!IsInTable(key));
 
-    if ((numItems / numBuckets) >= ResizeRatio) {
+    if ((numItems + 1) * 100 > numSlots * MaxFullPercent) {
 	ReHash();
     }
 
-    buckets[HashValue(key)]->Append(item);
+    Place(item, (*hash)(key));
     numItems++;
 
     ASSERT(IsInTable(key));
 }
 
+//----------------------------------------------------------------------
+// HashTable<Key,T>::Place
+//      Put "item", whose key hashes to "h", into the table, displacing
+//	items as need be.  There must be an empty slot.
+//----------------------------------------------------------------------
+
+template <class Key, class T>
+void
+HashTable<Key,T>::Place(T item, unsigned h)
+{
+    int slot = HomeSlot(h);
+    unsigned short dist = 1;
+
+    while (distance[slot] != 0) {
+	if (distance[slot] < dist) {	// it is better off than we are
+	    T otherItem = items[slot];
+	    unsigned otherHash = hashes[slot];
+	    unsigned short otherDist = distance[slot];
+
+	    items[slot] = item;
+	    hashes[slot] = h;
+	    distance[slot] = dist;
+	    item = otherItem;
+	    h = otherHash;
+	    dist = otherDist;
+	}
+	slot = (slot + 1) & (numSlots - 1);
+	dist++;
+    }
+    items[slot] = item;
+    hashes[slot] = h;
+    distance[slot] = dist;
+}
+
 //----------------------------------------------------------------------
 // HashTable<Key,T>::ReHash
 //      Increase the size of the hashtable, by 
 //	  (i) making a new table
 //	  (ii) moving all the elements into the new table
 //	  (iii) deleting the old table
+//
+//	The hashes were kept, so the keys need not be hashed again.
 //----------------------------------------------------------------------
 
 template <class Key, class T>
 void
 HashTable<Key,T>::ReHash()
 {
-    Bucket *oldTable = buckets;
-    int oldSize = numBuckets;
-    T item;
+    T *oldItems = items;
+    unsigned *oldHashes = hashes;
+    unsigned short *oldDistance = distance;
+    int oldSize = numSlots;
 
     SanityCheck();
-    InitBuckets(numBuckets * IncreaseSizeBy);
+    InitSlots(numSlots * IncreaseSizeBy);
 
     for (int i = 0; i < oldSize; i++) {
-	while (!oldTable[i]->IsEmpty()) {
-	    item = oldTable[i]->RemoveFront();
-	    buckets[HashValue(getKey(item))]->Append(item);
+	if (oldDistance[i] != 0) {
+	    Place(oldItems[i], oldHashes[i]);
         }
     }
-    DeleteBuckets(oldTable, oldSize);
+    delete [] oldItems;
+    delete [] oldHashes;
+    delete [] oldDistance;
     SanityCheck();
 }
 
 //----------------------------------------------------------------------
-// HashTable<Key,T>::FindInBucket
-//      Find an item in a hash table bucket, from it's key
-//
-//	"bucket" -- the list storing the item, if it's in the table 
-//	"key" -- the key uniquely identifying the item
+// HashTable<Key,T>::FindSlot
+//      Find the slot holding the item with key "key".  Only the items
+//	whose hash matches are compared with the key; the search stops
+//	at the first slot whose item is closer to its home than "key"
+//	would be, since Insert would have put it there.
 // 
 // Returns:
-//	Whether item is found, and if found, the item.
+//	The slot, or -1 if the key isn't in the table.
 //----------------------------------------------------------------------
 
 template <class Key, class T>
-bool
-HashTable<Key,T>::FindInBucket(int bucket, 
-				Key key, T *itemPtr) const
+int
+HashTable<Key,T>::FindSlot(Key key) const
 {
-    ListIterator<T> iterator(buckets[bucket]);
+    unsigned h = (*hash)(key);
+    int slot = HomeSlot(h);
 
-    for (; !iterator.IsDone(); iterator.Next()) {
-	if (key == getKey(iterator.Item())) { // found!
-	    *itemPtr = iterator.Item();
-	    return TRUE;
+    for (int dist = 1; distance[slot] >= dist; dist++) {
+	if (hashes[slot] == h && key == getKey(items[slot])) { // found!
+	    return slot;
         }
+	slot = (slot + 1) & (numSlots - 1);
     }
-    *itemPtr = NULL;
-    return FALSE;
+    return -1;
 }
 
 //----------------------------------------------------------------------
@@ -185,21 +233,27 @@ HashTable<Key,T>::FindInBucket(int bucket,
 //      Find an item from the hash table.
 // 
 // Returns:
-//	The item or NULL if not found. 
+//	Whether item is found, and if found, the item; "*itemPtr" is
+//	left as it was if not.
 //----------------------------------------------------------------------
 
 template <class Key, class T>
 bool
 HashTable<Key,T>::Find(Key key, T *itemPtr) const
 {
-    int bucket = HashValue(key);
+    int slot = FindSlot(key);
     
-    return FindInBucket(bucket, key, itemPtr); 
+    if (slot == -1)
+	return FALSE;
+    *itemPtr = items[slot];
+    return TRUE;
 }
 
 //----------------------------------------------------------------------
 // HashTable<Key,T>::Remove
 //      Remove an item from the hash table. The item must be in the table.
+//	The items after it that are not in their home slots move back
+//	one slot each, so that no tombstone is left behind.
 // 
 // Returns:
 //	The removed item.
@@ -209,13 +263,22 @@ template <class Key, class T>
 T
 HashTable<Key,T>::Remove(Key key)
 {
-    int bucket = HashValue(key);
+    int slot = FindSlot(key);
+    int next;
     T item;
-    bool found = FindInBucket(bucket, key, &item); 
 
-    ASSERT(found);	// item must be in table
+    ASSERT(slot != -1);	// item must be in table
 
-    buckets[bucket]->Remove(item);
+    item = items[slot];
+    next = (slot + 1) & (numSlots - 1);
+    while (distance[next] > 1) {
+	items[slot] = items[next];
+	hashes[slot] = hashes[next];
+	distance[slot] = distance[next] - 1;
+	slot = next;
+	next = (next + 1) & (numSlots - 1);
+    }
+    distance[slot] = 0;
     numItems--;
 
     ASSERT(!IsInTable(key));
@@ -234,37 +297,41 @@ template <class Key,class T>
 void
 HashTable<Key,T>::Apply(void (*func)(T)) const
 {
-    for (int bucket = 0; bucket < numBuckets; bucket++) {
-        buckets[bucket]->Apply(func);
+    for (int slot = 0; slot < numSlots; slot++) {
+	if (distance[slot] != 0) {
+	    (*func)(items[slot]);
+	}
     }
 }
 
 //----------------------------------------------------------------------
-// HashTable<Key,T>::FindNextFullBucket
-//      Find the next bucket in the hash table that has any items in it.
+// HashTable<Key,T>::FindNextFullSlot
+//      Find the next slot in the hash table that has an item in it.
 //
-//	"bucket" -- where to start looking for full buckets
+//	"slot" -- where to start looking for full slots
 //----------------------------------------------------------------------
 
 template <class Key,class T>
 int
-HashTable<Key,T>::FindNextFullBucket(int bucket) const
+HashTable<Key,T>::FindNextFullSlot(int slot) const
 { 
-    for (; bucket < numBuckets; bucket++) {
-	if (!buckets[bucket]->IsEmpty()) {
+    for (; slot < numSlots; slot++) {
+	if (distance[slot] != 0) {
 	     break;
 	}
     }
-    return bucket;
+    return slot;
 }
 
 //----------------------------------------------------------------------
 // HashTable<Key,T>::SanityCheck
 //      Test whether this is still a legal hash table.
 //
-//	Tests: are all the buckets legal?
-//	       does the table have the right # of elements?
-//	       do all the elements hash to where they are stored?
+//	Tests: does the table have the right # of elements?
+//	       is each element's hash that of its key?
+//	       is each element as far from its home as it says?
+//	       is each element no further from home than the next one,
+//		 plus one (the Robin Hood order)?
 //----------------------------------------------------------------------
 
 template <class Key, class T>
@@ -272,16 +339,18 @@ void
 HashTable<Key,T>::SanityCheck() const
 {
     int numFound = 0;
-    ListIterator<T> *iterator;
-
-    for (int i = 0; i < numBuckets; i++) {
-	buckets[i]->SanityCheck();
-	numFound += buckets[i]->NumInList();
-	iterator = new ListIterator<T>(buckets[i]);
-        for (; !iterator->IsDone(); iterator->Next()) {
-	    ASSERT(i == HashValue(getKey(iterator->Item())));
-        }
-        delete iterator;
+
+    for (int i = 0; i < numSlots; i++) {
+	int next = (i + 1) & (numSlots - 1);
+
+	if (distance[i] == 0) {
+	    ASSERT(distance[next] <= 1);
+	    continue;
+	}
+	numFound++;
+	ASSERT(hashes[i] == (*hash)(getKey(items[i])));
+	ASSERT(((HomeSlot(hashes[i]) + distance[i] - 1) & (numSlots - 1)) == i);
+	ASSERT(distance[next] <= distance[i] + 1);
     }
     ASSERT(numItems == numFound);
 
@@ -311,9 +380,24 @@ HashTable<Key,T>::SelfTest(T *p, int numEntries)
         ASSERT(IsInTable(getKey(p[i])));
         ASSERT(!IsEmpty());
     }
+    SanityCheck();
+
+    // the iterator should step through each item once
+    iterator = new HashIterator<Key,T>(this);
+    for (i = 0; !iterator->IsDone(); iterator->Next()) {
+	i++;
+    }
+    ASSERT(i == numEntries);
+    delete iterator;
     
-    // should be able to get out everything we put in
-    for (i = 0; i < numEntries; i++) {  
+    // should be able to get out everything we put in -- every other
+    // one first, so that the rest are moved back over their slots
+    for (i = 0; i < numEntries; i += 2) {  
+        ASSERT(Remove(getKey(p[i])) == p[i]);
+    }
+    SanityCheck();
+    for (i = 1; i < numEntries; i += 2) {  
+        ASSERT(IsInTable(getKey(p[i])));
         ASSERT(Remove(getKey(p[i])) == p[i]);
     }
 
@@ -332,11 +416,7 @@ template <class Key, class T>
 HashIterator<Key,T>::HashIterator(HashTable<Key,T> *tbl) 
 { 
     table = tbl;
-    bucket = table->FindNextFullBucket(0);
-    bucketIter = NULL;
-    if (bucket < table->numBuckets) {
-	bucketIter = new ListIterator<T>(table->buckets[bucket]);
-    }
+    slot = table->FindNextFullSlot(0);
 }
 
 //----------------------------------------------------------------------
@@ -348,13 +428,5 @@ template <class Key,class T>
 void
 HashIterator<Key,T>::Next() 
 { 
-    bucketIter->Next();
-    if (bucketIter->IsDone()) {
-	delete bucketIter;
-	bucketIter = NULL;
-        bucket = table->FindNextFullBucket(++bucket);
-        if (bucket < table->numBuckets) {
-	    bucketIter = new ListIterator<T>(table->buckets[bucket]);
-        }
-    }
+    slot = table->FindNextFullSlot(slot + 1);
 }
@@ -0,0 +1,97 @@
+// hostprof.cc
+//	Routines to sample which layer of the simulator the host is in,
+//	and to print the breakdown.  See hostprof.h.
+//
+// Copyright (c) 1992-1996 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "hostprof.h"
+#include "debug.h"
+#include "sysdep.h"
+
+#ifndef NO_PERF_COUNTERS
+
+static char *tagNames[NumProfTags] = { "kernel", "instructions", "translate",
+				       "interrupt", "handlers", "scheduler",
+				       "host_io" };
+
+volatile int hostProfTag = ProfKernel;
+static volatile int samples[NumProfTags];	// taken in each layer
+static bool sampling = FALSE;
+
+//----------------------------------------------------------------------
+// Sample
+// 	The SIGPROF handler: count a sample for the current layer.
+//----------------------------------------------------------------------
+
+static void
+Sample(int sig)
+{
+    samples[hostProfTag]++;
+}
+
+//----------------------------------------------------------------------
+// HostProfStart
+// 	Start taking a sample every HostProfInterval microseconds of host
+//	CPU time -- or as often as the host's clock can, if that is less
+//	often; only the shares of the samples are printed.
+//----------------------------------------------------------------------
+
+void
+HostProfStart()
+{
+    sampling = TRUE;
+    CallOnProfTick(Sample, HostProfInterval);
+}
+
+//----------------------------------------------------------------------
+// HostProfPrint
+// 	Stop sampling, and print how many samples fell in each layer,
+//	and what share of them, busiest first.
+//----------------------------------------------------------------------
+
+void
+HostProfPrint()
+{
+    bool printed[NumProfTags];
+    int total = 0;
+
+    if (!sampling)
+	return;
+    CallOnProfTick(NULL, 0);
+    sampling = FALSE;
+    for (int t = 0; t < NumProfTags; t++) {
+	total += samples[t];
+	printed[t] = FALSE;
+    }
+    cout << "Host profile: " << total << " samples of host CPU time\n";
+    if (total == 0)
+	return;
+    for (int n = 0; n < NumProfTags; n++) {
+	int most = -1;
+
+	for (int t = 0; t < NumProfTags; t++)
+	    if (!printed[t] && (most == -1 || samples[t] > samples[most]))
+		most = t;
+	printed[most] = TRUE;
+	cout << "  " << tagNames[most] << " " << samples[most] << " ("
+	     << (100.0 * samples[most]) / total << "%)\n";
+    }
+}
+
+#else // NO_PERF_COUNTERS
+
+void
+HostProfStart()
+{
+}
+
+void
+HostProfPrint()
+{
+    cout << "Host profile: compiled out (NO_PERF_COUNTERS)\n";
+}
+
+#endif // NO_PERF_COUNTERS
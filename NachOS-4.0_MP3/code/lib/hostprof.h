@@ -0,0 +1,83 @@
+// hostprof.h
+//	A sampling profiler of the host time Nachos itself takes (-hostprof):
+//	which layer of the simulator the host CPU is spent in, so that
+//	speeding it up can start where it matters.
+//
+//	The simulator's layers are interleaved and mostly inlined, so a
+//	host profiler's program counters say little; instead, each layer
+//	marks where it runs with a HostProfScope, which sets the one
+//	current tag for as long as it is in scope, and puts the last one
+//	back after:
+//
+//		HostProfScope scope(ProfTranslate);
+//
+//	A SIGPROF timer then samples the tag every HostProfInterval
+//	microseconds of host CPU time.  Code nobody marked (threads,
+//	synchronization, the lists everything uses) counts for whatever
+//	layer called it, or for "kernel".  Each thread's stack keeps its
+//	own saved tags, so a context switch puts back the tags of the
+//	thread switched to as its scopes end; a new thread starts out
+//	in "kernel".
+//
+//	Setting a tag is two stores; compiling with -DNO_PERF_COUNTERS, as
+//	for the counters of perfcount.h, takes the scopes out too.
+//
+// Copyright (c) 1992-1996 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#ifndef HOSTPROF_H
+#define HOSTPROF_H
+
+#include "copyright.h"
+
+// The layers host time is charged to
+
+enum HostProfTag {
+    ProfKernel,			// anything not in one of the below
+    ProfInstruction,		// decoding and executing MIPS instructions
+    ProfTranslate,		// reading and writing user memory
+    ProfInterrupt,		// advancing the clock, and checking for
+				// interrupts that are due
+    ProfHandler,		// device interrupt handlers
+    ProfScheduler,		// ready queues, aging, and switching
+    ProfHostIO,			// UNIX files, sockets and polling
+    NumProfTags
+};
+
+const int HostProfInterval = 1000;	// microseconds of host CPU time
+					// between samples
+
+#ifndef NO_PERF_COUNTERS
+
+extern volatile int hostProfTag;	// what the host is doing now
+
+class HostProfScope {
+  public:
+    HostProfScope(HostProfTag tag) { saved = hostProfTag; hostProfTag = tag; }
+    ~HostProfScope() { hostProfTag = saved; }
+
+  private:
+    int saved;				// the tag to put back
+};
+
+inline void HostProfSet(HostProfTag tag) { hostProfTag = tag; }
+					// for a new thread, which has no
+					// scope to go back to
+
+#else // NO_PERF_COUNTERS
+
+class HostProfScope {
+  public:
+    HostProfScope(HostProfTag tag) {}
+};
+
+inline void HostProfSet(HostProfTag tag) {}
+
+#endif // NO_PERF_COUNTERS
+
+extern void HostProfStart();		// start sampling
+extern void HostProfPrint();		// stop, and print where the
+					// samples fell
+
+#endif // HOSTPROF_H
@@ -1,6 +1,10 @@
 // libtest.cc 
 //	Driver code to call self-test routines for standard library
-//	classes -- bitmaps, lists, sorted lists, and hash tables.
+//	classes -- bitmaps, lists, sorted lists, hash tables, rings, and
+//	queues.
+//
+//	Also a microbenchmark of the same classes, and of a binary heap
+//	as a replacement for sorted lists, timed on the host (-bench-lib).
 //
 // Copyright (c) 1992-1996 The Regents of the University of California.
 // All rights reserved.  See copyright.h for copyright notice and limitation 
@@ -11,6 +15,10 @@
 #include "bitmap.h"
 #include "list.h"
 #include "hash.h"
+#include "ring.h"
+#include "dlist.h"
+#include "queue.h"
+#include "perfcount.h"
 #include "sysdep.h"
 
 //----------------------------------------------------------------------
@@ -50,6 +58,16 @@ HashKey(char *str) {
     return atoi(str);
 }
 
+// An item that can be on two DLists at once, for testing DLists
+
+class DListItem {
+  public:
+    DLink<DListItem, 0> first;
+    DLink<DListItem, 1> second;
+    DLink<DListItem, 0> *Link(DLink<DListItem, 0> *) { return &first; }
+    DLink<DListItem, 1> *Link(DLink<DListItem, 1> *) { return &second; }
+};
+
 // Array of values to be inserted into a List or SortedList. 
 static int listTestVector[] = { 9, 5, 7 };
 
@@ -58,10 +76,40 @@ static int listTestVector[] = { 9, 5, 7 };
 static char *hashTestVector[] = { "0", "1", "2", "3", "4", "5", "6",
 	 "7", "8", "9", "10", "11", "12", "13", "14"};
 
+//----------------------------------------------------------------------
+// PerfSelfTest
+// 	Check that a histogram's values land in the right buckets and
+//	add up.  It is made only when the test runs, so that -stats
+//	shows it only then.
+//----------------------------------------------------------------------
+
+static void
+PerfSelfTest()
+{
+#ifndef NO_PERF_COUNTERS
+    static PerfCounter counter("libtest", "counter");
+    static PerfHistogram histogram("libtest", "histogram");
+    PerfValue before = counter.Value(), recorded = histogram.Count();
+    PerfValue zeros = histogram.Bucket(0), sum = histogram.Sum();
+
+    ASSERT(PerfBucket(-1) == 0 && PerfBucket(0) == 0);
+    ASSERT(PerfBucket(1) == 1 && PerfBucket(2) == 2 && PerfBucket(3) == 2);
+    ASSERT(PerfBucket(1 << (PerfBuckets - 2)) == PerfBuckets - 1);
+    ASSERT(PerfBucket(0x7fffffff) == PerfBuckets - 1);
+    counter.Inc();
+    counter.Add(2);
+    ASSERT(counter.Value() == before + 3);
+    for (int i = 0; i < 8; i++)
+	histogram.Record(i);
+    ASSERT(histogram.Bucket(0) == zeros + 1);
+    ASSERT(histogram.Count() == recorded + 8 && histogram.Sum() == sum + 28);
+#endif
+}
+
 //----------------------------------------------------------------------
 // LibSelfTest
-//	Run self tests on bitmaps, lists, sorted lists, and 
-//	hash tables.
+//	Run self tests on bitmaps, lists, sorted lists, 
+//	hash tables, rings, intrusive lists, queues and perf counters.
 //----------------------------------------------------------------------
 
 void
@@ -71,15 +119,500 @@ LibSelfTest () {
     SortedList<int> *sortList = new SortedList<int>(IntCompare);
     HashTable<int, char *> *hashTable = 
 	new HashTable<int, char *>(HashKey, HashInt);
+    Ring<int, 4> *ring = new Ring<int, 4>;
+    Queue<int> *queue = new Queue<int>;
+    DListItem items[4];
+    DList<DListItem, 0> firstList;
+    DList<DListItem, 1> secondList;
 	
 		
     map->SelfTest();
     list->SelfTest(listTestVector, sizeof(listTestVector)/sizeof(int));
     sortList->SelfTest(listTestVector, sizeof(listTestVector)/sizeof(int));
     hashTable->SelfTest(hashTestVector, sizeof(hashTestVector)/sizeof(char *));
+    ring->SelfTest(listTestVector, sizeof(listTestVector)/sizeof(int));
+    queue->SelfTest(listTestVector, sizeof(listTestVector)/sizeof(int));
+    firstList.Append(&items[0]);	// on one list while tested on the other
+    secondList.SelfTest(items, 4);
+    firstList.Remove(&items[0]);
+    firstList.SelfTest(items, 4);
+    PerfSelfTest();
 
     delete map;
     delete list;
     delete sortList;
     delete hashTable;
+    delete ring;
+    delete queue;
+}
+
+// The benchmarks.  Each container is timed doing "n" inserts, "n"
+// lookups, a walk over its "n" items, and "n" removes, for "n" from 10
+// up to BenchItems.  Smaller sizes are repeated in BenchItems / n
+// containers, so that each phase touches BenchItems items, and takes
+// long enough for WallTime to time.
+//
+// Looking up an item in a list or heap means searching it, so those
+// lookups stop at BenchSearches per container.  Adding an item to a
+// List searches it too (to check that the item isn't already there),
+// as does finding its place in a SortedList, so lists are only timed
+// up to MaxListBench items.
+
+const int BenchItems = 1000000;
+const int BenchSearches = 64;
+const int MaxListBench = 1000;
+
+static int *benchKey;		// 0 to n - 1, shuffled
+static int benchSink;		// total of what was found, so that the
+				// compiler can't leave the work out
+
+// A binary heap of integers, smallest first: the shape of the pending
+// interrupt queue (see interrupt.h), timed as a replacement for a
+// SortedList.
+
+class BenchHeap {
+  public:
+    BenchHeap() { size = 16; item = new int[size]; numInHeap = 0; }
+    ~BenchHeap() { delete [] item; }
+
+    void Insert(int x);		// add an item
+    int RemoveMin();		// take the smallest item out
+    bool IsInHeap(int x);	// search for an item
+
+    int *item;			// item[0] is the smallest
+    int numInHeap;		// items in the heap
+    int size;			// items allocated
+};
+
+void
+BenchHeap::Insert(int x)
+{
+    int i;
+
+    if (numInHeap == size) {
+	int *bigger = new int[2 * size];
+
+	bcopy(item, bigger, size * sizeof(int));
+	delete [] item;
+	item = bigger;
+	size *= 2;
+    }
+    for (i = numInHeap++; i > 0 && x < item[(i - 1) / 2]; i = (i - 1) / 2)
+	item[i] = item[(i - 1) / 2];
+    item[i] = x;
+}
+
+int
+BenchHeap::RemoveMin()
+{
+    int min = item[0];
+    int last = item[--numInHeap];
+    int i = 0;
+
+    for (;;) {
+	int child = 2 * i + 1;
+
+	if (child >= numInHeap)
+	    break;
+	if (child + 1 < numInHeap && item[child + 1] < item[child])
+	    child++;
+	if (last <= item[child])
+	    break;
+	item[i] = item[child];
+	i = child;
+    }
+    item[i] = last;
+    return min;
+}
+
+bool
+BenchHeap::IsInHeap(int x)
+{
+    for (int i = 0; i < numInHeap; i++)
+	if (item[i] == x)
+	    return TRUE;
+    return FALSE;
+}
+
+// An item that can be put on a DList, for timing DLists
+
+class BenchItem {
+  public:
+    DLink<BenchItem> link;
+    int key;
+    DLink<BenchItem> *Link(DLink<BenchItem> *) { return &link; }
+};
+
+const int BenchRingSize = 1 << 20;	// at least BenchItems
+
+//----------------------------------------------------------------------
+// BenchKeys
+//	Fill benchKey with 0 to "n" - 1 in a random order -- the same
+//	order every time, so that runs can be compared.
+//----------------------------------------------------------------------
+
+static void
+BenchKeys(int n)
+{
+    unsigned int seed = 1;
+
+    for (int i = 0; i < n; i++)
+	benchKey[i] = i;
+    for (int i = n - 1; i > 0; i--) {
+	int j, key;
+
+	seed = seed * 1103515245 + 12345;
+	j = (seed >> 8) % (i + 1);
+	key = benchKey[i];
+	benchKey[i] = benchKey[j];
+	benchKey[j] = key;
+    }
+}
+
+//----------------------------------------------------------------------
+// BenchReport
+//	Print how long "count" operations "op" on a "container" holding
+//	"n" items took, since "start", as one line of "key=value" fields
+//	after the word "libbench", for a script to pick out:
+//
+//	    libbench container=<class> op=<op> n=<items> ns_per_op=<time>
+//----------------------------------------------------------------------
+
+static void
+BenchReport(char *container, char *op, int n, int count, double start)
+{
+    double seconds = WallTime() - start;
+
+    cout << "libbench container=" << container << " op=" << op
+	 << " n=" << n << " ns_per_op=" << seconds * 1e9 / count << "\n";
+}
+
+//----------------------------------------------------------------------
+// BenchBitmap
+//	Time "reps" bitmaps of "n" bits: Mark each bit, Test each, walk
+//	the set bits with NextSet, Clear each.  (FindAndSet on a nearly
+//	full map takes time proportional to its size, as it looks from
+//	the start each time, so it isn't used to fill them.)
+//----------------------------------------------------------------------
+
+static void
+BenchBitmap(int n, int reps)
+{
+    Bitmap **maps = new Bitmap *[reps];
+    double start;
+    int r, i;
+
+    start = WallTime();
+    for (r = 0; r < reps; r++) {
+	maps[r] = new Bitmap(n);
+	for (i = 0; i < n; i++)
+	    maps[r]->Mark(benchKey[i]);
+    }
+    BenchReport("Bitmap", "insert", n, n * reps, start);
+
+    start = WallTime();
+    for (r = 0; r < reps; r++)
+	for (i = 0; i < n; i++)
+	    benchSink += maps[r]->Test(benchKey[i]);
+    BenchReport("Bitmap", "find", n, n * reps, start);
+
+    start = WallTime();
+    for (r = 0; r < reps; r++)
+	for (i = maps[r]->NextSet(0, n); i < n; i = maps[r]->NextSet(i + 1, n))
+	    benchSink += i;
+    BenchReport("Bitmap", "iterate", n, n * reps, start);
+
+    start = WallTime();
+    for (r = 0; r < reps; r++) {
+	for (i = 0; i < n; i++)
+	    maps[r]->Clear(benchKey[i]);
+	delete maps[r];
+    }
+    BenchReport("Bitmap", "remove", n, n * reps, start);
+    delete [] maps;
+}
+
+//----------------------------------------------------------------------
+// BenchList
+//	Time "reps" lists of "n" integers, used as queues: Append each,
+//	search for some, walk them with a ListIterator, RemoveFront
+//	each.  With "sorted", time SortedLists instead, Inserting each.
+//----------------------------------------------------------------------
+
+static void
+BenchList(int n, int reps, bool sorted)
+{
+    List<int> **lists = new List<int> *[reps];
+    char *name = sorted ? (char *) "SortedList" : (char *) "List";
+    int searches = min(n, BenchSearches);
+    double start;
+    int r, i;
+
+    start = WallTime();
+    for (r = 0; r < reps; r++) {
+	if (sorted) {
+	    SortedList<int> *list = new SortedList<int>(IntCompare);
+
+	    for (i = 0; i < n; i++)
+		list->Insert(benchKey[i]);
+	    lists[r] = list;
+	} else {
+	    lists[r] = new List<int>;
+	    for (i = 0; i < n; i++)
+		lists[r]->Append(benchKey[i]);
+	}
+    }
+    BenchReport(name, "insert", n, n * reps, start);
+
+    start = WallTime();
+    for (r = 0; r < reps; r++)
+	for (i = 0; i < searches; i++)
+	    benchSink += lists[r]->IsInList(benchKey[i]);
+    BenchReport(name, "find", n, searches * reps, start);
+
+    start = WallTime();
+    for (r = 0; r < reps; r++) {
+	ListIterator<int> iter(lists[r]);
+
+	for (; !iter.IsDone(); iter.Next())
+	    benchSink += iter.Item();
+    }
+    BenchReport(name, "iterate", n, n * reps, start);
+
+    start = WallTime();
+    for (r = 0; r < reps; r++) {
+	while (!lists[r]->IsEmpty())
+	    benchSink += lists[r]->RemoveFront();
+	delete lists[r];
+    }
+    BenchReport(name, "remove", n, n * reps, start);
+    delete [] lists;
+}
+
+//----------------------------------------------------------------------
+// BenchHeapOf
+//	Time "reps" BenchHeaps of "n" integers, as a SortedList is timed:
+//	Insert each, search for some, walk the array, RemoveMin each.
+//----------------------------------------------------------------------
+
+static void
+BenchHeapOf(int n, int reps)
+{
+    BenchHeap *heaps = new BenchHeap[reps];
+    int searches = min(n, BenchSearches);
+    double start;
+    int r, i;
+
+    start = WallTime();
+    for (r = 0; r < reps; r++)
+	for (i = 0; i < n; i++)
+	    heaps[r].Insert(benchKey[i]);
+    BenchReport("Heap", "insert", n, n * reps, start);
+
+    start = WallTime();
+    for (r = 0; r < reps; r++)
+	for (i = 0; i < searches; i++)
+	    benchSink += heaps[r].IsInHeap(benchKey[i]);
+    BenchReport("Heap", "find", n, searches * reps, start);
+
+    start = WallTime();
+    for (r = 0; r < reps; r++)
+	for (i = 0; i < heaps[r].numInHeap; i++)
+	    benchSink += heaps[r].item[i];
+    BenchReport("Heap", "iterate", n, n * reps, start);
+
+    start = WallTime();
+    for (r = 0; r < reps; r++)
+	while (heaps[r].numInHeap > 0)
+	    benchSink += heaps[r].RemoveMin();
+    BenchReport("Heap", "remove", n, n * reps, start);
+    delete [] heaps;
+}
+
+//----------------------------------------------------------------------
+// BenchDList
+//	Time "reps" intrusive lists of "n" items: Append each, check
+//	that each is on its list, walk them, RemoveFront each.  Finding
+//	whether an item is on a DList takes no search.
+//----------------------------------------------------------------------
+
+static void
+BenchDList(int n, int reps)
+{
+    BenchItem *items = new BenchItem[n * reps];
+    DList<BenchItem> *lists = new DList<BenchItem>[reps];
+    double start;
+    int r, i;
+
+    for (i = 0; i < n * reps; i++)
+	items[i].key = benchKey[i % n];
+
+    start = WallTime();
+    for (r = 0; r < reps; r++)
+	for (i = 0; i < n; i++)
+	    lists[r].Append(&items[r * n + i]);
+    BenchReport("DList", "insert", n, n * reps, start);
+
+    start = WallTime();
+    for (r = 0; r < reps; r++)
+	for (i = 0; i < n; i++)
+	    benchSink += lists[r].IsInList(&items[r * n + benchKey[i]]);
+    BenchReport("DList", "find", n, n * reps, start);
+
+    start = WallTime();
+    for (r = 0; r < reps; r++)
+	for (BenchItem *p = lists[r].Front(); p != NULL; p = lists[r].Next(p))
+	    benchSink += p->key;
+    BenchReport("DList", "iterate", n, n * reps, start);
+
+    start = WallTime();
+    for (r = 0; r < reps; r++)
+	while (!lists[r].IsEmpty())
+	    benchSink += lists[r].RemoveFront()->key;
+    BenchReport("DList", "remove", n, n * reps, start);
+    delete [] lists;
+    delete [] items;
+}
+
+//----------------------------------------------------------------------
+// BenchRing
+//	Time a ring as a queue of "n" integers, "reps" times over: Put
+//	each, then Get each.  A ring has a fixed capacity, so one ring,
+//	big enough for all of them at once, is used throughout.
+//----------------------------------------------------------------------
+
+static void
+BenchRing(int n, int reps)
+{
+    Ring<int, BenchRingSize> *ring = new Ring<int, BenchRingSize>;
+    double start;
+    int r, i, item;
+
+    start = WallTime();
+    for (r = 0; r < reps; r++)
+	for (i = 0; i < n; i++)
+	    ring->Put(benchKey[i]);
+    BenchReport("Ring", "insert", n, n * reps, start);
+
+    start = WallTime();
+    while (ring->Get(&item))
+	benchSink += item;
+    BenchReport("Ring", "remove", n, n * reps, start);
+    delete ring;
+}
+
+//----------------------------------------------------------------------
+// BenchQueue
+//	Time "reps" queues of "n" integers, as a List is timed: Append
+//	each, walk them with Item, RemoveFront each.
+//----------------------------------------------------------------------
+
+static void
+BenchQueue(int n, int reps)
+{
+    Queue<int> *queues = new Queue<int>[reps];
+    double start;
+    int r, i;
+
+    start = WallTime();
+    for (r = 0; r < reps; r++)
+	for (i = 0; i < n; i++)
+	    queues[r].Append(benchKey[i]);
+    BenchReport("Queue", "insert", n, n * reps, start);
+
+    start = WallTime();
+    for (r = 0; r < reps; r++)
+	for (i = 0; i < n; i++)
+	    benchSink += *queues[r].Item(i);
+    BenchReport("Queue", "iterate", n, n * reps, start);
+
+    start = WallTime();
+    for (r = 0; r < reps; r++)
+	while (!queues[r].IsEmpty())
+	    benchSink += queues[r].RemoveFront();
+    BenchReport("Queue", "remove", n, n * reps, start);
+    delete [] queues;
+}
+
+//----------------------------------------------------------------------
+// BenchHash
+//	Time "reps" hash tables of "n" integers: Insert each, Find each,
+//	walk them with a HashIterator, Remove each.
+//----------------------------------------------------------------------
+
+static int
+IntKey(int x)
+{
+    return x;
+}
+
+static void
+BenchHash(int n, int reps)
+{
+    HashTable<int, int> **tables = new HashTable<int, int> *[reps];
+    double start;
+    int r, i, item;
+
+    start = WallTime();
+    for (r = 0; r < reps; r++) {
+	tables[r] = new HashTable<int, int>(IntKey, HashInt);
+	for (i = 0; i < n; i++)
+	    tables[r]->Insert(benchKey[i]);
+    }
+    BenchReport("HashTable", "insert", n, n * reps, start);
+
+    start = WallTime();
+    for (r = 0; r < reps; r++)
+	for (i = 0; i < n; i++)
+	    if (tables[r]->Find(n - 1 - benchKey[i], &item))
+		benchSink += item;
+    BenchReport("HashTable", "find", n, n * reps, start);
+
+    start = WallTime();
+    for (r = 0; r < reps; r++) {
+	HashIterator<int, int> iter(tables[r]);
+
+	for (; !iter.IsDone(); iter.Next())
+	    benchSink += iter.Item();
+    }
+    BenchReport("HashTable", "iterate", n, n * reps, start);
+
+    start = WallTime();
+    for (r = 0; r < reps; r++) {
+	for (i = 0; i < n; i++)
+	    benchSink += tables[r]->Remove(benchKey[i]);
+	delete tables[r];
+    }
+    BenchReport("HashTable", "remove", n, n * reps, start);
+    delete [] tables;
+}
+
+//----------------------------------------------------------------------
+// LibBenchmark
+//	Time the standard library classes, and a heap, at each size from
+//	10 items up to BenchItems, printing a line for each operation.
+//	Run on the host, with no simulated time passing.
+//----------------------------------------------------------------------
+
+void
+LibBenchmark()
+{
+    benchKey = new int[BenchItems];
+    for (int n = 10; n <= BenchItems; n *= 10) {
+	int reps = BenchItems / n;
+
+	BenchKeys(n);
+	BenchBitmap(n, reps);
+	if (n <= MaxListBench) {
+	    BenchList(n, reps, FALSE);
+	    BenchList(n, reps, TRUE);
+	}
+	BenchHeapOf(n, reps);
+	BenchDList(n, reps);
+	BenchRing(n, reps);
+	BenchQueue(n, reps);
+	BenchHash(n, reps);
+    }
+    DEBUG(dbgThread, "Benchmark total " << benchSink);
+    delete [] benchKey;
 }
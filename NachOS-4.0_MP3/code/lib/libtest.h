@@ -11,5 +11,6 @@
 #include "copyright.h"
 
 extern void LibSelfTest();
+extern void LibBenchmark();	// time the classes, on the host
 
 #endif // LIBTEST_H
@@ -6,7 +6,8 @@
 // 	A "ListElement" is allocated for each item to be put on the
 //	list; it is de-allocated when the item is removed. This means
 //      we don't need to keep a "next" pointer in every object we
-//      want to put on a list.
+//      want to put on a list.  Elements are recycled, so once a list
+//	has been as long as it gets, this costs no heap allocation.
 // 
 //     	NOTE: Mutual exclusion must be provided by the caller.
 //  	If you want a synchronized list, you must use the routines 
@@ -32,6 +33,52 @@ ListElement<T>::ListElement(T itm)
      next = NULL;	// always initialize to something!
 }
 
+template <class T>
+void *ListElement<T>::freeElements = NULL;
+
+//----------------------------------------------------------------------
+// ListElement<T>::operator new
+// 	Return the memory for a list element: the most recently freed
+//	one, or if there is none, the first of a new slab, the rest of
+//	which goes on the free list.
+//----------------------------------------------------------------------
+
+template <class T>
+void *
+ListElement<T>::operator new(size_t size)
+{
+    void *p;
+
+    ASSERT(size == sizeof(ListElement<T>));
+    if (freeElements == NULL) {
+	char *slab = new char[ElementsPerSlab * sizeof(ListElement<T>)];
+	for (int i = ElementsPerSlab - 1; i >= 0; i--) {
+	    p = slab + i * sizeof(ListElement<T>);
+	    *(void **) p = freeElements;
+	    freeElements = p;
+	}
+    }
+    p = freeElements;
+    freeElements = *(void **) p;
+    return p;
+}
+
+//----------------------------------------------------------------------
+// ListElement<T>::operator delete
+// 	Put a list element's memory on the free list.  Slabs are never
+//	given back to the heap.
+//----------------------------------------------------------------------
+
+template <class T>
+void
+ListElement<T>::operator delete(void *p)
+{
+    if (p == NULL)
+	return;
+    *(void **) p = freeElements;
+    freeElements = p;
+}
+
 
 //----------------------------------------------------------------------
 // List<T>::List
@@ -236,7 +283,7 @@ SortedList<T>::Insert(T item)
     ListElement<T> *element = new ListElement<T>(item);
     ListElement<T> *ptr;		// keep track
 
-    ASSERT(!IsInList(item));
+    ASSERT(!this->IsInList(item));
     if (this->IsEmpty()) {			// if list is empty, put at front
         this->first = element;
         this->last = element;
@@ -256,7 +303,7 @@ SortedList<T>::Insert(T item)
 	this->last = element;
     }
     this->numInList++;
-    ASSERT(IsInList(item));
+    ASSERT(this->IsInList(item));
 }
 
 //----------------------------------------------------------------------
@@ -362,14 +409,14 @@ SortedList<T>::SelfTest(T *p, int numEntries)
 
     for (i = 0; i < numEntries; i++) {
 	 Insert(p[i]);
-	 ASSERT(IsInList(p[i]));
+	 ASSERT(this->IsInList(p[i]));
      }
      SanityCheck();
 
      // should be able to get out everything we put in
      for (i = 0; i < numEntries; i++) {
 	 q[i] = this->RemoveFront();
-         ASSERT(!IsInList(q[i]));
+         ASSERT(!this->IsInList(q[i]));
      }
      ASSERT(this->IsEmpty());
 
@@ -379,5 +426,5 @@ SortedList<T>::SelfTest(T *p, int numEntries)
      }
      SanityCheck();
 
-     delete q;
+     delete [] q;
 }
@@ -23,13 +23,26 @@
 //
 // This class is private to this module (and classes that inherit
 // from this module). Made public for notational convenience.
+//
+// List elements are allocated and freed on every list operation, so
+// rather than going to the heap each time, they are carved out of
+// slabs, and freed ones are kept on a list (one per item type) to be
+// reused.
+
+const int ElementsPerSlab = 64;
 
 template <class T>
 class ListElement {
   public:
     ListElement(T itm); 	// initialize a list element
+    static void *operator new(size_t size);	// take an element from
+    static void operator delete(void *p);	// the free list, or put
+						// it back
     ListElement *next;	     	// next element on list, NULL if this is last
     T item; 	   	     	// item on the list
+
+  private:
+    static void *freeElements;	// each free one points to the next
 };
 
 // The following class defines a "list" -- a singly linked list of
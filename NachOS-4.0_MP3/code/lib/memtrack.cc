@@ -0,0 +1,207 @@
+// memtrack.cc
+//	The kernel's operator new and operator delete, which count each
+//	block against the subsystem that allocated it, and the routines
+//	to print the counts.  See memtrack.h.
+//
+//	Blocks are allocated before main, by constructors, and freed
+//	after it, so the counts are only plain arrays, zero before
+//	anything runs.
+//
+// Copyright (c) 1992-1996 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "memtrack.h"
+#include "debug.h"
+#include "sysdep.h"
+#include <stdlib.h>
+#include <new>
+
+#ifndef NO_PERF_COUNTERS
+
+static const char *tagNames[NumMemTags] = { "kernel", "threads", "scheduler",
+					     "interrupt", "userprog", "filesys",
+					     "network" };
+
+// What is in front of each block: its size, and who it is charged to.
+// Kept a multiple of the strictest alignment, so the block after it
+// is as aligned as malloc's.
+
+union MemHeader {
+    struct {
+	size_t size;
+	int tag;
+    } block;
+    double align[2];
+};
+
+int memTag = MemKernel;
+static long long liveBytes[NumMemTags];	// allocated and not deleted
+static long long liveBlocks[NumMemTags];
+static long long peakBytes[NumMemTags];	// the most liveBytes has been
+static long long totalLive, totalPeak;		// and for all of them
+
+//----------------------------------------------------------------------
+// Allocate
+// 	Allocate "size" bytes, and charge them to the current subsystem.
+//	Return NULL if the host is out of memory.
+//----------------------------------------------------------------------
+
+static void *
+Allocate(size_t size)
+{
+    MemHeader *header = (MemHeader *) malloc(sizeof(MemHeader) + size);
+    int tag = memTag;
+
+    if (header == NULL)
+	return NULL;
+    header->block.size = size;
+    header->block.tag = tag;
+    liveBytes[tag] += size;
+    liveBlocks[tag]++;
+    if (liveBytes[tag] > peakBytes[tag])
+	peakBytes[tag] = liveBytes[tag];
+    totalLive += size;
+    if (totalLive > totalPeak)
+	totalPeak = totalLive;
+    return header + 1;
+}
+
+//----------------------------------------------------------------------
+// Free
+// 	Give back a block from Allocate, and take it off the count of the
+//	subsystem that allocated it.
+//----------------------------------------------------------------------
+
+static void
+Free(void *p)
+{
+    MemHeader *header = (MemHeader *) p - 1;
+    int tag;
+
+    if (p == NULL)
+	return;
+    tag = header->block.tag;
+    liveBytes[tag] -= header->block.size;
+    liveBlocks[tag]--;
+    totalLive -= header->block.size;
+    free(header);
+}
+
+//----------------------------------------------------------------------
+// OutOfMemory
+// 	What new does when the host has no more memory: there is nothing
+//	sensible to go on with.
+//----------------------------------------------------------------------
+
+static void *
+OutOfMemory(size_t size)
+{
+    cerr << "Out of host memory, allocating " << size << " bytes\n";
+    Abort();
+    return NULL;
+}
+
+//----------------------------------------------------------------------
+// operator new, operator delete
+// 	Every allocation in the kernel.
+//----------------------------------------------------------------------
+
+void *
+operator new(size_t size)
+{
+    void *p = Allocate(size);
+
+    return (p != NULL) ? p : OutOfMemory(size);
+}
+
+void *
+operator new[](size_t size)
+{
+    void *p = Allocate(size);
+
+    return (p != NULL) ? p : OutOfMemory(size);
+}
+
+void *
+operator new(size_t size, const std::nothrow_t &)
+{
+    return Allocate(size);
+}
+
+void *
+operator new[](size_t size, const std::nothrow_t &)
+{
+    return Allocate(size);
+}
+
+void
+operator delete(void *p)
+{
+    Free(p);
+}
+
+void
+operator delete[](void *p)
+{
+    Free(p);
+}
+
+void
+operator delete(void *p, const std::nothrow_t &)
+{
+    Free(p);
+}
+
+void
+operator delete[](void *p, const std::nothrow_t &)
+{
+    Free(p);
+}
+
+//----------------------------------------------------------------------
+// MemLiveBytes
+// 	Return how many bytes "tag" has allocated and not yet deleted.
+//----------------------------------------------------------------------
+
+long long
+MemLiveBytes(MemTag tag)
+{
+    return liveBytes[tag];
+}
+
+//----------------------------------------------------------------------
+// MemPrint
+// 	Print what is still allocated, and the most that ever was, in all
+//	and then for each subsystem that allocated anything.
+//----------------------------------------------------------------------
+
+void
+MemPrint()
+{
+    cout << "Memory: live " << totalLive << " bytes, peak " << totalPeak
+	 << " bytes\n";
+    for (int t = 0; t < NumMemTags; t++) {
+	if (peakBytes[t] == 0)
+	    continue;
+	cout << "  " << tagNames[t] << " live " << liveBytes[t] << " in "
+	     << liveBlocks[t] << " blocks, peak " << peakBytes[t] << "\n";
+    }
+}
+
+#else // NO_PERF_COUNTERS
+
+long long
+MemLiveBytes(MemTag tag)
+{
+    return 0;
+}
+
+void
+MemPrint()
+{
+    cout << "Memory: compiled out (NO_PERF_COUNTERS)\n";
+}
+
+#endif // NO_PERF_COUNTERS
@@ -0,0 +1,72 @@
+// memtrack.h
+//	Accounting of the host memory the kernel allocates, by subsystem:
+//	how many bytes each has live now, and the most it ever had, so
+//	that a subsystem whose footprint keeps growing over a long run
+//	-- a leak -- shows up at halt (-stats).
+//
+//	Every new and delete in Nachos goes through the operator new and
+//	operator delete of memtrack.cc, which put the size and the
+//	subsystem in a header in front of each block.  The subsystem is
+//	whichever is current when the block is allocated: each marks
+//	where it runs with a MemTagScope, as the layers do for the host
+//	profiler (hostprof.h), around the code that allocates for it,
+//
+//		MemTagScope tag(MemFileSys);
+//
+//	and the block is charged to it until it is deleted, whoever
+//	deletes it.  Anything allocated outside a scope is "kernel".
+//
+//	Compiling with -DNO_PERF_COUNTERS, as for the counters of
+//	perfcount.h, leaves new and delete as the host's.
+//
+// Copyright (c) 1992-1996 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#ifndef MEMTRACK_H
+#define MEMTRACK_H
+
+#include "copyright.h"
+
+// The subsystems memory is charged to
+
+enum MemTag {
+    MemKernel,			// anything not in one of the below
+    MemThreads,			// threads and synchronization
+    MemScheduler,		// the ready queues and their lists
+    MemInterrupt,		// pending interrupts, and devices
+    MemUserProg,		// address spaces and system calls
+    MemFileSys,			// the file system and open files
+    MemNetwork,			// the post office and its mail
+    NumMemTags
+};
+
+#ifndef NO_PERF_COUNTERS
+
+extern int memTag;			// what is allocating now
+
+class MemTagScope {
+  public:
+    MemTagScope(MemTag tag) { saved = memTag; memTag = tag; }
+    ~MemTagScope() { memTag = saved; }
+
+  private:
+    int saved;				// the tag to put back
+};
+
+#else // NO_PERF_COUNTERS
+
+class MemTagScope {
+  public:
+    MemTagScope(MemTag tag) {}
+};
+
+#endif // NO_PERF_COUNTERS
+
+extern long long MemLiveBytes(MemTag tag);
+					// bytes allocated and not yet
+					// deleted, or 0 if compiled out
+extern void MemPrint();			// print each subsystem's live and
+					// peak bytes, for -stats
+
+#endif // MEMTRACK_H
@@ -0,0 +1,158 @@
+// perfcount.cc
+//	Routines to register the hot-path counters, and to print them.
+//
+//	The counters are constructed before main, in whatever order the
+//	linker puts their files, so the table is only plain arrays:
+//	they are all zero before any constructor runs.
+//
+// Copyright (c) 1992-1996 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "perfcount.h"
+#include "debug.h"
+
+#ifndef NO_PERF_COUNTERS
+
+// A counter or histogram, as registered
+
+class PerfEntry {
+  public:
+    const char *subsystem;
+    const char *name;
+    int slot;			// its first slot in perfSlots
+    bool histogram;		// PerfBuckets slots and a sum, or just one
+};
+
+PerfValue perfSlots[MaxPerfSlots];
+static PerfEntry perfEntries[MaxPerfCounters];
+static int numPerfEntries;
+static int numPerfSlots;
+
+//----------------------------------------------------------------------
+// PerfRegister
+// 	Take "slots" slots for a counter, and return the first.  The
+//	names are not copied.
+//----------------------------------------------------------------------
+
+static PerfValue *
+PerfRegister(const char *subsystem, const char *name, int slots,
+	     bool histogram)
+{
+    PerfEntry *e = &perfEntries[numPerfEntries];
+
+    ASSERT(numPerfEntries < MaxPerfCounters);
+    ASSERT(numPerfSlots + slots <= MaxPerfSlots);
+    e->subsystem = subsystem;
+    e->name = name;
+    e->slot = numPerfSlots;
+    e->histogram = histogram;
+    numPerfEntries++;
+    numPerfSlots += slots;
+    return &perfSlots[e->slot];
+}
+
+//----------------------------------------------------------------------
+// PerfCounter::PerfCounter
+// PerfHistogram::PerfHistogram
+// 	Register a counter, as "name" of "subsystem".
+//----------------------------------------------------------------------
+
+PerfCounter::PerfCounter(const char *subsystem, const char *name)
+{
+    slot = PerfRegister(subsystem, name, 1, FALSE);
+}
+
+PerfHistogram::PerfHistogram(const char *subsystem, const char *name)
+{
+    slot = PerfRegister(subsystem, name, PerfBuckets + 1, TRUE);
+}
+
+//----------------------------------------------------------------------
+// PerfHistogram::Count
+// 	Return how many values have been recorded, in all the buckets.
+//----------------------------------------------------------------------
+
+PerfValue
+PerfHistogram::Count()
+{
+    PerfValue count = 0;
+
+    for (int b = 0; b < PerfBuckets; b++)
+	count += slot[b];
+    return count;
+}
+
+//----------------------------------------------------------------------
+// PrintHistogram
+// 	Print the count and mean of a histogram's values, then each
+//	bucket that has any, as "low-high:count".
+//----------------------------------------------------------------------
+
+static void
+PrintHistogram(PerfValue *slot)
+{
+    PerfValue count = 0;
+
+    for (int b = 0; b < PerfBuckets; b++)
+	count += slot[b];
+    cout << " count " << count;
+    if (count == 0)
+	return;
+    cout << ", mean " << (double) slot[PerfBuckets] / count << ",";
+    for (int b = 0; b < PerfBuckets; b++) {
+	if (slot[b] == 0)
+	    continue;
+	if (b == 0)
+	    cout << " 0:";
+	else if (b == PerfBuckets - 1)
+	    cout << " " << (1 << (b - 1)) << "+:";
+	else
+	    cout << " " << (1 << (b - 1)) << "-" << (1 << b) - 1 << ":";
+	cout << slot[b];
+    }
+}
+
+//----------------------------------------------------------------------
+// PerfPrint
+// 	Print every counter, a line each: one subsystem's together, in
+//	the order they were declared.
+//----------------------------------------------------------------------
+
+void
+PerfPrint()
+{
+    bool printed[MaxPerfCounters];
+
+    for (int i = 0; i < numPerfEntries; i++)
+	printed[i] = FALSE;
+    cout << "Perf counters:\n";
+    for (int i = 0; i < numPerfEntries; i++) {
+	if (printed[i])
+	    continue;
+	for (int j = i; j < numPerfEntries; j++) {
+	    PerfEntry *e = &perfEntries[j];
+
+	    if (printed[j] || strcmp(e->subsystem, perfEntries[i].subsystem))
+		continue;
+	    printed[j] = TRUE;
+	    cout << "  " << e->subsystem << "." << e->name;
+	    if (e->histogram)
+		PrintHistogram(&perfSlots[e->slot]);
+	    else
+		cout << " " << perfSlots[e->slot];
+	    cout << "\n";
+	}
+    }
+}
+
+#else // NO_PERF_COUNTERS
+
+void
+PerfPrint()
+{
+    cout << "Perf counters: compiled out (NO_PERF_COUNTERS)\n";
+}
+
+#endif // NO_PERF_COUNTERS
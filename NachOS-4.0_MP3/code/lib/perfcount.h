@@ -0,0 +1,114 @@
+// perfcount.h
+//	Counters for the hot paths of the kernel and the machine: how
+//	often the scheduler switches, an interrupt fires, an address is
+//	translated, and so on -- cheap enough to be left in everywhere.
+//
+//	Each subsystem declares its counters once, at file scope:
+//
+//		static PerfCounter perfSwitches("scheduler", "switches");
+//		static PerfHistogram perfWait("synchdisk", "wait_ticks");
+//
+//	Before main runs, each takes its slots in one table of them all,
+//	kept in a single array, and remembers only where its slot is.
+//	Counting is then an inline add to that slot: no lookup, no call,
+//	and no lock (Nachos is one host thread).  A histogram is
+//	PerfBuckets slots in a row and the sum of the values, so that
+//	recording one is a bucket number and two adds.  The buckets are
+//	powers of two, as for the dispatch latencies in stats.h.
+//
+//	-stats prints every counter at halt, grouped by subsystem.
+//
+//	Adding "-DNO_PERF_COUNTERS" to the DEFINES in the Makefile
+//	compiles them all out: the classes hold nothing, and Inc and
+//	Record do nothing, so the hot paths are as they were without
+//	them.
+//
+// Copyright (c) 1992-1996 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#ifndef PERFCOUNT_H
+#define PERFCOUNT_H
+
+#include "copyright.h"
+
+// Bucket 0 counts values of 0 (or less), bucket b values from 2^(b-1)
+// to 2^b - 1, and the last bucket everything bigger.
+const int PerfBuckets = 24;
+
+const int MaxPerfCounters = 64;		// counters and histograms, in all
+const int MaxPerfSlots = 512;		// and the slots they take
+
+typedef long long PerfValue;
+
+#ifndef NO_PERF_COUNTERS
+
+extern PerfValue perfSlots[MaxPerfSlots];	// every count, in one array
+
+// The bucket for "value"
+
+inline int
+PerfBucket(int value)
+{
+    int b;
+
+    if (value <= 0)
+	return 0;
+    b = 32 - __builtin_clz((unsigned) value);	// its highest bit, + 1
+    return (b < PerfBuckets) ? b : PerfBuckets - 1;
+}
+
+class PerfCounter {
+  public:
+    PerfCounter(const char *subsystem, const char *name);
+					// take a slot for it
+
+    void Inc() { (*slot)++; }		// count one
+    void Add(int n) { *slot += n; }	// or several
+    PerfValue Value() { return *slot; }
+
+  private:
+    PerfValue *slot;			// in perfSlots
+};
+
+class PerfHistogram {
+  public:
+    PerfHistogram(const char *subsystem, const char *name);
+					// take its PerfBuckets slots, and
+					// one for the sum
+    void Record(int value) {		// count a value in its bucket
+	slot[PerfBucket(value)]++;
+	slot[PerfBuckets] += value;
+    }
+    PerfValue Count();			// values recorded
+    PerfValue Bucket(int b) { return slot[b]; }
+    PerfValue Sum() { return slot[PerfBuckets]; }
+
+  private:
+    PerfValue *slot;			// the buckets, then the sum
+};
+
+#else // NO_PERF_COUNTERS
+
+class PerfCounter {
+  public:
+    PerfCounter(const char *subsystem, const char *name) {}
+    void Inc() {}
+    void Add(int n) {}
+    PerfValue Value() { return 0; }
+};
+
+class PerfHistogram {
+  public:
+    PerfHistogram(const char *subsystem, const char *name) {}
+    void Record(int value) {}
+    PerfValue Count() { return 0; }
+    PerfValue Bucket(int b) { return 0; }
+    PerfValue Sum() { return 0; }
+};
+
+#endif // NO_PERF_COUNTERS
+
+extern void PerfPrint();		// print every counter, for -stats
+
+#endif // PERFCOUNT_H
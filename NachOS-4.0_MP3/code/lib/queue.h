@@ -0,0 +1,148 @@
+// queue.h
+//	Data structures for a first-in, first-out queue of items kept by
+//	value, in one array used as a ring buffer.
+//
+//	Unlike a List, a queue allocates nothing per item: an item is
+//	copied into the array, or better, filled in where it will stay
+//	(Tail then Push), and read where it is (Head then Pop).  So a small
+//	struct -- a disk request, a logged input -- can be queued as it
+//	is, rather than allocated on the heap to pass a pointer to it.
+//
+//	When the array fills up it is doubled, and the items copied over
+//	in order; a queue that stays about the same length stops
+//	allocating altogether.  Pointers returned by Tail, Head and Item
+//	are only good until the next call to Tail.  The size of the array is always a power
+//	of two, so that indexes can be masked rather than divided.
+//
+//	No synchronization is done; see SynchList for that.
+//
+// Copyright (c) 1992-1996 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#ifndef QUEUE_H
+#define QUEUE_H
+
+#include "copyright.h"
+#include "debug.h"
+
+const int InitialQueueSize = 8;
+
+// The following class defines a queue of items of type T.  T must
+// have a default constructor and assignment.
+
+template <class T>
+class Queue {
+  public:
+    Queue() { size = InitialQueueSize; item = new T[size]; head = tail = 0; }
+    ~Queue() { delete [] item; }
+
+    bool IsEmpty() { return head == tail; }
+    int NumInQueue() { return tail - head; }
+
+    T *Tail() { if (NumInQueue() == size) Grow(); return &item[tail & (size - 1)]; }
+				// the slot to fill in; there always is one
+    void Push() { ASSERT(NumInQueue() < size); tail++; }
+				// add the filled-in slot to the queue
+    T *Head() { return IsEmpty() ? NULL : &item[head & (size - 1)]; }
+				// the oldest item, or NULL if empty
+    void Pop() { ASSERT(!IsEmpty()); head++; }
+				// remove the oldest item
+
+    void Append(const T &value) { *Tail() = value; Push(); }
+				// copy an item onto the end
+    T RemoveFront() { T value = *Head(); Pop(); return value; }
+				// copy the oldest item off; the queue
+				// must not be empty
+    T *Item(int i) { ASSERT(i >= 0 && i < NumInQueue());
+		     return &item[(head + i) & (size - 1)]; }
+				// the "i"th oldest item
+
+    void Apply(void (*func)(T)); // call func on every item, oldest first
+
+    void SelfTest(T *p, int numEntries);
+				// verify module is working
+
+  private:
+    void Grow();		// double the array
+
+    T *item;			// the items
+    int size;			// slots in the array, a power of two
+    unsigned int head;		// items taken out; left to count up,
+    unsigned int tail;		// and items put in, wrapping around
+				// harmlessly, as in a Ring
+};
+
+//----------------------------------------------------------------------
+// Queue<T>::Grow
+//	Replace the array with one twice the size, copying the items
+//	over so that the oldest is in slot 0.
+//----------------------------------------------------------------------
+
+template <class T>
+void
+Queue<T>::Grow()
+{
+    T *bigger = new T[2 * size];
+    int n = NumInQueue();
+
+    for (int i = 0; i < n; i++)
+	bigger[i] = item[(head + i) & (size - 1)];
+    delete [] item;
+    item = bigger;
+    size *= 2;
+    head = 0;
+    tail = n;
+}
+
+//----------------------------------------------------------------------
+// Queue<T>::Apply
+//	Call "func" on every item in the queue, oldest first.
+//----------------------------------------------------------------------
+
+template <class T>
+void
+Queue<T>::Apply(void (*func)(T))
+{
+    for (unsigned int i = head; i != tail; i++)
+	func(item[i & (size - 1)]);
+}
+
+//----------------------------------------------------------------------
+// Queue<T>::SelfTest
+//	Test whether this module is working: pass items through the queue
+//	one at a time, so that it wraps around its array without growing,
+//	then fill it past its size several times over while it is
+//	wrapped, filling items in place, and empty it.
+//
+//	"p" -- array of items to put into the queue
+//	"numEntries" -- number of items in the array
+//----------------------------------------------------------------------
+
+template <class T>
+void
+Queue<T>::SelfTest(T *p, int numEntries)
+{
+    int i, count = 4 * InitialQueueSize + 1;
+
+    ASSERT(IsEmpty() && Head() == NULL);
+    for (i = 0; i < 3 * InitialQueueSize; i++) {
+	Append(p[i % numEntries]);
+	ASSERT(NumInQueue() == 1 && RemoveFront() == p[i % numEntries]);
+    }
+    ASSERT(IsEmpty() && size == InitialQueueSize);
+    for (i = 0; i < count; i++) {
+	*Tail() = p[i % numEntries];
+	Push();
+    }
+    ASSERT(NumInQueue() == count && size > count);
+    for (i = 0; i < count; i++)
+	ASSERT(*Item(i) == p[i % numEntries]);
+    for (i = 0; i < count; i++) {
+	ASSERT(*Head() == p[i % numEntries]);
+	Pop();
+    }
+    ASSERT(IsEmpty());
+}
+
+#endif // QUEUE_H
@@ -0,0 +1,112 @@
+// ring.h 
+//	Data structures for a fixed-size ring buffer, to pass items from
+//	an interrupt handler to a thread (or the other way).
+//
+//	There must be only one producer and one consumer.  The producer
+//	only moves the tail, and the consumer only moves the head, so
+//	neither needs to disable interrupts or take a lock, and nothing
+//	is allocated once the ring exists.  The capacity must be a power
+//	of two, so that indexes can be masked rather than divided; they
+//	are left to count up, and wrap around harmlessly.
+//
+//	The ring says nothing about waiting: a consumer that finds
+//	it empty has to arrange to be woken up itself.
+//
+// Copyright (c) 1992-1996 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation 
+// of liability and disclaimer of warranty provisions.
+
+#ifndef RING_H
+#define RING_H
+
+#include "copyright.h"
+#include "debug.h"
+
+// The following class defines a ring of "Capacity" items of type T.
+// Items can be added and removed by value (Put, Get), or filled in
+// and read in place (Tail then Push, Head then Pop), to avoid copying
+// large items.
+
+template <class T, int Capacity>
+class Ring {
+  public:
+    Ring() {
+	ASSERT(Capacity > 0 && (Capacity & (Capacity - 1)) == 0);
+	head = tail = 0;
+    }
+
+    bool IsEmpty() { return head == tail; }
+    bool IsFull() { return tail - head == (unsigned int) Capacity; }
+    int NumInRing() { return tail - head; }
+
+    T *Tail() { return IsFull() ? NULL : &item[tail & (Capacity - 1)]; }
+				// the slot to fill in, or NULL if full
+    void Push() { ASSERT(!IsFull()); tail++; }
+				// add the filled-in slot to the ring
+    T *Head() { return IsEmpty() ? NULL : &item[head & (Capacity - 1)]; }
+				// the oldest item, or NULL if empty
+    void Pop() { ASSERT(!IsEmpty()); head++; }
+				// remove the oldest item
+
+    bool Put(T value) {		// add an item; FALSE if full
+	T *slot = Tail();
+	if (slot == NULL)
+	    return FALSE;
+	*slot = value;
+	Push();
+	return TRUE;
+    }
+    bool Get(T *value) {	// remove the oldest item; FALSE if empty
+	T *slot = Head();
+	if (slot == NULL)
+	    return FALSE;
+	*value = *slot;
+	Pop();
+	return TRUE;
+    }
+
+    void SelfTest(T *p, int numEntries);
+				// verify module is working
+
+  private:
+    T item[Capacity];		// the items
+    volatile unsigned int head;	// items taken out; moved by the consumer
+    volatile unsigned int tail;	// items put in; moved by the producer
+};
+
+//----------------------------------------------------------------------
+// Ring<T,Capacity>::SelfTest
+//	Test whether this module is working: fill the ring, empty it,
+//	and then pass items through it enough times that the indexes
+//	wrap around the end of the array.
+//
+//	"p" -- array of items to put into the ring
+//	"numEntries" -- number of items in the array; at most Capacity
+//----------------------------------------------------------------------
+
+template <class T, int Capacity>
+void
+Ring<T,Capacity>::SelfTest(T *p, int numEntries)
+{
+    T value;
+    int i;
+
+    ASSERT(IsEmpty() && numEntries <= Capacity);
+    for (i = 0; i < Capacity; i++)
+	ASSERT(Put(p[i % numEntries]));
+    ASSERT(IsFull() && !Put(p[0]) && NumInRing() == Capacity);
+    for (i = 0; i < Capacity; i++) {
+	ASSERT(Get(&value));
+	ASSERT(value == p[i % numEntries]);
+    }
+    ASSERT(IsEmpty() && !Get(&value));
+    for (i = 0; i < Capacity * 3; i++) {
+	*Tail() = p[i % numEntries];
+	Push();
+	ASSERT(*Head() == p[i % numEntries]);
+	Pop();
+    }
+    ASSERT(IsEmpty());
+}
+
+#endif // RING_H
@@ -26,6 +26,7 @@
 #include "copyright.h"
 #include "debug.h"
 #include "sysdep.h"
+#include "hostprof.h"
 #include <stdlib.h>
 #include <unistd.h>
 #include <sys/time.h>
@@ -40,8 +41,8 @@
 #include <fcntl.h>
 #endif
 
-#ifdef LINUX	 // at this point, linux doesn't support mprotect 
-#define NO_MPROT     
+#ifdef LINUX	 // Linux only does mprotect on whole pages, so bounded
+#define USE_MMAP // arrays are mapped there to keep their guards exact
 #endif
 #ifdef DOS	// neither does DOS
 #define NO_MPROT
@@ -53,6 +54,7 @@ extern "C" {
 
 #ifndef NO_MPROT 
 #include <sys/mman.h>
+#include <poll.h>
 #endif
 
 // UNIX routines called by procedures in this file 
@@ -81,7 +83,7 @@ unsigned sleep(unsigned);
 
 #ifdef OSF_OR_AIX
 int mprotect(const void *, long unsigned int, int);
-#else
+#elif !defined(USE_MMAP)
 int mprotect(char *, unsigned int, int);
 #endif
 #endif
@@ -119,6 +121,33 @@ CallOnUserAbort(void (*func)(int))
     (void)signal(SIGINT, func);
 }
 
+//----------------------------------------------------------------------
+// CallOnProfTick
+// 	Arrange that "func" will be called every "usec" microseconds of
+//	CPU time the UNIX process uses, from a SIGPROF timer; or, if
+//	"func" is NULL, stop calling it.  System calls the signal
+//	interrupts are restarted.
+//----------------------------------------------------------------------
+
+void
+CallOnProfTick(void (*func)(int), int usec)
+{
+    struct itimerval timer;
+    struct sigaction action;
+
+    timer.it_interval.tv_sec = timer.it_value.tv_sec = 0;
+    timer.it_interval.tv_usec = timer.it_value.tv_usec =
+		(func == NULL) ? 0 : usec;
+    if (func == NULL)
+	(void) setitimer(ITIMER_PROF, &timer, NULL);
+    action.sa_handler = (func == NULL) ? SIG_IGN : func;
+    sigemptyset(&action.sa_mask);
+    action.sa_flags = SA_RESTART;
+    (void) sigaction(SIGPROF, &action, NULL);
+    if (func != NULL)
+	(void) setitimer(ITIMER_PROF, &timer, NULL);
+}
+
 //----------------------------------------------------------------------
 // Delay
 // 	Put the UNIX process running Nachos to sleep for x seconds,
@@ -132,6 +161,21 @@ Delay(int seconds)
     (void) sleep((unsigned) seconds);
 }
 
+//----------------------------------------------------------------------
+// WallTime
+// 	Return the host's time of day, in seconds, to the microsecond.
+//	Only differences between two calls mean anything.
+//----------------------------------------------------------------------
+
+double
+WallTime()
+{
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
 //----------------------------------------------------------------------
 // UDelay
 // 	Put the UNIX process running Nachos to sleep for x microseconds,
@@ -194,23 +238,50 @@ RandomNumber()
     return rand();
 }
 
+// Bounded arrays that have been de-allocated are kept, still with their
+// guard pages protected, to be handed out again.  They are thread
+// stacks, which are all the same size, so almost every allocation is
+// a reuse and costs no system calls.
+
+#ifdef USE_MMAP
+const bool ArrayGuardsExact = TRUE;
+#else
+const bool ArrayGuardsExact = FALSE;
+#endif
+
+static const int MaxFreeArrays = 64;
+static char *freeArray[MaxFreeArrays];
+static int freeArraySize[MaxFreeArrays];
+static int numFreeArrays = 0;
+
 //----------------------------------------------------------------------
-// AllocBoundedArray
-// 	Return an array, with the two pages just before 
-//	and after the array unmapped, to catch illegal references off
-//	the end of the array.  Particularly useful for catching overflow
-//	beyond fixed-size thread execution stacks.
-//
-//	Note: Just return the useful part!
+// NewBoundedArray
+// 	Allocate an array, with the pages just before and after it
+//	made inaccessible.  With mmap, the array starts on a page
+//	boundary, so running off its start (which is where a stack
+//	overflows) faults at the first byte.  Its pages are only
+//	reserved, not committed: each takes memory when first touched,
+//	so a stack costs what the thread actually uses of it.
 //
 //	"size" -- amount of useful space needed (in bytes)
 //----------------------------------------------------------------------
 
-char * 
-AllocBoundedArray(int size)
+static char *
+NewBoundedArray(int size)
 {
 #ifdef NO_MPROT
     return new char[size];
+#elif defined(USE_MMAP)
+    int pgSize = getpagesize();
+    int rounded = (size + pgSize - 1) / pgSize * pgSize;
+    char *ptr = (char *) mmap(NULL, rounded + pgSize * 2,
+		PROT_READ | PROT_WRITE,
+		MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+
+    ASSERT(ptr != (char *) MAP_FAILED);
+    mprotect(ptr, pgSize, PROT_NONE);
+    mprotect(ptr + pgSize + rounded, pgSize, PROT_NONE);
+    return ptr + pgSize;
 #else
     int pgSize = getpagesize();
     char *ptr = new char[pgSize * 2 + size];
@@ -222,30 +293,85 @@ AllocBoundedArray(int size)
 }
 
 //----------------------------------------------------------------------
-// DeallocBoundedArray
-// 	Deallocate an array of integers, unprotecting its two boundary pages.
+// DeleteBoundedArray
+// 	Give an array allocated by NewBoundedArray back to the system,
+//	unprotecting its two boundary pages.
 //
 //	"ptr" -- the array to be deallocated
 //	"size" -- amount of useful space in the array (in bytes)
 //----------------------------------------------------------------------
 
-#ifdef NO_MPROT
-void 
-DeallocBoundedArray(char *ptr, int /* size */)
+static void
+DeleteBoundedArray(char *ptr, int size)
 {
+#ifdef NO_MPROT
     delete [] ptr;
-}
+#elif defined(USE_MMAP)
+    int pgSize = getpagesize();
+    int rounded = (size + pgSize - 1) / pgSize * pgSize;
+
+    munmap(ptr - pgSize, rounded + pgSize * 2);
 #else
-void 
-DeallocBoundedArray(char *ptr, int size)
-{
     int pgSize = getpagesize();
 
     mprotect(ptr - pgSize, pgSize, PROT_READ | PROT_WRITE | PROT_EXEC);
     mprotect(ptr + size, pgSize, PROT_READ | PROT_WRITE | PROT_EXEC);
     delete [] (ptr - pgSize);
-}
 #endif
+}
+
+//----------------------------------------------------------------------
+// AllocBoundedArray
+// 	Return an array, with the two pages just before 
+//	and after the array unmapped, to catch illegal references off
+//	the end of the array.  Particularly useful for catching overflow
+//	beyond fixed-size thread execution stacks.
+//
+//	A de-allocated array of the same size is reused if there is
+//	one; its contents are whatever was left in it.
+//
+//	Note: Just return the useful part!
+//
+//	"size" -- amount of useful space needed (in bytes)
+//----------------------------------------------------------------------
+
+char * 
+AllocBoundedArray(int size)
+{
+    char *ptr;
+
+    for (int i = numFreeArrays - 1; i >= 0; i--) {
+	if (freeArraySize[i] == size) {
+	    ptr = freeArray[i];
+	    numFreeArrays--;
+	    freeArray[i] = freeArray[numFreeArrays];
+	    freeArraySize[i] = freeArraySize[numFreeArrays];
+	    return ptr;
+	}
+    }
+    return NewBoundedArray(size);
+}
+
+//----------------------------------------------------------------------
+// DeallocBoundedArray
+// 	Deallocate an array of integers.  Up to MaxFreeArrays are kept
+//	for reuse, guard pages and all; the rest are given back.
+//
+//	"ptr" -- the array to be deallocated
+//	"size" -- amount of useful space in the array (in bytes)
+//----------------------------------------------------------------------
+
+void 
+DeallocBoundedArray(char *ptr, int size)
+{
+    if (numFreeArrays < MaxFreeArrays) {
+	freeArray[numFreeArrays] = ptr;
+	freeArraySize[numFreeArrays] = size;
+	numFreeArrays++;
+    } else {
+	DeleteBoundedArray(ptr, size);
+    }
+}
 
 //----------------------------------------------------------------------
 // PollFile
@@ -267,6 +393,7 @@ PollFile(int fd)
 #endif
     int retVal;
     struct timeval pollTime;
+    HostProfScope scope(ProfHostIO);
 
 #if defined(SOLARIS) || defined(LINUX)
 // KMS
@@ -285,7 +412,9 @@ PollFile(int fd)
     retVal = select(32, (fd_set*)&rfd, (fd_set*)&wfd, (fd_set*)&xfd, &pollTime);
 #elif defined(SOLARIS) || defined(LINUX)
     // KMS
-    retVal = select(32, &rfd, &wfd, &xfd, &pollTime);
+    do {			// SIGPROF (-hostprof) may interrupt it
+	retVal = select(32, &rfd, &wfd, &xfd, &pollTime);
+    } while (retVal < 0 && errno == EINTR);
 #else
     retVal = select(32, &rfd, &wfd, &xfd, &pollTime);
 #endif
@@ -296,6 +425,43 @@ PollFile(int fd)
     return TRUE;
 }
 
+//----------------------------------------------------------------------
+// PollFiles
+// 	Check a set of open files or sockets, all with one poll, to see 
+//	which have characters that can be read immediately.  If none has,
+//	either return at once or sleep until one does.  A file at end of
+//	file, or with an error, counts as ready: reading it won't wait.
+//
+//	"fd" -- the file descriptors to check
+//	"ready" -- set to whether each one has characters waiting
+//	"numFiles" -- how many there are; at most MaxPollFiles
+//	"wait" -- if TRUE, sleep until one is ready
+//----------------------------------------------------------------------
+
+static const int MaxPollFiles = 8;
+
+int
+PollFiles(int *fd, bool *ready, int numFiles, bool wait)
+{
+    struct pollfd pfd[MaxPollFiles];
+    int i, retVal;
+    HostProfScope scope(ProfHostIO);
+
+    ASSERT(numFiles <= MaxPollFiles);
+    for (i = 0; i < numFiles; i++) {
+	pfd[i].fd = fd[i];
+	pfd[i].events = POLLIN;
+	pfd[i].revents = 0;
+    }
+    do {
+	retVal = poll(pfd, numFiles, wait ? -1 : 0);
+    } while (retVal < 0 && errno == EINTR);
+    ASSERT(retVal >= 0);
+    for (i = 0; i < numFiles; i++)
+	ready[i] = (pfd[i].revents != 0);
+    return retVal;
+}
+
 //----------------------------------------------------------------------
 // OpenForWrite
 // 	Open a file for writing.  Create it if it doesn't exist; truncate it 
@@ -338,6 +504,7 @@ OpenForReadWrite(char *name, bool crashOnError)
 void
 Read(int fd, char *buffer, int nBytes)
 {
+    HostProfScope scope(ProfHostIO);
     int retVal = read(fd, buffer, nBytes);
     ASSERT(retVal == nBytes);
 }
@@ -351,6 +518,8 @@ Read(int fd, char *buffer, int nBytes)
 int
 ReadPartial(int fd, char *buffer, int nBytes)
 {
+    HostProfScope scope(ProfHostIO);
+
     return read(fd, buffer, nBytes);
 }
 
@@ -363,6 +532,7 @@ ReadPartial(int fd, char *buffer, int nBytes)
 void
 WriteFile(int fd, char *buffer, int nBytes)
 {
+    HostProfScope scope(ProfHostIO);
     int retVal = write(fd, buffer, nBytes);
     ASSERT(retVal == nBytes);
 }
@@ -375,6 +545,7 @@ WriteFile(int fd, char *buffer, int nBytes)
 void 
 Lseek(int fd, int offset, int whence)
 {
+    HostProfScope scope(ProfHostIO);
     int retVal = lseek(fd, offset, whence);
     ASSERT(retVal >= 0);
 }
@@ -516,6 +687,7 @@ ReadFromSocket(int sockID, char *buffer, int packetSize)
 #else
     int size = sizeof(uName);
 #endif
+    HostProfScope scope(ProfHostIO);
    
     retVal = recvfrom(sockID, buffer, packetSize, 0,
 				   (struct sockaddr *) &uName, &size);
@@ -548,6 +720,7 @@ SendToSocket(int sockID, char *buffer, int packetSize, char *toName)
     struct sockaddr_un uName;
     int retVal;
     int retryCount;
+    HostProfScope scope(ProfHostIO);
 
     InitSocketName(&uName, toName);
 
@@ -19,15 +19,28 @@
 
 using namespace std;
 
-// Process control: abort, exit, and sleep
-extern void Abort();
-extern void Exit(int exitCode);
+// Process control: abort, exit, and sleep.  Abort and Exit never
+// return, and the compiler is told so: after a failed ASSERT, it
+// doesn't have to warn about, or keep code for, the way on.
+
+#ifdef __GNUC__
+#define NORETURN __attribute__((noreturn))
+#else
+#define NORETURN
+#endif
+
+extern void Abort() NORETURN;
+extern void Exit(int exitCode) NORETURN;
 extern void Delay(int seconds);
 extern void UDelay(unsigned int usec);// rcgood - to avoid spinners.
+extern double WallTime();	// host time, in seconds
 
 // Initialize system so that cleanUp routine is called when user hits ctl-C
 extern void CallOnUserAbort(void (*cleanup)(int));
 
+// Call "func" every "usec" microseconds of host CPU time; NULL stops it
+extern void CallOnProfTick(void (*func)(int), int usec);
+
 // Initialize the pseudo random number generator
 extern void RandomInit(unsigned seed);
 extern unsigned int RandomNumber();
@@ -36,11 +49,19 @@ extern unsigned int RandomNumber();
 // just beyond either end of the array will cause an error
 extern char *AllocBoundedArray(int size);
 extern void DeallocBoundedArray(char *p, int size);
+extern const bool ArrayGuardsExact;	// does running off either end
+					// fault at the first byte (and do
+					// untouched pages take no memory)?
 
 // Check file to see if there are any characters to be read.
 // If no characters in the file, return without waiting.
 extern bool PollFile(int fd);
 
+// Check several files at once, setting ready[i] if fd[i] has characters
+// to be read; if "wait" and none has, sleep until one does.  Return
+// how many are ready.
+extern int PollFiles(int *fd, bool *ready, int numFiles, bool wait);
+
 // File operations: open/read/write/lseek/close, and check for error
 // For simulating the disk and the console devices.
 extern int OpenForWrite(char *name);
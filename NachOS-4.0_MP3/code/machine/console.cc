@@ -38,7 +38,23 @@ ConsoleInput::ConsoleInput(char *readFile, CallBackObj *toCall)
     incoming = EOF;
 
     // start polling for incoming keystrokes
-    kernel->interrupt->Schedule(this, ConsoleTime, ConsoleReadInt);
+    Listen();
+}
+
+//----------------------------------------------------------------------
+// ConsoleInput::Listen
+// 	Arrange for CallBack to be called when the next character may
+//	be available: either poll again in ConsoleTime ticks, or have 
+//	the interrupt simulation wait for the UNIX file to be readable.
+//----------------------------------------------------------------------
+
+void
+ConsoleInput::Listen()
+{
+    if (kernel->waitForInput)
+	kernel->interrupt->WaitForInput(readFileNo, this, ConsoleReadInt);
+    else
+	kernel->interrupt->Schedule(this, ConsoleTime, ConsoleReadInt);
 }
 
 //----------------------------------------------------------------------
@@ -68,13 +84,26 @@ ConsoleInput::CallBack()
   char c;
   int readCount;
 
+    Replay *replay = kernel->replay;
+    bool ready;
+
     ASSERT(incoming == EOF);
-    if (!PollFile(readFileNo)) { // nothing to be read
-        // schedule the next time to poll for a packet
-        kernel->interrupt->Schedule(this, ConsoleTime, ConsoleReadInt);
+    if (replay != NULL && replay->Playing())
+	ready = replay->Ready(ReplayConsole);	// (never ask the host)
+    else
+	ready = PollFile(readFileNo);
+    if (!ready) { // nothing to be read
+        // schedule the next time to poll for a character
+        Listen();
     } else { 
     	// otherwise, try to read a character
-    	readCount = ReadPartial(readFileNo, &c, sizeof(char));
+	if (replay != NULL && replay->Playing()) {
+	    readCount = replay->Input(ReplayConsole, &c, sizeof(char));
+	} else {
+	    readCount = ReadPartial(readFileNo, &c, sizeof(char));
+	    if (replay != NULL)
+		replay->Input(ReplayConsole, &c, readCount);
+	}
 	if (readCount == 0) {
 	   // this seems to happen at end of file, when the
 	   // console input is a regular file
@@ -105,7 +134,7 @@ ConsoleInput::GetChar()
    char ch = incoming;
 
    if (incoming != EOF) {	// schedule when next char will arrive
-       kernel->interrupt->Schedule(this, ConsoleTime, ConsoleReadInt);
+       Listen();
    }
    incoming = EOF;
    return ch;
@@ -131,6 +160,7 @@ ConsoleOutput::ConsoleOutput(char *writeFile, CallBackObj *toCall)
 
     callWhenDone = toCall;
     putBusy = FALSE;
+    numPutting = 0;
 }
 
 //----------------------------------------------------------------------
@@ -154,7 +184,7 @@ void
 ConsoleOutput::CallBack()
 {
     putBusy = FALSE;
-    kernel->stats->numConsoleCharsWritten++;
+    kernel->stats->numConsoleCharsWritten += numPutting;
     callWhenDone->CallBack();
 }
 
@@ -170,36 +200,26 @@ ConsoleOutput::PutChar(char ch)
     ASSERT(putBusy == FALSE);
     WriteFile(writeFileNo, &ch, sizeof(char));
     putBusy = TRUE;
+    numPutting = 1;
     kernel->interrupt->Schedule(this, ConsoleTime, ConsoleWriteInt);
 }
 
+//----------------------------------------------------------------------
+// ConsoleOutput::PutBuffer()
+// 	Write a block of characters to the simulated display with one 
+//	UNIX write, and schedule a single interrupt for when the serial 
+//	line would have finished sending all of them.
+//
+//	"buf" -- the characters to write
+//	"numChars" -- how many; at least one
+//----------------------------------------------------------------------
+
 void
-ConsoleOutput::PrintInt(int number)
+ConsoleOutput::PutBuffer(char *buf, int numChars)
 {
-	//turn int into char first
-	char a[10]={};
-	int count = 0;
-	int k = number;
-	while(k != 0)
-	{
-		a[count] = k%10 + '0';
-		k = k/10;
-		count++;
-	}
-
-	char a_new[10]={};
-	for(int i=0 ; i<count ; i++)
-	{
-		a_new[i] = a [count-1-i];
-	}
-	a_new[count] = '\n';
-
-	//do the same job as PutChar
-	ASSERT(putBusy == FALSE);
-	WriteFile(writeFileNo, a_new, sizeof(a_new));
-	putBusy = TRUE;
-	kernel->interrupt->Schedule(this, ConsoleTime, ConsoleWriteInt);
-
+    ASSERT(putBusy == FALSE && numChars > 0);
+    WriteFile(writeFileNo, buf, numChars);
+    putBusy = TRUE;
+    numPutting = numChars;
+    kernel->interrupt->Schedule(this, ConsoleTime * numChars, ConsoleWriteInt);
 }
-
-
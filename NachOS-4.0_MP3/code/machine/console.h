@@ -59,6 +59,9 @@ class ConsoleInput : public CallBackObj {
 				// from the keyboard.
 
   private:
+    void Listen();			// be called back when the next
+					// character may have arrived
+
     int readFileNo;			// UNIX file emulating the keyboard 
     CallBackObj *callWhenAvail;		// Interrupt handler to call when 
 					// there is a char to be read
@@ -76,9 +79,14 @@ class ConsoleOutput : public CallBackObj {
     void PutChar(char ch);	// Write "ch" to the console display, 
 				// and return immediately.  "callWhenDone" 
 				// will called when the I/O completes. 
+    void PutBuffer(char *buf, int numChars);
+				// Write "numChars" characters at once, 
+				// with one UNIX write, and return 
+				// immediately.  "callWhenDone" is called 
+				// once, when all of them have gone out.
+
     void CallBack();		// Invoked when next character can be put
 				// out to the display.
-    void PrintInt(int number);
 
   private:
     int writeFileNo;			// UNIX file emulating the display
@@ -86,6 +94,7 @@ class ConsoleOutput : public CallBackObj {
 					// the next char can be put 
     bool putBusy;    			// Is a PutChar operation in progress?
 					// If so, you can't do another one!
+    int numPutting;			// characters being put out
 };
 
 #endif // CONSOLE_H
@@ -127,6 +127,9 @@ Disk::ReadRequest(int sectorNumber, char* data)
     active = TRUE;
     UpdateLast(sectorNumber);
     kernel->stats->numDiskReads++;
+    requestTick = kernel->stats->totalTicks;
+    requestSector = sectorNumber;
+    requestWriting = FALSE;
     kernel->interrupt->Schedule(this, ticks, DiskInt);
 }
 
@@ -147,6 +150,9 @@ Disk::WriteRequest(int sectorNumber, char* data)
     active = TRUE;
     UpdateLast(sectorNumber);
     kernel->stats->numDiskWrites++;
+    requestTick = kernel->stats->totalTicks;
+    requestSector = sectorNumber;
+    requestWriting = TRUE;
     kernel->interrupt->Schedule(this, ticks, DiskInt);
 }
 
@@ -159,6 +165,9 @@ void
 Disk::CallBack ()
 { 
     active = FALSE;
+    if (kernel->timeline != NULL)
+	kernel->timeline->DiskRequest(requestWriting, requestSector,
+				      requestTick, kernel->stats->totalTicks);
     callWhenDone->CallBack();
 }
 
@@ -20,6 +20,7 @@
 #include "copyright.h"
 #include "utility.h"
 #include "callback.h"
+#include "config.h"
 
 // The following class defines a physical disk I/O device.  The disk
 // has a single surface, split up into "tracks", and each track split
@@ -47,9 +48,11 @@
 //
 // The track buffer simulation can be disabled by compiling with -DNOTRACKBUF
 
-const int SectorSize = 128;		// number of bytes per disk sector
-const int SectorsPerTrack  = 32;	// number of sectors per disk track 
-const int NumTracks = 32;		// number of tracks per disk
+const int SectorSize = Config::SectorSize;
+					// number of bytes per disk sector
+const int SectorsPerTrack = Config::SectorsPerTrack;
+					// number of sectors per disk track 
+const int NumTracks = Config::NumTracks;	// number of tracks per disk
 const int NumSectors = (SectorsPerTrack * NumTracks);
 					// total # of sectors per disk
 
@@ -83,6 +86,10 @@ class Disk : public CallBackObj {
     int lastSector;			// The previous disk request 
     int bufferInit;			// When the track buffer started 
 					// being loaded
+    int requestTick;			// When the request in progress was
+					// issued, and what it is; for the
+    int requestSector;			// timeline
+    bool requestWriting;
 
     int TimeToSeek(int newSector, int *rotate); // time to get to the new track
     int ModuloDiff(int to, int from);        // # sectors between to and from
@@ -23,6 +23,17 @@
 #include "copyright.h"
 #include "interrupt.h"
 #include "main.h"
+#include "perfcount.h"
+#include "hostprof.h"
+#include "memtrack.h"
+
+static PerfCounter perfTicks("interrupt", "ticks");
+static PerfCounter perfScheduled("interrupt", "scheduled");
+static PerfCounter perfHandled("interrupt", "handled");
+static PerfCounter perfClockJumps("interrupt", "clock_jumps");
+					// idle skips to the next interrupt
+static PerfHistogram perfLead("interrupt", "lead_ticks");
+					// how far ahead each is scheduled
 
 // String definitions for debugging messages
 
@@ -50,16 +61,123 @@ PendingInterrupt::PendingInterrupt(CallBackObj *callOnInt,
 }
 
 //----------------------------------------------------------------------
-// PendingCompare
-//	Compare to interrupts based on which should occur first.
+// PendingQueue::PendingQueue
+// 	Initialize an empty queue.  The heap grows as interrupts are
+//	scheduled, but is never shrunk.
 //----------------------------------------------------------------------
 
-static int
-PendingCompare (PendingInterrupt *x, PendingInterrupt *y)
+PendingQueue::PendingQueue()
 {
-    if (x->when < y->when) { return -1; }
-    else if (x->when > y->when) { return 1; }
-    else { return 0; }
+    size = 16;
+    heap = new PendingInterrupt[size];
+    numPending = 0;
+    numScheduled = 0;
+}
+
+//----------------------------------------------------------------------
+// PendingQueue::~PendingQueue
+// 	De-allocate the queue.
+//----------------------------------------------------------------------
+
+PendingQueue::~PendingQueue()
+{
+    delete [] heap;
+}
+
+//----------------------------------------------------------------------
+// PendingQueue::Before
+//	Return TRUE if heap entry "a" should fire before "b": it is due
+//	sooner, or at the same time and was scheduled first.
+//----------------------------------------------------------------------
+
+bool
+PendingQueue::Before(int a, int b)
+{
+    if (heap[a].when != heap[b].when)
+	return heap[a].when < heap[b].when;
+    return heap[a].order < heap[b].order;
+}
+
+//----------------------------------------------------------------------
+// PendingQueue::Swap
+// 	Exchange two heap entries.
+//----------------------------------------------------------------------
+
+void
+PendingQueue::Swap(int a, int b)
+{
+    PendingInterrupt tmp = heap[a];
+
+    heap[a] = heap[b];
+    heap[b] = tmp;
+}
+
+//----------------------------------------------------------------------
+// PendingQueue::Insert
+// 	Add an interrupt to the heap, and sift it up to its place.
+//----------------------------------------------------------------------
+
+void
+PendingQueue::Insert(CallBackObj *callOnInt, int when, IntType kind)
+{
+    int i, parent;
+
+    if (numPending == size) {
+	PendingInterrupt *bigger = new PendingInterrupt[size * 2];
+	for (i = 0; i < numPending; i++)
+	    bigger[i] = heap[i];
+	delete [] heap;
+	heap = bigger;
+	size *= 2;
+    }
+    i = numPending++;
+    heap[i] = PendingInterrupt(callOnInt, when, kind);
+    heap[i].order = numScheduled++;
+    while (i > 0) {
+	parent = (i - 1) / 2;
+	if (!Before(i, parent))
+	    break;
+	Swap(i, parent);
+	i = parent;
+    }
+}
+
+//----------------------------------------------------------------------
+// PendingQueue::RemoveFront
+// 	Take the earliest interrupt off the heap, and sift the last
+//	entry down into the hole.  The record is returned by value, so
+//	the handler it names is free to schedule more interrupts.
+//----------------------------------------------------------------------
+
+PendingInterrupt
+PendingQueue::RemoveFront()
+{
+    PendingInterrupt front;
+    int i, child;
+
+    ASSERT(numPending > 0);
+    front = heap[0];
+    heap[0] = heap[--numPending];
+    for (i = 0; (child = 2 * i + 1) < numPending; i = child) {
+	if (child + 1 < numPending && Before(child + 1, child))
+	    child++;
+	if (!Before(child, i))
+	    break;
+	Swap(i, child);
+    }
+    return front;
+}
+
+//----------------------------------------------------------------------
+// PendingQueue::Apply
+// 	Call "func" on every pending interrupt, in heap order.
+//----------------------------------------------------------------------
+
+void
+PendingQueue::Apply(void (*func)(PendingInterrupt *))
+{
+    for (int i = 0; i < numPending; i++)
+	(*func)(&heap[i]);
 }
 
 //----------------------------------------------------------------------
@@ -72,10 +190,10 @@ PendingCompare (PendingInterrupt *x, PendingInterrupt *y)
 Interrupt::Interrupt()
 {
     level = IntOff;
-    pending = new SortedList<PendingInterrupt *>(PendingCompare);
+    pending = new PendingQueue;
     inHandler = FALSE;
-    yieldOnReturn = FALSE;
     status = SystemMode;
+    numInputs = 0;
 }
 
 //----------------------------------------------------------------------
@@ -85,9 +203,6 @@ Interrupt::Interrupt()
 
 Interrupt::~Interrupt()
 {
-    while (!pending->IsEmpty()) {
-	delete pending->RemoveFront();
-    }
     delete pending;
 }
 
@@ -150,33 +265,45 @@ Interrupt::OneTick()
 {
     MachineStatus oldStatus = status;
     Statistics *stats = kernel->stats;
+    Scheduler *scheduler = kernel->scheduler;
+    HostProfScope scope(ProfInterrupt);
 		
+    ChangeLevel(IntOn, IntOff);	// first, turn off interrupts
+				// (interrupt handlers run with
+				// interrupts disabled)
+
+    // With several CPUs, the clock only advances for a user instruction
+    // once every busy CPU has executed one.
+    if (status != UserMode || scheduler->LastInRound()) {
+	perfTicks.Inc();
 		//cout<< "== Tick " << stats->totalTicks << " ==\n";
 // advance simulated time
-    if (status == SystemMode) {
-        stats->totalTicks += SystemTick;
-				stats->systemTicks += SystemTick;
-    } else {
-				stats->totalTicks += UserTick;
-				stats->userTicks += UserTick;
-    }
-    DEBUG(dbgInt, "== Tick " << stats->totalTicks << " ==");
+	if (status == SystemMode) {
+	    stats->totalTicks += SystemTick;
+	    stats->systemTicks += SystemTick;
+	    scheduler->Account(SystemTick);
+	} else {
+	    stats->totalTicks += UserTick;
+	    stats->userTicks += UserTick;
+	    scheduler->Account(UserTick);
+	}
+	DEBUG(dbgInt, "== Tick " << stats->totalTicks << " ==");
+	stats->CheckSnapshot();
 
 // check any pending interrupts are now ready to fire
-    ChangeLevel(IntOn, IntOff);	// first, turn off interrupts
-				// (interrupt handlers run with
-				// interrupts disabled)
-				
-		inHandler = TRUE;
-		kernel->scheduler->Aging();
-		inHandler = FALSE;
+	inHandler = TRUE;
+	scheduler->Aging();
+	inHandler = FALSE;
 		
-    CheckIfDue(FALSE);		// check for pending interrupts
+	CheckIfDue(FALSE);		// check for pending interrupts
+	scheduler->Balance();		// start threads on idle CPUs
+    }
+    if (status == UserMode)
+	scheduler->NextCPU();		// let the other CPUs take a turn
 		
     ChangeLevel(IntOff, IntOn);	// re-enable interrupts
-    if (yieldOnReturn) {	// if the timer device handler asked 
+    if (scheduler->YieldPending()) {	// if the timer device handler asked 
     				// for a context switch, ok to do it now
-			yieldOnReturn = FALSE;
 		 	status = SystemMode;		// yield is a kernel routine
 			kernel->currentThread->Yield();
 			status = oldStatus;
@@ -198,7 +325,7 @@ void
 Interrupt::YieldOnReturn()
 { 
     ASSERT(inHandler == TRUE);  
-    yieldOnReturn = TRUE; 
+    kernel->scheduler->Preempt(kernel->scheduler->CurrentCPU());
 }
 
 //----------------------------------------------------------------------
@@ -209,6 +336,11 @@ Interrupt::YieldOnReturn()
 //	on the ready queue, the only thing to do is to advance 
 //	simulated time until the next scheduled hardware interrupt.
 //
+//	Devices waiting for host input (see WaitForInput) are checked
+//	first, so that input that arrived while the machine was busy is
+//	seen.  If nothing else is pending, sleep on the host until one
+//	of them has input, rather than spin.
+//
 //	If there are no pending interrupts, stop.  There's nothing
 //	more for us to do.
 //----------------------------------------------------------------------
@@ -216,15 +348,20 @@ Interrupt::YieldOnReturn()
 void
 Interrupt::Idle()
 {
+    HostProfScope scope(ProfInterrupt);
+
     DEBUG(dbgInt, "Machine idling; checking for interrupts.");
     status = IdleMode;
 		
-	
-		if(kernel->scheduler->blockedThread->IsEmpty()) {
+		if (numInputs > 0)
+			CheckInputs(FALSE);		// any input in the meantime?
+		if(kernel->scheduler->numBlocked == 0) {
 			Halt();
 		}
-		else if (CheckIfDue(TRUE)) {	// check for any pending interrupts
+		else if (CheckIfDue(TRUE)	// check for any pending interrupts
+			|| (numInputs > 0 && CheckInputs(TRUE) && CheckIfDue(TRUE))) {
 			status = SystemMode;
+			kernel->alarm->Resume();	// restart the timer, if need be
 			return;			// return in case there's now
 				// a runnable thread
     }
@@ -247,6 +384,7 @@ Interrupt::Idle()
 void
 Interrupt::Halt()
 {
+    kernel->schedTrace->Flush();	// print any buffered events first
     cout << "Machine halting!\n\n";
     cout << "This is halt\n";
     kernel->stats->Print();
@@ -278,10 +416,10 @@ Interrupt::WriteFile(char *buffer, int size, int id)
 {
 	return kernel->WriteFile(buffer, size, id);
 }
-char*
-Interrupt::ReadFile(int size, int id)
+int
+Interrupt::ReadFile(char *buffer, int size, int id)
 {
-	return kernel->ReadFile(size, id);
+	return kernel->ReadFile(buffer, size, id);
 }
 
 
@@ -290,7 +428,7 @@ Interrupt::ReadFile(int size, int id)
 // 	Arrange for the CPU to be interrupted when simulated time
 //	reaches "now + when".
 //
-//	Implementation: just put it on a sorted list.
+//	Implementation: just put it on the heap of pending interrupts.
 //
 //	NOTE: the Nachos kernel should not call this routine directly.
 //	Instead, it is only called by the hardware device simulators.
@@ -304,12 +442,71 @@ void
 Interrupt::Schedule(CallBackObj *toCall, int fromNow, IntType type)
 {
     int when = kernel->stats->totalTicks + fromNow;
-    PendingInterrupt *toOccur = new PendingInterrupt(toCall, when, type);
+    MemTagScope tag(MemInterrupt);
 
     DEBUG(dbgInt, "Scheduling interrupt handler the " << intTypeNames[type] << " at time = " << when);
 		ASSERT(fromNow > 0);
 
-    pending->Insert(toOccur);
+    perfScheduled.Inc();
+    perfLead.Record(fromNow);
+    pending->Insert(toCall, when, type);
+}
+
+//----------------------------------------------------------------------
+// Interrupt::WaitForInput
+// 	Arrange for a device to be interrupted once its UNIX file or
+//	socket has something to read, instead of it scheduling an
+//	interrupt every so often to poll it.  This is a one-shot: the
+//	device calls it again once it wants the next input.
+//
+//	"fd" is the UNIX file or socket to watch
+//	"toCall" is the device to call back
+//	"type" is the interrupt to raise, for debugging
+//----------------------------------------------------------------------
+
+void
+Interrupt::WaitForInput(int fd, CallBackObj *toCall, IntType type)
+{
+    DEBUG(dbgInt, "Waiting for input for the " << intTypeNames[type]);
+    ASSERT(numInputs < MaxInputs);
+    inputs[numInputs].fd = fd;
+    inputs[numInputs].callOnInput = toCall;
+    inputs[numInputs].type = type;
+    numInputs++;
+}
+
+//----------------------------------------------------------------------
+// Interrupt::CheckInputs
+// 	Check every device waiting for host input with one poll.  Each
+//	one that has input stops waiting, and its interrupt is scheduled
+//	for the next tick.
+//
+// Returns:
+//	TRUE, if any interrupt was scheduled
+// Params:
+//	"wait" -- if TRUE, nothing else can happen, so sleep on the host
+//		until some input is ready
+//----------------------------------------------------------------------
+
+bool
+Interrupt::CheckInputs(bool wait)
+{
+    int fd[MaxInputs];
+    bool ready[MaxInputs];
+    int i, n = numInputs;
+
+    for (i = 0; i < n; i++)
+	fd[i] = inputs[i].fd;
+    if (PollFiles(fd, ready, n, wait) == 0)
+	return FALSE;
+    numInputs = 0;
+    for (i = 0; i < n; i++) {
+	if (ready[i])
+	    Schedule(inputs[i].callOnInput, 1, inputs[i].type);
+	else
+	    inputs[numInputs++] = inputs[i];	// still waiting
+    }
+    return TRUE;
 }
 
 //----------------------------------------------------------------------
@@ -328,6 +525,7 @@ bool
 Interrupt::CheckIfDue(bool advanceClock)
 {
     PendingInterrupt *next;
+    PendingInterrupt due;
     Statistics *stats = kernel->stats;
 		Scheduler *scheduler = kernel->scheduler;
 
@@ -346,8 +544,11 @@ Interrupt::CheckIfDue(bool advanceClock)
             return FALSE;
         }
         else {      		// advance the clock to next interrupt
+			    perfClockJumps.Inc();
 			    stats->idleTicks += (next->when - stats->totalTicks);
+			    scheduler->Account(next->when - stats->totalTicks);
 			    stats->totalTicks = next->when;
+			    stats->CheckSnapshot();
 			    // UDelay(1000L); // rcgood - to stop nachos from spinning.
 				}
     }
@@ -361,33 +562,15 @@ Interrupt::CheckIfDue(bool advanceClock)
 
     inHandler = TRUE;
     do {
-        next = pending->RemoveFront();    // pull interrupt off list
-        next->callOnInterrupt->CallBack();// call the interrupt handler
-				
-				scheduler->BlockThreadRemove();
-				
-				if(kernel->scheduler->getScheduleMode() == SJF) {
-					Thread *first = kernel->scheduler->get_readyList_Front(1, false);
-					
-					//cout << "Current First Element of L1: " << first->getName() << "\n";
-					
-					if(first != NULL) {
-						if(first->getBurstTime() < kernel->currentThread->getBurstTime()) {
-							YieldOnReturn();
-						} else if(kernel->currentThread->getPriority() < 100 ) {
-							YieldOnReturn();
-						}
-					}
-				} else if(kernel->scheduler->getScheduleMode() == Priority) {
-					Thread *first = kernel->scheduler->get_readyList_Front(2, false);
-					
-					if(first != NULL) {
-						if(kernel->currentThread->getPriority() < 50) {
-							YieldOnReturn();
-						}
-					}
-				}
-	delete next;
+        due = pending->RemoveFront();    // pull interrupt off list
+	perfHandled.Inc();
+	if (kernel->timeline != NULL)
+	    kernel->timeline->Handler(due.type, stats->totalTicks);
+	{
+	    HostProfScope handler(ProfHandler);
+
+	    due.callOnInterrupt->CallBack();// call the interrupt handler
+	}
     } while (!pending->IsEmpty() 
     		&& (pending->Front()->when <= stats->totalTicks));
 				
@@ -57,6 +57,7 @@ enum IntType { TimerInt, DiskInt, ConsoleWriteInt, ConsoleReadInt,
 
 class PendingInterrupt {
   public:
+    PendingInterrupt() {}	// an unused slot in a PendingQueue
     PendingInterrupt(CallBackObj *callOnInt, int time, IntType kind);
 				// initialize an interrupt that will
 				// occur in the future
@@ -66,6 +67,53 @@ class PendingInterrupt {
     
     int when;			// When the interrupt is supposed to fire
     IntType type;		// for debugging
+    int order;			// when it was scheduled, so interrupts
+				// due at the same time fire in order
+};
+
+// The following class defines the set of interrupts scheduled to
+// occur, earliest first.  It is a binary heap of the records
+// themselves, so scheduling and firing an interrupt are O(log n)
+// and allocate nothing once the heap has grown to its working size.
+
+class PendingQueue {
+  public:
+    PendingQueue();		// initialize an empty queue
+    ~PendingQueue();		// de-allocate the queue
+
+    void Insert(CallBackObj *callOnInt, int when, IntType kind);
+				// schedule an interrupt
+    PendingInterrupt RemoveFront();	// take off the earliest one;
+					// the queue must not be empty
+    PendingInterrupt *Front() { return &heap[0]; }
+				// the earliest one, if not empty
+    bool IsEmpty() { return numPending == 0; }
+    void Apply(void (*func)(PendingInterrupt *));
+				// call func on every interrupt,
+				// in no particular order
+
+  private:
+    bool Before(int a, int b);	// should heap[a] fire before heap[b]?
+    void Swap(int a, int b);
+
+    PendingInterrupt *heap;	// heap[0] is the next to fire
+    int numPending;		// interrupts in the heap
+    int size;			// entries allocated in the heap
+    int numScheduled;		// for PendingInterrupt::order
+};
+
+// The most devices that can wait for host input at once
+
+const int MaxInputs = 4;
+
+// A device waiting for its UNIX file or socket to have something to
+// read; see Interrupt::WaitForInput.
+
+class InputWait {
+  public:
+    int fd;			// the UNIX file or socket
+    CallBackObj *callOnInput;	// the device to call when it is ready
+    IntType type;		// the interrupt to raise
 };
 
 // The following class defines the data structures for the simulation
@@ -100,7 +148,7 @@ class Interrupt {
     int OpenFile(char *filename); //Open a file, if exist
     int CloseFile(int openfileId); //Close a opened file, if exist
     int WriteFile(char *buffer, int size, int id); // Write size-character into a file
-    char* ReadFile(int size, int id); // Read size-character from a file
+    int ReadFile(char *buffer, int size, int id); // Read size-character from a file
     
  
     void YieldOnReturn();	// cause a context switch on return 
@@ -122,21 +170,26 @@ class Interrupt {
     				// Schedule an interrupt to occur
 				// at time "when".  This is called
     				// by the hardware device simulators.
+
+    void WaitForInput(int fd, CallBackObj *callTo, IntType type);
+				// Raise an interrupt once there is
+				// something to read on UNIX file "fd",
+				// instead of polling it.  Checked when
+				// the machine is idle.
     
     void OneTick();       	// Advance simulated time
 
   private:
     IntStatus level;		// are interrupts enabled or disabled?
-    SortedList<PendingInterrupt *> *pending;		
-    				// the list of interrupts scheduled
+    PendingQueue *pending;	// the interrupts scheduled
 				// to occur in the future
     //int writeFileNo;            //UNIX file emulating the display
     bool inHandler;		// TRUE if we are running an interrupt handler
     //bool putBusy;               // Is a PrintInt operation in progress
                                   //If so, you cannoot do another one
-    bool yieldOnReturn; 	// TRUE if we are to context switch
-				// on return from the interrupt handler
     MachineStatus status;	// idle, kernel mode, user mode
+    InputWait inputs[MaxInputs];	// devices waiting for host input
+    int numInputs;
 
     // these functions are internal to the interrupt simulation code
 
@@ -144,6 +197,10 @@ class Interrupt {
     				// Check if any interrupts are supposed
 				// to occur now, and if so, do them
 
+    bool CheckInputs(bool wait);	// Schedule an interrupt for each
+				// device whose input is ready; if "wait",
+				// sleep until at least one is
+
     void ChangeLevel(IntStatus old, 	// SetLevel, without advancing the
 			IntStatus now); // simulated time
 };
@@ -10,6 +10,7 @@
 #include "copyright.h"
 #include "machine.h"
 #include "main.h"
+#include "hostprof.h"
 
 // Textual names of the exceptions that can be generated by user program
 // execution, for debugging.
@@ -61,15 +62,15 @@ Machine::Machine(bool debug)
     mainMemory = new char[MemorySize];
     for (i = 0; i < MemorySize; i++)
       	mainMemory[i] = 0;
-#ifdef USE_TLB
-    tlb = new TranslationEntry[TLBSize];
-    for (i = 0; i < TLBSize; i++)
-	tlb[i].valid = FALSE;
-    pageTable = NULL;
-#else	// use linear page table
-    tlb = NULL;
+    if (Config::UseTLB) {
+	tlb = new TranslationEntry[TLBSize];
+	for (i = 0; i < TLBSize; i++)
+	    tlb[i].valid = FALSE;
+    } else {			// use linear page table
+	tlb = NULL;
+    }
     pageTable = NULL;
-#endif
+    linked = FALSE;
 
     singleStep = debug;
     CheckEndian();
@@ -103,9 +104,19 @@ Machine::RaiseException(ExceptionType which, int badVAddr)
     DEBUG(dbgMach, "Exception: " << exceptionNames[which]);
     registers[BadVAddrReg] = badVAddr;
     DelayedLoad(0, 0);			// finish anything in progress
+    int start = kernel->stats->totalTicks;
+    int type = registers[2];		// the system call, if it is one
+    HostProfScope scope(ProfKernel);	// not the instruction's, or
+					// the memory access's
+
+    linked = FALSE;			// the kernel (or another thread,
+					// before we're back) may write it
     kernel->interrupt->setStatus(SystemMode);
     ExceptionHandler(which);		// interrupts are enabled at this point
     kernel->interrupt->setStatus(UserMode);
+    if (which == SyscallException && kernel->timeline != NULL)
+	kernel->timeline->Syscall(kernel->currentThread, type, start,
+				  kernel->stats->totalTicks);
 }
 
 //----------------------------------------------------------------------
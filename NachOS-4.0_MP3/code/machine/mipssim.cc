@@ -21,6 +21,7 @@
 #include "machine.h"
 #include "mipssim.h"
 #include "main.h"
+#include "hostprof.h"
 
 static void Mult(int a, int b, bool signedArith, int* hiPtr, int* loPtr);
 
@@ -56,7 +57,9 @@ class Instruction {
 void
 Machine::Run()
 {
-    Instruction *instr = new Instruction;  // storage for decoded instruction
+    Instruction instr;		// storage for decoded instruction; on
+				// the stack, since we never return to
+				// delete it
 
     if (debug->IsEnabled('m')) {
         cout << "Starting program in thread: " << kernel->currentThread->getName();
@@ -64,7 +67,8 @@ Machine::Run()
     }
     kernel->interrupt->setStatus(UserMode);
     for (;;) {
-        OneInstruction(instr);
+	if (!kernel->scheduler->Stalled())	// a CPU refilling its cache
+	    OneInstruction(&instr);		// after a switch loses its turn
 //        cout << "Thread[" << kernel->currentThread->getName() << "]　RUNNING\n";
 		kernel->interrupt->OneTick();
 		if (singleStep && (runUntilTime <= kernel->stats->totalTicks))
@@ -129,6 +133,7 @@ Machine::OneInstruction(Instruction *instr)
     int nextLoadReg = 0; 	
     int nextLoadValue = 0; 	// record delayed load operation, to apply
 				// in the future
+    HostProfScope scope(ProfInstruction);
 
     // Fetch instruction 
     if (!ReadMem(registers[PCReg], 4, &raw))
@@ -310,6 +315,21 @@ Machine::OneInstruction(Instruction *instr)
 	nextLoadValue = value;
 	break;
     	
+      case OP_LL:		// LW, and remember the word for SC
+	tmp = registers[(int) instr->rs] + instr->extra;
+	if (tmp & 0x3) {
+	    RaiseException(AddressErrorException, tmp);
+	    return;
+	}
+	if (!ReadMem(tmp, 4, &value))
+	    return;
+	(void) Translate(tmp, &linkAddr, 4, FALSE);	// can't fail now
+	linked = TRUE;
+	linkThread = kernel->currentThread;
+	nextLoadReg = instr->rt;
+	nextLoadValue = value;
+	break;
+
       case OP_LWL:	  
 	tmp = registers[instr->rs] + instr->extra;
 
@@ -550,6 +570,32 @@ Machine::OneInstruction(Instruction *instr)
 	    return;
 	break;
 	
+      case OP_SC:		// SW, only if no one has written the word
+				// since our LL; rt says if it did
+	tmp = registers[(int) instr->rs] + instr->extra;
+	if (tmp & 0x3) {
+	    RaiseException(AddressErrorException, tmp);
+	    return;
+	}
+	value = 0;
+	if (linked && linkThread == kernel->currentThread) {
+	    int physAddr;
+	    ExceptionType exception = Translate(tmp, &physAddr, 4, TRUE);
+
+	    if (exception != NoException) {
+		RaiseException(exception, tmp);
+		return;
+	    }
+	    if (physAddr == linkAddr) {
+		if (!WriteMem(tmp, 4, registers[(int) instr->rt]))
+		    return;
+		value = 1;
+	    }
+	}
+	linked = FALSE;
+	registers[(int) instr->rt] = value;
+	break;
+
       case OP_SWL:	  
 	tmp = registers[instr->rs] + instr->extra;
 
@@ -0,0 +1,418 @@
+// netlink.cc
+//	Routines to model the links between machines on the in-memory
+//	wire: bandwidth, queueing, propagation delay, loss and
+//	reordering.  See netlink.h.
+//
+//  DO NOT CHANGE -- part of the machine emulation
+//
+// Copyright (c) 1992-1996 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "netlink.h"
+#include "main.h"
+#include "perfcount.h"
+#include <math.h>
+#include <fstream>
+
+static PerfCounter perfLinkSent("link", "sent");
+static PerfCounter perfLinkDropped("link", "dropped");
+static PerfHistogram perfLinkQueueTicks("link", "queue_ticks");
+					// each packet waited to be sent
+
+// RED: the weight of each new queue length in the average, and the
+// chance of dropping a packet as the average reaches the upper of its
+// two thresholds, a quarter and three quarters of the queue
+
+const double RedWeight = 0.125;
+const double RedMaxChance = 0.1;
+
+//----------------------------------------------------------------------
+// InFlightCompare
+//	Compare two packets on a link by when they arrive, and then by
+//	the order the link took them in, so that those due at the same
+//	tick arrive in the order they were sent.
+//----------------------------------------------------------------------
+
+static int
+InFlightCompare(LinkPacket *x, LinkPacket *y)
+{
+    if (x->due != y->due)
+	return (x->due < y->due) ? -1 : 1;
+    if (x->seq != y->seq)
+	return (x->seq < y->seq) ? -1 : 1;
+    return 0;
+}
+
+//----------------------------------------------------------------------
+// NetworkLink::NetworkLink
+// 	Initialize a link, idle, with nothing sent.
+//
+//	"fromHost", "toHost" -- the machines it carries packets between,
+//		or AnyHost
+//	"bytesPerMs" -- its bandwidth, in bytes per 1000 ticks
+//	"ticks" -- its propagation delay
+//	"limit" -- the most packets that can wait to be sent
+//	"queuePolicy" -- what to do as the queue fills
+//	"percent" -- how many packets to hold back, out of 100
+//----------------------------------------------------------------------
+
+NetworkLink::NetworkLink(NetworkAddress fromHost, NetworkAddress toHost,
+			 int bytesPerMs, int ticks, int limit,
+			 QueuePolicy queuePolicy, int percent)
+{
+    ASSERT(bytesPerMs > 0 && ticks >= 0);
+    ASSERT(limit > 0 && limit <= MaxLinkQueue);
+    ASSERT(percent >= 0 && percent <= 100);
+    from = fromHost;
+    to = toHost;
+    bandwidth = bytesPerMs;
+    delay = ticks;
+    queueLimit = limit;
+    policy = queuePolicy;
+    reorder = percent;
+
+    busy = FALSE;
+    inFlight = new SortedList<LinkPacket *>(InFlightCompare);
+    numTaken = 0;
+    avgQueue = 0.0;
+    idleSince = 0;
+
+    doneAt = 0;
+    numStarted = numSent = numBytes = 0;
+    numTailDrops = numEarlyDrops = numReordered = 0;
+    busyTicks = maxQueue = maxQueueTicks = 0;
+    queueTicks = 0;
+}
+
+//----------------------------------------------------------------------
+// NetworkLink::~NetworkLink
+// 	De-allocate a link.  Packets still on it are lost.
+//----------------------------------------------------------------------
+
+NetworkLink::~NetworkLink()
+{
+    while (!inFlight->IsEmpty())
+	delete inFlight->RemoveFront();
+    delete inFlight;
+}
+
+//----------------------------------------------------------------------
+// NetworkLink::Carries
+// 	Return whether this link takes packets from machine "src" to
+//	machine "dst".
+//----------------------------------------------------------------------
+
+bool
+NetworkLink::Carries(NetworkAddress src, NetworkAddress dst)
+{
+    return (from == AnyHost || from == src) && (to == AnyHost || to == dst);
+}
+
+//----------------------------------------------------------------------
+// NetworkLink::SendTime
+// 	Return how many ticks the link takes to send a packet with
+//	"length" bytes of data, and its header: at least one.
+//----------------------------------------------------------------------
+
+int
+NetworkLink::SendTime(int length)
+{
+    int bytes = sizeof(PacketHeader) + length;
+
+    return max(1, (bytes * 1000 + bandwidth - 1) / bandwidth);
+}
+
+//----------------------------------------------------------------------
+// NetworkLink::EarlyDrop
+// 	RED: fold the length of the queue into its average -- which,
+//	while the queue has been empty, decays as though packets of the
+//	largest size had been going through -- and decide whether to
+//	drop the packet coming in.  None is dropped while the average
+//	is below a quarter of the queue, and every one once it is at
+//	three quarters; between the two, the chance goes up to
+//	RedMaxChance.
+//----------------------------------------------------------------------
+
+bool
+NetworkLink::EarlyDrop()
+{
+    int now = kernel->stats->totalTicks;
+    double low = max(1, queueLimit / 4);
+    double high = max(queueLimit / 4 + 1, 3 * queueLimit / 4);
+    double chance;
+
+    if (queue.IsEmpty())
+	avgQueue *= pow(1.0 - RedWeight,
+			(double) (now - idleSince) / SendTime(MaxPacketSize));
+    avgQueue += RedWeight * (queue.NumInRing() - avgQueue);
+    if (avgQueue < low)
+	return FALSE;
+    if (avgQueue >= high)
+	return TRUE;
+    chance = RedMaxChance * (avgQueue - low) / (high - low);
+    return (kernel->Random() % 10000) < chance * 10000;
+}
+
+//----------------------------------------------------------------------
+// NetworkLink::Send
+// 	A device has sent a packet onto the link.  Drop it if the queue
+//	is full, or RED says so; otherwise queue it, and if the link is
+//	idle, start sending it.
+//
+//	"packet" -- the packet; it is copied
+//----------------------------------------------------------------------
+
+void
+NetworkLink::Send(TransmitDescriptor *packet)
+{
+    LinkPacket *slot;
+    bool early = (policy == RandomEarlyDrop && EarlyDrop());
+
+    if (early || queue.NumInRing() >= queueLimit) {
+	DEBUG(dbgNet, "Link to " << packet->hdr.to << " dropping packet from "
+	      << packet->hdr.from << (early ? " early" : ", queue full"));
+	if (early)
+	    numEarlyDrops++;
+	else
+	    numTailDrops++;
+	perfLinkDropped.Inc();
+	return;
+    }
+    slot = queue.Tail();
+    ASSERT(slot != NULL);
+    slot->packet = *packet;
+    slot->seq = numTaken++;
+    slot->queued = kernel->stats->totalTicks;
+    queue.Push();
+    maxQueue = max(maxQueue, queue.NumInRing());
+    if (!busy)
+	StartSend();
+}
+
+//----------------------------------------------------------------------
+// NetworkLink::StartSend
+// 	Start sending the packet at the head of the queue, and schedule
+//	an interrupt for when it has gone.
+//----------------------------------------------------------------------
+
+void
+NetworkLink::StartSend()
+{
+    LinkPacket *head = queue.Head();
+    int waited = kernel->stats->totalTicks - head->queued;
+    int ticks = SendTime(head->packet.hdr.length);
+
+    busy = TRUE;
+    doneAt = kernel->stats->totalTicks + ticks;
+    numStarted++;
+    queueTicks += waited;
+    maxQueueTicks = max(maxQueueTicks, waited);
+    perfLinkQueueTicks.Record(waited);
+    busyTicks += ticks;
+    kernel->interrupt->Schedule(this, ticks, NetworkSendInt);
+}
+
+//----------------------------------------------------------------------
+// NetworkLink::CallBack
+// 	Called when the packet being sent has gone, and when a packet is
+//	due to arrive; either may be both.
+//
+//	A packet that has gone is due after the propagation delay, or
+//	later if it is one of those held back; schedule an interrupt for
+//	it, and start sending the next.  Then hand over, in order, every
+//	packet that is due to the machine it is for, if it is on the
+//	wire.
+//----------------------------------------------------------------------
+
+void
+NetworkLink::CallBack()
+{
+    int now = kernel->stats->totalTicks;
+
+    if (busy && doneAt <= now) {
+	LinkPacket *sent = new LinkPacket(*queue.Head());
+
+	queue.Pop();
+	busy = FALSE;
+	numSent++;
+	numBytes += sizeof(PacketHeader) + sent->packet.hdr.length;
+	perfLinkSent.Inc();
+	sent->due = now + delay;
+	if (reorder > 0 && (int) (kernel->Random() % 100) < reorder) {
+	    sent->due += 1 + kernel->Random() % (2 * SendTime(MaxPacketSize));
+	    numReordered++;
+	}
+	inFlight->Insert(sent);
+	if (sent->due > now)
+	    kernel->interrupt->Schedule(this, sent->due - now, NetworkRecvInt);
+	if (!queue.IsEmpty())
+	    StartSend();
+	else
+	    idleSince = now;
+    }
+    while (!inFlight->IsEmpty() && inFlight->Front()->due <= now) {
+	LinkPacket *p = inFlight->RemoveFront();
+	NetworkInput *input = NetworkInput::OnWire(p->packet.hdr.to);
+
+	if (input != NULL)
+	    input->Arrive(&p->packet);
+	else
+	    DEBUG(dbgNet, "No machine " << p->packet.hdr.to << " on the wire");
+	delete p;
+    }
+}
+
+//----------------------------------------------------------------------
+// NetworkLink::Print
+// 	Print what the link carried, if anything came to it: packets
+//	and bytes sent, packets dropped, how much of the time since the
+//	start the link was busy, and how long packets waited to be sent.
+//----------------------------------------------------------------------
+
+void
+NetworkLink::Print()
+{
+    int ticks = kernel->stats->totalTicks;
+
+    if (numTaken == 0 && numTailDrops == 0 && numEarlyDrops == 0)
+	return;
+    cout << "Link ";
+    if (from == AnyHost) cout << "*"; else cout << from;
+    cout << " -> ";
+    if (to == AnyHost) cout << "*"; else cout << to;
+    cout << ": packets " << numSent << ", bytes " << numBytes
+	 << ", dropped " << numTailDrops + numEarlyDrops
+	 << " (early " << numEarlyDrops << "), reordered " << numReordered
+	 << ", utilization "
+	 << ((ticks > 0) ? busyTicks * 100.0 / ticks : 0.0) << "%"
+	 << ", queue delay mean "
+	 << ((numStarted > 0) ? (double) queueTicks / numStarted : 0.0)
+	 << " max " << maxQueueTicks << " ticks, most queued "
+	 << maxQueue << "\n";
+}
+
+//----------------------------------------------------------------------
+// LinkModel::LinkModel
+// 	Start with no links, until Load reads some.
+//----------------------------------------------------------------------
+
+LinkModel::LinkModel()
+{
+    numLinks = 0;
+}
+
+//----------------------------------------------------------------------
+// LinkModel::~LinkModel
+// 	De-allocate the links.
+//----------------------------------------------------------------------
+
+LinkModel::~LinkModel()
+{
+    for (int i = 0; i < numLinks; i++)
+	delete link[i];
+}
+
+//----------------------------------------------------------------------
+// ReadHost
+// 	Parse a machine number, or * for any; return FALSE if "word" is
+//	neither.
+//----------------------------------------------------------------------
+
+static bool
+ReadHost(char *word, NetworkAddress *host)
+{
+    if (strcmp(word, "*") == 0) {
+	*host = AnyHost;
+	return TRUE;
+    }
+    return sscanf(word, "%d", host) == 1 && *host >= 0
+	    && *host < MaxWireHosts;
+}
+
+//----------------------------------------------------------------------
+// LinkModel::Load
+// 	Add the links read from a file, in the format described in
+//	netlink.h.  If the file can't be read, or a line is not valid,
+//	print why and return FALSE.
+//
+//	"fileName" is the UNIX file to read
+//----------------------------------------------------------------------
+
+bool
+LinkModel::Load(char *fileName)
+{
+    ifstream in(fileName);
+    char buf[200], word[20], src[20], dst[20], rule[20];
+    int line = 0, bandwidth, delay, limit, reorder;
+    NetworkAddress from, to;
+    QueuePolicy policy;
+
+    if (!in) {
+	cout << "Can't open link model " << fileName << "\n";
+	return FALSE;
+    }
+    while (in.getline(buf, sizeof(buf))) {
+	line++;
+	if (buf[0] == '#' || sscanf(buf, " %19s", word) != 1)
+	    continue;			// comment or blank line
+	if (numLinks == MaxLinks) {
+	    cout << fileName << ":" << line << ": more than "
+		 << MaxLinks << " links\n";
+	    return FALSE;
+	}
+	if (sscanf(buf, " link %19s %19s %d %d %d %19s %d", src, dst,
+			&bandwidth, &delay, &limit, rule, &reorder) != 7) {
+	    cout << fileName << ":" << line << ": expected \"link <from> "
+		 << "<to> <bandwidth> <delay> <queue> <tail|red> "
+		 << "<reorder>\"\n";
+	    return FALSE;
+	}
+	if (strcmp(rule, "tail") == 0) {
+	    policy = TailDrop;
+	} else if (strcmp(rule, "red") == 0) {
+	    policy = RandomEarlyDrop;
+	} else {
+	    cout << fileName << ":" << line << ": unknown queue " << rule
+		 << "\n";
+	    return FALSE;
+	}
+	if (!ReadHost(src, &from) || !ReadHost(dst, &to) || bandwidth <= 0
+		|| delay < 0 || limit <= 0 || limit > MaxLinkQueue
+		|| reorder < 0 || reorder > 100) {
+	    cout << fileName << ":" << line << ": bad link\n";
+	    return FALSE;
+	}
+	link[numLinks++] = new NetworkLink(from, to, bandwidth, delay, limit,
+					   policy, reorder);
+    }
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// LinkModel::Between
+// 	Return the first link that carries packets from machine "from" to
+//	machine "to", or NULL if none does.
+//----------------------------------------------------------------------
+
+NetworkLink *
+LinkModel::Between(NetworkAddress from, NetworkAddress to)
+{
+    for (int i = 0; i < numLinks; i++)
+	if (link[i]->Carries(from, to))
+	    return link[i];
+    return NULL;
+}
+
+//----------------------------------------------------------------------
+// LinkModel::Print
+// 	Print the statistics of each link that was used.
+//----------------------------------------------------------------------
+
+void
+LinkModel::Print()
+{
+    for (int i = 0; i < numLinks; i++)
+	link[i]->Print();
+}
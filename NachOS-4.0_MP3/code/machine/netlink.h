@@ -0,0 +1,153 @@
+// netlink.h
+//	Data structures to model the links between machines on the
+//	in-memory wire (-wire), rather than have every packet arrive the
+//	moment its sender's network device has sent it.
+//
+//	A link carries packets from some machines to others.  It sends
+//	one at a time, each for as long as its bytes take at the link's
+//	bandwidth; those that come while it is busy wait in its queue,
+//	and those that come when the queue is full are dropped.  With
+//	RED (random early detection), a packet may be dropped before
+//	then, the more likely the longer the queue has been on average,
+//	so that senders hear of congestion before the queue overflows.
+//	Once sent, a packet arrives after the link's propagation delay;
+//	a few, chosen at random, are held back a little longer, so that
+//	they arrive behind packets sent after them.
+//
+//	The links are read from a file given with "-link".  Each line of
+//	the file is either a comment (starting with #) or one link:
+//
+//	    link <from> <to> <bandwidth> <delay> <queue> <tail|red>
+//		<reorder>
+//
+//	"from" and "to" are machine numbers, or * for any.  A packet
+//	takes the first link that matches it; all the packets a line
+//	matches share the one link, so "link * 4 ..." is a bottleneck
+//	into machine 4.  A packet no line matches arrives as it did
+//	without a link model.  "bandwidth" is in bytes per thousand
+//	ticks (a tick is a microsecond, as on the timeline), counting
+//	each packet's PacketHeader and data; a network device sends
+//	MaxWireSize bytes in NetworkTime, about 640.  "delay" is in
+//	ticks, "queue" is the most packets the link can hold, counting
+//	the one being sent (up to MaxLinkQueue), and "reorder" is the percentage of packets held
+//	back, each by up to two packet times more.
+//
+//	A packet still goes through its sender's device first, taking
+//	NetworkTime, and may be lost there as -n says.  Random choices
+//	come from Kernel::Random, so runs are repeatable.  At halt,
+//	each link that was used prints how much it carried and dropped,
+//	how busy it was, and how long packets queued for it.
+//
+//  DO NOT CHANGE -- part of the machine emulation
+//
+// Copyright (c) 1992-1996 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#ifndef NETLINK_H
+#define NETLINK_H
+
+#include "copyright.h"
+#include "network.h"
+#include "callback.h"
+#include "ring.h"
+#include "list.h"
+
+// The most links, and the most packets one can queue
+
+const int MaxLinks = 16;
+const int MaxLinkQueue = 64;		// a power of two, for the Ring
+
+// A link matching any machine
+
+const NetworkAddress AnyHost = -1;
+
+// What a link does when packets come faster than it sends them
+
+enum QueuePolicy {
+    TailDrop,				// drop those that find the queue full
+    RandomEarlyDrop			// RED: and some before it is
+};
+
+// A packet on a link: waiting to be sent, or on its way
+
+class LinkPacket {
+  public:
+    TransmitDescriptor packet;
+    int seq;				// in the order the link took them
+    int queued;				// when it joined the queue
+    int due;				// when it arrives
+};
+
+// The following class defines one link.
+
+class NetworkLink : public CallBackObj {
+  public:
+    NetworkLink(NetworkAddress from, NetworkAddress to, int bandwidth,
+		int delay, int queueLimit, QueuePolicy policy, int reorder);
+    ~NetworkLink();
+
+    bool Carries(NetworkAddress from, NetworkAddress to);
+				// does this link take packets between them?
+    void Send(TransmitDescriptor *packet);
+				// a device has sent a packet onto the
+				// link; queue it, or drop it
+
+    void CallBack();		// a packet has been sent, or is due
+
+    void Print();		// how much the link carried, and how
+
+  private:
+    int SendTime(int length);	// ticks to send "length" bytes of data
+    bool EarlyDrop();		// should RED drop the packet coming in?
+    void StartSend();		// send the packet at the head of the queue
+
+    NetworkAddress from, to;	// who it carries packets between
+    int bandwidth;		// bytes per 1000 ticks
+    int delay;			// propagation delay, in ticks
+    int queueLimit;		// packets that can wait
+    QueuePolicy policy;
+    int reorder;		// percent of packets held back
+
+    Ring<LinkPacket, MaxLinkQueue> queue;
+				// packets to send; the head one is
+				// being sent, if "busy"
+    bool busy;			// is a packet being sent?
+    int doneAt;			// when it will have gone
+    SortedList<LinkPacket *> *inFlight;
+				// sent, not yet arrived, by when they
+				// are due
+    int numTaken;		// packets that came to the link
+    double avgQueue;		// for RED, the average queue length
+    int idleSince;		// when the queue last emptied
+
+    int numStarted;		// packets the link has started to send
+    int numSent, numBytes;	// and finished, and their bytes
+    int numTailDrops, numEarlyDrops;
+    int numReordered;
+    int busyTicks;		// spent sending
+    int maxQueue;		// most packets queued at once
+    long long queueTicks;	// total time packets waited to be sent
+    int maxQueueTicks;		// longest any waited
+};
+
+// The following class defines the links of the in-memory wire.
+
+class LinkModel {
+  public:
+    LinkModel();		// no links: packets arrive as they are sent
+    ~LinkModel();
+
+    bool Load(char *fileName);	// read the links from a file
+
+    NetworkLink *Between(NetworkAddress from, NetworkAddress to);
+				// the link packets between them take,
+				// or NULL
+    void Print();		// the statistics of every link
+
+  private:
+    NetworkLink *link[MaxLinks];
+    int numLinks;
+};
+
+#endif // NETLINK_H
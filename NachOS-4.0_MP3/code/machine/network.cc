@@ -11,28 +11,79 @@
 #include "copyright.h"
 #include "network.h"
 #include "main.h"
+#include "memops.h"
+#include "netlink.h"
+#include <limits.h>
+
+// The machines on the in-memory wire, by address
+
+static NetworkInput *wireHost[MaxWireHosts];
+
+// The machines in lockstep in this process (just the one), by address
+
+static NetworkSync *syncHost[MaxSyncHosts];
 
 //-----------------------------------------------------------------------
 // NetworkInput::NetworkInput
 // 	Initialize the simulation for the network input
 //
 //   	"toCall" is the interrupt handler to call when packet arrives
+//	"addr" is the machine to receive for, or -1 for this one
 //-----------------------------------------------------------------------
 
-NetworkInput::NetworkInput(CallBackObj *toCall)
+NetworkInput::NetworkInput(CallBackObj *toCall, NetworkAddress addr)
 {
     // set up the stuff to emulate asynchronous interrupts
     callWhenAvail = toCall;
     packetAvail = FALSE;
     inHdr.length = 0;
+    address = (addr < 0) ? kernel->hostName : addr;
+    onWire = kernel->memoryWire;
+    sync = NULL;
+    callPending = FALSE;
+
+    if (onWire) {			// plug into the wire
+	ASSERT(address < MaxWireHosts && wireHost[address] == NULL);
+	wireHost[address] = this;
+	return;
+    }
     
     sock = OpenSocket();
-    sprintf(sockName, "SOCKET_%d", kernel->hostName);
+    sprintf(sockName, "SOCKET_%d", address);
     AssignNameToSocket(sockName, sock);		 // Bind socket to a filename 
 						 // in the current directory.
 
+    if (kernel->syncHosts > 0) {	// packets come from the lockstep
+	sync = new NetworkSync(this, address, sock, kernel->syncHosts);
+	return;
+    }
+
     // start polling for incoming packets
-    kernel->interrupt->Schedule(this, NetworkTime, NetworkRecvInt);
+    Listen();
+}
+
+//-----------------------------------------------------------------------
+// NetworkInput::Listen
+//	Arrange for CallBack to be called when the next packet may have
+//	arrived: either poll again in NetworkTime ticks, or have the
+//	interrupt simulation wait for the socket to be readable.
+//
+//	On the in-memory wire, or in lockstep, there is nothing to poll:
+//	just be called back at once if a packet has already come.
+//-----------------------------------------------------------------------
+
+void
+NetworkInput::Listen()
+{
+    if (onWire || sync != NULL) {
+	if (!wireIn.IsEmpty() && !callPending) {
+	    callPending = TRUE;
+	    kernel->interrupt->Schedule(this, 1, NetworkRecvInt);
+	}
+    } else if (kernel->waitForInput)
+	kernel->interrupt->WaitForInput(sock, this, NetworkRecvInt);
+    else
+	kernel->interrupt->Schedule(this, NetworkTime, NetworkRecvInt);
 }
 
 //-----------------------------------------------------------------------
@@ -43,6 +94,11 @@ NetworkInput::NetworkInput(CallBackObj *toCall)
 
 NetworkInput::~NetworkInput()
 {
+    if (onWire) {
+	wireHost[address] = NULL;
+	return;
+    }
+    delete sync;
     CloseSocket(sock);
     DeAssignNameToSocket(sockName);
 }
@@ -55,27 +111,60 @@ NetworkInput::~NetworkInput()
 //      First check to make sure packet is available & there's space to
 //	pull it in.  Then invoke the "callBack" registered by whoever 
 //	wants the packet.
+//
+//	When waiting for input, rather than polling, there is no need
+//	to listen while a packet is buffered: Receive starts again.
 //-----------------------------------------------------------------------
 
 void
 NetworkInput::CallBack()
 {
+    TransmitDescriptor *packet;
+
+    if (onWire || sync != NULL) {
+	callPending = FALSE;
+	if (inHdr.length != 0 || (packet = wireIn.Head()) == NULL)
+	    return;
+	inHdr = packet->hdr;
+	MemCopy(inbox, packet->data, inHdr.length);
+	wireIn.Pop();
+
+	DEBUG(dbgNet, "Network received packet from " << inHdr.from << ", length " << inHdr.length);
+	kernel->stats->numPacketsRecvd++;
+	callWhenAvail->CallBack();
+	return;
+    }
+
     // schedule the next time to poll for a packet
-    kernel->interrupt->Schedule(this, NetworkTime, NetworkRecvInt);
+    if (!kernel->waitForInput)
+	Listen();
+
+    Replay *replay = kernel->replay;
+    bool playing = (replay != NULL && replay->Playing());
 
     if (inHdr.length != 0) 	// do nothing if packet is already buffered
 	return;		
-    if (!PollSocket(sock)) 	// do nothing if no packet to be read
+    if (playing ? !replay->Ready(ReplayPacket) : !PollSocket(sock)) {
+				// do nothing if no packet to be read
+	if (kernel->waitForInput)
+	    Listen();
 	return;
+    }
 
     // otherwise, read packet in
     char *buffer = new char[MaxWireSize];
-    ReadFromSocket(sock, buffer, MaxWireSize);
+    if (playing) {
+	replay->Input(ReplayPacket, buffer, MaxWireSize);
+    } else {
+	ReadFromSocket(sock, buffer, MaxWireSize);
+	if (replay != NULL)
+	    replay->Input(ReplayPacket, buffer, MaxWireSize);
+    }
 
     // divide packet into header and data
     inHdr = *(PacketHeader *)buffer;
-    ASSERT((inHdr.to == kernel->hostName) && (inHdr.length <= MaxPacketSize));
-    bcopy(buffer + sizeof(PacketHeader), inbox, inHdr.length);
+    ASSERT((inHdr.to == address) && (inHdr.length <= MaxPacketSize));
+    MemCopy(inbox, buffer + sizeof(PacketHeader), inHdr.length);
     delete [] buffer ;
 
     DEBUG(dbgNet, "Network received packet from " << inHdr.from << ", length " << inHdr.length);
@@ -97,20 +186,62 @@ NetworkInput::Receive(char* data)
 
     inHdr.length = 0;
     if (hdr.length != 0) {
-    	bcopy(inbox, data, hdr.length);
+    	MemCopy(data, inbox, hdr.length);
+	if (kernel->waitForInput || onWire || sync != NULL)
+	    Listen();			// wait for the next one
     }
     return hdr;
 }
 
+//-----------------------------------------------------------------------
+// NetworkInput::Arrive
+// 	Called when a packet for us reaches the end of the in-memory
+//	wire, or is due from the lockstep.  Queue it, and unless one is
+//	already buffered, pass it on.  If too many are waiting, drop it.
+//
+//	"packet" is the packet, as it was sent
+//-----------------------------------------------------------------------
+
+void
+NetworkInput::Arrive(TransmitDescriptor *packet)
+{
+    TransmitDescriptor *slot = wireIn.Tail();
+
+    if (slot == NULL) {
+	DEBUG(dbgNet, "Wire backlog full, dropping packet for " << address);
+	return;
+    }
+    *slot = *packet;
+    wireIn.Push();
+    if (inHdr.length == 0)
+	Listen();
+}
+
+//-----------------------------------------------------------------------
+// NetworkInput::OnWire
+// 	Return machine "addr" on the in-memory wire, or NULL if there is
+//	no such machine.
+//-----------------------------------------------------------------------
+
+NetworkInput *
+NetworkInput::OnWire(NetworkAddress addr)
+{
+    if (addr < 0 || addr >= MaxWireHosts)
+	return NULL;
+    return wireHost[addr];
+}
+
 //-----------------------------------------------------------------------
 // NetworkOutput::NetworkOutput
 // 	Initialize the simulation for sending network packets
 //
 //   	"reliability" says whether we drop packets to emulate unreliable links
 //   	"toCall" is the interrupt handler to call when next packet can be sent
+//	"addr" is the machine to send from, or -1 for this one
 //-----------------------------------------------------------------------
 
-NetworkOutput::NetworkOutput(double reliability, CallBackObj *toCall)
+NetworkOutput::NetworkOutput(double reliability, CallBackObj *toCall,
+				NetworkAddress addr)
 {
     if (reliability < 0) chanceToWork = 0;
     else if (reliability > 1) chanceToWork = 1;
@@ -118,8 +249,16 @@ NetworkOutput::NetworkOutput(double reliability, CallBackObj *toCall)
 
     // set up the stuff to emulate asynchronous interrupts
     callWhenDone = toCall;
-    sendBusy = FALSE;
-    sock = OpenSocket();
+    numDone = 0;
+    address = (addr < 0) ? kernel->hostName : addr;
+    onWire = kernel->memoryWire;
+    sync = NULL;
+    if (!onWire && kernel->syncHosts > 0) {
+	sync = NetworkSync::Of(address);
+	ASSERT(sync != NULL);		// the input is set up first
+    }
+    if (!onWire && sync == NULL)
+	sock = OpenSocket();
 }
 
 //-----------------------------------------------------------------------
@@ -129,54 +268,355 @@ NetworkOutput::NetworkOutput(double reliability, CallBackObj *toCall)
 
 NetworkOutput::~NetworkOutput()
 {
-    CloseSocket(sock);
+    if (!onWire && sync == NULL)
+	CloseSocket(sock);
 }
 
 //-----------------------------------------------------------------------
 // NetworkOutput::CallBack
-// 	Called by simulator when another packet can be sent.
+// 	Called by simulator when the packet on the wire has been sent.
+//	Take it off the queue and start the next one, so the wire is
+//	kept busy without waiting for anyone.  The sender is only told
+//	once a batch has gone or there is nothing left to send.
+//
+//	On the in-memory wire, this is when the packet reaches the
+//	machine it was sent to, if there is one -- or, with a link model
+//	(-link), the link it takes there.
 //-----------------------------------------------------------------------
 
 void
 NetworkOutput::CallBack()
 {
-    sendBusy = FALSE;
+    TransmitDescriptor *desc = queue.Head();
+    int to = desc->hdr.to;
+    NetworkLink *link = NULL;
+
+    if (onWire && kernel->links != NULL)
+	link = kernel->links->Between(address, to);
+    if (onWire && !desc->lost) {
+	if (link != NULL)
+	    link->Send(desc);
+	else if (to >= 0 && to < MaxWireHosts && wireHost[to] != NULL)
+	    wireHost[to]->Arrive(desc);
+	else
+	    DEBUG(dbgNet, "No machine " << to << " on the wire");
+    }
+    queue.Pop();
     kernel->stats->numPacketsSent++;
-    callWhenDone->CallBack();
+    if (!queue.IsEmpty())
+	StartSend();
+    if (++numDone == TransmitBatch || queue.IsEmpty()) {
+	numDone = 0;
+	callWhenDone->CallBack();
+    }
 }
 
 //-----------------------------------------------------------------------
 // NetworkOutput::Send
-// 	Send a packet into the simulated network, to the destination in hdr.
-// 	Concatenate hdr and data, and schedule an interrupt to tell the user 
-// 	when the next packet can be sent 
+// 	Queue a packet to be sent into the simulated network, to the
+//	destination in hdr.  The data is copied into the queue, so the
+//	caller can reuse it at once.  If the wire is idle, the packet
+//	goes out straight away.
+//
+//	Returns FALSE if the queue is full; the caller should wait for
+//	callWhenDone and try again.
+//-----------------------------------------------------------------------
+
+bool
+NetworkOutput::Send(PacketHeader hdr, char* data)
+{
+    IntStatus oldLevel;
+    TransmitDescriptor *desc;
+    
+    ASSERT((hdr.length > 0) && (hdr.length <= MaxPacketSize)
+	&& (hdr.from == address));
+
+    oldLevel = kernel->interrupt->SetLevel(IntOff);
+    desc = queue.Tail();
+    if (desc == NULL) {
+	(void) kernel->interrupt->SetLevel(oldLevel);
+	return FALSE;
+    }
+    desc->hdr = hdr;
+    MemCopy(desc->data, data, hdr.length);
+    queue.Push();
+    if (queue.NumInRing() == 1)		// the wire was idle
+	StartSend();
+    (void) kernel->interrupt->SetLevel(oldLevel);
+    return TRUE;
+}
+
+//-----------------------------------------------------------------------
+// NetworkOutput::StartSend
+// 	Put the packet at the head of the queue on the wire, and
+// 	schedule an interrupt for when it has been sent.  On the
+//	in-memory wire, it is delivered then.
 //
 // 	Note we always pad out a packet to MaxWireSize before putting it into
 // 	the socket, because it's simpler at the receive end.
 //-----------------------------------------------------------------------
 
 void
-NetworkOutput::Send(PacketHeader hdr, char* data)
+NetworkOutput::StartSend()
 {
+    TransmitDescriptor *desc = queue.Head();
+    PacketHeader hdr = desc->hdr;
     char toName[32];
+    char buffer[MaxWireSize];
 
     sprintf(toName, "SOCKET_%d", (int)hdr.to);
-    
-    ASSERT((sendBusy == FALSE) && (hdr.length > 0) && 
-	(hdr.length <= MaxPacketSize) && (hdr.from == kernel->hostName));
     DEBUG(dbgNet, "Sending to addr " << hdr.to << ", length " << hdr.length);
 
     kernel->interrupt->Schedule(this, NetworkTime, NetworkSendInt);
 
-    if (RandomNumber() % 100 >= chanceToWork * 100) { // emulate a lost packet
+    desc->lost = (kernel->Random() % 100 >= chanceToWork * 100);
+    if (desc->lost) {			// emulate a lost packet
 	DEBUG(dbgNet, "oops, lost it!");
 	return;
     }
+    if (onWire)
+	return;
+    if (sync != NULL) {
+	sync->Send(hdr, desc->data);
+	return;
+    }
 
     // concatenate hdr and data into a single buffer, and send it out
-    char *buffer = new char[MaxWireSize];
     *(PacketHeader *)buffer = hdr;
-    bcopy(data, buffer + sizeof(PacketHeader), hdr.length);
+    MemCopy(buffer + sizeof(PacketHeader), desc->data, hdr.length);
     SendToSocket(sock, buffer, MaxWireSize, toName);
-    delete [] buffer;
+}
+
+//-----------------------------------------------------------------------
+// SyncCompare
+//	Compare two packets from the lockstep by when they are due, and
+//	then by who sent them, so that they are handed over in the same
+//	order every run.  (Packets from one machine stay in the order
+//	they were sent.)
+//-----------------------------------------------------------------------
+
+static int
+SyncCompare(SyncFrame *x, SyncFrame *y)
+{
+    if (x->when != y->when)
+	return (x->when < y->when) ? -1 : 1;
+    if (x->hdr.from != y->hdr.from)
+	return (x->hdr.from < y->hdr.from) ? -1 : 1;
+    return 0;
+}
+
+//-----------------------------------------------------------------------
+// NetworkSync::NetworkSync
+// 	Start keeping machine "addr" in lockstep with the others, from 0
+//	to "hosts" - 1.  The first window ends at the next multiple of
+//	NetworkTime, as it does for all of them.
+//
+//	"in" is the network input to pass packets for us to
+//	"sockID" is our socket, already bound to our address
+//-----------------------------------------------------------------------
+
+NetworkSync::NetworkSync(NetworkInput *in, NetworkAddress addr, int sockID,
+			int hosts)
+{
+    int now = kernel->stats->totalTicks;
+
+    ASSERT(hosts <= MaxSyncHosts && addr >= 0 && addr < hosts);
+    ASSERT(syncHost[addr] == NULL);
+    input = in;
+    address = addr;
+    sock = sockID;
+    numHosts = hosts;
+    for (int i = 0; i < numHosts; i++)
+	heard[i] = (i == address) ? INT_MAX : 0;
+    arrived = new SortedList<SyncFrame *>(SyncCompare);
+    syncHost[address] = this;
+
+    nextWindow = (now / NetworkTime + 1) * NetworkTime;
+    kernel->interrupt->Schedule(this, nextWindow - now, NetworkRecvInt);
+}
+
+//-----------------------------------------------------------------------
+// NetworkSync::~NetworkSync
+// 	This machine is halting: promise the others it won't send any
+//	more, so they don't wait for it.  Packets not handed over yet
+//	are dropped.
+//-----------------------------------------------------------------------
+
+NetworkSync::~NetworkSync()
+{
+    Promise(INT_MAX);
+    syncHost[address] = NULL;
+    while (!arrived->IsEmpty())
+	delete arrived->RemoveFront();
+    delete arrived;
+}
+
+//-----------------------------------------------------------------------
+// NetworkSync::Of
+// 	Return the lockstep of machine "addr" in this process, or NULL
+//	if it isn't in lockstep.
+//-----------------------------------------------------------------------
+
+NetworkSync *
+NetworkSync::Of(NetworkAddress addr)
+{
+    if (addr < 0 || addr >= MaxSyncHosts)
+	return NULL;
+    return syncHost[addr];
+}
+
+//-----------------------------------------------------------------------
+// NetworkSync::Send
+// 	Send a packet to another machine, stamped to arrive NetworkTime
+//	ticks from now; that is when a packet would finish going out.
+//	Packets for a machine that has halted are dropped.
+//
+//	"hdr" -- where it is going
+//	"data" -- hdr.length bytes of it
+//-----------------------------------------------------------------------
+
+void
+NetworkSync::Send(PacketHeader hdr, char *data)
+{
+    SyncFrame frame;
+
+    if (hdr.to < 0 || hdr.to >= numHosts || heard[hdr.to] == INT_MAX) {
+	DEBUG(dbgNet, "No machine " << hdr.to << " in lockstep");
+	return;
+    }
+    frame.when = kernel->stats->totalTicks + NetworkTime;
+    frame.hdr = hdr;
+    MemCopy(frame.data, data, hdr.length);
+    Send(hdr.to, &frame);
+}
+
+//-----------------------------------------------------------------------
+// NetworkSync::Send
+// 	Put one frame on the socket, to machine "to".
+//-----------------------------------------------------------------------
+
+void
+NetworkSync::Send(NetworkAddress to, SyncFrame *frame)
+{
+    char toName[32];
+
+    sprintf(toName, "SOCKET_%d", (int) to);
+    SendToSocket(sock, (char *) frame, sizeof(SyncFrame), toName);
+}
+
+//-----------------------------------------------------------------------
+// NetworkSync::Promise
+// 	Tell every machine still running that we have sent them all we
+//	are going to before "when", as simulated time has got that far.
+//-----------------------------------------------------------------------
+
+void
+NetworkSync::Promise(int when)
+{
+    SyncFrame frame;
+
+    frame.when = when;
+    frame.hdr.from = address;
+    frame.hdr.length = 0;
+    for (int i = 0; i < numHosts; i++) {
+	if (heard[i] == INT_MAX)
+	    continue;			// us, or halted
+	frame.hdr.to = i;
+	Send(i, &frame);
+    }
+}
+
+//-----------------------------------------------------------------------
+// NetworkSync::Wait
+// 	Wait on the host until every other machine has promised to have
+//	got to now, keeping the packets they send meanwhile.
+//
+//	Some of those packets may have been sent after the promise, and
+//	whether they are here yet depends on the host; but none of them
+//	is due before now + NetworkTime.
+//-----------------------------------------------------------------------
+
+void
+NetworkSync::Wait()
+{
+    int now = kernel->stats->totalTicks;
+    SyncFrame frame;
+    int i;
+
+    for (;;) {
+	for (i = 0; i < numHosts; i++)
+	    if (heard[i] < now)
+		break;
+	if (i == numHosts)
+	    return;			// all caught up
+
+	ReadFromSocket(sock, (char *) &frame, sizeof(SyncFrame));
+	ASSERT(frame.hdr.from >= 0 && frame.hdr.from < numHosts);
+	if (frame.hdr.length == 0) {
+	    heard[frame.hdr.from] = frame.when;
+	    continue;
+	}
+	ASSERT(frame.hdr.to == address && frame.hdr.length <= MaxPacketSize);
+	arrived->Insert(new SyncFrame(frame));
+    }
+}
+
+//-----------------------------------------------------------------------
+// NetworkSync::Deliver
+// 	Hand the packets that are now due to the network input, in order.
+//	Only those due in the current window count: they are here every
+//	run, the later ones perhaps not.
+//-----------------------------------------------------------------------
+
+void
+NetworkSync::Deliver()
+{
+    int now = kernel->stats->totalTicks;
+    TransmitDescriptor packet;
+    SyncFrame *frame;
+
+    while (!arrived->IsEmpty() && arrived->Front()->when <= now
+		&& arrived->Front()->when < nextWindow) {
+	frame = arrived->RemoveFront();
+	packet.hdr = frame->hdr;
+	MemCopy(packet.data, frame->data, frame->hdr.length);
+	packet.lost = FALSE;
+	input->Arrive(&packet);
+	delete frame;
+    }
+}
+
+//-----------------------------------------------------------------------
+// NetworkSync::CallBack
+// 	Called at the end of each window, and when a packet is due.
+//
+//	At the end of a window, promise the others we have got this far,
+//	wait for them to get here too, and start the next window.  We
+//	now have every packet due in it; schedule an interrupt for each,
+//	in order. (Interrupts are sometimes late, by a few ticks in the
+//	kernel; a packet due before then is handed over now.)
+//
+//	Then hand over whatever is due.
+//-----------------------------------------------------------------------
+
+void
+NetworkSync::CallBack()
+{
+    int now = kernel->stats->totalTicks;
+    int lastWindow = nextWindow;
+
+    if (now >= nextWindow) {
+	DEBUG(dbgNet, "Lockstep: machine " << address << " at " << now);
+	Promise(now);
+	Wait();
+	nextWindow = now + NetworkTime;
+	kernel->interrupt->Schedule(this, NetworkTime, NetworkRecvInt);
+
+	ListIterator<SyncFrame *> iter(arrived);
+	for (; !iter.IsDone() && iter.Item()->when < nextWindow; iter.Next())
+	    if (iter.Item()->when >= lastWindow && iter.Item()->when > now)
+		kernel->interrupt->Schedule(this, iter.Item()->when - now,
+						NetworkRecvInt);
+    }
+    Deliver();
 }
@@ -6,6 +6,17 @@
 //	You may note that the interface to the network is similar to 
 //	the console device -- both are full duplex channels.
 //
+//	Normally each machine is a separate Nachos process, and packets
+//	go between them through UNIX sockets.  With "-wire", machines
+//	are instead network devices in the same process, each with its
+//	own address, and packets go between them in memory, timed by the
+//	one interrupt simulation: no system calls, and the same result
+//	every run.
+//
+//	With "-sync n", machines 0 to n-1 are separate processes, but
+//	run in lockstep (see NetworkSync below): each still on its own
+//	host CPU, and still with the same result every run.
+//
 //  DO NOT CHANGE -- part of the machine emulation
 //
 // Copyright (c) 1992-1996 The Regents of the University of California.
@@ -18,6 +29,8 @@
 #include "copyright.h"
 #include "utility.h"
 #include "callback.h"
+#include "ring.h"
+#include "list.h"
 
 // Network address -- uniquely identifies a machine.  This machine's ID 
 //  is given on the command line.
@@ -42,6 +55,100 @@ class PacketHeader {
 #define MaxPacketSize 	(MaxWireSize - sizeof(struct PacketHeader))	
 				// data "payload" of the largest packet
 
+// Packets that can be queued for sending, and how many must have gone
+// out (unless the queue empties first) before the sender is told
+
+const int TransmitQueueSize = 16;
+const int TransmitBatch = TransmitQueueSize / 2;
+
+// A packet waiting in the transmit queue, or on the in-memory wire
+
+class TransmitDescriptor {
+  public:
+    PacketHeader hdr;		// where it is going
+    char data[MaxPacketSize];	// a copy of the data
+    bool lost;			// is it to be dropped?
+};
+
+// Machines that can be on the in-memory wire, and packets each can
+// have arrived but not yet taken (more are dropped, as a full socket
+// would)
+
+const int MaxWireHosts = 16;
+const int WireBacklog = 16;
+
+// Machines that can run in lockstep
+
+const int MaxSyncHosts = 16;
+
+// A packet as it goes between machines running in lockstep: stamped
+// with when it is to arrive.  A frame with no data is a promise
+// instead -- a "null message" -- that the sender will send nothing
+// more that is to arrive before "when".
+
+class SyncFrame {
+  public:
+    int when;			// when it arrives; for a promise, when
+				// the sender has got to
+    PacketHeader hdr;		// where it is going, and from
+    char data[MaxPacketSize];	// a copy of the data
+};
+
+class NetworkInput;
+
+// The following class keeps one machine in lockstep with the others:
+// conservative parallel simulation, with the time to send a packet,
+// NetworkTime, as the lookahead.
+//
+// Nothing sent reaches another machine in less than NetworkTime, so
+// each machine can run NetworkTime ticks at a time without hearing
+// from the others.  At the end of each such window it promises every
+// other machine that it has sent all it is going to send so far, and
+// waits on the host until they have each promised it the same.  By
+// then it holds every packet due in the next window, and hands each
+// one over at the tick it is due, in a fixed order.  So the machines
+// run in parallel, but what each sees depends only on the simulation,
+// not on how fast the host runs them.
+//
+// A machine that halts promises never to send again.
+
+class NetworkSync : public CallBackObj {
+  public:
+    NetworkSync(NetworkInput *input, NetworkAddress address, int sock,
+		int numHosts);
+				// keep "address" in lockstep with the
+				// other "numHosts" - 1 machines, and pass
+				// packets for it to "input"
+    ~NetworkSync();		// promise the others to send no more
+
+    void Send(PacketHeader hdr, char *data);
+				// send a packet, to arrive NetworkTime
+				// ticks from now
+
+    void CallBack();		// the end of a window, or a packet
+				// is due
+
+    static NetworkSync *Of(NetworkAddress address);
+				// the machine's lockstep, or NULL
+
+  private:
+    void Promise(int when);	// tell the others we have got to "when"
+    void Wait();		// until they've all got to now
+    void Deliver();		// pass on the packets now due
+    void Send(NetworkAddress to, SyncFrame *frame);
+				// put a frame on the socket
+
+    NetworkInput *input;	// who packets for us go to
+    NetworkAddress address;	// who we are
+    int sock;			// our socket, bound to our address
+    int numHosts;		// machines in lockstep
+    int heard[MaxSyncHosts];	// the time each machine has promised
+				// to have sent everything before
+    int nextWindow;		// when the current window ends
+    SortedList<SyncFrame *> *arrived;
+				// packets received, in the order they
+				// are to be handed over
+};
 
 // The following two classes defines a physical network device.  The network
 // is capable of delivering fixed sized packets, in order but unreliably, 
@@ -55,8 +162,10 @@ class PacketHeader {
 
 class NetworkInput : public CallBackObj{
   public:
-    NetworkInput(CallBackObj *toCall);
-				// Allocate and initialize network input driver
+    NetworkInput(CallBackObj *toCall, NetworkAddress address = -1);
+				// Allocate and initialize network input
+				// driver, for "address" (-1 means this
+				// machine's host id)
     ~NetworkInput();		// De-allocate the network input driver data
     
     PacketHeader Receive(char* data);
@@ -68,7 +177,27 @@ class NetworkInput : public CallBackObj{
 
     void CallBack();		// A packet may have arrived.
 
+    void Arrive(TransmitDescriptor *packet);
+				// A packet has come over the in-memory
+				// wire.
+
+    static NetworkInput *OnWire(NetworkAddress address);
+				// the machine on the in-memory wire,
+				// or NULL
+
   private:
+    void Listen();		// be called back when the next packet
+				// may have arrived
+
+    NetworkAddress address;	// who we receive for
+    bool onWire;		// on the in-memory wire, not a socket?
+    NetworkSync *sync;		// our lockstep with the other machines,
+				// or NULL
+    Ring<TransmitDescriptor, WireBacklog> wireIn;
+				// packets from the wire (or from the
+				// lockstep), not yet taken
+    bool callPending;		// is a CallBack scheduled for them?
+
     int sock;                   // UNIX socket number for incoming packets
     char sockName[32];          // File name corresponding to UNIX socket
 
@@ -82,29 +211,45 @@ class NetworkInput : public CallBackObj{
 
 class NetworkOutput : public CallBackObj {
   public:
-    NetworkOutput(double reliability, CallBackObj *toCall);
-				// Allocate and initialize network output driver
+    NetworkOutput(double reliability, CallBackObj *toCall,
+			NetworkAddress address = -1);
+				// Allocate and initialize network output
+				// driver, sending from "address" (-1
+				// means this machine's host id)
     ~NetworkOutput();		// De-allocate the network input driver data
     
-    void Send(PacketHeader hdr, char* data);
-    				// Send the packet data to a remote machine,
-				// specified by "hdr".  Returns immediately.
-    				// "callWhenDone" is invoked once the next 
-				// packet can be sent.  Note that callWhenDone 
-				// is called whether or not the packet is 
-				// dropped, and note that the "from" field of 
-				// the PacketHeader is filled in automatically 
-				// by Send().
+    bool Send(PacketHeader hdr, char* data);
+    				// Queue the packet data to be sent to a
+				// remote machine, specified by "hdr".
+				// Returns immediately; FALSE, without
+				// queueing it, if the queue is full.
+    				// "callWhenDone" is invoked once a batch
+				// of packets has gone, or the queue has
+				// emptied.  Note that packets count as
+				// gone whether or not they are dropped.
+    bool IsFull() { return queue.IsFull(); }
+    bool IsEmpty() { return queue.IsEmpty(); }
+				// is nothing queued or on the wire?
 
     void CallBack();		// Interrupt handler, called when message is 
 				// sent
 
   private:
+    NetworkAddress address;	// who we send from
+    bool onWire;		// on the in-memory wire, not a socket?
+    NetworkSync *sync;		// the lockstep packets go through, or NULL
     int sock;                   // UNIX socket number for outgoing packets
     double chanceToWork;	// Likelihood packet will be dropped
     CallBackObj *callWhenDone;  // Interrupt handler, signalling next packet 
 				//      can be sent.  
-    bool sendBusy;		// Packet is being sent.
+    void StartSend();		// put the packet at the head of the
+				// queue on the wire
+
+    Ring<TransmitDescriptor, TransmitQueueSize> queue;
+				// packets to send; the head one is on
+				// the wire
+    int numDone;		// packets sent since callWhenDone was
+				// last called
 };
 
 #endif // NETWORK_H
@@ -0,0 +1,158 @@
+// replay.cc
+//	Routines to record the nondeterministic inputs of a simulation
+//	to a log, and to feed them back from it.
+//
+// Copyright (c) 1992-1996 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "replay.h"
+#include "main.h"
+#include "memops.h"
+#include <stdio.h>
+
+static char *inputNames[NumReplayInputs] = { "random", "console", "packet" };
+
+//----------------------------------------------------------------------
+// Replay::Replay
+// 	Start recording inputs to "fileName", replacing any old log; or
+//	read the whole of the log in "fileName", to replay it.
+//----------------------------------------------------------------------
+
+Replay::Replay(char *fileName, ReplayMode mode)
+{
+    this->mode = mode;
+    out = NULL;
+
+    if (mode == ReplayRecord) {
+	out = new ofstream(fileName);
+	return;
+    }
+
+    ifstream in(fileName);
+    char name[20];
+
+    if (!in) {
+	cerr << "Can't open replay log " << fileName << "\n";
+	Abort();
+    }
+    while (in >> name) {
+	ReplayEntry *e;
+	int k;
+
+	for (k = 0; k < NumReplayInputs; k++)
+	    if (strcmp(name, inputNames[k]) == 0)
+		break;
+	ASSERT(k < NumReplayInputs);
+	e = inputs[k].Tail();		// filled in where it is queued
+	e->tick = 0;
+	e->value = 0;
+	e->length = 0;
+	e->data = NULL;
+	if (k == ReplayRandom) {
+	    in >> e->value;
+	} else {
+	    in >> e->tick >> e->length;
+	    e->data = new char[e->length + 1];
+	    for (int i = 0; i < e->length; i++) {
+		unsigned int byte;
+		char hex[3];
+
+		in >> hex[0] >> hex[1];
+		hex[2] = '\0';
+		sscanf(hex, "%x", &byte);
+		e->data[i] = (char) byte;
+	    }
+	}
+	inputs[k].Push();
+    }
+}
+
+//----------------------------------------------------------------------
+// Replay::~Replay
+// 	Close the log, or throw away what was not replayed.
+//----------------------------------------------------------------------
+
+Replay::~Replay()
+{
+    delete out;
+    for (int k = 0; k < NumReplayInputs; k++)
+	for (; !inputs[k].IsEmpty(); inputs[k].Pop())
+	    delete [] inputs[k].Head()->data;
+}
+
+//----------------------------------------------------------------------
+// Replay::Random
+// 	Return a random number: the next one from the host, noted in the
+//	log, or the next one in the log.  Running out of them when
+//	replaying is an error: the build being replayed draws more.
+//----------------------------------------------------------------------
+
+unsigned int
+Replay::Random()
+{
+    unsigned int value;
+
+    if (mode == ReplayRecord) {
+	value = RandomNumber();
+	*out << inputNames[ReplayRandom] << " " << value << "\n";
+	return value;
+    }
+    if (inputs[ReplayRandom].IsEmpty()) {
+	cerr << "Replay log has no more random numbers, at tick "
+	     << kernel->stats->totalTicks << "\n";
+	Abort();
+    }
+    value = inputs[ReplayRandom].Head()->value;
+    inputs[ReplayRandom].Pop();
+    return value;
+}
+
+//----------------------------------------------------------------------
+// Replay::Ready
+// 	Return TRUE if the next recorded input of "kind" arrived at or
+//	before the current tick.
+//----------------------------------------------------------------------
+
+bool
+Replay::Ready(ReplayInput kind)
+{
+    ASSERT(mode == ReplayPlay);
+    return !inputs[kind].IsEmpty()
+		&& inputs[kind].Head()->tick <= kernel->stats->totalTicks;
+}
+
+//----------------------------------------------------------------------
+// Replay::Input
+// 	When recording, write the "length" bytes just read from the host
+//	into "buffer" to the log, with the tick.  When replaying, copy the
+//	next recorded input of "kind" into "buffer" in their place (it
+//	must be Ready), and return its length.
+//----------------------------------------------------------------------
+
+int
+Replay::Input(ReplayInput kind, char *buffer, int length)
+{
+    char hex[3];
+
+    if (mode == ReplayRecord) {
+	*out << inputNames[kind] << " " << kernel->stats->totalTicks << " "
+	     << length << " ";
+	for (int i = 0; i < length; i++) {
+	    sprintf(hex, "%02x", (unsigned char) buffer[i]);
+	    *out << hex;
+	}
+	*out << "\n";
+	return length;
+    }
+
+    ASSERT(Ready(kind));
+    ReplayEntry *e = inputs[kind].Head();
+
+    length = e->length;
+    MemCopy(buffer, e->data, length);
+    delete [] e->data;
+    inputs[kind].Pop();
+    return length;
+}
@@ -0,0 +1,88 @@
+// replay.h
+//	Data structures for recording the inputs that make a simulation
+//	nondeterministic, and replaying them, so that two runs (of two
+//	builds, say) see exactly the same inputs.
+//
+//	The inputs are the random numbers drawn (for random time slices
+//	and for dropping packets), the characters read from the console,
+//	and the packets read from the network socket, each with the tick
+//	it arrived at.
+//
+//	When recording, each input is taken from the host as usual and
+//	written to the log.  When replaying, the host is never asked:
+//	random numbers come from the log in the order they were drawn,
+//	and console input and packets arrive when the simulated clock
+//	reaches the tick they arrived at when recorded -- so they are fed
+//	at the same simulated times even if the build being replayed runs
+//	differently.
+//
+//	The log is text, one input per line:
+//
+//	    random <value>
+//	    console <tick> <length> <bytes, in hex>
+//	    packet <tick> <length> <bytes, in hex>
+//
+//	Host input is polled (as with "-input poll"); the waiting mode
+//	can't be recorded, as when its input arrives depends on the host.
+//
+// Copyright (c) 1992-1996 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include "copyright.h"
+#include "utility.h"
+#include "queue.h"
+#include <fstream>
+
+// Whether inputs are being recorded or replayed
+
+enum ReplayMode { ReplayRecord, ReplayPlay };
+
+// The kinds of input
+
+enum ReplayInput { ReplayRandom, ReplayConsole, ReplayPacket,
+			NumReplayInputs };
+
+// One recorded input
+
+class ReplayEntry {
+  public:
+    int tick;			// when it arrived
+    unsigned int value;		// a random number
+    int length;			// or the bytes of console input or
+    char *data;			// a packet
+};
+
+// The following class records or replays the inputs.
+
+class Replay {
+  public:
+    Replay(char *fileName, ReplayMode mode);
+				// start recording to, or replaying from,
+				// "fileName"
+    ~Replay();			// finish the log
+
+    bool Playing() { return mode == ReplayPlay; }
+
+    unsigned int Random();	// Draw a random number
+    bool Ready(ReplayInput kind);
+				// When replaying: has the next input of
+				// "kind" arrived yet?
+    int Input(ReplayInput kind, char *buffer, int length);
+				// When recording, note the "length" bytes
+				// just read into "buffer"; when
+				// replaying, copy the next input into
+				// "buffer" instead, and return its length
+
+  private:
+    ReplayMode mode;
+    ofstream *out;		// the log, when recording
+    Queue<ReplayEntry> inputs[NumReplayInputs];
+				// when replaying, the inputs of each kind
+				// not yet used, in order
+};
+
+#endif // REPLAY_H
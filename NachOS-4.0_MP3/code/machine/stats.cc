@@ -10,6 +10,12 @@
 #include "copyright.h"
 #include "debug.h"
 #include "stats.h"
+#include "main.h"
+#include "perfcount.h"
+#include "hostprof.h"
+#include "memtrack.h"
+#include "netlink.h"
+#include <fstream>
 
 //----------------------------------------------------------------------
 // Statistics::Statistics
@@ -22,6 +28,194 @@ Statistics::Statistics()
     numDiskReads = numDiskWrites = 0;
     numConsoleCharsRead = numConsoleCharsWritten = 0;
     numPageFaults = numPacketsSent = numPacketsRecvd = 0;
+    numCPUs = 1;
+    numContextSwitches = numUserStateCopies = 0;
+    numPageTableLoads = numStallTicks = 0;
+    numRealTimeJobs = numDeadlineMisses = numRealTimeRefused = 0;
+    strideFairness = 0.0;
+    numFairnessWindows = 0;
+    numBursts = burstError = 0;
+    for (int b = 0; b < NumLatencyBuckets; b++)
+	latency[b] = 0;
+    threadFile = latencyFile = NULL;
+    printPerf = printHostProfile = FALSE;
+    for (int i = 0; i < MaxCPUs; i++)
+	busyTicks[i] = 0;
+
+    numCounters = 0;
+    snapFile = NULL;
+    snapInterval = 0;
+    nextSnapshot = 0;
+    snapFormat = SnapshotJSON;
+    snapStarted = FALSE;
+    AddCounter("total_ticks", &totalTicks);
+    AddCounter("idle_ticks", &idleTicks);
+    AddCounter("system_ticks", &systemTicks);
+    AddCounter("user_ticks", &userTicks);
+    AddCounter("disk_reads", &numDiskReads);
+    AddCounter("disk_writes", &numDiskWrites);
+    AddCounter("console_reads", &numConsoleCharsRead);
+    AddCounter("console_writes", &numConsoleCharsWritten);
+    AddCounter("page_faults", &numPageFaults);
+    AddCounter("packets_sent", &numPacketsSent);
+    AddCounter("packets_received", &numPacketsRecvd);
+    AddCounter("context_switches", &numContextSwitches);
+}
+
+//----------------------------------------------------------------------
+// Statistics::AddCounter
+// 	Include a counter in every snapshot from now on.  With CSV, the
+//	columns are those of the counters added before the first
+//	snapshot; subsystems add theirs when they are initialized.
+//
+//	"name" is the counter's key; it is not copied
+//	"value" is where the subsystem keeps the count, or
+//	"func" is called with "arg" to work the count out
+//----------------------------------------------------------------------
+
+void
+Statistics::AddCounter(char *name, int *value)
+{
+    ASSERT(numCounters < MaxCounters);
+    counters[numCounters].name = name;
+    counters[numCounters].value = value;
+    counters[numCounters].func = NULL;
+    counters[numCounters].arg = NULL;
+    numCounters++;
+}
+
+void
+Statistics::AddCounter(char *name, CounterFunc func, void *arg)
+{
+    ASSERT(numCounters < MaxCounters);
+    counters[numCounters].name = name;
+    counters[numCounters].value = NULL;
+    counters[numCounters].func = func;
+    counters[numCounters].arg = arg;
+    numCounters++;
+}
+
+//----------------------------------------------------------------------
+// Statistics::StartSnapshots
+// 	Arrange for the counters to be written to "fileName" every
+//	"interval" ticks, and once more at shutdown.  Any old file is
+//	replaced.
+//----------------------------------------------------------------------
+
+void
+Statistics::StartSnapshots(char *fileName, int interval,
+			   SnapshotFormat format)
+{
+    ASSERT(interval > 0);
+    snapFile = fileName;
+    snapInterval = interval;
+    nextSnapshot = interval;
+    snapFormat = format;
+    snapStarted = FALSE;
+}
+
+//----------------------------------------------------------------------
+// Statistics::Snapshot
+// 	Append the value of every counter, at the current tick, to the
+//	snapshot file.  If the clock jumped past several intervals while
+//	the machine was idle, there is just the one snapshot for them.
+//----------------------------------------------------------------------
+
+void
+Statistics::Snapshot()
+{
+    ofstream out(snapFile, snapStarted ? ios::app : ios::trunc);
+    int i;
+
+    if (!snapStarted && snapFormat == SnapshotCSV) {
+	out << "tick";
+	for (i = 0; i < numCounters; i++)
+	    out << "," << counters[i].name;
+	out << "\n";
+    }
+    snapStarted = TRUE;
+
+    if (snapFormat == SnapshotJSON)
+	out << "{\"tick\": " << totalTicks;
+    else
+	out << totalTicks;
+    for (i = 0; i < numCounters; i++) {
+	StatCounter *c = &counters[i];
+	int value = (c->value != NULL) ? *c->value : (*c->func)(c->arg);
+
+	if (snapFormat == SnapshotJSON)
+	    out << ", \"" << c->name << "\": " << value;
+	else
+	    out << "," << value;
+    }
+    out << ((snapFormat == SnapshotJSON) ? "}\n" : "\n");
+    nextSnapshot = (totalTicks / snapInterval + 1) * snapInterval;
+}
+
+//----------------------------------------------------------------------
+// Statistics::RecordLatency
+// 	Count a dispatch that came "ticks" after the thread was made
+//	ready, in the bucket for its power of two.
+//----------------------------------------------------------------------
+
+void
+Statistics::RecordLatency(int ticks)
+{
+    int b = 0;
+
+    while (ticks > 0 && b < NumLatencyBuckets - 1) {
+	ticks >>= 1;
+	b++;
+    }
+    latency[b]++;
+}
+
+//----------------------------------------------------------------------
+// Statistics::StartCSV
+// 	Arrange for each thread's figures to be written, as it finishes,
+//	to "<prefix>.threads.csv", and the latency histogram to
+//	"<prefix>.latency.csv" at shutdown.  Any old files are replaced.
+//----------------------------------------------------------------------
+
+void
+Statistics::StartCSV(char *prefix)
+{
+    int levels = kernel->schedPolicy->NumLevels();
+
+    threadFile = new char[strlen(prefix) + 20];
+    sprintf(threadFile, "%s.threads.csv", prefix);
+    latencyFile = new char[strlen(prefix) + 20];
+    sprintf(latencyFile, "%s.latency.csv", prefix);
+
+    ofstream out(threadFile);
+    out << "id,name,ticks run,ticks waiting,preemptions";
+    for (int l = 0; l < levels; l++)
+	out << ",L" << l + 1 << " ticks";
+    out << "\n";
+}
+
+//----------------------------------------------------------------------
+// Statistics::ThreadDone
+// 	Append a finished thread's figures to the per-thread CSV file,
+//	if there is one.
+//----------------------------------------------------------------------
+
+void
+Statistics::ThreadDone(Thread *t)
+{
+    int levels = kernel->schedPolicy->NumLevels();
+
+    DEBUG(dbgThread, "Thread " << t->getName() << " ran " << t->ticksRun
+		<< " ticks, waited " << t->waitTicks << ", preempted "
+		<< t->numPreemptions << " times");
+    if (threadFile == NULL)
+	return;
+    ofstream out(threadFile, ios::app);
+    out << t->getID() << "," << t->getName() << "," << t->ticksRun << ","
+	<< t->waitTicks << "," << t->numPreemptions;
+    for (int l = 0; l < levels; l++)
+	out << "," << t->levelTicks[l];
+    out << "\n";
 }
 
 //----------------------------------------------------------------------
@@ -33,6 +227,8 @@ Statistics::Statistics()
 void
 Statistics::Print()
 {
+    if (snapInterval > 0)
+	Snapshot();			// the last one
     cout << "Ticks: total " << totalTicks << ", idle " << idleTicks;
 		cout << ", system " << systemTicks << ", user " << userTicks <<"\n";
     cout << "Disk I/O: reads " << numDiskReads;
@@ -42,4 +238,66 @@ Statistics::Print()
     cout << "Paging: faults " << numPageFaults << "\n";
     cout << "Network I/O: packets received " << numPacketsRecvd;
 		cout << ", sent " << numPacketsSent << "\n";
+    cout << "Context switches: " << numContextSwitches
+	 << ", user register copies " << numUserStateCopies << "\n";
+    cout << "Dispatch latency (ticks):";
+    for (int b = 0; b < NumLatencyBuckets; b++) {
+	if (latency[b] == 0)
+	    continue;
+	if (b == 0)
+	    cout << " 0:";
+	else if (b == NumLatencyBuckets - 1)
+	    cout << " " << (1 << (b - 1)) << "+:";
+	else
+	    cout << " " << (1 << (b - 1)) << "-" << (1 << b) - 1 << ":";
+	cout << latency[b];
+    }
+    cout << "\n";
+    if (latencyFile != NULL) {
+	ofstream out(latencyFile);
+	out << "low,high,count\n";
+	for (int b = 0; b < NumLatencyBuckets; b++) {
+	    out << (b == 0 ? 0 : 1 << (b - 1)) << ",";
+	    if (b < NumLatencyBuckets - 1)
+		out << (b == 0 ? 0 : (1 << b) - 1);
+	    out << "," << latency[b] << "\n";
+	}
+    }
+    if (numStallTicks > 0) {
+	cout << "Cache affinity: page table loads " << numPageTableLoads
+	     << ", stall ticks " << numStallTicks << "\n";
+    }
+    if (numRealTimeJobs > 0 || numDeadlineMisses > 0
+		|| numRealTimeRefused > 0) {
+	cout << "Real-time: jobs " << numRealTimeJobs << ", deadline misses "
+	     << numDeadlineMisses << ", refused " << numRealTimeRefused << "\n";
+    }
+    if (numFairnessWindows > 0) {
+	cout << "Stride fairness: mean Jain index "
+	     << strideFairness / numFairnessWindows << " over "
+	     << numFairnessWindows << " windows\n";
+    }
+    if (numBursts > 0) {
+	cout << "Burst prediction: " << numBursts << " bursts, mean error "
+	     << (double) burstError / numBursts << " ticks\n";
+    }
+    if (kernel->workload != NULL)
+	kernel->workload->Print();
+    if (kernel->links != NULL)
+	kernel->links->Print();
+    if (numCPUs > 1) {
+	for (int i = 0; i < numCPUs; i++) {
+	    cout << "CPU " << i << ": busy " << busyTicks[i] << " ticks";
+	    if (totalTicks > 0)
+		cout << ", utilization "
+		     << (100.0 * busyTicks[i]) / totalTicks << "%";
+	    cout << "\n";
+	}
+    }
+    if (printPerf) {
+	PerfPrint();
+	MemPrint();
+    }
+    if (printHostProfile)
+	HostProfPrint();
 }
@@ -13,6 +13,40 @@
 
 #include "copyright.h"
 
+// Most CPUs that can be simulated; see Scheduler
+const int MaxCPUs = 8;
+
+// Dispatch latencies are counted in buckets of powers of two: bucket 0
+// is 0 ticks, bucket b is 2^(b-1) to 2^b - 1 ticks, and the last bucket
+// holds everything longer.
+const int NumLatencyBuckets = 24;
+
+class Thread;
+
+// Counters written in each snapshot.  Besides its own, Statistics
+// takes counters from any subsystem, with AddCounter: either an int
+// the subsystem keeps up to date, or a function that works the value
+// out when a snapshot is taken (such as the length of a queue).
+
+typedef int (*CounterFunc)(void *arg);
+
+class StatCounter {
+  public:
+    char *name;			// its key, or column, in the snapshots
+    int *value;			// where the count is kept, or NULL
+    CounterFunc func;		// if value is NULL, func(arg) is the count
+    void *arg;
+};
+
+const int MaxCounters = 64;
+
+// How snapshots are written
+
+enum SnapshotFormat {
+    SnapshotJSON,		// one JSON object per line
+    SnapshotCSV			// a header line of names, then a row each
+};
+
 // The following class defines the statistics that are to be kept
 // about Nachos behavior -- how much time (ticks) elapsed, how
 // many user instructions executed, etc.
@@ -21,8 +55,10 @@
 
 class Statistics {
   public:
+    int numCPUs;		// number of simulated CPUs
     int totalTicks;      	// Total time running Nachos
-    int idleTicks;       	// Time spent idle (no threads to run)
+    int idleTicks;       	// Time spent idle (no threads to run
+				// on any CPU)
     int systemTicks;	 	// Time spent executing system code
     int userTicks;       	// Time spent executing user code
 				// (this is also equal to # of
@@ -35,10 +71,62 @@ class Statistics {
     int numPageFaults;		// number of virtual memory page faults
     int numPacketsSent;		// number of packets sent over the network
     int numPacketsRecvd;	// number of packets received over the network
+    int busyTicks[MaxCPUs];	// time each CPU spent running a thread
+    int numContextSwitches;	// calls to Scheduler::Run
+    int numUserStateCopies;	// times the user registers in the
+				// machine had to be replaced
+    int numPageTableLoads;	// switches to another address space on
+				// a CPU (cache affinity model)
+    int numStallTicks;		// CPU turns spent refilling its cache
+				// after a switch (cache affinity model)
+    int numRealTimeJobs;	// jobs real-time threads have finished
+    int numDeadlineMisses;	// of those and the unfinished ones,
+				// how many were late
+    int numRealTimeRefused;	// threads not admitted as real-time
+    double strideFairness;	// sum of the fairness index of each
+    int numFairnessWindows;	// window at the stride levels
+    int numBursts;		// CPU bursts whose length was predicted
+    int burstError;		// sum of |burst - prediction| over them
+    int latency[NumLatencyBuckets];	// how long threads waited on the
+				// ready queues before being dispatched
+    bool printPerf;		// print the perf counters and memory
+				// too (-stats)
+    bool printHostProfile;	// and the host profile (-hostprof)
 
     Statistics(); 		// initialize everything to zero
 
+    void RecordLatency(int ticks);	// a thread waited "ticks" to run
+    void StartCSV(char *prefix);	// also write the per-thread and
+				// latency figures to CSV files
+    void ThreadDone(Thread *thread);	// a thread has finished; write
+				// its figures, if there is a CSV file
     void Print();		// print collected statistics
+
+    void AddCounter(char *name, int *value);
+    void AddCounter(char *name, CounterFunc func, void *arg);
+				// include a counter in the snapshots
+    void StartSnapshots(char *fileName, int interval,
+			SnapshotFormat format);
+				// write the counters to "fileName"
+				// every "interval" ticks
+    void CheckSnapshot() {	// called as the clock advances
+	if (snapInterval > 0 && totalTicks >= nextSnapshot)
+	    Snapshot();
+    }
+
+  private:
+    void Snapshot();		// write the counters to the snapshot file
+
+    char *threadFile;		// per-thread CSV file, or NULL
+    char *latencyFile;		// latency CSV file, or NULL
+
+    StatCounter counters[MaxCounters];
+    int numCounters;
+    char *snapFile;		// snapshot file, or NULL
+    int snapInterval;		// ticks between snapshots, or 0 for none
+    int nextSnapshot;		// when the next one is due
+    SnapshotFormat snapFormat;
+    bool snapStarted;		// has the file been started yet?
 };
 
 // Constants used to reflect the relative time an operation would
@@ -33,13 +33,19 @@
 //      "doRandom" -- if true, arrange for the interrupts to occur
 //		at random, instead of fixed, intervals.
 //      "toCall" is the interrupt handler to call when the timer expires.
+//	"once" -- if true, don't interrupt periodically, only when
+//		SetNext asks for it; the first interrupt still comes
+//		after a time slice
 //----------------------------------------------------------------------
 
-Timer::Timer(bool doRandom, CallBackObj *toCall)
+Timer::Timer(bool doRandom, CallBackObj *toCall, bool once)
 {
     randomize = doRandom;
+    oneShot = once;
     callPeriodically = toCall;
     disable = FALSE;
+    suspended = FALSE;
+    due = -1;
     SetInterrupt();
 }
 
@@ -48,17 +54,79 @@ Timer::Timer(bool doRandom, CallBackObj *toCall)
 //      Routine called when interrupt is generated by the hardware 
 //	timer device.  Schedule the next interrupt, and invoke the
 //	interrupt handler.
+//
+//	An interrupt that Resume has replaced with an earlier one is
+//	ignored.
 //----------------------------------------------------------------------
 void 
 Timer::CallBack() 
 {
+    if (due == -1 || kernel->stats->totalTicks < due)
+	return;			// superseded
+    due = -1;
+    suspended = FALSE;
+
     // invoke the Nachos interrupt handler for this device
     callPeriodically->CallBack();
     
-    SetInterrupt();	// do last, to let software interrupt handler
+    if (due == -1 && !oneShot)	// unless the handler has already
+	SetInterrupt();		// resumed us, or sets the next itself	// do last, to let software interrupt handler
     			// decide if it wants to disable future interrupts
 }
 
+//----------------------------------------------------------------------
+// Timer::Suspend
+//      Delay the next interrupt.  Called from the interrupt handler,
+//	so it applies to the one that SetInterrupt schedules when the
+//	handler returns; after that, interrupts come every time slice
+//	again.
+//
+//	"ticks" -- how long until the next interrupt; 0 means there
+//		won't be one until Resume is called
+//----------------------------------------------------------------------
+
+void
+Timer::Suspend(int ticks)
+{
+    suspended = TRUE;
+    wakeAfter = ticks;
+}
+
+//----------------------------------------------------------------------
+// Timer::Resume
+//      Go back to interrupting every time slice, if a Suspend has left
+//	the next interrupt more than a time slice away (or not scheduled
+//	at all).
+//----------------------------------------------------------------------
+
+void
+Timer::Resume()
+{
+    suspended = FALSE;
+    if (!disable && (due == -1 || due > kernel->stats->totalTicks + TimerTicks))
+	Arm(TimerTicks);
+}
+
+//----------------------------------------------------------------------
+// Timer::SetNext
+//      For a one-shot timer: make the next interrupt come "ticks" from
+//	now, and ignore any other that has been scheduled.
+//
+//	"ticks" -- how long until the next interrupt; 0 means there
+//		won't be one until SetNext is called again
+//----------------------------------------------------------------------
+
+void
+Timer::SetNext(int ticks)
+{
+    if (disable)
+	return;
+    if (ticks == 0)
+	due = -1;		// the one scheduled is ignored
+    else if (due != kernel->stats->totalTicks + ticks)
+	Arm(ticks);
+}
+
 //----------------------------------------------------------------------
 // Timer::SetInterrupt
 //      Cause a timer interrupt to occur in the future, unless
@@ -72,10 +140,27 @@ Timer::SetInterrupt()
     if (!disable) {
        int delay = TimerTicks;
     
+       if (suspended) {
+	     if (wakeAfter > 0)
+		 Arm(wakeAfter);
+	     return;
+       }
        if (randomize) {
-	     delay = 1 + (RandomNumber() % (TimerTicks * 2));
+	     delay = 1 + (kernel->Random() % (TimerTicks * 2));
         }
-       // schedule the next timer device interrupt
-       kernel->interrupt->Schedule(this, delay, TimerInt);
+       Arm(delay);
     }
 }
+
+//----------------------------------------------------------------------
+// Timer::Arm
+//      Schedule the next timer device interrupt, replacing any that
+//	is already scheduled.
+//----------------------------------------------------------------------
+
+void
+Timer::Arm(int delay)
+{
+    due = kernel->stats->totalTicks + delay;
+    kernel->interrupt->Schedule(this, delay, TimerInt);
+}
@@ -11,6 +11,14 @@
 //	In order to introduce some randomness into time-slicing, if "doRandom"
 //	is set, then the interrupt comes after a random number of ticks.
 //
+//	A tickless kernel can ask for the next interrupt to come later,
+//	or not at all, while it has nothing to time-slice.  Since a
+//	scheduled interrupt can't be taken back, one that is superseded
+//	by Resume is ignored when it goes off.
+//
+//	A one-shot timer doesn't interrupt periodically at all: it
+//	interrupts once, when SetNext last asked it to.
+//
 //  DO NOT CHANGE -- part of the machine emulation
 //
 // Copyright (c) 1992-1996 The Regents of the University of California.
@@ -27,20 +35,34 @@
 // The following class defines a hardware timer. 
 class Timer : public CallBackObj {
   public:
-    Timer(bool doRandom, CallBackObj *toCall);
+    Timer(bool doRandom, CallBackObj *toCall, bool oneShot = FALSE);
 				// Initialize the timer, and callback to "toCall"
-				// every time slice.
+				// every time slice, or if "oneShot",
+				// when SetNext says.
     virtual ~Timer() {}
     
     void Disable() { disable = TRUE; }
     				// Turn timer device off, so it doesn't
 				// generate any more interrupts.
+    void Suspend(int ticks);	// Called from the interrupt handler:
+				// make the next interrupt come after
+				// "ticks", or never if ticks is 0
+    void Resume();		// Interrupt every time slice again,
+				// starting within one time slice
+    void SetNext(int ticks);	// One-shot: the next interrupt is to
+				// come after "ticks", replacing any
+				// other, or never if ticks is 0
 
   private:
     bool randomize;		// set if we need to use a random timeout delay
+    bool oneShot;		// interrupt only when SetNext says?
     CallBackObj *callPeriodically; // call this every TimerTicks time units 
     bool disable;		// turn off the timer device after next
     				// interrupt.
+    bool suspended;		// is the next interrupt delayed?
+    int wakeAfter;		// if so, by how much (0 means never)
+    int due;			// when the interrupt we are waiting
+				// for is scheduled, or -1 if none
     
     void CallBack();		// called internally when the hardware
 				// timer generates an interrupt
@@ -48,6 +70,7 @@ class Timer : public CallBackObj {
     void SetInterrupt();  	// cause an interrupt to occur in the
     				// the future after a fixed or random
 				// delay
+    void Arm(int delay);	// schedule the interrupt "delay" from now
 };
 
 #endif // TIMER_H
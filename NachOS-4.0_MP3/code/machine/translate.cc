@@ -31,6 +31,12 @@
 
 #include "copyright.h"
 #include "main.h"
+#include "perfcount.h"
+#include "hostprof.h"
+
+static PerfCounter perfTranslations("translate", "translations");
+static PerfCounter perfFaults("translate", "page_faults");
+					// pages (or TLB entries) not valid
 
 // Routines for converting Words and Short Words to and from the
 // simulated machine's format of little endian.  These end up
@@ -86,8 +92,11 @@ bool
 Machine::ReadMem(int addr, int size, int *value)
 {
     int data;
+    unsigned short half;
+    unsigned int word;
     ExceptionType exception;
     int physicalAddress;
+    HostProfScope scope(ProfTranslate);
     
     DEBUG(dbgAddr, "Reading VA " << addr << ", size " << size);
     
@@ -102,14 +111,16 @@ Machine::ReadMem(int addr, int size, int *value)
 	*value = data;
 	break;
 	
-      case 2:
-	data = *(unsigned short *) &mainMemory[physicalAddress];
-	*value = ShortToHost(data);
+      case 2:			// memory is chars: copy them out, as
+				// reading them through a short pointer
+				// breaks the aliasing rules -O relies on
+	memcpy(&half, &mainMemory[physicalAddress], sizeof(half));
+	*value = ShortToHost(half);
 	break;
 	
       case 4:
-	data = *(unsigned int *) &mainMemory[physicalAddress];
-	*value = WordToHost(data);
+	memcpy(&word, &mainMemory[physicalAddress], sizeof(word));
+	*value = WordToHost(word);
 	break;
 
       default: ASSERT(FALSE);
@@ -137,6 +148,9 @@ Machine::WriteMem(int addr, int size, int value)
 {
     ExceptionType exception;
     int physicalAddress;
+    unsigned short half;
+    unsigned int word;
+    HostProfScope scope(ProfTranslate);
      
     DEBUG(dbgAddr, "Writing VA " << addr << ", size " << size << ", value " << value);
 
@@ -145,19 +159,21 @@ Machine::WriteMem(int addr, int size, int value)
 	RaiseException(exception, addr);
 	return FALSE;
     }
+    if (linked && (physicalAddress & ~0x3) == linkAddr)
+	linked = FALSE;			// an SC on it now fails
     switch (size) {
       case 1:
 	mainMemory[physicalAddress] = (unsigned char) (value & 0xff);
 	break;
 
-      case 2:
-	*(unsigned short *) &mainMemory[physicalAddress]
-		= ShortToMachine((unsigned short) (value & 0xffff));
+      case 2:			// copied, as in ReadMem
+	half = ShortToMachine((unsigned short) (value & 0xffff));
+	memcpy(&mainMemory[physicalAddress], &half, sizeof(half));
 	break;
       
       case 4:
-	*(unsigned int *) &mainMemory[physicalAddress]
-		= WordToMachine((unsigned int) value);
+	word = WordToMachine((unsigned int) value);
+	memcpy(&mainMemory[physicalAddress], &word, sizeof(word));
 	break;
 	
       default: ASSERT(FALSE);
@@ -190,6 +206,7 @@ Machine::Translate(int virtAddr, int* physAddr, int size, bool writing)
     unsigned int pageFrame;
 
     DEBUG(dbgAddr, "\tTranslate " << virtAddr << (writing ? " , write" : " , read"));
+    perfTranslations.Inc();
 
 // check for alignment errors
     if (((size == 4) && (virtAddr & 0x3)) || ((size == 2) && (virtAddr & 0x1))){
@@ -205,12 +222,13 @@ Machine::Translate(int virtAddr, int* physAddr, int size, bool writing)
     vpn = (unsigned) virtAddr / PageSize;
     offset = (unsigned) virtAddr % PageSize;
     
-    if (tlb == NULL) {		// => page table => vpn is index into table
+    if (!HasTLB()) {		// => page table => vpn is index into table
 	if (vpn >= pageTableSize) {
 	    DEBUG(dbgAddr, "Illegal virtual page # " << virtAddr);
 	    return AddressErrorException;
 	} else if (!pageTable[vpn].valid) {
 	    DEBUG(dbgAddr, "Invalid virtual page # " << virtAddr);
+	    perfFaults.Inc();
 	    return PageFaultException;
 	}
 	entry = &pageTable[vpn];
@@ -222,6 +240,7 @@ Machine::Translate(int virtAddr, int* physAddr, int size, bool writing)
 	    }
 	if (entry == NULL) {				// not found
     	    DEBUG(dbgAddr, "Invalid TLB entry for this virtual page!");
+	    perfFaults.Inc();
     	    return PageFaultException;		// really, this is a TLB fault,
 						// the page may be in memory,
 						// but not in the TLB
@@ -0,0 +1,331 @@
+// netbench.cc
+//	Routines to benchmark the post office on the in-memory wire.
+//
+// Copyright (c) 1992-1996 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "netbench.h"
+#include "main.h"
+#include "post.h"
+#include "memops.h"
+#include "sysdep.h"
+
+const int NumPings = 200;		// round trips at each size
+const int NumBulk = 500;		// messages at each size
+const int NumFanInSenders = 8;
+const int FanInMessages = 100;		// from each sender
+const int EndInterval = 4 * NetworkTime;
+					// between end markers, in the
+					// bulk test
+
+const int NumSizes = 4;
+static int sizes[NumSizes] = { 8, 16, 24, MaxMailSize };
+
+// The machines each test uses
+
+enum { PingHost, EchoHost, BulkSender, BulkReceiver, FanInReceiver,
+       FirstFanInSender };
+
+const int NumBenchHosts = FirstFanInSender + NumFanInSenders;
+
+// The head of every benchmark message: the run of a test it belongs
+// to, so that a late one from an earlier run can be told apart, and
+// its number in the run, or EndOfRun.
+
+class BenchHeader {
+  public:
+    int run;
+    int seq;
+};
+
+const int EndOfRun = -1;
+
+static PostOfficeInput *postIn[NumBenchHosts];
+static PostOfficeOutput *postOut[NumBenchHosts];
+static int numRuns = 0;			// runs started, of all the tests
+
+//----------------------------------------------------------------------
+// SendBench
+// 	Send a "size"-byte benchmark message, number "seq" of run "run",
+//	from machine "from" to mailbox "box" of machine "to", with
+//	replies to go to mailbox "replyBox".
+//----------------------------------------------------------------------
+
+static void
+SendBench(int from, int to, int box, int replyBox, int run, int seq, int size)
+{
+    Mail mail;
+    BenchHeader hdr;
+
+    ASSERT(size >= (int) sizeof(BenchHeader) && size <= (int) MaxMailSize);
+    hdr.run = run;
+    hdr.seq = seq;
+    mail.pktHdr.to = to;
+    mail.mailHdr.to = box;
+    mail.mailHdr.from = replyBox;
+    mail.mailHdr.length = size;
+    MemZero(mail.data, size);
+    MemCopy(mail.data, &hdr, sizeof(hdr));
+    postOut[from]->Send(&mail);
+}
+
+//----------------------------------------------------------------------
+// HeaderOf
+// 	Return the BenchHeader at the front of a message.
+//----------------------------------------------------------------------
+
+static BenchHeader
+HeaderOf(Mail *mail)
+{
+    BenchHeader hdr;
+
+    MemCopy(&hdr, mail->data, sizeof(hdr));
+    return hdr;
+}
+
+//----------------------------------------------------------------------
+// Report
+// 	Print the start of a test's line: "messages" were moved in
+//	"ticks" of simulated time and "seconds" of host time.  The
+//	caller adds anything more, and the newline.
+//----------------------------------------------------------------------
+
+static void
+Report(char *test, int size, int messages, int ticks, double seconds)
+{
+    cout << "netbench " << test << size << " messages " << messages
+	 << " ticks " << ticks << " per_sim_sec "
+	 << ((ticks > 0) ? messages * 1000000.0 / ticks : 0.0)
+	 << " per_host_sec " << ((seconds > 0) ? messages / seconds : 0.0);
+}
+
+//----------------------------------------------------------------------
+// Echo
+// 	The ping-pong test's machine 1: send every message that comes to
+//	mailbox 0 back where it came from.  Never returns.
+//----------------------------------------------------------------------
+
+static void
+Echo(void *)
+{
+    for (;;) {
+	Mail *mail = postIn[EchoHost]->Receive(0);
+	BenchHeader hdr = HeaderOf(mail);
+
+	SendBench(EchoHost, mail->pktHdr.from, mail->mailHdr.from, 0,
+		  hdr.run, hdr.seq, mail->mailHdr.length);
+	postIn[EchoHost]->Release(mail);
+    }
+}
+
+//----------------------------------------------------------------------
+// PingPong
+// 	Time NumPings round trips of "size"-byte messages between
+//	machines 0 and 1, one at a time.
+//----------------------------------------------------------------------
+
+static void
+PingPong(int size)
+{
+    int run = ++numRuns;
+    int start = kernel->stats->totalTicks;
+    double wallStart = WallTime();
+    int ticks;
+
+    for (int i = 0; i < NumPings; i++) {
+	SendBench(PingHost, EchoHost, 0, 1, run, i, size);
+	postIn[PingHost]->Release(postIn[PingHost]->Receive(1));
+    }
+    ticks = kernel->stats->totalTicks - start;
+    Report((char *) "pingpong", size, NumPings, ticks, WallTime() - wallStart);
+    cout << " rtt_ticks " << ticks / NumPings << "\n";
+}
+
+// What the bulk test's receiver has seen of a run
+
+class BulkReceipt {
+  public:
+    int run;
+    int delivered;		// messages that arrived
+    int lastArrival;		// when the last of them did
+    bool finished;		// has an end marker arrived?
+    Semaphore *done;		// V'ed when the receiver has stopped
+};
+
+//----------------------------------------------------------------------
+// BulkReceive
+// 	The bulk test's machine 3: count the messages of a run that
+//	arrive in mailbox 0, until its end marker does.
+//----------------------------------------------------------------------
+
+static void
+BulkReceive(void *arg)
+{
+    BulkReceipt *r = (BulkReceipt *) arg;
+
+    while (!r->finished) {
+	Mail *mail = postIn[BulkReceiver]->Receive(0);
+	BenchHeader hdr = HeaderOf(mail);
+
+	postIn[BulkReceiver]->Release(mail);
+	if (hdr.run != r->run) {
+	    continue;			// left over from an earlier size
+	} else if (hdr.seq == EndOfRun) {
+	    r->finished = TRUE;
+	} else {
+	    r->delivered++;
+	    r->lastArrival = kernel->stats->totalTicks;
+	}
+    }
+    r->done->V();
+}
+
+//----------------------------------------------------------------------
+// Bulk
+// 	Send NumBulk "size"-byte messages from machine 2 to machine 3 as
+//	fast as they can go, then an end marker every EndInterval ticks
+//	until one gets through.  The throughput is of the messages that
+//	arrived, up to the last of them.
+//----------------------------------------------------------------------
+
+static void
+Bulk(int size)
+{
+    BulkReceipt receipt;
+    Thread *t = new Thread("bulk receiver", 1);
+    int start = kernel->stats->totalTicks;
+    double wallStart = WallTime();
+
+    receipt.run = ++numRuns;
+    receipt.delivered = 0;
+    receipt.lastArrival = start;
+    receipt.finished = FALSE;
+    receipt.done = new Semaphore("bulk receiver done", 0);
+    t->Fork(BulkReceive, &receipt, SmallStackSize);
+
+    for (int i = 0; i < NumBulk; i++)
+	SendBench(BulkSender, BulkReceiver, 0, 0, receipt.run, i, size);
+    while (!receipt.finished) {
+	SendBench(BulkSender, BulkReceiver, 0, 0, receipt.run, EndOfRun, size);
+	kernel->alarm->WaitUntil(EndInterval);
+    }
+    receipt.done->P();
+    delete receipt.done;
+    Report((char *) "bulk", size, receipt.delivered,
+	   receipt.lastArrival - start, WallTime() - wallStart);
+    cout << " sent " << NumBulk << " lost " << NumBulk - receipt.delivered
+	 << "\n";
+}
+
+// One of the fan-in test's senders
+
+class FanInSender {
+  public:
+    int host;			// the machine it sends from
+    int run;
+    bool ended;			// has its end marker arrived?
+    Semaphore *done;		// V'ed when it has stopped sending
+};
+
+//----------------------------------------------------------------------
+// FanInSend
+// 	Send FanInMessages messages of the largest size to machine 4,
+//	then an end marker every EndInterval ticks until one gets
+//	through: with every sender at once, machine 4's network device
+//	is overrun, and drops packets.
+//----------------------------------------------------------------------
+
+static void
+FanInSend(void *arg)
+{
+    FanInSender *s = (FanInSender *) arg;
+
+    for (int i = 0; i < FanInMessages; i++)
+	SendBench(s->host, FanInReceiver, 0, 0, s->run, i, MaxMailSize);
+    while (!s->ended) {
+	SendBench(s->host, FanInReceiver, 0, 0, s->run, EndOfRun, MaxMailSize);
+	kernel->alarm->WaitUntil(EndInterval);
+    }
+    s->done->V();
+}
+
+//----------------------------------------------------------------------
+// FanIn
+// 	Have every fan-in sender send to machine 4 at once, and take the
+//	messages as they come, until each sender's end marker has.  The
+//	throughput is of the messages that arrived.
+//----------------------------------------------------------------------
+
+static void
+FanIn()
+{
+    FanInSender senders[NumFanInSenders];
+    Semaphore *done = new Semaphore("fan-in senders done", 0);
+    int run = ++numRuns;
+    int start = kernel->stats->totalTicks, last = start;
+    double wallStart = WallTime();
+    int received = 0, ended = 0;
+
+    for (int i = 0; i < NumFanInSenders; i++) {
+	Thread *t = new Thread("fan-in sender", 1);
+
+	senders[i].host = FirstFanInSender + i;
+	senders[i].run = run;
+	senders[i].ended = FALSE;
+	senders[i].done = done;
+	t->Fork(FanInSend, &senders[i], SmallStackSize);
+    }
+    while (ended < NumFanInSenders) {
+	Mail *mail = postIn[FanInReceiver]->Receive(0);
+	BenchHeader hdr = HeaderOf(mail);
+	int sender = mail->pktHdr.from - FirstFanInSender;
+
+	postIn[FanInReceiver]->Release(mail);
+	if (hdr.run != run || sender < 0 || sender >= NumFanInSenders) {
+	    continue;			// stale, or not from a sender
+	} else if (hdr.seq == EndOfRun) {
+	    if (!senders[sender].ended) {
+		senders[sender].ended = TRUE;
+		ended++;
+	    }
+	} else {
+	    received++;
+	    last = kernel->stats->totalTicks;
+	}
+    }
+    for (int i = 0; i < NumFanInSenders; i++)
+	done->P();			// before "senders" goes away
+    delete done;
+    Report((char *) "fanin", NumFanInSenders, received, last - start,
+	   WallTime() - wallStart);
+    cout << " sent " << NumFanInSenders * FanInMessages << " lost "
+	 << NumFanInSenders * FanInMessages - received << "\n";
+}
+
+//----------------------------------------------------------------------
+// NetBenchmark
+// 	Make the machines, each with its own post office on the wire, and
+//	run the tests one after another.  The bulk test's two machines
+//	drop packets with "reliability"; the rest never do.
+//----------------------------------------------------------------------
+
+void
+NetBenchmark(double reliability)
+{
+    ASSERT(NumBenchHosts <= MaxWireHosts);
+    for (int host = 0; host < NumBenchHosts; host++) {
+	bool lossy = (host == BulkSender || host == BulkReceiver);
+
+	postIn[host] = new PostOfficeInput(10, host);
+	postOut[host] = new PostOfficeOutput(lossy ? reliability : 1.0, host);
+    }
+    (new Thread("echo", 1))->Fork(Echo, NULL, SmallStackSize);
+
+    for (int i = 0; i < NumSizes; i++)
+	PingPong(sizes[i]);
+    for (int i = 0; i < NumSizes; i++)
+	Bulk(sizes[i]);
+    FanIn();
+}
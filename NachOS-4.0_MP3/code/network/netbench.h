@@ -0,0 +1,49 @@
+// netbench.h
+//	A benchmark of the post office, run with "nachos -wire -bench-net".
+//	Every machine is a network device on the in-memory wire, in this
+//	one process, so runs are repeatable and a test can use as many
+//	machines as it likes.  There are three tests:
+//
+//	    pingpong	machine 0 sends a message to machine 1, which
+//			sends it straight back, many times over: the
+//			round trip latency
+//	    bulk	machine 2 sends machine 3 a stream of messages,
+//			as fast as its transmit queue takes them: the
+//			throughput, and how much of it is lost
+//	    fanin	machines 5 to 12 all send to machine 4 at once:
+//			the throughput with the receiver as the
+//			bottleneck
+//
+//	The ping-pong and bulk tests are run at several message sizes,
+//	up to MaxMailSize.  The bulk test's machines drop packets with
+//	the reliability given with -n; the others never do, since a lost
+//	ping would stop the test.  Even so, a receiver sent to faster than
+//	it takes packets off its device loses some, so the bulk and
+//	fan-in lines also give how many messages were sent and lost.
+//	With -coalesce, small messages queued behind others share
+//	packets (see PostOfficeOutput::Pack), which shows in the bulk
+//	test at the smaller sizes.
+//
+//	Each test prints one line:
+//
+//	    netbench <test><size> messages <n> ticks <t>
+//		per_sim_sec <m> per_host_sec <h> [...]
+//
+//	where "per_sim_sec" counts a tick as a microsecond of simulated
+//	time (as the timeline does), and "per_host_sec" is by the host's
+//	clock, for the cost of the simulation itself.
+//
+// Copyright (c) 1992-1996 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#ifndef NETBENCH_H
+#define NETBENCH_H
+
+#include "copyright.h"
+
+extern void NetBenchmark(double reliability);
+				// run the tests; the bulk test drops
+				// packets with "reliability"
+
+#endif // NETBENCH_H
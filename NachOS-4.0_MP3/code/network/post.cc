@@ -18,6 +18,23 @@
 
 #include "copyright.h"
 #include "post.h"
+#include "memops.h"
+#include "perfcount.h"
+#include "memtrack.h"
+
+static PerfCounter perfSent("post", "sent");
+static PerfCounter perfSendWaits("post", "send_waits");
+					// for room in the transmit queue
+static PerfCounter perfDelivered("post", "delivered");
+static PerfCounter perfDropped("post", "dropped");
+					// no such box, or it was full
+static PerfHistogram perfMailBytes("post", "mail_bytes");
+					// of each message sent
+static PerfCounter perfPacked("post", "packed");
+					// messages sent in a shared packet
+static PerfCounter perfSharedPackets("post", "shared_packets");
+static PerfCounter perfUnpacked("post", "unpacked");
+					// messages received in one
 
 //----------------------------------------------------------------------
 // Mail::Mail
@@ -35,7 +52,7 @@ Mail::Mail(PacketHeader pktH, MailHeader mailH, char *msgData)
 
     pktHdr = pktH;
     mailHdr = mailH;
-    bcopy(msgData, data, mailHdr.length);
+    MemCopy(data, msgData, mailHdr.length);
 }
 
 //----------------------------------------------------------------------
@@ -44,12 +61,19 @@ Mail::Mail(PacketHeader pktH, MailHeader mailH, char *msgData)
 //	can receive incoming messages.
 //
 //	Just initialize a list of messages, representing the mailbox.
+//
+//	"boxAddress" -- which mailbox this is
+//	"capacity" -- the most messages it holds, or 0 for no limit
+//	"boxPolicy" -- what to do with a message when it is full
 //----------------------------------------------------------------------
 
 
-MailBox::MailBox()
+MailBox::MailBox(MailBoxAddress boxAddress, int capacity,
+			MailBoxPolicy boxPolicy)
 { 
-    messages = new SynchList<Mail *>(); 
+    address = boxAddress;
+    policy = boxPolicy;
+    messages = new SynchList<Mail *>(capacity); 
 }
 
 //----------------------------------------------------------------------
@@ -86,54 +110,62 @@ PrintHeader(PacketHeader pktHdr, MailHeader mailHdr)
 // 	Add a message to the mailbox.  If anyone is waiting for message
 //	arrival, wake them up!
 //
-//	We need to reconstruct the Mail message (by concatenating the headers
-//	to the data), to simplify queueing the message on the SynchList.
+//	If the mailbox is full, either wait for room, or drop the
+//	message and return FALSE, as its policy says.
 //
-//	"pktHdr" -- source, destination machine ID's
-//	"mailHdr" -- source, destination mailbox ID's
-//	"data" -- payload message data
+//	"mail" -- the message, in the buffer it arrived in
 //----------------------------------------------------------------------
 
-void 
-MailBox::Put(PacketHeader pktHdr, MailHeader mailHdr, char *data)
+bool 
+MailBox::Put(Mail *mail)
 { 
-    Mail *mail = new Mail(pktHdr, mailHdr, data); 
-
+    if (policy == MailDrop)
+	return messages->TryAppend(mail);
     messages->Append(mail);		// put on the end of the list of 
 					// arrived messages, and wake up 
 					// any waiters
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// BoxAddress, BoxHash
+// 	Get the key a mailbox is stored under in the post office, and
+//	spread keys over the hash table.  Mailbox numbers are often
+//	small and consecutive, so mix the bits.
+//----------------------------------------------------------------------
+
+static MailBoxAddress
+BoxAddress(MailBox *box)
+{
+    return box->Address();
+}
+
+static unsigned
+BoxHash(MailBoxAddress address)
+{
+    return (unsigned) address * 2654435761u >> 8;
 }
 
 //----------------------------------------------------------------------
 // MailBox::Get
-// 	Get a message from a mailbox, parsing it into the packet header,
-//	mailbox header, and data. 
+// 	Get a message from a mailbox.  The message is not copied; the
+//	caller gets the buffer it arrived in.
 //
 //	The calling thread waits if there are no messages in the mailbox.
-//
-//	"pktHdr" -- address to put: source, destination machine ID's
-//	"mailHdr" -- address to put: source, destination mailbox ID's
-//	"data" -- address to put: payload message data
 //----------------------------------------------------------------------
 
-void 
-MailBox::Get(PacketHeader *pktHdr, MailHeader *mailHdr, char *data) 
+Mail *
+MailBox::Get() 
 { 
     DEBUG(dbgNet, "Waiting for mail in mailbox");
     Mail *mail = messages->RemoveFront();	// remove message from list;
 						// will wait if list is empty
 
-    *pktHdr = mail->pktHdr;
-    *mailHdr = mail->mailHdr;
     if (debug->IsEnabled('n')) {
 	cout << "Got mail from mailbox: ";
-	PrintHeader(*pktHdr, *mailHdr);
+	PrintHeader(mail->pktHdr, mail->mailHdr);
     }
-    bcopy(mail->data, data, mail->mailHdr.length);
-					// copy the message data into
-					// the caller's buffer
-    delete mail;			// we've copied out the stuff we
-					// need, we can now discard the message
+    return mail;
 }
 
 //----------------------------------------------------------------------
@@ -147,21 +179,45 @@ MailBox::Get(PacketHeader *pktHdr, MailHeader *mailHdr, char *data)
 //	delivering messages to the mailboxes can't be done directly
 //	by the interrupt handlers, because it requires a Lock.
 //
-//	"nBoxes" is the number of mail boxes in this Post Office
+//	Incoming messages are kept in a pool of buffers, allocated once.
+//	A packet is taken off the network straight into one, which is
+//	then passed by reference to a mailbox and on to the receiver,
+//	until it is released.
+//
+//	Mailboxes are kept in a hash table, and only made when wanted,
+//	so a machine can have any number of them, and those never used
+//	cost nothing.
+//
+//	A packet that holds several messages (see PostOfficeOutput::Pack)
+//	is copied aside, and its messages are unpacked from there into
+//	buffers of their own.
+//
+//	"nBoxes" is the number of mail boxes made when first used: either
+//	  by mail arriving for them, or by a thread waiting in them
+//	"host" is the machine to receive for; other than this one, it
+//	  only makes sense on the in-memory wire (-wire)
 //----------------------------------------------------------------------
 
-PostOfficeInput::PostOfficeInput(int nBoxes)
+PostOfficeInput::PostOfficeInput(int nBoxes, NetworkAddress host)
 {
     messageAvailable = new Semaphore("message available", 0);
+    waiting = pending = FALSE;
+    packedHdr.length = packedAt = 0;
+
+    pool = new Mail[MailPoolSize];
+    ASSERT(pool[0].Payload() + sizeof(MailHeader) == pool[0].data);
+    for (numFree = 0; numFree < MailPoolSize; numFree++)
+	freeMail[numFree] = &pool[numFree];
 
     numBoxes = nBoxes;
-    boxes = new MailBox[nBoxes];
+    boxes = new HashTable<MailBoxAddress, MailBox *>(BoxAddress, BoxHash);
+    boxLock = new Lock("mailbox table lock");
 
-    network = new NetworkInput(this);
+    network = new NetworkInput(this, host);
 
     Thread *t = new Thread("postal worker", 1);
 
-    t->Fork(PostOfficeInput::PostalDelivery, this);
+    t->Fork(PostOfficeInput::PostalDelivery, this, SmallStackSize);
 }
 
 //----------------------------------------------------------------------
@@ -175,43 +231,118 @@ PostOfficeInput::PostOfficeInput(int nBoxes)
 
 PostOfficeInput::~PostOfficeInput()
 {
+    MailBox *box;
+
     delete network;
-    delete [] boxes;
+    while (!boxes->IsEmpty()) {
+	HashIterator<MailBoxAddress, MailBox *> iter(boxes);
+	box = iter.Item();
+	(void) boxes->Remove(box->Address());
+	delete box;
+    }
+    delete boxes;
+    delete boxLock;
+    delete [] pool;
+}
+
+//----------------------------------------------------------------------
+// PostOfficeInput::Open
+// 	Make a mailbox, if it doesn't exist already.  Until then, mail
+//	for a box numbered "nBoxes" or more is dropped.
+//
+//	"box" -- mailbox ID to make
+//	"capacity" -- the most messages it holds, or 0 for no limit
+//	"policy" -- what to do with a message when it is full
+//----------------------------------------------------------------------
+
+void
+PostOfficeInput::Open(int box, int capacity, MailBoxPolicy policy)
+{
+    MailBox *found;
+
+    ASSERT(box >= 0 && capacity >= 0);
+    boxLock->Acquire();
+    if (!boxes->Find(box, &found))
+	boxes->Insert(new MailBox(box, capacity, policy));
+    boxLock->Release();
+}
+
+//----------------------------------------------------------------------
+// PostOfficeInput::FindBox
+// 	Return the mailbox "box", making it first if it is one of those
+//	made when first used, or NULL if there is no such box.
+//----------------------------------------------------------------------
+
+MailBox *
+PostOfficeInput::FindBox(int box)
+{
+    MailBox *found = NULL;
+
+    boxLock->Acquire();
+    if (!boxes->Find(box, &found) && box < numBoxes) {
+	found = new MailBox(box, DefaultBoxCapacity, MailBackpressure);
+	boxes->Insert(found);
+    }
+    boxLock->Release();
+    return found;
 }
 
 //----------------------------------------------------------------------
 // PostOffice::PostalDelivery
 // 	Wait for incoming messages, and put them in the right mailbox.
+//	CallBack queues them in a ring; we only wait if it's empty.
+//	Interrupts are off while we look at the ring, so that CallBack
+//	can't add a packet between our finding it empty and going to
+//	sleep.  Taking a message out may make room for a packet left
+//	on the network, or for more of a shared packet's messages.
 //
 //      Incoming messages have had the PacketHeader stripped off,
-//	but the MailHeader is still tacked on the front of the data.
+//	but the MailHeader is still tacked on the front of the data,
+//	which is where it belongs in the Mail.
+//
+//	Mail for a box that doesn't exist, or that is full and drops
+//	what it can't hold, goes straight back to the pool.  A full box
+//	that doesn't drop holds up delivery until there is room.
 //----------------------------------------------------------------------
 
 void
 PostOfficeInput::PostalDelivery(void* data)
 {
     PostOfficeInput* _this = (PostOfficeInput*)data;
-    PacketHeader pktHdr;
-    MailHeader mailHdr;
-    char *buffer = new char[MaxPacketSize];
+    Mail *mail;
+    MailBox *box;
+    IntStatus oldLevel;
+    MemTagScope tag(MemNetwork);
 
     for (;;) {
         // first, wait for a message
-        _this->messageAvailable->P();	
-        pktHdr = _this->network->Receive(buffer);
+	oldLevel = kernel->interrupt->SetLevel(IntOff);
+	while (!_this->arrived.Get(&mail)) {
+	    _this->waiting = TRUE;
+	    _this->messageAvailable->P();
+	}
+	if (_this->pending || _this->packedAt < _this->packedHdr.length)
+	    _this->Pull();		// there's room for it now
+	(void) kernel->interrupt->SetLevel(oldLevel);
 
-        mailHdr = *(MailHeader *)buffer;
         if (debug->IsEnabled('n')) {
 	    cout << "Putting mail into mailbox: ";
-	    PrintHeader(pktHdr, mailHdr);
+	    PrintHeader(mail->pktHdr, mail->mailHdr);
         }
 
 	// check that arriving message is legal!
-	ASSERT(0 <= mailHdr.to && mailHdr.to < _this->numBoxes);
-	ASSERT(mailHdr.length <= MaxMailSize);
+	ASSERT(0 <= mail->mailHdr.to);
+	ASSERT(mail->mailHdr.length <= MaxMailSize);
 
 	// put into mailbox
-        _this->boxes[mailHdr.to].Put(pktHdr, mailHdr, buffer + sizeof(MailHeader));
+	box = _this->FindBox(mail->mailHdr.to);
+	if (box == NULL || !box->Put(mail)) {
+	    DEBUG(dbgNet, "Dropping mail for box " << mail->mailHdr.to);
+	    perfDropped.Inc();
+	    _this->Release(mail);
+	} else {
+	    perfDelivered.Inc();
+	}
     }
 }
 
@@ -234,23 +365,159 @@ void
 PostOfficeInput::Receive(int box, PacketHeader *pktHdr, 
 				MailHeader *mailHdr, char* data)
 {
-    ASSERT((box >= 0) && (box < numBoxes));
+    Mail *mail = Receive(box);
+
+    *pktHdr = mail->pktHdr;
+    *mailHdr = mail->mailHdr;
+    MemCopy(data, mail->data, mail->mailHdr.length);
+					// copy the message data into
+					// the caller's buffer
+    Release(mail);			// we've copied out the stuff we
+					// need, we can now discard the message
+}
+
+//----------------------------------------------------------------------
+// PostOfficeInput::Receive
+// 	Retrieve a message from a specific box, waiting for one if need
+//	be, without copying it.  The caller must Release the message
+//	once it is done with it.
+//
+//	"box" -- mailbox ID in which to look for message
+//----------------------------------------------------------------------
+
+Mail *
+PostOfficeInput::Receive(int box)
+{
+    MailBox *found = FindBox(box);
+    Mail *mail;
 
-    boxes[box].Get(pktHdr, mailHdr, data);
-    ASSERT(mailHdr->length <= MaxMailSize);
+    ASSERT(found != NULL);		// one of the first nBoxes, or Opened
+    mail = found->Get();
+    ASSERT(mail->mailHdr.length <= MaxMailSize);
+    return mail;
+}
+
+//----------------------------------------------------------------------
+// PostOfficeInput::Release
+// 	Return a message's buffer to the pool.  If a packet was left on
+//	the network for want of a buffer, it can come in now.
+//
+//	"mail" -- a message returned by Receive(box)
+//----------------------------------------------------------------------
+
+void
+PostOfficeInput::Release(Mail *mail)
+{
+    IntStatus oldLevel = kernel->interrupt->SetLevel(IntOff);
+
+    ASSERT(numFree < MailPoolSize);
+    freeMail[numFree++] = mail;
+    if (pending || packedAt < packedHdr.length)
+	Pull();
+    (void) kernel->interrupt->SetLevel(oldLevel);
+}
+
+//----------------------------------------------------------------------
+// PostOfficeInput::Pull
+// 	Take the packet waiting on the network straight into a free
+//	buffer, and add it to the ring, so the next one can come in;
+//	signal the PostalDelivery routine that it is time to get to work!
+//	If the ring or the pool is full, the packet is left on the
+//	network until PostalDelivery or Release makes room.
+//
+//	A shared packet is copied aside, and its buffer given straight
+//	back; the next packet waits until all its messages are unpacked,
+//	so they stay in order.
+//
+//	Interrupts must be off.
+//----------------------------------------------------------------------
+
+void
+PostOfficeInput::Pull()
+{
+    Mail *mail;
+
+    Unpack();				// the rest of a shared packet
+    if (!pending || packedAt < packedHdr.length
+	    || arrived.IsFull() || numFree == 0)
+	return;
+    pending = FALSE;
+    mail = freeMail[--numFree];
+    mail->pktHdr = network->Receive(mail->Payload());
+    if (mail->mailHdr.to != CoalescedBox) {
+	Queue(mail);
+	return;
+    }
+    packedHdr = mail->pktHdr;
+    MemCopy(packed, mail->Payload(), packedHdr.length);
+    packedAt = sizeof(MailBoxAddress);
+    freeMail[numFree++] = mail;
+    Unpack();
+}
+
+//----------------------------------------------------------------------
+// PostOfficeInput::Unpack
+// 	Give each message of the shared packet that has been copied
+//	aside a buffer of its own, with the headers it would have had
+//	in a packet by itself, and add it to the ring -- while there is
+//	room for it.
+//
+//	Interrupts must be off.
+//----------------------------------------------------------------------
+
+void
+PostOfficeInput::Unpack()
+{
+    PackedHeader rec;
+    Mail *mail;
+
+    while (packedAt < packedHdr.length && !arrived.IsFull() && numFree > 0) {
+	ASSERT(packedAt + sizeof(rec) <= packedHdr.length);
+	MemCopy(&rec, packed + packedAt, sizeof(rec));
+	packedAt += sizeof(rec);
+	ASSERT(packedAt + rec.length <= packedHdr.length);
+
+	mail = freeMail[--numFree];
+	mail->pktHdr = packedHdr;
+	mail->pktHdr.length = sizeof(MailHeader) + rec.length;
+	mail->mailHdr.to = rec.to;
+	mail->mailHdr.from = rec.from;
+	mail->mailHdr.length = rec.length;
+	MemCopy(mail->data, packed + packedAt, rec.length);
+	packedAt += rec.length;
+	perfUnpacked.Inc();
+	Queue(mail);
+    }
+}
+
+//----------------------------------------------------------------------
+// PostOfficeInput::Queue
+// 	Add a message to the ring, and signal the PostalDelivery routine
+//	that it is time to get to work!
+//
+//	Interrupts must be off.
+//----------------------------------------------------------------------
+
+void
+PostOfficeInput::Queue(Mail *mail)
+{
+    arrived.Put(mail);
+    if (waiting) {
+	waiting = FALSE;
+	messageAvailable->V(); 
+    }
 }
 
 //----------------------------------------------------------------------
 // PostOffice::CallBack
 // 	Interrupt handler, called when a packet arrives from the network.
-//
-//	Signal the PostalDelivery routine that it is time to get to work!
 //----------------------------------------------------------------------
 
 void
 PostOfficeInput::CallBack()
 { 
-    messageAvailable->V(); 
+    pending = TRUE;
+    Pull();
 }
 
 //----------------------------------------------------------------------
@@ -261,19 +528,29 @@ PostOfficeInput::CallBack()
 //	  be delivered (e.g., reliability = 1 means the network never
 //	  drops any packets; reliability = 0 means the network never
 //	  delivers any packets)
+//	"sender" is the machine to send from, or -1 for this one
+//
+//	Small messages are packed together only with -coalesce.
 //----------------------------------------------------------------------
 
-PostOfficeOutput::PostOfficeOutput(double reliability)
+PostOfficeOutput::PostOfficeOutput(double reliability, NetworkAddress sender)
 {
     messageSent = new Semaphore("message sent", 0);
     sendLock = new Lock("message send lock");
+    waiting = FALSE;
+    coalesce = kernel->coalesceMail;
+    for (int i = 0; i < CoalesceSlots; i++)
+	slot[i].count = 0;
 
-    network = new NetworkOutput(reliability, this);
+    host = (sender < 0) ? kernel->hostName : sender;
+    network = new NetworkOutput(reliability, this, host);
 }
 
 //----------------------------------------------------------------------
 // PostOfficeOutput::~PostOfficeOutput
-// 	De-allocate the post office data structures.
+// 	De-allocate the post office data structures.  Messages still
+//	waiting for others to share their packet are lost, as if the
+//	network had dropped them.
 //----------------------------------------------------------------------
 
 PostOfficeOutput::~PostOfficeOutput()
@@ -288,9 +565,6 @@ PostOfficeOutput::~PostOfficeOutput()
 // 	Concatenate the MailHeader to the front of the data, and pass 
 //	the result to the Network for delivery to the destination machine.
 //
-//	Note that the MailHeader + data looks just like normal payload
-//	data to the Network.
-//
 //	"pktHdr" -- source, destination machine ID's
 //	"mailHdr" -- source, destination mailbox ID's
 //	"data" -- payload message data
@@ -299,46 +573,263 @@ PostOfficeOutput::~PostOfficeOutput()
 void
 PostOfficeOutput::Send(PacketHeader pktHdr, MailHeader mailHdr, char* data)
 {
-    char* buffer = new char[MaxPacketSize];	// space to hold concatenated
-						// mailHdr + data
+    Mail mail(pktHdr, mailHdr, data);	// concatenate MailHeader and data
+
+    Send(&mail);
+}
+
+//----------------------------------------------------------------------
+// PostOfficeOutput::Send
+// 	Pass a message, already laid out as the Network wants it, to the
+//	Network for delivery to the destination machine.
+//
+//	The Network queues the packet, so we only wait if its transmit
+//	queue is full, not for the packet itself to be sent.
+//
+//	With -coalesce, the message may instead be put in a packet
+//	with others for the same machine, to go a little later (see
+//	Pack).  One that isn't has to wait for those already packed
+//	for its machine to go first, so that they stay in order.
+//
+//	"mail" -- the message; its pktHdr.to and mailHdr must be set
+//----------------------------------------------------------------------
+
+void
+PostOfficeOutput::Send(Mail *mail)
+{
+    IntStatus oldLevel;
+    MemTagScope tag(MemNetwork);
 
     if (debug->IsEnabled('n')) {
 	cout << "Post send: ";
-	PrintHeader(pktHdr, mailHdr);
+	PrintHeader(mail->pktHdr, mail->mailHdr);
     }
-    ASSERT(mailHdr.length <= MaxMailSize);
-    ASSERT(0 <= mailHdr.to);
+    ASSERT(mail->mailHdr.length <= MaxMailSize);
+    ASSERT(0 <= mail->mailHdr.to);
     
     // fill in pktHdr, for the Network layer
-    pktHdr.from = kernel->hostName;
-    pktHdr.length = mailHdr.length + sizeof(MailHeader);
-
-    // concatenate MailHeader and data
-    bcopy((char *)&mailHdr, buffer, sizeof(MailHeader));
-    bcopy(data, buffer + sizeof(MailHeader), mailHdr.length);
-
-    sendLock->Acquire();   		// only one message can be sent
-					// to the network at any one time
-    network->Send(pktHdr, buffer);
-    messageSent->P();			// wait for interrupt to tell us
-					// ok to send the next message
-    sendLock->Release();
-
-    delete [] buffer;			// we've sent the message, so
-					// we can delete our buffer
+    mail->pktHdr.from = host;
+    mail->pktHdr.length = mail->mailHdr.length + sizeof(MailHeader);
+    perfSent.Inc();
+    perfMailBytes.Record(mail->mailHdr.length);
+
+    sendLock->Acquire();   		// only one sender can wait for
+					// room at any one time
+    oldLevel = kernel->interrupt->SetLevel(IntOff);
+    if (!coalesce || !Pack(mail)) {
+	CoalesceSlot *packing = SlotFor(mail->pktHdr.to);
+
+	if (packing != NULL)
+	    (void) Flush(packing, TRUE);
+	Transmit(mail->pktHdr, mail->Payload());
+    }
+    (void) kernel->interrupt->SetLevel(oldLevel);
+    sendLock->Release();		// the network has copied the
+					// message, so the caller can
+					// reuse it
+}
+
+//----------------------------------------------------------------------
+// PostOfficeOutput::Transmit
+// 	Queue a packet on the Network, waiting for room if its transmit
+//	queue is full.  Interrupts are off while we look, so that
+//	CallBack can't make room between our finding it full and going
+//	to sleep.
+//
+//	Interrupts must be off, and the caller must hold sendLock.
+//
+//	"hdr" -- where the packet is going, and its length
+//	"data" -- what is in it
+//----------------------------------------------------------------------
+
+void
+PostOfficeOutput::Transmit(PacketHeader hdr, char *data)
+{
+    while (!network->Send(hdr, data)) {
+	waiting = TRUE;			// wait for interrupt to tell us
+	perfSendWaits.Inc();
+	messageSent->P();		// there is room again
+    }
+}
+
+//----------------------------------------------------------------------
+// PostOfficeOutput::Pack
+// 	Coalesce small messages, as Nagle's algorithm does for TCP.  A
+//	packet costs NetworkTime however little is in it, so a message
+//	that would go while another packet is still on the wire is held
+//	back instead, and more messages for the same machine are added
+//	to it, behind a PackedHeader each, until the packet is full.
+//	Whatever is held goes once CoalesceDelay ticks have passed, or
+//	the wire is idle (see CallBack).
+//
+//	A message when nothing is being sent, or between mailboxes too
+//	far up to fit a PackedHeader, goes by itself as usual: return
+//	FALSE, for the caller to send it.
+//
+//	Interrupts must be off, and the caller must hold sendLock.
+//
+//	"mail" -- the message; its headers are filled in
+//----------------------------------------------------------------------
+
+bool
+PostOfficeOutput::Pack(Mail *mail)
+{
+    MailHeader *mailHdr = &mail->mailHdr;
+    CoalesceSlot *packing;
+    PackedHeader rec;
+    unsigned need = sizeof(PackedHeader) + mailHdr->length;
+
+    if (mailHdr->to > MaxPackedBox || mailHdr->from < 0
+	    || mailHdr->from > MaxPackedBox)
+	return FALSE;
+    packing = SlotFor(mail->pktHdr.to);
+    if (packing != NULL && packing->pktHdr.length + need > MaxPacketSize) {
+	(void) Flush(packing, TRUE);	// no room for it; start another
+	packing = NULL;
+    }
+    if (packing == NULL) {
+	if (network->IsEmpty())
+	    return FALSE;		// nothing to wait for
+	packing = FreeSlot();
+	packing->pktHdr = mail->pktHdr;
+	packing->pktHdr.length = sizeof(MailBoxAddress);
+	MemCopy(packing->data, &CoalescedBox, sizeof(MailBoxAddress));
+	packing->opened = kernel->stats->totalTicks;
+    }
+
+    rec.to = mailHdr->to;
+    rec.from = mailHdr->from;
+    rec.length = mailHdr->length;
+    MemCopy(packing->data + packing->pktHdr.length, &rec, sizeof(rec));
+    MemCopy(packing->data + packing->pktHdr.length + sizeof(rec),
+	    mail->data, mailHdr->length);
+    packing->pktHdr.length += need;
+    packing->count++;
+    DEBUG(dbgNet, "Packed message " << packing->count << " for machine "
+	  << packing->pktHdr.to);
+
+    if (packing->pktHdr.length + sizeof(PackedHeader) > MaxPacketSize)
+	(void) Flush(packing, TRUE);	// full
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// PostOfficeOutput::SlotFor
+// 	Return the slot with the packet being filled for machine "to",
+//	or NULL if there is none.
+//----------------------------------------------------------------------
+
+CoalesceSlot *
+PostOfficeOutput::SlotFor(NetworkAddress to)
+{
+    for (int i = 0; i < CoalesceSlots; i++)
+	if (slot[i].count > 0 && slot[i].pktHdr.to == to)
+	    return &slot[i];
+    return NULL;
+}
+
+//----------------------------------------------------------------------
+// PostOfficeOutput::FreeSlot
+// 	Return a slot with no packet in it, sending the one that has
+//	been filled for longest if every slot is in use.
+//
+//	Interrupts must be off, and the caller must hold sendLock.
+//----------------------------------------------------------------------
+
+CoalesceSlot *
+PostOfficeOutput::FreeSlot()
+{
+    CoalesceSlot *oldest = &slot[0];
+
+    for (int i = 0; i < CoalesceSlots; i++) {
+	if (slot[i].count == 0)
+	    return &slot[i];
+	if (slot[i].opened < oldest->opened)
+	    oldest = &slot[i];
+    }
+    (void) Flush(oldest, TRUE);
+    return oldest;
+}
+
+//----------------------------------------------------------------------
+// PostOfficeOutput::Flush
+// 	Queue the packet being filled in "slot" on the Network, and free
+//	the slot.  A packet with only one message in it goes as that
+//	message would by itself, so as not to cost the receiver a copy.
+//
+//	A sender waiting for room may find that CallBack has sent the
+//	packet for it in the meantime.
+//
+//	Returns FALSE, and keeps the packet, if the transmit queue is full
+//	and "canWait" is FALSE.  Interrupts must be off; if "canWait", the
+//	caller must hold sendLock.
+//----------------------------------------------------------------------
+
+bool
+PostOfficeOutput::Flush(CoalesceSlot *packing, bool canWait)
+{
+    Mail alone;
+    PacketHeader hdr = packing->pktHdr;
+    char *data = packing->data;
+
+    ASSERT(packing->count > 0);
+    if (packing->count == 1) {
+	PackedHeader rec;
+
+	MemCopy(&rec, packing->data + sizeof(MailBoxAddress), sizeof(rec));
+	alone.pktHdr = packing->pktHdr;
+	alone.mailHdr.to = rec.to;
+	alone.mailHdr.from = rec.from;
+	alone.mailHdr.length = rec.length;
+	MemCopy(alone.data, packing->data + sizeof(MailBoxAddress)
+		+ sizeof(rec), rec.length);
+	hdr = alone.pktHdr;
+	hdr.length = sizeof(MailHeader) + rec.length;
+	data = alone.Payload();
+    }
+    while (packing->count > 0 && !network->Send(hdr, data)) {
+	if (!canWait)
+	    return FALSE;
+	waiting = TRUE;
+	perfSendWaits.Inc();
+	messageSent->P();
+    }
+    if (packing->count > 1) {
+	perfPacked.Add(packing->count);
+	perfSharedPackets.Inc();
+    }
+    packing->count = 0;
+    return TRUE;
 }
 
 //----------------------------------------------------------------------
 // PostOfficeOutput::CallBack
-// 	Interrupt handler, called when the next packet can be put onto the 
-//	network.
+// 	Interrupt handler, called when a batch of packets has been put
+//	onto the network, so there is room to queue more.
+//
+//	A packet being filled goes now if the wire has gone idle, or it
+//	has waited CoalesceDelay ticks: so a message is never held up for
+//	long for others to share its packet.
 //
-//	Called even if the previous packet was dropped.
+//	Called even if the packets were dropped.
 //----------------------------------------------------------------------
 
 void 
 PostOfficeOutput::CallBack()
 { 
-    messageSent->V();
+    bool idle = network->IsEmpty();
+    int now = kernel->stats->totalTicks;
+
+    for (int i = 0; i < CoalesceSlots; i++) {
+	if (slot[i].count == 0
+		|| (!idle && now - slot[i].opened < CoalesceDelay))
+	    continue;
+	if (!Flush(&slot[i], FALSE))
+	    break;			// no more room; wait for the next batch
+    }
+    if (waiting) {
+	waiting = FALSE;
+	messageSent->V();
+    }
 }
 
@@ -31,8 +31,11 @@
 #include "utility.h"
 #include "callback.h"
 #include "network.h"
+#include "stats.h"
 #include "synchlist.h"
 #include "synch.h"
+#include "ring.h"
+#include "hash.h"
 
 // Mailbox address -- uniquely identifies a mailbox on a given machine.
 // A mailbox is just a place for temporary storage for messages.
@@ -56,23 +59,53 @@ class MailHeader {
 #define MaxMailSize 	(MaxPacketSize - sizeof(MailHeader))
 
 
+// With coalescing (-coalesce), small messages for the same machine
+// may instead share one packet.  In place of the MailHeader it starts
+// with CoalescedBox, and then holds each message in turn, behind a
+// PackedHeader: a MailHeader cut down to a byte a field, so that only
+// messages between mailboxes up to MaxPackedBox can go this way.
+
+const MailBoxAddress CoalescedBox = -1;
+const int MaxPackedBox = 255;
+
+class PackedHeader {
+  public:
+    unsigned char to;		// Destination mail box
+    unsigned char from;		// Mail box to reply to
+    unsigned char length;	// Bytes of message data
+};
+
 // The following class defines the format of an incoming/outgoing 
 // "Mail" message.  The message format is layered: 
 //	network header (PacketHeader) 
 //	post office header (MailHeader) 
 //	data
+//
+// The MailHeader and data are together just as the Network sees them,
+// so a message can be received into, or sent from, a Mail in place.
 
 class Mail {
   public:
+     Mail() {}			// An empty buffer, to be received into
      Mail(PacketHeader pktH, MailHeader mailH, char *msgData);
 				// Initialize a mail message by
 				// concatenating the headers to the data
 
+     char *Payload() { return (char *) &mailHdr; }
+				// MailHeader then data, as on the network
+
      PacketHeader pktHdr;	// Header appended by Network
      MailHeader mailHdr;	// Header appended by PostOffice
      char data[MaxMailSize];	// Payload -- message data
 };
 
+// What a mailbox does with a message that arrives when it is full
+
+enum MailBoxPolicy {
+    MailBackpressure,		// wait for room, holding up delivery
+    MailDrop			// throw the message away
+};
+
 // The following class defines a single mailbox, or temporary storage
 // for messages.   Incoming messages are put by the PostOffice into the 
 // appropriate mailbox, and these messages can then be retrieved by
@@ -80,19 +113,41 @@ class Mail {
 
 class MailBox {
   public: 
-    MailBox();			// Allocate and initialize mail box
+    MailBox(MailBoxAddress address, int capacity, MailBoxPolicy policy);
+				// Allocate and initialize mail box,
+				// holding at most "capacity" messages
+				// (0 means there is no limit)
     ~MailBox();			// De-allocate mail box
 
-    void Put(PacketHeader pktHdr, MailHeader mailHdr, char *data);
-   				// Atomically put a message into the mailbox
-    void Get(PacketHeader *pktHdr, MailHeader *mailHdr, char *data); 
-   				// Atomically get a message out of the 
+    bool Put(Mail *mail);	// Atomically put a message into the
+				// mailbox; it is not copied.  Returns
+				// FALSE if it was dropped
+    Mail *Get();		// Atomically get a message out of the 
 				// mailbox (and wait if there is no message 
 				// to get!)
+    MailBoxAddress Address() { return address; }
+
   private:
+    MailBoxAddress address;	// which box this is
+    MailBoxPolicy policy;	// what to do when it is full
     SynchList<Mail *> *messages; // A mailbox is just a list of arrived messages
 };
 
+// Mailboxes that are created when first used, and how many messages
+// each one can hold
+
+const int DefaultBoxCapacity = 64;
+
+
+// Packets that can arrive before the postal worker delivers them
+
+const int PacketBacklog = 16;
+
+// Buffers for incoming messages: arrived, in a mailbox, or held by
+// a thread that has received them but not yet released them
+
+const int MailPoolSize = 64;
+
 // The following two classes defines a "Post Office", or a collection of 
 // mailboxes.  The Post Office provides two main operations: 
 //	Send -- send a message to a mailbox on a remote machine 
@@ -104,13 +159,25 @@ class MailBox {
 
 class PostOfficeInput : public CallBackObj {
   public:
-    PostOfficeInput(int nBoxes); // Allocate and initialize Post Office
+    PostOfficeInput(int nBoxes, NetworkAddress host = -1);
+				// Allocate and initialize Post Office
+				// for "host" (-1 means this machine);
+				// boxes 0 to nBoxes-1 are made when
+				// first used, any others by Open
     ~PostOfficeInput();		// De-allocate Post Office data
+
+    void Open(int box, int capacity, MailBoxPolicy policy);
+				// Make a mailbox, so mail for it is kept
+				// rather than dropped
     
     void Receive(int box, PacketHeader *pktHdr, 
 		MailHeader *mailHdr, char *data);
     				// Retrieve a message from "box".  Wait if
 				// there is no message in the box.
+    Mail *Receive(int box);	// Same, but return the message in
+				// place, rather than copying it out
+    void Release(Mail *mail);	// Give back a message returned by
+				// Receive(box), once it has been read
 
     static void PostalDelivery(void* data);
 				// Wait for incoming messages, 
@@ -121,31 +188,94 @@ class PostOfficeInput : public CallBackObj {
 				// (i.e., time to call PostalDelivery)
 
   private:
+    void Pull();		// take a packet off the network into a
+				// free buffer, if there is room for it
+    void Unpack();		// and the messages of a shared packet,
+				// as many as there is room for
+    void Queue(Mail *mail);	// hand a message to the postal worker
+    MailBox *FindBox(int box);	// the mailbox, or NULL if there is none
+
     NetworkInput *network;	// Physical network connection
-    MailBox *boxes;		// Table of mail boxes to hold incoming mail
-    int numBoxes;		// Number of mail boxes
+    HashTable<MailBoxAddress, MailBox *> *boxes;
+				// Mail boxes to hold incoming mail, by
+				// address; only those in use exist
+    Lock *boxLock;		// protects the table
+    int numBoxes;		// Boxes that are made when first used
     Semaphore *messageAvailable;// V'ed when message has arrived from network
+				// and the postal worker is waiting
+    Mail *pool;			// the buffers for incoming messages
+    Mail *freeMail[MailPoolSize];	// those not in use
+    int numFree;
+    Ring<Mail *, PacketBacklog> arrived;
+				// packets CallBack has taken off the
+				// network, not yet delivered
+    bool waiting;		// is the postal worker waiting?
+    bool pending;		// is a packet left on the network,
+				// because the ring or pool was full?
+    PacketHeader packedHdr;	// a shared packet being unpacked,
+    char packed[MaxPacketSize];	// and its data
+    unsigned packedAt;		// where its next message starts
 };
 
+// A packet being filled with small messages for one machine, until
+// it is full, or has waited CoalesceDelay ticks, or there is nothing
+// else on the wire to wait for (as Nagle's algorithm does for TCP)
+
+class CoalesceSlot {
+  public:
+    PacketHeader pktHdr;	// where it is going, and bytes so far
+    char data[MaxPacketSize];	// CoalescedBox, then the messages
+    int count;			// messages in it; 0 if the slot is free
+    int opened;			// when the first of them was put in
+};
+
+// Machines a sender can be filling a packet for at once, and how long
+// a message may be held for more to join it
+
+const int CoalesceSlots = 4;
+const int CoalesceDelay = NetworkTime;
+
 class PostOfficeOutput : public CallBackObj {
   public:
-    PostOfficeOutput(double reliability);
+    PostOfficeOutput(double reliability, NetworkAddress host = -1);
 				// Allocate and initialize output
 				//   "reliability" is how many packets
 				//   get dropped by the underlying network
+				//   "host" is who sends (-1 means this
+				//   machine)
     ~PostOfficeOutput();	// De-allocate Post Office data
 
     void Send(PacketHeader pktHdr, MailHeader mailHdr, char *data);
     				// Send a message to a mailbox on a remote 
 				// machine.  The fromBox in the MailHeader is 
 				// the return box for ack's.
+    void Send(Mail *mail);	// Same, for a message already built in
+				// a Mail; nothing is copied but by the
+				// network
 
-    void CallBack();		// Called when outgoing packet has been 
-				// put on network; next packet can now be sent
+    void CallBack();		// Called when outgoing packets have been 
+				// put on network; more can now be queued
     
   private:
+    bool Pack(Mail *mail);	// put a message in a shared packet,
+				// FALSE if it should go by itself
+    CoalesceSlot *SlotFor(NetworkAddress to);
+				// the packet being filled for "to"
+    CoalesceSlot *FreeSlot();	// a slot to fill, sending the oldest
+				// packet if all are in use
+    bool Flush(CoalesceSlot *slot, bool canWait);
+				// send a packet being filled; FALSE if
+				// there was no room, and not "canWait"
+    void Transmit(PacketHeader hdr, char *data);
+				// queue a packet, waiting for room
+
+    NetworkAddress host;	// the machine we send from
     NetworkOutput *network;	// Physical network connection
-    Semaphore *messageSent;	// V'ed when next message can be sent to network
-    Lock *sendLock;		// Only one outgoing message at a time
+    Semaphore *messageSent;	// V'ed when there is room in the network's
+				// transmit queue and a sender is waiting
+    Lock *sendLock;		// Only one sender waits for room at a time
+    bool waiting;		// is a sender waiting for room?
+    bool coalesce;		// pack small messages together?
+    CoalesceSlot slot[CoalesceSlots];
 };
 #endif
@@ -0,0 +1,403 @@
+// transport.cc
+//	Routines for a reliable, ordered byte stream with a sliding
+//	window, on top of the post office.
+//
+//	Each connection has two threads of its own: one takes segments
+//	and ACKs out of the connection's mailbox, and one sleeps until
+//	the retransmission timer of the oldest outstanding segment runs
+//	out.  Threads calling Write and Read only wait for the window to
+//	open, or for data to arrive.
+//
+//	The lock is released while a segment is handed to the post
+//	office, since that waits for the network; the segment is copied
+//	first, so it doesn't matter if it is acknowledged meanwhile.
+//
+// Copyright (c) 1992-1996 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "main.h"
+#include "transport.h"
+#include "memops.h"
+
+//----------------------------------------------------------------------
+// Connection::Connection
+// 	Open our end of a stream, and start the threads that receive
+//	and retransmit for it.
+//
+//	"localBox" -- our mailbox; only this connection may use it
+//	"remoteHost", "remoteBox" -- the other end's machine and mailbox
+//	"window" -- the most segments to have outstanding
+//----------------------------------------------------------------------
+
+Connection::Connection(int localBox, int remoteHost, int remoteBox,
+			int window)
+{
+    ASSERT(window > 0 && window <= MaxWindow);
+
+    local = localBox;
+    host = remoteHost;
+    remote = remoteBox;
+    this->window = window;
+
+    lock = new Lock("connection lock");
+    windowOpen = new Condition("window open");
+    allAcked = new Condition("all acked");
+    outstanding = new Condition("outstanding");
+    dataReady = new Condition("data ready");
+
+    sendBase = nextSeq = 0;
+    timerStart = 0;
+    dupAcks = 0;
+    srtt = rttvar = -1;
+    rto = InitialRto;
+    numRetransmits = 0;
+
+    for (int i = 0; i < MaxWindow; i++)
+	arrived[i].present = FALSE;
+    recvNext = 0;
+    streamHead = numBuffered = 0;
+
+    // a lost segment is retransmitted, so there's no need to hold up
+    // the post office when we fall behind
+    kernel->postOfficeIn->Open(local, 2 * MaxWindow, MailDrop);
+
+    Thread *t = new Thread("transport receiver", 1);
+    t->Fork(Connection::Receiver, this, SmallStackSize);
+    t = new Thread("transport retransmitter", 1);
+    t->Fork(Connection::Retransmitter, this, SmallStackSize);
+}
+
+//----------------------------------------------------------------------
+// Connection::~Connection
+// 	De-allocate the connection.
+//
+//	As with the post office, the threads are waiting on our lock
+//	and conditions, so we don't deallocate them.
+//----------------------------------------------------------------------
+
+Connection::~Connection()
+{
+}
+
+//----------------------------------------------------------------------
+// Connection::Transmit
+// 	Send a segment, carrying a cumulative ACK of what we have
+//	received.  The segment is copied out with the lock held, which
+//	is then released while the post office sends it.
+//
+//	"seq" -- the segment to send, or -1 for a bare ACK
+//	"again" -- is this a retransmission?
+//----------------------------------------------------------------------
+
+void
+Connection::Transmit(int seq, bool again)
+{
+    Mail mail;
+    SegmentHeader *hdr = (SegmentHeader *) mail.data;
+    Segment *seg;
+
+    ASSERT(lock->IsHeldByCurrentThread());
+    hdr->seq = seq;
+    hdr->ack = recvNext;
+    hdr->length = 0;
+    hdr->flags = 0;
+    if (seq >= 0) {
+	seg = &sent[seq % MaxWindow];
+	hdr->length = seg->length;
+	MemCopy(mail.data + sizeof(SegmentHeader), seg->data, seg->length);
+	if (again) {
+	    seg->retransmitted = TRUE;
+	    numRetransmits++;
+	} else {
+	    seg->sentAt = kernel->stats->totalTicks;
+	    seg->retransmitted = FALSE;
+	}
+    }
+    DEBUG(dbgNet, "Transport send seq " << seq << " ack " << hdr->ack
+		<< " bytes " << hdr->length << (again ? " again" : ""));
+
+    mail.pktHdr.to = host;
+    mail.mailHdr.to = remote;
+    mail.mailHdr.from = local;
+    mail.mailHdr.length = sizeof(SegmentHeader) + hdr->length;
+
+    lock->Release();
+    kernel->postOfficeOut->Send(&mail);
+    lock->Acquire();
+}
+
+//----------------------------------------------------------------------
+// Connection::Write
+// 	Cut the data into segments and send them, waiting whenever
+//	"window" segments are outstanding.  Returns once the last one
+//	has been sent, not acknowledged; see Flush.
+//
+//	"data" -- the bytes to send
+//	"size" -- how many
+//----------------------------------------------------------------------
+
+void
+Connection::Write(char *data, int size)
+{
+    Segment *seg;
+    int seq;
+
+    lock->Acquire();
+    while (size > 0) {
+	while (nextSeq - sendBase >= window)
+	    windowOpen->Wait(lock);
+	seq = nextSeq++;
+	seg = &sent[seq % MaxWindow];
+	seg->length = min(size, (int) MaxSegmentData);
+	MemCopy(seg->data, data, seg->length);
+	data += seg->length;
+	size -= seg->length;
+	if (seq == sendBase) {		// nothing was being timed
+	    timerStart = kernel->stats->totalTicks;
+	    outstanding->Signal(lock);
+	}
+	Transmit(seq, FALSE);
+    }
+    lock->Release();
+}
+
+//----------------------------------------------------------------------
+// Connection::Flush
+// 	Wait until every segment written has been acknowledged.
+//----------------------------------------------------------------------
+
+void
+Connection::Flush()
+{
+    lock->Acquire();
+    while (sendBase != nextSeq)
+	allAcked->Wait(lock);
+    lock->Release();
+}
+
+//----------------------------------------------------------------------
+// Connection::Read
+// 	Wait until some of the stream has arrived, then copy out as much
+//	of it as will fit.  Making room may let segments that were held
+//	back be delivered; if so, tell the other end.
+//
+//	"data" -- where to put the bytes
+//	"size" -- the most to return
+//----------------------------------------------------------------------
+
+int
+Connection::Read(char *data, int size)
+{
+    int n, chunk;
+
+    lock->Acquire();
+    while (numBuffered == 0)
+	dataReady->Wait(lock);
+    n = min(size, numBuffered);
+    for (int done = 0; done < n; done += chunk) {
+	chunk = min(n - done, StreamBufferSize - streamHead);
+	MemCopy(data + done, stream + streamHead, chunk);
+	streamHead = (streamHead + chunk) % StreamBufferSize;
+    }
+    numBuffered -= n;
+    if (Deliver())
+	Transmit(-1, FALSE);
+    lock->Release();
+    return n;
+}
+
+//----------------------------------------------------------------------
+// Connection::Deliver
+// 	Move segments that are next in order from the arrival window to
+//	the stream buffer, as long as there is room for them.  Returns
+//	TRUE if any were moved.
+//----------------------------------------------------------------------
+
+bool
+Connection::Deliver()
+{
+    Segment *seg;
+    int tail, chunk;
+    bool moved = FALSE;
+
+    for (;;) {
+	seg = &arrived[recvNext % MaxWindow];
+	if (!seg->present || seg->length > StreamBufferSize - numBuffered)
+	    break;
+	tail = (streamHead + numBuffered) % StreamBufferSize;
+	chunk = min(seg->length, StreamBufferSize - tail);
+	MemCopy(stream + tail, seg->data, chunk);
+	MemCopy(stream, seg->data + chunk, seg->length - chunk);
+	numBuffered += seg->length;
+	seg->present = FALSE;
+	recvNext++;
+	moved = TRUE;
+    }
+    if (moved)
+	dataReady->Broadcast(lock);
+    return moved;
+}
+
+//----------------------------------------------------------------------
+// Connection::GotData
+// 	Keep an arrived segment, if it is within the window and we
+//	don't have it already, and deliver what it completes.
+//
+//	"hdr" -- the segment's transport header
+//	"data" -- its data
+//----------------------------------------------------------------------
+
+void
+Connection::GotData(SegmentHeader *hdr, char *data)
+{
+    Segment *seg;
+    int offset = hdr->seq - recvNext;
+
+    if (offset < 0 || offset >= MaxWindow)
+	return;				// a duplicate, or too far ahead
+    seg = &arrived[hdr->seq % MaxWindow];
+    if (seg->present)
+	return;
+    seg->length = hdr->length;
+    MemCopy(seg->data, data, hdr->length);
+    seg->present = TRUE;
+    Deliver();
+}
+
+//----------------------------------------------------------------------
+// Connection::Measure
+// 	Update the round trip time estimate with a new sample, and
+//	recompute the retransmission timeout (RFC 6298, section 2).
+//
+//	"rtt" -- the measured round trip time, in ticks
+//----------------------------------------------------------------------
+
+void
+Connection::Measure(int rtt)
+{
+    if (srtt < 0) {
+	srtt = rtt;
+	rttvar = rtt / 2;
+    } else {
+	rttvar = (3 * rttvar + abs(srtt - rtt)) / 4;
+	srtt = (7 * srtt + rtt) / 8;
+    }
+    rto = srtt + max(TimerTicks, 4 * rttvar);
+    rto = min(max(rto, MinRto), MaxRto);
+}
+
+//----------------------------------------------------------------------
+// Connection::GotAck
+// 	Process an acknowledgement of every segment before "ack".
+//
+//	An ACK of new data slides the window, measures the round trip
+//	of the newest segment it covers (unless that was retransmitted),
+//	and restarts the timer.  A bare ACK that repeats the last one
+//	means a later segment arrived without the oldest; after
+//	DupAckThreshold of them, retransmit it without waiting.
+//
+//	"ack" -- the next segment the other end needs
+//	"bare" -- did the ACK come without data?
+//----------------------------------------------------------------------
+
+void
+Connection::GotAck(int ack, bool bare)
+{
+    Segment *newest;
+
+    if (ack - sendBase > 0 && ack - nextSeq <= 0) {
+	newest = &sent[(ack - 1) % MaxWindow];
+	if (!newest->retransmitted)
+	    Measure(kernel->stats->totalTicks - newest->sentAt);
+	sendBase = ack;
+	dupAcks = 0;
+	timerStart = kernel->stats->totalTicks;
+	windowOpen->Broadcast(lock);
+	if (sendBase == nextSeq)
+	    allAcked->Broadcast(lock);
+    } else if (ack == sendBase && bare && sendBase != nextSeq) {
+	if (++dupAcks == DupAckThreshold) {
+	    DEBUG(dbgNet, "Transport fast retransmit of " << sendBase);
+	    timerStart = kernel->stats->totalTicks;
+	    Transmit(sendBase, TRUE);
+	}
+    }
+}
+
+//----------------------------------------------------------------------
+// Connection::Receiver
+// 	Thread that takes messages out of our mailbox: process the ACK
+//	each one carries, keep its data, and acknowledge any data.
+//	Messages are read where they arrived, and released after.
+//----------------------------------------------------------------------
+
+void
+Connection::Receiver(void *arg)
+{
+    Connection *_this = (Connection *) arg;
+    Mail *mail;
+    SegmentHeader *hdr;
+
+    for (;;) {
+	mail = kernel->postOfficeIn->Receive(_this->local);
+	hdr = (SegmentHeader *) mail->data;
+	if (mail->pktHdr.from != _this->host
+		|| mail->mailHdr.from != _this->remote
+		|| mail->mailHdr.length < sizeof(SegmentHeader)
+		|| hdr->length != mail->mailHdr.length - sizeof(SegmentHeader)) {
+	    kernel->postOfficeIn->Release(mail);
+	    continue;			// not for this connection
+	}
+	DEBUG(dbgNet, "Transport got seq " << hdr->seq << " ack "
+		<< hdr->ack << " bytes " << hdr->length);
+
+	_this->lock->Acquire();
+	_this->GotAck(hdr->ack, hdr->length == 0);
+	if (hdr->length > 0) {
+	    _this->GotData(hdr, mail->data + sizeof(SegmentHeader));
+	    kernel->postOfficeIn->Release(mail);
+	    _this->Transmit(-1, FALSE);	// always ACK data, so that a
+					// gap shows up as duplicates
+	} else {
+	    kernel->postOfficeIn->Release(mail);
+	}
+	_this->lock->Release();
+    }
+}
+
+//----------------------------------------------------------------------
+// Connection::Retransmitter
+// 	Thread that waits for the retransmission timer.  With nothing
+//	outstanding there is nothing to time; otherwise sleep until the
+//	timer should run out, and if it has (an ACK may have restarted
+//	it meanwhile), retransmit the oldest segment and back off.
+//----------------------------------------------------------------------
+
+void
+Connection::Retransmitter(void *arg)
+{
+    Connection *_this = (Connection *) arg;
+    int left;
+
+    _this->lock->Acquire();
+    for (;;) {
+	if (_this->sendBase == _this->nextSeq) {
+	    _this->outstanding->Wait(_this->lock);
+	    continue;
+	}
+	left = _this->timerStart + _this->rto - kernel->stats->totalTicks;
+	if (left > 0) {
+	    _this->lock->Release();
+	    kernel->alarm->WaitUntil(left);
+	    _this->lock->Acquire();
+	    continue;
+	}
+	DEBUG(dbgNet, "Transport timeout, retransmit " << _this->sendBase);
+	_this->rto = min(2 * _this->rto, MaxRto);
+	_this->dupAcks = 0;
+	_this->timerStart = kernel->stats->totalTicks;
+	_this->Transmit(_this->sendBase, TRUE);
+    }
+}
@@ -0,0 +1,147 @@
+// transport.h
+//	Data structures for a reliable, ordered byte stream between
+//	mailboxes on two machines, built on the (unreliable) post office.
+//
+//	The stream is cut into segments, each sent as one message.
+//	Segments are numbered; the sender may have up to "window" of
+//	them outstanding before it waits for acknowledgements, so
+//	throughput grows with the window rather than being one segment
+//	per round trip.
+//
+//	The receiver keeps segments that arrive out of order, and
+//	acknowledges every segment with the number of the next one it
+//	needs (a cumulative ACK).  The sender retransmits the oldest
+//	unacknowledged segment when its retransmission timer expires,
+//	or at once when three duplicate ACKs show that it was lost but
+//	later ones got through (fast retransmit).
+//
+//	The retransmission timeout is estimated from measured round trip
+//	times as in TCP (RFC 6298): a smoothed RTT plus four times its
+//	mean deviation, doubled on every timeout.  Segments that have
+//	been retransmitted are not measured, since we can't tell which
+//	copy was acknowledged (Karn's rule).
+//
+//	Each end is a Connection, naming a mailbox of its own (which it
+//	must be the only one to use) and the mailbox at the other end.
+//
+// Copyright (c) 1992-1996 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#ifndef TRANSPORT_H
+#define TRANSPORT_H
+
+#include "copyright.h"
+#include "utility.h"
+#include "post.h"
+#include "synch.h"
+
+// The following class defines the transport header, prepended to the
+// data of every segment.
+
+class SegmentHeader {
+  public:
+    int seq;			// number of this segment
+    int ack;			// next segment the sender expects
+    unsigned short length;	// bytes of data; 0 for a bare ACK
+    unsigned short flags;	// unused, must be 0
+};
+
+// Data in a single segment, after the transport header
+
+#define MaxSegmentData	(MaxMailSize - sizeof(SegmentHeader))
+
+// The most segments that can be outstanding, or buffered out of order
+
+const int MaxWindow = 32;
+
+// Bytes received in order, waiting for Read
+
+const int StreamBufferSize = MaxWindow * MaxSegmentData;
+
+// Bounds on the retransmission timeout, in ticks
+
+const int InitialRto = 2000;
+const int MinRto = 4 * NetworkTime;
+const int MaxRto = 64000;
+
+// Duplicate ACKs that trigger a fast retransmit
+
+const int DupAckThreshold = 3;
+
+// A segment that has been sent, or has arrived out of order
+
+class Segment {
+  public:
+    int length;			// bytes of data
+    char data[MaxSegmentData];
+    int sentAt;			// when it was first sent
+    bool retransmitted;		// has it been sent more than once?
+    bool present;		// for arrived segments: is the slot full?
+};
+
+// The following class defines one end of a stream.
+
+class Connection {
+  public:
+    Connection(int localBox, int remoteHost, int remoteBox, int window);
+				// Open our end of a stream; the other
+				// machine must open its end with the
+				// boxes the other way round
+    ~Connection();		// De-allocate the connection
+
+    void Write(char *data, int size);
+				// Send "size" bytes; wait while the
+				// window is full
+    int Read(char *data, int size);
+				// Wait for at least one byte, then
+				// return up to "size" of them
+    void Flush();		// Wait until everything written has
+				// been acknowledged
+
+    int NumRetransmits() { return numRetransmits; }
+    int Rto() { return rto; }	// current retransmission timeout
+
+  private:
+    static void Receiver(void *arg);	// thread: take segments and
+					// ACKs out of our mailbox
+    static void Retransmitter(void *arg);
+					// thread: retransmit on timeout
+
+    void Transmit(int seq, bool again);
+				// send segment "seq", or a bare ACK if
+				// it is -1; lock must be held
+    void GotAck(int ack, bool bare);	// process an acknowledgement
+    void GotData(SegmentHeader *hdr, char *data);
+				// keep an arrived segment
+    bool Deliver();		// move in-order segments to the stream
+    void Measure(int rtt);	// update the RTT estimate
+
+    int local, host, remote;	// our mailbox, the other end's address
+    int window;			// most segments outstanding
+    Lock *lock;			// protects everything below
+    Condition *windowOpen;	// signalled when a segment is acked
+    Condition *allAcked;	// signalled when none are outstanding
+    Condition *outstanding;	// signalled when there is one to time
+    Condition *dataReady;	// signalled when bytes can be read
+
+    // send side
+    Segment sent[MaxWindow];	// sent[seq % MaxWindow]
+    int sendBase;		// oldest unacknowledged segment
+    int nextSeq;		// next segment to send
+    int timerStart;		// when the retransmission timer started
+    int dupAcks;		// duplicate ACKs of sendBase in a row
+    int srtt, rttvar;		// smoothed RTT and its deviation, in
+				// ticks; srtt < 0 before the first sample
+    int rto;			// retransmission timeout, in ticks
+    int numRetransmits;		// for statistics
+
+    // receive side
+    Segment arrived[MaxWindow];	// arrived[seq % MaxWindow]
+    int recvNext;		// next segment needed in order
+    char stream[StreamBufferSize];	// bytes in order, not yet read
+    int streamHead;		// first byte to read
+    int numBuffered;		// bytes waiting to be read
+};
+
+#endif // TRANSPORT_H
@@ -0,0 +1,90 @@
+/* futex.c
+ *	Simple program to test the user-level locks of usync.c.
+ *
+ *	Three threads each add to a counter 20 times, yielding while
+ *	they hold the lock, so the others have to wait for it in the
+ *	kernel; it should print 60.  Then main hands the numbers 1 to 10
+ *	to a thread through a one-slot buffer, with a condition variable;
+ *	the thread should print their sum, 55.
+ */
+
+#include "syscall.h"
+#include "usync.h"
+
+#define NumThreads	3
+#define Rounds		20
+
+Mutex lock;
+CondVar changed;
+int counter;
+
+int slot, full, done;
+
+int
+Adder()
+{
+  int i, c;
+
+  for (i = 0; i < Rounds; i++) {
+    MutexLock(&lock);
+    c = counter;
+    ThreadYield();		/* let the others find the lock held */
+    counter = c + 1;
+    MutexUnlock(&lock);
+  }
+  return 0;
+}
+
+int
+Consumer()
+{
+  int sum = 0;
+
+  MutexLock(&lock);
+  for (;;) {
+    while (!full && !done)
+      CondWait(&changed, &lock);
+    if (!full)
+      break;
+    sum += slot;
+    full = 0;
+    CondBroadcast(&changed);
+  }
+  MutexUnlock(&lock);
+  PrintInt(sum);
+  return sum;
+}
+
+int
+main()
+{
+  ThreadId id[NumThreads];
+  int t, i;
+
+  MutexInit(&lock);
+  CondInit(&changed);
+  for (t = 0; t < NumThreads; t++)
+    id[t] = ThreadFork((void (*)()) Adder);
+  for (t = 0; t < NumThreads; t++)
+    ThreadJoin(id[t]);
+  PrintInt(counter);
+
+  id[0] = ThreadFork((void (*)()) Consumer);
+  for (i = 1; i <= 10; i++) {
+    MutexLock(&lock);
+    while (full)
+      CondWait(&changed, &lock);
+    slot = i;
+    full = 1;
+    CondSignal(&changed);
+    MutexUnlock(&lock);
+  }
+  MutexLock(&lock);
+  while (full)
+    CondWait(&changed, &lock);
+  done = 1;
+  CondSignal(&changed);
+  MutexUnlock(&lock);
+  ThreadJoin(id[0]);
+  return 0;
+}
@@ -0,0 +1,39 @@
+/* mail.c
+ *	Simple program to test the MailSend and MailRecv system calls.
+ *
+ *	Sends itself messages of 1 to 10 bytes through mailbox 1, on
+ *	machine 0 (run it there, with "-m 0", the default, and perhaps
+ *	-wire), and checks each one as it comes back; it should print
+ *	10, the number that came back right.  Then a message into a
+ *	buffer that is too small should be cut short: it prints 4.
+ */
+
+#include "syscall.h"
+
+#define Host	0
+#define Box	1
+
+char out[40], in[40];
+
+int
+main()
+{
+  int i, j, n, right = 0;
+
+  for (i = 1; i <= 10; i++) {
+    for (j = 0; j < i; j++)
+      out[j] = i + j;
+    if (MailSend(Host, Box, out, i) != i)
+      continue;
+    n = MailRecv(Box, in, sizeof(in));
+    for (j = 0; j < n && in[j] == out[j]; j++)
+      ;
+    if (n == i && j == n)
+      right++;
+  }
+  PrintInt(right);
+
+  MailSend(Host, Box, out, 10);
+  PrintInt(MailRecv(Box, in, 4));
+  return 0;
+}
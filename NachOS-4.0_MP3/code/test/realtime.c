@@ -0,0 +1,34 @@
+/* realtime.c
+ *	Simple program to test the real-time scheduling class.
+ *
+ *	First ask for more than a whole CPU, which should be refused
+ *	(prints -1).  Then become a periodic task: a job every 1000
+ *	ticks, with a budget of 300, printing each job's number as it
+ *	finishes.  Run it next to other programs: every job should still
+ *	make its deadline (see the "Real-time:" line of the statistics).
+ */
+
+#include "syscall.h"
+
+#define NumJobs		10
+#define Work		20
+
+int
+main()
+{
+  int job, i, sum;
+
+  PrintInt(RealTime(1000, 1200, 0));
+  if (RealTime(1000, 300, 0) < 0) {
+    PrintInt(-2);
+    Halt();
+  }
+  for (job = 1; job <= NumJobs; job++) {
+    for (sum = 0, i = 0; i < Work; i++)
+      sum += i;
+    PrintInt(job);
+    NextPeriod();
+  }
+  Halt();
+  /* not reached */
+}
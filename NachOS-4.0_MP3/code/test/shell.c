@@ -4,9 +4,9 @@ int
 main()
 {
     SpaceId newProc;
-    OpenFileId input = ConsoleInput;
-    OpenFileId output = ConsoleOutput;
-    char prompt[2], ch, buffer[60];
+    OpenFileId input = SysConsoleInput;
+    OpenFileId output = SysConsoleOutput;
+    char prompt[2], buffer[60];
     int i;
 
     prompt[0] = '-';
@@ -16,15 +16,12 @@ main()
     {
 	Write(prompt, 2, output);
 
-	i = 0;
-	
-	do {
-	
-	    Read(&buffer[i], 1, input); 
-
-	} while( buffer[i++] != '\n' );
-
-	buffer[--i] = '\0';
+	i = Read(buffer, sizeof(buffer) - 1, input);	/* a whole line */
+	if( i == 0 )
+		Halt();		/* end of the input */
+	if( buffer[i - 1] == '\n' )
+		i--;
+	buffer[i] = '\0';
 
 	if( i > 0 ) {
 		newProc = Exec(buffer);
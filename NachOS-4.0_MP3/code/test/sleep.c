@@ -0,0 +1,22 @@
+/* sleep.c
+ *	Simple program to test the Sleep system call.
+ *
+ *	Sleep for increasing lengths of time, printing a number each
+ *	time we wake up.
+ *
+ */
+
+#include "syscall.h"
+
+int
+main()
+{
+  int i;
+
+  for (i = 1; i <= 5; i++) {
+    Sleep(i * 1000);
+    PrintInt(i);
+  }
+  Halt();
+  /* not reached */
+}
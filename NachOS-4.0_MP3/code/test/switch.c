@@ -0,0 +1,41 @@
+/* switch.c
+ *	Context switch microbenchmark.
+ *
+ *	First sleep repeatedly: with no other thread to run, the machine
+ *	idles and this thread is switched back in with its registers
+ *	still loaded, so none should be copied.  Then a forked thread and
+ *	this one yield to each other, which copies the registers on every
+ *	switch.  Compare "Context switches" and "user register copies"
+ *	in the statistics printed at halt, and time the run on the host.
+ */
+
+#include "syscall.h"
+
+#define NumSwitches	1000
+
+int
+Yielder()
+{
+  int i;
+
+  for (i = 0; i < NumSwitches; i++)
+    ThreadYield();
+  return 0;
+}
+
+int
+main()
+{
+  int i;
+  ThreadId id;
+
+  for (i = 0; i < NumSwitches; i++)
+    Sleep(1);
+
+  id = ThreadFork((void (*)()) Yielder);
+  for (i = 0; i < NumSwitches; i++)
+    ThreadYield();
+  ThreadJoin(id);
+  Halt();
+  /* not reached */
+}
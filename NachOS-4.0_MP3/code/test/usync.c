@@ -0,0 +1,83 @@
+/* usync.c
+ *	User-level locks and condition variables; see usync.h.
+ *
+ *	The lock is the three-state futex mutex: a thread that finds it
+ *	held marks it contended (2) before sleeping, so the holder knows
+ *	to call FutexWake when it gives it back, and a thread woken up
+ *	takes it as contended too, since others may still be asleep.
+ */
+
+#include "usync.h"
+
+#define WakeAll		0x7fffffff
+
+void
+MutexInit(Mutex *m)
+{
+  m->state = 0;
+}
+
+void
+MutexLock(Mutex *m)
+{
+  int c = CompareAndSwap(&m->state, 0, 1);
+
+  if (c == 0)
+    return;			/* it was free: no system call */
+  do {
+    if (c == 2 || CompareAndSwap(&m->state, 1, 2) != 0)
+      FutexWait((int *) &m->state, 2);
+  } while ((c = CompareAndSwap(&m->state, 0, 2)) != 0);
+}
+
+void
+MutexUnlock(Mutex *m)
+{
+  if (CompareAndSwap(&m->state, 1, 0) == 1)
+    return;			/* no one waiting: no system call */
+  m->state = 0;
+  FutexWake((int *) &m->state, 1);
+}
+
+void
+CondInit(CondVar *c)
+{
+  c->seq = 0;
+}
+
+void
+CondWait(CondVar *c, Mutex *m)
+{
+  int seq = c->seq;
+
+  MutexUnlock(m);
+  FutexWait((int *) &c->seq, seq);	/* returns at once if signalled
+					   since we looked */
+  MutexLock(m);
+}
+
+/* Count a signal; a waiter that hasn't gone to sleep yet then won't */
+
+static void
+NextSeq(CondVar *c)
+{
+  int seq;
+
+  do
+    seq = c->seq;
+  while (CompareAndSwap(&c->seq, seq, seq + 1) != seq);
+}
+
+void
+CondSignal(CondVar *c)
+{
+  NextSeq(c);
+  FutexWake((int *) &c->seq, 1);
+}
+
+void
+CondBroadcast(CondVar *c)
+{
+  NextSeq(c);
+  FutexWake((int *) &c->seq, WakeAll);
+}
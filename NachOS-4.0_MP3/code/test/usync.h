@@ -0,0 +1,44 @@
+/* usync.h
+ *	Locks and condition variables for the threads of a user program,
+ *	built on CompareAndSwap (start.S) and the futex system calls.
+ *
+ *	Taking a lock no one holds, and giving back one no one is waiting
+ *	for, are a CompareAndSwap each, with no system call; only a
+ *	thread that has to wait goes into the kernel, with FutexWait, and
+ *	only then does the one giving the lock back call FutexWake.
+ *
+ *	A Mutex's word is 0 when it is free, 1 when it is held, and 2
+ *	when it is held and someone may be waiting for it.  A CondVar's
+ *	word counts the signals, so that a waiter that has given back the
+ *	lock but not yet gone to sleep sees that a signal came in between,
+ *	and doesn't sleep through it.
+ */
+
+#ifndef USYNC_H
+#define USYNC_H
+
+#include "syscall.h"
+
+typedef struct {
+  volatile int state;		/* 0 free, 1 held, 2 held and contended */
+} Mutex;
+
+typedef struct {
+  volatile int seq;		/* signals so far */
+} CondVar;
+
+/* If *addr holds "old", replace it with "new"; either way, return
+ * what it held.  Atomic with respect to every other thread.
+ */
+int CompareAndSwap(volatile int *addr, int old, int new);
+
+void MutexInit(Mutex *m);
+void MutexLock(Mutex *m);
+void MutexUnlock(Mutex *m);
+
+void CondInit(CondVar *c);
+void CondWait(CondVar *c, Mutex *m);	/* give back m, wait, retake m */
+void CondSignal(CondVar *c);		/* wake one waiter, if any */
+void CondBroadcast(CondVar *c);		/* wake them all */
+
+#endif /* USYNC_H */
@@ -0,0 +1,98 @@
+/* uthreads.c
+ *	Simple program to test user-level threads.
+ *
+ *	Three threads take turns printing, switched by the program
+ *	itself from a run queue kept here, with no system calls.
+ *	Then a thread is forked in the kernel, and joined; it should
+ *	print 55 as its exit code.
+ */
+
+#include "syscall.h"
+
+#define NumThreads	3
+#define StackWords	128
+#define Main		NumThreads	/* the thread main runs in */
+
+UserContext context[NumThreads + 1];
+int stack[NumThreads][StackWords];
+
+int queue[NumThreads + 1];		/* threads waiting for their turn */
+int head, numQueued;
+int current = Main;
+int numRunning;
+
+void
+Enqueue(int t)
+{
+  queue[(head + numQueued++) % (NumThreads + 1)] = t;
+}
+
+int
+Dequeue()
+{
+  int t = queue[head];
+
+  head = (head + 1) % (NumThreads + 1);
+  numQueued--;
+  return t;
+}
+
+/* Switch to the next thread in the run queue.  If "requeue", the
+ * current thread goes on the end of it; otherwise it is finished.
+ */
+void
+Switch(int requeue)
+{
+  int from = current;
+
+  if (requeue)
+    Enqueue(from);
+  current = Dequeue();
+  UserSwitch(&context[from], &context[current]);
+}
+
+void
+Worker()
+{
+  int i;
+
+  for (i = 0; i < 3; i++) {
+    PrintInt(current * 10 + i);
+    Switch(1);
+  }
+  numRunning--;
+  Switch(0);
+  /* not reached */
+}
+
+int
+Sum()
+{
+  int i, sum = 0;
+
+  for (i = 1; i <= 10; i++) {
+    sum += i;
+    ThreadYield();
+  }
+  return sum;
+}
+
+int
+main()
+{
+  int t;
+  ThreadId id;
+
+  for (t = 0; t < NumThreads; t++) {
+    context[t].regs[UserSP] = (int) &stack[t][StackWords - 4];
+    context[t].regs[UserRA] = (int) Worker;
+    Enqueue(t);
+    numRunning++;
+  }
+  while (numRunning > 0)
+    Switch(1);
+
+  id = ThreadFork((void (*)()) Sum);
+  PrintInt(ThreadJoin(id));
+  return 0;
+}
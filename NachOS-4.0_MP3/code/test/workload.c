@@ -0,0 +1,35 @@
+/* workload.c
+ *	One job of a synthetic workload (see threads/workload.h).  The
+ *	kernel passes the job's kind and bursts as the arguments to main.
+ *
+ *	Run "bursts" CPU bursts of "burst" loop iterations each.  After
+ *	each one, an I/O-bound job prints "pause" numbers on the console,
+ *	and an interactive job sleeps for "pause" ticks; a CPU-bound job
+ *	goes straight on to the next.
+ */
+
+#include "syscall.h"
+
+#define CpuBound	0	/* the kinds, as in threads/workload.h */
+#define IoBound		1
+#define Interactive	2
+
+volatile int work;		/* so the loops aren't optimized away */
+
+int
+main(int kind, int burst, int bursts, int pause)
+{
+  int b, i;
+
+  for (b = 0; b < bursts; b++) {
+    for (i = 0; i < burst; i++)
+      work++;
+    if (kind == IoBound) {
+      for (i = 0; i < pause; i++)
+        PrintInt(b);
+    } else if (kind == Interactive) {
+      Sleep(pause);
+    }
+  }
+  Exit(0);
+}
@@ -1,8 +1,7 @@
 // alarm.cc
 //	Routines to use a hardware timer device to provide a
-//	software alarm clock.  For now, we just provide time-slicing.
-//
-//	Not completely implemented.
+//	software alarm clock: time-slicing, and waking up threads
+//	that have asked to sleep for a while.
 //
 // Copyright (c) 1992-1996 The Regents of the University of California.
 // All rights reserved.  See copyright.h for copyright notice and limitation 
@@ -18,11 +17,19 @@
 //
 //      "doRandom" -- if true, arrange for the hardware interrupts to 
 //		occur at random, instead of fixed, intervals.
+//	"isTickless" -- if true, don't interrupt while nothing is
+//		runnable, except to wake up sleeping threads
+//	"isOneShot" -- if true, don't interrupt every TimerTicks, only
+//		when a slice ends or a sleeping thread is due (see
+//		Reprogram); -rs then has no effect on the timer
 //----------------------------------------------------------------------
 
-Alarm::Alarm(bool doRandom)
+Alarm::Alarm(bool doRandom, bool isTickless, bool isOneShot)
 {
-    timer = new Timer(doRandom, this);
+    tickless = isTickless;
+    oneShot = isOneShot;
+    sleepers = new SleepQueue;
+    timer = new Timer(doRandom, this, oneShot);
 }
 
 //----------------------------------------------------------------------
@@ -39,8 +46,17 @@ Alarm::Alarm(bool doRandom)
 //	if the interrupted thread called Yield at the point it is 
 //	was interrupted.
 //
-//	For now, just provide time-slicing.  Only need to time slice 
-//      if we're currently running something (in other words, not idle).
+//	Wake up every sleeping thread that is due.  Then time-slice:
+//	only need to time slice if we're currently running something
+//	(in other words, not idle).  Every CPU running a round-robin
+//	(L3) thread is asked to switch.
+//
+//	In tickless mode, if the machine is idle and nothing has become
+//	ready, there is nothing to time-slice: the next interrupt is put
+//	off until the next sleeping thread is due, if there is one, so
+//	the clock can jump straight to the next real event.  With a
+//	one-shot timer, the timer is then set for the next thing due,
+//	which does the same and more.
 //----------------------------------------------------------------------
 
 void 
@@ -48,10 +64,190 @@ Alarm::CallBack()
 {
     Interrupt *interrupt = kernel->interrupt;
     MachineStatus status = interrupt->getStatus();
+    Thread *thread;
+
+    while ((thread = sleepers->RemoveDue(kernel->stats->totalTicks)) != NULL)
+	kernel->scheduler->ReadyToRun(thread);
     
     if (status != IdleMode) {
-       if(kernel->currentThread->getPriority() < 50) {
-         interrupt->YieldOnReturn();
-       }
+       kernel->scheduler->TimeSlice();
+    } else if (tickless && !oneShot && !kernel->scheduler->AnyReady()) {
+       timer->Suspend(sleepers->IsEmpty() ? 0 :
+			sleepers->NextWake() - kernel->stats->totalTicks);
+    }
+    Reprogram();
+}
+
+//----------------------------------------------------------------------
+// Alarm::Resume
+//	Called when the machine stops idling.  In tickless mode, if a
+//	thread has become ready, start time-slicing again; with a
+//	one-shot timer, set it for whatever is now due first.
+//----------------------------------------------------------------------
+
+void
+Alarm::Resume()
+{
+    if (oneShot)
+	Reprogram();
+    else if (tickless && kernel->scheduler->AnyReady())
+	timer->Resume();
+}
+
+//----------------------------------------------------------------------
+// Alarm::Reprogram
+//	With a one-shot timer, set it for the next thing due: the end of
+//	a time slice (see Scheduler::NextSliceDue), or the next sleeping
+//	thread, whichever is first; or for nothing, if no thread is
+//	running or asleep.  Called at each timer interrupt, each time a
+//	thread is dispatched, and each time one goes to sleep.
+//----------------------------------------------------------------------
+
+void
+Alarm::Reprogram()
+{
+    int now = kernel->stats->totalTicks;
+    int next;
+
+    if (!oneShot)
+	return;
+    next = kernel->scheduler->NextSliceDue();
+    if (!sleepers->IsEmpty() && (next == -1 || sleepers->NextWake() < next))
+	next = sleepers->NextWake();
+    timer->SetNext((next == -1) ? 0 : max(next - now, 1));
+}
+
+//----------------------------------------------------------------------
+// Alarm::WaitUntil
+// 	Suspend the current thread for at least "x" ticks.  It is woken
+//	up by the first timer interrupt at or after that time, so it may
+//	sleep up to TimerTicks longer (with a one-shot timer, not at all).
+//
+//	"x" -- how long to sleep; nothing happens if it isn't positive
+//----------------------------------------------------------------------
+
+void
+Alarm::WaitUntil(int x)
+{
+    IntStatus oldLevel;
+
+    if (x <= 0)
+	return;
+    oldLevel = kernel->interrupt->SetLevel(IntOff);
+    DEBUG(dbgThread, "Thread " << kernel->currentThread->getName()
+		<< " sleeping for " << x << " ticks");
+    sleepers->Insert(kernel->currentThread, kernel->stats->totalTicks + x);
+    Reprogram();			// it may be the first due
+    kernel->currentThread->Sleep(FALSE);
+    (void) kernel->interrupt->SetLevel(oldLevel);
+}
+
+//----------------------------------------------------------------------
+// Alarm::WakeAt
+// 	Hold a thread that is neither running nor ready -- a real-time
+//	thread out of budget -- until time "when", as if it had called
+//	WaitUntil.  It has already been marked BLOCKED.
+//----------------------------------------------------------------------
+
+void
+Alarm::WakeAt(Thread *thread, int when)
+{
+    ASSERT(kernel->interrupt->getLevel() == IntOff);
+    ASSERT(thread->getStatus() == BLOCKED);
+    DEBUG(dbgThread, "Thread " << thread->getName() << " held until " << when);
+    sleepers->Insert(thread, when);
+    Reprogram();
+}
+
+//----------------------------------------------------------------------
+// SleepQueue::SleepQueue
+// 	Initialize an empty queue.  The heap grows as threads are added.
+//----------------------------------------------------------------------
+
+SleepQueue::SleepQueue()
+{
+    size = 16;
+    heap = new Sleeper[size];
+    numSleeping = 0;
+}
+
+//----------------------------------------------------------------------
+// SleepQueue::~SleepQueue
+// 	De-allocate the queue.
+//----------------------------------------------------------------------
+
+SleepQueue::~SleepQueue()
+{
+    delete [] heap;
+}
+
+//----------------------------------------------------------------------
+// SleepQueue::Swap
+// 	Exchange two heap entries.
+//----------------------------------------------------------------------
+
+void
+SleepQueue::Swap(int a, int b)
+{
+    Sleeper tmp = heap[a];
+
+    heap[a] = heap[b];
+    heap[b] = tmp;
+}
+
+//----------------------------------------------------------------------
+// SleepQueue::Insert
+// 	Add a thread that is to wake at "when", and sift it up to its
+//	place.
+//----------------------------------------------------------------------
+
+void
+SleepQueue::Insert(Thread *thread, int when)
+{
+    int i, parent;
+
+    if (numSleeping == size) {
+	Sleeper *bigger = new Sleeper[size * 2];
+	for (i = 0; i < numSleeping; i++)
+	    bigger[i] = heap[i];
+	delete [] heap;
+	heap = bigger;
+	size *= 2;
+    }
+    i = numSleeping++;
+    heap[i].thread = thread;
+    heap[i].when = when;
+    while (i > 0) {
+	parent = (i - 1) / 2;
+	if (heap[parent].when <= heap[i].when)
+	    break;
+	Swap(i, parent);
+	i = parent;
+    }
+}
+
+//----------------------------------------------------------------------
+// SleepQueue::RemoveDue
+// 	If the earliest thread is due to wake by "now", take it off the
+//	heap and return it; otherwise return NULL.
+//----------------------------------------------------------------------
+
+Thread *
+SleepQueue::RemoveDue(int now)
+{
+    Thread *due;
+    int i, child;
+
+    if (numSleeping == 0 || heap[0].when > now)
+	return NULL;
+    due = heap[0].thread;
+    heap[0] = heap[--numSleeping];
+    for (i = 0; (child = 2 * i + 1) < numSleeping; i = child) {
+	if (child + 1 < numSleeping && heap[child + 1].when < heap[child].when)
+	    child++;
+	if (heap[i].when <= heap[child].when)
+	    break;
+	Swap(i, child);
     }
+    return due;
 }
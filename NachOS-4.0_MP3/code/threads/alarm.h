@@ -8,7 +8,9 @@
 //	From this, we provide the ability for a thread to be
 //	woken up after a delay; we also provide time-slicing.
 //
-//	NOTE: this abstraction is not completely implemented.
+//	Sleeping threads are kept in a heap ordered by the time they
+//	are to wake up, so each timer interrupt only looks at the
+//	threads that are due.
 //
 // Copyright (c) 1992-1996 The Regents of the University of California.
 // All rights reserved.  See copyright.h for copyright notice and limitation 
@@ -22,19 +24,68 @@
 #include "callback.h"
 #include "timer.h"
 
+class Thread;
+
+// One thread waiting in Alarm::WaitUntil
+
+class Sleeper {
+  public:
+    Thread *thread;
+    int when;			// tick at which to wake it up
+};
+
+// The following class defines a set of sleeping threads, ordered
+// by wake-up time.  It is a binary heap, so adding a thread and
+// taking off the next one due are O(log n).
+
+class SleepQueue {
+  public:
+    SleepQueue();		// initialize an empty queue
+    ~SleepQueue();		// de-allocate the queue
+
+    void Insert(Thread *thread, int when);
+				// thread is to wake at "when"
+    Thread *RemoveDue(int now);	// take off a thread due by "now",
+				// or return NULL if none is
+    bool IsEmpty() { return numSleeping == 0; }
+    int NextWake() { return heap[0].when; }
+				// when the next thread is due; the
+				// queue must not be empty
+
+  private:
+    void Swap(int a, int b);
+
+    Sleeper *heap;		// heap[0] is the next thread due
+    int numSleeping;		// threads in the heap
+    int size;			// entries allocated in the heap
+};
+
 
 // The following class defines a software alarm clock. 
 class Alarm : public CallBackObj {
   public:
-    Alarm(bool doRandomYield);	// Initialize the timer, and callback 
-				// to "toCall" every time slice.
-    ~Alarm() { delete timer; }
+    Alarm(bool doRandomYield, bool tickless = FALSE, bool oneShot = FALSE);
+				// Initialize the timer, and callback 
+				// to "toCall" every time slice.  If
+				// "tickless", stop the timer while
+				// nothing is runnable.  If "oneShot",
+				// set it each time for the next thing
+				// due instead.
+    ~Alarm() { delete timer; delete sleepers; }
     
-    void WaitUntil(int x);	// suspend execution until time > now + x
-                                // this method is not yet implemented
+    void WaitUntil(int x);	// suspend execution until time >= now + x
+    void WakeAt(Thread *thread, int when);
+				// make a thread that isn't running
+				// ready at time "when"
+    void Resume();		// time-slice again, if a thread is ready
+    void Reprogram();		// one-shot: set the timer for the next
+				// slice to end, or sleeper to wake
 
   private:
     Timer *timer;		// the hardware timer device
+    SleepQueue *sleepers;	// threads in WaitUntil
+    bool tickless;		// stop the timer when idle?
+    bool oneShot;		// set it for each event?
 
     void CallBack();		// called when the hardware
 				// timer generates an interrupt
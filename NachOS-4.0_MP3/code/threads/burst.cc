@@ -0,0 +1,91 @@
+// burst.cc
+//	Routines to predict the CPU bursts of threads.
+//
+// Copyright (c) 1992-1996 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "burst.h"
+#include "main.h"
+
+//----------------------------------------------------------------------
+// BurstPredictor::BurstPredictor
+// 	Initialize the predictor, with no history.
+//
+//	"weight" is alpha, the weight of the last burst (0 to 1)
+//	"history" is set if predictions are to be kept per executable
+//----------------------------------------------------------------------
+
+BurstPredictor::BurstPredictor(double weight, bool history)
+{
+    ASSERT(weight >= 0.0 && weight <= 1.0);
+    alpha = (int) (weight * BurstScale + 0.5);
+    useHistory = history;
+    numHistory = 0;
+}
+
+//----------------------------------------------------------------------
+// BurstPredictor::Find
+// 	Return where "name" is in the history, or -1 if it isn't.
+//----------------------------------------------------------------------
+
+int
+BurstPredictor::Find(char *name)
+{
+    for (int i = 0; i < numHistory; i++) {
+	if (strcmp(historyName[i], name) == 0)
+	    return i;
+    }
+    return -1;
+}
+
+//----------------------------------------------------------------------
+// BurstPredictor::Start
+// 	Give a thread that is about to run a program its first
+//	prediction: the last one made for the same program, if there is
+//	one and history is kept, otherwise 0.
+//----------------------------------------------------------------------
+
+void
+BurstPredictor::Start(Thread *thread)
+{
+    int i = useHistory ? Find(thread->getName()) : -1;
+
+    thread->burstEstimate = (i == -1) ? 0 : historyEstimate[i];
+    thread->setBurstTime((thread->burstEstimate + BurstScale / 2) >> BurstShift);
+}
+
+//----------------------------------------------------------------------
+// BurstPredictor::Update
+// 	A thread has run "burst" ticks before blocking.  Charge the error
+//	of its last prediction to the statistics, then fold the burst
+//	into its prediction, and remember that for the program.
+//----------------------------------------------------------------------
+
+void
+BurstPredictor::Update(Thread *thread, int burst)
+{
+    Statistics *stats = kernel->stats;
+    long long estimate;
+    int i;
+
+    stats->numBursts++;
+    stats->burstError += abs(burst - thread->getBurstTime());
+
+    estimate = ((long long) alpha * burst * BurstScale
+		+ (long long) (BurstScale - alpha) * thread->burstEstimate)
+		>> BurstShift;
+    thread->burstEstimate = (int) estimate;
+    thread->setBurstTime((thread->burstEstimate + BurstScale / 2) >> BurstShift);
+
+    if (!useHistory || thread->space == NULL)
+	return;				// only programs have history
+    i = Find(thread->getName());
+    if (i == -1 && numHistory < MaxHistory) {
+	i = numHistory++;
+	historyName[i] = thread->getName();
+    }
+    if (i != -1)
+	historyEstimate[i] = thread->burstEstimate;
+}
@@ -0,0 +1,59 @@
+// burst.h
+//	Data structures for predicting how long a thread will run before
+//	it next blocks, so the SJF level can run the shortest job first.
+//
+//	The prediction is an exponential average of the bursts so far:
+//
+//		next = alpha * last burst + (1 - alpha) * previous prediction
+//
+//	kept in fixed point, so that short bursts don't round away.
+//	Optionally, the latest prediction for each executable is kept,
+//	and a new thread running the same program starts from it rather
+//	than from 0.
+//
+// Copyright (c) 1992-1996 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#ifndef BURST_H
+#define BURST_H
+
+#include "copyright.h"
+
+class Thread;
+
+// Predictions, and alpha, are kept in units of 1/BurstScale
+
+const int BurstShift = 8;
+const int BurstScale = 1 << BurstShift;
+
+// Most executables whose history is kept; any more are not learned
+
+const int MaxHistory = 32;
+
+// The following class predicts CPU bursts.
+
+class BurstPredictor {
+  public:
+    BurstPredictor(double alpha, bool useHistory);
+				// alpha is the weight of the last burst,
+				// from 0 to 1
+    ~BurstPredictor() {}
+
+    void Start(Thread *thread);	// a thread is about to run a program;
+				// give it its first prediction
+    void Update(Thread *thread, int burst);
+				// the thread ran "burst" ticks before
+				// blocking; predict its next burst
+
+  private:
+    int Find(char *name);	// index of name in the history, or -1
+
+    int alpha;			// weight of the last burst, fixed point
+    bool useHistory;		// remember predictions per executable?
+    int numHistory;		// executables remembered
+    char *historyName[MaxHistory];	// their names (never freed)
+    int historyEstimate[MaxHistory];	// their latest predictions
+};
+
+#endif // BURST_H
@@ -0,0 +1,135 @@
+// classify.cc
+//	Routines to classify threads by how they run, and place them
+//	at the level of the scheduler that suits them.  See classify.h.
+//
+// Copyright (c) 1992-1996 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "classify.h"
+#include "main.h"
+#include "perfcount.h"
+
+// Threads that changed to each class
+
+static PerfCounter perfToInteractive("classify", "to_interactive");
+static PerfCounter perfToIoBound("classify", "to_io_bound");
+static PerfCounter perfToCpuBound("classify", "to_cpu_bound");
+
+static const char *className[NumThreadClasses] = { "interactive",
+						   "I/O-bound", "CPU-bound" };
+
+//----------------------------------------------------------------------
+// ThreadClassifier::Start
+// 	Place a thread that is about to run a program with the
+//	interactive threads, until it has shown what it is.
+//----------------------------------------------------------------------
+
+void
+ThreadClassifier::Start(Thread *thread)
+{
+    thread->cpuShare = 0;
+    thread->threadClass = ClassInteractive;
+    Place(thread);
+}
+
+//----------------------------------------------------------------------
+// ThreadClassifier::Block
+// 	The running thread is going to sleep: note when, so that Wake
+//	knows how long it was blocked for.
+//----------------------------------------------------------------------
+
+void
+ThreadClassifier::Block(Thread *thread)
+{
+    thread->blockedTick = kernel->stats->totalTicks;
+}
+
+//----------------------------------------------------------------------
+// ThreadClassifier::Wake
+// 	A thread that blocked is ready to run again.  Its last cycle is
+//	the time it ran since it was last woken up, and the time it has
+//	just been blocked for; fold that into its share, and re-place it.
+//	Called by ReadyToRun before the thread is queued.
+//----------------------------------------------------------------------
+
+void
+ThreadClassifier::Wake(Thread *thread)
+{
+    int burst = thread->ticksRun - thread->cycleRun;
+    int blocked;
+    long long sample;
+
+    if (thread->blockedTick == -1)
+	return;				// not asleep since we last looked
+    blocked = kernel->stats->totalTicks - thread->blockedTick;
+    thread->blockedTick = -1;
+    thread->cycleRun = thread->ticksRun;
+    if (burst + blocked == 0)
+	return;
+    sample = (long long) burst * ClassScale / (burst + blocked);
+    thread->cpuShare = (int) ((ClassAlpha * sample
+		+ (long long) (ClassScale - ClassAlpha) * thread->cpuShare)
+		>> ClassShift);
+    Place(thread);
+}
+
+//----------------------------------------------------------------------
+// ThreadClassifier::CheckHog
+// 	Called at each timer interrupt for the thread running on each
+//	CPU.  If it has run "burst" ticks since it was last woken up, and
+//	that is HogTicks or more, it is CPU-bound, whatever it was; and
+//	as a CPU-bound thread it goes down to the last level now.
+//----------------------------------------------------------------------
+
+void
+ThreadClassifier::CheckHog(Thread *thread, int burst)
+{
+    if (burst < HogTicks)
+	return;
+    thread->cpuShare = ClassScale;	// it shows no sign of blocking
+    Place(thread);
+}
+
+//----------------------------------------------------------------------
+// ThreadClassifier::Place
+// 	Classify a thread by its share, and if its priority is not at
+//	the level of its class, give it the lowest priority of that
+//	level.  A running thread that is moved down may be preempted
+//	(see Scheduler::SetPriority).
+//----------------------------------------------------------------------
+
+void
+ThreadClassifier::Place(Thread *thread)
+{
+    SchedPolicy *policy = kernel->schedPolicy;
+    int last = policy->NumLevels() - 1;
+    ThreadClass newClass;
+    int level;
+
+    if (thread->cpuShare < InteractiveShare) {
+	newClass = ClassInteractive;
+	level = 0;
+    } else if (thread->cpuShare < IoShare) {
+	newClass = ClassIoBound;
+	level = min(1, last);
+    } else {
+	newClass = ClassCpuBound;
+	level = last;
+    }
+    if (newClass != thread->threadClass) {
+	DEBUG(dbgThread, "Thread " << thread->getName() << " is now "
+		<< className[newClass] << ", share " << thread->cpuShare);
+	switch (newClass) {
+	  case ClassInteractive: perfToInteractive.Inc(); break;
+	  case ClassIoBound: perfToIoBound.Inc(); break;
+	  default: perfToCpuBound.Inc(); break;
+	}
+	thread->threadClass = newClass;
+    }
+    if (thread->IsRealTime() || thread->basePriority != -1)
+	return;				// not its own priority to change
+    if (policy->LevelOf(thread->getPriority()) != level)
+	kernel->scheduler->SetPriority(thread, policy->Level(level)->minPriority);
+}
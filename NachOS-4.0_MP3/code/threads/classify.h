@@ -0,0 +1,80 @@
+// classify.h
+//	Data structures for classifying threads as they run -- as
+//	interactive, I/O-bound or CPU-bound -- and placing each at the
+//	level of the scheduler that suits it, so that response time
+//	doesn't depend on priorities being tuned by hand (-classify).
+//
+//	Each time a thread blocks and is woken up, the CPU burst it ran
+//	before blocking and the time it was blocked for make one cycle.
+//	The share of its cycles it spends running is kept as an
+//	exponential average, as burst.h does for the bursts themselves:
+//
+//		share = alpha * burst / (burst + blocked)
+//			+ (1 - alpha) * previous share
+//
+//	with alpha ClassAlpha.  A thread with a share below
+//	InteractiveShare is interactive, one below IoShare is I/O-bound,
+//	and anything else CPU-bound.  A thread that runs HogTicks without
+//	blocking is CPU-bound at once, rather than when it next blocks,
+//	since at a level without time slicing it might never block.
+//
+//	An interactive thread is placed at the first level (L1 by
+//	default), an I/O-bound one at the second (L2), and a CPU-bound one
+//	at the last (L3).  A thread that moves to another level gets the
+//	lowest priority of that level, and from there ages as usual; one
+//	that stays keeps its priority.  A new program starts out as
+//	interactive, whatever priority it was given, until its bursts
+//	show otherwise.  Real-time threads, and threads running at a
+//	priority they inherited (see synch.h), are left where they are.
+//
+// Copyright (c) 1992-1996 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#ifndef CLASSIFY_H
+#define CLASSIFY_H
+
+#include "copyright.h"
+
+class Thread;
+
+// What a thread's behaviour so far says it is
+
+enum ThreadClass { ClassInteractive, ClassIoBound, ClassCpuBound,
+		   NumThreadClasses };
+
+// Shares are kept in units of 1/ClassScale of the time
+
+const int ClassShift = 8;
+const int ClassScale = 1 << ClassShift;
+
+const int ClassAlpha = ClassScale / 2;		// weight of the last cycle
+const int InteractiveShare = ClassScale / 10;	// runs under 10% of the time
+const int IoShare = ClassScale / 2;		// runs under half the time
+const int HogTicks = 1000;			// a burst this long is
+						// CPU-bound, ten timer
+						// interrupts' worth
+
+// The following class places threads by their class.
+
+class ThreadClassifier {
+  public:
+    ThreadClassifier() {}
+    ~ThreadClassifier() {}
+
+    void Start(Thread *thread);	// a thread is about to run a program;
+				// place it as interactive
+    void Block(Thread *thread);	// the running thread is going to sleep
+    void Wake(Thread *thread);	// a thread that blocked is ready again;
+				// fold the cycle into its share, and
+				// re-place it, before it is queued
+    void CheckHog(Thread *thread, int burst);
+				// the running thread has run "burst"
+				// ticks since it was woken up
+
+  private:
+    void Place(Thread *thread);	// classify a thread by its share, and
+				// give it a priority at its level
+};
+
+#endif // CLASSIFY_H
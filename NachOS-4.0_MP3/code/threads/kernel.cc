@@ -16,7 +16,21 @@
 #include "string.h"
 #include "synchdisk.h"
 #include "post.h"
+#include "netbench.h"
+#include "netlink.h"
 #include "synchconsole.h"
+#include "futex.h"
+#include "perfcount.h"
+#include "hostprof.h"
+#include "memtrack.h"
+
+// The file system's, counted where user programs' calls reach it, so
+// that they are the same with the stub (FILESYS_STUB) and without
+
+static PerfCounter perfCreates("filesys", "creates");
+static PerfCounter perfOpens("filesys", "opens");
+static PerfHistogram perfReadBytes("filesys", "read_bytes");
+static PerfHistogram perfWriteBytes("filesys", "write_bytes");
 
 //----------------------------------------------------------------------
 // Kernel::Kernel
@@ -28,14 +42,50 @@ Kernel::Kernel(int argc, char **argv)
 {
     randomSlice = FALSE; 
     debugUserProg = FALSE;
+    traceMode = TraceText;	// print scheduling events as they happen
+    numCPUs = 1;
+    gangSchedule = FALSE;
+    cacheAffinity = FALSE;
+    schedPolicy = new SchedPolicy;	// the MP3 levels, unless -sched
+    tickless = FALSE;
+    adaptiveQuantum = FALSE;
+    oneShotTimer = FALSE;
+    burstAlpha = 0.5;
+    burstHistory = FALSE;
+    classify = FALSE;
+    csvPrefix = NULL;
+    perfStats = FALSE;
+    hostProfile = FALSE;
+    snapFile = NULL;
+    snapInterval = 0;
+    snapFormat = SnapshotJSON;
+    timelineFile = NULL;
+    workloadFile = NULL;
+    linkFile = NULL;
+    replayFile = NULL;
+    replayMode = ReplayRecord;
+    execfile = new char *[argc];	// more than there can be -e flags
+    execPriority = new int[argc];
+    execfileNum = 0;
+    threadNum = 0;
+    numFreeIDs = 0;
+    for (int i = 0; i < MaxThreads; i++)
+	t[i] = NULL;
     consoleIn = NULL;          // default is stdin
     consoleOut = NULL;         // default is stdout
+    consoleCooked = TRUE;	// read console input a line at a time
 #ifndef FILESYS_STUB
     formatFlag = FALSE;
 #endif
     reliability = 1;            // network reliability, default is 1.0
     hostName = 0;               // machine id, also UNIX socket name
                                 // 0 is the default machine id
+    waitForInput = FALSE;	// poll the console and network
+    memoryWire = FALSE;		// machines are separate processes
+    syncHosts = 0;		// ...each at its own pace
+    coalesceMail = FALSE;	// a packet for every message
+    freeSynch = FALSE;		// synchronization always toggles interrupts
+    priorityWait = FALSE;	// waiters are woken first come, first served
     for (int i = 1; i < argc; i++) {
         if (strcmp(argv[i], "-rs") == 0) {
  	    	ASSERT(i + 1 < argc);
@@ -45,8 +95,129 @@ Kernel::Kernel(int argc, char **argv)
 	    	i++;
         } else if (strcmp(argv[i], "-s") == 0) {
             debugUserProg = TRUE;
+        } else if (strcmp(argv[i], "-cpus") == 0) {
+	    	ASSERT(i + 1 < argc);
+	    	numCPUs = atoi(argv[i + 1]);
+	    	if (numCPUs < 1 || numCPUs > MaxCPUs) {
+		    cout << "Number of CPUs must be 1 to " << MaxCPUs << "\n";
+		    numCPUs = 1;
+	    	}
+	    	i++;
+        } else if (strcmp(argv[i], "-gang") == 0) {
+	    	gangSchedule = TRUE;
+        } else if (strcmp(argv[i], "-affinity") == 0) {
+	    	cacheAffinity = TRUE;
+        } else if (strcmp(argv[i], "-sched") == 0) {
+	    	ASSERT(i + 1 < argc);
+	    	if (schedPolicy->Load(argv[i + 1]))
+		    schedPolicy->Print();
+	    	i++;
+        } else if (strcmp(argv[i], "-alpha") == 0) {
+	    	ASSERT(i + 1 < argc);
+	    	burstAlpha = atof(argv[i + 1]);
+	    	if (burstAlpha < 0.0 || burstAlpha > 1.0) {
+		    cout << "Burst alpha must be between 0 and 1\n";
+		    burstAlpha = 0.5;
+	    	}
+	    	i++;
+        } else if (strcmp(argv[i], "-history") == 0) {
+	    	burstHistory = TRUE;
+        } else if (strcmp(argv[i], "-classify") == 0) {
+	    	classify = TRUE;
+        } else if (strcmp(argv[i], "-csv") == 0) {
+	    	ASSERT(i + 1 < argc);
+	    	csvPrefix = argv[i + 1];
+	    	i++;
+        } else if (strcmp(argv[i], "-stats") == 0) {
+	    	perfStats = TRUE;
+        } else if (strcmp(argv[i], "-hostprof") == 0) {
+	    	hostProfile = TRUE;
+        } else if (strcmp(argv[i], "-snapshot") == 0) {
+	    	ASSERT(i + 2 < argc);	// next: ticks between, and a file
+	    	snapInterval = atoi(argv[i + 1]);
+	    	ASSERT(snapInterval > 0);
+	    	snapFile = argv[i + 2];
+	    	i += 2;
+        } else if (strcmp(argv[i], "-snapfmt") == 0) {
+	    	ASSERT(i + 1 < argc);
+	    	if (strcmp(argv[i + 1], "json") == 0) {
+		    snapFormat = SnapshotJSON;
+	    	} else if (strcmp(argv[i + 1], "csv") == 0) {
+		    snapFormat = SnapshotCSV;
+	    	} else {
+		    cout << "Unknown snapshot format " << argv[i + 1] << "\n";
+		    ASSERTNOTREACHED();
+	    	}
+	    	i++;
+        } else if (strcmp(argv[i], "-timeline") == 0) {
+	    	ASSERT(i + 1 < argc);	// next argument is a UNIX file
+	    	timelineFile = argv[i + 1];
+	    	i++;
+        } else if (strcmp(argv[i], "-workload") == 0) {
+	    	ASSERT(i + 1 < argc);	// next argument is a UNIX file
+	    	workloadFile = argv[i + 1];
+	    	i++;
+        } else if (strcmp(argv[i], "-link") == 0) {
+	    	ASSERT(i + 1 < argc);	// next argument is a UNIX file
+	    	linkFile = argv[i + 1];
+	    	i++;
+        } else if (strcmp(argv[i], "-tickless") == 0) {
+	    	tickless = TRUE;
+        } else if (strcmp(argv[i], "-quantum") == 0) {
+	    	ASSERT(i + 1 < argc);
+	    	if (strcmp(argv[i + 1], "fixed") == 0) {
+		    adaptiveQuantum = FALSE;
+	    	} else if (strcmp(argv[i + 1], "adaptive") == 0) {
+		    adaptiveQuantum = TRUE;
+	    	} else {
+		    cout << "Unknown quantum mode " << argv[i + 1] << "\n";
+	    	}
+	    	i++;
+        } else if (strcmp(argv[i], "-timer") == 0) {
+	    	ASSERT(i + 1 < argc);
+	    	if (strcmp(argv[i + 1], "periodic") == 0) {
+		    oneShotTimer = FALSE;
+	    	} else if (strcmp(argv[i + 1], "oneshot") == 0) {
+		    oneShotTimer = TRUE;
+	    	} else {
+		    cout << "Unknown timer mode " << argv[i + 1] << "\n";
+	    	}
+	    	i++;
+        } else if (strcmp(argv[i], "-synchcost") == 0) {
+	    	ASSERT(i + 1 < argc);
+	    	if (strcmp(argv[i + 1], "ticks") == 0) {
+		    freeSynch = FALSE;
+	    	} else if (strcmp(argv[i + 1], "free") == 0) {
+		    freeSynch = TRUE;
+	    	} else {
+		    cout << "Unknown synchronization cost " << argv[i + 1] << "\n";
+	    	}
+	    	i++;
+        } else if (strcmp(argv[i], "-waitqueue") == 0) {
+	    	ASSERT(i + 1 < argc);
+	    	if (strcmp(argv[i + 1], "fifo") == 0) {
+		    priorityWait = FALSE;
+	    	} else if (strcmp(argv[i + 1], "priority") == 0) {
+		    priorityWait = TRUE;
+	    	} else {
+		    cout << "Unknown wait queue order " << argv[i + 1] << "\n";
+	    	}
+	    	i++;
+        } else if (strcmp(argv[i], "-trace") == 0) {
+	    	ASSERT(i + 1 < argc);
+	    	if (strcmp(argv[i + 1], "text") == 0) {
+		    traceMode = TraceText;
+	    	} else if (strcmp(argv[i + 1], "ring") == 0) {
+		    traceMode = TraceRing;
+	    	} else if (strcmp(argv[i + 1], "off") == 0) {
+		    traceMode = TraceOff;
+	    	} else {
+		    cout << "Unknown trace mode " << argv[i + 1] << "\n";
+	    	}
+	    	i++;
 		} else if (strcmp(argv[i], "-e") == 0) {
         	execfile[++execfileNum]= argv[++i];
+        	execPriority[execfileNum] = 0;
 			cout << execfile[execfileNum] << "\n";
     } else if (strcmp(argv[i], "-ep") == 0) {
         execfile[++execfileNum] = argv[++i];
@@ -62,6 +233,16 @@ Kernel::Kernel(int argc, char **argv)
 	    	ASSERT(i + 1 < argc);
 	    	consoleOut = argv[i + 1];
 	    	i++;
+		} else if (strcmp(argv[i], "-cmode") == 0) {
+	    	ASSERT(i + 1 < argc);
+	    	if (strcmp(argv[i + 1], "cooked") == 0) {
+		    consoleCooked = TRUE;
+	    	} else if (strcmp(argv[i + 1], "raw") == 0) {
+		    consoleCooked = FALSE;
+	    	} else {
+		    cout << "Unknown console mode " << argv[i + 1] << "\n";
+	    	}
+	    	i++;
 #ifndef FILESYS_STUB
 		} else if (strcmp(argv[i], "-f") == 0) {
 	    	formatFlag = TRUE;
@@ -74,14 +255,62 @@ Kernel::Kernel(int argc, char **argv)
             ASSERT(i + 1 < argc);   // next argument is int
             hostName = atoi(argv[i + 1]);
             i++;
+        } else if (strcmp(argv[i], "-input") == 0) {
+	    	ASSERT(i + 1 < argc);
+	    	if (strcmp(argv[i + 1], "poll") == 0) {
+		    waitForInput = FALSE;
+	    	} else if (strcmp(argv[i + 1], "wait") == 0) {
+		    waitForInput = TRUE;
+	    	} else {
+		    cout << "Unknown input mode " << argv[i + 1] << "\n";
+	    	}
+	    	i++;
+        } else if (strcmp(argv[i], "-record") == 0) {
+	    	ASSERT(i + 1 < argc);	// next argument is the log
+	    	replayFile = argv[i + 1];
+	    	replayMode = ReplayRecord;
+	    	i++;
+        } else if (strcmp(argv[i], "-replay") == 0) {
+	    	ASSERT(i + 1 < argc);	// next argument is the log
+	    	replayFile = argv[i + 1];
+	    	replayMode = ReplayPlay;
+	    	i++;
+        } else if (strcmp(argv[i], "-wire") == 0) {
+	    	memoryWire = TRUE;
+        } else if (strcmp(argv[i], "-sync") == 0) {
+	    	ASSERT(i + 1 < argc);	// next argument is the machines
+	    	syncHosts = atoi(argv[i + 1]);
+	    	ASSERT(syncHosts >= 1 && syncHosts <= MaxSyncHosts);
+	    	i++;
+        } else if (strcmp(argv[i], "-coalesce") == 0) {
+	    	coalesceMail = TRUE;
         } else if (strcmp(argv[i], "-u") == 0) {
             cout << "Partial usage: nachos [-rs randomSeed]\n";
 	   		cout << "Partial usage: nachos [-s]\n";
+            cout << "Partial usage: nachos [-trace text|ring|off]\n";
+            cout << "Partial usage: nachos [-cpus #] [-gang] [-affinity]\n";
+            cout << "Partial usage: nachos [-tickless]\n";
+            cout << "Partial usage: nachos [-quantum fixed|adaptive] [-timer periodic|oneshot]\n";
+            cout << "Partial usage: nachos [-synchcost ticks|free] [-waitqueue fifo|priority]\n";
+            cout << "Partial usage: nachos [-sched policyFile]\n";
+            cout << "Partial usage: nachos [-alpha weight] [-history]\n";
+            cout << "Partial usage: nachos [-classify]\n";
+            cout << "Partial usage: nachos [-csv prefix]\n";
+            cout << "Partial usage: nachos [-stats] [-hostprof]\n";
+            cout << "Partial usage: nachos [-snapshot ticks file] [-snapfmt json|csv]\n";
+            cout << "Partial usage: nachos [-timeline file]\n";
+            cout << "Partial usage: nachos [-workload file]\n";
             cout << "Partial usage: nachos [-ci consoleIn] [-co consoleOut]\n";
+            cout << "Partial usage: nachos [-cmode cooked|raw]\n";
 #ifndef FILESYS_STUB
 	    	cout << "Partial usage: nachos [-nf]\n";
 #endif
             cout << "Partial usage: nachos [-n #] [-m #]\n";
+            cout << "Partial usage: nachos [-input poll|wait]\n";
+            cout << "Partial usage: nachos [-wire | -sync #]\n";
+            cout << "Partial usage: nachos [-coalesce]\n";
+            cout << "Partial usage: nachos [-link file]\n";
+            cout << "Partial usage: nachos [-record log | -replay log]\n";
 		}
     }
 }
@@ -101,15 +330,66 @@ Kernel::Initialize()
     // object to save its state. 
 
 	
-    currentThread = new Thread("main", threadNum++);		
+    currentThread = new Thread("main", 0);
+    NewThreadID(currentThread);		// main is always thread 0
     currentThread->setStatus(RUNNING);
 
     stats = new Statistics();		// collect statistics
+    stats->numCPUs = numCPUs;
+    if (csvPrefix != NULL)
+	stats->StartCSV(csvPrefix);
+    stats->printPerf = perfStats;
+    stats->printHostProfile = hostProfile;
+    if (hostProfile)
+	HostProfStart();
+    if (snapFile != NULL)
+	stats->StartSnapshots(snapFile, snapInterval, snapFormat);
+    schedTrace = new SchedTrace(traceMode);	// record scheduling events
+    timeline = (timelineFile == NULL) ? NULL : new Timeline(timelineFile);
+    replay = NULL;
+    if (replayFile != NULL) {
+	ASSERT(!waitForInput);		// input has to be polled
+	replay = new Replay(replayFile, replayMode);
+    }
+    if (syncHosts > 0) {		// packets are timed by the lockstep
+	ASSERT(!memoryWire && replay == NULL && !waitForInput);
+	ASSERT(hostName < syncHosts);
+    }
+    burstPredictor = new BurstPredictor(burstAlpha, burstHistory);
+    classifier = classify ? new ThreadClassifier : NULL;
+    workload = NULL;
+    if (workloadFile != NULL) {
+	workload = new Workload();
+	if (!workload->Load(workloadFile)) {
+	    delete workload;
+	    workload = NULL;
+	}
+    }
+    links = NULL;
+    if (linkFile != NULL) {
+	if (!memoryWire) {
+	    cout << "-link needs -wire\n";
+	} else {
+	    links = new LinkModel();
+	    if (!links->Load(linkFile)) {
+		delete links;
+		links = NULL;
+	    }
+	}
+    }
     interrupt = new Interrupt;		// start up interrupt handling
-    scheduler = new Scheduler();	// initialize the ready queue
-    alarm = new Alarm(randomSlice);	// start up time slicing
+    if (adaptiveQuantum)
+	oneShotTimer = TRUE;		// so the quanta needn't be whole
+					// timer periods
+    scheduler = new Scheduler(schedPolicy, numCPUs, gangSchedule,
+			      cacheAffinity, adaptiveQuantum, oneShotTimer);
+					// initialize the ready queues
+    alarm = new Alarm(randomSlice, tickless, oneShotTimer);
+					// start up time slicing
     machine = new Machine(debugUserProg);
-    synchConsoleIn = new SynchConsoleInput(consoleIn); // input from stdin
+    futexes = new FutexTable();
+    synchConsoleIn = new SynchConsoleInput(consoleIn, consoleCooked);
+							// input from stdin
     synchConsoleOut = new SynchConsoleOutput(consoleOut); // output to stdout
     synchDisk = new SynchDisk();    //
 #ifdef FILESYS_STUB
@@ -119,6 +399,8 @@ Kernel::Initialize()
 #endif // FILESYS_STUB
     // postOfficeIn = new PostOfficeInput(10);
     // postOfficeOut = new PostOfficeOutput(reliability);
+    postOfficeIn = NULL;		// until the network test, or a
+    postOfficeOut = NULL;		// program, wants them
 
     interrupt->Enable();
 }
@@ -130,17 +412,32 @@ Kernel::Initialize()
 
 Kernel::~Kernel()
 {
+    delete timeline;
+    timeline = NULL;
+    delete replay;
+    replay = NULL;
+    delete workload;
+    workload = NULL;
+    delete links;
+    links = NULL;
     delete stats;
     delete interrupt;
     delete scheduler;
+    delete [] execfile;
+    delete [] execPriority;
     delete alarm;
     delete machine;
+    delete futexes;
     delete synchConsoleIn;
     delete synchConsoleOut;
     delete synchDisk;
     delete fileSystem;
     delete postOfficeIn;
     delete postOfficeOut;
+    delete schedTrace;
+    delete schedPolicy;
+    delete burstPredictor;
+    delete classifier;
     
     for(int i=0; i<NumPhysPages; i++)
       usedPhyPages[i] = false;
@@ -156,6 +453,7 @@ Kernel::~Kernel()
 void
 Kernel::ThreadSelfTest() {
    Semaphore *semaphore;
+   WaitQueue *waitQueue;
    SynchList<int> *synchList;
    
    LibSelfTest();		// test library routines
@@ -166,6 +464,11 @@ Kernel::ThreadSelfTest() {
    semaphore = new Semaphore("test", 0);
    semaphore->SelfTest();
    delete semaphore;
+
+   				// test waking waiters by priority
+   waitQueue = new WaitQueue(TRUE);
+   waitQueue->SelfTest();
+   delete waitQueue;
    
    				// test locks, condition variables
 				// using synchronized lists
@@ -197,30 +500,100 @@ Kernel::ConsoleTest() {
     cout << "\n";
 
 }
+
+//----------------------------------------------------------------------
+// Kernel::ConsoleInteger
+//      Print a number on the console display, for the PrintInt system
+//	call.  The digits go out as one block.
+//----------------------------------------------------------------------
+
 void
-Kernel::ConsoleInteger(int number) {	
-	char ch[10];
-	int digit = 1;
-	bool neg = (number < 0)? true : false;
-
-	ch[0] = '\n';
-
-	if(number == 0)
-		ch[digit++] = '0';
-	else {
-		number = (neg)? -(number) : (number);
-		while(number) {
-			ch[digit++] = (number % 10) + '0';
-			number = number / 10;
-		}
-		if(neg)
-			ch[digit++] = '-';
-	}
-		
-	while(digit > 1) 
-		synchConsoleOut->PutChar(ch[--digit]);   // echo it!
-	
+Kernel::ConsoleInteger(int number) {
+    synchConsoleOut->PrintInt(number);
+}
+
+//----------------------------------------------------------------------
+// NetworkExchange
+//      One machine's half of the network test (see Kernel::NetworkTest).
+//
+//	"postIn", "postOut" -- the machine's post office
+//	"host" -- the machine, 0 or 1
+//----------------------------------------------------------------------
 
+static void
+NetworkExchange(PostOfficeInput *postIn, PostOfficeOutput *postOut, int host)
+{
+    // if we're machine 1, send to 0 and vice versa
+    int farHost = (host == 0 ? 1 : 0); 
+    PacketHeader outPktHdr, inPktHdr;
+    MailHeader outMailHdr, inMailHdr;
+    char *data = "Hello there!";
+    char *ack = "Got it!";
+    char buffer[MaxMailSize];
+
+    // construct packet, mail header for original message
+    // To: destination machine, mailbox 0
+    // From: our machine, reply to: mailbox 1
+    outPktHdr.to = farHost;         
+    outMailHdr.to = 0;
+    outMailHdr.from = 1;
+    outMailHdr.length = strlen(data) + 1;
+
+    // Send the first message
+    postOut->Send(outPktHdr, outMailHdr, data); 
+
+    // Wait for the first message from the other machine
+    postIn->Receive(0, &inPktHdr, &inMailHdr, buffer);
+    cout << "Got: " << buffer << " : from " << inPktHdr.from << ", box " 
+                                            << inMailHdr.from << "\n";
+    cout.flush();
+
+    // Send acknowledgement to the other machine (using "reply to" mailbox
+    // in the message that just arrived
+    outPktHdr.to = inPktHdr.from;
+    outMailHdr.to = inMailHdr.from;
+    outMailHdr.length = strlen(ack) + 1;
+    postOut->Send(outPktHdr, outMailHdr, ack); 
+
+    // Wait for the ack from the other machine to the first message we sent
+    postIn->Receive(1, &inPktHdr, &inMailHdr, buffer);
+    cout << "Got: " << buffer << " : from " << inPktHdr.from << ", box " 
+                                            << inMailHdr.from << "\n";
+    cout.flush();
+}
+
+// One machine on the in-memory wire, running its half of the test
+
+class WireMachine {
+  public:
+    PostOfficeInput *postIn;
+    PostOfficeOutput *postOut;
+    int host;
+    Semaphore *done;		// V'ed when it has finished
+};
+
+static void
+WireMachineTest(void *arg)
+{
+    WireMachine *m = (WireMachine *) arg;
+
+    NetworkExchange(m->postIn, m->postOut, m->host);
+    m->done->V();
+}
+
+//----------------------------------------------------------------------
+// Kernel::StartNetwork
+//      Make this machine's post office, the first time the network
+//	test or a user program (MailSend, MailRecv) wants it.
+//----------------------------------------------------------------------
+
+void
+Kernel::StartNetwork()
+{
+    if (postOfficeIn != NULL)
+	return;
+    postOfficeIn = new PostOfficeInput(10);
+    postOfficeOut = new PostOfficeOutput(reliability);
 }
 
 //----------------------------------------------------------------------
@@ -233,57 +606,62 @@ Kernel::ConsoleInteger(int number) {
 //      4. wait for an acknowledgement from the other machine to our 
 //          original message
 //
-//  This test works best if each Nachos machine has its own window
+//  This test works best if each Nachos machine has its own window.
+//  On the in-memory wire (-wire), both machines are run here instead,
+//  each with a post office and a thread of its own.  The post offices
+//  are left behind, as their postal workers are still waiting.
 //----------------------------------------------------------------------
 
 void
 Kernel::NetworkTest() {
 
-    if (hostName == 0 || hostName == 1) {
-        // if we're machine 1, send to 0 and vice versa
-        int farHost = (hostName == 0 ? 1 : 0); 
-        PacketHeader outPktHdr, inPktHdr;
-        MailHeader outMailHdr, inMailHdr;
-        char *data = "Hello there!";
-        char *ack = "Got it!";
-        char buffer[MaxMailSize];
-
-        // construct packet, mail header for original message
-        // To: destination machine, mailbox 0
-        // From: our machine, reply to: mailbox 1
-        outPktHdr.to = farHost;         
-        outMailHdr.to = 0;
-        outMailHdr.from = 1;
-        outMailHdr.length = strlen(data) + 1;
-
-        // Send the first message
-        postOfficeOut->Send(outPktHdr, outMailHdr, data); 
-
-        // Wait for the first message from the other machine
-        postOfficeIn->Receive(0, &inPktHdr, &inMailHdr, buffer);
-        cout << "Got: " << buffer << " : from " << inPktHdr.from << ", box " 
-                                                << inMailHdr.from << "\n";
-        cout.flush();
-
-        // Send acknowledgement to the other machine (using "reply to" mailbox
-        // in the message that just arrived
-        outPktHdr.to = inPktHdr.from;
-        outMailHdr.to = inMailHdr.from;
-        outMailHdr.length = strlen(ack) + 1;
-        postOfficeOut->Send(outPktHdr, outMailHdr, ack); 
-
-        // Wait for the ack from the other machine to the first message we sent
-	postOfficeIn->Receive(1, &inPktHdr, &inMailHdr, buffer);
-        cout << "Got: " << buffer << " : from " << inPktHdr.from << ", box " 
-                                                << inMailHdr.from << "\n";
-        cout.flush();
+    if (memoryWire) {
+	WireMachine machine[2];
+	Semaphore *done = new Semaphore("machines done", 0);
+	Thread *t;
+
+	for (int i = 0; i < 2; i++) {
+	    machine[i].postIn = new PostOfficeInput(10, i);
+	    machine[i].postOut = new PostOfficeOutput(reliability, i);
+	    machine[i].host = i;
+	    machine[i].done = done;
+	    t = new Thread("wire machine", 1);
+	    t->Fork(WireMachineTest, &machine[i]);
+	}
+	done->P();
+	done->P();
+	delete done;
+    } else if (hostName == 0 || hostName == 1) {
+	StartNetwork();
+	NetworkExchange(postOfficeIn, postOfficeOut, hostName);
     }
 
     // Then we're done!
 }
 
+//----------------------------------------------------------------------
+// Kernel::NetworkBenchmark
+//      Time the post office over the in-memory wire (see netbench.h),
+//	then halt: the benchmark's machines are left waiting for more
+//	messages.  Only the bulk test drops packets, with -n's
+//	reliability.
+//----------------------------------------------------------------------
+
+void
+Kernel::NetworkBenchmark()
+{
+    if (!memoryWire) {
+	cout << "-bench-net needs -wire\n";
+	return;
+    }
+    NetBenchmark(reliability);
+    interrupt->Halt();
+}
+
 void ForkExecute(Thread *t)
 {
+	MemTagScope tag(MemUserProg);
+
 	if ( !t->space->Load(t->getName()) ) {
     	return;             // executable not found
     }
@@ -295,23 +673,83 @@ void Kernel::ExecAll()
 {
   cout << "\n";
 	for (int i=1;i<=execfileNum;i++) {
-		int a = Exec(execfile[i]);
+		int a = Exec(execfile[i], execPriority[i]);
 	}
+	if (workload != NULL)
+		workload->Start();
 	currentThread->Finish();
     //Kernel::Exec();	
 }
 
 
-int Kernel::Exec(char* name)
+//----------------------------------------------------------------------
+// Kernel::NewThreadID
+// 	Give "thread" an ID, and enter it in the thread table.  The most
+//	recently freed ID is reused first, so the table stays dense and
+//	"getThread" stays a lookup however many threads have come and
+//	gone.  Returns -1 if every ID is in use.
+//----------------------------------------------------------------------
+
+int
+Kernel::NewThreadID(Thread *thread)
 {
-	t[threadNum] = new Thread(name, threadNum);
-	t[threadNum]->space = new AddrSpace();
-  t[threadNum]->setPriority(execPriority[threadNum]);
-	t[threadNum]->Fork((VoidFunctionPtr) &ForkExecute, (void *)t[threadNum]);
-  
-	threadNum++;
-
-	return threadNum-1;
+    int id;
+
+    if (numFreeIDs > 0) {
+	id = freeID[--numFreeIDs];
+    } else if (threadNum < MaxThreads) {
+	id = threadNum++;
+    } else {
+	return -1;
+    }
+    t[id] = thread;
+    thread->setID(id);
+    return id;
+}
+
+//----------------------------------------------------------------------
+// Kernel::FreeThreadID
+// 	Take a thread that is being destroyed out of the thread table,
+//	and keep its ID for the next thread.
+//----------------------------------------------------------------------
+
+void
+Kernel::FreeThreadID(int threadID)
+{
+    ASSERT(threadID >= 0 && threadID < threadNum && t[threadID] != NULL);
+    t[threadID] = NULL;
+    freeID[numFreeIDs++] = threadID;
+}
+
+
+//----------------------------------------------------------------------
+// Kernel::Exec
+// 	Start a thread running the program "name" at "priority", and
+//	return its ID, or -1 if there are too many threads.  If "args"
+//	isn't NULL, its four numbers are passed to the program's main.
+//----------------------------------------------------------------------
+
+int Kernel::Exec(char* name, int priority, int *args)
+{
+	MemTagScope tag(MemUserProg);
+	Thread *thread = new Thread(name, 0);
+	int id = NewThreadID(thread);
+
+	if (id == -1) {
+	    cout << "Too many threads to run " << name << "\n";
+	    delete thread;
+	    return -1;
+	}
+	thread->space = new AddrSpace();
+	if (args != NULL)
+		thread->space->SetArgs(args);
+  thread->setPriority(priority);
+  burstPredictor->Start(thread);
+  if (classifier != NULL)
+    classifier->Start(thread);
+	thread->Fork((VoidFunctionPtr) &ForkExecute, (void *)thread);
+
+	return id;
 /*
     cout << "Total threads number is " << execfileNum << endl;
     for (int n=1;n<=execfileNum;n++) {
@@ -341,25 +779,39 @@ int Kernel::Exec(char* name)
 
 int Kernel::CreateFile(char *filename)
 {
+	MemTagScope tag(MemFileSys);
+
+	perfCreates.Inc();
 	return fileSystem->Create(filename);
 }
 
 int Kernel::OpenFile(char *filename)
 {
-	return (int)fileSystem->Open(filename);
+	MemTagScope tag(MemFileSys);
+
+	perfOpens.Inc();
+	return fileSystem->Open_File(filename);
 }
 
 int Kernel::CloseFile(int openfileId)
 {
+	MemTagScope tag(MemFileSys);
+
 	return fileSystem->Close_File(openfileId);
 }
 
 int Kernel::WriteFile(char *buffer, int size, int id)
 {
+	MemTagScope tag(MemFileSys);
+
+	perfWriteBytes.Record(size);
 	return fileSystem->Write_File(buffer, size, id);
 }
 
-char* Kernel::ReadFile(int size, int id)
+int Kernel::ReadFile(char *buffer, int size, int id)
 {
-	return fileSystem->Read_File(size, id);
+	MemTagScope tag(MemFileSys);
+
+	perfReadBytes.Record(size);
+	return fileSystem->Read_File(buffer, size, id);
 }
\ No newline at end of file
@@ -18,13 +18,24 @@
 #include "alarm.h"
 #include "filesys.h"
 #include "machine.h"
+#include "schedtrace.h"
+#include "timeline.h"
+#include "replay.h"
+#include "schedpolicy.h"
+#include "burst.h"
+#include "workload.h"
 
 class PostOfficeInput;
 class PostOfficeOutput;
 class SynchConsoleInput;
 class SynchConsoleOutput;
 class SynchDisk;
+class FutexTable;
+class LinkModel;
 
+// The most threads that can exist at once; IDs are 0 to MaxThreads-1
+
+const int MaxThreads = 128;
 
 
 class Kernel {
@@ -37,25 +48,43 @@ class Kernel {
 				// from constructor because 
 				// refers to "kernel" as a global
 	  void ExecAll();
-	  int Exec(char* name);
+	  int Exec(char* name, int priority, int *args = NULL);
     void ThreadSelfTest();	// self test of threads and synchronization
 	
     void ConsoleTest();         // interactive console self test
     void ConsoleInteger(int number); // Print integer onto display
     void NetworkTest();         // interactive 2-machine network test
+    void NetworkBenchmark();	// time the post office on the wire
+    void StartNetwork();	// make this machine's post office, if
+				// it hasn't been yet
 	  Thread* getThread(int threadID){return t[threadID];}    
+    int NewThreadID(Thread *thread);	// give a thread an unused ID
+    void FreeThreadID(int threadID);	// recycle a dead thread's ID
+    unsigned int Random() {	// a random number, recorded or replayed
+	return (replay != NULL) ? replay->Random() : RandomNumber();
+    }
 	
 	  int CreateFile(char* filename); // fileSystem call
     int OpenFile(char *filename);  // fileSSystem call for opening a file
     int CloseFile(int openfileId);
     int WriteFile(char *buffer, int size, int id);
-    char* ReadFile(int size, int id);
+    int ReadFile(char *buffer, int size, int id);
 
 // These are public for notational convenience; really, 
 // they're global variables used everywhere.
 
     Thread *currentThread;	// the thread holding the CPU
     Scheduler *scheduler;	// the ready list
+    SchedTrace *schedTrace;	// record of scheduling events
+    Timeline *timeline;		// timeline of the simulation, or NULL
+    Replay *replay;		// record or replay of the inputs, or NULL
+    SchedPolicy *schedPolicy;	// levels of the ready queues
+    BurstPredictor *burstPredictor;	// predicts bursts for SJF
+    ThreadClassifier *classifier;	// places threads by how they run
+					// (-classify), or NULL
+    Workload *workload;		// synthetic workload to run, or NULL
+    LinkModel *links;		// links of the in-memory wire (-link),
+				// or NULL
     Interrupt *interrupt;	// interrupt status
     Statistics *stats;		// performance metrics
     Alarm *alarm;		// the software alarm clock    
@@ -66,23 +95,63 @@ class Kernel {
     FileSystem *fileSystem;     
     PostOfficeInput *postOfficeIn;
     PostOfficeOutput *postOfficeOut;
+    FutexTable *futexes;	// threads asleep in FutexWait
 
     int hostName;               // machine identifier
+    bool waitForInput;		// devices wait for host input, rather
+				// than poll for it (-input wait)
+    bool memoryWire;		// machines are network devices in this
+				// process, on an in-memory wire (-wire)
+    int syncHosts;		// machines running in lockstep (-sync),
+				// or 0
+    bool coalesceMail;		// small messages for the same machine
+				// share packets (-coalesce)
+    bool freeSynch;		// uncontended P, V, Acquire and Release
+				// cost no ticks (-synchcost free)
+    bool priorityWait;		// threads waiting on a semaphore, lock
+				// or condition are woken highest
+				// priority first (-waitqueue priority)
 	bool usedPhyPages[NumPhysPages];
 
 
   private:
 
-	Thread* t[10];
-	char*   execfile[10];
-  int execPriority[10];
-	int execfileNum;
-	int threadNum;
+	Thread* t[MaxThreads];	// threads by ID, or NULL if the ID is free
+	char **execfile;		// programs to run, from -e and -ep;
+	int *execPriority;		// 1 to execfileNum, and the priority
+	int execfileNum;		// of each
+	int threadNum;		// IDs below this have been handed out
+    int freeID[MaxThreads];	// IDs given back, most recent last
+    int numFreeIDs;
     bool randomSlice;		// enable pseudo-random time slicing
     bool debugUserProg;         // single step user program
+    TraceMode traceMode;	// what to do with scheduling events
+    int numCPUs;		// number of CPUs to simulate
+    bool gangSchedule;		// co-schedule the threads of a program
+    bool cacheAffinity;		// charge threads for switching CPUs
+    bool tickless;		// stop the timer while idle
+    bool adaptiveQuantum;	// adapt the quanta to the load
+    bool oneShotTimer;		// set the timer for each slice's end
+    double burstAlpha;		// weight of the last burst in predictions
+    bool burstHistory;		// learn predictions per executable
+    bool classify;		// place threads by how they run
+    char *csvPrefix;		// where to write per-thread statistics
+    bool perfStats;		// print the perf counters at halt
+    bool hostProfile;		// sample where the host's time goes
+    char *snapFile;		// where to write snapshots of the
+				// statistics, or NULL
+    int snapInterval;		// ticks between them
+    SnapshotFormat snapFormat;	// JSON lines or CSV
+    char *timelineFile;		// where to write the timeline, or NULL
+    char *workloadFile;		// the workload to run, or NULL
+    char *linkFile;		// the links to model, or NULL
+    char *replayFile;		// the log of inputs to record or replay,
+				// or NULL
+    ReplayMode replayMode;
     double reliability;         // likelihood messages are dropped
     char *consoleIn;            // file to read console input from
     char *consoleOut;           // file to send console output to
+    bool consoleCooked;		// edit console input into lines
 #ifndef FILESYS_STUB
     bool formatFlag;          // format the disk if this is true
 #endif
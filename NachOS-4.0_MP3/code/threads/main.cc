@@ -4,23 +4,127 @@
 //
 // Usage: nachos -d <debugflags> -rs <random seed #>
 //              -s -x <nachos file> -ci <consoleIn> -co <consoleOut>
+//              -cmode <cooked|raw>
+//              -trace <text|ring|off> -cpus <number of CPUs> -gang -affinity
+//              -tickless -synchcost <ticks|free> -waitqueue <fifo|priority>
+//              -quantum <fixed|adaptive> -timer <periodic|oneshot>
+//              -sched <policy file> -alpha <weight> -history -classify
+//              -csv <file prefix> -snapshot <ticks> <file> -snapfmt <json|csv>
+//              -stats -hostprof
+//              -timeline <file> -record <log> -replay <log>
+//              -workload <file>
 //              -f -cp <unix file> <nachos file>
 //              -p <nachos file> -r <nachos file> -l -D
-//              -n <network reliability> -m <machine id>
-//              -z -K -C -N
+//              -n <network reliability> -m <machine id> -input <poll|wait>
+//              -wire -sync <machines> -coalesce -link <file>
+//              -z -K -C -N -bench-lib -bench-net
 //
 //    -d causes certain debugging messages to be printed (see debug.h)
 //    -rs causes Yield to occur at random (but repeatable) spots
 //    -z prints the copyright message
 //    -s causes user programs to be executed in single-step mode
+//    -trace sets what is done with scheduling events: "text" prints
+//	each one as it happens (the default), "ring" keeps the most
+//	recent ones in memory and prints them at halt, "off" drops them
+//    -cpus simulates several CPUs, each with its own ready queues; an
+//	idle CPU steals round-robin threads from the others
+//    -gang co-schedules the threads of a user program (ThreadFork): a
+//	CPU prefers a ready thread whose program is running on another
+//	CPU, so that they hold and release their locks in step
+//    -affinity charges a user thread for being switched onto a CPU:
+//	a few ticks if it was the last to run there, more for a cold
+//	cache, and more again to load another program's page table
+//    -tickless stops the timer while no thread is runnable, so the
+//	clock jumps straight to the next disk, console or wakeup event
+//    -quantum adaptive reconsiders the quantum of each time-sliced level
+//	(set in the policy, see -sched) every 1000 ticks: it is doubled,
+//	up to 8 times the policy's, while few threads wait at the level
+//	or switching costs more than 5% of the time, and halved back
+//	otherwise (see threads/scheduler.h); it implies -timer oneshot
+//    -timer oneshot sets the timer, each time, for the next slice to
+//	end or sleeping thread to wake, rather than interrupting every
+//	TimerTicks; "periodic" is the default
+//    -synchcost sets what a semaphore or lock operation that doesn't
+//	have to wait, or wake anyone, costs: "ticks" (the default)
+//	turns interrupts off and back on, which advances the clock, as
+//	every other operation does; "free" skips that, so it costs no
+//	simulated time (see threads/synch.cc)
+//    -waitqueue sets which thread waiting on a semaphore, lock or
+//	condition is woken first: "fifo" (the default), the one that has
+//	waited longest, or "priority", the one of highest priority,
+//	counting any it has inherited through a lock
+//    -sched reads the levels of the multilevel scheduler from a file
+//	(see schedpolicy.h for the format), and prints them
+//    -alpha sets the weight (0 to 1, default 0.5) of a thread's last
+//	CPU burst when predicting its next one
+//    -history starts a new thread with the last prediction made for
+//	the same executable, rather than 0
+//    -classify places each thread at a level by how it has run so far:
+//	interactive and I/O-bound threads, which block more than they
+//	run, at L1 and L2, and CPU hogs at L3, whatever priority they
+//	were started with (see threads/classify.h)
+//    -csv writes each thread's CPU time, wait time and preemptions to
+//	<prefix>.threads.csv as it finishes, and the histogram of
+//	dispatch latencies to <prefix>.latency.csv at halt
+//    -snapshot writes the statistics counters to a file every # ticks,
+//	and at halt: the built-in ones, the length of each ready queue
+//	level and of the disk queue, and any a subsystem has added
+//	with Statistics::AddCounter
+//    -snapfmt writes the snapshots as JSON lines (the default) or CSV
+//    -stats prints the hot-path counters of the scheduler, interrupts,
+//	address translation, the disk, the file system and the post
+//	office at halt (see lib/perfcount.h), and how much host memory
+//	each subsystem has allocated, and the most it ever had (see
+//	lib/memtrack.h)
+//    -hostprof samples which layer of the simulator the host's CPU time
+//	goes to -- instructions, address translation, interrupts, the
+//	scheduler, host I/O -- and prints the breakdown at halt (see
+//	lib/hostprof.h)
+//    -timeline writes thread runs, interrupts, disk requests and system
+//	calls to a file, for chrome://tracing or Perfetto (see
+//	threads/timeline.h)
+//    -workload runs a synthetic mix of CPU-bound, I/O-bound and
+//	interactive jobs, arriving at random, read from a file (see
+//	threads/workload.h), and prints their throughput, turnaround
+//	and response times at halt
+//    -record writes every nondeterministic input (random numbers,
+//	console input, packets) to a log; -replay feeds the inputs
+//	back from one instead of from the host, at the same simulated
+//	ticks (see machine/replay.h)
 //    -x runs a user program
 //    -ci specify file for console input (stdin is the default)
+//    -cmode sets how console input is read: "cooked" (the default)
+//	edits it a line at a time -- backspace or DEL takes back a
+//	character, ^U the line -- and reads stop at the end of a line;
+//	"raw" hands it over as it comes
 //    -co specify file for console output (stdout is the default)
 //    -n sets the network reliability
 //    -m sets this machine's host id (needed for the network)
+//    -input sets how the console and network find out about input:
+//	"poll" checks every ConsoleTime (or NetworkTime) ticks (the
+//	default), "wait" checks only when the machine is idle, and
+//	sleeps on the host until there is some
+//    -wire puts the machines of a network test in this one process,
+//	sending packets in memory rather than through UNIX sockets
+//    -sync runs this machine in lockstep with the others, from 0 to
+//	the number given less one, so that a network test between
+//	separate processes comes out the same every run
+//    -coalesce packs small messages for the same machine into one
+//	packet, when another is still being sent (see
+//	PostOfficeOutput::Pack)
+//    -link models the links between the machines on the in-memory
+//	wire -- bandwidth, propagation delay, queueing and loss, and
+//	reordering -- as read from a file (see machine/netlink.h)
 //    -K run a simple self test of kernel threads and synchronization
 //    -C run an interactive console test
-//    -N run a two-machine network test (see Kernel::NetworkTest)
+//    -N run a two-machine network test (see Kernel::NetworkTest); with
+//	-wire, both machines are run by this process
+//    -bench-lib times the standard library classes -- lists, sorted
+//	lists, hash tables, bitmaps, rings, intrusive lists, queues --
+//	and a heap, from 10 to a million items (see LibBenchmark)
+//    -bench-net times the post office, with -wire: ping-pong round
+//	trips, bulk transfer (losing packets as -n says) and many
+//	machines sending to one, then halts (see netbench.h)
 //
 //    Filesystem-related flags:
 //    -f forces the Nachos disk to be formatted
@@ -45,6 +149,8 @@
 #include "filesys.h"
 #include "openfile.h"
 #include "sysdep.h"
+#include "memops.h"
+#include "libtest.h"
 
 // global variables
 Kernel *kernel;
@@ -172,6 +278,8 @@ main(int argc, char **argv)
     bool threadTestFlag = false;
     bool consoleTestFlag = false;
     bool networkTestFlag = false;
+    bool libBenchFlag = false;
+    bool netBenchFlag = false;
 #ifndef FILESYS_STUB
     char *copyUnixFileName = NULL;    // UNIX file to be copied into Nachos
     char *copyNachosFileName = NULL;  // name of copied file in Nachos
@@ -207,6 +315,12 @@ main(int argc, char **argv)
 	else if (strcmp(argv[i], "-N") == 0) {
 	    networkTestFlag = TRUE;
 	}
+	else if (strcmp(argv[i], "-bench-lib") == 0) {
+	    libBenchFlag = TRUE;
+	}
+	else if (strcmp(argv[i], "-bench-net") == 0) {
+	    netBenchFlag = TRUE;
+	}
 #ifndef FILESYS_STUB
 	else if (strcmp(argv[i], "-cp") == 0) {
 	    ASSERT(i + 2 < argc);
@@ -234,7 +348,7 @@ main(int argc, char **argv)
 	else if (strcmp(argv[i], "-u") == 0) {
             cout << "Partial usage: nachos [-z -d debugFlags]\n";
             cout << "Partial usage: nachos [-x programName]\n";
-	    cout << "Partial usage: nachos [-K] [-C] [-N]\n";
+	    cout << "Partial usage: nachos [-K] [-C] [-N] [-bench-lib] [-bench-net]\n";
 #ifndef FILESYS_STUB
             cout << "Partial usage: nachos [-cp UnixFile NachosFile]\n";
             cout << "Partial usage: nachos [-p fileName] [-r fileName]\n";
@@ -246,6 +360,8 @@ main(int argc, char **argv)
     debug = new Debug(debugArg);
     
     DEBUG(dbgThread, "Entering main");
+    MemOpsInit();
+    DEBUG(dbgThread, "Copying memory with " << MemOpsKind() << " routines");
 
     kernel = new Kernel(argc, argv);
 
@@ -264,6 +380,12 @@ main(int argc, char **argv)
     if (networkTestFlag) {
       kernel->NetworkTest();   // two-machine test of the network
     }
+    if (libBenchFlag) {
+      LibBenchmark();          // time the library classes
+    }
+    if (netBenchFlag) {
+      kernel->NetworkBenchmark();  // time the post office; halts
+    }
 
 #ifndef FILESYS_STUB
     if (removeFileName != NULL) {
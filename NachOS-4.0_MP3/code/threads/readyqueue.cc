@@ -0,0 +1,460 @@
+// readyqueue.cc
+//	Routines to manage the scheduler's ready queues: a heap of
+//	threads ordered by predicted burst time, a set of FIFO
+//	lists, one per priority, and a level that is either of them
+//	or a plain FIFO list.
+//
+// Copyright (c) 1992-1996 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "readyqueue.h"
+#include "thread.h"
+
+//----------------------------------------------------------------------
+// SJFQueue::SJFQueue
+// 	Initialize an empty queue.  The heap grows as threads are added.
+//
+//	"keyOrder" is ShortestJob to order threads by predicted burst,
+//	EarliestDeadline to order them by deadline, or Stride to order
+//	them by pass value
+//----------------------------------------------------------------------
+
+SJFQueue::SJFQueue(SelectRule keyOrder)
+{
+    ASSERT(keyOrder == ShortestJob || keyOrder == EarliestDeadline
+		|| keyOrder == Stride);
+    order = keyOrder;
+    size = 16;
+    heap = new SJFEntry[size];
+    numInQueue = 0;
+    numInserted = 0;
+}
+
+//----------------------------------------------------------------------
+// SJFQueue::~SJFQueue
+// 	De-allocate the queue.  The threads on it are not deleted.
+//----------------------------------------------------------------------
+
+SJFQueue::~SJFQueue()
+{
+    delete [] heap;
+}
+
+//----------------------------------------------------------------------
+// SJFQueue::Before
+// 	Return TRUE if heap entry "a" should be scheduled before "b":
+//	it has a smaller key (predicted burst, deadline or pass), or the same
+//	key and was queued first.
+//----------------------------------------------------------------------
+
+bool
+SJFQueue::Before(int a, int b)
+{
+    if (heap[a].key != heap[b].key)
+	return heap[a].key < heap[b].key;
+    return heap[a].order < heap[b].order;
+}
+
+//----------------------------------------------------------------------
+// SJFQueue::Swap
+// 	Exchange two heap entries.
+//----------------------------------------------------------------------
+
+void
+SJFQueue::Swap(int a, int b)
+{
+    SJFEntry tmp = heap[a];
+
+    heap[a] = heap[b];
+    heap[b] = tmp;
+}
+
+//----------------------------------------------------------------------
+// SJFQueue::Insert
+// 	Add a thread to the heap, keyed on its current predicted burst,
+//	deadline or pass, and sift it up to its place.
+//----------------------------------------------------------------------
+
+void
+SJFQueue::Insert(Thread *thread)
+{
+    int i;
+
+    if (numInQueue == size) {
+	SJFEntry *bigger = new SJFEntry[size * 2];
+	for (i = 0; i < numInQueue; i++)
+	    bigger[i] = heap[i];
+	delete [] heap;
+	heap = bigger;
+	size *= 2;
+    }
+    i = numInQueue++;
+    heap[i].thread = thread;
+    switch (order) {
+      case EarliestDeadline:	heap[i].key = thread->AbsDeadline(); break;
+      case Stride:		heap[i].key = thread->pass; break;
+      default:			heap[i].key = thread->getBurstTime(); break;
+    }
+    heap[i].order = numInserted++;
+    SiftUp(i);
+}
+
+//----------------------------------------------------------------------
+// SJFQueue::SiftUp, SJFQueue::SiftDown
+// 	Restore the heap order after heap[i] has changed, by moving it
+//	towards the root or the leaves.
+//----------------------------------------------------------------------
+
+void
+SJFQueue::SiftUp(int i)
+{
+    int parent;
+
+    while (i > 0) {
+	parent = (i - 1) / 2;
+	if (!Before(i, parent))
+	    break;
+	Swap(i, parent);
+	i = parent;
+    }
+}
+
+void
+SJFQueue::SiftDown(int i)
+{
+    int child;
+
+    for (; (child = 2 * i + 1) < numInQueue; i = child) {
+	if (child + 1 < numInQueue && Before(child + 1, child))
+	    child++;
+	if (!Before(child, i))
+	    break;
+	Swap(i, child);
+    }
+}
+
+//----------------------------------------------------------------------
+// SJFQueue::RemoveFront
+// 	Take the thread with the shortest predicted burst off the heap,
+//	and sift the last entry down into the hole.  Returns NULL if the
+//	queue is empty.
+//----------------------------------------------------------------------
+
+Thread *
+SJFQueue::RemoveFront()
+{
+    Thread *front;
+
+    if (numInQueue == 0)
+	return NULL;
+    front = heap[0].thread;
+    heap[0] = heap[--numInQueue];
+    SiftDown(0);
+    return front;
+}
+
+//----------------------------------------------------------------------
+// SJFQueue::Remove
+// 	Take a thread out of the heap, wherever it is, and move the last
+//	entry into its place.  Finding it is a linear search; this is
+//	only needed when a thread is promoted out of the queue.
+//----------------------------------------------------------------------
+
+void
+SJFQueue::Remove(Thread *thread)
+{
+    int i;
+
+    for (i = 0; i < numInQueue && heap[i].thread != thread; i++)
+	;
+    ASSERT(i < numInQueue);
+    heap[i] = heap[--numInQueue];
+    if (i < numInQueue) {
+	SiftUp(i);
+	SiftDown(i);
+    }
+}
+
+//----------------------------------------------------------------------
+// SJFQueue::Front
+// 	Return the thread with the shortest predicted burst, without
+//	removing it, or NULL if the queue is empty.
+//----------------------------------------------------------------------
+
+Thread *
+SJFQueue::Front()
+{
+    return numInQueue == 0 ? NULL : heap[0].thread;
+}
+
+//----------------------------------------------------------------------
+// SJFQueue::Apply
+// 	Call "func" on every thread in the queue, in heap order.
+//----------------------------------------------------------------------
+
+void
+SJFQueue::Apply(void (*func)(Thread *))
+{
+    for (int i = 0; i < numInQueue; i++)
+	(*func)(heap[i].thread);
+}
+
+//----------------------------------------------------------------------
+// PriorityQueue::PriorityQueue
+// 	Initialize an empty queue, with an empty list for each priority.
+//----------------------------------------------------------------------
+
+PriorityQueue::PriorityQueue()
+{
+    for (int w = 0; w < (NumPriorities + 31) / 32; w++)
+	nonEmpty[w] = 0;
+    numInQueue = 0;
+}
+
+//----------------------------------------------------------------------
+// PriorityQueue::~PriorityQueue
+// 	De-allocate the queue.  The threads on it are not deleted.
+//----------------------------------------------------------------------
+
+PriorityQueue::~PriorityQueue()
+{
+}
+
+//----------------------------------------------------------------------
+// PriorityQueue::Highest
+// 	Return the highest priority that has a thread queued, or -1 if
+//	the queue is empty.
+//----------------------------------------------------------------------
+
+int
+PriorityQueue::Highest()
+{
+    for (int w = (NumPriorities + 31) / 32 - 1; w >= 0; w--) {
+	if (nonEmpty[w] != 0)
+	    return w * 32 + 31 - __builtin_clz(nonEmpty[w]);
+    }
+    return -1;
+}
+
+//----------------------------------------------------------------------
+// PriorityQueue::Insert
+// 	Add a thread to the end of the list for its priority.
+//----------------------------------------------------------------------
+
+void
+PriorityQueue::Insert(Thread *thread)
+{
+    int p = thread->getPriority();
+
+    ASSERT(p >= 0 && p < NumPriorities);
+    level[p].Append(thread);
+    nonEmpty[p / 32] |= 1 << (p % 32);
+    numInQueue++;
+}
+
+//----------------------------------------------------------------------
+// PriorityQueue::RemoveFront
+// 	Take the first thread of the highest priority off the queue.
+//	Returns NULL if the queue is empty.
+//----------------------------------------------------------------------
+
+Thread *
+PriorityQueue::RemoveFront()
+{
+    int p = Highest();
+    Thread *front;
+
+    if (p == -1)
+	return NULL;
+    front = level[p].RemoveFront();
+    if (level[p].IsEmpty())
+	nonEmpty[p / 32] &= ~(1 << (p % 32));
+    numInQueue--;
+    return front;
+}
+
+//----------------------------------------------------------------------
+// PriorityQueue::Front
+// 	Return the first thread of the highest priority, without removing
+//	it, or NULL if the queue is empty.
+//----------------------------------------------------------------------
+
+Thread *
+PriorityQueue::Front()
+{
+    int p = Highest();
+
+    return p == -1 ? NULL : level[p].Front();
+}
+
+//----------------------------------------------------------------------
+// PriorityQueue::Remove
+// 	Take a thread out of the queue, wherever it is.  It is unlinked
+//	from the list for its priority, so its priority must be the one
+//	it was queued with.
+//----------------------------------------------------------------------
+
+void
+PriorityQueue::Remove(Thread *thread)
+{
+    int p = thread->getPriority();
+
+    ASSERT(p >= 0 && p < NumPriorities);
+    level[p].Remove(thread);
+    if (level[p].IsEmpty())
+	nonEmpty[p / 32] &= ~(1 << (p % 32));
+    numInQueue--;
+}
+
+//----------------------------------------------------------------------
+// PriorityQueue::Apply
+// 	Call "func" on every thread in the queue, highest priority first.
+//----------------------------------------------------------------------
+
+void
+PriorityQueue::Apply(void (*func)(Thread *))
+{
+    for (int p = NumPriorities - 1; p >= 0; p--)
+	level[p].Apply(func);
+}
+
+//----------------------------------------------------------------------
+// ReadyQueue::ReadyQueue
+// 	Initialize an empty level, kept in whichever kind of queue
+//	"selectRule" needs.
+//----------------------------------------------------------------------
+
+ReadyQueue::ReadyQueue(SelectRule selectRule)
+{
+    rule = selectRule;
+    sjf = NULL;
+    priority = NULL;
+    fifo = NULL;
+    switch (rule) {
+      case ShortestJob:
+      case Stride:
+      case EarliestDeadline:
+	sjf = new SJFQueue(rule);
+	break;
+      case HighestPriority:
+	priority = new PriorityQueue;
+	break;
+      case RoundRobin:
+	fifo = new DList<Thread, ReadyLink>;
+	break;
+      default:
+	ASSERTNOTREACHED();
+    }
+}
+
+//----------------------------------------------------------------------
+// ReadyQueue::~ReadyQueue
+// 	De-allocate the level.  The threads on it are not deleted.
+//----------------------------------------------------------------------
+
+ReadyQueue::~ReadyQueue()
+{
+    delete sjf;
+    delete priority;
+    delete fifo;
+}
+
+//----------------------------------------------------------------------
+// ReadyQueue::Insert, ReadyQueue::RemoveFront, ReadyQueue::Front,
+// ReadyQueue::Remove, ReadyQueue::IsEmpty, ReadyQueue::NumInQueue,
+// ReadyQueue::Apply
+// 	Pass the operation on to the level's queue.
+//----------------------------------------------------------------------
+
+void
+ReadyQueue::Insert(Thread *thread)
+{
+    switch (rule) {
+      case ShortestJob:
+      case Stride:
+      case EarliestDeadline:	sjf->Insert(thread); break;
+      case HighestPriority:	priority->Insert(thread); break;
+      default:			fifo->Append(thread); break;
+    }
+}
+
+Thread *
+ReadyQueue::RemoveFront()
+{
+    switch (rule) {
+      case ShortestJob:
+      case Stride:
+      case EarliestDeadline:	return sjf->RemoveFront();
+      case HighestPriority:	return priority->RemoveFront();
+      default:			return fifo->RemoveFront();
+    }
+}
+
+Thread *
+ReadyQueue::Front()
+{
+    switch (rule) {
+      case ShortestJob:
+      case Stride:
+      case EarliestDeadline:	return sjf->Front();
+      case HighestPriority:	return priority->Front();
+      default:			return fifo->Front();
+    }
+}
+
+void
+ReadyQueue::Remove(Thread *thread)
+{
+    switch (rule) {
+      case ShortestJob:
+      case Stride:
+      case EarliestDeadline:	sjf->Remove(thread); break;
+      case HighestPriority:	priority->Remove(thread); break;
+      default:			fifo->Remove(thread); break;
+    }
+}
+
+bool
+ReadyQueue::IsEmpty()
+{
+    return NumInQueue() == 0;
+}
+
+int
+ReadyQueue::NumInQueue()
+{
+    switch (rule) {
+      case ShortestJob:
+      case Stride:
+      case EarliestDeadline:	return sjf->NumInQueue();
+      case HighestPriority:	return priority->NumInQueue();
+      default:			return fifo->NumInList();
+    }
+}
+
+void
+ReadyQueue::Apply(void (*func)(Thread *))
+{
+    switch (rule) {
+      case ShortestJob:
+      case Stride:
+      case EarliestDeadline:	sjf->Apply(func); break;
+      case HighestPriority:	priority->Apply(func); break;
+      default:			fifo->Apply(func); break;
+    }
+}
+
+//----------------------------------------------------------------------
+// ReadyQueue::RemoveBack
+// 	Take the last thread off a round robin level: the one that
+//	would wait longest for its turn.  Returns NULL if it is empty.
+//----------------------------------------------------------------------
+
+Thread *
+ReadyQueue::RemoveBack()
+{
+    ASSERT(rule == RoundRobin);
+    return fifo->RemoveBack();
+}
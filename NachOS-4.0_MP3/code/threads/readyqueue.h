@@ -0,0 +1,155 @@
+// readyqueue.h
+//	Data structures for the scheduler's ready queues.
+//
+//	SJFQueue holds the L1 threads, shortest predicted burst first.
+//	It is a binary heap, so insert and remove are O(log n) rather
+//	than the linear walk of a SortedList.  The same heap, keyed on
+//	deadlines instead, holds the real-time threads; keyed on pass
+//	values, it holds a stride scheduling level.
+//
+//	PriorityQueue holds the L2 threads, highest priority first.
+//	Since priorities are small integers, it keeps a FIFO list for
+//	each priority and a bitmap of the non-empty ones, so insert and
+//	remove are O(1).  The lists are DLists linked through the threads
+//	themselves, so taking a thread out of the middle of one is O(1)
+//	too, and moving a thread between queues allocates nothing.
+//
+//	In both, threads with the same key come out in the order they
+//	went in, as they did from a SortedList.
+//
+//	ReadyQueue is one level of the multilevel scheduler: whichever
+//	of the above (or a plain FIFO list, for round robin) its
+//	selection rule needs.
+//
+// Copyright (c) 1992-1996 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#ifndef READYQUEUE_H
+#define READYQUEUE_H
+
+#include "copyright.h"
+#include "dlist.h"
+
+class Thread;
+
+// The DLists a thread can be on at once.  A ready thread is on one
+// ready queue list and, if it can still be aged, its level's aging
+// list.
+
+enum ThreadLink {
+    ReadyLink,			// a PriorityQueue or round robin list
+    AgingLink			// a Processor's aging list
+};
+
+// Thread priorities are 0 .. NumPriorities-1
+
+const int NumPriorities = 150;
+
+// How a ReadyQueue picks the next thread
+
+enum SelectRule {
+    ShortestJob,		// shortest predicted burst (SJFQueue)
+    HighestPriority,		// highest priority (PriorityQueue)
+    RoundRobin,			// first in, first out
+    Stride,			// lowest pass value (SJFQueue)
+    EarliestDeadline		// earliest deadline (SJFQueue); only
+				// for the real-time threads
+};
+
+// One thread on an SJFQueue
+
+class SJFEntry {
+  public:
+    Thread *thread;
+    int key;			// its predicted burst, deadline or pass,
+				// when it was queued
+    int order;			// when it was queued, to break ties
+};
+
+// The following class defines a queue of threads ordered by
+// predicted burst time, by absolute deadline, or by pass value.
+
+class SJFQueue {
+  public:
+    SJFQueue(SelectRule order = ShortestJob);
+				// initialize an empty queue
+    ~SJFQueue();		// de-allocate the queue
+
+    void Insert(Thread *thread);	// queue a thread
+    Thread *RemoveFront();	// take off the shortest job, or NULL
+    Thread *Front();		// return the shortest job, or NULL
+    void Remove(Thread *thread);	// take a thread out of the heap
+    bool IsEmpty() { return numInQueue == 0; }
+    int NumInQueue() { return numInQueue; }
+    void Apply(void (*func)(Thread *));	// call func on every thread,
+					// in no particular order
+
+  private:
+    bool Before(int a, int b);	// should heap[a] come out before heap[b]?
+    void Swap(int a, int b);
+    void SiftUp(int i);		// move heap[i] up or down to its place
+    void SiftDown(int i);
+
+    SelectRule order;		// ShortestJob, Stride or EarliestDeadline
+    SJFEntry *heap;		// heap[0] is the shortest job
+    int numInQueue;		// threads in the heap
+    int size;			// entries allocated in the heap
+    int numInserted;		// for SJFEntry::order
+};
+
+// The following class defines a queue of threads ordered by
+// priority, highest first.
+
+class PriorityQueue {
+  public:
+    PriorityQueue();		// initialize an empty queue
+    ~PriorityQueue();		// de-allocate the queue
+
+    void Insert(Thread *thread);	// queue a thread
+    Thread *RemoveFront();	// take off the highest priority, or NULL
+    Thread *Front();		// return the highest priority, or NULL
+    void Remove(Thread *thread);	// take a thread out of the queue;
+					// its priority must not have changed
+    bool IsEmpty() { return numInQueue == 0; }
+    int NumInQueue() { return numInQueue; }
+    void Apply(void (*func)(Thread *));	// call func on every thread,
+					// highest priority first
+
+  private:
+    int Highest();		// highest non-empty priority, or -1
+
+    DList<Thread, ReadyLink> level[NumPriorities];
+				// threads at each priority
+    unsigned int nonEmpty[(NumPriorities + 31) / 32];
+				// bit p is set if level[p] is non-empty
+    int numInQueue;		// threads at all priorities
+};
+
+// The following class defines one level of ready threads, ordered
+// by its selection rule.
+
+class ReadyQueue {
+  public:
+    ReadyQueue(SelectRule rule);	// initialize an empty queue
+    ~ReadyQueue();		// de-allocate the queue
+
+    void Insert(Thread *thread);	// queue a thread
+    Thread *RemoveFront();	// take off the next thread, or NULL
+    Thread *Front();		// return the next thread, or NULL
+    void Remove(Thread *thread);	// take a thread out of the queue
+    Thread *RemoveBack();	// take off the thread that would run
+				// last; RoundRobin only
+    bool IsEmpty();
+    int NumInQueue();
+    void Apply(void (*func)(Thread *));	// call func on every thread
+
+    SelectRule rule;		// which of the following is used
+
+  private:
+    SJFQueue *sjf;
+    PriorityQueue *priority;
+    DList<Thread, ReadyLink> *fifo;
+};
+
+#endif // READYQUEUE_H
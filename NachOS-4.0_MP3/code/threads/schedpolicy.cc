@@ -0,0 +1,177 @@
+// schedpolicy.cc
+//	Routines to set up the multilevel feedback scheduling policy,
+//	and to make the decisions that depend on it.
+//
+// Copyright (c) 1992-1996 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "schedpolicy.h"
+#include "thread.h"
+#include "sysdep.h"
+#include <fstream>
+
+static char *ruleNames[] = { "sjf", "priority", "rr", "stride", "edf" };
+
+//----------------------------------------------------------------------
+// SchedPolicy::SchedPolicy
+// 	Initialize the default policy: the three MP3 levels.
+//----------------------------------------------------------------------
+
+SchedPolicy::SchedPolicy()
+{
+    static const SchedLevel mp3[] = {
+	{ 100, ShortestJob,	0, TRUE,  1500, 10, 0 },	// L1
+	{ 50,  HighestPriority,	0, FALSE, 1500, 10, 0 },	// L2
+	{ 0,   RoundRobin,	1, FALSE, 1500, 10, 0 },	// L3
+    };
+
+    numLevels = sizeof(mp3) / sizeof(mp3[0]);
+    for (int i = 0; i < numLevels; i++)
+	level[i] = mp3[i];
+}
+
+//----------------------------------------------------------------------
+// SchedPolicy::Load
+// 	Replace the levels with those read from a file, in the format
+//	described in schedpolicy.h.  If the file can't be read, or a
+//	line is not valid, print why and keep the current policy.
+//
+//	"fileName" is the UNIX file to read
+//----------------------------------------------------------------------
+
+bool
+SchedPolicy::Load(char *fileName)
+{
+    ifstream in(fileName);
+    SchedLevel table[MaxLevels];
+    char buf[200], rule[20];
+    int n = 0, line = 0, preemptive;
+    SchedLevel *l;
+
+    if (!in) {
+	cout << "Can't open scheduling policy " << fileName << "\n";
+	return FALSE;
+    }
+    while (in.getline(buf, sizeof(buf))) {
+	line++;
+	if (buf[0] == '#' || sscanf(buf, " %19s", rule) != 1)
+	    continue;			// comment or blank line
+	if (n == MaxLevels) {
+	    cout << fileName << ":" << line << ": more than "
+		 << MaxLevels << " levels\n";
+	    return FALSE;
+	}
+	l = &table[n];
+	if (sscanf(buf, " level %d %19s %d %d %d %d %d", &l->minPriority,
+			rule, &l->quantum, &preemptive, &l->agingTicks,
+			&l->agingPriority, &l->demotePriority) != 7) {
+	    cout << fileName << ":" << line << ": expected \"level <min "
+		 << "priority> <rule> <quantum> <preemptive> <aging ticks> "
+		 << "<aging priority> <demote priority>\"\n";
+	    return FALSE;
+	}
+	if (strcmp(rule, "sjf") == 0) {
+	    l->rule = ShortestJob;
+	} else if (strcmp(rule, "priority") == 0) {
+	    l->rule = HighestPriority;
+	} else if (strcmp(rule, "rr") == 0) {
+	    l->rule = RoundRobin;
+	} else if (strcmp(rule, "stride") == 0) {
+	    l->rule = Stride;
+	} else {
+	    cout << fileName << ":" << line << ": unknown rule " << rule << "\n";
+	    return FALSE;
+	}
+	l->preemptive = (preemptive != 0);
+	if (l->minPriority < 0 || l->minPriority >= NumPriorities
+		|| (n > 0 && l->minPriority >= table[n - 1].minPriority)
+		|| l->quantum < 0 || l->agingTicks < 0
+		|| l->agingPriority < 0 || l->demotePriority < 0) {
+	    cout << fileName << ":" << line << ": bad level\n";
+	    return FALSE;
+	}
+	n++;
+    }
+    if (n == 0 || table[n - 1].minPriority != 0) {
+	cout << fileName << ": the last level must start at priority 0\n";
+	return FALSE;
+    }
+    numLevels = n;
+    for (int i = 0; i < numLevels; i++)
+	level[i] = table[i];
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// SchedPolicy::LevelOf
+// 	Return the level a thread with "priority" is queued at: the first
+//	one whose minimum priority it meets.
+//----------------------------------------------------------------------
+
+int
+SchedPolicy::LevelOf(int priority)
+{
+    int i;
+
+    for (i = 0; i < numLevels - 1 && priority < level[i].minPriority; i++)
+	;
+    return i;
+}
+
+//----------------------------------------------------------------------
+// SchedPolicy::Preempts
+// 	Return TRUE if the ready thread should be switched in for the
+//	running one: it is at a higher level, or at the same preemptive
+//	level and would be picked first by its rule.  Real-time threads
+//	are above every level, and preempt each other by deadline.
+//----------------------------------------------------------------------
+
+bool
+SchedPolicy::Preempts(Thread *ready, Thread *running)
+{
+    int r = LevelOf(ready->getPriority());
+    int s = LevelOf(running->getPriority());
+
+    if (ready->IsRealTime() != running->IsRealTime())
+	return ready->IsRealTime();
+    if (ready->IsRealTime())
+	return ready->AbsDeadline() < running->AbsDeadline();
+
+    if (r != s)
+	return r < s;
+    if (!level[r].preemptive)
+	return FALSE;
+    switch (level[r].rule) {
+      case ShortestJob:
+	return ready->getBurstTime() < running->getBurstTime();
+      case HighestPriority:
+	return ready->getPriority() > running->getPriority();
+      case Stride:
+	return ready->pass < running->pass;
+      default:
+	return FALSE;			// FIFO never preempts itself
+    }
+}
+
+//----------------------------------------------------------------------
+// SchedPolicy::Print
+// 	Print the table of levels, in the format Load reads.
+//----------------------------------------------------------------------
+
+void
+SchedPolicy::Print()
+{
+    SchedLevel *l;
+
+    cout << "# level <min priority> <rule> <quantum> <preemptive> "
+	 << "<aging ticks> <aging priority> <demote priority>\n";
+    for (int i = 0; i < numLevels; i++) {
+	l = &level[i];
+	cout << "level " << l->minPriority << " " << ruleNames[l->rule]
+	     << " " << l->quantum << " " << (l->preemptive ? 1 : 0)
+	     << " " << l->agingTicks << " " << l->agingPriority
+	     << " " << l->demotePriority << "\n";
+    }
+}
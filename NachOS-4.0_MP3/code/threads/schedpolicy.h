@@ -0,0 +1,98 @@
+// schedpolicy.h
+//	Data structures for the multilevel feedback scheduling policy.
+//
+//	The policy is a table of levels, highest first.  A thread is
+//	queued at the first level whose minimum priority it meets.
+//	Each level has its own rule for picking the next thread, its
+//	own quantum, and its own aging and demotion parameters.
+//
+//	The default table is the one MP3 has always used:
+//
+//	    level  priority  rule      quantum  preemptive  aging
+//	    L1     100-149   SJF       none     yes         +10/1500
+//	    L2     50-99     priority  none     no          +10/1500
+//	    L3     0-49      RR        1        no          +10/1500
+//
+//	It can be replaced, without recompiling, by a file given with
+//	"-sched".  Each line of the file is either a comment (starting
+//	with #) or gives one level, highest first:
+//
+//	    level <min priority> <sjf|priority|rr|stride> <quantum>
+//		<preemptive> <aging ticks> <aging priority> <demote priority>
+//
+//	A stride level gives its threads CPU time in proportion to their
+//	tickets, a thread's priority plus one: each has a pass value,
+//	which goes up by StrideOne / tickets for every TimerTicks it
+//	runs, and the lowest pass runs next.  A thread joining the level
+//	starts no lower than the pass at the front, so time spent
+//	blocked earns no credit.
+//
+//	A quantum of 0 means threads at the level are never time-sliced;
+//	otherwise a thread is switched out at the first timer interrupt
+//	after it has run that many ticks (so 1 means at every timer
+//	interrupt).  Aging ticks of 0 turns aging off at that level.  A
+//	thread that uses up its quantum loses "demote priority".  The
+//	last level's minimum priority must be 0.
+//
+// Copyright (c) 1992-1996 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#ifndef SCHEDPOLICY_H
+#define SCHEDPOLICY_H
+
+#include "copyright.h"
+#include "readyqueue.h"
+
+// The most levels a policy can have
+
+const int MaxLevels = 8;
+
+// The stride of a thread with one ticket, at a stride level
+
+const int StrideOne = 1 << 12;
+
+class Thread;
+
+// One level of the policy
+
+class SchedLevel {
+  public:
+    int minPriority;		// lowest priority queued at this level
+    SelectRule rule;		// how the next thread is picked
+    int quantum;		// ticks before it is time-sliced, or 0
+    bool preemptive;		// does a ready thread preempt a running
+				// one at this level that it would be
+				// picked before?
+    int agingTicks;		// wait before a ready thread is aged,
+				// or 0 for no aging
+    int agingPriority;		// how much aging raises its priority
+    int demotePriority;		// how much using up a quantum lowers it
+};
+
+// The following class defines the scheduling policy: which level a
+// thread belongs to, and when one thread should preempt another.
+
+class SchedPolicy {
+  public:
+    SchedPolicy();		// initialize the default policy
+    ~SchedPolicy() {}
+
+    bool Load(char *fileName);	// replace the levels with those in a
+				// file; return FALSE, leaving the
+				// policy alone, if it is not valid
+
+    int LevelOf(int priority);	// the level a priority is queued at
+    SchedLevel *Level(int i) { return &level[i]; }
+    int NumLevels() { return numLevels; }
+
+    bool Preempts(Thread *ready, Thread *running);
+				// should "ready" run instead?
+    void Print();		// print the table
+
+  private:
+    int numLevels;		// levels in use
+    SchedLevel level[MaxLevels];	// level[0] is the highest
+};
+
+#endif // SCHEDPOLICY_H
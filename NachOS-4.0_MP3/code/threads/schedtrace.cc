@@ -0,0 +1,128 @@
+// schedtrace.cc
+//	Routines to record scheduling events, and to print them in
+//	the format the scheduler has always used.
+//
+// Copyright (c) 1992-1996 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "main.h"
+#include "schedtrace.h"
+
+//----------------------------------------------------------------------
+// SchedTrace::SchedTrace
+// 	Initialize an empty trace.  The ring buffer is only needed if
+//	events are to be kept until halt.
+//
+//	"traceMode" is what to do with each event
+//----------------------------------------------------------------------
+
+SchedTrace::SchedTrace(TraceMode traceMode)
+{
+    mode = traceMode;
+    ring = (mode == TraceRing) ? new TraceRecord[TraceSize] : NULL;
+    numRecorded = 0;
+}
+
+//----------------------------------------------------------------------
+// SchedTrace::~SchedTrace
+// 	De-allocate the trace.  Any events not yet flushed are lost.
+//----------------------------------------------------------------------
+
+SchedTrace::~SchedTrace()
+{
+    delete [] ring;
+}
+
+//----------------------------------------------------------------------
+// SchedTrace::Add
+// 	Note an event at the current time: either print it now, or
+//	store it in the ring buffer, overwriting the oldest one if the
+//	buffer is full.
+//----------------------------------------------------------------------
+
+void
+SchedTrace::Add(TraceEvent event, int id, char *name, int queue,
+			int oldValue, int newValue)
+{
+    TraceRecord now;
+    TraceRecord *record = (mode == TraceRing) ?
+			&ring[numRecorded++ % TraceSize] : &now;
+
+    record->tick = kernel->stats->totalTicks;
+    record->id = id;
+    record->name = name;
+    record->event = event;
+    record->queue = queue;
+    record->oldValue = oldValue;
+    record->newValue = newValue;
+    if (mode == TraceText)
+	Print(record);
+}
+
+//----------------------------------------------------------------------
+// SchedTrace::Flush
+// 	Print the events in the ring buffer, oldest first, and empty it.
+//	Called when Nachos halts.
+//----------------------------------------------------------------------
+
+void
+SchedTrace::Flush()
+{
+    int first;
+
+    if (mode != TraceRing)
+	return;
+    first = max(0, numRecorded - TraceSize);
+    if (first > 0)
+	cout << "(" << first << " earlier scheduling events not kept)\n";
+    for (int i = first; i < numRecorded; i++)
+	Print(&ring[i % TraceSize]);
+    numRecorded = 0;
+}
+
+//----------------------------------------------------------------------
+// SchedTrace::Print
+// 	Print one event.
+//----------------------------------------------------------------------
+
+void
+SchedTrace::Print(TraceRecord *r)
+{
+    if (r->event != TraceBurst)
+	cout << "Tick[" << r->tick << "]: ";
+    switch (r->event) {
+      case TraceInsert:
+	cout << "Thread[" << r->id << "] is inserted into queue L["
+	     << (int) r->queue << "]\n";
+	break;
+      case TraceRemove:
+	cout << "Thread[" << r->id << "] is removed from queue L["
+	     << (int) r->queue << "]\n";
+	break;
+      case TracePriority:
+	cout << "Thread[" << r->id << "] changes its priority from ["
+	     << r->oldValue << "] to [" << r->newValue << "]\n";
+	break;
+      case TraceSelect:
+	cout << "Thread [" << r->id << "] is now selected for execution\n";
+	break;
+      case TraceReplace:
+	cout << "Thread [" << r->id << "] is replaced, and it has executed ["
+	     << r->newValue << "] ticks\n";
+	break;
+      case TraceSleep:
+	cout << "Thread[" << r->name << "] goes to sleep\n";
+	break;
+      case TraceFinish:
+	cout << "Thread[" << r->id << "] is finished\n";
+	break;
+      case TraceBurst:
+	cout << "Thread [" << r->name << "] suspend\n";
+	cout << "Next Burst Time: " << r->newValue << "\n";
+	break;
+      default:
+	ASSERTNOTREACHED();
+    }
+}
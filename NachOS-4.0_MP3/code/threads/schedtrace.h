@@ -0,0 +1,88 @@
+// schedtrace.h
+//	Data structures for tracing scheduling events: threads entering
+//	and leaving the ready queues, priority changes, context switches.
+//
+//	By default each event is printed as it happens, as it always
+//	has been.  Formatting the text costs far more than scheduling
+//	the thread, so the trace can instead be kept in memory, as
+//	fixed-size records in a ring buffer that is printed (in the same
+//	format) when Nachos halts, or turned off altogether.
+//
+// Copyright (c) 1992-1996 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#ifndef SCHEDTRACE_H
+#define SCHEDTRACE_H
+
+#include "copyright.h"
+#include "utility.h"
+
+// Number of records kept in the ring buffer; older ones are overwritten
+
+const int TraceSize = 8192;
+
+// What to do with trace events
+
+enum TraceMode {
+    TraceText,			// print each event as it happens
+    TraceRing,			// record events, print them at halt
+    TraceOff			// drop events
+};
+
+// Kinds of event; the comments show how each one is printed
+
+enum TraceEvent {
+    TraceInsert,		// Thread[id] is inserted into queue L[queue]
+    TraceRemove,		// Thread[id] is removed from queue L[queue]
+    TracePriority,		// Thread[id] changes its priority from
+				//	[oldValue] to [newValue]
+    TraceSelect,		// Thread [id] is now selected for execution
+    TraceReplace,		// Thread [id] is replaced, and it has
+				//	executed [newValue] ticks
+    TraceSleep,			// Thread[name] goes to sleep
+    TraceFinish,		// Thread[id] is finished
+    TraceBurst			// Thread [name] suspend, and its
+				//	Next Burst Time: newValue
+};
+
+// One event
+
+class TraceRecord {
+  public:
+    int tick;			// kernel->stats->totalTicks at the event
+    int id;			// the thread's ID
+    char *name;			// the thread's name (never freed)
+    char event;			// a TraceEvent
+    char queue;			// ready queue level, for insert/remove
+    int oldValue;		// event specific
+    int newValue;
+};
+
+// The following class records scheduling events.
+
+class SchedTrace {
+  public:
+    SchedTrace(TraceMode mode);	// initialize an empty trace
+    ~SchedTrace();		// de-allocate the trace
+
+    void Record(TraceEvent event, int id, char *name, int queue = 0,
+			int oldValue = 0, int newValue = 0) {
+	if (mode != TraceOff)
+	    Add(event, id, name, queue, oldValue, newValue);
+    }
+				// note an event, unless tracing is off
+    void Flush();		// print and discard the recorded events
+
+  private:
+    void Add(TraceEvent event, int id, char *name, int queue,
+			int oldValue, int newValue);
+    void Print(TraceRecord *record);	// print one event
+
+    TraceMode mode;		// what Record does
+    TraceRecord *ring;		// recorded events, for TraceRing
+    int numRecorded;		// events recorded since the last Flush;
+				// only the last TraceSize are kept
+};
+
+#endif // SCHEDTRACE_H
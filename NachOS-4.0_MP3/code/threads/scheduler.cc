@@ -4,7 +4,8 @@
 //
 // 	These routines assume that interrupts are already disabled.
 //	If interrupts are disabled, we can assume mutual exclusion
-//	(since we are on a uniprocessor).
+//	(since even with several simulated CPUs, only one of them
+//	executes at a time).
 //
 // 	NOTE: We can't use Locks to provide mutual exclusion here, since
 // 	if we needed to wait for a lock, and the lock was busy, we would 
@@ -22,37 +23,160 @@
 #include "debug.h"
 #include "scheduler.h"
 #include "main.h"
+#include "perfcount.h"
+#include "hostprof.h"
+#include "memtrack.h"
+#include "synch.h"
+
+static PerfCounter perfReady("scheduler", "ready");
+static PerfCounter perfSwitches("scheduler", "switches");
+static PerfCounter perfPreemptions("scheduler", "preemptions");
+static PerfHistogram perfQueueLength("scheduler", "queue_length");
+					// of the CPU a thread is made
+					// ready on, counting it
+static PerfCounter perfLonger("scheduler", "quantum_longer");
+static PerfCounter perfShorter("scheduler", "quantum_shorter");
 
 //----------------------------------------------------------------------
-// Scheduler::Scheduler
-// 	Initialize the list of ready but not running threads.
-//	Initially, no ready threads.
+// Processor::Processor
+// 	Initialize an idle CPU, with an empty ready queue for each level
+//	of the policy.
+//
+//	"which" is the CPU's number
+//	"policy" gives the levels, and how each picks its next thread
 //----------------------------------------------------------------------
 
+Processor::Processor(int which, SchedPolicy *policy)
+{
+    id = which;
+    numLevels = policy->NumLevels();
+    running = NULL;
+    dispatchTick = 0;
+    yieldOnReturn = FALSE;
+    lastUser = NULL;
+    loadedSpace = NULL;
+    stallTicks = 0;
+    rtList = new ReadyQueue(EarliestDeadline);
+    for (int i = 0; i < numLevels; i++)
+	readyList[i] = new ReadyQueue(policy->Level(i)->rule);
+}
+
+//----------------------------------------------------------------------
+// Processor::~Processor
+// 	De-allocate a CPU's ready queues.
+//----------------------------------------------------------------------
 
-static int SJFCompare(Thread* a, Thread* b) {
-  if(a->getBurstTime() == b->getBurstTime())
-    return 0;
-  else
-    return a->getBurstTime() > b->getBurstTime() ? 1 : -1;
+Processor::~Processor()
+{
+    delete rtList;
+    for (int i = 0; i < numLevels; i++)
+	delete readyList[i];
 }
 
-static int PriorityCompare(Thread* a, Thread* b) {
-  if(a->getPriority() == b->getPriority())
-    return 0;
-  else
-    return a->getPriority() < b->getPriority() ? 1 : -1;
+//----------------------------------------------------------------------
+// Processor::Load
+// 	Return the number of threads running or ready on this CPU.
+//----------------------------------------------------------------------
+
+int
+Processor::Load()
+{
+    int n = (running != NULL ? 1 : 0) + rtList->NumInQueue();
+
+    for (int i = 0; i < numLevels; i++)
+	n += readyList[i]->NumInQueue();
+    return n;
+}
+
+//----------------------------------------------------------------------
+// ReadyCounter
+// 	Return the number of threads ready at level "level" of every
+//	CPU, for the statistics snapshots.
+//----------------------------------------------------------------------
+
+static int
+ReadyCounter(void *level)
+{
+    return kernel->scheduler->NumReady((int) (long) level);
 }
 
-Scheduler::Scheduler()
+//----------------------------------------------------------------------
+// Scheduler::Scheduler
+// 	Initialize the list of ready but not running threads.
+//	Initially, no ready threads.  The thread calling this is running
+//	on CPU 0; any other CPUs are idle.
+//
+//	"schedPolicy" is the policy to schedule by
+//	"howMany" is the number of CPUs to simulate
+//	"gangSchedule" is set to co-schedule the threads of a program
+//	"cacheAffinity" is set to charge threads for switching CPUs
+//	"adaptiveQuantum" is set to adapt the quanta to the load
+//	"oneShotTimer" is set if the timer is set for the end of each
+//		slice, rather than interrupting every TimerTicks
+//----------------------------------------------------------------------
+
+Scheduler::Scheduler(SchedPolicy *schedPolicy, int howMany,
+		     bool gangSchedule, bool cacheAffinity,
+		     bool adaptiveQuantum, bool oneShotTimer)
 { 
-    blockedThread = new List<Thread *>; 
-    readyList_L1 = new SortedList<Thread *>(SJFCompare);
-    readyList_L2 = new SortedList<Thread *>(PriorityCompare);
-    readyList_L3 = new List<Thread *>;
+    ASSERT(howMany >= 1 && howMany <= MaxCPUs);
+    policy = schedPolicy;
+    numCPUs = howMany;
+    gang = gangSchedule;
+    affinity = cacheAffinity;
+    rtDensity = 0.0;
+    anyStride = FALSE;
+    for (int l = 0; l < policy->NumLevels(); l++) {
+	if (policy->Level(l)->rule == Stride)
+	    anyStride = TRUE;
+    }
+    nextWindow = FairnessWindow;
+    adaptive = adaptiveQuantum;
+    oneShot = oneShotTimer;
+    for (int l = 0; l < policy->NumLevels(); l++)
+	quantum[l] = BaseQuantum(l);
+    nextAdapt = AdaptWindow;
+    adaptSwitches = adaptStalls = 0;
+    cpus = new Processor *[numCPUs];
+    for (int i = 0; i < numCPUs; i++)
+	cpus[i] = new Processor(i, policy);
+    current = cpus[0];
+    current->running = kernel->currentThread;
+    kernel->currentThread->cpu = 0;
+    kernel->currentThread->level =
+		policy->LevelOf(kernel->currentThread->getPriority());
+    numBlocked = 0;
     toBeDestroyed = NULL;
+    userStateOwner = NULL;
+    for (int l = 0; l < policy->NumLevels(); l++) {
+	char *name = new char[20];	// (never freed)
+
+	sprintf(name, "ready_L%d", l + 1);
+	kernel->stats->AddCounter(name, ReadyCounter, (void *) (long) l);
+    }
+    if (affinity) {
+	kernel->stats->AddCounter("page_table_loads",
+				  &kernel->stats->numPageTableLoads);
+	kernel->stats->AddCounter("stall_ticks", &kernel->stats->numStallTicks);
+    }
 } 
 
+//----------------------------------------------------------------------
+// Scheduler::NumReady
+// 	Return the number of threads on the ready queues for "level",
+//	on every CPU.
+//----------------------------------------------------------------------
+
+int
+Scheduler::NumReady(int level)
+{
+    int n = 0;
+
+    for (int i = 0; i < numCPUs; i++)
+	n += cpus[i]->readyList[level]->NumInQueue();
+    return n;
+}
+
 //----------------------------------------------------------------------
 // Scheduler::~Scheduler
 // 	De-allocate the list of ready threads.
@@ -60,9 +184,9 @@ Scheduler::Scheduler()
 
 Scheduler::~Scheduler()
 { 
-    delete readyList_L1;
-    delete readyList_L2;
-    delete readyList_L3;   
+    for (int i = 0; i < numCPUs; i++)
+	delete cpus[i];
+    delete [] cpus;
 } 
 
 //----------------------------------------------------------------------
@@ -70,44 +194,114 @@ Scheduler::~Scheduler()
 // 	Mark a thread as ready, but not running.
 //	Put it on the ready list, for later scheduling onto the CPU.
 //
+//	A thread goes back to the queues of the CPU it last ran on,
+//	unless some CPU is idle with nothing queued.  A thread that has
+//	never run goes to the CPU with the least work.
+//
+//	This is where preemption is decided: if the thread should run
+//	instead of the one on its CPU, ask that one to yield.  (Nothing
+//	else queued can preempt it, or it would have already.)  A thread
+//	that is yielding is still running, and doesn't count.
+//
+//	A real-time thread that has used up its budget for the period
+//	is not made ready, but held (as BLOCKED) until the next period
+//	begins.
+//
 //	"thread" is the thread to be put on the ready list.
 //----------------------------------------------------------------------
 
 void
 Scheduler::ReadyToRun (Thread *thread)
 {
-    int priority = thread->getPriority();
-    int prev_Status = thread->getStatus();
-    Thread *currentThread = kernel->currentThread;
+    Processor *cpu;
+    HostProfScope scope(ProfScheduler);
+    MemTagScope tag(MemScheduler);
   
     ASSERT(kernel->interrupt->getLevel() == IntOff);
+    if (thread->IsRealTime()) {
+	if (thread->getStatus() == RUNNING)
+	    Charge(thread);
+	Replenish(thread);
+	if (thread->rtUsed >= thread->rtBudget) {
+	    if (thread->getStatus() != BLOCKED)
+		numBlocked++;
+	    thread->setStatus(BLOCKED);
+	    kernel->alarm->WakeAt(thread, thread->rtRelease + thread->rtPeriod);
+	    return;
+	}
+    }
+    if (thread->cpu != -1) {
+	cpu = cpus[thread->cpu];
+	for (int i = 0; i < numCPUs && cpu->Load() > 0; i++) {
+	    if (cpus[i]->Load() == 0)
+		cpu = cpus[i];
+	}
+    } else {
+	cpu = cpus[0];
+	for (int i = 1; i < numCPUs; i++) {
+	    if (cpus[i]->Load() < cpu->Load())
+		cpu = cpus[i];
+	}
+    }
+    thread->cpu = cpu->id;
     DEBUG(dbgThread, "Putting thread on ready list: " << thread->getName());
 	
+    if (thread->getStatus() == BLOCKED) {
+	numBlocked--;
+	if (kernel->classifier != NULL)
+	    kernel->classifier->Wake(thread);	// placed by its last cycle
+    }
     thread->setStatus(READY);
-    thread->setWaitTime(0);
-    
-    if(thread->getPriority() >= 100){ // put into L1
-        readyList_L1->Insert(thread);
-        cout << "Tick[" << kernel->stats->totalTicks << "]: "
-             << "Thread[" << thread->getID() << "] is inserted into queue L[1]\n";
-             
-    } 
-    else if(thread->getPriority() >= 50) {
-      readyList_L2->Insert(thread);
-      cout << "Tick[" << kernel->stats->totalTicks << "]: "
-           << "Thread[" << thread->getID() << "] is inserted into queue L[2]\n";
+    thread->readyTick = thread->queuedTick = kernel->stats->totalTicks;
+    Enqueue(cpu, thread);
+    perfReady.Inc();
+    perfQueueLength.Record(cpu->Load());
+    if (cpu->running != NULL && cpu->running != thread
+		&& policy->Preempts(thread, cpu->running))
+	Preempt(cpu);
+}
+
+//----------------------------------------------------------------------
+// Scheduler::Enqueue
+// 	Put a ready thread on the queue of "cpu" for the level its
+//	priority belongs to, and start it aging if the level ages.  A
+//	real-time thread goes on the real-time queue ("L0") instead.
+//
+//	At a stride level, a thread that is yielding is first charged
+//	for the time it has run, and no thread joins with a pass below
+//	the one at the front.
+//----------------------------------------------------------------------
+
+void
+Scheduler::Enqueue(Processor *cpu, Thread *thread)
+{
+    Thread *front;
+
+    thread->level = policy->LevelOf(thread->getPriority());
+    if (thread->IsRealTime()) {
+	cpu->rtList->Insert(thread);
+	kernel->schedTrace->Record(TraceInsert, thread->getID(),
+				   thread->getName(), 0);
+	return;
     }
-    else {
-      readyList_L3->Append(thread);
-      cout << "Tick[" << kernel->stats->totalTicks << "]: "
-           << "Thread[" << thread->getID() << "] is inserted into queue L[3]\n";
+    if (cpu->readyList[thread->level]->rule == Stride) {
+	if (thread->getStatus() == RUNNING)
+	    ChargeStride(thread);
+	front = cpu->readyList[thread->level]->Front();
+	if (front != NULL && front->pass > thread->pass)
+	    thread->pass = front->pass;
     }
-    // readyList->Append(thread);
+    cpu->readyList[thread->level]->Insert(thread);
+    kernel->schedTrace->Record(TraceInsert, thread->getID(),
+				thread->getName(), thread->level + 1);
+    if (thread->getPriority() < MaxPriority
+		&& policy->Level(thread->level)->agingTicks > 0)
+	StartAging(thread);
 }
 
 //----------------------------------------------------------------------
 // Scheduler::FindNextToRun
-// 	Return the next thread to be scheduled onto the CPU.
+// 	Return the next thread to be scheduled onto the current CPU.
 //	If there are no ready threads, return NULL.
 // Side effect:
 //	Thread is removed from the ready list.
@@ -116,29 +310,187 @@ Scheduler::ReadyToRun (Thread *thread)
 Thread *
 Scheduler::FindNextToRun ()
 {
+    HostProfScope scope(ProfScheduler);
+    MemTagScope tag(MemScheduler);
+
     ASSERT(kernel->interrupt->getLevel() == IntOff);
 
-    if (readyList_L1->IsEmpty() && readyList_L2->IsEmpty() && readyList_L3->IsEmpty()) {
-		    return NULL;
-    } else {
-      int schedulerType = getScheduleMode();
-      
-      
-      switch (schedulerType) {
-        case SJF:
-          cout << "Tick[" << kernel->stats->totalTicks << "]: Thread["
-               << readyList_L1->Front()->getID() << "] is removed from queue L[1]\n";
-          return readyList_L1->RemoveFront();
-        case Priority:
-          cout << "Tick[" << kernel->stats->totalTicks << "]: Thread["
-               << readyList_L2->Front()->getID() << "] is removed from queue L[2]\n";
-          return readyList_L2->RemoveFront();
-        default: 
-          cout << "Tick[" << kernel->stats->totalTicks << "]: Thread["
-               << readyList_L3->Front()->getID() << "] is removed from queue L[3]\n";
-          return readyList_L3->RemoveFront();
-      }
+    return NextFor(current);
+}
+
+//----------------------------------------------------------------------
+// Scheduler::NextFor
+// 	Take the next thread off the ready queues of "cpu": the one its
+//	highest non-empty level picks -- or, with gang scheduling, a
+//	thread at that level whose program is running on another CPU,
+//	if there is one.  A real-time thread comes before any of them.
+//	If they are all empty, steal a thread from another CPU.  Return
+//	NULL if there is nothing to run.
+//----------------------------------------------------------------------
+
+Thread *
+Scheduler::NextFor(Processor *cpu)
+{
+    Thread *next;
+
+    if (!cpu->rtList->IsEmpty()) {
+	next = cpu->rtList->RemoveFront();
+	kernel->schedTrace->Record(TraceRemove, next->getID(),
+				   next->getName(), 0);
+	return next;
+    }
+    for (int l = 0; l < cpu->numLevels; l++) {
+	if (!cpu->readyList[l]->IsEmpty())
+	    return Take(cpu, l, gang ? GangPick(cpu, l, cpu) : NULL);
+    }
+    return Steal(cpu);
+}
+
+//----------------------------------------------------------------------
+// Scheduler::Take
+// 	Take "thread" off the ready queue of "cpu" for "level", or the
+//	thread at the front of the queue if "thread" is NULL, and stop
+//	it aging.  Return the thread taken.
+//----------------------------------------------------------------------
+
+Thread *
+Scheduler::Take(Processor *cpu, int level, Thread *thread)
+{
+    if (thread == NULL)
+	thread = cpu->readyList[level]->RemoveFront();
+    else
+	cpu->readyList[level]->Remove(thread);
+    kernel->schedTrace->Record(TraceRemove, thread->getID(),
+				thread->getName(), level + 1);
+    StopAging(thread);
+    return thread;
+}
+
+// GangPick's search, through ReadyQueue::Apply
+
+static Processor *gangFor;	// the CPU looking for a thread
+static Thread *gangFound;	// the first suitable thread, or NULL
+
+static void
+GangVisit(Thread *t)
+{
+    if (gangFound == NULL && t->space != NULL
+		&& kernel->scheduler->SpaceRunning(t->space, gangFor))
+	gangFound = t;
+}
+
+//----------------------------------------------------------------------
+// Scheduler::GangPick
+// 	Return a thread on the ready queue of "cpu" for "level" whose
+//	address space has a thread running on some CPU other than
+//	"forCPU", the one that would run it; the first such thread in
+//	the queue's order, as far as ReadyQueue::Apply gives it.  Return
+//	NULL if there is none.  The thread stays on the queue.
+//----------------------------------------------------------------------
+
+Thread *
+Scheduler::GangPick(Processor *cpu, int level, Processor *forCPU)
+{
+    gangFor = forCPU;
+    gangFound = NULL;
+    cpu->readyList[level]->Apply(GangVisit);
+    return gangFound;
+}
+
+//----------------------------------------------------------------------
+// Scheduler::SpaceRunning
+// 	Return TRUE if a thread of "space" is running on a CPU other
+//	than "except".
+//----------------------------------------------------------------------
+
+bool
+Scheduler::SpaceRunning(AddrSpace *space, Processor *except)
+{
+    for (int i = 0; i < numCPUs; i++) {
+	if (cpus[i] != except && cpus[i]->running != NULL
+		&& cpus[i]->running->space == space)
+	    return TRUE;
+    }
+    return FALSE;
+}
+
+//----------------------------------------------------------------------
+// Scheduler::Steal
+// 	"cpu" has nothing to run; take the thread at the tail of the
+//	longest round robin queue of any other CPU.  The tail is the
+//	thread that would have waited longest for its turn there.  Only
+//	round robin and stride threads move (from a stride level, the
+//	front, the one furthest behind), so the order of each CPU's
+//	other queues is left alone.
+//
+//	A real-time thread, the one with the earliest deadline, is
+//	always taken first.  Then, with gang scheduling, a thread at any
+//	level whose program is running on another CPU, highest level
+//	first.
+//
+//	Return NULL if no other CPU has a thread to give.
+//----------------------------------------------------------------------
+
+Thread *
+Scheduler::Steal(Processor *cpu)
+{
+    Processor *victim = NULL;
+    int level = 0;
+    Thread *t;
+
+    for (int i = 0; i < numCPUs; i++) {
+	t = cpus[i]->rtList->Front();
+	if (cpus[i] != cpu && t != NULL && (victim == NULL
+		|| t->AbsDeadline() < victim->rtList->Front()->AbsDeadline()))
+	    victim = cpus[i];
+    }
+    if (victim != NULL) {
+	t = victim->rtList->RemoveFront();
+	kernel->schedTrace->Record(TraceRemove, t->getID(), t->getName(), 0);
+	t->cpu = cpu->id;
+	return t;
     }
+
+    for (int l = 0; gang && l < policy->NumLevels(); l++) {
+	for (int i = 0; i < numCPUs; i++) {
+	    if (cpus[i] == cpu || cpus[i]->readyList[l]->IsEmpty())
+		continue;
+	    t = GangPick(cpus[i], l, cpu);
+	    if (t != NULL) {
+		Take(cpus[i], l, t);
+		DEBUG(dbgThread, "CPU " << cpu->id << " gangs " << t->getName()
+			<< " from CPU " << i);
+		t->cpu = cpu->id;
+		return t;
+	    }
+	}
+    }
+    for (int l = 0; l < policy->NumLevels(); l++) {
+	if (policy->Level(l)->rule != RoundRobin
+		&& policy->Level(l)->rule != Stride)
+	    continue;
+	for (int i = 0; i < numCPUs; i++) {
+	    if (cpus[i] != cpu && !cpus[i]->readyList[l]->IsEmpty() &&
+		    (victim == NULL || cpus[i]->readyList[l]->NumInQueue()
+				> victim->readyList[level]->NumInQueue())) {
+		victim = cpus[i];
+		level = l;
+	    }
+	}
+    }
+    if (victim == NULL)
+	return NULL;
+
+    if (victim->readyList[level]->rule == RoundRobin)
+	t = victim->readyList[level]->RemoveBack();
+    else
+	t = victim->readyList[level]->RemoveFront();
+    kernel->schedTrace->Record(TraceRemove, t->getID(), t->getName(), level + 1);
+    StopAging(t);
+    DEBUG(dbgThread, "CPU " << cpu->id << " steals " << t->getName()
+		<< " from CPU " << victim->id);
+    t->cpu = cpu->id;
+    return t;
 }
 
 //----------------------------------------------------------------------
@@ -150,7 +502,10 @@ Scheduler::FindNextToRun ()
 //      Note: we assume the state of the previously running thread has
 //	already been changed from running to blocked or ready (depending).
 // Side effect:
-//	The global variable kernel->currentThread becomes nextThread.
+//	The global variable kernel->currentThread becomes nextThread,
+//	which is now running on the current CPU.  The current CPU is
+//	usually the one the old thread was on; when switching between
+//	CPUs it has already been changed.
 //
 //	"nextThread" is the thread to be put into the CPU.
 //	"finishing" is set if the current thread is to be deleted
@@ -162,18 +517,28 @@ void
 Scheduler::Run (Thread *nextThread, bool finishing)
 {
     Thread *oldThread = kernel->currentThread;
+    MachineStatus oldStatus = kernel->interrupt->getStatus();
+    HostProfScope scope(ProfScheduler);
+    MemTagScope tag(MemScheduler);
     
     ASSERT(kernel->interrupt->getLevel() == IntOff);
 
+    if (current->running != nextThread) {  // a new thread for this CPU,
+	StopRunning(current);		   // not just its turn to run
+	Dispatch(current, nextThread);
+    }
+    nextThread->cpu = current->id;
+
     if (finishing) {	// mark that we need to delete current thread
        ASSERT(toBeDestroyed == NULL);
        toBeDestroyed = oldThread;
     }
     
-    if (oldThread->space != NULL) {	// if this thread is a user program,
-        oldThread->SaveUserState(); 	// save the user's CPU registers
-		oldThread->space->SaveState();
-    }
+    kernel->stats->numContextSwitches++;
+    perfSwitches.Inc();
+					// a user program's CPU registers
+					// stay in the machine until another
+					// one needs it (see LoadUserState)
     
     oldThread->CheckOverflow();		    // check if the old thread
 					    // had an undetected stack overflow
@@ -193,6 +558,9 @@ Scheduler::Run (Thread *nextThread, bool finishing)
       
     // interrupts are off when we return from switch!
     ASSERT(kernel->interrupt->getLevel() == IntOff);
+    kernel->interrupt->setStatus(oldStatus);	// whichever thread switched
+						// to us may have been in
+						// another mode
 
     DEBUG(dbgThread, "Now in thread: " << oldThread->getName());
 
@@ -200,10 +568,35 @@ Scheduler::Run (Thread *nextThread, bool finishing)
 					// before this one has finished
 					// and needs to be cleaned up
     
-    if (oldThread->space != NULL) {	    // if there is an address space
-        oldThread->RestoreUserState();     // to restore, do it.
-		oldThread->space->RestoreState();
+    if (oldThread->space != NULL)	// if there is an address space
+	LoadUserState(oldThread);	// to restore, do it.
+}
+
+//----------------------------------------------------------------------
+// Scheduler::LoadUserState
+// 	Make sure the machine holds a user program thread's registers and
+//	page table.  They are only copied when they have to be: if the
+//	last thread to run user code was this one, as when it is switched
+//	back in after only kernel threads (or no thread) ran, its
+//	registers are still in the machine.  The previous owner's
+//	registers are saved when they are replaced.  The page table is
+//	only reloaded if it belongs to another address space.
+//
+//	Also called before a thread first jumps to user code.
+//----------------------------------------------------------------------
+
+void
+Scheduler::LoadUserState(Thread *thread)
+{
+    if (userStateOwner != thread) {
+	if (userStateOwner != NULL)
+	    userStateOwner->SaveUserState();
+	thread->RestoreUserState();
+	userStateOwner = thread;
+	kernel->stats->numUserStateCopies++;
     }
+    if (kernel->machine->pageTable != thread->space->pageTable)
+	thread->space->RestoreState();
 }
 
 //----------------------------------------------------------------------
@@ -218,6 +611,18 @@ void
 Scheduler::CheckToBeDestroyed()
 {
     if (toBeDestroyed != NULL) {
+        if (userStateOwner == toBeDestroyed)
+	    userStateOwner = NULL;	// its registers need not be saved
+	if (toBeDestroyed->IsRealTime())
+	    rtDensity -= (double) toBeDestroyed->rtBudget
+					/ toBeDestroyed->rtDeadline;
+	for (int i = 0; i < numCPUs; i++) {
+	    if (cpus[i]->lastUser == toBeDestroyed)
+		cpus[i]->lastUser = NULL;
+	}
+        kernel->stats->ThreadDone(toBeDestroyed);
+	if (kernel->workload != NULL)
+	    kernel->workload->Done(toBeDestroyed);
         delete toBeDestroyed;
          toBeDestroyed = NULL;
     }
@@ -232,190 +637,898 @@ void
 Scheduler::Print()
 {
     cout << "Ready list contents:\n";
-    readyList_L1->Apply(ThreadPrint);
-    readyList_L2->Apply(ThreadPrint);
-    readyList_L3->Apply(ThreadPrint);
+    for (int i = 0; i < numCPUs; i++) {
+	if (numCPUs > 1)
+	    cout << "CPU " << i << ":\n";
+	cpus[i]->rtList->Apply(ThreadPrint);
+	for (int l = 0; l < cpus[i]->numLevels; l++)
+	    cpus[i]->readyList[l]->Apply(ThreadPrint);
+    }
 }
 
+//----------------------------------------------------------------------
+// Scheduler::getScheduleMode, Scheduler::get_readyList_Front
+// 	Which queue the current CPU will take its next thread from,
+//	and the thread at the front of one of its queues.
+//----------------------------------------------------------------------
+
 int 
 Scheduler::getScheduleMode()
 {
-  if(!readyList_L1->IsEmpty())
-    return SJF;
-  else if(!readyList_L2->IsEmpty())
-    return Priority;
-  else if(!readyList_L3->IsEmpty())
-    return RR;
-  else 
-    return ERROR;
+  for (int l = 0; l < current->numLevels; l++) {
+    if (current->readyList[l]->IsEmpty())
+      continue;
+    switch (current->readyList[l]->rule) {
+      case ShortestJob:
+        return SJF;
+      case HighestPriority:
+        return Priority;
+      default:
+        return RR;
+    }
+  }
+  return ERROR;
 }
 
 Thread* 
 Scheduler::get_readyList_Front(int order, bool remove)
 {
-  if(!remove) {
-    switch (order) {
-      case 1:
-        return readyList_L1->Front();
-      case 2:
-        return readyList_L2->Front();
-      case 3:
-        return readyList_L3->Front();
-      default:
-        return NULL;
+  Thread *t;
+
+  if (order < 1 || order > current->numLevels)
+    return NULL;
+  if (!remove)
+    return current->readyList[order - 1]->Front();
+  t = current->readyList[order - 1]->RemoveFront();
+  if (t != NULL)
+    StopAging(t);
+  return t;
+}
+
+//----------------------------------------------------------------------
+// Scheduler::Aging
+// 	Called on every tick.  Promote each ready thread that has waited
+//	its level's aging ticks since it was queued (or last promoted).
+//	Each CPU has an aging list for each level.
+//
+//	Rather than counting up a wait time in every ready thread, each
+//	thread records the tick it was queued at, and sits on the aging
+//	list in that order.  Only the threads at the head of a list can
+//	be due, so the cost of a tick does not depend on how many threads
+//	are ready.  Threads already at MaxPriority, or at a level that
+//	doesn't age, are not on the lists.
+//----------------------------------------------------------------------
+
+void
+Scheduler::Aging()
+{
+  int now = kernel->stats->totalTicks;
+  Processor *cpu;
+  Thread *t;
+  int wait;
+  HostProfScope scope(ProfScheduler);
+  MemTagScope tag(MemScheduler);
+
+  for (int i = 0; i < numCPUs; i++) {
+    cpu = cpus[i];
+    for (int l = 0; l < cpu->numLevels; l++) {
+      wait = policy->Level(l)->agingTicks;
+      while ((t = cpu->aging[l].Front()) != NULL && now - t->readyTick >= wait) {
+        StopAging(t);
+        Promote(t);
+      }
     }
+  }
+}
+
+//----------------------------------------------------------------------
+// Scheduler::Promote
+// 	Raise the priority of a ready thread that has waited long enough,
+//	moving it to a higher level if it crosses into one, and ask for
+//	a context switch if it should now preempt the thread running on
+//	its CPU.
+//	The thread then starts waiting for its next promotion.
+//----------------------------------------------------------------------
+
+void
+Scheduler::Promote(Thread *t)
+{
+  Requeue(t, min(t->getPriority() + policy->Level(t->level)->agingPriority,
+				MaxPriority));
+  t->readyTick = kernel->stats->totalTicks;
+  if (t->getPriority() < MaxPriority && policy->Level(t->level)->agingTicks > 0)
+    StartAging(t);
+}
+
+//----------------------------------------------------------------------
+// Scheduler::SetPriority
+// 	Change the priority of a thread, whatever its state, for priority
+//	inheritance.  A ready thread is moved to its new place in the
+//	queues, and restarts its wait for aging there.  If a running
+//	thread is lowered, another CPU may now have to preempt it.  A
+//	real-time thread's place doesn't depend on its priority.  A
+//	thread waiting on a semaphore, lock or condition is moved in
+//	its WaitQueue.
+//----------------------------------------------------------------------
+
+void
+Scheduler::SetPriority(Thread *t, int newPriority)
+{
+  int priority = t->getPriority();
+
+  if (newPriority == priority)
+    return;
+  if (t->getStatus() != READY || t->IsRealTime()) {
+    kernel->schedTrace->Record(TracePriority, t->getID(), t->getName(), 0,
+				priority, newPriority);
+    if (t->waitQueue != NULL)
+      t->waitQueue->SetPriority(t, newPriority);	// keep its place
+    else
+      t->setPriority(newPriority);
+    if (t->getStatus() == RUNNING && newPriority < priority)
+      CheckPreempt(t);
+    return;
+  }
+  StopAging(t);
+  Requeue(t, newPriority);
+  t->readyTick = kernel->stats->totalTicks;
+  if (newPriority < MaxPriority && policy->Level(t->level)->agingTicks > 0)
+    StartAging(t);
+}
+
+//----------------------------------------------------------------------
+// Scheduler::Requeue
+// 	Give a ready thread, not on the aging list, a new priority,
+//	moving it to another level if it crosses into one, and ask for
+//	a context switch if it should now preempt the thread running on
+//	its CPU.
+//----------------------------------------------------------------------
+
+void
+Scheduler::Requeue(Thread *t, int newPriority)
+{
+  Processor *cpu = cpus[t->cpu];
+  Thread *running = cpu->running;
+  int level = t->level;
+  int priority = t->getPriority();
+  int newLevel = policy->LevelOf(newPriority);
+
+  kernel->schedTrace->Record(TracePriority, t->getID(), t->getName(), 0,
+				priority, newPriority);
+
+  if (newLevel == level && cpu->readyList[level]->rule != HighestPriority) {
+    t->setPriority(newPriority);	// its place doesn't depend on
+					// its priority, so it stays put
+  } else if (newLevel == level) {
+    cpu->readyList[level]->Remove(t);
+    t->setPriority(newPriority);
+    cpu->readyList[level]->Insert(t);	// re-sort by the new priority
   } else {
-    switch (order) {
-      case 1:
-        return readyList_L1->RemoveFront();
-      case 2:
-        return readyList_L2->RemoveFront();
-      case 3:
-        return readyList_L3->RemoveFront();
-      default:
-        return NULL;
-    }
+    cpu->readyList[level]->Remove(t);
+    t->setPriority(newPriority);
+    kernel->schedTrace->Record(TraceRemove, t->getID(), t->getName(), level + 1);
+    t->level = newLevel;
+    cpu->readyList[newLevel]->Insert(t);
+    kernel->schedTrace->Record(TraceInsert, t->getID(), t->getName(), newLevel + 1);
   }
+  if (running != NULL && policy->Preempts(t, running))
+    Preempt(cpu);
 }
 
+//----------------------------------------------------------------------
+// Scheduler::StartAging
+// 	Put a thread that was just queued, or just promoted, at the tail
+//	of the aging list for its level on its CPU.  Its readyTick is the
+//	latest on the list.
+//----------------------------------------------------------------------
+
 void
-Scheduler::Aging()
+Scheduler::StartAging(Thread *t)
 {
-  int status = kernel->interrupt->getStatus();
-  int priority, newPriority, waitTime;
-  int tick_plus = (status == 1 ? 10 : 1);
-  
-  SortedList<Thread *> *tmp_L1 = new SortedList<Thread *>(SJFCompare);
-  SortedList<Thread *> *tmp_L2 = new SortedList<Thread *>(PriorityCompare);
-  List<Thread *> *tmp_L3 = new List<Thread *>;
-  Thread *t, *currentThread = kernel->currentThread;
-  
+  cpus[t->cpu]->aging[t->level].Append(t);
+}
 
-    while(!readyList_L1->IsEmpty()) {
-      priority = readyList_L1->Front()->getPriority();
-      waitTime = readyList_L1->Front()->getWaitTime();
-      
-      if(waitTime + tick_plus < 1500) {
-        // cout << "Tick[" << kernel->stats->totalTicks << "]: Thread["
-        //      << t->getName() << "] changes its waitTime"
-        //      << " from [" << waitTime << "] to [" << waitTime + tick_plus << "]\n";
-        
-        t->setWaitTime(waitTime + tick_plus);
-        tmp_L1->Insert(readyList_L1->RemoveFront());
-      } else {
-        newPriority = (priority <= 139? priority+10 : 149);
-        
-        readyList_L1->Front()->setWaitTime(0);
-        
-        cout << "Tick[" << kernel->stats->totalTicks << "]: Thread["
-             << readyList_L1->Front()->getID() << "] changes its priority from [" << priority
-             << "] to [" << newPriority << "]\n";
-        readyList_L1->Front()->setPriority(newPriority);
-        
-        tmp_L1->Insert(readyList_L1->RemoveFront());
-      }
+//----------------------------------------------------------------------
+// Scheduler::StopAging
+// 	Take a thread off the aging list, because it is leaving the ready
+//	queues or is being promoted.  Harmless if it isn't on the list.
+//----------------------------------------------------------------------
+
+void
+Scheduler::StopAging(Thread *t)
+{
+  DList<Thread, AgingLink> *aging = &cpus[t->cpu]->aging[t->level];
+
+  if (aging->IsInList(t))
+    aging->Remove(t);
+}
+
+//----------------------------------------------------------------------
+// Scheduler::CheckPreempt
+// 	Called when the priority of "running", a running thread, drops.
+//	Ask its CPU to context switch if the thread its ready queues
+//	would pick next should run instead, as the policy decides.  No
+//	other CPU is affected.
+//----------------------------------------------------------------------
+
+void
+Scheduler::CheckPreempt(Thread *running)
+{
+  Processor *cpu = cpus[running->cpu];
+  Thread *first = cpu->rtList->Front();
+
+  ASSERT(cpu->running == running);
+  for (int l = 0; l < cpu->numLevels && first == NULL; l++)
+    first = cpu->readyList[l]->Front();
+  if (first != NULL && policy->Preempts(first, running))
+    Preempt(cpu);
+}
+
+//----------------------------------------------------------------------
+// Scheduler::TimeSlice
+// 	Called on each timer interrupt.  Ask every CPU whose thread has
+//	run for its level's quantum to switch, and demote the thread if
+//	the level says to.  A real-time thread has no quantum; its CPU
+//	is asked to switch once it has used up its budget for the
+//	period.  So budgets are enforced to within a timer interrupt.
+//
+//	A thread at a stride level whose quantum is up keeps running
+//	while its pass is still the lowest.  With a stride level, this is
+//	also where each fairness window is closed, and with an adaptive
+//	quantum, each adaptation window.
+//----------------------------------------------------------------------
+
+void
+Scheduler::TimeSlice()
+{
+  Thread *running, *first;
+  SchedLevel *level;
+  int priority, q;
+
+  if (anyStride && kernel->stats->totalTicks >= nextWindow)
+    MeasureFairness();
+  if (adaptive && kernel->stats->totalTicks >= nextAdapt)
+    AdaptQuanta();
+  for (int i = 0; i < numCPUs; i++) {
+    running = cpus[i]->running;
+    if (running == NULL)
+      continue;
+    if (running->IsRealTime()) {
+      Charge(running);
+      Replenish(running);
+      if (running->rtUsed >= running->rtBudget)
+	Preempt(cpus[i]);
+      continue;
     }
-    readyList_L1 = tmp_L1;
-    
-    
-    while(!readyList_L2->IsEmpty()) {
-      priority = readyList_L2->Front()->getPriority();
-      waitTime = readyList_L2->Front()->getWaitTime();
-      
-      if(waitTime + tick_plus < 1500) {
-        // cout << "Tick[" << kernel->stats->totalTicks << "]: Thread["
-        //      << readyList_L2->Front()->getName() << "] changes its waitTime"
-        //      << " from [" << waitTime << "] to [" << waitTime + tick_plus << "]\n";
-        // 
-        readyList_L2->Front()->setWaitTime(waitTime + tick_plus);
-        tmp_L2->Insert(readyList_L2->RemoveFront());
-      } else {
-        newPriority = (priority <= 139? priority+10 : 149);
-        
-        readyList_L2->Front()->setWaitTime(0);
-        
-        cout << "Tick[" << kernel->stats->totalTicks << "]: Thread["
-             << readyList_L2->Front()->getID() << "] changes its priority from [" << priority
-             << "] to [" << newPriority << "]\n";
-        readyList_L2->Front()->setPriority(newPriority);
-
-        if(priority >= 90) {
-          t = readyList_L2->RemoveFront();
-          cout << "Tick[" << kernel->stats->totalTicks << "]: Thread["
-               << t->getID() << "] is removed from queue L[2]\n";
-          
-          readyList_L1->Insert(t);
-          cout << "Tick[" << kernel->stats->totalTicks << "]: Thread["
-               << t->getID() << "] is inserted into queue L[1]\n";
-          
-          if(currentThread->getPriority() >= 100 && currentThread->getBurstTime() > t->getBurstTime()) {
-            kernel->interrupt->YieldOnReturn();
-          } else if(currentThread->getPriority() >= 50) {
-            kernel->interrupt->YieldOnReturn();
-          }
-          
-        } else {
-          t = readyList_L2->RemoveFront();
-          tmp_L2->Insert(t);
-        }
-      }
+    if (kernel->classifier != NULL)
+      kernel->classifier->CheckHog(running, running->ticksRun - running->cycleRun
+		+ kernel->stats->totalTicks - cpus[i]->dispatchTick);
+    priority = running->getPriority();
+    level = policy->Level(policy->LevelOf(priority));
+    q = Quantum(policy->LevelOf(priority));
+    if (q == 0 || kernel->stats->totalTicks - cpus[i]->dispatchTick < q)
+      continue;
+    if (level->rule == Stride) {
+      ChargeStride(running);
+      first = cpus[i]->readyList[policy->LevelOf(priority)]->Front();
+      if (first == NULL || first->pass >= running->pass)
+	continue;			// it is still furthest behind
     }
-    readyList_L2 = tmp_L2;
-    
-    while(!readyList_L3->IsEmpty()) {
-      priority = readyList_L3->Front()->getPriority();
-      waitTime = readyList_L3->Front()->getWaitTime();
-      
-      if(waitTime + tick_plus < 1500) {
-        // cout << "Tick[" << kernel->stats->totalTicks << "]: Thread["
-        //      << readyList_L3->Front()->getName() << "] changes its waitTime"
-        //      << " from [" << waitTime << "] to [" << waitTime + tick_plus << "]\n";
-             
-        readyList_L3->Front()->setWaitTime(waitTime + tick_plus);
-        tmp_L3->Append(readyList_L3->RemoveFront());
-      } else {
-        newPriority = (priority <= 139? priority+10 : 149);
-        
-        readyList_L3->Front()->setWaitTime(0);
-        
-        cout << "Tick[" << kernel->stats->totalTicks << "]: Thread["
-             << readyList_L3->Front()->getID() << "] changes its priority from [" << priority
-             << "] to [" << newPriority << "]\n";
-        readyList_L3->Front()->setPriority(newPriority);
-
-        if(priority >= 40) {
-          t = readyList_L3->RemoveFront();
-          cout << "Tick[" << kernel->stats->totalTicks << "]: Thread["
-               << t->getID() << "] is removed from queue L[3]\n";
-          
-          readyList_L2->Insert(t);
-          cout << "Tick[" << kernel->stats->totalTicks << "]: Thread["
-               << t->getID() << "] is inserted into queue L[2]\n";
-               
-          if(currentThread->getPriority() < 50) {
-            kernel->interrupt->YieldOnReturn();
-          }   
-        } else {
-          tmp_L3->Append(readyList_L3->Front());
-          readyList_L3->RemoveFront();
-        }
-      }
+    Preempt(cpus[i]);
+    if (level->demotePriority > 0 && priority > 0) {
+      running->setPriority(max(priority - level->demotePriority, 0));
+      kernel->schedTrace->Record(TracePriority, running->getID(),
+		running->getName(), 0, priority, running->getPriority());
     }
-    readyList_L3 = tmp_L3;
-      
+  }
+}
+
+//----------------------------------------------------------------------
+// Scheduler::BaseQuantum
+// 	Return the policy's quantum for "level", or 0 if it isn't time
+//	sliced.  With a one-shot timer, a quantum shorter than TimerTicks
+//	is TimerTicks, which is what it comes to with the periodic one:
+//	a thread is switched out at the first timer interrupt after its
+//	quantum is up.
+//----------------------------------------------------------------------
+
+int
+Scheduler::BaseQuantum(int level)
+{
+  int q = policy->Level(level)->quantum;
+
+  return (oneShot && q > 0) ? max(q, TimerTicks) : q;
 }
-void 
-Scheduler::BlockThreadRemove()
+
+//----------------------------------------------------------------------
+// Scheduler::Quantum
+// 	Return how long a thread at "level" runs before it is time
+//	sliced, or 0 if never: the policy's, unless it has been adapted.
+//----------------------------------------------------------------------
+
+int
+Scheduler::Quantum(int level)
 {
-  List<Thread *> *tmp_block = new List<Thread *>;
+  return quantum[level];
+}
+
+//----------------------------------------------------------------------
+// Scheduler::AdaptQuanta
+// 	End an adaptation window: lengthen the quantum of each level
+//	that has a short queue, or of every level if switching cost too
+//	much of the window, and shorten the others back towards the
+//	policy's (see AdaptWindow).
+//----------------------------------------------------------------------
+
+void
+Scheduler::AdaptQuanta()
+{
+  Statistics *stats = kernel->stats;
+  int now = stats->totalTicks;
+  int window = now - (nextAdapt - AdaptWindow);
+  int overhead = (stats->numContextSwitches - adaptSwitches) * SystemTick
+		+ stats->numStallTicks - adaptStalls;
+  bool costly = overhead * 100 > window * SwitchOverheadTarget;
+  int base, q;
+
+  for (int l = 0; l < policy->NumLevels(); l++) {
+    base = BaseQuantum(l);
+    if (base == 0)
+      continue;
+    if (costly || NumReady(l) <= ShortQueue * numCPUs)
+      q = min(quantum[l] * 2, base * MaxQuantumScale);
+    else
+      q = max(quantum[l] / 2, base);
+    if (q == quantum[l])
+      continue;
+    DEBUG(dbgThread, "Quantum of L" << l + 1 << " now " << q << " ticks, "
+		<< NumReady(l) << " ready, switching " << overhead
+		<< " of " << window << " ticks");
+    if (q > quantum[l])
+      perfLonger.Inc();
+    else
+      perfShorter.Inc();
+    quantum[l] = q;
+  }
+  adaptSwitches = stats->numContextSwitches;
+  adaptStalls = stats->numStallTicks;
+  nextAdapt = now + AdaptWindow;
+}
+
+//----------------------------------------------------------------------
+// Scheduler::NextSliceDue
+// 	Return the earliest time TimeSlice has something to do, for a
+//	one-shot timer: the earliest any running thread's quantum, or a
+//	real-time thread's budget or period, is up, or the end of a
+//	fairness or adaptation window, or when -classify should check a
+//	thread for hogging the CPU -- and at most MaxTimerGap away, for
+//	anything else.  A thread past its quantum that was left running
+//	is looked at again TimerTicks later, as with the periodic timer.
+//	Return -1 if no CPU is running a thread.
+//----------------------------------------------------------------------
+
+int
+Scheduler::NextSliceDue()
+{
+  int now = kernel->stats->totalTicks;
+  int next = -1, due, q;
   Thread *t;
-  
-  while(!blockedThread->IsEmpty()) {
-    t =  blockedThread->RemoveFront();
-    
-    if(t->getStatus() == BLOCKED) {
-      tmp_block->Append(t);
+
+  for (int i = 0; i < numCPUs; i++) {
+    t = cpus[i]->running;
+    if (t == NULL)
+      continue;
+    due = now + MaxTimerGap;		// whatever else it might do
+    if (t->IsRealTime()) {
+      due = min(due, now + t->rtBudget - t->rtUsed - (now - t->rtSince));
+      due = min(due, t->rtRelease + t->rtPeriod);
+    } else {
+      q = Quantum(policy->LevelOf(t->getPriority()));
+      if (q > 0)
+	due = min(due, (cpus[i]->dispatchTick + q > now)
+			? cpus[i]->dispatchTick + q : now + TimerTicks);
+      if (kernel->classifier != NULL
+		&& policy->LevelOf(t->getPriority()) != policy->NumLevels() - 1)
+	due = min(due, now + HogTicks
+		- (t->ticksRun - t->cycleRun + now - cpus[i]->dispatchTick));
     }
+    if (next == -1 || due < next)
+      next = due;
+  }
+  if (next == -1)
+    return -1;
+  if (anyStride)
+    next = min(next, nextWindow);
+  if (adaptive)
+    next = min(next, nextAdapt);
+  return max(next, now + 1);
+}
+
+//----------------------------------------------------------------------
+// Scheduler::SetRealTime
+// 	Make "thread", the running thread, a real-time thread: from now
+//	on it runs a job every "period" ticks, which must be done
+//	within "deadline" ticks of the period starting (0 means by the
+//	end of the period), and may run for "budget" ticks each period.
+//	Returns FALSE, and leaves the thread as it was, if the
+//	parameters don't make sense, or if admitting it would let the
+//	real-time threads ask for more than one CPU's time: the sum of
+//	budget/deadline over them must stay at most 1, which is enough
+//	for earliest deadline first to meet every deadline.
+//
+//	Budgets are enforced, and periods start, at timer interrupts, so
+//	a period must be at least TimerTicks long.
+//
+//	A period of 0 makes the thread an ordinary one again.
+//----------------------------------------------------------------------
+
+bool
+Scheduler::SetRealTime(Thread *t, int period, int budget, int deadline)
+{
+  double old = t->IsRealTime() ? (double) t->rtBudget / t->rtDeadline : 0.0;
+  double density;
+
+  ASSERT(t->getStatus() == RUNNING);
+  if (period == 0) {
+    rtDensity -= old;
+    t->rtPeriod = 0;
+    return TRUE;
+  }
+  if (deadline == 0)
+    deadline = period;
+  if (period < TimerTicks || budget <= 0 || budget > deadline
+		|| deadline > period) {
+    kernel->stats->numRealTimeRefused++;
+    return FALSE;
+  }
+  density = (double) budget / deadline;
+  if (rtDensity - old + density > 1.0) {
+    DEBUG(dbgThread, "Real-time " << t->getName() << " refused: "
+		<< rtDensity - old << " of the CPU is taken");
+    kernel->stats->numRealTimeRefused++;
+    return FALSE;
+  }
+  rtDensity += density - old;
+  t->rtPeriod = period;
+  t->rtBudget = budget;
+  t->rtDeadline = deadline;
+  t->rtRelease = t->rtSince = kernel->stats->totalTicks;
+  t->rtUsed = 0;
+  t->rtDone = t->rtLate = FALSE;
+  return TRUE;
+}
+
+//----------------------------------------------------------------------
+// Scheduler::NextPeriod
+// 	The current thread, a real-time thread, has finished this
+//	period's job.  Count it, and whether it was late, and wait for
+//	the next period to begin -- at once, if it already has.
+//----------------------------------------------------------------------
+
+void
+Scheduler::NextPeriod()
+{
+  Thread *t = kernel->currentThread;
+  IntStatus oldLevel = kernel->interrupt->SetLevel(IntOff);
+  int now = kernel->stats->totalTicks;
+  int next;
+
+  if (t->IsRealTime()) {
+    Charge(t);
+    kernel->stats->numRealTimeJobs++;
+    if (now > t->AbsDeadline() && !t->rtLate)
+      MissDeadline(t);
+    t->rtDone = TRUE;
+    next = t->rtRelease + t->rtPeriod;
+    if (next > now)
+      kernel->alarm->WaitUntil(next - now);
+    else
+      Replenish(t);
+  }
+  (void) kernel->interrupt->SetLevel(oldLevel);
+}
+
+//----------------------------------------------------------------------
+// Scheduler::Charge
+// 	Count the time a running real-time thread has run since it was
+//	last charged against its budget.
+//----------------------------------------------------------------------
+
+void
+Scheduler::Charge(Thread *t)
+{
+  int now = kernel->stats->totalTicks;
+
+  t->rtUsed += now - t->rtSince;
+  t->rtSince = now;
+}
+
+//----------------------------------------------------------------------
+// Scheduler::Replenish
+// 	If a real-time thread's period is over, start the one the clock
+//	is now in, with a full budget.  A job still unfinished at the end
+//	of its period has missed its deadline; the thread carries on
+//	with it in the new one.
+//----------------------------------------------------------------------
+
+void
+Scheduler::Replenish(Thread *t)
+{
+  int now = kernel->stats->totalTicks;
+
+  if (now < t->rtRelease + t->rtPeriod)
+    return;
+  if (!t->rtDone && !t->rtLate)
+    MissDeadline(t);
+  t->rtRelease += (now - t->rtRelease) / t->rtPeriod * t->rtPeriod;
+  t->rtUsed = 0;
+  t->rtDone = t->rtLate = FALSE;
+}
+
+//----------------------------------------------------------------------
+// Scheduler::MissDeadline
+// 	Count a real-time thread's current job as late, once.
+//----------------------------------------------------------------------
+
+void
+Scheduler::MissDeadline(Thread *t)
+{
+  DEBUG(dbgThread, "Real-time " << t->getName() << " missed its deadline "
+		<< t->AbsDeadline());
+  t->rtLate = TRUE;
+  kernel->stats->numDeadlineMisses++;
+}
+
+//----------------------------------------------------------------------
+// Scheduler::AtStride
+// 	Return TRUE if a thread is at (ready or running from) a stride
+//	level.
+//----------------------------------------------------------------------
+
+bool
+Scheduler::AtStride(Thread *t)
+{
+  return !t->IsRealTime() && policy->Level(t->level)->rule == Stride;
+}
+
+//----------------------------------------------------------------------
+// Scheduler::ChargeStride
+// 	Advance the pass of a thread running at a stride level by its
+//	stride, StrideOne / tickets, for every TimerTicks it has run
+//	since it was last charged; the rest carries over to next time.
+//	A thread's tickets are its priority plus one.
+//----------------------------------------------------------------------
+
+void
+Scheduler::ChargeStride(Thread *t)
+{
+  int now = kernel->stats->totalTicks;
+  int ran = now - t->strideSince;
+
+  t->strideSince = now;
+  t->windowTicks += ran;
+  t->passTicks += ran * (StrideOne / (t->getPriority() + 1));
+  t->pass += t->passTicks / TimerTicks;
+  t->passTicks %= TimerTicks;
+}
+
+// MeasureFairness's sums, through ReadyQueue::Apply
+
+static int fairCount;		// threads at stride levels
+static double fairSum;		// sum of their ticks per ticket
+static double fairSquares;	// and of its square
+
+static void
+FairnessVisit(Thread *t)
+{
+  double share = (double) t->windowTicks / (t->getPriority() + 1);
+
+  fairCount++;
+  fairSum += share;
+  fairSquares += share * share;
+  t->windowTicks = 0;
+}
+
+//----------------------------------------------------------------------
+// Scheduler::MeasureFairness
+// 	End a fairness window: work out Jain's index of how fairly the
+//	threads at stride levels, ready or running, shared the CPU in it
+//	for their tickets,
+//
+//		(sum of x)^2 / (n * sum of x^2)
+//
+//	where x is a thread's ticks run in the window per ticket.  It is
+//	1 for a perfectly proportional share, and 1/n if one thread had
+//	it all.  Windows with fewer than two such threads, or in which
+//	none of them ran, don't count.
+//----------------------------------------------------------------------
+
+void
+Scheduler::MeasureFairness()
+{
+  Thread *running;
+
+  fairCount = 0;
+  fairSum = fairSquares = 0.0;
+  for (int i = 0; i < numCPUs; i++) {
+    running = cpus[i]->running;
+    if (running != NULL && AtStride(running)) {
+      ChargeStride(running);
+      FairnessVisit(running);
+    }
+    for (int l = 0; l < cpus[i]->numLevels; l++) {
+      if (cpus[i]->readyList[l]->rule == Stride)
+	cpus[i]->readyList[l]->Apply(FairnessVisit);
+    }
+  }
+  if (fairCount >= 2 && fairSquares > 0.0) {
+    kernel->stats->strideFairness += fairSum * fairSum
+					/ (fairCount * fairSquares);
+    kernel->stats->numFairnessWindows++;
   }
-  blockedThread = tmp_block;
-}
\ No newline at end of file
+  nextWindow = kernel->stats->totalTicks + FairnessWindow;
+}
+
+//----------------------------------------------------------------------
+// Scheduler::Preempt
+// 	Ask for the thread running on "cpu" to yield, the next time it
+//	executes an instruction.  This must be a flag per CPU, since
+//	before then the other CPUs may take their turns.
+//----------------------------------------------------------------------
+
+void
+Scheduler::Preempt(Processor *cpu)
+{
+  if (!cpu->yieldOnReturn && cpu->running != NULL) {
+    cpu->running->numPreemptions++;
+    perfPreemptions.Inc();
+  }
+  cpu->yieldOnReturn = TRUE;
+}
+
+//----------------------------------------------------------------------
+// Scheduler::Dispatch
+// 	Make "thread", just taken off the ready queues, the one running
+//	on "cpu", and count how long it waited to get there.
+//
+//	With the cache affinity model, a user thread stalls before it
+//	runs: WarmSwitchTicks if it was the last user thread on this CPU,
+//	otherwise ColdSwitchTicks, and PageTableLoadTicks more if the
+//	CPU has another address space's page table loaded.
+//----------------------------------------------------------------------
+
+void
+Scheduler::Dispatch(Processor *cpu, Thread *thread)
+{
+  int now = kernel->stats->totalTicks;
+
+  cpu->running = thread;
+  cpu->dispatchTick = now;
+  cpu->yieldOnReturn = FALSE;
+  thread->waitTicks += now - thread->queuedTick;
+  kernel->stats->RecordLatency(now - thread->queuedTick);
+  if (thread->firstRunTick == -1)
+    thread->firstRunTick = now;
+  thread->rtSince = thread->strideSince = now;
+  if (oneShot)
+    kernel->alarm->Reprogram();	// for the end of its slice
+
+  cpu->stallTicks = 0;
+  if (!affinity || thread->space == NULL)
+    return;
+  if (cpu->lastUser == thread) {
+    cpu->stallTicks = WarmSwitchTicks;
+  } else {
+    cpu->stallTicks = ColdSwitchTicks;
+    cpu->lastUser = thread;
+  }
+  if (cpu->loadedSpace != thread->space) {
+    cpu->stallTicks += PageTableLoadTicks;
+    cpu->loadedSpace = thread->space;
+    kernel->stats->numPageTableLoads++;
+  }
+}
+
+//----------------------------------------------------------------------
+// Scheduler::StopRunning
+// 	The thread on "cpu", if any, is blocking, finishing or being
+//	switched out.  Charge it for the time since it was dispatched,
+//	and leave the CPU idle.
+//----------------------------------------------------------------------
+
+void
+Scheduler::StopRunning(Processor *cpu)
+{
+  Thread *t = cpu->running;
+  int ran;
+
+  if (t == NULL)
+    return;
+  if (t->IsRealTime())
+    Charge(t);
+  else if (AtStride(t))
+    ChargeStride(t);
+  ran = kernel->stats->totalTicks - cpu->dispatchTick;
+  if (kernel->timeline != NULL)
+    kernel->timeline->Run(cpu->id, t, cpu->dispatchTick,
+			  kernel->stats->totalTicks);
+  t->ticksRun += ran;
+  t->levelTicks[t->level] += ran;
+  cpu->running = NULL;
+}
+
+//----------------------------------------------------------------------
+// Scheduler::YieldPending
+// 	Return TRUE, once, if the current CPU has been asked to switch
+//	threads.
+//----------------------------------------------------------------------
+
+bool
+Scheduler::YieldPending()
+{
+  bool pending = current->yieldOnReturn;
+
+  current->yieldOnReturn = FALSE;
+  return pending;
+}
+
+//----------------------------------------------------------------------
+// Scheduler::Stalled
+// 	Called before the current thread executes a user instruction.
+//	Return TRUE, and use up one tick of the stall, if the cache
+//	affinity model still has it waiting to run.
+//----------------------------------------------------------------------
+
+bool
+Scheduler::Stalled()
+{
+  if (current->stallTicks == 0)
+    return FALSE;
+  current->stallTicks--;
+  kernel->stats->numStallTicks++;
+  return TRUE;
+}
+
+//----------------------------------------------------------------------
+// Scheduler::NextBusy
+// 	Return the first CPU after the current one, in turn, that is
+//	running a thread, or NULL if no other CPU is busy.
+//----------------------------------------------------------------------
+
+Processor *
+Scheduler::NextBusy()
+{
+  Processor *cpu;
+
+  for (int i = 1; i < numCPUs; i++) {
+    cpu = cpus[(current->id + i) % numCPUs];
+    if (cpu->running != NULL)
+      return cpu;
+  }
+  return NULL;
+}
+
+//----------------------------------------------------------------------
+// Scheduler::OtherCPUsBusy
+// 	Return TRUE if any CPU but the current one is running a thread.
+//----------------------------------------------------------------------
+
+bool
+Scheduler::OtherCPUsBusy()
+{
+  return NextBusy() != NULL;
+}
+
+//----------------------------------------------------------------------
+// Scheduler::AnyReady
+// 	Return TRUE if some CPU has a thread on its ready queues.
+//----------------------------------------------------------------------
+
+bool
+Scheduler::AnyReady()
+{
+  for (int i = 0; i < numCPUs; i++) {
+    if (cpus[i]->Load() > (cpus[i]->running != NULL ? 1 : 0))
+      return TRUE;
+  }
+  return FALSE;
+}
+
+//----------------------------------------------------------------------
+// Scheduler::LastInRound
+// 	Return TRUE if no busy CPU comes after the current one, so every
+//	busy CPU has executed an instruction since the clock last
+//	advanced.
+//----------------------------------------------------------------------
+
+bool
+Scheduler::LastInRound()
+{
+  for (int i = current->id + 1; i < numCPUs; i++) {
+    if (cpus[i]->running != NULL)
+      return FALSE;
+  }
+  return TRUE;
+}
+
+//----------------------------------------------------------------------
+// Scheduler::NextCPU
+// 	Called after the current thread executes a user instruction.
+//	Switch to the thread on the next busy CPU, so that it can
+//	execute its instruction.  Returns once it is the current
+//	thread's turn again -- immediately, if no other CPU is busy.
+//----------------------------------------------------------------------
+
+void
+Scheduler::NextCPU()
+{
+  Processor *next = NextBusy();
+
+  ASSERT(kernel->interrupt->getLevel() == IntOff);
+  if (next != NULL) {
+    current = next;
+    Run(next->running, FALSE);
+  }
+}
+
+//----------------------------------------------------------------------
+// Scheduler::LeaveCPU
+// 	The current thread has blocked or finished, and there is nothing
+//	else for its CPU to do, but another CPU is busy.  Leave this CPU
+//	idle and switch to the thread on the next busy CPU.
+//
+//	"finishing" is set if the current thread is to be deleted
+//----------------------------------------------------------------------
+
+void
+Scheduler::LeaveCPU(bool finishing)
+{
+  Processor *next = NextBusy();
+
+  ASSERT(next != NULL);
+  StopRunning(current);
+  current = next;
+  Run(next->running, finishing);
+}
+
+//----------------------------------------------------------------------
+// Scheduler::Balance
+// 	Give each idle CPU (other than the current one, which is busy
+//	unless it is on its way to idling) the next thread from its own
+//	ready queues, or a stolen one.  The thread starts executing when
+//	that CPU next takes its turn.
+//----------------------------------------------------------------------
+
+void
+Scheduler::Balance()
+{
+  Thread *next;
+
+  for (int i = 0; i < numCPUs; i++) {
+    if (cpus[i] == current || cpus[i]->running != NULL)
+      continue;
+    next = NextFor(cpus[i]);
+    if (next == NULL)
+      continue;
+    Dispatch(cpus[i], next);
+    next->cpu = i;
+    next->setStatus(RUNNING);
+    kernel->schedTrace->Record(TraceSelect, next->getID(), next->getName());
+    next->setStartTime(kernel->stats->userTicks);
+  }
+}
+
+//----------------------------------------------------------------------
+// Scheduler::Account
+// 	Simulated time has advanced by "ticks"; charge it to each CPU as
+//	busy or idle.
+//----------------------------------------------------------------------
+
+void
+Scheduler::Account(int ticks)
+{
+  for (int i = 0; i < numCPUs; i++) {
+    if (cpus[i]->running != NULL)
+      kernel->stats->busyTicks[i] += ticks;
+  }
+}
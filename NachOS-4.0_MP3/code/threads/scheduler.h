@@ -12,15 +12,112 @@
 #include "copyright.h"
 #include "list.h"
 #include "thread.h"
+#include "readyqueue.h"
+#include "schedpolicy.h"
 
+// Aging raises a ready thread's priority up to MaxPriority.
+const int MaxPriority = NumPriorities - 1;
+
+// With the cache affinity model (-affinity), a user thread that is
+// dispatched onto a CPU stalls for a while before it executes: this
+// many user ticks, if it was the last user thread to run there, and
+// its state is still in the CPU's cache...
+const int WarmSwitchTicks = 2;
+// ...or this many, if it has to be fetched...
+const int ColdSwitchTicks = 20;
+// ...plus this many, if its address space's page table isn't the one
+// the CPU has loaded.
+const int PageTableLoadTicks = 10;
+
+// With a stride level, how fairly its threads share the CPU is
+// measured over windows of this many ticks.
+const int FairnessWindow = 1000;
+
+// With an adaptive quantum (-quantum adaptive), each level's quantum
+// is reconsidered every AdaptWindow ticks.  It is doubled, up to
+// MaxQuantumScale times the policy's, if at most ShortQueue threads
+// per CPU are waiting at the level -- there is little to gain by
+// switching -- or if switching took more than SwitchOverheadTarget
+// percent of the window; otherwise it is halved, back down to the
+// policy's.  A switch costs SystemTick, for the interrupts turned
+// back on after it, plus any stall of the cache affinity model.
+const int AdaptWindow = 1000;
+const int MaxQuantumScale = 8;
+const int ShortQueue = 1;
+const int SwitchOverheadTarget = 5;
+
+// With a one-shot timer (-timer oneshot), the longest there can be
+// between timer interrupts while a thread is running: ten TimerTicks.
+const int MaxTimerGap = 1000;
+
+// The per-CPU part of the scheduler: the thread a CPU is running,
+// and its own ready queues, one per level of the policy, with the
+// real-time threads' queue above them.  A thread
+// stays on the queues of the CPU it last ran on; a CPU with nothing
+// to do steals from the round robin queues of another.
+
+class Processor {
+  public:
+    Processor(int id, SchedPolicy *policy);
+				// initialize an idle CPU
+    ~Processor();		// de-allocate its ready queues
+
+    int Load();			// threads running or ready on this CPU
+
+    int id;			// which CPU this is
+    int numLevels;		// ready queues in use
+    Thread *running;		// thread on this CPU, or NULL if it is idle
+    int dispatchTick;		// when it was switched in
+    bool yieldOnReturn;		// context switch the running thread at
+				// the next instruction it executes
+    Thread *lastUser;		// last user thread to run here, whose
+				// state is in the cache, or NULL
+    AddrSpace *loadedSpace;	// whose page table this CPU has loaded
+    int stallTicks;		// user ticks before the running thread
+				// executes again (cache affinity model)
+    ReadyQueue *rtList;		// real-time threads, earliest deadline
+				// first; above all the levels
+    ReadyQueue *readyList[MaxLevels];	// readyList[0] is L1, and so on
+
+    DList<Thread, AgingLink> aging[MaxLevels];
+				// ready threads at each level that
+				// can still be aged, oldest
+				// readyTick first; since every thread
+				// at a level ages after the same wait,
+				// the next one due is at the head
+};
 
 // The following class defines the scheduler/dispatcher abstraction -- 
 // the data structures and operations needed to keep track of which 
 // thread is running, and which threads are ready but not running.
+//
+// With more than one CPU, the CPUs take turns to execute one user
+// instruction each; the simulated clock advances once all of them
+// have.  kernel->currentThread is always the thread on the CPU whose
+// turn it is.
+//
+// Two options model multi-threaded user programs on several CPUs:
+//
+//	gang scheduling: a CPU picking a thread prefers, within the
+//	level it picks from, one whose address space is running on
+//	another CPU, and an idle CPU steals such a thread before any
+//	other; so the threads of a program tend to run at the same time,
+//	rather than one holding a lock while the others wait a quantum
+//	for it
+//
+//	cache affinity: a user thread pays for being switched onto a
+//	CPU, less if it was the last one there (see WarmSwitchTicks)
+//
+// Real-time threads are a class of their own, above L1: they are
+// scheduled earliest deadline first, each within the budget it was
+// admitted with (see SetRealTime).
 
 class Scheduler {
   public:
-    Scheduler();		// Initialize list of ready threads 
+    Scheduler(SchedPolicy *policy, int numCPUs = 1, bool gang = FALSE,
+	      bool affinity = FALSE, bool adaptive = FALSE,
+	      bool oneShot = FALSE);
+				// Initialize list of ready threads 
     ~Scheduler();		// De-allocate ready list
 
     void ReadyToRun(Thread* thread);	
@@ -31,27 +128,129 @@ class Scheduler {
     				// Cause nextThread to start running
     void CheckToBeDestroyed();// Check if thread that had been
     				// running needs to be deleted
+    void LoadUserState(Thread *thread);
+				// Put thread's user registers and
+				// page table in the machine, if they
+				// aren't there already
     void Print();		// Print contents of ready list
     
     int getScheduleMode();
     
     Thread* get_readyList_Front(int order, bool remove);
     
-    void Aging();
+    void Aging();		// Promote the ready threads that have
+				// waited long enough at their level
+    void CheckPreempt(Thread *running);
+				// Preempt a running thread, if there
+				// is a better one on its ready queues
+    void TimeSlice();		// Preempt every CPU whose thread has
+				// used up its quantum
+    int Quantum(int level);	// Ticks a thread at "level" runs
+				// before it is time-sliced, or 0
+    int NextSliceDue();		// When TimeSlice next has something
+				// to do, for a one-shot timer; -1 if
+				// no CPU is running a thread
+    void SetPriority(Thread *thread, int priority);
+				// Change a thread's priority, moving
+				// it in the ready queues if need be
+    bool SetRealTime(Thread *thread, int period, int budget, int deadline);
+				// Make the running thread real-time,
+				// if its budget can be guaranteed
+    void NextPeriod();		// The current real-time thread's job
+				// is done; wait for its next period
     
-    void BlockThreadRemove();
+
+    int NumCPUs() { return numCPUs; }
+    Processor *CurrentCPU() { return current; }
+				// the CPU whose turn it is
+    void NextCPU();		// Let the next busy CPU execute an
+				// instruction; returns when it is this
+				// thread's turn again
+    bool LastInRound();		// Has every busy CPU had its turn?
+    void Balance();		// Give each idle CPU a thread, if any
+				// are ready
+    bool OtherCPUsBusy();	// Is another CPU running a thread?
+    bool AnyReady();		// Is a thread ready on any CPU?
+    int NumReady(int level);	// Threads ready at "level", on
+				// every CPU
+    void LeaveCPU(bool finishing);
+				// The current CPU goes idle; run the
+				// thread of the next busy CPU
+    void Preempt(Processor *cpu);	// Context switch cpu's thread
+					// at its next instruction
+    bool YieldPending();	// Should the current thread yield?
+    bool Stalled();		// Must the current thread wait a tick
+				// before its next user instruction?
+    bool SpaceRunning(AddrSpace *space, Processor *except);
+				// Is a thread of "space" running on a
+				// CPU other than "except"?
+    void Account(int ticks);	// Charge elapsed time to each CPU
+    void StopRunning(Processor *cpu);	// cpu's thread is leaving it;
+					// charge it for its time there
     
     // SelfTest for scheduler is implemented in class Thread
     
     
-    List<Thread *> *blockedThread;  // queue of threads that are ready to run,
+    int numBlocked;		// threads asleep, waiting to be woken up
   private:
-    SortedList<Thread *> *readyList_L1; // L1 queue 
-    SortedList<Thread *> *readyList_L2; // L2 queue
-    List<Thread *> *readyList_L3; // L3 queue
-				// but not running
+    SchedPolicy *policy;	// the levels, and when to preempt
+    int numCPUs;		// number of simulated CPUs
+    Processor **cpus;		// their state
+    Processor *current;		// the CPU whose turn it is
+    bool gang;			// co-schedule threads of a program?
+    bool affinity;		// charge threads for switching CPUs?
+    double rtDensity;		// sum of budget/deadline, over the
+				// real-time threads
+    bool anyStride;		// does the policy have a stride level?
+    int nextWindow;		// when the fairness window ends
+    bool adaptive;		// adapt the quanta to the load?
+    bool oneShot;		// is the timer set for each slice's end,
+				// rather than interrupting periodically?
+    int quantum[MaxLevels];	// each level's quantum, as adapted
+    int nextAdapt;		// when the quanta are next reconsidered
+    int adaptSwitches;		// numContextSwitches and numStallTicks
+    int adaptStalls;		// when they last were
     Thread *toBeDestroyed;	// finishing thread to be destroyed
     				// by the next thread that runs
+    Thread *userStateOwner;	// thread whose user registers are in
+				// the machine, or NULL
+
+    Thread *NextFor(Processor *cpu);	// take a thread off cpu's ready
+					// queues, or steal one
+    Thread *Steal(Processor *cpu);	// take the round robin tail of
+					// the CPU with the most such threads
+    Thread *GangPick(Processor *cpu, int level, Processor *forCPU);
+					// find a thread at "level" of cpu
+					// whose program runs elsewhere
+    Thread *Take(Processor *cpu, int level, Thread *thread);
+					// take thread (or the front) off
+					// one of cpu's ready queues
+    void Enqueue(Processor *cpu, Thread *thread);
+					// put thread on the queue for
+					// its priority
+    Processor *NextBusy();	// next busy CPU after the current one
+    void Dispatch(Processor *cpu, Thread *thread);
+				// start thread running on cpu
+
+    void StartAging(Thread *thread);	// put thread at the aging tail
+    void StopAging(Thread *thread);	// take thread off the aging list
+    void Promote(Thread *thread);	// age one thread, moving it up
+					// a queue if need be
+    void Requeue(Thread *thread, int priority);
+					// re-place a ready thread for a
+					// new priority
+
+    void Charge(Thread *thread);	// count a running real-time
+					// thread's time against its budget
+    void Replenish(Thread *thread);	// start its next period, if due
+    void MissDeadline(Thread *thread);	// count a missed deadline
+
+    bool AtStride(Thread *thread);	// is it queued by pass value?
+    void ChargeStride(Thread *thread);	// advance a running thread's pass
+    void MeasureFairness();		// end a fairness window
+
+    int BaseQuantum(int level);		// the policy's quantum for level
+    void AdaptQuanta();			// end an adaptation window
 };
 
 #endif // SCHEDULER_H
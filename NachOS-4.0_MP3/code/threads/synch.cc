@@ -16,17 +16,33 @@
 // re-set the interrupt state back to its original value (whether
 // that be disabled or enabled).
 //
-// Once we'e implemented one set of higher level atomic operations,
-// we can implement others using that implementation.  We illustrate
-// this by implementing locks and condition variables on top of 
-// semaphores, instead of directly enabling and disabling interrupts.
+// Locks and condition variables also disable interrupts directly,
+// rather than being built on semaphores, so that a thread can be
+// moved from a condition's queue to its lock's queue without waking
+// up in between.
 //
-// Locks are implemented using a semaphore to keep track of
-// whether the lock is held or not -- a semaphore value of 0 means
-// the lock is busy; a semaphore value of 1 means the lock is free.
+// A lock keeps its holder and a queue of waiting threads.  Release
+// makes the next waiter the holder before waking it up.
 //
-// The implementation of condition variables using semaphores is
-// a bit trickier, as explained below under Condition::Wait.
+// Turning interrupts back on advances simulated time (see
+// Interrupt::SetLevel), so every P, V, Acquire and Release would cost
+// ticks even when no one else wants what it takes.  With "-synchcost
+// free", one that has nothing to wait for and no one to wake up skips
+// turning interrupts off at all: Nachos runs on one host thread, and
+// kernel code is only ever switched away from inside the interrupt
+// routines, so a few lines that call none of them are already atomic.
+// Such an operation then costs no simulated time, and is not a point
+// where the timer can preempt.  The default, "-synchcost ticks", keeps
+// the interrupt toggling everywhere, and so the timing of the original.
+//
+// A condition keeps a queue of waiting threads.  Signal moves the
+// first one onto the lock's queue, as explained below under
+// Condition::Wait.
+//
+// All three queue their waiters on a WaitQueue, which with
+// "-waitqueue priority" wakes the highest priority thread first.
+// Otherwise "first" above means first to come; "-waitqueue fifo" is
+// the default.
 //
 // Copyright (c) 1992-1996 The Regents of the University of California.
 // All rights reserved.  See copyright.h for copyright notice and limitation 
@@ -35,6 +51,168 @@
 #include "copyright.h"
 #include "synch.h"
 #include "main.h"
+#include "memtrack.h"
+#include "perfcount.h"
+
+static PerfCounter perfFast("synch", "uncontended");	// skipped the
+							// interrupt toggling
+static PerfCounter perfSlow("synch", "interrupts_off");
+
+//----------------------------------------------------------------------
+// WaitQueue::WaitQueue
+// 	Initialize an empty queue of waiting threads.
+//
+//	"byPriority" -- wake the highest priority first, rather than
+//		the first to come?
+//----------------------------------------------------------------------
+
+WaitQueue::WaitQueue(bool byPriority)
+{
+    if (byPriority) {
+	fifo = NULL;
+	this->byPriority = new PriorityQueue;
+    } else {
+	fifo = new List<Thread *>;
+	this->byPriority = NULL;
+    }
+}
+
+//----------------------------------------------------------------------
+// WaitQueue::~WaitQueue
+// 	De-allocate the queue.  Assume no one is still waiting on it!
+//----------------------------------------------------------------------
+
+WaitQueue::~WaitQueue()
+{
+    if (fifo != NULL)
+	delete fifo;
+    else
+	delete byPriority;
+}
+
+//----------------------------------------------------------------------
+// WaitQueue::Append
+// 	Queue "thread", which is about to go to sleep.  By priority, it
+//	goes behind the threads of the same priority, and is linked
+//	through its ready queue link -- free, since it isn't ready -- so
+//	nothing is allocated.
+//----------------------------------------------------------------------
+
+void
+WaitQueue::Append(Thread *thread)
+{
+    ASSERT(thread->waitQueue == NULL);
+    thread->waitQueue = this;
+    if (fifo != NULL)
+	fifo->Append(thread);
+    else
+	byPriority->Insert(thread);
+}
+
+//----------------------------------------------------------------------
+// WaitQueue::RemoveFront
+// 	Take off the thread to wake next: the first queued, or the first
+//	of the highest priority.  Returns NULL if no one is waiting.
+//----------------------------------------------------------------------
+
+Thread *
+WaitQueue::RemoveFront()
+{
+    Thread *thread;
+
+    if (IsEmpty())
+	return NULL;
+    if (fifo != NULL)
+	thread = fifo->RemoveFront();
+    else
+	thread = byPriority->RemoveFront();
+    thread->waitQueue = NULL;
+    return thread;
+}
+
+//----------------------------------------------------------------------
+// WaitQueue::IsEmpty
+// 	Return whether no one is waiting.
+//----------------------------------------------------------------------
+
+bool
+WaitQueue::IsEmpty()
+{
+    return fifo != NULL ? fifo->IsEmpty() : byPriority->IsEmpty();
+}
+
+//----------------------------------------------------------------------
+// WaitQueue::Highest
+// 	Return the highest priority of the waiting threads, or -1 if
+//	there are none.  By priority, that of the front one; else each
+//	has to be looked at.
+//----------------------------------------------------------------------
+
+int
+WaitQueue::Highest()
+{
+    int highest = -1;
+
+    if (byPriority != NULL) {
+	Thread *front = byPriority->Front();
+
+	return front == NULL ? -1 : front->getPriority();
+    }
+    ListIterator<Thread *> iter(fifo);
+    for (; !iter.IsDone(); iter.Next())
+	highest = max(highest, iter.Item()->getPriority());
+    return highest;
+}
+
+//----------------------------------------------------------------------
+// WaitQueue::SetPriority
+// 	Give "thread", waiting on this queue, a new priority.  By
+//	priority, it is moved to the end of the threads at its new
+//	priority, as if it had just come.
+//----------------------------------------------------------------------
+
+void
+WaitQueue::SetPriority(Thread *thread, int priority)
+{
+    ASSERT(thread->waitQueue == this);
+    if (fifo != NULL) {
+	thread->setPriority(priority);
+	return;
+    }
+    byPriority->Remove(thread);
+    thread->setPriority(priority);
+    byPriority->Insert(thread);
+}
+
+//----------------------------------------------------------------------
+// WaitQueue::SelfTest
+// 	Test a queue by priority, with threads that are never run:
+//	the highest priority comes off first, those of the same priority
+//	in the order they went on, and one whose priority is raised
+//	comes off at its new place.
+//----------------------------------------------------------------------
+
+void
+WaitQueue::SelfTest()
+{
+    Thread *t[4];
+    static int priority[4] = { 50, 120, 50, 10 };
+    static int order[4] = { 3, 1, 0, 2 };	// after t[3] is raised
+
+    ASSERT(byPriority != NULL && IsEmpty());	// otherwise test won't work!
+    for (int i = 0; i < 4; i++) {
+	t[i] = new Thread("wait test", i);
+	t[i]->setPriority(priority[i]);
+	Append(t[i]);
+    }
+    ASSERT(Highest() == 120);
+    SetPriority(t[3], 130);
+    for (int i = 0; i < 4; i++)
+	ASSERT(RemoveFront() == t[order[i]]);
+    ASSERT(IsEmpty() && Highest() == -1);
+    for (int i = 0; i < 4; i++)
+	delete t[i];
+}
 
 //----------------------------------------------------------------------
 // Semaphore::Semaphore
@@ -48,7 +226,7 @@ Semaphore::Semaphore(char* debugName, int initialValue)
 {
     name = debugName;
     value = initialValue;
-    queue = new List<Thread *>;
+    queue = new WaitQueue(kernel->priorityWait);
 }
 
 //----------------------------------------------------------------------
@@ -77,7 +255,15 @@ Semaphore::P()
 {
     Interrupt *interrupt = kernel->interrupt;
     Thread *currentThread = kernel->currentThread;
+    MemTagScope tag(MemThreads);	// for the queue of waiters
     
+    if (kernel->freeSynch && value > 0) {	// nothing to wait for
+	value--;
+	perfFast.Inc();
+	return;
+    }
+    perfSlow.Inc();
+
     // disable interrupts
     IntStatus oldLevel = interrupt->SetLevel(IntOff);	
     
@@ -104,6 +290,13 @@ Semaphore::V()
 {
     Interrupt *interrupt = kernel->interrupt;
     
+    if (kernel->freeSynch && queue->IsEmpty()) {	// no one to wake
+	value++;
+	perfFast.Inc();
+	return;
+    }
+    perfSlow.Inc();
+
     // disable interrupts
     IntStatus oldLevel = interrupt->SetLevel(IntOff);
     
@@ -119,7 +312,9 @@ Semaphore::V()
 //----------------------------------------------------------------------
 // Semaphore::SelfTest, SelfTestHelper
 // 	Test the semaphore implementation, by using a semaphore
-//	to control two threads ping-ponging back and forth.
+//	to control two threads ping-ponging back and forth.  With
+//	-synchcost free, also check that a P and V that find no one
+//	else cost no simulated time.
 //----------------------------------------------------------------------
 
 static Semaphore *ping;
@@ -145,6 +340,14 @@ Semaphore::SelfTest()
 	this->P();
     }
     delete ping;
+
+    if (kernel->freeSynch) {
+	int before = kernel->stats->totalTicks;
+
+	this->V();
+	this->P();
+	ASSERT(kernel->stats->totalTicks == before);
+    }
 }
 
 //----------------------------------------------------------------------
@@ -158,8 +361,9 @@ Semaphore::SelfTest()
 Lock::Lock(char* debugName)
 {
     name = debugName;
-    semaphore = new Semaphore("lock", 1);  // initially, unlocked
-    lockHolder = NULL;
+    waitQueue = new WaitQueue(kernel->priorityWait);
+    lockHolder = NULL;			// initially, unlocked
+    nextHeld = NULL;
 }
 
 //----------------------------------------------------------------------
@@ -168,28 +372,52 @@ Lock::Lock(char* debugName)
 //----------------------------------------------------------------------
 Lock::~Lock()
 {
-    delete semaphore;
+    delete waitQueue;
 }
 
 //----------------------------------------------------------------------
 // Lock::Acquire
 //	Atomically wait until the lock is free, then set it to busy.
-//	Equivalent to Semaphore::P(), with the semaphore value of 0
-//	equal to busy, and semaphore value of 1 equal to free.
+//	If it is busy, go to sleep; Release hands the lock over before
+//	waking us up, so there is no need to check again.
+//
+//	Note that Thread::Sleep assumes that interrupts are disabled
+//	when it is called.
 //----------------------------------------------------------------------
 
 void Lock::Acquire()
 {
-    semaphore->P();
-    lockHolder = kernel->currentThread;
+    Interrupt *interrupt = kernel->interrupt;
+    Thread *currentThread = kernel->currentThread;
+    IntStatus oldLevel;
+
+    if (kernel->freeSynch && lockHolder == NULL) {	// free: just take it
+	Take(currentThread);
+	perfFast.Inc();
+	return;
+    }
+    perfSlow.Inc();
+    oldLevel = interrupt->SetLevel(IntOff);
+
+    ASSERT(!IsHeldByCurrentThread());
+    if (lockHolder == NULL) {
+	Take(currentThread);
+    } else {
+	currentThread->waitingFor = this;
+	waitQueue->Append(currentThread);
+	Donate(currentThread->getPriority());
+	currentThread->Sleep(FALSE);
+    }
+    ASSERT(IsHeldByCurrentThread());
+    (void) interrupt->SetLevel(oldLevel);
 }
 
 //----------------------------------------------------------------------
 // Lock::Release
-//	Atomically set lock to be free, waking up a thread waiting
-//	for the lock, if any.
-//	Equivalent to Semaphore::V(), with the semaphore value of 0
-//	equal to busy, and semaphore value of 1 equal to free.
+//	Atomically set lock to be free, or if a thread is waiting for
+//	it, make that thread the holder and wake it up.  The new holder
+//	inherits the priority of the threads still waiting, and we lose
+//	what we inherited from them.
 //
 //	By convention, only the thread that acquired the lock
 // 	may release it.
@@ -197,9 +425,134 @@ void Lock::Acquire()
 
 void Lock::Release()
 {
+    Interrupt *interrupt = kernel->interrupt;
+    IntStatus oldLevel;
+    Thread *next;
+
     ASSERT(IsHeldByCurrentThread());
+    if (kernel->freeSynch && waitQueue->IsEmpty()
+		&& lockHolder->basePriority == -1) {
+	Drop();				// no one waiting, nothing inherited
+	perfFast.Inc();
+	return;
+    }
+    perfSlow.Inc();
+    oldLevel = interrupt->SetLevel(IntOff);
+    Drop();
+    Restore();
+    if (!waitQueue->IsEmpty()) {
+	next = waitQueue->RemoveFront();
+	next->waitingFor = NULL;
+	Take(next);
+	Donate(HighestWaiter());
+	kernel->scheduler->ReadyToRun(next);
+    }
+    (void) interrupt->SetLevel(oldLevel);
+}
+
+//----------------------------------------------------------------------
+// Lock::Take
+//	Make "thread" the holder of the lock, and add the lock to the
+//	ones it holds.
+//----------------------------------------------------------------------
+
+void Lock::Take(Thread *thread)
+{
+    lockHolder = thread;
+    nextHeld = thread->locksHeld;
+    thread->locksHeld = this;
+}
+
+//----------------------------------------------------------------------
+// Lock::Drop
+//	Take the lock off the ones its holder holds, and make it free.
+//----------------------------------------------------------------------
+
+void Lock::Drop()
+{
+    Lock **lock;
+
+    for (lock = &lockHolder->locksHeld; *lock != this; lock = &(*lock)->nextHeld)
+	;
+    *lock = nextHeld;
     lockHolder = NULL;
-    semaphore->V();
+}
+
+//----------------------------------------------------------------------
+// Lock::Donate
+//	A thread of "priority" is waiting for the lock.  Raise the holder
+//	to that priority if it is lower, remembering its own; if the
+//	holder is waiting for another lock, do the same for that lock's
+//	holder, and so on down the chain.
+//----------------------------------------------------------------------
+
+void Lock::Donate(int priority)
+{
+    Thread *holder;
+
+    for (Lock *lock = this; lock != NULL; lock = holder->waitingFor) {
+	holder = lock->lockHolder;
+	if (holder == NULL || holder->getPriority() >= priority)
+	    return;
+	if (holder->basePriority == -1)
+	    holder->basePriority = holder->getPriority();
+	kernel->scheduler->SetPriority(holder, priority);
+    }
+}
+
+//----------------------------------------------------------------------
+// Lock::HighestWaiter
+//	Return the highest priority of the threads waiting for the lock,
+//	or -1 if there are none.
+//----------------------------------------------------------------------
+
+int Lock::HighestWaiter()
+{
+    return waitQueue->Highest();
+}
+
+//----------------------------------------------------------------------
+// Lock::Restore
+//	The current thread has just released a lock.  If it had inherited
+//	a priority, drop it to the highest of its own and those waiting
+//	for the locks it still holds.
+//----------------------------------------------------------------------
+
+void Lock::Restore()
+{
+    Thread *thread = kernel->currentThread;
+    int priority = thread->basePriority;
+
+    if (priority == -1)
+	return;				// never raised
+    for (Lock *lock = thread->locksHeld; lock != NULL; lock = lock->nextHeld)
+	priority = max(priority, lock->HighestWaiter());
+    if (priority == thread->basePriority)
+	thread->basePriority = -1;	// nothing left to inherit
+    if (priority < thread->getPriority())
+	kernel->scheduler->SetPriority(thread, priority);
+}
+
+//----------------------------------------------------------------------
+// Lock::AddWaiter
+//	Queue a thread, already asleep, to be handed the lock once it is
+//	released.  Called by Condition::Signal, whose caller holds the
+//	lock, for a thread that has to re-acquire it.  As in Acquire,
+//	the holder inherits its priority.
+//
+//	"thread" -- the blocked thread
+//----------------------------------------------------------------------
+
+void Lock::AddWaiter(Thread *thread)
+{
+    Interrupt *interrupt = kernel->interrupt;
+    IntStatus oldLevel = interrupt->SetLevel(IntOff);
+
+    ASSERT(IsHeldByCurrentThread());
+    thread->waitingFor = this;
+    waitQueue->Append(thread);
+    Donate(thread->getPriority());
+    (void) interrupt->SetLevel(oldLevel);
 }
 
 //----------------------------------------------------------------------
@@ -213,7 +566,7 @@ void Lock::Release()
 Condition::Condition(char* debugName)
 {
     name = debugName;
-    waitQueue = new List<Semaphore *>;
+    waitQueue = new WaitQueue(kernel->priorityWait);
 }
 
 //----------------------------------------------------------------------
@@ -228,36 +581,38 @@ Condition::~Condition()
 
 //----------------------------------------------------------------------
 // Condition::Wait
-// 	Atomically release monitor lock and go to sleep.
-//	Our implementation uses semaphores to implement this, by
-//	allocating a semaphore for each waiting thread.  The signaller
-//	will V() this semaphore, so there is no chance the waiter
-//	will miss the signal, even though the lock is released before
-//	calling P().
+// 	Atomically release monitor lock and go to sleep.  Interrupts
+//	are disabled from before the lock is released until we are
+//	asleep, so there is no chance the waiter will miss the signal.
 //
 //	Note: we assume Mesa-style semantics, which means that the
-//	waiter must re-acquire the monitor lock when waking up.
+//	waiter must re-acquire the monitor lock when waking up.  Signal
+//	queues us for the lock, so by the time we run, we hold it.
 //
 //	"conditionLock" -- lock protecting the use of this condition
 //----------------------------------------------------------------------
 
 void Condition::Wait(Lock* conditionLock) 
 {
-     Semaphore *waiter;
+     Interrupt *interrupt = kernel->interrupt;
+     Thread *currentThread = kernel->currentThread;
+     IntStatus oldLevel;
     
      ASSERT(conditionLock->IsHeldByCurrentThread());
 
-     waiter = new Semaphore("condition", 0);
-     waitQueue->Append(waiter);
+     oldLevel = interrupt->SetLevel(IntOff);
+     waitQueue->Append(currentThread);
      conditionLock->Release();
-     waiter->P();
-     conditionLock->Acquire();
-     delete waiter;
+     currentThread->Sleep(FALSE);
+     ASSERT(conditionLock->IsHeldByCurrentThread());
+     (void) interrupt->SetLevel(oldLevel);
 }
 
 //----------------------------------------------------------------------
 // Condition::Signal
-// 	Wake up a thread waiting on this condition, if any.
+// 	Wake up a thread waiting on this condition, if any.  It can't
+//	run until it has the lock, which we hold, so instead of making
+//	it ready, move it onto the lock's queue.
 //
 //	Note: we assume Mesa-style semantics, which means that the
 //	signaller doesn't give up control immediately to the thread
@@ -272,19 +627,17 @@ void Condition::Wait(Lock* conditionLock)
 
 void Condition::Signal(Lock* conditionLock)
 {
-    Semaphore *waiter;
-    
     ASSERT(conditionLock->IsHeldByCurrentThread());
     
     if (!waitQueue->IsEmpty()) {
-        waiter = waitQueue->RemoveFront();
-	waiter->V();
+	conditionLock->AddWaiter(waitQueue->RemoveFront());
     }
 }
 
 //----------------------------------------------------------------------
 // Condition::Broadcast
-// 	Wake up all threads waiting on this condition, if any.
+// 	Wake up all threads waiting on this condition, if any.  They
+//	are handed the lock, and so run, one at a time.
 //
 //	"conditionLock" -- lock protecting the use of this condition
 //----------------------------------------------------------------------
@@ -295,3 +648,86 @@ void Condition::Broadcast(Lock* conditionLock)
         Signal(conditionLock);
     }
 }
+
+//----------------------------------------------------------------------
+// RWLock::RWLock
+// 	Initialize a reader-writer lock, held by no one.
+//
+//	"debugName" is an arbitrary name, useful for debugging.
+//----------------------------------------------------------------------
+
+RWLock::RWLock(char* debugName)
+{
+    name = debugName;
+    lock = new Lock("rwlock");
+    canRead = new Condition("rwlock readers");
+    canWrite = new Condition("rwlock writers");
+    numReaders = numWritersWaiting = 0;
+    writer = NULL;
+}
+
+//----------------------------------------------------------------------
+// RWLock::~RWLock
+// 	Deallocate a reader-writer lock.
+//----------------------------------------------------------------------
+
+RWLock::~RWLock()
+{
+    delete canWrite;
+    delete canRead;
+    delete lock;
+}
+
+//----------------------------------------------------------------------
+// RWLock::AcquireRead, RWLock::ReleaseRead
+//	Start and stop reading.  A reader waits while there is a writer,
+//	or one waiting; the last reader out lets a writer in.
+//----------------------------------------------------------------------
+
+void RWLock::AcquireRead()
+{
+    lock->Acquire();
+    while (writer != NULL || numWritersWaiting > 0)
+	canRead->Wait(lock);
+    numReaders++;
+    lock->Release();
+}
+
+void RWLock::ReleaseRead()
+{
+    lock->Acquire();
+    ASSERT(numReaders > 0);
+    if (--numReaders == 0)
+	canWrite->Signal(lock);
+    lock->Release();
+}
+
+//----------------------------------------------------------------------
+// RWLock::AcquireWrite, RWLock::ReleaseWrite
+//	Start and stop writing.  A writer waits until there are no
+//	readers and no other writer.  On the way out it lets the next
+//	writer in if there is one, and otherwise all the waiting readers.
+//----------------------------------------------------------------------
+
+void RWLock::AcquireWrite()
+{
+    lock->Acquire();
+    numWritersWaiting++;
+    while (writer != NULL || numReaders > 0)
+	canWrite->Wait(lock);
+    numWritersWaiting--;
+    writer = kernel->currentThread;
+    lock->Release();
+}
+
+void RWLock::ReleaseWrite()
+{
+    lock->Acquire();
+    ASSERT(IsWriteHeldByCurrentThread());
+    writer = NULL;
+    if (numWritersWaiting > 0)
+	canWrite->Signal(lock);
+    else
+	canRead->Broadcast(lock);
+    lock->Release();
+}
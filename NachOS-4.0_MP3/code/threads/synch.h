@@ -20,8 +20,41 @@
 #include "copyright.h"
 #include "thread.h"
 #include "list.h"
+#include "readyqueue.h"
 #include "main.h"
 
+// The following class defines the queue of threads waiting on a
+// semaphore, lock or condition variable.  It is either first in,
+// first out, as in the original, or ordered by priority (-waitqueue
+// priority): a PriorityQueue, so the thread woken is the one of
+// highest priority, counting any it has inherited, and threads of
+// the same priority are woken in the order they came.  Either way, a
+// thread goes on and comes off in O(1).
+//
+// A thread's priority may change while it waits, when it holds a lock
+// that a higher priority thread then waits for.  Scheduler::SetPriority
+// calls SetPriority here, which moves it to its new place.
+
+class WaitQueue {
+  public:
+    WaitQueue(bool byPriority);	// initialize an empty queue
+    ~WaitQueue();
+
+    void Append(Thread *thread);	// queue a thread about to block
+    Thread *RemoveFront();	// take off the next to wake, or NULL
+    bool IsEmpty();
+    int Highest();		// highest priority waiting, or -1
+    void SetPriority(Thread *thread, int priority);
+				// change the priority of a thread on
+				// the queue, keeping it in order
+    void SelfTest();		// test routine for the queue
+
+  private:
+    List<Thread *> *fifo;	// the waiting threads, first in first
+				// out; or NULL, and instead
+    PriorityQueue *byPriority;	// by priority
+};
+
 // The following class defines a "semaphore" whose value is a non-negative
 // integer.  The semaphore has only two operations P() and V():
 //
@@ -36,6 +69,11 @@
 // into a register, a context switch might have occurred,
 // and some other thread might have called P or V, so the true value might
 // now be different.
+//
+// With -synchcost free, a P that doesn't have to wait and a V that
+// wakes no one (and likewise an Acquire of a free lock, and a Release
+// no one is waiting for) leave interrupts alone, and so cost no
+// simulated time; see synch.cc.
 
 class Semaphore {
   public:
@@ -50,7 +88,7 @@ class Semaphore {
   private:
     char* name;        // useful for debugging
     int value;         // semaphore value, always >= 0
-    List<Thread *> *queue;     
+    WaitQueue *queue;     
 		  	// threads waiting in P() for the value to be > 0
    };
 
@@ -65,6 +103,16 @@ class Semaphore {
 // In addition, by convention, only the thread that acquired the lock
 // may release it.  As with semaphores, you can't read the lock value
 // (because the value might change immediately after you read it).  
+//
+// A released lock is handed straight to the next waiter, which then
+// holds it when it wakes up, rather than having to compete for it
+// again with every other thread that wants it.
+//
+// To avoid priority inversion, the holder of a lock inherits the
+// priority of the highest priority thread waiting for it (and so
+// runs at that thread's level), passing it on to the holder of any
+// lock it is itself waiting for.  It gets its own priority back when
+// it releases the lock.
 
 class Lock {
   public:
@@ -79,13 +127,25 @@ class Lock {
     		return lockHolder == kernel->currentThread; }
     				// return true if the current thread 
 				// holds this lock.
+    void AddWaiter(Thread *thread);
+    				// queue a blocked thread for the lock,
+				// for Condition::Signal
     
     // Note: SelfTest routine provided by SynchList
     
   private:
     char *name;			// debugging assist
     Thread *lockHolder;		// thread currently holding lock
-    Semaphore *semaphore;	// we use a semaphore to implement lock
+    WaitQueue *waitQueue;	// threads waiting to be handed the lock
+    Lock *nextHeld;		// next lock on lockHolder->locksHeld
+
+    void Take(Thread *thread);	// make thread the holder
+    void Drop();		// and take it back
+    void Donate(int priority);	// raise the holder, and any holder it
+				// waits for, to at least priority
+    int HighestWaiter();	// highest priority waiting, or -1
+    void Restore();		// drop the current thread back to the
+				// priority it inherits from other locks
 };
 
 // The following class defines a "condition variable".  A condition
@@ -108,9 +168,12 @@ class Lock {
 //
 // In Nachos, condition variables are assumed to obey *Mesa*-style
 // semantics.  When a Signal or Broadcast wakes up another thread,
-// it simply puts the thread on the ready list, and it is the responsibility
-// of the woken thread to re-acquire the lock (this re-acquire is
-// taken care of within Wait()).  By contrast, some define condition
+// the thread still has to re-acquire the lock before it returns from
+// Wait().  Since the signaller holds the lock, the thread is moved
+// straight onto the lock's queue of waiters, rather than being put on
+// the ready list only to block again on the lock ("wait morphing");
+// Broadcast so hands the lock to the waiters one at a time, instead of
+// waking them all at once.  By contrast, some define condition
 // variables according to *Hoare*-style semantics -- where the signalling
 // thread gives up control over the lock and the CPU to the woken thread,
 // which runs immediately and gives back control over the lock to the 
@@ -139,6 +202,44 @@ class Condition {
 
   private:
     char* name;
-    List<Semaphore *> *waitQueue;	// list of waiting threads
+    WaitQueue *waitQueue;		// list of waiting threads
+};
+
+// The following class defines a "reader-writer lock", for data that is
+// read much more often than it is changed.  Any number of readers can
+// hold it at once, or one writer:
+//
+//	AcquireRead -- wait until no thread is writing, or waiting to
+//		write, then join the readers
+//
+//	AcquireWrite -- wait until no thread is reading or writing, then
+//		become the writer
+//
+// Waiting writers are let in ahead of new readers, so that a steady
+// stream of readers can't keep a writer out forever.  When a writer
+// releases the lock, the readers that were waiting all get in together.
+
+class RWLock {
+  public:
+    RWLock(char* debugName);	// initialize lock to be FREE
+    ~RWLock();			// deallocate lock
+    char* getName() { return name; }	// debugging assist
+
+    void AcquireRead();		// share the lock with other readers
+    void ReleaseRead();
+    void AcquireWrite();	// hold the lock alone
+    void ReleaseWrite();
+
+    bool IsWriteHeldByCurrentThread() {
+		return writer == kernel->currentThread; }
+
+  private:
+    char *name;			// debugging assist
+    Lock *lock;			// protects the fields below
+    Condition *canRead;		// signalled when readers can get in
+    Condition *canWrite;	// signalled when a writer can get in
+    int numReaders;		// threads holding the lock to read
+    int numWritersWaiting;	// threads waiting in AcquireWrite
+    Thread *writer;		// thread holding the lock to write, or NULL
 };
 #endif // SYNCH_H
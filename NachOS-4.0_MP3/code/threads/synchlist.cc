@@ -17,14 +17,20 @@
 //	Allocate and initialize the data structures needed for a 
 //	synchronized list, empty to start with.
 //	Elements can now be added to the list.
+//
+//	"maxItems" is how many items the list can hold, or 0 if it is
+//	unbounded
 //----------------------------------------------------------------------
 
 template <class T>
-SynchList<T>::SynchList()
+SynchList<T>::SynchList(int maxItems)
 {
-    list = new List<T>;
+    ASSERT(maxItems >= 0);
+    list = new Queue<T>;
+    maxInList = maxItems;
     lock = new Lock("list lock"); 
     listEmpty = new Condition("list empty cond");
+    listFull = new Condition("list full cond");
 }
 
 //----------------------------------------------------------------------
@@ -35,6 +41,7 @@ SynchList<T>::SynchList()
 template <class T>
 SynchList<T>::~SynchList()
 { 
+    delete listFull;
     delete listEmpty;
     delete lock;
     delete list;
@@ -43,21 +50,78 @@ SynchList<T>::~SynchList()
 //----------------------------------------------------------------------
 // SynchList<T>::Append
 //      Append an "item" to the end of the list.  Wake up anyone
-//	waiting for an element to be appended.
+//	waiting for an element to be appended.  If the list is full,
+//	wait until there is room.
 //
 //	"item" is the thing to put on the list. 
 //----------------------------------------------------------------------
 
 template <class T>
 void
-SynchList<T>::Append(T item)
+SynchList<T>::Append(const T &item)
 {
     lock->Acquire();		// enforce mutual exclusive access to the list 
+    while (IsFull())
+	listFull->Wait(lock);	// wait until there is room
     list->Append(item);
     listEmpty->Signal(lock);	// wake up a waiter, if any
     lock->Release();
 }
 
+//----------------------------------------------------------------------
+// SynchList<T>::TryAppend
+//      Append an "item" to the end of the list, as Append does, but
+//	if the list is full, return FALSE at once rather than waiting.
+//
+//	"item" is the thing to put on the list. 
+//----------------------------------------------------------------------
+
+template <class T>
+bool
+SynchList<T>::TryAppend(const T &item)
+{
+    bool room;
+
+    lock->Acquire();
+    room = !IsFull();
+    if (room) {
+	list->Append(item);
+	listEmpty->Signal(lock);
+    }
+    lock->Release();
+    return room;
+}
+
+//----------------------------------------------------------------------
+// SynchList<T>::AppendBatch
+//      Append "n" items to the end of the list, in order, holding the
+//	lock throughout unless the list fills up, in which case wait for
+//	room with the items not yet appended.  Everyone waiting for an
+//	item is woken up once, rather than once per item.
+//
+//	"items" is the array of things to put on the list
+//	"n" is how many there are
+//----------------------------------------------------------------------
+
+template <class T>
+void
+SynchList<T>::AppendBatch(T *items, int n)
+{
+    int i = 0;
+
+    lock->Acquire();
+    while (i < n) {
+	while (IsFull()) {
+	    listEmpty->Broadcast(lock);	// let consumers make room
+	    listFull->Wait(lock);
+	}
+	for (; i < n && !IsFull(); i++)
+	    list->Append(items[i]);
+    }
+    listEmpty->Broadcast(lock);
+    lock->Release();
+}
+
 //----------------------------------------------------------------------
 // SynchList<T>::RemoveFront
 //      Remove an "item" from the beginning of the list.  Wait if
@@ -76,10 +140,41 @@ SynchList<T>::RemoveFront()
     while (list->IsEmpty())
 	listEmpty->Wait(lock);		// wait until list isn't empty
     item = list->RemoveFront();
+    if (maxInList > 0)
+	listFull->Signal(lock);		// there is room for one more
     lock->Release();
     return item;
 }
 
+//----------------------------------------------------------------------
+// SynchList<T>::RemoveUpTo
+//      Remove up to "n" items from the beginning of the list, waiting
+//	only if the list is empty.
+//
+//	"items" is where to put the removed items
+//	"n" is how many there is room for
+// Returns:
+//	The number of items removed: at least one, and at most "n".
+//----------------------------------------------------------------------
+
+template <class T>
+int
+SynchList<T>::RemoveUpTo(T *items, int n)
+{
+    int removed;
+
+    ASSERT(n > 0);
+    lock->Acquire();
+    while (list->IsEmpty())
+	listEmpty->Wait(lock);
+    for (removed = 0; removed < n && !list->IsEmpty(); removed++)
+	items[removed] = list->RemoveFront();
+    if (maxInList > 0)
+	listFull->Broadcast(lock);	// there is room for them all
+    lock->Release();
+    return removed;
+}
+
 //----------------------------------------------------------------------
 // SynchList<T>::Apply
 //      Apply function to every item on a list.
@@ -127,4 +222,15 @@ SynchList<T>::SelfTest(T val)
 	ASSERT(val == this->RemoveFront());
     }
     delete selfTestPing;
+
+    SynchList<T> *bounded = new SynchList<T>(4);
+    T batch[4];
+
+    for (int i = 0; i < 4; i++)
+	batch[i] = val;
+    bounded->AppendBatch(batch, 4);
+    ASSERT(bounded->IsFull());
+    ASSERT(bounded->RemoveUpTo(batch, 3) == 3);
+    ASSERT(bounded->RemoveUpTo(batch, 3) == 1 && batch[0] == val);
+    delete bounded;
 }
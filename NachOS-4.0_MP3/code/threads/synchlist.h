@@ -2,6 +2,13 @@
 //	Data structures for synchronized access to a list.
 //
 //	Identical interface to List, except accesses are synchronized.
+//	A list can be given a bound, in which case Append waits for room.
+//	Items can also be appended and removed in batches, so that a
+//	producer or consumer with many items takes the lock only once.
+//
+//	The items are kept by value in a Queue, so appending one allocates
+//	nothing (once the queue has grown to its working length), and a
+//	small struct can be passed as it is rather than by pointer.
 //
 // Copyright (c) 1992-1996 The Regents of the University of California.
 // All rights reserved.  See copyright.h for copyright notice and limitation 
@@ -11,7 +18,7 @@
 #define SYNCHLIST_H
 
 #include "copyright.h"
-#include "list.h"
+#include "queue.h"
 #include "synch.h"
 
 // The following class defines a "synchronized list" -- a list for which
@@ -19,27 +26,43 @@
 //	1. Threads trying to remove an item from a list will
 //	wait until the list has an element on it.
 //	2. One thread at a time can access list data structures
+//	3. If the list is bounded, threads trying to append an item
+//	will wait until the list has room for it.
 
 template <class T>
 class SynchList {
   public:
-    SynchList();		// initialize a synchronized list
+    SynchList(int maxItems = 0);	// initialize a synchronized list,
+				// holding at most maxItems (0 means
+				// there is no limit)
     ~SynchList();		// de-allocate a synchronized list
 
-    void Append(T item);	// append item to the end of the list,
+    void Append(const T &item);	// append item to the end of the list,
 				// and wake up any thread waiting in remove
+    void AppendBatch(T *items, int n);
+				// append n items, in order
+    bool TryAppend(const T &item);	// append item unless the list is full;
+				// return FALSE if it is, without waiting
 
     T RemoveFront();		// remove the first item from the front of
 				// the list, waiting if the list is empty
+    int RemoveUpTo(T *items, int n);
+				// remove up to n items, at least one,
+				// waiting if the list is empty; return
+				// how many were removed
 
     void Apply(void (*f)(T)); // apply function to all elements in list
 
     void SelfTest(T value);	// test the SynchList implementation
     
   private:
-    List<T> *list;		// the list of things
+    Queue<T> *list;		// the list of things
+    int maxInList;		// the bound, or 0 if there is none
     Lock *lock;			// enforce mutual exclusive access to the list
     Condition *listEmpty;	// wait in Remove if the list is empty
+    Condition *listFull;	// wait in Append if the list is full
+
+    bool IsFull() { return maxInList > 0 && list->NumInQueue() >= maxInList; }
     
     // these are only to assist SelfTest()
     SynchList<T> *selfTestPing;
@@ -21,10 +21,59 @@
 #include "switch.h"
 #include "synch.h"
 #include "sysdep.h"
+#include "hostprof.h"
+#include "memtrack.h"
 
 // this is put at the top of the execution stack, for detecting stack overflows
 const int STACK_FENCEPOST = 0xdedbeef;
 
+// Thread objects are carved out of slabs of this many, and kept on a
+// free list when they are deleted, instead of going back to the heap
+
+const int ThreadsPerSlab = 32;
+static void *freeThreads = NULL;	// each free one points to the next
+
+//----------------------------------------------------------------------
+// Thread::operator new
+// 	Return the memory for a Thread: the most recently freed one, or
+//	if there is none, the first of a new slab, the rest of which goes
+//	on the free list.
+//----------------------------------------------------------------------
+
+void *
+Thread::operator new(size_t size)
+{
+    void *p;
+
+    ASSERT(size == sizeof(Thread));
+    if (freeThreads == NULL) {
+	char *slab = new char[ThreadsPerSlab * sizeof(Thread)];
+	for (int i = ThreadsPerSlab - 1; i >= 0; i--) {
+	    p = slab + i * sizeof(Thread);
+	    *(void **) p = freeThreads;
+	    freeThreads = p;
+	}
+    }
+    p = freeThreads;
+    freeThreads = *(void **) p;
+    return p;
+}
+
+//----------------------------------------------------------------------
+// Thread::operator delete
+// 	Put a destroyed Thread's memory on the free list.  Slabs are
+//	never given back to the heap.
+//----------------------------------------------------------------------
+
+void
+Thread::operator delete(void *p)
+{
+    if (p == NULL)
+	return;
+    *(void **) p = freeThreads;
+    freeThreads = p;
+}
+
 //----------------------------------------------------------------------
 // Thread::Thread
 // 	Initialize a thread control block, so that we can then call
@@ -39,6 +88,7 @@ Thread::Thread(char* threadName, int threadID)
     name = threadName;
     stackTop = NULL;
     stack = NULL;
+    stackSize = StackSize;
     status = JUST_CREATED;
     for (int i = 0; i < MachineStateSize; i++) {
 	machineState[i] = NULL;		// not strictly necessary, since
@@ -48,8 +98,27 @@ Thread::Thread(char* threadName, int threadID)
     space = NULL;
 		startTime = 0;
 		burstTime = 0;
+		burstEstimate = 0;
 		executionTime = 0;
-		waitTime = 0;
+		readyTick = 0;
+		cpu = -1;
+		level = 0;
+		userThread = 0;
+		basePriority = -1;
+		locksHeld = waitingFor = NULL;
+		waitQueue = NULL;
+		queuedTick = 0;
+		ticksRun = waitTicks = numPreemptions = 0;
+		for (int l = 0; l < MaxLevels; l++)
+			levelTicks[l] = 0;
+		firstRunTick = workloadJob = -1;
+		threadClass = ClassInteractive;
+		cpuShare = cycleRun = 0;
+		blockedTick = -1;
+		rtPeriod = rtBudget = rtDeadline = 0;
+		rtRelease = rtUsed = rtSince = 0;
+		rtDone = rtLate = FALSE;
+		pass = passTicks = strideSince = windowTicks = 0;
 }
 
 //----------------------------------------------------------------------
@@ -68,8 +137,13 @@ Thread::~Thread()
 {
     DEBUG(dbgThread, "Deleting thread: " << name);
     ASSERT(this != kernel->currentThread);
+    if (ID >= 0 && ID < MaxThreads && kernel->getThread(ID) == this)
+	kernel->FreeThreadID(ID);
     if (stack != NULL)
-	DeallocBoundedArray((char *) stack, StackSize * sizeof(int));
+	DeallocBoundedArray((char *) stack, stackSize * sizeof(int));
+    if (space != NULL && space->DropThread())
+	delete space;			// and its memory: no thread of
+					// the program is left
 }
 
 //----------------------------------------------------------------------
@@ -90,16 +164,20 @@ Thread::~Thread()
 // 	
 //	"func" is the procedure to run concurrently.
 //	"arg" is a single argument to be passed to the procedure.
+//	"stackWords" is the size of its stack, in words
 //----------------------------------------------------------------------
 
 void 
-Thread::Fork(VoidFunctionPtr func, void *arg)
+Thread::Fork(VoidFunctionPtr func, void *arg, int stackWords)
 {
     Interrupt *interrupt = kernel->interrupt;
     Scheduler *scheduler = kernel->scheduler;
     IntStatus oldLevel;
+    MemTagScope tag(MemThreads);
     
-    DEBUG(dbgThread, "Forking thread: " << name << " f(a): " << (int) func << " " << arg);
+    DEBUG(dbgThread, "Forking thread: " << name << " f(a): " << (void *) func << " " << arg);
+    ASSERT(stackWords >= 256);
+    stackSize = stackWords;
     StackAllocate(func, arg);
 
     oldLevel = interrupt->SetLevel(IntOff);
@@ -126,9 +204,9 @@ Thread::Fork(VoidFunctionPtr func, void *arg)
 void
 Thread::CheckOverflow()
 {
-    if (stack != NULL) {
+    if (stack != NULL && !ArrayGuardsExact) {
 #ifdef HPUX			// Stacks grow upward on the Snakes
-	ASSERT(stack[StackSize - 1] == STACK_FENCEPOST);
+	ASSERT(stack[stackSize - 1] == STACK_FENCEPOST);
 #else
 	ASSERT(*stack == STACK_FENCEPOST);
 #endif
@@ -151,6 +229,7 @@ Thread::Begin ()
 {
     ASSERT(this == kernel->currentThread);
     DEBUG(dbgThread, "Beginning thread: " << name);
+    HostProfSet(ProfKernel);		// not still in Scheduler::Run
     
     kernel->scheduler->CheckToBeDestroyed();
     kernel->interrupt->Enable();
@@ -178,8 +257,7 @@ Thread::Finish ()
     ASSERT(this == kernel->currentThread);
     
     DEBUG(dbgThread, "Finishing thread: " << name); 
-		cout << "Tick[" << kernel->stats->totalTicks << "]: Thread["
-				 << kernel->currentThread->getID() << "] is finished\n";
+		kernel->schedTrace->Record(TraceFinish, ID, name);
     Sleep(TRUE);				// invokes SWITCH
     // not reached
 }
@@ -223,11 +301,10 @@ Thread::Yield ()
 			
 			kernel->scheduler->ReadyToRun(this);
 
-			cout << "Tick[" << kernel->stats->totalTicks << "]: Thread [" 
-	         << nextThread->getID() << "] is now selected for execution\n";
-	    cout << "Tick[" << kernel->stats->totalTicks << "]: Thread [" 
-	         << oldThread->getID() << "] is replaced, and it has executed ["
-	         << oldThread->getExecTime() << "] ticks\n";
+			kernel->schedTrace->Record(TraceSelect, nextThread->getID(),
+					nextThread->getName());
+			kernel->schedTrace->Record(TraceReplace, oldThread->getID(),
+					oldThread->getName(), 0, 0, oldThread->getExecTime());
 					 
 			nextThread->setStartTime(kernel->stats->userTicks);
 			
@@ -250,6 +327,10 @@ Thread::Yield ()
 //	occurs (the only thing that could cause a thread to become
 //	ready to run).
 //
+//	With several CPUs, as long as another CPU is busy we don't
+//	idle; this CPU is left without a thread, and we switch to the
+//	thread on the next busy CPU.
+//
 //	NOTE: we assume interrupts are already disabled, because it
 //	is called from the synchronization routines which must
 //	disable interrupts for atomicity.   We need interrupts off 
@@ -268,31 +349,43 @@ Thread::Sleep (bool finishing)
     ASSERT(kernel->interrupt->getLevel() == IntOff);
     
     DEBUG(dbgThread, "Sleeping thread: " << name);
-		cout << "Tick[" << kernel->stats->totalTicks << "]: Thread["
-			   << oldThread->getName() << "] goes to sleep\n";
+		kernel->schedTrace->Record(TraceSleep, oldThread->getID(),
+				oldThread->getName());
 
     status = BLOCKED;
 		if(!finishing)
-			kernel->scheduler->blockedThread->Append(oldThread);
+			kernel->scheduler->numBlocked++;
+		if(!finishing && kernel->classifier != NULL)
+			kernel->classifier->Block(oldThread);
+		kernel->scheduler->StopRunning(kernel->scheduler->CurrentCPU());
+							// the CPU is idle
 	//cout << "debug Thread::Sleep " << name << "wait for Idle\n";
     while ((nextThread = kernel->scheduler->FindNextToRun()) == NULL) {
+			kernel->scheduler->Balance();	// another CPU may have work
+			if (kernel->scheduler->OtherCPUsBusy())
+				break;			// so leave this one idle
 			kernel->interrupt->Idle();	// no one to run, wait for an interrupt
 		}    
     // returns when it's time for us to run
 		oldThread->setExecTime(prev_executionTime + cur_executionTime);
 		
-		cout << "Tick[" << kernel->stats->totalTicks << "]: Thread [" 
-				 << nextThread->getID() << "] is now selected for execution\n";
-		cout << "Tick[" << kernel->stats->totalTicks << "]: Thread [" 
-				 << oldThread->getID() << "] is replaced, and it has executed ["
-				 << oldThread->getExecTime() << "] ticks\n";
+		if (nextThread != NULL) {
+			kernel->schedTrace->Record(TraceSelect, nextThread->getID(),
+					nextThread->getName());
+		}
+		kernel->schedTrace->Record(TraceReplace, oldThread->getID(),
+				oldThread->getName(), 0, 0, oldThread->getExecTime());
 				 
-		nextThread->setStartTime(kernel->stats->userTicks);
+		if (nextThread != NULL)
+			nextThread->setStartTime(kernel->stats->userTicks);
 
 		if(!finishing)
 			oldThread->PredictBurst();
 			
-    kernel->scheduler->Run(nextThread, finishing); 
+		if (nextThread != NULL)
+	    kernel->scheduler->Run(nextThread, finishing); 
+		else
+			kernel->scheduler->LeaveCPU(finishing);
 }
 
 //----------------------------------------------------------------------
@@ -346,35 +439,30 @@ PLabelToAddr(void *plabel)
 void
 Thread::StackAllocate (VoidFunctionPtr func, void *arg)
 {
-    stack = (int *) AllocBoundedArray(StackSize * sizeof(int));
+    stack = (int *) AllocBoundedArray(stackSize * sizeof(int));
 
 #ifdef PARISC
     // HP stack works from low addresses to high addresses
     // everyone else works the other way: from high addresses to low addresses
     stackTop = stack + 16;	// HP requires 64-byte frame marker
-    stack[StackSize - 1] = STACK_FENCEPOST;
 #endif
 
 #ifdef SPARC
-    stackTop = stack + StackSize - 96; 	// SPARC stack must contains at 
+    stackTop = stack + stackSize - 96; 	// SPARC stack must contains at 
 					// least 1 activation record 
 					// to start with.
-    *stack = STACK_FENCEPOST;
 #endif 
 
 #ifdef PowerPC // RS6000
-    stackTop = stack + StackSize - 16; 	// RS6000 requires 64-byte frame marker
-    *stack = STACK_FENCEPOST;
+    stackTop = stack + stackSize - 16; 	// RS6000 requires 64-byte frame marker
 #endif 
 
 #ifdef DECMIPS
-    stackTop = stack + StackSize - 4;	// -4 to be on the safe side!
-    *stack = STACK_FENCEPOST;
+    stackTop = stack + stackSize - 4;	// -4 to be on the safe side!
 #endif
 
 #ifdef ALPHA
-    stackTop = stack + StackSize - 8;	// -8 to be on the safe side!
-    *stack = STACK_FENCEPOST;
+    stackTop = stack + stackSize - 8;	// -8 to be on the safe side!
 #endif
 
 
@@ -382,11 +470,36 @@ Thread::StackAllocate (VoidFunctionPtr func, void *arg)
     // the x86 passes the return address on the stack.  In order for SWITCH() 
     // to go to ThreadRoot when we switch to this thread, the return addres 
     // used in SWITCH() must be the starting address of ThreadRoot.
-    stackTop = stack + StackSize - 4;	// -4 to be on the safe side!
+    stackTop = stack + stackSize - 4;	// -4 to be on the safe side!
     *(--stackTop) = (int) ThreadRoot;
-    *stack = STACK_FENCEPOST;
 #endif
-    
+
+#ifdef x86_64
+    // As on the x86, SWITCH() returns to ThreadRoot the first time, through 
+    // a return address on the stack -- a 64-bit one.  The stack must be 
+    // 16-byte aligned at a call, so the slot holding it is too.
+    stackTop = (int *) (((unsigned long) (stack + stackSize - 4)) & ~15UL);
+    stackTop -= 16 / sizeof(int);
+    *(void **) stackTop = (void *) ThreadRoot;
+#endif
+
+#ifdef AARCH64
+    // SWITCH() "returns" to the address in x30, so ThreadRoot is only 
+    // in machineState.  The stack pointer must be 16-byte aligned.
+    stackTop = (int *) (((unsigned long) (stack + stackSize - 4)) & ~15UL);
+#endif
+
+    // Where running off the stack faults at once, the fencepost isn't
+    // needed; without it, none of the stack's pages but the top ones
+    // are touched, and so take memory, unless the thread goes deep.
+    if (!ArrayGuardsExact) {
+#ifdef PARISC
+	stack[stackSize - 1] = STACK_FENCEPOST;
+#else
+	*stack = STACK_FENCEPOST;
+#endif
+    }
+
 #ifdef PARISC
     machineState[PCState] = PLabelToAddr(ThreadRoot);
     machineState[StartupPCState] = PLabelToAddr(ThreadBegin);
@@ -478,17 +591,19 @@ Thread::SelfTest()
 void
 Thread::PredictBurst()
 {
-	if(kernel->currentThread->getPriority() < 100)
-		return;
-		
 	Thread *t = kernel->currentThread;
+	SchedPolicy *policy = kernel->schedPolicy;
+
+	if (policy->Level(policy->LevelOf(t->getPriority()))->rule != ShortestJob)
+		return;		// only needed to order an SJF level
+		
 	int executionTime = t->getExecTime();
 	int burstTime = t->getBurstTime();
 	
 	t->setExecTime(0);
-	t->setBurstTime(( burstTime + executionTime )/2);
+	kernel->burstPredictor->Update(t, executionTime);
 	
-	cout << "Thread [" << t->getName() << "] suspend\n"; 
-	cout << "Next Burst Time: " << t->getBurstTime() << "\n";
+	kernel->schedTrace->Record(TraceBurst, t->getID(), t->getName(), 0,
+			burstTime, t->getBurstTime());
 }
 
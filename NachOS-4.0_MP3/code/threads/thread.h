@@ -42,6 +42,11 @@
 #include "sysdep.h"
 #include "machine.h"
 #include "addrspace.h"
+#include "schedpolicy.h"
+#include "classify.h"
+
+class Lock;
+class WaitQueue;
 
 // CPU register state to be saved on context switch.  
 // The x86 needs to save only a few registers, 
@@ -57,6 +62,12 @@
 // WATCH OUT IF THIS ISN'T BIG ENOUGH!!!!!
 const int StackSize = (8 * 1024);	// in words
 
+// Size of the stack of a kernel helper thread that makes no deep
+// calls, such as the post office's delivery thread; given to Fork.
+// (A stack takes memory only for the pages it touches, so a big one
+// costs little, but a helper per machine adds up.)
+const int SmallStackSize = (2 * 1024);	// in words
+
 
 // Thread state
 enum ThreadStatus { JUST_CREATED, RUNNING, READY, BLOCKED, ZOMBIE };
@@ -83,6 +94,8 @@ class Thread {
 
   public:
     Thread(char* debugName, int threadID);		// initialize a Thread 
+    static void *operator new(size_t size);	// take a Thread from the
+    static void operator delete(void *p);	// free list, or put it back
     ~Thread(); 				// deallocate a Thread
 					// NOTE -- thread being deleted
 					// must not be running when delete 
@@ -90,8 +103,9 @@ class Thread {
 
     // basic thread operations
 
-    void Fork(VoidFunctionPtr func, void *arg); 
-    				// Make thread run (*func)(arg)
+    void Fork(VoidFunctionPtr func, void *arg, int stackWords = StackSize);
+    				// Make thread run (*func)(arg), on a
+				// stack of "stackWords" words
     void Yield();  		// Relinquish the CPU if any 
 				// other thread is runnable
     void Sleep(bool finishing); // Put the thread to sleep and 
@@ -105,6 +119,7 @@ class Thread {
     char* getName() { return (name); }
     
     int getID() { return (ID); }
+    void setID(int threadID) { ID = threadID; }
     void Print() { cout << name; }
     void SelfTest();		// test whether thread impl is working
     
@@ -114,6 +129,7 @@ class Thread {
     int *stack; 	 	// Bottom of the stack 
 				// NULL if this is the main thread
 				// (If NULL, don't deallocate stack)
+    int stackSize;		// in words
     ThreadStatus status;	// ready, running or blocked
     char* name;
 	  int   ID;
@@ -139,17 +155,79 @@ class Thread {
     int getPriority() { return priority; }
     void setExecTime(int newExecTime) { executionTime = newExecTime; } 
     int getExecTime() { return executionTime; }
-    void setWaitTime(int newWaitTime) { waitTime = newWaitTime; }
-    int getWaitTime() { return waitTime; }
     
     void PredictBurst();
 
     AddrSpace *space;			// User code this thread is running.
     int priority;
     int burstTime;
+    int burstEstimate;			// predicted burst, in 1/BurstScale
+					// ticks; burstTime is it rounded
     int startTime;
     int executionTime;
-    int waitTime;
+    int readyTick;			// when it joined a ready queue, or
+					// last had its priority aged
+    DLink<Thread, ReadyLink> readyLink;	// its place on a ready queue list
+    DLink<Thread, AgingLink> agingLink;	// and on the scheduler's aging
+					// list, in readyTick order
+    DLink<Thread, ReadyLink> *Link(DLink<Thread, ReadyLink> *)
+	{ return &readyLink; }
+    DLink<Thread, AgingLink> *Link(DLink<Thread, AgingLink> *)
+	{ return &agingLink; }		// for DList
+    int cpu;				// CPU it last ran or was queued on,
+					// or -1 if it has never been queued
+    int level;				// ready queue it is on, while ready
+    int userThread;			// its ThreadId in "space", or 0 for
+					// the thread the program started in
+    int basePriority;			// its priority before it inherited
+					// a higher one, or -1 if it hasn't
+    Lock *locksHeld;			// locks it holds, latest first
+    Lock *waitingFor;			// lock it is waiting to be handed,
+					// or NULL
+    WaitQueue *waitQueue;		// queue it is blocked on, or NULL
+
+    int queuedTick;			// when it was last made ready
+    int ticksRun;			// time it has spent on a CPU
+    int waitTicks;			// time it has spent ready
+    int numPreemptions;			// times it was asked to give up
+					// its CPU for another thread
+    int levelTicks[MaxLevels];		// ticksRun, by the level it was
+					// dispatched from
+    int firstRunTick;			// when it was first dispatched, or
+					// -1 if it hasn't been
+    ThreadClass threadClass;		// what its bursts say it is, with
+					// -classify (see classify.h)
+    int cpuShare;			// share of its time it runs, in
+					// 1/ClassScale
+    int cycleRun;			// ticksRun when it was last woken up
+    int blockedTick;			// when it last blocked, or -1 if it
+					// has been woken up since
+    int workloadJob;			// the workload job it runs (see
+					// workload.h), or -1
+
+    // A real-time thread runs a job each period, which must be done
+    // by the deadline; see Scheduler::SetRealTime.
+    int rtPeriod;			// ticks between the start of each
+					// job, or 0 if not real-time
+    int rtBudget;			// ticks it may run each period
+    int rtDeadline;			// ticks into the period its job
+					// must be done by
+    int rtRelease;			// when the current period began
+    int rtUsed;				// ticks run in the current period
+    int rtSince;			// while running, the tick rtUsed
+					// is charged up to
+    bool rtDone;			// has this period's job finished?
+    bool rtLate;			// has it missed this deadline?
+    bool IsRealTime() { return rtPeriod > 0; }
+
+    int pass;				// its pass value, at a stride level
+    int passTicks;			// ticks times stride not yet added
+					// to pass (less than TimerTicks)
+    int strideSince;			// while running at a stride level,
+					// the tick pass is charged up to
+    int windowTicks;			// ticks run at a stride level in the
+					// current fairness window
+    int AbsDeadline() { return rtRelease + rtDeadline; }
 };
 
 // external function, dummy routine whose sole job is to call Thread::Print
@@ -0,0 +1,220 @@
+// timeline.cc
+//	Routines to write a timeline of thread runs, interrupts, disk
+//	requests and system calls in the Chrome Trace Event format.
+//
+// Copyright (c) 1992-1996 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "main.h"
+#include "timeline.h"
+#include <stdio.h>
+
+// The groups of tracks, as process IDs
+
+enum { CPUTracks = 1, DeviceTracks, ThreadTracks };
+
+static char *deviceNames[] = { "timer", "disk", "console write",
+			"console read", "network send", "network recv" };
+
+//----------------------------------------------------------------------
+// Quote
+// 	Copy "name" into "buf", of "size" bytes, escaping the characters
+//	JSON strings can't contain, and truncating it if need be.
+//----------------------------------------------------------------------
+
+static char *
+Quote(char *buf, int size, char *name)
+{
+    int n = 0;
+
+    for (; *name != '\0' && n < size - 2; name++) {
+	if (*name == '"' || *name == '\\')
+	    buf[n++] = '\\';
+	buf[n++] = (*name >= ' ') ? *name : '?';
+    }
+    buf[n] = '\0';
+    return buf;
+}
+
+//----------------------------------------------------------------------
+// Timeline::Timeline
+// 	Start a timeline in the UNIX file "fileName", replacing any old
+//	one, with the names of the groups of tracks and of the tracks
+//	known already.
+//----------------------------------------------------------------------
+
+Timeline::Timeline(char *fileName)
+{
+    char name[20];
+
+    fd = OpenForWrite(fileName);
+    used = 0;
+    numEvents = 0;
+    threadName = new char *[MaxThreads];
+    for (int i = 0; i < MaxThreads; i++)
+	threadName[i] = NULL;
+
+    used += sprintf(buffer, "[\n");
+    Name(CPUTracks, -1, "CPUs");
+    Name(DeviceTracks, -1, "Devices");
+    Name(ThreadTracks, -1, "Threads");
+    for (int cpu = 0; cpu < MaxCPUs; cpu++) {
+	sprintf(name, "CPU %d", cpu);
+	Name(CPUTracks, cpu, name);
+    }
+    for (unsigned int type = 0; type < sizeof(deviceNames) / sizeof(char *); type++)
+	Name(DeviceTracks, type, deviceNames[type]);
+}
+
+//----------------------------------------------------------------------
+// Timeline::~Timeline
+// 	Finish the JSON array, write out what is left, and close the
+//	file.
+//----------------------------------------------------------------------
+
+Timeline::~Timeline()
+{
+    WriteFile(fd, buffer, used);
+    WriteFile(fd, "\n]\n", 3);
+    Close(fd);
+    delete [] threadName;
+}
+
+//----------------------------------------------------------------------
+// Timeline::Write
+// 	Add one event, a JSON object, to the array, writing the buffer
+//	out first if the event might not fit.
+//----------------------------------------------------------------------
+
+void
+Timeline::Write(char *event)
+{
+    int length = strlen(event);
+
+    if (used + length + 2 > (int) sizeof(buffer)) {
+	WriteFile(fd, buffer, used);
+	used = 0;
+    }
+    if (numEvents++ > 0) {
+	buffer[used++] = ',';
+	buffer[used++] = '\n';
+    }
+    strcpy(buffer + used, event);
+    used += length;
+}
+
+//----------------------------------------------------------------------
+// Timeline::Name
+// 	Name track "tid" of group "pid", or the group itself if "tid" is
+//	-1.
+//----------------------------------------------------------------------
+
+void
+Timeline::Name(int pid, int tid, char *name)
+{
+    char event[200], quoted[100];
+
+    if (tid == -1)
+	sprintf(event, "{\"ph\": \"M\", \"name\": \"process_name\", "
+		"\"pid\": %d, \"args\": {\"name\": \"%s\"}}", pid,
+		Quote(quoted, sizeof(quoted), name));
+    else
+	sprintf(event, "{\"ph\": \"M\", \"name\": \"thread_name\", "
+		"\"pid\": %d, \"tid\": %d, \"args\": {\"name\": \"%s\"}}",
+		pid, tid, Quote(quoted, sizeof(quoted), name));
+    Write(event);
+}
+
+//----------------------------------------------------------------------
+// Timeline::NameThread
+// 	Name the track of "thread"'s ID after it, unless it was last
+//	named after a thread of the same name.  (IDs are reused; a
+//	viewer shows the last name given.)
+//----------------------------------------------------------------------
+
+void
+Timeline::NameThread(Thread *thread)
+{
+    int id = thread->getID();
+    char name[60];
+
+    if (threadName[id] == thread->getName())
+	return;
+    threadName[id] = thread->getName();
+    sprintf(name, "%d ", id);
+    strncat(name, thread->getName(), sizeof(name) - strlen(name) - 1);
+    Name(ThreadTracks, id, name);
+}
+
+//----------------------------------------------------------------------
+// Timeline::Run
+// 	"thread" ran on CPU "cpu" from tick "start" to "end".
+//----------------------------------------------------------------------
+
+void
+Timeline::Run(int cpu, Thread *thread, int start, int end)
+{
+    char event[200], quoted[100];
+
+    sprintf(event, "{\"ph\": \"X\", \"name\": \"%s\", \"pid\": %d, "
+	    "\"tid\": %d, \"ts\": %d, \"dur\": %d, \"args\": {\"id\": %d}}",
+	    Quote(quoted, sizeof(quoted), thread->getName()), CPUTracks, cpu,
+	    start, end - start, thread->getID());
+    Write(event);
+}
+
+//----------------------------------------------------------------------
+// Timeline::Handler
+// 	The handler of an interrupt of kind "type" ran at tick "when".
+//	Handlers take no simulated time, so it is an instant.
+//----------------------------------------------------------------------
+
+void
+Timeline::Handler(IntType type, int when)
+{
+    char event[200];
+
+    sprintf(event, "{\"ph\": \"i\", \"s\": \"t\", \"name\": \"%s\", "
+	    "\"pid\": %d, \"tid\": %d, \"ts\": %d}", deviceNames[type],
+	    DeviceTracks, type, when);
+    Write(event);
+}
+
+//----------------------------------------------------------------------
+// Timeline::DiskRequest
+// 	A request to read or write "sector" was issued at tick "start",
+//	and its interrupt came at "end".
+//----------------------------------------------------------------------
+
+void
+Timeline::DiskRequest(bool writing, int sector, int start, int end)
+{
+    char event[200];
+
+    sprintf(event, "{\"ph\": \"X\", \"name\": \"%s %d\", \"pid\": %d, "
+	    "\"tid\": %d, \"ts\": %d, \"dur\": %d}",
+	    writing ? "write" : "read", sector, DeviceTracks, DiskInt,
+	    start, end - start);
+    Write(event);
+}
+
+//----------------------------------------------------------------------
+// Timeline::Syscall
+// 	"thread" trapped into the kernel for system call "type" at tick
+//	"start", and returned to user mode at "end".  The interval
+//	includes any time it blocked in the kernel.
+//----------------------------------------------------------------------
+
+void
+Timeline::Syscall(Thread *thread, int type, int start, int end)
+{
+    char event[200];
+
+    NameThread(thread);
+    sprintf(event, "{\"ph\": \"X\", \"name\": \"syscall %d\", \"pid\": %d, "
+	    "\"tid\": %d, \"ts\": %d, \"dur\": %d}", type, ThreadTracks,
+	    thread->getID(), start, end - start);
+    Write(event);
+}
@@ -0,0 +1,66 @@
+// timeline.h
+//	Data structures for writing a timeline of the simulation, to be
+//	looked at in a trace viewer (chrome://tracing, or Perfetto).
+//
+//	Events are written as they happen, in the Chrome Trace Event
+//	format (a JSON array of events; a viewer accepts it without its
+//	closing bracket, so a trace cut short by a crash can still be
+//	read).  Times are simulated ticks, shown as microseconds.
+//
+//	The timeline has three groups of tracks:
+//
+//	    CPUs	one track per simulated CPU, with an interval for
+//			each time a thread ran on it
+//	    Devices	one track per kind of interrupt, with a mark for
+//			each handler run; the disk track also has an
+//			interval for each request, from issue to its
+//			interrupt
+//	    Threads	one track per thread ID, with an interval for each
+//			system call, from the trap to its return
+//
+// Copyright (c) 1992-1996 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#ifndef TIMELINE_H
+#define TIMELINE_H
+
+#include "copyright.h"
+#include "utility.h"
+#include "interrupt.h"
+
+class Thread;
+
+// The following class writes the timeline.
+
+class Timeline {
+  public:
+    Timeline(char *fileName);	// start a timeline in "fileName"
+    ~Timeline();		// write out the rest of it
+
+    void Run(int cpu, Thread *thread, int start, int end);
+				// "thread" ran on "cpu" from start to end
+    void Handler(IntType type, int when);
+				// an interrupt handler ran
+    void DiskRequest(bool writing, int sector, int start, int end);
+				// a disk request, from issue to interrupt
+    void Syscall(Thread *thread, int type, int start, int end);
+				// "thread" made system call "type"
+
+  private:
+    void Write(char *event);	// add one event to the file
+    void Name(int pid, int tid, char *name);
+				// name a track
+    void NameThread(Thread *thread);
+				// name the track of "thread", if it
+				// doesn't have the thread's name yet
+
+    int fd;			// UNIX file descriptor of the timeline
+    char buffer[8192];		// events not yet written
+    int used;			// bytes of buffer in use
+    int numEvents;		// events written, to know where commas go
+    char **threadName;		// the name given to each thread ID's
+				// track, or NULL
+};
+
+#endif // TIMELINE_H
@@ -0,0 +1,362 @@
+// workload.cc
+//	Routines to generate a synthetic workload, run it, and measure
+//	how well it was scheduled.
+//
+// Copyright (c) 1992-1996 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "workload.h"
+#include "main.h"
+#include "addrspace.h"
+#include <fstream>
+#include <math.h>
+
+static char *kindNames[NumJobKinds] = {
+    (char *) "cpu", (char *) "io", (char *) "interactive"
+};
+
+//----------------------------------------------------------------------
+// Workload::Workload
+// 	Initialize an empty workload, running the default program, with
+//	every job arriving at once.
+//----------------------------------------------------------------------
+
+Workload::Workload()
+{
+    strcpy(program, "../test/workload");
+    meanArrival = 0;
+    numClasses = 0;
+    numJobs = 0;
+    numDone = 0;
+}
+
+//----------------------------------------------------------------------
+// Workload::Load
+// 	Read the workload from a file, in the format described in
+//	workload.h.  If the file can't be read, or a line is not valid,
+//	print why and return FALSE.
+//
+//	"fileName" is the UNIX file to read
+//----------------------------------------------------------------------
+
+bool
+Workload::Load(char *fileName)
+{
+    ifstream in(fileName);
+    char buf[200], word[20], kind[20], dist[20];
+    int line = 0, total = 0;
+    JobClass *c;
+
+    if (!in) {
+	cout << "Can't open workload " << fileName << "\n";
+	return FALSE;
+    }
+    while (in.getline(buf, sizeof(buf))) {
+	line++;
+	if (buf[0] == '#' || sscanf(buf, " %19s", word) != 1)
+	    continue;			// comment or blank line
+	if (strcmp(word, "program") == 0) {
+	    if (sscanf(buf, " program %99s", program) != 1) {
+		cout << fileName << ":" << line
+		     << ": expected \"program <executable>\"\n";
+		return FALSE;
+	    }
+	    continue;
+	}
+	if (strcmp(word, "arrival") == 0) {
+	    if (sscanf(buf, " arrival %d", &meanArrival) != 1
+			|| meanArrival < 0) {
+		cout << fileName << ":" << line
+		     << ": expected \"arrival <mean ticks>\"\n";
+		return FALSE;
+	    }
+	    continue;
+	}
+	c = &classes[numClasses];
+	if (sscanf(buf, " jobs %19s %d %d %d %19s %d %d %d", kind, &c->count,
+			&c->minPriority, &c->maxPriority, dist, &c->meanBurst,
+			&c->bursts, &c->pause) != 8) {
+	    cout << fileName << ":" << line << ": expected \"jobs <kind> "
+		 << "<count> <min priority> <max priority> <distribution> "
+		 << "<mean burst> <bursts> <pause>\"\n";
+	    return FALSE;
+	}
+	if (strcmp(kind, "cpu") == 0) {
+	    c->kind = CpuBound;
+	} else if (strcmp(kind, "io") == 0) {
+	    c->kind = IoBound;
+	} else if (strcmp(kind, "interactive") == 0) {
+	    c->kind = Interactive;
+	} else {
+	    cout << fileName << ":" << line << ": unknown kind " << kind << "\n";
+	    return FALSE;
+	}
+	if (strcmp(dist, "fixed") == 0) {
+	    c->distribution = FixedBurst;
+	} else if (strcmp(dist, "uniform") == 0) {
+	    c->distribution = UniformBurst;
+	} else if (strcmp(dist, "exp") == 0) {
+	    c->distribution = ExponentialBurst;
+	} else {
+	    cout << fileName << ":" << line << ": unknown distribution "
+		 << dist << "\n";
+	    return FALSE;
+	}
+	total += c->count;
+	if (c->count < 0 || total > MaxWorkloadJobs || c->minPriority < 0
+		|| c->minPriority > c->maxPriority
+		|| c->maxPriority >= NumPriorities || c->meanBurst < 1
+		|| c->bursts < 1 || c->pause < 0) {
+	    cout << fileName << ":" << line << ": bad jobs (at most "
+		 << MaxWorkloadJobs << " in all)\n";
+	    return FALSE;
+	}
+	numClasses++;
+    }
+    if (total == 0) {
+	cout << fileName << ": no jobs\n";
+	return FALSE;
+    }
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// Uniform, Exponential
+// 	Draw a random number uniformly from (0,1), or from an exponential
+//	distribution with mean "mean".
+//----------------------------------------------------------------------
+
+static double
+Uniform()
+{
+    return (kernel->Random() % 1000000 + 1) / 1000001.0;
+}
+
+static double
+Exponential(double mean)
+{
+    return -mean * log(Uniform());
+}
+
+//----------------------------------------------------------------------
+// Workload::Draw
+// 	Return a random burst length, from the distribution "how" with
+//	mean "mean"; at least 1.
+//----------------------------------------------------------------------
+
+int
+Workload::Draw(BurstDistribution how, int mean)
+{
+    int burst = mean;
+
+    switch (how) {
+      case FixedBurst:
+	break;
+      case UniformBurst:
+	burst = 1 + kernel->Random() % (2 * mean - 1);
+	break;
+      case ExponentialBurst:
+	burst = (int) (Exponential(mean) + 0.5);
+	break;
+    }
+    return max(burst, 1);
+}
+
+//----------------------------------------------------------------------
+// Workload::Generate
+// 	Draw each class's jobs, shuffle the jobs of all the classes
+//	together, and give them their arrival times, the first now.
+//----------------------------------------------------------------------
+
+void
+Workload::Generate()
+{
+    double when = kernel->stats->totalTicks;
+    int i, j, k;
+
+    numJobs = 0;
+    for (i = 0; i < numClasses; i++) {
+	JobClass *c = &classes[i];
+
+	for (j = 0; j < c->count; j++) {
+	    WorkloadJob *job = &jobs[numJobs++];
+
+	    job->kind = c->kind;
+	    job->priority = c->minPriority
+			+ kernel->Random() % (c->maxPriority - c->minPriority + 1);
+	    job->burst = Draw(c->distribution, c->meanBurst);
+	    job->bursts = c->bursts;
+	    job->pause = c->pause;
+	    job->firstRun = job->finish = -1;
+	}
+    }
+    for (i = numJobs - 1; i > 0; i--) {	// Fisher-Yates
+	WorkloadJob swap = jobs[i];
+
+	k = kernel->Random() % (i + 1);
+	jobs[i] = jobs[k];
+	jobs[k] = swap;
+    }
+    for (i = 0; i < numJobs; i++) {
+	jobs[i].arrival = (int) when;
+	if (meanArrival > 0)
+	    when += Exponential(meanArrival);
+    }
+}
+
+//----------------------------------------------------------------------
+// Workload::Start
+// 	Draw the jobs, and fork the thread that starts each one when it
+//	arrives.
+//----------------------------------------------------------------------
+
+void
+Workload::Start()
+{
+    Thread *thread = new Thread("workload", 0);
+
+    Generate();
+    if (kernel->NewThreadID(thread) == -1) {
+	cout << "Too many threads to run the workload\n";
+	delete thread;
+	return;
+    }
+    thread->Fork((VoidFunctionPtr) Workload::Arrivals, (void *) this);
+}
+
+//----------------------------------------------------------------------
+// Workload::Arrivals
+// 	The thread that starts the jobs: sleep until each one's arrival,
+//	and run the program for it, as -e does.  A job's arrival is put
+//	off to when it was really started, which may be up to TimerTicks
+//	after it was due.
+//----------------------------------------------------------------------
+
+void
+Workload::Arrivals(Workload *workload)
+{
+    for (int i = 0; i < workload->numJobs; i++) {
+	WorkloadJob *job = &workload->jobs[i];
+	int args[4];
+	IntStatus oldLevel;
+	int id;
+
+	kernel->alarm->WaitUntil(job->arrival - kernel->stats->totalTicks);
+	args[0] = job->kind;
+	args[1] = job->burst;
+	args[2] = job->bursts;
+	args[3] = job->pause;
+	oldLevel = kernel->interrupt->SetLevel(IntOff);	// before it runs
+	job->arrival = kernel->stats->totalTicks;
+	id = kernel->Exec(workload->program, job->priority, args);
+	if (id != -1)
+	    kernel->getThread(id)->workloadJob = i;
+	(void) kernel->interrupt->SetLevel(oldLevel);
+	DEBUG(dbgThread, "Workload job " << i << " (" << kindNames[job->kind]
+		<< ", priority " << job->priority << ", burst " << job->burst
+		<< ") arrived at " << job->arrival);
+    }
+}
+
+//----------------------------------------------------------------------
+// Workload::Done
+// 	A thread is finishing.  If it was running one of the jobs, the
+//	job is done: note when, and when it first ran.
+//----------------------------------------------------------------------
+
+void
+Workload::Done(Thread *thread)
+{
+    WorkloadJob *job;
+
+    if (thread->workloadJob == -1)
+	return;
+    job = &jobs[thread->workloadJob];
+    job->firstRun = thread->firstRunTick;
+    job->finish = kernel->stats->totalTicks;
+    numDone++;
+}
+
+//----------------------------------------------------------------------
+// SortTicks
+// 	Sort "n" times into increasing order.  There are at most
+//	MaxWorkloadJobs, so insertion sort will do.
+//----------------------------------------------------------------------
+
+static void
+SortTicks(int *ticks, int n)
+{
+    for (int i = 1; i < n; i++) {
+	int t = ticks[i], j;
+
+	for (j = i; j > 0 && ticks[j - 1] > t; j--)
+	    ticks[j] = ticks[j - 1];
+	ticks[j] = t;
+    }
+}
+
+//----------------------------------------------------------------------
+// Workload::Report
+// 	Print the mean and 99th percentile turnaround and response time
+//	of the finished jobs of kind "kind", or of all of them if "kind"
+//	is -1.
+//----------------------------------------------------------------------
+
+void
+Workload::Report(char *name, int kind)
+{
+    int turnaround[MaxWorkloadJobs], response[MaxWorkloadJobs];
+    double turnaroundSum = 0, responseSum = 0;
+    int n = 0, p99;
+
+    for (int i = 0; i < numJobs; i++) {
+	if (jobs[i].finish == -1 || (kind != -1 && jobs[i].kind != kind))
+	    continue;
+	turnaround[n] = jobs[i].finish - jobs[i].arrival;
+	response[n] = (jobs[i].firstRun == -1) ? turnaround[n]
+			: jobs[i].firstRun - jobs[i].arrival;
+	turnaroundSum += turnaround[n];
+	responseSum += response[n];
+	n++;
+    }
+    if (n == 0)
+	return;
+    SortTicks(turnaround, n);
+    SortTicks(response, n);
+    p99 = (99 * n + 99) / 100 - 1;	// nearest rank
+    cout << "  " << name << ": jobs " << n << ", turnaround mean "
+	 << (int) (turnaroundSum / n + 0.5) << " p99 " << turnaround[p99]
+	 << ", response mean " << (int) (responseSum / n + 0.5)
+	 << " p99 " << response[p99] << "\n";
+}
+
+//----------------------------------------------------------------------
+// Workload::Print
+// 	Print how many jobs finished, the throughput -- jobs finished
+//	per 1000 ticks, from the first arrival to the last finish -- and
+//	the turnaround and response times of each kind of job.
+//----------------------------------------------------------------------
+
+void
+Workload::Print()
+{
+    int first = -1, last = -1;
+
+    for (int i = 0; i < numJobs; i++) {
+	if (jobs[i].finish == -1)
+	    continue;
+	if (first == -1 || jobs[i].arrival < first)
+	    first = jobs[i].arrival;
+	last = max(last, jobs[i].finish);
+    }
+    cout << "Workload: " << numDone << " of " << numJobs << " jobs finished";
+    if (numDone > 0 && last > first)
+	cout << ", throughput " << numDone * 1000.0 / (last - first)
+	     << " per 1000 ticks";
+    cout << "\n";
+    for (int k = 0; k < NumJobKinds; k++)
+	Report(kindNames[k], k);
+    Report((char *) "all", -1);
+}
@@ -0,0 +1,126 @@
+// workload.h
+//	Data structures for a synthetic workload: a mix of CPU-bound,
+//	I/O-bound and interactive user programs, started at random
+//	times, whose throughput, turnaround and response times are
+//	measured, so that one scheduling policy can be compared with
+//	another on the same jobs.
+//
+//	The workload is read from a file given with "-workload".  Each
+//	line of the file is either a comment (starting with #) or one of
+//
+//	    program <executable>
+//	    arrival <mean ticks>
+//	    jobs <cpu|io|interactive> <count> <min priority> <max priority>
+//		<fixed|uniform|exp> <mean burst> <bursts> <pause>
+//
+//	Every job runs the one program (../test/workload by default),
+//	which is passed its kind, bursts and pause as the arguments to
+//	main.  A job runs "bursts" CPU bursts, each a loop of that many
+//	iterations; after each, an I/O-bound job prints "pause" numbers
+//	on the console, and an interactive one sleeps "pause" ticks.
+//
+//	Each "jobs" line adds "count" jobs of one kind.  A job's priority
+//	is drawn uniformly from the range, and its burst length from the
+//	distribution given, with the mean given: always the mean, uniform
+//	from 1 to twice the mean, or exponential.  The jobs of all the
+//	lines arrive in a random order, with exponentially distributed
+//	times between them (a Poisson process) of the mean given by
+//	"arrival"; 0, the default, starts them all at once.
+//
+//	Random numbers come from Kernel::Random, so the same seed (-rs)
+//	gives the same jobs, and -record and -replay work as usual.
+//
+//	A job's turnaround is from its arrival until it finishes, and its
+//	response time until it is first dispatched.  Each job is started
+//	the way -e starts a program (Kernel::Exec), by a kernel thread
+//	that sleeps until the next arrival.
+//
+// Copyright (c) 1992-1996 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#ifndef WORKLOAD_H
+#define WORKLOAD_H
+
+#include "copyright.h"
+
+class Thread;
+
+// The kinds of job, as passed to the program
+
+enum JobKind { CpuBound, IoBound, Interactive, NumJobKinds };
+
+// How a kind of job's burst lengths are drawn
+
+enum BurstDistribution { FixedBurst, UniformBurst, ExponentialBurst };
+
+// The most jobs a workload can have
+
+const int MaxWorkloadJobs = 100;
+
+// One "jobs" line of the workload file
+
+class JobClass {
+  public:
+    JobKind kind;
+    int count;			// jobs of this class
+    int minPriority, maxPriority;
+    BurstDistribution distribution;
+    int meanBurst;		// mean loop iterations in a CPU burst
+    int bursts;			// CPU bursts in each job
+    int pause;			// console writes, or ticks asleep,
+				// after each
+};
+
+// One job of the workload
+
+class WorkloadJob {
+  public:
+    JobKind kind;
+    int priority;
+    int burst;			// loop iterations in each CPU burst
+    int bursts;			// how many
+    int pause;			// console writes, or ticks asleep,
+				// after each
+    int arrival;		// when it is started
+    int firstRun;		// when it was first dispatched, or -1
+    int finish;			// when it finished, or -1
+};
+
+// The following class generates a workload, starts its jobs, and
+// reports on them.
+
+class Workload {
+  public:
+    Workload();			// an empty workload
+    ~Workload() {}
+
+    bool Load(char *fileName);	// read the workload to run; FALSE if
+				// the file isn't valid
+    void Start();		// draw the jobs, and start a thread to
+				// run them as they arrive
+    void Done(Thread *thread);	// a thread has finished; if it was a
+				// job, note the time
+    void Print();		// print the figures for the jobs
+
+  private:
+    void Generate();		// draw the jobs from the classes
+    int Draw(BurstDistribution how, int mean);
+				// a random burst length
+    static void Arrivals(Workload *workload);
+				// the thread that starts the jobs
+    void Report(char *name, int kind);
+				// print the figures for one kind of
+				// job, or for all if "kind" is -1
+
+    char program[100];		// the executable every job runs
+    int meanArrival;		// mean ticks between arrivals
+    int numClasses;		// "jobs" lines read
+    JobClass classes[MaxWorkloadJobs];
+
+    int numJobs;		// the jobs drawn, in arrival order
+    WorkloadJob jobs[MaxWorkloadJobs];
+    int numDone;		// jobs finished
+};
+
+#endif // WORKLOAD_H
@@ -20,6 +20,7 @@
 #include "addrspace.h"
 #include "machine.h"
 #include "noff.h"
+#include "synch.h"
 
 //----------------------------------------------------------------------
 // SwapHeader
@@ -79,16 +80,49 @@ AddrSpace::AddrSpace()
     
     // zero out the entire address space
     //bzero(kernel->machine->mainMemory, MemorySize);
+
+    for (int i = 0; i < MaxUserThreads; i++) {
+	userThread[i].inUse = FALSE;
+	userThread[i].stackTop = 0;
+    }
+    for (int i = 0; i < 4; i++)
+	mainArgs[i] = 0;
+    pageTable = NULL;
+    numPages = 0;
+    numThreads = 1;			// the one it is created for
+    threadLock = new Lock("user threads");
+    threadExited = new Condition("user thread exited");
 }
 
 //----------------------------------------------------------------------
 // AddrSpace::~AddrSpace
-// 	Dealloate an address space.
+// 	Dealloate an address space, and give back its physical pages.
 //----------------------------------------------------------------------
 
 AddrSpace::~AddrSpace()
 {
-   delete pageTable;
+   for (unsigned int i = 0; i < numPages; i++)
+	kernel->usedPhyPages[pageTable[i].physicalPage] = FALSE;
+   if (kernel->machine->pageTable == pageTable) {
+	kernel->machine->pageTable = NULL;	// so the next one to be
+	kernel->machine->pageTableSize = 0;	// allocated here is loaded
+   }
+   delete [] pageTable;
+   delete threadExited;
+   delete threadLock;
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::DropThread
+// 	One of the threads running the program is being destroyed.
+//	Return TRUE if it was the last, and the address space can go too.
+//----------------------------------------------------------------------
+
+bool
+AddrSpace::DropThread()
+{
+    ASSERT(numThreads > 0);
+    return --numThreads == 0;
 }
 
 
@@ -200,6 +234,8 @@ AddrSpace::Execute(char* fileName)
 {
     kernel->currentThread->space = this;
 
+    kernel->scheduler->LoadUserState(kernel->currentThread);
+					// take the machine's registers
     this->InitRegisters();		// set the initial register values
     this->RestoreState();		// load page table register
 
@@ -245,6 +281,23 @@ AddrSpace::InitRegisters()
    // accidentally reference off the end!
     machine->WriteRegister(StackReg, numPages * PageSize - 16);
     DEBUG(dbgAddr, "Initializing stack pointer: " << numPages * PageSize - 16);
+
+    // The program's arguments, as main sees them
+    for (i = 0; i < 4; i++)
+	machine->WriteRegister(4 + i, mainArgs[i]);
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::SetArgs
+// 	Pass the four numbers in "args" to the program's main, in the
+//	argument registers, when it starts.  Called before Execute.
+//----------------------------------------------------------------------
+
+void
+AddrSpace::SetArgs(int *args)
+{
+    for (int i = 0; i < 4; i++)
+	mainArgs[i] = args[i];
 }
 
 //----------------------------------------------------------------------
@@ -252,7 +305,9 @@ AddrSpace::InitRegisters()
 // 	On a context switch, save any machine state, specific
 //	to this address space, that needs saving.
 //
-//	For now, don't need to save anything!
+//	For now, don't need to save anything!  The machine's page table
+//	is always this address space's own, so the scheduler no longer
+//	calls this.
 //----------------------------------------------------------------------
 
 void AddrSpace::SaveState() 
@@ -326,6 +381,249 @@ AddrSpace::Translate(unsigned int vaddr, unsigned int *paddr, int isReadWrite)
     return NoException;
 }
 
+//----------------------------------------------------------------------
+// AddrSpace::CanCopy
+//  Return whether all _size_ bytes from the virtual address _vaddr_
+//  are mapped, and, if _mode_ is 1, writable.  Only the first byte on
+//  each page needs to be translated.
+//----------------------------------------------------------------------
+
+bool
+AddrSpace::CanCopy(unsigned int vaddr, int size, int mode)
+{
+    unsigned int paddr;
+
+    for (unsigned int at = vaddr; at < vaddr + size;
+	 at = (at / PageSize + 1) * PageSize)
+	if (Translate(at, &paddr, mode) != NoException)
+	    return FALSE;
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::CopyIn
+//  Copy _size_ bytes from the virtual address _vaddr_ into the kernel
+//  buffer _to_, a page at a time, since the pages need not be next to
+//  one another in physical memory.
+//----------------------------------------------------------------------
+
+bool
+AddrSpace::CopyIn(unsigned int vaddr, char *to, int size)
+{
+    unsigned int paddr;
+    int n;
+
+    if (!CanCopy(vaddr, size, 0))
+	return FALSE;
+    for (; size > 0; vaddr += n, to += n, size -= n) {
+	n = min(size, (int) (PageSize - vaddr % PageSize));
+	(void) Translate(vaddr, &paddr, 0);
+	bcopy(&kernel->machine->mainMemory[paddr], to, n);
+    }
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::CopyOut
+//  Copy _size_ bytes from the kernel buffer _from_ to the virtual
+//  address _vaddr_, a page at a time.
+//----------------------------------------------------------------------
+
+bool
+AddrSpace::CopyOut(char *from, unsigned int vaddr, int size)
+{
+    unsigned int paddr;
+    int n;
+
+    if (!CanCopy(vaddr, size, 1))
+	return FALSE;
+    for (; size > 0; vaddr += n, from += n, size -= n) {
+	n = min(size, (int) (PageSize - vaddr % PageSize));
+	(void) Translate(vaddr, &paddr, 1);
+	bcopy(from, &kernel->machine->mainMemory[paddr], n);
+    }
+    return TRUE;
+}
+
+
+
+
+
+//----------------------------------------------------------------------
+// AddrSpace::NewStack
+// 	Grow the address space by a user stack, and return the address
+//	of its top, or 0 if there isn't enough physical memory.  Called
+//	by a thread running in this address space, so the new page
+//	table is loaded into the machine straight away.
+//----------------------------------------------------------------------
+
+int
+AddrSpace::NewStack()
+{
+    unsigned int stackPages = divRoundUp(UserStackSize, PageSize);
+    TranslationEntry *bigger;
+    unsigned int i, j, numFree = 0;
+
+    for (j = 0; j < NumPhysPages; j++) {
+	if (!kernel->usedPhyPages[j])
+	    numFree++;
+    }
+    if (numFree < stackPages)
+	return 0;
+
+    bigger = new TranslationEntry[numPages + stackPages];
+    for (i = 0; i < numPages; i++)
+	bigger[i] = pageTable[i];
+    for (j = 0; i < numPages + stackPages; i++) {
+	while (kernel->usedPhyPages[j])
+	    j++;
+	kernel->usedPhyPages[j] = TRUE;
+	bigger[i].virtualPage = i;
+	bigger[i].physicalPage = j;
+	bigger[i].valid = TRUE;
+	bigger[i].use = FALSE;
+	bigger[i].dirty = FALSE;
+	bigger[i].readOnly = FALSE;
+    }
+    delete [] pageTable;
+    pageTable = bigger;
+    numPages += stackPages;
+    RestoreState();
+    DEBUG(dbgAddr, "New user stack at " << numPages * PageSize);
+    return numPages * PageSize;
+}
+
+//----------------------------------------------------------------------
+// StartUserThread
+// 	The kernel thread for a forked user thread starts here.
+//----------------------------------------------------------------------
+
+static void
+StartUserThread(Thread *thread)
+{
+    thread->space->StartThread(thread->userThread);
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::ForkThread
+// 	Create a kernel thread to run the user function at "func" in
+//	this address space, on a stack of its own.  A free slot's stack
+//	is reused if it has one.  The new thread gets the forking
+//	thread's priority.
+//
+//	Returns the new thread's ThreadId, or -1 if there are too many
+//	threads or not enough memory.
+//
+//	"func" is the user address to start at
+//	"retAddr" is the user address "func" returns to, which calls
+//		ThreadExit (see start.S)
+//----------------------------------------------------------------------
+
+int
+AddrSpace::ForkThread(int func, int retAddr)
+{
+    Thread *parent = kernel->currentThread;
+    Thread *child;
+    UserThread *u;
+    int id;
+
+    for (id = 1; id <= MaxUserThreads && userThread[id - 1].inUse; id++)
+	;
+    if (id > MaxUserThreads)
+	return -1;
+    u = &userThread[id - 1];
+    if (u->stackTop == 0 && (u->stackTop = NewStack()) == 0)
+	return -1;
+
+    child = new Thread(parent->getName(), 0);
+    if (kernel->NewThreadID(child) == -1) {
+	delete child;
+	return -1;
+    }
+    u->inUse = TRUE;
+    u->exited = FALSE;
+    u->func = func;
+    u->retAddr = retAddr;
+    child->space = this;
+    numThreads++;
+    child->userThread = id;
+    child->setPriority(parent->getPriority());
+    kernel->burstPredictor->Start(child);
+    DEBUG(dbgAddr, "Forking user thread " << id << " at " << func);
+    child->Fork((VoidFunctionPtr) StartUserThread, (void *) child);
+    return id;
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::StartThread
+// 	Set up the registers for forked thread "id", and jump to its
+//	function, as Execute does for the program's first thread.
+//----------------------------------------------------------------------
+
+void
+AddrSpace::StartThread(int id)
+{
+    Machine *machine = kernel->machine;
+    UserThread *u = &userThread[id - 1];
+
+    kernel->scheduler->LoadUserState(kernel->currentThread);
+    for (int i = 0; i < NumTotalRegs; i++)
+	machine->WriteRegister(i, 0);
+    machine->WriteRegister(PCReg, u->func);
+    machine->WriteRegister(NextPCReg, u->func + 4);
+    machine->WriteRegister(RetAddrReg, u->retAddr);
+    machine->WriteRegister(StackReg, u->stackTop - 16);
+    RestoreState();
+
+    machine->Run();
+    ASSERTNOTREACHED();
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::JoinThread
+// 	Wait for forked thread "id" to call ThreadExit, and return its
+//	exit code.  Its slot, and stack, are then free for the next
+//	thread forked.  Returns -1 if "id" is not a thread that can be
+//	joined.
+//----------------------------------------------------------------------
 
+int
+AddrSpace::JoinThread(int id)
+{
+    UserThread *u;
+    int exitCode = -1;
+
+    if (id < 1 || id > MaxUserThreads || id == kernel->currentThread->userThread)
+	return -1;
+    u = &userThread[id - 1];
+    threadLock->Acquire();
+    while (u->inUse && !u->exited)
+	threadExited->Wait(threadLock);
+    if (u->inUse) {			// not joined by someone else first
+	exitCode = u->exitCode;
+	u->inUse = FALSE;
+    }
+    threadLock->Release();
+    return exitCode;
+}
 
+//----------------------------------------------------------------------
+// AddrSpace::ExitThread
+// 	Finish the current thread, waking up anyone waiting to join it.
+//	If it is the program's first thread, there's no one to wake.
+//----------------------------------------------------------------------
 
+void
+AddrSpace::ExitThread(int exitCode)
+{
+    int id = kernel->currentThread->userThread;
+
+    if (id != 0) {
+	threadLock->Acquire();
+	userThread[id - 1].exited = TRUE;
+	userThread[id - 1].exitCode = exitCode;
+	threadExited->Broadcast(threadLock);
+	threadLock->Release();
+    }
+    kernel->currentThread->Finish();
+}
@@ -2,9 +2,11 @@
 //	Data structures to keep track of executing user programs 
 //	(address spaces).
 //
-//	For now, we don't keep any information about address spaces.
-//	The user level CPU state is saved and restored in the thread
-//	executing the user program (see thread.h).
+//	An address space also keeps track of the threads a user program
+//	forks with ThreadFork: each runs in its own kernel thread, with
+//	its own user stack mapped above the others.  The user level CPU
+//	state is saved and restored in the thread executing the user
+//	program (see thread.h).
 //
 // Copyright (c) 1992-1996 The Regents of the University of California.
 // All rights reserved.  See copyright.h for copyright notice and limitation 
@@ -17,6 +19,26 @@
 #include "filesys.h"
 
 #define UserStackSize		1024 	// increase this as necessary!
+#define MaxUserThreads		8	// threads a program can have forked
+					// and not yet joined
+
+class Thread;
+class Lock;
+class Condition;
+
+// A thread forked by a user program.  Its ThreadId is its index in
+// the address space's table, plus one.
+
+class UserThread {
+  public:
+    bool inUse;			// forked and not yet joined?
+    bool exited;		// has it called ThreadExit?
+    int exitCode;		// what it passed to ThreadExit
+    int func;			// user address it starts at
+    int retAddr;		// user address "func" returns to
+    int stackTop;		// top of its user stack, or 0 if none
+				// has been mapped for this slot yet
+};
 
 class AddrSpace {
   public:
@@ -31,6 +53,7 @@ class AddrSpace {
 					// assumes the program has already
                                         // been loaded
 
+    void SetArgs(int *args);		// pass four numbers to main
     void SaveState();			// Save/restore address space-specific
     void RestoreState();		// info on a context switch 
     
@@ -40,6 +63,28 @@ class AddrSpace {
     // is 0 for Read, 1 for Write.
     ExceptionType Translate(unsigned int vaddr, unsigned int *paddr, int mode);
 
+    bool CanCopy(unsigned int vaddr, int size, int mode);
+					// is every byte of the range in the
+					// address space, and writable if
+					// _mode_ is 1?
+    bool CopyIn(unsigned int vaddr, char *to, int size);
+					// copy from the program's memory,
+    bool CopyOut(char *from, unsigned int vaddr, int size);
+					// or into it; FALSE, copying nothing,
+					// if the range is not all there
+
+    int ForkThread(int func, int retAddr);
+					// start a thread at "func", returning
+					// to "retAddr"; return its ThreadId,
+					// or -1 if it can't be created
+    int JoinThread(int id);		// wait for a forked thread to exit;
+					// return its exit code, or -1
+    void ExitThread(int exitCode);	// finish the current thread
+    void StartThread(int id);		// jump to a forked thread's code
+    bool DropThread();			// a thread running it is being
+					// destroyed; TRUE if it was the
+					// last one
+
 	TranslationEntry *pageTable;	// Assume linear page table translation
 
   private:
@@ -47,9 +92,18 @@ class AddrSpace {
 					// for now!
     unsigned int numPages;		// Number of pages in the virtual 
 					// address space
+    int mainArgs[4];			// main's arguments, or 0s
 
     void InitRegisters();		// Initialize user-level CPU registers,
 					// before jumping to user code
+    int NewStack();			// map another user stack at the top
+					// of the address space
+
+    UserThread userThread[MaxUserThreads];	// forked threads
+    Lock *threadLock;			// protects userThread
+    Condition *threadExited;		// signalled by ExitThread
+    int numThreads;			// kernel threads running it, till
+					// they are destroyed
 
 };
 
@@ -25,6 +25,8 @@
 #include "main.h"
 #include "syscall.h"
 #include "ksyscall.h"
+#include "memops.h"
+#include "memtrack.h"
 //----------------------------------------------------------------------
 // ExceptionHandler
 // 	Entry point into the Nachos kernel.  Called when a user program
@@ -55,6 +57,7 @@ ExceptionHandler(ExceptionType which)
 	int val;
     int status, exit, threadID, programID;
 	int Buffersize, fileId;
+	MemTagScope tag(MemUserProg);
 	DEBUG(dbgSys, "Received Exception " << which << " type: " << type << "\n");
     switch (which) {
     case SyscallException:
@@ -70,7 +73,7 @@ ExceptionHandler(ExceptionType which)
 			val = kernel->machine->ReadRegister(4);
 			{
 			char *msg = &(kernel->machine->mainMemory[val]);
-			cout << msg << endl;
+			SysMSG(msg);
 			}
 
 			/*kernel->machine->WriteRegister(PrevPCReg, kernel->machine->ReadRegister(PCReg));
@@ -142,13 +145,15 @@ ExceptionHandler(ExceptionType which)
 			val = kernel->machine->ReadRegister(4); //get fileId
 			Buffersize = kernel->machine->ReadRegister(5);
 			fileId = kernel->machine->ReadRegister(6);
-			{
-				char *buffer;
-				
-				buffer = SysRead(Buffersize, fileId);
-				strcpy(&kernel->machine->mainMemory[val], buffer);
-
-				kernel->machine->WriteRegister(2, strlen(buffer));
+			if (fileId == SysConsoleInput) {
+				/* as much as is there, in one go */
+				kernel->machine->WriteRegister(2,
+				    SysReadConsole(&kernel->machine->mainMemory[val],
+						   Buffersize));
+			} else {
+				kernel->machine->WriteRegister(2,
+				    SysRead(&kernel->machine->mainMemory[val],
+					    Buffersize, fileId));
 			}
 
 			kernel->machine->WriteRegister(PrevPCReg, kernel->machine->ReadRegister(PCReg));
@@ -174,6 +179,119 @@ ExceptionHandler(ExceptionType which)
 	 		kernel->machine->WriteRegister(NextPCReg, kernel->machine->ReadRegister(PCReg)+4);
 			}
                   
+			return;
+			ASSERTNOTREACHED();
+			break;
+		case SC_Sleep:
+			val = kernel->machine->ReadRegister(4);
+			DEBUG(dbgSys, "Sleep for " << val << " ticks\n");
+			SysSleep(val);
+			kernel->machine->WriteRegister(PrevPCReg, kernel->machine->ReadRegister(PCReg));
+			kernel->machine->WriteRegister(PCReg, kernel->machine->ReadRegister(PCReg) + 4);
+			kernel->machine->WriteRegister(NextPCReg, kernel->machine->ReadRegister(PCReg)+4);
+			return;
+			ASSERTNOTREACHED();
+			break;
+		case SC_RealTime:
+			val = kernel->machine->ReadRegister(4);
+			DEBUG(dbgSys, "RealTime period " << val << "\n");
+			val = SysRealTime(val, kernel->machine->ReadRegister(5),
+					  kernel->machine->ReadRegister(6));
+			kernel->machine->WriteRegister(2, val);
+			kernel->machine->WriteRegister(PrevPCReg, kernel->machine->ReadRegister(PCReg));
+			kernel->machine->WriteRegister(PCReg, kernel->machine->ReadRegister(PCReg) + 4);
+			kernel->machine->WriteRegister(NextPCReg, kernel->machine->ReadRegister(PCReg)+4);
+			return;
+			ASSERTNOTREACHED();
+			break;
+		case SC_NextPeriod:
+			DEBUG(dbgSys, "NextPeriod\n");
+			SysNextPeriod();
+			kernel->machine->WriteRegister(PrevPCReg, kernel->machine->ReadRegister(PCReg));
+			kernel->machine->WriteRegister(PCReg, kernel->machine->ReadRegister(PCReg) + 4);
+			kernel->machine->WriteRegister(NextPCReg, kernel->machine->ReadRegister(PCReg)+4);
+			return;
+			ASSERTNOTREACHED();
+			break;
+		case SC_ThreadFork:
+			val = kernel->machine->ReadRegister(4);
+			DEBUG(dbgSys, "ThreadFork at " << val << "\n");
+			val = SysThreadFork(val, kernel->machine->ReadRegister(5));
+			kernel->machine->WriteRegister(2, val);
+			kernel->machine->WriteRegister(PrevPCReg, kernel->machine->ReadRegister(PCReg));
+			kernel->machine->WriteRegister(PCReg, kernel->machine->ReadRegister(PCReg) + 4);
+			kernel->machine->WriteRegister(NextPCReg, kernel->machine->ReadRegister(PCReg)+4);
+			return;
+			ASSERTNOTREACHED();
+			break;
+		case SC_ThreadYield:
+			DEBUG(dbgSys, "ThreadYield\n");
+			SysThreadYield();
+			kernel->machine->WriteRegister(PrevPCReg, kernel->machine->ReadRegister(PCReg));
+			kernel->machine->WriteRegister(PCReg, kernel->machine->ReadRegister(PCReg) + 4);
+			kernel->machine->WriteRegister(NextPCReg, kernel->machine->ReadRegister(PCReg)+4);
+			return;
+			ASSERTNOTREACHED();
+			break;
+		case SC_ThreadJoin:
+			val = kernel->machine->ReadRegister(4);
+			DEBUG(dbgSys, "ThreadJoin " << val << "\n");
+			val = SysThreadJoin(val);
+			kernel->machine->WriteRegister(2, val);
+			kernel->machine->WriteRegister(PrevPCReg, kernel->machine->ReadRegister(PCReg));
+			kernel->machine->WriteRegister(PCReg, kernel->machine->ReadRegister(PCReg) + 4);
+			kernel->machine->WriteRegister(NextPCReg, kernel->machine->ReadRegister(PCReg)+4);
+			return;
+			ASSERTNOTREACHED();
+			break;
+		case SC_ThreadExit:
+			val = kernel->machine->ReadRegister(4);
+			DEBUG(dbgSys, "ThreadExit " << val << "\n");
+			SysThreadExit(val);
+			ASSERTNOTREACHED();
+			break;
+		case SC_FutexWait:
+			val = SysFutexWait(kernel->machine->ReadRegister(4),
+					   kernel->machine->ReadRegister(5));
+			kernel->machine->WriteRegister(2, val);
+			kernel->machine->WriteRegister(PrevPCReg, kernel->machine->ReadRegister(PCReg));
+			kernel->machine->WriteRegister(PCReg, kernel->machine->ReadRegister(PCReg) + 4);
+			kernel->machine->WriteRegister(NextPCReg, kernel->machine->ReadRegister(PCReg)+4);
+			return;
+			ASSERTNOTREACHED();
+			break;
+		case SC_FutexWake:
+			val = SysFutexWake(kernel->machine->ReadRegister(4),
+					   kernel->machine->ReadRegister(5));
+			kernel->machine->WriteRegister(2, val);
+			kernel->machine->WriteRegister(PrevPCReg, kernel->machine->ReadRegister(PCReg));
+			kernel->machine->WriteRegister(PCReg, kernel->machine->ReadRegister(PCReg) + 4);
+			kernel->machine->WriteRegister(NextPCReg, kernel->machine->ReadRegister(PCReg)+4);
+			return;
+			ASSERTNOTREACHED();
+			break;
+		case SC_MailSend:
+			DEBUG(dbgSys, "MailSend to machine " << kernel->machine->ReadRegister(4) << ", box " << kernel->machine->ReadRegister(5) << "\n");
+			val = SysMailSend(kernel->machine->ReadRegister(4),
+					  kernel->machine->ReadRegister(5),
+					  kernel->machine->ReadRegister(6),
+					  kernel->machine->ReadRegister(7));
+			kernel->machine->WriteRegister(2, val);
+			kernel->machine->WriteRegister(PrevPCReg, kernel->machine->ReadRegister(PCReg));
+			kernel->machine->WriteRegister(PCReg, kernel->machine->ReadRegister(PCReg) + 4);
+			kernel->machine->WriteRegister(NextPCReg, kernel->machine->ReadRegister(PCReg)+4);
+			return;
+			ASSERTNOTREACHED();
+			break;
+		case SC_MailRecv:
+			DEBUG(dbgSys, "MailRecv in box " << kernel->machine->ReadRegister(4) << "\n");
+			val = SysMailRecv(kernel->machine->ReadRegister(4),
+					  kernel->machine->ReadRegister(5),
+					  kernel->machine->ReadRegister(6));
+			kernel->machine->WriteRegister(2, val);
+			kernel->machine->WriteRegister(PrevPCReg, kernel->machine->ReadRegister(PCReg));
+			kernel->machine->WriteRegister(PCReg, kernel->machine->ReadRegister(PCReg) + 4);
+			kernel->machine->WriteRegister(NextPCReg, kernel->machine->ReadRegister(PCReg)+4);
 			return;
 			ASSERTNOTREACHED();
 			break;
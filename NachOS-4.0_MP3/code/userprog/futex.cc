@@ -0,0 +1,118 @@
+// futex.cc
+//	Routines to put threads to sleep on a word of user memory, and
+//	to wake them up.  See futex.h.
+//
+//	Both run with interrupts off, so that no other thread can change
+//	the word or wake anyone between FutexWait checking the word and
+//	going to sleep: a FutexWake that comes after the user program
+//	changed the word can't be missed.
+//
+// Copyright (c) 1992-1996 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "futex.h"
+#include "main.h"
+#include "addrspace.h"
+
+//----------------------------------------------------------------------
+// FutexTable::FutexTable
+// FutexTable::~FutexTable
+// 	Set up, and tear down, the empty wait queues.
+//----------------------------------------------------------------------
+
+FutexTable::FutexTable()
+{
+    for (int b = 0; b < FutexBuckets; b++)
+	buckets[b] = new List<FutexWaiter *>;
+}
+
+FutexTable::~FutexTable()
+{
+    for (int b = 0; b < FutexBuckets; b++)
+	delete buckets[b];
+}
+
+//----------------------------------------------------------------------
+// UserWord
+// 	Find the word at user address "addr", in the current thread's
+//	address space.  Return FALSE if it isn't a word of it.
+//----------------------------------------------------------------------
+
+static bool
+UserWord(int addr, unsigned int *paddr)
+{
+    if (addr & 0x3)
+	return FALSE;
+    return kernel->currentThread->space->Translate(addr, paddr, 0)
+							== NoException;
+}
+
+//----------------------------------------------------------------------
+// FutexTable::Wait
+// 	Put the current thread to sleep until a FutexWake on "addr" --
+//	but only if the word there still holds "value"; if it has changed
+//	since the user program looked, whatever it was waiting for may
+//	already have happened.
+//
+//	Returns 0 once woken, or -1 if the word held something else (or
+//	"addr" is not a word of the program).
+//----------------------------------------------------------------------
+
+int
+FutexTable::Wait(int addr, int value)
+{
+    FutexWaiter waiter;
+    unsigned int word;
+    IntStatus oldLevel;
+
+    if (!UserWord(addr, &waiter.paddr))
+	return -1;
+    oldLevel = kernel->interrupt->SetLevel(IntOff);
+    memcpy(&word, &kernel->machine->mainMemory[waiter.paddr], sizeof(word));
+    if ((int) WordToHost(word) != value) {
+	(void) kernel->interrupt->SetLevel(oldLevel);
+	return -1;
+    }
+    waiter.thread = kernel->currentThread;
+    DEBUG(dbgSys, "FutexWait on " << waiter.paddr << " by "
+	  << waiter.thread->getName());
+    Bucket(waiter.paddr)->Append(&waiter);
+    kernel->currentThread->Sleep(FALSE);
+    (void) kernel->interrupt->SetLevel(oldLevel);
+    return 0;
+}
+
+//----------------------------------------------------------------------
+// FutexTable::Wake
+// 	Wake up to "count" of the threads waiting on "addr", the ones that
+//	have waited longest first.  Returns how many were woken, or -1 if
+//	"addr" is not a word of the program.
+//----------------------------------------------------------------------
+
+int
+FutexTable::Wake(int addr, int count)
+{
+    unsigned int paddr;
+    List<FutexWaiter *> *bucket;
+    IntStatus oldLevel;
+    int woken = 0;
+
+    if (!UserWord(addr, &paddr))
+	return -1;
+    oldLevel = kernel->interrupt->SetLevel(IntOff);
+    bucket = Bucket(paddr);
+    for (int n = bucket->NumInList(); n > 0; n--) {	// once round,
+	FutexWaiter *waiter = bucket->RemoveFront();	// keeping the order
+
+	if (waiter->paddr == paddr && woken < count) {
+	    kernel->scheduler->ReadyToRun(waiter->thread);
+	    woken++;
+	} else
+	    bucket->Append(waiter);
+    }
+    (void) kernel->interrupt->SetLevel(oldLevel);
+    DEBUG(dbgSys, "FutexWake on " << paddr << " woke " << woken);
+    return woken;
+}
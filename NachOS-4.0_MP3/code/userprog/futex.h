@@ -0,0 +1,55 @@
+// futex.h
+//	Data structures for the FutexWait and FutexWake system calls,
+//	which let a user program build its own locks: it takes and
+//	gives back a lock with LL/SC on a word of its memory, with no
+//	system call at all, and only asks the kernel to put it to sleep
+//	(or wake a sleeper) when the lock is contended.
+//
+//	The threads waiting on a word are kept in a hash table of wait
+//	queues, keyed by the word's physical address, so that threads
+//	of the same program -- or of any two programs sharing the page
+//	-- find each other whatever virtual address they use for it.
+//
+// Copyright (c) 1992-1996 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#ifndef FUTEX_H
+#define FUTEX_H
+
+#include "copyright.h"
+#include "list.h"
+
+class Thread;
+
+#define FutexBuckets	64		// wait queues in the hash table
+
+// A thread asleep in FutexWait, on its own stack
+
+class FutexWaiter {
+  public:
+    unsigned int paddr;			// the word it is waiting on
+    Thread *thread;
+};
+
+class FutexTable {
+  public:
+    FutexTable();			// no one waiting
+    ~FutexTable();
+
+    int Wait(int addr, int value);	// sleep, if the word at user
+					// address "addr" still holds
+					// "value"; return 0 once woken,
+					// or -1 if it doesn't
+    int Wake(int addr, int count);	// wake up to "count" threads
+					// waiting on "addr", in the order
+					// they came; return how many
+
+  private:
+    List<FutexWaiter *> *buckets[FutexBuckets];
+
+    List<FutexWaiter *> *Bucket(unsigned int paddr)
+	{ return buckets[(paddr >> 2) % FutexBuckets]; }
+};
+
+#endif // FUTEX_H
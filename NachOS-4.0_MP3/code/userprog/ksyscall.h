@@ -12,6 +12,8 @@
 #define __USERPROG_KSYSCALL_H__ 
 
 #include "kernel.h"
+#include "futex.h"
+#include "post.h"
 
 #include "synchconsole.h"
 
@@ -39,6 +41,17 @@ void SysPrintInt(int number)
   kernel->interrupt->PrintInt(number);
 }
 
+void SysMSG(char *msg)
+{
+  kernel->synchConsoleOut->PutBuffer(msg, strlen(msg));
+  kernel->synchConsoleOut->PutChar('\n');
+}
+
+void SysSleep(int ticks)
+{
+  kernel->alarm->WaitUntil(ticks);
+}
+
 int SysOpen(char *filename) {
   //return value
   // >0: success
@@ -58,8 +71,92 @@ int SysWrite(char *buffer, int size, int id) {
   // number of characters actually written into file
   return kernel->interrupt->WriteFile(buffer, size, id);
 }
-char* SysRead(int size, int id)
+int SysRead(char *buffer, int size, int id)
+{
+	return kernel->interrupt->ReadFile(buffer, size, id);
+}
+
+int SysReadConsole(char *buffer, int size)
+{
+  return kernel->synchConsoleIn->Read(buffer, size);
+}
+
+int SysRealTime(int period, int budget, int deadline)
+{
+  IntStatus oldLevel = kernel->interrupt->SetLevel(IntOff);
+  bool admitted = kernel->scheduler->SetRealTime(kernel->currentThread,
+						 period, budget, deadline);
+
+  (void) kernel->interrupt->SetLevel(oldLevel);
+  return admitted ? 0 : -1;
+}
+
+void SysNextPeriod()
+{
+  kernel->scheduler->NextPeriod();
+}
+
+int SysThreadFork(int func, int retAddr)
+{
+  return kernel->currentThread->space->ForkThread(func, retAddr);
+}
+
+void SysThreadYield()
+{
+  kernel->currentThread->Yield();
+}
+
+int SysThreadJoin(int id)
 {
-	return kernel->interrupt->ReadFile(size, id);
+  return kernel->currentThread->space->JoinThread(id);
+}
+
+void SysThreadExit(int exitCode)
+{
+  kernel->currentThread->space->ExitThread(exitCode);
+}
+
+int SysFutexWait(int addr, int value)
+{
+  return kernel->futexes->Wait(addr, value);
+}
+
+int SysFutexWake(int addr, int count)
+{
+  return kernel->futexes->Wake(addr, count);
+}
+
+int SysMailSend(int machine, int box, int buffer, int size)
+{
+  Mail mail;
+
+  if (machine < 0 || box < 0 || size < 0 || size > (int) MaxMailSize
+      || !kernel->currentThread->space->CopyIn(buffer, mail.data, size))
+    return -1;
+  mail.pktHdr.to = machine;
+  mail.mailHdr.to = box;
+  mail.mailHdr.from = box;
+  mail.mailHdr.length = size;
+  kernel->StartNetwork();
+  kernel->postOfficeOut->Send(&mail);
+  return size;
+}
+
+int SysMailRecv(int box, int buffer, int size)
+{
+  AddrSpace *space = kernel->currentThread->space;
+  Mail *mail;
+
+  // check the buffer first, so that no message is lost for want of it
+  if (box < 0 || size < 0 || !space->CanCopy(buffer, size, 1))
+    return -1;
+  kernel->StartNetwork();
+  kernel->postOfficeIn->Open(box, DefaultBoxCapacity, MailBackpressure);
+  mail = kernel->postOfficeIn->Receive(box);	// in the buffer it
+						// arrived in
+  size = min(size, (int) mail->mailHdr.length);
+  (void) space->CopyOut(mail->data, buffer, size);
+  kernel->postOfficeIn->Release(mail);
+  return size;
 }
 #endif /* ! __USERPROG_KSYSCALL_H__ */
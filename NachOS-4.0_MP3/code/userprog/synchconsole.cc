@@ -15,13 +15,18 @@
 //
 //      "inputFile" -- if NULL, use stdin as console device
 //              otherwise, read from this file
+//	"cooked" -- if TRUE, hand the input to readers a line at a time,
+//		after editing it; otherwise, as it comes
 //----------------------------------------------------------------------
 
-SynchConsoleInput::SynchConsoleInput(char *inputFile)
+SynchConsoleInput::SynchConsoleInput(char *inputFile, bool cooked)
 {
-    consoleInput = new ConsoleInput(inputFile, this);
+    this->cooked = cooked;
+    lineLength = 0;
+    lineDone = atEnd = waiting = pending = FALSE;
     lock = new Lock("console in");
     waitFor = new Semaphore("console in", 0);
+    consoleInput = new ConsoleInput(inputFile, this);
 }
 
 //----------------------------------------------------------------------
@@ -36,33 +41,184 @@ SynchConsoleInput::~SynchConsoleInput()
     delete waitFor;
 }
 
+//----------------------------------------------------------------------
+// SynchConsoleInput::Wait
+//      Wait until there is something in the ring to read.  There only
+//	ever is a whole line, in cooked mode, so the reader is woken up
+//	once a line rather than for every keystroke.  Returns FALSE,
+//	without waiting, if the input has all been read.
+//
+//	Interrupts must be off, so that CallBack can't add a character
+//	between our finding the ring empty and going to sleep (it only
+//	wakes us if we are waiting).
+//----------------------------------------------------------------------
+
+bool
+SynchConsoleInput::Wait()
+{
+    while (typed.IsEmpty()) {
+	if (atEnd && !lineDone)
+	    return FALSE;
+	waiting = TRUE;
+	waitFor->P();
+    }
+    return TRUE;
+}
+
 //----------------------------------------------------------------------
 // SynchConsoleInput::GetChar
 //      Read a character typed at the keyboard, waiting if necessary.
+//	Characters are taken off the keyboard by CallBack, and queued
+//	in a ring; we only have to wait if the ring is empty.  Returns
+//	EOF at the end of the input.
 //----------------------------------------------------------------------
 
 char
 SynchConsoleInput::GetChar()
 {
-    char ch;
+    char ch = EOF;
+    IntStatus oldLevel;
 
     lock->Acquire();
-    ch = consoleInput->GetChar();
-    waitFor->P();
+    oldLevel = kernel->interrupt->SetLevel(IntOff);
+    if (Wait()) {
+	typed.Get(&ch);
+	Refill();
+    }
+    (void) kernel->interrupt->SetLevel(oldLevel);
     lock->Release();
     return ch;
 }
 
+//----------------------------------------------------------------------
+// SynchConsoleInput::Read
+//      Read as much of what has been typed as is there, waiting for
+//	something if nothing is, with one wait rather than one per
+//	character.  In cooked mode, stop at the end of a line, as a
+//	UNIX terminal does.  Returns how many characters were read, or
+//	0 at the end of the input.
+//
+//	"buf" -- where to put them
+//	"size" -- the most to read
+//----------------------------------------------------------------------
+
+int
+SynchConsoleInput::Read(char *buf, int size)
+{
+    char ch;
+    int n = 0;
+    IntStatus oldLevel;
+
+    if (size <= 0)
+	return 0;
+    lock->Acquire();
+    oldLevel = kernel->interrupt->SetLevel(IntOff);
+    if (Wait()) {
+	while (n < size && typed.Get(&ch)) {
+	    buf[n++] = ch;
+	    Refill();
+	    if (cooked && ch == '\n')
+		break;
+	}
+    }
+    (void) kernel->interrupt->SetLevel(oldLevel);
+    lock->Release();
+    return n;
+}
+
+//----------------------------------------------------------------------
+// SynchConsoleInput::Refill
+//      Now that the reader has made room in the ring, put in a line
+//	that didn't fit, and take the keystroke left on the keyboard
+//	for want of room, if there is one.  Interrupts must be off.
+//----------------------------------------------------------------------
+
+void
+SynchConsoleInput::Refill()
+{
+    if (lineDone && !Commit())
+	return;
+    if (pending && (cooked || !typed.IsFull())) {
+	pending = FALSE;
+	Take(consoleInput->GetChar());
+    }
+}
+
 //----------------------------------------------------------------------
 // SynchConsoleInput::CallBack
-//      Interrupt handler called when keystroke is hit; wake up
-//	anyone waiting.
+//      Interrupt handler called when keystroke is hit.  Take it off
+//	the keyboard, so the next one can come in.  If there is no room
+//	for it -- the ring is full, or in cooked mode the last line is
+//	still waiting to go in -- it is left on the keyboard until a
+//	read makes room.
 //----------------------------------------------------------------------
 
 void
 SynchConsoleInput::CallBack()
 {
-    waitFor->V();
+    if (cooked ? lineDone : typed.IsFull()) {
+	pending = TRUE;
+	return;
+    }
+    Take(consoleInput->GetChar());
+}
+
+//----------------------------------------------------------------------
+// SynchConsoleInput::Take
+//      Add a keystroke to the input, through the line discipline: in
+//	raw mode it goes straight into the ring; in cooked mode it is
+//	added to the line being typed (or edits it), and the line goes
+//	into the ring once it ends, with a newline, a full line, or the
+//	end of the input.  Wake up the reader if it is waiting, and
+//	there is now something for it.
+//----------------------------------------------------------------------
+
+void
+SynchConsoleInput::Take(char ch)
+{
+    if (ch == EOF) {
+	atEnd = TRUE;			// whatever was typed of the last
+	lineDone = cooked;		// line is all there will be
+    } else if (!cooked) {
+	typed.Put(ch);
+    } else if (ch == ConsoleErase || ch == '\177') {
+	if (lineLength > 0)
+	    lineLength--;
+	return;
+    } else if (ch == ConsoleKill) {
+	lineLength = 0;
+	return;
+    } else {
+	line[lineLength++] = ch;
+	if (ch != '\n' && lineLength < ConsoleLineSize)
+	    return;			// not finished yet
+	lineDone = TRUE;
+    }
+    if (lineDone && !Commit())
+	return;				// Refill will, once there's room
+    if (waiting) {
+	waiting = FALSE;
+	waitFor->V();
+    }
+}
+
+//----------------------------------------------------------------------
+// SynchConsoleInput::Commit
+//      Move the finished line into the ring, for the reader.  Returns
+//	FALSE, and leaves it where it is, if there isn't room for all of
+//	it yet.
+//----------------------------------------------------------------------
+
+bool
+SynchConsoleInput::Commit()
+{
+    if (ConsoleTypeAhead - typed.NumInRing() < lineLength)
+	return FALSE;
+    for (int i = 0; i < lineLength; i++)
+	typed.Put(line[i]);
+    lineLength = 0;
+    lineDone = FALSE;
+    return TRUE;
 }
 
 //----------------------------------------------------------------------
@@ -118,13 +274,44 @@ SynchConsoleOutput::CallBack()
     waitFor->V();
 }
 
+//----------------------------------------------------------------------
+// SynchConsoleOutput::PutBuffer
+//      Write a block of characters to the console display, waiting 
+//	if necessary.  The device puts them all out with one write and 
+//	one interrupt, rather than one of each per character.
+//
+//	"buf" -- the characters to write
+//	"numChars" -- how many
+//----------------------------------------------------------------------
+
+void
+SynchConsoleOutput::PutBuffer(char *buf, int numChars)
+{
+    if (numChars <= 0)
+	return;
+    lock->Acquire();
+    consoleOutput->PutBuffer(buf, numChars);
+    waitFor->P();
+    lock->Release();
+}
+
+//----------------------------------------------------------------------
+// SynchConsoleOutput::PrintInt
+//      Write a number to the console display in decimal, as one block.
+//----------------------------------------------------------------------
 
 void
 SynchConsoleOutput::PrintInt(int number)
 {
-	lock->Acquire();
-	consoleOutput->PrintInt(number);
-	waitFor->P();
-	lock->Release();
-}
+    char buf[12];		// enough for "-2147483648"
+    int i = sizeof(buf);
+    unsigned int n = (number < 0) ? -(unsigned int) number : number;
 
+    do {
+	buf[--i] = (n % 10) + '0';
+	n /= 10;
+    } while (n != 0);
+    if (number < 0)
+	buf[--i] = '-';
+    PutBuffer(&buf[i], sizeof(buf) - i);
+}
@@ -16,23 +16,61 @@
 #include "callback.h"
 #include "console.h"
 #include "synch.h"
+#include "ring.h"
+
+// Characters that can be typed ahead, before anyone reads them, and
+// the longest line that can be edited before it is
+
+const int ConsoleTypeAhead = 256;
+const int ConsoleLineSize = 128;
+
+// The editing characters of cooked mode
+
+const char ConsoleErase = '\b';	// take back the last character (or DEL)
+const char ConsoleKill = 0x15;		// take back the whole line (^U)
 
 // The following two classes define synchronized input and output to
 // a console device
 
 class SynchConsoleInput : public CallBackObj {
   public:
-    SynchConsoleInput(char *inputFile); // Initialize the console device
+    SynchConsoleInput(char *inputFile, bool cooked = TRUE);
+				// Initialize the console device; in
+				// cooked mode, input is edited, and
+				// handed over, a line at a time
     ~SynchConsoleInput();		// Deallocate console device
 
-    char GetChar();		// Read a character, waiting if necessary
+    char GetChar();		// Read a character, waiting if necessary;
+				// EOF at the end of the input
+    int Read(char *buf, int size);
+				// Read what has been typed, up to "size"
+				// characters and (in cooked mode) the end
+				// of a line, waiting for at least one;
+				// return how many, or 0 at the end
     
   private:
     ConsoleInput *consoleInput;	// the hardware keyboard
     Lock *lock;			// only one reader at a time
     Semaphore *waitFor;		// wait for callBack
+    Ring<char, ConsoleTypeAhead> typed;	// characters CallBack has taken
+				// from the keyboard and not yet read --
+				// in cooked mode, only whole lines
+    bool cooked;		// edit the input into lines?
+    char line[ConsoleLineSize];	// in cooked mode, the line being typed
+    int lineLength;
+    bool lineDone;		// is it finished, but there isn't room
+				// in the ring for it yet?
+    bool atEnd;			// has the end of the input been reached?
+    bool waiting;		// is the reader waiting for CallBack?
+    bool pending;		// is a character left on the keyboard,
+				// because there was no room for it?
 
     void CallBack();		// called when a keystroke is available
+    void Take(char ch);		// add a keystroke to the input
+    bool Commit();		// move a finished line into the ring
+    void Refill();		// after reading: take anything left
+				// waiting for room
+    bool Wait();		// wait for input; FALSE at the end
 };
 
 class SynchConsoleOutput : public CallBackObj {
@@ -41,7 +79,10 @@ class SynchConsoleOutput : public CallBackObj {
     ~SynchConsoleOutput();
 
     void PutChar(char ch);	// Write a character, waiting if necessary
-	void PrintInt(int number);
+    void PutBuffer(char *buf, int numChars);
+				// Write a block of characters, waiting 
+				// once for all of them
+    void PrintInt(int number);	// Write a number in decimal
    
   private:
     ConsoleOutput *consoleOutput;// the hardware display
@@ -34,6 +34,13 @@
 #define SC_ExecV	13
 #define SC_ThreadExit   14
 #define SC_ThreadJoin   15
+#define SC_Sleep	16
+#define SC_RealTime	17
+#define SC_NextPeriod	18
+#define SC_FutexWait	19
+#define SC_FutexWake	20
+#define SC_MailSend	21
+#define SC_MailRecv	22
 #define SC_PrintInt 40
 #define SC_Add		42
 #define SC_MSG		100
@@ -53,6 +60,21 @@
 /* Stop Nachos, and print out performance stats */
 void Halt();			
 
+/* Suspend the calling thread for (at least) "ticks" simulated ticks */
+void Sleep(int ticks);
+
+/* Make the calling thread real-time: it runs a job every "period" ticks,
+ * for at most "budget" ticks, each of which must be done within
+ * "deadline" ticks of its period starting (0 for the whole period).
+ * It is scheduled earliest deadline first, ahead of every other thread.
+ * Return 0 if it is admitted, -1 if its budget can't be guaranteed.
+ * A period of 0 makes it an ordinary thread again.
+ */
+int RealTime(int period, int budget, int deadline);
+
+/* A real-time thread has finished this period's job: wait for the next */
+void NextPeriod();
+
 /*Print Interger to console*/
 void PrintInt(int number);
  
@@ -139,6 +161,9 @@ int Write(char *buffer, int size, OpenFileId id);
  * long enough, or if it is an I/O device, and there aren't enough 
  * characters to read, return whatever is available (for I/O devices, 
  * you should always wait until you can return at least one character).
+ * From SysConsoleInput, a read returns what has been typed, in one go;
+ * unless nachos is run with "-cmode raw", that is one edited line at
+ * most, newline included, and 0 means the end of the input.
  */
 int Read(char *buffer, int size, OpenFileId id);
 
@@ -178,9 +203,52 @@ int ThreadJoin(ThreadId id);
 
 /*
  * Deletes current thread and returns ExitCode to every waiting lokal thread.
+ * A thread that returns from the function it was forked with calls this,
+ * with the function's return value.
  */
 void ThreadExit(int ExitCode);	
 
+/* Futexes: the kernel half of locks a user program builds for itself
+ * (see usync.h).  FutexWait puts the thread to sleep, if the word at
+ * "addr" still holds "val", until a FutexWake on the same word; it
+ * returns 0 once woken, and -1 at once if the word holds something
+ * else.  FutexWake wakes up to "n" of the threads waiting on "addr",
+ * longest waiting first, and returns how many it woke.  Threads are
+ * matched by the word's physical address, not its virtual one.
+ */
+int FutexWait(int *addr, int val);
+int FutexWake(int *addr, int n);
+
+/* Mail between machines, through the post office (see network/post.h).
+ * MailSend sends "len" bytes from "buf" to mailbox "box" of machine
+ * "machine" (which may be this one), with the same box number to reply
+ * to; at most MaxMailSize (40) bytes go in one message, and like any
+ * packet it may be lost.  It returns "len", or -1 if the message is too
+ * long or "buf" is not all in the program.  MailRecv waits for a
+ * message to arrive in mailbox "box" of this machine, and copies up to
+ * "len" bytes of it into "buf", straight from the buffer it arrived
+ * in; it returns how many it copied (the rest of the message is lost),
+ * or -1 if "buf" is not all in the program and writable.
+ */
+int MailSend(int machine, int box, char *buf, int len);
+int MailRecv(int box, char *buf, int len);
+
+/* Switch to another user-level thread in the same kernel thread, with
+ * no system call: the registers a C function has to preserve are saved
+ * in *from, and loaded from *to.  Threads switched this way are
+ * scheduled by the user program itself.  To start a new one, set its
+ * stack pointer (regs[UserSP]) and the function to run (regs[UserRA]),
+ * which must never return.
+ */
+#define UserSP		8
+#define UserRA		10
+
+typedef struct {
+  int regs[11];		/* s0-s7, sp, fp, ra */
+} UserContext;
+
+void UserSwitch(UserContext *from, UserContext *to);
+
 #endif /* IN_ASM */
 
 #endif /* SYSCALL_H */
@@ -0,0 +1,270 @@
+// checksum.cc
+//	Routines to keep, check and save the checksum of each disk sector.
+//
+//	Like the journal's, the checksum area's own sectors are always
+//	read and written straight to the disk with SynchDisk::ReadSectors
+//	and WriteSectors; they are never in the cache.
+//
+//	The CRC32C is computed eight bytes at a time from eight lookup
+//	tables ("slicing by 8"), or with the SSE4.2 crc32 instruction
+//	when Nachos is compiled for a host that has it (-msse4.2).
+//	Either way a sector costs far less than the simulated disk
+//	spends transferring it.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#ifndef FILESYS_STUB
+
+#include "copyright.h"
+#include "main.h"
+#include "checksum.h"
+#include "synchdisk.h"
+#include "memops.h"
+
+#ifdef __SSE4_2__
+#include <nmmintrin.h>
+#endif
+
+#define Crc32cPoly	0x82f63b78	// Castagnoli, bit-reversed
+
+static unsigned crcTable[8][256];
+static bool crcTableBuilt = FALSE;
+
+//----------------------------------------------------------------------
+// BuildCrcTable
+// 	Fill in crcTable: crcTable[0][b] is the CRC of the byte b, and
+//	crcTable[k][b] that of b followed by k zero bytes.
+//----------------------------------------------------------------------
+
+static void
+BuildCrcTable()
+{
+    for (int b = 0; b < 256; b++) {
+	unsigned crc = b;
+
+	for (int bit = 0; bit < 8; bit++)
+	    crc = (crc & 1) ? (crc >> 1) ^ Crc32cPoly : crc >> 1;
+	crcTable[0][b] = crc;
+    }
+    for (int k = 1; k < 8; k++)
+	for (int b = 0; b < 256; b++)
+	    crcTable[k][b] = (crcTable[k - 1][b] >> 8)
+				^ crcTable[0][crcTable[k - 1][b] & 0xff];
+    crcTableBuilt = TRUE;
+}
+
+//----------------------------------------------------------------------
+// Crc32c
+// 	Return the CRC32C of "length" bytes at "data".
+//----------------------------------------------------------------------
+
+unsigned
+Crc32c(char *data, int length)
+{
+    unsigned char *p = (unsigned char *) data;
+    unsigned crc = 0xffffffff;
+
+#ifdef __SSE4_2__
+    for (; length >= 4; length -= 4, p += 4) {
+	unsigned word;
+
+	bcopy(p, &word, 4);
+	crc = _mm_crc32_u32(crc, word);
+    }
+    for (; length > 0; length--, p++)
+	crc = _mm_crc32_u8(crc, *p);
+#else
+    if (!crcTableBuilt)
+	BuildCrcTable();
+    for (; length >= 8; length -= 8, p += 8) {
+	crc ^= p[0] | (p[1] << 8) | (p[2] << 16) | ((unsigned) p[3] << 24);
+	crc = crcTable[7][crc & 0xff] ^ crcTable[6][(crc >> 8) & 0xff]
+		^ crcTable[5][(crc >> 16) & 0xff] ^ crcTable[4][crc >> 24]
+		^ crcTable[3][p[4]] ^ crcTable[2][p[5]]
+		^ crcTable[1][p[6]] ^ crcTable[0][p[7]];
+    }
+    for (; length > 0; length--, p++)
+	crc = (crc >> 8) ^ crcTable[0][(crc ^ *p) & 0xff];
+#endif
+    return crc ^ 0xffffffff;
+}
+
+//----------------------------------------------------------------------
+// Checksums::Checksums
+// 	Initialize the in-memory table of checksums kept in sectors
+//	"firstSector" through "firstSector" + "numSectors" - 1, for
+//	every sector of the disk outside them.  Whether the disk has
+//	a checksum area is found out by Format or Mount.
+//----------------------------------------------------------------------
+
+Checksums::Checksums(int firstSector, int numSectors)
+{
+    ASSERT(sizeof(ChecksumHeader) == SectorSize);
+    start = firstSector;
+    size = numSectors;
+    numEntries = NumSectors - numSectors;
+    tableSectors = divRoundUp(numEntries, ChecksumsPerSector);
+    ASSERT(1 + tableSectors <= size);
+    crc = new unsigned[tableSectors * ChecksumsPerSector];
+    MemZero((char *) crc, tableSectors * SectorSize);
+    numCorrupt = 0;
+    ASSERT(Crc32c((char *) "123456789", 9) == 0xe3069283);
+}
+
+Checksums::~Checksums()
+{
+    delete [] crc;
+}
+
+//----------------------------------------------------------------------
+// Checksums::Index
+// 	Return the entry of the table for "sector", or -1 if the sector
+//	is part of the checksum area itself.
+//----------------------------------------------------------------------
+
+int
+Checksums::Index(int sector)
+{
+    if (sector < start)
+	return sector;
+    if (sector < start + size)
+	return -1;
+    return sector - size;
+}
+
+//----------------------------------------------------------------------
+// Checksums::Format
+// 	Start an empty table, when the disk is being formatted: no
+//	checksum is known until its sector is written.  The caller has
+//	marked the checksum area's sectors as in use.
+//----------------------------------------------------------------------
+
+void
+Checksums::Format()
+{
+    ChecksumHeader header;
+
+    bzero((char *) &header, sizeof(header));
+    header.magic = ChecksumMagic;
+    header.clean = FALSE;		// until Unmount
+    kernel->synchDisk->WriteSectors(start, 1, (char *) &header);
+}
+
+//----------------------------------------------------------------------
+// Checksums::Mount
+// 	When the file system is mounted, before anything else is read:
+//	read the table, if the disk was formatted with one, and mark it
+//	out of date on disk until Unmount writes it back.  If the last
+//	run of Nachos didn't get to Unmount, the table on disk may be
+//	missing the checksums of sectors it wrote, so none are trusted.
+//
+//	Returns FALSE if the disk has no checksum area.
+//----------------------------------------------------------------------
+
+bool
+Checksums::Mount()
+{
+    ChecksumHeader header;
+
+    kernel->synchDisk->ReadSectors(start, 1, (char *) &header);
+    if (header.magic != ChecksumMagic) {
+	DEBUG(dbgFile, "No checksums on this disk");
+	return FALSE;
+    }
+    if (header.clean) {
+	kernel->synchDisk->ReadSectors(start + 1, tableSectors, (char *) crc);
+    } else {
+	DEBUG(dbgFile, "Checksums were not saved; forgetting them");
+	MemZero((char *) crc, tableSectors * SectorSize);
+    }
+    header.clean = FALSE;
+    kernel->synchDisk->WriteSectors(start, 1, (char *) &header);
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// Checksums::Unmount
+// 	Write the table back, then mark it up to date.  The caller has
+//	written every dirty sector in the cache to disk, so the table
+//	has the checksums of everything on the disk.
+//----------------------------------------------------------------------
+
+void
+Checksums::Unmount()
+{
+    ChecksumHeader header;
+
+    kernel->synchDisk->WriteSectors(start + 1, tableSectors, (char *) crc);
+    bzero((char *) &header, sizeof(header));
+    header.magic = ChecksumMagic;
+    header.clean = TRUE;
+    kernel->synchDisk->WriteSectors(start, 1, (char *) &header);
+    kernel->synchDisk->Sync();		// flushes a mapped disk
+}
+
+//----------------------------------------------------------------------
+// Checksums::Transferred
+// 	Called by SynchDisk, with interrupts off, when the disk has
+//	finished a request: "count" sectors starting at "sector" have
+//	been written from, or read into, "data".  A written sector's
+//	checksum is recomputed; a sector read is checked against its
+//	checksum, if that is known.
+//
+//	A corrupt sector is reported, and its checksum forgotten, so that
+//	it is reported only once; the file system carries on with what
+//	was read.
+//----------------------------------------------------------------------
+
+void
+Checksums::Transferred(int sector, int count, char *data, bool writing)
+{
+    for (int i = 0; i < count; i++) {
+	int entry = Index(sector + i);
+	unsigned sum;
+
+	if (entry == -1)
+	    continue;
+	sum = Crc32c(&data[i * SectorSize], SectorSize);
+	if (writing) {
+	    crc[entry] = sum;
+	} else if (crc[entry] == 0) {
+	    crc[entry] = sum;		// learn it
+	} else if (crc[entry] != sum) {
+	    cout << "Checksum error: disk sector " << (sector + i)
+		 << " is corrupt\n";
+	    numCorrupt++;
+	    crc[entry] = 0;
+	}
+    }
+}
+
+//----------------------------------------------------------------------
+// Checksums::Verify
+// 	Read every sector of the disk outside the checksum area, a track
+//	at a time, so that each is checked.  Sectors in the cache are
+//	copied from there rather than read, so their checksums were
+//	checked when they were read in.
+//
+//	Returns how many corrupt sectors were found.
+//----------------------------------------------------------------------
+
+int
+Checksums::Verify()
+{
+    char *buf = new char[SectorsPerTrack * SectorSize];
+    int before = numCorrupt;
+
+    for (int first = 0; first < NumSectors; first += SectorsPerTrack) {
+	int count = SectorsPerTrack;
+
+	if (first < start + size && start < first + count)
+	    continue;			// the checksum area's own track
+	kernel->synchDisk->ReadSectors(first, count, buf);
+    }
+    delete [] buf;
+    return numCorrupt - before;
+}
+
+#endif // FILESYS_STUB
@@ -0,0 +1,82 @@
+// checksum.h
+//	Data structures for keeping a checksum of each sector of the disk,
+//	so that a sector that was changed behind the file system's back
+//	(or that the disk garbled) is noticed when it is read, rather
+//	than turning up as garbage in a file or a failed assertion in
+//	FetchFrom.
+//
+//	A disk formatted with checksums (-crc) gives them a reserved
+//	range of sectors, the checksum area: a header, then the CRC32C of
+//	every other sector of the disk, in order.  While Nachos runs the
+//	table is kept in memory.  SynchDisk hands each transfer to the
+//	disk to Transferred: a sector written gets its checksum
+//	recomputed; a sector read is checked against it.
+//
+//	The table is written back only when the file system is shut down
+//	cleanly.  The header says whether the table on disk is up to
+//	date; after a crash it is not, and every checksum is forgotten
+//	(a forgotten checksum, 0, is learned again the next time the
+//	sector is read or written).  So a crash can never make a good
+//	sector look corrupt.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#ifndef CHECKSUM_H
+#define CHECKSUM_H
+
+#include "copyright.h"
+#include "disk.h"
+
+#define ChecksumMagic		0x43524343	// marks a checksum area
+#define ChecksumsPerSector	((int) (SectorSize / sizeof(unsigned)))
+
+// The first sector of the checksum area.  Exactly one disk sector
+// in size.
+
+class ChecksumHeader {
+  public:
+    int magic;				// ChecksumMagic
+    int clean;				// is the table after it up to date?
+    char unused[SectorSize - 2 * sizeof(int)];
+};
+
+class Checksums {
+  public:
+    Checksums(int firstSector, int numSectors);
+					// The checksums are kept in the
+					// "numSectors" sectors from
+					// "firstSector"
+    ~Checksums();
+
+    void Format();			// Start a new, empty table
+    bool Mount();			// Read the table, if the disk has
+					// one; FALSE if it has none
+    void Unmount();			// Write the table back, and mark
+					// it up to date
+
+    void Transferred(int sector, int count, char *data, bool writing);
+					// "count" sectors from "sector" were
+					// just read into or written from
+					// "data"
+    int Verify();			// Read every sector that has a
+					// checksum; return how many are bad
+
+  private:
+    int Index(int sector);		// entry for "sector", or -1 if it
+					// is in the checksum area
+
+    int start;				// first sector of the checksum area
+    int size;				// number of sectors in it
+    int numEntries;			// sectors with a checksum
+    int tableSectors;			// sectors the table takes
+    unsigned *crc;			// checksum of each, or 0 if unknown
+    int numCorrupt;			// mismatches found so far
+};
+
+extern unsigned Crc32c(char *data, int length);
+					// CRC32C (Castagnoli) of "length"
+					// bytes
+
+#endif // CHECKSUM_H
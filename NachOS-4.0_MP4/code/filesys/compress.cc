@@ -0,0 +1,194 @@
+// compress.cc
+//	Routines to compress and decompress a chunk of data, in the LZ4
+//	block format described in compress.h.
+//
+//	A chunk is at most a few sectors, so a match is never farther
+//	back than LzMaxOffset, and the match table is small enough to
+//	clear for each one.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "compress.h"
+#include "utility.h"
+#include <string.h>
+
+#define LzHashSize	(1 << LzHashBits)
+
+//----------------------------------------------------------------------
+// LzHash
+// 	Which entry of the match table the LzMinMatch bytes at "p" go in.
+//----------------------------------------------------------------------
+
+static unsigned
+LzHash(unsigned char *p)
+{
+    unsigned word;
+
+    memcpy(&word, p, sizeof(word));
+    return (word * 2654435761u) >> (32 - LzHashBits);
+}
+
+//----------------------------------------------------------------------
+// PutLength
+// 	Append the rest of a length whose field in the token was 15 --
+//	"value" more -- to "out", at *n.  Return FALSE if it would go past
+//	"room".
+//----------------------------------------------------------------------
+
+static bool
+PutLength(unsigned char *out, int *n, int room, int value)
+{
+    for (; value >= 255; value -= 255) {
+	if (*n >= room)
+	    return FALSE;
+	out[(*n)++] = 255;
+    }
+    if (*n >= room)
+	return FALSE;
+    out[(*n)++] = value;
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// PutToken
+// 	Append a token to "out", at *n: the "numLiterals" bytes at
+//	"literals", then a match of "matchLength" bytes "offset" back, or
+//	no match if "matchLength" is 0.  Return FALSE if it would go past
+//	"room".
+//----------------------------------------------------------------------
+
+static bool
+PutToken(unsigned char *out, int *n, int room, unsigned char *literals,
+	int numLiterals, int offset, int matchLength)
+{
+    int matchField = (matchLength > 0) ? matchLength - LzMinMatch : 0;
+
+    if (*n >= room)
+	return FALSE;
+    out[(*n)++] = (min(numLiterals, 15) << 4) | min(matchField, 15);
+    if (numLiterals >= 15 && !PutLength(out, n, room, numLiterals - 15))
+	return FALSE;
+    if (*n + numLiterals > room)
+	return FALSE;
+    memcpy(&out[*n], literals, numLiterals);
+    *n += numLiterals;
+    if (matchLength == 0)
+	return TRUE;
+    if (*n + 2 > room)
+	return FALSE;
+    out[(*n)++] = offset & 0xff;
+    out[(*n)++] = offset >> 8;
+    return matchField < 15 || PutLength(out, n, room, matchField - 15);
+}
+
+//----------------------------------------------------------------------
+// LzCompress
+// 	Compress the "length" bytes at "from" into "to", which has room
+//	for "room" bytes.  Return the length of the compressed data, or
+//	-1 if it would not fit.
+//----------------------------------------------------------------------
+
+int
+LzCompress(char *from, int length, char *to, int room)
+{
+    unsigned char *in = (unsigned char *) from;
+    unsigned char *out = (unsigned char *) to;
+    int table[LzHashSize];
+    int i = 0, anchor = 0, n = 0;
+
+    for (int h = 0; h < LzHashSize; h++)
+	table[h] = -1;
+    while (i + LzMinMatch <= length) {
+	unsigned h = LzHash(&in[i]);
+	int candidate = table[h];
+	int matchLength;
+
+	table[h] = i;
+	if (candidate == -1 || i - candidate > LzMaxOffset
+		|| memcmp(&in[candidate], &in[i], LzMinMatch) != 0) {
+	    i++;
+	    continue;
+	}
+	matchLength = LzMinMatch;
+	while (i + matchLength < length
+		&& in[candidate + matchLength] == in[i + matchLength])
+	    matchLength++;
+	if (!PutToken(out, &n, room, &in[anchor], i - anchor, i - candidate,
+			matchLength))
+	    return -1;
+	i += matchLength;
+	anchor = i;
+    }
+    if (!PutToken(out, &n, room, &in[anchor], length - anchor, 0, 0))
+	return -1;
+    return n;
+}
+
+//----------------------------------------------------------------------
+// GetLength
+// 	Add the rest of a length whose field in the token was 15, from
+//	"in" at *n, to *value.  Return FALSE if "in" ends first.
+//----------------------------------------------------------------------
+
+static bool
+GetLength(unsigned char *in, int *n, int length, int *value)
+{
+    int byte;
+
+    do {
+	if (*n >= length)
+	    return FALSE;
+	byte = in[(*n)++];
+	*value += byte;
+    } while (byte == 255);
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// LzDecompress
+// 	Decompress the "length" bytes at "from" into "to".  Return TRUE
+//	if they decompress into exactly "rawLength" bytes; FALSE if they
+//	are not a compressed block of that many (and "to" may then hold
+//	anything).
+//----------------------------------------------------------------------
+
+bool
+LzDecompress(char *from, int length, char *to, int rawLength)
+{
+    unsigned char *in = (unsigned char *) from;
+    unsigned char *out = (unsigned char *) to;
+    int n = 0, done = 0;
+
+    for (;;) {
+	int token, numLiterals, offset, matchLength;
+
+	if (n >= length)
+	    return FALSE;
+	token = in[n++];
+	numLiterals = token >> 4;
+	if (numLiterals == 15 && !GetLength(in, &n, length, &numLiterals))
+	    return FALSE;
+	if (n + numLiterals > length || done + numLiterals > rawLength)
+	    return FALSE;
+	memcpy(&out[done], &in[n], numLiterals);
+	n += numLiterals;
+	done += numLiterals;
+	if (n == length)
+	    return done == rawLength;	// the last token
+	if (n + 2 > length)
+	    return FALSE;
+	offset = in[n] | (in[n + 1] << 8);
+	n += 2;
+	matchLength = token & 0xf;
+	if (matchLength == 15 && !GetLength(in, &n, length, &matchLength))
+	    return FALSE;
+	matchLength += LzMinMatch;
+	if (offset == 0 || offset > done || done + matchLength > rawLength)
+	    return FALSE;
+	for (int i = 0; i < matchLength; i++, done++)	// may overlap
+	    out[done] = out[done - offset];
+    }
+}
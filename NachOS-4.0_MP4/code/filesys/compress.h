@@ -0,0 +1,40 @@
+// compress.h
+//	Compressing a chunk of a file's data, for files kept compressed
+//	(see filehdr.h).
+//
+//	The format is that of an LZ4 block: a sequence of tokens, each
+//	a run of literal bytes followed by a match -- a copy of bytes
+//	already decompressed, up to LzMaxOffset back.  A token's first
+//	byte holds the number of literals in its high four bits and the
+//	match length, less LzMinMatch, in its low four; a field of 15
+//	goes on in the bytes after it (each added, until one is not 255).
+//	Then come the literals, the match's distance back in two bytes,
+//	low byte first, and the rest of the match length.  The last
+//	token has only literals, and ends the block.
+//
+//	Matches are found greedily, through a table of where each hash
+//	of LzMinMatch bytes was last seen.  That is fast, and on text
+//	like the num_*.txt files finds almost everything there is.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#ifndef COMPRESS_H
+#define COMPRESS_H
+
+#include "copyright.h"
+
+#define LzMinMatch	4		// shortest match worth a token
+#define LzMaxOffset	65535		// farthest back a match can be
+#define LzHashBits	12		// log2 of the size of the match table
+
+extern int LzCompress(char *from, int length, char *to, int room);
+					// Compress "length" bytes into at
+					// most "room"; return how many that
+					// took, or -1 if they didn't fit
+extern bool LzDecompress(char *from, int length, char *to, int rawLength);
+					// Undo it; FALSE unless exactly
+					// "rawLength" bytes come out
+
+#endif // COMPRESS_H
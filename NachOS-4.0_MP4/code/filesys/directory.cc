@@ -1,52 +1,166 @@
-// directory.cc 
+// directory.cc
 //	Routines to manage a directory of file names.
 //
-//	The directory is a table of fixed length entries; each
-//	entry represents a single file, and contains the file name,
-//	and the location of the file header on disk.  The fixed size
-//	of each directory entry means that we have the restriction
-//	of a fixed maximum size for file names.
+//	The directory is a B+tree of entries, in order of the hashes of
+//	their names; each entry represents a single file, and contains
+//	the file name, and the location of the file header on disk.  An
+//	entry takes only the room its name needs, up to the maximum size
+//	for file names, FileNameMaxLen.
 //
-//	The constructor initializes an empty directory of a certain size;
-//	we use ReadFrom/WriteBack to fetch the contents of the directory
-//	from disk, and to write back any modifications back to disk.
+//	The constructor initializes an empty directory; we use FetchFrom
+//	to start using the directory on disk instead, and WriteBack to
+//	write back any modifications to disk.  Nodes are read from the
+//	directory file only when an operation reaches them, and written
+//	back only if they were changed, so that an operation on a large
+//	directory costs no more than the height of its tree.
 //
-//	Also, this implementation has the restriction that the size
-//	of the directory cannot expand.  In other words, once all the
-//	entries in the directory are used, no more files can be created.
+//	A node that fills up is split in two, adding a key to its parent
+//	(and, when the root splits, a new root), so the tree always has
+//	all its leaves at the same depth.  Removing a name never merges
+//	nodes: a leaf left empty stays in the tree, to take later names
+//	in its range, so the tree is as deep as the directory ever was
+//	at its largest.
 //
 // Copyright (c) 1992-1993 The Regents of the University of California.
-// All rights reserved.  See copyright.h for copyright notice and limitation 
+// All rights reserved.  See copyright.h for copyright notice and limitation
 // of liability and disclaimer of warranty provisions.
 
 #include "copyright.h"
 #include "utility.h"
+#include "debug.h"
 #include "filehdr.h"
 #include "directory.h"
+#include "pool.h"
+
+static Pool directoryPool("Directory", sizeof(Directory));
+static Pool nodePool("DirNode", sizeof(DirNode));
+
+// Names compare on their first FileNameMaxLen characters only.  The
+// entries are kept in order of the hash of their names, and then of
+// the names.
+
+static unsigned
+HashName(char *name)
+{
+    unsigned h = 0;
+
+    for (int i = 0; i < FileNameMaxLen && name[i] != '\0'; i++)
+	h = h * 31 + (unsigned char) name[i];
+    return h;
+}
+
+static int
+CompareEntry(unsigned hash, char *name, DirectoryEntry *entry)
+{
+    if (hash != entry->hash)
+	return (hash < entry->hash) ? -1 : 1;
+    return strncmp(name, entry->name, FileNameMaxLen);
+}
+
+//----------------------------------------------------------------------
+// EntrySize, PackedSize
+// 	The number of bytes entry "e", or the "count" entries in
+//	"entries", take up in a leaf.
+//----------------------------------------------------------------------
+
+static int
+EntrySize(DirectoryEntry *e)
+{
+    return DirRecordHead + strlen(e->name);
+}
+
+static int
+PackedSize(DirectoryEntry *entries, int count)
+{
+    int size = 0;
+
+    for (int i = 0; i < count; i++)
+	size += EntrySize(&entries[i]);
+    return size;
+}
+
+//----------------------------------------------------------------------
+// UnpackLeaf
+// 	Copy the entries packed in "leaf" out into "entries" (which has
+//	room for DirLeafMax), and return how many there are.
+//----------------------------------------------------------------------
+
+static int
+UnpackLeaf(DirNode *leaf, DirectoryEntry *entries)
+{
+    char *p = leaf->data;
+
+    ASSERT(leaf->isLeaf && leaf->count <= DirLeafMax);
+    for (int i = 0; i < leaf->count; i++) {
+	DirectoryEntry *e = &entries[i];
+	int length = (unsigned char) p[3 * sizeof(int) + 2];
+
+	ASSERT(length <= FileNameMaxLen);
+	bcopy(p, (char *)&e->hash, sizeof(int));
+	bcopy(p + sizeof(int), (char *)&e->sector, sizeof(int));
+	bcopy(p + 2 * sizeof(int), (char *)&e->size, sizeof(int));
+	e->type = p[3 * sizeof(int)];
+	e->attributes = (unsigned char) p[3 * sizeof(int) + 1];
+	bcopy(p + DirRecordHead, e->name, length);
+	e->name[length] = '\0';
+	p += DirRecordHead + length;
+    }
+    return leaf->count;
+}
+
+//----------------------------------------------------------------------
+// PackLeaf
+// 	Pack the "count" entries in "entries" into "leaf".  Return FALSE,
+//	leaving the leaf alone, if they don't fit.
+//----------------------------------------------------------------------
+
+static bool
+PackLeaf(DirectoryEntry *entries, int count, DirNode *leaf)
+{
+    char *p = leaf->data;
+
+    if (count > DirLeafMax || PackedSize(entries, count) > DirNodeData)
+	return FALSE;
+    for (int i = 0; i < count; i++) {
+	DirectoryEntry *e = &entries[i];
+	int length = strlen(e->name);
+
+	bcopy((char *)&e->hash, p, sizeof(int));
+	bcopy((char *)&e->sector, p + sizeof(int), sizeof(int));
+	bcopy((char *)&e->size, p + 2 * sizeof(int), sizeof(int));
+	p[3 * sizeof(int)] = e->type;
+	p[3 * sizeof(int) + 1] = e->attributes;
+	p[3 * sizeof(int) + 2] = length;
+	bcopy(e->name, p + DirRecordHead, length);
+	p += DirRecordHead + length;
+    }
+    leaf->count = count;
+    return TRUE;
+}
 
 //----------------------------------------------------------------------
 // Directory::Directory
 // 	Initialize a directory; initially, the directory is completely
-//	empty.  If the disk is being formatted, an empty directory
-//	is all we need, but otherwise, we need to call FetchFrom in order
-//	to initialize it from disk.
-//
-//	"size" is the number of entries in the directory
+//	empty: a tree with only its (empty) root leaf.  If the disk is
+//	being formatted, or a directory is being created, an empty
+//	directory is all we need, but otherwise, we need to call
+//	FetchFrom in order to use the one on disk.
 //----------------------------------------------------------------------
 
-Directory::Directory(int size)
+Directory::Directory()
 {
-    table = new DirectoryEntry[size];
-	
-	// MP4 mod tag
-	memset(table, 0, sizeof(DirectoryEntry) * size);  // dummy operation to keep valgrind happy
-	
-    tableSize = size;
-    for (int i = 0; i < tableSize; i++) {
-		table[i].inUse = FALSE;
-		table[i].isDir = FALSE;
-	}
-		
+    ASSERT(sizeof(DirNode) <= SectorSize && sizeof(DirHeader) <= SectorSize);
+    file = NULL;
+    nodes = smallNodes;			// until it needs more
+    dirty = smallDirty;
+    capacity = DirSmallNodes;
+    for (int i = 0; i < capacity; i++) {
+	nodes[i] = NULL;
+	dirty[i] = FALSE;
+    }
+    header.magic = DirMagic;
+    header.numNodes = 1;		// just the header
+    header.root = NewNode(TRUE);
 }
 
 //----------------------------------------------------------------------
@@ -55,13 +169,55 @@ Directory::Directory(int size)
 //----------------------------------------------------------------------
 
 Directory::~Directory()
-{ 
-    delete [] table;
-} 
+{
+    Discard();
+    if (nodes != smallNodes) {
+	delete [] nodes;
+	delete [] dirty;
+    }
+}
+
+//----------------------------------------------------------------------
+// Directory::operator new, Directory::operator delete
+// 	Take the memory for a directory from the pool of them, and give it
+//	back (see pool.h).
+//----------------------------------------------------------------------
+
+void *
+Directory::operator new(size_t size)
+{
+    return directoryPool.Alloc(size);
+}
+
+void
+Directory::operator delete(void *p)
+{
+    directoryPool.Free(p);
+}
+
+//----------------------------------------------------------------------
+// DirNode::operator new, DirNode::operator delete
+// 	Take the memory for a node of a directory's tree from the pool
+//	of them, and give it back (see pool.h).
+//----------------------------------------------------------------------
+
+void *
+DirNode::operator new(size_t size)
+{
+    return nodePool.Alloc(size);
+}
+
+void
+DirNode::operator delete(void *p)
+{
+    nodePool.Free(p);
+}
 
 //----------------------------------------------------------------------
 // Directory::FetchFrom
-// 	Read the contents of the directory from disk.
+// 	Start using the directory on disk: read the header of its tree,
+//	leaving the nodes to be read as they are needed.  Anything read
+//	or changed before is forgotten.
 //
 //	"file" -- file containing the directory contents
 //----------------------------------------------------------------------
@@ -69,43 +225,164 @@ Directory::~Directory()
 void
 Directory::FetchFrom(OpenFile *file)
 {
-    (void) file->ReadAt((char *)table, tableSize * sizeof(DirectoryEntry), 0);
+    Discard();
+    this->file = file;
+    (void) file->ReadAt((char *)&header, sizeof(DirHeader), 0);
+    ASSERT(header.magic == DirMagic);
+    Grow(header.numNodes);
 }
 
 //----------------------------------------------------------------------
 // Directory::WriteBack
-// 	Write any modifications to the directory back to disk
+// 	Write the nodes that have been changed back to disk, and the
+//	header of the tree if it changed.  Return FALSE if the disk is
+//	too full to grow the directory file for its new nodes; nothing
+//	else is written then, so the directory on disk is as it was.
 //
 //	"file" -- file to contain the new directory contents
 //----------------------------------------------------------------------
 
-void
+bool
 Directory::WriteBack(OpenFile *file)
 {
-    (void) file->WriteAt((char *)table, tableSize * sizeof(DirectoryEntry), 0);
+    int firstNew = divRoundUp(file->Length(), SectorSize);
+    int n;
+
+    this->file = file;
+    for (n = max(firstNew, 1); n < header.numNodes; n++)	// new nodes first
+	if (dirty[n] && file->WriteAt((char *)nodes[n], sizeof(DirNode),
+				n * SectorSize) < (int) sizeof(DirNode))
+	    return FALSE;
+    for (n = 1; n < header.numNodes; n++) {
+	if (dirty[n] && n < firstNew)
+	    (void) file->WriteAt((char *)nodes[n], sizeof(DirNode),
+				n * SectorSize);
+	dirty[n] = FALSE;
+    }
+    if (dirty[0])
+	(void) file->WriteAt((char *)&header, sizeof(DirHeader), 0);
+    dirty[0] = FALSE;
+    return TRUE;
 }
 
 //----------------------------------------------------------------------
-// Directory::FindIndex
-// 	Look up file name in directory, and return its location in the table of
-//	directory entries.  Return -1 if the name isn't in the directory.
+// Directory::GetNode
+// 	Return node "n" of the tree, reading it from the directory file
+//	if it hasn't been yet.
+//----------------------------------------------------------------------
+
+DirNode *
+Directory::GetNode(int n)
+{
+    ASSERT(n > 0 && n < header.numNodes);
+    if (nodes[n] == NULL) {
+	ASSERT(file != NULL);
+	nodes[n] = new DirNode;
+	(void) file->ReadAt((char *)nodes[n], sizeof(DirNode), n * SectorSize);
+    }
+    return nodes[n];
+}
+
+//----------------------------------------------------------------------
+// Directory::NewNode
+// 	Add an empty node to the end of the directory file, and return
+//	its number.  It is written back with the rest.
 //
-//	"name" -- the file name to look up
+//	"isLeaf" -- will the node hold entries, or children?
 //----------------------------------------------------------------------
 
 int
-Directory::FindIndex(char *name)
+Directory::NewNode(bool isLeaf)
 {
-    for (int i = 0; i < tableSize; i++)
-        if (table[i].inUse && !strncmp(table[i].name, name, FileNameMaxLen))
-	    return i;
-    return -1;		// name not in directory
+    int n = header.numNodes++;
+
+    Grow(header.numNodes);
+    nodes[n] = new DirNode;
+    bzero((char *)nodes[n], sizeof(DirNode));
+    nodes[n]->isLeaf = isLeaf;
+    nodes[n]->count = 0;
+    nodes[n]->next = -1;
+    dirty[n] = TRUE;
+    dirty[0] = TRUE;			// numNodes changed
+    return n;
+}
+
+//----------------------------------------------------------------------
+// Directory::Grow
+// 	Make room in memory for the first "size" nodes of the tree.  A
+//	small directory makes do with the arrays in the Directory itself.
+//----------------------------------------------------------------------
+
+void
+Directory::Grow(int size)
+{
+    if (size <= capacity)
+	return;
+
+    int newCapacity = max(size, 2 * capacity);
+    DirNode **newNodes = new DirNode *[newCapacity];
+    bool *newDirty = new bool[newCapacity];
+
+    for (int i = 0; i < newCapacity; i++) {
+	newNodes[i] = (i < capacity) ? nodes[i] : NULL;
+	newDirty[i] = (i < capacity) ? dirty[i] : FALSE;
+    }
+    if (nodes != smallNodes) {
+	delete [] nodes;
+	delete [] dirty;
+    }
+    nodes = newNodes;
+    dirty = newDirty;
+    capacity = newCapacity;
+}
+
+//----------------------------------------------------------------------
+// Directory::Discard
+// 	Forget every node read or changed so far.
+//----------------------------------------------------------------------
+
+void
+Directory::Discard()
+{
+    for (int i = 0; i < capacity; i++) {
+	delete nodes[i];
+	nodes[i] = NULL;
+	dirty[i] = FALSE;
+    }
+}
+
+//----------------------------------------------------------------------
+// Directory::FindLeaf
+// 	Return the leaf that holds the names with hash value "hash", or
+//	would if there were any in the directory.  The interior nodes on
+//	the way down to it, from the root, are left in "path", and how
+//	many there are in "depth".
+//----------------------------------------------------------------------
+
+int
+Directory::FindLeaf(unsigned hash, int *path, int *depth)
+{
+    int n = header.root;
+    DirNode *node = GetNode(n);
+
+    *depth = 0;
+    while (!node->isLeaf) {
+	int i = 0;
+
+	ASSERT(*depth < MaxDirHeight);
+	path[(*depth)++] = n;
+	while (i < node->count && hash >= node->branch.key[i])
+	    i++;
+	n = node->branch.child[i];
+	node = GetNode(n);
+    }
+    return n;
 }
 
 //----------------------------------------------------------------------
 // Directory::Find
 // 	Look up file name in directory, and return the disk sector number
-//	where the file's header is stored. Return -1 if the name isn't 
+//	where the file's header is stored. Return -1 if the name isn't
 //	in the directory.
 //
 //	"name" -- the file name to look up
@@ -114,173 +391,341 @@ Directory::FindIndex(char *name)
 int
 Directory::Find(char *name)
 {
-    int i = FindIndex(name);
+    DirectoryEntry entry;
 
-    if (i != -1)
-	return table[i].sector;
-    return -1;
+    if (FindEntry(name, &entry))
+	return entry.sector;
+    return -1;		// name not in directory
+}
+
+//----------------------------------------------------------------------
+// Directory::FindEntry
+// 	Look up file name in directory, and copy its entry into "entry".
+//	Return FALSE if the name isn't in the directory.
+//
+//	"name" -- the file name to look up
+//----------------------------------------------------------------------
+
+bool
+Directory::FindEntry(char *name, DirectoryEntry *entry)
+{
+    int path[MaxDirHeight], depth;
+    unsigned hash = HashName(name);
+    DirectoryEntry entries[DirLeafMax];
+    int count = UnpackLeaf(GetNode(FindLeaf(hash, path, &depth)), entries);
+
+    for (int i = 0; i < count; i++)
+	if (entries[i].hash == hash
+		&& strncmp(entries[i].name, name, FileNameMaxLen) == 0) {
+	    *entry = entries[i];
+	    return TRUE;
+	}
+    return FALSE;
 }
 
 //----------------------------------------------------------------------
 // Directory::Add
 // 	Add a file into the directory.  Return TRUE if successful;
 //	return FALSE if the file name is already in the directory, or if
-//	the directory is completely full, and has no more space for
-//	additional file names.
+//	the directory file has grown as large as a file can be.
+//
+//	If it doesn't fit in its leaf, the leaf is split in two, between
+//	two names with different hashes, and the first hash in the new
+//	one is added to the parent as a key.  (So a leaf full of names
+//	with the same hash can't take another one; that fails too.)
 //
 //	"name" -- the name of the file being added
 //	"newSector" -- the disk sector containing the added file's header
+//	"type" -- FileType or DirType
+//	"size", "attributes" -- what the header says of the file
 //----------------------------------------------------------------------
 
 bool
-Directory::Add(char *name, int newSector, bool isDir)
-{ 
-    if (FindIndex(name) != -1)
-	return FALSE;
-
-    for (int i = 0; i < tableSize; i++)
-        if (!table[i].inUse) {
-            table[i].inUse = TRUE;
-			table[i].isDir = isDir;
-            strncpy(table[i].name, name, FileNameMaxLen); 
-            table[i].sector = newSector;
-        return TRUE;
+Directory::Add(char *name, int newSector, EntryType type, int size,
+		int attributes)
+{
+    int path[MaxDirHeight], depth;
+    unsigned hash = HashName(name);
+    int n = FindLeaf(hash, path, &depth);
+    DirNode *leaf = GetNode(n);
+    DirectoryEntry entries[DirLeafMax + 1];
+    int count = UnpackLeaf(leaf, entries);
+    int i, j;
+
+    for (i = 0; i < count; i++) {
+	int cmp = CompareEntry(hash, name, &entries[i]);
+
+	if (cmp == 0)
+	    return FALSE;		// already there
+	if (cmp < 0)
+	    break;
+    }
+    if (header.numNodes + depth + 2 > MaxFileSectors)
+	return FALSE;			// no room to split all the way up
+
+    for (j = count; j > i; j--)
+	entries[j] = entries[j - 1];
+    bzero((char *)&entries[i], sizeof(DirectoryEntry));
+    strncpy(entries[i].name, name, FileNameMaxLen);
+    entries[i].type = type;
+    entries[i].attributes = attributes;
+    entries[i].size = size;
+    entries[i].sector = newSector;
+    entries[i].hash = hash;
+    count++;
+    if (PackLeaf(entries, count, leaf)) {
+	dirty[n] = TRUE;
+	return TRUE;
+    }
+
+    int split = -1, best = 0;
+    int total = PackedSize(entries, count), left = 0;
+
+    for (int s = 1; s < count; s++) {
+	int diff;
+
+	left += EntrySize(&entries[s - 1]);
+	if (entries[s - 1].hash == entries[s].hash)
+	    continue;			// they must stay in one leaf
+	if (s > DirLeafMax || count - s > DirLeafMax
+		|| left > DirNodeData || total - left > DirNodeData)
+	    continue;
+	diff = (2 * left > total) ? 2 * left - total : total - 2 * left;
+	if (split == -1 || diff < best) {
+	    split = s;
+	    best = diff;
 	}
-    return FALSE;	// no space.  Fix when we have extensible files.
+    }
+    if (split == -1)
+	return FALSE;			// too many names with one hash
+
+    int right = NewNode(TRUE);
+    DirNode *rightLeaf = GetNode(right);
+    bool packed;
+
+    DEBUG(dbgFile, "Splitting directory leaf " << n << " into " << right);
+    packed = PackLeaf(entries, split, leaf)
+		&& PackLeaf(&entries[split], count - split, rightLeaf);
+    ASSERT(packed);
+    rightLeaf->next = leaf->next;
+    leaf->next = right;
+    dirty[n] = TRUE;
+    InsertKey(path, depth, entries[split].hash, right);
+    return TRUE;
 }
 
 //----------------------------------------------------------------------
-// Directory::Remove
-// 	Remove a file name from the directory.  Return TRUE if successful;
-//	return FALSE if the file isn't in the directory. 
-//
-//	"name" -- the file name to be removed
+// Directory::InsertKey
+// 	A node below path[depth - 1] has split: add "key", the first hash
+//	in the new node "child", to it, with "child" to the right of the
+//	key.  If it is full, split it too, moving its middle key up to
+//	its own parent.  If it is the root (depth is 0), make a new root
+//	over the two halves.
 //----------------------------------------------------------------------
 
-bool
-Directory::Remove(char *name)
-{ 
-    int i = FindIndex(name);
-
-    if (i == -1)
-	return FALSE; 		// name not in directory
-    table[i].inUse = FALSE;
-	table[i].isDir = FALSE;
-    return TRUE;	
+void
+Directory::InsertKey(int *path, int depth, unsigned key, int child)
+{
+    if (depth == 0) {
+	int oldRoot = header.root;
+	int r = NewNode(FALSE);
+	DirNode *root = GetNode(r);
+
+	root->count = 1;
+	root->branch.child[0] = oldRoot;
+	root->branch.child[1] = child;
+	root->branch.key[0] = key;
+	header.root = r;
+	return;
+    }
+
+    int n = path[depth - 1];
+    DirNode *node = GetNode(n);
+    unsigned keys[DirFanout];
+    int children[DirFanout + 1];
+    int i, total;
+
+    for (i = 0; i < node->count; i++)
+	if (key < node->branch.key[i])
+	    break;
+    total = node->count + 1;
+    for (int j = 0, k = 0; j < total; j++)
+	keys[j] = (j == i) ? key : node->branch.key[k++];
+    for (int j = 0, k = 0; j <= total; j++)
+	children[j] = (j == i + 1) ? child : node->branch.child[k++];
+    dirty[n] = TRUE;
+
+    if (total <= DirFanout - 1) {
+	bcopy((char *)keys, (char *)node->branch.key, sizeof(unsigned) * total);
+	bcopy((char *)children, (char *)node->branch.child,
+			sizeof(int) * (total + 1));
+	node->count = total;
+	return;
+    }
+
+    int mid = total / 2;
+    int right = NewNode(FALSE);
+    DirNode *rightNode = GetNode(right);
+
+    DEBUG(dbgFile, "Splitting directory node " << n << " into " << right);
+    node->count = mid;
+    bcopy((char *)keys, (char *)node->branch.key, sizeof(unsigned) * mid);
+    bcopy((char *)children, (char *)node->branch.child, sizeof(int) * (mid + 1));
+    rightNode->count = total - mid - 1;
+    bcopy((char *)&keys[mid + 1], (char *)rightNode->branch.key,
+		sizeof(unsigned) * rightNode->count);
+    bcopy((char *)&children[mid + 1], (char *)rightNode->branch.child,
+		sizeof(int) * (rightNode->count + 1));
+    InsertKey(path, depth - 1, keys[mid], right);
 }
 
 //----------------------------------------------------------------------
-// Directory::List
-// 	List all the file names in the directory. 
+// Directory::SetSize
+// 	Record a new size and attributes in the entry for "name".  The
+//	entry takes the same room in its leaf as before, so this only
+//	repacks the leaf.  Return FALSE if the name isn't in the directory,
+//	or names some other file than the one with its header at "sector".
 //----------------------------------------------------------------------
 
-void
-Directory::List()
+bool
+Directory::SetSize(char *name, int sector, int size, int attributes)
 {
-   for (int i = 0; i < tableSize; i++) {
-	   if (table[i].inUse) {
-		   if(!table[i].isDir) {
-			   printf("%s %s\n", table[i].name, "[F]");
-			   
-		   } else {
-			   printf("%s %s\n", table[i].name, "[D]");
-		   }
-	   }
-   }
+    int path[MaxDirHeight], depth;
+    unsigned hash = HashName(name);
+    int n = FindLeaf(hash, path, &depth);
+    DirNode *leaf = GetNode(n);
+    DirectoryEntry entries[DirLeafMax];
+    int count = UnpackLeaf(leaf, entries);
+
+    for (int i = 0; i < count; i++)
+	if (CompareEntry(hash, name, &entries[i]) == 0) {
+	    bool packed;
+
+	    if (entries[i].sector != sector)
+		return FALSE;		// removed, and the name reused
+	    if (entries[i].size == size && entries[i].attributes == attributes)
+		return TRUE;		// already up to date
+	    entries[i].size = size;
+	    entries[i].attributes = attributes;
+	    packed = PackLeaf(entries, count, leaf);
+	    ASSERT(packed);
+	    dirty[n] = TRUE;
+	    return TRUE;
+	}
+    return FALSE;		// name not in directory
 }
 
 //----------------------------------------------------------------------
-// Directory::Print
-// 	List all the file names in the directory, their FileHeader locations,
-//	and the contents of each file.  For debugging.
+// Directory::Remove
+// 	Remove a file name from the directory.  Return TRUE if successful;
+//	return FALSE if the file isn't in the directory.
+//
+//	"name" -- the file name to be removed
 //----------------------------------------------------------------------
 
-void
-Directory::Print()
-{ 
-    FileHeader *hdr = new FileHeader;
-
-    printf("Directory contents:\n");
-    for (int i = 0; i < tableSize; i++)
-	if (table[i].inUse) {
-	    printf("Name: %s, Sector: %d\n", table[i].name, table[i].sector);
-	    hdr->FetchFrom(table[i].sector);
-	    hdr->Print();
+bool
+Directory::Remove(char *name)
+{
+    int path[MaxDirHeight], depth;
+    unsigned hash = HashName(name);
+    int n = FindLeaf(hash, path, &depth);
+    DirNode *leaf = GetNode(n);
+    DirectoryEntry entries[DirLeafMax];
+    int count = UnpackLeaf(leaf, entries);
+
+    for (int i = 0; i < count; i++)
+	if (CompareEntry(hash, name, &entries[i]) == 0) {
+	    bool packed;
+
+	    for (int j = i; j < count - 1; j++)
+		entries[j] = entries[j + 1];
+	    packed = PackLeaf(entries, count - 1, leaf);
+	    ASSERT(packed);
+	    dirty[n] = TRUE;
+	    return TRUE;
 	}
-    printf("\n");
-    delete hdr;
+    return FALSE; 		// name not in directory
 }
 
-
 //----------------------------------------------------------------------
-// Directory::RecurList
-// 	Recursively list all the file names in the directory. 
+// Directory::Next
+// 	Copy the entry following the name "after" into "entry", or the
+//	first entry of all if "after" is NULL.  Return FALSE if there is
+//	none.  Walking the directory this way visits each name once (in
+//	order of their hashes), and a name need not still be there to go
+//	on from it.
 //----------------------------------------------------------------------
 
-void
-Directory::RecurList(int indent_level)
+bool
+Directory::Next(char *after, DirectoryEntry *entry)
 {
-	Directory *directory;
-	OpenFile *openDirectoryFile;
-	int count = 0;
-	
-   for (int i = 0; i < tableSize; i++) {
-	   if (table[i].inUse) {
-		   count++;
-		   
-		   if(!table[i].isDir) {
-			   printf("%*s %s\n", 2*indent_level + strlen(table[i].name), table[i].name, "[F]");
-			   
-		   } else {
-			   printf("%*s %s\n", 2*indent_level + strlen(table[i].name), table[i].name, "[D]");
-			   openDirectoryFile = new OpenFile(table[i].sector);
-			   directory = new Directory(64);
-			   directory->FetchFrom(openDirectoryFile);
-			   
-			   directory->RecurList(indent_level + 1);
-			   
-			   
-			   delete directory;
-			   delete openDirectoryFile;
-		   }
-	   }
-   }
-	if(count == 0) {
-		printf("%*s\n", 2*indent_level + strlen("Empty Folder"), "Empty Folder");
+    int path[MaxDirHeight], depth;
+    DirectoryEntry entries[DirLeafMax];
+    int n, i = 0, count;
+
+    if (after == NULL) {
+	for (n = header.root; !GetNode(n)->isLeaf; )
+	    n = GetNode(n)->branch.child[0];
+    } else {
+	unsigned hash = HashName(after);
+
+	n = FindLeaf(hash, path, &depth);
+	count = UnpackLeaf(GetNode(n), entries);
+	while (i < count && CompareEntry(hash, after, &entries[i]) >= 0)
+	    i++;
+    }
+    for (;;) {
+	DirNode *node = GetNode(n);
+
+	count = UnpackLeaf(node, entries);
+	if (i < count) {
+	    *entry = entries[i];
+	    return TRUE;
 	}
+	if (node->next == -1)
+	    return FALSE;
+	n = node->next;
+	i = 0;
+    }
 }
 
 //----------------------------------------------------------------------
-// Directory::FindSector
-// 	Look up file name in directory, and return the disk sector number
-//	where the file's header is stored. Return -1 if the name isn't 
-//	in the directory.
-//
-//	"index" -- the file index to look up
+// Directory::List
+// 	List all the file names in the directory, and if "sizes", the
+//	size of each file, as its entry has it.
 //----------------------------------------------------------------------
 
-int
-Directory::FindSector(int index)
+void
+Directory::List(bool sizes)
 {
-    if (table[index].sector != -1 && index < tableSize)
-	return table[index].sector;
+    DirectoryEntry entry;
 
-    return -1;
+    for (bool more = Next(NULL, &entry); more; more = Next(entry.name, &entry))
+	if (sizes && entry.type == FileType)
+	    printf("%s [F] %d\n", entry.name, entry.size);
+	else
+	    printf("%s %s\n", entry.name, (entry.type == DirType) ? "[D]" : "[F]");
 }
 
 //----------------------------------------------------------------------
-// Directory::isDirectory
-// 	Look up for the index in table
-//	If the entry is a directory return true to show that it is a directory
-//	Else return false to represent it is a file
-//
-//	"index" -- the file index to look up
+// Directory::Print
+// 	List all the file names in the directory, their FileHeader locations,
+//	and the contents of each file.  For debugging.
 //----------------------------------------------------------------------
-bool
-Directory::isDirectory(int index)
+
+void
+Directory::Print()
 {
-	if(index < tableSize) {
-		return table[index].isDir;
-	}
-	return FALSE;
-}
\ No newline at end of file
+    FileHeader *hdr = new FileHeader;
+    DirectoryEntry entry;
+
+    printf("Directory contents (%d nodes):\n", header.numNodes - 1);
+    for (bool more = Next(NULL, &entry); more; more = Next(entry.name, &entry)) {
+	printf("Name: %s, Sector: %d\n", entry.name, entry.sector);
+	hdr->FetchFrom(entry.sector);
+	hdr->Print();
+    }
+    printf("\n");
+    delete hdr;
+}
+
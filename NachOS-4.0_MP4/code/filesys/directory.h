@@ -1,15 +1,35 @@
-// directory.h 
+// directory.h
 //	Data structures to manage a UNIX-like directory of file names.
-// 
+//
 //      A directory is a table of pairs: <file name, sector #>,
-//	giving the name of each file in the directory, and 
+//	giving the name of each file in the directory, and
 //	where to find its file header (the data structure describing
 //	where to find the file's data blocks) on disk.
 //
+//	On disk, the table is a B+tree, one node per sector of the
+//	directory file, kept in order of a hash of the names (and of the
+//	names, among those with the same hash).  Sector 0 of the file
+//	says where the root is; the entries themselves are in the leaves,
+//	which are linked in order, and the interior nodes hold the hash
+//	values that divide them.  So looking up, adding or removing a name
+//	reads and writes only the nodes on one path from the root to a
+//	leaf, however many files the directory holds.
+//
+//	An entry in a leaf takes only as much room as its name needs: its
+//	hash, header sector, size, type, attributes and name length, then
+//	the name itself.  A lookup compares the hashes first, and only the
+//	names of the entries whose hash matches.
+//
+//	The size and attributes of a file are copies of what its header
+//	says, so that a listing can show them reading only the directory,
+//	not a header per file.  The header is still what counts: the copy
+//	is brought up to date when a file whose size changed is closed or
+//	synced (see OpenFile::SyncEntry).
+//
 //      We assume mutual exclusion is provided by the caller.
 //
 // Copyright (c) 1992-1993 The Regents of the University of California.
-// All rights reserved.  See copyright.h for copyright notice and limitation 
+// All rights reserved.  See copyright.h for copyright notice and limitation
 // of liability and disclaimer of warranty provisions.
 
 #include "copyright.h"
@@ -18,25 +38,96 @@
 #define DIRECTORY_H
 
 #include "openfile.h"
+#include "disk.h"
+
+#define FileNameMaxLen 		32	// for simplicity, we assume
+					// file names are <= 32 characters long
+
+#define DirMagic		0x44495253	// marks a directory file, with
+					// sizes in its entries
+#define DirectoryFileSize	(2 * SectorSize)
+					// a new directory: its tree header
+					// and an empty root; it grows a
+					// sector at a time as nodes split
+#define MaxDirHeight		8	// deeper than a directory the size
+					// of the disk can grow
+#define DirSmallNodes		16	// nodes a Directory has room for
+					// before allocating arrays
+
+// What an entry names
 
-#define FileNameMaxLen 		9	// for simplicity, we assume 
-					// file names are <= 9 characters long
+enum EntryType { FileType, DirType };
+
+// Attributes of a file, kept in its entry
+
+#define EntryInline	0x1		// its data is in its header
+#define EntryCompressed	0x2		// its data is compressed
 
 // The following class defines a "directory entry", representing a file
 // in the directory.  Each entry gives the name of the file, and where
 // the file's header is to be found on disk.
 //
 // Internal data structures kept public so that Directory operations can
-// access them directly.
+// access them directly.  On disk, an entry is packed into a leaf as
+// DirRecordHead bytes -- hash, sector, size, type, attributes and the
+// name's length -- followed by the name, without its '\0'.
 
 class DirectoryEntry {
   public:
-    bool inUse;				// Is this directory entry in use?
-	bool isDir;
-    int sector;				// Location on disk to find the 
-					//   FileHeader for this file 
-    char name[FileNameMaxLen + 1];	// Text name for file, with +1 for 
+    char name[FileNameMaxLen + 1];	// Text name for file, with +1 for
 					// the trailing '\0'
+    int type;				// FileType or DirType
+    int attributes;			// EntryInline, EntryCompressed, or 0
+    int size;				// bytes in the file, as of when it
+					// was last closed (0 for a directory)
+    int sector;				// Location on disk to find the
+					//   FileHeader for this file
+    unsigned hash;			// of the name
+};
+
+#define DirRecordHead	(3 * sizeof(int) + 3)
+#define DirNodeData	((int) (SectorSize - 3 * sizeof(int)))
+					// room for entries in a leaf
+#define DirLeafMax	((int) (DirNodeData / (DirRecordHead + 1)))
+					// most entries a leaf can hold
+#define DirFanout	((int) ((DirNodeData + sizeof(int)) / (2 * sizeof(int))))
+
+// The children of an interior node of the tree.  Names whose hash is
+// below key[i - 1] are under child[i - 1]; hashes from key[i - 1] up
+// to key[i] are under child[i].  All the names with the same hash are
+// in the same leaf.
+
+class DirBranch {
+  public:
+    int child[DirFanout];		// node numbers
+    unsigned key[DirFanout - 1];	// hash values
+};
+
+// A node of the tree: exactly one disk sector in size.
+
+class DirNode {
+  public:
+    static void *operator new(size_t size);	// from a pool of them,
+    static void operator delete(void *p);	// not the heap
+    int isLeaf;				// TRUE for a leaf
+    int count;				// entries in a leaf, or keys in an
+					// interior node (it has count + 1
+					// children)
+    int next;				// the leaf after this one, or -1
+    union {
+	char data[DirNodeData];		// a leaf's entries, packed, in order
+	DirBranch branch;		// an interior node's
+    };
+};
+
+// Sector 0 of a directory file: where its tree is.
+
+class DirHeader {
+  public:
+    int magic;				// DirMagic
+    int root;				// node number of the root
+    int numNodes;			// nodes in the file, counting this
+					// header as node 0
 };
 
 // The following class defines a UNIX-like "directory".  Each entry in
@@ -45,58 +136,74 @@ class DirectoryEntry {
 // The directory data structure can be stored in memory, or on disk.
 // When it is on disk, it is stored as a regular Nachos file.
 //
-// The constructor initializes a directory structure in memory; the
-// FetchFrom/WriteBack operations shuffle the directory information
-// from/to disk. 
+// The constructor initializes an (empty) directory structure in
+// memory.  FetchFrom starts using the directory in a file instead,
+// reading its nodes only as operations need them; WriteBack writes
+// the nodes that have been changed since.
 
 class Directory {
   public:
-    Directory(int size); 		// Initialize an empty directory
-					// with space for "size" files
+    Directory(); 			// Initialize an empty directory
     ~Directory();			// De-allocate the directory
+    static void *operator new(size_t size);	// from a pool of them,
+    static void operator delete(void *p);	// not the heap
 
     void FetchFrom(OpenFile *file);  	// Init directory contents from disk
-    void WriteBack(OpenFile *file);	// Write modifications to 
-					// directory contents back to disk
+    bool WriteBack(OpenFile *file);	// Write modifications to
+					// directory contents back to disk;
+					// FALSE if the disk is full
 
-    int Find(char *name);		// Find the sector number of the 
+    int Find(char *name);		// Find the sector number of the
 					// FileHeader for file: "name"
+    bool FindEntry(char *name, DirectoryEntry *entry);
+					// or its whole entry
 
-    bool Add(char *name, int newSector, bool inDir);  // Add a file name into the directory
+    bool Add(char *name, int newSector, EntryType type, int size = 0,
+		int attributes = 0);	// Add a file name into the directory
+    bool SetSize(char *name, int sector, int size, int attributes);
+					// Bring a file's entry up to date
+					// with its header
 
     bool Remove(char *name);		// Remove a file from the directory
 
-    void List();			// Print the names of all the files
-					//  in the directory
+    bool Next(char *after, DirectoryEntry *entry);
+					// The entry following the name
+					// "after" (or the first, if NULL)
+
+    void List(bool sizes = FALSE);	// Print the names of all the files
+					//  in the directory (and their
+					//  sizes, if "sizes")
     void Print();			// Verbose print of the contents
 					//  of the directory -- all the file
 					//  names and their contents.
-	void RecurList(int indent_level);
-	
-	bool isDirectory(int index);
-	int FindSector(int index);
-	char* getIndexName(int index) {
-		return table[index].name;
-	}
-	bool inUseIndex(int index) {
-		return table[index].inUse;
-	}
-  
+
   private:
-  
+
 	/*
 		MP4 Hint:
 		Directory is actually a "file", be careful of how it works with OpenFile and FileHdr.
-		Disk part: table
-		In-core part: tableSize
+		Disk part: header, and each node in "nodes"
+		In-core part: file, capacity, dirty
 	*/
-  
-    int tableSize;			// Number of directory entries
-    DirectoryEntry *table;		// Table of pairs: 
-					// <file name, file header location> 
 
-    int FindIndex(char *name);		// Find the index into the directory 
-					//  table corresponding to "name"
+    OpenFile *file;			// where the nodes not in memory are
+    DirHeader header;
+    DirNode **nodes;			// the nodes read so far, or NULL
+    bool *dirty;			// has each been changed?
+    int capacity;			// size of "nodes" and "dirty"
+    DirNode *smallNodes[DirSmallNodes];	// "nodes" and "dirty", while
+    bool smallDirty[DirSmallNodes];	// there are few enough
+
+    DirNode *GetNode(int n);		// Read node "n", if need be
+    int NewNode(bool isLeaf);		// Add a node to the tree
+    void Grow(int size);		// Make room for "size" nodes
+    void Discard();			// Forget the nodes read so far
+    int FindLeaf(unsigned hash, int *path, int *depth);
+					// The leaf names with "hash" belong
+					// in, and the interior nodes above it
+    void InsertKey(int *path, int depth, unsigned key, int child);
+					// Add a key and its right child to
+					// the interior node path[depth - 1]
 };
 
 #endif // DIRECTORY_H
@@ -28,6 +28,66 @@
 #include "debug.h"
 #include "synchdisk.h"
 #include "main.h"
+#include "hash.h"
+#include "imagecache.h"
+#include "pool.h"
+#include "memops.h"
+
+static Pool headerPool("FileHeader", sizeof(FileHeader));
+static Pool indirectPool("Indirect", sizeof(Indirect));
+
+// The in-core headers of the open files, by header sector.  Every
+// OpenFile of the same file shares one FileHeader.
+
+static HashTable<int, FileHeader *> *openHeaders = NULL;
+
+static int
+HeaderKey(FileHeader *hdr)
+{
+    return hdr->openSector;
+}
+
+static unsigned
+HashSector(int sector)
+{
+    return sector;
+}
+
+//----------------------------------------------------------------------
+// FileHeader::operator new, FileHeader::operator delete
+// 	Take the memory for a file header from the pool of them, and give it
+//	back (see pool.h).
+//----------------------------------------------------------------------
+
+void *
+FileHeader::operator new(size_t size)
+{
+    return headerPool.Alloc(size);
+}
+
+void
+FileHeader::operator delete(void *p)
+{
+    headerPool.Free(p);
+}
+
+//----------------------------------------------------------------------
+// Indirect::operator new, Indirect::operator delete
+// 	Take the memory for an index block from the pool of them, and give it
+//	back (see pool.h).
+//----------------------------------------------------------------------
+
+void *
+Indirect::operator new(size_t size)
+{
+    return indirectPool.Alloc(size);
+}
+
+void
+Indirect::operator delete(void *p)
+{
+    indirectPool.Free(p);
+}
 
 //----------------------------------------------------------------------
 // MP4 mod tag
@@ -40,79 +100,731 @@ FileHeader::FileHeader()
 {
 	numBytes = 0;
 	numSectors = 0;
+	numExtents = 0;			// mapped by extents, of which none yet
 	memset(dataSectors, -1, sizeof(dataSectors));
 	
 	// MP4
-	headerSector = -1;
+	clusterSize = 1;
+	flags = 0;
 	singleIndirectSector = -1;
 	doubleIndirectSector = -1;
+	
+	singleCache = NULL;
+	doubleCache = NULL;
+	for (int i = 0; i < NumIndirect; i++)
+		doubleChildCache[i] = NULL;
+	allocNext = -1;
+	allocWant = 0;
+	openSector = -1;
+	openCount = 0;
+	numAcquires = 0;
+	shared = FALSE;
+
+	// FetchFrom and WriteBack move the disk part, from numBytes
+	// on, as one sector; the in-core part must start after it
+	ASSERT((char *) &singleCache - (char *) &numBytes >= SectorSize);
 }
 
 //----------------------------------------------------------------------
 // MP4 mod tag
 // FileHeader::~FileHeader
-//	Currently, there is not need to do anything in destructor function.
-//	However, if you decide to add some "in-core" data in header
-//	Always remember to deallocate their space or you will leak memory
+//	Free the in-core copies of the index blocks.
 //----------------------------------------------------------------------
 FileHeader::~FileHeader()
 {
-	// nothing to do now
+	FlushIndirectCache();
 }
 
 //----------------------------------------------------------------------
 // MP4 mod tag
 // FileHeader::Initialize
-// Initialize the content of file header
+// Initialize the content of file header: an empty, uncompressed file,
+// with no sectors, and the same cluster size
 //----------------------------------------------------------------------
 void 
 FileHeader::Initialize()
 {
-	
+	FlushIndirectCache();
+	numBytes = 0;
+	numSectors = 0;
+	numExtents = 0;
+	flags = 0;
+	memset(dataSectors, -1, sizeof(dataSectors));
+	singleIndirectSector = -1;
+	doubleIndirectSector = -1;
+}
+
+//----------------------------------------------------------------------
+// FileHeader::SetClusterSize
+// 	Make the clusters of a new file, which has no sectors yet,
+//	"sectors" sectors long.
+//----------------------------------------------------------------------
+
+void
+FileHeader::SetClusterSize(int sectors)
+{
+	ASSERT(sectors >= 1 && sectors <= MaxClusterSize);
+	ASSERT(!IsInline() && numExtents == 0);
+	clusterSize = sectors;
+}
+
+//----------------------------------------------------------------------
+// FileHeader::NumClusters
+// 	Return how many clusters the file's length reaches into.
+//----------------------------------------------------------------------
+
+int
+FileHeader::NumClusters()
+{
+	if (IsInline())
+		return 0;
+	return divRoundUp(numSectors, ClusterSize());
 }
 
 //----------------------------------------------------------------------
 // FileHeader::Allocate
-// 	Initialize a fresh file header for a newly created file.
-//	Allocate data blocks for the file out of the map of free disk blocks.
+// 	Allocate data blocks for the first "fileSize" bytes of the file out
+//	of the map of free disk blocks, filling in any holes, and make the
+//	file at least that long.  Used for a newly created file (or
+//	directory) whose space must all be there from the start.
 //	Return FALSE if there are not enough free blocks to accomodate
-//	the new file.
+//	the file (or they are too scattered to make its clusters of);
+//	nothing is allocated then.  The file must have no sectors yet.
 //
 //	"freeMap" is the bit map of free disk sectors
 //	"fileSize" is the bit map of free disk sectors
+//	"near" is where the file's first new sector should go if it is
+//		free (-1 to just use the first free extent on the disk)
 //----------------------------------------------------------------------
 
 bool
-FileHeader::Allocate(PersistentBitmap *freeMap, int fileSize)
+FileHeader::Allocate(PersistentBitmap *freeMap, int fileSize, int near)
 { 
-    // numBytes = fileSize;
-    // numSectors  = divRoundUp(fileSize, SectorSize);
-    if (freeMap->NumClear() < numSectors) {
+	int total = divRoundUp(fileSize, SectorSize);
+	int wanted = SectorsWanted(0, total - 1);
+	
+    if (freeMap->NumClear() < wanted) {
 		cout << "OUT OF MEMORY\n";
 		return FALSE;		// not enough space
 	}
+	if (AllocateRange(freeMap, 0, total - 1, near) < total) {
+		numSectors = total;	// give back the clusters it did get
+		Deallocate(freeMap);
+		Initialize();
+		cout << "OUT OF MEMORY\n";
+		return FALSE;		// no run of free sectors for a cluster
+	}
+	if (fileSize > numBytes)
+		SetLength(fileSize);
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// FileHeader::AllocateRange
+// 	Allocate disk sectors for the holes among the file's sectors
+//	"first" through "last", along with any index blocks they need.
+//	Return the number of the first of those sectors that could not be
+//	allocated because the disk is full, or last + 1 if they all were.
+//	Sectors are allocated a whole cluster at a time, so filling in one
+//	sector allocates the others of its cluster too.
+//
+//	The index blocks are written through; the caller must write
+//	back the header and "freeMap".
+//
+//	"near" is where the first new sector should go if it is free
+//		(-1 to just use the first free extent on the disk)
+//----------------------------------------------------------------------
+
+int
+FileHeader::AllocateRange(PersistentBitmap *freeMap, int first, int last, int near)
+{
+	ASSERT(!IsInline());
+	// hand out sectors from as few runs of free sectors as we can
+	allocWant = SectorsWanted(first, last);
+	allocNext = near;
+	
+	for (int i = first; i <= last; i++) {
+		if (GetPhysicSector(i) == -1 && AllocateAt(i, freeMap) == -1)
+			return i;
+	}
+	return last + 1;
+}
+
+//----------------------------------------------------------------------
+// FileHeader::SectorsWanted
+// 	Return how many disk sectors (data and index) it would take to
+//	fill in the holes among the file's sectors "first" through "last"
+//	-- all the sectors of the clusters they are in.
+//----------------------------------------------------------------------
+
+int
+FileHeader::SectorsWanted(int first, int last)
+{
+	int wanted = 0;
+	int lastChild = -1;
+	bool needSingle = FALSE, needDouble = FALSE;
+	
+	for (int i = first / ClusterSize(); i <= last / ClusterSize(); i++) {
+		if (GetCluster(i) != -1)
+			continue;
+		wanted += ClusterSize();
+		if (IsExtentMapped())
+			continue;		// (unless it runs out of extents)
+		if (i >= NumDirect && i < NumDirect + NumIndirect) {
+			needSingle = (singleIndirectSector == -1);
+		} else if (i >= NumDirect + NumIndirect) {
+			int child = (i - NumDirect - NumIndirect) / NumIndirect;
+			
+			needDouble = (doubleIndirectSector == -1);
+			if (child != lastChild && (needDouble 
+					|| DoubleIndirect()->dataSectors[child] == -1))
+				wanted++;		// one of its single indirect blocks
+			lastChild = child;
+		}
+	}
+	return wanted + (needSingle ? 1 : 0) + (needDouble ? 1 : 0);
+}
+
+//----------------------------------------------------------------------
+// FileHeader::AllocateAt
+// 	Allocate the cluster holding the file's sector "localSector",
+//	which must be a hole, along with the index blocks leading to it if
+//	they don't exist yet.  Return the disk sector "localSector" is now
+//	in, or -1 if there is no run of free sectors for the cluster.
+//
+//	A file mapped by extents adds the cluster to its extents; if they
+//	are all in use and it starts no new one, the file is changed over
+//	to dataSectors and index blocks.
+//----------------------------------------------------------------------
+
+int
+FileHeader::AllocateAt(int localSector, PersistentBitmap *freeMap)
+{
+	Indirect *indirect = NULL;
+	int indirectSector = -1;
+	int cluster = localSector / ClusterSize();
+	int *slot;		// where the new sector number goes
+	
+	ASSERT(cluster >= 0 && cluster < MaxFileClusters);
+	if (IsExtentMapped()) {
+		int sector = AllocSectors(freeMap, ClusterSize());
 		
-	AllocateDirectBlocks(fileSize, freeMap);
-	if(fileSize <= (NumDirect * SectorSize)) return TRUE;
+		if (sector == -1)
+			return -1;
+		if (!AddExtent(cluster, sector) && !ToBlocks(freeMap, cluster, sector)) {
+			freeMap->ClearRange(sector, ClusterSize());	// no room for
+									// the index
+			return -1;
+		}
+		DEBUG(dbgFile, "Adding sector " << sector << " as file cluster " << cluster);
+		return sector + localSector % ClusterSize();
+	}
+	if ((slot = FindSlot(cluster, freeMap, &indirect, &indirectSector)) == NULL)
+		return -1;
 	
-	// Create Single Indirect
-	ASSERT(numBytes >= (NumDirect * SectorSize));
-	CreateSingleIndirectBlock(fileSize, freeMap);
+	ASSERT(*slot == -1);
+	if ((*slot = AllocSectors(freeMap, ClusterSize())) == -1)
+		return -1;
+	DEBUG(dbgFile, "Adding sector " << *slot << " as file cluster " << cluster);
+	if (indirect != NULL) {
+		indirect->numSectors++;
+		kernel->synchDisk->WriteSector(indirectSector, (char *)indirect, TRUE);
+	}
+	return *slot + localSector % ClusterSize();
+}
+
+//----------------------------------------------------------------------
+// FileHeader::FindSlot
+// 	Return where the first sector of cluster "cluster" of a file
+//	mapped by dataSectors and index blocks is recorded: in the header,
+//	or in the index block returned in "indirect" (whose sector is
+//	returned in "indirectSector"; NULL and -1 if it's the header).
+//
+//	If "freeMap" is not NULL, the index blocks leading to the cluster
+//	are allocated (and written through) if they don't exist yet, and
+//	NULL is returned if the disk is full; otherwise they must exist.
+//----------------------------------------------------------------------
+
+int *
+FileHeader::FindSlot(int cluster, PersistentBitmap *freeMap, 
+			Indirect **indirect, int *indirectSector)
+{
+	ASSERT(!IsExtentMapped());
+	*indirect = NULL;
+	*indirectSector = -1;
+	if (cluster < NumDirect)
+		return &dataSectors[cluster];
+	if (cluster < NumDirect + NumIndirect) {
+		if (singleIndirectSector == -1) {
+			ASSERT(freeMap != NULL);
+			if ((singleIndirectSector = AllocSectors(freeMap, 1)) == -1)
+				return NULL;
+			DEBUG(dbgFile, "Creating Single Indirect Block at sector " << singleIndirectSector);
+			singleCache = new Indirect();	// keep it, rather than re-read it
+			kernel->synchDisk->WriteSector(singleIndirectSector, (char *)singleCache, TRUE);
+		}
+		*indirect = SingleIndirect();
+		*indirectSector = singleIndirectSector;
+		return &(*indirect)->dataSectors[cluster - NumDirect];
+	}
 	
-	int allocated = AllocateIndirectSpace(fileSize, singleIndirectSector, (NumDirect * SectorSize), freeMap);
-	if(allocated == 0) return TRUE;
+	int rel = cluster - (NumDirect + NumIndirect);
+	int child = rel / NumIndirect;
 	
-	// Create Double Indirect
-	ASSERT(allocated > 0);
-	AllocateDoubleIndirectBlock(fileSize, freeMap);
+	if (doubleIndirectSector == -1) {
+		ASSERT(freeMap != NULL);
+		if ((doubleIndirectSector = AllocSectors(freeMap, 1)) == -1)
+			return NULL;
+		DEBUG(dbgFile, "Creating a double indirect block at sector " << doubleIndirectSector);
+		doubleCache = new Indirect();
+		kernel->synchDisk->WriteSector(doubleIndirectSector, (char *)doubleCache, TRUE);
+	}
+	Indirect *doubleIndirect = DoubleIndirect();
 	
+	if (doubleIndirect->dataSectors[child] == -1) {
+		ASSERT(freeMap != NULL);
+		int indSector = AllocSectors(freeMap, 1);
+		
+		if (indSector == -1)
+			return NULL;
+		DEBUG(dbgFile, "Creating a single indirect of double indirect at sector " << indSector);
+		doubleIndirect->dataSectors[child] = indSector;
+		doubleIndirect->numSectors++;
+		doubleChildCache[child] = new Indirect();
+		kernel->synchDisk->WriteSector(indSector, (char *)doubleChildCache[child], TRUE);
+		kernel->synchDisk->WriteSector(doubleIndirectSector, (char *)doubleIndirect, TRUE);
+	}
+	*indirect = DoubleChild(child);
+	*indirectSector = doubleIndirect->dataSectors[child];
+	return &(*indirect)->dataSectors[rel % NumIndirect];
+}
+
+//----------------------------------------------------------------------
+// FileHeader::FindExtent
+// 	Return the index of the last of the file's extents that starts at
+//	or before cluster "cluster" (a binary search, as they are kept in
+//	order), or -1 if there is none.
+//----------------------------------------------------------------------
+
+int
+FileHeader::FindExtent(int cluster)
+{
+	int lo = 0, hi = numExtents - 1, found = -1;
 	
-    return TRUE;
+	while (lo <= hi) {
+		int mid = (lo + hi) / 2;
+		
+		if (extents[mid].first <= cluster) {
+			found = mid;
+			lo = mid + 1;
+		} else
+			hi = mid - 1;
+	}
+	return found;
+}
+
+//----------------------------------------------------------------------
+// FileHeader::AddExtent
+// 	Map the file's cluster "cluster", a hole, to the cluster at disk
+//	sector "sector", joining it to the extent before and/or after it
+//	if it continues them on disk too.  Return FALSE if it would need
+//	an extent of its own, and all MaxExtents are in use.
+//----------------------------------------------------------------------
+
+bool
+FileHeader::AddExtent(int cluster, int sector)
+{
+	int e = FindExtent(cluster);
+	int size = ClusterSize();
+	bool joinPrev = (e != -1 && extents[e].first + extents[e].length == cluster
+			&& extents[e].sector + extents[e].length * size == sector);
+	bool joinNext = (e + 1 < numExtents && extents[e + 1].first == cluster + 1
+			&& extents[e + 1].sector == sector + size);
+	
+	ASSERT(e == -1 || cluster >= extents[e].first + extents[e].length);
+	if (joinPrev && joinNext) {
+		extents[e].length += 1 + extents[e + 1].length;
+		for (int i = e + 1; i < numExtents - 1; i++)
+			extents[i] = extents[i + 1];
+		numExtents--;
+	} else if (joinPrev) {
+		extents[e].length++;
+	} else if (joinNext) {
+		extents[e + 1].first--;
+		extents[e + 1].sector -= size;
+		extents[e + 1].length++;
+	} else {
+		if (numExtents == MaxExtents)
+			return FALSE;
+		for (int i = numExtents; i > e + 1; i--)
+			extents[i] = extents[i - 1];
+		extents[e + 1].first = cluster;
+		extents[e + 1].sector = sector;
+		extents[e + 1].length = 1;
+		numExtents++;
+	}
+	return TRUE;
+}
+
+//----------------------------------------------------------------------
+// FileHeader::ToBlocks
+// 	Change a file mapped by extents over to dataSectors and index
+//	blocks, also mapping its cluster "cluster" (a hole) to disk sector
+//	"sector", unless "cluster" is -1.  The index blocks are allocated
+//	and written through.
+//	Return FALSE, changing nothing, if there are not enough free
+//	sectors for them.
+//----------------------------------------------------------------------
+
+bool
+FileHeader::ToBlocks(PersistentBitmap *freeMap, int cluster, int sector)
+{
+	Extent saved[MaxExtents];
+	int numSaved = numExtents;
+	bool single = FALSE, doubleIndirect = FALSE;
+	bool child[NumIndirect];
+	int wanted = 0;
+	
+	ASSERT(IsExtentMapped());
+	bzero(child, sizeof(child));
+	for (int e = 0; e <= numSaved; e++) {
+		int first = (e < numSaved) ? extents[e].first : cluster;
+		int last = (e < numSaved) ? first + extents[e].length - 1 : cluster;
+		
+		for (int i = max(first, (int) NumDirect); i <= last; i++) {
+			if (i < NumDirect + NumIndirect) {
+				single = TRUE;
+			} else {
+				doubleIndirect = TRUE;
+				child[(i - NumDirect - NumIndirect) / NumIndirect] = TRUE;
+			}
+		}
+	}
+	for (int i = 0; i < NumIndirect; i++)
+		if (child[i])
+			wanted++;
+	if (single)
+		wanted++;
+	if (doubleIndirect)
+		wanted++;
+	if (freeMap->NumClear() < wanted)
+		return FALSE;
+	
+	DEBUG(dbgFile, "Mapping the " << numSaved << " extents of a file with index blocks");
+	bcopy(extents, saved, sizeof(saved));
+	numExtents = BlockMapped;
+	memset(dataSectors, -1, sizeof(dataSectors));
+	for (int e = 0; e < numSaved; e++)
+		for (int i = 0; i < saved[e].length; i++)
+			SetSlot(saved[e].first + i, saved[e].sector + i * ClusterSize(),
+				freeMap);
+	if (cluster != -1)
+		SetSlot(cluster, sector, freeMap);
+	return TRUE;
+}
+
+//----------------------------------------------------------------------
+// FileHeader::SetSlot
+// 	Record that cluster "cluster" of a file mapped by index blocks,
+//	a hole, is at disk sector "sector", allocating the index blocks
+//	leading to it if need be (there must be room for them).
+//----------------------------------------------------------------------
+
+void
+FileHeader::SetSlot(int cluster, int sector, PersistentBitmap *freeMap)
+{
+	Indirect *indirect;
+	int indirectSector;
+	int *slot = FindSlot(cluster, freeMap, &indirect, &indirectSector);
+	
+	ASSERT(slot != NULL && *slot == -1);
+	*slot = sector;
+	if (indirect != NULL) {
+		indirect->numSectors++;
+		kernel->synchDisk->WriteSector(indirectSector, (char *)indirect, TRUE);
+	}
+}
+
+//----------------------------------------------------------------------
+// FileHeader::CutExtent
+// 	Make cluster "cluster" of a file mapped by extents, which is in
+//	extent "e", a hole.  Return FALSE, changing nothing, if that would
+//	split the extent in two when all MaxExtents are in use.
+//----------------------------------------------------------------------
+
+bool
+FileHeader::CutExtent(int e, int cluster)
+{
+	int offset = cluster - extents[e].first;
+	
+	ASSERT(offset >= 0 && offset < extents[e].length);
+	if (extents[e].length == 1) {
+		for (int i = e; i < numExtents - 1; i++)
+			extents[i] = extents[i + 1];
+		numExtents--;
+	} else if (offset == 0) {
+		extents[e].first++;
+		extents[e].sector += ClusterSize();
+		extents[e].length--;
+	} else if (offset == extents[e].length - 1) {
+		extents[e].length--;
+	} else {
+		if (numExtents == MaxExtents)
+			return FALSE;
+		for (int i = numExtents; i > e + 1; i--)
+			extents[i] = extents[i - 1];
+		extents[e + 1].first = cluster + 1;
+		extents[e + 1].sector = extents[e].sector + (offset + 1) * ClusterSize();
+		extents[e + 1].length = extents[e].length - offset - 1;
+		extents[e].length = offset;
+		numExtents++;
+	}
+	return TRUE;
+}
+
+//----------------------------------------------------------------------
+// FileHeader::Remap
+// 	Point the file's cluster "cluster", which is mapped, at disk
+//	sector "sector" instead, once its data has been copied there.
+//	Index blocks that change are written through; a file mapped by
+//	extents may need another extent for it, or to change over to
+//	index blocks.  Return FALSE, changing nothing, if there are not
+//	enough free sectors for them.  The caller must write back the
+//	header, and let go of the old cluster.
+//----------------------------------------------------------------------
+
+bool
+FileHeader::Remap(int cluster, int sector, PersistentBitmap *freeMap)
+{
+	Indirect *indirect;
+	int indirectSector;
+	int *slot;
+	
+	if (IsExtentMapped()) {
+		int old = GetCluster(cluster);
+		
+		ASSERT(old != -1);
+		if (CutExtent(FindExtent(cluster), cluster)) {
+			bool restored;
+			
+			if (AddExtent(cluster, sector) || ToBlocks(freeMap, cluster, sector))
+				return TRUE;
+			restored = AddExtent(cluster, old);	// as it was
+			ASSERT(restored);
+			return FALSE;
+		}
+		if (!ToBlocks(freeMap, -1, -1))
+			return FALSE;
+	}
+	slot = FindSlot(cluster, NULL, &indirect, &indirectSector);
+	ASSERT(*slot != -1);
+	*slot = sector;
+	if (indirect != NULL)
+		kernel->synchDisk->WriteSector(indirectSector, (char *)indirect, TRUE);
+	return TRUE;
+}
+
+//----------------------------------------------------------------------
+// FileHeader::IndexBlocks
+// 	Return how many index blocks the file has.
+//----------------------------------------------------------------------
+
+int
+FileHeader::IndexBlocks()
+{
+	int n = 0;
+	
+	if (IsInline() || IsExtentMapped())
+		return 0;
+	if (singleIndirectSector != -1)
+		n++;
+	if (doubleIndirectSector != -1)
+		n += 1 + DoubleIndirect()->numSectors;
+	return n;
+}
+
+//----------------------------------------------------------------------
+// FileHeader::CloneFrom
+// 	Make this header, of a new file, map the same data sectors as
+//	"src" does: a copy of the disk part of "src", with index blocks of
+//	its own if it has any (allocated and written through; the caller
+//	must have checked there is room for IndexBlocks of them).  The
+//	caller counts the extra reference to each data sector.
+//----------------------------------------------------------------------
+
+void
+FileHeader::CloneFrom(FileHeader *src, PersistentBitmap *freeMap)
+{
+	FlushIndirectCache();
+	bcopy((char *) &src->numBytes, (char *) &numBytes, SectorSize);
+	if (IsInline() || IsExtentMapped())
+		return;
+	singleIndirectSector = -1;
+	doubleIndirectSector = -1;
+	for (int i = NumDirect; i < NumClusters(); i++) {
+		int sector = src->GetCluster(i);
+		
+		if (sector != -1)
+			SetSlot(i, sector, freeMap);
+	}
+}
+
+//----------------------------------------------------------------------
+// FileHeader::ToExtents
+// 	Change a file mapped by dataSectors and index blocks back to
+//	extents, freeing its index blocks, if its clusters are in few
+//	enough runs on disk; otherwise leave it alone.
+//----------------------------------------------------------------------
+
+void
+FileHeader::ToExtents(PersistentBitmap *freeMap)
+{
+	Extent runs[MaxExtents];
+	int n = 0;
+	
+	if (IsExtentMapped())
+		return;
+	for (int i = 0; i < NumClusters(); i++) {
+		int sector = GetCluster(i);
+		
+		if (sector == -1)
+			continue;		// a hole
+		if (n > 0 && runs[n - 1].first + runs[n - 1].length == i
+				&& runs[n - 1].sector + runs[n - 1].length * ClusterSize() == sector) {
+			runs[n - 1].length++;
+			continue;
+		}
+		if (n == MaxExtents)
+			return;			// too scattered
+		runs[n].first = i;
+		runs[n].sector = sector;
+		runs[n].length = 1;
+		n++;
+	}
+	
+	DEBUG(dbgFile, "Mapping a file with " << n << " extents");
+	if (singleIndirectSector != -1)
+		freeMap->Clear(singleIndirectSector);
+	if (doubleIndirectSector != -1) {
+		Indirect *doubleIndirect = DoubleIndirect();
+		
+		for (int i = 0; i < NumIndirect; i++)
+			if (doubleIndirect->dataSectors[i] != -1)
+				freeMap->Clear(doubleIndirect->dataSectors[i]);
+		freeMap->Clear(doubleIndirectSector);
+	}
+	FlushIndirectCache();
+	singleIndirectSector = doubleIndirectSector = -1;
+	memset(dataSectors, -1, sizeof(dataSectors));
+	bcopy(runs, extents, n * sizeof(Extent));
+	numExtents = n;
+}
+
+//----------------------------------------------------------------------
+// FileHeader::SetLength
+// 	Change the length of the file, without allocating anything; the
+//	sectors that aren't allocated are holes, which read as zeros.
+//----------------------------------------------------------------------
+
+void
+FileHeader::SetLength(int length)
+{
+	ASSERT(length >= 0 && divRoundUp(length, SectorSize) <= MaxFileSectors);
+	ASSERT(!IsCompressed());
+	numBytes = length;
+	if (IsInline()) {
+		ASSERT(length <= MaxInlineSize);
+	} else
+		numSectors = divRoundUp(length, SectorSize);
+}
+
+//----------------------------------------------------------------------
+// FileHeader::MakeInline
+// 	Keep the data of a new file, which has no sectors yet, in the
+//	header itself.  It reads as zeros until written.
+//----------------------------------------------------------------------
+
+void
+FileHeader::MakeInline()
+{
+	ASSERT(numBytes <= MaxInlineSize && numExtents == 0);
+	numSectors = InlineSectors;
+	bzero(inlineData, MaxInlineSize);
+}
+
+//----------------------------------------------------------------------
+// FileHeader::Uninline
+// 	Copy the data of an inline file to "saved" (MaxInlineSize bytes),
+//	and turn the file into an ordinary one of the same length, all
+//	holes, so that the caller can write the data back into sectors.
+//----------------------------------------------------------------------
+
+void
+FileHeader::Uninline(char *saved)
+{
+	ASSERT(IsInline());
+	bcopy(inlineData, saved, MaxInlineSize);
+	memset(dataSectors, -1, sizeof(dataSectors));
+	numSectors = divRoundUp(numBytes, SectorSize);
+}
+
+//----------------------------------------------------------------------
+// FileHeader::StoredSectors
+// 	Return how many sectors the file's data takes on disk (holes
+//	included): none if it is inline, the stream's if it is
+//	compressed, and otherwise as many as its length covers.
+//----------------------------------------------------------------------
+
+int
+FileHeader::StoredSectors()
+{
+	if (IsInline())
+		return 0;
+	if (IsCompressed())
+		return numSectors;
+	return divRoundUp(numBytes, SectorSize);
+}
+
+//----------------------------------------------------------------------
+// FileHeader::MakeCompressed
+// 	Make a new file, which has no sectors yet, "length" bytes long,
+//	kept as a compressed stream of "storedBytes".  The caller then
+//	allocates and writes the stream's sectors.  Unlike an ordinary
+//	file, it can be longer than MaxFileSize, as long as the stream
+//	fits in a file.
+//----------------------------------------------------------------------
+
+void
+FileHeader::MakeCompressed(int length, int storedBytes)
+{
+	ASSERT(!IsInline() && NumClusters() == 0 && numExtents == 0);
+	ASSERT(divRoundUp(storedBytes, SectorSize) <= MaxFileSectors);
+	flags |= HdrCompressed;
+	numBytes = length;
+	numSectors = divRoundUp(storedBytes, SectorSize);
+}
+
+//----------------------------------------------------------------------
+// FileHeader::Uncompress
+// 	Turn a compressed file, whose sectors have been deallocated, into
+//	an ordinary one of the same length, all holes, so that the caller
+//	can write the data back decompressed.
+//----------------------------------------------------------------------
+
+void
+FileHeader::Uncompress()
+{
+	int length = numBytes;
+	
+	ASSERT(IsCompressed() && length <= MaxFileSize);
+	Initialize();
+	SetLength(length);
 }
 
 //----------------------------------------------------------------------
 // FileHeader::Deallocate
 // 	De-allocate all the space allocated for data blocks for this file.
+//	Clusters shared with a clone (see refcount.h) stay allocated.
 //
 //	"freeMap" is the bit map of free disk sectors
 //----------------------------------------------------------------------
@@ -120,25 +832,91 @@ FileHeader::Allocate(PersistentBitmap *freeMap, int fileSize)
 void 
 FileHeader::Deallocate(PersistentBitmap *freeMap)
 {
-    /*for (int i = 0; i < numSectors; i++) {
-		ASSERT(freeMap->Test((int) dataSectors[i]));  // ought to be marked!
-		freeMap->Clear((int) dataSectors[i]);
-    }*/
-	
-	for (int i = 0; i < numSectors; i++) {
-      int pos = GetPhysicSector(i);
-      ASSERT(freeMap->Test(pos));  // ought to be marked!
-      freeMap->Clear(pos);
+	for (int i = 0; i < NumClusters(); i++) {
+      int pos = GetCluster(i);
+      
+      if (pos == -1)
+		continue;		// a hole
+      ASSERT(freeMap->NumClearIn(pos, ClusterSize()) == 0);  // ought to be marked!
+      freeMap->ReleaseRange(pos, ClusterSize());	// unless a clone has it
     }
     if (singleIndirectSector != -1) { 
       if (freeMap->Test(singleIndirectSector)) freeMap->Clear(singleIndirectSector);
     }
 
     if (doubleIndirectSector != -1) {
+      Indirect *doubleIndirect = DoubleIndirect();
+      for (int i = 0; i < NumIndirect; i++) {
+        int child = doubleIndirect->dataSectors[i];
+        if (child != -1 && freeMap->Test(child)) freeMap->Clear(child);
+      }
       if (freeMap->Test(doubleIndirectSector)) freeMap->Clear(doubleIndirectSector);
     }
 }
 
+//----------------------------------------------------------------------
+// FileHeader::Acquire
+// 	Return the in-core header of the file whose header is at "sector",
+//	reading it from disk only if no one has it open yet.  Each call
+//	must be matched by a Release.
+//----------------------------------------------------------------------
+
+FileHeader *
+FileHeader::Acquire(int sector)
+{
+    FileHeader *hdr;
+
+    if (openHeaders == NULL)
+	openHeaders = new HashTable<int, FileHeader *>(HeaderKey, HashSector);
+    if (!openHeaders->Find(sector, &hdr)) {
+	hdr = new FileHeader;
+	hdr->FetchFrom(sector);
+	hdr->openSector = sector;
+	hdr->shared = TRUE;
+	openHeaders->Insert(hdr);
+    }
+    hdr->openCount++;
+    hdr->numAcquires++;
+    return hdr;
+}
+
+//----------------------------------------------------------------------
+// FileHeader::Release
+// 	Give up a header returned by Acquire; the last one to let go
+//	deletes it.
+//----------------------------------------------------------------------
+
+void
+FileHeader::Release(FileHeader *hdr)
+{
+    ASSERT(hdr->openCount > 0);
+    if (--hdr->openCount == 0) {
+	if (hdr->shared)
+	    openHeaders->Remove(hdr->openSector);
+	delete hdr;
+    }
+}
+
+//----------------------------------------------------------------------
+// FileHeader::Forget
+// 	The file whose header was at "sector" has been removed, and the
+//	sector may be reused.  Anyone who still has the old header keeps
+//	it, but later Acquire's read the sector afresh, and any cached
+//	image of it as a program is thrown away.
+//----------------------------------------------------------------------
+
+void
+FileHeader::Forget(int sector)
+{
+    FileHeader *hdr;
+
+    kernel->imageCache->Invalidate(sector);	// if it was a program
+    if (openHeaders != NULL && openHeaders->Find(sector, &hdr)) {
+	openHeaders->Remove(sector);
+	hdr->shared = FALSE;
+    }
+}
+
 //----------------------------------------------------------------------
 // FileHeader::FetchFrom
 // 	Fetch contents of file header from disk. 
@@ -149,7 +927,8 @@ FileHeader::Deallocate(PersistentBitmap *freeMap)
 void
 FileHeader::FetchFrom(int sector)
 {
-    kernel->synchDisk->ReadSector(sector, (char *)this);
+    FlushIndirectCache();		// they belonged to the old contents
+    kernel->synchDisk->ReadSector(sector, (char *) &numBytes, TRUE);
 	
 	/*
 		MP4 Hint:
@@ -168,7 +947,7 @@ FileHeader::FetchFrom(int sector)
 void
 FileHeader::WriteBack(int sector)
 {
-    kernel->synchDisk->WriteSector(sector, (char *)this); 
+    kernel->synchDisk->WriteSector(sector, (char *) &numBytes, TRUE); 
 	
 	/*
 		MP4 Hint:
@@ -223,21 +1002,49 @@ FileHeader::Print()
     char *data = new char[SectorSize];
 
     printf("FileHeader contents.  File size: %d.  File blocks:\n", numBytes);
+    if (ClusterSize() > 1)
+	printf("(in clusters of %d sectors)\n", ClusterSize());
+    if (IsInline()) {
+	printf("(in the header)\nFile contents:\n");
+	for (j = 0; j < numBytes; j++) {
+	    if ('\040' <= inlineData[j] && inlineData[j] <= '\176')
+		printf("%c", inlineData[j]);
+	    else
+		printf("\\%x", (unsigned char)inlineData[j]);
+	}
+	printf("\n");
+	delete [] data;
+	return;
+    }
+    if (IsCompressed())
+	printf("(compressed into %d sectors)\n", numSectors);
+    if (IsExtentMapped())
+	printf("(in %d extents)\n", numExtents);
     for (i = 0; i < numSectors; i++) {
 		int sector = GetPhysicSector(i);
+		int cluster = i / ClusterSize();
 		
-		if(i < NumDirect)
+		if(IsExtentMapped() || cluster < NumDirect)
 			printf("%d ", sector);
-		else if(i < (NumDirect + NumIndirect))
+		else if(cluster < (NumDirect + NumIndirect))
 			printf("*%d* ", sector);
 		else
 			printf("**%d** ", sector);
 	}
 
-    printf("\nFile contents:\n");
+    printf("\n");
+    if (IsCompressed()) {
+	printf("File contents are compressed.\n");
+	delete [] data;
+	return;
+    }
+    printf("File contents:\n");
 	
     for (i = k = 0; i < numSectors; i++) {
-		kernel->synchDisk->ReadSector(GetPhysicSector(i), data);
+		if (GetPhysicSector(i) == -1)
+			MemZero(data, SectorSize);	// a hole
+		else
+			kernel->synchDisk->ReadSector(GetPhysicSector(i), data);
 		
         for (j = 0; (j < SectorSize) && (k < numBytes); j++, k++) {
 			if ('\040' <= data[j] && data[j] <= '\176')   // isprint(data[j])
@@ -250,172 +1057,206 @@ FileHeader::Print()
     delete [] data;
 }
 
-// Allocates space within the direct blocks of the inode.
-void
-FileHeader::AllocateDirectBlocks(int fileSize, PersistentBitmap *freeMap)
-{
-  while (numBytes >= 0 && numBytes < (NumDirect * SectorSize)) {
-    if (fileSize <= (numSectors * SectorSize)) {
-		numBytes = fileSize;
-		break;
-    } else {
-      numBytes = (numSectors * SectorSize);
-	
-      if (numSectors < NumDirect) {
-		// This action needs to be atomic
-		dataSectors[numSectors] = freeMap->FindAndSet();
-		DEBUG(dbgFile, "Adding sector " << dataSectors[numSectors] << " to the direct block\n");
-		numSectors += 1;
-      }
-    }
-  }
-}
+//----------------------------------------------------------------------
+// FileHeader::AllocSectors
+// 	Allocate the next "count" consecutive sectors for the file being
+//	allocated: a cluster, or (with count 1) an index block.  Sectors
+//	are handed out in order from an extent -- a run of consecutive
+//	free sectors found with PersistentBitmap::FindRun, big enough for
+//	everything Allocate still needs if there is one.  So a file is
+//	laid out on as few runs as possible, and sequential transfers of
+//	it take few disk requests.
+//
+//	The first sector is the one Allocate was asked to start "near",
+//	if that is free; a new extent is looked for after the last one.
+//	Return the first of the sectors, or -1 if there is no run of
+//	"count" free sectors left on the disk.
+//----------------------------------------------------------------------
 
-// Create Single Indirect Block for file header
-void 
-FileHeader::CreateSingleIndirectBlock(int fileSize, PersistentBitmap *freeMap)
+int
+FileHeader::AllocSectors(PersistentBitmap *freeMap, int count)
 {
-	if(singleIndirectSector == -1) {
-		Indirect *singleIndirect = new Indirect();
-		
-		singleIndirectSector = freeMap->FindAndSet();
-		DEBUG(dbgFile, "Creating Single Indirect Block at sector " << singleIndirectSector << "\n");
-		//singleIndirect->numSectors = 0;
-		kernel->synchDisk->WriteSector(singleIndirectSector, (char *) singleIndirect);
+	int length;
+	
+	if (allocNext == -1 || allocNext + count > NumSectors 
+			|| freeMap->NumClearIn(allocNext, count) < count) {
+		int from = (allocNext == -1 || allocNext >= NumSectors) ? 0 : allocNext;
 		
-		delete singleIndirect;
+		allocNext = freeMap->FindRun(max(allocWant, count), &length, from);
+		if (allocNext == -1 || length < count)
+			return -1;		// the disk is full
+		DEBUG(dbgFile, "New extent of " << length << " sectors at sector " << allocNext);
 	}
+	freeMap->MarkRange(allocNext, count);
+	allocWant = max(allocWant - count, 0);
+	allocNext += count;
+	return allocNext - count;
 }
 
-// Allocate Space for Indirect Block
+// Return the physical sector number, or -1 if that part of the
+// file is a hole
 int
-FileHeader::AllocateIndirectSpace(int fileSize, int sector, int start, PersistentBitmap *freeMap)
+FileHeader::GetPhysicSector(int localSector)
 {
-	int end = start + (NumIndirect * SectorSize);
-	Indirect *indirect = new Indirect();
-	
-	kernel->synchDisk->ReadSector(sector, (char *)indirect);
+	int cluster;
 	
-	while(numBytes >= start && numBytes < end) {
-		if(fileSize <= (numSectors * SectorSize)) {
-			numBytes = fileSize;
-			break;
-		} else {
-			numBytes = (numSectors * SectorSize);
-			
-			if(indirect->numSectors < NumIndirect) {
-				indirect->dataSectors[indirect->numSectors] = freeMap->FindAndSet();
-				
-				indirect->numSectors++;
-				numSectors++;
-			}
-		}
-	}
-	kernel->synchDisk->WriteSector(sector, (char *)indirect);
-	delete indirect;
-	
-	return fileSize - numBytes;
+	if (IsInline())
+		return -1;		// the data is in the header
+	cluster = GetCluster(localSector / ClusterSize());
+	if (cluster == -1)
+		return -1;		// a hole
+	return cluster + localSector % ClusterSize();
 }
 
-// Allocate Double Indirect Block
-void 
-FileHeader::AllocateDoubleIndirectBlock(int fileSize, PersistentBitmap *freeMap)
+// Return the first physical sector of cluster "cluster" of the file,
+// or -1 if it is a hole
+int
+FileHeader::GetCluster(int cluster)
 {
-	int allocated = -1;
-	
-	Indirect *doubleIndirect = new Indirect();
+	int physicSector;
 	
-	if(doubleIndirectSector != -1) {
-		kernel->synchDisk->ReadSector(doubleIndirectSector, (char *)doubleIndirect);
-	} else {
-		doubleIndirectSector = freeMap->FindAndSet();
-		
-		
-		DEBUG(dbgFile, "Creating a double indirect block at sector " << doubleIndirectSector << "\n");
+	if (IsInline())
+		return -1;		// the data is in the header
+	if (IsExtentMapped()) {
+		int e = FindExtent(cluster);
 		
-		kernel->synchDisk->WriteSector(doubleIndirectSector, (char *)doubleIndirect);
+		if (e == -1 || cluster >= extents[e].first + extents[e].length)
+			return -1;		// a hole
+		return extents[e].sector + (cluster - extents[e].first) * ClusterSize();
 	}
-	
-	int cur_numSectors = 0;
-	
-	do{
-		ASSERT(cur_numSectors <= doubleIndirect->numSectors);
-		Indirect *singleIndirect = new Indirect();
-		
-		if(doubleIndirect->dataSectors[cur_numSectors] != -1) {
-			kernel->synchDisk->ReadSector(doubleIndirect->dataSectors[cur_numSectors], (char *)singleIndirect);
-		} else {
-			int indSector = freeMap->FindAndSet();
-			
-			DEBUG(dbgFile, "Creating a single indirect of double indirect at sector " << indSector << "\n");
-			
-			//singleIndirect->numSectors = 0;
-			doubleIndirect->dataSectors[doubleIndirect->numSectors] = indSector;
-			doubleIndirect->numSectors++;
-			
-			kernel->synchDisk->WriteSector(indSector, (char *)singleIndirect);
-			kernel->synchDisk->WriteSector(doubleIndirectSector, (char *) doubleIndirect);
-		}
-		
-		// start position = Direct_Sector + Single_Sector + SingleSector_OF_Double
-		int start = SectorSize * (NumDirect + NumIndirect * (1 + cur_numSectors));
+	if(cluster < NumDirect) {
+		physicSector =  dataSectors[cluster];
+	} else if(cluster < (NumDirect + NumIndirect)) {
+		if(singleIndirectSector == -1)
+			return -1;		// a hole
 		
-		allocated = AllocateIndirectSpace(fileSize, doubleIndirect->dataSectors[cur_numSectors], start, freeMap);
-		
-		// Whether current single indirect block 
-		// can be filled completely or not just increment the index
-		cur_numSectors++;
+		physicSector = SingleIndirect()->dataSectors[cluster - NumDirect];
+	} else {
+		ASSERT(cluster < MaxFileClusters);
+		if(doubleIndirectSector == -1)
+			return -1;		// a hole
 		
-		delete singleIndirect;
+		int single = (cluster - (NumDirect + NumIndirect)) / NumIndirect;
+		int pos = (cluster - (NumDirect + NumIndirect)) % NumIndirect;
 		
-	}while(allocated != 0);
-	
-	delete doubleIndirect;
+		if(DoubleIndirect()->dataSectors[single] == -1)
+			return -1;		// a hole
+		physicSector = DoubleChild(single)->dataSectors[pos];
+	}
+	return physicSector;
 }
 
-// Return the physical sector number
-int
-FileHeader::GetPhysicSector(int localSector)
+//----------------------------------------------------------------------
+// FileHeader::MoveTo
+// 	Point the file's clusters, in order, at the consecutive disk
+//	sectors from "sector", once their data has been copied there.  A
+//	file mapped by index blocks is then mapped by extents, if it can
+//	be, and its index blocks are given back to "freeMap"; the index
+//	blocks it keeps are written through.  The caller must write back
+//	the header.
+//----------------------------------------------------------------------
+
+void
+FileHeader::MoveTo(int sector, PersistentBitmap *freeMap)
 {
-	int physicSector;
+	int next = sector;
 	
-	if(localSector < NumDirect) {
-		physicSector =  dataSectors[localSector];
-	} else if(localSector < (NumDirect + NumIndirect)) {
-		ASSERT(singleIndirectSector != -1);
-		ASSERT(localSector < (NumDirect + NumIndirect));
-		
-		Indirect *singleIndirect = new Indirect();
-		
-		kernel->synchDisk->ReadSector(singleIndirectSector, (char *)singleIndirect);
-		physicSector = singleIndirect->dataSectors[localSector - NumDirect];
-		
-		delete singleIndirect;
-		
-	} else {
-		ASSERT(doubleIndirectSector != -1);
-		ASSERT(localSector >= (NumDirect + NumIndirect));
+	if (IsExtentMapped()) {
+		int n = 0;
 		
-		Indirect *doubleIndirect = new Indirect();
-		kernel->synchDisk->ReadSector(doubleIndirectSector, (char *)doubleIndirect);
-		
-		int single = (localSector - (NumDirect + NumIndirect)) / NumIndirect;
-		
-		Indirect *ind = new Indirect();
-		kernel->synchDisk->ReadSector(doubleIndirect->dataSectors[single], (char *)ind);
-		
-		int pos = (localSector - (NumDirect + NumIndirect)) % NumIndirect;
-		
-		physicSector = ind->dataSectors[pos];
+		for (int e = 0; e < numExtents; e++) {
+			extents[e].sector = next;
+			next += extents[e].length * ClusterSize();
+			if (n > 0 && extents[n - 1].first + extents[n - 1].length 
+					== extents[e].first)
+				extents[n - 1].length += extents[e].length;
+			else
+				extents[n++] = extents[e];
+		}
+		numExtents = n;
+		return;
+	}
+	for (int i = 0; i < NumClusters(); i++) {
+		Indirect *indirect;
+		int indirectSector;
+		int *slot;
 		
-		delete doubleIndirect;
-		delete ind;
+		if (GetCluster(i) == -1)
+			continue;		// a hole
+		slot = FindSlot(i, NULL, &indirect, &indirectSector);
+		*slot = next;
+		next += ClusterSize();
+		if (indirect != NULL)
+			kernel->synchDisk->WriteSector(indirectSector, (char *)indirect, TRUE);
 	}
-	return physicSector;
+	ToExtents(freeMap);
 }
 
+//----------------------------------------------------------------------
+// FileHeader::SingleIndirect
+// FileHeader::DoubleIndirect
+// FileHeader::DoubleChild
+//	Return the in-core copy of one of the file's index blocks, reading
+//	it from disk the first time it is needed.  After that, looking up
+//	a sector through it costs no disk I/O.
+//
+//	Code that changes an index block must change this copy, and write
+//	it through to disk.
+//
+//	"i" is which single indirect block of the double indirect block
+//----------------------------------------------------------------------
 
+Indirect *
+FileHeader::SingleIndirect()
+{
+	ASSERT(singleIndirectSector != -1);
+	if (singleCache == NULL) {
+		singleCache = new Indirect();
+		kernel->synchDisk->ReadSector(singleIndirectSector, (char *)singleCache, TRUE);
+	}
+	return singleCache;
+}
 
+Indirect *
+FileHeader::DoubleIndirect()
+{
+	ASSERT(doubleIndirectSector != -1);
+	if (doubleCache == NULL) {
+		doubleCache = new Indirect();
+		kernel->synchDisk->ReadSector(doubleIndirectSector, (char *)doubleCache, TRUE);
+	}
+	return doubleCache;
+}
 
+Indirect *
+FileHeader::DoubleChild(int i)
+{
+	ASSERT(i >= 0 && i < NumIndirect);
+	if (doubleChildCache[i] == NULL) {
+		int sector = DoubleIndirect()->dataSectors[i];
+		
+		ASSERT(sector != -1);
+		doubleChildCache[i] = new Indirect();
+		kernel->synchDisk->ReadSector(sector, (char *)doubleChildCache[i], TRUE);
+	}
+	return doubleChildCache[i];
+}
 
+//----------------------------------------------------------------------
+// FileHeader::FlushIndirectCache
+//	Throw away the in-core copies of the index blocks (they are always
+//	written through, so nothing needs to go back to disk).
+//----------------------------------------------------------------------
 
+void
+FileHeader::FlushIndirectCache()
+{
+	delete singleCache;
+	singleCache = NULL;
+	delete doubleCache;
+	doubleCache = NULL;
+	for (int i = 0; i < NumIndirect; i++) {
+		delete doubleChildCache[i];
+		doubleChildCache[i] = NULL;
+	}
+}
@@ -17,9 +17,47 @@
 #include "disk.h"
 #include "pbitmap.h"
 
-#define NumDirect 	((SectorSize - 5 * sizeof(int)) / sizeof(int))
-#define NumIndirect ((SectorSize - 1 * sizeof(int)) / sizeof(int))
-#define MaxFileSize 	(NumDirect * SectorSize)
+#define NumDirect 	((int) ((SectorSize - 6 * sizeof(int)) / sizeof(int)))
+#define NumIndirect	((int) ((SectorSize - 1 * sizeof(int)) / sizeof(int)))
+#define MaxFileClusters	(NumDirect + NumIndirect * (1 + NumIndirect))
+					// data clusters a header can point to
+#define MaxFileSectors	MaxFileClusters	// always reachable, even with
+					// one-sector clusters
+#define MaxFileSize 	(MaxFileSectors * SectorSize)
+#define MaxClusterSize	16		// most sectors in a cluster
+
+// A file this small can keep its data in its header, in place of the
+// table of direct sectors; numSectors is then InlineSectors.
+
+#define MaxInlineSize	((int) (NumDirect * sizeof(int)))
+#define InlineSectors	-1
+
+// A run of a file's clusters that are also consecutive on disk.
+
+class Extent {
+  public:
+    int first;				// the file's first cluster in it
+    int sector;				// the disk sector that one starts at
+    int length;				// number of clusters
+};
+
+// A file whose clusters are in few enough runs on disk is mapped by a
+// list of its extents, kept in the header in place of dataSectors;
+// one in more runs is mapped by dataSectors and index blocks, and has
+// numExtents BlockMapped.
+
+#define MaxExtents	((int) (NumDirect * sizeof(int) / sizeof(Extent)))
+#define BlockMapped	-1
+
+// A file can be kept compressed, as chunks of ChunkSize bytes each
+// compressed on its own (see compress.h).  Its sectors then hold a
+// stream: a table of where in the stream each chunk begins, with one
+// more entry for where the last one ends, and the chunks after it.  A
+// chunk that doesn't compress is stored as it is, and is known by
+// taking ChunkSize bytes (or all that is left of the file).
+
+#define ChunkSize	(8 * SectorSize)	// bytes compressed together
+#define HdrCompressed	0x1		// in "flags": the file is compressed
 
 // The following class defines the Nachos "file header" (in UNIX terms,  
 // the "i-node"), describing where on disk to find all of the data in the file.
@@ -35,19 +73,61 @@
 // There is no constructor; rather the file header can be initialized
 // by allocating blocks for the file (if it is a new file), or by
 // reading it from disk.
+//
+// A new file of no more than MaxInlineSize bytes starts out "inline":
+// its contents take the place of dataSectors, so reading or writing
+// it needs no disk sector besides the header.  Once it is written past
+// MaxInlineSize, its data moves out to a sector of its own, and it is
+// an ordinary file from then on.
+//
+// A file's data is allocated in clusters: runs of clusterSize
+// consecutive disk sectors, chosen when the disk is formatted.  Each
+// entry of dataSectors (and of the index blocks) gives the first
+// sector of one cluster, so a file of a given size needs a
+// clusterSize'th of the index entries, and its data is never split
+// into pieces smaller than a cluster.  The rest of Nachos still sees
+// the file as a sequence of sectors (see ByteToSector); the sectors of
+// a cluster that the file has not grown into yet are allocated, but
+// past its end.
+//
+// A new file is mapped by extents: finding the disk sector of an offset
+// is then a binary search of a few extents in the header, with no index
+// block to read, and however long a file in one run is, it takes one
+// extent.  A file that comes to need more than MaxExtents is changed
+// over to dataSectors and index blocks (see ToBlocks); defragmenting
+// it may change it back.
+//
+// A compressed file (HdrCompressed) is written whole, when it is
+// created (see OpenFile::LoadCompressed).  numBytes is then the length
+// of its data, and numSectors that of the compressed stream, which is
+// what its sectors map; reading a byte of it reads and decompresses
+// only the chunk it is in.  A write to it first makes it an ordinary
+// file again.
 
 class FileHeader {
   public:
 	// MP4 mod tag
 	FileHeader(); // dummy constructor to keep valgrind happy
 	~FileHeader();
+	static void *operator new(size_t size);	// from a pool of them,
+	static void operator delete(void *p);	// not the heap
 	
-    bool Allocate(PersistentBitmap *bitMap, int fileSize);// Initialize a file header, 
+    bool Allocate(PersistentBitmap *bitMap, int fileSize, int near = -1);
+						// Initialize a file header, 
 						//  including allocating space 
-						//  on disk for the file data
+						//  on disk for the file data,
+						//  starting at "near" if free
     void Deallocate(PersistentBitmap *bitMap);  // De-allocate this file's 
 						//  data blocks
 
+    static FileHeader *Acquire(int sectorNumber);
+					// Return the in-core header at
+					//  "sectorNumber", shared by everyone
+					//  who has the file open
+    static void Release(FileHeader *hdr); // Give up a header from Acquire
+    static void Forget(int sectorNumber); // The file is gone; don't hand
+					//  its header out any more
+
     void FetchFrom(int sectorNumber); 	// Initialize file header from disk
     void WriteBack(int sectorNumber); 	// Write modifications to file header
 					//  back to disk
@@ -63,11 +143,70 @@ class FileHeader {
 	
 	// Additional function of MP4
 	void Initialize();
-	void AllocateDirectBlocks(int fileSize, PersistentBitmap *bitMap);
-	void CreateSingleIndirectBlock(int fileSize, PersistentBitmap *bitMap);
-	int AllocateIndirectSpace(int fileSize, int sector, int start, PersistentBitmap *bitMap);
-	void AllocateDoubleIndirectBlock(int fileSize, PersistentBitmap *bitMap);
-	int GetPhysicSector(int localSector);
+	int AllocateRange(PersistentBitmap *bitMap, int first, int last, int near);
+					// Fill in the holes among some of the
+					//  file's sectors
+	int AllocateAt(int localSector, PersistentBitmap *bitMap);
+					// Fill in one hole
+	int SectorsWanted(int first, int last);
+					// Disk sectors it takes to fill them
+	void SetLength(int length);	// Just change the file's length
+	int GetPhysicSector(int localSector);	// -1 for a hole
+	int GetCluster(int cluster);	// its first sector, or -1 for a hole
+	bool IsExtentMapped() { return numExtents != BlockMapped; }
+					// Is it mapped by extents?
+	int ClusterSize() { return (clusterSize > 0) ? clusterSize : 1; }
+					// sectors in each cluster (headers
+					//  written before there were clusters
+					//  have none recorded)
+	int NumClusters();		// clusters the file's length covers
+	void SetClusterSize(int sectors);	// For a new, empty file
+	void MoveTo(int sector, PersistentBitmap *bitMap);
+					// Point all the clusters at one run
+					//  of sectors
+	bool IsInline() { return numSectors == InlineSectors; }
+					// Is the data in the header?
+	bool IsCompressed() { return (flags & HdrCompressed) != 0; }
+					// Are its sectors compressed chunks?
+	int StoredSectors();		// sectors its data takes, as stored
+	void MakeCompressed(int length, int storedBytes);
+					// Make the (new, empty) file
+					//  "length" bytes, compressed into
+					//  "storedBytes"
+	void Uncompress();		// Make it an ordinary file of holes,
+					//  once its sectors are given back
+	void MakeInline();		// Keep the (new, empty) file's data
+					//  in the header
+	void Uninline(char *saved);	// Copy the data out to "saved", and
+					//  make it an ordinary file of holes
+	int AllocSectors(PersistentBitmap *bitMap, int count);
+					// next "count" sectors of the extent
+	int *FindSlot(int cluster, PersistentBitmap *bitMap, 
+			class Indirect **indirect, int *indirectSector);
+					// where a cluster's sector is recorded
+	void SetSlot(int cluster, int sector, PersistentBitmap *bitMap);
+					// record it there
+	int FindExtent(int cluster);	// the extent it would be in
+	bool AddExtent(int cluster, int sector);
+					// map a cluster, if there is room
+	bool ToBlocks(PersistentBitmap *bitMap, int cluster, int sector);
+					// change over to index blocks, then
+					//  map a cluster
+	void ToExtents(PersistentBitmap *bitMap);
+					// change back, if it can be
+	bool CutExtent(int e, int cluster);
+					// make a cluster of an extent a hole
+	bool Remap(int cluster, int sector, PersistentBitmap *bitMap);
+					// move a cluster to other sectors
+	int IndexBlocks();		// how many index blocks it has
+	void CloneFrom(FileHeader *src, PersistentBitmap *bitMap);
+					// map the same sectors as "src"
+	
+	// in-core cache of the index blocks
+	class Indirect *SingleIndirect();	// the single indirect block
+	class Indirect *DoubleIndirect();	// the double indirect block
+	class Indirect *DoubleChild(int i);	// its "i"th single indirect block
+	void FlushIndirectCache();		// forget all cached index blocks
  public:
 	
 	/*
@@ -79,22 +218,49 @@ class FileHeader {
 		In order to implement a data structure, you will need to add some "in-core" data
 		to maintain data structure.
 		
-		Disk Part - numBytes, numSectors, dataSectors occupy exactly 128 bytes and will be
-		written to a sector on disk.
-		In-core part - none
+		Disk Part - numBytes, numSectors, numExtents, dataSectors (or
+		extents or inlineData), clusterSize, flags, singleIndirectSector,
+		doubleIndirectSector occupy
+		exactly 128 bytes and will be written to a sector on disk.
+		In-core part - the cached index blocks below; they must stay after
+		the disk part, since FetchFrom/WriteBack transfer the first SectorSize
+		bytes of this object.
 		
 	*/
 	
     int numBytes;			// Number of bytes in the file
-    int numSectors;			// Number of data sectors in the file
-    int dataSectors[NumDirect];		// Disk sector numbers for each data 
-					// block in the file
+    int numSectors;			// Number of data sectors in the file,
+					// or InlineSectors
+    int numExtents;			// entries in "extents", or BlockMapped
+    union {
+	int dataSectors[NumDirect];	// Disk sector numbers of the first
+					// sector of each cluster in the file
+	Extent extents[MaxExtents];	// or where its runs of clusters are
+	char inlineData[MaxInlineSize];	// or the file's data, if inline
+    };
 					
 	// in-core part
 	
-	int headerSector;
+	short clusterSize;			// sectors per cluster
+	short flags;				// HdrCompressed, or 0
 	int singleIndirectSector;
 	int doubleIndirectSector;
+	
+	// in-core part
+	
+	class Indirect *singleCache;		// single indirect block, once read
+	class Indirect *doubleCache;		// double indirect block, once read
+	class Indirect *doubleChildCache[NumIndirect];
+						// single indirect blocks of the
+						// double indirect block, once read
+	int allocNext;				// next sector of the extent being
+						// handed out by AllocSectors, or -1
+	int allocWant;				// sectors Allocate still needs
+	int openSector;				// where it came from, if Acquired
+	int openCount;				// number of Acquire's not Released
+	int numAcquires;			// number of Acquire's ever, to see
+						//  whether anyone else has used it
+	bool shared;				// in the table of open headers?
 };
 
 class Indirect {
@@ -107,6 +273,8 @@ class Indirect {
 	~Indirect() {
 		numSectors = 0;
 	}
+	static void *operator new(size_t size);	// from a pool of them,
+	static void operator delete(void *p);	// not the heap
 	public:
 		int numSectors;
 		int dataSectors[NumIndirect];
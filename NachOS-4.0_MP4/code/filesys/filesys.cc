@@ -28,16 +28,18 @@
 //	modified part of the directory and/or bitmap, we simply discard
 //	the changed version, without writing it back to disk.
 //
+//	The writes made by each such operation are one transaction in
+//	the journal (cf. journal.h), kept on the last track of the disk,
+//	so that they all reach the disk or none do, even if Nachos exits
+//	part way through.
+//
 // 	Our implementation at this point has the following restrictions:
 //
 //	   there is no synchronization for concurrent accesses
 //	   files have a fixed size, set when the file is created
 //	   files cannot be bigger than about 3KB in size
-//	   there is no hierarchical directory structure, and only a limited
-//	     number of files can be added to the system
-//	   there is no attempt to make the system robust to failures
-//	    (if Nachos exits in the middle of an operation that modifies
-//	    the file system, it may corrupt the disk)
+//	   only file system metadata is journaled; file data being
+//	    written when Nachos exits may be lost
 //
 // Copyright (c) 1992-1993 The Regents of the University of California.
 // All rights reserved.  See copyright.h for copyright notice and limitation 
@@ -51,6 +53,13 @@
 #include "pbitmap.h"
 #include "filehdr.h"
 #include "filesys.h"
+#include "synchdisk.h"
+#include "journal.h"
+#include "checksum.h"
+#include "freetree.h"
+#include "refcount.h"
+#include "pool.h"
+#include "main.h"
 
 // Sectors containing the file headers for the bitmap of free sectors,
 // and the directory of files.  These file headers are placed in well-known 
@@ -58,12 +67,60 @@
 #define FreeMapSector 		0
 #define DirectorySector 	1
 
-// Initial file sizes for the bitmap and directory; until the file system
-// supports extensible files, the directory size sets the maximum number 
-// of files that can be loaded onto the disk.
+// The journal takes up the last track of the disk.
+#define JournalSectors		SectorsPerTrack
+#define JournalSector		(NumSectors - JournalSectors)
+
+// A disk formatted with checksums keeps them on the tracks before it:
+// one, on the default disk, and as many as it takes on a bigger one.
+#define ChecksumSectors		(SectorsPerTrack * divRoundUp(NumSectors, \
+				    SectorsPerTrack * ChecksumsPerSector))
+#define ChecksumSector		(JournalSector - ChecksumSectors)
+
+// The free tree area goes before them, taking as many tracks as the
+// free map does sectors -- one, on the default disk.
+#define FreeTreeSectors		(SectorsPerTrack * divRoundUp(FreeMapFileSize, \
+				    SectorSize))
+#define FreeTreeSector		(ChecksumSector - FreeTreeSectors)
+
+// Most shared clusters a write copies in one transaction
+#define UnshareBatch		8
+
+// The reference counts go just before that: a header, and a byte for
+// each sector of the disk.
+#define RefCountSectors		(1 + divRoundUp(NumSectors, SectorSize))
+#define RefCountSector		(FreeTreeSector - RefCountSectors)
+
+// Initial file size for the bitmap; a directory starts out
+// DirectoryFileSize bytes long, and grows as files are added to it.
 #define FreeMapFileSize 	(NumSectors / BitsInByte)
-#define NumDirEntries 		64
-#define DirectoryFileSize 	(sizeof(DirectoryEntry) * NumDirEntries)
+
+static void JoinPath(char folder[][FileNameMaxLen + 1], int n, char *path);
+
+//----------------------------------------------------------------------
+// PinFile
+// 	Keep the header and data sectors of a file that is used on
+//	nearly every file system operation (the free map or the root
+//	directory) resident in the disk buffer cache.  Stops at the first
+//	sector the cache won't pin (see SynchDisk::Pin), so that a large
+//	file takes no more than its share of the cache.
+//
+//	"sector" is the disk sector holding the file's header
+//----------------------------------------------------------------------
+
+static void
+PinFile(int sector)
+{
+    FileHeader *hdr = new FileHeader;
+    bool pinned = kernel->synchDisk->Pin(sector);
+
+    hdr->FetchFrom(sector);
+    for (int offset = 0; pinned && offset < hdr->FileLength();
+		offset += SectorSize)
+	if (hdr->ByteToSector(offset) != -1)
+	    pinned = kernel->synchDisk->Pin(hdr->ByteToSector(offset));
+    delete hdr;
+}
 
 //----------------------------------------------------------------------
 // FileSystem::FileSystem
@@ -73,17 +130,51 @@
 //	not all of the sectors marked as free).  
 //
 //	If format = FALSE, we just have to open the files
-//	representing the bitmap and the directory.
+//	representing the bitmap and the directory, once any transaction
+//	left in the journal has been replayed.  A disk that was formatted
+//	with another on-disk format (see FormatVersion in journal.h) can't
+//	be read; Nachos says to reformat it, and exits.
+//
+//	Either way, the bitmap is then kept in memory while Nachos runs;
+//	each operation writes back only the sectors of it that it changed.
+//
+//	The cluster size is chosen when the disk is formatted, and kept
+//	in the header of the bitmap file (whose own data is in clusters
+//	of that size).  So is whether the disk keeps a checksum of each
+//	sector (cf. checksum.h); if it does, every sector read from then
+//	on is checked.
 //
 //	"format" -- should we initialize the disk?
+//	"placement" -- where to put new files and directories
+//	"clusterSectors" -- sectors per cluster, if formatting
+//	"withChecksums" -- reserve a checksum area, if formatting
 //----------------------------------------------------------------------
 
-FileSystem::FileSystem(bool format)
+FileSystem::FileSystem(bool format, PlacementPolicy placement, int clusterSectors,
+			bool withChecksums)
 { 
     DEBUG(dbgFile, "Initializing the file system.");
+    policy = placement;
+    clusterSize = clusterSectors;
+    for (int i = 0; i < PathCacheSize; i++)
+	pathCache[i].valid = FALSE;
+    for (int i = 0; i < NumSectors; i++)
+	access[i] = NULL;
+    journal = new Journal(JournalSector, JournalSectors);
+    freeTree = new FreeExtentTree(FreeTreeSector, FreeTreeSectors);
+    refs = new BlockRefs(RefCountSector, RefCountSectors);
+    checksums = new Checksums(ChecksumSector, ChecksumSectors);
+    if (format ? withChecksums : checksums->Mount()) {
+	kernel->synchDisk->SetChecksums(checksums);
+    } else {
+	delete checksums;
+	checksums = NULL;
+    }
     if (format) {
-        PersistentBitmap *freeMap = new PersistentBitmap(NumSectors);
-        Directory *directory = new Directory(NumDirEntries);
+        freeMap = new PersistentBitmap(NumSectors);
+        freeTree->Format();
+        freeMap->SetTree(freeTree);
+        Directory *directory = new Directory;
 		FileHeader *mapHdr = new FileHeader;
 		FileHeader *dirHdr = new FileHeader;
 
@@ -93,10 +184,25 @@ FileSystem::FileSystem(bool format)
 		// (make sure no one else grabs these!)
 		freeMap->Mark(FreeMapSector);	    
 		freeMap->Mark(DirectorySector);
+		for (int i = 0; i < JournalSectors; i++)
+			freeMap->Mark(JournalSector + i);
+		journal->Format();
+		for (int i = 0; i < FreeTreeSectors; i++)
+			freeMap->Mark(FreeTreeSector + i);
+		for (int i = 0; i < RefCountSectors; i++)
+			freeMap->Mark(RefCountSector + i);
+		refs->Format();
+		if (checksums != NULL) {
+			for (int i = 0; i < ChecksumSectors; i++)
+				freeMap->Mark(ChecksumSector + i);
+			checksums->Format();
+		}
 
 		// Second, allocate space for the data blocks containing the contents
 		// of the directory and bitmap files.  There better be enough space!
 
+		mapHdr->SetClusterSize(clusterSize);
+		dirHdr->SetClusterSize(clusterSize);
 		ASSERT(mapHdr->Allocate(freeMap, FreeMapFileSize));
 		ASSERT(dirHdr->Allocate(freeMap, DirectoryFileSize));
 
@@ -130,16 +236,42 @@ FileSystem::FileSystem(bool format)
 			freeMap->Print();
 			directory->Print();
         }
-        delete freeMap; 
-		delete directory; 
+ 		delete directory; 
 		delete mapHdr; 
 		delete dirHdr;
     } else {
 		// if we are not formatting the disk, just open the files representing
 		// the bitmap and directory; these are left open while Nachos is running
+		if (!journal->Recover()) {
+			cout << "The disk was not formatted by this version of the"
+			     << " file system; reformat with -f\n";
+			Exit(1);
+		}
         freeMapFile = new OpenFile(FreeMapSector);
         directoryFile = new OpenFile(DirectorySector);
+        freeMap = new PersistentBitmap(freeMapFile, NumSectors);
+        if (!freeTree->Mount())
+			freeTree->Build(freeMap);
+        freeMap->SetTree(freeTree);
+        if (!refs->Mount()) {
+			delete refs;		// files on it can't be cloned
+			refs = NULL;
+        }
+
+        FileHeader *mapHdr = FileHeader::Acquire(FreeMapSector);
+
+        clusterSize = mapHdr->ClusterSize();	// as it was formatted
+        FileHeader::Release(mapHdr);
     }
+    freeMap->SetRefs(refs);
+    freeMap->SetBestFit(policy == BestFitPlacement);
+    if (debug->IsEnabled('f')) {
+	ASSERT(freeTree->Check(freeMap));
+	ASSERT(refs == NULL || refs->Check(freeMap));
+    }
+    DEBUG(dbgFile, "Files are allocated in clusters of " << clusterSize << " sectors.");
+    PinFile(FreeMapSector);
+    PinFile(DirectorySector);
 }
 
 //----------------------------------------------------------------------
@@ -148,20 +280,33 @@ FileSystem::FileSystem(bool format)
 //----------------------------------------------------------------------
 FileSystem::~FileSystem()
 {
+	freeTree->Unmount();
+	kernel->synchDisk->Sync();		// write back the buffer cache
+	if (checksums != NULL) {
+		checksums->Unmount();		// now that they are all known
+		kernel->synchDisk->SetChecksums(NULL);
+		delete checksums;
+	}
+	delete freeMap;				// already on disk
+	delete freeTree;
+	delete refs;
 	delete freeMapFile;
 	delete directoryFile;
+	delete journal;
+	for (int i = 0; i < NumSectors; i++)
+		delete access[i];
 }
 
 //----------------------------------------------------------------------
 // FileSystem::Create
 // 	Create a file in the Nachos file system (similar to UNIX create).
-//	Since we can't increase the size of files dynamically, we have
-//	to give Create the initial size of the file.
+//	The file starts out "initialSize" bytes long, but no data blocks
+//	are allocated: it is all a hole, reading as zeros, until it is
+//	written.  Files also grow when written past their end.
 //
 //	The steps to create a file are:
 //	  Make sure the file doesn't already exist
 //    Allocate a sector for the file header
-// 	  Allocate space on disk for the data blocks for the file
 //	  Add the name to the directory
 //	  Store the new file header on disk 
 //	  Flush the changes to the bitmap and the directory back to disk
@@ -172,7 +317,7 @@ FileSystem::~FileSystem()
 //   		file is already in directory
 //	 	no free space for file header
 //	 	no free entry for file in directory
-//	 	no free space for data blocks for the file 
+//	 	the file would be larger than MaxFileSize
 //
 // 	Note that this implementation assumes there is no concurrent access
 //	to the file system!
@@ -185,12 +330,11 @@ bool
 FileSystem::Create(char *name, int initialSize)
 {
     Directory *directory;
-    PersistentBitmap *freeMap;
     FileHeader *hdr;
 	OpenFile *openDirectoryFile;
     int sector, count = 0;
     bool success;
-	char folder[10][10];
+	char folder[MaxPathDepth][FileNameMaxLen + 1];
 
     DEBUG(dbgFile, "Creating file " << name << " size " << initialSize);
 
@@ -206,7 +350,7 @@ FileSystem::Create(char *name, int initialSize)
 		success = FALSE;
 		
 	} else {
-		directory = new Directory(NumDirEntries);
+		directory = new Directory;
 		directory->FetchFrom(openDirectoryFile);
 		
 		if (directory->Find(folder[count-1]) != -1) {
@@ -214,33 +358,47 @@ FileSystem::Create(char *name, int initialSize)
 			cout << "file is already in directory!!!\n";
 		}
 		else {	
-			freeMap = new PersistentBitmap(freeMapFile,NumSectors);
-			sector = freeMap->FindAndSet();	// find a sector to hold the file header
+			// find a sector to hold the file header
+			sector = AllocHeader(openDirectoryFile->HeaderSector(), FALSE);
 			if (sector == -1) {
 				success = FALSE;		// no free block for file header 
 				cout << "no free block for file header!!!.\n";
 			}	
-			else if (!directory->Add(folder[count-1], sector, FALSE)) {
+			else if (!directory->Add(folder[count-1], sector, FileType,
+					initialSize, (initialSize <= MaxInlineSize) ? EntryInline : 0)) {
 				success = FALSE;	// no space in directory
 				cout << "no space in directory.\n";
+				freeMap->Clear(sector);
 			}
 				
 			else {
 				hdr = new FileHeader;
-				if (!hdr->Allocate(freeMap, initialSize)) {
-					success = FALSE;	// no space on disk for data
-					cout << "no space on disk for data!!!.\n";
+				if (initialSize > MaxFileSize) {
+					success = FALSE;	// too big for a file header
+					cout << "file too large!!!.\n";
+					freeMap->Clear(sector);
 				}	
 				else {	
+					hdr->SetClusterSize(clusterSize);
+					if (initialSize <= MaxInlineSize)
+						hdr->MakeInline();	// data goes in the header
+					hdr->SetLength(initialSize);	// allocated when written
 					success = TRUE;
 					// everthing worked, flush all changes back to disk
+					journal->Begin();
 					hdr->WriteBack(sector); 		
-					directory->WriteBack(openDirectoryFile);
-					freeMap->WriteBack(freeMapFile);
+					if (!directory->WriteBack(openDirectoryFile)) {
+						success = FALSE;	// no room to grow the directory
+						cout << "no space in directory.\n";
+						freeMap->Clear(sector);
+					}
+					freeMap->WriteDirty(freeMapFile);
+					journal->Commit();
+					if (success)
+						ForgetMissing();	// the new name exists now
 				}
 				delete hdr;
 			}
-			delete freeMap;
 		}
 		delete openDirectoryFile;
 		delete directory;
@@ -250,11 +408,214 @@ FileSystem::Create(char *name, int initialSize)
     return success;
 }
 
+//----------------------------------------------------------------------
+// FileSystem::AllocateSectors
+// 	Allocate disk sectors for the holes among sectors "first" through
+//	"last" of an open file, when they are about to be written.  The
+//	header and the bitmap of free blocks are written back.  Return
+//	the first of those sectors that could not be allocated because
+//	the disk is full, or last + 1 if they all were.
+//
+//	Under TrackPlacement, new sectors follow the file's last cluster
+//	before them (or its header), so a file written in order is laid
+//	out in order.
+//
+//	"hdr" -- the file header
+//	"hdrSector" -- where the header is on disk
+//----------------------------------------------------------------------
+
+int
+FileSystem::AllocateSectors(FileHeader *hdr, int hdrSector, int first, int last)
+{
+    int near = -1;
+    int done;
+
+    if (policy == TrackPlacement) {
+	near = hdrSector + 1;
+	for (int i = first / hdr->ClusterSize() - 1; i >= 0; i--) {
+	    if (hdr->GetCluster(i) != -1) {
+		near = hdr->GetCluster(i) + hdr->ClusterSize();
+		break;
+	    }
+	}
+	if (near >= NumSectors)
+	    near = -1;
+    }
+    journal->Begin();
+    done = hdr->AllocateRange(freeMap, first, last, near);
+    hdr->WriteBack(hdrSector);
+    freeMap->WriteDirty(freeMapFile);
+    journal->Commit();
+    return done;
+}
+
+//----------------------------------------------------------------------
+// FileSystem::Uncompress
+// 	Give back the sectors of a compressed file's stream, and make it
+//	an ordinary file of the same length, all holes, for the caller to
+//	write its data back into, decompressed (see OpenFile::Expand).
+//	Return FALSE, changing nothing, if the data would not fit in an
+//	ordinary file, or on the disk.
+//
+//	The data is only in the caller's memory until it is written
+//	back: a crash in between loses it.
+//
+//	"hdr" -- the file header
+//	"hdrSector" -- where the header is on disk
+//----------------------------------------------------------------------
+
+bool
+FileSystem::Uncompress(FileHeader *hdr, int hdrSector)
+{
+    int wanted = divRoundUp(hdr->FileLength(), SectorSize);
+
+    if (wanted > (int) NumDirect)
+	wanted += 2 + divRoundUp(wanted, NumIndirect);	// index blocks, at most
+    if (hdr->FileLength() > MaxFileSize
+		|| freeMap->NumClear() + hdr->StoredSectors() < wanted)
+	return FALSE;
+    journal->Begin();
+    hdr->Deallocate(freeMap);
+    hdr->Uncompress();
+    hdr->WriteBack(hdrSector);
+    freeMap->WriteDirty(freeMapFile);
+    journal->Commit();
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// FileSystem::Unshare
+// 	Give an open file copies of its own of the clusters covering its
+//	sectors "first" through "last" that it shares with a clone, when
+//	they are about to be written.  Return the first of those sectors
+//	whose cluster could not be copied because the disk is full, or
+//	last + 1 if they all were (or none was shared).
+//
+//	As in DefragmentFile, the copies are forced out to sectors that
+//	are still free on disk before a transaction points the header at
+//	them and lets go of the old clusters -- up to UnshareBatch of
+//	them at a time, so the transaction fits in the journal.  So a
+//	crash leaves each cluster either shared still, or copied.
+//
+//	"hdr" -- the file header
+//	"hdrSector" -- where the header is on disk
+//----------------------------------------------------------------------
+
+int
+FileSystem::Unshare(FileHeader *hdr, int hdrSector, int first, int last)
+{
+    int size = hdr->ClusterSize();
+    int cluster[UnshareBatch], old[UnshareBatch];
+    int copies[UnshareBatch * MaxClusterSize];
+    int c = first / size, done = last + 1;
+    char *buf;
+
+    if (refs == NULL || refs->NumShared() == 0)
+	return last + 1;		// nothing is shared
+    buf = new char[size * SectorSize];
+    while (c <= last / size && done > last) {
+	int n = 0;
+	bool stuck = FALSE;
+
+	for (; c <= last / size && n < UnshareBatch; c++) {
+	    int from = hdr->GetCluster(c), to;
+
+	    if (from == -1 || !refs->Shared(from))
+		continue;
+	    if ((to = hdr->AllocSectors(freeMap, size)) == -1) {
+		done = max(first, c * size);	// the disk is full
+		break;
+	    }
+	    DEBUG(dbgFile, "Copying shared cluster " << c << " from " << from
+		    << " to " << to);
+	    kernel->synchDisk->ReadSectors(from, size, buf);
+	    kernel->synchDisk->WriteSectors(to, size, buf);
+	    for (int i = 0; i < size; i++)
+		copies[n * size + i] = to + i;
+	    cluster[n] = c;
+	    old[n++] = from;
+	}
+	if (n == 0)
+	    break;
+	kernel->synchDisk->Flush(copies, n * size);
+
+	journal->Begin();
+	for (int i = 0; i < n; i++) {
+	    if (!stuck && hdr->Remap(cluster[i], copies[i * size], freeMap)) {
+		freeMap->ReleaseRange(old[i], size);
+	    } else {
+		if (!stuck)			// no room for the index
+		    done = max(first, cluster[i] * size);
+		stuck = TRUE;
+		freeMap->ClearRange(copies[i * size], size);
+	    }
+	}
+	hdr->WriteBack(hdrSector);
+	freeMap->WriteDirty(freeMapFile);
+	journal->Commit();
+    }
+    delete [] buf;
+    return done;
+}
+
+//----------------------------------------------------------------------
+// FileSystem::AllocHeader
+// 	Allocate a sector for the header of a new file or directory, whose
+//	parent directory's header is at "dirSector".  Return -1 if the
+//	disk is full.
+//
+//	FirstFitPlacement -- the first free sector on the disk
+//	TrackPlacement -- a file goes on its directory's track, or the
+//		first free sector after it, so the directory, the header
+//		and (since Allocate starts the data right after the header)
+//		the first data blocks are close together.  A directory
+//		instead goes on the track with the most free sectors, to
+//		leave room for the files that will go in it.
+//	BestFitPlacement -- the shortest run of free sectors there is,
+//		filling a hole a longer file could not use
+//----------------------------------------------------------------------
+
+int
+FileSystem::AllocHeader(int dirSector, bool isDir)
+{
+    int from = dirSector - (dirSector % SectorsPerTrack);
+    int length, sector;
+
+    if (policy == FirstFitPlacement)
+	return freeMap->FindAndSet();
+
+    if (policy == BestFitPlacement) {
+	sector = freeMap->FindBestFit(1, &length);
+	if (sector != -1)
+	    freeMap->Mark(sector);
+	return sector;
+    }
+
+    if (isDir) {
+	int mostFree = -1;
+
+	for (int track = 0; track < NumTracks; track++) {
+	    int numFree = freeMap->NumClearIn(track * SectorsPerTrack,
+						SectorsPerTrack);
+
+	    if (numFree > mostFree) {
+		mostFree = numFree;
+		from = track * SectorsPerTrack;
+	    }
+	}
+    }
+    sector = freeMap->FindClearRun(1, &length, from);
+    if (sector != -1)
+	freeMap->Mark(sector);
+    DEBUG(dbgFile, "Placing header at sector " << sector << ", near " << dirSector);
+    return sector;
+}
+
 //----------------------------------------------------------------------
 // FileSystem::CreateDirectory
 //  Create a new directory in Nachos File System
-//  We just create a directory that has a fixed size
-//  Be equal to sizeof(DirectoryEntry) * NumDirEntries
+//  A new directory starts out DirectoryFileSize bytes long: an empty
+//  tree (see directory.h), which grows as files are added to it
 //  The steps to create new directory:
 //    -Parse the string (name)
 //    -Go to the bottom directory
@@ -266,60 +627,42 @@ FileSystem::Create(char *name, int initialSize)
 bool
 FileSystem::CreateDirectory(char *path)
 {
-	char folder[10][10];
-	char *cut = "/";
-	char *pch;
-	int sector, NewDirSector;
+	char folder[MaxPathDepth][FileNameMaxLen + 1];
+	int NewDirSector;
 	int count = 0;
 	bool success = TRUE;
 	
-	Directory *directory = new Directory(NumDirEntries);
-	Directory *NewDirectory = new Directory(NumDirEntries);
-	OpenFile *tempDirectory = new OpenFile(DirectorySector);
+	Directory *directory = new Directory;
+	Directory *NewDirectory = new Directory;
+	OpenFile *tempDirectory = Parse(path, TRUE, folder, &count);
 	OpenFile *NewDirectoryFile;
-	PersistentBitmap *freeMap;
     FileHeader *hdr;
 	
-	directory->FetchFrom(directoryFile);
-	pch = strtok(path, cut); // first cut
-	
-	
-	while(pch != NULL) {
-		strncpy(folder[count++], pch, FileNameMaxLen);
-		pch = strtok(NULL, cut);
-	}
-	
-	for(int i=0; i < count-1; i++) {
-		if((sector = directory->Find(folder[i])) == -1) {
-			success = FALSE;
-			break;
-		}
-		
-		if(tempDirectory != NULL) {
-			delete tempDirectory;
-			tempDirectory = NULL;
-		}
-		tempDirectory = new OpenFile(sector);
+	if(tempDirectory == NULL)
+		success = FALSE;
+	else
 		directory->FetchFrom(tempDirectory);
-	}
-	
-	freeMap = new PersistentBitmap(freeMapFile,NumSectors);
 	
 	if(!success) {
 		printf("No such directory.\n");
 		
-	} else if((NewDirSector = freeMap->FindAndSet()) == -1) {
+	} else if((NewDirSector = AllocHeader(tempDirectory->HeaderSector(), TRUE)) == -1) {
 		printf("no free block for file header!!!.\n");
 		success = FALSE;
-	} else if(!directory->Add(folder[count-1], NewDirSector, TRUE)) {
+	} else if(!directory->Add(folder[count-1], NewDirSector, DirType)) {
 		printf("no space in directory.\n");
 		success = FALSE;
+		freeMap->Clear(NewDirSector);
 	} else {
 		hdr = new FileHeader;
+		hdr->SetClusterSize(clusterSize);
 		
-		if(!hdr->Allocate(freeMap, DirectoryFileSize)) {
+		journal->Begin();
+		if(!hdr->Allocate(freeMap, DirectoryFileSize, 
+				(policy == TrackPlacement) ? NewDirSector + 1 : -1)) {
 			printf("no space on disk for data!!!.\n");
 			success = FALSE;
+			freeMap->Clear(NewDirSector);
 		} else {
 			success = TRUE;
 			// everything is done!!!
@@ -327,15 +670,21 @@ FileSystem::CreateDirectory(char *path)
 			
 			NewDirectoryFile = new OpenFile(NewDirSector);
 			NewDirectory->WriteBack(NewDirectoryFile);
-			
-			directory->WriteBack(tempDirectory);
-			freeMap->WriteBack(freeMapFile);
-			
 			delete NewDirectoryFile;
+			
+			if(!directory->WriteBack(tempDirectory)) {
+				printf("no space in directory.\n");
+				success = FALSE;	// no room to grow the directory
+				hdr->Deallocate(freeMap);
+				freeMap->Clear(NewDirSector);
+				FileHeader::Forget(NewDirSector);
+			} else
+				ForgetMissing();	// the new name exists now
+			freeMap->WriteDirty(freeMapFile);
 		}
+		journal->Commit();
 		delete hdr;
 	}
-	delete freeMap;
 	delete tempDirectory;
 	delete directory;
 	delete NewDirectory;
@@ -349,6 +698,8 @@ FileSystem::CreateDirectory(char *path)
 //	To open a file:
 //	  Find the location of the file's header, using the directory 
 //	  Bring the header into memory
+//	  Tell the open file where its entry is, to keep the size there
+//	  up to date
 //
 //	"name" -- the text name of the file to be opened
 //----------------------------------------------------------------------
@@ -356,54 +707,51 @@ FileSystem::CreateDirectory(char *path)
 OpenFile *
 FileSystem::Open(char *name)
 { 
-    Directory *directory = new Directory(NumDirEntries);
-    OpenFile *openFile = NULL;
-	OpenFile *openDirectoryFile = NULL;
-    int sector, count = 0;
-	char folder[10][10];
+    int count = 0;
+	char folder[MaxPathDepth][FileNameMaxLen + 1];
 
     DEBUG(dbgFile, "Opening file" << name);
 	
-	openDirectoryFile = Parse(name, TRUE, folder, &count);
-	
-	if(openDirectoryFile != NULL) {
-		directory->FetchFrom(openDirectoryFile);
-		sector = directory->Find(folder[count-1]); 
-		if (sector >= 0) 		
-			openFile = new OpenFile(sector);	// name was found in directory 
-	}
-	
-    delete directory;
-	delete openDirectoryFile;
-    return openFile;				// return NULL if not found
+	// resolve the whole path, through the path cache
+    OpenFile *openFile = Parse(name, FALSE, folder, &count);
+
+    if (openFile != NULL) {
+	FileAccess *a = Access(openFile->HeaderSector());
+
+	strncpy(a->name, name, MaxPathLen - 1);
+	if (count > 0)			// (the parent's path is cached now)
+	    openFile->SetEntry(LookupPath(folder, count - 1), folder[count - 1]);
+    }
+    return openFile;				// NULL if not found
 }
 
 //----------------------------------------------------------------------
-// FileSystem::Close
-//   Close an opened file
-//   
-//   "id" -- the file identity of opened file
-//   
-//   if id<=0, then we can't close it because it doesn't exist.  return 0.
-//   else close the file and return 1.
+// FileSystem::SyncEntry
+// 	Record the size and attributes of the file with its header at
+//	"sector" in its entry "name", in the directory whose header is at
+//	"dirSector", in a transaction of its own.  Return FALSE if the
+//	entry is gone (the file was removed while it was open).
 //----------------------------------------------------------------------
 
-int 
-FileSystem::Close(int id)
+bool
+FileSystem::SyncEntry(int dirSector, char *name, int sector, int size,
+		int attributes)
 {
-	OpenFile *openFile = NULL;
-	
-	if(id <= 0)
-		return 0;
+    OpenFile *dirFile = new OpenFile(dirSector);
+    Directory *directory = new Directory;
+    bool found;
 
-	openFile = (OpenFile*)(id);
-	
-	if(openFile == NULL)
-		return 0;
-	
-	delete openFile;
-	openFile = NULL;
-	return 1;
+    DEBUG(dbgFile, "Entry " << name << " now has size " << size);
+    directory->FetchFrom(dirFile);
+    found = directory->SetSize(name, sector, size, attributes);
+    if (found) {
+	journal->Begin();
+	directory->WriteBack(dirFile);	// a leaf, rewritten in place
+	journal->Commit();
+    }
+    delete directory;
+    delete dirFile;
+    return found;
 }
 
 //----------------------------------------------------------------------
@@ -424,13 +772,12 @@ bool
 FileSystem::Remove(char *name)
 { 
     Directory *directory;
-    PersistentBitmap *freeMap;
     FileHeader *fileHdr;
 	OpenFile *openDirectoryFile = NULL;
     int sector, count = 0;
-	char folder[10][10];
+	char folder[MaxPathDepth][FileNameMaxLen + 1];
     
-    directory = new Directory(NumDirEntries);
+    directory = new Directory;
 	openDirectoryFile = Parse(name, TRUE, folder, &count);
 	
 	if(openDirectoryFile == NULL) {
@@ -450,42 +797,155 @@ FileSystem::Remove(char *name)
 		fileHdr = new FileHeader;
 		fileHdr->FetchFrom(sector);
 
-		freeMap = new PersistentBitmap(freeMapFile,NumSectors);
-
 		fileHdr->Deallocate(freeMap);  		// remove data blocks
 		freeMap->Clear(sector);			// remove header block
+		FileHeader::Forget(sector);
 		directory->Remove(folder[count-1]);
 
-		freeMap->WriteBack(freeMapFile);		// flush to disk
+		journal->Begin();
+		freeMap->WriteDirty(freeMapFile);		// flush to disk
 		directory->WriteBack(openDirectoryFile);     // flush to disk
+		journal->Commit();
+		
+		char path[MaxPathLen];
+		JoinPath(folder, count, path);
+		ForgetPath(path);
 	}
     
     delete fileHdr;
 	delete openDirectoryFile;
     delete directory;
-    delete freeMap;
     return TRUE;
 } 
 
+//----------------------------------------------------------------------
+// FileSystem::Clone
+// 	Make a new file "to", with the same contents as the file "from",
+//	by giving it a header that maps the same data sectors: only the
+//	header, and any index blocks, are written.  Each file copies a
+//	shared cluster the first time it writes to it (see Unshare), and
+//	removing one leaves the data to the other.
+//
+//	The new header, its index blocks, the directory entry and the
+//	reference counts are all changed in one transaction.  Return
+//	FALSE, changing nothing, if "from" is not a file, "to" already
+//	exists, the disk has no reference counts, is full, or the
+//	transaction would be too big for the journal.
+//----------------------------------------------------------------------
+
+bool
+FileSystem::Clone(char *from, char *to)
+{
+    char folder[MaxPathDepth][FileNameMaxLen + 1];
+    int count = 0, sector, attributes, size;
+    OpenFile *dirFile;
+    Directory *directory;
+    DirectoryEntry entry;
+    FileHeader *src, *hdr;
+    bool found, success;
+
+    DEBUG(dbgFile, "Cloning file " << from << " as " << to);
+    if (refs == NULL) {
+	printf("This disk has no reference counts; format it to clone files.\n");
+	return FALSE;
+    }
+    dirFile = Parse(from, TRUE, folder, &count);
+    if (dirFile == NULL || count == 0) {
+	printf("No such file\n");
+	delete dirFile;
+	return FALSE;
+    }
+    directory = new Directory;
+    directory->FetchFrom(dirFile);
+    found = directory->FindEntry(folder[count - 1], &entry);
+    delete directory;
+    delete dirFile;
+    if (!found || entry.type != FileType) {
+	printf("No such file\n");
+	return FALSE;
+    }
+
+    count = 0;
+    dirFile = Parse(to, TRUE, folder, &count);
+    if (dirFile == NULL || count == 0) {
+	printf("No such directory.\n");
+	delete dirFile;
+	return FALSE;
+    }
+    directory = new Directory;
+    directory->FetchFrom(dirFile);
+    if (directory->Find(folder[count - 1]) != -1) {
+	printf("file is already in directory!!!\n");
+	delete directory;
+	delete dirFile;
+	return FALSE;
+    }
+
+    src = FileHeader::Acquire(entry.sector);	// as it is now, if open
+    size = src->ClusterSize();
+    success = TRUE;
+    for (int i = 0; i < src->NumClusters() && success; i++)
+	if (src->GetCluster(i) != -1 && !refs->CanShare(src->GetCluster(i), size))
+	    success = FALSE;
+    if (!success) {
+	printf("%s has too many clones.\n", from);
+    } else if (freeMap->NumClear() < 1 + src->IndexBlocks()
+		|| (sector = AllocHeader(dirFile->HeaderSector(), FALSE)) == -1) {
+	printf("no free block for file header!!!.\n");
+	success = FALSE;
+    } else {
+	for (int i = 0; i < src->NumClusters(); i++)
+	    if (src->GetCluster(i) != -1)
+		refs->Share(src->GetCluster(i), size);
+	if (refs->NumDirty() + src->IndexBlocks() + 4 > (int) MaxJournalEntries) {
+	    printf("%s is too scattered to clone in one transaction.\n", from);
+	    for (int i = 0; i < src->NumClusters(); i++)
+		if (src->GetCluster(i) != -1)
+		    refs->Drop(src->GetCluster(i), size);
+	    freeMap->Clear(sector);
+	    success = FALSE;
+	}
+    }
+    if (success) {
+	hdr = new FileHeader;
+	journal->Begin();
+	hdr->CloneFrom(src, freeMap);
+	attributes = (hdr->IsInline() ? EntryInline : 0)
+			| (hdr->IsCompressed() ? EntryCompressed : 0);
+	if (!directory->Add(folder[count - 1], sector, FileType,
+			hdr->FileLength(), attributes)
+		    || !directory->WriteBack(dirFile)) {
+	    printf("no space in directory.\n");
+	    hdr->Deallocate(freeMap);	// the references, and index blocks
+	    freeMap->Clear(sector);
+	    success = FALSE;
+	} else {
+	    hdr->WriteBack(sector);
+	}
+	freeMap->WriteDirty(freeMapFile);
+	journal->Commit();
+	if (success)
+	    ForgetMissing();		// the new name exists now
+	delete hdr;
+    }
+    FileHeader::Release(src);
+    delete directory;
+    delete dirFile;
+    return success;
+}
+
 //----------------------------------------------------------------------
 // FileSystem::Write
 //    "buffer": the pointer for written content.
 //    "size": the size of written content.
-//    "id": the identity of an opened file.
+//    "openFile": the opened file, or NULL if the id was not valid.
 //    
 //    return the number of content which has been written into file.
 //----------------------------------------------------------------------
 
 int
-FileSystem::Write(char *buffer, int size, int id)
+FileSystem::Write(char *buffer, int size, OpenFile *openFile)
 {
-	OpenFile *openFile = NULL;
-	
-	if(id <= 0)
-		return 0;
-	
-	openFile = (OpenFile*)(id);
-	
 	if(openFile == NULL)
 		return 0;
 	
@@ -496,26 +956,72 @@ FileSystem::Write(char *buffer, int size, int id)
 // FileSystem::Read
 //    "buffer": the pointer for read content.
 //    "size": the size of read content.
-//    "id": the identity of an opened file.
+//    "openFile": the opened file, or NULL if the id was not valid.
 //    
 //    return the number of content which has been read into buffer.
 //----------------------------------------------------------------------
 int
-FileSystem::Read(char *buffer, int size, int id)
+FileSystem::Read(char *buffer, int size, OpenFile *openFile)
 {
-	OpenFile *openFile = NULL;
-	
-	if(id <= 0)
-		return 0;
-	
-	openFile = (OpenFile*)(id);
-	
 	if(openFile == NULL)
 		return 0;
 	
 	return openFile->Read(buffer, size);
 }
 
+//----------------------------------------------------------------------
+// FileSystem::Seek
+//    Set the position the next Read or Write of an opened file starts
+//    at.  It may be past the end of the file; a Write there grows it.
+//
+//    "position": the new position, in bytes from the start of the file.
+//    "openFile": the opened file, or NULL if the id was not valid.
+//    
+//    return 1 on success, 0 if the file or position is not valid.
+//----------------------------------------------------------------------
+
+int
+FileSystem::Seek(int position, OpenFile *openFile)
+{
+	if(openFile == NULL || position < 0)
+		return 0;
+
+	openFile->Seek(position);
+	return 1;
+}
+
+//----------------------------------------------------------------------
+// FileSystem::WriteAt, FileSystem::ReadAt
+//    Write or read an opened file at a given position, without using
+//    or moving its Seek position, so that threads sharing one opened
+//    file don't disturb each other's place in it.
+//
+//    "buffer": the pointer for the content.
+//    "size": the size of the content.
+//    "position": where in the file to start.
+//    "openFile": the opened file, or NULL if the id was not valid.
+//    
+//    return the number of bytes written or read.
+//----------------------------------------------------------------------
+
+int
+FileSystem::WriteAt(char *buffer, int size, int position, OpenFile *openFile)
+{
+	if(openFile == NULL || position < 0)
+		return 0;
+
+	return openFile->WriteAt(buffer, size, position);
+}
+
+int
+FileSystem::ReadAt(char *buffer, int size, int position, OpenFile *openFile)
+{
+	if(openFile == NULL || position < 0)
+		return 0;
+
+	return openFile->ReadAt(buffer, size, position);
+}
+
 
 //----------------------------------------------------------------------
 // FileSystem::List
@@ -525,7 +1031,7 @@ FileSystem::Read(char *buffer, int size, int id)
 void
 FileSystem::List()
 {
-    Directory *directory = new Directory(NumDirEntries);
+    Directory *directory = new Directory;
 
     directory->FetchFrom(directoryFile);
     directory->List();
@@ -547,8 +1053,7 @@ FileSystem::Print()
 {
     FileHeader *bitHdr = new FileHeader;
     FileHeader *dirHdr = new FileHeader;
-    PersistentBitmap *freeMap = new PersistentBitmap(freeMapFile,NumSectors);
-    Directory *directory = new Directory(NumDirEntries);
+    Directory *directory = new Directory;
 
     printf("Bit map file header:\n");
     bitHdr->FetchFrom(FreeMapSector);
@@ -565,202 +1070,867 @@ FileSystem::Print()
 
     delete bitHdr;
     delete dirHdr;
-    delete freeMap;
     delete directory;
 } 
 
+//----------------------------------------------------------------------
+// FileAccess::FileAccess
+// 	Start with a file that has not been read or written.
+//----------------------------------------------------------------------
+
+FileAccess::FileAccess()
+{
+    name[0] = '\0';
+    requests = sequentials = sectors = runs = 0;
+    lastSector = -2;
+}
+
+//----------------------------------------------------------------------
+// FileAccess::Touch
+// 	Count "count" consecutive disk sectors from "sector", read or
+//	written for the file.  They continue the last run if they follow
+//	on from the last sector it covered -- in the same request or not.
+//----------------------------------------------------------------------
+
+void
+FileAccess::Touch(int sector, int count)
+{
+    if (sector != lastSector + 1)
+	runs++;
+    sectors += count;
+    lastSector = sector + count - 1;
+}
+
+//----------------------------------------------------------------------
+// FileSystem::Access
+// 	Return how the file whose header is at "hdrSector" has been read
+//	and written so far, starting to count if it hasn't been yet.
+//----------------------------------------------------------------------
+
+FileAccess *
+FileSystem::Access(int hdrSector)
+{
+    ASSERT(hdrSector >= 0 && hdrSector < NumSectors);
+    if (access[hdrSector] == NULL)
+	access[hdrSector] = new FileAccess;
+    return access[hdrSector];
+}
+
+//----------------------------------------------------------------------
+// FileSystem::PrintStats
+// 	Print how each file that was read or written was used: its
+//	requests, how many were sequential, and the disk sectors they
+//	covered, in how many runs of consecutive sectors.  Files are
+//	named by the path they were opened by, or their header sector.
+//	Then print how many of each kind of object the file system made
+//	(see pool.h).
+//----------------------------------------------------------------------
+
+void
+FileSystem::PrintStats()
+{
+    for (int i = 0; i < NumSectors; i++) {
+	FileAccess *a = access[i];
+
+	if (a == NULL || a->requests == 0)
+	    continue;
+	cout << "File ";
+	if (a->name[0] != '\0')
+	    cout << a->name;
+	else if (i == FreeMapSector)
+	    cout << "(free map)";
+	else if (i == DirectorySector)
+	    cout << "(root directory)";
+	else
+	    cout << "(header " << i << ")";
+	cout << ": requests " << a->requests << ", sequential "
+	     << a->sequentials << ", sectors " << a->sectors << " in "
+	     << a->runs << " runs\n";
+    }
+    Pool::PrintAll();
+}
+
 //----------------------------------------------------------------------
 // FileSystem::ListDirectory
-// 	List all the files or subdirectories in the directory.
+// 	List all the files or subdirectories in the directory, and if
+//	"sizes", the size of each file.  Only the directory is read.
 //----------------------------------------------------------------------
 
 void
-FileSystem::ListDirectory(char *path)
+FileSystem::ListDirectory(char *path, bool sizes)
 {
-	char folder[10][10];
-	char *cut = "/";
-	char *pch;
-	int sector, count = 0;
-	bool success = TRUE;
+	char folder[MaxPathDepth][FileNameMaxLen + 1];
+	int count = 0;
 	
-    Directory *directory = new Directory(NumDirEntries);
-	OpenFile *tempDirectory = new OpenFile(DirectorySector);
-    directory->FetchFrom(directoryFile);
-    
-	pch = strtok(path, cut);
+    Directory *directory = new Directory;
+	OpenFile *tempDirectory = Parse(path, FALSE, folder, &count);
 	
-	while(pch != NULL) {
-		strncpy(folder[count++], pch, FileNameMaxLen);
-		pch = strtok(NULL, cut);
-	}
-	
-	for(int i=0; i < count; i++) {
-		if((sector = directory->Find(folder[i])) == -1) {
-			success = FALSE;
-			break;
-		}
-		
-		if(tempDirectory != NULL) {
-			delete tempDirectory;
-			tempDirectory = NULL;
-		}
-		tempDirectory = new OpenFile(sector);
+	if(tempDirectory != NULL) {
 		directory->FetchFrom(tempDirectory);
-	}
-	
-	if(success)
-		directory->List();
-	else 
+		directory->List(sizes);
+	} else 
 		printf("No such directory\n");
 	
 	delete tempDirectory;
     delete directory;
 }
 
+//----------------------------------------------------------------------
+// Walking a tree of directories
+//	RecurListDirectory and RecurRemoveDirectory first read the whole
+//	tree under a directory into memory, a level at a time, WalkBatch
+//	directories at once: the headers of a batch are prefetched
+//	together, in sector order, then the sectors of the directory
+//	files, and only then read.  So the disk sees sorted runs of
+//	requests it can serve in one sweep, rather than one directory's
+//	header and nodes at a time.
+//----------------------------------------------------------------------
+
+#define WalkBatch	16		// directories (or headers) read
+					// at once on a walk
+
+// A directory met on a walk: its entries, in the order Directory::Next
+// gives them, and for each that is a directory, what is in that.
+
+class TreeDir {
+  public:
+    TreeDir(int hdrSector) { sector = hdrSector; numEntries = 0;
+			entries = NULL; children = NULL; }
+    ~TreeDir();
+
+    int sector;				// its header
+    int numEntries;
+    DirectoryEntry *entries;
+    TreeDir **children;			// NULL for each entry that is a file
+};
+
+TreeDir::~TreeDir()
+{
+    for (int i = 0; i < numEntries; i++)
+	delete children[i];
+    delete [] children;
+    delete [] entries;
+}
+
+static int
+CompareSectors(int a, int b)
+{
+    return a - b;
+}
+
+//----------------------------------------------------------------------
+// PrefetchSorted
+// 	Start reading the sectors in "sectors", in order, into the disk
+//	cache, up to as many as it can hold at once; empty the list.
+//----------------------------------------------------------------------
+
+static void
+PrefetchSorted(SortedList<int> *sectors)
+{
+    for (int n = 0; !sectors->IsEmpty(); n++) {
+	int sector = sectors->RemoveFront();
+
+	if (n < NumCacheBuffers / 2)
+	    kernel->synchDisk->Prefetch(sector);
+    }
+}
+
+//----------------------------------------------------------------------
+// ReadTreeDirs
+// 	Read the "n" directories in "batch", adding the subdirectories
+//	in them to "next", the next level of the walk.
+//----------------------------------------------------------------------
+
+static void
+ReadTreeDirs(TreeDir **batch, int n, List<TreeDir *> *next)
+{
+    SortedList<int> *sectors = new SortedList<int>(CompareSectors);
+    FileHeader *hdr = new FileHeader;
+    DirectoryEntry entry;
+    int i, j;
+
+    for (i = 0; i < n; i++)
+	sectors->Insert(batch[i]->sector);
+    PrefetchSorted(sectors);		// the headers
+    for (i = 0; i < n; i++) {
+	hdr->FetchFrom(batch[i]->sector);
+	for (int offset = 0; offset < hdr->FileLength(); offset += SectorSize)
+	    if (hdr->ByteToSector(offset) != -1)
+		sectors->Insert(hdr->ByteToSector(offset));
+    }
+    PrefetchSorted(sectors);		// the directory files
+    for (i = 0; i < n; i++) {
+	TreeDir *dir = batch[i];
+	OpenFile *file = new OpenFile(dir->sector);
+	Directory *directory = new Directory;
+	bool more;
+
+	directory->FetchFrom(file);
+	for (more = directory->Next(NULL, &entry); more;
+				more = directory->Next(entry.name, &entry))
+	    dir->numEntries++;
+	dir->entries = new DirectoryEntry[dir->numEntries];
+	dir->children = new TreeDir *[dir->numEntries];
+	for (j = 0, more = directory->Next(NULL, &entry); more;
+			j++, more = directory->Next(entry.name, &entry)) {
+	    dir->entries[j] = entry;
+	    dir->children[j] = NULL;
+	    if (entry.type == DirType) {
+		dir->children[j] = new TreeDir(entry.sector);
+		next->Append(dir->children[j]);
+	    }
+	}
+	delete directory;
+	delete file;
+    }
+    delete hdr;
+    delete sectors;
+}
+
+//----------------------------------------------------------------------
+// WalkTree
+// 	Read the whole tree of directories under the one whose header is
+//	at "sector" into memory, a level at a time.
+//----------------------------------------------------------------------
+
+static TreeDir *
+WalkTree(int sector)
+{
+    TreeDir *root = new TreeDir(sector);
+    List<TreeDir *> *level = new List<TreeDir *>;
+
+    level->Append(root);
+    while (!level->IsEmpty()) {
+	List<TreeDir *> *next = new List<TreeDir *>;
+
+	while (!level->IsEmpty()) {
+	    TreeDir *batch[WalkBatch];
+	    int n = 0;
+
+	    while (n < WalkBatch && !level->IsEmpty())
+		batch[n++] = level->RemoveFront();
+	    ReadTreeDirs(batch, n, next);
+	}
+	delete level;
+	level = next;
+    }
+    delete level;
+    return root;
+}
+
+//----------------------------------------------------------------------
+// PrintTree
+// 	List the directory "dir" walked, and everything under it,
+//	indented by "indent_level", with the size of each file if
+//	"sizes".
+//----------------------------------------------------------------------
+
+static void
+PrintTree(TreeDir *dir, int indent_level, bool sizes)
+{
+	for(int i = 0; i < dir->numEntries; i++) {
+		char *name = dir->entries[i].name;
+		
+		if(dir->children[i] == NULL && sizes) {
+			printf("%*s %s %d\n", 2*indent_level + (int) strlen(name), name,
+				"[F]", dir->entries[i].size);
+		} else if(dir->children[i] == NULL) {
+			printf("%*s %s\n", 2*indent_level + (int) strlen(name), name, "[F]");
+		} else {
+			printf("%*s %s\n", 2*indent_level + (int) strlen(name), name, "[D]");
+			PrintTree(dir->children[i], indent_level + 1, sizes);
+		}
+	}
+	if(dir->numEntries == 0) {
+		printf("%*s\n", 2*indent_level + (int) strlen("Empty Folder"), "Empty Folder");
+	}
+}
+
+//----------------------------------------------------------------------
+// CollectHeaders
+// 	Add the header sectors of everything under the directory "dir"
+//	walked to "headers".
+//----------------------------------------------------------------------
+
+static void
+CollectHeaders(TreeDir *dir, SortedList<int> *headers)
+{
+	for(int i = 0; i < dir->numEntries; i++) {
+		headers->Insert(dir->entries[i].sector);
+		if(dir->children[i] != NULL)
+			CollectHeaders(dir->children[i], headers);
+	}
+}
+
 //----------------------------------------------------------------------
 // FileSystem::RecurListDirectory
-// 	Recursively list all the files or subdirectories in the directory.
+// 	Recursively list all the files or subdirectories in the directory,
+//	and if "sizes", the size of each file.  The walk reads only the
+//	headers and files of the directories, never a file's header.
 //----------------------------------------------------------------------
 
 void
-FileSystem::RecurListDirectory(char *path)
+FileSystem::RecurListDirectory(char *path, bool sizes)
 {
-	Directory *directory;
 	OpenFile *openDirectoryFile = NULL;
-    int sector, count = 0;
-	char folder[10][10];
-    
-    directory = new Directory(NumDirEntries);
-	openDirectoryFile = Parse(path, FALSE, folder, &count);
+	int count = 0;
+	char folder[MaxPathDepth][FileNameMaxLen + 1];
 	
+	openDirectoryFile = Parse(path, FALSE, folder, &count);
 	
 	if(openDirectoryFile == NULL) {
-		delete directory;
 		printf("No such directory.\n");
 		return;
-	} else {
-		directory->FetchFrom(openDirectoryFile);
-		directory->RecurList(0);
 	}
-	delete directory;
+	TreeDir *tree = WalkTree(openDirectoryFile->HeaderSector());
+	
+	PrintTree(tree, 0, sizes);
+	delete tree;
 	delete openDirectoryFile;
-	return;
 }
 
 //----------------------------------------------------------------------
 // FileSystem::RecurRemoveDirectory
 // 	Recursively remove all the files or subdirectories in the directory.
+//	Return FALSE if there is no such directory.
+//
+//	The tree is walked first (see WalkTree); then the headers of
+//	everything in it are read in sector order, WalkBatch at a time,
+//	and their sectors cleared in the free map in memory.  The
+//	directories under the one removed are never written, since they
+//	go too: there is one transaction at the end, writing the free map
+//	and the parent directory.
 //----------------------------------------------------------------------
+
 bool
 FileSystem::RecurRemoveDirectory(char *name) 	
 {
-	Directory *directory = new Directory(NumDirEntries);
-	PersistentBitmap *freeMap;
-    FileHeader *fileHdr;
+	Directory *directory = new Directory;
 	OpenFile *openDirectoryFile = NULL;
-	OpenFile *openRemoveDirectory = NULL;
-	int sector, count = 0;
-	char folder[10][10];
+	DirectoryEntry entry;
+	int count = 0;
+	char folder[MaxPathDepth][FileNameMaxLen + 1];
 	
 	openDirectoryFile = Parse(name, TRUE, folder, &count);
-	
-	ASSERT(openDirectoryFile != NULL);
-
+	if(openDirectoryFile == NULL || count == 0) {
+		printf("No such directory\n");
+		delete directory;
+		delete openDirectoryFile;
+		return FALSE;
+	}
 	directory->FetchFrom(openDirectoryFile);
 	
-	sector = directory->Find(folder[count - 1]);
+	if(!directory->FindEntry(folder[count - 1], &entry)) {
+		printf("No such directory\n");
+		delete directory;
+		delete openDirectoryFile;
+		return FALSE;
+	}
+	if(entry.type != DirType) {
+		delete directory;
+		delete openDirectoryFile;
+		return Remove(name);		// just a file
+	}
+	
+	TreeDir *tree = WalkTree(entry.sector);
+	SortedList<int> *headers = new SortedList<int>(CompareSectors);
+	FileHeader *fileHdr = new FileHeader;
 	
-	if(sector != -1) {
-		openRemoveDirectory = new OpenFile(sector);
-		directory->FetchFrom(openRemoveDirectory);
+	CollectHeaders(tree, headers);
+	headers->Insert(entry.sector);
+	delete tree;
+	while(!headers->IsEmpty()) {
+		int batch[WalkBatch];
+		int n = 0;
 		
-		fileHdr = new FileHeader;
-		fileHdr->FetchFrom(sector);
+		while(n < WalkBatch && !headers->IsEmpty()) {
+			batch[n] = headers->RemoveFront();
+			kernel->synchDisk->Prefetch(batch[n++]);
+		}
+		for(int i = 0; i < n; i++) {
+			fileHdr->FetchFrom(batch[i]);
+			fileHdr->Deallocate(freeMap);  	// remove data blocks
+			freeMap->Clear(batch[i]);		// remove header block
+			FileHeader::Forget(batch[i]);
+		}
+	}
+	delete fileHdr;
+	delete headers;
+	
+	directory->Remove(folder[count-1]);
+	
+	journal->Begin();
+	freeMap->WriteDirty(freeMapFile);
+	directory->WriteBack(openDirectoryFile);
+	journal->Commit();
+	
+	char path[MaxPathLen];
+	JoinPath(folder, count, path);
+	ForgetPath(path);
+	
+	delete directory;
+	delete openDirectoryFile;
+	return TRUE;
+}
+
+//----------------------------------------------------------------------
+// CountRuns
+// 	Return how many runs of consecutive disk sectors the data of the
+//	file with header "hdr" is in, and set "numData" to the number of
+//	data sectors it has -- all those of its clusters (holes don't
+//	count, nor break a run).
+//----------------------------------------------------------------------
 
-		freeMap = new PersistentBitmap(freeMapFile,NumSectors);
+static int
+CountRuns(FileHeader *hdr, int *numData)
+{
+	int runs = 0, last = -2;
 	
-		for(int i=0; i<NumDirEntries; i++) {
-			if(directory->inUseIndex(i)) {
-				char str[100];
-				strcpy(str, name);
-				strcat(str, "/");
-				strcat(str, directory->getIndexName(i));
-				
-				if(!directory->isDirectory(i)) {
-					Remove(str);
-				} else {
-					RecurRemoveDirectory(str);
-				}
-			}
+	*numData = 0;
+	for (int i = 0; i < hdr->NumClusters(); i++) {
+		int sector = hdr->GetCluster(i);
+		
+		if (sector == -1)
+			continue;		// a hole
+		if (sector != last + 1)
+			runs++;
+		last = sector + hdr->ClusterSize() - 1;
+		*numData += hdr->ClusterSize();
+	}
+	return runs;
+}
+
+//----------------------------------------------------------------------
+// FileSystem::PrintFragmentation
+// 	Print how scattered the data of the "n" files whose headers are
+//	in "headers" is -- the score is the average number of runs of
+//	sectors a file with data is in, 1.00 if none is split -- and
+//	how scattered the free space is.
+//----------------------------------------------------------------------
+
+void
+FileSystem::PrintFragmentation(char *when, int *headers, int n)
+{
+	FileHeader *hdr = new FileHeader;
+	int files = 0, split = 0, sectors = 0, runs = 0;
+	int freeRuns = 0, freeLargest = 0, length = 0;
+	
+	for (int i = 0; i < n; i++) {
+		int numData, r;
+		
+		hdr->FetchFrom(headers[i]);
+		r = CountRuns(hdr, &numData);
+		if (numData == 0)
+			continue;
+		files++;
+		sectors += numData;
+		runs += r;
+		if (r > 1)
+			split++;
+	}
+	delete hdr;
+	for (int i = 0; i <= NumSectors; i++) {
+		if (i < NumSectors && !freeMap->Test(i)) {
+			length++;
+			continue;
 		}
-		fileHdr->Deallocate(freeMap);  		// remove data blocks
-		freeMap->Clear(sector);			// remove header block
+		if (length > 0)
+			freeRuns++;
+		freeLargest = max(freeLargest, length);
+		length = 0;
+	}
+	int score = (files > 0) ? runs * 100 / files : 100;
+	
+	printf("Fragmentation %s: %d of %d files split, %d sectors in %d runs, "
+		"score %d.%02d; free space in %d runs, largest %d\n", when, split,
+		files, sectors, runs, score / 100, score % 100, freeRuns, freeLargest);
+}
+
+//----------------------------------------------------------------------
+// FileSystem::DefragmentFile
+// 	Move the data of the file whose header is at "hdrSector" into one
+//	run of free sectors, if it is in more than one.  Return 1 if it
+//	was moved, 0 if it didn't need to be, or -1 if there is no run of
+//	free sectors long enough (or its index blocks would not all fit
+//	in one transaction).
+//
+//	The data is copied first, to sectors that are still free on disk,
+//	and forced out to them; then one transaction points the header
+//	and index blocks at the copy and swaps the sectors in the free
+//	map.  So if Nachos stops part way, the file is either all in its
+//	old place or all in its new one.  The header is the one shared by
+//	everyone who has the file open, so they follow it there.  Clusters
+//	it shared with a clone are left to the clone; the copy is its own.
+//
+//	If "giveWay", other threads may be running while the data is
+//	copied, so the free run is marked in use first, in a transaction
+//	of its own, for no one else to be given it meanwhile (if Nachos
+//	stops before the move commits, it stays marked, unused).  And the
+//	file is left where it is, returning -1, if anyone else has it
+//	open, or opens or removes it before the copy is done, since what
+//	they write goes to the old sectors.
+//----------------------------------------------------------------------
+
+int
+FileSystem::DefragmentFile(int hdrSector, bool giveWay)
+{
+	FileHeader *hdr = FileHeader::Acquire(hdrSector);
+	int numClusters = hdr->NumClusters();
+	int numData, start, length, next, i, j, acquires;
+	char buf[SectorSize];
+	
+	if (giveWay && hdr->openCount > 1) {
+		FileHeader::Release(hdr);
+		return -1;
+	}
+	if (CountRuns(hdr, &numData) <= 1) {
+		FileHeader::Release(hdr);
+		return 0;
+	}
+	start = freeMap->FindRun(numData, &length, (hdrSector + 1) % NumSectors);
+	if (start == -1 || length < numData || (hdr->doubleIndirectSector != -1
+			&& hdr->DoubleIndirect()->numSectors + 4 > (int) MaxJournalEntries)) {
+		FileHeader::Release(hdr);
+		return -1;
+	}
+	DEBUG(dbgFile, "Moving the " << numData << " sectors of file " << hdrSector
+		<< " to " << start);
+	if (giveWay) {
+		journal->Begin();
+		freeMap->MarkRange(start, numData);
+		freeMap->WriteDirty(freeMapFile);
+		journal->Commit();
+	}
+	acquires = hdr->numAcquires;
+	
+	for (i = 0, next = start; i < numClusters; i++) {
+		int sector = hdr->GetCluster(i);
 		
-		directory->FetchFrom(openDirectoryFile);
-		directory->Remove(folder[count-1]);
+		if (sector == -1)
+			continue;
+		for (j = 0; j < hdr->ClusterSize(); j++) {
+			kernel->synchDisk->ReadSector(sector + j, buf);
+			kernel->synchDisk->WriteSector(next++, buf);
+		}
+	}
+	kernel->synchDisk->Sync();	// the copy is on disk before anything
+					// points at it
+	if (giveWay && (!hdr->shared || hdr->numAcquires != acquires)) {
+		DEBUG(dbgFile, "File " << hdrSector << " was used while it was copied");
+		journal->Begin();
+		freeMap->ReleaseRange(start, numData);
+		freeMap->WriteDirty(freeMapFile);
+		journal->Commit();
+		FileHeader::Release(hdr);
+		return -1;
+	}
+	
+	journal->Begin();
+	for (i = 0; i < numClusters; i++) {
+		int sector = hdr->GetCluster(i);
 		
-		freeMap->WriteBack(freeMapFile);
-		directory->WriteBack(openDirectoryFile);
+		if (sector != -1)
+			freeMap->ReleaseRange(sector, hdr->ClusterSize());
+	}
+	if (!giveWay)
+		freeMap->MarkRange(start, numData);
+	hdr->MoveTo(start, freeMap);
+	hdr->WriteBack(hdrSector);
+	freeMap->WriteDirty(freeMapFile);
+	journal->Commit();
+	FileHeader::Release(hdr);
+	return 1;
+}
+
+//----------------------------------------------------------------------
+// FileSystem::Defragment
+// 	Move the data of each file and directory in the file system (but
+//	the free map and the root directory, which stay where formatting
+//	put them) into one run of consecutive sectors, if there is room,
+//	and report how scattered the files were before and after.
+//
+//	Files are moved in order of their header sectors, each to the
+//	first run of free sectors after its header that is long enough.
+//----------------------------------------------------------------------
+
+void
+FileSystem::Defragment()
+{
+	TreeDir *tree = WalkTree(DirectorySector);
+	SortedList<int> *list = new SortedList<int>(CompareSectors);
+	int *headers;
+	int n = 0, moved = 0, stuck = 0;
+	
+	CollectHeaders(tree, list);
+	delete tree;
+	headers = new int[list->NumInList()];
+	while (!list->IsEmpty())
+		headers[n++] = list->RemoveFront();
+	delete list;
+	
+	PrintFragmentation("before", headers, n);
+	for (int i = 0; i < n; i++) {
+		int result = DefragmentFile(headers[i]);
 		
-		delete openRemoveDirectory;
-		delete fileHdr;
-		delete freeMap;
-					
-	} else {
-		printf("No such directory\n");
+		if (result > 0)
+			moved++;
+		else if (result < 0)
+			stuck++;
 	}
+	PrintFragmentation("after", headers, n);
+	printf("Moved %d files; %d could not be moved into one run\n", moved, stuck);
+	delete [] headers;
+}
+
+//----------------------------------------------------------------------
+// FileSystem::CompactNext
+// 	For the housekeeper (see housekeep.h): move the data of the first
+//	file after header sector "after", in header order, that is in
+//	more than one run, into one, as Defragment does -- but leaving it
+//	if someone else is using it (see DefragmentFile).  Set "*moved" to
+//	whether it was moved, and return its header sector, or -1 if no
+//	file after "after" is split.  The tree is walked afresh each time,
+//	since files may have come and gone since the last call.
+//----------------------------------------------------------------------
+
+int
+FileSystem::CompactNext(int after, bool *moved)
+{
+	TreeDir *tree = WalkTree(DirectorySector);
+	SortedList<int> *list = new SortedList<int>(CompareSectors);
+	int found = -1;
 	
-	delete directory;
-	delete openDirectoryFile;
+	CollectHeaders(tree, list);
+	delete tree;
+	while (!list->IsEmpty() && found == -1) {
+		int sector = list->RemoveFront();
+		int result;
+		
+		if (sector <= after)
+			continue;
+		result = DefragmentFile(sector, TRUE);
+		if (result != 0) {
+			found = sector;
+			*moved = (result > 0);
+		}
+	}
+	delete list;
+	return found;
+}
+
+//----------------------------------------------------------------------
+// FileSystem::NumUpdates
+// 	Return how many transactions have been started: if it has not
+//	gone up, the file system has not changed since.
+//----------------------------------------------------------------------
+
+int
+FileSystem::NumUpdates()
+{
+	return journal->NumBegun();
+}
+
+//----------------------------------------------------------------------
+// FileSystem::Verify
+// 	Read the whole disk, checking each sector against its checksum
+//	(each corrupt one is reported as it is found), and say how many
+//	were corrupt.
+//----------------------------------------------------------------------
+
+void
+FileSystem::Verify()
+{
+	if (checksums == NULL) {
+		printf("This disk was formatted without checksums\n");
+		return;
+	}
+	printf("Verified the disk: %d corrupt sectors\n", checksums->Verify());
 }
 
 //----------------------------------------------------------------------
 // FileSystem::Parse
-// 	Parse the path of input.
+// 	Parse the path of input.  Paths longer than MaxPathLen, or of
+//	more than MaxPathDepth parts, name nothing; each part counts only
+//	up to FileNameMaxLen characters.
 //----------------------------------------------------------------------'
 OpenFile*
-FileSystem::Parse(char *path, bool create, char folder[10][10], int *count)
+FileSystem::Parse(char *path, bool create, char folder[][FileNameMaxLen + 1], int *count)
 {
-	char pathCopy[100];
+	char pathCopy[MaxPathLen];
 	char *cut = "/";
 	char *pch;
 	int sector;
-	bool success = TRUE;
 	
+	if(strlen(path) >= MaxPathLen)
+		return NULL;			// too long to be a path
 	strcpy(pathCopy, path);
 	
-    Directory *directory = new Directory(NumDirEntries);
-	OpenFile *tempDirectory = new OpenFile(DirectorySector);
-    directory->FetchFrom(directoryFile);
-    
 	pch = strtok(pathCopy, cut);
 	
 	while(pch != NULL) {
-		strncpy(folder[(*count)++], pch, FileNameMaxLen);
+		if(*count == MaxPathDepth)
+			return NULL;		// too deep
+		strncpy(folder[*count], pch, FileNameMaxLen);
+		folder[(*count)++][FileNameMaxLen] = '\0';
 		pch = strtok(NULL, cut);
 	}
 	
-	for(int i=0; i < *count - (int)create; i++) {
-		if((sector = directory->Find(folder[i])) == -1) {
-			success = FALSE;
-			delete tempDirectory;
+	sector = LookupPath(folder, *count - (int)create);
+	if(sector == -1)
+		return NULL;
+	return new OpenFile(sector);
+}
+
+//----------------------------------------------------------------------
+// JoinPath
+// 	Put the first "n" parts of a parsed path back together, in the
+//	canonical form used as the key of the path cache.
+//----------------------------------------------------------------------
+
+static void
+JoinPath(char folder[][FileNameMaxLen + 1], int n, char *path)
+{
+	path[0] = '\0';
+	for(int i = 0; i < n; i++) {
+		strcat(path, "/");
+		strncat(path, folder[i], FileNameMaxLen);
+	}
+}
+
+//----------------------------------------------------------------------
+// HashPath
+// 	Which path cache entry a path goes in.
+//----------------------------------------------------------------------
+
+static int
+HashPath(char *path)
+{
+	unsigned h = 0;
+	
+	for(; *path != '\0'; path++)
+		h = h * 31 + (unsigned char) *path;
+	return h % PathCacheSize;
+}
+
+// How much of a directory file LookupPath queues at once, from its
+// start: enough for the header node, the root and the first leaves,
+// which are usually consecutive.
+#define LookupPrefetchSectors	16
+
+//----------------------------------------------------------------------
+// FileSystem::LookupPath
+// 	Return the sector of the file header named by the first "n" parts
+//	of a parsed path, or -1 if there is no such file.  The root
+//	directory is named by zero parts.
+//
+//	We start from the longest part of the path that is in the path
+//	cache, and read only the directories after it, remembering each
+//	step (including the names that turn out not to exist).  Each
+//	directory's nodes are queued together as soon as its header is
+//	in, so its header node, root and leaves come in one sweep --
+//	mostly one request, since they are usually consecutive -- rather
+//	than one dependent read at a time as the search gets to them.
+//----------------------------------------------------------------------
+
+int
+FileSystem::LookupPath(char folder[][FileNameMaxLen + 1], int n)
+{
+	char path[MaxPathLen];
+	int sector = DirectorySector;
+	int known;
+	
+	for(known = n; known > 0; known--) {
+		JoinPath(folder, known, path);
+		if(CachedPath(path, &sector))
 			break;
-		}
+	}
+	if(known == 0)
+		sector = DirectorySector;
+	
+	if(sector != -1 && known < n) {
+		Directory *directory = new Directory;
 		
-		if(tempDirectory != NULL) {
-			delete tempDirectory;
-			tempDirectory = NULL;
+		for(int i = known; i < n && sector != -1; i++) {
+			OpenFile *dirFile = new OpenFile(sector);
+			
+			dirFile->Prefetch(0, LookupPrefetchSectors * SectorSize);
+			directory->FetchFrom(dirFile);
+			sector = directory->Find(folder[i]);	// reads dirFile
+			delete dirFile;
+			JoinPath(folder, i + 1, path);
+			CachePath(path, sector);
 		}
-		tempDirectory = new OpenFile(sector);
-		directory->FetchFrom(tempDirectory);
+		delete directory;
 	}
+	return sector;
+}
+
+//----------------------------------------------------------------------
+// FileSystem::CachedPath
+// 	If "path" is in the path cache, set "sector" to the header it
+//	names (-1 if it names nothing) and return TRUE.
+//----------------------------------------------------------------------
+
+bool
+FileSystem::CachedPath(char *path, int *sector)
+{
+	PathCacheEntry *entry = &pathCache[HashPath(path)];
 	
-	delete directory;
+	if(!entry->valid || strcmp(entry->path, path) != 0)
+		return FALSE;
+	*sector = entry->sector;
+	return TRUE;
+}
+
+//----------------------------------------------------------------------
+// FileSystem::CachePath
+// 	Remember that "path" names the header at "sector" (or that it
+//	names nothing, if "sector" is -1), replacing whatever path was
+//	in its entry.
+//----------------------------------------------------------------------
+
+void
+FileSystem::CachePath(char *path, int sector)
+{
+	PathCacheEntry *entry = &pathCache[HashPath(path)];
 	
-	if(success)
-		return tempDirectory;
-	else 
-		return NULL;
+	entry->valid = TRUE;
+	entry->sector = sector;
+	strcpy(entry->path, path);
+}
+
+//----------------------------------------------------------------------
+// FileSystem::ForgetPath
+// 	Drop "path" and every path below it from the path cache, once
+//	the file or directory it names is removed.
+//----------------------------------------------------------------------
+
+void
+FileSystem::ForgetPath(char *path)
+{
+	int len = strlen(path);
+	
+	for(int i = 0; i < PathCacheSize; i++) {
+		PathCacheEntry *entry = &pathCache[i];
+		
+		if(entry->valid && strncmp(entry->path, path, len) == 0
+				&& (entry->path[len] == '\0' || entry->path[len] == '/'))
+			entry->valid = FALSE;
+	}
+}
+
+//----------------------------------------------------------------------
+// FileSystem::ForgetMissing
+// 	Drop every negative entry from the path cache, once a new file
+//	or directory is created.
+//----------------------------------------------------------------------
+
+void
+FileSystem::ForgetMissing()
+{
+	for(int i = 0; i < PathCacheSize; i++)
+		if(pathCache[i].valid && pathCache[i].sector == -1)
+			pathCache[i].valid = FALSE;
 }
 
 #endif // FILESYS_STUB
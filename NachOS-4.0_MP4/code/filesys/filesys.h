@@ -36,6 +36,8 @@
 #include "copyright.h"
 #include "sysdep.h"
 #include "openfile.h"
+#include "disk.h"
+#include "directory.h"
 
 #ifdef FILESYS_STUB 		// Temporarily implement file system calls as 
 				// calls to UNIX, until the real file system
@@ -66,14 +68,76 @@ class FileSystem {
 };
 
 #else // FILESYS
+class PersistentBitmap;
+class FileHeader;
+class Journal;
+class Checksums;
+class FreeExtentTree;
+class BlockRefs;
+
+// Where new file headers and data go on the disk
+enum PlacementPolicy {
+    FirstFitPlacement,		// the first free sectors on the disk
+    TrackPlacement,		// a file's header, index and first data
+				// blocks on its directory's track; each
+				// new directory on the emptiest track
+    BestFitPlacement		// the shortest run of free sectors each
+				// request fits in (see freetree.h)
+};
+
+// A path the file system has resolved recently, and the sector of the
+// header it names (-1 if there is no such file).  Paths are kept in
+// canonical form: "/a/b", with "" for the root.
+
+#define PathCacheSize	64		// number of paths remembered
+#define MaxPathDepth	16		// most parts of a path Parse handles
+#define MaxPathLen	(MaxPathDepth * (FileNameMaxLen + 1) + 1)
+					// room for that many parts, of up to
+					// FileNameMaxLen characters each
+
+class PathCacheEntry {
+  public:
+    bool valid;				// is this entry in use?
+    int sector;				// header of the file, or -1
+    char path[MaxPathLen];		// the canonical path
+};
+
+// How the sectors of one file have been read and written, for "-S":
+// how many requests there were and how many of them were sequential,
+// and how many disk sectors they covered, in how many runs of
+// consecutive sectors -- fewer runs per sector means the file's
+// placement let the disk stream it.
+
+class FileAccess {
+  public:
+    FileAccess();
+
+    void Request(bool sequential) { requests++; if (sequential) sequentials++; }
+					// count a read or write
+    void Touch(int sector, int count);	// it covered "count" consecutive
+					// disk sectors from "sector"
+
+    char name[MaxPathLen];		// the file's path, if opened by one
+    int requests;			// reads and writes of the file
+    int sequentials;			// ones that carried on from the last
+    int sectors;			// disk sectors they covered
+    int runs;				// in runs of consecutive sectors
+    int lastSector;			// the last sector covered, or -2
+};
+
 class FileSystem {
   public:
-    FileSystem(bool format);		// Initialize the file system.
+    FileSystem(bool format, PlacementPolicy placement = TrackPlacement,
+		int clusterSectors = 1, bool withChecksums = FALSE);
+					// Initialize the file system.
 					// Must be called *after* "synchDisk" 
 					// has been initialized.
     					// If "format", there is nothing on
 					// the disk, so initialize the directory
-    					// and the bitmap of free blocks.
+    					// and the bitmap of free blocks, and
+					// allocate files in clusters of
+					// "clusterSectors" sectors, keeping
+					// checksums if "withChecksums".
 	// MP4 mod tag
 	~FileSystem();
 
@@ -82,28 +146,96 @@ class FileSystem {
 
     OpenFile* Open(char *name); 	// Open a file (UNIX open)
 	
-	int Close(int id);  // Close an opened file
-
     bool Remove(char *name);  		// Delete a file (UNIX unlink)
 	
-	int Write(char *buffer, int size, int id); // Write content into file
+	int Write(char *buffer, int size, OpenFile *openFile); // Write content into file
 	
-	int Read(char *buffer, int size, int id);  // Read some content from an opened file.
+	int Read(char *buffer, int size, OpenFile *openFile);  // Read some content from an opened file.
+
+	int Seek(int position, OpenFile *openFile);	// Move an opened file's position
+
+	int WriteAt(char *buffer, int size, int position, OpenFile *openFile);
+	int ReadAt(char *buffer, int size, int position, OpenFile *openFile);
+					// Write or read at "position",
+					// leaving the file's position alone
+
+    int AllocateSectors(FileHeader *hdr, int hdrSector, int first, int last);
+					// Fill in holes of a file that is
+					// about to be written
+    bool Uncompress(FileHeader *hdr, int hdrSector);
+					// Give back a compressed file's
+					// sectors, to write it out plainly
+    int Unshare(FileHeader *hdr, int hdrSector, int first, int last);
+					// Copy the clusters of a file that
+					// it shares with a clone, before
+					// they are written
+    bool Clone(char *from, char *to);	// Make a new file sharing the data
+					// of another (see refcount.h)
 
     void List();			// List all the files in the file system
 
     void Print();			// List all the files and their contents
+
+    FileAccess *Access(int hdrSector);	// How the file with its header at
+					// "hdrSector" has been used
+    void PrintStats();			// Print that, for each file used
+
+    void Defragment();			// Move each file's data into one run
+					// of consecutive sectors
+    int CompactNext(int after, bool *moved);
+					// Do the same for the next split file
+					// no one has open, in the background
+    int NumUpdates();			// Has anything changed since?
+    void Verify();			// Check every sector against its
+					// checksum
 	
 	// functions for directory implements
 	bool CreateDirectory(char *name);
-	void ListDirectory(char *name);
-	void RecurListDirectory(char *name);
+	void ListDirectory(char *name, bool sizes = FALSE);
+	void RecurListDirectory(char *name, bool sizes = FALSE);
+					// List a directory, or the tree
+					// under it, with file sizes if
+					// "sizes"
+	bool SyncEntry(int dirSector, char *name, int sector, int size,
+			int attributes);
+					// Copy a file's size into its
+					// directory entry
 	bool RecurRemoveDirectory(char *name);
-	OpenFile* Parse(char *name, bool create, char folder[10][10], int *count);
+	OpenFile* Parse(char *name, bool create, char folder[][FileNameMaxLen + 1], int *count);
   
   private:
+   int LookupPath(char folder[][FileNameMaxLen + 1], int n);
+					// Header sector of the file named by
+					// the first "n" parts of a path
+   int DefragmentFile(int hdrSector, bool giveWay = FALSE);
+					// Move one file's data
+   void PrintFragmentation(char *when, int *headers, int n);
+					// How scattered those files are
+   bool CachedPath(char *path, int *sector);
+   void CachePath(char *path, int sector);
+   void ForgetPath(char *path);		// Drop a path, and all paths below it
+   void ForgetMissing();		// Drop every negative entry
+   PathCacheEntry pathCache[PathCacheSize];
+					// recently resolved paths
+   FileAccess *access[NumSectors];	// how each file has been used, by
+					// header sector, or NULL
+   int AllocHeader(int dirSector, bool isDir);
+					// Find a sector for a new file header
+   PlacementPolicy policy;		// where new files go on the disk
+   int clusterSize;			// sectors in each cluster of a new
+					// file, as the disk was formatted
+   Journal *journal;			// makes each update atomic
+   Checksums *checksums;		// of each sector, or NULL if the
+					// disk has none
    OpenFile* freeMapFile;		// Bit map of free disk blocks,
 					// represented as a file
+   PersistentBitmap *freeMap;		// and kept in memory (always up to
+					// date on disk once an operation's
+					// transaction commits)
+   FreeExtentTree *freeTree;		// the free map's extents, by start
+					// and by length
+   BlockRefs *refs;			// how many files share each sector,
+					// or NULL if the disk doesn't say
    OpenFile* directoryFile;		// "Root" directory -- list of 
 					// file names, represented as a file
 };
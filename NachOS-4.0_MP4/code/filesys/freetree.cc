@@ -0,0 +1,757 @@
+// freetree.cc
+//	Routines to keep the free extents of the disk in two B-trees,
+//	and to find the one that best fits a request.  See freetree.h.
+//
+//	Changes go top down: a full node is split before an insertion
+//	goes into it, and a node at the minimum is given more entries --
+//	from a sibling, or by merging with one -- before a removal goes
+//	into it.  So neither has to come back up the tree, except to set
+//	the smallest key of each node it passed through.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "freetree.h"
+#include "synchdisk.h"
+#include "main.h"
+
+//----------------------------------------------------------------------
+// Compare
+// 	Return less than, equal to or greater than 0 as "key" is before,
+//	the same as or after (a, b).
+//----------------------------------------------------------------------
+
+static int
+Compare(const int *key, int a, int b)
+{
+    if (key[0] != a)
+	return (key[0] < a) ? -1 : 1;
+    if (key[1] != b)
+	return (key[1] < b) ? -1 : 1;
+    return 0;
+}
+
+//----------------------------------------------------------------------
+// Slot
+// 	Return the last entry of "node" whose key is at or before (a, b),
+//	or -1 if they are all after it.
+//----------------------------------------------------------------------
+
+static int
+Slot(FreeTreeNode *node, int a, int b)
+{
+    int i = node->count - 1;
+
+    while (i >= 0 && Compare(node->entry[i].key, a, b) > 0)
+	i--;
+    return i;
+}
+
+//----------------------------------------------------------------------
+// FreeExtentTree::FreeExtentTree
+// 	Initialize the trees, with no extents in them, to be kept in the
+//	"numSectors" sectors starting with "firstSector".
+//----------------------------------------------------------------------
+
+FreeExtentTree::FreeExtentTree(int firstSector, int numSectors)
+{
+    ASSERT(sizeof(FreeTreeNode) == SectorSize);
+    ASSERT(sizeof(FreeTreeHeader) == SectorSize);
+    start = firstSector;
+    size = numSectors;
+    enabled = FALSE;
+    maxNodes = size;
+    node = new FreeTreeNode *[maxNodes];
+    dirty = new bool[maxNodes];
+    for (int i = 0; i < maxNodes; i++)
+	node[i] = NULL;
+    Reset();
+}
+
+FreeExtentTree::~FreeExtentTree()
+{
+    for (int i = 0; i < numNodes; i++)
+	delete node[i];
+    delete [] node;
+    delete [] dirty;
+}
+
+//----------------------------------------------------------------------
+// FreeExtentTree::Reset
+// 	Forget every node, in memory and on disk: both trees are empty.
+//----------------------------------------------------------------------
+
+void
+FreeExtentTree::Reset()
+{
+    for (int i = 0; i < maxNodes; i++) {
+	delete node[i];
+	node[i] = NULL;
+    }
+    for (int t = 0; t < NumFreeTrees; t++)
+	root[t] = -1;
+    numNodes = 0;
+    freeNodes = -1;
+    numExtents = 0;
+    onDisk = 0;
+}
+
+//----------------------------------------------------------------------
+// FreeExtentTree::Format
+// 	Start a new free tree area, with the whole disk one extent; the
+//	file system then takes the sectors it reserves.  The header says
+//	the nodes on disk are out of date until Unmount.
+//----------------------------------------------------------------------
+
+void
+FreeExtentTree::Format()
+{
+    FreeTreeHeader header;
+
+    Reset();
+    Insert(0, NumSectors);
+    bzero((char *) &header, sizeof(header));
+    header.magic = FreeTreeMagic;
+    header.clean = FALSE;
+    kernel->synchDisk->WriteSectors(start, 1, (char *) &header);
+    enabled = TRUE;
+}
+
+//----------------------------------------------------------------------
+// FreeExtentTree::Mount
+// 	When the file system is mounted: read the header, and mark the
+//	trees out of date on disk until Unmount writes them back.  The
+//	nodes are left on disk until they are needed.
+//
+//	The header has to be on disk before the free map is changed: if
+//	Nachos stopped with the old header there, claiming the trees were
+//	up to date, the next mount would believe them.
+//
+//	Returns FALSE if the trees on disk can't be used -- the last run
+//	of Nachos didn't get to Unmount, or the disk has no free tree
+//	area -- so the caller has to Build them.
+//----------------------------------------------------------------------
+
+bool
+FreeExtentTree::Mount()
+{
+    FreeTreeHeader header;
+
+    Reset();
+    kernel->synchDisk->ReadSectors(start, 1, (char *) &header);
+    if (header.magic != FreeTreeMagic) {
+	DEBUG(dbgFile, "No free tree area on this disk");
+	enabled = FALSE;
+	return FALSE;
+    }
+    enabled = TRUE;
+    if (!header.clean) {
+	DEBUG(dbgFile, "Free extent trees were not saved; rebuilding them");
+	return FALSE;
+    }
+    for (int t = 0; t < NumFreeTrees; t++)
+	root[t] = header.root[t];
+    numNodes = onDisk = header.numNodes;
+    freeNodes = header.freeNodes;
+    numExtents = header.numExtents;
+    header.clean = FALSE;
+    kernel->synchDisk->WriteSectors(start, 1, (char *) &header);
+    kernel->synchDisk->Flush(&start, 1);
+    DEBUG(dbgFile, "Free extent trees: " << numExtents << " extents in "
+	<< numNodes << " nodes");
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// FreeExtentTree::Build
+// 	Make the trees again from "freeMap": an extent for each run of its
+//	clear bits.  If the disk has a free tree area, mark it out of date.
+//----------------------------------------------------------------------
+
+void
+FreeExtentTree::Build(const Bitmap *freeMap)
+{
+    Reset();
+    for (int i = 0; i < NumSectors; ) {
+	int first = freeMap->NextClear(i, NumSectors);
+
+	if (first == NumSectors)
+	    break;
+	i = freeMap->NextSet(first, NumSectors);
+	Insert(first, i - first);
+    }
+    if (enabled) {
+	FreeTreeHeader header;
+
+	bzero((char *) &header, sizeof(header));
+	header.magic = FreeTreeMagic;
+	header.clean = FALSE;
+	kernel->synchDisk->WriteSectors(start, 1, (char *) &header);
+	kernel->synchDisk->Flush(&start, 1);
+    }
+    DEBUG(dbgFile, "Built free extent trees: " << numExtents << " extents");
+}
+
+//----------------------------------------------------------------------
+// FreeExtentTree::Unmount
+// 	Write back the nodes that have changed, then the header, marking
+//	them up to date -- unless the disk has no free tree area, or
+//	the trees no longer fit in it.
+//----------------------------------------------------------------------
+
+void
+FreeExtentTree::Unmount()
+{
+    FreeTreeHeader header;
+
+    if (!enabled)
+	return;
+    if (numNodes > size - 1) {
+	DEBUG(dbgFile, "Free extent trees take " << numNodes
+	    << " nodes; not saving them");
+	return;
+    }
+    for (int i = 0; i < numNodes; i++)
+	if (node[i] != NULL && dirty[i])
+	    kernel->synchDisk->WriteSectors(start + 1 + i, 1, (char *) node[i]);
+    bzero((char *) &header, sizeof(header));
+    header.magic = FreeTreeMagic;
+    header.clean = TRUE;
+    for (int t = 0; t < NumFreeTrees; t++)
+	header.root[t] = root[t];
+    header.numNodes = numNodes;
+    header.freeNodes = freeNodes;
+    header.numExtents = numExtents;
+    kernel->synchDisk->WriteSectors(start, 1, (char *) &header);
+}
+
+//----------------------------------------------------------------------
+// FreeExtentTree::Load
+// 	Return node "which", reading it from the free tree area if it
+//	was there when the disk was mounted and hasn't been read since.
+//----------------------------------------------------------------------
+
+FreeTreeNode *
+FreeExtentTree::Load(int which)
+{
+    ASSERT(which >= 0 && which < numNodes);
+    if (node[which] == NULL) {
+	ASSERT(which < onDisk);
+	node[which] = new FreeTreeNode;
+	dirty[which] = FALSE;
+	kernel->synchDisk->ReadSectors(start + 1 + which, 1,
+					(char *) node[which]);
+    }
+    return node[which];
+}
+
+//----------------------------------------------------------------------
+// FreeExtentTree::Change
+// 	Return node "which", as Load does, noting that it has to be
+//	written back.
+//----------------------------------------------------------------------
+
+FreeTreeNode *
+FreeExtentTree::Change(int which)
+{
+    FreeTreeNode *n = Load(which);
+
+    dirty[which] = TRUE;
+    return n;
+}
+
+//----------------------------------------------------------------------
+// FreeExtentTree::NewNode
+// 	Return an empty node for either tree: one that is no longer used,
+//	if there is one, or else the next one after all of those used.
+//----------------------------------------------------------------------
+
+int
+FreeExtentTree::NewNode(bool leaf)
+{
+    FreeTreeNode *n;
+    int which;
+
+    if (freeNodes != -1) {
+	which = freeNodes;
+	n = Change(which);
+	freeNodes = n->entry[0].child;
+    } else {
+	if (numNodes == maxNodes) {		// make room for more
+	    FreeTreeNode **newNode = new FreeTreeNode *[2 * maxNodes];
+	    bool *newDirty = new bool[2 * maxNodes];
+
+	    for (int i = 0; i < 2 * maxNodes; i++) {
+		newNode[i] = (i < maxNodes) ? node[i] : NULL;
+		newDirty[i] = (i < maxNodes) ? dirty[i] : FALSE;
+	    }
+	    delete [] node;
+	    delete [] dirty;
+	    node = newNode;
+	    dirty = newDirty;
+	    maxNodes *= 2;
+	}
+	which = numNodes++;
+	node[which] = n = new FreeTreeNode;
+	bzero((char *) n, sizeof(FreeTreeNode));
+	dirty[which] = TRUE;
+    }
+    n->leaf = leaf;
+    n->count = 0;
+    return which;
+}
+
+//----------------------------------------------------------------------
+// FreeExtentTree::FreeNode
+// 	Put node "which" on the list of nodes no longer used.
+//----------------------------------------------------------------------
+
+void
+FreeExtentTree::FreeNode(int which)
+{
+    FreeTreeNode *n = Change(which);
+
+    n->count = 0;
+    n->entry[0].child = freeNodes;
+    freeNodes = which;
+}
+
+//----------------------------------------------------------------------
+// FreeExtentTree::Insert, FreeExtentTree::Remove
+// 	Add or take out the extent of "length" sectors from "first", in
+//	both trees.
+//----------------------------------------------------------------------
+
+void
+FreeExtentTree::Insert(int first, int length)
+{
+    InsertKey(ByStart, first, length);
+    InsertKey(ByLength, length, first);
+    numExtents++;
+}
+
+void
+FreeExtentTree::Remove(int first, int length)
+{
+    RemoveKey(ByStart, first, length);
+    RemoveKey(ByLength, length, first);
+    numExtents--;
+}
+
+//----------------------------------------------------------------------
+// FreeExtentTree::Take
+// 	The free map has marked "count" sectors from "first" as in use,
+//	all of them free before: cut them out of the extent they are in,
+//	leaving what is left on either side.
+//----------------------------------------------------------------------
+
+void
+FreeExtentTree::Take(int first, int count)
+{
+    int key[2], end;
+
+    ASSERT(Floor(ByStart, first, NumSectors, key));
+    end = key[0] + key[1];
+    ASSERT(first + count <= end);
+    Remove(key[0], key[1]);
+    if (key[0] < first)
+	Insert(key[0], first - key[0]);
+    if (first + count < end)
+	Insert(first + count, end - (first + count));
+}
+
+//----------------------------------------------------------------------
+// FreeExtentTree::Give
+// 	The free map has cleared "count" sectors from "first", all of them
+//	in use before: make them an extent, joined with the extents right
+//	before and after them, if there are any.
+//----------------------------------------------------------------------
+
+void
+FreeExtentTree::Give(int first, int count)
+{
+    int key[2];
+    int end = first + count;
+
+    if (Floor(ByStart, first - 1, NumSectors, key)) {
+	ASSERT(key[0] + key[1] <= first);
+	if (key[0] + key[1] == first) {
+	    Remove(key[0], key[1]);
+	    first = key[0];
+	}
+    }
+    if (Ceiling(ByStart, end, 0, key) && key[0] == end) {
+	Remove(key[0], key[1]);
+	end += key[1];
+    }
+    Insert(first, end - first);
+}
+
+//----------------------------------------------------------------------
+// FreeExtentTree::BestFit
+// 	Return the first sector of the shortest extent of "count" sectors
+//	or more (the first such, if there are several), and set "length"
+//	to "count".  If every extent is shorter, return the longest, and
+//	set "length" to its length.  Return -1 if there are no free
+//	sectors.  Nothing is taken.
+//----------------------------------------------------------------------
+
+int
+FreeExtentTree::BestFit(int count, int *length)
+{
+    int key[2];
+
+    if (Ceiling(ByLength, count, 0, key)) {
+	*length = count;
+	return key[1];
+    }
+    if (Floor(ByLength, NumSectors, NumSectors, key)) {
+	*length = key[0];
+	return key[1];
+    }
+    *length = 0;
+    return -1;
+}
+
+//----------------------------------------------------------------------
+// FreeExtentTree::InsertKey
+// 	Add (a, b) to "tree".  A root that is full is split first, under
+//	a new root; so is each full node on the way down, so that the
+//	leaf the key ends up in has room for it.
+//----------------------------------------------------------------------
+
+void
+FreeExtentTree::InsertKey(FreeTreeIndex tree, int a, int b)
+{
+    FreeTreeNode *n;
+    int which, i;
+
+    if (root[tree] == -1) {
+	root[tree] = NewNode(TRUE);
+    } else if (Load(root[tree])->count == (int) FreeTreeEntries) {
+	int old = root[tree];
+
+	root[tree] = NewNode(FALSE);
+	n = Change(root[tree]);
+	n->entry[0].key[0] = Load(old)->entry[0].key[0];
+	n->entry[0].key[1] = Load(old)->entry[0].key[1];
+	n->entry[0].child = old;
+	n->count = 1;
+	SplitChild(root[tree], 0);
+    }
+    for (which = root[tree]; ; which = n->entry[i].child) {
+	n = Change(which);
+	i = Slot(n, a, b);
+	if (n->leaf) {
+	    for (int j = n->count; j > i + 1; j--)
+		n->entry[j] = n->entry[j - 1];
+	    n->entry[i + 1].key[0] = a;
+	    n->entry[i + 1].key[1] = b;
+	    n->entry[i + 1].child = -1;
+	    n->count++;
+	    return;
+	}
+	if (i == -1) {			// the new smallest key in the subtree
+	    i = 0;
+	    n->entry[0].key[0] = a;
+	    n->entry[0].key[1] = b;
+	}
+	if (Load(n->entry[i].child)->count == (int) FreeTreeEntries) {
+	    SplitChild(which, i);
+	    if (Compare(n->entry[i + 1].key, a, b) <= 0)
+		i++;
+	}
+    }
+}
+
+//----------------------------------------------------------------------
+// FreeExtentTree::SplitChild
+// 	Move the second half of the full child "i" of node "which" into a
+//	new node, the child after it.  "which" is not full.
+//----------------------------------------------------------------------
+
+void
+FreeExtentTree::SplitChild(int which, int i)
+{
+    FreeTreeNode *n = Change(which);
+    int left = n->entry[i].child;
+    int right = NewNode(Load(left)->leaf);
+    FreeTreeNode *l = Change(left);
+    FreeTreeNode *r = Change(right);
+    int half = FreeTreeEntries / 2;
+
+    ASSERT(l->count == (int) FreeTreeEntries
+	   && n->count < (int) FreeTreeEntries);
+    for (int j = half; j < l->count; j++)
+	r->entry[j - half] = l->entry[j];
+    r->count = l->count - half;
+    l->count = half;
+    for (int j = n->count; j > i + 1; j--)
+	n->entry[j] = n->entry[j - 1];
+    n->entry[i + 1].key[0] = r->entry[0].key[0];
+    n->entry[i + 1].key[1] = r->entry[0].key[1];
+    n->entry[i + 1].child = right;
+    n->count++;
+}
+
+//----------------------------------------------------------------------
+// FreeExtentTree::RemoveKey
+// 	Take (a, b), which has to be there, out of "tree"; then, if the
+//	root is left an inner node with one child, that child is the new
+//	root, and if it is left an empty leaf, the tree is empty.
+//----------------------------------------------------------------------
+
+void
+FreeExtentTree::RemoveKey(FreeTreeIndex tree, int a, int b)
+{
+    FreeTreeNode *n;
+
+    ASSERT(root[tree] != -1);
+    RemoveFrom(root[tree], a, b);
+    n = Load(root[tree]);
+    if (!n->leaf && n->count == 1) {
+	int old = root[tree];
+
+	root[tree] = n->entry[0].child;
+	FreeNode(old);
+    } else if (n->leaf && n->count == 0) {
+	FreeNode(root[tree]);
+	root[tree] = -1;
+    }
+}
+
+//----------------------------------------------------------------------
+// FreeExtentTree::RemoveFrom
+// 	Take (a, b) out of the subtree under node "which", which is the
+//	root or has more than the minimum of entries.  On the way back
+//	up, the smallest key of the child it was in is set again.
+//----------------------------------------------------------------------
+
+void
+FreeExtentTree::RemoveFrom(int which, int a, int b)
+{
+    FreeTreeNode *n = Change(which);
+    int i = Slot(n, a, b);
+    int child;
+
+    ASSERT(i >= 0);
+    if (n->leaf) {
+	ASSERT(Compare(n->entry[i].key, a, b) == 0);
+	for (int j = i; j < n->count - 1; j++)
+	    n->entry[j] = n->entry[j + 1];
+	n->count--;
+	return;
+    }
+    if (Load(n->entry[i].child)->count <= (int) MinTreeEntries)
+	i = FillChild(which, i);
+    child = n->entry[i].child;
+    RemoveFrom(child, a, b);
+    n->entry[i].key[0] = Load(child)->entry[0].key[0];
+    n->entry[i].key[1] = Load(child)->entry[0].key[1];
+}
+
+//----------------------------------------------------------------------
+// FreeExtentTree::FillChild
+// 	Give child "i" of node "which", which has only the minimum of
+//	entries, at least one more: an entry from a sibling that has more
+//	than the minimum, or else all of a sibling's, merging the two.
+//	Return which child of "which" now has the keys child "i" had.
+//----------------------------------------------------------------------
+
+int
+FreeExtentTree::FillChild(int which, int i)
+{
+    FreeTreeNode *n = Change(which);
+    FreeTreeNode *c = Change(n->entry[i].child);
+    FreeTreeNode *s;
+
+    if (i > 0 && Load(n->entry[i - 1].child)->count > (int) MinTreeEntries) {
+	s = Change(n->entry[i - 1].child);	// the last of the one before
+	for (int j = c->count; j > 0; j--)
+	    c->entry[j] = c->entry[j - 1];
+	c->entry[0] = s->entry[--s->count];
+	c->count++;
+	n->entry[i].key[0] = c->entry[0].key[0];
+	n->entry[i].key[1] = c->entry[0].key[1];
+	return i;
+    }
+    if (i + 1 < n->count
+	    && Load(n->entry[i + 1].child)->count > (int) MinTreeEntries) {
+	s = Change(n->entry[i + 1].child);	// the first of the one after
+	c->entry[c->count++] = s->entry[0];
+	for (int j = 0; j < s->count - 1; j++)
+	    s->entry[j] = s->entry[j + 1];
+	s->count--;
+	n->entry[i + 1].key[0] = s->entry[0].key[0];
+	n->entry[i + 1].key[1] = s->entry[0].key[1];
+	return i;
+    }
+    if (i > 0)				// merge into the one before
+	i--;
+    c = Change(n->entry[i].child);
+    s = Change(n->entry[i + 1].child);
+    ASSERT(c->count + s->count <= (int) FreeTreeEntries);
+    for (int j = 0; j < s->count; j++)
+	c->entry[c->count + j] = s->entry[j];
+    c->count += s->count;
+    FreeNode(n->entry[i + 1].child);
+    for (int j = i + 1; j < n->count - 1; j++)
+	n->entry[j] = n->entry[j + 1];
+    n->count--;
+    return i;
+}
+
+//----------------------------------------------------------------------
+// FreeExtentTree::Floor
+// 	Set "key" to the last key in "tree" at or before (a, b).  Down
+//	from the root, that is under the last entry whose smallest key is.
+//	Return FALSE if there is none.
+//----------------------------------------------------------------------
+
+bool
+FreeExtentTree::Floor(FreeTreeIndex tree, int a, int b, int *key)
+{
+    int which = root[tree];
+
+    while (which != -1) {
+	FreeTreeNode *n = Load(which);
+	int i = Slot(n, a, b);
+
+	if (i == -1)
+	    return FALSE;
+	if (n->leaf) {
+	    key[0] = n->entry[i].key[0];
+	    key[1] = n->entry[i].key[1];
+	    return TRUE;
+	}
+	which = n->entry[i].child;
+    }
+    return FALSE;
+}
+
+//----------------------------------------------------------------------
+// FreeExtentTree::Ceiling
+// 	Set "key" to the first key in "tree" at or after (a, b).  Down
+//	from the root, that is under the last entry whose smallest key is
+//	at or before (a, b), if it has one that late -- and otherwise the
+//	smallest key of the entry after that.
+//	Return FALSE if there is none.
+//----------------------------------------------------------------------
+
+bool
+FreeExtentTree::Ceiling(FreeTreeIndex tree, int a, int b, int *key)
+{
+    int which = root[tree];
+    bool found = FALSE;
+
+    while (which != -1) {
+	FreeTreeNode *n = Load(which);
+	int i = Slot(n, a, b);
+
+	if (n->leaf) {
+	    if (i >= 0 && Compare(n->entry[i].key, a, b) == 0) {
+		i--;			// the key itself
+	    }
+	    if (i + 1 < n->count) {
+		key[0] = n->entry[i + 1].key[0];
+		key[1] = n->entry[i + 1].key[1];
+		found = TRUE;
+	    }
+	    return found;
+	}
+	if (i == -1) {			// every key under here is after it
+	    key[0] = n->entry[0].key[0];
+	    key[1] = n->entry[0].key[1];
+	    return TRUE;
+	}
+	if (i + 1 < n->count) {		// the best so far
+	    key[0] = n->entry[i + 1].key[0];
+	    key[1] = n->entry[i + 1].key[1];
+	    found = TRUE;
+	}
+	which = n->entry[i].child;
+    }
+    return found;
+}
+
+//----------------------------------------------------------------------
+// FreeExtentTree::Check
+// 	Return TRUE if the trees hold the runs of clear bits of "freeMap",
+//	and nothing else: walking the tree by start, the next extent is
+//	always the next run, and is in the tree by length too.
+//----------------------------------------------------------------------
+
+bool
+FreeExtentTree::Check(const Bitmap *freeMap)
+{
+    int runs = 0, key[2], other[2];
+
+    for (int i = 0; i < NumSectors; ) {
+	int first = freeMap->NextClear(i, NumSectors);
+
+	if (first == NumSectors)
+	    break;
+	i = freeMap->NextSet(first, NumSectors);
+	if (!Ceiling(ByStart, first, 0, key) || key[0] != first
+		|| key[1] != i - first)
+	    return FALSE;
+	if (!Ceiling(ByLength, key[1], first, other) || other[0] != key[1]
+		|| other[1] != first)
+	    return FALSE;
+	runs++;
+    }
+    if (Ceiling(ByStart, NumSectors, 0, key))
+	return FALSE;
+    return runs == numExtents;
+}
+
+//----------------------------------------------------------------------
+// FreeExtentTree::SelfTest
+// 	Test whether this module is working: keep the trees of a bitmap
+//	as the bitmap is marked and cleared in a scattered pattern, deep
+//	enough to need inner nodes, and check them against it.  Done in
+//	memory only, on trees that are not a disk's.
+//----------------------------------------------------------------------
+
+void
+FreeExtentTree::SelfTest()
+{
+    Bitmap *map = new Bitmap(NumSectors);
+    int length, i;
+
+    Reset();
+    Insert(0, NumSectors);			// as Format does, in memory
+    ASSERT(Check(map));
+    for (i = 0; i < NumSectors; i += 3) {	// every third sector used
+	map->Mark(i);
+	Take(i, 1);
+    }
+    ASSERT(Check(map) && NumExtents() > (int) FreeTreeEntries);
+    ASSERT(BestFit(2, &length) == 1 && length == 2);
+    ASSERT(BestFit(3, &length) != -1 && length == 2);
+
+    map->Clear(3);				// joins 1-2 and 4-5
+    Give(3, 1);
+    ASSERT(BestFit(3, &length) == 1 && length == 3);
+    map->MarkRange(1, 5);
+    Take(1, 5);
+    ASSERT(Check(map));
+
+    for (i = 0; i < NumSectors; i += 3) {	// and back again
+	if (map->Test(i) && (i < 1 || i > 5)) {
+	    map->Clear(i);
+	    Give(i, 1);
+	}
+    }
+    ASSERT(Check(map));
+    map->ClearRange(1, 5);
+    Give(1, 5);
+    ASSERT(NumExtents() == 1 && Check(map));
+    ASSERT(BestFit(1, &length) == 0 && length == 1);
+    Take(0, NumSectors);
+    ASSERT(NumExtents() == 0 && BestFit(1, &length) == -1);
+
+    delete map;
+}
@@ -0,0 +1,160 @@
+// freetree.h
+//	Data structures for an index of the free space on the disk: every
+//	extent -- maximal run of free sectors -- kept in two B-trees, one
+//	ordered by where the extent starts and one by how long it is.
+//
+//	The free map (pbitmap.h) is still the record of which sectors are
+//	free; it is what transactions change and the journal protects.
+//	The trees follow it: each sector the free map marks or clears
+//	splits or joins the extents around it, a few entries changed in
+//	each tree.  What they add is the search.  The extent that best
+//	fits a request -- the shortest one at least that long -- is the
+//	first entry at or after it in the tree by length, found without
+//	looking at the free map at all, where Bitmap::FindClearRun looks
+//	at every run from where it starts.  The tree by start finds the
+//	neighbours a freed run joins.
+//
+//	Each node of a tree is one sector, holding up to FreeTreeEntries
+//	entries.  An entry of a leaf is an extent; an entry of an inner
+//	node is a child, with the smallest key in the child's subtree.
+//	Both trees keep their nodes in the same free tree area, a
+//	reserved range of sectors (on the track before the checksums):
+//	a header, saying where each root is, then the nodes.
+//
+//	Like the checksums (checksum.h), the trees are written back only
+//	when the file system is shut down cleanly, and until then the
+//	header says the nodes on disk are out of date.  A mount after a
+//	clean shutdown reads just the header; a node is read the first
+//	time a search or a change gets to it.  After a crash, the trees
+//	are rebuilt from the free map, which the journal has made right.
+//	So are they on a disk formatted before there was a free tree
+//	area; then they are never written back, since the sectors they
+//	would go in may belong to a file.  If the trees outgrow the area,
+//	they are not written back either, and the next mount rebuilds
+//	them.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#ifndef FREETREE_H
+#define FREETREE_H
+
+#include "copyright.h"
+#include "disk.h"
+#include "bitmap.h"
+
+#define FreeTreeMagic		0x46524545	// marks a free tree area
+
+// The two trees, and what their keys are
+
+enum FreeTreeIndex {
+    ByStart,				// (first sector, length)
+    ByLength,				// (length, first sector)
+    NumFreeTrees
+};
+
+// One entry of a node.  Keys are ordered by key[0], then key[1].
+
+class FreeTreeEntry {
+  public:
+    int key[2];
+    int child;				// the node below, for an inner node;
+					// on the free list, the next free node
+};
+
+#define FreeTreeEntries		((SectorSize - 2 * sizeof(int)) \
+				    / sizeof(FreeTreeEntry))
+#define MinTreeEntries		(FreeTreeEntries / 2)
+					// fewest a node other than the root
+					// has
+
+// A node of either tree.  Exactly one disk sector in size.
+
+class FreeTreeNode {
+  public:
+    int leaf;				// is this a leaf?
+    int count;				// entries in use
+    FreeTreeEntry entry[FreeTreeEntries];
+};
+
+// The first sector of the free tree area.  Exactly one disk sector
+// in size.
+
+class FreeTreeHeader {
+  public:
+    int magic;				// FreeTreeMagic
+    int clean;				// are the nodes after it up to date?
+    int root[NumFreeTrees];		// node at the root of each tree,
+					// or -1 if there are no extents
+    int numNodes;			// nodes ever used
+    int freeNodes;			// first node no longer used, or -1
+    int numExtents;			// entries in each tree
+    char unused[SectorSize - (5 + NumFreeTrees) * sizeof(int)];
+};
+
+// The following class keeps the free extents of the disk.
+
+class FreeExtentTree {
+  public:
+    FreeExtentTree(int firstSector, int numSectors);
+					// The trees are kept in the
+					// "numSectors" sectors from
+					// "firstSector"
+    ~FreeExtentTree();
+
+    void Format();			// Start over with the whole disk free
+    bool Mount();			// Read the header; FALSE if the
+					// trees have to be rebuilt
+    void Build(const Bitmap *freeMap);	// Rebuild them from the free map
+    void Unmount();			// Write the trees back, and mark
+					// them up to date
+
+    void Take(int first, int count);	// "count" free sectors from "first"
+					// are now in use
+    void Give(int first, int count);	// and "count" in use are now free
+    int BestFit(int count, int *length);
+					// Start of the shortest extent of
+					// "count" sectors or more, or else
+					// of the longest; -1 if none
+
+    int NumExtents() { return numExtents; }
+    bool Check(const Bitmap *freeMap);	// Do the trees hold exactly the runs
+					// of clear bits in "freeMap"?
+    void SelfTest();			// Test whether this module is working
+
+  private:
+    void Reset();			// Forget every node
+    FreeTreeNode *Load(int which);	// node "which", read in if need be
+    FreeTreeNode *Change(int which);	// and the same, to be written back
+    int NewNode(bool leaf);		// a node to add to a tree
+    void FreeNode(int which);		// put back one that is not needed
+
+    void Insert(int first, int length);	// add an extent to both trees
+    void Remove(int first, int length);	// take one out of both
+    void InsertKey(FreeTreeIndex tree, int a, int b);
+    void RemoveKey(FreeTreeIndex tree, int a, int b);
+    void RemoveFrom(int which, int a, int b);
+    void SplitChild(int which, int i);	// split the full child "i"
+    int FillChild(int which, int i);	// give "i" more than the minimum
+    bool Floor(FreeTreeIndex tree, int a, int b, int *key);
+					// last key at or before (a, b)
+    bool Ceiling(FreeTreeIndex tree, int a, int b, int *key);
+					// first key at or after (a, b)
+
+    int start;				// first sector of the free tree area
+    int size;				// number of sectors in it
+    bool enabled;			// FALSE for a disk formatted without
+					// a free tree area
+    int root[NumFreeTrees];		// as in the header
+    int numNodes;
+    int freeNodes;
+    int numExtents;
+    int onDisk;				// nodes below this were on disk when
+					// it was mounted
+    int maxNodes;			// room in the arrays below
+    FreeTreeNode **node;		// each node read or made, or NULL
+    bool *dirty;			// changed since it was read?
+};
+
+#endif // FREETREE_H
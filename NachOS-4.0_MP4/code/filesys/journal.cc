@@ -0,0 +1,161 @@
+// journal.cc 
+//	Routines to keep a write-ahead journal of file system metadata
+//	updates, and to recover from it after a crash.
+//
+//	The journal's own sectors are always read and written straight to
+//	the disk with SynchDisk::ReadSectors/WriteSectors (they are never
+//	in the cache), and each write returns only once it is on disk, so
+//	the order of the writes below is the order they reach the disk.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation 
+// of liability and disclaimer of warranty provisions.
+
+#ifndef FILESYS_STUB
+
+#include "copyright.h"
+#include "main.h"
+#include "journal.h"
+#include "synchdisk.h"
+
+//----------------------------------------------------------------------
+// Journal::Journal
+// 	Initialize the in-memory state of the journal kept in sectors
+//	"firstSector" through "firstSector" + "numSectors" - 1.  Whether
+//	there is a journal on disk is found out by Format or Recover.
+//----------------------------------------------------------------------
+
+Journal::Journal(int firstSector, int numSectors)
+{
+    ASSERT(sizeof(JournalHeader) == SectorSize);
+    ASSERT(numSectors >= 2);
+    start = firstSector;
+    size = numSectors;
+    enabled = FALSE;
+    depth = 0;
+    numBegun = 0;
+}
+
+//----------------------------------------------------------------------
+// Journal::Format
+// 	Write an empty journal, when the disk is being formatted.  The
+//	caller has marked the journal's sectors as in use.
+//----------------------------------------------------------------------
+
+void
+Journal::Format()
+{
+    JournalHeader header;
+
+    bzero((char *) &header, sizeof(header));
+    header.magic = JournalMagic;
+    header.version = FormatVersion;
+    header.numSectors = 0;
+    kernel->synchDisk->WriteSectors(start, 1, (char *) &header);
+    enabled = TRUE;
+}
+
+//----------------------------------------------------------------------
+// Journal::Recover
+// 	When the file system is mounted, before anything else is read:
+//	if the journal holds a committed transaction, write its sectors
+//	to their places on disk (again, perhaps), then empty the journal.
+//
+//	Returns FALSE, touching nothing, if the disk was not formatted
+//	with this FormatVersion: one formatted before there was a
+//	journal has no JournalMagic at the start of it, and one formatted
+//	by another Nachos has another version.  Its file headers and
+//	directories can't be read as this one's.
+//----------------------------------------------------------------------
+
+bool
+Journal::Recover()
+{
+    JournalHeader header;
+
+    kernel->synchDisk->ReadSectors(start, 1, (char *) &header);
+    if (header.magic != JournalMagic || header.version != FormatVersion) {
+	DEBUG(dbgFile, "Disk format " << ((header.magic == JournalMagic) ?
+		header.version : 0) << ", not " << FormatVersion);
+	return FALSE;
+    }
+    enabled = TRUE;
+    if (header.numSectors == 0)
+	return TRUE;
+
+    ASSERT(header.numSectors > 0 && header.numSectors < size
+		&& header.numSectors <= (int) MaxJournalEntries);
+    DEBUG(dbgFile, "Replaying " << header.numSectors << " sectors from the journal");
+    char *data = new char[header.numSectors * SectorSize];
+    kernel->synchDisk->ReadSectors(start + 1, header.numSectors, data);
+    for (int i = 0; i < header.numSectors; i++)
+	kernel->synchDisk->WriteSectors(header.sector[i], 1,
+					&data[i * SectorSize]);
+    delete [] data;
+
+    header.numSectors = 0;
+    kernel->synchDisk->WriteSectors(start, 1, (char *) &header);
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// Journal::Begin
+// 	Start a transaction.  Transactions nest: only the outermost one
+//	commits.
+//----------------------------------------------------------------------
+
+void
+Journal::Begin()
+{
+    numBegun++;				// something may change
+    if (!enabled)
+	return;
+    if (depth++ == 0)
+	kernel->synchDisk->StartTransaction(min(size - 1,
+						(int) MaxJournalEntries));
+}
+
+//----------------------------------------------------------------------
+// Journal::Commit
+// 	End a transaction.  For the outermost one:
+//	   copy the sectors it wrote into the journal;
+//	   write the journal header listing them -- the commit point;
+//	   let them go to their places on disk, and wait until they have;
+//	   mark the journal empty.
+//----------------------------------------------------------------------
+
+void
+Journal::Commit()
+{
+    if (!enabled)
+	return;
+    ASSERT(depth > 0);
+    if (--depth > 0)
+	return;
+
+    JournalHeader header;
+    int n = kernel->synchDisk->EndTransaction(header.sector);
+
+    if (n == 0) {
+	kernel->synchDisk->FinishTransaction();
+	return;
+    }
+    DEBUG(dbgFile, "Committing " << n << " sectors to the journal");
+    char *data = new char[n * SectorSize];
+    for (int i = 0; i < n; i++)
+	kernel->synchDisk->ReadSector(header.sector[i], &data[i * SectorSize]);
+    kernel->synchDisk->WriteSectors(start + 1, n, data);
+    delete [] data;
+
+    header.magic = JournalMagic;
+    header.version = FormatVersion;
+    header.numSectors = n;
+    kernel->synchDisk->WriteSectors(start, 1, (char *) &header);
+
+    kernel->synchDisk->FinishTransaction();
+
+    header.numSectors = 0;
+    kernel->synchDisk->WriteSectors(start, 1, (char *) &header);
+}
+
+#endif // FILESYS_STUB
@@ -0,0 +1,80 @@
+// journal.h 
+//	Data structures for a write-ahead journal of file system metadata.
+//
+//	An operation such as creating a file changes several sectors --
+//	the free map, the new file header, the directory.  If Nachos is
+//	killed part way through writing them, the file system on disk is
+//	left inconsistent.  So each such operation is a transaction: the
+//	sectors it writes are held in the disk cache (see synchdisk.h)
+//	until it commits.  Committing copies them all into the journal, a
+//	reserved range of sectors, and then writes the journal header
+//	saying the copy is complete.  Only then do the sectors go to
+//	their real places on disk; once they are all there, the journal
+//	is marked empty again.
+//
+//	When the file system is mounted, a journal that is not empty
+//	holds a committed transaction that may not be on disk yet, so
+//	it is copied into place again.  A transaction that had not
+//	committed left nothing on disk outside the journal.
+//
+//	The journal header is also where the disk records which version
+//	of the file system's on-disk format it was formatted with: it is
+//	at a fixed place, and read before anything else when mounting,
+//	so a disk written by an older Nachos is caught before its file
+//	headers or directories are misread.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation 
+// of liability and disclaimer of warranty provisions.
+
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include "copyright.h"
+#include "disk.h"
+
+#define JournalMagic		0x4a524e4c	// marks a formatted journal
+#define FormatVersion		1		// of the on-disk format; change
+						// it when a header, directory
+						// or area on disk changes
+#define MaxJournalEntries	((SectorSize - 3 * sizeof(int)) / sizeof(int))
+					// sectors one transaction can hold
+
+// The first sector of the journal: what the rest of it holds.
+// Exactly one disk sector in size.
+
+class JournalHeader {
+  public:
+    int magic;				// JournalMagic
+    int version;			// FormatVersion, when formatted
+    int numSectors;			// number of sectors in the committed
+					// transaction, or 0 if none
+    int sector[MaxJournalEntries];	// where each one belongs
+};
+
+class Journal {
+  public:
+    Journal(int firstSector, int numSectors);
+					// The journal is kept in the
+					// "numSectors" sectors from 
+					// "firstSector"
+
+    void Format();			// Initialize an empty journal
+    bool Recover();			// Copy a committed transaction that
+					// was left in the journal into place;
+					// FALSE if the disk has another format
+
+    void Begin();			// Start a transaction
+    void Commit();			// End it, making its writes durable
+    int NumBegun() { return numBegun; }	// transactions started, nested or
+					// not, journal enabled or not
+
+  private:
+    int start;				// first sector of the journal
+    int size;				// number of sectors in it
+    bool enabled;			// FALSE until formatted or recovered
+    int depth;				// number of Begins not yet Committed
+    int numBegun;			// number of Begins ever
+};
+
+#endif // JOURNAL_H
@@ -17,30 +17,125 @@
 #include "filehdr.h"
 #include "openfile.h"
 #include "synchdisk.h"
+#include "imagecache.h"
+#include "pool.h"
+#include "memops.h"
+#include "directory.h"
+#include "compress.h"
+
+static Pool openFilePool("OpenFile", sizeof(OpenFile));
 
 //----------------------------------------------------------------------
 // OpenFile::OpenFile
 // 	Open a Nachos file for reading and writing.  Bring the file header
-//	into memory while the file is open.
+//	into memory while the file is open; if the file is already open,
+//	its header is already in memory, and is shared.
 //
 //	"sector" -- the location on disk of the file header for this file
 //----------------------------------------------------------------------
 
 OpenFile::OpenFile(int sector)
 { 
-    hdr = new FileHeader;
-    hdr->FetchFrom(sector);
+    hdr = FileHeader::Acquire(sector);	// shared with other opens
     seekPosition = 0;
+    hdrSector = sector;
+    lastEnd = -1;
+    readAheadEnd = -1;
+    hint = NormalAccess;
+    numIds = 0;
+    entryDir = -1;
+    entryName = NULL;
+    chunkData = NULL;
+    chunkNumber = -1;
 }
 
 //----------------------------------------------------------------------
 // OpenFile::~OpenFile
 // 	Close a Nachos file, de-allocating any in-memory data structures.
+//	If its size changed while it was open, its directory entry is
+//	brought up to date first.
 //----------------------------------------------------------------------
 
 OpenFile::~OpenFile()
 {
-    delete hdr;
+    SyncEntry();
+    delete [] entryName;
+    delete [] chunkData;
+    FileHeader::Release(hdr);
+}
+
+//----------------------------------------------------------------------
+// OpenFile::SetEntry
+// 	The file was opened by its name "name" in the directory whose
+//	header is at "dirSector"; the size and attributes in that entry
+//	are taken to be what the header says now (which FileSystem::Create
+//	and earlier closes saw to).
+//----------------------------------------------------------------------
+
+void
+OpenFile::SetEntry(int dirSector, char *name)
+{
+    delete [] entryName;
+    entryDir = dirSector;
+    entryName = new char[strlen(name) + 1];
+    strcpy(entryName, name);
+    entrySize = hdr->FileLength();
+    entryAttributes = Attributes();
+}
+
+//----------------------------------------------------------------------
+// OpenFile::Attributes
+// 	Return the attributes the file's directory entry should have.
+//----------------------------------------------------------------------
+
+int
+OpenFile::Attributes()
+{
+    return (hdr->IsInline() ? EntryInline : 0)
+		| (hdr->IsCompressed() ? EntryCompressed : 0);
+}
+
+//----------------------------------------------------------------------
+// OpenFile::SyncEntry
+// 	If the file's size or attributes are not what its directory entry
+//	was last told, tell it now, so a listing needn't read the header.
+//	Writes don't do this each time the file grows: it costs a
+//	directory write, and is done once, when the file is closed or
+//	synced.
+//----------------------------------------------------------------------
+
+void
+OpenFile::SyncEntry()
+{
+    int size = hdr->FileLength();
+    int attributes = Attributes();
+
+    if (entryDir == -1 || kernel->fileSystem == NULL
+		|| (size == entrySize && attributes == entryAttributes))
+	return;
+    if (!kernel->fileSystem->SyncEntry(entryDir, entryName, hdrSector, size,
+					attributes))
+	entryDir = -1;			// the file is gone
+    entrySize = size;
+    entryAttributes = attributes;
+}
+
+//----------------------------------------------------------------------
+// OpenFile::operator new, OpenFile::operator delete
+// 	Take the memory for an open file from the pool of them, and give it
+//	back (see pool.h).
+//----------------------------------------------------------------------
+
+void *
+OpenFile::operator new(size_t size)
+{
+    return openFilePool.Alloc(size);
+}
+
+void
+OpenFile::operator delete(void *p)
+{
+    openFilePool.Free(p);
 }
 
 //----------------------------------------------------------------------
@@ -97,13 +192,36 @@ OpenFile::Write(char *into, int numBytes)
 //	sector at a time.  Thus:
 //
 //	For ReadAt:
-//	   We read in all of the full or partial sectors that are part of the
-//	   request, but we only copy the part we are interested in.
+//	   A partial first or last sector is read into a local buffer,
+//	   and we only copy the part we are interested in.  Holes (parts
+//	   of the file never written) read as zeros.
 //	For WriteAt:
-//	   We must first read in any sectors that will be partially written,
-//	   so that we don't overwrite the unmodified portion.  We then copy
-//	   in the data that will be modified, and write back all the full
-//	   or partial sectors that are part of the request.
+//	   A partial first or last sector is read in first, so that we
+//	   don't overwrite the unmodified portion, then the bytes we are
+//	   changing are copied in and the whole sector written back.
+//	   Sectors are allocated for any holes written into, and the file
+//	   grows if the write goes past its end; if the disk fills up,
+//	   only part of the request is written.  Sectors are allocated
+//	   a cluster at a time (see filehdr.h): the sectors of a new
+//	   cluster the request doesn't cover are zeroed if they are
+//	   inside the file, and so are any left past the old end of the
+//	   file that it now grows over.
+//
+//	The full sectors in between are transferred straight to/from the
+//	caller's buffer, as few disk requests as possible: each run of
+//	sectors that are also consecutive on disk is one request.
+//
+//	An inline file (see filehdr.h) is read and written in its header,
+//	which is already in memory; a write past MaxInlineSize first moves
+//	its data out to a sector.  A compressed file is read a chunk at a
+//	time (see ReadChunks); a write to it first decompresses the whole
+//	file back into ordinary sectors (see Expand).
+//
+//	If the request follows on from the last one, the file is being
+//	streamed: a read then prefetches the next few sectors into the
+//	buffer cache, and a write goes through the cache, each sector
+//	being written behind once it is complete.  Either way, the caller
+//	goes on while the disk works.
 //
 //	"into" -- the buffer to contain the data to be read from disk 
 //	"from" -- the buffer containing the data to be written to disk 
@@ -116,28 +234,55 @@ int
 OpenFile::ReadAt(char *into, int numBytes, int position)
 {
     int fileLength = hdr->FileLength();
-    int i, firstSector, lastSector, numSectors;
-    char *buf;
+    int i, firstSector, lastSector, run;
+    bool sequential;
+    char buf[SectorSize];
+    FileAccess *access;
 
     if ((numBytes <= 0) || (position >= fileLength))
     	return 0; 				// check request
     if ((position + numBytes) > fileLength)		
 	numBytes = fileLength - position;
     DEBUG(dbgFile, "Reading " << numBytes << " bytes at " << position << " from file of length " << fileLength);
+    sequential = Sequential(position, numBytes);
+    access = Access();
+    if (access != NULL)
+	access->Request(sequential);
+    if (hdr->IsInline()) {
+	MemCopy(into, &hdr->inlineData[position], numBytes);
+	return numBytes;
+    }
+    if (hdr->IsCompressed()) {
+	ReadChunks(into, numBytes, position);
+	if (hint == SequentialAccess || (sequential && hint != RandomAccess))
+	    ReadAhead(divRoundDown(chunkEnd - 1, SectorSize));
+	return numBytes;
+    }
 
     firstSector = divRoundDown(position, SectorSize);
     lastSector = divRoundDown(position + numBytes - 1, SectorSize);
-    numSectors = 1 + lastSector - firstSector;
 
-    // read in all the full and partial sectors that we need
-    buf = new char[numSectors * SectorSize];
-    for (i = firstSector; i <= lastSector; i++)	
-        kernel->synchDisk->ReadSector(hdr->ByteToSector(i * SectorSize), 
-					&buf[(i - firstSector) * SectorSize]);
+    for (i = firstSector; i <= lastSector; i += run) {
+	int start = max(position, i * SectorSize);
+	int end = min(position + numBytes, (i + 1) * SectorSize);
+	int sector = hdr->ByteToSector(i * SectorSize);
 
-    // copy the part we want
-    bcopy(&buf[position - (firstSector * SectorSize)], into, numBytes);
-    delete [] buf;
+	run = 1;
+	if (sector == -1) {			// a hole
+	    MemZero(&into[start - position], end - start);
+	} else if (end - start < SectorSize) {	// partial sector
+	    kernel->synchDisk->ReadSector(sector, buf);
+	    MemCopy(&into[start - position], &buf[start - i * SectorSize], 
+			end - start);
+	} else {
+	    run = FullRun(i, lastSector, position + numBytes);
+	    kernel->synchDisk->ReadSectors(sector, run, &into[start - position]);
+	}
+	if (access != NULL && sector != -1)
+	    access->Touch(sector, run);
+    }
+    if (hint == SequentialAccess || (sequential && hint != RandomAccess))
+	ReadAhead(lastSector);
     return numBytes;
 }
 
@@ -145,46 +290,590 @@ int
 OpenFile::WriteAt(char *from, int numBytes, int position)
 {
     int fileLength = hdr->FileLength();
-    int i, firstSector, lastSector, numSectors;
-    bool firstAligned, lastAligned;
-    char *buf;
+    int oldSectors = divRoundUp(fileLength, SectorSize);
+    int i, firstSector, lastSector, run, cluster;
+    bool firstHole, lastHole, sequential;
+    char buf[SectorSize];
+    FileAccess *access = Access();
 
-    if ((numBytes <= 0) || (position >= fileLength))
+    if ((numBytes <= 0) || (position < 0) || (position >= MaxFileSize))
 	return 0;				// check request
-    if ((position + numBytes) > fileLength)
-		numBytes = fileLength - position;
+    if ((position + numBytes) > MaxFileSize)
+		numBytes = MaxFileSize - position;
     DEBUG(dbgFile, "Writing " << numBytes << " bytes at " << position << " from file of length " << fileLength);
+    kernel->imageCache->Invalidate(hdrSector);	// if it's a program
+    if (hdr->IsCompressed() && !Expand())
+	return 0;				// the disk is full
+    if (hdr->IsInline()) {
+	if (position + numBytes <= MaxInlineSize) {
+	    if (access != NULL)
+		access->Request(Sequential(position, numBytes));
+	    MemCopy(&hdr->inlineData[position], from, numBytes);
+	    if (position + numBytes > fileLength)
+		hdr->SetLength(position + numBytes);
+	    hdr->WriteBack(hdrSector);
+	    return numBytes;
+	}
+	if (!Spill())
+	    return 0;				// the disk is full
+    }
 
     firstSector = divRoundDown(position, SectorSize);
     lastSector = divRoundDown(position + numBytes - 1, SectorSize);
-    numSectors = 1 + lastSector - firstSector;
-
-    buf = new char[numSectors * SectorSize];
-	
-	// Mp4 mod tag
-	memset(buf, 0, sizeof(char) * numSectors * SectorSize); // dummy operation to keep valgrind happy
-
-    firstAligned = (position == (firstSector * SectorSize));
-    lastAligned = ((position + numBytes) == ((lastSector + 1) * SectorSize));
-
-// read in first and last sector, if they are to be partially modified
-    if (!firstAligned)
-        ReadAt(buf, SectorSize, firstSector * SectorSize);	
-    if (!lastAligned && ((firstSector != lastSector) || firstAligned))
-        ReadAt(&buf[(lastSector - firstSector) * SectorSize], 
-				SectorSize, lastSector * SectorSize);	
-
-// copy in the bytes we want to change 
-    bcopy(from, &buf[position - (firstSector * SectorSize)], numBytes);
-
-// write modified sectors back
-    for (i = firstSector; i <= lastSector; i++)	
-        kernel->synchDisk->WriteSector(hdr->ByteToSector(i * SectorSize), 
-					&buf[(i - firstSector) * SectorSize]);
-    delete [] buf;
+
+// allocate the holes we are about to write into, including any past
+// the end of the file; new sectors that are partly written start as zeros
+    firstHole = (hdr->ByteToSector(firstSector * SectorSize) == -1);
+    lastHole = (hdr->ByteToSector(lastSector * SectorSize) == -1);
+    for (i = firstSector; i <= lastSector; i++)
+	if (hdr->ByteToSector(i * SectorSize) == -1)
+	    break;
+    if (i <= lastSector) {
+	int done = kernel->fileSystem->AllocateSectors(hdr, hdrSector, i, lastSector);
+
+	if (done <= lastSector) {		// the disk is full
+	    numBytes = done * SectorSize - position;
+	    if (numBytes <= 0)
+		return 0;
+	    lastSector = done - 1;
+	    lastHole = FALSE;			// wholly written, if new
+	}
+    }
+
+// and copy the clusters shared with a clone that we are about to write
+// into, zeros included, so that the clone keeps its data (there are
+// none while the file system is being formatted)
+    cluster = hdr->ClusterSize();
+    if (kernel->fileSystem != NULL) {
+	i = kernel->fileSystem->Unshare(hdr, hdrSector,
+		min(oldSectors, firstSector - firstSector % cluster), lastSector);
+	if (i <= lastSector) {			// the disk is full
+	    if (i <= firstSector)
+		return 0;
+	    numBytes = i * SectorSize - position;
+	    lastSector = i - 1;
+	    lastHole = FALSE;
+	}
+    }
+    if ((position + numBytes) > fileLength) {
+	hdr->SetLength(position + numBytes);
+	hdr->WriteBack(hdrSector);
+    }
+
+// the sectors before the request that were never written: the rest of
+// a new cluster, or ones past the old end of the file; and after it, the
+// rest of a new cluster, if still inside the file
+    MemZero(buf, SectorSize);
+    for (i = min(oldSectors, firstSector - firstSector % cluster); i < firstSector; i++)
+	if (i >= oldSectors || firstHole)
+	    ZeroSector(i, buf);
+    if (lastHole)
+	for (i = lastSector + 1; i < min(oldSectors, lastSector - lastSector % cluster + cluster); i++)
+	    ZeroSector(i, buf);
+
+    sequential = Sequential(position, numBytes);
+    if (access != NULL)
+	access->Request(sequential);
+
+    for (i = firstSector; i <= lastSector; i += run) {
+	int start = max(position, i * SectorSize);
+	int end = min(position + numBytes, (i + 1) * SectorSize);
+	int sector = hdr->ByteToSector(i * SectorSize);
+
+	run = 1;
+	if (end - start < SectorSize) {		// partial sector
+	    if ((i == firstSector && firstHole) || (i == lastSector && lastHole)
+			|| i >= oldSectors)	// never written
+		MemZero(buf, SectorSize);
+	    else
+		kernel->synchDisk->ReadSector(sector, buf);
+	    MemCopy(&buf[start - i * SectorSize], &from[start - position], 
+			end - start);
+	    kernel->synchDisk->WriteSector(sector, buf);
+	    if (sequential && end == (i + 1) * SectorSize)
+		kernel->synchDisk->WriteBehind(sector);
+	} else if (sequential) {
+	    kernel->synchDisk->WriteSector(sector, &from[start - position]);
+	    kernel->synchDisk->WriteBehind(sector);
+	} else {
+	    run = FullRun(i, lastSector, position + numBytes);
+	    kernel->synchDisk->WriteSectors(sector, run, &from[start - position]);
+	}
+	if (access != NULL)
+	    access->Touch(sector, run);
+    }
+    return numBytes;
+}
+
+//----------------------------------------------------------------------
+// OpenFile::ZeroSector
+// 	Write "zeros" (SectorSize of them) over the file's sector
+//	"localSector", unless it is a hole.
+//----------------------------------------------------------------------
+
+void
+OpenFile::ZeroSector(int localSector, char *zeros)
+{
+    int sector = hdr->ByteToSector(localSector * SectorSize);
+
+    if (sector != -1)
+	kernel->synchDisk->WriteSector(sector, zeros);
+}
+
+//----------------------------------------------------------------------
+// OpenFile::Spill
+// 	Move the data of an inline file, which is about to grow past
+//	MaxInlineSize, out of its header and into a sector of its own.
+//	Returns FALSE, leaving the file inline, if the disk is full.
+//----------------------------------------------------------------------
+
+bool
+OpenFile::Spill()
+{
+    char saved[MaxInlineSize];
+    int length = hdr->FileLength();
+
+    DEBUG(dbgFile, "Moving the " << length << " bytes in header " << hdrSector
+		<< " out to a sector");
+    hdr->Uninline(saved);
+    if (length > 0 && WriteAt(saved, length, 0) < length) {
+	hdr->MakeInline();			// nothing was allocated
+	MemCopy(hdr->inlineData, saved, MaxInlineSize);
+	hdr->WriteBack(hdrSector);
+	return FALSE;
+    }
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// OpenFile::Load
+// 	Write the whole contents of a file that has just been created
+//	with room for them, such as one being copied in from UNIX.
+//
+//	Its sectors are all allocated already, so there are no holes to
+//	fill, nothing to read back, and the header doesn't change: each
+//	run of consecutive disk sectors goes straight from "from" to the
+//	disk in one request, and only a partial last sector is copied.
+//	If the file isn't laid out like that, just use WriteAt.
+//
+//	Returns the number of bytes written, and leaves the position
+//	after them.
+//
+//	"from" -- the contents of the file
+//	"numBytes" -- how many bytes there are
+//----------------------------------------------------------------------
+
+int
+OpenFile::Load(char *from, int numBytes)
+{
+    int numFull = numBytes / SectorSize;
+    int i, sector, run;
+    char buf[SectorSize];
+    FileAccess *access;
+
+    kernel->imageCache->Invalidate(hdrSector);	// if it's a program
+    for (i = 0; i < divRoundUp(numBytes, SectorSize); i++)
+	if (hdr->ByteToSector(i * SectorSize) == -1)
+	    break;
+    if (numBytes > hdr->FileLength() || i < divRoundUp(numBytes, SectorSize)
+		|| hdr->IsCompressed()) {
+	seekPosition = WriteAt(from, numBytes, 0);
+	return seekPosition;
+    }
+
+    access = Access();
+    if (access != NULL)
+	access->Request(FALSE);
+    for (i = 0; i < numFull; i += run) {
+	sector = hdr->ByteToSector(i * SectorSize);
+	run = FullRun(i, numFull - 1, numFull * SectorSize);
+	kernel->synchDisk->WriteSectors(sector, run, &from[i * SectorSize]);
+	if (access != NULL)
+	    access->Touch(sector, run);
+    }
+    if (numBytes % SectorSize > 0) {
+	sector = hdr->ByteToSector(numFull * SectorSize);
+	MemZero(buf, SectorSize);
+	MemCopy(buf, &from[numFull * SectorSize], numBytes % SectorSize);
+	kernel->synchDisk->WriteSector(sector, buf);
+	if (access != NULL)
+	    access->Touch(sector, 1);
+    }
+    seekPosition = lastEnd = numBytes;
+    return numBytes;
+}
+
+//----------------------------------------------------------------------
+// OpenFile::LoadCompressed
+// 	Write the whole contents of a file that has just been created,
+//	empty, compressed: each ChunkSize bytes of "from" are compressed
+//	on their own (or kept as they are, if that doesn't make them
+//	smaller), and the stream of them, after the table of where each
+//	one starts, is written to sectors allocated for it together.
+//	Return how many bytes the file holds: "numBytes", or 0 if the
+//	stream would not fit in a file, or on the disk.
+//
+//	"from" -- the contents of the file
+//	"numBytes" -- how many bytes there are
+//----------------------------------------------------------------------
+
+int
+OpenFile::LoadCompressed(char *from, int numBytes)
+{
+    int numChunks = divRoundUp(numBytes, ChunkSize);
+    int tableBytes = (numChunks + 1) * sizeof(int);
+    int *table = new int[numChunks + 1];
+    char *stream = new char[tableBytes + numBytes + SectorSize];
+    char saved[MaxInlineSize];
+    int length = tableBytes, numSectors, done, i, run;
+    FileAccess *access;
+
+    ASSERT(hdr->FileLength() == 0);
+    for (i = 0; i < numChunks; i++) {
+	int raw = min(ChunkSize, numBytes - i * ChunkSize);
+	int n = LzCompress(&from[i * ChunkSize], raw, &stream[length], raw - 1);
+
+	if (n == -1) {
+	    MemCopy(&stream[length], &from[i * ChunkSize], raw);
+	    n = raw;				// stored as it is
+	}
+	table[i] = length;
+	length += n;
+    }
+    table[numChunks] = length;
+    MemCopy(stream, table, tableBytes);
+    delete [] table;
+    numSectors = divRoundUp(length, SectorSize);
+    DEBUG(dbgFile, "Compressed " << numBytes << " bytes in " << numChunks
+		<< " chunks into " << length << " bytes, " << numSectors << " sectors");
+    if (numBytes <= 0 || numSectors > MaxFileSectors) {
+	delete [] stream;
+	return 0;
+    }
+    MemZero(&stream[length], numSectors * SectorSize - length);
+
+    kernel->imageCache->Invalidate(hdrSector);	// if it's a program
+    if (hdr->IsInline())
+	hdr->Uninline(saved);			// (nothing in it)
+    hdr->MakeCompressed(numBytes, length);
+    done = kernel->fileSystem->AllocateSectors(hdr, hdrSector, 0, numSectors - 1);
+    if (done < numSectors) {			// the disk is full
+	bool freed;
+
+	hdr->numBytes = 0;			// nothing to write back
+	freed = kernel->fileSystem->Uncompress(hdr, hdrSector);
+	ASSERT(freed);
+	delete [] stream;
+	return 0;
+    }
+
+    access = Access();
+    if (access != NULL)
+	access->Request(FALSE);
+    for (i = 0; i < numSectors; i += run) {
+	int sector = hdr->ByteToSector(i * SectorSize);
+
+	run = FullRun(i, numSectors - 1, numSectors * SectorSize);
+	kernel->synchDisk->WriteSectors(sector, run, &stream[i * SectorSize]);
+	if (access != NULL)
+	    access->Touch(sector, run);
+    }
+    delete [] stream;
+    seekPosition = lastEnd = numBytes;
     return numBytes;
 }
 
+//----------------------------------------------------------------------
+// OpenFile::ReadStream
+// 	Read "numBytes" bytes of a compressed file's stream, from offset
+//	"position" in it, into "into": a partial sector through a buffer,
+//	and each run of whole sectors consecutive on disk in one request.
+//----------------------------------------------------------------------
+
+void
+OpenFile::ReadStream(char *into, int numBytes, int position)
+{
+    int firstSector = divRoundDown(position, SectorSize);
+    int lastSector = divRoundDown(position + numBytes - 1, SectorSize);
+    char buf[SectorSize];
+    FileAccess *access = Access();
+    int i, run;
+
+    ASSERT(numBytes > 0 && position + numBytes <= hdr->StoredSectors() * SectorSize);
+    for (i = firstSector; i <= lastSector; i += run) {
+	int start = max(position, i * SectorSize);
+	int end = min(position + numBytes, (i + 1) * SectorSize);
+	int sector = hdr->ByteToSector(i * SectorSize);
+
+	ASSERT(sector != -1);			// a stream has no holes
+	run = 1;
+	if (end - start < SectorSize) {
+	    kernel->synchDisk->ReadSector(sector, buf);
+	    MemCopy(&into[start - position], &buf[start - i * SectorSize],
+			end - start);
+	} else {
+	    run = FullRun(i, lastSector, position + numBytes);
+	    kernel->synchDisk->ReadSectors(sector, run, &into[start - position]);
+	}
+	if (access != NULL)
+	    access->Touch(sector, run);
+    }
+}
+
+//----------------------------------------------------------------------
+// OpenFile::LoadChunk
+// 	Decompress chunk "chunk" of a compressed file into chunkData,
+//	unless it is there already: read where it is in the stream from
+//	the table, then only its bytes.  Return where it ends in the
+//	stream.
+//----------------------------------------------------------------------
+
+int
+OpenFile::LoadChunk(int chunk)
+{
+    int bounds[2];
+    int raw = min(ChunkSize, hdr->FileLength() - chunk * ChunkSize);
+    char packed[ChunkSize];
+
+    if (chunk == chunkNumber)
+	return chunkEnd;
+    if (chunkData == NULL)
+	chunkData = new char[ChunkSize];
+    ReadStream((char *) bounds, sizeof(bounds), chunk * sizeof(int));
+    ASSERT(bounds[0] < bounds[1] && bounds[1] - bounds[0] <= raw);
+    if (bounds[1] - bounds[0] == raw) {
+	ReadStream(chunkData, raw, bounds[0]);	// stored as it is
+    } else {
+	bool ok;
+
+	ReadStream(packed, bounds[1] - bounds[0], bounds[0]);
+	ok = LzDecompress(packed, bounds[1] - bounds[0], chunkData, raw);
+	ASSERT(ok);
+    }
+    chunkNumber = chunk;
+    chunkEnd = bounds[1];
+    return chunkEnd;
+}
+
+//----------------------------------------------------------------------
+// OpenFile::ReadChunks
+// 	Read "numBytes" bytes of a compressed file's data at "position"
+//	into "into", decompressing each chunk they are in, and only those.
+//	The last chunk decompressed is kept, for the next read: reading
+//	the file in small pieces decompresses each chunk once.
+//----------------------------------------------------------------------
+
+void
+OpenFile::ReadChunks(char *into, int numBytes, int position)
+{
+    for (int chunk = position / ChunkSize; chunk * ChunkSize < position + numBytes;
+		chunk++) {
+	int start = max(position, chunk * ChunkSize);
+	int end = min(position + numBytes, (chunk + 1) * ChunkSize);
+
+	LoadChunk(chunk);
+	MemCopy(&into[start - position], &chunkData[start - chunk * ChunkSize],
+		end - start);
+    }
+}
+
+//----------------------------------------------------------------------
+// OpenFile::Expand
+// 	Make a compressed file, which is about to be written, an ordinary
+//	one: decompress all of it into memory, give back its stream (see
+//	FileSystem::Uncompress), and write the data back to sectors of its
+//	own.  Returns FALSE, leaving the file compressed, if it wouldn't
+//	fit.
+//----------------------------------------------------------------------
+
+bool
+OpenFile::Expand()
+{
+    int length = hdr->FileLength();
+    char *data = new char[length + 1];
+    bool done;
+
+    DEBUG(dbgFile, "Decompressing the " << length << " bytes of file "
+		<< hdrSector << " to write to it");
+    ReadChunks(data, length, 0);
+    if (!kernel->fileSystem->Uncompress(hdr, hdrSector)) {
+	delete [] data;
+	return FALSE;
+    }
+    chunkNumber = -1;
+    done = (WriteAt(data, length, 0) == length);
+    delete [] data;
+    return done;
+}
+
+//----------------------------------------------------------------------
+// OpenFile::Access
+// 	Return where the use of this file is counted, for "-S" -- or
+//	NULL while the file system is being set up, before there is
+//	one to count it.
+//----------------------------------------------------------------------
+
+FileAccess *
+OpenFile::Access()
+{
+    if (kernel->fileSystem == NULL)
+	return NULL;
+    return kernel->fileSystem->Access(hdrSector);
+}
+
+//----------------------------------------------------------------------
+// OpenFile::FullRun
+// 	Return how many file sectors, starting at "first" (which is wholly
+//	part of the request), are wholly part of the request and stored
+//	in consecutive disk sectors, so they can be moved in one transfer.
+//
+//	"last" -- the last file sector of the request
+//	"end" -- the file offset just past the request
+//----------------------------------------------------------------------
+
+int
+OpenFile::FullRun(int first, int last, int end)
+{
+    int sector = hdr->ByteToSector(first * SectorSize);
+    int run = 1;
+
+    while ((first + run <= last) && ((first + run + 1) * SectorSize <= end)
+		&& (hdr->ByteToSector((first + run) * SectorSize) == sector + run))
+	run++;
+    return run;
+}
+
+//----------------------------------------------------------------------
+// OpenFile::Sequential
+// 	Return TRUE if a request for "numBytes" at "position" starts where
+//	the last ReadAt or WriteAt on this open file ended, and remember
+//	where this one ends.  Any other request starts a new stream.
+//----------------------------------------------------------------------
+
+bool
+OpenFile::Sequential(int position, int numBytes)
+{
+    bool sequential = (position == lastEnd);
+
+    if (!sequential)
+	readAheadEnd = -1;		// a new stream, if any
+    lastEnd = position + numBytes;
+    return sequential;
+}
+
+//----------------------------------------------------------------------
+// OpenFile::ReadAhead
+// 	Prefetch up to ReadAheadSectors file sectors following file sector
+//	"lastSector" (the last one just read) -- twice as many, if the
+//	file is to be read sequentially -- and on to the end of the
+//	cluster that leaves off in, skipping the ones already prefetched
+//	and any holes.
+//----------------------------------------------------------------------
+
+void
+OpenFile::ReadAhead(int lastSector)
+{
+    int numSectors = hdr->StoredSectors();
+    int i = max(lastSector + 1, readAheadEnd + 1);
+    int end = lastSector + ((hint == SequentialAccess) ?
+				2 * ReadAheadSectors : ReadAheadSectors);
+
+    end += hdr->ClusterSize() - 1 - end % hdr->ClusterSize();
+    for (; i <= end && i < numSectors; i++) {
+	int sector = hdr->ByteToSector(i * SectorSize);
+
+	if (sector != -1)
+	    kernel->synchDisk->Prefetch(sector);
+	readAheadEnd = i;
+    }
+}
+
+//----------------------------------------------------------------------
+// OpenFile::Prefetch
+// 	Queue background reads of the sectors holding "numBytes" bytes
+//	at "position", for a caller who is about to read them, so that
+//	they are on the disk queue together (with those of any other
+//	thread doing the same) rather than requested one run at a time.
+//	At most half the buffer cache is used, so a big request can't
+//	push out everything else.
+//----------------------------------------------------------------------
+
+void
+OpenFile::Prefetch(int position, int numBytes)
+{
+    int i, lastSector;
+
+    if (numBytes <= 0 || position < 0 || position >= hdr->FileLength()
+		|| hdr->IsCompressed())
+	return;				// (the chunks could be anywhere)
+    if (position + numBytes > hdr->FileLength())
+	numBytes = hdr->FileLength() - position;
+    lastSector = divRoundDown(position + numBytes - 1, SectorSize);
+    lastSector = min(lastSector,
+		divRoundDown(position, SectorSize) + NumCacheBuffers / 2 - 1);
+    for (i = divRoundDown(position, SectorSize); i <= lastSector; i++) {
+	int sector = hdr->ByteToSector(i * SectorSize);
+
+	if (sector != -1)
+	    kernel->synchDisk->Prefetch(sector);
+    }
+}
+
+//----------------------------------------------------------------------
+// OpenFile::Sync
+// 	Write whatever of the file's data is dirty in the buffer cache to
+//	the disk, and wait until it is there, for Fsync.  Its header and
+//	index blocks go through the journal, so they are on the disk (or in
+//	the journal) once the write that changed them has returned, as is
+//	its directory entry once SyncEntry has; the header sector is
+//	flushed anyway, for an inline file's data.
+//----------------------------------------------------------------------
+
+void
+OpenFile::Sync()
+{
+    int numSectors = hdr->StoredSectors();
+    int *sectors = new int[numSectors + 1];
+    int n = 0;
+
+    SyncEntry();			// the entry goes through the journal
+    sectors[n++] = hdrSector;
+    for (int i = 0; i < numSectors; i++) {
+	int sector = hdr->GetPhysicSector(i);
+
+	if (sector != -1)
+	    sectors[n++] = sector;
+    }
+    kernel->synchDisk->Flush(sectors, n);
+    delete [] sectors;
+}
+
+//----------------------------------------------------------------------
+// OpenFile::Discard
+// 	The caller won't need the "numBytes" bytes at "position" again
+//	soon: let the buffer cache reuse the sectors holding them first
+//	(see SynchDisk::Discard).
+//----------------------------------------------------------------------
+
+void
+OpenFile::Discard(int position, int numBytes)
+{
+    int i, lastSector;
+
+    if (numBytes <= 0 || position < 0 || position >= hdr->FileLength()
+		|| hdr->IsInline() || hdr->IsCompressed())
+	return;
+    if (position + numBytes > hdr->FileLength())
+	numBytes = hdr->FileLength() - position;
+    lastSector = divRoundDown(position + numBytes - 1, SectorSize);
+    for (i = divRoundDown(position, SectorSize); i <= lastSector; i++) {
+	int sector = hdr->ByteToSector(i * SectorSize);
+
+	if (sector != -1)
+	    kernel->synchDisk->Discard(sector);
+    }
+}
+
 //----------------------------------------------------------------------
 // OpenFile::Length
 // 	Return the number of bytes in the file.
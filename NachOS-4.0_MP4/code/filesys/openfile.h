@@ -61,12 +61,27 @@ class OpenFile {
 
 #else // FILESYS
 class FileHeader;
+class FileAccess;
+
+// When a file is being read sequentially, how many sectors past the
+// current position to read ahead into the buffer cache
+
+const int ReadAheadSectors = 8;
+
+// What the user of an open file has said about how it will be read
+// (see OpenFile::SetHint): nothing, so read ahead only once it is seen
+// reading sequentially; sequentially, so read ahead twice as far, from
+// the first read; or at random, so never read ahead.
+
+enum AccessHint { NormalAccess, SequentialAccess, RandomAccess };
 
 class OpenFile {
   public:
     OpenFile(int sector);		// Open a file whose header is located
 					// at "sector" on the disk
     ~OpenFile();			// Close the file
+    static void *operator new(size_t size);	// from a pool of them,
+    static void operator delete(void *p);	// not the heap
 
     void Seek(int position); 		// Set the position from which to 
 					// start reading/writing -- UNIX lseek
@@ -82,14 +97,81 @@ class OpenFile {
 					// bypassing the implicit position.
     int WriteAt(char *from, int numBytes, int position);
 
+    int Load(char *from, int numBytes);	// Fill a newly created file from
+					// the start, a run of sectors at
+					// a time
+    int LoadCompressed(char *from, int numBytes);
+					// Or fill a newly created, empty
+					// file with the data compressed
+    void Prefetch(int position, int numBytes);
+					// Start reading bytes into the
+					// buffer cache, without waiting
+    void Sync();			// Write the file's data from the
+					// buffer cache to disk, and wait
+    void SetHint(AccessHint how) { hint = how; }
+					// How the file will be read, to
+					// tune read-ahead
+    void Discard(int position, int numBytes);
+					// The bytes won't be needed again
+					// soon; let the cache reuse them
+
     int Length(); 			// Return the number of bytes in the
 					// file (this interface is simpler 
 					// than the UNIX idiom -- lseek to 
 					// end of file, tell, lseek back 
+
+    int HeaderSector() { return hdrSector; }
+					// Where the file header is on disk
+    void SetEntry(int dirSector, char *name);
+					// Where the file's directory entry
+					// is, to keep its size up to date
+    void SyncEntry();			// Bring the entry up to date now
+
+    void AddId() { numIds++; }		// A user program's FileTable has
+    bool RemoveId() { return --numIds == 0; }
+					// one more/fewer id for it; TRUE
+					// if that was the last
     
   private:
+    int FullRun(int first, int last, int end);
+					// Length of a run of whole sectors
+					// that are consecutive on disk
+    bool Sequential(int position, int numBytes);
+					// Does this request pick up where
+					// the last one left off?
+    void ReadAhead(int lastSector);	// Prefetch the sectors after it
+    bool Spill();			// Move an inline file's data out of
+					// its header
+    void ZeroSector(int localSector, char *zeros);
+					// Clear a sector never written
+    FileAccess *Access();		// Where its use is counted, or NULL
+    int Attributes();			// What its directory entry should say
+    void ReadStream(char *into, int numBytes, int position);
+					// Read bytes of a compressed file's
+					// stream
+    int LoadChunk(int chunk);		// Decompress a chunk into chunkData
+    void ReadChunks(char *into, int numBytes, int position);
+					// Read a compressed file's data
+    bool Expand();			// Make a compressed file an ordinary
+					// one, to write to
+
     FileHeader *hdr;			// Header for this file 
     int seekPosition;			// Current position within the file
+    int hdrSector;			// Sector holding the file header
+    int lastEnd;			// File offset just past the last
+					// ReadAt/WriteAt, or -1
+    int readAheadEnd;			// Last file sector prefetched
+    AccessHint hint;			// how it is expected to be read
+    int numIds;				// FileTable ids that refer to it
+    int entryDir;			// header of the directory the file
+					// is in, or -1 if it wasn't opened
+					// by name
+    char *entryName;			// its name there, or NULL
+    int entrySize;			// the size and attributes last
+    int entryAttributes;		// recorded there
+    char *chunkData;			// the chunk of a compressed file
+    int chunkNumber;			// last decompressed, or -1
+    int chunkEnd;			// where it ends in the stream
 };
 
 #endif // FILESYS
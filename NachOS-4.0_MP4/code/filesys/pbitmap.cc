@@ -8,6 +8,9 @@
 
 #include "copyright.h"
 #include "pbitmap.h"
+#include "disk.h"
+#include "debug.h"
+#include "refcount.h"
 
 //----------------------------------------------------------------------
 // PersistentBitmap::PersistentBitmap(int)
@@ -17,10 +20,14 @@
 //	"numItems" is the number of bits in the bitmap.
 //
 //      This constructor does not initialize the bitmap from a disk file
+//
+//	Clear bits are counted a track at a time, since this is the
+//	disk's free map.
 //----------------------------------------------------------------------
 
-PersistentBitmap::PersistentBitmap(int numItems):Bitmap(numItems) 
+PersistentBitmap::PersistentBitmap(int numItems):Bitmap(numItems, SectorsPerTrack) 
 { 
+    InitDirty();
 }
 
 //----------------------------------------------------------------------
@@ -35,12 +42,32 @@ PersistentBitmap::PersistentBitmap(int numItems):Bitmap(numItems)
 //      This constructor initializes the bitmap from a disk file
 //----------------------------------------------------------------------
 
-PersistentBitmap::PersistentBitmap(OpenFile *file, int numItems):Bitmap(numItems) 
+PersistentBitmap::PersistentBitmap(OpenFile *file, int numItems):Bitmap(numItems, SectorsPerTrack) 
 { 
     // map has already been initialized by the BitMap constructor,
     // but we will just overwrite that with the contents of the
     // map found in the file
     file->ReadAt((char *)map, numWords * sizeof(unsigned), 0);
+    Recount();
+    InitDirty();
+}
+
+//----------------------------------------------------------------------
+// PersistentBitmap::InitDirty
+// 	Set up the record of which sectors of the bitmap have changed,
+//	with none changed.
+//----------------------------------------------------------------------
+
+void
+PersistentBitmap::InitDirty()
+{
+    tree = NULL;
+    refs = NULL;
+    bestFit = FALSE;
+    numSectors = divRoundUp(numWords * sizeof(unsigned), SectorSize);
+    dirty = new bool[numSectors];
+    for (int i = 0; i < numSectors; i++)
+	dirty[i] = FALSE;
 }
 
 //----------------------------------------------------------------------
@@ -50,11 +77,182 @@ PersistentBitmap::PersistentBitmap(OpenFile *file, int numItems):Bitmap(numItems
 
 PersistentBitmap::~PersistentBitmap()
 { 
+    delete [] dirty;
+}
+
+//----------------------------------------------------------------------
+// PersistentBitmap::Mark, PersistentBitmap::Clear
+// 	Set or clear the "nth" bit, as for any bitmap, and note that the
+//	sector of the bitmap holding it is out of date on disk.  If it
+//	changes, so does an extent in the tree.
+//----------------------------------------------------------------------
+
+void
+PersistentBitmap::Mark(int which)
+{
+    if (tree != NULL && !Test(which))
+	tree->Take(which, 1);
+    Bitmap::Mark(which);
+    dirty[(which / BitsInWord) * sizeof(unsigned) / SectorSize] = TRUE;
+}
+
+void
+PersistentBitmap::Clear(int which)
+{
+    if (tree != NULL && Test(which))
+	tree->Give(which, 1);
+    Bitmap::Clear(which);
+    dirty[(which / BitsInWord) * sizeof(unsigned) / SectorSize] = TRUE;
+}
+
+//----------------------------------------------------------------------
+// PersistentBitmap::MarkRange, PersistentBitmap::ClearRange
+// 	Set or clear "count" bits starting with bit "first", as for any
+//	bitmap, and note that the sectors of the bitmap holding them are
+//	out of date on disk.
+//----------------------------------------------------------------------
+
+void
+PersistentBitmap::MarkRange(int first, int count)
+{
+    if (tree != NULL)
+	TakeRuns(first, count);
+    Bitmap::MarkRange(first, count);
+    SetDirty(first, count);
+}
+
+void
+PersistentBitmap::ClearRange(int first, int count)
+{
+    if (tree != NULL)
+	GiveRuns(first, count);
+    Bitmap::ClearRange(first, count);
+    SetDirty(first, count);
+}
+
+//----------------------------------------------------------------------
+// PersistentBitmap::ReleaseRange
+// 	A file no longer uses the "count" sectors of a cluster from
+//	"first": if other files share them, they just lose a reference;
+//	otherwise they are cleared.
+//----------------------------------------------------------------------
+
+void
+PersistentBitmap::ReleaseRange(int first, int count)
+{
+    if (refs != NULL && refs->Drop(first, count))
+	return;				// still in another file
+    ClearRange(first, count);
+}
+
+//----------------------------------------------------------------------
+// PersistentBitmap::TakeRuns, PersistentBitmap::GiveRuns
+// 	Before "count" bits from "first" are marked (or cleared), tell the
+//	tree about each run among them that is clear (or set) now: those
+//	are what change.
+//----------------------------------------------------------------------
+
+void
+PersistentBitmap::TakeRuns(int first, int count)
+{
+    int end = first + count;
+
+    for (int i = first; i < end; ) {
+	int run = NextClear(i, end);
+
+	if (run == end)
+	    break;
+	i = NextSet(run, end);
+	tree->Take(run, i - run);
+    }
+}
+
+void
+PersistentBitmap::GiveRuns(int first, int count)
+{
+    int end = first + count;
+
+    for (int i = first; i < end; ) {
+	int run = NextSet(i, end);
+
+	if (run == end)
+	    break;
+	i = NextClear(run, end);
+	tree->Give(run, i - run);
+    }
+}
+
+//----------------------------------------------------------------------
+// PersistentBitmap::FindBestFit
+// 	Return the first bit of the shortest run of "count" clear bits or
+//	more, and set "length" to "count"; or if there is none that long,
+//	of the longest, setting "length" to its length.  -1 if no bits are
+//	clear.  From the tree, if there is one, or else the slow way, a
+//	run at a time.  Nothing is marked as in use.
+//----------------------------------------------------------------------
+
+int
+PersistentBitmap::FindBestFit(int count, int *length)
+{
+    int best = -1, bestLength = 0;
+
+    if (tree != NULL)
+	return tree->BestFit(count, length);
+    for (int i = 0; i < numBits; ) {
+	int first = NextClear(i, numBits);
+	int runLength;
+
+	if (first == numBits)
+	    break;
+	i = NextSet(first, numBits);
+	runLength = i - first;
+	if ((bestLength < count && runLength > bestLength)
+		|| (runLength >= count && runLength < bestLength)) {
+	    best = first;
+	    bestLength = runLength;
+	}
+    }
+    *length = min(bestLength, count);
+    return best;
+}
+
+//----------------------------------------------------------------------
+// PersistentBitmap::FindRun
+// 	Find a run of "count" clear bits for the file system to allocate,
+//	or the longest there is, as FindClearRun does: the best fit, if
+//	the file system places files that way, or else the first at or
+//	after "from".
+//----------------------------------------------------------------------
+
+int
+PersistentBitmap::FindRun(int count, int *length, int from)
+{
+    if (bestFit)
+	return FindBestFit(count, length);
+    return FindClearRun(count, length, from);
+}
+
+//----------------------------------------------------------------------
+// PersistentBitmap::SetDirty
+// 	Note that the sectors of the bitmap holding the "count" bits
+//	starting with bit "first" are out of date on disk.
+//----------------------------------------------------------------------
+
+void
+PersistentBitmap::SetDirty(int first, int count)
+{
+    int bitsPerSector = SectorSize * BitsInByte;
+
+    if (count == 0)
+	return;
+    for (int i = first / bitsPerSector; i <= (first + count - 1) / bitsPerSector; i++)
+	dirty[i] = TRUE;
 }
 
 //----------------------------------------------------------------------
 // PersistentBitmap::FetchFrom
-// 	Initialize the contents of a persistent bitmap from a Nachos file.
+// 	Initialize the contents of a persistent bitmap from a Nachos file,
+//	and rebuild its tree, if it has one, to match.
 //
 //	"file" is the place to read the bitmap from
 //----------------------------------------------------------------------
@@ -63,6 +261,11 @@ void
 PersistentBitmap::FetchFrom(OpenFile *file) 
 {
     file->ReadAt((char *)map, numWords * sizeof(unsigned), 0);
+    Recount();
+    for (int i = 0; i < numSectors; i++)
+	dirty[i] = FALSE;
+    if (tree != NULL)
+	tree->Build(this);
 }
 
 //----------------------------------------------------------------------
@@ -76,4 +279,40 @@ void
 PersistentBitmap::WriteBack(OpenFile *file)
 {
    file->WriteAt((char *)map, numWords * sizeof(unsigned), 0);
+   for (int i = 0; i < numSectors; i++)
+	dirty[i] = FALSE;
+}
+
+//----------------------------------------------------------------------
+// PersistentBitmap::WriteDirty
+// 	Store the sectors of a persistent bitmap that have changed since
+//	it was last read or written to a Nachos file, a run of
+//	consecutive ones at a time, and then the sectors of reference
+//	counts that have changed, in the same transaction.
+//
+//	"file" is the place to write the bitmap to
+//----------------------------------------------------------------------
+
+void
+PersistentBitmap::WriteDirty(OpenFile *file)
+{
+    int size = numWords * sizeof(unsigned);
+
+    for (int first = 0; first < numSectors; first++) {
+	int last = first;
+
+	if (!dirty[first])
+	    continue;
+	while (last + 1 < numSectors && dirty[last + 1])
+	    last++;
+	DEBUG(dbgFile, "Writing free map sectors " << first << " to " << last);
+	file->WriteAt((char *)map + first * SectorSize,
+		min((last + 1) * SectorSize, size) - first * SectorSize,
+		first * SectorSize);
+	for (int i = first; i <= last; i++)
+	    dirty[i] = FALSE;
+	first = last;
+    }
+    if (refs != NULL)
+	refs->WriteDirty();
 }
@@ -6,6 +6,14 @@
 //    when it is created, or it can be initialized later using
 //    the FetchFrom method
 //
+//    It remembers which sectors' worth of it have changed since it was
+//    last read or written, so that WriteDirty can write only those.
+//
+//    A free map can be given the trees of its free extents (freetree.h),
+//    which it then keeps up to date as bits are marked and cleared,
+//    and the reference counts of the sectors (refcount.h), so that a
+//    sector shared by clones is freed only by the last of them.
+//
 // Copyright (c) 1992,1993,1995 The Regents of the University of California.
 // All rights reserved.  See copyright.h for copyright notice and limitation 
 // of liability and disclaimer of warranty provisions.
@@ -16,6 +24,9 @@
 #include "copyright.h"
 #include "bitmap.h"
 #include "openfile.h"
+#include "freetree.h"
+
+class BlockRefs;
 
 // The following class defines a persistent bitmap.  It inherits all
 // the behavior of a bitmap (see bitmap.h), adding the ability to
@@ -28,8 +39,51 @@ class PersistentBitmap : public Bitmap {
 
     ~PersistentBitmap(); 			// deallocate bitmap
 
+    void Mark(int which);		// Set or clear the "nth" bit, noting
+    void Clear(int which);		// that its sector has changed
+    void MarkRange(int first, int count);
+    void ClearRange(int first, int count);
+					// or "count" of them, noting that
+					// their sectors have changed
+    void ReleaseRange(int first, int count);
+					// A file lets go of a cluster:
+					// clear it, unless it is shared
+
     void FetchFrom(OpenFile *file);     // read bitmap from the disk
     void WriteBack(OpenFile *file); 	// write bitmap contents to disk 
+    void WriteDirty(OpenFile *file);	// write just the sectors of it
+					// that have changed (and of the
+					// reference counts)
+
+    void SetTree(FreeExtentTree *extents) { tree = extents; }
+					// keep "extents" up to date, from
+					// now on
+    void SetRefs(BlockRefs *counts) { refs = counts; }
+					// free shared sectors by "counts"
+    void SetBestFit(bool on) { bestFit = on; }
+					// should FindRun find the best fit?
+    int FindBestFit(int count, int *length);
+					// As FindClearRun, but the start of
+					// the shortest run of "count" clear
+					// bits, from the tree
+    int FindRun(int count, int *length, int from);
+					// FindBestFit or FindClearRun, as
+					// set by SetBestFit
+
+  private:
+    void InitDirty();			// Start with no sector changed
+    void SetDirty(int first, int count);// Note that the sectors holding
+					// some bits have changed
+
+    void TakeRuns(int first, int count);// Tell the tree about the runs of
+    void GiveRuns(int first, int count);// clear/set bits about to change
+
+    int numSectors;			// sectors the bitmap takes on disk
+    bool *dirty;			// has each of them changed?
+    FreeExtentTree *tree;		// its free extents, or NULL
+    BlockRefs *refs;			// the sectors' reference counts, or
+					// NULL
+    bool bestFit;			// FindRun finds the best fit
 };
 
 #endif // PBITMAP_H
@@ -0,0 +1,98 @@
+// pool.cc
+//	Routines to hand out objects from a pool, and take them back.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "pool.h"
+#include "debug.h"
+
+Pool *Pool::allPools = NULL;
+
+//----------------------------------------------------------------------
+// Pool::Pool
+// 	Initialize an empty pool of objects "objectSize" bytes long, for
+//	the class "className", and add it to the list of pools.  Called
+//	before main, for a static pool, so it allocates nothing.
+//----------------------------------------------------------------------
+
+Pool::Pool(char *className, size_t objectSize)
+{
+    name = className;
+    size = divRoundUp(objectSize, sizeof(double)) * sizeof(double);
+    freeObjects = NULL;
+    numAllocs = numSlabs = numInUse = maxInUse = 0;
+    nextPool = allPools;
+    allPools = this;
+}
+
+//----------------------------------------------------------------------
+// Pool::Alloc
+// 	Return the memory for an object: the most recently freed one,
+//	or if there is none, the first of a new slab, the rest of which
+//	goes on the free list.
+//
+//	"objectSize" is the size of the object wanted, as passed to
+//	operator new; it must fit
+//----------------------------------------------------------------------
+
+void *
+Pool::Alloc(size_t objectSize)
+{
+    void *p;
+
+    ASSERT(objectSize <= size);
+    if (freeObjects == NULL) {
+	char *slab = new char[PoolSlabObjects * size];
+
+	for (int i = PoolSlabObjects - 1; i >= 0; i--) {
+	    p = slab + i * size;
+	    *(void **) p = freeObjects;
+	    freeObjects = p;
+	}
+	numSlabs++;
+    }
+    p = freeObjects;
+    freeObjects = *(void **) p;
+    numAllocs++;
+    if (++numInUse > maxInUse)
+	maxInUse = numInUse;
+    return p;
+}
+
+//----------------------------------------------------------------------
+// Pool::Free
+// 	Put an object's memory on the free list.
+//----------------------------------------------------------------------
+
+void
+Pool::Free(void *object)
+{
+    if (object == NULL)
+	return;
+    *(void **) object = freeObjects;
+    freeObjects = object;
+    numInUse--;
+}
+
+//----------------------------------------------------------------------
+// Pool::PrintAll
+// 	Print, for each pool that was used, how many objects it handed
+//	out, how many of those the host allocator was asked for (a slab
+//	at a time), and how many there were at most at once.
+//----------------------------------------------------------------------
+
+void
+Pool::PrintAll()
+{
+    for (Pool *pool = allPools; pool != NULL; pool = pool->nextPool) {
+	if (pool->numAllocs == 0)
+	    continue;
+	cout << "Pool " << pool->name << ": " << pool->numAllocs
+	     << " allocations, " << pool->numSlabs * PoolSlabObjects
+	     << " from the host, at most " << pool->maxInUse
+	     << " in use\n";
+    }
+}
@@ -0,0 +1,62 @@
+// pool.h
+//	Data structures for handing out the small objects the file system
+//	makes and throws away on every operation -- file headers, open
+//	files, directories and their nodes, index blocks, disk requests --
+//	without going to the host's allocator each time.
+//
+//	Each such class has a pool of objects its size, and its own
+//	operator new and delete that use it.  Objects are carved out of
+//	slabs of PoolSlabObjects at a time; a freed object goes on the
+//	pool's free list, to be handed out again, and slabs are never
+//	given back.  So once the file system has made as many of each as
+//	it ever has at once, Create, Open, Read and Write allocate nothing
+//	from the host.
+//
+//	These are pools rather than an arena emptied at the end of each
+//	operation: an operation can wait for the disk halfway through
+//	while another thread runs one of its own, and some objects (open
+//	files, the headers they share) outlive the operation that made
+//	them.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#ifndef POOL_H
+#define POOL_H
+
+#include "copyright.h"
+#include "utility.h"
+#include <stddef.h>
+
+#define PoolSlabObjects	32		// objects carved out at a time
+
+// The following class defines a pool of objects of one size.  Pools
+// are meant to be static: each one links itself onto a list of them
+// all, for PrintAll.
+
+class Pool {
+  public:
+    Pool(char *className, size_t objectSize);
+					// A pool of "objectSize" objects,
+					// for the class "className"
+
+    void *Alloc(size_t size);		// Take an object from the pool
+    void Free(void *object);		// Give one back
+
+    static void PrintAll();		// Print the use of every pool
+
+  private:
+    char *name;				// the class the objects are for
+    size_t size;			// bytes in each, rounded up
+    void *freeObjects;			// each free one points to the next
+    int numAllocs;			// objects handed out
+    int numSlabs;			// slabs taken from the host
+    int numInUse;			// objects handed out, not given back
+    int maxInUse;			// the most there ever were
+    Pool *nextPool;			// on the list of all pools
+
+    static Pool *allPools;		// the list of all pools
+};
+
+#endif // POOL_H
@@ -0,0 +1,220 @@
+// refcount.cc
+//	Routines to keep the reference count of every disk sector, for
+//	files that share sectors with their clones.  See refcount.h.
+//
+//	The counts are written through the disk cache, as metadata, so
+//	that a transaction holds them until it commits, with the free map.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "refcount.h"
+#include "synchdisk.h"
+#include "main.h"
+#include "memops.h"
+
+//----------------------------------------------------------------------
+// BlockRefs::BlockRefs
+// 	Initialize the in-memory counts kept in sectors "firstSector"
+//	through "firstSector" + "numSectors" - 1, every sector with a
+//	single reference.  Whether the disk has a reference count area
+//	is found out by Format or Mount.
+//----------------------------------------------------------------------
+
+BlockRefs::BlockRefs(int firstSector, int numSectors)
+{
+    ASSERT(sizeof(RefCountHeader) == SectorSize);
+    start = firstSector;
+    size = numSectors;
+    tableSectors = divRoundUp(NumSectors, SectorSize);
+    ASSERT(1 + tableSectors <= size);
+    extra = new unsigned char[tableSectors * SectorSize];
+    MemZero((char *) extra, tableSectors * SectorSize);
+    dirty = new bool[tableSectors];
+    for (int i = 0; i < tableSectors; i++)
+	dirty[i] = FALSE;
+    numShared = 0;
+}
+
+BlockRefs::~BlockRefs()
+{
+    delete [] extra;
+    delete [] dirty;
+}
+
+//----------------------------------------------------------------------
+// BlockRefs::Format
+// 	Write the header and the counts, none shared, when the disk is
+//	being formatted.  The caller has marked the area's sectors as in
+//	use.
+//----------------------------------------------------------------------
+
+void
+BlockRefs::Format()
+{
+    RefCountHeader header;
+
+    bzero((char *) &header, sizeof(header));
+    header.magic = RefCountMagic;
+    kernel->synchDisk->WriteSector(start, (char *) &header, TRUE);
+    for (int i = 0; i < tableSectors; i++) {
+	kernel->synchDisk->WriteSector(start + 1 + i,
+		(char *) &extra[i * SectorSize], TRUE);
+	dirty[i] = FALSE;
+    }
+}
+
+//----------------------------------------------------------------------
+// BlockRefs::Mount
+// 	When the file system is mounted, once the journal has been
+//	replayed: read the counts, if the disk was formatted with them.
+//
+//	Returns FALSE if the disk has no reference count area.
+//----------------------------------------------------------------------
+
+bool
+BlockRefs::Mount()
+{
+    RefCountHeader header;
+
+    kernel->synchDisk->ReadSector(start, (char *) &header, TRUE);
+    if (header.magic != RefCountMagic) {
+	DEBUG(dbgFile, "No reference counts on this disk");
+	return FALSE;
+    }
+    for (int i = 0; i < tableSectors; i++)
+	kernel->synchDisk->ReadSector(start + 1 + i,
+		(char *) &extra[i * SectorSize], TRUE);
+    numShared = 0;
+    for (int i = 0; i < NumSectors; i++)
+	if (extra[i] > 0)
+	    numShared++;
+    DEBUG(dbgFile, numShared << " sectors are shared between files");
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// BlockRefs::CanShare
+// 	Return whether each of "count" sectors from "first" can be given
+//	another reference.
+//----------------------------------------------------------------------
+
+bool
+BlockRefs::CanShare(int first, int count)
+{
+    for (int i = first; i < first + count; i++)
+	if (extra[i] == MaxExtraRefs)
+	    return FALSE;
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// BlockRefs::Share
+// 	Give "count" sectors from "first" one more reference each: a
+//	clone maps them too.
+//----------------------------------------------------------------------
+
+void
+BlockRefs::Share(int first, int count)
+{
+    ASSERT(CanShare(first, count));
+    for (int i = first; i < first + count; i++)
+	Change(i, 1);
+}
+
+//----------------------------------------------------------------------
+// BlockRefs::Drop
+// 	A file is letting go of "count" sectors from "first" (a cluster,
+//	whose sectors are always shared together).  If they are shared,
+//	take one reference away from each, and return TRUE: another file
+//	still has them.  Otherwise return FALSE, changing nothing; it's
+//	for the caller to free them.
+//----------------------------------------------------------------------
+
+bool
+BlockRefs::Drop(int first, int count)
+{
+    if (!Shared(first))
+	return FALSE;
+    for (int i = first; i < first + count; i++)
+	Change(i, -1);
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// BlockRefs::Change
+// 	Add "by" to the count of "sector", and note that its sector of
+//	counts is out of date on disk.
+//----------------------------------------------------------------------
+
+void
+BlockRefs::Change(int sector, int by)
+{
+    ASSERT(sector >= 0 && sector < NumSectors);
+    ASSERT(extra[sector] + by >= 0 && extra[sector] + by <= MaxExtraRefs);
+    if (extra[sector] == 0)
+	numShared++;
+    extra[sector] += by;
+    if (extra[sector] == 0)
+	numShared--;
+    dirty[sector / SectorSize] = TRUE;
+}
+
+//----------------------------------------------------------------------
+// BlockRefs::NumDirty
+// 	Return how many sectors of counts have changed since they were
+//	last written.
+//----------------------------------------------------------------------
+
+int
+BlockRefs::NumDirty()
+{
+    int n = 0;
+
+    for (int i = 0; i < tableSectors; i++)
+	if (dirty[i])
+	    n++;
+    return n;
+}
+
+//----------------------------------------------------------------------
+// BlockRefs::WriteDirty
+// 	Write back the sectors of counts that have changed.  Called in
+//	the transaction that changed them, when it writes the free map.
+//----------------------------------------------------------------------
+
+void
+BlockRefs::WriteDirty()
+{
+    for (int i = 0; i < tableSectors; i++) {
+	if (!dirty[i])
+	    continue;
+	DEBUG(dbgFile, "Writing reference count sector " << i);
+	kernel->synchDisk->WriteSector(start + 1 + i,
+		(char *) &extra[i * SectorSize], TRUE);
+	dirty[i] = FALSE;
+    }
+}
+
+//----------------------------------------------------------------------
+// BlockRefs::Check
+// 	Return whether every sector with more than one reference is in
+//	use in "freeMap", and the shared sectors are counted right.
+//----------------------------------------------------------------------
+
+bool
+BlockRefs::Check(const Bitmap *freeMap)
+{
+    int n = 0;
+
+    for (int i = 0; i < NumSectors; i++) {
+	if (extra[i] == 0)
+	    continue;
+	if (!freeMap->Test(i))
+	    return FALSE;
+	n++;
+    }
+    return n == numShared;
+}
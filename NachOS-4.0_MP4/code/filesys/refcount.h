@@ -0,0 +1,89 @@
+// refcount.h
+//	Data structures for counting how many files share each sector of
+//	the disk, so that a file can be cloned (-clone) by giving the
+//	copy a header of its own that maps the same data sectors, rather
+//	than copying the data.  Cloning then costs only as much as the
+//	file's index; a shared cluster is copied the first time either
+//	file writes to it (see FileSystem::Unshare), and a sector goes
+//	back to the free map only when the last file using it lets go.
+//
+//	The counts are kept in a reserved range of sectors, the reference
+//	count area: a header, then one byte for every sector of the disk,
+//	the number of references it has beyond the first.  Almost every
+//	byte is 0, so nothing but cloning and the copies it leads to
+//	changes them.  They are read in whole when the file system is
+//	mounted, and unlike the checksums (checksum.h) they are kept up
+//	to date on disk by the same transactions as the free map: each
+//	sector of counts an operation changes is written back along with
+//	the sectors of the free map it changed (see
+//	PersistentBitmap::WriteDirty), so the journal covers them too.
+//
+//	A disk formatted before there was a reference count area has no
+//	header there, and files on it can't be cloned.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#ifndef REFCOUNT_H
+#define REFCOUNT_H
+
+#include "copyright.h"
+#include "disk.h"
+#include "bitmap.h"
+
+#define RefCountMagic		0x52454653	// marks a reference count area
+#define MaxExtraRefs		255		// most references to a sector,
+						// beyond the first
+
+// The first sector of the reference count area.  Exactly one disk
+// sector in size.
+
+class RefCountHeader {
+  public:
+    int magic;				// RefCountMagic
+    char unused[SectorSize - sizeof(int)];
+};
+
+// The following class keeps the reference count of every sector.
+
+class BlockRefs {
+  public:
+    BlockRefs(int firstSector, int numSectors);
+					// The counts are kept in the
+					// "numSectors" sectors from
+					// "firstSector"
+    ~BlockRefs();
+
+    void Format();			// Start with no sector shared
+    bool Mount();			// Read the counts, if the disk has
+					// them; FALSE if it has none
+
+    bool Shared(int sector) { return extra[sector] > 0; }
+					// Is it in more than one file?
+    bool CanShare(int first, int count);// Is there room for one more
+					// reference to each of "count"
+					// sectors from "first"?
+    void Share(int first, int count);	// and give them one
+    bool Drop(int first, int count);	// Take one away, if they are
+					// shared; FALSE if they aren't
+    int NumShared() { return numShared; }
+					// sectors with more than one reference
+    int NumDirty();			// sectors of counts WriteDirty would
+					// write
+    void WriteDirty();			// Write those sectors
+
+    bool Check(const Bitmap *freeMap);	// Is every shared sector in use?
+
+  private:
+    void Change(int sector, int by);	// add "by" to a sector's count
+
+    int start;				// first sector of the area
+    int size;				// number of sectors in it
+    int tableSectors;			// sectors the counts take
+    unsigned char *extra;		// references to each beyond the first
+    bool *dirty;			// has each sector of them changed?
+    int numShared;			// sectors with extra references
+};
+
+#endif // REFCOUNT_H
@@ -0,0 +1,392 @@
+// replay.cc
+//	Routines to replay a trace of file system calls and sector
+//	requests, with no user program running.  See replay.h.
+//
+//	The thread calling Run reads the trace, waits until each request
+//	is due, and makes the file requests itself.  Sector requests are
+//	handed to ReplayDepth threads; "idle" counts those free to take
+//	one, so that the trace waits (and its requests are made late)
+//	only once all of them are busy.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "replay.h"
+#include "filesys.h"
+#include "synchdisk.h"
+#include "main.h"
+#include <fstream>
+
+// What each kind of request is called, in a trace and in the results
+
+static char *kindName[NumReplayKinds] = {
+    "create", "open", "read", "write", "close", "remove", "sread", "swrite"
+};
+
+//----------------------------------------------------------------------
+// ReplayThread
+// 	The body of each thread making sector requests.
+//----------------------------------------------------------------------
+
+static void
+ReplayThread(TraceReplay *replay)
+{
+    replay->Serve();
+}
+
+//----------------------------------------------------------------------
+// TraceReplay::TraceReplay
+// 	Get ready to replay the trace in the UNIX file "traceName", with
+//	no files open and nothing counted.
+//----------------------------------------------------------------------
+
+TraceReplay::TraceReplay(char *traceName)
+{
+    this->traceName = traceName;
+    start = 0;
+    for (int i = 0; i < MaxReplayFiles; i++) {
+	openName[i] = NULL;
+	openFile[i] = NULL;
+    }
+    buffer = NULL;
+    bufferSize = 0;
+    sectorQueue = new SynchList<ReplayRequest *>;
+    idle = new Semaphore("replay idle", 0);
+    finished = new Semaphore("replay finished", 0);
+    due = new Semaphore("replay due", 0);
+    for (int k = 0; k < NumReplayKinds; k++) {
+	numRequests[k] = maxResponse[k] = 0;
+	responseTicks[k] = 0;
+    }
+    numBusy = numLate = numFailed = 0;
+}
+
+//----------------------------------------------------------------------
+// TraceReplay::~TraceReplay
+// 	Close the files the trace left open, and de-allocate the rest.
+//----------------------------------------------------------------------
+
+TraceReplay::~TraceReplay()
+{
+    for (int i = 0; i < MaxReplayFiles; i++) {
+	if (openName[i] != NULL) {
+	    delete openFile[i];
+	    delete [] openName[i];
+	}
+    }
+    delete [] buffer;
+    delete due;
+    delete finished;
+    delete idle;
+    delete sectorQueue;
+}
+
+//----------------------------------------------------------------------
+// TraceReplay::Run
+// 	Replay the trace: start the threads for sector requests, make
+//	each request when it is due, or as soon after as the requests
+//	before it let us, wait for the last sector request to be done,
+//	and print the response times.  A line that can't be parsed is
+//	reported and skipped.
+//
+//	Returns FALSE, replaying nothing, if the trace can't be opened.
+//----------------------------------------------------------------------
+
+bool
+TraceReplay::Run()
+{
+    ifstream in(traceName);
+    char buf[600];
+    int line = 0;
+
+    if (!in) {
+	printf("Replay: couldn't open trace %s\n", traceName);
+	return FALSE;
+    }
+    for (int i = 0; i < ReplayDepth; i++) {
+	Thread *t = kernel->NewThread("replay");
+
+	ASSERT(t != NULL);
+	t->Fork((VoidFunctionPtr) ReplayThread, (void *) this);
+	idle->V();
+    }
+    kernel->StartFlusher();
+    start = kernel->stats->totalTicks;
+    while (in.getline(buf, sizeof(buf))) {
+	ReplayRequest *request;
+	int wait;
+
+	line++;
+	if (buf[0] == '#' || strspn(buf, " \t") == strlen(buf))
+	    continue;			// comment or blank line
+	request = new ReplayRequest;
+	if (!Parse(buf, request)) {
+	    printf("Replay: %s:%d: can't parse: %s\n", traceName, line, buf);
+	    numFailed++;
+	    delete request;
+	    continue;
+	}
+	wait = start + request->due - kernel->stats->totalTicks;
+	if (wait > 0) {
+	    kernel->interrupt->Schedule(this, wait, TimerInt);
+	    due->P();
+	}
+	DEBUG(dbgFile, "Replaying " << kindName[request->kind] << " due at "
+		<< request->due);
+	if (request->kind == ReplaySectorRead
+		|| request->kind == ReplaySectorWrite) {
+	    if (wait < 0 || numBusy == ReplayDepth)
+		numLate++;		// behind, or every thread busy
+	    idle->P();
+	    numBusy++;
+	    sectorQueue->Append(request);
+	} else {
+	    if (wait < 0)
+		numLate++;
+	    Do(request);
+	    Done(request);
+	    delete request;
+	}
+    }
+    for (int i = 0; i < ReplayDepth; i++) {
+	sectorQueue->Append(NULL);	// one at a time, since a List
+	finished->P();			// holds an item only once
+    }
+    Print();
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// TraceReplay::CallBack
+// 	The interrupt Run scheduled for when the next request is due:
+//	wake it up to make the request.
+//----------------------------------------------------------------------
+
+void
+TraceReplay::CallBack()
+{
+    due->V();
+}
+
+//----------------------------------------------------------------------
+// TraceReplay::Parse
+// 	Read the request on one line of the trace into "request".
+//	Returns FALSE if the line isn't a request, or asks for sectors
+//	that aren't on the disk.
+//----------------------------------------------------------------------
+
+bool
+TraceReplay::Parse(char *buf, ReplayRequest *request)
+{
+    char what[10];
+    int n, k, args;
+
+    n = sscanf(buf, " %d %9s %255s %d %d", &request->due, what,
+		request->name, &request->position, &request->size);
+    if (n < 2)
+	return FALSE;
+    for (k = 0; k < NumReplayKinds; k++)
+	if (strcmp(what, kindName[k]) == 0)
+	    break;
+    if (k == NumReplayKinds || request->due < 0)
+	return FALSE;
+    request->kind = (ReplayKind) k;
+    switch (request->kind) {
+      case ReplayCreate:		// <file> <bytes>
+	request->size = request->position;
+	request->position = 0;
+	return n == 4 && request->size >= 0;
+      case ReplayRead:
+      case ReplayWrite:			// <file> <offset> <bytes>
+	return n == 5 && request->position >= 0 && request->size >= 0;
+      case ReplaySectorRead:
+      case ReplaySectorWrite:		// <sector> <count>
+	request->size = request->position;
+	args = sscanf(request->name, "%d", &request->position);
+	return n == 4 && args == 1 && request->position >= 0
+		&& request->size > 0
+		&& request->position + request->size <= NumSectors;
+      default:				// <file>
+	return n == 3;
+    }
+}
+
+//----------------------------------------------------------------------
+// TraceReplay::Do
+// 	Make a file request, as the system call for it would.  A request
+//	the file system refuses -- a file that can't be created, opened
+//	or removed, or one that isn't open for a read, write or close --
+//	is counted as failed.
+//----------------------------------------------------------------------
+
+void
+TraceReplay::Do(ReplayRequest *request)
+{
+    FileSystem *fileSystem = kernel->fileSystem;
+    int slot = Find(request->name);
+    bool ok = TRUE;
+
+    switch (request->kind) {
+      case ReplayCreate:
+	ok = fileSystem->Create(request->name, request->size);
+	break;
+      case ReplayRemove:
+	ok = fileSystem->Remove(request->name);
+	break;
+      case ReplayOpen:
+	if (slot != -1 || (slot = Find(NULL)) == -1) {
+	    ok = FALSE;			// open already, or too many open
+	    break;
+	}
+	openFile[slot] = fileSystem->Open(request->name);
+	if (openFile[slot] == NULL) {
+	    ok = FALSE;
+	    break;
+	}
+	openName[slot] = new char[strlen(request->name) + 1];
+	strcpy(openName[slot], request->name);
+	break;
+      case ReplayClose:
+	if (slot == -1) {
+	    ok = FALSE;
+	    break;
+	}
+	delete openFile[slot];
+	delete [] openName[slot];
+	openFile[slot] = NULL;
+	openName[slot] = NULL;
+	break;
+      case ReplayRead:
+	if (slot == -1)
+	    ok = FALSE;
+	else
+	    openFile[slot]->ReadAt(Data(request->size), request->size,
+				   request->position);
+	break;
+      case ReplayWrite:
+	if (slot == -1)
+	    ok = FALSE;
+	else
+	    openFile[slot]->WriteAt(Data(request->size), request->size,
+				    request->position);
+	break;
+      default:
+	ASSERTNOTREACHED();
+    }
+    if (!ok) {
+	DEBUG(dbgFile, "Replay: " << kindName[request->kind] << " "
+		<< request->name << " failed");
+	numFailed++;
+    }
+}
+
+//----------------------------------------------------------------------
+// TraceReplay::Serve
+// 	Make the sector requests handed to this thread, one at a time,
+//	until it is handed a NULL.  Each has a buffer of its own, since
+//	several are outstanding at once.
+//----------------------------------------------------------------------
+
+void
+TraceReplay::Serve()
+{
+    ReplayRequest *request;
+
+    while ((request = sectorQueue->RemoveFront()) != NULL) {
+	char *data = new char[request->size * SectorSize];
+
+	if (request->kind == ReplaySectorRead) {
+	    kernel->synchDisk->ReadSectors(request->position, request->size,
+					   data);
+	} else {
+	    for (int i = 0; i < request->size * SectorSize; i++)
+		data[i] = (char) i;
+	    kernel->synchDisk->WriteSectors(request->position, request->size,
+					    data);
+	}
+	delete [] data;
+	Done(request);
+	delete request;
+	numBusy--;
+	idle->V();
+    }
+    finished->V();
+}
+
+//----------------------------------------------------------------------
+// TraceReplay::Done
+// 	A request has been done: count how long after it was due.
+//----------------------------------------------------------------------
+
+void
+TraceReplay::Done(ReplayRequest *request)
+{
+    int response = kernel->stats->totalTicks - (start + request->due);
+
+    numRequests[request->kind]++;
+    responseTicks[request->kind] += response;
+    maxResponse[request->kind] = max(maxResponse[request->kind], response);
+}
+
+//----------------------------------------------------------------------
+// TraceReplay::Find
+// 	Return the slot of the open file "name", or -1 if it isn't open.
+//	With "name" NULL, return a free slot, or -1 if there is none.
+//----------------------------------------------------------------------
+
+int
+TraceReplay::Find(char *name)
+{
+    for (int i = 0; i < MaxReplayFiles; i++) {
+	if (name == NULL ? openName[i] == NULL
+		: openName[i] != NULL && strcmp(openName[i], name) == 0)
+	    return i;
+    }
+    return -1;
+}
+
+//----------------------------------------------------------------------
+// TraceReplay::Data
+// 	Return a buffer of at least "size" bytes for a file request,
+//	holding the pattern written.
+//----------------------------------------------------------------------
+
+char *
+TraceReplay::Data(int size)
+{
+    if (buffer == NULL || size > bufferSize) {
+	delete [] buffer;
+	bufferSize = max(size, max(2 * bufferSize, SectorSize));
+	buffer = new char[bufferSize];
+	for (int i = 0; i < bufferSize; i++)
+	    buffer[i] = (char) i;
+    }
+    return buffer;
+}
+
+//----------------------------------------------------------------------
+// TraceReplay::Print
+// 	Print how many requests of each kind were made, and how long they
+//	took to be done from when they were due.
+//----------------------------------------------------------------------
+
+void
+TraceReplay::Print()
+{
+    int total = 0;
+
+    for (int k = 0; k < NumReplayKinds; k++) {
+	total += numRequests[k];
+	if (numRequests[k] == 0)
+	    continue;
+	cout << "Replay " << kindName[k] << ": " << numRequests[k]
+	     << " requests, response mean "
+	     << responseTicks[k] / numRequests[k] << ", max "
+	     << maxResponse[k] << " ticks\n";
+    }
+    cout << "Replay: " << total << " requests in "
+	 << kernel->stats->totalTicks - start << " ticks, " << numLate
+	 << " made late, " << numFailed << " failed\n";
+}
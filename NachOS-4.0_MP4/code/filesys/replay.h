@@ -0,0 +1,137 @@
+// replay.h
+//	Data structures for replaying a trace of file system calls, or of
+//	raw sector requests, straight against the file system and the
+//	disk (-replay): no user program is run, so no MIPS instruction is
+//	interpreted.  A trace replays in a fraction of the time the
+//	programs it was taken from would, so that cache, placement and
+//	disk scheduling policies (-ds, -fp, -flush, -housekeep, -ssd, and
+//	so on) can be compared by replaying the same trace under each;
+//	-S and -bench print the same statistics as for a full run.
+//
+//	Each line of a trace is a comment (starting with #), or one
+//	request:
+//
+//	    <tick> create <file> <bytes>
+//	    <tick> open <file>
+//	    <tick> read <file> <offset> <bytes>
+//	    <tick> write <file> <offset> <bytes>
+//	    <tick> close <file>
+//	    <tick> remove <file>
+//	    <tick> sread <sector> <count>
+//	    <tick> swrite <sector> <count>
+//
+//	"tick" is when the request is made, counted from the start of the
+//	replay, and the lines are in that order.  A request that comes
+//	while the one before it is still being done is made late, as soon
+//	as that one is; so a trace with every tick 0 runs as fast as the
+//	disk allows.  Until a request is due, the replay waits for an
+//	interrupt it schedules for that tick, so that the request is made
+//	at exactly its tick, and the time between requests is spent idle,
+//	with the timer stopped, as it would be for programs blocked on
+//	the disk.
+//
+//	The file requests are made one at a time, by one thread, as one
+//	user program would make them: a read or write is of a file an
+//	earlier "open" opened, and that hasn't been closed since.  As for
+//	a program, a file keeps the size it was created with, and a read
+//	or write past its end is cut short.  What is written doesn't
+//	matter, so it is a fixed pattern.
+//
+//	The sector requests, "sread" and "swrite" of "count" sectors from
+//	"sector", go to SynchDisk::ReadSectors and WriteSectors, by the
+//	buffer cache.  Up to ReplayDepth of them are outstanding at once,
+//	each made by a thread of its own, so that the disk has a queue of
+//	them to schedule.  An swrite overwrites whatever the sectors hold,
+//	so a trace of them is for a disk with nothing else on it.
+//
+//	Once the trace has been replayed, Nachos prints, for each kind of
+//	request, how many there were and their response time -- from the
+//	tick a request was due to when it was done -- and then halts.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include "copyright.h"
+#include "openfile.h"
+#include "callback.h"
+#include "synch.h"
+#include "synchlist.h"
+
+// The most sector requests outstanding at once, and files open at once
+
+const int ReplayDepth = 8;
+const int MaxReplayFiles = 32;
+
+// The kinds of request in a trace
+
+enum ReplayKind {
+    ReplayCreate, ReplayOpen, ReplayRead, ReplayWrite, ReplayClose,
+    ReplayRemove, ReplaySectorRead, ReplaySectorWrite,
+    NumReplayKinds
+};
+
+// One request of a trace
+
+class ReplayRequest {
+  public:
+    ReplayKind kind;
+    int due;				// tick it is made at, from the start
+					// of the replay
+    char name[256];			// the file, for a file request
+    int position;			// offset in the file, or first sector
+    int size;				// bytes, or sectors
+};
+
+// The following class replays one trace.
+
+class TraceReplay : public CallBackObj {
+  public:
+    TraceReplay(char *traceName);	// ready to replay the trace in
+					// the UNIX file "traceName"
+    ~TraceReplay();
+
+    bool Run();				// Replay it, and print the response
+					// times; FALSE if it can't be read
+
+    void Serve();			// The body of a thread making sector
+					// requests
+    void CallBack();			// The next request is due
+
+  private:
+    bool Parse(char *buf, ReplayRequest *request);
+					// read a line of the trace
+    void Do(ReplayRequest *request);	// make a file request
+    void Done(ReplayRequest *request);	// count its response time
+    int Find(char *name);		// its slot in the open files, or -1
+    char *Data(int size);		// a buffer of at least "size" bytes
+    void Print();			// the response time of each kind
+
+    char *traceName;
+    int start;				// tick the replay started at
+    char *openName[MaxReplayFiles];	// the files open, or NULL
+    OpenFile *openFile[MaxReplayFiles];
+    char *buffer;			// for the file requests
+    int bufferSize;
+
+    SynchList<ReplayRequest *> *sectorQueue;
+					// sector requests to make, and
+					// a NULL for a thread to finish
+    Semaphore *idle;			// threads not making a request
+    int numBusy;			// and those that are
+    Semaphore *finished;		// threads that have finished
+    Semaphore *due;			// V'ed when the next request is due
+
+    int numRequests[NumReplayKinds];	// requests done, of each kind
+    long long responseTicks[NumReplayKinds];
+					// their total response time
+    int maxResponse[NumReplayKinds];	// and the longest
+    int numLate;			// made after their tick
+    int numFailed;			// that the file system refused, or
+					// couldn't be parsed
+};
+
+#endif // REPLAY_H
@@ -1,94 +1,1417 @@
-// synchdisk.cc 
-//	Routines to synchronously access the disk.  The physical disk 
+// synchdisk.cc
+//	Routines to synchronously access the disk.  The physical disk
 //	is an asynchronous device (disk requests return immediately, and
 //	an interrupt happens later on).  This is a layer on top of
 //	the disk providing a synchronous interface (requests wait until
 //	the request completes).
 //
-//	Use a semaphore to synchronize the interrupt handlers with the
-//	pending requests.  And, because the physical disk can only
-//	handle one operation at a time, use a lock to enforce mutual
-//	exclusion.
+//	Because the physical disk can only handle one operation at a
+//	time, requests are queued; each time the disk finishes one, the
+//	interrupt handler sends it the next.  A thread making a request
+//	waits on a semaphore for the interrupt handler to call it back.
+//
+//	Sectors are cached in a small number of buffers, so most requests
+//	for file headers, directories and the free map are satisfied
+//	without waiting for the disk.  A lock protects the cache, but it
+//	is not held while waiting for the disk, so that several threads
+//	can have requests queued at once; a buffer being read in or
+//	written out is marked busy meanwhile, and anyone else who wants
+//	it waits until it is not.
 //
 // Copyright (c) 1992-1993 The Regents of the University of California.
-// All rights reserved.  See copyright.h for copyright notice and limitation 
+// All rights reserved.  See copyright.h for copyright notice and limitation
 // of liability and disclaimer of warranty provisions.
 
 #include "copyright.h"
+#include "main.h"
 #include "synchdisk.h"
+#include "checksum.h"
+#include "pool.h"
+#include "warmstart.h"
+#include "memops.h"
+
+static Pool requestPool("DiskRequest", sizeof(DiskRequest));
+
+// A caller of the asynchronous interface that just waits for its
+// request to be done
+
+class DiskWaiter : public CallBackObj {
+  public:
+    DiskWaiter() { done = new Semaphore("disk request", 0); }
+    ~DiskWaiter() { delete done; }
+
+    void CallBack() { done->V(); }
+
+    Semaphore *done;
+};
+
+//----------------------------------------------------------------------
+// DiskRequest::DiskRequest
+// 	Initialize a request for "numSectors" sectors, starting at
+//	"sectorNumber", to be read into or written from "where".
+//
+//	"toCall" is called back when the request is done
+//----------------------------------------------------------------------
+
+DiskRequest::DiskRequest(int sectorNumber, int numSectors, char *where,
+			bool write, CallBackObj *toCall)
+{
+    sector = sectorNumber;
+    count = numSectors;
+    data = where;
+    writing = write;
+    caller = toCall;
+    buffer = -1;
+    queuedAt = 0;
+    whole = NULL;
+    piecesLeft = 0;
+    merged = FALSE;
+    riders = nextRider = NULL;
+}
+
+//----------------------------------------------------------------------
+// DiskRequest::operator new, DiskRequest::operator delete
+// 	Take the memory for a disk request from the pool of them, and give it
+//	back (see pool.h).
+//----------------------------------------------------------------------
+
+void *
+DiskRequest::operator new(size_t size)
+{
+    return requestPool.Alloc(size);
+}
+
+void
+DiskRequest::operator delete(void *p)
+{
+    requestPool.Free(p);
+}
 
+//----------------------------------------------------------------------
+// DiskUnit::DiskUnit
+// 	Initialize disk "unit" of the array "owner", with nothing queued,
+//	in turn initializing the physical disk.
+//----------------------------------------------------------------------
+
+DiskUnit::DiskUnit(SynchDisk *owner, int unit, bool mapped,
+			SnapshotAction snapshot, DiskDevice device)
+{
+    array = owner;
+    number = unit;
+    disk = new Disk(this, mapped, snapshot, unit, device);
+    queue = new List<DiskRequest *>;
+    active = NULL;
+    sweepUp = TRUE;
+    numServed = 0;
+}
+
+DiskUnit::~DiskUnit()
+{
+    ASSERT(active == NULL && queue->IsEmpty());
+    delete disk;
+    delete queue;
+}
+
+//----------------------------------------------------------------------
+// DiskUnit::CallBack
+// 	Disk interrupt handler: pass it on to the SynchDisk.
+//----------------------------------------------------------------------
+
+void
+DiskUnit::CallBack()
+{
+    array->UnitDone(this);
+}
 
 //----------------------------------------------------------------------
 // SynchDisk::SynchDisk
-// 	Initialize the synchronous interface to the physical disk, in turn
-//	initializing the physical disk.
+// 	Initialize the synchronous interface to the physical disks, in
+//	turn initializing the physical disks.
 //
+//	"diskSchedule" is how to choose the next request for a disk
+//	"mapped" is whether the disks map their UNIX files into memory
+//	"snapshot" is what the disks should do with their snapshots
+//	"numDisks" is how many disks there are
+//	"arrayLayout" is how sectors are spread over them, if several
+//	"stripeSectors" is the sectors in a chunk, if striped
+//	"device" is the kind of disk each one is
 //----------------------------------------------------------------------
 
-SynchDisk::SynchDisk()
+SynchDisk::SynchDisk(DiskSchedule diskSchedule, bool mapped,
+			SnapshotAction snapshot, int numDisks,
+			ArrayLayout arrayLayout, int stripeSectors,
+			DiskDevice device)
 {
-    semaphore = new Semaphore("synch disk", 0);
+    ASSERT(numDisks >= 1 && numDisks <= MaxDisks && stripeSectors >= 1);
+    schedule = diskSchedule;
+    layout = arrayLayout;
+    stripe = stripeSectors;
+    numOutstanding = 0;
     lock = new Lock("synch disk lock");
-    disk = new Disk(this);
+    numWaiting = 0;
+    requestDone = new Semaphore("disk request done", 0);
+    numUnits = numDisks;
+    units = new DiskUnit *[numUnits];
+    for (int i = 0; i < numUnits; i++)
+	units[i] = new DiskUnit(this, i, mapped, snapshot, device);
+    buffers = new CacheBuffer[NumCacheBuffers];
+    for (int i = 0; i < NumCacheBuffers; i++) {
+	buffers[i].sector = -1;
+	buffers[i].dirty = FALSE;
+	buffers[i].dirtiedAt = 0;
+	buffers[i].use = 0;
+	buffers[i].pinned = FALSE;
+	buffers[i].metadata = FALSE;
+	buffers[i].busy = FALSE;
+	buffers[i].held = FALSE;
+    }
+    bufferOf = new int[NumSectors];
+    for (int i = 0; i < NumSectors; i++)
+	bufferOf[i] = -1;
+    hand = 0;
+    numPinned = 0;
+    logging = FALSE;
+    maxLogged = numLogged = 0;
+    logged = new int[NumCacheBuffers];
+    checksums = NULL;
+    writeThrough = FALSE;
+    merging = TRUE;
+    warmForgotten = FALSE;
+    numRequests = totalDepth = maxDepth = 0;
+    numServed = totalService = 0;
+    numMerged = numSuperseded = 0;
 }
 
 //----------------------------------------------------------------------
 // SynchDisk::~SynchDisk
 // 	De-allocate data structures needed for the synchronous disk
-//	abstraction.
+//	abstraction.  Anything still dirty in the cache is lost, so the
+//	file system must Sync first.
 //----------------------------------------------------------------------
 
 SynchDisk::~SynchDisk()
 {
-    delete disk;
+    ASSERT(numOutstanding == 0);
+    delete [] buffers;
+    delete [] bufferOf;
+    delete [] logged;
+    for (int i = 0; i < numUnits; i++)
+	delete units[i];
+    delete [] units;
     delete lock;
-    delete semaphore;
+    delete requestDone;
 }
 
 //----------------------------------------------------------------------
 // SynchDisk::ReadSector
 // 	Read the contents of a disk sector into a buffer.  Return only
-//	after the data has been read.
+//	after the data has been read, from the cache if it is there.
 //
 //	"sectorNumber" -- the disk sector to read
 //	"data" -- the buffer to hold the contents of the disk sector
+//	"metadata" -- is this a file header, directory, or free map sector?
 //----------------------------------------------------------------------
 
 void
-SynchDisk::ReadSector(int sectorNumber, char* data)
+SynchDisk::ReadSector(int sectorNumber, char* data, bool metadata)
 {
-    lock->Acquire();			// only one disk I/O at a time
-    disk->ReadRequest(sectorNumber, data);
-    semaphore->P();			// wait for interrupt
+    lock->Acquire();
+    CacheBuffer *buf = FindBuffer(sectorNumber, metadata, TRUE);
+    MemCopy(data, buf->data, SectorSize);
     lock->Release();
 }
 
 //----------------------------------------------------------------------
 // SynchDisk::WriteSector
-// 	Write the contents of a buffer into a disk sector.  Return only
-//	after the data has been written.
+// 	Write the contents of a buffer into a disk sector.  The new
+//	contents go into the cache, and reach the disk when the buffer
+//	is reused or the cache is synced -- or now, in write-through
+//	mode.
+//
+//	Since the whole sector is overwritten, it need not be read in
+//	first.
 //
 //	"sectorNumber" -- the disk sector to be written
 //	"data" -- the new contents of the disk sector
+//	"metadata" -- is this a file header, directory, or free map sector?
+//----------------------------------------------------------------------
+
+void
+SynchDisk::WriteSector(int sectorNumber, char* data, bool metadata)
+{
+    lock->Acquire();
+    CacheBuffer *buf = FindBuffer(sectorNumber, metadata, FALSE);
+    MemCopy(buf->data, data, SectorSize);
+    Dirty(bufferOf[sectorNumber]);
+    lock->Release();
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::ReadSectors
+// 	Read "count" consecutive sectors into "data".  Sectors already in
+//	the cache are copied from there (they may be newer than the disk);
+//	each run of uncached sectors is read straight into "data" with one
+//	disk request.  Bulk data read this way is not cached.
+//
+//	"sectorNumber" -- the first disk sector to read
+//	"count" -- the number of sectors
+//	"data" -- the buffer to hold them, "count" * SectorSize bytes
+//----------------------------------------------------------------------
+
+void
+SynchDisk::ReadSectors(int sectorNumber, int count, char* data)
+{
+    int run;
+
+    ASSERT((sectorNumber >= 0) && (sectorNumber + count <= NumSectors));
+    lock->Acquire();
+    for (int i = 0; i < count; i += run) {
+	int which = bufferOf[sectorNumber + i];
+
+	run = 1;
+	if (which != -1) {
+	    if (buffers[which].busy) {
+		WaitForDisk();
+		run = 0;			// look at this sector again
+		continue;
+	    }
+	    MemCopy(&data[i * SectorSize], buffers[which].data, SectorSize);
+	    buffers[which].use = max(buffers[which].use, 1);
+	    continue;
+	}
+	while (i + run < count && bufferOf[sectorNumber + i + run] == -1)
+	    run++;
+	Transfer(sectorNumber + i, &data[i * SectorSize], run, FALSE);
+    }
+    lock->Release();
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::WriteSectors
+// 	Write "count" consecutive sectors from "data".  Sectors that are
+//	in the cache are just updated there; each run of uncached sectors
+//	is written straight from "data" with one disk request, and returns
+//	only once it is on the disk.  In a transaction, though, every
+//	sector goes into the cache, to be held there.
+//
+//	"sectorNumber" -- the first disk sector to write
+//	"count" -- the number of sectors
+//	"data" -- their new contents, "count" * SectorSize bytes
+//----------------------------------------------------------------------
+
+void
+SynchDisk::WriteSectors(int sectorNumber, int count, char* data)
+{
+    int run;
+
+    ASSERT((sectorNumber >= 0) && (sectorNumber + count <= NumSectors));
+    lock->Acquire();
+    for (int i = 0; i < count; i += run) {
+	int which = bufferOf[sectorNumber + i];
+
+	run = 1;
+	if (which != -1) {
+	    if (buffers[which].busy) {
+		WaitForDisk();
+		run = 0;			// look at this sector again
+		continue;
+	    }
+	    MemCopy(buffers[which].data, &data[i * SectorSize], SectorSize);
+	    buffers[which].use = max(buffers[which].use, 1);
+	    Dirty(which);
+	    continue;
+	}
+	if (logging) {
+	    CacheBuffer *buf = FindBuffer(sectorNumber + i, FALSE, FALSE);
+	    MemCopy(buf->data, &data[i * SectorSize], SectorSize);
+	    Dirty(bufferOf[sectorNumber + i]);
+	    continue;
+	}
+	while (i + run < count && bufferOf[sectorNumber + i + run] == -1)
+	    run++;
+	Transfer(sectorNumber + i, &data[i * SectorSize], run, TRUE);
+    }
+    lock->Release();
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::Prefetch
+// 	Start reading "sectorNumber" into the cache, unless it is already
+//	there, and return without waiting for it.  Used to read ahead of
+//	a thread reading a file sequentially.
+//
+//	If the buffers the CLOCK hand comes to are dirty, they are
+//	written behind, and the hand moves on.
+//----------------------------------------------------------------------
+
+void
+SynchDisk::Prefetch(int sectorNumber)
+{
+    ASSERT((sectorNumber >= 0) && (sectorNumber < NumSectors));
+    lock->Acquire();
+    if (bufferOf[sectorNumber] == -1) {
+	int which = FindVictim();
+
+	while (which != -1 && buffers[which].dirty) {
+	    StartBackground(which, TRUE);
+	    which = FindVictim();
+	}
+	if (which != -1) {
+	    CacheBuffer *buf = &buffers[which];
+
+	    DEBUG(dbgDisk, "Prefetching sector " << sectorNumber);
+	    if (buf->sector != -1)
+		bufferOf[buf->sector] = -1;
+	    buf->sector = sectorNumber;
+	    buf->use = 1;
+	    buf->metadata = FALSE;
+	    bufferOf[sectorNumber] = which;
+	    StartBackground(which, FALSE);
+	}
+    }
+    lock->Release();
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::WriteBehind
+// 	Start writing "sectorNumber" from the cache back to the disk, if
+//	it is dirty, and return without waiting for it.  Used once a
+//	thread writing a file sequentially is done with a sector.
+//----------------------------------------------------------------------
+
+void
+SynchDisk::WriteBehind(int sectorNumber)
+{
+    ASSERT((sectorNumber >= 0) && (sectorNumber < NumSectors));
+    lock->Acquire();
+    int which = bufferOf[sectorNumber];
+    if (which != -1 && buffers[which].dirty && !buffers[which].busy
+		&& !buffers[which].held)
+	StartBackground(which, TRUE);
+    lock->Release();
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::Pin
+// 	Bring a sector into the cache, and never evict it.  Used for the
+//	sectors the file system touches on almost every operation.
+//
+//	Returns FALSE if MaxPinnedBuffers are pinned already; the sector
+//	is then cached only as any other metadata is.
+//----------------------------------------------------------------------
+
+bool
+SynchDisk::Pin(int sectorNumber)
+{
+    bool pinned = TRUE;
+
+    lock->Acquire();
+    CacheBuffer *buf = FindBuffer(sectorNumber, TRUE, TRUE);
+    if (!buf->pinned && numPinned >= MaxPinnedBuffers) {
+	DEBUG(dbgDisk, "Not pinning sector " << sectorNumber
+		<< ": " << numPinned << " are");
+	pinned = FALSE;
+    } else if (!buf->pinned) {
+	buf->pinned = TRUE;
+	numPinned++;
+	DEBUG(dbgDisk, "Pinning sector " << sectorNumber);
+    }
+    lock->Release();
+    return pinned;
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::Warm
+// 	Put "data", known to be what the disk holds in metadata sector
+//	"sectorNumber", in a free buffer, as if it had just been read;
+//	for starting with the cache as a run left it (see warmstart.h).
+//	Returns FALSE, caching nothing, if the sector is cached already
+//	or no buffer is free.
+//----------------------------------------------------------------------
+
+bool
+SynchDisk::Warm(int sectorNumber, char *data)
+{
+    int which = -1;
+
+    if (sectorNumber < 0 || sectorNumber >= NumSectors)
+	return FALSE;
+    lock->Acquire();
+    if (bufferOf[sectorNumber] == -1) {
+	for (int i = 0; i < NumCacheBuffers && which == -1; i++)
+	    if (buffers[i].sector == -1 && !buffers[i].busy)
+		which = i;
+    }
+    if (which != -1) {
+	CacheBuffer *buf = &buffers[which];
+
+	buf->sector = sectorNumber;
+	buf->dirty = FALSE;
+	buf->use = 2;
+	buf->metadata = TRUE;
+	MemCopy(buf->data, data, SectorSize);
+	bufferOf[sectorNumber] = which;
+    }
+    lock->Release();
+    return which != -1;
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::HotSectors
+// 	Copy each metadata sector in the cache that is the same as on
+//	disk (clean, and not being read in) to "data", a sector each, and
+//	its number to "sectors", in room for NumCacheBuffers of each.
+//	Returns how many there are.
+//----------------------------------------------------------------------
+
+int
+SynchDisk::HotSectors(int *sectors, char *data)
+{
+    int count = 0;
+
+    lock->Acquire();
+    for (int i = 0; i < NumCacheBuffers; i++) {
+	CacheBuffer *buf = &buffers[i];
+
+	if (buf->sector != -1 && buf->metadata && !buf->dirty
+		&& !buf->busy) {
+	    sectors[count] = buf->sector;
+	    MemCopy(&data[count * SectorSize], buf->data, SectorSize);
+	    count++;
+	}
+    }
+    lock->Release();
+    return count;
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::Discard
+// 	The sector won't be wanted again soon.  If its buffer is clean,
+//	free it now; if it is dirty, start writing it back, and leave it
+//	with no second chances, so it is the first CLOCK reuses.  Pinned,
+//	busy and held buffers are left alone.
+//----------------------------------------------------------------------
+
+void
+SynchDisk::Discard(int sectorNumber)
+{
+    ASSERT((sectorNumber >= 0) && (sectorNumber < NumSectors));
+    lock->Acquire();
+    int which = bufferOf[sectorNumber];
+    if (which != -1 && !buffers[which].pinned && !buffers[which].busy
+		&& !buffers[which].held) {
+	CacheBuffer *buf = &buffers[which];
+
+	buf->use = 0;
+	if (buf->dirty) {
+	    StartBackground(which, TRUE);
+	} else {
+	    DEBUG(dbgDisk, "Discarding sector " << sectorNumber);
+	    bufferOf[sectorNumber] = -1;
+	    buf->sector = -1;
+	}
+    }
+    lock->Release();
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::Sync
+// 	Write every dirty sector in the cache back to the disk.  The
+//	buffers stay valid.  The writes are all queued at once, so the
+//	disk schedule can order them, and we return once the disk has
+//	nothing left to do.  Sectors held by a transaction are left alone.
+//	Disks mapped into memory then write that back to their UNIX
+//	files.
+//----------------------------------------------------------------------
+
+void
+SynchDisk::Sync()
+{
+    lock->Acquire();
+    for (int i = 0; i < NumCacheBuffers; i++) {
+	if (buffers[i].sector != -1 && buffers[i].dirty && !buffers[i].busy
+		&& !buffers[i].held)
+	    StartBackground(i, TRUE);
+    }
+    while (numOutstanding > 0)
+	WaitForDisk();
+    for (int i = 0; i < numUnits; i++)
+	units[i]->disk->Flush();
+    lock->Release();
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::Flush
+// 	Write back those of the "count" sectors in "sectors" that are
+//	dirty in the cache, and wait until they are all on the disk, for
+//	Fsync.  As in Sync, the writes are queued together, and sectors
+//	held by a transaction are left alone (the journal has them).
+//----------------------------------------------------------------------
+
+void
+SynchDisk::Flush(int *sectors, int count)
+{
+    lock->Acquire();
+    for (int i = 0; i < count; i++) {
+	int which = bufferOf[sectors[i]];
+
+	if (which != -1 && buffers[which].dirty && !buffers[which].busy
+		&& !buffers[which].held)
+	    StartBackground(which, TRUE);
+    }
+    for (int i = 0; i < count; i++) {
+	int which = bufferOf[sectors[i]];
+
+	if (which != -1 && buffers[which].busy) {
+	    WaitForDisk();
+	    i = -1;			// look at them all again
+	}
+    }
+    lock->Release();
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::WriteBackOlder
+// 	Start writing back every sector that has been dirty in the cache
+//	since before tick "when", and return how many there were, without
+//	waiting for them.  Called by the flusher thread, so that no write
+//	stays only in memory for long.
+//----------------------------------------------------------------------
+
+int
+SynchDisk::WriteBackOlder(int when)
+{
+    int n = 0;
+
+    lock->Acquire();
+    for (int i = 0; i < NumCacheBuffers; i++) {
+	if (buffers[i].sector != -1 && buffers[i].dirty && !buffers[i].busy
+		&& !buffers[i].held && buffers[i].dirtiedAt < when) {
+	    StartBackground(i, TRUE);
+	    n++;
+	}
+    }
+    lock->Release();
+    return n;
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::NumWritable
+// 	Return how many sectors are dirty in the cache and could be
+//	written back now: not being read or written already, and not
+//	held by a transaction.  Looks without the lock, so that it can be
+//	called with interrupts off, from Thread::Sleep.
+//----------------------------------------------------------------------
+
+int
+SynchDisk::NumWritable()
+{
+    int n = 0;
+
+    for (int i = 0; i < NumCacheBuffers; i++) {
+	if (buffers[i].sector != -1 && buffers[i].dirty && !buffers[i].busy
+		&& !buffers[i].held)
+	    n++;
+    }
+    return n;
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::WriteBackAfter
+// 	Write back up to "count" of the sectors NumWritable counts, and
+//	wait until they are on the disk; return how many there were.
+//	They are the first ones at or after sector "*from", going round
+//	to sector 0 past the last, and "*from" is left just past the
+//	last one written, so that calls one after another sweep across
+//	the disk like an elevator.  Called by the housekeeper, a batch
+//	at a time, so that a request that comes while it is writing
+//	waits behind at most "count" sectors.
+//----------------------------------------------------------------------
+
+int
+SynchDisk::WriteBackAfter(int *from, int count)
+{
+    int sectors[NumCacheBuffers];
+    int n = 0;
+
+    ASSERT(*from >= 0 && *from < NumSectors);
+    lock->Acquire();
+    for (int i = 0; i < NumCacheBuffers; i++) {
+	if (buffers[i].sector == -1 || !buffers[i].dirty || buffers[i].busy
+		|| buffers[i].held)
+	    continue;
+	int distance = (buffers[i].sector - *from + NumSectors) % NumSectors;
+	int j = n++;
+
+	for (; j > 0; j--) {		// keep them in elevator order
+	    int other = (sectors[j - 1] - *from + NumSectors) % NumSectors;
+
+	    if (other < distance)
+		break;
+	    sectors[j] = sectors[j - 1];
+	}
+	sectors[j] = buffers[i].sector;
+    }
+    n = min(n, count);
+    for (int i = 0; i < n; i++)
+	StartBackground(bufferOf[sectors[i]], TRUE);
+    for (int i = 0; i < n; i++) {
+	int which = bufferOf[sectors[i]];
+
+	if (which != -1 && buffers[which].busy) {
+	    WaitForDisk();
+	    i = -1;			// look at them all again
+	}
+    }
+    if (n > 0)
+	*from = (sectors[n - 1] + 1) % NumSectors;
+    lock->Release();
+    return n;
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::StartTransaction
+// 	From now on, hold each sector written (through the cache) in the
+//	cache until FinishTransaction, so that none of them reaches the
+//	disk before the journal has a copy of them all.
+//
+//	Only "maxSectors" sectors are held (what fits in the journal);
+//	past that, sectors are written as usual.
+//----------------------------------------------------------------------
+
+void
+SynchDisk::StartTransaction(int maxSectors)
+{
+    lock->Acquire();
+    ASSERT(!logging);
+    logging = TRUE;
+    maxLogged = min(maxSectors, NumCacheBuffers / 2);
+    numLogged = 0;
+    lock->Release();
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::EndTransaction
+// 	Stop holding the sectors written from now on.  Put the numbers of
+//	the sectors held by the current transaction in "sectors", in the
+//	order they were first written, and return how many there are.
+//	They stay held until FinishTransaction; meanwhile their contents
+//	can be read with ReadSector.
+//----------------------------------------------------------------------
+
+int
+SynchDisk::EndTransaction(int *sectors)
+{
+    lock->Acquire();
+    ASSERT(logging);
+    logging = FALSE;
+    for (int i = 0; i < numLogged; i++)
+	sectors[i] = logged[i];
+    int n = numLogged;
+    lock->Release();
+    return n;
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::FinishTransaction
+// 	After EndTransaction: write the sectors the transaction held to
+//	the disk, and wait until they are all there.  After this the copy
+//	in the journal is no longer needed.
+//----------------------------------------------------------------------
+
+void
+SynchDisk::FinishTransaction()
+{
+    lock->Acquire();
+    ASSERT(!logging);
+    for (int i = 0; i < numLogged; i++) {
+	CacheBuffer *buf = &buffers[bufferOf[logged[i]]];
+
+	buf->held = FALSE;
+	if (buf->dirty && !buf->busy)
+	    StartBackground(bufferOf[logged[i]], TRUE);
+    }
+    for (int i = 0; i < numLogged; i++) {
+	int which = bufferOf[logged[i]];
+
+	if (which != -1 && buffers[which].busy) {
+	    WaitForDisk();
+	    i = -1;			// look at them all again
+	}
+    }
+    numLogged = 0;
+    lock->Release();
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::Log
+// 	Buffer "which" has just been written.  If we are in a transaction,
+//	hold it in the cache (if there is still room in the transaction).
+//	The caller must hold the lock.
+//----------------------------------------------------------------------
+
+void
+SynchDisk::Log(int which)
+{
+    CacheBuffer *buf = &buffers[which];
+
+    if (!logging || buf->held)
+	return;
+    if (numLogged == maxLogged) {
+	DEBUG(dbgDisk, "Transaction full, not holding sector " << buf->sector);
+	return;
+    }
+    buf->held = TRUE;
+    logged[numLogged++] = buf->sector;
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::Dirty
+// 	Buffer "which" has just been written.  Mark it dirty, noting when
+//	it became so, and hold it if we are in a transaction.  Otherwise,
+//	in write-through mode, write it to the disk now, and wait.  The
+//	caller must hold the lock.
+//----------------------------------------------------------------------
+
+void
+SynchDisk::Dirty(int which)
+{
+    CacheBuffer *buf = &buffers[which];
+
+    if (!buf->dirty) {
+	buf->dirty = TRUE;
+	buf->dirtiedAt = kernel->stats->totalTicks;
+    }
+    Log(which);
+    if (writeThrough && !buf->held) {
+	buf->busy = TRUE;
+	buf->dirty = FALSE;
+	Transfer(buf->sector, buf->data, 1, TRUE);
+	buf->busy = FALSE;
+	WakeWaiters();
+    }
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::Submit
+// 	Queue a request for the disk, and return at once.  The request
+//	goes straight to the disk, not through the buffer cache; when it
+//	is done, the interrupt handler calls request->caller->CallBack().
+//
+//	A request is never served before one queued earlier that it
+//	overlaps, if either is a write.  The caller must not touch the
+//	request (or its data) until it is called back.
+//
+//	On an array, the request is split into pieces, one for each
+//	run of sectors on one disk: a striped request into a piece for
+//	each chunk it touches, a mirrored write into a piece for every
+//	disk, and a mirrored read into one, for the least busy disk.
+//	Since a logical sector is always on the same disk (or, mirrored,
+//	a write on each of them), keeping each disk's requests in order
+//	keeps them all in order.
+//----------------------------------------------------------------------
+
+void
+SynchDisk::Submit(DiskRequest *request)
+{
+    ASSERT((request->sector >= 0) && (request->count > 0)
+		&& (request->sector + request->count <= NumSectors));
+    IntStatus oldLevel = kernel->interrupt->SetLevel(IntOff);
+    request->queuedAt = kernel->stats->totalTicks;
+    numOutstanding++;
+    if (request->writing && !warmForgotten) {
+	WarmStart::Forget();		// it no longer matches the disk
+	warmForgotten = TRUE;
+    }
+
+    int depth = numOutstanding;
+    numRequests++;
+    totalDepth += depth;
+    maxDepth = max(maxDepth, depth);
+
+    if (numUnits == 1) {
+	Queue(units[0], request);
+    } else if (layout == MirroredLayout) {
+	if (request->writing) {
+	    for (int i = 0; i < numUnits; i++)
+		Queue(units[i], Piece(request, request->sector, 0,
+				request->count));
+	} else {
+	    Queue(MirrorFor(request), Piece(request, request->sector, 0,
+				request->count));
+	}
+    } else {
+	for (int i = 0; i < request->count; ) {
+	    int logical = request->sector + i;
+	    int chunk = logical / stripe, offset = logical % stripe;
+	    int n = min(stripe - offset, request->count - i);
+
+	    Queue(units[chunk % numUnits],
+		  Piece(request, chunk / numUnits * stripe + offset, i, n));
+	    i += n;
+	}
+    }
+    kernel->interrupt->SetLevel(oldLevel);
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::Piece
+// 	Return a new request for "count" sectors of "whole", from its
+//	"first"th on, to go to "sector" of one of the disks.  "whole" is
+//	done when all its pieces are.
+//----------------------------------------------------------------------
+
+DiskRequest *
+SynchDisk::Piece(DiskRequest *whole, int sector, int first, int count)
+{
+    DiskRequest *piece = new DiskRequest(sector, count,
+				whole->data + first * SectorSize,
+				whole->writing, NULL);
+
+    piece->whole = whole;
+    piece->queuedAt = whole->queuedAt;
+    whole->piecesLeft++;
+    return piece;
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::MirrorFor
+// 	Return the disk a mirrored read should go to: the one with the
+//	fewest requests queued or being done; of those, the one whose
+//	head is nearest the sector.
+//----------------------------------------------------------------------
+
+DiskUnit *
+SynchDisk::MirrorFor(DiskRequest *request)
+{
+    DiskUnit *best = NULL;
+    int bestLoad = 0, bestDistance = 0;
+
+    for (int i = 0; i < numUnits; i++) {
+	DiskUnit *unit = units[i];
+	int load = unit->queue->NumInList() + ((unit->active != NULL) ? 1 : 0);
+	int distance = abs(unit->disk->HeadSector() - request->sector);
+
+	if (best == NULL || load < bestLoad
+		|| (load == bestLoad && distance < bestDistance)) {
+	    best = unit;
+	    bestLoad = load;
+	    bestDistance = distance;
+	}
+    }
+    return best;
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::Queue
+// 	Queue a request (or a piece of one) for disk "unit", and start
+//	it if the disk is idle.  Called with interrupts off.
+//----------------------------------------------------------------------
+
+void
+SynchDisk::Queue(DiskUnit *unit, DiskRequest *request)
+{
+    if (merging && request->writing)
+	Supersede(unit, request);
+    unit->queue->Append(request);
+    if (unit->active == NULL)
+	StartNext(unit);
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::Supersede
+// 	Take the writes queued for disk "unit" that the write "request"
+//	covers entirely off the queue, and make them riders of it: they
+//	needn't be done, since the disk will hold "request"'s data
+//	anyway, but they are only done when it is.
+//
+//	A write that a read queued after it overlaps must be done, for
+//	the read to see it; to keep it simple, no write queued before a
+//	read is taken.
+//----------------------------------------------------------------------
+
+void
+SynchDisk::Supersede(DiskUnit *unit, DiskRequest *request)
+{
+    List<DiskRequest *> covered;
+    ListIterator<DiskRequest *> iter(unit->queue);
+
+    for (; !iter.IsDone(); iter.Next()) {
+	DiskRequest *earlier = iter.Item();
+
+	if (earlier->writing && earlier->sector >= request->sector
+		&& earlier->sector + earlier->count
+			<= request->sector + request->count)
+	    covered.Append(earlier);
+	else if (!earlier->writing)
+	    while (!covered.IsEmpty())
+		covered.RemoveFront();
+    }
+    while (!covered.IsEmpty()) {
+	DiskRequest *earlier = covered.RemoveFront();
+
+	unit->queue->Remove(earlier);
+	earlier->nextRider = request->riders;
+	request->riders = earlier;
+	numSuperseded++;
+	DEBUG(dbgDisk, "Write of " << earlier->count << " sector(s) at "
+		<< earlier->sector << " superseded");
+    }
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::Merge
+// 	"request" is next for disk "unit": take every request queued for
+//	it that is in the same direction, needn't wait for another, and
+//	is for the sectors just before or after it, and return one new
+//	request for them all, up to MaxMergeSectors, with a buffer of its
+//	own.  The merged requests are its riders, each done when it is.
+//	If there is nothing to merge, "request" itself is returned.
+//----------------------------------------------------------------------
+
+DiskRequest *
+SynchDisk::Merge(DiskUnit *unit, DiskRequest *request)
+{
+    DiskRequest *riders = request, *adjacent;
+    int first = request->sector, last = request->sector + request->count;
+
+    request->nextRider = NULL;
+    do {
+	ListIterator<DiskRequest *> iter(unit->queue);
+
+	adjacent = NULL;
+	for (; !iter.IsDone() && adjacent == NULL; iter.Next()) {
+	    DiskRequest *r = iter.Item();
+
+	    if (r->writing == request->writing
+		    && (r->sector == last || r->sector + r->count == first)
+		    && last - first + r->count <= MaxMergeSectors
+		    && !Blocked(unit, r))
+		adjacent = r;
+	}
+	if (adjacent != NULL) {
+	    unit->queue->Remove(adjacent);
+	    first = min(first, adjacent->sector);
+	    last = max(last, adjacent->sector + adjacent->count);
+	    adjacent->nextRider = riders;
+	    riders = adjacent;
+	    numMerged++;
+	}
+    } while (adjacent != NULL);
+    if (riders == request)
+	return request;
+
+    DiskRequest *merged = new DiskRequest(first, last - first,
+			new char[(last - first) * SectorSize],
+			request->writing, NULL);
+
+    merged->merged = TRUE;
+    merged->riders = riders;
+    merged->queuedAt = request->queuedAt;
+    if (merged->writing)
+	for (DiskRequest *r = riders; r != NULL; r = r->nextRider)
+	    MemCopy(merged->data + (r->sector - first) * SectorSize, r->data,
+			r->count * SectorSize);
+    DEBUG(dbgDisk, "Merged requests into " << merged->count
+		<< " sector(s) at " << first);
+    return merged;
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::PrintStats
+// 	Print how deep the disk queue got, and how long requests took
+//	from being submitted to being done, on average; then each disk's
+//	own statistics.
+//----------------------------------------------------------------------
+
+void
+SynchDisk::PrintStats()
+{
+    cout << "Disk queue: requests " << numRequests;
+    if (numRequests > 0) {
+	cout << ", average depth " << (double) totalDepth / numRequests;
+	cout << ", maximum depth " << maxDepth;
+    }
+    if (numServed > 0)
+	cout << ", average service " << totalService / numServed << " ticks";
+    cout << "\n";
+    if (numMerged > 0 || numSuperseded > 0)
+	cout << "Disk queue: " << numMerged << " requests merged into others, "
+	     << numSuperseded << " superseded writes dropped\n";
+    if (numUnits == 1) {
+	units[0]->disk->PrintStats();
+	return;
+    }
+    cout << "Disk array: " << numUnits << " disks, ";
+    if (layout == MirroredLayout)
+	cout << "mirrored\n";
+    else
+	cout << "striped in " << stripe << "-sector chunks\n";
+    for (int i = 0; i < numUnits; i++) {
+	cout << "Disk " << i << ": requests " << units[i]->numServed << "\n";
+	units[i]->disk->PrintStats();
+    }
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::FindBuffer
+// 	Return the cache buffer holding "sectorNumber", giving it a
+//	buffer if it has none.  If "fill", a newly cached sector is read
+//	in from the disk; otherwise the caller is about to overwrite it.
+//
+//	If the buffer chosen for it is dirty, it is written back first.
+//	The lock is released while waiting for the disk, or for a busy
+//	buffer, so after that we look the sector up again.
+//
+//	The caller must hold the lock.
+//----------------------------------------------------------------------
+
+CacheBuffer *
+SynchDisk::FindBuffer(int sectorNumber, bool metadata, bool fill)
+{
+    ASSERT((sectorNumber >= 0) && (sectorNumber < NumSectors));
+    CacheBuffer *buf;
+
+    for (;;) {
+	int which = bufferOf[sectorNumber];
+
+	if (which != -1) {
+	    buf = &buffers[which];
+	    if (!buf->busy)
+		break;
+	    WaitForDisk();		// being read in or written out
+	    continue;
+	}
+	which = FindVictim();
+	if (which == -1) {		// every buffer is busy
+	    WaitForDisk();
+	    continue;
+	}
+	buf = &buffers[which];
+	if (buf->sector != -1 && buf->dirty) {
+	    DEBUG(dbgDisk, "Writing back sector " << buf->sector << " from cache");
+	    buf->busy = TRUE;
+	    buf->dirty = FALSE;
+	    Transfer(buf->sector, buf->data, 1, TRUE);
+	    buf->busy = FALSE;
+	    WakeWaiters();
+	    hand = which;		// try it again first
+	    continue;
+	}
+	if (buf->sector != -1) {
+	    DEBUG(dbgDisk, "Evicting sector " << buf->sector << " from cache");
+	    bufferOf[buf->sector] = -1;
+	}
+	buf->sector = sectorNumber;
+	buf->dirty = FALSE;
+	buf->use = 0;
+	buf->metadata = FALSE;
+	bufferOf[sectorNumber] = which;
+	if (fill) {
+	    buf->busy = TRUE;
+	    Transfer(sectorNumber, buf->data, 1, FALSE);
+	    buf->busy = FALSE;
+	    WakeWaiters();
+	}
+	break;
+    }
+    buf->use = max(buf->use, metadata ? 2 : 1);
+    buf->metadata |= metadata;
+    return buf;
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::FindVictim
+// 	Choose a buffer to hold a newly cached sector: an unused one if
+//	there is one, otherwise the first one the CLOCK hand reaches
+//	that has no second chances left.  Every pass of the hand takes
+//	one chance away, so metadata survives one more pass than data.
+//
+//	Busy buffers, and those held by a transaction, are skipped; return
+//	-1 if every buffer that is not pinned is one of those.
+//----------------------------------------------------------------------
+
+int
+SynchDisk::FindVictim()
+{
+    for (int tries = 0; tries < 3 * NumCacheBuffers; tries++) {
+	int victim = hand;
+
+	hand = (hand + 1) % NumCacheBuffers;
+	if (buffers[victim].busy)
+	    continue;
+	if (buffers[victim].sector == -1)
+	    return victim;
+	if (buffers[victim].pinned || buffers[victim].held)
+	    continue;
+	if (buffers[victim].use == 0)
+	    return victim;
+	buffers[victim].use--;
+    }
+    return -1;
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::Transfer
+// 	Queue a request for "count" sectors, and wait until it is done.
+//	The caller must hold the lock; it is released once the request
+//	is queued (so any request for the same sectors queued after it is
+//	served after it), and acquired again before returning.
+//----------------------------------------------------------------------
+
+void
+SynchDisk::Transfer(int sectorNumber, char *data, int count, bool writing)
+{
+    DiskWaiter waiter;
+    DiskRequest request(sectorNumber, count, data, writing, &waiter);
+
+    Submit(&request);
+    lock->Release();
+    waiter.done->P();			// wait for interrupt
+    lock->Acquire();
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::StartBackground
+// 	Queue a read into, or a write from, buffer "which", without
+//	waiting for it.  The buffer is busy until the interrupt handler
+//	sees the request is done.  The caller must hold the lock.
 //----------------------------------------------------------------------
 
 void
-SynchDisk::WriteSector(int sectorNumber, char* data)
+SynchDisk::StartBackground(int which, bool writing)
 {
-    lock->Acquire();			// only one disk I/O at a time
-    disk->WriteRequest(sectorNumber, data);
-    semaphore->P();			// wait for interrupt
+    CacheBuffer *buf = &buffers[which];
+    DiskRequest *request = new DiskRequest(buf->sector, 1, buf->data,
+					writing, NULL);
+
+    request->buffer = which;
+    buf->busy = TRUE;
+    if (writing) {
+	DEBUG(dbgDisk, "Writing behind sector " << buf->sector);
+	buf->dirty = FALSE;
+    }
+    Submit(request);
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::WaitForDisk
+// 	Release the lock, wait until some request is done or a buffer is
+//	no longer busy, and acquire the lock again.  Called when what we
+//	want is in use; the caller looks again afterwards.
+//----------------------------------------------------------------------
+
+void
+SynchDisk::WaitForDisk()
+{
+    IntStatus oldLevel = kernel->interrupt->SetLevel(IntOff);
+    numWaiting++;
     lock->Release();
+    requestDone->P();
+    kernel->interrupt->SetLevel(oldLevel);
+    lock->Acquire();
 }
 
 //----------------------------------------------------------------------
-// SynchDisk::CallBack
-// 	Disk interrupt handler.  Wake up any thread waiting for the disk
-//	request to finish.
+// SynchDisk::WakeWaiters
+// 	Wake up every thread in WaitForDisk, so each can look again.
 //----------------------------------------------------------------------
 
 void
-SynchDisk::CallBack()
-{ 
-    semaphore->V();
+SynchDisk::WakeWaiters()
+{
+    IntStatus oldLevel = kernel->interrupt->SetLevel(IntOff);
+    for (; numWaiting > 0; numWaiting--)
+	requestDone->V();
+    kernel->interrupt->SetLevel(oldLevel);
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::StartNext
+// 	If there is a request waiting for disk "unit", send it to the
+//	disk.  Called with interrupts off, when the disk is free.
+//----------------------------------------------------------------------
+
+void
+SynchDisk::StartNext(DiskUnit *unit)
+{
+    ASSERT(unit->active == NULL);
+    DiskRequest *request = ChooseNext(unit);
+
+    if (request == NULL)
+	return;
+    unit->queue->Remove(request);
+    if (merging)
+	request = Merge(unit, request);
+    unit->active = request;
+    if (request->writing)
+	unit->disk->WriteRequest(request->sector, request->data,
+				request->count);
+    else
+	unit->disk->ReadRequest(request->sector, request->data,
+				request->count);
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::ChooseNext
+// 	Return the request queued for disk "unit" to serve next, or NULL
+//	if there is none.
+//	Requests that must wait for one queued earlier are passed over.
+//
+//	FCFSSchedule -- the oldest request
+//	SSTFSchedule -- the one the head can seek to soonest
+//		(Disk::TimeToSeek); the oldest of those, on a tie
+//	SCANSchedule -- the nearest one beyond the head in the direction
+//		it is sweeping; if there is none, the sweep turns round
+//	CLOOKSchedule -- the nearest one above the head; if there is
+//		none, the lowest one
+//----------------------------------------------------------------------
+
+DiskRequest *
+SynchDisk::ChooseNext(DiskUnit *unit)
+{
+    ListIterator<DiskRequest *> iter(unit->queue);
+    DiskRequest *best = NULL;
+    int bestCost = 0;
+    int head = unit->disk->HeadSector();
+
+    for (; !iter.IsDone(); iter.Next()) {
+	DiskRequest *request = iter.Item();
+	int cost, rotation;
+
+	if (Blocked(unit, request))
+	    continue;
+	switch (schedule) {
+	  case FCFSSchedule:
+	    return request;
+
+	  case SSTFSchedule:
+	    cost = unit->disk->TimeToSeek(request->sector, &rotation);
+	    break;
+
+	  case SCANSchedule:
+	    if (unit->sweepUp)
+		cost = (request->sector > head) ? request->sector - head
+			: NumSectors + head - request->sector;
+	    else
+		cost = (request->sector <= head) ? head - request->sector
+			: NumSectors + request->sector - head;
+	    break;
+
+	  case CLOOKSchedule:
+	    cost = (request->sector - head - 1 + NumSectors) % NumSectors;
+	    break;
+
+	  default:
+	    ASSERTNOTREACHED();
+	}
+	if (best == NULL || cost < bestCost) {
+	    best = request;
+	    bestCost = cost;
+	}
+    }
+    if (best != NULL && schedule == SCANSchedule && bestCost >= NumSectors)
+	unit->sweepUp = !unit->sweepUp;	// nothing left this way
+    return best;
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::Blocked
+// 	Return TRUE if "request" overlaps one queued before it for disk
+//	"unit", and either of them is a write, so they must be done in
+//	order.
+//----------------------------------------------------------------------
+
+bool
+SynchDisk::Blocked(DiskUnit *unit, DiskRequest *request)
+{
+    ListIterator<DiskRequest *> iter(unit->queue);
+
+    for (; iter.Item() != request; iter.Next()) {
+	DiskRequest *earlier = iter.Item();
+
+	if ((earlier->writing || request->writing)
+		&& (earlier->sector < request->sector + request->count)
+		&& (request->sector < earlier->sector + earlier->count))
+	    return TRUE;
+    }
+    return FALSE;
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::UnitDone
+// 	Disk interrupt handler.  The request disk "unit" was doing is
+//	done: finish it (see Complete), wake up any thread waiting for
+//	the disk, and start the disk's next request.
+//----------------------------------------------------------------------
+
+void
+SynchDisk::UnitDone(DiskUnit *unit)
+{
+    DiskRequest *request = unit->active;
+
+    ASSERT(request != NULL);
+    unit->active = NULL;
+    unit->numServed++;
+    Complete(request);
+    WakeWaiters();
+    StartNext(unit);
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::Complete
+// 	The disk has done "request".  Its riders are done too: if it was
+//	merged from them, reads are copied out of its buffer, which then
+//	goes away with it.  Otherwise it is done itself -- or, if it was
+//	a piece, the request is done once its last piece is.
+//----------------------------------------------------------------------
+
+void
+SynchDisk::Complete(DiskRequest *request)
+{
+    DiskRequest *rider = request->riders, *next;
+
+    for (; rider != NULL; rider = next) {
+	next = rider->nextRider;
+	if (request->merged && !request->writing)
+	    MemCopy(rider->data,
+		    request->data + (rider->sector - request->sector) * SectorSize,
+		    rider->count * SectorSize);
+	Complete(rider);
+    }
+    if (request->merged) {
+	delete [] request->data;
+	delete request;
+    } else if (request->whole == NULL) {
+	Finished(request);
+    } else {
+	DiskRequest *whole = request->whole;
+
+	delete request;
+	if (--whole->piecesLeft == 0)
+	    Finished(whole);
+    }
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::Finished
+// 	A request is done: tell whoever made it, or, for the cache's own
+//	requests, mark the buffer no longer busy.
+//----------------------------------------------------------------------
+
+void
+SynchDisk::Finished(DiskRequest *request)
+{
+    numOutstanding--;
+    numServed++;
+    totalService += kernel->stats->totalTicks - request->queuedAt;
+    if (checksums != NULL)
+	checksums->Transferred(request->sector, request->count, request->data,
+				request->writing);
+    if (request->caller != NULL) {
+	request->caller->CallBack();
+    } else {
+	buffers[request->buffer].busy = FALSE;
+	delete request;
+    }
 }
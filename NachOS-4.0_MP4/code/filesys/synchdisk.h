@@ -14,6 +14,70 @@
 #include "disk.h"
 #include "synch.h"
 #include "callback.h"
+#include "list.h"
+
+class Checksums;
+class SynchDisk;
+
+// A request to read or write a run of consecutive sectors, as queued
+// for the disk.  Callers of the asynchronous interface (SynchDisk::Submit)
+// fill one in, and keep it until told the request is done.
+
+class DiskRequest {
+  public:
+    DiskRequest(int sectorNumber, int numSectors, char *where,
+		bool write, CallBackObj *toCall);
+    static void *operator new(size_t size);	// from a pool of them,
+    static void operator delete(void *p);	// not the heap
+
+    int sector;				// first sector to transfer
+    int count;				// number of sectors
+    char *data;				// where the data goes or comes from
+    bool writing;			// is this a write?
+    CallBackObj *caller;		// told, from the disk interrupt
+					// handler, when the request is done
+    int buffer;				// for the cache's own requests
+					// (caller == NULL): the buffer busy
+					// with this one
+    int queuedAt;			// when the request was submitted
+    DiskRequest *whole;			// for a piece of a request split
+					// over the disks of an array: the
+					// request; otherwise NULL
+    int piecesLeft;			// for a request split into pieces:
+					// how many aren't done yet
+    bool merged;			// made by merging queued requests
+					// (the riders), into a buffer of
+					// its own?
+    DiskRequest *riders;		// requests done when this one is:
+					// merged into it, or writes it
+					// supersedes
+    DiskRequest *nextRider;		// the next of those, in a list
+};
+
+const int MaxMergeSectors = SectorsPerTrack;
+					// most sectors a merged request
+					// transfers
+
+// One of the disks under a SynchDisk: the raw device, the requests (or
+// pieces of requests) queued for it, and the one it is doing.  Each
+// disk has its own interrupt, which calls back here.
+
+class DiskUnit : public CallBackObj {
+  public:
+    DiskUnit(SynchDisk *owner, int unit, bool mapped,
+		SnapshotAction snapshot, DiskDevice device);
+    ~DiskUnit();
+
+    void CallBack();			// the disk is done: tell the owner
+
+    SynchDisk *array;			// the SynchDisk it belongs to
+    int number;				// which of its disks this is
+    Disk *disk;				// raw disk device
+    List<DiskRequest *> *queue;		// requests not yet sent to the disk
+    DiskRequest *active;		// request the disk is doing, or NULL
+    bool sweepUp;			// direction of the sweep, for SCAN
+    int numServed;			// requests the disk has done
+};
 
 // The following class defines a "synchronous" disk abstraction.
 // As with other I/O devices, the raw physical disk is an asynchronous device --
@@ -24,32 +88,232 @@
 //
 // This class provides the abstraction that for any individual thread
 // making a request, it waits around until the operation finishes before
-// returning.
+// returning.  Requests are kept in a queue, and whenever the disk is
+// free the next one is chosen according to the DiskSchedule, so threads
+// waiting on the disk at the same time are served in an order that keeps
+// the seeks short.  Requests can also be submitted asynchronously.
+//
+// Before a disk is sent a request, the requests queued for it for the
+// sectors just before or after are merged into it, so that a run of
+// sectors written back one at a time pays for one seek and rotation,
+// not one each; and a write that covers writes still queued drops
+// them.  Either way, the requests merged or dropped are only done
+// when the one the disk does is.
+//
+// A SynchDisk can also be an array of several disks, which work at
+// the same time.  Logical sector numbers stay those of one disk, so
+// the file system is none the wiser: a request is split into a piece
+// for each disk it touches, each piece queued and scheduled on its
+// own disk, and the request done when all its pieces are.  Striped,
+// logical sector s is in chunk c = s / stripe, which is on disk
+// c % n at c / n * stripe + s % stripe, so a long run keeps every disk
+// busy at once and each disk uses only 1/n of its sectors; mirrored,
+// each write goes to every disk and each read to the one with the
+// least to do.  A disk formatted in one layout must be used in it.
+//
+// Recently used sectors are kept in a buffer cache, so that a request
+// for one of them need not go to the disk at all.  Writes only update
+// the cached copy; dirty sectors go back to the disk when their buffer
+// is reused, or when Sync is called.  Buffers are reused in CLOCK order;
+// sectors marked as file system metadata get an extra second chance,
+// and pinned sectors are never evicted.
+//
+// Sectors can also be read into the cache (Prefetch) or written out
+// from it (WriteBehind) in the background: the request is queued, and
+// the caller does not wait for it.
+//
+// For the file system's journal, the sectors written during a
+// transaction are held in the cache, and none of them reaches the disk
+// until the transaction is finished (after the journal has a copy).
+//
+// How long dirty sectors stay in the cache trades durability against
+// throughput.  In write-through mode every write goes to the disk
+// before it returns.  Otherwise a flusher thread can call WriteBackOlder
+// now and then, to bound how long a write waits to reach the disk;
+// the housekeeper calls WriteBackAfter when the disk would otherwise
+// be idle; and Flush writes back the sectors of one file, for Fsync.
+
+const int NumCacheBuffers = 64;		// number of sectors cached in memory
+const int MaxPinnedBuffers = NumCacheBuffers / 4;
+					// most of them Pin may keep for good
 
-class SynchDisk : public CallBackObj {
+class CacheBuffer {
   public:
-    SynchDisk();    		        // Initialize a synchronous disk,
-					// by initializing the raw Disk.
+    int sector;				// sector held, or -1 if unused
+    bool dirty;				// modified since read from disk?
+    int dirtiedAt;			// if so, when it first was
+    int use;				// second chances left, for CLOCK
+    bool pinned;			// never evict this sector
+    bool metadata;			// read or written as metadata?
+    bool busy;				// being read in or written out
+    bool held;				// written in the current transaction;
+					// not to be written out until it ends
+    char data[SectorSize];		// contents of the sector
+};
+
+class SynchDisk {
+  public:
+    SynchDisk(DiskSchedule schedule = CLOOKSchedule, bool mapped = FALSE,
+		SnapshotAction snapshot = KeepSnapshot, int numDisks = 1,
+		ArrayLayout layout = StripedLayout,
+		int stripeSectors = DefaultStripeSectors,
+		DiskDevice device = RotatingDevice);
+					// Initialize a synchronous disk,
+					// by initializing the raw Disks.
     ~SynchDisk();			// De-allocate the synch disk data
     
-    void ReadSector(int sectorNumber, char* data);
+    void ReadSector(int sectorNumber, char* data, bool metadata = FALSE);
     					// Read/write a disk sector, returning
     					// only once the data is actually read 
-					// or written.  These call
-    					// Disk::ReadRequest/WriteRequest and
-					// then wait until the request is done.
-    void WriteSector(int sectorNumber, char* data);
+					// or written (into the buffer cache).
+					// "metadata" asks the cache to keep the
+					// sector longer than file data.
+    void WriteSector(int sectorNumber, char* data, bool metadata = FALSE);
+
+    void ReadSectors(int sectorNumber, int count, char* data);
+    void WriteSectors(int sectorNumber, int count, char* data);
+					// Read/write a run of consecutive
+					// sectors straight to/from "data";
+					// uncached parts of the run go to the
+					// disk as a single request
+
+    void Prefetch(int sectorNumber);	// Start reading a sector into the
+					// cache, without waiting for it
+    void WriteBehind(int sectorNumber);	// Start writing a cached sector
+					// back, without waiting for it
+
+    bool Pin(int sectorNumber);		// Keep a sector in the cache for
+					// good; FALSE if too many are
+    bool Warm(int sectorNumber, char *data);
+					// Cache "data" as the disk's copy of
+					// a metadata sector, in a free
+					// buffer; FALSE if there is none
+    int HotSectors(int *sectors, char *data);
+					// Copy out the clean metadata sectors
+					// cached; return how many
+    void Discard(int sectorNumber);	// Let the cache reuse a sector's
+					// buffer first
+    void Sync();			// Write every dirty sector to disk
+    void Flush(int *sectors, int count);
+					// Write those of "sectors" that are
+					// dirty to disk, and wait for them
+    int WriteBackOlder(int when);	// Start writing back the sectors
+					// dirty since before "when"
+    int NumWritable();			// Dirty sectors that could be
+					// written back now
+    int WriteBackAfter(int *from, int count);
+					// Write back "count" of them, the
+					// next in order from sector "*from"
+    bool IsIdle() { return numOutstanding == 0; }
+					// Is no request outstanding?
+    void SetWriteThrough(bool on) { writeThrough = on; }
+					// Write each sector to disk as soon
+					// as it is written?
+    void SetMerging(bool on) { merging = on; }
+					// Merge queued requests for adjacent
+					// sectors, and drop superseded
+					// writes?
+
+    void StartTransaction(int maxSectors);
+					// Hold the next sectors written in
+					// the cache, up to "maxSectors"
+    int EndTransaction(int *sectors);	// Stop holding sectors written, and
+					// return the ones held
+    void FinishTransaction();		// Write the held sectors to disk,
+					// and wait until they are there
+
+    void Submit(DiskRequest *request);	// Queue a request, bypassing the
+					// cache, and return at once; the
+					// request's caller is called back
+					// when it is done
+
+    void SetChecksums(Checksums *table) { checksums = table; }
+					// Check each sector read against
+					// "table", and update it for each
+					// sector written (NULL: don't)
+
+    void PrintStats();			// Print queue depth and service time
     
-    void CallBack();			// Called by the disk device interrupt
+    void UnitDone(DiskUnit *unit);	// Called by the disk device interrupt
 					// handler, to signal that the
-					// current disk operation is complete.
+					// unit's current request is complete.
 
   private:
-    Disk *disk;		  		// Raw disk device
-    Semaphore *semaphore; 		// To synchronize requesting thread 
-					// with the interrupt handler
-    Lock *lock;		  		// Only one read/write request
-					// can be sent to the disk at a time
+    CacheBuffer *FindBuffer(int sectorNumber, bool metadata, bool fill);
+					// Return the buffer for a sector,
+					// reading it in if "fill"
+    int FindVictim();			// choose a buffer to reuse
+    void Transfer(int sectorNumber, char *data, int count, bool writing);
+					// Do one request on the disk, and
+					// wait until it is done
+    void StartBackground(int which, bool writing);
+					// Read/write a buffer, without waiting
+    void WaitForDisk();			// wait for some request to finish
+    void WakeWaiters();			// a request finished, or a buffer is
+					// no longer busy
+    void Queue(DiskUnit *unit, DiskRequest *request);
+					// queue a request for one disk
+    DiskRequest *Piece(DiskRequest *whole, int sector, int first,
+			int count);	// a piece of "whole", for one disk
+    DiskUnit *MirrorFor(DiskRequest *request);
+					// the disk to read a mirrored request
+    void Finished(DiskRequest *request);
+					// a request is done: tell its caller
+    void Complete(DiskRequest *request);
+					// the disk did a request: finish it,
+					// its riders, or its whole
+    DiskRequest *Merge(DiskUnit *unit, DiskRequest *request);
+					// add the adjacent queued requests
+    void Supersede(DiskUnit *unit, DiskRequest *request);
+					// take the queued writes it covers
+    void StartNext(DiskUnit *unit);	// send a disk its next request
+    DiskRequest *ChooseNext(DiskUnit *unit);
+					// which request that is
+    bool Blocked(DiskUnit *unit, DiskRequest *request);
+					// must it wait for one queued
+					// earlier?
+    void Log(int which);		// hold a buffer just written, if in
+					// a transaction
+    void Dirty(int which);		// buffer "which" has just been
+					// written: mark it, and hold it or
+					// write it through
+
+    int numUnits;			// disks in the array
+    DiskUnit **units;			// and each one
+    ArrayLayout layout;			// how sectors are spread over them
+    int stripe;				// sectors in a chunk, if striped
+    DiskSchedule schedule;		// how each disk's next request is
+					// chosen
+    int numOutstanding;			// requests submitted and not done
+    Lock *lock;		  		// protects the buffer cache; not held
+					// while waiting for the disk
+    int numWaiting;			// threads in WaitForDisk
+    Semaphore *requestDone;		// to wake them up
+    CacheBuffer *buffers;		// the buffer cache
+    int *bufferOf;			// buffer holding each sector, or -1
+    int hand;				// next buffer to consider, for CLOCK
+    int numPinned;			// buffers that can never be reused
+
+    bool logging;			// in a transaction?
+    int maxLogged;			// most sectors it may hold
+    int numLogged;			// sectors it holds
+    int *logged;			// which ones
+
+    Checksums *checksums;		// of each sector, or NULL
+    bool writeThrough;			// write sectors to disk at once?
+    bool merging;			// merge and supersede requests?
+    bool warmForgotten;			// has a write removed the warm
+					// start file yet?
+
+    int numRequests;			// requests submitted
+    int totalDepth;			// sum of the requests outstanding
+					// when each one was submitted
+    int maxDepth;			// most requests ever outstanding
+    int numServed;			// requests completed
+    int totalService;			// sum of their times from submission
+					// to completion
+    int numMerged;			// requests merged into others
+    int numSuperseded;			// writes dropped, as superseded
 };
 
 #endif // SYNCHDISK_H
@@ -0,0 +1,264 @@
+// warmstart.cc
+//	Routines to save the buffer cache's metadata and the executable
+//	image cache in a UNIX file as Nachos halts, and fill the caches
+//	from it when Nachos next starts.  See warmstart.h.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "warmstart.h"
+#include "synchdisk.h"
+#include "checksum.h"
+#include "imagecache.h"
+#include "main.h"
+#include "memops.h"
+
+//----------------------------------------------------------------------
+// ImageBytes
+// 	Return the bytes an image takes in the file.
+//----------------------------------------------------------------------
+
+static int
+ImageBytes(ExecImage *image)
+{
+    int bytes = sizeof(int) + sizeof(NoffHeader);
+
+    bytes += max(image->noffH.code.size, 0);
+    bytes += max(image->noffH.initData.size, 0);
+#ifdef RDATA
+    bytes += max(image->noffH.readonlyData.size, 0);
+#endif
+    return bytes;
+}
+
+//----------------------------------------------------------------------
+// PutSegment, GetSegment
+// 	Copy the contents of a segment of "size" bytes to the file's
+//	bytes at "*to", or back from them at "*from", and move past them.
+//	An empty segment has no contents.
+//----------------------------------------------------------------------
+
+static void
+PutSegment(char **to, char *bytes, int size)
+{
+    if (size <= 0)
+	return;
+    MemCopy(*to, bytes, size);
+    *to += size;
+}
+
+static char *
+GetSegment(char **from, int size)
+{
+    char *bytes;
+
+    if (size <= 0)
+	return NULL;
+    bytes = new char[size];
+    MemCopy(bytes, *from, size);
+    *from += size;
+    return bytes;
+}
+
+//----------------------------------------------------------------------
+// WarmStart::WarmStart
+// 	Get ready to save or load the caches, for a disk of "numDisks"
+//	UNIX files.
+//----------------------------------------------------------------------
+
+WarmStart::WarmStart(int disks)
+{
+    numDisks = disks;
+    FileName(name);
+}
+
+WarmStart::~WarmStart()
+{
+}
+
+//----------------------------------------------------------------------
+// WarmStart::FileName
+// 	Put the UNIX name of the file in "name": the name of the disk's
+//	(first) file, with ".warm" after it.
+//----------------------------------------------------------------------
+
+void
+WarmStart::FileName(char *name)
+{
+    Disk::UnixName(0, name);
+    strcat(name, ".warm");
+}
+
+//----------------------------------------------------------------------
+// WarmStart::Forget
+// 	Remove the file, if there is one, since the disk is about to be
+//	written.
+//----------------------------------------------------------------------
+
+void
+WarmStart::Forget()
+{
+    char name[40];
+
+    FileName(name);
+    Unlink(name);
+}
+
+//----------------------------------------------------------------------
+// WarmStart::Generation
+// 	Return the disk's generation: a number that changes whenever
+//	one of its UNIX files, or their snapshots', is written.
+//----------------------------------------------------------------------
+
+long long
+WarmStart::Generation()
+{
+    char diskName[32], cowName[40];
+    long long generation = 0;
+
+    for (int i = 0; i < numDisks; i++) {
+	Disk::UnixName(i, diskName);
+	sprintf(cowName, "%s.cow", diskName);
+	generation = generation * 31 + FileVersion(diskName);
+	generation = generation * 31 + FileVersion(cowName);
+    }
+    return generation;
+}
+
+//----------------------------------------------------------------------
+// WarmStart::Load
+// 	Read the file, in one read, and if it is good, put its sectors
+//	in the buffer cache and its images in the image cache.  Must be
+//	called before the file system is mounted.
+//
+//	Returns FALSE, filling nothing, if there is no file, or it isn't
+//	one for the disk as it is now.
+//----------------------------------------------------------------------
+
+bool
+WarmStart::Load()
+{
+    int fd = OpenForReadWrite(name, FALSE);
+    int length, numSectors = 0, numImages = 0;
+    WarmHeader *header;
+    char *buffer, *next;
+
+    if (fd < 0)
+	return FALSE;
+    Lseek(fd, 0, 2);
+    length = Tell(fd);
+    if (length < (int) sizeof(WarmHeader)) {
+	Close(fd);
+	return FALSE;
+    }
+    buffer = new char[length];
+    Lseek(fd, 0, 0);
+    Read(fd, buffer, length);
+    Close(fd);
+
+    header = (WarmHeader *) buffer;
+    next = buffer + sizeof(WarmHeader);
+    if (header->magic != WarmMagic
+	    || header->length != length - (int) sizeof(WarmHeader)
+	    || header->crc != Crc32c(next, header->length)
+	    || header->generation != Generation()) {
+	DEBUG(dbgDisk, "Warm start file " << name << " is stale");
+	delete [] buffer;
+	return FALSE;
+    }
+    for (int i = 0; i < header->numSectors; i++) {
+	int sector = *(int *) next;
+
+	if (kernel->synchDisk->Warm(sector, next + sizeof(int)))
+	    numSectors++;
+	next += sizeof(int) + SectorSize;
+    }
+    for (int i = 0; i < header->numImages; i++) {
+	ExecImage *image = new ExecImage(*(int *) next);
+
+	next += sizeof(int);
+	MemCopy((char *) &image->noffH, next, sizeof(NoffHeader));
+	next += sizeof(NoffHeader);
+	image->code = GetSegment(&next, image->noffH.code.size);
+	image->initData = GetSegment(&next, image->noffH.initData.size);
+#ifdef RDATA
+	image->readonlyData = GetSegment(&next,
+					 image->noffH.readonlyData.size);
+#endif
+	if (kernel->imageCache->Warm(image))
+	    numImages++;
+    }
+    DEBUG(dbgDisk, "Warm start: " << numSectors << " sectors and "
+	  << numImages << " images from " << name);
+    delete [] buffer;
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// WarmStart::Save
+// 	Write the clean metadata sectors in the buffer cache, and the
+//	images in the image cache, to the file, with the disk's
+//	generation now.  Must be called once the file system is done
+//	with the disk.
+//----------------------------------------------------------------------
+
+void
+WarmStart::Save()
+{
+    int sectors[NumCacheBuffers];
+    char *data = new char[NumCacheBuffers * SectorSize];
+    int numSectors = kernel->synchDisk->HotSectors(sectors, data);
+    ExecImage *image[ImageCacheSize];
+    int numImages = 0;
+    int length = numSectors * (sizeof(int) + SectorSize);
+    WarmHeader *header;
+    char *buffer, *next;
+    int fd;
+
+    for (int i = 0; i < ImageCacheSize; i++) {
+	ExecImage *cached = kernel->imageCache->Image(i);
+
+	if (cached != NULL && cached->sector != -1) {
+	    image[numImages++] = cached;
+	    length += ImageBytes(cached);
+	}
+    }
+    buffer = new char[sizeof(WarmHeader) + length];
+    header = (WarmHeader *) buffer;
+    next = buffer + sizeof(WarmHeader);
+    for (int i = 0; i < numSectors; i++) {
+	*(int *) next = sectors[i];
+	MemCopy(next + sizeof(int), &data[i * SectorSize], SectorSize);
+	next += sizeof(int) + SectorSize;
+    }
+    for (int i = 0; i < numImages; i++) {
+	*(int *) next = image[i]->sector;
+	next += sizeof(int);
+	MemCopy(next, (char *) &image[i]->noffH, sizeof(NoffHeader));
+	next += sizeof(NoffHeader);
+	PutSegment(&next, image[i]->code, image[i]->noffH.code.size);
+	PutSegment(&next, image[i]->initData, image[i]->noffH.initData.size);
+#ifdef RDATA
+	PutSegment(&next, image[i]->readonlyData,
+		   image[i]->noffH.readonlyData.size);
+#endif
+    }
+    ASSERT(next == buffer + sizeof(WarmHeader) + length);
+
+    WaitHostJob();			// the disk's last write is done
+    header->magic = WarmMagic;
+    header->numSectors = numSectors;
+    header->numImages = numImages;
+    header->length = length;
+    header->crc = Crc32c(buffer + sizeof(WarmHeader), length);
+    header->generation = Generation();
+    fd = OpenForWrite(name);
+    WriteFile(fd, buffer, sizeof(WarmHeader) + length);
+    Close(fd);
+    DEBUG(dbgDisk, "Warm start: saved " << numSectors << " sectors and "
+	  << numImages << " images in " << name);
+    delete [] buffer;
+    delete [] data;
+}
@@ -0,0 +1,81 @@
+// warmstart.h
+//	Data structures for starting Nachos warm (-warm), so that a script
+//	running nachos again and again on the same disk (-cp, then -e,
+//	then -p) doesn't start every run with empty caches.
+//
+//	As Nachos halts, the file system metadata in the buffer cache --
+//	the free map, directories, file headers and indirect blocks,
+//	each by its sector -- and the images in the executable image
+//	cache are saved in a UNIX file next to the disk's (DISK_0.warm).
+//	The next run started with -warm reads the file back, in one read,
+//	and fills the caches from it before the file system is mounted.
+//
+//	The file is only good for the disk as it was when the file was
+//	saved, so:
+//
+//	   it records the disk's generation -- when the disk's UNIX files
+//	   (and their snapshots', cf. disk.h) were last modified -- and
+//	   is ignored if that has changed since, say because the disk
+//	   was copied over, or put back after a -checkpoint run;
+//
+//	   the first sector any run writes to the disk, with -warm or
+//	   without, removes the file (as does rolling back to a snapshot),
+//	   so a run that doesn't halt leaves none behind;
+//
+//	   and a CRC32C of its contents catches one that was cut short.
+//
+//	Only sectors that are clean in the cache are saved; anything
+//	still dirty at halt is the file system's to write back first.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#ifndef WARMSTART_H
+#define WARMSTART_H
+
+#include "copyright.h"
+#include "utility.h"
+
+// The start of the file: what follows it, and the disk it is for
+
+class WarmHeader {
+  public:
+    int magic;				// WarmMagic, for a file of this kind
+    int numSectors;			// sectors saved, each as its number
+					// and then its contents
+    int numImages;			// images saved after them, each as
+					// its header sector, its NOFF header,
+					// and its segments' contents
+    int length;				// bytes after the header
+    unsigned crc;			// their CRC32C
+    long long generation;		// the disk's, when saved
+};
+
+const int WarmMagic = 0x5741524d;	// "WARM"
+
+// The following class saves the caches, and fills them again.
+
+class WarmStart {
+  public:
+    WarmStart(int numDisks);		// for the disk, in "numDisks"
+					// UNIX files
+    ~WarmStart();
+
+    bool Load();			// Fill the caches from the file;
+					// FALSE if there is none that is good
+    void Save();			// Save what is in the caches now
+
+    static void FileName(char *name);	// the UNIX name of the file, in
+					// room for 40 characters
+    static void Forget();		// Remove the file: the disk is
+					// changing
+
+  private:
+    long long Generation();		// the disk's generation now
+
+    int numDisks;
+    char name[40];			// the file's UNIX name
+};
+
+#endif // WARMSTART_H
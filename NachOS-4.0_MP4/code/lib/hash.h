@@ -16,8 +16,14 @@
 //		Key GetKey(T x);
 //
 //	The hash table automatically resizes itself as items are
-//	put into the table.  The implementation uses chaining
-//	to resolve hash conflicts.
+//	put into the table.  The implementation is a single flat
+//	array of items, probed linearly from the slot a key hashes to
+//	("open addressing"), so a lookup touches consecutive memory
+//	rather than following a list.  Items are kept in "Robin Hood"
+//	order: no item is further from its home slot than one that
+//	follows it, which keeps every probe short, and lets a lookup
+//	for a missing key stop as soon as it passes where the key
+//	would be.
 //
 //	Allocation and deallocation of the items in the table are to 
 //	be done by the caller.
@@ -30,7 +36,7 @@
 #define HASH_H
 
 #include "copyright.h"
-#include "list.h"
+#include "debug.h"
 
 // The following class defines a "hash table" -- allowing quick
 // lookup according to the hash function defined for the items
@@ -64,34 +70,38 @@ class HashTable {
     				// is the module working?
 
   private:
-typedef List<T> *Bucket;
-
-    Bucket *buckets;		// the array of hash buckets
-    int numBuckets;		// the number of buckets
+    T *items;			// the array of slots
+    unsigned *hashes;		// the hash of each item's key
+    unsigned short *distance;	// how far each item is from its home
+				// slot, plus one; 0 for an empty slot
+    int numSlots;		// the number of slots, a power of two
+    int shift;			// 32 - log2(numSlots)
     int numItems;		// the number of items in the table
     
     Key (*getKey)(T x);		// get Key from value
     unsigned (*hash)(Key x);	// the hash function
 
-    void InitBuckets(int size);// initialize bucket array
-    void DeleteBuckets(Bucket *table, int size);
-    				// deallocate bucket array
+    void InitSlots(int size);	// initialize the slot arrays
+    void DeleteSlots();		// deallocate them
 				
-    int HashValue(Key key) const;
-    				// which bucket does the key hash to?
+    int HomeSlot(unsigned h) const;
+    				// which slot does hash value "h" go in?
 
     void ReHash();		// expand the hash table
-    
-    bool FindInBucket(int bucket, Key key, T *itemPtr) const; 
-    				// find item in bucket
-    int FindNextFullBucket(int start) const;
-    				// find next full bucket starting from this one
+    void Place(T item, unsigned h);
+				// put an item into the table, as is
+
+    int FindSlot(Key key) const; 
+    				// find the slot holding key, or -1
+    int FindNextFullSlot(int start) const;
+    				// find next full slot starting from this one
 
     friend class HashIterator<Key,T>;
 };
 
 // The following class can be used to step through a hash table --
-// same interface as ListIterator.  Example code:
+// same interface as ListIterator.  The table must not be changed while
+// an iterator is stepping through it.  Example code:
 //	HashIterator<Key, T> iter(table); 
 //
 //	for (; !iter->IsDone(); iter->Next()) {
@@ -102,19 +112,16 @@ template <class Key,class T>
 class HashIterator {
   public:
     HashIterator(HashTable<Key,T> *table); // initialize an iterator
-    ~HashIterator() { if (bucketIter != NULL) delete bucketIter;}; 
-				// destruct an iterator
 
-    bool IsDone() { return (bucket == table->numBuckets); };
+    bool IsDone() { return (slot == table->numSlots); };
 				// return TRUE if no more items in table 
-    T Item() { ASSERT(!IsDone()); return bucketIter->Item(); }; 
+    T Item() { ASSERT(!IsDone()); return table->items[slot]; }; 
 				// return current item in table
     void Next(); 		// update iterator to point to next
 
   private:   
     HashTable<Key,T> *table;	// the hash table we're stepping through
-    int bucket;			// current bucket we are in
-    ListIterator<T> *bucketIter; // where we are in the bucket
+    int slot;			// current slot we are at
 };
 
 #include "hash.cc"		// templates are really like macros
@@ -236,7 +236,7 @@ SortedList<T>::Insert(T item)
     ListElement<T> *element = new ListElement<T>(item);
     ListElement<T> *ptr;		// keep track
 
-    ASSERT(!IsInList(item));
+    ASSERT(!this->IsInList(item));
     if (this->IsEmpty()) {			// if list is empty, put at front
         this->first = element;
         this->last = element;
@@ -256,7 +256,7 @@ SortedList<T>::Insert(T item)
 	this->last = element;
     }
     this->numInList++;
-    ASSERT(IsInList(item));
+    ASSERT(this->IsInList(item));
 }
 
 //----------------------------------------------------------------------
@@ -362,14 +362,14 @@ SortedList<T>::SelfTest(T *p, int numEntries)
 
     for (i = 0; i < numEntries; i++) {
 	 Insert(p[i]);
-	 ASSERT(IsInList(p[i]));
+	 ASSERT(this->IsInList(p[i]));
      }
      SanityCheck();
 
      // should be able to get out everything we put in
      for (i = 0; i < numEntries; i++) {
 	 q[i] = this->RemoveFront();
-         ASSERT(!IsInList(q[i]));
+         ASSERT(!this->IsInList(q[i]));
      }
      ASSERT(this->IsEmpty());
 
@@ -379,5 +379,5 @@ SortedList<T>::SelfTest(T *p, int numEntries)
      }
      SanityCheck();
 
-     delete q;
+     delete [] q;
 }
@@ -0,0 +1,228 @@
+// memops.cc
+//	Routines to copy, zero and compare blocks of memory, with the
+//	host's vector instructions where it has them.
+//
+//	The AVX2 routines are compiled for AVX2 one function at a time
+//	(the "target" attribute), so the rest of Nachos doesn't need it,
+//	and are only used if MemOpsInit finds the CPU has it.  This needs
+//	GCC 4.9 or later; older compilers get the C library's routines.
+//
+//	Each routine moves whole vectors, and leaves the last few bytes
+//	to the C library.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "memops.h"
+#include <string.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__)) \
+	&& (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))
+#define MEMOPS_AVX2
+#include <immintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define MEMOPS_NEON
+#include <arm_neon.h>
+#endif
+
+//----------------------------------------------------------------------
+// LibCopy, LibZero, LibCompare
+// 	The C library's routines, for hosts without anything better.
+//----------------------------------------------------------------------
+
+static void
+LibCopy(void *to, const void *from, int numBytes)
+{
+    memcpy(to, from, numBytes);
+}
+
+static void
+LibZero(void *to, int numBytes)
+{
+    memset(to, 0, numBytes);
+}
+
+static int
+LibCompare(const void *a, const void *b, int numBytes)
+{
+    return memcmp(a, b, numBytes);
+}
+
+#ifdef MEMOPS_AVX2
+//----------------------------------------------------------------------
+// Avx2Copy, Avx2Zero, Avx2Compare
+// 	The same, 32 bytes at a time.  Copies and zeroes do two vectors
+//	an iteration, so that a page is a short loop.
+//----------------------------------------------------------------------
+
+__attribute__((target("avx2"))) static void
+Avx2Copy(void *to, const void *from, int numBytes)
+{
+    char *t = (char *) to;
+    const char *f = (const char *) from;
+
+    for (; numBytes >= 64; numBytes -= 64, t += 64, f += 64) {
+	__m256i v0 = _mm256_loadu_si256((const __m256i *) f);
+	__m256i v1 = _mm256_loadu_si256((const __m256i *) (f + 32));
+
+	_mm256_storeu_si256((__m256i *) t, v0);
+	_mm256_storeu_si256((__m256i *) (t + 32), v1);
+    }
+    if (numBytes > 0)
+	memcpy(t, f, numBytes);
+}
+
+__attribute__((target("avx2"))) static void
+Avx2Zero(void *to, int numBytes)
+{
+    char *t = (char *) to;
+    __m256i zero = _mm256_setzero_si256();
+
+    for (; numBytes >= 64; numBytes -= 64, t += 64) {
+	_mm256_storeu_si256((__m256i *) t, zero);
+	_mm256_storeu_si256((__m256i *) (t + 32), zero);
+    }
+    if (numBytes > 0)
+	memset(t, 0, numBytes);
+}
+
+__attribute__((target("avx2"))) static int
+Avx2Compare(const void *a, const void *b, int numBytes)
+{
+    const char *p = (const char *) a;
+    const char *q = (const char *) b;
+
+    for (; numBytes >= 32; numBytes -= 32, p += 32, q += 32) {
+	__m256i same = _mm256_cmpeq_epi8(
+			_mm256_loadu_si256((const __m256i *) p),
+			_mm256_loadu_si256((const __m256i *) q));
+
+	if (_mm256_movemask_epi8(same) != -1)
+	    return memcmp(p, q, 32);	// which way they differ
+    }
+    return (numBytes > 0) ? memcmp(p, q, numBytes) : 0;
+}
+#endif // MEMOPS_AVX2
+
+#ifdef MEMOPS_NEON
+//----------------------------------------------------------------------
+// NeonCopy, NeonZero, NeonCompare
+// 	The same, 16 bytes at a time.
+//----------------------------------------------------------------------
+
+static void
+NeonCopy(void *to, const void *from, int numBytes)
+{
+    uint8_t *t = (uint8_t *) to;
+    const uint8_t *f = (const uint8_t *) from;
+
+    for (; numBytes >= 32; numBytes -= 32, t += 32, f += 32) {
+	uint8x16_t v0 = vld1q_u8(f);
+	uint8x16_t v1 = vld1q_u8(f + 16);
+
+	vst1q_u8(t, v0);
+	vst1q_u8(t + 16, v1);
+    }
+    if (numBytes > 0)
+	memcpy(t, f, numBytes);
+}
+
+static void
+NeonZero(void *to, int numBytes)
+{
+    uint8_t *t = (uint8_t *) to;
+    uint8x16_t zero = vdupq_n_u8(0);
+
+    for (; numBytes >= 32; numBytes -= 32, t += 32) {
+	vst1q_u8(t, zero);
+	vst1q_u8(t + 16, zero);
+    }
+    if (numBytes > 0)
+	memset(t, 0, numBytes);
+}
+
+static int
+NeonCompare(const void *a, const void *b, int numBytes)
+{
+    const uint8_t *p = (const uint8_t *) a;
+    const uint8_t *q = (const uint8_t *) b;
+
+    for (; numBytes >= 16; numBytes -= 16, p += 16, q += 16) {
+	uint8x16_t same = vceqq_u8(vld1q_u8(p), vld1q_u8(q));
+	uint64x2_t halves = vreinterpretq_u64_u8(same);
+
+	if ((vgetq_lane_u64(halves, 0) & vgetq_lane_u64(halves, 1))
+							!= ~(uint64_t) 0)
+	    return memcmp(p, q, 16);	// which way they differ
+    }
+    return (numBytes > 0) ? memcmp(p, q, numBytes) : 0;
+}
+#endif // MEMOPS_NEON
+
+static void (*copyRoutine)(void *, const void *, int) = LibCopy;
+static void (*zeroRoutine)(void *, int) = LibZero;
+static int (*compareRoutine)(const void *, const void *, int) = LibCompare;
+static char *kind = (char *) "libc";
+
+//----------------------------------------------------------------------
+// MemOpsInit
+// 	Pick the fastest routines this CPU can run.  Called once, at
+//	startup; anything copied before then uses the C library.
+//----------------------------------------------------------------------
+
+void
+MemOpsInit()
+{
+#ifdef MEMOPS_AVX2
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+	copyRoutine = Avx2Copy;
+	zeroRoutine = Avx2Zero;
+	compareRoutine = Avx2Compare;
+	kind = (char *) "avx2";
+    }
+#endif
+#ifdef MEMOPS_NEON
+    copyRoutine = NeonCopy;
+    zeroRoutine = NeonZero;
+    compareRoutine = NeonCompare;
+    kind = (char *) "neon";
+#endif
+}
+
+//----------------------------------------------------------------------
+// MemOpsKind
+// 	Return the name of the routines MemOpsInit picked.
+//----------------------------------------------------------------------
+
+char *
+MemOpsKind()
+{
+    return kind;
+}
+
+//----------------------------------------------------------------------
+// MemCopy, MemZero, MemCompare
+// 	Copy "numBytes" bytes from "from" to "to", which must not
+//	overlap; zero them at "to"; or compare them at "a" and "b".
+//----------------------------------------------------------------------
+
+void
+MemCopy(void *to, const void *from, int numBytes)
+{
+    (*copyRoutine)(to, from, numBytes);
+}
+
+void
+MemZero(void *to, int numBytes)
+{
+    (*zeroRoutine)(to, numBytes);
+}
+
+int
+MemCompare(const void *a, const void *b, int numBytes)
+{
+    return (*compareRoutine)(a, b, numBytes);
+}
@@ -32,6 +32,8 @@
 #include <sys/file.h>
 #include <sys/socket.h>
 #include <sys/un.h>
+#include <sys/wait.h>
+#include <sys/stat.h>
 #include <cerrno>
 
 #ifdef SOLARIS
@@ -51,9 +53,9 @@ extern "C" {
 #include <signal.h>
 #include <sys/types.h>
 
-#ifndef NO_MPROT 
-#include <sys/mman.h>
-#endif
+#include <sys/mman.h>		// mprotect, and mmap for the disk
+#include <pthread.h>		// the host job thread, for the disk, and
+				// the host writer thread, for the console
 
 // UNIX routines called by procedures in this file 
 
@@ -132,6 +134,64 @@ Delay(int seconds)
     (void) sleep((unsigned) seconds);
 }
 
+//----------------------------------------------------------------------
+// WallTime
+// 	Return the host's time of day, in seconds, to the microsecond.
+//	Only differences between two calls mean anything.
+//----------------------------------------------------------------------
+
+double
+WallTime()
+{
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
+static void ForgetHostJobs();
+static void ForgetFileWrites();
+static bool OnWriterThread();
+
+//----------------------------------------------------------------------
+// ForkProcess
+// 	Make a copy of the UNIX process running Nachos -- its memory,
+//	the stacks of every Nachos thread, and its open files.  Returns
+//	0 in the copy, and the copy's process ID in the original.
+//----------------------------------------------------------------------
+
+int
+ForkProcess()
+{
+    int pid;
+
+    WaitHostJob();		// the copy won't have the job's thread,
+    WaitFileWrites();		// nor the writer's
+    pid = fork();
+    ASSERT(pid >= 0);
+    if (pid == 0) {
+	ForgetHostJobs();
+	ForgetFileWrites();
+    }
+    return pid;
+}
+
+//----------------------------------------------------------------------
+// WaitProcess
+// 	Wait for the copy of the process with ID "pid" to exit, and
+//	return its exit code (or 1, if it was killed).
+//----------------------------------------------------------------------
+
+int
+WaitProcess(int pid)
+{
+    int status;
+    int retVal = waitpid(pid, &status, 0);
+
+    ASSERT(retVal == pid);
+    return WIFEXITED(status) ? WEXITSTATUS(status) : 1;
+}
+
 //----------------------------------------------------------------------
 // UDelay
 // 	Put the UNIX process running Nachos to sleep for x microseconds,
@@ -151,23 +211,28 @@ UDelay(unsigned int useconds)
 
 //----------------------------------------------------------------------
 // Abort
-// 	Quit and drop core.
+// 	Quit and drop core, once what was written with WriteFileLater
+//	is out (unless it is writing it that failed).
 //----------------------------------------------------------------------
 
 void 
 Abort()
 {
+    if (!OnWriterThread())
+	WaitFileWrites();
     abort();
 }
 
 //----------------------------------------------------------------------
 // Exit
-// 	Quit without dropping core.
+// 	Quit without dropping core, once what was written with
+//	WriteFileLater is out.
 //----------------------------------------------------------------------
 
 void 
 Exit(int exitCode)
 {
+    WaitFileWrites();
     exit(exitCode);
 }
 
@@ -367,6 +432,23 @@ WriteFile(int fd, char *buffer, int nBytes)
     ASSERT(retVal == nBytes);
 }
 
+//----------------------------------------------------------------------
+// FileVersion
+// 	Return a number that changes whenever the UNIX file "name" is
+//	written -- when it was last modified, in nanoseconds -- or -1 if
+//	there is no such file.
+//----------------------------------------------------------------------
+
+long long
+FileVersion(char *name)
+{
+    struct stat info;
+
+    if (stat(name, &info) != 0)
+	return -1;
+    return info.st_mtim.tv_sec * 1000000000LL + info.st_mtim.tv_nsec;
+}
+
 //----------------------------------------------------------------------
 // Lseek
 // 	Change the location within an open file.  Abort on error.
@@ -409,6 +491,265 @@ Close(int fd)
     return retVal;
 }
 
+//----------------------------------------------------------------------
+// MapFile
+// 	Map the first "nBytes" of an open file into memory, shared, so
+//	that stores to the memory change the file.  The file must be at
+//	least that long.  Return NULL if it can't be mapped.
+//----------------------------------------------------------------------
+
+char *
+MapFile(int fd, int nBytes)
+{
+    void *addr = mmap(NULL, nBytes, PROT_READ | PROT_WRITE, MAP_SHARED,
+			fd, 0);
+
+    return (addr == MAP_FAILED) ? NULL : (char *) addr;
+}
+
+//----------------------------------------------------------------------
+// SyncMappedFile
+// 	Write the changes made to a mapped file back to the file, and
+//	wait for them to get there.  Abort on error.
+//----------------------------------------------------------------------
+
+void
+SyncMappedFile(char *addr, int nBytes)
+{
+    int retVal = msync(addr, nBytes, MS_SYNC);
+    ASSERT(retVal == 0);
+}
+
+//----------------------------------------------------------------------
+// UnmapFile
+// 	Undo MapFile.  Changes not yet synced still reach the file
+//	eventually.
+//----------------------------------------------------------------------
+
+void
+UnmapFile(char *addr, int nBytes)
+{
+    int retVal = munmap(addr, nBytes);
+    ASSERT(retVal == 0);
+}
+
+// The host job thread, started by the first job.  The job and its
+// argument are under "jobLock".
+
+static bool jobStarted = FALSE;
+static pthread_t jobThread;
+static pthread_mutex_t jobLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t jobChanged = PTHREAD_COND_INITIALIZER;
+static void (*jobToRun)(void *) = NULL;	// waiting to run, or running
+static void *jobArg;
+
+//----------------------------------------------------------------------
+// HostJobThread
+// 	The host thread jobs run on: run each as it is given, and say
+//	when it is done.  Never returns.
+//----------------------------------------------------------------------
+
+static void *
+HostJobThread(void *)
+{
+    void (*job)(void *);
+    void *arg;
+
+    pthread_mutex_lock(&jobLock);
+    for (;;) {
+	while (jobToRun == NULL)
+	    pthread_cond_wait(&jobChanged, &jobLock);
+	job = jobToRun;
+	arg = jobArg;
+	pthread_mutex_unlock(&jobLock);
+	(*job)(arg);
+	pthread_mutex_lock(&jobLock);
+	jobToRun = NULL;
+	pthread_cond_broadcast(&jobChanged);
+    }
+    return NULL;
+}
+
+//----------------------------------------------------------------------
+// StartHostJob
+// 	Call "job" with "arg" on the host job thread, starting the thread
+//	if this is the first job, and return without waiting for it.
+//	Waits for the last job to be done first.
+//----------------------------------------------------------------------
+
+void
+StartHostJob(void (*job)(void *), void *arg)
+{
+    if (!jobStarted) {
+	int retVal = pthread_create(&jobThread, NULL, HostJobThread, NULL);
+	ASSERT(retVal == 0);
+	jobStarted = TRUE;
+    }
+    pthread_mutex_lock(&jobLock);
+    while (jobToRun != NULL)
+	pthread_cond_wait(&jobChanged, &jobLock);
+    jobToRun = job;
+    jobArg = arg;
+    pthread_cond_broadcast(&jobChanged);
+    pthread_mutex_unlock(&jobLock);
+}
+
+//----------------------------------------------------------------------
+// WaitHostJob
+// 	Wait until the last job started is done, if it isn't already.
+//----------------------------------------------------------------------
+
+void
+WaitHostJob()
+{
+    if (!jobStarted)
+	return;
+    pthread_mutex_lock(&jobLock);
+    while (jobToRun != NULL)
+	pthread_cond_wait(&jobChanged, &jobLock);
+    pthread_mutex_unlock(&jobLock);
+}
+
+//----------------------------------------------------------------------
+// ForgetHostJobs
+// 	In a copy of the process, which has only the thread that made
+//	it: start a job thread afresh, with the first job.
+//----------------------------------------------------------------------
+
+static void
+ForgetHostJobs()
+{
+    jobStarted = FALSE;
+    jobToRun = NULL;
+    pthread_mutex_init(&jobLock, NULL);
+    pthread_cond_init(&jobChanged, NULL);
+}
+
+// The host writer thread, started by the first WriteFileLater.  The
+// bytes waiting to be written, in a ring, and the file they go to are
+// under "writerLock".
+
+static const int WriterRingSize = 65536;
+static bool writerStarted = FALSE;
+static pthread_t writerThread;
+static pthread_mutex_t writerLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t writerChanged = PTHREAD_COND_INITIALIZER;
+static char writerRing[WriterRingSize];
+static int writerHead = 0;		// the next byte to write out
+static int writerCount = 0;		// bytes waiting, or being written
+static int writerFd = -1;
+
+//----------------------------------------------------------------------
+// HostWriterThread
+// 	The host thread that writes out the ring: write all the bytes in
+//	it that are next to each other, and say when they are out, as
+//	long as there are any.  Never returns.
+//
+//	The bytes being written stay in the ring until they are out, so
+//	WriteFileLater can't overwrite them.
+//----------------------------------------------------------------------
+
+static void *
+HostWriterThread(void *)
+{
+    pthread_mutex_lock(&writerLock);
+    for (;;) {
+	int fd, nBytes;
+	char *start;
+
+	while (writerCount == 0)
+	    pthread_cond_wait(&writerChanged, &writerLock);
+	fd = writerFd;
+	start = writerRing + writerHead;
+	nBytes = WriterRingSize - writerHead;	// up to the end of the ring
+	if (nBytes > writerCount)
+	    nBytes = writerCount;
+	pthread_mutex_unlock(&writerLock);
+	WriteFile(fd, start, nBytes);
+	pthread_mutex_lock(&writerLock);
+	writerHead = (writerHead + nBytes) % WriterRingSize;
+	writerCount -= nBytes;
+	pthread_cond_broadcast(&writerChanged);
+    }
+    return NULL;
+}
+
+//----------------------------------------------------------------------
+// WriteFileLater
+// 	Write characters to an open file, as WriteFile does, but on the
+//	host writer thread: copy them to the ring, starting the thread
+//	if this is the first write, and return without waiting for them
+//	to be written -- unless the ring is full, or holds bytes for
+//	another file, until there is room.
+//----------------------------------------------------------------------
+
+void
+WriteFileLater(int fd, char *buffer, int nBytes)
+{
+    if (!writerStarted) {
+	int retVal = pthread_create(&writerThread, NULL, HostWriterThread,
+				    NULL);
+	ASSERT(retVal == 0);
+	writerStarted = TRUE;
+    }
+    pthread_mutex_lock(&writerLock);
+    while (writerCount > 0 && fd != writerFd)
+	pthread_cond_wait(&writerChanged, &writerLock);
+    writerFd = fd;
+    for (int i = 0; i < nBytes; i++) {
+	while (writerCount == WriterRingSize)
+	    pthread_cond_wait(&writerChanged, &writerLock);
+	writerRing[(writerHead + writerCount) % WriterRingSize] = buffer[i];
+	writerCount++;
+    }
+    pthread_cond_broadcast(&writerChanged);
+    pthread_mutex_unlock(&writerLock);
+}
+
+//----------------------------------------------------------------------
+// WaitFileWrites
+// 	Wait until everything written with WriteFileLater is out, if it
+//	isn't already.
+//----------------------------------------------------------------------
+
+void
+WaitFileWrites()
+{
+    if (!writerStarted)
+	return;
+    pthread_mutex_lock(&writerLock);
+    while (writerCount > 0)
+	pthread_cond_wait(&writerChanged, &writerLock);
+    pthread_mutex_unlock(&writerLock);
+}
+
+//----------------------------------------------------------------------
+// OnWriterThread
+// 	Is the host writer thread the one calling?
+//----------------------------------------------------------------------
+
+static bool
+OnWriterThread()
+{
+    return writerStarted && pthread_equal(pthread_self(), writerThread);
+}
+
+//----------------------------------------------------------------------
+// ForgetFileWrites
+// 	In a copy of the process, which has only the thread that made
+//	it (and an empty ring): start a writer thread afresh, with the
+//	first write.
+//----------------------------------------------------------------------
+
+static void
+ForgetFileWrites()
+{
+    writerStarted = FALSE;
+    writerHead = writerCount = 0;
+    pthread_mutex_init(&writerLock, NULL);
+    pthread_cond_init(&writerChanged, NULL);
+}
+
 //----------------------------------------------------------------------
 // Unlink
 // 	Delete a file.
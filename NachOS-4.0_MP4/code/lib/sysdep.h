@@ -19,11 +19,23 @@
 
 using namespace std;
 
-// Process control: abort, exit, and sleep
-extern void Abort();
-extern void Exit(int exitCode);
+// Process control: abort, exit, and sleep.  Abort and Exit never
+// return, and the compiler is told so: after a failed ASSERT, it
+// doesn't have to warn about, or keep code for, the way on.
+
+#ifdef __GNUC__
+#define NORETURN __attribute__((noreturn))
+#else
+#define NORETURN
+#endif
+
+extern void Abort() NORETURN;
+extern void Exit(int exitCode) NORETURN;
 extern void Delay(int seconds);
 extern void UDelay(unsigned int usec);// rcgood - to avoid spinners.
+extern double WallTime();	// host time, in seconds
+extern int ForkProcess();	// copy the Nachos process: 0 in the copy
+extern int WaitProcess(int pid);// wait for a copy to exit; its status
 
 // Initialize system so that cleanUp routine is called when user hits ctl-C
 extern void CallOnUserAbort(void (*cleanup)(int));
@@ -52,6 +64,26 @@ extern void Lseek(int fd, int offset, int whence);
 extern int Tell(int fd);
 extern int Close(int fd);
 extern bool Unlink(char *name);
+extern long long FileVersion(char *name);
+					// changes when the file is written
+
+// Map an open file into memory, write the changes back, and unmap it.
+// For simulating the disk without a system call per sector.
+extern char *MapFile(int fd, int nBytes);
+extern void SyncMappedFile(char *addr, int nBytes);
+extern void UnmapFile(char *addr, int nBytes);
+
+// Run a job on a host thread, alongside Nachos, and wait for it to be
+// done.  One job at a time.  For simulating the disk without waiting
+// for the host's file system.
+extern void StartHostJob(void (*job)(void *), void *arg);
+extern void WaitHostJob();
+
+// Write to an open file from a host thread, alongside Nachos, and wait
+// for everything written so to be out.  For simulating the console
+// without waiting for a slow terminal or pipe; Exit waits too.
+extern void WriteFileLater(int fd, char *buffer, int nBytes);
+extern void WaitFileWrites();
 
 // Other C library routines that are used by Nachos.
 // These are assumed to be portable, so we don't include a wrapper.
@@ -0,0 +1,657 @@
+// blockcache.cc
+//	Routines to translate user code into blocks of host routines, one
+//	per instruction, and to run them.  Each routine does what
+//	Machine::OneInstruction does for its kind of instruction, then
+//	retires it as OneInstruction does: the delayed load, then the PC.
+//
+// Copyright (c) 1992-1996 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "blockcache.h"
+#include "machine.h"
+#include "main.h"
+#define OPCODES_ONLY
+#include "mipssim.h"
+
+//----------------------------------------------------------------------
+// Retire
+// 	Finish an instruction that ran without an exception: apply the
+//	delayed load from the instruction before it, record this one's
+//	(if any), and move the PC on -- to "pcAfter" after the next
+//	instruction, the delay slot.
+//----------------------------------------------------------------------
+
+static inline bool
+Retire(int *r, int loadReg, int loadValue, int pcAfter)
+{
+    r[r[LoadReg]] = r[LoadValueReg];
+    r[LoadReg] = loadReg;
+    r[LoadValueReg] = loadValue;
+    r[0] = 0;
+    r[PrevPCReg] = r[PCReg];
+    r[PCReg] = r[NextPCReg];
+    r[NextPCReg] = pcAfter;
+    return TRUE;
+}
+
+// The instructions that neither branch nor load fall through to the
+// delay slot's successor.
+
+#define NEXT(r)		((r)[NextPCReg] + 4)
+#define BRANCH(r, op)	((r)[NextPCReg] + IndexToAddr((op)->extra))
+
+//----------------------------------------------------------------------
+// The host routines for each kind of instruction.  (ADD, ADDI and SUB
+// can trap on overflow, and the unaligned loads and stores are rare;
+// those, SYSCALL and the illegal ones are left to the interpreter.
+// Unaligned LH and LW trap in Translate, just as they do there.)
+//----------------------------------------------------------------------
+
+static bool
+DoADDIU(Machine *m, int *r, BlockOp *op)
+{
+    r[op->rt] = r[op->rs] + op->extra;
+    return Retire(r, 0, 0, NEXT(r));
+}
+
+static bool
+DoADDU(Machine *m, int *r, BlockOp *op)
+{
+    r[op->rd] = r[op->rs] + r[op->rt];
+    return Retire(r, 0, 0, NEXT(r));
+}
+
+static bool
+DoSUBU(Machine *m, int *r, BlockOp *op)
+{
+    r[op->rd] = r[op->rs] - r[op->rt];
+    return Retire(r, 0, 0, NEXT(r));
+}
+
+static bool
+DoAND(Machine *m, int *r, BlockOp *op)
+{
+    r[op->rd] = r[op->rs] & r[op->rt];
+    return Retire(r, 0, 0, NEXT(r));
+}
+
+static bool
+DoANDI(Machine *m, int *r, BlockOp *op)
+{
+    r[op->rt] = r[op->rs] & (op->extra & 0xffff);
+    return Retire(r, 0, 0, NEXT(r));
+}
+
+static bool
+DoOR(Machine *m, int *r, BlockOp *op)
+{
+    r[op->rd] = r[op->rs] | r[op->rt];
+    return Retire(r, 0, 0, NEXT(r));
+}
+
+static bool
+DoORI(Machine *m, int *r, BlockOp *op)
+{
+    r[op->rt] = r[op->rs] | (op->extra & 0xffff);
+    return Retire(r, 0, 0, NEXT(r));
+}
+
+static bool
+DoXOR(Machine *m, int *r, BlockOp *op)
+{
+    r[op->rd] = r[op->rs] ^ r[op->rt];
+    return Retire(r, 0, 0, NEXT(r));
+}
+
+static bool
+DoXORI(Machine *m, int *r, BlockOp *op)
+{
+    r[op->rt] = r[op->rs] ^ (op->extra & 0xffff);
+    return Retire(r, 0, 0, NEXT(r));
+}
+
+static bool
+DoNOR(Machine *m, int *r, BlockOp *op)
+{
+    r[op->rd] = ~(r[op->rs] | r[op->rt]);
+    return Retire(r, 0, 0, NEXT(r));
+}
+
+static bool
+DoLUI(Machine *m, int *r, BlockOp *op)
+{
+    r[op->rt] = op->extra << 16;
+    return Retire(r, 0, 0, NEXT(r));
+}
+
+static bool
+DoSLL(Machine *m, int *r, BlockOp *op)
+{
+    r[op->rd] = r[op->rt] << op->extra;
+    return Retire(r, 0, 0, NEXT(r));
+}
+
+static bool
+DoSLLV(Machine *m, int *r, BlockOp *op)
+{
+    r[op->rd] = r[op->rt] << (r[op->rs] & 0x1f);
+    return Retire(r, 0, 0, NEXT(r));
+}
+
+// SRL and SRLV shift a signed int, as the interpreter does
+
+static bool
+DoSRA(Machine *m, int *r, BlockOp *op)
+{
+    r[op->rd] = r[op->rt] >> op->extra;
+    return Retire(r, 0, 0, NEXT(r));
+}
+
+static bool
+DoSRAV(Machine *m, int *r, BlockOp *op)
+{
+    r[op->rd] = r[op->rt] >> (r[op->rs] & 0x1f);
+    return Retire(r, 0, 0, NEXT(r));
+}
+
+static bool
+DoSLT(Machine *m, int *r, BlockOp *op)
+{
+    r[op->rd] = (r[op->rs] < r[op->rt]) ? 1 : 0;
+    return Retire(r, 0, 0, NEXT(r));
+}
+
+static bool
+DoSLTI(Machine *m, int *r, BlockOp *op)
+{
+    r[op->rt] = (r[op->rs] < op->extra) ? 1 : 0;
+    return Retire(r, 0, 0, NEXT(r));
+}
+
+static bool
+DoSLTIU(Machine *m, int *r, BlockOp *op)
+{
+    r[op->rt] = ((unsigned int) r[op->rs] < (unsigned int) op->extra) ? 1 : 0;
+    return Retire(r, 0, 0, NEXT(r));
+}
+
+static bool
+DoSLTU(Machine *m, int *r, BlockOp *op)
+{
+    r[op->rd] = ((unsigned int) r[op->rs] < (unsigned int) r[op->rt]) ? 1 : 0;
+    return Retire(r, 0, 0, NEXT(r));
+}
+
+static bool
+DoMFHI(Machine *m, int *r, BlockOp *op)
+{
+    r[op->rd] = r[HiReg];
+    return Retire(r, 0, 0, NEXT(r));
+}
+
+static bool
+DoMFLO(Machine *m, int *r, BlockOp *op)
+{
+    r[op->rd] = r[LoReg];
+    return Retire(r, 0, 0, NEXT(r));
+}
+
+static bool
+DoMTHI(Machine *m, int *r, BlockOp *op)
+{
+    r[HiReg] = r[op->rs];
+    return Retire(r, 0, 0, NEXT(r));
+}
+
+static bool
+DoMTLO(Machine *m, int *r, BlockOp *op)
+{
+    r[LoReg] = r[op->rs];
+    return Retire(r, 0, 0, NEXT(r));
+}
+
+static bool
+DoMULT(Machine *m, int *r, BlockOp *op)
+{
+    Mult(r[op->rs], r[op->rt], TRUE, &r[HiReg], &r[LoReg]);
+    return Retire(r, 0, 0, NEXT(r));
+}
+
+static bool
+DoMULTU(Machine *m, int *r, BlockOp *op)
+{
+    Mult(r[op->rs], r[op->rt], FALSE, &r[HiReg], &r[LoReg]);
+    return Retire(r, 0, 0, NEXT(r));
+}
+
+static bool
+DoDIV(Machine *m, int *r, BlockOp *op)
+{
+    if (r[op->rt] == 0) {
+	r[LoReg] = 0;
+	r[HiReg] = 0;
+    } else {
+	r[LoReg] = r[op->rs] / r[op->rt];
+	r[HiReg] = r[op->rs] % r[op->rt];
+    }
+    return Retire(r, 0, 0, NEXT(r));
+}
+
+static bool
+DoDIVU(Machine *m, int *r, BlockOp *op)
+{
+    unsigned int rs = r[op->rs], rt = r[op->rt];
+
+    if (rt == 0) {
+	r[LoReg] = 0;
+	r[HiReg] = 0;
+    } else {
+	r[LoReg] = (int) (rs / rt);
+	r[HiReg] = (int) (rs % rt);
+    }
+    return Retire(r, 0, 0, NEXT(r));
+}
+
+static bool
+DoBEQ(Machine *m, int *r, BlockOp *op)
+{
+    return Retire(r, 0, 0,
+		(r[op->rs] == r[op->rt]) ? BRANCH(r, op) : NEXT(r));
+}
+
+static bool
+DoBNE(Machine *m, int *r, BlockOp *op)
+{
+    return Retire(r, 0, 0,
+		(r[op->rs] != r[op->rt]) ? BRANCH(r, op) : NEXT(r));
+}
+
+static bool
+DoBGEZ(Machine *m, int *r, BlockOp *op)
+{
+    return Retire(r, 0, 0, !(r[op->rs] & SIGN_BIT) ? BRANCH(r, op) : NEXT(r));
+}
+
+static bool
+DoBGEZAL(Machine *m, int *r, BlockOp *op)
+{
+    r[R31] = r[NextPCReg] + 4;
+    return DoBGEZ(m, r, op);
+}
+
+static bool
+DoBLTZ(Machine *m, int *r, BlockOp *op)
+{
+    return Retire(r, 0, 0, (r[op->rs] & SIGN_BIT) ? BRANCH(r, op) : NEXT(r));
+}
+
+static bool
+DoBLTZAL(Machine *m, int *r, BlockOp *op)
+{
+    r[R31] = r[NextPCReg] + 4;
+    return DoBLTZ(m, r, op);
+}
+
+static bool
+DoBGTZ(Machine *m, int *r, BlockOp *op)
+{
+    return Retire(r, 0, 0, (r[op->rs] > 0) ? BRANCH(r, op) : NEXT(r));
+}
+
+static bool
+DoBLEZ(Machine *m, int *r, BlockOp *op)
+{
+    return Retire(r, 0, 0, (r[op->rs] <= 0) ? BRANCH(r, op) : NEXT(r));
+}
+
+static bool
+DoJ(Machine *m, int *r, BlockOp *op)
+{
+    return Retire(r, 0, 0, (NEXT(r) & 0xf0000000) | IndexToAddr(op->extra));
+}
+
+static bool
+DoJAL(Machine *m, int *r, BlockOp *op)
+{
+    r[R31] = r[NextPCReg] + 4;
+    return DoJ(m, r, op);
+}
+
+static bool
+DoJR(Machine *m, int *r, BlockOp *op)
+{
+    return Retire(r, 0, 0, r[op->rs]);
+}
+
+static bool
+DoJALR(Machine *m, int *r, BlockOp *op)
+{
+    r[op->rd] = r[NextPCReg] + 4;	// (before rs is read, as in
+    return Retire(r, 0, 0, r[op->rs]);	// the interpreter)
+}
+
+static bool
+DoLB(Machine *m, int *r, BlockOp *op)
+{
+    int value;
+
+    if (!m->ReadMem<1>(r[op->rs] + op->extra, &value))
+	return FALSE;
+    value = (value & 0x80) ? (value | 0xffffff00) : (value & 0xff);
+    return Retire(r, op->rt, value, NEXT(r));
+}
+
+static bool
+DoLBU(Machine *m, int *r, BlockOp *op)
+{
+    int value;
+
+    if (!m->ReadMem<1>(r[op->rs] + op->extra, &value))
+	return FALSE;
+    return Retire(r, op->rt, value & 0xff, NEXT(r));
+}
+
+static bool
+DoLH(Machine *m, int *r, BlockOp *op)
+{
+    int value;
+
+    if (!m->ReadMem<2>(r[op->rs] + op->extra, &value))
+	return FALSE;
+    value = (value & 0x8000) ? (value | 0xffff0000) : (value & 0xffff);
+    return Retire(r, op->rt, value, NEXT(r));
+}
+
+static bool
+DoLHU(Machine *m, int *r, BlockOp *op)
+{
+    int value;
+
+    if (!m->ReadMem<2>(r[op->rs] + op->extra, &value))
+	return FALSE;
+    return Retire(r, op->rt, value & 0xffff, NEXT(r));
+}
+
+static bool
+DoLW(Machine *m, int *r, BlockOp *op)
+{
+    int value;
+
+    if (!m->ReadMem<4>(r[op->rs] + op->extra, &value))
+	return FALSE;
+    return Retire(r, op->rt, value, NEXT(r));
+}
+
+static bool
+DoSB(Machine *m, int *r, BlockOp *op)
+{
+    if (!m->WriteMem<1>((unsigned) (r[op->rs] + op->extra), r[op->rt]))
+	return FALSE;
+    return Retire(r, 0, 0, NEXT(r));
+}
+
+static bool
+DoSH(Machine *m, int *r, BlockOp *op)
+{
+    if (!m->WriteMem<2>((unsigned) (r[op->rs] + op->extra), r[op->rt]))
+	return FALSE;
+    return Retire(r, 0, 0, NEXT(r));
+}
+
+static bool
+DoSW(Machine *m, int *r, BlockOp *op)
+{
+    if (!m->WriteMem<4>((unsigned) (r[op->rs] + op->extra), r[op->rt]))
+	return FALSE;
+    return Retire(r, 0, 0, NEXT(r));
+}
+
+//----------------------------------------------------------------------
+// FuncOf
+// 	Return the host routine for instructions of kind "opCode", or
+//	NULL if the interpreter must run them.
+//----------------------------------------------------------------------
+
+static BlockOpFunc
+FuncOf(int opCode)
+{
+    switch (opCode) {
+      case OP_ADDIU:	return DoADDIU;
+      case OP_ADDU:	return DoADDU;
+      case OP_SUBU:	return DoSUBU;
+      case OP_AND:	return DoAND;
+      case OP_ANDI:	return DoANDI;
+      case OP_OR:	return DoOR;
+      case OP_ORI:	return DoORI;
+      case OP_XOR:	return DoXOR;
+      case OP_XORI:	return DoXORI;
+      case OP_NOR:	return DoNOR;
+      case OP_LUI:	return DoLUI;
+      case OP_SLL:	return DoSLL;
+      case OP_SLLV:	return DoSLLV;
+      case OP_SRA:
+      case OP_SRL:	return DoSRA;
+      case OP_SRAV:
+      case OP_SRLV:	return DoSRAV;
+      case OP_SLT:	return DoSLT;
+      case OP_SLTI:	return DoSLTI;
+      case OP_SLTIU:	return DoSLTIU;
+      case OP_SLTU:	return DoSLTU;
+      case OP_MFHI:	return DoMFHI;
+      case OP_MFLO:	return DoMFLO;
+      case OP_MTHI:	return DoMTHI;
+      case OP_MTLO:	return DoMTLO;
+      case OP_MULT:	return DoMULT;
+      case OP_MULTU:	return DoMULTU;
+      case OP_DIV:	return DoDIV;
+      case OP_DIVU:	return DoDIVU;
+      case OP_BEQ:	return DoBEQ;
+      case OP_BNE:	return DoBNE;
+      case OP_BGEZ:	return DoBGEZ;
+      case OP_BGEZAL:	return DoBGEZAL;
+      case OP_BLTZ:	return DoBLTZ;
+      case OP_BLTZAL:	return DoBLTZAL;
+      case OP_BGTZ:	return DoBGTZ;
+      case OP_BLEZ:	return DoBLEZ;
+      case OP_J:	return DoJ;
+      case OP_JAL:	return DoJAL;
+      case OP_JR:	return DoJR;
+      case OP_JALR:	return DoJALR;
+      case OP_LB:	return DoLB;
+      case OP_LBU:	return DoLBU;
+      case OP_LH:	return DoLH;
+      case OP_LHU:	return DoLHU;
+      case OP_LW:	return DoLW;
+      case OP_SB:	return DoSB;
+      case OP_SH:	return DoSH;
+      case OP_SW:	return DoSW;
+      default:		return NULL;
+    }
+}
+
+//----------------------------------------------------------------------
+// BlockCache::BlockCache
+// 	Start with nothing translated.
+//----------------------------------------------------------------------
+
+BlockCache::BlockCache(Machine *m)
+{
+    machine = m;
+    blockAt = new Block *[MemorySize / 4];
+    for (int i = 0; i < MemorySize / 4; i++)
+	blockAt[i] = NULL;
+    pageBlocks = new int[NumPhysPages];
+    for (int i = 0; i < NumPhysPages; i++)
+	pageBlocks[i] = 0;
+    stale = NULL;
+    numTranslated = numRuns = numInstrs = 0;
+}
+
+//----------------------------------------------------------------------
+// BlockCache::~BlockCache
+// 	Free every block.
+//----------------------------------------------------------------------
+
+BlockCache::~BlockCache()
+{
+    DEBUG(dbgMach, "Block cache: " << numTranslated << " blocks translated, "
+	  << numRuns << " run, " << numInstrs << " instructions");
+    Invalidate(0, MemorySize);
+    FreeStale();
+    delete [] blockAt;
+    delete [] pageBlocks;
+}
+
+//----------------------------------------------------------------------
+// BlockCache::Translate
+// 	Translate the instructions from "physAddr", which the PC "pc"
+//	maps to, to the end of its page, stopping after the first one
+//	the interpreter must run.
+//----------------------------------------------------------------------
+
+Block *
+BlockCache::Translate(int pc, int physAddr)
+{
+    int end = (physAddr / PageSize + 1) * PageSize;
+    Block *block = new Block;
+
+    block->pc = pc;
+    block->physAddr = physAddr;
+    block->ops = new BlockOp[(end - physAddr) / 4];
+    block->valid = TRUE;
+    block->nextStale = NULL;
+    block->length = 0;
+    for (int addr = physAddr; addr < end; addr += 4) {
+	Instruction instr;
+	BlockOp *op = &block->ops[block->length++];
+
+	instr.value = MemoryToHost<4>(&machine->mainMemory[addr]);
+	instr.Decode();
+	op->func = FuncOf(instr.opCode);
+	op->pc = pc + (addr - physAddr);
+	op->rs = instr.rs;
+	op->rt = instr.rt;
+	op->rd = instr.rd;
+	op->extra = instr.extra;
+	if (op->func == NULL)
+	    break;
+    }
+    numTranslated++;
+    DEBUG(dbgMach, "Translated " << block->length << " instructions at "
+	  << pc);
+    return block;
+}
+
+//----------------------------------------------------------------------
+// BlockCache::Run
+// 	Run the block at the PC, translating it first if need be, for as
+//	long as control falls through it: until it reaches an instruction
+//	the interpreter must run, branches away, raises an exception, has
+//	its own code written over, or would run past the next interrupt.
+//	Then advance the clock for what it ran.
+//
+//	Returns FALSE, without running anything, if the interpreter must
+//	run the next instruction: it is one a block doesn't do, the PC
+//	doesn't translate, or an interrupt is due now.
+//----------------------------------------------------------------------
+
+bool
+BlockCache::Run()
+{
+    int *r = machine->registers;
+    int ahead = kernel->interrupt->NextDue() - kernel->stats->totalTicks;
+    int budget, physAddr, i;
+    bool ok;
+
+    FreeStale();			// none of them is running now
+    if (ahead > PageSize * UserTick)
+	ahead = PageSize * UserTick;	// more than any block can use
+    budget = (ahead + UserTick - 1) / UserTick - machine->pendingTicks;
+					// instructions until one is due
+    if (budget <= 0 || machine->singleStep || debug->IsEnabled('m'))
+	return FALSE;
+    if (machine->Translate(r[PCReg], &physAddr, 4, FALSE) != NoException)
+	return FALSE;			// leave the fault to the interpreter
+
+    Block *block = blockAt[physAddr / 4];
+
+    if (block != NULL && block->pc != r[PCReg]) {
+	Invalidate(physAddr, 4);	// mapped at another address now
+	block = NULL;
+    }
+    if (block == NULL) {
+	block = Translate(r[PCReg], physAddr);
+	blockAt[physAddr / 4] = block;
+	pageBlocks[physAddr / PageSize]++;
+    }
+    if (block->ops[0].func == NULL)
+	return FALSE;
+
+    numRuns++;
+    for (i = 0; i < block->length && i < budget; i++) {
+	BlockOp *op = &block->ops[i];
+
+	if (op->func == NULL || r[PCReg] != op->pc)
+	    break;			// not falling through any more
+	ok = (*op->func)(machine, r, op);
+	machine->pendingTicks++;	// after: an exception charges the
+					// ones before it, then runs the kernel
+	if (!ok || !block->valid) {
+	    i++;			// the kernel handled an exception, or
+	    break;			// it wrote over its own code
+	}
+    }
+    numInstrs += i;
+    machine->ChargePendingTicks();
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// BlockCache::Invalidate
+// 	Forget every block with an instruction among "size" bytes of
+//	physical memory from "physAddr", as they have been written.  The
+//	blocks aren't freed yet, as one may be running; see FreeStale.
+//----------------------------------------------------------------------
+
+void
+BlockCache::Invalidate(int physAddr, int size)
+{
+    int last = physAddr + size - 1;
+
+    for (int page = physAddr / PageSize; page <= last / PageSize; page++) {
+	if (pageBlocks[page] == 0)
+	    continue;			// the usual case: no code here
+	for (int addr = page * PageSize; addr < (page + 1) * PageSize;
+			addr += 4) {
+	    Block *block = blockAt[addr / 4];
+
+	    if (block == NULL || addr > last
+		|| addr + block->length * 4 <= physAddr)
+		continue;
+	    block->valid = FALSE;
+	    block->nextStale = stale;
+	    stale = block;
+	    blockAt[addr / 4] = NULL;
+	    pageBlocks[page]--;
+	}
+    }
+}
+
+//----------------------------------------------------------------------
+// BlockCache::FreeStale
+// 	Free the blocks invalidated since the last time.
+//----------------------------------------------------------------------
+
+void
+BlockCache::FreeStale()
+{
+    while (stale != NULL) {
+	Block *block = stale;
+
+	stale = block->nextStale;
+	delete [] block->ops;
+	delete block;
+    }
+}
@@ -0,0 +1,98 @@
+// blockcache.h
+//	Data structures for translating user code a block at a time, so
+//	that the simulator can run straight-line stretches of it without
+//	going through Machine::OneInstruction for each instruction.
+//
+//	A block is the run of instructions from some word of physical
+//	memory to the end of its page (a block never crosses a page, so
+//	one translation of its PC covers it all).  Each instruction is
+//	translated into a BlockOp: a host routine that does just that
+//	kind of instruction, with its registers and immediate already
+//	pulled out.  Running a block calls each routine in turn, for as
+//	long as control keeps falling through to the next one.
+//
+//	Running a block has exactly the effect of running its
+//	instructions with -bs 1: the PC and delayed-load registers are
+//	kept up to date after every instruction, memory is read and
+//	written through ReadMem and WriteMem (so faults are taken at the
+//	same instruction), and a block is cut short so that it never runs
+//	past the time the next interrupt is due.  Only the clock is
+//	advanced once per block rather than once per instruction.
+//
+//	Anything a block doesn't handle -- a system call, trapping
+//	arithmetic, the unaligned loads and stores -- ends it, and the
+//	interpreter runs that instruction as usual.
+//
+// Copyright (c) 1992-1996 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#ifndef BLOCKCACHE_H
+#define BLOCKCACHE_H
+
+#include "copyright.h"
+#include "utility.h"
+
+class Machine;
+class BlockOp;
+
+// The host routine for one kind of instruction.  Returns FALSE if it
+// raised an exception (the kernel has already handled it).
+
+typedef bool (*BlockOpFunc)(Machine *machine, int *registers, BlockOp *op);
+
+// One translated instruction
+
+class BlockOp {
+  public:
+    BlockOpFunc func;		// what to do, or NULL for the interpreter
+    int pc;			// its virtual address
+    int rs, rt, rd;		// the registers it names
+    int extra;			// its immediate, target or shift amount
+};
+
+// A translated run of instructions
+
+class Block {
+  public:
+    int pc;			// virtual address it was translated at
+    int physAddr;		// physical address of its first instruction
+    int length;			// number of BlockOps
+    BlockOp *ops;
+    bool valid;			// FALSE once its memory has been written
+    Block *nextStale;		// on the list of blocks to free
+};
+
+// The following class holds the translated blocks, and runs them.
+
+class BlockCache {
+  public:
+    BlockCache(Machine *m);	// translate the code "m" runs
+    ~BlockCache();
+
+    bool Run();			// run the block at the PC, if there is
+				// one to run; return FALSE if the
+				// interpreter must run the next
+				// instruction instead
+    void Invalidate(int physAddr, int size);
+				// forget the blocks with instructions in
+				// "size" bytes of physical memory
+
+  private:
+    Block *Translate(int pc, int physAddr);
+				// translate the block at "physAddr"
+    void FreeStale();		// free the blocks invalidated since
+
+    Machine *machine;
+    Block **blockAt;		// the block starting at each word of
+				// physical memory, or NULL
+    int *pageBlocks;		// blocks starting in each physical page
+    Block *stale;		// invalidated blocks, not yet freed
+				// (one may be running)
+
+    int numTranslated;		// blocks translated
+    int numRuns;		// and run
+    int numInstrs;		// instructions run in blocks
+};
+
+#endif // BLOCKCACHE_H
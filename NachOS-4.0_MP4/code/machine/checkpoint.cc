@@ -0,0 +1,174 @@
+// checkpoint.cc
+//	Routines to checkpoint a simulation by forking copies of the
+//	Nachos process, and to put the disk back between runs.
+//
+// Copyright (c) 1992-1996 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "checkpoint.h"
+#include "disk.h"
+#include "main.h"
+#include "sysdep.h"
+#include "memops.h"
+#include <stdio.h>
+
+// The disk's UNIX file: a magic number, then the sectors (see disk.cc)
+
+static const int DiskHeader = sizeof(int);
+static const int DiskImageSize = DiskHeader + NumSectors * SectorSize;
+
+// The disk snapshot's: a magic number, a byte per sector, then the
+// sectors
+
+static const int CowHeader = sizeof(int) + NumSectors;
+static const int CowImageSize = CowHeader + NumSectors * SectorSize;
+
+//----------------------------------------------------------------------
+// SaveFile
+// 	Return the first "size" bytes of the UNIX file "name", or NULL if
+//	there is no such file.
+//----------------------------------------------------------------------
+
+static char *
+SaveFile(char *name, int size)
+{
+    int fd = OpenForReadWrite(name, FALSE);
+    char *image;
+
+    if (fd < 0)
+	return NULL;
+    image = new char[size];
+    Read(fd, image, size);
+    Close(fd);
+    return image;
+}
+
+//----------------------------------------------------------------------
+// RestoreFile
+// 	Write back the sectors of the UNIX file "name" that differ from
+//	"image", saved by SaveFile, after its "header" bytes (which are
+//	always written back).  Returns the number of sectors written.
+//----------------------------------------------------------------------
+
+static int
+RestoreFile(char *name, char *image, int header, int size)
+{
+    int fd = OpenForReadWrite(name, TRUE);
+    char *now = new char[size];
+    int changed = 0;
+
+    Read(fd, now, size);
+    if (MemCompare(now, image, header) != 0) {
+	Lseek(fd, 0, 0);
+	WriteFile(fd, image, header);
+    }
+    for (int offset = header; offset < size; offset += SectorSize) {
+	if (MemCompare(now + offset, image + offset, SectorSize) != 0) {
+	    Lseek(fd, offset, 0);
+	    WriteFile(fd, image + offset, SectorSize);
+	    changed++;
+	}
+    }
+    delete [] now;
+    Close(fd);
+    return changed;
+}
+
+//----------------------------------------------------------------------
+// Checkpoint::Checkpoint
+// 	Arrange to checkpoint at simulated time "tick" and run from
+//	there "runs" times, with the machine's first "disks" disks.
+//----------------------------------------------------------------------
+
+Checkpoint::Checkpoint(int tick, int runs, int disks)
+{
+    ASSERT(tick >= 0 && runs >= 1 && disks >= 1 && disks <= MaxDisks);
+    this->tick = tick;
+    this->runs = runs;
+    taken = FALSE;
+    numDisks = disks;
+    for (int d = 0; d < numDisks; d++) {
+	diskImage[d] = cowImage[d] = NULL;
+	Disk::UnixName(d, diskName[d]);
+	sprintf(cowName[d], "%s.cow", diskName[d]);
+    }
+}
+
+//----------------------------------------------------------------------
+// Checkpoint::~Checkpoint
+//----------------------------------------------------------------------
+
+Checkpoint::~Checkpoint()
+{
+    for (int d = 0; d < numDisks; d++) {
+	delete [] diskImage[d];
+	delete [] cowImage[d];
+    }
+}
+
+//----------------------------------------------------------------------
+// Checkpoint::Take
+// 	Save the disk images, then fork the runs one at a time.  Each copy
+//	returns, to simulate the rest of the way from the checkpoint; the
+//	original waits for it, puts the disk back, and forks the next.
+//	When the last run is done, the original exits as it did.
+//
+//	Output is flushed first, so that what was printed before the
+//	checkpoint isn't printed again by each copy.
+//----------------------------------------------------------------------
+
+void
+Checkpoint::Take()
+{
+    int status = 0;
+
+    taken = TRUE;
+    for (int d = 0; d < numDisks; d++) {
+	diskImage[d] = SaveFile(diskName[d], DiskImageSize);
+	cowImage[d] = SaveFile(cowName[d], CowImageSize);
+    }
+    cout << "Checkpoint at tick " << kernel->stats->totalTicks << "\n";
+
+    for (int run = 1; run <= runs; run++) {
+	cout.flush();
+	fflush(stdout);
+	int pid = ForkProcess();
+
+	if (pid == 0) {
+	    cout << "Run " << run << " of " << runs
+		 << ", from the checkpoint\n";
+	    kernel->RestartWallClock();
+	    return;			// the copy simulates the rest
+	}
+	status = WaitProcess(pid);
+	RestoreDisk();
+    }
+    Exit(status);
+}
+
+//----------------------------------------------------------------------
+// Checkpoint::RestoreDisk
+// 	Write back the sectors of each disk's UNIX file (and its
+//	snapshot's) that differ from the images saved at the checkpoint.  A run
+//	usually changes few of them, so this is quicker than writing the
+//	whole image back.
+//----------------------------------------------------------------------
+
+void
+Checkpoint::RestoreDisk()
+{
+    int changed = 0;
+
+    for (int d = 0; d < numDisks; d++) {
+	if (diskImage[d] == NULL)
+	    continue;
+	changed += RestoreFile(diskName[d], diskImage[d], DiskHeader,
+				DiskImageSize);
+	if (cowImage[d] != NULL)
+	    changed += RestoreFile(cowName[d], cowImage[d], CowHeader,
+				CowImageSize);
+    }
+    cout << "Checkpoint: restored " << changed << " sectors of the disk\n";
+}
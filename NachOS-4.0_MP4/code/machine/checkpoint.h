@@ -0,0 +1,61 @@
+// checkpoint.h
+//	Data structures for checkpointing a simulation part of the way
+//	through, and running the rest of it from there again and again,
+//	without booting and warming up each time.
+//
+//	The state of a simulation is spread over the whole Nachos
+//	process: simulated memory and registers, page tables, the
+//	pending interrupts, statistics, and the host stacks of every
+//	Nachos thread, full of host pointers.  Rather than write all of
+//	it to a file (and fix up every pointer on reading it back), the
+//	checkpoint is a copy of the process, made with UNIX "fork": the
+//	original sleeps at the checkpoint, and each run is a copy of it,
+//	started in the time it takes to fork.
+//
+//	The one piece of state outside the process is the disks' UNIX
+//	files (and their snapshots', if they have them; cf. disk.h).  Their
+//	images are saved at the checkpoint, and after each run the
+//	sectors the run changed are put back, so that every run sees the
+//	disk as it was at the checkpoint.
+//
+// Copyright (c) 1992-1996 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include "copyright.h"
+#include "utility.h"
+#include "disk.h"
+
+// The following class takes the checkpoint, and runs the rest of the
+// simulation from it.
+
+class Checkpoint {
+  public:
+    Checkpoint(int tick, int runs, int disks = 1);
+				// checkpoint at simulated time "tick", and
+				// run the rest of the simulation "runs"
+				// times from there, saving "disks" disks
+    ~Checkpoint();
+
+    void Check(int now) { if (!taken && now >= tick) Take(); }
+				// called each tick, with the simulated
+				// time: take the checkpoint, if it is time
+
+  private:
+    void Take();		// save the disk, and fork off the runs
+    void RestoreDisk();		// put back the sectors a run changed
+
+    int tick;			// when to take the checkpoint
+    int runs;			// how many times to run from it
+    bool taken;			// has it been taken?
+    int numDisks;		// how many disks there are
+    char diskName[MaxDisks][32];	// each disk's UNIX file
+    char *diskImage[MaxDisks];	// its contents at the checkpoint
+    char cowName[MaxDisks][40];	// each disk snapshot's UNIX file
+    char *cowImage[MaxDisks];	// its contents, or NULL if there is none
+};
+
+#endif // CHECKPOINT_H
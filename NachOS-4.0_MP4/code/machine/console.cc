@@ -146,6 +146,7 @@ ConsoleOutput::ConsoleOutput(char *writeFile, CallBackObj *toCall)
 
 ConsoleOutput::~ConsoleOutput()
 {
+    WaitFileWrites();
     if (writeFileNo != 1)
 	Close(writeFileNo);
 }
@@ -168,13 +169,17 @@ ConsoleOutput::CallBack()
 // ConsoleOutput::PutChar()
 // 	Write a character to the simulated display, schedule an interrupt 
 //	to occur in the future, and return.
+//
+//	The character is written out by the host writer thread, so that
+//	a slow terminal or pipe doesn't hold up the simulation; when the
+//	interrupt comes doesn't depend on when it is out.
 //----------------------------------------------------------------------
 
 void
 ConsoleOutput::PutChar(char ch)
 {
     ASSERT(putBusy == FALSE);
-    WriteFile(writeFileNo, &ch, sizeof(char));
+    WriteFileLater(writeFileNo, &ch, sizeof(char));
     putBusy = TRUE;
     kernel->interrupt->Schedule(this, ConsoleTime, ConsoleWriteInt);
 }
@@ -5,7 +5,10 @@
 //	therefore about the behavior of this simulation).
 //
 //	Disk operations are asynchronous, so we have to invoke an interrupt
-//	handler when the simulated operation completes.
+//	handler when the simulated operation completes.  The UNIX file is
+//	read or written meanwhile, on a host thread of its own, so that
+//	the host's I/O overlaps with simulating the machine; it only has
+//	to be done by the time the interrupt comes.
 //
 //  DO NOT CHANGE -- part of the machine emulation
 //
@@ -18,6 +21,8 @@
 #include "debug.h"
 #include "sysdep.h"
 #include "main.h"
+#include "memops.h"
+#include "flash.h"
 
 // We put a magic number at the front of the UNIX file representing the
 // disk, to make it less likely we will accidentally treat a useful file 
@@ -27,31 +32,57 @@ const int MagicNumber = 0x456789ab;
 const int MagicSize = sizeof(int);
 const int DiskSize = (MagicSize + (NumSectors * SectorSize));
 
+// The UNIX file of a snapshot's sectors: a magic number, then a byte for
+// each sector saying whether it has been written since the snapshot,
+// then the sectors written.
+
+const int CowMagicNumber = 0x434f5753;
+const int CowMapStart = MagicSize;
+const int CowDataStart = (CowMapStart + NumSectors);
+const int CowSize = (CowDataStart + (NumSectors * SectorSize));
+
 
 //----------------------------------------------------------------------
 // Disk::Disk()
 // 	Initialize a simulated disk.  Open the UNIX file (creating it
 //	if it doesn't exist), and check the magic number to make sure it's 
-// 	ok to treat it as Nachos disk storage.
+// 	ok to treat it as Nachos disk storage.  Then map it, if asked to;
+//	if that fails, fall back to reading and writing it.  Last, open
+//	the disk's snapshot, if it has one, and take, roll back or drop
+//	the snapshot, if asked to.
 //
 //	"toCall" -- object to call when disk read/write request completes
+//	"mapped" -- should the file be mapped into memory?
+//	"snapshot" -- what to do with the snapshot
+//	"unit" -- which of the machine's disks this is
+//	"device" -- the kind of disk it is, for its timing
 //----------------------------------------------------------------------
 
-Disk::Disk(CallBackObj *toCall)
+Disk::Disk(CallBackObj *toCall, bool mapped, SnapshotAction snapshot,
+		int unit, DiskDevice device)
 {
     int magicNum;
     int tmp = 0;
 
     DEBUG(dbgDisk, "Initializing the disk.");
     callWhenDone = toCall;
-    lastSector = 0;
-    bufferInit = 0;
+    if (device == FlashDevice)
+	model = new FlashModel();
+    else
+	model = new RotatingModel();
     
-    sprintf(diskname,"DISK_%d",kernel->hostName);
+    UnixName(unit, diskname);
     fileno = OpenForReadWrite(diskname, FALSE);
     if (fileno >= 0) {		 	// file exists, check magic number 
 		Read(fileno, (char *) &magicNum, MagicSize);
 		ASSERT(magicNum == MagicNumber);
+		Lseek(fileno, 0, SEEK_END);	// and that it is this size
+		if (Tell(fileno) != DiskSize) {
+		    cout << diskname << " is not " << NumSectors
+			 << " sectors, the size of this machine's disk"
+			 << " (cf. config.h)\n";
+		    Exit(1);
+		}
     } else {				// file doesn't exist, create it
         fileno = OpenForWrite(diskname);
 		magicNum = MagicNumber;  
@@ -61,18 +92,305 @@ Disk::Disk(CallBackObj *toCall)
         Lseek(fileno, DiskSize - sizeof(int), 0);	
 		WriteFile(fileno, (char *)&tmp, sizeof(int));  
     }
+    image = mapped ? MapFile(fileno, DiskSize) : NULL;
+    if (mapped && image == NULL)
+	cout << "Can't map " << diskname << ", reading and writing it\n";
+    OpenSnapshot(snapshot);
     active = FALSE;
+    transferring = FALSE;
+}
+
+//----------------------------------------------------------------------
+// Disk::UnixName()
+// 	Put the name of the UNIX file of this machine's disk "unit" in
+//	"name", which has room for 32 characters.
+//----------------------------------------------------------------------
+
+void
+Disk::UnixName(int unit, char *name)
+{
+    ASSERT(unit >= 0 && unit < MaxDisks);
+    if (unit == 0)
+	sprintf(name, "DISK_%d", kernel->hostName);
+    else
+	sprintf(name, "DISK_%d.%d", kernel->hostName, unit);
 }
 
 //----------------------------------------------------------------------
 // Disk::~Disk()
 // 	Clean up disk simulation, by closing the UNIX file representing the
-//	disk.
+//	disk, after bringing it up to date if it is mapped.
 //----------------------------------------------------------------------
 
 Disk::~Disk()
 {
+    FinishTransfer();
+    if (image != NULL) {
+	Flush();
+	UnmapFile(image, DiskSize);
+    }
     Close(fileno);
+    if (cowFile >= 0)
+	Close(cowFile);
+    delete [] written;
+    delete model;
+}
+
+//----------------------------------------------------------------------
+// Disk::OpenSnapshot()
+// 	Open the file of the sectors written since the disk's snapshot,
+//	if there is a snapshot, and then:
+//
+//	   TakeSnapshot -- copy them into the disk's own file, if there
+//		was a snapshot, so that the disk as it is now becomes the
+//		snapshot; otherwise create the file.  Either way, no
+//		sector has been written since.
+//	   RollBackSnapshot -- forget all of them
+//	   DropSnapshot -- copy them into the disk's own file, and remove
+//		the snapshot's
+//
+//	Each is done so that if Nachos is killed part way, running it
+//	again with the same action finishes the job.
+//----------------------------------------------------------------------
+
+void
+Disk::OpenSnapshot(SnapshotAction action)
+{
+    int magicNum;
+    int tmp = 0;
+
+    written = new char[NumSectors];
+    MemZero(written, NumSectors);
+    numWritten = 0;
+    sprintf(cowName, "%s.cow", diskname);
+    cowFile = OpenForReadWrite(cowName, FALSE);
+    if (cowFile >= 0) {
+	Read(cowFile, (char *) &magicNum, MagicSize);
+	ASSERT(magicNum == CowMagicNumber);
+	Read(cowFile, written, NumSectors);
+	for (int i = 0; i < NumSectors; i++)
+	    if (written[i])
+		numWritten++;
+    }
+
+    switch (action) {
+      case KeepSnapshot:
+	return;
+      case TakeSnapshot:
+	if (cowFile >= 0) {
+	    MergeSnapshot();
+	} else {
+	    cowFile = OpenForWrite(cowName);
+	    magicNum = CowMagicNumber;
+	    WriteFile(cowFile, (char *) &magicNum, MagicSize);
+	    Lseek(cowFile, CowSize - sizeof(int), 0);	// so reads don't
+	    WriteFile(cowFile, (char *) &tmp, sizeof(int));	// return EOF
+	}
+	break;
+      case RollBackSnapshot:
+	if (cowFile < 0) {
+	    cout << "There is no snapshot of " << diskname << " to roll back to\n";
+	    return;
+	}
+	break;
+      case DropSnapshot:
+	if (cowFile >= 0) {
+	    MergeSnapshot();
+	    Close(cowFile);
+	    Unlink(cowName);
+	    cowFile = -1;
+	}
+	return;
+    }
+    DEBUG(dbgDisk, "Snapshot of " << diskname << ": forgetting "
+		<< numWritten << " sectors written since it was taken");
+    MemZero(written, NumSectors);
+    numWritten = 0;
+    Lseek(cowFile, CowMapStart, 0);
+    WriteFile(cowFile, written, NumSectors);
+}
+
+//----------------------------------------------------------------------
+// Disk::MergeSnapshot()
+// 	Copy each sector written since the snapshot into the disk's own
+//	UNIX file, leaving it as the disk is now.
+//----------------------------------------------------------------------
+
+void
+Disk::MergeSnapshot()
+{
+    char data[SectorSize];
+
+    DEBUG(dbgDisk, "Snapshot of " << diskname << ": keeping "
+		<< numWritten << " sectors written since it was taken");
+    for (int i = 0; i < NumSectors; i++) {
+	if (written[i]) {
+	    Lseek(cowFile, CowDataStart + i * SectorSize, 0);
+	    Read(cowFile, data, SectorSize);
+	    WriteBase(i, data, 1);
+	}
+    }
+    Flush();
+}
+
+//----------------------------------------------------------------------
+// Disk::ReadBase/WriteBase()
+// 	Read or write "count" consecutive sectors of the disk's own UNIX
+//	file (or the memory it is mapped into).
+//----------------------------------------------------------------------
+
+void
+Disk::ReadBase(int sectorNumber, char *data, int count)
+{
+    if (image != NULL) {
+	MemCopy(data, image + SectorSize * sectorNumber + MagicSize,
+		SectorSize * count);
+    } else {
+	Lseek(fileno, SectorSize * sectorNumber + MagicSize, 0);
+	Read(fileno, data, SectorSize * count);
+    }
+}
+
+void
+Disk::WriteBase(int sectorNumber, char *data, int count)
+{
+    if (image != NULL) {
+	MemCopy(image + SectorSize * sectorNumber + MagicSize, data,
+		SectorSize * count);
+    } else {
+	Lseek(fileno, SectorSize * sectorNumber + MagicSize, 0);
+	WriteFile(fileno, data, SectorSize * count);
+    }
+}
+
+//----------------------------------------------------------------------
+// Disk::ReadSectors/WriteSectors()
+// 	Read or write "count" consecutive sectors, as the disk holds them
+//	now.  With a snapshot, a sector written since it was taken is in
+//	the snapshot's file, and every write goes there; the sector is
+//	marked as written only once it is, so a run killed part way
+//	never finds a sector marked that wasn't.
+//----------------------------------------------------------------------
+
+void
+Disk::ReadSectors(int sectorNumber, char *data, int count)
+{
+    int run;
+
+    if (cowFile < 0) {
+	ReadBase(sectorNumber, data, count);
+	return;
+    }
+    for (int i = 0; i < count; i += run) {
+	int sector = sectorNumber + i;
+
+	for (run = 1; i + run < count
+			&& written[sector + run] == written[sector]; run++)
+	    ;
+	if (written[sector]) {
+	    Lseek(cowFile, CowDataStart + SectorSize * sector, 0);
+	    Read(cowFile, &data[i * SectorSize], SectorSize * run);
+	} else {
+	    ReadBase(sector, &data[i * SectorSize], run);
+	}
+    }
+}
+
+void
+Disk::WriteSectors(int sectorNumber, char *data, int count)
+{
+    bool marked = FALSE;
+
+    if (cowFile < 0) {
+	WriteBase(sectorNumber, data, count);
+	return;
+    }
+    Lseek(cowFile, CowDataStart + SectorSize * sectorNumber, 0);
+    WriteFile(cowFile, data, SectorSize * count);
+    for (int i = sectorNumber; i < sectorNumber + count; i++) {
+	if (!written[i]) {
+	    written[i] = TRUE;
+	    numWritten++;
+	    marked = TRUE;
+	}
+    }
+    if (marked) {
+	Lseek(cowFile, CowMapStart + sectorNumber, 0);
+	WriteFile(cowFile, &written[sectorNumber], count);
+    }
+}
+
+//----------------------------------------------------------------------
+// Disk::Flush()
+// 	Write what has been written to the mapped image back to the
+//	UNIX file.  Each write goes straight to the file otherwise, so
+//	there is nothing to do.  Takes no simulated time.
+//----------------------------------------------------------------------
+
+void
+Disk::Flush()
+{
+    FinishTransfer();
+    if (image != NULL)
+	SyncMappedFile(image, DiskSize);
+}
+
+//----------------------------------------------------------------------
+// Disk::StartTransfer()
+// 	Start reading or writing "count" sectors from "sectorNumber", to
+//	or from "data", on the host job thread.  A mapped disk is only a
+//	copy, and with disk debugging on the sectors are printed as they
+//	go, so those are done right away instead.
+//----------------------------------------------------------------------
+
+void
+Disk::StartTransfer(int sectorNumber, char *data, int count, bool writing)
+{
+    xferSector = sectorNumber;
+    xferData = data;
+    xferCount = count;
+    xferWriting = writing;
+    if (image != NULL || debug->IsEnabled('d')) {
+	Transfer(this);
+	return;
+    }
+    transferring = TRUE;
+    StartHostJob(Transfer, this);
+}
+
+//----------------------------------------------------------------------
+// Disk::Transfer()
+// 	Do the transfer StartTransfer was asked for.  Runs on the host job
+//	thread, so it only touches the disk's files, and the sectors
+//	marked as written.
+//
+//	"arg" -- the disk
+//----------------------------------------------------------------------
+
+void
+Disk::Transfer(void *arg)
+{
+    Disk *disk = (Disk *) arg;
+
+    if (disk->xferWriting)
+	disk->WriteSectors(disk->xferSector, disk->xferData, disk->xferCount);
+    else
+	disk->ReadSectors(disk->xferSector, disk->xferData, disk->xferCount);
+}
+
+//----------------------------------------------------------------------
+// Disk::FinishTransfer()
+// 	Wait for the host job thread to be done with the transfer, if
+//	there is one.
+//----------------------------------------------------------------------
+
+void
+Disk::FinishTransfer()
+{
+    if (transferring) {
+	WaitHostJob();
+	transferring = FALSE;
+    }
 }
 
 //----------------------------------------------------------------------
@@ -97,55 +415,59 @@ PrintSector (bool writing, int sector, char *data)
 
 //----------------------------------------------------------------------
 // Disk::ReadRequest/WriteRequest
-// 	Simulate a request to read/write a single disk sector
-//	   Do the read/write immediately to the UNIX file
+// 	Simulate a request to read/write a run of consecutive disk sectors
+//	   Start the read/write of the UNIX file (or the memory it is
+//	      mapped into)
 //	   Set up an interrupt handler to be called later,
 //	      that will notify the caller when the simulator says
 //	      the operation has completed.
 //
 //	Note that a disk only allows an entire sector to be read/written,
-//	not part of a sector.
+//	not part of a sector.  A run of sectors pays the seek and rotational
+//	delay once, and then one RotationTime per sector (plus a track to
+//	track seek each time the run crosses onto the next track).
 //
-//	"sectorNumber" -- the disk sector to read/write
+//	"sectorNumber" -- the first disk sector to read/write
 //	"data" -- the bytes to be written, the buffer to hold the incoming bytes
+//	"count" -- how many sectors to transfer
 //----------------------------------------------------------------------
 
 void
-Disk::ReadRequest(int sectorNumber, char* data)
+Disk::ReadRequest(int sectorNumber, char* data, int count)
 {
-    int ticks = ComputeLatency(sectorNumber, FALSE);
+    int ticks = model->Request(sectorNumber, count, FALSE);
 
     ASSERT(!active);				// only one request at a time
-    ASSERT((sectorNumber >= 0) && (sectorNumber < NumSectors));
+    ASSERT((sectorNumber >= 0) && (count > 0) 
+			&& (sectorNumber + count <= NumSectors));
     
-    DEBUG(dbgDisk, "Reading from sector " << sectorNumber);
-    Lseek(fileno, SectorSize * sectorNumber + MagicSize, 0);
-    Read(fileno, data, SectorSize);
+    DEBUG(dbgDisk, "Reading " << count << " sector(s) from sector " << sectorNumber);
+    StartTransfer(sectorNumber, data, count, FALSE);
     if (debug->IsEnabled('d'))
-	PrintSector(FALSE, sectorNumber, data);
+	for (int i = 0; i < count; i++)
+	    PrintSector(FALSE, sectorNumber + i, &data[i * SectorSize]);
     
     active = TRUE;
-    UpdateLast(sectorNumber);
     kernel->stats->numDiskReads++;
     kernel->interrupt->Schedule(this, ticks, DiskInt);
 }
 
 void
-Disk::WriteRequest(int sectorNumber, char* data)
+Disk::WriteRequest(int sectorNumber, char* data, int count)
 {
-    int ticks = ComputeLatency(sectorNumber, TRUE);
+    int ticks = model->Request(sectorNumber, count, TRUE);
 
     ASSERT(!active);
-    ASSERT((sectorNumber >= 0) && (sectorNumber < NumSectors));
+    ASSERT((sectorNumber >= 0) && (count > 0) 
+			&& (sectorNumber + count <= NumSectors));
     
-    DEBUG(dbgDisk, "Writing to sector " << sectorNumber);
-    Lseek(fileno, SectorSize * sectorNumber + MagicSize, 0);
-    WriteFile(fileno, data, SectorSize);
+    DEBUG(dbgDisk, "Writing " << count << " sector(s) to sector " << sectorNumber);
+    StartTransfer(sectorNumber, data, count, TRUE);
     if (debug->IsEnabled('d'))
-	PrintSector(TRUE, sectorNumber, data);
+	for (int i = 0; i < count; i++)
+	    PrintSector(TRUE, sectorNumber + i, &data[i * SectorSize]);
     
     active = TRUE;
-    UpdateLast(sectorNumber);
     kernel->stats->numDiskWrites++;
     kernel->interrupt->Schedule(this, ticks, DiskInt);
 }
@@ -153,17 +475,50 @@ Disk::WriteRequest(int sectorNumber, char* data)
 //----------------------------------------------------------------------
 // Disk::CallBack()
 // 	Called by the machine simulation when the disk interrupt occurs.
+//	The transfer has to be done by now.
 //----------------------------------------------------------------------
 
 void
 Disk::CallBack ()
 { 
+    FinishTransfer();
     active = FALSE;
     callWhenDone->CallBack();
 }
 
 //----------------------------------------------------------------------
-// Disk::TimeToSeek()
+// RotatingModel::RotatingModel()
+// 	Initialize the timing of a rotating disk, with the head at
+//	sector 0 and nothing counted yet.
+//----------------------------------------------------------------------
+
+RotatingModel::RotatingModel()
+{
+    lastSector = 0;
+    bufferInit = 0;
+    for (int i = 0; i < NumTracks; i++)
+	seekDistance[i] = 0;
+    seekTicks = rotationTicks = transferTicks = 0;
+    bufferHits = bufferMisses = 0;
+}
+
+//----------------------------------------------------------------------
+// RotatingModel::Request()
+// 	Return how long a request for "count" sectors from "sector" will
+//	take (see RunLatency), and leave the head after its last sector.
+//----------------------------------------------------------------------
+
+int
+RotatingModel::Request(int sector, int count, bool writing)
+{
+    int ticks = RunLatency(sector, count, writing);
+
+    UpdateLast(sector + count - 1);
+    return ticks;
+}
+
+//----------------------------------------------------------------------
+// RotatingModel::TimeToSeek()
 //	Returns how long it will take to position the disk head over the correct
 //	track on the disk.  Since when we finish seeking, we are likely
 //	to be in the middle of a sector that is rotating past the head,
@@ -174,7 +529,7 @@ Disk::CallBack ()
 //----------------------------------------------------------------------
 
 int
-Disk::TimeToSeek(int newSector, int *rotation) 
+RotatingModel::TimeToSeek(int newSector, int *rotation) 
 {
     int newTrack = newSector / SectorsPerTrack;
     int oldTrack = lastSector / SectorsPerTrack;
@@ -191,13 +546,13 @@ Disk::TimeToSeek(int newSector, int *rotation)
 }
 
 //----------------------------------------------------------------------
-// Disk::ModuloDiff()
+// RotatingModel::ModuloDiff()
 // 	Return number of sectors of rotational delay between target sector
 //	"to" and current sector position "from"
 //----------------------------------------------------------------------
 
 int 
-Disk::ModuloDiff(int to, int from)
+RotatingModel::ModuloDiff(int to, int from)
 {
     int toOffset = to % SectorsPerTrack;
     int fromOffset = from % SectorsPerTrack;
@@ -206,7 +561,7 @@ Disk::ModuloDiff(int to, int from)
 }
 
 //----------------------------------------------------------------------
-// Disk::ComputeLatency()
+// RotatingModel::ComputeLatency()
 // 	Return how long will it take to read/write a disk sector, from
 //	the current position of the disk head.
 //
@@ -227,36 +582,89 @@ Disk::ModuloDiff(int to, int from)
 //----------------------------------------------------------------------
 
 int
-Disk::ComputeLatency(int newSector, bool writing)
+RotatingModel::ComputeLatency(int newSector, bool writing)
 {
-    int rotation;
-    int seek = TimeToSeek(newSector, &rotation);
-    int timeAfter = kernel->stats->totalTicks + seek + rotation;
+    int seek, rotation;
+    bool buffered;
+
+    return Latency(newSector, writing, &seek, &rotation, &buffered);
+}
+
+//----------------------------------------------------------------------
+// RotatingModel::Latency()
+// 	Compute the latency of a request to "newSector", as for
+//	ComputeLatency, also returning the time it spends seeking and
+//	waiting for the sector to rotate under the head, and whether it
+//	is served from the track buffer (with neither).
+//----------------------------------------------------------------------
+
+int
+RotatingModel::Latency(int newSector, bool writing, int *seek, int *rotation,
+		bool *buffered)
+{
+    *seek = TimeToSeek(newSector, rotation);
+    *buffered = FALSE;
+    int timeAfter = kernel->stats->totalTicks + *seek + *rotation;
 
 #ifndef NOTRACKBUF	// turn this on if you don't want the track buffer stuff
     // check if track buffer applies
-    if ((writing == FALSE) && (seek == 0) 
+    if ((writing == FALSE) && (*seek == 0) 
 		&& (((timeAfter - bufferInit) / RotationTime) 
 	     		> ModuloDiff(newSector, bufferInit / RotationTime))) {
         DEBUG(dbgDisk, "Request latency = " << RotationTime);
+	*rotation = 0;
+	*buffered = TRUE;
 	return RotationTime; // time to transfer sector from the track buffer
     }
 #endif
 
-    rotation += ModuloDiff(newSector, timeAfter / RotationTime) * RotationTime;
+    *rotation += ModuloDiff(newSector, timeAfter / RotationTime) * RotationTime;
 
-    DEBUG(dbgDisk, "Request latency = " << (seek + rotation + RotationTime));
-    return(seek + rotation + RotationTime);
+    DEBUG(dbgDisk, "Request latency = " << (*seek + *rotation + RotationTime));
+    return(*seek + *rotation + RotationTime);
 }
 
 //----------------------------------------------------------------------
-// Disk::UpdateLast
+// RotatingModel::RunLatency()
+// 	Return how long it will take to read/write "count" consecutive
+//	sectors starting at "newSector": the latency of the first one,
+//	then one sector time for each of the rest, plus a one track seek
+//	whenever the run moves onto the next track.
+//
+//	Called once per request, so it also counts where the time goes.
+//----------------------------------------------------------------------
+
+int
+RotatingModel::RunLatency(int newSector, int count, bool writing)
+{
+    int endSector = newSector + count - 1;
+    int tracks = endSector / SectorsPerTrack - newSector / SectorsPerTrack;
+    int seek, rotation;
+    bool buffered;
+    int latency = Latency(newSector, writing, &seek, &rotation, &buffered);
+
+    seekDistance[abs(newSector / SectorsPerTrack
+			- lastSector / SectorsPerTrack)]++;
+    seekTicks += seek + tracks * SeekTime;
+    rotationTicks += rotation;
+    transferTicks += count * RotationTime;
+    if (!writing) {
+	if (buffered)
+	    bufferHits++;
+	else
+	    bufferMisses++;
+    }
+    return latency + (count - 1) * RotationTime + tracks * SeekTime;
+}
+
+//----------------------------------------------------------------------
+// RotatingModel::UpdateLast
 //   	Keep track of the most recently requested sector.  So we can know
 //	what is in the track buffer.
 //----------------------------------------------------------------------
 
 void
-Disk::UpdateLast(int newSector)
+RotatingModel::UpdateLast(int newSector)
 {
     int rotate;
     int seek = TimeToSeek(newSector, &rotate);
@@ -266,3 +674,46 @@ Disk::UpdateLast(int newSector)
     lastSector = newSector;
     DEBUG(dbgDisk, "Updating last sector = " << lastSector << " , " << bufferInit);
 }
+
+//----------------------------------------------------------------------
+// RotatingModel::PrintStats
+// 	Print how far the head moved to reach each request, the time
+//	spent seeking, waiting for rotation and transferring, and how
+//	often reads were served from the track buffer -- what sector
+//	placement and request ordering are meant to cut down.
+//----------------------------------------------------------------------
+
+void
+RotatingModel::PrintStats()
+{
+    int reads = bufferHits + bufferMisses;
+
+    cout << "Disk seeks (tracks: requests):";
+    for (int i = 0; i < NumTracks; i++)
+	if (seekDistance[i] > 0)
+	    cout << " " << i << ": " << seekDistance[i];
+    cout << "\n";
+    cout << "Disk time: seek " << seekTicks << ", rotation " << rotationTicks
+	 << ", transfer " << transferTicks << " ticks\n";
+    cout << "Disk track buffer: hits " << bufferHits << ", misses "
+	 << bufferMisses;
+    if (reads > 0)
+	cout << " (" << 100 * bufferHits / reads << "% of reads)";
+    cout << "\n";
+}
+
+//----------------------------------------------------------------------
+// Disk::PrintStats
+// 	Print the statistics of the disk's timing model, and how much has
+//	been written since the snapshot, if there is one.
+//----------------------------------------------------------------------
+
+void
+Disk::PrintStats()
+{
+    FinishTransfer();			// it may be marking sectors written
+    model->PrintStats();
+    if (cowFile >= 0)
+	cout << "Disk snapshot: " << numWritten
+	     << " sectors written since it was taken\n";
+}
@@ -20,6 +20,7 @@
 #include "copyright.h"
 #include "utility.h"
 #include "callback.h"
+#include "config.h"
 
 // The following class defines a physical disk I/O device.  The disk
 // has a single surface, split up into "tracks", and each track split
@@ -46,47 +47,218 @@
 // disks these days now come with a track buffer.
 //
 // The track buffer simulation can be disabled by compiling with -DNOTRACKBUF
+//
+// All of that is the disk's timing model, RotatingModel.  The disk can
+// instead be a flash drive (FlashModel, in flash.h), with the same
+// sectors in the same UNIX file: only how long each request takes,
+// and the statistics, differ.  Any other kind of device need only be
+// another DiskModel.
+//
+// The UNIX file can also be mapped into memory, so that a transfer is
+// just a copy, rather than a system call; the simulated timing is the
+// same.  The file is then brought up to date by Flush, and when the
+// disk is deallocated.
+//
+// A snapshot of the disk keeps its UNIX file just as it was when the
+// snapshot was taken.  From then on, each sector written goes to a
+// second file, "DISK_<n>.cow", instead -- copy on write, a sector at a
+// time -- along with a byte for each sector saying whether it has
+// been written since; a sector that hasn't is read from the first
+// file.  So taking a snapshot and rolling back to it each just clear
+// those bytes, however much the file system on the disk holds, and
+// neither affects the simulated timing.
+//
+// There can be several disks, up to MaxDisks, each with its own UNIX
+// file, head and interrupt, so that they work at the same time (see
+// SynchDisk for how the file system uses them together).  Disk 0's
+// file is DISK_<n>, for machine n; disk d's is DISK_<n>.<d>.
 
-const int SectorSize = 128;		// number of bytes per disk sector
-const int SectorsPerTrack  = 32;	// number of sectors per disk track 
-const int NumTracks = 32;		// number of tracks per disk
+const int SectorSize = Config::SectorSize;
+					// number of bytes per disk sector
+const int SectorsPerTrack = Config::SectorsPerTrack;
+					// number of sectors per disk track 
+const int NumTracks = Config::NumTracks;	// number of tracks per disk
 const int NumSectors = (SectorsPerTrack * NumTracks);
 					// total # of sectors per disk
+const int MaxDisks = 8;			// disks a machine can have
+
+// The order in which the disk is given queued requests (cf. SynchDisk)
+
+enum DiskSchedule {
+    FCFSSchedule,		// in the order they were made
+    SSTFSchedule,		// the one the head can seek to soonest
+    SCANSchedule,		// elevator: the nearest one in the direction
+				// the head is sweeping, reversing when there
+				// are no more that way
+    CLOOKSchedule		// as SCAN, but only sweeping upwards; at the
+				// top the head goes back to the lowest one
+};
+
+// What to do with the disk's snapshot, when the disk is created
+
+enum SnapshotAction {
+    KeepSnapshot,		// nothing: carry on from where the last run
+				// left it (with or without a snapshot)
+    TakeSnapshot,		// keep the disk as it is now, to roll back to
+				// (replacing any older snapshot)
+    RollBackSnapshot,		// forget what was written since the snapshot
+    DropSnapshot		// keep what was written, and no snapshot
+};
+
+// How a SynchDisk spreads its sectors over several disks
+
+enum ArrayLayout {
+    StripedLayout,		// RAID-0: in chunks of consecutive sectors,
+				// dealt out to the disks in turn
+    MirroredLayout		// RAID-1: every sector on every disk
+};
+
+const int DefaultStripeSectors = 8;	// sectors in a chunk, for striping
+
+// The kind of device the disk is
+
+enum DiskDevice {
+    RotatingDevice,		// a hard disk (RotatingModel)
+    FlashDevice			// a solid-state drive (FlashModel)
+};
+
+// How long a disk's requests take.  The disk asks its model once for
+// each request, as the request starts; the scheduler may also ask how
+// far off a sector is, to choose between requests.
+
+class DiskModel {
+  public:
+    virtual ~DiskModel() {}
+
+    virtual int Request(int sector, int count, bool writing) = 0;
+				// Return how long a request for "count"
+				// sectors from "sector" will take, from
+				// now, and count where the time goes
+    virtual int TimeToSeek(int sector, int *rotation) = 0;
+				// How long until a request for "sector"
+				// could start transferring it: returned,
+				// and in *rotation
+    virtual int HeadSector() = 0;
+				// Where the last request left off
+    virtual void PrintStats() = 0;
+				// Print where the time of the requests
+				// went
+};
+
+// The timing of a rotating disk, with a track buffer, as described
+// above
+
+class RotatingModel : public DiskModel {
+  public:
+    RotatingModel();
+
+    int Request(int sector, int count, bool writing);
+    int TimeToSeek(int newSector, int *rotate); // time to get to the new track
+    int HeadSector() { return lastSector; }
+					// Where the last request left the head
+    void PrintStats();
+
+    int ComputeLatency(int newSector, bool writing);	
+    					// Return how long a request to 
+					// newSector will take: 
+					// (seek + rotational delay + transfer)
+
+  private:
+    int lastSector;			// The previous disk request 
+    int bufferInit;			// When the track buffer started 
+					// being loaded
+
+    int seekDistance[NumTracks];	// requests by how many tracks the
+					// head moved to reach their first
+					// sector
+    int seekTicks;			// time spent seeking, in all
+    int rotationTicks;			// waiting for sectors to come round
+    int transferTicks;			// and transferring them
+    int bufferHits;			// reads served from the track buffer
+    int bufferMisses;			// and reads that weren't
+
+    int ModuloDiff(int to, int from);        // # sectors between to and from
+    int Latency(int newSector, bool writing, int *seek, int *rotation,
+		bool *buffered);	// ComputeLatency, in its parts
+    int RunLatency(int newSector, int count, bool writing);
+					// latency of a multi-sector request
+    void UpdateLast(int newSector);
+};
 
 class Disk : public CallBackObj {
   public:
-    Disk(CallBackObj *toCall);          // Create a simulated disk.  
+    Disk(CallBackObj *toCall, bool mapped = FALSE,
+		SnapshotAction snapshot = KeepSnapshot, int unit = 0,
+		DiskDevice device = RotatingDevice);
+					// Create simulated disk "unit".  
 					// Invoke toCall->CallBack() 
 					// when each request completes.
+					// If "mapped", map the UNIX file
+					// into memory.
     ~Disk();				// Deallocate the disk.
+
+    static void UnixName(int unit, char *name);
+					// Put the name of disk "unit"'s
+					// UNIX file in "name"
     
-    void ReadRequest(int sectorNumber, char* data);
-    					// Read/write an single disk sector.
+    void ReadRequest(int sectorNumber, char* data, int count = 1);
+    					// Read/write "count" consecutive disk
+					// sectors (usually just one).
 					// These routines send a request to 
     					// the disk and return immediately.
     					// Only one request allowed at a time!
-    void WriteRequest(int sectorNumber, char* data);
+    void WriteRequest(int sectorNumber, char* data, int count = 1);
 
     void CallBack();			// Invoked when disk request 
 					// finishes. In turn calls, callWhenDone.
 
-    int ComputeLatency(int newSector, bool writing);	
-    					// Return how long a request to 
-					// newSector will take: 
-					// (seek + rotational delay + transfer)
+    int TimeToSeek(int newSector, int *rotate)
+	{ return model->TimeToSeek(newSector, rotate); }
+					// time to get to the new sector
+    int HeadSector() { return model->HeadSector(); }
+					// Where the last request left the head
+    void Flush();			// Make sure the UNIX file has
+					// everything written so far
+    void PrintStats();			// Print where the time of the
+					// requests went
 
   private:
+    DiskModel *model;			// how long requests take
     int fileno;				// UNIX file number for simulated disk 
     char diskname[32];			// name of simulated disk's file
+    char *image;			// the file mapped into memory, or
+					// NULL if it is read and written
+    int cowFile;			// UNIX file of the sectors written
+					// since the snapshot, or -1 if there
+					// is no snapshot
+    char cowName[40];			// its name
+    char *written;			// has each sector been written
+					// since the snapshot?
+    int numWritten;			// how many have
     CallBackObj *callWhenDone;		// Invoke when any disk request finishes
     bool active;     			// Is a disk operation in progress?
-    int lastSector;			// The previous disk request 
-    int bufferInit;			// When the track buffer started 
-					// being loaded
+    bool transferring;			// Is the host job thread doing its
+					// transfer?
+    int xferSector;			// The transfer: "xferCount" sectors
+    char *xferData;			// from "xferSector", to or from
+    int xferCount;			// "xferData"
+    bool xferWriting;
 
-    int TimeToSeek(int newSector, int *rotate); // time to get to the new track
-    int ModuloDiff(int to, int from);        // # sectors between to and from
-    void UpdateLast(int newSector);
+    void ReadSectors(int sectorNumber, char *data, int count);
+    void WriteSectors(int sectorNumber, char *data, int count);
+					// transfer sectors to or from the
+					// UNIX files
+    void StartTransfer(int sectorNumber, char *data, int count,
+			bool writing);	// start ReadSectors or WriteSectors
+    static void Transfer(void *disk);	// ...which runs this
+    void FinishTransfer();		// wait for it to be done
+    void ReadBase(int sectorNumber, char *data, int count);
+    void WriteBase(int sectorNumber, char *data, int count);
+					// the same, ignoring any snapshot
+    void OpenSnapshot(SnapshotAction action);
+					// find the snapshot, and do "action"
+    void MergeSnapshot();		// copy the sectors written since the
+					// snapshot into the disk's own file
 };
 
 #endif // DISK_H
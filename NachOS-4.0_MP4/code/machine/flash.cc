@@ -0,0 +1,257 @@
+// flash.cc
+//	Routines to simulate the timing of a solid-state drive: its flash
+//	translation layer, garbage collection, and channels.  See flash.h
+//	for how the drive behaves.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "flash.h"
+#include "main.h"
+#include "stats.h"
+
+//----------------------------------------------------------------------
+// FlashModel::FlashModel
+// 	Initialize the drive's FTL, as if each sector had been written
+//	once, in order: size each channel for its sectors and its spare
+//	blocks, put every block on the free lists, and program every
+//	sector.  The counts start from there.
+//----------------------------------------------------------------------
+
+FlashModel::FlashModel()
+{
+    int sectorsPerChannel = divRoundUp(NumSectors, FlashChannels);
+    int dataBlocks = divRoundUp(sectorsPerChannel, FlashBlockPages);
+
+    blocksPerChannel = dataBlocks + max(2, dataBlocks / FlashSpareRatio);
+    numBlocks = FlashChannels * blocksPerChannel;
+    map = new int[NumSectors];
+    owner = new int[numBlocks * FlashBlockPages];
+    validPages = new int[numBlocks];
+    eraseCount = new int[numBlocks];
+    erased = new bool[numBlocks];
+    for (int i = 0; i < numBlocks * FlashBlockPages; i++)
+	owner[i] = -1;
+    for (int c = 0; c < FlashChannels; c++) {
+	freeBlocks[c] = new List<int>;
+	for (int b = c * blocksPerChannel; b < (c + 1) * blocksPerChannel; b++) {
+	    validPages[b] = eraseCount[b] = 0;
+	    erased[b] = TRUE;
+	    freeBlocks[c]->Append(b);
+	}
+	writeBlock[c] = -1;
+	writePage[c] = FlashBlockPages;	// so the first program opens one
+	busyUntil[c] = busyTicks[c] = 0;
+    }
+    for (int s = 0; s < NumSectors; s++) {
+	map[s] = -1;
+	Program(s % FlashChannels, s);
+    }
+    lastSector = 0;
+    hostReads = hostWrites = programs = gcCopies = erases = 0;
+}
+
+FlashModel::~FlashModel()
+{
+    for (int c = 0; c < FlashChannels; c++)
+	delete freeBlocks[c];
+    delete [] map;
+    delete [] owner;
+    delete [] validPages;
+    delete [] eraseCount;
+    delete [] erased;
+}
+
+//----------------------------------------------------------------------
+// FlashModel::Request
+// 	Return how long a request for "count" sectors from "sector" will
+//	take.  Each sector is read or written on its own channel, after
+//	whatever that channel is already doing; the request is done when
+//	the last of them is.
+//----------------------------------------------------------------------
+
+int
+FlashModel::Request(int sector, int count, bool writing)
+{
+    int now = kernel->stats->totalTicks;
+    int done = now;
+
+    for (int s = sector; s < sector + count; s++) {
+	int channel = s % FlashChannels;
+	int ticks;
+
+	if (writing) {
+	    ticks = Write(s);
+	} else {
+	    ticks = FlashReadTime;
+	    hostReads++;
+	}
+	busyUntil[channel] = max(busyUntil[channel], now) + ticks;
+	busyTicks[channel] += ticks;
+	done = max(done, busyUntil[channel]);
+    }
+    lastSector = sector + count - 1;
+    DEBUG(dbgDisk, "Flash request latency = " << done - now);
+    return done - now;
+}
+
+//----------------------------------------------------------------------
+// FlashModel::Write
+// 	Write "sector" into the next erased page of its channel, and
+//	return how long that takes the channel.  If the channel's block
+//	is full and only the one erased block kept back for collecting
+//	is left, garbage collect first, for as long as it takes to have
+//	a page to write into.
+//----------------------------------------------------------------------
+
+int
+FlashModel::Write(int sector)
+{
+    int channel = sector % FlashChannels;
+    int ticks = FlashProgramTime;
+
+    Invalidate(sector);			// needn't be copied, if collected
+    while (writePage[channel] == FlashBlockPages) {
+	if (freeBlocks[channel]->NumInList() > 1) {
+	    Open(channel);
+	    break;
+	}
+	ticks += Collect(channel);
+    }
+    Program(channel, sector);
+    hostWrites++;
+    return ticks;
+}
+
+//----------------------------------------------------------------------
+// FlashModel::Invalidate
+// 	The page holding "sector", if it is in one, no longer does.
+//----------------------------------------------------------------------
+
+void
+FlashModel::Invalidate(int sector)
+{
+    int page = map[sector];
+
+    if (page == -1)
+	return;
+    owner[page] = -1;
+    validPages[page / FlashBlockPages]--;
+    map[sector] = -1;
+}
+
+//----------------------------------------------------------------------
+// FlashModel::Program
+// 	Put "sector" in the next page of "channel"'s block, starting an
+//	erased block if that one is full.
+//----------------------------------------------------------------------
+
+void
+FlashModel::Program(int channel, int sector)
+{
+    int page;
+
+    if (writePage[channel] == FlashBlockPages)
+	Open(channel);
+    page = writeBlock[channel] * FlashBlockPages + writePage[channel]++;
+    ASSERT(owner[page] == -1 && map[sector] == -1);
+    owner[page] = sector;
+    map[sector] = page;
+    validPages[writeBlock[channel]]++;
+    programs++;
+}
+
+//----------------------------------------------------------------------
+// FlashModel::Open
+// 	Take an erased block off "channel"'s free list, to program.
+//----------------------------------------------------------------------
+
+void
+FlashModel::Open(int channel)
+{
+    ASSERT(!freeBlocks[channel]->IsEmpty());
+    writeBlock[channel] = freeBlocks[channel]->RemoveFront();
+    erased[writeBlock[channel]] = FALSE;
+    writePage[channel] = 0;
+}
+
+//----------------------------------------------------------------------
+// FlashModel::Collect
+// 	Garbage collect the block of "channel" with the fewest valid
+//	pages: copy each of them into the channel's next page, erase the
+//	block, and put it on the free list.  Returns how long that takes
+//	the channel.
+//
+//	Called only when the channel's block is full, so it can be the
+//	one chosen too, and with one erased block left to copy into.
+//	The channel's sectors fill at least a block fewer than the rest
+//	of its blocks, so one of them has an invalid page, and the
+//	copies fit.
+//----------------------------------------------------------------------
+
+int
+FlashModel::Collect(int channel)
+{
+    int victim = -1, ticks = 0;
+
+    for (int b = channel * blocksPerChannel;
+		b < (channel + 1) * blocksPerChannel; b++)
+	if (!erased[b] && (victim == -1 || validPages[b] < validPages[victim]))
+	    victim = b;
+    ASSERT(victim != -1 && validPages[victim] < FlashBlockPages);
+    DEBUG(dbgDisk, "Flash collecting block " << victim << ", "
+		<< validPages[victim] << " valid pages");
+    for (int p = victim * FlashBlockPages;
+		p < (victim + 1) * FlashBlockPages; p++) {
+	int sector = owner[p];
+
+	if (sector == -1)
+	    continue;
+	Invalidate(sector);
+	Program(channel, sector);
+	gcCopies++;
+	ticks += FlashReadTime + FlashProgramTime;
+    }
+    ASSERT(validPages[victim] == 0);
+    eraseCount[victim]++;
+    erases++;
+    erased[victim] = TRUE;
+    freeBlocks[channel]->Append(victim);
+    return ticks + FlashEraseTime;
+}
+
+//----------------------------------------------------------------------
+// FlashModel::PrintStats
+// 	Print what the FTL did: pages read and written by the host and
+//	programmed in all, the copies and erases garbage collection
+//	cost, the write amplification, the wear on the most and least
+//	erased blocks, and how long each channel worked.
+//----------------------------------------------------------------------
+
+void
+FlashModel::PrintStats()
+{
+    int most = 0, fewest = eraseCount[0];
+
+    for (int b = 0; b < numBlocks; b++) {
+	most = max(most, eraseCount[b]);
+	fewest = min(fewest, eraseCount[b]);
+    }
+    cout << "Flash pages: reads " << hostReads << ", writes " << hostWrites
+	 << ", programmed " << programs << " (" << gcCopies
+	 << " copied by garbage collection), blocks erased " << erases
+	 << "\n";
+    cout << "Flash write amplification ";
+    if (hostWrites > 0)
+	cout << (double) programs / hostWrites;
+    else
+	cout << "-";
+    cout << ", erases per block: fewest " << fewest << ", most " << most
+	 << "\n";
+    cout << "Flash channel time (channel: ticks):";
+    for (int c = 0; c < FlashChannels; c++)
+	cout << " " << c << ": " << busyTicks[c];
+    cout << "\n";
+}
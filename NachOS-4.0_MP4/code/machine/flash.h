@@ -0,0 +1,94 @@
+// flash.h
+//	The timing of a solid-state (flash) drive, as a disk model: with
+//	-ssd, each disk is one of these instead of a rotating disk.
+//
+//	Flash is read and programmed (written) a page at a time, here a
+//	sector, but a page can only be programmed once it has been
+//	erased, and erasing is done a whole erase block -- FlashBlockPages
+//	pages -- at a time.  So the drive never overwrites a sector in
+//	place: its flash translation layer (FTL) programs the new data
+//	into the next erased page, and marks the old page invalid.  When
+//	there are no erased blocks to spare, it garbage collects: picks
+//	the block with the fewest valid pages, copies those into erased
+//	pages, and erases the block.  The copies are programs the host
+//	never asked for; programs per page written is the drive's write
+//	amplification.  The drive has some blocks more than its sectors
+//	need (over-provisioning), so there is always a block worth
+//	collecting.
+//
+//	The flash is in FlashChannels channels, which work at the same
+//	time.  Sector s is always on channel s % FlashChannels, so a run
+//	of consecutive sectors is spread over all of them: a request
+//	takes as long as its busiest channel, not the sum.  A read costs
+//	a fixed FlashReadTime, a program FlashProgramTime, and an erase
+//	FlashEraseTime (cf. stats.h); there is no seek, and no rotation.
+//
+//	The FTL's map is not kept in the disk's UNIX file, so each run
+//	starts the drive as if every sector had just been written once,
+//	in order: blocks full of valid pages, and only the spare ones
+//	erased.  That is how a drive that has been in use behaves -- a
+//	fresh one would not garbage collect for a long time.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#ifndef FLASH_H
+#define FLASH_H
+
+#include "copyright.h"
+#include "disk.h"
+#include "list.h"
+
+const int FlashChannels = 4;		// channels working at once
+const int FlashBlockPages = 32;		// pages (sectors) in an erase block
+const int FlashSpareRatio = 8;		// a spare block for each this many
+					// the sectors need (but at least 2 in
+					// each channel)
+
+class FlashModel : public DiskModel {
+  public:
+    FlashModel();			// a drive that has been written once
+    ~FlashModel();
+
+    int Request(int sector, int count, bool writing);
+    int TimeToSeek(int sector, int *rotation)
+	{ *rotation = 0; return 0; }	// every sector is as near as any
+    int HeadSector() { return lastSector; }
+    void PrintStats();			// Print the FTL's work, and how busy
+					// each channel was
+
+  private:
+    int blocksPerChannel;		// erase blocks in each channel
+    int numBlocks;			// and in all; block b is in channel
+					// b / blocksPerChannel
+    int *map;				// the page each sector is in, or -1
+    int *owner;				// the sector in each page, or -1 if
+					// it is erased or invalid
+    int *validPages;			// pages of each block still in use
+    int *eraseCount;			// times each block was erased
+    bool *erased;			// is each block on its channel's
+					// free list?
+    List<int> *freeBlocks[FlashChannels];
+					// each channel's erased blocks
+    int writeBlock[FlashChannels];	// the block each channel is
+    int writePage[FlashChannels];	// programming, and its next page
+    int busyUntil[FlashChannels];	// when each channel is next free
+    int busyTicks[FlashChannels];	// and how long it has worked, in all
+    int lastSector;			// the last sector of the last request
+
+    int hostReads, hostWrites;		// pages the host read and wrote
+    int programs;			// pages programmed, copies included
+    int gcCopies;			// valid pages copied by collection
+    int erases;				// blocks erased
+
+    int Write(int sector);		// write a sector: how long it takes
+					// its channel
+    void Invalidate(int sector);	// the sector's page is out of date
+    void Program(int channel, int sector);
+					// put it in the channel's next page
+    void Open(int channel);		// start programming an erased block
+    int Collect(int channel);		// garbage collect a block
+};
+
+#endif // FLASH_H
@@ -23,6 +23,8 @@
 #include "copyright.h"
 #include "interrupt.h"
 #include "main.h"
+#include "checkpoint.h"
+#include <limits.h>
 
 // String definitions for debugging messages
 
@@ -73,6 +75,7 @@ Interrupt::Interrupt()
 {
     level = IntOff;
     pending = new SortedList<PendingInterrupt *>(PendingCompare);
+    nextDue = INT_MAX;
     inHandler = FALSE;
     yieldOnReturn = FALSE;
     status = SystemMode;
@@ -142,23 +145,43 @@ Interrupt::SetLevel(IntStatus now)
 //
 //	Two things can cause OneTick to be called:
 //		interrupts are re-enabled
-//		a user instruction is executed
+//		a user instruction (or a block of them) is executed
+//
+//	Nothing can be due before "nextDue", so until then this is only
+//	a matter of adding up the time; the interrupt list is checked,
+//	with interrupts off, once something is due.  (Unless interrupt
+//	debugging is on, which traces every check.)
+//
+//	"ticks" -- how many ticks' worth of time to advance; the machine
+//		passes the length of a basic block when running in
+//		block mode (see Machine::Run)
+//
+//	The yield a timer interrupt asks for is done here, and it
+//	re-enables interrupts on its way back, which can land here
+//	again with another time slice over.  A thread that keeps on
+//	yielding would then nest one Yield inside another until its
+//	stack overflowed; instead, the inner call leaves the request
+//	set and the outer one yields again.
 //----------------------------------------------------------------------
 void
-Interrupt::OneTick()
+Interrupt::OneTick(int ticks)
 {
     MachineStatus oldStatus = status;
     Statistics *stats = kernel->stats;
 
 // advance simulated time
     if (status == SystemMode) {
-        stats->totalTicks += SystemTick;
-	stats->systemTicks += SystemTick;
+        stats->totalTicks += SystemTick * ticks;
+	stats->systemTicks += SystemTick * ticks;
     } else {
-	stats->totalTicks += UserTick;
-	stats->userTicks += UserTick;
+	stats->totalTicks += UserTick * ticks;
+	stats->userTicks += UserTick * ticks;
     }
     DEBUG(dbgInt, "== Tick " << stats->totalTicks << " ==");
+    if (kernel->checkpoint != NULL)
+	kernel->checkpoint->Check(stats->totalTicks);
+    if (stats->totalTicks < nextDue && !debug->IsEnabled(dbgInt))
+	return;			// nothing due yet
 
 // check any pending interrupts are now ready to fire
     ChangeLevel(IntOn, IntOff);	// first, turn off interrupts
@@ -166,11 +189,18 @@ Interrupt::OneTick()
 				// interrupts disabled)
     CheckIfDue(FALSE);		// check for pending interrupts
     ChangeLevel(IntOff, IntOn);	// re-enable interrupts
-    if (yieldOnReturn) {	// if the timer device handler asked 
+    if (yieldOnReturn && !kernel->currentThread->tickYield) {
+				// if the timer device handler asked 
     				// for a context switch, ok to do it now
-	yieldOnReturn = FALSE;
+	Thread *thread = kernel->currentThread;
+
  	status = SystemMode;		// yield is a kernel routine
-	kernel->currentThread->Yield();
+	thread->tickYield = TRUE;
+	while (yieldOnReturn) {		// again, if asked for as the
+	    yieldOnReturn = FALSE;	// last one was returning
+	    thread->Yield();
+	}
+	thread->tickYield = FALSE;
 	status = oldStatus;
     }
 }
@@ -242,9 +272,8 @@ Interrupt::Halt()
     cout << "This is halt\n";
     kernel->stats->Print();
 	*/
-	delete debug;
-	
-    delete kernel;	// Never returns.
+    delete kernel;	// Never returns; deletes "debug" too, once
+			// the kernel no longer needs it.
 }
 
 #ifndef FILESYS_STUB
@@ -254,6 +283,12 @@ Interrupt::CreateFile(char *filename, int length)
     return kernel->CreateFile(filename, length);
 }
 
+int
+Interrupt::RemoveFile(char *filename)
+{
+    return kernel->RemoveFile(filename);
+}
+
 int 
 Interrupt::OpenFile(char *filename)
 {
@@ -266,6 +301,12 @@ Interrupt::CloseFile(int id)
 	return kernel->CloseFile(id);
 }
 
+int
+Interrupt::DupFile(int id)
+{
+	return kernel->DupFile(id);
+}
+
 int
 Interrupt::WriteFile(char *buffer, int size, int id)
 {
@@ -277,6 +318,48 @@ Interrupt::ReadFile(char *buffer, int size, int id)
 {
 	return kernel->ReadFile(buffer, size, id);
 }
+
+int
+Interrupt::SeekFile(int position, int id)
+{
+	return kernel->SeekFile(position, id);
+}
+
+int
+Interrupt::WriteFileAt(char *buffer, int size, int position, int id)
+{
+	return kernel->WriteFileAt(buffer, size, position, id);
+}
+
+int
+Interrupt::ReadFileAt(char *buffer, int size, int position, int id)
+{
+	return kernel->ReadFileAt(buffer, size, position, id);
+}
+
+int
+Interrupt::MakePipe(int *ids)
+{
+	return kernel->MakePipe(ids);
+}
+
+int
+Interrupt::SyncFile(int id)
+{
+	return kernel->SyncFile(id);
+}
+
+int
+Interrupt::SyncAll()
+{
+	return kernel->SyncAll();
+}
+
+int
+Interrupt::AdviseFile(int id, int offset, int length, int hint)
+{
+	return kernel->AdviseFile(id, offset, length, hint);
+}
 #endif
 
 //----------------------------------------------------------------------
@@ -304,6 +387,24 @@ Interrupt::Schedule(CallBackObj *toCall, int fromNow, IntType type)
     ASSERT(fromNow > 0);
 
     pending->Insert(toOccur);
+    if (when < nextDue)
+	nextDue = when;
+}
+
+//----------------------------------------------------------------------
+// Interrupt::UpdateNextDue
+// 	Recompute "nextDue" from the list of pending interrupts: the time
+//	the earliest is due, or the largest time there is if none is
+//	pending.  Called whenever interrupts are taken off the list.
+//----------------------------------------------------------------------
+
+void
+Interrupt::UpdateNextDue()
+{
+    if (pending->IsEmpty())
+	nextDue = INT_MAX;
+    else
+	nextDue = pending->Front()->when;
 }
 
 //----------------------------------------------------------------------
@@ -355,6 +456,7 @@ Interrupt::CheckIfDue(bool advanceClock)
     inHandler = TRUE;
     do {
         next = pending->RemoveFront();    // pull interrupt off list
+	UpdateNextDue();
         next->callOnInterrupt->CallBack();// call the interrupt handler
 	delete next;
     } while (!pending->IsEmpty() 
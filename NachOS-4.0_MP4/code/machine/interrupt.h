@@ -97,10 +97,19 @@ class Interrupt {
     void PrintInt(int number);
 	#ifndef FILESYS_STUB
 		int CreateFile(char *filename, int length);
+		int RemoveFile(char *filename);
 		int OpenFile(char *filename);
 		int CloseFile(int id);
+		int DupFile(int id);
 		int WriteFile(char *buffer, int size, int id);
 		int ReadFile(char *buffer, int size, int id);
+		int SeekFile(int position, int id);
+		int WriteFileAt(char *buffer, int size, int position, int id);
+		int ReadFileAt(char *buffer, int size, int position, int id);
+		int MakePipe(int *ids);
+		int SyncFile(int id);
+		int SyncAll();
+		int AdviseFile(int id, int offset, int length, int hint);
 	#endif 
 
     void YieldOnReturn();	// cause a context switch on return 
@@ -123,13 +132,21 @@ class Interrupt {
 				// at time "when".  This is called
     				// by the hardware device simulators.
     
-    void OneTick();       	// Advance simulated time
+    void OneTick(int ticks = 1);
+				// Advance simulated time by "ticks"
+				// instructions' worth
+
+    int NextDue() { return nextDue; }
+				// when the next interrupt is due
 
   private:
     IntStatus level;		// are interrupts enabled or disabled?
     SortedList<PendingInterrupt *> *pending;		
     				// the list of interrupts scheduled
 				// to occur in the future
+    int nextDue;		// when the first of them is due, or
+				// INT_MAX if none is; kept so that
+				// OneTick needn't look at the list
     //int writeFileNo;            //UNIX file emulating the display
     bool inHandler;		// TRUE if we are running an interrupt handler
     //bool putBusy;               // Is a PrintInt operation in progress
@@ -146,6 +163,8 @@ class Interrupt {
 
     void ChangeLevel(IntStatus old, 	// SetLevel, without advancing the
 			IntStatus now); // simulated time
+
+    void UpdateNextDue();	// recompute "nextDue"
 };
 
 #endif // INTERRRUPT_H
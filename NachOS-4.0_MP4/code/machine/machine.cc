@@ -9,6 +9,7 @@
 
 #include "copyright.h"
 #include "machine.h"
+#include "blockcache.h"
 #include "main.h"
 
 // Textual names of the exceptions that can be generated by user program
@@ -50,9 +51,14 @@ void CheckEndian()
 //
 //	"debug" -- if TRUE, drop into the debugger after each user instruction
 //		is executed.
+//	"skew" -- the most user instructions that may run before simulated
+//		time is advanced and pending interrupts are checked (see
+//		Machine::Run).  1 gives the exact, per-instruction timing.
+//	"translate" -- if TRUE, translate user code a block at a time
+//		(see blockcache.h), rather than only interpreting it.
 //----------------------------------------------------------------------
 
-Machine::Machine(bool debug)
+Machine::Machine(bool debug, int skew, bool translate)
 {
     int i;
 
@@ -61,17 +67,32 @@ Machine::Machine(bool debug)
     mainMemory = new char[MemorySize];
     for (i = 0; i < MemorySize; i++)
       	mainMemory[i] = 0;
-#ifdef USE_TLB
-    tlb = new TranslationEntry[TLBSize];
-    for (i = 0; i < TLBSize; i++)
-	tlb[i].valid = FALSE;
-    pageTable = NULL;
-#else	// use linear page table
-    tlb = NULL;
+    decodeCache = new Instruction[MemorySize / 4];
+    decodeValid = new bool[MemorySize / 4];
+    for (i = 0; i < MemorySize / 4; i++) {
+	decodeValid[i] = FALSE;
+	decodeCache[i].trap = FALSE;
+    }
+    if (Config::UseTLB) {
+	tlb = new TranslationEntry[TLBSize];
+	for (i = 0; i < TLBSize; i++)
+	    tlb[i].valid = FALSE;
+    } else {			// use linear page table
+	tlb = NULL;
+    }
     pageTable = NULL;
-#endif
 
+    FlushTranslationCache();
     singleStep = debug;
+    ASSERT(skew >= 1);
+    blockSkew = skew;
+    pendingTicks = 0;
+    numTraps = 0;
+    numBreaks = numWatches = 0;
+    breakHit = resumeAt = watchHit = -1;
+    for (i = 0; i < WatchPageSlots; i++)
+	watchPages[i] = 0;
+    blockCache = translate ? new BlockCache(this) : NULL;
     CheckEndian();
 }
 
@@ -83,6 +104,9 @@ Machine::Machine(bool debug)
 Machine::~Machine()
 {
     delete [] mainMemory;
+    delete [] decodeCache;
+    delete [] decodeValid;
+    delete blockCache;
     if (tlb != NULL)
         delete [] tlb;
 }
@@ -101,6 +125,9 @@ void
 Machine::RaiseException(ExceptionType which, int badVAddr)
 {
     DEBUG(dbgMach, "Exception: " << exceptionNames[which]);
+    numTraps++;
+    ChargePendingTicks();		// the kernel must see the time used
+					// by the instructions before this one
     registers[BadVAddrReg] = badVAddr;
     DelayedLoad(0, 0);			// finish anything in progress
     kernel->interrupt->setStatus(SystemMode);
@@ -115,13 +142,16 @@ Machine::RaiseException(ExceptionType which, int badVAddr)
 //	It could, but you'd have to implement *a lot* more system calls
 //	to get it to work!
 //
-//	So just allow single-stepping, and printing the contents of memory.
+//	So just allow single-stepping, and printing the contents of memory;
+//	and breakpoints and watchpoints, which run at full speed until
+//	they are hit (see SetBreakpoint and SetWatchpoint).
 //----------------------------------------------------------------------
 
 void Machine::Debugger()
 {
     char *buf = new char[80];
-    int num;
+    char *end;
+    int num, addr, size;
     bool done = FALSE;
 
     kernel->interrupt->DumpState();
@@ -146,11 +176,33 @@ void Machine::Debugger()
 	  singleStep = FALSE;
 	  done = TRUE;
 	  break;
+	case 'b':
+	  addr = (int) strtol(buf + 1, &end, 0);
+	  if (end == buf + 1 || !SetBreakpoint(addr))
+	    cout << "Can't set a breakpoint there\n";
+	  break;
+	case 'w':
+	  addr = (int) strtol(buf + 1, &end, 0);
+	  size = (int) strtol(end, NULL, 0);
+	  if (end == buf + 1 || !SetWatchpoint(addr, (size > 0) ? size : 4))
+	    cout << "Can't set a watchpoint there\n";
+	  break;
+	case 'l':
+	  ListTraps();
+	  break;
+	case 'd':
+	  ClearTraps();
+	  break;
 	case '?':
 	  cout << "Machine commands:\n";
 	  cout << "    <return>  execute one instruction\n";
 	  cout << "    <number>  run until the given timer tick\n";
-	  cout << "    c         run until completion\n";
+	  cout << "    c         run until completion, or a breakpoint\n";
+	  cout << "    b <addr>  stop before the instruction at <addr>\n";
+	  cout << "    w <addr> [<size>]\n";
+	  cout << "              stop after a store into <size> (4) bytes at <addr>\n";
+	  cout << "    l         list breakpoints and watchpoints\n";
+	  cout << "    d         delete them all\n";
 	  cout << "    ?         print help message\n";
 	  break;
 	default:
@@ -165,6 +217,213 @@ void Machine::Debugger()
     delete [] buf;
 }
  
+//----------------------------------------------------------------------
+// Machine::SetBreakpoint
+// 	Drop into the debugger each time the instruction at virtual
+//	address "addr" is about to run.  Return FALSE if "addr" isn't an
+//	instruction address, or there are MaxBreakpoints already.
+//
+//	A breakpoint costs nothing until it is near: the decode cache has
+//	a trap flag on every word that might be one, which OneInstruction
+//	tests as it fetches the word, and only then compares the PC with
+//	the breakpoints.  Since the cache is by physical address, and a
+//	page may be anywhere, the flag is set on the word at the same
+//	offset in every page; so the breakpoints hold whatever the page
+//	table or TLB, and need no updating when either changes.
+//----------------------------------------------------------------------
+
+bool
+Machine::SetBreakpoint(int addr)
+{
+    if ((addr & 0x3) || addr < 0 || numBreaks == MaxBreakpoints)
+	return FALSE;
+    breakAddr[numBreaks++] = addr;
+    MarkTraps(addr % PageSize);
+    DEBUG(dbgMach, "Breakpoint " << numBreaks << " at " << addr);
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// Machine::SetWatchpoint
+// 	Drop into the debugger each time a user instruction stores into
+//	any of "size" bytes of virtual memory starting at "addr".  Return
+//	FALSE if there are MaxWatchpoints already.
+//
+//	Pages are write-protected, in effect: Translate counts the
+//	watchpoints on each page in watchPages, and only a store to a
+//	page with some is checked against them.  The store is done, and
+//	then the debugger is invoked, with what was there before.  Writes
+//	the kernel makes straight into mainMemory, such as a system
+//	call's, are not seen.
+//----------------------------------------------------------------------
+
+bool
+Machine::SetWatchpoint(int addr, int size)
+{
+    if (addr < 0 || size <= 0 || numWatches == MaxWatchpoints)
+	return FALSE;
+    watchAddr[numWatches] = addr;
+    watchSize[numWatches] = size;
+    numWatches++;
+    for (int vpn = addr / PageSize; vpn <= (addr + size - 1) / PageSize;
+	    vpn++) {
+	ASSERT(watchPages[vpn % WatchPageSlots] < 255);
+	watchPages[vpn % WatchPageSlots]++;
+    }
+    DEBUG(dbgMach, "Watchpoint " << numWatches << " at " << addr << ", "
+		<< size << " bytes");
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// Machine::ClearTraps
+// 	Forget every breakpoint and watchpoint.
+//----------------------------------------------------------------------
+
+void
+Machine::ClearTraps()
+{
+    int offsets[MaxBreakpoints];
+    int n = numBreaks;
+
+    for (int i = 0; i < n; i++)
+	offsets[i] = breakAddr[i] % PageSize;
+    numBreaks = numWatches = 0;
+    breakHit = resumeAt = watchHit = -1;
+    for (int i = 0; i < n; i++)
+	MarkTraps(offsets[i]);
+    for (int i = 0; i < WatchPageSlots; i++)
+	watchPages[i] = 0;
+}
+
+//----------------------------------------------------------------------
+// Machine::MarkTraps
+// 	Set the trap flag of the word at "offset" in every page of the
+//	decode cache, if any breakpoint is at that offset in its page,
+//	and clear it if none is.  The flag outlasts the word's decoded
+//	form, so it holds when the word is decoded again.
+//----------------------------------------------------------------------
+
+void
+Machine::MarkTraps(int offset)
+{
+    bool trap = FALSE;
+
+    for (int i = 0; i < numBreaks; i++)
+	if (breakAddr[i] % PageSize == offset)
+	    trap = TRUE;
+    for (int page = 0; page < NumPhysPages; page++)
+	decodeCache[(page * PageSize + offset) / 4].trap = trap;
+}
+
+//----------------------------------------------------------------------
+// Machine::AtBreakpoint
+// 	Called by OneInstruction when the word it fetched has its trap
+//	flag set.  If the PC is at a breakpoint -- other than the one
+//	just stopped at, which is let run once -- note it, count it as a
+//	trap so that RunToDeadline stops, and return TRUE: the
+//	instruction is not to run yet.
+//----------------------------------------------------------------------
+
+bool
+Machine::AtBreakpoint()
+{
+    int pc = registers[PCReg];
+
+    if (pc == resumeAt) {
+	resumeAt = -1;
+	return FALSE;
+    }
+    for (int i = 0; i < numBreaks; i++) {
+	if (breakAddr[i] == pc) {
+	    breakHit = i;
+	    numTraps++;
+	    return TRUE;
+	}
+    }
+    return FALSE;
+}
+
+//----------------------------------------------------------------------
+// Machine::CheckWatch
+// 	Called by Translate for a store of "size" bytes to virtual address
+//	"virtAddr" (physical "physAddr"), on a page with watchpoints.  If
+//	it touches one, note it and what was there, and count it as a
+//	trap, so that the debugger is invoked once the instruction is
+//	done.
+//----------------------------------------------------------------------
+
+void
+Machine::CheckWatch(int virtAddr, int size, int physAddr)
+{
+    for (int i = 0; i < numWatches; i++) {
+	if (virtAddr < watchAddr[i] + watchSize[i]
+		&& watchAddr[i] < virtAddr + size) {
+	    watchHit = i;
+	    watchVAddr = virtAddr;
+	    watchPhys = physAddr;
+	    watchLen = size;
+	    switch (size) {
+	      case 1: watchOld = MemoryToHost<1>(&mainMemory[physAddr]); break;
+	      case 2: watchOld = MemoryToHost<2>(&mainMemory[physAddr]); break;
+	      default: watchOld = MemoryToHost<4>(&mainMemory[physAddr]); break;
+	    }
+	    numTraps++;
+	    return;
+	}
+    }
+}
+
+//----------------------------------------------------------------------
+// Machine::Stopped
+// 	A breakpoint or watchpoint has been hit: say which, and invoke
+//	the debugger, which keeps single-stepping until told to continue.
+//	Simulated time is charged as if nothing had stopped.
+//----------------------------------------------------------------------
+
+void
+Machine::Stopped()
+{
+    if (breakHit != -1) {
+	cout << "Breakpoint " << breakHit + 1 << " at PC " << registers[PCReg]
+	     << "\n";
+	resumeAt = registers[PCReg];
+	breakHit = -1;
+    }
+    if (watchHit != -1) {
+	int now;
+
+	switch (watchLen) {
+	  case 1: now = MemoryToHost<1>(&mainMemory[watchPhys]); break;
+	  case 2: now = MemoryToHost<2>(&mainMemory[watchPhys]); break;
+	  default: now = MemoryToHost<4>(&mainMemory[watchPhys]); break;
+	}
+	cout << "Watchpoint " << watchHit + 1 << ": " << watchLen
+	     << " bytes at " << watchVAddr << " were " << watchOld
+	     << ", now " << now << " (PC " << registers[PrevPCReg] << ")\n";
+	watchHit = -1;
+    }
+    singleStep = TRUE;
+    runUntilTime = 0;
+    Debugger();
+}
+
+//----------------------------------------------------------------------
+// Machine::ListTraps
+// 	Print the breakpoints and watchpoints, numbered as Stopped
+//	names them.
+//----------------------------------------------------------------------
+
+void
+Machine::ListTraps()
+{
+    for (int i = 0; i < numBreaks; i++)
+	cout << "Breakpoint " << i + 1 << ": PC " << breakAddr[i] << "\n";
+    for (int i = 0; i < numWatches; i++)
+	cout << "Watchpoint " << i + 1 << ": " << watchSize[i] << " bytes at "
+	     << watchAddr[i] << "\n";
+}
+
 //----------------------------------------------------------------------
 // Machine::DumpState
 // 	Print the user program's CPU state.  We might print the contents
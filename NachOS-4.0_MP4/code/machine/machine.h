@@ -23,11 +23,13 @@
 
 #include "copyright.h"
 #include "utility.h"
+#include "debug.h"
 #include "translate.h"
+#include "config.h"
 
 // Definitions related to the size, and format of user memory
 
-const int PageSize = 128; 		// set the page size equal to
+const int PageSize = Config::PageSize; 	// set the page size equal to
 					// the disk sector size, for simplicity
 
 //
@@ -35,10 +37,17 @@ const int PageSize = 128; 		// set the page size equal to
 // Doing so will change the number of pages of physical memory
 // available on the simulated machine.
 //
-const int NumPhysPages = 128;
+const int NumPhysPages = Config::NumPhysPages;
 
 const int MemorySize = (NumPhysPages * PageSize);
-const int TLBSize = 4;			// if there is a TLB, make it small
+const int TLBSize = Config::TLBSize;	// if there is a TLB, make it small
+const int XlateCacheSize = 16;		// host-side cache of recent
+					// translations (see Translate);
+					// must be a power of two
+const int MaxBreakpoints = 16;		// PCs the debugger can stop at
+const int MaxWatchpoints = 8;		// and ranges of memory it can watch
+const int WatchPageSlots = 64;		// watched pages are counted in
+					// slots by virtual page # mod this
 
 enum ExceptionType { NoException,           // Everything ok!
 		     SyscallException,      // A program executed a system call.
@@ -88,12 +97,41 @@ enum ExceptionType { NoException,           // Everything ok!
 // The procedures in this class are defined in machine.cc, mipssim.cc, and
 // translate.cc.
 
-class Instruction;
+// The following class defines an instruction, represented in both
+// 	undecoded binary form
+//      decoded to identify
+//	    operation to do
+//	    registers to act on
+//	    any immediate operand value
+//
+// It lives here, rather than in mipssim.cc, so that the machine can
+// keep a cache of already-decoded instructions (see OneInstruction).
+
+class Instruction {
+  public:
+    void Decode();	// decode the binary representation of the instruction
+
+    unsigned int value; // binary representation of the instruction
+
+    char opCode;     // Type of instruction.  This is NOT the same as the
+    		     // opcode field from the instruction: see defs in mips.h
+    char rs, rt, rd; // Three registers from instruction.
+    int extra;       // Immediate or target or shamt field or offset.
+                     // Immediates are sign-extended.
+    bool loadHazard; // For a load, TRUE unless the word after it is
+		     // known not to use the register it loads (see
+		     // Machine::OneInstruction)
+    bool trap;       // In the decode cache, might there be a
+		     // breakpoint here?  (see Machine::SetBreakpoint)
+};
+
 class Interrupt;
+class BlockCache;
 
 class Machine {
   public:
-    Machine(bool debug);	// Initialize the simulation of the hardware
+    Machine(bool debug, int skew = 1, bool translate = FALSE);
+				// Initialize the simulation of the hardware
 				// for running user programs
     ~Machine();			// De-allocate the data structures
 
@@ -134,6 +172,9 @@ class Machine {
 
     TranslationEntry *tlb;		// this pointer should be considered 
 					// "read-only" to Nachos kernel code
+    bool HasTLB() { return Config::UseTLB && tlb != NULL; }
+					// known at compile time, on a
+					// build without a TLB
 
     TranslationEntry *pageTable;
     unsigned int pageTableSize;
@@ -143,6 +184,32 @@ class Machine {
     				// Read or write 1, 2, or 4 bytes of virtual 
 				// memory (at addr).  Return FALSE if a 
 				// correct translation couldn't be found.
+    template <int size> bool ReadMem(int addr, int* value);
+    template <int size> bool WriteMem(int addr, int value);
+				// The same, for a size known when
+				// compiling; inline, with no switch on
+				// the size (see the end of this file)
+
+    void InvalidateDecodeCache(int physAddr, int size);
+				// Forget any pre-decoded instructions in
+				// "size" bytes of physical memory at
+				// "physAddr".  Must be called by kernel
+				// code that writes into mainMemory
+				// directly (e.g., when loading a program)
+
+    void FlushTranslationCache();
+				// Forget all cached translations.  Must be
+				// called whenever pageTable or tlb is
+				// switched to another address space
+
+    bool SetBreakpoint(int addr);
+				// Drop into the debugger before running
+				// the instruction at virtual address
+				// "addr"; FALSE if there are too many
+    bool SetWatchpoint(int addr, int size);
+				// And after any store into "size" bytes
+				// of virtual memory at "addr"
+    void ClearTraps();		// Forget every breakpoint and watchpoint
   private:
 
 // Routines internal to the machine simulation -- DO NOT call these directly
@@ -151,6 +218,14 @@ class Machine {
 
     void OneInstruction(Instruction *instr); 	
     				// Run one instruction of a user program.
+
+    void ChargePendingTicks();	// Advance simulated time for the user
+				// instructions run since the last check
+    void RunToDeadline(Instruction *instr);
+				// Run user instructions up to the next
+				// interrupt, without checking for it
+    bool LoadHazard(int physAddr);
+				// Must the load at "physAddr" be delayed?
     
 
 
@@ -167,6 +242,16 @@ class Machine {
 
     void Debugger();		// invoke the user program debugger
     void DumpState();		// print the user CPU and memory state 
+    bool AtBreakpoint();	// is the instruction about to run at a
+				// breakpoint? if so, stop before it
+    void CheckWatch(int virtAddr, int size, int physAddr);
+				// stop after a store into a watched page,
+				// if it touches what is watched
+    void Stopped();		// a breakpoint or watchpoint was hit:
+				// say so, and invoke the debugger
+    void MarkTraps(int offset);	// set the decode cache's trap flags for
+				// the words at "offset" in every page
+    void ListTraps();		// print the breakpoints and watchpoints
 
 
 // Internal data structures
@@ -177,8 +262,42 @@ class Machine {
 				// simulated instruction
     int runUntilTime;		// drop back into the debugger when simulated
 				// time reaches this value
+    int breakAddr[MaxBreakpoints];	// PCs to stop at
+    int numBreaks;
+    int breakHit;		// the one stopped at, or -1
+    int resumeAt;		// PC of a breakpoint stopped at, to be
+				// run past once, or -1
+    int watchAddr[MaxWatchpoints];	// virtual memory watched for
+    int watchSize[MaxWatchpoints];	// stores
+    int numWatches;
+    unsigned char watchPages[WatchPageSlots];
+				// watchpoints on the pages in each slot
+    int watchHit;		// the one a store touched, or -1
+    int watchVAddr, watchPhys;	// where the store was
+    int watchLen;		// how many bytes it stored
+    int watchOld;		// and what was there before
+
+    int xlateVpn[XlateCacheSize];	// virtual page cached in each slot,
+					// or -1 if the slot is empty
+    TranslationEntry *xlateEntry[XlateCacheSize];
+					// page table/TLB entry for that page
+
+    int blockSkew;		// run up to this many instructions of a
+				// basic block between interrupt checks
+    int pendingTicks;		// instructions not yet charged to the clock
+    int numTraps;		// exceptions raised so far, so a run of
+				// instructions can tell it trapped
+
+    Instruction *decodeCache;	// one pre-decoded instruction for every
+				// word of physical memory
+    bool *decodeValid;		// is the matching decodeCache entry
+				// up to date with mainMemory?
+
+    BlockCache *blockCache;	// translated blocks of user code, or
+				// NULL to only interpret it
 
     friend class Interrupt;		// calls DelayedLoad()    
+    friend class BlockCache;		// runs the user program
 };
 
 extern void ExceptionHandler(ExceptionType which);
@@ -198,9 +317,117 @@ extern void ExceptionHandler(ExceptionType which);
 //	simulated machine byte ordering:
 //	   contents of main memory
 
-unsigned int WordToHost(unsigned int word);
-unsigned short ShortToHost(unsigned short shortword);
-unsigned int WordToMachine(unsigned int word);
-unsigned short ShortToMachine(unsigned short shortword);
+//
+// They are inline, and which version is compiled is chosen by
+// HOST_IS_BIG_ENDIAN, so on a little endian host they cost nothing.
+
+inline unsigned int
+WordToHost(unsigned int word) {
+#ifdef HOST_IS_BIG_ENDIAN
+	 register unsigned long result;
+	 result = (word >> 24) & 0x000000ff;
+	 result |= (word >> 8) & 0x0000ff00;
+	 result |= (word << 8) & 0x00ff0000;
+	 result |= (word << 24) & 0xff000000;
+	 return result;
+#else 
+	 return word;
+#endif /* HOST_IS_BIG_ENDIAN */
+}
+
+inline unsigned short
+ShortToHost(unsigned short shortword) {
+#ifdef HOST_IS_BIG_ENDIAN
+	 register unsigned short result;
+	 result = (shortword << 8) & 0xff00;
+	 result |= (shortword >> 8) & 0x00ff;
+	 return result;
+#else 
+	 return shortword;
+#endif /* HOST_IS_BIG_ENDIAN */
+}
+
+inline unsigned int
+WordToMachine(unsigned int word) { return WordToHost(word); }
+
+inline unsigned short
+ShortToMachine(unsigned short shortword) { return ShortToHost(shortword); }
+
+// Routines to load and store "size" bytes of main memory, in host
+// format, for Machine::ReadMem<size> and WriteMem<size>.  The address
+// has been checked for alignment (by Translate), so each one is a
+// single aligned load or store, plus the byte swap if there is one.
+// They copy with memcpy, which compiles to just that, since reading
+// chars through a wider pointer breaks the aliasing rules -O relies on.
+
+template <int size> int MemoryToHost(char *where);
+template <int size> void HostToMemory(char *where, int value);
+
+template <> inline int
+MemoryToHost<1>(char *where) { return *where; }
+
+template <> inline int
+MemoryToHost<2>(char *where)
+{ unsigned short h; memcpy(&h, where, sizeof(h)); return ShortToHost(h); }
+
+template <> inline int
+MemoryToHost<4>(char *where)
+{ unsigned int w; memcpy(&w, where, sizeof(w)); return WordToHost(w); }
+
+template <> inline void
+HostToMemory<1>(char *where, int value)
+{ *where = (unsigned char) (value & 0xff); }
+
+template <> inline void
+HostToMemory<2>(char *where, int value)
+{ unsigned short h = ShortToMachine((unsigned short) (value & 0xffff));
+  memcpy(where, &h, sizeof(h)); }
+
+template <> inline void
+HostToMemory<4>(char *where, int value)
+{ unsigned int w = WordToMachine((unsigned int) value);
+  memcpy(where, &w, sizeof(w)); }
+
+//----------------------------------------------------------------------
+// Machine::ReadMem<size>, Machine::WriteMem<size>
+//	Read or write "size" (1, 2, or 4) bytes of virtual memory at
+//	"addr", as ReadMem and WriteMem do.  Returns FALSE if the
+//	translation raised an exception.
+//----------------------------------------------------------------------
+
+template <int size> inline bool
+Machine::ReadMem(int addr, int *value)
+{
+    int physicalAddress;
+    ExceptionType exception;
+
+    DEBUG(dbgAddr, "Reading VA " << addr << ", size " << size);
+    exception = Translate(addr, &physicalAddress, size, FALSE);
+    if (exception != NoException) {
+	RaiseException(exception, addr);
+	return FALSE;
+    }
+    *value = MemoryToHost<size>(&mainMemory[physicalAddress]);
+    DEBUG(dbgAddr, "\tvalue read = " << *value);
+    return TRUE;
+}
+
+template <int size> inline bool
+Machine::WriteMem(int addr, int value)
+{
+    int physicalAddress;
+    ExceptionType exception;
+
+    DEBUG(dbgAddr, "Writing VA " << addr << ", size " << size << ", value "
+	  << value);
+    exception = Translate(addr, &physicalAddress, size, TRUE);
+    if (exception != NoException) {
+	RaiseException(exception, addr);
+	return FALSE;
+    }
+    HostToMemory<size>(&mainMemory[physicalAddress], value);
+    InvalidateDecodeCache(physicalAddress, size);
+    return TRUE;
+}
 
 #endif // MACHINE_H
@@ -20,29 +20,13 @@
 #include "debug.h"
 #include "machine.h"
 #include "mipssim.h"
+#include "blockcache.h"
 #include "main.h"
 
-static void Mult(int a, int b, bool signedArith, int* hiPtr, int* loPtr);
-
-// The following class defines an instruction, represented in both
-// 	undecoded binary form
-//      decoded to identify
-//	    operation to do
-//	    registers to act on
-//	    any immediate operand value
-
-class Instruction {
-  public:
-    void Decode();	// decode the binary representation of the instruction
-
-    unsigned int value; // binary representation of the instruction
-
-    char opCode;     // Type of instruction.  This is NOT the same as the
-    		     // opcode field from the instruction: see defs in mips.h
-    char rs, rt, rd; // Three registers from instruction.
-    int extra;       // Immediate or target or shamt field or offset.
-                     // Immediates are sign-extended.
-};
+static bool EndsBlock(char opCode);
+static const int RunQuantum = 1000;	// most instructions run between
+					// interrupt checks, when none is due
+static bool UsesReg(Instruction *instr, int reg);
 
 //----------------------------------------------------------------------
 // Machine::Run
@@ -51,6 +35,22 @@ class Instruction {
 //
 //	This routine is re-entrant, in that it can be called multiple
 //	times concurrently -- one for each thread executing user code.
+//
+//	With a block skew greater than 1, simulated time is advanced once
+//	per basic block (ending at a branch, a jump, an exception, or after
+//	"blockSkew" instructions) rather than once per instruction, so
+//	interrupts fire at most blockSkew - 1 ticks late.
+//
+//	Otherwise, the instructions until the next interrupt is due are
+//	run in one go (see RunToDeadline), which is just as exact.  Only
+//	single-stepping, or tracing the machine, goes an instruction at a
+//	time.
+//
+//	With a block cache, straight-line code is run from translated
+//	blocks instead, with the same effect as a block skew of 1; the
+//	interpreter runs whatever a block can't.  Not while there are
+//	breakpoints or watchpoints, which only the interpreter checks;
+//	when one is hit, the debugger is invoked (see Machine::Stopped).
 //----------------------------------------------------------------------
 
 void
@@ -64,14 +64,106 @@ Machine::Run()
     }
     kernel->interrupt->setStatus(UserMode);
     for (;;) {
+	if (breakHit != -1 || watchHit != -1) {
+	    Stopped();
+	    continue;
+	}
+	if (blockCache != NULL && numBreaks + numWatches == 0
+		&& blockCache->Run())
+	    continue;		// ran a translated block instead
+	if (blockSkew == 1 && !singleStep && !debug->IsEnabled('m')) {
+	    RunToDeadline(instr);
+	    continue;
+	}
         OneInstruction(instr);
-		kernel->interrupt->OneTick();
+		if (breakHit != -1)
+			continue;	// it didn't run, so takes no time
+		if (blockSkew == 1) {
+			kernel->interrupt->OneTick();
+		} else {
+			pendingTicks++;
+			if (EndsBlock(instr->opCode) || pendingTicks >= blockSkew)
+				ChargePendingTicks();
+		}
 		if (singleStep && (runUntilTime <= kernel->stats->totalTicks))
 	  		Debugger();
     }
 }
 
 
+//----------------------------------------------------------------------
+// EndsBlock
+// 	Return TRUE if "opCode" can transfer control, and so ends a
+//	straight-line basic block.
+//----------------------------------------------------------------------
+
+static bool
+EndsBlock(char opCode)
+{
+    switch (opCode) {
+      case OP_BEQ: case OP_BGEZ: case OP_BGEZAL: case OP_BGTZ:
+      case OP_BLEZ: case OP_BLTZ: case OP_BLTZAL: case OP_BNE:
+      case OP_J: case OP_JAL: case OP_JALR: case OP_JR:
+      case OP_SYSCALL:
+	return TRUE;
+      default:
+	return FALSE;
+    }
+}
+
+//----------------------------------------------------------------------
+// Machine::ChargePendingTicks
+// 	Advance simulated time for the user instructions run since it was
+//	last advanced, and let any interrupts that came due in the
+//	meantime fire.  A no-op when there is nothing outstanding.
+//----------------------------------------------------------------------
+
+void
+Machine::ChargePendingTicks()
+{
+    int ticks = pendingTicks;
+
+    if (ticks == 0)
+	return;
+    pendingTicks = 0;		// clear first: OneTick may context switch
+    kernel->interrupt->OneTick(ticks);
+}
+
+//----------------------------------------------------------------------
+// Machine::RunToDeadline
+// 	Run user instructions until the next interrupt is due (at most
+//	RunQuantum of them), and then advance the clock for all of them
+//	at once.  No interrupt can fire in between, so this is the same
+//	as advancing it after each one, only faster.
+//
+//	Stops early after an exception: the kernel may have scheduled an
+//	interrupt, or run other threads, and the deadline is out of date.
+//	(If something is due now, this runs one instruction then lets the
+//	interrupt fire, as interleaving them would.)
+//----------------------------------------------------------------------
+
+void
+Machine::RunToDeadline(Instruction *instr)
+{
+    int ahead = kernel->interrupt->NextDue() - kernel->stats->totalTicks;
+    int traps = numTraps;
+    int budget, i;
+
+    if (ahead > RunQuantum * UserTick)
+	ahead = RunQuantum * UserTick;
+    budget = (ahead + UserTick - 1) / UserTick;	// instructions until due
+    if (budget < 1)
+	budget = 1;
+    for (i = 0; i < budget && numTraps == traps; i++) {
+	OneInstruction(instr);
+	pendingTicks++;		// after: an exception charges the ones
+				// before it, then runs the kernel
+    }
+    if (breakHit != -1)
+	pendingTicks--;		// stopped before it ran
+    ChargePendingTicks();
+}
+
 //----------------------------------------------------------------------
 // TypeToReg
 // 	Retrieve the register # referred to in an instruction. 
@@ -124,16 +216,30 @@ Machine::OneInstruction(Instruction *instr)
     int byte;       // described in Kane for LWL,LWR,...
 #endif
 
-    int raw;
     int nextLoadReg = 0; 	
     int nextLoadValue = 0; 	// record delayed load operation, to apply
 				// in the future
 
-    // Fetch instruction 
-    if (!ReadMem(registers[PCReg], 4, &raw))
+    // Fetch instruction.  We still translate the PC on every
+    // instruction, so the use bits and any page/TLB faults behave as
+    // before, but the memory read and the decode are skipped whenever
+    // the physical word has already been decoded.
+    int physAddr;
+    ExceptionType exception = Translate(registers[PCReg], &physAddr, 4, FALSE);
+    if (exception != NoException) {
+	RaiseException(exception, registers[PCReg]);
 	return;			// exception occurred
-    instr->value = raw;
-    instr->Decode();
+    }
+    int word = physAddr / 4;
+    if (!decodeValid[word]) {
+	decodeCache[word].value = MemoryToHost<4>(&mainMemory[physAddr]);
+	decodeCache[word].Decode();
+	decodeCache[word].loadHazard = LoadHazard(physAddr);
+	decodeValid[word] = TRUE;
+    }
+    *instr = decodeCache[word];
+    if (instr->trap && AtBreakpoint())
+	return;			// stop before it runs
 
     if (debug->IsEnabled('m')) {
         struct OpString *str = &opStrings[instr->opCode];
@@ -263,7 +369,7 @@ Machine::OneInstruction(Instruction *instr)
       case OP_LB:
       case OP_LBU:
 	tmp = registers[instr->rs] + instr->extra;
-	if (!ReadMem(tmp, 1, &value))
+	if (!ReadMem<1>(tmp, &value))
 	    return;
 
 	if ((value & 0x80) && (instr->opCode == OP_LB))
@@ -281,7 +387,7 @@ Machine::OneInstruction(Instruction *instr)
 	    RaiseException(AddressErrorException, tmp);
 	    return;
 	}
-	if (!ReadMem(tmp, 2, &value))
+	if (!ReadMem<2>(tmp, &value))
 	    return;
 
 	if ((value & 0x8000) && (instr->opCode == OP_LH))
@@ -303,7 +409,7 @@ Machine::OneInstruction(Instruction *instr)
 	    RaiseException(AddressErrorException, tmp);
 	    return;
 	}
-	if (!ReadMem(tmp, 4, &value))
+	if (!ReadMem<4>(tmp, &value))
 	    return;
 	nextLoadReg = instr->rt;
 	nextLoadValue = value;
@@ -323,7 +429,7 @@ Machine::OneInstruction(Instruction *instr)
         byte = tmp & 0x3;
         // DEBUG('P', "Addr 0x%X\n",tmp-byte);
 
-        if (!ReadMem(tmp-byte, 4, &value))
+        if (!ReadMem<4>(tmp-byte, &value))
             return;
 #else
 	// ReadMem assumes all 4 byte requests are aligned on an even 
@@ -331,7 +437,7 @@ Machine::OneInstruction(Instruction *instr)
         // fail (I think) if the other cases are ever exercised.
 	ASSERT((tmp & 0x3) == 0);  
 
-	if (!ReadMem(tmp, 4, &value))
+	if (!ReadMem<4>(tmp, &value))
 	    return;
 #endif
 
@@ -375,7 +481,7 @@ Machine::OneInstruction(Instruction *instr)
         byte = tmp & 0x3;
         // DEBUG('P', "Addr 0x%X\n",tmp-byte);
 
-        if (!ReadMem(tmp-byte, 4, &value))
+        if (!ReadMem<4>(tmp-byte, &value))
             return;
 #else
 	// ReadMem assumes all 4 byte requests are aligned on an even 
@@ -383,7 +489,7 @@ Machine::OneInstruction(Instruction *instr)
         // fail (I think) if the other cases are ever exercised.
 	ASSERT((tmp & 0x3) == 0);  
 
-	if (!ReadMem(tmp, 4, &value))
+	if (!ReadMem<4>(tmp, &value))
 	    return;
 #endif
 
@@ -456,14 +562,16 @@ Machine::OneInstruction(Instruction *instr)
 	break;
 	
       case OP_SB:
-	if (!WriteMem((unsigned) 
-		(registers[instr->rs] + instr->extra), 1, registers[instr->rt]))
+	if (!WriteMem<1>((unsigned)
+		(registers[(int) instr->rs] + instr->extra),
+		registers[(int) instr->rt]))
 	    return;
 	break;
 	
       case OP_SH:
-	if (!WriteMem((unsigned) 
-		(registers[instr->rs] + instr->extra), 2, registers[instr->rt]))
+	if (!WriteMem<2>((unsigned)
+		(registers[(int) instr->rs] + instr->extra),
+		registers[(int) instr->rt]))
 	    return;
 	break;
 	
@@ -544,8 +652,9 @@ Machine::OneInstruction(Instruction *instr)
 	break;
 	
       case OP_SW:
-	if (!WriteMem((unsigned) 
-		(registers[instr->rs] + instr->extra), 4, registers[instr->rt]))
+	if (!WriteMem<4>((unsigned)
+		(registers[(int) instr->rs] + instr->extra),
+		registers[(int) instr->rt]))
 	    return;
 	break;
 	
@@ -561,7 +670,7 @@ Machine::OneInstruction(Instruction *instr)
 
         byte = tmp & 0x3;
         // DEBUG('P', "Addr 0x%X\n",tmp-byte);
-        if (!ReadMem(tmp-byte, 4, &value))
+        if (!ReadMem<4>(tmp-byte, &value))
             return;
 
         // DEBUG('P', "Value 0x%X\n",value);
@@ -571,7 +680,7 @@ Machine::OneInstruction(Instruction *instr)
         // fail (I think) if the other cases are ever exercised.
 	ASSERT((tmp & 0x3) == 0);  
 
-	if (!ReadMem((tmp & ~0x3), 4, &value))
+	if (!ReadMem<4>((tmp & ~0x3), &value))
 	    return;
 #endif
 
@@ -598,12 +707,12 @@ Machine::OneInstruction(Instruction *instr)
 	    break;
 	}
 #ifndef SIM_FIX
-        if (!WriteMem((tmp & ~0x3), 4, value))
+        if (!WriteMem<4>((tmp & ~0x3), value))
             return;
 #else
         // DEBUG('P', "Value 0x%X\n",value);
 
-        if (!WriteMem((tmp - byte), 4, value))
+        if (!WriteMem<4>((tmp - byte), value))
             return;
 #endif // SIM_FIX
 	break;
@@ -616,7 +725,7 @@ Machine::OneInstruction(Instruction *instr)
         // fail (I think) if the other cases are ever exercised.
         ASSERT((tmp & 0x3) == 0);  
 
-        if (!ReadMem((tmp & ~0x3), 4, &value))
+        if (!ReadMem<4>((tmp & ~0x3), &value))
             return;
 #else
         // The only difference between this code and the BIG ENDIAN code
@@ -629,7 +738,7 @@ Machine::OneInstruction(Instruction *instr)
         byte = tmp & 0x3;
         // DEBUG('P', "Addr 0x%X\n",tmp-byte);
 
-        if (!ReadMem(tmp-byte, 4, &value))
+        if (!ReadMem<4>(tmp-byte, &value))
             return;
         // DEBUG('P', "Value 0x%X\n",value);
 #endif // SIM_FIX
@@ -655,12 +764,12 @@ Machine::OneInstruction(Instruction *instr)
 	}
 
 #ifndef SIM_FIX
-        if (!WriteMem((tmp & ~0x3), 4, value))
+        if (!WriteMem<4>((tmp & ~0x3), value))
             return;
 #else
         // DEBUG('P', "Value 0x%X\n",value);
 
-        if (!WriteMem((tmp - byte), 4, value))
+        if (!WriteMem<4>((tmp - byte), value))
             return;
 #endif // SIM_FIX
 
@@ -690,8 +799,16 @@ Machine::OneInstruction(Instruction *instr)
     
     // Now we have successfully executed the instruction.
     
-    // Do any delayed load operation
-    DelayedLoad(nextLoadReg, nextLoadValue);
+    // Do any delayed load operation.  A load whose delay slot is the
+    // next word, and doesn't use the register loaded, can't be told
+    // from one that takes effect at once -- so it does, and the
+    // instruction after it has no delayed load to finish.
+    if (nextLoadReg != 0 && !instr->loadHazard && !singleStep
+		&& registers[NextPCReg] == registers[PCReg] + 4) {
+	DelayedLoad(0, 0);
+	registers[nextLoadReg] = nextLoadValue;
+    } else
+	DelayedLoad(nextLoadReg, nextLoadValue);
     
     // Advance program counters.
     registers[PrevPCReg] = registers[PCReg];	// for debugging, in case we
@@ -717,6 +834,79 @@ Machine::DelayedLoad(int nextReg, int nextValue)
     registers[0] = 0; 	// and always make sure R0 stays zero.
 }
 
+//----------------------------------------------------------------------
+// Machine::InvalidateDecodeCache
+// 	Throw away the pre-decoded form of every instruction word that
+//	overlaps "size" bytes of physical memory starting at "physAddr",
+//	so the next fetch from there re-reads and decodes mainMemory.
+//	Called by WriteMem, and by any kernel code that stores into
+//	mainMemory behind the simulator's back.
+//----------------------------------------------------------------------
+
+void
+Machine::InvalidateDecodeCache(int physAddr, int size)
+{
+    ASSERT((physAddr >= 0) && ((physAddr + size) <= MemorySize));
+
+    int first = physAddr / 4;
+
+    if (first > 0)
+	first--;		// its load hazard depends on this word
+    for (int word = first; word <= (physAddr + size - 1) / 4; word++)
+	decodeValid[word] = FALSE;
+    if (blockCache != NULL)
+	blockCache->Invalidate(physAddr, size);
+}
+
+//----------------------------------------------------------------------
+// Machine::LoadHazard
+// 	Return TRUE unless the instruction at "physAddr" is a load whose
+//	target register the next word in memory neither reads nor
+//	writes.  (Only the next word of the same page is known here; and
+//	LWL and LWR merge with the pending load, so they always need it.)
+//----------------------------------------------------------------------
+
+bool
+Machine::LoadHazard(int physAddr)
+{
+    Instruction *instr = &decodeCache[physAddr / 4];
+    Instruction next;
+
+    switch (instr->opCode) {
+      case OP_LB: case OP_LBU: case OP_LH: case OP_LHU: case OP_LW:
+	break;
+      default:
+	return TRUE;
+    }
+    if ((physAddr + 4) % PageSize == 0)
+	return TRUE;		// the next word may not come next
+    next.value = MemoryToHost<4>(&mainMemory[physAddr + 4]);
+    next.Decode();
+    return UsesReg(&next, instr->rt);
+}
+
+//----------------------------------------------------------------------
+// UsesReg
+// 	Return TRUE if "instr" might read or write register "reg".  Errs
+//	on the side of TRUE: every register field counts, whatever the
+//	format, and a trap might look at any register.
+//----------------------------------------------------------------------
+
+static bool
+UsesReg(Instruction *instr, int reg)
+{
+    switch (instr->opCode) {
+      case OP_SYSCALL: case OP_RES: case OP_UNIMP:
+      case OP_LWL: case OP_LWR:
+	return TRUE;
+      case OP_JAL: case OP_BGEZAL: case OP_BLTZAL:
+	if (reg == R31)
+	    return TRUE;
+	break;
+    }
+    return (reg == instr->rs) || (reg == instr->rt) || (reg == instr->rd);
+}
+
 //----------------------------------------------------------------------
 // Instruction::Decode
 // 	Decode a MIPS instruction 
@@ -768,7 +958,7 @@ Instruction::Decode()
 // 	double-length result of the multiplication.
 //----------------------------------------------------------------------
 
-static void
+void
 Mult(int a, int b, bool signedArith, int* hiPtr, int* loPtr)
 {
     if ((a == 0) || (b == 0)) {
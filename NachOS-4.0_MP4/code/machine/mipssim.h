@@ -96,6 +96,12 @@
 #define SIGN_BIT	0x80000000
 #define R31		31
 
+// Multiply, as MULT and MULTU do (shared with blockcache.cc)
+
+extern void Mult(int a, int b, bool signedArith, int* hiPtr, int* loPtr);
+
+#ifndef OPCODES_ONLY	// blockcache.cc needs only the definitions above
+
 /*
  * The table below is used to translate bits 31:26 of the instruction
  * into a value suitable for the "opCode" field of a MemWord structure,
@@ -226,4 +232,6 @@ static struct OpString opStrings[] = {
 	{"Reserved", {NONE, NONE, NONE}}
       };
 
+#endif // OPCODES_ONLY
+
 #endif // MIPSSIM_H
@@ -11,6 +11,7 @@
 #include "copyright.h"
 #include "network.h"
 #include "main.h"
+#include "memops.h"
 
 //-----------------------------------------------------------------------
 // NetworkInput::NetworkInput
@@ -75,7 +76,7 @@ NetworkInput::CallBack()
     // divide packet into header and data
     inHdr = *(PacketHeader *)buffer;
     ASSERT((inHdr.to == kernel->hostName) && (inHdr.length <= MaxPacketSize));
-    bcopy(buffer + sizeof(PacketHeader), inbox, inHdr.length);
+    MemCopy(inbox, buffer + sizeof(PacketHeader), inHdr.length);
     delete [] buffer ;
 
     DEBUG(dbgNet, "Network received packet from " << inHdr.from << ", length " << inHdr.length);
@@ -97,7 +98,7 @@ NetworkInput::Receive(char* data)
 
     inHdr.length = 0;
     if (hdr.length != 0) {
-    	bcopy(inbox, data, hdr.length);
+    	MemCopy(data, inbox, hdr.length);
     }
     return hdr;
 }
@@ -176,7 +177,7 @@ NetworkOutput::Send(PacketHeader hdr, char* data)
     // concatenate hdr and data into a single buffer, and send it out
     char *buffer = new char[MaxWireSize];
     *(PacketHeader *)buffer = hdr;
-    bcopy(data, buffer + sizeof(PacketHeader), hdr.length);
+    MemCopy(buffer + sizeof(PacketHeader), data, hdr.length);
     SendToSocket(sock, buffer, MaxWireSize, toName);
     delete [] buffer;
 }
@@ -10,6 +10,7 @@
 #include "copyright.h"
 #include "debug.h"
 #include "stats.h"
+#include "handle.h"
 
 //----------------------------------------------------------------------
 // Statistics::Statistics
@@ -22,6 +23,59 @@ Statistics::Statistics()
     numDiskReads = numDiskWrites = 0;
     numConsoleCharsRead = numConsoleCharsWritten = 0;
     numPageFaults = numPacketsSent = numPacketsRecvd = 0;
+    numContextSwitches = 0;
+    bzero((char *) syscalls, sizeof(syscalls));
+}
+
+//----------------------------------------------------------------------
+// Statistics::Syscalls
+// 	Return the counter of system call "type" made by thread
+//	"threadID", or NULL if the code is out of range.
+//----------------------------------------------------------------------
+
+SyscallCounter *
+Statistics::Syscalls(int threadID, int type)
+{
+    if (type < 0 || type >= NumSyscallCodes)
+	return NULL;
+    threadID = HandleSlot(threadID);	// thread IDs are handles
+    if (threadID >= MaxStatThreads)
+	threadID = MaxStatThreads - 1;
+    return &syscalls[threadID][type];
+}
+
+//----------------------------------------------------------------------
+// Statistics::StartSyscall
+// 	Count a call of system call "type" by thread "threadID".  It is
+//	counted on entry, as Exit and Halt never return.
+//----------------------------------------------------------------------
+
+void
+Statistics::StartSyscall(int threadID, int type)
+{
+    SyscallCounter *c = Syscalls(threadID, type);
+
+    if (c != NULL)
+	c->count++;
+}
+
+//----------------------------------------------------------------------
+// Statistics::EndSyscall
+// 	A system call counted by StartSyscall has returned, after
+//	"ticks" of simulated time, having read or written "bytes".
+//----------------------------------------------------------------------
+
+void
+Statistics::EndSyscall(int threadID, int type, int ticks, int bytes)
+{
+    SyscallCounter *c = Syscalls(threadID, type);
+
+    if (c == NULL)
+	return;
+    c->ticks += ticks;
+    if (ticks > c->maxTicks)
+	c->maxTicks = ticks;
+    c->bytes += bytes;
 }
 
 //----------------------------------------------------------------------
@@ -40,6 +94,52 @@ Statistics::Print()
 		cout << "Console I/O: reads " << numConsoleCharsRead;
     cout << ", writes " << numConsoleCharsWritten << "\n";
     cout << "Paging: faults " << numPageFaults << "\n";
+    cout << "Context switches: " << numContextSwitches << "\n";
     cout << "Network I/O: packets received " << numPacketsRecvd;
 		cout << ", sent " << numPacketsSent << "\n";
+    for (int t = 0; t < MaxStatThreads; t++) {
+	for (int type = 0; type < NumSyscallCodes; type++) {
+	    SyscallCounter *c = &syscalls[t][type];
+
+	    if (c->count == 0)
+		continue;
+	    cout << "Syscall " << type << ", thread " << t
+		 << (t == MaxStatThreads - 1 ? " and up" : "")
+		 << ": calls " << c->count << ", ticks " << c->ticks
+		 << " (max " << c->maxTicks << "), bytes " << c->bytes << "\n";
+	}
+    }
+}
+
+//----------------------------------------------------------------------
+// Statistics::PrintBench
+// 	Print the metrics a benchmark run is judged by, as one line of
+//	"key=value" fields after the word "bench", so that a script can
+//	pick it out of the rest of the output and compare it with other
+//	builds:
+//
+//	    bench name=<name> wall_sec=<host seconds> ticks=<total ticks>
+//		instructions=<user instructions> instr_per_sec=<per host
+//		second> switches=<context switches> switches_per_sec=...
+//		sector_ios=<disk reads + writes> sector_ios_per_sec=...
+//
+//	"name" labels the run
+//	"seconds" is how long it took on the host
+//----------------------------------------------------------------------
+
+void
+Statistics::PrintBench(char *name, double seconds)
+{
+    int sectorIOs = numDiskReads + numDiskWrites;
+
+    if (seconds <= 0)
+	seconds = 1e-6;			// too quick to measure
+    cout << "bench name=" << name << " wall_sec=" << seconds
+	 << " ticks=" << totalTicks
+	 << " instructions=" << userTicks
+	 << " instr_per_sec=" << (long) (userTicks / seconds)
+	 << " switches=" << numContextSwitches
+	 << " switches_per_sec=" << (long) (numContextSwitches / seconds)
+	 << " sector_ios=" << sectorIOs
+	 << " sector_ios_per_sec=" << (long) (sectorIOs / seconds) << "\n";
 }
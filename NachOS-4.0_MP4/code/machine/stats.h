@@ -13,6 +13,20 @@
 
 #include "copyright.h"
 
+// The use one thread has made of one system call
+
+class SyscallCounter {
+  public:
+    int count;			// calls made
+    int ticks;			// simulated time spent in them, in all
+    int maxTicks;		// in the longest one
+    int bytes;			// bytes read or written by them
+};
+
+const int NumSyscallCodes = 43;	// system call codes counted (up to SC_Add)
+const int MaxStatThreads = 16;	// thread ID slots counted apart; higher
+				// ones are counted with the last
+
 // The following class defines the statistics that are to be kept
 // about Nachos behavior -- how much time (ticks) elapsed, how
 // many user instructions executed, etc.
@@ -35,10 +49,27 @@ class Statistics {
     int numPageFaults;		// number of virtual memory page faults
     int numPacketsSent;		// number of packets sent over the network
     int numPacketsRecvd;	// number of packets received over the network
+    int numContextSwitches;	// number of times a thread was switched in
+
+    SyscallCounter syscalls[MaxStatThreads][NumSyscallCodes];
+				// the system calls of each thread ID
 
     Statistics(); 		// initialize everything to zero
 
+    void StartSyscall(int threadID, int type);
+				// count system call "type", on entry (some
+				// never return)
+    void EndSyscall(int threadID, int type, int ticks, int bytes);
+				// it took "ticks", moving "bytes"
+    SyscallCounter *Syscalls(int threadID, int type);
+				// the counter for "type" and the thread,
+				// or NULL if "type" isn't counted
+
     void Print();		// print collected statistics
+    void PrintBench(char *name, double seconds);
+				// print them, and the rates they were
+				// simulated at in "seconds" of host time,
+				// on one line
 };
 
 // Constants used to reflect the relative time an operation would
@@ -53,6 +84,9 @@ const int UserTick = 	   1;	// advance for each user-level instruction
 const int SystemTick =	  10; 	// advance each time interrupts are enabled
 const int RotationTime = 500; 	// time disk takes to rotate one sector
 const int SeekTime =	 500;  	// time disk takes to seek past one track
+const int FlashReadTime =  50;	// time flash takes to read one page
+const int FlashProgramTime = 300; // to program (write) one
+const int FlashEraseTime = 2000; // and to erase a block of them
 const int ConsoleTime =	 100;	// time to read or write one character
 const int NetworkTime =	 100;  	// time to send or receive one packet
 const int TimerTicks = 	 100;  	// (average) time between timer interrupts
@@ -32,43 +32,6 @@
 #include "copyright.h"
 #include "main.h"
 
-// Routines for converting Words and Short Words to and from the
-// simulated machine's format of little endian.  These end up
-// being NOPs when the host machine is also little endian (DEC and Intel).
-
-unsigned int
-WordToHost(unsigned int word) {
-#ifdef HOST_IS_BIG_ENDIAN
-	 register unsigned long result;
-	 result = (word >> 24) & 0x000000ff;
-	 result |= (word >> 8) & 0x0000ff00;
-	 result |= (word << 8) & 0x00ff0000;
-	 result |= (word << 24) & 0xff000000;
-	 return result;
-#else 
-	 return word;
-#endif /* HOST_IS_BIG_ENDIAN */
-}
-
-unsigned short
-ShortToHost(unsigned short shortword) {
-#ifdef HOST_IS_BIG_ENDIAN
-	 register unsigned short result;
-	 result = (shortword << 8) & 0xff00;
-	 result |= (shortword >> 8) & 0x00ff;
-	 return result;
-#else 
-	 return shortword;
-#endif /* HOST_IS_BIG_ENDIAN */
-}
-
-unsigned int
-WordToMachine(unsigned int word) { return WordToHost(word); }
-
-unsigned short
-ShortToMachine(unsigned short shortword) { return ShortToHost(shortword); }
-
-
 //----------------------------------------------------------------------
 // Machine::ReadMem
 //      Read "size" (1, 2, or 4) bytes of virtual memory at "addr" into 
@@ -85,38 +48,16 @@ ShortToMachine(unsigned short shortword) { return ShortToHost(shortword); }
 bool
 Machine::ReadMem(int addr, int size, int *value)
 {
-    int data;
-    ExceptionType exception;
-    int physicalAddress;
-    
-    DEBUG(dbgAddr, "Reading VA " << addr << ", size " << size);
-    
-    exception = Translate(addr, &physicalAddress, size, FALSE);
-    if (exception != NoException) {
-	RaiseException(exception, addr);
-	return FALSE;
-    }
     switch (size) {
       case 1:
-	data = mainMemory[physicalAddress];
-	*value = data;
-	break;
-	
+	return ReadMem<1>(addr, value);
       case 2:
-	data = *(unsigned short *) &mainMemory[physicalAddress];
-	*value = ShortToHost(data);
-	break;
-	
+	return ReadMem<2>(addr, value);
       case 4:
-	data = *(unsigned int *) &mainMemory[physicalAddress];
-	*value = WordToHost(data);
-	break;
-
+	return ReadMem<4>(addr, value);
       default: ASSERT(FALSE);
     }
-    
-    DEBUG(dbgAddr, "\tvalue read = " << *value);
-    return (TRUE);
+    return FALSE;
 }
 
 //----------------------------------------------------------------------
@@ -135,35 +76,16 @@ Machine::ReadMem(int addr, int size, int *value)
 bool
 Machine::WriteMem(int addr, int size, int value)
 {
-    ExceptionType exception;
-    int physicalAddress;
-     
-    DEBUG(dbgAddr, "Writing VA " << addr << ", size " << size << ", value " << value);
-
-    exception = Translate(addr, &physicalAddress, size, TRUE);
-    if (exception != NoException) {
-	RaiseException(exception, addr);
-	return FALSE;
-    }
     switch (size) {
       case 1:
-	mainMemory[physicalAddress] = (unsigned char) (value & 0xff);
-	break;
-
+	return WriteMem<1>(addr, value);
       case 2:
-	*(unsigned short *) &mainMemory[physicalAddress]
-		= ShortToMachine((unsigned short) (value & 0xffff));
-	break;
-      
+	return WriteMem<2>(addr, value);
       case 4:
-	*(unsigned int *) &mainMemory[physicalAddress]
-		= WordToMachine((unsigned int) value);
-	break;
-	
+	return WriteMem<4>(addr, value);
       default: ASSERT(FALSE);
     }
-    
-    return TRUE;
+    return FALSE;
 }
 
 //----------------------------------------------------------------------
@@ -175,6 +97,14 @@ Machine::WriteMem(int addr, int size, int value)
 //	address in "physAddr".  If there was an error, returns the type
 //	of the exception.
 //
+//	The last translation made for each of XlateCacheSize slots (picked
+//	by the low bits of the virtual page #) is remembered, so repeated
+//	references to the same page skip the page table bounds check or
+//	the TLB search.  The cached entry is still re-checked for validity,
+//	so the kernel may change the contents of the page table or TLB at
+//	any time; it must only call FlushTranslationCache when it points
+//	the machine at a different table.
+//
 //	"virtAddr" -- the virtual address to translate
 //	"physAddr" -- the place to store the physical address
 //	"size" -- the amount of memory being read or written
@@ -205,7 +135,12 @@ Machine::Translate(int virtAddr, int* physAddr, int size, bool writing)
     vpn = (unsigned) virtAddr / PageSize;
     offset = (unsigned) virtAddr % PageSize;
     
-    if (tlb == NULL) {		// => page table => vpn is index into table
+    int slot = vpn & (XlateCacheSize - 1);
+    entry = xlateEntry[slot];
+    if (xlateVpn[slot] == (int) vpn && entry->valid
+			&& (!HasTLB() || entry->virtualPage == (int) vpn)) {
+	;				// cache hit, entry is still good
+    } else if (!HasTLB()) {		// => page table => vpn is index into table
 	if (vpn >= pageTableSize) {
 	    DEBUG(dbgAddr, "Illegal virtual page # " << virtAddr);
 	    return AddressErrorException;
@@ -227,6 +162,8 @@ Machine::Translate(int virtAddr, int* physAddr, int size, bool writing)
 						// but not in the TLB
 	}
     }
+    xlateVpn[slot] = vpn;
+    xlateEntry[slot] = entry;
 
     if (entry->readOnly && writing) {	// trying to write to a read-only page
 	DEBUG(dbgAddr, "Write to read-only page at " << virtAddr);
@@ -246,5 +183,22 @@ Machine::Translate(int virtAddr, int* physAddr, int size, bool writing)
     *physAddr = pageFrame * PageSize + offset;
     ASSERT((*physAddr >= 0) && ((*physAddr + size) <= MemorySize));
     DEBUG(dbgAddr, "phys addr = " << *physAddr);
+    if (writing && watchPages[vpn % WatchPageSlots] > 0)
+	CheckWatch(virtAddr, size, *physAddr);	// a page being watched
     return NoException;
 }
+
+//----------------------------------------------------------------------
+// Machine::FlushTranslationCache
+// 	Empty the cache of recent translations used by Translate, because
+//	the page table or TLB now belongs to a different address space.
+//----------------------------------------------------------------------
+
+void
+Machine::FlushTranslationCache()
+{
+    for (int i = 0; i < XlateCacheSize; i++) {
+	xlateVpn[i] = -1;
+	xlateEntry[i] = NULL;
+    }
+}
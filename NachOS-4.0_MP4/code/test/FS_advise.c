@@ -0,0 +1,36 @@
+#include "syscall.h"
+
+/* Read a file back under each access hint, and check that the data
+ * is the same whatever the kernel was told, and that Advise refuses
+ * bad hints and what isn't an open file.
+ */
+
+int main(void)
+{
+	char buf[1024], back[1024];
+	OpenFileId fid;
+	int i, hint;
+
+	for (i = 0; i < 1024; i++)
+		buf[i] = i * 7;
+	if (Create("/file1", 0) != 1) MSG("Failed on creating file");
+	fid = Open("/file1");
+	if (fid <= 0) MSG("Failed on opening file");
+	if (Write(buf, 1024, fid) != 1024) MSG("Failed on writing file");
+	for (hint = AdviseNormal; hint <= AdviseDontNeed; hint++) {
+		if (Advise(fid, 0, 0, hint) != 0) MSG("Failed on Advise");
+		if (Seek(0, fid) != 1) MSG("Failed on seeking file");
+		for (i = 0; i < 1024; i += 128)
+			if (Read(back + i, 128, fid) != 128)
+				MSG("Failed on reading file");
+		for (i = 0; i < 1024; i++)
+			if (back[i] != buf[i]) MSG("Read back the wrong data");
+	}
+	if (Advise(fid, 512, 256, AdviseDontNeed) != 0) MSG("Failed on Advise");
+	if (Advise(fid, 0, 0, 99) != -1) MSG("Advise took a bad hint");
+	if (Advise(fid, -1, 0, AdviseWillNeed) != -1) MSG("Advise took a bad offset");
+	if (Advise(SysConsoleOutput, 0, 0, AdviseRandom) != -1) MSG("Advise took the console");
+	if (Close(fid) != 1) MSG("Failed on closing file");
+	if (Advise(fid, 0, 0, AdviseSequential) != -1) MSG("Advise took a closed file");
+	Halt();
+}
@@ -0,0 +1,50 @@
+#include "syscall.h"
+
+/* Write a file with several asynchronous requests in flight at once,
+ * computing while they go, then read it back the same way.
+ */
+
+#define Pieces	4
+#define Piece	256
+
+char out[Pieces][Piece], in[Pieces][Piece];
+
+int main(void)
+{
+	OpenFileId fid;
+	int aio[Pieces];
+	int i, j, sum;
+
+	for (i = 0; i < Pieces; i++)
+		for (j = 0; j < Piece; j++)
+			out[i][j] = 'A' + (i + j) % 26;
+	if (Create("/file1", Pieces * Piece) != 1) MSG("Failed on creating file");
+	fid = Open("/file1");
+	if (fid <= 0) MSG("Failed on opening file");
+
+	for (i = 0; i < Pieces; i++) {
+		aio[i] = AioWrite(out[i], Piece, i * Piece, fid);
+		if (aio[i] < 0) MSG("Failed on starting a write");
+	}
+	sum = 0;
+	while (AioPoll(aio[Pieces - 1]) == 0)
+		for (j = 0; j < 100; j++)
+			sum += j;	/* compute while the disk works */
+	for (i = 0; i < Pieces; i++)
+		if (AioWait(aio[i]) != Piece) MSG("A write was short");
+	if (AioWait(aio[0]) != -1) MSG("Waited twice for a request");
+	if (AioPoll(aio[0]) != -1) MSG("Polled a finished request");
+
+	for (i = 0; i < Pieces; i++) {
+		aio[i] = AioRead(in[i], Piece, i * Piece, fid);
+		if (aio[i] < 0) MSG("Failed on starting a read");
+	}
+	if (Close(fid) != 1) MSG("Failed on closing file");	/* the reads go on */
+	for (i = Pieces - 1; i >= 0; i--)
+		if (AioWait(aio[i]) != Piece) MSG("A read was short");
+	for (i = 0; i < Pieces; i++)
+		for (j = 0; j < Piece; j++)
+			if (in[i][j] != out[i][j]) MSG("Read back the wrong data");
+	if (AioRead(in[0], Piece, 0, fid) != -1) MSG("Read a closed file");
+	Halt();
+}
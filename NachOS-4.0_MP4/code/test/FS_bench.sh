@@ -0,0 +1,55 @@
+# File system microbenchmarks.  Each program prints a line for each
+# thing it times (see fsbench.h):
+#
+#	fsbench <name> ops <n> ticks/op <t> reads <r> writes <w>
+#
+#	FS_bench_create	creating, filling and deleting small files
+#	FS_bench_seq	sequential writes and reads, at several I/O sizes
+#	FS_bench_rand	random 128-byte reads
+#	FS_bench_path	opening a file at the root, and 9 levels down
+#	FS_bench_sort	an external merge sort of a num_*.txt file: making
+#			the sorted runs, then each merge pass
+#
+# Each runs on a freshly formatted disk.  Any arguments are passed on to
+# nachos, to compare file system settings, for example
+#
+#	sh FS_bench.sh -fp track
+#	sh FS_bench.sh -wt
+#
+# The sort's input is $SORT_INPUT, num_3000.txt by default.  Its runs
+# and output take as much room again, so the larger files need a
+# larger disk.
+#
+# Run from this directory, after building nachos and the programs
+# ("make fsbench" here builds the programs).
+
+NACHOS=${NACHOS:-../build.linux/nachos}
+SORT_INPUT=${SORT_INPUT:-num_3000.txt}
+
+for prog in FS_bench_create FS_bench_seq FS_bench_rand FS_bench_path \
+	FS_bench_sort
+do
+	if [ ! -f $prog ]
+	then
+		echo "FS_bench.sh: $prog is not built, skipping it" 1>&2
+		continue
+	fi
+	$NACHOS -f -cp $prog /$prog > /dev/null
+	if [ $prog = FS_bench_path ]
+	then
+		rm -f fsbench.batch
+		dir=
+		for d in d1 d2 d3 d4 d5 d6 d7 d8
+		do
+			dir=$dir/$d
+			echo "-mkdir $dir" >> fsbench.batch
+		done
+		$NACHOS -b fsbench.batch > /dev/null
+		rm -f fsbench.batch
+	fi
+	if [ $prog = FS_bench_sort ]
+	then
+		$NACHOS -cp $SORT_INPUT /numbers > /dev/null
+	fi
+	$NACHOS "$@" -e /$prog | grep "^fsbench "
+done
@@ -0,0 +1,48 @@
+#include "fsbench.h"
+
+/* Create-storm: create NumFiles small files in one directory, fill
+ * each with a sector, then delete them all, timing each phase.
+ */
+
+#define NumFiles	32
+#define FileSize	128
+
+static char data[FileSize];
+
+static void
+Name(char *name, int i)
+{
+  sprintf(name, "/storm%d", i);
+}
+
+int main(void)
+{
+  char name[20];
+  OpenFileId fid;
+  int i;
+
+  BenchStart();
+  for (i = 0; i < NumFiles; i++) {
+    Name(name, i);
+    if (Create(name, 0) != 1) MSG("Failed on creating file");
+  }
+  BenchReport("create", NumFiles);
+
+  BenchStart();
+  for (i = 0; i < NumFiles; i++) {
+    Name(name, i);
+    fid = Open(name);
+    if (fid <= 0) MSG("Failed on opening file");
+    if (Write(data, FileSize, fid) != FileSize) MSG("Failed on writing file");
+    if (Close(fid) != 1) MSG("Failed on closing file");
+  }
+  BenchReport("fill", NumFiles);
+
+  BenchStart();
+  for (i = 0; i < NumFiles; i++) {
+    Name(name, i);
+    if (Remove(name) != 1) MSG("Failed on removing file");
+  }
+  BenchReport("delete", NumFiles);
+  BenchDone();
+}
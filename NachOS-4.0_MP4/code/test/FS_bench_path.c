@@ -0,0 +1,34 @@
+#include "fsbench.h"
+
+/* Path lookup: open and close a file at the root, and one Depth
+ * directories down, NumOpens times each, timing each.  FS_bench.sh
+ * makes the directories /d1, /d1/d2, ... first.
+ */
+
+#define NumOpens	50
+
+static char *shallow = "/shallow";
+static char *deep = "/d1/d2/d3/d4/d5/d6/d7/d8/deep";
+
+static void
+Opens(char *name, char *what)
+{
+  OpenFileId fid;
+  int i;
+
+  if (Create(name, 0) != 1) MSG("Failed on creating file");
+  BenchStart();
+  for (i = 0; i < NumOpens; i++) {
+    fid = Open(name);
+    if (fid <= 0) MSG("Failed on opening file");
+    if (Close(fid) != 1) MSG("Failed on closing file");
+  }
+  BenchReport(what, NumOpens);
+}
+
+int main(void)
+{
+  Opens(shallow, "open-depth1");
+  Opens(deep, "open-depth9");
+  BenchDone();
+}
@@ -0,0 +1,39 @@
+#include "fsbench.h"
+
+/* Random reads: fill a FileSize-byte file, then read NumReads 128-byte
+ * pieces of it, each at a random sector, timing the reads.  The file
+ * is bigger than the buffer cache, so most reads miss.
+ */
+
+#define FileSize	32768
+#define ReadSize	128
+#define NumReads	200
+
+static char buf[2048];
+
+int main(void)
+{
+  unsigned int seed = 1;
+  OpenFileId fid;
+  int i, position;
+
+  if (Create("/rand", FileSize) != 1) MSG("Failed on creating file");
+  fid = Open("/rand");
+  if (fid <= 0) MSG("Failed on opening file");
+  for (i = 0; i < FileSize; i += sizeof(buf))
+    if (Write(buf, sizeof(buf), fid) != sizeof(buf))
+      MSG("Failed on writing file");
+  Sync();				/* start with nothing dirty */
+
+  BenchStart();
+  for (i = 0; i < NumReads; i++) {
+    seed = seed * 1103515245 + 12345;	/* the C library's rand */
+    position = ((seed >> 16) % (FileSize / ReadSize)) * ReadSize;
+    if (PRead(buf, ReadSize, position, fid) != ReadSize)
+      MSG("Failed on reading file");
+  }
+  BenchReport("randread128", NumReads);
+
+  if (Close(fid) != 1) MSG("Failed on closing file");
+  BenchDone();
+}
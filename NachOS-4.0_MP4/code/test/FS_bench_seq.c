@@ -0,0 +1,42 @@
+#include "fsbench.h"
+
+/* Sequential I/O: write a FileSize-byte file from start to end, then
+ * read it back, at each I/O size in turn, timing each pass.
+ */
+
+#define FileSize	32768
+#define NumSizes	5
+
+static int sizes[NumSizes] = { 16, 128, 512, 1024, 4096 };
+static char buf[4096];	/* memory is only 16KB */
+
+int main(void)
+{
+  char name[20];
+  OpenFileId fid;
+  int s, size, i;
+
+  for (s = 0; s < NumSizes; s++) {
+    size = sizes[s];
+    if (Create("/seq", FileSize) != 1) MSG("Failed on creating file");
+    fid = Open("/seq");
+    if (fid <= 0) MSG("Failed on opening file");
+
+    BenchStart();
+    for (i = 0; i < FileSize; i += size)
+      if (Write(buf, size, fid) != size) MSG("Failed on writing file");
+    sprintf(name, "seqwrite%d", size);
+    BenchReport(name, FileSize / size);
+
+    if (Seek(0, fid) != 1) MSG("Failed on Seek");
+    BenchStart();
+    for (i = 0; i < FileSize; i += size)
+      if (Read(buf, size, fid) != size) MSG("Failed on reading file");
+    sprintf(name, "seqread%d", size);
+    BenchReport(name, FileSize / size);
+
+    if (Close(fid) != 1) MSG("Failed on closing file");
+    if (Remove("/seq") != 1) MSG("Failed on removing file");
+  }
+  BenchDone();
+}
@@ -0,0 +1,180 @@
+#include "fsbench.h"
+
+/* External merge sort: sort the numbers in /numbers, a copy of one of
+ * the num_*.txt files, far more than fit in memory.
+ *
+ * First the input is read RunSize numbers at a time; each batch is
+ * sorted in memory and spilled to a run file, /run<n>, as binary ints.
+ * Then the runs are merged MergeWays at a time into longer runs, the
+ * merged ones removed, until one is left: /sorted.  Each pass is timed,
+ * and the output is checked to be in order with nothing lost.
+ *
+ * A merge reads MergeWays streams and writes one, and libnachos has
+ * room for 6 besides stdin and stdout; memory is only 16KB.
+ */
+
+#define RunSize		256	/* numbers sorted in memory at once */
+#define MergeWays	4	/* runs merged at once */
+#define MaxRuns		128
+
+static int numbers[RunSize];
+
+/* Read the next number from "f" into *n; return 0 at the end */
+static int
+ReadNumber(FILE *f, int *n)
+{
+  int c;
+
+  do {
+    c = fgetc(f);
+  } while (c == ' ' || c == '\n' || c == '\t' || c == '\r');
+  if (c < '0' || c > '9')
+    return 0;
+  *n = 0;
+  for (; c >= '0' && c <= '9'; c = fgetc(f))
+    *n = *n * 10 + (c - '0');
+  return 1;
+}
+
+/* Sift a[i] down the heap a[0..n-1], largest at the top */
+static void
+SiftDown(int *a, int i, int n)
+{
+  int child, t;
+
+  for (; (child = 2 * i + 1) < n; i = child) {
+    if (child + 1 < n && a[child + 1] > a[child])
+      child++;
+    if (a[i] >= a[child])
+      break;
+    t = a[i]; a[i] = a[child]; a[child] = t;
+  }
+}
+
+/* Sort a[0..n-1] into increasing order, in place */
+static void
+HeapSort(int *a, int n)
+{
+  int i, t;
+
+  for (i = n / 2 - 1; i >= 0; i--)
+    SiftDown(a, i, n);
+  for (i = n - 1; i > 0; i--) {
+    t = a[0]; a[0] = a[i]; a[i] = t;
+    SiftDown(a, 0, i);
+  }
+}
+
+static void
+RunName(char *name, int run)
+{
+  sprintf(name, "/run%d", run);
+}
+
+/* Merge runs first..first+ways-1 into run "to" (or /sorted, if "to"
+ * is -1), and remove them.  Return how many numbers were merged.
+ */
+static int
+Merge(int first, int ways, int to)
+{
+  FILE *in[MergeWays], *out;
+  int head[MergeWays], live[MergeWays];
+  char name[20];
+  int i, best, count = 0, last = 0;
+
+  if (to == -1)
+    out = fopen("/sorted", "w");
+  else {
+    RunName(name, to);
+    out = fopen(name, "w");
+  }
+  if (out == 0) MSG("Failed on creating a run");
+  for (i = 0; i < ways; i++) {
+    RunName(name, first + i);
+    in[i] = fopen(name, "r");
+    if (in[i] == 0) MSG("Failed on opening a run");
+    Advise(in[i]->id, 0, 0, AdviseSequential);
+    live[i] = (fread(&head[i], sizeof(int), 1, in[i]) == 1);
+  }
+  for (;;) {
+    best = -1;			/* ways is small: just look at each */
+    for (i = 0; i < ways; i++)
+      if (live[i] && (best == -1 || head[i] < head[best]))
+	best = i;
+    if (best == -1)
+      break;
+    if (count > 0 && head[best] < last) MSG("Merged out of order");
+    last = head[best];
+    if (fwrite(&last, sizeof(int), 1, out) != 1)
+      MSG("Failed on writing a run");
+    count++;
+    live[best] = (fread(&head[best], sizeof(int), 1, in[best]) == 1);
+  }
+  for (i = 0; i < ways; i++) {
+    fclose(in[i]);
+    RunName(name, first + i);
+    if (Remove(name) != 1) MSG("Failed on removing a run");
+  }
+  if (fclose(out) != 0) MSG("Failed on writing a run");
+  return count;
+}
+
+int main(void)
+{
+  FILE *in, *out;
+  char name[20];
+  int total = 0, n, runs, first, next, merged, pass;
+
+  /* Make the sorted runs */
+  in = fopen("/numbers", "r");
+  if (in == 0) MSG("Failed on opening /numbers");
+  Advise(in->id, 0, 0, AdviseSequential);
+  BenchStart();
+  for (runs = 0; ; runs++) {
+    for (n = 0; n < RunSize && ReadNumber(in, &numbers[n]); n++)
+      ;
+    if (n == 0)
+      break;
+    if (runs == MaxRuns) MSG("Too many runs");
+    HeapSort(numbers, n);
+    RunName(name, runs);
+    out = fopen(name, "w");
+    if (out == 0) MSG("Failed on creating a run");
+    if (fwrite(numbers, sizeof(int), n, out) != n || fclose(out) != 0)
+      MSG("Failed on writing a run");
+    total += n;
+  }
+  fclose(in);
+  if (total == 0) MSG("No numbers in /numbers");
+  BenchReport("sortruns", total);
+
+  /* Merge them, a pass at a time: the runs of a pass are first..end-1,
+   * and the merged ones are numbered from end on.  A pass of one merge
+   * is the last, and writes /sorted.
+   */
+  first = 0;
+  next = runs;
+  for (pass = 1; ; pass++) {
+    int end = next, ways, last = (end - first <= MergeWays);
+
+    BenchStart();
+    merged = 0;
+    for (; first < end; first += ways) {
+      ways = (end - first < MergeWays) ? end - first : MergeWays;
+      if (last)
+	merged += Merge(first, ways, -1);
+      else {
+	if (next == MaxRuns) MSG("Too many runs");
+	merged += Merge(first, ways, next++);
+      }
+    }
+    if (merged != total) MSG("Lost numbers in the merge");
+    sprintf(name, "sortmerge%d", pass);
+    BenchReport(name, total);
+    if (last)
+      break;
+  }
+  printf("sorted %d numbers in %d runs, %d merge passes\n", total, runs,
+	 pass);
+  BenchDone();
+}
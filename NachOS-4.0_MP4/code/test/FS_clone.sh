@@ -0,0 +1,20 @@
+../build.linux/nachos -f
+../build.linux/nachos -mkdir /t0
+../build.linux/nachos -cp num_100.txt /f1
+../build.linux/nachos -clone /f1 /f2
+../build.linux/nachos -clone /f1 /t0/f3
+../build.linux/nachos -cpz num_400.txt /z1
+../build.linux/nachos -clone /z1 /t0/z2
+echo "========================================"
+../build.linux/nachos -llr /
+echo "========================================"
+../build.linux/nachos -r /f1
+../build.linux/nachos -r /z1
+../build.linux/nachos -p /f2
+../build.linux/nachos -p /t0/z2
+echo "========================================"
+../build.linux/nachos -r /f2
+../build.linux/nachos -p /t0/f3
+../build.linux/nachos -clone /t0 /t1
+../build.linux/nachos -clone /t0/f3 /t0/z2
+../build.linux/nachos -llr /
@@ -0,0 +1,35 @@
+#include "syscall.h"
+
+/* Push more than a pipe holds through one, a piece at a time, reading
+ * each piece back out; then check that a Dup of the write end keeps
+ * the pipe open, and that closing every write end gives end of file.
+ */
+
+int main(void)
+{
+	char test[] = "abcdefghijklmnopqrstuvwxyz";
+	char buf[26];
+	OpenFileId fds[2];
+	OpenFileId dup;
+	int i, j;
+
+	if (Pipe(fds) != 0) MSG("Failed on making a pipe");
+	for (i = 0; i < 40; i++) {
+		if (Write(test, 26, fds[1]) != 26) MSG("Failed on writing the pipe");
+		if (Read(buf, 26, fds[0]) != 26) MSG("Failed on reading the pipe");
+		for (j = 0; j < 26; j++)
+			if (buf[j] != test[j]) MSG("Read back the wrong bytes");
+	}
+	if (Read(buf, 1, fds[1]) != -1) MSG("Read the write end");
+	if (Write(test, 1, fds[0]) != -1) MSG("Wrote the read end");
+
+	dup = Dup(fds[1]);
+	if (dup < 0) MSG("Failed on Dup of the write end");
+	if (Close(fds[1]) != 1) MSG("Failed on closing the write end");
+	if (Write(test, 3, dup) != 3) MSG("Failed on writing the Dup");
+	if (Close(dup) != 1) MSG("Failed on closing the Dup");
+	if (Read(buf, 26, fds[0]) != 3) MSG("Lost the bytes written");
+	if (Read(buf, 26, fds[0]) != 0) MSG("No end of file");
+	if (Close(fds[0]) != 1) MSG("Failed on closing the read end");
+	Halt();
+}
@@ -0,0 +1,47 @@
+# Compare the sector placement policies (nachos -fp first|track|bestfit)
+# by the total simulated ticks and disk requests of the FS_partII and
+# FS_partIII command sequences.  Run from this directory, after building nachos.
+
+for policy in first track bestfit
+do
+	rm -f stats.$policy
+	run() {
+		../build.linux/nachos -fp $policy -S "$@" | grep -e "^Ticks:" -e "^Disk I/O:" >> stats.$policy
+	}
+
+	# FS_partII
+	run -f
+	run -cp num_100.txt /100
+	run -cp num_1000.txt /1000
+	run -cp num_3000.txt /3000
+	run -p /1000
+	run -p /100
+	run -p /3000
+
+	# FS_partIII
+	run -f
+	run -mkdir /t0
+	run -mkdir /t1
+	run -mkdir /t2
+	run -cp num_100.txt /t0/f1
+	run -mkdir /t0/aa
+	run -mkdir /t0/bb
+	run -mkdir /t0/cc
+	run -cp num_100.txt /t0/bb/f1
+	run -cp num_100.txt /t0/bb/f2
+	run -cp num_100.txt /t0/bb/f3
+	run -cp num_100.txt /t0/bb/f4
+	run -l /
+	run -l /t0
+	run -r /t0/bb/f1
+	run -lr /
+	run -p /t0/f1
+	run -p /t0/bb/f3
+
+	awk -v policy=$policy '
+		/^Ticks:/ { ticks += $3 }
+		/^Disk I\/O:/ { gsub(",", ""); reads += $4; writes += $6 }
+		END { printf("%-7s total ticks %d, disk reads %d, writes %d\n", policy, ticks, reads, writes) }
+	' stats.$policy
+	rm -f stats.$policy
+done
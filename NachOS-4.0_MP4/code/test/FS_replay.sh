@@ -0,0 +1,14 @@
+# Compare the disk schedules (nachos -ds) by replaying the same traces
+# under each: the file system calls of FS_replay.trace and the raw
+# sector requests of FS_replay_sectors.trace.  Each is replayed on a
+# freshly formatted disk.  Run from this directory, after building nachos.
+
+for schedule in fcfs sstf scan clook
+do
+	echo "==== -ds $schedule"
+	for trace in FS_replay.trace FS_replay_sectors.trace
+	do
+		../build.linux/nachos -f -ds $schedule -S -replay $trace \
+			| grep -e "^Replay" -e "^Ticks:" -e "^Disk I/O:"
+	done
+done
@@ -0,0 +1,31 @@
+#include "syscall.h"
+
+/* Write the alphabet back to front with PWrite, then check it with
+ * Seek and Read, and with PRead, without reopening the file.
+ */
+
+int main(void)
+{
+	char test[] = "abcdefghijklmnopqrstuvwxyz\n";
+	char c;
+	OpenFileId fid;
+	int i;
+
+	if (Create("/file1", 27) != 1) MSG("Failed on creating file");
+	fid = Open("/file1");
+	if (fid <= 0) MSG("Failed on opening file");
+	for (i = 26; i >= 0; --i)
+		if (PWrite(test + i, 1, i, fid) != 1) MSG("Failed on PWrite");
+
+	for (i = 0; i < 27; i += 2) {
+		if (Seek(i, fid) != 1) MSG("Failed on Seek");
+		if (Read(&c, 1, fid) != 1 || c != test[i])
+			MSG("Failed on reading after Seek");
+	}
+	for (i = 1; i < 27; i += 2)
+		if (PRead(&c, 1, i, fid) != 1 || c != test[i])
+			MSG("Failed on PRead");
+	if (Read(&c, 1, fid) != 0) MSG("PRead moved the seek position");
+	if (Close(fid) != 1) MSG("Failed on closing file");
+	Halt();
+}
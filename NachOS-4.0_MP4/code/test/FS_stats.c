@@ -0,0 +1,33 @@
+#include "syscall.h"
+
+/* Write and read back a file a piece at a time, then check that
+ * GetStats counted the calls and the bytes they moved.
+ */
+
+int main(void)
+{
+	char buf[64];
+	SyscallStats st;
+	OpenFileId fid;
+	int i;
+
+	if (Create("/file1", 640) != 1) MSG("Failed on creating file");
+	fid = Open("/file1");
+	if (fid <= 0) MSG("Failed on opening file");
+	for (i = 0; i < 10; i++)
+		if (Write(buf, 64, fid) != 64) MSG("Failed on writing file");
+	if (Seek(0, fid) != 1) MSG("Failed on Seek");
+	for (i = 0; i < 10; i++)
+		if (Read(buf, 32, fid) != 32) MSG("Failed on reading file");
+
+	if (GetStats(SC_Write, &st) != 0) MSG("Failed on GetStats");
+	if (st.count != 10 || st.bytes != 640) MSG("Wrong Write stats");
+	if (st.ticks <= 0 || st.maxTicks > st.ticks) MSG("Wrong Write ticks");
+	if (GetStats(SC_Read, &st) != 0 || st.count != 10 || st.bytes != 320)
+		MSG("Wrong Read stats");
+	if (GetStats(-1, &st) != 0 || st.count != 26 || st.bytes != 960)
+		MSG("Wrong total stats");
+	if (GetStats(1000, &st) >= 0) MSG("GetStats took a bad code");
+	if (Close(fid) != 1) MSG("Failed on closing file");
+	Halt();
+}
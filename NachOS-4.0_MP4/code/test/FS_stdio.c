@@ -0,0 +1,44 @@
+#include "libnachos.h"
+
+/* Write a file a byte at a time through the stdio library, read it
+ * back the same way, and check with GetStats that the buffering kept
+ * the system calls to about one a sector.
+ */
+
+#define Size	1280	/* ten sectors */
+#define Text	(Size - 4 * 19)	/* the rest is four 19-byte lines */
+
+int main(void)
+{
+	SyscallStats st;
+	FILE *f;
+	char c;
+	int i, n;
+
+	f = fopen("/file1", "w");
+	if (f == 0) MSG("Failed on opening file");
+	for (i = 0; i < Text; i++) {
+		c = 'a' + i % 26;
+		if (fwrite(&c, 1, 1, f) != 1) MSG("Failed on writing file");
+	}
+	for (i = 0; i < 4; i++)
+		fprintf(f, "line %04d of %-5s\n", i, "four");
+	if (fclose(f) != 0) MSG("Failed on closing file");
+	if (GetStats(SC_Write, &st) != 0 || st.count > Size / BufSize + 1)
+		MSG("Too many Writes for the file");
+	if (st.bytes != Size) MSG("Wrong number of bytes written");
+
+	f = fopen("/file1", "r");
+	if (f == 0) MSG("Failed on opening file for reading");
+	for (n = 0; fread(&c, 1, 1, f) == 1; n++)
+		if (n < Text && c != 'a' + n % 26)
+			MSG("Read back the wrong data");
+	if (n != Size) MSG("Read back the wrong length");
+	fclose(f);
+	if (GetStats(SC_Read, &st) != 0 || st.count > Size / BufSize + 1)
+		MSG("Too many Reads for the file");
+
+	printf("stdio: %d bytes in %d reads, %x ok\n", n, st.count, 0xc0de);
+	fflush(0);
+	Halt();
+}
@@ -0,0 +1,26 @@
+#include "syscall.h"
+
+/* Write a file, force it to the disk with Fsync and Sync, and check
+ * that both refuse what isn't an open file.
+ */
+
+int main(void)
+{
+	char buf[256];
+	OpenFileId fid;
+	int i;
+
+	for (i = 0; i < 256; i++)
+		buf[i] = i;
+	if (Create("/file1", 0) != 1) MSG("Failed on creating file");
+	fid = Open("/file1");
+	if (fid <= 0) MSG("Failed on opening file");
+	if (Write(buf, 256, fid) != 256) MSG("Failed on writing file");
+	if (Fsync(fid) != 0) MSG("Failed on Fsync");
+	if (Write(buf, 100, fid) != 100) MSG("Failed on writing file");
+	if (Sync() != 0) MSG("Failed on Sync");
+	if (Fsync(SysConsoleOutput) != -1) MSG("Fsync took the console");
+	if (Close(fid) != 1) MSG("Failed on closing file");
+	if (Fsync(fid) != -1) MSG("Fsync took a closed file");
+	Halt();
+}
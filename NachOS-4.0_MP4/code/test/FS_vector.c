@@ -0,0 +1,51 @@
+#include "syscall.h"
+
+/* Write the alphabet with WriteV and Submit, a letter per piece, and
+ * read it back with ReadV: the same work as FS_test1, in a few traps.
+ */
+
+int main(void)
+{
+	char test[] = "abcdefghijklmnopqrstuvwxyz\n";
+	char back[27];
+	IoBuf vec[MaxIoBufs];
+	IoRequest req[MaxIoBufs];
+	OpenFileId fid;
+	int i, n;
+
+	if (Create("/file1", 27) != 1) MSG("Failed on creating file");
+	fid = Open("/file1");
+	if (fid <= 0) MSG("Failed on opening file");
+
+	for (i = 0; i < 13; ++i) {
+		vec[i].buffer = test + i;
+		vec[i].size = 1;
+	}
+	if (WriteV(vec, 13, fid) != 13) MSG("Failed on WriteV");
+
+	for (i = 0; i < 14; ++i) {
+		req[i].op = IoWrite;
+		req[i].buffer = test + 13 + i;
+		req[i].size = 1;
+		req[i].id = fid;
+	}
+	req[14].op = IoClose;
+	req[14].id = fid;
+	if (Submit(req, 15) != 15) MSG("Failed on Submit");
+	for (i = 0; i < 14; ++i)
+		if (req[i].result != 1) MSG("Failed on writing file");
+	if (req[14].result != 1) MSG("Failed on closing file");
+
+	fid = Open("/file1");
+	if (fid <= 0) MSG("Failed on opening file");
+	vec[0].buffer = back;
+	vec[0].size = 10;
+	vec[1].buffer = back + 10;
+	vec[1].size = 17;
+	n = ReadV(vec, 2, fid);
+	if (n != 27) MSG("Failed on ReadV");
+	for (i = 0; i < 27; ++i)
+		if (back[i] != test[i]) MSG("Read back the wrong data");
+	if (Close(fid) != 1) MSG("Failed on closing file");
+	Halt();
+}
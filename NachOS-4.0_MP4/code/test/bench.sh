@@ -0,0 +1,55 @@
+# Simulator benchmark suite.  Each run prints one machine-readable line
+# (see Statistics::PrintBench):
+#
+#	bench name=<run> wall_sec=... instr_per_sec=... switches_per_sec=...
+#		sector_ios_per_sec=... (and the raw counts)
+#
+# so that the output of two builds can be compared, or kept to track
+# regressions.  Run from this directory, after building nachos and the
+# test programs ("make bench" in build.linux does both of these).
+#
+# The disk only holds 128KB, so the 1MB copy cycle is sixteen copies in
+# and out of a 64KB file, in one run (see Batch in threads/main.cc).
+
+NACHOS=${NACHOS:-../build.linux/nachos}
+
+run() {
+	name=$1
+	shift
+	$NACHOS -bench $name "$@" | grep -o "bench name=.*"
+				# not "^bench ": "-p" output need not end
+				# with a newline
+}
+
+# user programs, each loaded onto a fresh disk first
+for prog in matmult10 matmult15 matmult20 sort FS_test1 FS_test2
+do
+	if [ ! -f $prog ]
+	then
+		echo "bench.sh: $prog is not built, skipping it" 1>&2
+		continue
+	fi
+	$NACHOS -f -cp $prog /$prog > /dev/null
+	run $prog -e /$prog
+done
+
+# 1MB through the file system
+head -c 65536 num_1000000.txt > bench.64k
+rm -f bench.batch
+i=0
+while [ $i -lt 16 ]
+do
+	echo "-cp bench.64k /big" >> bench.batch
+	echo "-p /big" >> bench.batch
+	echo "-r /big" >> bench.batch
+	i=`expr $i + 1`
+done
+$NACHOS -f > /dev/null
+run fs_1mb -b bench.batch
+rm -f bench.64k bench.batch
+
+# the scheduler, with more and more threads competing
+for threads in 2 10 50
+do
+	run stress$threads -stress $threads
+done
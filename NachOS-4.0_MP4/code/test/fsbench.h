@@ -0,0 +1,49 @@
+/* fsbench.h
+ *	What the file system benchmarks (FS_bench_*.c) share: timing a
+ *	run of operations with GetMachineStats, and reporting it as one
+ *	line, for FS_bench.sh to collect:
+ *
+ *	    fsbench <name> ops <n> ticks/op <t> reads <r> writes <w>
+ *
+ *	"reads" and "writes" are disk requests, so what the buffer cache
+ *	saves shows up as well as what the disk scheduling does.  Each
+ *	program includes this once, and links libnachos.o.
+ */
+
+#ifndef FSBENCH_H
+#define FSBENCH_H
+
+#include "libnachos.h"
+
+static MachineStats benchStart;
+
+/* Start timing */
+static void
+BenchStart(void)
+{
+  fflush(stdout);	/* so earlier output isn't counted */
+  GetMachineStats(&benchStart);
+}
+
+/* Report the "ops" operations since BenchStart, as "name" */
+static void
+BenchReport(char *name, int ops)
+{
+  MachineStats now;
+
+  GetMachineStats(&now);
+  printf("fsbench %s ops %d ticks/op %d reads %d writes %d\n", name, ops,
+	 (now.ticks - benchStart.ticks) / ops,
+	 now.diskReads - benchStart.diskReads,
+	 now.diskWrites - benchStart.diskWrites);
+}
+
+/* Stop: write out the reports, and halt */
+static void
+BenchDone(void)
+{
+  fflush(0);
+  Halt();
+}
+
+#endif /* FSBENCH_H */
@@ -0,0 +1,48 @@
+#include "libnachos.h"
+
+/* Grow the heap with Sbrk, then allocate, free and reallocate through
+ * malloc, checking that freed blocks are reused and that running out
+ * of memory fails cleanly.
+ */
+
+#define Count	64
+
+int main(void)
+{
+	int *a[Count], *b, i, j;
+	char *end, *p;
+
+	end = (char *) Sbrk(0);
+	if (end == (char *) -1) MSG("Sbrk(0) failed");
+	if ((char *) Sbrk(256) != end) MSG("Sbrk didn't grow from the end");
+	for (p = end; p < end + 256; p++)
+		if (*p != 0) MSG("Sbrk didn't give zeroes");
+	if ((char *) Sbrk(-256) != end + 256) MSG("Sbrk didn't shrink");
+	if ((int) Sbrk(-1) != -1) MSG("Sbrk shrank below the heap");
+	if ((int) Sbrk(1 << 30) != -1) MSG("Sbrk grew past memory");
+
+	for (i = 0; i < Count; i++) {
+		a[i] = (int *) malloc((i % 8 + 1) * sizeof(int));
+		if (a[i] == 0 || ((int) a[i] & 7) != 0) MSG("Bad malloc");
+		for (j = 0; j <= i % 8; j++)
+			a[i][j] = i;
+	}
+	for (i = 0; i < Count; i++)
+		for (j = 0; j <= i % 8; j++)
+			if (a[i][j] != i) MSG("Blocks overlap");
+	b = a[Count - 1];
+	free(b);
+	if (malloc(8 * sizeof(int)) != b) MSG("A freed block wasn't reused");
+
+	b = (int *) realloc(a[0], 100 * sizeof(int));
+	if (b == 0 || b[0] != 0) MSG("realloc lost the data");
+	b = (int *) calloc(50, sizeof(int));
+	for (i = 0; i < 50; i++)
+		if (b == 0 || b[i] != 0) MSG("calloc didn't zero");
+	if (malloc(1 << 20) != 0) MSG("malloc took more than memory");
+
+	printf("heap: %d blocks, heap grew by %d bytes\n", Count,
+		(char *) Sbrk(0) - end);
+	fflush(0);
+	Halt();
+}
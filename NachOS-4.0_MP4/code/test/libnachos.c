@@ -0,0 +1,484 @@
+/* libnachos.c
+ *	Buffered I/O and formatted output for Nachos user programs.
+ *	See libnachos.h.
+ *
+ *	There is no C library on the simulated machine, so everything
+ *	here -- even copying bytes -- is done by hand.
+ */
+
+#include "libnachos.h"
+
+static FILE streams[MaxStreams] = {
+  { 1, SysConsoleInput, 0, 0 },
+  { 1, SysConsoleOutput, 1, 1 }
+};
+
+FILE *stdin = &streams[0];
+FILE *stdout = &streams[1];
+
+/* Write out the bytes in f's buffer, if it is for writing.  Return 0,
+ * or EOF if the Write failed.
+ */
+static int
+Drain(FILE *f)
+{
+  int n = f->count;
+
+  if (!f->writing || n == 0)
+    return 0;
+  f->count = 0;
+  if (Write(f->buf, n, f->id) != n) {
+    f->error = 1;
+    return EOF;
+  }
+  return 0;
+}
+
+/* Refill f's buffer, when reading, with one Read.  Return the number
+ * of bytes now in it: 0 at the end of the file.
+ */
+static int
+Fill(FILE *f)
+{
+  int n = Read(f->buf, BufSize, f->id);
+
+  if (n < 0) {
+    f->error = 1;
+    n = 0;
+  }
+  f->count = n;
+  f->next = 0;
+  return n;
+}
+
+FILE *
+fopen(char *name, char *mode)
+{
+  FILE *f;
+  int i;
+
+  for (i = 0; i < MaxStreams && streams[i].inUse; i++)
+    ;
+  if (i == MaxStreams || (mode[0] != 'r' && mode[0] != 'w'))
+    return 0;
+  f = &streams[i];
+  if (mode[0] == 'w') {
+    Remove(name);	/* no truncate: start a new, empty file */
+    if (Create(name, 0) != 1)
+      return 0;
+  }
+  f->id = Open(name);
+  if (f->id <= 0)
+    return 0;
+  f->inUse = 1;
+  f->writing = (mode[0] == 'w');
+  f->lineBuffered = 0;
+  f->count = 0;
+  f->next = 0;
+  f->error = 0;
+  return f;
+}
+
+int
+fflush(FILE *f)
+{
+  int i, result = 0;
+
+  if (f != 0)
+    return Drain(f);
+  for (i = 0; i < MaxStreams; i++)
+    if (streams[i].inUse && Drain(&streams[i]) == EOF)
+      result = EOF;
+  return result;
+}
+
+int
+fclose(FILE *f)
+{
+  int result = Drain(f);
+
+  if (f->id != SysConsoleInput && f->id != SysConsoleOutput)
+    Close(f->id);
+  f->inUse = 0;
+  return result;
+}
+
+int
+fwrite(void *buf, int size, int count, FILE *f)
+{
+  char *p = (char *) buf;
+  int n = size * count, done = 0, chunk, i;
+
+  if (!f->writing || n <= 0)
+    return 0;
+  while (done < n) {
+    if (f->count == 0 && n - done >= BufSize) {
+      /* a whole buffer's worth: write it straight from the caller */
+      chunk = (n - done) - (n - done) % BufSize;
+      if (Write(p + done, chunk, f->id) != chunk) {
+        f->error = 1;
+        break;
+      }
+      done += chunk;
+      continue;
+    }
+    chunk = BufSize - f->count;
+    if (chunk > n - done)
+      chunk = n - done;
+    for (i = 0; i < chunk; i++)
+      f->buf[f->count++] = p[done++];
+    if (f->count == BufSize && Drain(f) == EOF)
+      break;
+  }
+  if (f->lineBuffered)
+    for (i = 0; i < n; i++)
+      if (p[i] == '\n') {
+        Drain(f);
+        break;
+      }
+  return done / size;
+}
+
+int
+fread(void *buf, int size, int count, FILE *f)
+{
+  char *p = (char *) buf;
+  int n = size * count, done = 0, chunk, got;
+
+  if (f->writing || n <= 0)
+    return 0;
+  while (done < n) {
+    if (f->next == f->count && n - done >= BufSize) {
+      /* a whole buffer's worth: read it straight into the caller's */
+      chunk = (n - done) - (n - done) % BufSize;
+      got = Read(p + done, chunk, f->id);
+      if (got <= 0) {
+        if (got < 0)
+          f->error = 1;
+        break;
+      }
+      done += got;
+      continue;
+    }
+    if (f->next == f->count && Fill(f) == 0)
+      break;
+    while (f->next < f->count && done < n)
+      p[done++] = f->buf[f->next++];
+  }
+  return done / size;
+}
+
+int
+fputc(int c, FILE *f)
+{
+  char ch = c;
+
+  return (fwrite(&ch, 1, 1, f) == 1) ? (c & 0xff) : EOF;
+}
+
+int
+fgetc(FILE *f)
+{
+  if (f->writing)
+    return EOF;
+  if (f->next == f->count && Fill(f) == 0)
+    return EOF;
+  return f->buf[f->next++] & 0xff;
+}
+
+int
+fputs(char *s, FILE *f)
+{
+  int n;
+
+  for (n = 0; s[n] != '\0'; n++)
+    ;
+  return (fwrite(s, 1, n, f) == n) ? n : EOF;
+}
+
+/* Formatted output goes to a "sink": a stream, or a string.  Each
+ * character is handed to Put; a stream's are collected into a run and
+ * passed to fwrite together, so printf costs no more than fwrite.
+ */
+typedef struct {
+  FILE *f;		/* the stream, or 0 for a string */
+  char *s;		/* the string's next byte */
+  char run[32];		/* characters for f not yet given to fwrite */
+  int n;		/* how many */
+  int total;		/* characters produced, in all */
+} Sink;
+
+static void
+PutRun(Sink *k)
+{
+  if (k->n > 0)
+    fwrite(k->run, 1, k->n, k->f);
+  k->n = 0;
+}
+
+static void
+Put(Sink *k, int c)
+{
+  k->total++;
+  if (k->f == 0) {
+    *k->s++ = c;
+    return;
+  }
+  k->run[k->n++] = c;
+  if (k->n == sizeof(k->run))
+    PutRun(k);
+}
+
+/* Put "len" characters of "s", padded to "width" on the left (or on
+ * the right, if "left"); with "pad" characters, where a leading '-'
+ * goes before zeroes.
+ */
+static void
+PutField(Sink *k, char *s, int len, int width, int left, int pad)
+{
+  if (pad == '0' && len > 0 && s[0] == '-') {
+    Put(k, *s++);
+    len--;
+    width--;
+  }
+  if (!left)
+    for (; width > len; width--)
+      Put(k, pad);
+  for (; len > 0; len--, width--)
+    Put(k, *s++);
+  for (; width > 0; width--)
+    Put(k, ' ');
+}
+
+static void
+Format(Sink *k, char *format, va_list args)
+{
+  char digits[12], *p, *s;
+  unsigned int u;
+  int base, left, pad, width, len, neg;
+
+  for (; *format != '\0'; format++) {
+    if (*format != '%') {
+      Put(k, *format);
+      continue;
+    }
+    left = 0;
+    pad = ' ';
+    width = 0;
+    for (format++; *format == '-' || *format == '0'; format++)
+      if (*format == '-')
+        left = 1;
+      else
+        pad = '0';
+    for (; *format >= '0' && *format <= '9'; format++)
+      width = width * 10 + (*format - '0');
+    if (*format == 'l')
+      format++;		/* int and long are the same size here */
+    if (left)
+      pad = ' ';
+
+    switch (*format) {
+    case 'd': case 'i': case 'u': case 'x': case 'X': case 'o':
+      base = (*format == 'x' || *format == 'X') ? 16
+              : (*format == 'o') ? 8 : 10;
+      u = va_arg(args, unsigned int);
+      neg = ((*format == 'd' || *format == 'i') && (int) u < 0);
+      if (neg)
+        u = -u;
+      p = digits + sizeof(digits);
+      do {
+        *--p = "0123456789abcdef"[u % base];
+        if (*format == 'X' && *p >= 'a')
+          *p += 'A' - 'a';
+        u /= base;
+      } while (u != 0);
+      if (neg)
+        *--p = '-';
+      PutField(k, p, digits + sizeof(digits) - p, width, left, pad);
+      break;
+    case 'c':
+      digits[0] = va_arg(args, int);
+      PutField(k, digits, 1, width, left, ' ');
+      break;
+    case 's':
+      s = va_arg(args, char *);
+      if (s == 0)
+        s = "(null)";
+      for (len = 0; s[len] != '\0'; len++)
+        ;
+      PutField(k, s, len, width, left, ' ');
+      break;
+    case '\0':
+      return;
+    default:		/* "%%", or a conversion we don't do */
+      Put(k, *format);
+      break;
+    }
+  }
+}
+
+int
+vfprintf(FILE *f, char *format, va_list args)
+{
+  Sink k;
+
+  k.f = f;
+  k.n = 0;
+  k.total = 0;
+  Format(&k, format, args);
+  PutRun(&k);
+  return k.total;
+}
+
+int
+fprintf(FILE *f, char *format, ...)
+{
+  va_list args;
+  int n;
+
+  va_start(args, format);
+  n = vfprintf(f, format, args);
+  va_end(args);
+  return n;
+}
+
+int
+printf(char *format, ...)
+{
+  va_list args;
+  int n;
+
+  va_start(args, format);
+  n = vfprintf(stdout, format, args);
+  va_end(args);
+  return n;
+}
+
+int
+sprintf(char *s, char *format, ...)
+{
+  va_list args;
+  Sink k;
+
+  k.f = 0;
+  k.s = s;
+  k.total = 0;
+  va_start(args, format);
+  Format(&k, format, args);
+  va_end(args);
+  *k.s = '\0';
+  return k.total;
+}
+
+/* Every block starts with a header giving its size class, and the
+ * caller gets the bytes after it.  A free block's first word links it
+ * into the list for its class.
+ */
+typedef struct {
+  int sizeClass;	/* the block is 2^sizeClass bytes, with this */
+  int pad;		/* keeps what follows 8-byte aligned */
+} Header;
+
+static char *freeList[NumClasses];	/* free blocks of each class */
+static char *arenaNext, *arenaEnd;	/* heap not yet carved into blocks */
+
+/* Carve a block of 2^c bytes from the end of the heap, asking Sbrk
+ * for more if need be.  Return 0 if there is no more.
+ */
+static char *
+Carve(int c)
+{
+  int size = 1 << c, grow;
+  char *p, *old;
+
+  if (arenaEnd - arenaNext < size) {
+    grow = (size > HeapGrow) ? size : HeapGrow;
+    old = (char *) Sbrk(grow);
+    if (old == (char *) -1) {
+      grow = size;		/* take no more than is needed */
+      old = (char *) Sbrk(grow);
+      if (old == (char *) -1)
+        return 0;
+    }
+    if (old != arenaEnd) {	/* the first time: start the arena off */
+      arenaNext = old;
+      while ((int) arenaNext & 7)
+        arenaNext++;
+    }
+    arenaEnd = old + grow;
+    if (arenaEnd - arenaNext < size)
+      return 0;
+  }
+  p = arenaNext;
+  arenaNext += size;
+  return p;
+}
+
+void *
+malloc(int size)
+{
+  char *p;
+  int c;
+
+  if (size < 0)
+    return 0;
+  for (c = MinClass; c < MinClass + NumClasses; c++)
+    if ((1 << c) - (int) sizeof(Header) >= size)
+      break;
+  if (c == MinClass + NumClasses)
+    return 0;
+  p = freeList[c - MinClass];
+  if (p != 0)
+    freeList[c - MinClass] = *(char **) p;
+  else if ((p = Carve(c)) == 0)
+    return 0;
+  ((Header *) p)->sizeClass = c;
+  return p + sizeof(Header);
+}
+
+void
+free(void *q)
+{
+  char *p = (char *) q - sizeof(Header);
+  int c;
+
+  if (q == 0)
+    return;
+  c = ((Header *) p)->sizeClass;
+  *(char **) p = freeList[c - MinClass];
+  freeList[c - MinClass] = p;
+}
+
+void *
+calloc(int count, int size)
+{
+  char *p = (char *) malloc(count * size);
+  int i;
+
+  if (p != 0)
+    for (i = 0; i < count * size; i++)
+      p[i] = 0;
+  return p;
+}
+
+void *
+realloc(void *q, int size)
+{
+  char *p;
+  int have, i;
+
+  if (q == 0)
+    return malloc(size);
+  have = (1 << ((Header *) ((char *) q - sizeof(Header)))->sizeClass)
+		- sizeof(Header);
+  if (size <= have)
+    return q;		/* it still fits */
+  p = (char *) malloc(size);
+  if (p == 0)
+    return 0;
+  for (i = 0; i < have; i++)
+    p[i] = ((char *) q)[i];
+  free(q);
+  return p;
+}
+
@@ -0,0 +1,90 @@
+/* libnachos.h
+ *	A small C library for Nachos user programs: buffered I/O on
+ *	files and the console, and printf-style formatting.
+ *
+ *	Each stream keeps a buffer of one disk sector, and only traps to
+ *	the kernel when it is full (or, when reading, empty), so a program
+ *	that writes a file a byte at a time makes one Write system call
+ *	per sector rather than one per byte.  Output to stdout also goes
+ *	out at each newline.
+ *
+ *	There is no exit hook: call fflush(NULL), or fclose each stream,
+ *	before Halt or Exit, or the end of the output is lost.
+ *
+ *	malloc takes memory from the heap with Sbrk.  Each block is
+ *	rounded up to a power of two -- its size class -- and freed
+ *	blocks go on a list for their class, so a malloc of a size that
+ *	has been freed before is a pop off that list, with no system call
+ *	and no search.  Memory is never given back to the kernel.
+ *
+ *	To use it, include this file and link libnachos.o after start.o.
+ */
+
+#ifndef LIBNACHOS_H
+#define LIBNACHOS_H
+
+#include "syscall.h"
+#include <stdarg.h>
+
+#define BufSize		128	/* bytes in a stream's buffer: one sector */
+#define MaxStreams	8	/* streams open at once, with stdin and stdout */
+#define MinClass	4	/* the smallest block is 2^4 bytes, */
+#define NumClasses	12	/* the largest 2^15 */
+#define HeapGrow	1024	/* bytes to ask Sbrk for at least, at a time */
+
+#define EOF		(-1)
+
+typedef struct {
+  int inUse;		/* is the stream open? */
+  OpenFileId id;	/* the file it is open on */
+  int writing;		/* open for writing, rather than reading? */
+  int lineBuffered;	/* write out the buffer at each newline? */
+  int count;		/* bytes in buf: to be written, or read */
+  int next;		/* when reading, the next byte of buf to take */
+  int error;		/* has a system call failed? */
+  char buf[BufSize];
+} FILE;
+
+extern FILE *stdin, *stdout;
+
+/* Open a Nachos file for reading ("r"), or for writing ("w"): the file
+ * is made empty, or created.  Return NULL if it can't be.
+ */
+FILE *fopen(char *name, char *mode);
+
+/* Write out what is buffered, and close.  Return 0, or EOF on failure */
+int fclose(FILE *f);
+
+/* Write out what is buffered -- for every stream, if "f" is NULL.
+ * Return 0, or EOF on failure.
+ */
+int fflush(FILE *f);
+
+/* Write or read "count" items of "size" bytes; return how many were */
+int fwrite(void *buf, int size, int count, FILE *f);
+int fread(void *buf, int size, int count, FILE *f);
+
+/* Write a character (return it, or EOF), or read one (EOF at the end) */
+int fputc(int c, FILE *f);
+int fgetc(FILE *f);
+
+/* Write a string, without adding a newline; return EOF on failure */
+int fputs(char *s, FILE *f);
+
+/* Formatted output, as in C: %d %u %x %o %c %s and %%, with the flags
+ * "-" and "0" and a field width.  Return the number of characters.
+ */
+int printf(char *format, ...);
+int fprintf(FILE *f, char *format, ...);
+int vfprintf(FILE *f, char *format, va_list args);
+int sprintf(char *s, char *format, ...);
+
+/* Memory allocation, as in C.  malloc returns 0 if there is no room;
+ * its blocks are 8-byte aligned.
+ */
+void *malloc(int size);
+void *calloc(int count, int size);
+void *realloc(void *p, int size);
+void free(void *p);
+
+#endif /* LIBNACHOS_H */
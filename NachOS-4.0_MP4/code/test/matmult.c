@@ -9,9 +9,11 @@
 
 #include "syscall.h"
 
+#ifndef Dim		/* -DDim=... builds the larger or smaller */
 #define Dim 	20	/* sum total of the arrays doesn't fit in 
 			 * physical memory 
 			 */
+#endif			/* versions used by bench.sh */
 
 int A[Dim][Dim];
 int B[Dim][Dim];
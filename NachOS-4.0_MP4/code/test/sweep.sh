@@ -0,0 +1,68 @@
+# Run one Nachos configuration across many parameter points, several
+# simulations at a time.
+#
+#	sh sweep.sh points [jobs]
+#
+# Each line of "points" is a name, then the nachos flags for that point:
+#
+#	tlb4	-e /matmult10 -rs 1
+#	first	-fp first -e /FS_test1
+#
+# Every point runs "$NACHOS -bench <name> <flags>" as its own process,
+# on its own disk: point n is machine n (-m n), so it reads and writes
+# DISK_n, and no two runs share any state.  If $PREP is set, it is run
+# on each point's disk first, for example
+#
+#	PREP="-f -cp matmult10 /matmult10" sh sweep.sh points
+#
+# "jobs" runs (default: one per host CPU) go at once.  The bench lines
+# are printed in the order of the points, whatever order they finish in.
+
+NACHOS=${NACHOS:-../build.linux/nachos}
+points=$1
+jobs=${2:-`getconf _NPROCESSORS_ONLN 2>/dev/null || echo 1`}
+
+if [ -z "$points" ] || [ ! -f "$points" ]
+then
+	echo "usage: sh sweep.sh points [jobs]" 1>&2
+	exit 1
+fi
+
+point() {
+	host=$1
+	name=$2
+	shift 2
+	if [ -n "$PREP" ]
+	then
+		$NACHOS -m $host $PREP > /dev/null
+	fi
+	$NACHOS -m $host -bench $name "$@" | grep "^bench " > sweep.$host
+	rm -f DISK_$host
+}
+
+host=1
+running=0
+while read name flags
+do
+	case $name in
+	""|"#"*)
+		continue ;;
+	esac
+	point $host $name $flags &
+	host=`expr $host + 1`
+	running=`expr $running + 1`
+	if [ $running -ge $jobs ]
+	then
+		wait
+		running=0
+	fi
+done < $points
+wait
+
+i=1
+while [ $i -lt $host ]
+do
+	cat sweep.$i
+	rm -f sweep.$i
+	i=`expr $i + 1`
+done
@@ -1,8 +1,7 @@
 // alarm.cc
 //	Routines to use a hardware timer device to provide a
-//	software alarm clock.  For now, we just provide time-slicing.
-//
-//	Not completely implemented.
+//	software alarm clock: time-slicing, and waking up threads
+//	that have asked to sleep for a while.
 //
 // Copyright (c) 1992-1996 The Regents of the University of California.
 // All rights reserved.  See copyright.h for copyright notice and limitation 
@@ -22,6 +21,7 @@
 
 Alarm::Alarm(bool doRandom)
 {
+    sleepers = new SleepQueue;
     timer = new Timer(doRandom, this);
 }
 
@@ -39,8 +39,9 @@ Alarm::Alarm(bool doRandom)
 //	if the interrupted thread called Yield at the point it is 
 //	was interrupted.
 //
-//	For now, just provide time-slicing.  Only need to time slice 
-//      if we're currently running something (in other words, not idle).
+//	Wake up every sleeping thread that is due.  Then time-slice:
+//	only need to time slice if we're currently running something
+//	(in other words, not idle).
 //----------------------------------------------------------------------
 
 void 
@@ -48,8 +49,129 @@ Alarm::CallBack()
 {
     Interrupt *interrupt = kernel->interrupt;
     MachineStatus status = interrupt->getStatus();
+    Thread *thread;
+
+    while ((thread = sleepers->RemoveDue(kernel->stats->totalTicks)) != NULL)
+	kernel->scheduler->ReadyToRun(thread);
     
     if (status != IdleMode) {
 	interrupt->YieldOnReturn();
     }
 }
+
+//----------------------------------------------------------------------
+// Alarm::WaitUntil
+// 	Suspend the current thread for at least "x" ticks.  It is woken
+//	up by the first timer interrupt at or after that time, so it may
+//	sleep up to TimerTicks longer.
+//
+//	"x" -- how long to sleep; nothing happens if it isn't positive
+//----------------------------------------------------------------------
+
+void
+Alarm::WaitUntil(int x)
+{
+    IntStatus oldLevel;
+
+    if (x <= 0)
+	return;
+    oldLevel = kernel->interrupt->SetLevel(IntOff);
+    DEBUG(dbgThread, "Thread " << kernel->currentThread->getName()
+		<< " sleeping for " << x << " ticks");
+    sleepers->Insert(kernel->currentThread, kernel->stats->totalTicks + x);
+    kernel->currentThread->Sleep(FALSE);
+    (void) kernel->interrupt->SetLevel(oldLevel);
+}
+
+//----------------------------------------------------------------------
+// SleepQueue::SleepQueue
+// 	Initialize an empty queue.  The heap grows as threads are added.
+//----------------------------------------------------------------------
+
+SleepQueue::SleepQueue()
+{
+    size = 16;
+    heap = new Sleeper[size];
+    numSleeping = 0;
+}
+
+//----------------------------------------------------------------------
+// SleepQueue::~SleepQueue
+// 	De-allocate the queue.
+//----------------------------------------------------------------------
+
+SleepQueue::~SleepQueue()
+{
+    delete [] heap;
+}
+
+//----------------------------------------------------------------------
+// SleepQueue::Swap
+// 	Exchange two heap entries.
+//----------------------------------------------------------------------
+
+void
+SleepQueue::Swap(int a, int b)
+{
+    Sleeper tmp = heap[a];
+
+    heap[a] = heap[b];
+    heap[b] = tmp;
+}
+
+//----------------------------------------------------------------------
+// SleepQueue::Insert
+// 	Add a thread that is to wake at "when", and sift it up to its
+//	place.
+//----------------------------------------------------------------------
+
+void
+SleepQueue::Insert(Thread *thread, int when)
+{
+    int i, parent;
+
+    if (numSleeping == size) {
+	Sleeper *bigger = new Sleeper[size * 2];
+	for (i = 0; i < numSleeping; i++)
+	    bigger[i] = heap[i];
+	delete [] heap;
+	heap = bigger;
+	size *= 2;
+    }
+    i = numSleeping++;
+    heap[i].thread = thread;
+    heap[i].when = when;
+    while (i > 0) {
+	parent = (i - 1) / 2;
+	if (heap[parent].when <= heap[i].when)
+	    break;
+	Swap(i, parent);
+	i = parent;
+    }
+}
+
+//----------------------------------------------------------------------
+// SleepQueue::RemoveDue
+// 	If the earliest thread is due to wake by "now", take it off the
+//	heap and return it; otherwise return NULL.
+//----------------------------------------------------------------------
+
+Thread *
+SleepQueue::RemoveDue(int now)
+{
+    Thread *due;
+    int i, child;
+
+    if (numSleeping == 0 || heap[0].when > now)
+	return NULL;
+    due = heap[0].thread;
+    heap[0] = heap[--numSleeping];
+    for (i = 0; (child = 2 * i + 1) < numSleeping; i = child) {
+	if (child + 1 < numSleeping && heap[child + 1].when < heap[child].when)
+	    child++;
+	if (heap[i].when <= heap[child].when)
+	    break;
+	Swap(i, child);
+    }
+    return due;
+}
@@ -0,0 +1,203 @@
+// housekeep.cc
+//	Routines for the housekeeper, the thread that writes back dirty
+//	sectors and compacts split files while Nachos would otherwise
+//	be idle.  See housekeep.h.
+//
+// Copyright (c) 1992-1996 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation 
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "housekeep.h"
+#include "main.h"
+#include "synchdisk.h"
+
+//----------------------------------------------------------------------
+// HousekeeperThread
+// 	Dummy function, to fork the housekeeper's thread with (C++ does
+//	not easily allow pointers to member functions).
+//----------------------------------------------------------------------
+
+static void
+HousekeeperThread(Housekeeper *housekeeper)
+{
+    housekeeper->Run();
+}
+
+//----------------------------------------------------------------------
+// Housekeeper::Housekeeper
+// 	Make the housekeeper's thread, the scheduler's background thread.
+//	It is forked only when it is first woken, so that until there is
+//	work to do there is no second thread, and no time slicing.
+//----------------------------------------------------------------------
+
+Housekeeper::Housekeeper()
+{
+    thread = kernel->NewThread("housekeeper");
+    ASSERT(thread != NULL);
+    kernel->scheduler->SetBackground(thread);
+    started = FALSE;
+    parked = TRUE;
+    sweepAt = 0;
+    compactAfter = -1;
+    passBegan = compactedAt = -1;
+    numUnits = numWritten = numCompacted = numLeft = 0;
+}
+
+//----------------------------------------------------------------------
+// Housekeeper::~Housekeeper
+// 	Nachos is halting.  The thread, if asleep, is simply never woken
+//	again.
+//----------------------------------------------------------------------
+
+Housekeeper::~Housekeeper()
+{
+}
+
+//----------------------------------------------------------------------
+// Housekeeper::HasWork
+// 	Return whether there is work to do, and the disk has nothing
+//	queued, so that the work can't delay anyone else's.  Called with
+//	interrupts off, so it takes no locks.
+//----------------------------------------------------------------------
+
+bool
+Housekeeper::HasWork()
+{
+    if (!kernel->synchDisk->IsIdle())
+	return FALSE;
+    if (kernel->synchDisk->NumWritable() > 0)
+	return TRUE;
+#ifndef FILESYS_STUB
+    if (kernel->fileSystem != NULL
+	    && kernel->fileSystem->NumUpdates() != compactedAt)
+	return TRUE;
+#endif
+    return FALSE;
+}
+
+//----------------------------------------------------------------------
+// Housekeeper::Wake
+// 	Called by Thread::Sleep, with interrupts off, when no thread is
+//	ready to run.  If the housekeeper is asleep and has work to do,
+//	make it ready -- forking it, the first time -- and return TRUE;
+//	it is the background thread, so it runs now.  Otherwise return
+//	FALSE, and Nachos idles.
+//----------------------------------------------------------------------
+
+bool
+Housekeeper::Wake()
+{
+    ASSERT(kernel->interrupt->getLevel() == IntOff);
+    if (!parked || !HasWork())
+	return FALSE;
+    parked = FALSE;
+    if (!started) {
+	started = TRUE;
+	thread->Fork((VoidFunctionPtr) HousekeeperThread, (void *) this);
+    } else {
+	kernel->scheduler->ReadyToRun(thread);
+    }
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// Housekeeper::Run
+// 	The body of the housekeeper's thread: do a unit of work, then let
+//	anyone who became ready while it was done run first; once there
+//	is no more work, or the disk has something else to do, sleep
+//	until Wake.  It never finishes.
+//----------------------------------------------------------------------
+
+void
+Housekeeper::Run()
+{
+    for (;;) {
+	IntStatus oldLevel = kernel->interrupt->SetLevel(IntOff);
+	bool busy = HasWork();
+
+	(void) kernel->interrupt->SetLevel(oldLevel);
+	if (!busy) {
+	    Park();
+	    continue;
+	}
+	Step();
+	kernel->currentThread->Yield();
+    }
+}
+
+//----------------------------------------------------------------------
+// Housekeeper::Park
+// 	Put the housekeeper's thread to sleep, until Thread::Sleep finds
+//	that there is work for it and no one else to run.
+//----------------------------------------------------------------------
+
+void
+Housekeeper::Park()
+{
+    IntStatus oldLevel = kernel->interrupt->SetLevel(IntOff);
+
+    ASSERT(kernel->currentThread == thread);
+    DEBUG(dbgThread, "Housekeeper has nothing to do");
+    parked = TRUE;
+    thread->Sleep(FALSE);
+    (void) kernel->interrupt->SetLevel(oldLevel);
+}
+
+//----------------------------------------------------------------------
+// Housekeeper::Step
+// 	Do one unit of work: write back a batch of dirty sectors, if
+//	there are any; otherwise move the next split file into one run,
+//	if a pass over the files is due.
+//----------------------------------------------------------------------
+
+void
+Housekeeper::Step()
+{
+    int n;
+
+    numUnits++;
+    n = kernel->synchDisk->WriteBackAfter(&sweepAt, HousekeepBatch);
+    if (n > 0) {
+	DEBUG(dbgDisk, "Housekeeper wrote back " << n << " sectors, up to "
+		<< sweepAt - 1);
+	numWritten += n;
+	return;
+    }
+#ifndef FILESYS_STUB
+    int updates = kernel->fileSystem->NumUpdates();
+    bool moved = FALSE;
+    int sector;
+
+    if (updates == compactedAt)
+	return;
+    if (compactAfter == -1)
+	passBegan = updates;
+    sector = kernel->fileSystem->CompactNext(compactAfter, &moved);
+    if (sector == -1) {			// the pass is over
+	compactAfter = -1;
+	compactedAt = passBegan;
+	return;
+    }
+    DEBUG(dbgFile, "Housekeeper " << (moved ? "moved" : "left") << " file "
+		<< sector);
+    compactAfter = sector;
+    if (moved)
+	numCompacted++;
+    else
+	numLeft++;
+#endif
+}
+
+//----------------------------------------------------------------------
+// Housekeeper::PrintStats
+// 	Print how much work the housekeeper did, for -S.
+//----------------------------------------------------------------------
+
+void
+Housekeeper::PrintStats()
+{
+    cout << "Housekeeper: " << numUnits << " units of work, "
+	 << numWritten << " sectors written back, " << numCompacted
+	 << " files compacted, " << numLeft << " left split\n";
+}
@@ -0,0 +1,73 @@
+// housekeep.h
+//	Data structures for the housekeeper: a kernel thread that does
+//	the file system's background work while there is nothing else
+//	to do, so that it is done by the time a program would wait for
+//	it.  Started with "-housekeep".
+//
+//	The housekeeper is the scheduler's background thread (see
+//	Scheduler::SetBackground): whenever it is ready, it runs only
+//	once the ready list is empty.  Thread::Sleep wakes it when it
+//	finds no thread ready, if there is work and the disk has nothing
+//	queued; it does one bounded unit of work at a time, yields to
+//	anyone who has become ready meanwhile, and goes back to sleep
+//	when the work is done, or the disk is wanted.  While it sleeps,
+//	it doesn't keep Nachos from idling, or from halting.
+//
+//	A unit of work is, first of all, writing back HousekeepBatch of
+//	the sectors dirty in the buffer cache, sweeping the disk in
+//	sector order like an elevator (see SynchDisk::WriteBackAfter).
+//	Once none are dirty, it is moving one split file into a single
+//	run of sectors, as -defrag does, going through the files in
+//	order of their header sectors (see FileSystem::CompactNext).  A
+//	pass over every file is made again only if the file system has
+//	changed since the last one began.
+//
+// Copyright (c) 1992-1996 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation 
+// of liability and disclaimer of warranty provisions.
+
+#ifndef HOUSEKEEP_H
+#define HOUSEKEEP_H
+
+#include "copyright.h"
+#include "utility.h"
+
+class Thread;
+
+const int HousekeepBatch = 8;	// dirty sectors written back in one unit
+
+// The following class defines the housekeeper.
+
+class Housekeeper {
+  public:
+    Housekeeper();		// Make the housekeeper's thread, asleep
+    ~Housekeeper();
+
+    bool Wake();		// No thread is ready: give the housekeeper
+				// the CPU, if it has work; FALSE if not
+    void Run();			// The body of its thread
+
+    void PrintStats();		// Print how much it did
+
+  private:
+    bool HasWork();		// Is there work, and the disk free for it?
+    void Step();		// Do one unit of it
+    void Park();		// Sleep until Wake
+
+    Thread *thread;		// the housekeeper's thread
+    bool started;		// has it been forked?
+    bool parked;		// is it asleep, waiting for Wake?
+    int sweepAt;		// next sector of the elevator sweep
+    int compactAfter;		// header sector the pass has got to,
+				// or -1 to start a new one
+    int passBegan;		// file system updates when this pass began
+    int compactedAt;		// and when the last one did, or -1 if
+				// there has been none
+
+    int numUnits;		// units of work done
+    int numWritten;		// sectors written back
+    int numCompacted;		// files moved into one run
+    int numLeft;		// and those left as they were
+};
+
+#endif // HOUSEKEEP_H
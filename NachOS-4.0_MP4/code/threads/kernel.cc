@@ -15,8 +15,16 @@
 #include "libtest.h"
 #include "string.h"
 #include "synchdisk.h"
+#include "filehdr.h"
+#include "freetree.h"
+#include "housekeep.h"
 #include "post.h"
 #include "synchconsole.h"
+#include "imagecache.h"
+#include "warmstart.h"
+#include "checkpoint.h"
+#include "pipe.h"
+#include "syscall.h"
 
 //----------------------------------------------------------------------
 // Kernel::Kernel
@@ -28,17 +36,42 @@ Kernel::Kernel(int argc, char **argv)
 {
     randomSlice = FALSE; 
     debugUserProg = FALSE;
+    numBreakAt = numWatchAt = 0;
+    blockSkew = 1;		// default: check interrupts every instruction
+    translateUser = FALSE;
     consoleIn = NULL;          // default is stdin
     consoleOut = NULL;         // default is stdout
+    printStats = FALSE;
+    benchName = NULL;
+    startTime = WallTime();
+    diskSchedule = CLOOKSchedule;
+    mapDisk = FALSE;
+    numDisks = 1;
+    diskLayout = StripedLayout;
+    stripeSectors = DefaultStripeSectors;
+    diskDevice = RotatingDevice;
+    writeThrough = FALSE;
+    mergeRequests = TRUE;
+    flushAge = 0;
+    housekeep = FALSE;
+    snapshotAction = KeepSnapshot;
+    checkpointTick = -1;
+    checkpointRuns = 1;
 #ifndef FILESYS_STUB
     formatFlag = FALSE;
+    placePolicy = TrackPlacement;
+    clusterSize = 1;
+    checksumFlag = FALSE;
+    warmStart = FALSE;
 #endif
     reliability = 1;            // network reliability, default is 1.0
     hostName = 0;               // machine id, also UNIX socket name
                                 // 0 is the default machine id
 								
 	// MP4 mod tag
-	execfileNum = 0; // dummy operation to keep valgrind happy
+    execfile = new char *[argc];	// more than there can be -e flags
+    execfileNum = 0;
+    threads = new HandleTable<Thread *>;
 								
     for (int i = 1; i < argc; i++) {
         if (strcmp(argv[i], "-rs") == 0) {
@@ -49,6 +82,21 @@ Kernel::Kernel(int argc, char **argv)
 	    	i++;
         } else if (strcmp(argv[i], "-s") == 0) {
             debugUserProg = TRUE;
+        } else if (strcmp(argv[i], "-break") == 0) {
+	    	ASSERT(i + 1 < argc && numBreakAt < MaxBreakpoints);
+	    	breakAt[numBreakAt++] = (int) strtol(argv[i + 1], NULL, 0);
+	    	i++;
+        } else if (strcmp(argv[i], "-watch") == 0) {
+	    	ASSERT(i + 1 < argc && numWatchAt < MaxWatchpoints);
+	    	watchAt[numWatchAt++] = (int) strtol(argv[i + 1], NULL, 0);
+	    	i++;
+        } else if (strcmp(argv[i], "-bs") == 0) {
+	    	ASSERT(i + 1 < argc);	// next argument is int
+	    	blockSkew = atoi(argv[i + 1]);
+	    	ASSERT(blockSkew >= 1);
+	    	i++;
+        } else if (strcmp(argv[i], "-jit") == 0) {
+            translateUser = TRUE;
 		} else if (strcmp(argv[i], "-e") == 0) {
         	execfile[++execfileNum]= argv[++i];
 			cout << execfile[execfileNum] << "\n";
@@ -63,7 +111,93 @@ Kernel::Kernel(int argc, char **argv)
 #ifndef FILESYS_STUB
 		} else if (strcmp(argv[i], "-f") == 0) {
 	    	formatFlag = TRUE;
+		} else if (strcmp(argv[i], "-fp") == 0) {
+	    	ASSERT(i + 1 < argc);
+	    	if (strcmp(argv[i + 1], "first") == 0) {
+		    	placePolicy = FirstFitPlacement;
+	    	} else if (strcmp(argv[i + 1], "bestfit") == 0) {
+		    	placePolicy = BestFitPlacement;
+	    	} else {
+		    	ASSERT(strcmp(argv[i + 1], "track") == 0);
+		    	placePolicy = TrackPlacement;
+	    	}
+	    	i++;
+		} else if (strcmp(argv[i], "-cl") == 0) {
+	    	ASSERT(i + 1 < argc);	// sectors per cluster, for -f
+	    	clusterSize = atoi(argv[i + 1]);
+	    	ASSERT(clusterSize >= 1 && clusterSize <= MaxClusterSize);
+	    	i++;
+		} else if (strcmp(argv[i], "-crc") == 0) {
+	    	checksumFlag = TRUE;	// for -f
+		} else if (strcmp(argv[i], "-warm") == 0) {
+	    	warmStart = TRUE;
 #endif
+		} else if (strcmp(argv[i], "-S") == 0) {
+	    	printStats = TRUE;
+		} else if (strcmp(argv[i], "-bench") == 0) {
+	    	ASSERT(i + 1 < argc);	// next argument names the run
+	    	benchName = argv[i + 1];
+	    	i++;
+		} else if (strcmp(argv[i], "-ds") == 0) {
+	    	ASSERT(i + 1 < argc);
+	    	if (strcmp(argv[i + 1], "fcfs") == 0) {
+		    	diskSchedule = FCFSSchedule;
+	    	} else if (strcmp(argv[i + 1], "sstf") == 0) {
+		    	diskSchedule = SSTFSchedule;
+	    	} else if (strcmp(argv[i + 1], "scan") == 0) {
+		    	diskSchedule = SCANSchedule;
+	    	} else {
+		    	ASSERT(strcmp(argv[i + 1], "clook") == 0);
+		    	diskSchedule = CLOOKSchedule;
+	    	}
+	    	i++;
+		} else if (strcmp(argv[i], "-mmap") == 0) {
+	    	mapDisk = TRUE;
+		} else if (strcmp(argv[i], "-ssd") == 0) {
+	    	diskDevice = FlashDevice;
+		} else if (strcmp(argv[i], "-raid") == 0) {
+	    	ASSERT(i + 2 < argc);	// the level, and the number of disks
+	    	if (strcmp(argv[i + 1], "1") == 0) {
+		    	diskLayout = MirroredLayout;
+	    	} else {
+		    	ASSERT(strcmp(argv[i + 1], "0") == 0);
+		    	diskLayout = StripedLayout;
+	    	}
+	    	numDisks = atoi(argv[i + 2]);
+	    	ASSERT(numDisks >= 2 && numDisks <= MaxDisks);
+	    	i += 2;
+		} else if (strcmp(argv[i], "-stripe") == 0) {
+	    	ASSERT(i + 1 < argc);	// sectors in a chunk, for -raid 0
+	    	stripeSectors = atoi(argv[i + 1]);
+	    	ASSERT(stripeSectors >= 1);
+	    	i++;
+		} else if (strcmp(argv[i], "-wt") == 0) {
+	    	writeThrough = TRUE;
+		} else if (strcmp(argv[i], "-nomerge") == 0) {
+	    	mergeRequests = FALSE;
+		} else if (strcmp(argv[i], "-flush") == 0) {
+	    	ASSERT(i + 1 < argc);	// ticks a sector may stay dirty
+	    	flushAge = atoi(argv[i + 1]);
+	    	ASSERT(flushAge > 0);
+	    	i++;
+		} else if (strcmp(argv[i], "-housekeep") == 0) {
+	    	housekeep = TRUE;
+		} else if (strcmp(argv[i], "-snapshot") == 0) {
+	    	ASSERT(i + 1 < argc);
+	    	if (strcmp(argv[i + 1], "take") == 0) {
+		    	snapshotAction = TakeSnapshot;
+	    	} else if (strcmp(argv[i + 1], "rollback") == 0) {
+		    	snapshotAction = RollBackSnapshot;
+	    	} else {
+		    	ASSERT(strcmp(argv[i + 1], "drop") == 0);
+		    	snapshotAction = DropSnapshot;
+	    	}
+	    	i++;
+		} else if (strcmp(argv[i], "-checkpoint") == 0) {
+	    	ASSERT(i + 2 < argc);	// the tick, and the number of runs
+	    	checkpointTick = atoi(argv[i + 1]);
+	    	checkpointRuns = atoi(argv[i + 2]);
+	    	i += 2;
         } else if (strcmp(argv[i], "-n") == 0) {
             ASSERT(i + 1 < argc);   // next argument is float
             reliability = atof(argv[i + 1]);
@@ -74,12 +208,20 @@ Kernel::Kernel(int argc, char **argv)
             i++;
         } else if (strcmp(argv[i], "-u") == 0) {
             cout << "Partial usage: nachos [-rs randomSeed]\n";
-	   		cout << "Partial usage: nachos [-s]\n";
+	   		cout << "Partial usage: nachos [-s] [-break addr] [-watch addr]\n";
+	   		cout << "Partial usage: nachos [-bs blockSkew] [-jit]\n";
             cout << "Partial usage: nachos [-ci consoleIn] [-co consoleOut]\n";
 #ifndef FILESYS_STUB
-	    	cout << "Partial usage: nachos [-nf]\n";
+	    	cout << "Partial usage: nachos [-nf] [-fp first|track|bestfit] [-cl sectors] [-crc]\n";
+	    	cout << "Partial usage: nachos [-warm]\n";
 #endif
-            cout << "Partial usage: nachos [-n #] [-m #]\n";
+            cout << "Partial usage: nachos [-ds fcfs|sstf|scan|clook] [-mmap] [-ssd]\n";
+            cout << "Partial usage: nachos [-raid 0|1 disks] [-stripe sectors]\n";
+            cout << "Partial usage: nachos [-wt] [-flush ticks] [-nomerge] [-housekeep]\n";
+            cout << "Partial usage: nachos [-snapshot take|rollback|drop]\n";
+            cout << "Partial usage: nachos [-n #] [-m #] [-S]\n";
+            cout << "Partial usage: nachos [-bench name]\n";
+            cout << "Partial usage: nachos [-checkpoint tick runs]\n";
 		}
     }
 }
@@ -99,22 +241,48 @@ Kernel::Initialize()
     // object to save its state. 
 
 	
-    currentThread = new Thread("main", threadNum++);		
+    currentThread = NewThread("main");
     currentThread->setStatus(RUNNING);
 
     stats = new Statistics();		// collect statistics
+    checkpoint = NULL;			// set before anything can tick
+    if (checkpointTick >= 0)
+	checkpoint = new Checkpoint(checkpointTick, checkpointRuns, numDisks);
     interrupt = new Interrupt;		// start up interrupt handling
     scheduler = new Scheduler();	// initialize the ready queue
-    alarm = new Alarm(randomSlice);	// start up time slicing
-    machine = new Machine(debugUserProg);
-    synchConsoleIn = new SynchConsoleInput(consoleIn); // input from stdin
-    synchConsoleOut = new SynchConsoleOutput(consoleOut); // output to stdout
-    synchDisk = new SynchDisk();    //
+    alarm = NULL;			// no time slicing until there is
+					// a second thread (see StartAlarm)
+    machine = new Machine(debugUserProg, blockSkew, translateUser);
+    for (int i = 0; i < numBreakAt; i++)
+	if (!machine->SetBreakpoint(breakAt[i]))
+	    cout << "Can't set a breakpoint at " << breakAt[i] << "\n";
+    for (int i = 0; i < numWatchAt; i++)
+	if (!machine->SetWatchpoint(watchAt[i], 4))
+	    cout << "Can't set a watchpoint at " << watchAt[i] << "\n";
+    synchConsoleIn = NULL;		// opened when first used (see
+    synchConsoleOut = NULL;		// getConsoleIn, getConsoleOut)
+    synchDisk = new SynchDisk(diskSchedule, mapDisk, snapshotAction,
+				numDisks, diskLayout, stripeSectors, diskDevice);
+    synchDisk->SetWriteThrough(writeThrough);
+    synchDisk->SetMerging(mergeRequests);
+    imageCache = new ImageCache();
+#ifndef FILESYS_STUB
+    if (warmStart && !formatFlag) {
+	WarmStart warm(numDisks);	// before the file system reads
+					// anything
+	warm.Load();
+    }
+#endif
+    housekeeper = NULL;			// not until the file system is up
+    fileSystem = NULL;			// (files opened while it is set up
+					// aren't counted; see OpenFile::Access)
 #ifdef FILESYS_STUB
     fileSystem = new FileSystem();
 #else
-    fileSystem = new FileSystem(formatFlag);
+    fileSystem = new FileSystem(formatFlag, placePolicy, clusterSize, checksumFlag);
 #endif // FILESYS_STUB
+    if (housekeep)
+	housekeeper = new Housekeeper();
 
 	// MP4 mod tag
     /*
@@ -131,36 +299,115 @@ Kernel::Initialize()
 // 	Since Nachos does not disable Timer, Console after all threads complete,
 //	which will result in generating infinite interrupts. We manually disable timer,
 //	console, etc. after all threads complete.
+//
+//	The timer is left going while a thread sleeps in Alarm::WaitUntil,
+//	such as the -flush thread, since only a timer interrupt will wake
+//	it; "no thread ready" doesn't mean all threads are done then.
 //----------------------------------------------------------------------
 void
 Kernel::PrepareToEnd()
 {
-	alarm->Disable();
-	synchConsoleIn->Disable();
+	if (alarm != NULL && !alarm->AnySleeping())
+		alarm->Disable();
+	if (synchConsoleIn != NULL)
+		synchConsoleIn->Disable();
+}
+
+//----------------------------------------------------------------------
+// Kernel::StartAlarm
+// 	Start the timer, for time slicing, if it isn't going yet.  Called
+//	when a thread is forked; until then only the main thread runs,
+//	and there is nothing to switch to, so commands that just use the
+//	file system never take a timer interrupt.
+//----------------------------------------------------------------------
+
+void
+Kernel::StartAlarm()
+{
+    if (alarm == NULL)
+	alarm = new Alarm(randomSlice);
+}
+
+//----------------------------------------------------------------------
+// Kernel::getConsoleIn, Kernel::getConsoleOut
+// 	Return the synchronized console, opening it the first time.  The
+//	console input device polls for keystrokes all the time it is
+//	open, so it is only opened by whoever needs it.
+//----------------------------------------------------------------------
+
+SynchConsoleInput *
+Kernel::getConsoleIn()
+{
+    if (synchConsoleIn == NULL)
+	synchConsoleIn = new SynchConsoleInput(consoleIn); // input from stdin
+    return synchConsoleIn;
+}
+
+SynchConsoleOutput *
+Kernel::getConsoleOut()
+{
+    if (synchConsoleOut == NULL)
+	synchConsoleOut = new SynchConsoleOutput(consoleOut); // output to stdout
+    return synchConsoleOut;
 }
 
 //----------------------------------------------------------------------
 // Kernel::~Kernel
 // 	Nachos is halting.  De-allocate global data structures.
+//	The housekeeper goes first, so that it is not woken while the
+//	rest goes.  Then the file system, since writing back the disk
+//	buffer cache still needs the disk, interrupts and the scheduler.
 //----------------------------------------------------------------------
 
 Kernel::~Kernel()
 {
+    Housekeeper *idle = housekeeper;
+
+    housekeeper = NULL;			// no more background work
+    WaitFileWrites();			// the programs' output comes before
+					// the statistics
+    if (printStats && idle != NULL)
+	idle->PrintStats();
+    delete idle;
+#ifndef FILESYS_STUB
+    if (printStats)
+	fileSystem->PrintStats();
+#endif
+    delete fileSystem;
+    delete checkpoint;
+    if (printStats) {
+	synchDisk->PrintStats();
+	imageCache->PrintStats();
+    }
+#ifndef FILESYS_STUB
+    if (warmStart) {
+	WarmStart warm(numDisks);	// once everything is written back
+
+	warm.Save();
+    }
+#endif
+    delete imageCache;
+    delete synchDisk;
+    if (printStats)
+	stats->Print();
+    if (benchName != NULL)
+	stats->PrintBench(benchName, WallTime() - startTime);
     delete stats;
     delete interrupt;
     delete scheduler;
+    delete threads;			// no thread is deleted after this
+    delete [] execfile;
     delete alarm;
     delete machine;
     delete synchConsoleIn;
     delete synchConsoleOut;
-    delete synchDisk;
-    delete fileSystem;
 	
 	// Mp4 mod tag
 	/*
     delete postOfficeIn;
     delete postOfficeOut;
     */
+	delete debug;
 	
     Exit(0);
 }
@@ -176,6 +423,11 @@ Kernel::ThreadSelfTest() {
    SynchList<int> *synchList;
    
    LibSelfTest();		// test library routines
+#ifndef FILESYS_STUB
+   FreeExtentTree *extents = new FreeExtentTree(0, 1);
+   extents->SelfTest();		// test the free extent trees
+   delete extents;
+#endif
    
    currentThread->SelfTest();	// test thread switching
    
@@ -192,6 +444,46 @@ Kernel::ThreadSelfTest() {
 
 }
 
+//----------------------------------------------------------------------
+// StressThread
+// 	Body of each SchedulerStress thread: give up the CPU, over and
+//	over, then say we're done.
+//----------------------------------------------------------------------
+
+static const int StressRounds = 1000;	// Yields by each thread
+
+static void
+StressThread(Semaphore *done)
+{
+    for (int i = 0; i < StressRounds; i++)
+	kernel->currentThread->Yield();
+    done->V();
+}
+
+//----------------------------------------------------------------------
+// Kernel::SchedulerStress
+// 	Fork "numThreads" threads that do nothing but Yield to each other,
+//	and wait for them all to finish.  Every Yield is a context
+//	switch, so this measures how fast the scheduler and thread
+//	switch are.
+//----------------------------------------------------------------------
+
+void
+Kernel::SchedulerStress(int numThreads)
+{
+    Semaphore *done = new Semaphore("stress done", 0);
+    Thread *t;
+
+    for (int i = 0; i < numThreads; i++) {
+	t = NewThread("stress");
+	ASSERT(t != NULL);
+	t->Fork((VoidFunctionPtr) StressThread, (void *) done);
+    }
+    for (int i = 0; i < numThreads; i++)
+	done->P();
+    delete done;
+}
+
 //----------------------------------------------------------------------
 // Kernel::ConsoleTest
 //      Test the synchconsole
@@ -207,8 +499,8 @@ Kernel::ConsoleTest() {
     cout.flush();
 
     do {
-        ch = synchConsoleIn->GetChar();
-        if(ch != EOF) synchConsoleOut->PutChar(ch);   // echo it!
+        ch = getConsoleIn()->GetChar();
+        if(ch != EOF) getConsoleOut()->PutChar(ch);   // echo it!
     } while (ch != EOF);
 
     cout << "\n";
@@ -274,6 +566,13 @@ Kernel::NetworkTest() {
     // Then we're done!
 }
 
+//----------------------------------------------------------------------
+// ForkExecute
+// 	Load and run a user program, in the thread made for it by Exec.
+//	Loading happens here rather than in Exec, so that while this
+//	thread waits for the disk, others can load theirs, or run.
+//----------------------------------------------------------------------
+
 void ForkExecute(Thread *t)
 {
 	if ( !t->space->Load(t->getName()) ) {
@@ -284,8 +583,60 @@ void ForkExecute(Thread *t)
 
 }
 
+//----------------------------------------------------------------------
+// FlushThread
+// 	The body of the flusher thread: every "*age" / 2 ticks, start
+//	writing back each sector that has been dirty in the buffer cache
+//	for "*age" ticks or more, so that a streaming writer runs at cache
+//	speed while what it wrote still reaches the disk before long.
+//	It only runs alongside user programs, or a -replay, which end in
+//	Halt; a thread that never finishes would keep Nachos from idling
+//	out.
+//----------------------------------------------------------------------
+
+static void
+FlushThread(int *age)
+{
+	for (;;) {
+		kernel->alarm->WaitUntil(max(*age / 2, 1));
+		int n = kernel->synchDisk->WriteBackOlder(
+					kernel->stats->totalTicks - *age);
+
+		if (n > 0) {
+			DEBUG(dbgDisk, "Flusher writing back " << n << " sectors");
+		}
+	}
+}
+
+//----------------------------------------------------------------------
+// Kernel::StartFlusher
+// 	Start the flusher thread, if -flush asked for one.  Since it never
+//	finishes, it is only started for runs that end in Halt: those of
+//	user programs, and -replay.
+//----------------------------------------------------------------------
+
+void
+Kernel::StartFlusher()
+{
+	if (flushAge > 0) {
+		Thread *t = NewThread("flusher");
+
+		t->Fork((VoidFunctionPtr) FlushThread, (void *) &flushAge);
+	}
+}
+
+//----------------------------------------------------------------------
+// Kernel::ExecAll
+// 	Start every program given with -e.  Each is loaded by its own
+//	thread, so their disk reads are queued together and overlap, and
+//	the first to finish loading starts running while the others are
+//	still waiting for theirs.
+//----------------------------------------------------------------------
+
 void Kernel::ExecAll()
 {
+	if (execfileNum > 0)
+		StartFlusher();
 	for (int i=1;i<=execfileNum;i++) {
 		int a = Exec(execfile[i]);
 	}
@@ -296,12 +647,13 @@ void Kernel::ExecAll()
 
 int Kernel::Exec(char* name)
 {
-	t[threadNum] = new Thread(name, threadNum);
-	t[threadNum]->space = new AddrSpace();
-	t[threadNum]->Fork((VoidFunctionPtr) &ForkExecute, (void *)t[threadNum]);
-	threadNum++;
+	Thread *t = NewThread(name);
 
-	return threadNum-1;
+	if (t == NULL)
+		return -1;
+	t->space = new AddrSpace();
+	t->Fork((VoidFunctionPtr) &ForkExecute, (void *)t);
+	return t->getID();
 /*
     cout << "Total threads number is " << execfileNum << endl;
     for (int n=1;n<=execfileNum;n++) {
@@ -329,29 +681,247 @@ int Kernel::Exec(char* name)
 //  cout << "after ThreadedKernel:Run();" << endl;  // unreachable
 }
 
+//----------------------------------------------------------------------
+// Kernel::NewThread
+// 	Make a thread called "name", and give it an ID -- its handle in
+//	the table of threads -- that getThread finds it by until it is
+//	deleted, and that is stale after.  Returns NULL if there are
+//	MaxHandleSlots threads already.
+//----------------------------------------------------------------------
+
+Thread *
+Kernel::NewThread(char *name)
+{
+	int id = threads->Enter();
+
+	if (id == -1)
+		return NULL;
+	*threads->Lookup(id) = new Thread(name, id);
+	return *threads->Lookup(id);
+}
+
+//----------------------------------------------------------------------
+// Kernel::ForgetThread
+// 	Called when "thread" is deleted: give back its ID, if NewThread
+//	gave it one.  Threads made directly have made-up IDs, which
+//	getThread doesn't find.
+//----------------------------------------------------------------------
+
+void
+Kernel::ForgetThread(Thread *thread)
+{
+	if (getThread(thread->getID()) == thread)
+		threads->Remove(thread->getID());
+}
+
 #ifndef FILESYS_STUB
+//----------------------------------------------------------------------
+// UserFiles
+//	The open file table of the user program making a system call.
+//	OpenFileIds are indexes into it, so they only mean something to
+//	the program that opened them.
+//----------------------------------------------------------------------
+
+static FileTable *
+UserFiles()
+{
+	ASSERT(kernel->currentThread->space != NULL);
+	return kernel->currentThread->space->files;
+}
+
 int Kernel::CreateFile(char *filename, int length)
 {
 	return (int)fileSystem->Create(filename, length);
 }
 
+int Kernel::RemoveFile(char *filename)
+{
+	return (int)fileSystem->Remove(filename);
+}
+
 int Kernel::OpenFile(char *filename)
 {
-	return (int)fileSystem->Open(filename);
+	class OpenFile *openFile = fileSystem->Open(filename);
+	int id;
+
+	if (openFile == NULL)
+		return 0;
+	id = UserFiles()->Add(openFile);
+	if (id < 0) {			// too many files open
+		delete openFile;
+		return 0;
+	}
+	return id;
 }
 
 int Kernel::CloseFile(int id)
 {
-	return fileSystem->Close(id);
+	return UserFiles()->Close(id) ? 1 : 0;
 }
 
+int Kernel::DupFile(int id)
+{
+	return UserFiles()->Dup(id);
+}
+
+//----------------------------------------------------------------------
+// Kernel::WriteFile, Kernel::ReadFile
+//	Write to or read from an open file, or a pipe, or the console.
+//	A write to a pipe waits until all of it has gone in (or the pipe
+//	has no readers left); a read takes whatever is there.
+//	Reading a write end, or writing a read end, fails.  A read from
+//	the console stops after a newline.
+//----------------------------------------------------------------------
+
 int Kernel::WriteFile(char *buffer, int size, int id)
 {
-	return fileSystem->Write(buffer, size, id);
+	PipeBuffer *pipe = UserFiles()->GetPipe(id, TRUE);
+	int done = 0;
+
+	if (id == SysConsoleOutput) {
+		for (; done < size; done++)
+			getConsoleOut()->PutChar(buffer[done]);
+		return done;
+	}
+	if (pipe == NULL) {
+		if (UserFiles()->GetPipe(id, FALSE) != NULL)
+			return -1;
+		return fileSystem->Write(buffer, size, UserFiles()->Get(id));
+	}
+	while (done < size) {
+		int n = pipe->Write(buffer + done, size - done);
+
+		if (n < 0)
+			return (done > 0) ? done : -1;
+		done += n;
+	}
+	return done;
 }
 int Kernel::ReadFile(char *buffer, int size, int id)
 {
-	return fileSystem->Read(buffer, size, id);
+	PipeBuffer *pipe = UserFiles()->GetPipe(id, FALSE);
+	int done = 0;
+
+	if (id == SysConsoleInput) {
+		while (done < size) {
+			char ch = getConsoleIn()->GetChar();
+
+			if (ch == EOF)
+				break;
+			buffer[done++] = ch;
+			if (ch == '\n')
+				break;
+		}
+		return done;
+	}
+	if (pipe == NULL) {
+		if (UserFiles()->GetPipe(id, TRUE) != NULL)
+			return -1;
+		return fileSystem->Read(buffer, size, UserFiles()->Get(id));
+	}
+	return pipe->Read(buffer, size);
+}
+
+//----------------------------------------------------------------------
+// Kernel::MakePipe
+//	Make a pipe, and give its read end and its write end ids in the
+//	calling program's open file table, storing them in "ids".
+//	Returns 0, or -1 if the table hasn't room for both.
+//----------------------------------------------------------------------
+
+//----------------------------------------------------------------------
+// Kernel::SyncFile, Kernel::SyncAll
+//	Write an open file's data, or everything, from the buffer cache
+//	to the disk, and wait until it is there.  SyncFile returns 0, or
+//	-1 if "id" isn't an open file (a pipe or the console, say).
+//----------------------------------------------------------------------
+
+int Kernel::SyncFile(int id)
+{
+	class OpenFile *openFile = UserFiles()->Get(id);
+
+	if (openFile == NULL)
+		return -1;
+	openFile->Sync();
+	return 0;
+}
+
+int Kernel::SyncAll()
+{
+	synchDisk->Sync();
+	return 0;
+}
+
+//----------------------------------------------------------------------
+// Kernel::AdviseFile
+//	Take a hint about how the "length" bytes of open file "id" from
+//	"offset" will be used -- to the end of the file, if "length" is
+//	0.  SEQUENTIAL and RANDOM are about the whole file, and set how
+//	far it is read ahead; WILLNEED starts reading the bytes into the
+//	buffer cache, and DONTNEED lets the cache reuse them.  Returns 0,
+//	or -1 if "id" isn't an open file or the hint isn't one of those.
+//----------------------------------------------------------------------
+
+int Kernel::AdviseFile(int id, int offset, int length, int hint)
+{
+	class OpenFile *openFile = UserFiles()->Get(id);
+
+	if (openFile == NULL || offset < 0 || length < 0)
+		return -1;
+	if (length == 0)
+		length = openFile->Length() - offset;
+	switch (hint) {
+	  case AdviseNormal:
+		openFile->SetHint(NormalAccess);
+		break;
+	  case AdviseSequential:
+		openFile->SetHint(SequentialAccess);
+		break;
+	  case AdviseRandom:
+		openFile->SetHint(RandomAccess);
+		break;
+	  case AdviseWillNeed:
+		openFile->Prefetch(offset, length);
+		break;
+	  case AdviseDontNeed:
+		openFile->Discard(offset, length);
+		break;
+	  default:
+		return -1;
+	}
+	return 0;
+}
+
+int Kernel::MakePipe(int *ids)
+{
+	PipeBuffer *pipe = new PipeBuffer;
+
+	ids[0] = UserFiles()->AddPipe(pipe, FALSE);
+	if (ids[0] < 0) {
+		delete pipe;
+		return -1;
+	}
+	ids[1] = UserFiles()->AddPipe(pipe, TRUE);
+	if (ids[1] < 0) {
+		UserFiles()->Close(ids[0]);	// deletes the pipe
+		return -1;
+	}
+	return 0;
+}
+
+int Kernel::SeekFile(int position, int id)
+{
+	return fileSystem->Seek(position, UserFiles()->Get(id));
+}
+
+int Kernel::WriteFileAt(char *buffer, int size, int position, int id)
+{
+	return fileSystem->WriteAt(buffer, size, position, UserFiles()->Get(id));
+}
+
+int Kernel::ReadFileAt(char *buffer, int size, int position, int id)
+{
+	return fileSystem->ReadAt(buffer, size, position, UserFiles()->Get(id));
 }
 #endif 
 
@@ -18,12 +18,17 @@
 #include "alarm.h"
 #include "filesys.h"
 #include "machine.h"
+#include "handle.h"
+#include "disk.h"
 
 class PostOfficeInput;
 class PostOfficeOutput;
 class SynchConsoleInput;
 class SynchConsoleOutput;
 class SynchDisk;
+class ImageCache;
+class Housekeeper;
+class Checkpoint;
 
 
 
@@ -42,18 +47,43 @@ class Kernel {
 	
 	void ExecAll();
 	int Exec(char* name);
+    void StartFlusher();	// start the -flush thread, if asked for;
+				// the run must then end in Halt
     void ThreadSelfTest();	// self test of threads and synchronization
+    void SchedulerStress(int numThreads);
+				// make threads compete for the CPU
 	
     void ConsoleTest();         // interactive console self test
     void NetworkTest();         // interactive 2-machine network test
-	Thread* getThread(int threadID){return t[threadID];}    
+	Thread* getThread(int threadID)
+		{ Thread **p = threads->Lookup(threadID);
+		  return (p == NULL) ? NULL : *p; }
+				// NULL if "threadID" is stale
+	Thread *NewThread(char *name);	// a thread with an ID of its own,
+				// or NULL if there are too many
+	void ForgetThread(Thread *thread);	// it is being deleted
+    void StartAlarm();		// start time slicing, if not yet started
+    SynchConsoleInput *getConsoleIn();	// the console, opened on
+    SynchConsoleOutput *getConsoleOut();	// first use
+    void RestartWallClock() { startTime = WallTime(); }
+				// time the benchmark from now on
 
 	#ifndef FILESYS_STUB	
 		int CreateFile(char* filename, int length); // fileSystem call
+		int RemoveFile(char *filename);	// and to delete one
 		int OpenFile(char *filename); // open file system call
 		int CloseFile(int id);
+		int DupFile(int id);
 		int WriteFile(char *buffer, int size, int id);
 		int ReadFile(char *buffer, int size, int id);
+		int SeekFile(int position, int id);
+		int WriteFileAt(char *buffer, int size, int position, int id);
+		int ReadFileAt(char *buffer, int size, int position, int id);
+		int MakePipe(int *ids);	// ids of a new pipe's two ends
+		int SyncFile(int id);	// write a file's dirty sectors to disk
+		int SyncAll();		// and everyone's
+		int AdviseFile(int id, int offset, int length, int hint);
+					// how a file will be read
 	#endif
 
 // These are public for notational convenience; really, 
@@ -63,30 +93,64 @@ class Kernel {
     Scheduler *scheduler;	// the ready list
     Interrupt *interrupt;	// interrupt status
     Statistics *stats;		// performance metrics
-    Alarm *alarm;		// the software alarm clock    
+    Alarm *alarm;		// the software alarm clock, or NULL
+				// before the first Fork
     Machine *machine;           // the simulated CPU
-    SynchConsoleInput *synchConsoleIn;
+    SynchConsoleInput *synchConsoleIn;	// NULL until first used
     SynchConsoleOutput *synchConsoleOut;
     SynchDisk *synchDisk;
     FileSystem *fileSystem;     
+    ImageCache *imageCache;	// executables recently loaded
+    Housekeeper *housekeeper;	// works while nothing else runs, or NULL
     PostOfficeInput *postOfficeIn;
     PostOfficeOutput *postOfficeOut;
+    Checkpoint *checkpoint;	// where to fork the runs from, or NULL
 
     int hostName;               // machine identifier
 
   private:
 
-	Thread* t[10];
-	char*   execfile[10];
-	int execfileNum;
-	int threadNum;
+	HandleTable<Thread *> *threads;	// threads by ID
+	char **execfile;		// programs to run, from -e; 1 to
+	int execfileNum;		// execfileNum
     bool randomSlice;		// enable pseudo-random time slicing
     bool debugUserProg;         // single step user program
+    int breakAt[MaxBreakpoints];	// user PCs to stop at, from -break
+    int numBreakAt;
+    int watchAt[MaxWatchpoints];	// and words to watch, from -watch
+    int numWatchAt;
+    int blockSkew;		// max user instructions run between
+				// interrupt checks (1 = every instruction)
+    bool translateUser;		// run user code from translated blocks
     double reliability;         // likelihood messages are dropped
     char *consoleIn;            // file to read console input from
     char *consoleOut;           // file to send console output to
+    bool printStats;		// print performance statistics at halt
+    char *benchName;		// print a benchmark result at halt, with
+				// this name, or NULL
+    double startTime;		// host time at startup, for benchName
+    DiskSchedule diskSchedule;	// order in which disk requests are served
+    bool mapDisk;		// map the disk's UNIX file into memory
+    int numDisks;		// disks the file system is spread over
+    ArrayLayout diskLayout;	// and how, if there are several
+    int stripeSectors;		// sectors in a chunk, if striped
+    DiskDevice diskDevice;	// the kind of disk, for its timing
+    bool writeThrough;		// write sectors to disk at once, rather
+				// than leaving them in the buffer cache
+    bool mergeRequests;		// merge adjacent disk requests?
+    int flushAge;		// run a flusher for sectors dirty this
+				// many ticks, or 0
+    bool housekeep;		// run the housekeeper?
+    SnapshotAction snapshotAction;	// what to do with the disk's snapshot
+    int checkpointTick;		// when to checkpoint, or -1
+    int checkpointRuns;		// how many runs to fork from it
 #ifndef FILESYS_STUB
     bool formatFlag;          // format the disk if this is true
+    PlacementPolicy placePolicy;	// where new files go on the disk
+    int clusterSize;			// sectors per cluster, if formatting
+    bool checksumFlag;			// keep sector checksums, if formatting
+    bool warmStart;			// fill the caches as the last run
+					// left them, and save them at halt?
 #endif
 };
 
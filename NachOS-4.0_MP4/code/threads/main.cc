@@ -3,16 +3,32 @@
 //	operating system kernel.  
 //
 // Usage: nachos -d <debugflags> -rs <random seed #>
-//              -s -x <nachos file> -ci <consoleIn> -co <consoleOut>
-//              -f -cp <unix file> <nachos file>
-//              -p <nachos file> -r <nachos file> -l -D
+//              -s -break <addr> -watch <addr>
+//              -bs <block skew> -jit -x <nachos file> -ci <consoleIn> -co <consoleOut>
+//              -f -fp <first|track|bestfit> -cl <sectors> -crc -warm -cp <unix file> <nachos file>
+//              -cpout <nachos file> <unix file> -clone <nachos file> <nachos file>
+//              -cpm <manifest> -b <script> -replay <trace>
+//              -p <nachos file> -r <nachos file> -l -D -defrag -verify
+//              -ds <fcfs|sstf|scan|clook> -mmap -ssd -snapshot <take|rollback|drop>
+//              -raid <0|1> <disks> -stripe <sectors> -wt -flush <ticks> -nomerge
+//              -housekeep
 //              -n <network reliability> -m <machine id>
-//              -z -K -C -N
+//              -z -K -C -N -S -stress <threads> -bench <name>
+//              -checkpoint <tick> <runs>
 //
 //    -d causes certain debugging messages to be printed (see debug.h)
 //    -rs causes Yield to occur at random (but repeatable) spots
 //    -z prints the copyright message
 //    -s causes user programs to be executed in single-step mode
+//    -break drops into the same debugger when the user instruction at
+//	  the given address (decimal, or hex with 0x) is about to run,
+//	  and -watch once a user instruction has stored into the word at
+//	  the given address; until then programs run at full speed.  The
+//	  debugger can set more (see Machine::SetBreakpoint)
+//    -bs runs user code a basic block at a time, checking for
+//	  interrupts only at block ends (at most # instructions apart)
+//    -jit runs straight-line user code from blocks translated into
+//	  host routines, with the exact timing of -bs 1 (see blockcache.h)
 //    -x runs a user program
 //    -ci specify file for console input (stdin is the default)
 //    -co specify file for console output (stdout is the default)
@@ -21,14 +37,100 @@
 //    -K run a simple self test of kernel threads and synchronization
 //    -C run an interactive console test
 //    -N run a two-machine network test (see Kernel::NetworkTest)
+//    -S prints performance statistics when Nachos halts
+//    -stress runs # threads that just Yield to each other, to time
+//	  the scheduler (see Kernel::SchedulerStress)
+//    -bench prints a one-line, machine-readable summary of the run
+//	  when Nachos halts: host time, and simulated instructions,
+//	  context switches and sector I/Os per host second (see
+//	  Statistics::PrintBench, and the "bench" target in the Makefile)
+//    -ds chooses the order queued disk requests are served in: first
+//	  come first served, shortest seek first, elevator, or circular
+//	  elevator (the default)
+//    -mmap maps the disk's UNIX file into memory, so that sectors
+//	  are copied rather than read and written with system calls
+//	  (the simulated timing is the same)
+//    -ssd times the disk as a solid-state drive rather than a rotating
+//	  disk: the same sectors, but no seeks, asymmetric read and
+//	  write times, erase blocks and garbage collection, and channels
+//	  working at once; -S prints its write amplification (see flash.h)
+//    -raid spreads the file system over the given number of disks
+//	  (2 up to 8), each with its own UNIX file, DISK_<m>.<d> after
+//	  the first: level 0 stripes it across them, level 1 mirrors
+//	  it on each.  A disk must be used with the -raid it was
+//	  formatted with (see synchdisk.h)
+//    -stripe sets how many consecutive sectors (8, the default) -raid 0
+//	  puts on one disk before going on to the next
+//    -wt mounts the disk write-through: each sector written goes to
+//	  the disk before the write returns, rather than waiting in the
+//	  buffer cache (see synchdisk.h)
+//    -nomerge sends the disk each queued request as it is, rather than
+//	  merging requests for adjacent sectors into one, and dropping
+//	  writes that later ones supersede (see synchdisk.h)
+//    -flush starts a thread, once user programs run, that writes back
+//	  every sector that has been dirty in the buffer cache for the
+//	  given number of ticks (it looks twice that often)
+//    -housekeep runs a thread whenever no other thread is ready and the
+//	  disk has nothing queued, that writes back the dirty sectors of
+//	  the buffer cache, in sector order, then moves each split file
+//	  no one has open into one run of sectors, as -defrag does; -S
+//	  prints how much it did (see housekeep.h)
+//    -snapshot, before anything else uses the disk, takes a snapshot
+//	  of it as it is, rolls it back to the snapshot taken last, or
+//	  drops the snapshot, keeping what has been written since.  A
+//	  snapshot costs nothing to take or roll back to, however full
+//	  the disk (see disk.h)
+//    -checkpoint runs the simulation to the given tick, then runs the
+//	  rest of it from there the given number of times, each from
+//	  the same state -- disk included (see checkpoint.h)
 //
 //    Filesystem-related flags:
 //    -f forces the Nachos disk to be formatted
+//    -fp chooses where new files go: "first" free sectors, near
+//	  their directory's "track" (the default), or the "bestfit" --
+//	  the shortest run of free sectors each fits in (see freetree.h)
+//    -cl sets how many consecutive sectors (1, the default, up to 16)
+//	  the disk being formatted by -f allocates file data in; a disk
+//	  keeps the cluster size it was formatted with
+//    -crc makes the disk being formatted by -f keep a checksum of
+//	  every sector, checked each time the sector is read (see
+//	  checksum.h)
+//    -warm starts with the caches filled as the last -warm run that
+//	  halted left them, if the disk hasn't been written since: the
+//	  file system's metadata in the buffer cache, and the images of
+//	  programs run (see warmstart.h)
 //    -cp copies a file from UNIX to Nachos
-//    -p prints a Nachos file to stdout
+//    -cpz does too, keeping the Nachos file compressed: it takes fewer
+//	  sectors, and reading any part of it decompresses only the
+//	  chunk that part is in
+//    -cpm builds a Nachos file system from a manifest of UNIX files
+//	  and Nachos directories, all in one run (use with -f to make a
+//	  fresh disk image; see Populate below)
+//    -b runs the file system commands in a script (or on stdin, if
+//	  the script is "-"), one after another in this one run (see
+//	  Batch below)
+//    -replay makes the file system calls and sector requests of a
+//	  trace, each at the tick it was recorded at, with no user
+//	  program; then prints their response times and halts, -S
+//	  printing the statistics of a full run (see replay.h)
+//    -cpout copies a file from Nachos to UNIX
+//    -clone makes a new Nachos file with the contents of another,
+//	  sharing its data sectors until either is written, so that
+//	  only the new header and index blocks are written (see
+//	  refcount.h)
+//    -p prints a Nachos file to stdout; like -cpout, it reads the file
+//	a run of sectors at a time, and writes them whole
 //    -r removes a Nachos file from the file system
 //    -l lists the contents of the Nachos directory
+//    -ll and -llr list a directory, or the tree under it (as -lr does),
+//	  with the size of each file; the sizes are kept in the
+//	  directories, so no file header is read
 //    -D prints the contents of the entire file system 
+//    -defrag moves the data of each file into one run of consecutive
+//	  sectors where it can, printing how fragmented the files and
+//	  the free space were before and after
+//    -verify reads the whole disk, reporting each sector that doesn't
+//	  match its checksum
 //
 //  Note: the file system flags are not used if the stub filesystem
 //        is being used
@@ -44,7 +146,10 @@
 #include "main.h"
 #include "filesys.h"
 #include "openfile.h"
+#include "replay.h"
 #include "sysdep.h"
+#include "memops.h"
+#include <fstream>
 
 // global variables
 Kernel *kernel;
@@ -64,21 +169,26 @@ Cleanup(int x)
 }
 
 //-------------------------------------------------------------------
-// Constant used by "Copy" and "Print"
-//   It is the number of bytes read from the Unix file (for Copy)
-//   or the Nachos file (for Print) by each read operation
+// Constant used by "Export" (and so "Print")
+//   It is the number of bytes read from the Nachos file, and written
+//   to the UNIX file, by each read and write operation: enough
+//   sectors for the disk to read them in a few requests
 //-------------------------------------------------------------------
-static const int TransferSize = 128;
+static const int ExportSize = 64 * SectorSize;
 
 
 #ifndef FILESYS_STUB
 //----------------------------------------------------------------------
 // Copy
-//      Copy the contents of the UNIX file "from" to the Nachos file "to"
+//      Copy the contents of the UNIX file "from" to the Nachos file "to".
+//	The Nachos file is created with all its space, and the UNIX file
+//	is read whole, so the data can go to the disk a run of sectors
+//	at a time (see OpenFile::Load).  If "compress", it is created
+//	empty instead, and filled compressed (see OpenFile::LoadCompressed).
 //----------------------------------------------------------------------
 
 static void
-Copy(char *from, char *to)
+Copy(char *from, char *to, bool compress = FALSE)
 {
     int fd;
     OpenFile* openFile;
@@ -98,7 +208,7 @@ Copy(char *from, char *to)
 
 // Create a Nachos file of the same length
     DEBUG('f', "Copying file " << from << " of size " << fileLength <<  " to file " << to);
-    if (!kernel->fileSystem->Create(to, fileLength)) {   // Create Nachos file
+    if (!kernel->fileSystem->Create(to, compress ? 0 : fileLength)) {
         printf("Copy: couldn't create output file %s\n", to);
         Close(fd);
         return;
@@ -107,10 +217,14 @@ Copy(char *from, char *to)
     openFile = kernel->fileSystem->Open(to);
     ASSERT(openFile != NULL);
     
-// Copy the data in TransferSize chunks
-    buffer = new char[TransferSize];
-    while ((amountRead=ReadPartial(fd, buffer, sizeof(char)*TransferSize)) > 0)
-        openFile->Write(buffer, amountRead);    
+// Copy the data all at once
+    buffer = new char[fileLength + 1];
+    amountRead = ReadPartial(fd, buffer, fileLength);
+    if (amountRead > 0 && compress) {
+	if (openFile->LoadCompressed(buffer, amountRead) == 0)
+	    printf("Copy: no room for compressed file %s\n", to);
+    } else if (amountRead > 0)
+        openFile->Load(buffer, amountRead);    
     delete [] buffer;
 
 // Close the UNIX and the Nachos files
@@ -121,31 +235,69 @@ Copy(char *from, char *to)
 #endif // FILESYS_STUB
 
 //----------------------------------------------------------------------
-// Print
-//      Print the contents of the Nachos file "name".
+// Export
+//      Write the contents of the Nachos file "name" to the open UNIX
+//	file "fd", ExportSize bytes at a time: each is read from the
+//	Nachos file in one go, as runs of sectors through the buffer
+//	cache (with the rest read ahead, since the file is read
+//	straight through), and written with one system call.  Returns
+//	FALSE if the Nachos file can't be opened.
 //----------------------------------------------------------------------
 
-void
-Print(char *name)
+static bool
+Export(char *name, int fd)
 {
     OpenFile *openFile;    
-    int i, amountRead;
+    int amountRead;
     char *buffer;
 
-    if ((openFile = kernel->fileSystem->Open(name)) == NULL) {
-        printf("Print: unable to open file %s\n", name);
-        return;
-    }
+    if ((openFile = kernel->fileSystem->Open(name)) == NULL)
+        return FALSE;
+#ifndef FILESYS_STUB
+    openFile->SetHint(SequentialAccess);
+#endif
     
-    buffer = new char[TransferSize];
-    while ((amountRead = openFile->Read(buffer, TransferSize)) > 0)
-        for (i = 0; i < amountRead; i++)
-            printf("%c", buffer[i]);
+    buffer = new char[ExportSize];
+    while ((amountRead = openFile->Read(buffer, ExportSize)) > 0)
+        WriteFile(fd, buffer, amountRead);
     delete [] buffer;
 
     delete openFile;            // close the Nachos file
-    return;
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// Print
+//      Print the contents of the Nachos file "name", by exporting it
+//	to stdout.
+//----------------------------------------------------------------------
+
+void
+Print(char *name)
+{
+    fflush(stdout);		// anything printed so far goes first
+    cout.flush();
+    if (!Export(name, 1))
+        printf("Print: unable to open file %s\n", name);
+}
+
+#ifndef FILESYS_STUB
+//----------------------------------------------------------------------
+// CopyOut
+//      Copy the contents of the Nachos file "from" to the UNIX file
+//	"to", which is created, or replaced if it exists.
+//----------------------------------------------------------------------
+
+static void
+CopyOut(char *from, char *to)
+{
+    int fd = OpenForWrite(to);
+
+    if (!Export(from, fd))
+        printf("CopyOut: unable to open file %s\n", from);
+    Close(fd);
 }
+#endif // FILESYS_STUB
 
 //----------------------------------------------------------------------
 // MP4 mod tag
@@ -169,6 +321,142 @@ CreateDirectory(char *name)
 	
 }
 
+//----------------------------------------------------------------------
+// Populate
+// 	Build the Nachos file system from a manifest, in this one run,
+//	rather than with a "nachos -mkdir" or "nachos -cp" each: the disk
+//	is opened, and the bitmap and directories read, only once.  Each
+//	line of the manifest is a comment (starting with #), or one of
+//
+//	    dir <Nachos directory>
+//	    file <UNIX file> <Nachos file>
+//
+//	done in order, so a directory must come before what goes in it.
+//	A line that can't be parsed is reported and skipped.
+//
+//	"manifest" is the UNIX file to read
+//----------------------------------------------------------------------
+
+static void
+Populate(char *manifest)
+{
+    ifstream in(manifest);
+    char buf[600], what[10], from[256], to[256];
+    int line = 0, n;
+
+    if (!in) {
+	printf("Populate: couldn't open manifest %s\n", manifest);
+	return;
+    }
+    while (in.getline(buf, sizeof(buf))) {
+	line++;
+	if (buf[0] == '#' || sscanf(buf, " %9s", what) != 1)
+	    continue;			// comment or blank line
+	n = sscanf(buf, " %9s %255s %255s", what, from, to);
+	if (strcmp(what, "dir") == 0 && n == 2) {
+	    CreateDirectory(from);
+	} else if (strcmp(what, "file") == 0 && n == 3) {
+	    Copy(from, to);
+	} else {
+	    printf("Populate: %s:%d: expected \"dir <Nachos directory>\" "
+		   "or \"file <UNIX file> <Nachos file>\"\n", manifest, line);
+	}
+    }
+}
+
+//----------------------------------------------------------------------
+// Batch
+// 	Run file system commands, read one per line, in this one run of
+//	Nachos, so that the free map, the directories and the buffer
+//	cache all carry over from one command to the next.  Each line
+//	is a comment (starting with #), or a command written as it would
+//	be on the Nachos command line, one of
+//
+//	    -cp <UNIX file> <Nachos file>	-p <Nachos file>
+//	    -cpz <UNIX file> <Nachos file>	-cpout <Nachos file> <UNIX file>
+//	    -mkdir <Nachos directory>		-l <Nachos directory>
+//	    -r <Nachos file>			-lr <Nachos directory>
+//	    -rr <Nachos directory>		-cpm <manifest>
+//	    -ll <Nachos directory>		-llr <Nachos directory>
+//	    -D					-defrag
+//	    -verify				-clone <Nachos file> <Nachos file>
+//
+//	or "echo <text>", which just prints the text.  So a shell script
+//	of "nachos" commands becomes a script for Batch by dropping the
+//	"nachos" from each line.  A line that can't be parsed is reported
+//	and skipped.
+//
+//	"script" is the UNIX file to read, or "-" for stdin
+//----------------------------------------------------------------------
+
+static void
+Batch(char *script)
+{
+    istream *in = &cin;
+    char buf[600], what[10], arg[256], arg2[256];
+    int line = 0, n;
+
+    if (strcmp(script, "-") != 0) {
+	in = new ifstream(script);
+	if (!*in) {
+	    printf("Batch: couldn't open script %s\n", script);
+	    delete in;
+	    return;
+	}
+    }
+    while (in->getline(buf, sizeof(buf))) {
+	line++;
+	if (buf[0] == '#' || sscanf(buf, " %9s", what) != 1)
+	    continue;			// comment or blank line
+	if (strcmp(what, "echo") == 0) {
+	    char *text = strstr(buf, "echo") + 4;
+
+	    printf("%s\n", text + strspn(text, " \t"));
+	    continue;
+	}
+	n = sscanf(buf, " %9s %255s %255s", what, arg, arg2);
+	if (strcmp(what, "-cp") == 0 && n == 3) {
+	    Copy(arg, arg2);
+	} else if (strcmp(what, "-cpz") == 0 && n == 3) {
+	    Copy(arg, arg2, TRUE);
+	} else if (strcmp(what, "-cpout") == 0 && n == 3) {
+	    CopyOut(arg, arg2);
+	} else if (strcmp(what, "-clone") == 0 && n == 3) {
+	    kernel->fileSystem->Clone(arg, arg2);
+	} else if (strcmp(what, "-p") == 0 && n == 2) {
+	    Print(arg);
+	} else if (strcmp(what, "-mkdir") == 0 && n == 2) {
+	    CreateDirectory(arg);
+	} else if (strcmp(what, "-r") == 0 && n == 2) {
+	    kernel->fileSystem->Remove(arg);
+	} else if (strcmp(what, "-rr") == 0 && n == 2) {
+	    kernel->fileSystem->RecurRemoveDirectory(arg);
+	} else if (strcmp(what, "-l") == 0 && n == 2) {
+	    kernel->fileSystem->ListDirectory(arg);
+	} else if (strcmp(what, "-lr") == 0 && n == 2) {
+	    kernel->fileSystem->RecurListDirectory(arg);
+	} else if (strcmp(what, "-ll") == 0 && n == 2) {
+	    kernel->fileSystem->ListDirectory(arg, TRUE);
+	} else if (strcmp(what, "-llr") == 0 && n == 2) {
+	    kernel->fileSystem->RecurListDirectory(arg, TRUE);
+	} else if (strcmp(what, "-cpm") == 0 && n == 2) {
+	    Populate(arg);
+	} else if (strcmp(what, "-D") == 0 && n == 1) {
+	    kernel->fileSystem->Print();
+	} else if (strcmp(what, "-defrag") == 0 && n == 1) {
+	    kernel->fileSystem->Defragment();
+	} else if (strcmp(what, "-verify") == 0 && n == 1) {
+	    kernel->fileSystem->Verify();
+	} else {
+	    printf("Batch: %s:%d: unknown command: %s\n", script, line, buf);
+	}
+	fflush(stdout);
+	cout.flush();
+    }
+    if (in != &cin)
+	delete in;
+}
+
 //----------------------------------------------------------------------
 // main
 // 	Bootstrap the operating system kernel.  
@@ -192,18 +480,30 @@ main(int argc, char **argv)
     bool threadTestFlag = false;
     bool consoleTestFlag = false;
     bool networkTestFlag = false;
+    int stressThreads = 0;
 #ifndef FILESYS_STUB
     char *copyUnixFileName = NULL;    // UNIX file to be copied into Nachos
     char *copyNachosFileName = NULL;  // name of copied file in Nachos
+    bool copyCompressed = false;      // keep it compressed?
     char *printFileName = NULL; 
+    char *exportFileName = NULL;      // Nachos file to be copied out
+    char *exportUnixFileName = NULL;  // and the UNIX file it goes to
+    char *cloneFromName = NULL;       // Nachos file to be cloned
+    char *cloneToName = NULL;         // and the name of the clone
     char *removeFileName = NULL;
     bool dirListFlag = false;
     bool dumpFlag = false;
+    bool defragFlag = false;
+    bool verifyFlag = false;
 	// MP4 mod tag
 	char *createDirectoryName = NULL;
 	char *listDirectoryName = NULL;
+	char *manifestName = NULL;
+	char *batchName = NULL;
+	char *replayName = NULL;
 	bool mkdirFlag = false;
 	bool recursiveListFlag = false;
+	bool listSizesFlag = false;
 	bool recursiveRemoveFlag = false;
 #endif //FILESYS_STUB
 
@@ -233,13 +533,46 @@ main(int argc, char **argv)
 	else if (strcmp(argv[i], "-N") == 0) {
 	    networkTestFlag = TRUE;
 	}
+	else if (strcmp(argv[i], "-stress") == 0) {
+	    ASSERT(i + 1 < argc);
+	    stressThreads = atoi(argv[i + 1]);
+	    i++;
+	}
 #ifndef FILESYS_STUB
-	else if (strcmp(argv[i], "-cp") == 0) {
+	else if (strcmp(argv[i], "-cp") == 0 || strcmp(argv[i], "-cpz") == 0) {
 	    ASSERT(i + 2 < argc);
 	    copyUnixFileName = argv[i + 1];
 	    copyNachosFileName = argv[i + 2];
+	    copyCompressed = (argv[i][3] == 'z');
+	    i += 2;
+	}
+	else if (strcmp(argv[i], "-cpout") == 0) {
+	    ASSERT(i + 2 < argc);
+	    exportFileName = argv[i + 1];
+	    exportUnixFileName = argv[i + 2];
 	    i += 2;
 	}
+	else if (strcmp(argv[i], "-clone") == 0) {
+	    ASSERT(i + 2 < argc);
+	    cloneFromName = argv[i + 1];
+	    cloneToName = argv[i + 2];
+	    i += 2;
+	}
+	else if (strcmp(argv[i], "-cpm") == 0) {
+	    ASSERT(i + 1 < argc);
+	    manifestName = argv[i + 1];
+	    i++;
+	}
+	else if (strcmp(argv[i], "-b") == 0) {
+	    ASSERT(i + 1 < argc);
+	    batchName = argv[i + 1];
+	    i++;
+	}
+	else if (strcmp(argv[i], "-replay") == 0) {
+	    ASSERT(i + 1 < argc);
+	    replayName = argv[i + 1];
+	    i++;
+	}
 	else if (strcmp(argv[i], "-p") == 0) {
 	    ASSERT(i + 1 < argc);
 	    printFileName = argv[i + 1];
@@ -273,6 +606,15 @@ main(int argc, char **argv)
 		recursiveListFlag = true;
 		i++;
 	}
+	else if (strcmp(argv[i], "-ll") == 0 || strcmp(argv[i], "-llr") == 0) {
+		// list with sizes
+		ASSERT(i + 1 < argc);
+		listDirectoryName = argv[i + 1];
+		dirListFlag = true;
+		recursiveListFlag = (argv[i][3] == 'r');
+		listSizesFlag = true;
+		i++;
+	}
 	else if (strcmp(argv[i], "-mkdir") == 0) {
 		// MP4 mod tag
 		ASSERT(i + 1 < argc);
@@ -283,15 +625,29 @@ main(int argc, char **argv)
 	else if (strcmp(argv[i], "-D") == 0) {
 	    dumpFlag = true;
 	}
+	else if (strcmp(argv[i], "-defrag") == 0) {
+	    defragFlag = true;
+	}
+	else if (strcmp(argv[i], "-verify") == 0) {
+	    verifyFlag = true;
+	}
 #endif //FILESYS_STUB
 	else if (strcmp(argv[i], "-u") == 0) {
             cout << "Partial usage: nachos [-z -d debugFlags]\n";
             cout << "Partial usage: nachos [-x programName]\n";
 	    cout << "Partial usage: nachos [-K] [-C] [-N]\n";
+	    cout << "Partial usage: nachos [-stress numThreads]\n";
 #ifndef FILESYS_STUB
             cout << "Partial usage: nachos [-cp UnixFile NachosFile]\n";
+            cout << "Partial usage: nachos [-cpz UnixFile NachosFile]\n";
+            cout << "Partial usage: nachos [-cpout NachosFile UnixFile]\n";
+            cout << "Partial usage: nachos [-clone NachosFile NachosFile]\n";
+            cout << "Partial usage: nachos [-cpm manifestFile]\n";
+            cout << "Partial usage: nachos [-b scriptFile|-]\n";
+            cout << "Partial usage: nachos [-replay traceFile]\n";
             cout << "Partial usage: nachos [-p fileName] [-r fileName]\n";
-            cout << "Partial usage: nachos [-l] [-D]\n";
+            cout << "Partial usage: nachos [-l] [-D] [-defrag] [-verify]\n";
+            cout << "Partial usage: nachos [-ll dirName] [-llr dirName]\n";
 #endif //FILESYS_STUB
 	}
 
@@ -299,6 +655,8 @@ main(int argc, char **argv)
     debug = new Debug(debugArg);
     
     DEBUG(dbgThread, "Entering main");
+    MemOpsInit();
+    DEBUG(dbgThread, "Copying memory with " << MemOpsKind() << " routines");
 
     kernel = new Kernel(argc, argv);
 
@@ -317,6 +675,9 @@ main(int argc, char **argv)
     if (networkTestFlag) {
       kernel->NetworkTest();   // two-machine test of the network
     }
+    if (stressThreads > 0) {
+      kernel->SchedulerStress(stressThreads);
+    }
 
 #ifndef FILESYS_STUB
     if (removeFileName != NULL) {
@@ -325,17 +686,29 @@ main(int argc, char **argv)
 		else 
 			kernel->fileSystem->RecurRemoveDirectory(removeFileName);
     }
+    if (manifestName != NULL) {
+		Populate(manifestName);
+    }
     if (copyUnixFileName != NULL && copyNachosFileName != NULL) {
-		Copy(copyUnixFileName,copyNachosFileName);
+		Copy(copyUnixFileName,copyNachosFileName,copyCompressed);
+    }
+    if (cloneFromName != NULL) {
+		kernel->fileSystem->Clone(cloneFromName, cloneToName);
+    }
+    if (defragFlag) {
+		kernel->fileSystem->Defragment();
+    }
+    if (verifyFlag) {
+		kernel->fileSystem->Verify();
     }
     if (dumpFlag) {
 		kernel->fileSystem->Print();
     }
     if (dirListFlag) {
 		if(!recursiveListFlag)
-			kernel->fileSystem->ListDirectory(listDirectoryName);
+			kernel->fileSystem->ListDirectory(listDirectoryName, listSizesFlag);
 		else
-			kernel->fileSystem->RecurListDirectory(listDirectoryName);
+			kernel->fileSystem->RecurListDirectory(listDirectoryName, listSizesFlag);
     }
 	if (mkdirFlag) {
 		// MP4 mod tag
@@ -344,6 +717,19 @@ main(int argc, char **argv)
     if (printFileName != NULL) {
       Print(printFileName);
     }
+    if (exportFileName != NULL) {
+      CopyOut(exportFileName, exportUnixFileName);
+    }
+    if (batchName != NULL) {
+		Batch(batchName);
+    }
+    if (replayName != NULL) {
+		TraceReplay *replay = new TraceReplay(replayName);
+
+		replay->Run();
+		delete replay;
+		kernel->interrupt->Halt();
+    }
 #endif // FILESYS_STUB
 
     // finally, run an initial user program if requested to do so
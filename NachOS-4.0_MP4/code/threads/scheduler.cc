@@ -33,6 +33,8 @@ Scheduler::Scheduler()
 { 
     readyList = new List<Thread *>; 
     toBeDestroyed = NULL;
+    background = NULL;
+    backgroundReady = FALSE;
 } 
 
 //----------------------------------------------------------------------
@@ -60,29 +62,52 @@ Scheduler::ReadyToRun (Thread *thread)
     DEBUG(dbgThread, "Putting thread on ready list: " << thread->getName());
 	//cout << "Putting thread on ready list: " << thread->getName() << endl ;
     thread->setStatus(READY);
-    readyList->Append(thread);
+    if (thread == background)
+	backgroundReady = TRUE;		// it waits only for the ready list
+    else
+	readyList->Append(thread);
 }
 
 //----------------------------------------------------------------------
 // Scheduler::FindNextToRun
 // 	Return the next thread to be scheduled onto the CPU.
-//	If there are no ready threads, return NULL.
+//	If there are no ready threads, return the background thread, if
+//	"background" and it is ready; otherwise return NULL.  Yield asks
+//	for no background thread, since the thread yielding is ready too.
 // Side effect:
 //	Thread is removed from the ready list.
 //----------------------------------------------------------------------
 
 Thread *
-Scheduler::FindNextToRun ()
+Scheduler::FindNextToRun (bool background)
 {
     ASSERT(kernel->interrupt->getLevel() == IntOff);
 
-    if (readyList->IsEmpty()) {
-		return NULL;
-    } else {
+    if (!readyList->IsEmpty()) {
     	return readyList->RemoveFront();
+    } else if (background && backgroundReady) {
+	backgroundReady = FALSE;
+	return this->background;
+    } else {
+		return NULL;
     }
 }
 
+//----------------------------------------------------------------------
+// Scheduler::SetBackground
+// 	Make "thread" the background thread: from now on, when it is
+//	ready to run, it is kept off the ready list and runs only when
+//	the list is empty -- below every other thread, however long it
+//	has waited.  For the housekeeper (see housekeep.h).
+//----------------------------------------------------------------------
+
+void
+Scheduler::SetBackground(Thread *thread)
+{
+    ASSERT(background == NULL);
+    background = thread;
+}
+
 //----------------------------------------------------------------------
 // Scheduler::Run
 // 	Dispatch the CPU to nextThread.  Save the state of the old thread,
@@ -121,6 +146,7 @@ Scheduler::Run (Thread *nextThread, bool finishing)
 					    // had an undetected stack overflow
 
     kernel->currentThread = nextThread;  // switch to the next thread
+    kernel->stats->numContextSwitches++;
     nextThread->setStatus(RUNNING);      // nextThread is now running
     
     DEBUG(dbgThread, "Switching from: " << oldThread->getName() << " to: " << nextThread->getName());
@@ -24,8 +24,14 @@ class Scheduler {
 
     void ReadyToRun(Thread* thread);	
     				// Thread can be dispatched.
-    Thread* FindNextToRun();	// Dequeue first thread on the ready 
+    Thread* FindNextToRun(bool background = TRUE);
+				// Dequeue first thread on the ready 
 				// list, if any, and return thread.
+				// Or else the background thread, if
+				// "background" and it is ready
+    void SetBackground(Thread *thread);
+				// Run "thread" only when no other
+				// thread is ready to
     void Run(Thread* nextThread, bool finishing);
     				// Cause nextThread to start running
     void CheckToBeDestroyed();// Check if thread that had been
@@ -39,6 +45,8 @@ class Scheduler {
 				// but not running
     Thread *toBeDestroyed;	// finishing thread to be destroyed
     				// by the next thread that runs
+    Thread *background;		// kept off the ready list, or NULL
+    bool backgroundReady;	// is it ready to run?
 };
 
 #endif // SCHEDULER_H
@@ -21,6 +21,7 @@
 #include "switch.h"
 #include "synch.h"
 #include "sysdep.h"
+#include "housekeep.h"
 
 // this is put at the top of the execution stack, for detecting stack overflows
 const int STACK_FENCEPOST = 0xdedbeef;
@@ -46,6 +47,7 @@ Thread::Thread(char* threadName, int threadID)
 					// of machine registers
     }
     space = NULL;
+    tickYield = FALSE;
 }
 
 //----------------------------------------------------------------------
@@ -66,6 +68,7 @@ Thread::~Thread()
     ASSERT(this != kernel->currentThread);
     if (stack != NULL)
 	DeallocBoundedArray((char *) stack, StackSize * sizeof(int));
+    kernel->ForgetThread(this);
 }
 
 //----------------------------------------------------------------------
@@ -95,8 +98,9 @@ Thread::Fork(VoidFunctionPtr func, void *arg)
     Scheduler *scheduler = kernel->scheduler;
     IntStatus oldLevel;
     
-    DEBUG(dbgThread, "Forking thread: " << name << " f(a): " << (int) func << " " << arg);
+    DEBUG(dbgThread, "Forking thread: " << name << " f(a): " << (void *) func << " " << arg);
     StackAllocate(func, arg);
+    kernel->StartAlarm();		// there is someone to time-slice with
 
     oldLevel = interrupt->SetLevel(IntOff);
     scheduler->ReadyToRun(this);	// ReadyToRun assumes that interrupts 
@@ -207,7 +211,7 @@ Thread::Yield ()
     
     DEBUG(dbgThread, "Yielding thread: " << name);
     
-    nextThread = kernel->scheduler->FindNextToRun();
+    nextThread = kernel->scheduler->FindNextToRun(FALSE);
     if (nextThread != NULL) {
 	kernel->scheduler->ReadyToRun(this);
 	kernel->scheduler->Run(nextThread, FALSE);
@@ -248,6 +252,8 @@ Thread::Sleep (bool finishing)
     status = BLOCKED;
 	//cout << "debug Thread::Sleep " << name << "wait for Idle\n";
     while ((nextThread = kernel->scheduler->FindNextToRun()) == NULL) {
+		if (kernel->housekeeper != NULL && kernel->housekeeper->Wake())
+		    continue;		// spare time: it has work to do
 		kernel->PrepareToEnd();
 		kernel->interrupt->Idle();	// no one to run, wait for an interrupt
 	}    
@@ -346,6 +352,23 @@ Thread::StackAllocate (VoidFunctionPtr func, void *arg)
     *(--stackTop) = (int) ThreadRoot;
     *stack = STACK_FENCEPOST;
 #endif
+
+#ifdef x86_64
+    // As on the x86, SWITCH() returns to ThreadRoot the first time, through 
+    // a return address on the stack -- a 64-bit one.  The stack must be 
+    // 16-byte aligned at a call, so the slot holding it is too.
+    stackTop = (int *) (((unsigned long) (stack + StackSize - 4)) & ~15UL);
+    stackTop -= 16 / sizeof(int);
+    *(void **) stackTop = (void *) ThreadRoot;
+    *stack = STACK_FENCEPOST;
+#endif
+
+#ifdef AARCH64
+    // SWITCH() "returns" to the address in x30, so ThreadRoot is only 
+    // in machineState.  The stack pointer must be 16-byte aligned.
+    stackTop = (int *) (((unsigned long) (stack + StackSize - 4)) & ~15UL);
+    *stack = STACK_FENCEPOST;
+#endif
     
 #ifdef PARISC
     machineState[PCState] = PLabelToAddr(ThreadRoot);
@@ -131,6 +131,10 @@ class Thread {
     void RestoreUserState();		// restore user-level register state
 
     AddrSpace *space;			// User code this thread is running.
+
+    bool tickYield;			// TRUE while in a Yield asked for
+					// by a timer interrupt (see
+					// Interrupt::OneTick)
 };
 
 // external function, dummy routine whose sole job is to call Thread::Print
@@ -19,43 +19,8 @@
 #include "main.h"
 #include "addrspace.h"
 #include "machine.h"
-#include "noff.h"
-
-//----------------------------------------------------------------------
-// SwapHeader
-// 	Do little endian to big endian conversion on the bytes in the 
-//	object file header, in case the file was generated on a little
-//	endian machine, and we're now running on a big endian machine.
-//----------------------------------------------------------------------
-
-static void 
-SwapHeader (NoffHeader *noffH)
-{
-    noffH->noffMagic = WordToHost(noffH->noffMagic);
-    noffH->code.size = WordToHost(noffH->code.size);
-    noffH->code.virtualAddr = WordToHost(noffH->code.virtualAddr);
-    noffH->code.inFileAddr = WordToHost(noffH->code.inFileAddr);
-#ifdef RDATA
-    noffH->readonlyData.size = WordToHost(noffH->readonlyData.size);
-    noffH->readonlyData.virtualAddr = 
-           WordToHost(noffH->readonlyData.virtualAddr);
-    noffH->readonlyData.inFileAddr = 
-           WordToHost(noffH->readonlyData.inFileAddr);
-#endif 
-    noffH->initData.size = WordToHost(noffH->initData.size);
-    noffH->initData.virtualAddr = WordToHost(noffH->initData.virtualAddr);
-    noffH->initData.inFileAddr = WordToHost(noffH->initData.inFileAddr);
-    noffH->uninitData.size = WordToHost(noffH->uninitData.size);
-    noffH->uninitData.virtualAddr = WordToHost(noffH->uninitData.virtualAddr);
-    noffH->uninitData.inFileAddr = WordToHost(noffH->uninitData.inFileAddr);
-
-#ifdef RDATA
-    DEBUG(dbgAddr, "code = " << noffH->code.size <<  
-                   " readonly = " << noffH->readonlyData.size <<
-                   " init = " << noffH->initData.size <<
-                   " uninit = " << noffH->uninitData.size << "\n");
-#endif
-}
+#include "imagecache.h"
+#include "memops.h"
 
 //----------------------------------------------------------------------
 // AddrSpace::AddrSpace
@@ -67,6 +32,10 @@ SwapHeader (NoffHeader *noffH)
 
 AddrSpace::AddrSpace()
 {
+#ifndef FILESYS_STUB
+    files = new FileTable;
+    aio = new AioTable(files);
+#endif
     pageTable = new TranslationEntry[NumPhysPages];
     for (int i = 0; i < NumPhysPages; i++) {
 	pageTable[i].virtualPage = i;	// for now, virt page # = phys page #
@@ -78,7 +47,8 @@ AddrSpace::AddrSpace()
     }
     
     // zero out the entire address space
-    bzero(kernel->machine->mainMemory, MemorySize);
+    MemZero(kernel->machine->mainMemory, MemorySize);
+    kernel->machine->InvalidateDecodeCache(0, MemorySize);
 }
 
 //----------------------------------------------------------------------
@@ -88,6 +58,10 @@ AddrSpace::AddrSpace()
 
 AddrSpace::~AddrSpace()
 {
+#ifndef FILESYS_STUB
+   delete aio;				// waits for any requests left
+   delete files;			// closes any files left open
+#endif
    delete pageTable;
 }
 
@@ -97,7 +71,9 @@ AddrSpace::~AddrSpace()
 // 	Load a user program into memory from a file.
 //
 //	Assumes that the page table has been initialized, and that
-//	the object code file is in NOFF format.
+//	the object code file is in NOFF format.  The header and segments
+//	come from the kernel's image cache, so running a program again
+//	just copies them into memory.
 //
 //	"fileName" is the file containing the object code to load into memory
 //----------------------------------------------------------------------
@@ -106,6 +82,7 @@ bool
 AddrSpace::Load(char *fileName) 
 {
     OpenFile *executable = kernel->fileSystem->Open(fileName);
+    ExecImage *image;
     NoffHeader noffH;
     unsigned int size;
 
@@ -114,11 +91,10 @@ AddrSpace::Load(char *fileName)
 	return FALSE;
     }
 
-    executable->ReadAt((char *)&noffH, sizeof(noffH), 0);
-    if ((noffH.noffMagic != NOFFMAGIC) && 
-		(WordToHost(noffH.noffMagic) == NOFFMAGIC))
-    	SwapHeader(&noffH);
-    ASSERT(noffH.noffMagic == NOFFMAGIC);
+    image = kernel->imageCache->Get(executable);
+    delete executable;			// close file
+    ASSERT(image != NULL);		// not NOFF format
+    noffH = image->noffH;
 
 #ifdef RDATA
 // how big is address space?
@@ -134,6 +110,7 @@ AddrSpace::Load(char *fileName)
 #endif
     numPages = divRoundUp(size, PageSize);
     size = numPages * PageSize;
+    heapStart = heapEnd = size;		// empty, until the program calls Sbrk
 
     ASSERT(numPages <= NumPhysPages);		// check we're not trying
 						// to run anything too big --
@@ -147,29 +124,30 @@ AddrSpace::Load(char *fileName)
     if (noffH.code.size > 0) {
         DEBUG(dbgAddr, "Initializing code segment.");
 	DEBUG(dbgAddr, noffH.code.virtualAddr << ", " << noffH.code.size);
-        executable->ReadAt(
-		&(kernel->machine->mainMemory[noffH.code.virtualAddr]), 
-			noffH.code.size, noffH.code.inFileAddr);
+        MemCopy(&(kernel->machine->mainMemory[noffH.code.virtualAddr]),
+		image->code, 
+			noffH.code.size);
     }
     if (noffH.initData.size > 0) {
         DEBUG(dbgAddr, "Initializing data segment.");
 	DEBUG(dbgAddr, noffH.initData.virtualAddr << ", " << noffH.initData.size);
-        executable->ReadAt(
-		&(kernel->machine->mainMemory[noffH.initData.virtualAddr]),
-			noffH.initData.size, noffH.initData.inFileAddr);
+        MemCopy(&(kernel->machine->mainMemory[noffH.initData.virtualAddr]),
+		image->initData,
+			noffH.initData.size);
     }
 
 #ifdef RDATA
     if (noffH.readonlyData.size > 0) {
         DEBUG(dbgAddr, "Initializing read only data segment.");
 	DEBUG(dbgAddr, noffH.readonlyData.virtualAddr << ", " << noffH.readonlyData.size);
-        executable->ReadAt(
-		&(kernel->machine->mainMemory[noffH.readonlyData.virtualAddr]),
-			noffH.readonlyData.size, noffH.readonlyData.inFileAddr);
+        MemCopy(&(kernel->machine->mainMemory[noffH.readonlyData.virtualAddr]),
+		image->readonlyData,
+			noffH.readonlyData.size);
     }
 #endif
 
-    delete executable;			// close file
+    kernel->machine->InvalidateDecodeCache(0, MemorySize);
+					// we wrote mainMemory directly
     return TRUE;			// success
 }
 
@@ -258,6 +236,7 @@ void AddrSpace::RestoreState()
 {
     kernel->machine->pageTable = pageTable;
     kernel->machine->pageTableSize = numPages;
+    kernel->machine->FlushTranslationCache();
 }
 
 
@@ -311,6 +290,41 @@ AddrSpace::Translate(unsigned int vaddr, unsigned int *paddr, int isReadWrite)
     return NoException;
 }
 
+//----------------------------------------------------------------------
+// AddrSpace::Sbrk
+// 	Move the end of the heap by "increment" bytes, for SC_Sbrk, and
+//	return where it was; or -1 if that would take it below where it
+//	starts, or beyond physical memory.
+//
+//	The heap is the space above the stack, so growing it just adds
+//	pages to the end of the page table.  Memory starts out zeroed,
+//	and the bytes a shrinking heap gives back are zeroed again, so
+//	that the heap always gains zeroes.
+//----------------------------------------------------------------------
 
-
+int
+AddrSpace::Sbrk(int increment)
+{
+    unsigned int oldEnd = heapEnd;
+    unsigned int newEnd;
+    unsigned int pages;
+
+    if (increment < 0 && 0u - (unsigned) increment > heapEnd - heapStart)
+	return -1;
+    if (increment > 0 && (unsigned) increment > MemorySize - heapEnd)
+	return -1;
+    newEnd = heapEnd + increment;
+    if (newEnd < oldEnd) {
+	MemZero(&(kernel->machine->mainMemory[newEnd]), oldEnd - newEnd);
+	kernel->machine->InvalidateDecodeCache(newEnd, oldEnd - newEnd);
+    }
+    heapEnd = newEnd;
+    pages = divRoundUp(heapEnd, PageSize);
+    if (pages != numPages) {
+	DEBUG(dbgAddr, "Heap now ends at " << heapEnd << ", " << pages << " pages");
+	numPages = pages;
+	RestoreState();			// the machine's copy of the size
+    }
+    return oldEnd;
+}
 
@@ -15,6 +15,8 @@
 
 #include "copyright.h"
 #include "filesys.h"
+#include "filetable.h"
+#include "aio.h"
 
 #define UserStackSize		1024 	// increase this as necessary!
 
@@ -39,11 +41,24 @@ class AddrSpace {
     // is 0 for Read, 1 for Write.
     ExceptionType Translate(unsigned int vaddr, unsigned int *paddr, int mode);
 
+    int Sbrk(int increment);		// Move the end of the heap by
+					// "increment" bytes; return the old
+					// end, or -1 if there is no room
+
+#ifndef FILESYS_STUB
+    FileTable *files;			// the program's open files
+    AioTable *aio;			// and its asynchronous requests
+#endif
+
   private:
     TranslationEntry *pageTable;	// Assume linear page table translation
 					// for now!
     unsigned int numPages;		// Number of pages in the virtual 
-					// address space
+					// address space: up to the end
+					// of the heap
+    unsigned int heapStart;		// where the heap starts, above the
+					// stack
+    unsigned int heapEnd;		// and the byte after its last
 
     void InitRegisters();		// Initialize user-level CPU registers,
 					// before jumping to user code
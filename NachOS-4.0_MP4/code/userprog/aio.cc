@@ -0,0 +1,201 @@
+// aio.cc
+//	Routines to carry out asynchronous file I/O for user programs.
+//	See aio.h.
+//
+// Copyright (c) 1992-1996 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "aio.h"
+#include "main.h"
+#include "filetable.h"
+#include "usermem.h"
+#include "synch.h"
+
+#ifndef FILESYS_STUB
+
+// One request: what to move, and how it went.  The kernel thread doing
+// it only touches "result" and "done", and signals "finished".
+
+class AioRequest {
+  public:
+    IoVec *vec;			// the user's buffer, in pieces of mainMemory
+    int numVec;
+    int position;		// where in the file it starts
+    bool writing;
+    int fileId;			// the request's own id for the file,
+    OpenFile *file;		// and the file
+    int result;			// bytes moved, once done
+    bool done;
+    Semaphore *finished;	// V'ed when done
+};
+
+//----------------------------------------------------------------------
+// AioThread
+// 	The body of the kernel thread that carries out a request: move
+//	each piece of the buffer in turn, stopping early at end of file,
+//	then say it is done.
+//----------------------------------------------------------------------
+
+static void
+AioThread(AioRequest *request)
+{
+    int done = 0;
+
+    for (int i = 0; i < request->numVec; i++) {
+	IoVec *v = &request->vec[i];
+	int n = request->writing ?
+	    kernel->fileSystem->WriteAt(v->base, v->length,
+				request->position + done, request->file)
+	  : kernel->fileSystem->ReadAt(v->base, v->length,
+				request->position + done, request->file);
+
+	if (n > 0) {
+	    done += n;
+	}
+	if (n < v->length) {
+	    break;
+	}
+    }
+    DEBUG(dbgFile, "Async " << (request->writing ? "write" : "read")
+		<< " of " << done << " bytes done");
+    request->result = done;
+    request->done = TRUE;
+    request->finished->V();
+}
+
+//----------------------------------------------------------------------
+// AioTable::AioTable
+// 	Initialize an empty table, for a program whose open files are
+//	"fileTable".
+//----------------------------------------------------------------------
+
+AioTable::AioTable(FileTable *fileTable)
+{
+    files = fileTable;
+    requests = new HandleTable<AioRequest *>(MaxAioRequests);
+}
+
+//----------------------------------------------------------------------
+// AioTable::~AioTable
+// 	Wait for any requests the program didn't collect -- their
+//	threads still point into its memory -- and de-allocate the table.
+//----------------------------------------------------------------------
+
+AioTable::~AioTable()
+{
+    WaitAll();
+    delete requests;
+}
+
+//----------------------------------------------------------------------
+// AioTable::Start
+// 	Start reading or writing "size" bytes of open file "id", from
+//	byte "position", to or from the calling program's buffer at
+//	virtual address "userAddr", and return at once.
+//
+//	Returns the request's handle, or -1 if "id" isn't an open file,
+//	the buffer isn't valid, or MaxAioRequests are already going.
+//----------------------------------------------------------------------
+
+int
+AioTable::Start(int userAddr, int size, int position, int id, bool writing)
+{
+    AioRequest *request;
+    Thread *thread;
+    int handle, fileId, maxVec;
+
+    if (size < 0 || position < 0 || files->Get(id) == NULL
+		|| requests->NumInTable() == MaxAioRequests) {
+	return -1;
+    }
+    request = new AioRequest;
+    maxVec = divRoundUp(size, PageSize) + 1;
+    request->vec = new IoVec[maxVec];
+    request->numVec = UserToIoVec(userAddr, size, !writing,
+					request->vec, maxVec);
+    fileId = (request->numVec < 0) ? -1 : files->Dup(id);
+    thread = (fileId < 0) ? NULL : kernel->NewThread("aio");
+    if (thread == NULL) {
+	if (fileId >= 0) {
+	    files->Close(fileId);
+	}
+	delete [] request->vec;
+	delete request;
+	return -1;
+    }
+    request->position = position;
+    request->writing = writing;
+    request->fileId = fileId;
+    request->file = files->Get(fileId);
+    request->result = 0;
+    request->done = FALSE;
+    request->finished = new Semaphore("aio", 0);
+
+    handle = requests->Enter();
+    *requests->Lookup(handle) = request;
+    thread->Fork((VoidFunctionPtr) AioThread, (void *) request);
+    return handle;
+}
+
+//----------------------------------------------------------------------
+// AioTable::Poll
+// 	Return 1 if request "handle" is done, 0 if it is still going, or
+//	-1 if there is no such request.
+//----------------------------------------------------------------------
+
+int
+AioTable::Poll(int handle)
+{
+    AioRequest **request = requests->Lookup(handle);
+
+    if (request == NULL) {
+	return -1;
+    }
+    return (*request)->done ? 1 : 0;
+}
+
+//----------------------------------------------------------------------
+// AioTable::Wait
+// 	Wait until request "handle" is done, then forget it: from now on
+//	the handle is stale.  Returns the number of bytes it moved, or
+//	-1 if there is no such request.
+//----------------------------------------------------------------------
+
+int
+AioTable::Wait(int handle)
+{
+    AioRequest **entry = requests->Lookup(handle);
+    AioRequest *request;
+    int result;
+
+    if (entry == NULL) {
+	return -1;
+    }
+    request = *entry;
+    requests->Remove(handle);		// so no one else waits for it
+    request->finished->P();
+    result = request->result;
+    files->Close(request->fileId);
+    delete request->finished;
+    delete [] request->vec;
+    delete request;
+    return result;
+}
+
+//----------------------------------------------------------------------
+// AioTable::WaitAll
+// 	Wait for, and forget, every request not yet collected.
+//----------------------------------------------------------------------
+
+void
+AioTable::WaitAll()
+{
+    int handle;
+
+    while ((handle = requests->Next(-1)) != -1) {
+	Wait(handle);
+    }
+}
+#endif // FILESYS_STUB
@@ -0,0 +1,58 @@
+// aio.h
+//	Data structures for asynchronous file I/O: reads and writes that
+//	a user program starts with AioRead and AioWrite and collects
+//	later with AioWait, so that one thread can keep several disk
+//	requests going while it computes.
+//
+//	Each request is carried out by a kernel thread of its own, which
+//	moves the data straight between the file and the user's buffer,
+//	as SC_PRead and SC_PWrite do -- so the program must leave the
+//	buffer alone until the request is done.  The thread's sector
+//	requests join the disk queue along with everyone else's, and the
+//	program runs on while the thread waits for the disk.
+//
+//	A request keeps its own id for the file (a Dup), so closing the
+//	program's id doesn't pull the file out from under it.
+//
+// Copyright (c) 1992-1996 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#ifndef AIO_H
+#define AIO_H
+
+#include "copyright.h"
+#include "handle.h"
+
+class FileTable;
+class AioRequest;
+
+// The most requests a program can have started and not yet
+// collected; each holds an id in its open file table
+
+const int MaxAioRequests = 8;
+
+// The following class defines a user program's asynchronous requests,
+// named by the handles that AioRead and AioWrite return.
+
+class AioTable {
+  public:
+    AioTable(FileTable *files);	// no requests yet, for the program
+				// with open files "files"
+    ~AioTable();		// wait for any requests left
+
+    int Start(int userAddr, int size, int position, int id, bool writing);
+				// start a request; returns its handle,
+				// or -1
+    int Poll(int handle);	// 1 if the request is done, 0 if not, -1
+				// if there is no such request
+    int Wait(int handle);	// wait until it is done, and forget it;
+				// returns the bytes moved, or -1
+    void WaitAll();		// wait for every request, e.g. at Exit
+
+  private:
+    FileTable *files;		// where request's file ids are
+    HandleTable<AioRequest *> *requests;	// requests not yet collected
+};
+
+#endif // AIO_H
@@ -25,38 +25,252 @@
 #include "main.h"
 #include "syscall.h"
 #include "ksyscall.h"
+#include "usermem.h"
+
+#ifndef FILESYS_STUB
+const int MaxIoVec = 8;		// pieces of a user buffer handled at once
+const int IoBufWords = 2;	// size of an IoBuf in user memory: buffer,
+				// size (the kernel's pointers may be wider)
+const int IoRequestWords = 5;	// and of an IoRequest: op, buffer, size,
+				// id, result
+
 //----------------------------------------------------------------------
-// ExceptionHandler
-// 	Entry point into the Nachos kernel.  Called when a user program
-//	is executing, and either does a syscall, or generates an addressing
-//	or arithmetic exception.
-//
-// 	For system calls, the following is the calling convention:
+// UserFileIO
+// 	Read or write an open file directly to or from the user buffer of
+//	"size" bytes at virtual address "userAddr", one physically
+//	contiguous piece at a time, with no intermediate kernel buffer.
 //
-// 	system call code -- r2
-//		arg1 -- r4
-//		arg2 -- r5
-//		arg3 -- r6
-//		arg4 -- r7
+//	Returns the number of bytes transferred (stopping early at end
+//	of file), or -1 if the buffer is not valid user memory.
 //
-//	The result of the system call, if any, must be put back into r2. 
+//	"reading" -- TRUE for SC_Read, FALSE for SC_Write
+//	"position" -- where in the file to start, for SC_PRead and
+//		SC_PWrite; -1 to use (and move) its seek position
+//----------------------------------------------------------------------
+
+static int
+UserFileIO(int userAddr, int size, int id, bool reading, int position = -1)
+{
+    int done = 0;
+
+    while (done < size) {
+	IoVec vec[MaxIoVec];
+	int numVec = UserToIoVec(userAddr + done, size - done, reading,
+				vec, MaxIoVec);
+
+	if (numVec < 0) {
+	    return (done > 0) ? done : -1;
+	}
+	for (int i = 0; i < numVec; i++) {
+	    int n;
+
+	    if (position < 0) {
+		n = reading ? SysRead(vec[i].base, vec[i].length, id)
+			    : SysWrite(vec[i].base, vec[i].length, id);
+	    } else {
+		n = reading ?
+		    SysPRead(vec[i].base, vec[i].length, position + done, id)
+		  : SysPWrite(vec[i].base, vec[i].length, position + done, id);
+	    }
+	    if (n > 0) {
+		done += n;
+	    }
+	    if (n < vec[i].length) {
+		return done;		// end of file, or an error
+	    }
+	}
+    }
+    return done;
+}
+
+//----------------------------------------------------------------------
+// CopyInWords
+// 	Copy "numWords" words of a structure from user virtual address
+//	"userAddr" into "words", converting each to host byte order.
+//	Returns FALSE on a bad address.
+//----------------------------------------------------------------------
+
+static bool
+CopyInWords(int userAddr, int *words, int numWords)
+{
+    if (!CopyIn(userAddr, (char *) words, numWords * sizeof(int))) {
+	return FALSE;
+    }
+    for (int i = 0; i < numWords; i++) {
+	words[i] = WordToHost(words[i]);
+    }
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// UserFileIOV
+// 	Read or write an open file to or from the "count" pieces of
+//	user buffer described by the IoBuf array at "vecAddr", for
+//	SC_ReadV and SC_WriteV.  Each piece goes straight between the
+//	file and user memory, as in UserFileIO.
 //
-// If you are handling a system call, don't forget to increment the pc
-// before returning. (Or else you'll loop making the same system call forever!)
+//	Returns the total number of bytes transferred, stopping at the
+//	first piece that is not transferred in full; or -1 if the array
+//	is not valid, or the first piece is not valid user memory.
+//----------------------------------------------------------------------
+
+static int
+UserFileIOV(int vecAddr, int count, int id, bool reading)
+{
+    int vec[MaxIoBufs * IoBufWords];
+    int done = 0;
+
+    if (count < 0 || count > MaxIoBufs
+	|| !CopyInWords(vecAddr, vec, count * IoBufWords)) {
+	return -1;
+    }
+    for (int i = 0; i < count; i++) {
+	int *buf = &vec[i * IoBufWords];	// buffer, size
+	int n = UserFileIO(buf[0], buf[1], id, reading);
+
+	if (n < 0) {
+	    return (done > 0) ? done : -1;
+	}
+	done += n;
+	if (n < buf[1]) {
+	    break;			// end of file, or an error
+	}
+    }
+    return done;
+}
+
+//----------------------------------------------------------------------
+// UserSubmit
+// 	Carry out the "count" IoRequests in the array at "reqAddr", for
+//	SC_Submit, storing each one's result back into its "result"
+//	field.
 //
-//	"which" is the kind of exception.  The list of possible exceptions 
-//	is in machine.h.
+//	Returns the number carried out, or -1 if the array is not valid.
 //----------------------------------------------------------------------
 
-void
-ExceptionHandler(ExceptionType which)
+static int
+UserSubmit(int reqAddr, int count)
+{
+    int req[IoRequestWords];
+
+    if (count < 0 || count > MaxIoBufs) {
+	return -1;
+    }
+    for (int i = 0; i < count; i++, reqAddr += IoRequestWords * sizeof(int)) {
+	int result;
+
+	if (!CopyInWords(reqAddr, req, IoRequestWords)) {
+	    return (i > 0) ? i : -1;
+	}
+	switch (req[0]) {		// op, buffer, size, id
+	  case IoRead:
+	    result = UserFileIO(req[1], req[2], req[3], TRUE);
+	    break;
+	  case IoWrite:
+	    result = UserFileIO(req[1], req[2], req[3], FALSE);
+	    break;
+	  case IoClose:
+	    result = SysClose(req[3]);
+	    break;
+	  default:
+	    result = -1;
+	    break;
+	}
+	result = WordToMachine(result);
+	if (!CopyOut((char *) &result, reqAddr + 4 * sizeof(int),	// result
+			sizeof(int))) {
+	    return (i > 0) ? i : -1;
+	}
+    }
+    return count;
+}
+#endif
+//----------------------------------------------------------------------
+// SyscallBytes
+// 	Return the bytes system call "type", just returned, read or
+//	wrote: its result, for the calls that return a byte count.
+//----------------------------------------------------------------------
+
+static int
+SyscallBytes(int type)
+{
+    int result = kernel->machine->ReadRegister(2);
+
+    switch (type) {
+      case SC_Read:
+      case SC_Write:
+      case SC_PRead:
+      case SC_PWrite:
+      case SC_ReadV:
+      case SC_WriteV:
+	return (result > 0) ? result : 0;
+      default:
+	return 0;
+    }
+}
+
+//----------------------------------------------------------------------
+// UserGetStats
+// 	Copy the calling thread's use of system call "type" so far, or
+//	of all of them together if "type" is -1, to the SyscallStats at
+//	user virtual address "userAddr", for SC_GetStats.  Returns 0, or
+//	-1 if "type" isn't a system call or the address is not valid.
+//----------------------------------------------------------------------
+
+static int
+UserGetStats(int type, int userAddr)
+{
+    int id = kernel->currentThread->getID();
+    int words[4] = { 0, 0, 0, 0 };	// count, ticks, maxTicks, bytes
+
+    if (type != -1 && kernel->stats->Syscalls(id, type) == NULL)
+	return -1;
+    for (int t = 0; t < NumSyscallCodes; t++) {
+	SyscallCounter *c = kernel->stats->Syscalls(id, t);
+
+	if (type != -1 && t != type)
+	    continue;
+	words[0] += c->count;
+	words[1] += c->ticks;
+	if (c->maxTicks > words[2])
+	    words[2] = c->maxTicks;
+	words[3] += c->bytes;
+    }
+    for (int i = 0; i < 4; i++)
+	words[i] = WordToMachine(words[i]);
+    return CopyOut((char *) words, userAddr, sizeof(words)) ? 0 : -1;
+}
+
+//----------------------------------------------------------------------
+// UserGetMachineStats
+// 	Copy the machine's tick and disk request counters to the
+//	MachineStats at user virtual address "userAddr", for
+//	SC_GetMachineStats.  Returns 0, or -1 if the address is not valid.
+//----------------------------------------------------------------------
+
+static int
+UserGetMachineStats(int userAddr)
+{
+    int words[3];			// ticks, diskReads, diskWrites
+
+    words[0] = WordToMachine(kernel->stats->totalTicks);
+    words[1] = WordToMachine(kernel->stats->numDiskReads);
+    words[2] = WordToMachine(kernel->stats->numDiskWrites);
+    return CopyOut((char *) words, userAddr, sizeof(words)) ? 0 : -1;
+}
+
+//----------------------------------------------------------------------
+// Syscall
+// 	Carry out system call "type", with its arguments in r4 to r7.
+//	Returns with the result in r2 and the pc moved past the syscall
+//	instruction -- unless the call never returns, as Exit and Halt.
+//----------------------------------------------------------------------
+
+static void
+Syscall(int type)
 {
-    int type = kernel->machine->ReadRegister(2);
 	int val;
-    int status, exit, threadID, programID;
-	DEBUG(dbgSys, "Received Exception " << which << " type: " << type << "\n");
-    switch (which) {
-    case SyscallException:
+    int status;
       	switch(type) {
       	case SC_Halt:
 			DEBUG(dbgSys, "Shutdown, initiated by user program.\n");
@@ -78,10 +292,13 @@ ExceptionHandler(ExceptionType which)
 		case SC_Create:
 			val = kernel->machine->ReadRegister(4);
 			{
-				char *filename = &(kernel->machine->mainMemory[val]);
+				char filename[MaxUserString];
 				int length = kernel->machine->ReadRegister(5);
 				//cout << length << endl;
-				status = SysCreate(filename, length);
+				if (CopyInString(val, filename, MaxUserString) < 0)
+					status = 0;
+				else
+					status = SysCreate(filename, length);
 				kernel->machine->WriteRegister(2, (int) status);
 			}
 			kernel->machine->WriteRegister(PrevPCReg, kernel->machine->ReadRegister(PCReg));
@@ -90,11 +307,30 @@ ExceptionHandler(ExceptionType which)
 			return;
 			ASSERTNOTREACHED();
             break;
+		case SC_Remove:
+			val = kernel->machine->ReadRegister(4);
+			{
+				char filename[MaxUserString];
+				if (CopyInString(val, filename, MaxUserString) < 0)
+					status = 0;
+				else
+					status = SysRemove(filename);
+				kernel->machine->WriteRegister(2, (int) status);
+			}
+			kernel->machine->WriteRegister(PrevPCReg, kernel->machine->ReadRegister(PCReg));
+			kernel->machine->WriteRegister(PCReg, kernel->machine->ReadRegister(PCReg) + 4);
+			kernel->machine->WriteRegister(NextPCReg, kernel->machine->ReadRegister(PCReg)+4);
+			return;
+			ASSERTNOTREACHED();
+			break;
 		case SC_Open: 
 			val = kernel->machine->ReadRegister(4);
 			{
-				char *filename = &(kernel->machine->mainMemory[val]);
-				status = SysOpen(filename);
+				char filename[MaxUserString];
+				if (CopyInString(val, filename, MaxUserString) < 0)
+					status = 0;
+				else
+					status = SysOpen(filename);
 				kernel->machine->WriteRegister(2, (int) status);
 			}
 			kernel->machine->WriteRegister(PrevPCReg, kernel->machine->ReadRegister(PCReg));
@@ -118,12 +354,11 @@ ExceptionHandler(ExceptionType which)
 		case SC_Write:
 			val = kernel->machine->ReadRegister(4);
 			{
-				char *buffer = &(kernel->machine->mainMemory[val]);
 				int size = kernel->machine->ReadRegister(5);
 				int id = kernel->machine->ReadRegister(6);
 				int numWritten = 0;
 				
-				numWritten = SysWrite(buffer, size, id);
+				numWritten = UserFileIO(val, size, id, FALSE);
 				kernel->machine->WriteRegister(2, numWritten);
 			}
 			kernel->machine->WriteRegister(PrevPCReg, kernel->machine->ReadRegister(PCReg));
@@ -137,12 +372,9 @@ ExceptionHandler(ExceptionType which)
 			{
 				int size = kernel->machine->ReadRegister(5);
 				int id = kernel->machine->ReadRegister(6);
-				char *buffer = (char *)malloc(sizeof(char *) * (size));
-				
 				int numRead = 0;
 				
-				numRead = SysRead(buffer, size, id);
-				strcpy(&kernel->machine->mainMemory[val], buffer);
+				numRead = UserFileIO(val, size, id, TRUE);
 				kernel->machine->WriteRegister(2, numRead);
 			}
 			kernel->machine->WriteRegister(PrevPCReg, kernel->machine->ReadRegister(PCReg));
@@ -150,6 +382,82 @@ ExceptionHandler(ExceptionType which)
 			kernel->machine->WriteRegister(NextPCReg, kernel->machine->ReadRegister(PCReg)+4);
 			return;
 			ASSERTNOTREACHED();
+            break;
+		case SC_Dup:
+			val = kernel->machine->ReadRegister(4);
+			{
+				status = SysDup(val);
+				kernel->machine->WriteRegister(2, (int) status);
+			}
+			kernel->machine->WriteRegister(PrevPCReg, kernel->machine->ReadRegister(PCReg));
+			kernel->machine->WriteRegister(PCReg, kernel->machine->ReadRegister(PCReg) + 4);
+			kernel->machine->WriteRegister(NextPCReg, kernel->machine->ReadRegister(PCReg)+4);
+			return;
+			ASSERTNOTREACHED();
+			break;
+		case SC_Seek:
+			val = kernel->machine->ReadRegister(4);
+			{
+				int id = kernel->machine->ReadRegister(5);
+
+				status = SysSeek(val, id);
+				kernel->machine->WriteRegister(2, status);
+			}
+			kernel->machine->WriteRegister(PrevPCReg, kernel->machine->ReadRegister(PCReg));
+			kernel->machine->WriteRegister(PCReg, kernel->machine->ReadRegister(PCReg) + 4);
+			kernel->machine->WriteRegister(NextPCReg, kernel->machine->ReadRegister(PCReg)+4);
+			return;
+			ASSERTNOTREACHED();
+            break;
+		case SC_PWrite:
+		case SC_PRead:
+			val = kernel->machine->ReadRegister(4);
+			{
+				int size = kernel->machine->ReadRegister(5);
+				int position = kernel->machine->ReadRegister(6);
+				int id = kernel->machine->ReadRegister(7);
+
+				if (position < 0)
+					status = -1;
+				else
+					status = UserFileIO(val, size, id, type == SC_PRead, position);
+				kernel->machine->WriteRegister(2, status);
+			}
+			kernel->machine->WriteRegister(PrevPCReg, kernel->machine->ReadRegister(PCReg));
+			kernel->machine->WriteRegister(PCReg, kernel->machine->ReadRegister(PCReg) + 4);
+			kernel->machine->WriteRegister(NextPCReg, kernel->machine->ReadRegister(PCReg)+4);
+			return;
+			ASSERTNOTREACHED();
+            break;
+		case SC_WriteV:
+		case SC_ReadV:
+			val = kernel->machine->ReadRegister(4);
+			{
+				int count = kernel->machine->ReadRegister(5);
+				int id = kernel->machine->ReadRegister(6);
+
+				status = UserFileIOV(val, count, id, type == SC_ReadV);
+				kernel->machine->WriteRegister(2, status);
+			}
+			kernel->machine->WriteRegister(PrevPCReg, kernel->machine->ReadRegister(PCReg));
+			kernel->machine->WriteRegister(PCReg, kernel->machine->ReadRegister(PCReg) + 4);
+			kernel->machine->WriteRegister(NextPCReg, kernel->machine->ReadRegister(PCReg)+4);
+			return;
+			ASSERTNOTREACHED();
+            break;
+		case SC_Submit:
+			val = kernel->machine->ReadRegister(4);
+			{
+				int count = kernel->machine->ReadRegister(5);
+
+				status = UserSubmit(val, count);
+				kernel->machine->WriteRegister(2, status);
+			}
+			kernel->machine->WriteRegister(PrevPCReg, kernel->machine->ReadRegister(PCReg));
+			kernel->machine->WriteRegister(PCReg, kernel->machine->ReadRegister(PCReg) + 4);
+			kernel->machine->WriteRegister(NextPCReg, kernel->machine->ReadRegister(PCReg)+4);
+			return;
+			ASSERTNOTREACHED();
             break;
 		#endif
       	case SC_Add:
@@ -176,21 +484,183 @@ ExceptionHandler(ExceptionType which)
 			return;	
 			ASSERTNOTREACHED();
             break;
+		case SC_GetStats:
+			val = kernel->machine->ReadRegister(4);
+			{
+				int addr = kernel->machine->ReadRegister(5);
+
+				status = UserGetStats(val, addr);
+				kernel->machine->WriteRegister(2, status);
+			}
+			kernel->machine->WriteRegister(PrevPCReg, kernel->machine->ReadRegister(PCReg));
+			kernel->machine->WriteRegister(PCReg, kernel->machine->ReadRegister(PCReg) + 4);
+			kernel->machine->WriteRegister(NextPCReg, kernel->machine->ReadRegister(PCReg)+4);
+			return;
+			ASSERTNOTREACHED();
+            break;
+		case SC_GetMachineStats:
+			val = kernel->machine->ReadRegister(4);
+			status = UserGetMachineStats(val);
+			kernel->machine->WriteRegister(2, status);
+			kernel->machine->WriteRegister(PrevPCReg, kernel->machine->ReadRegister(PCReg));
+			kernel->machine->WriteRegister(PCReg, kernel->machine->ReadRegister(PCReg) + 4);
+			kernel->machine->WriteRegister(NextPCReg, kernel->machine->ReadRegister(PCReg)+4);
+			return;
+			ASSERTNOTREACHED();
+			break;
+		case SC_Sbrk:
+			val = kernel->machine->ReadRegister(4);
+			status = SysSbrk(val);
+			DEBUG(dbgAddr, "Sbrk " << val << " returning " << status);
+			kernel->machine->WriteRegister(2, status);
+			kernel->machine->WriteRegister(PrevPCReg, kernel->machine->ReadRegister(PCReg));
+			kernel->machine->WriteRegister(PCReg, kernel->machine->ReadRegister(PCReg) + 4);
+			kernel->machine->WriteRegister(NextPCReg, kernel->machine->ReadRegister(PCReg)+4);
+			return;
+			ASSERTNOTREACHED();
+			break;
+#ifndef FILESYS_STUB
+		case SC_AioRead:
+		case SC_AioWrite:
+			val = kernel->machine->ReadRegister(4);
+			{
+				int size = kernel->machine->ReadRegister(5);
+				int position = kernel->machine->ReadRegister(6);
+				OpenFileId id = kernel->machine->ReadRegister(7);
+
+				status = SysAioStart(val, size, position, id, type == SC_AioWrite);
+				kernel->machine->WriteRegister(2, status);
+			}
+			kernel->machine->WriteRegister(PrevPCReg, kernel->machine->ReadRegister(PCReg));
+			kernel->machine->WriteRegister(PCReg, kernel->machine->ReadRegister(PCReg) + 4);
+			kernel->machine->WriteRegister(NextPCReg, kernel->machine->ReadRegister(PCReg)+4);
+			return;
+			ASSERTNOTREACHED();
+			break;
+		case SC_AioWait:
+		case SC_AioPoll:
+			val = kernel->machine->ReadRegister(4);
+			status = (type == SC_AioWait) ? SysAioWait(val) : SysAioPoll(val);
+			kernel->machine->WriteRegister(2, status);
+			kernel->machine->WriteRegister(PrevPCReg, kernel->machine->ReadRegister(PCReg));
+			kernel->machine->WriteRegister(PCReg, kernel->machine->ReadRegister(PCReg) + 4);
+			kernel->machine->WriteRegister(NextPCReg, kernel->machine->ReadRegister(PCReg)+4);
+			return;
+			ASSERTNOTREACHED();
+			break;
+		case SC_Fsync:
+		case SC_Sync:
+			val = kernel->machine->ReadRegister(4);
+			status = (type == SC_Fsync) ? SysFsync(val) : SysSync();
+			kernel->machine->WriteRegister(2, status);
+			kernel->machine->WriteRegister(PrevPCReg, kernel->machine->ReadRegister(PCReg));
+			kernel->machine->WriteRegister(PCReg, kernel->machine->ReadRegister(PCReg) + 4);
+			kernel->machine->WriteRegister(NextPCReg, kernel->machine->ReadRegister(PCReg)+4);
+			return;
+			ASSERTNOTREACHED();
+			break;
+		case SC_Advise:
+			val = kernel->machine->ReadRegister(4);
+			{
+				int offset = kernel->machine->ReadRegister(5);
+				int length = kernel->machine->ReadRegister(6);
+				int hint = kernel->machine->ReadRegister(7);
+
+				status = SysAdvise(val, offset, length, hint);
+				kernel->machine->WriteRegister(2, status);
+			}
+			kernel->machine->WriteRegister(PrevPCReg, kernel->machine->ReadRegister(PCReg));
+			kernel->machine->WriteRegister(PCReg, kernel->machine->ReadRegister(PCReg) + 4);
+			kernel->machine->WriteRegister(NextPCReg, kernel->machine->ReadRegister(PCReg)+4);
+			return;
+			ASSERTNOTREACHED();
+			break;
+		case SC_Pipe:
+			val = kernel->machine->ReadRegister(4);
+			{
+				int ids[2];
+
+				status = SysPipe(ids);
+				if (status == 0) {
+					ids[0] = WordToMachine(ids[0]);
+					ids[1] = WordToMachine(ids[1]);
+					if (!CopyOut((char *) ids, val, sizeof(ids))) {
+						SysClose(WordToHost(ids[0]));
+						SysClose(WordToHost(ids[1]));
+						status = -1;
+					}
+				}
+				kernel->machine->WriteRegister(2, status);
+			}
+			kernel->machine->WriteRegister(PrevPCReg, kernel->machine->ReadRegister(PCReg));
+			kernel->machine->WriteRegister(PCReg, kernel->machine->ReadRegister(PCReg) + 4);
+			kernel->machine->WriteRegister(NextPCReg, kernel->machine->ReadRegister(PCReg)+4);
+			return;
+			ASSERTNOTREACHED();
+			break;
+#endif
 		case SC_Exit:
 			DEBUG(dbgAddr, "Program exit\n");
             val=kernel->machine->ReadRegister(4);
             cout << "return value:" << val << endl;
+#ifndef FILESYS_STUB
+			SysCloseAll();			// close what it left open
+#endif
 			kernel->currentThread->Finish();
             break;
       	default:
 			cerr << "Unexpected system call " << type << "\n";
 			break;
 		}
-		break;
+    ASSERTNOTREACHED();
+}
+
+//----------------------------------------------------------------------
+// ExceptionHandler
+// 	Entry point into the Nachos kernel.  Called when a user program
+//	is executing, and either does a syscall, or generates an addressing
+//	or arithmetic exception.
+//
+// 	For system calls, the following is the calling convention:
+//
+// 	system call code -- r2
+//		arg1 -- r4
+//		arg2 -- r5
+//		arg3 -- r6
+//		arg4 -- r7
+//
+//	The result of the system call, if any, must be put back into r2. 
+//
+// If you are handling a system call, don't forget to increment the pc
+// before returning. (Or else you'll loop making the same system call forever!)
+//
+//	Each system call is counted in the statistics, with the time it
+//	took and the bytes it moved, by thread (see SC_GetStats).
+//
+//	"which" is the kind of exception.  The list of possible exceptions 
+//	is in machine.h.
+//----------------------------------------------------------------------
+
+void
+ExceptionHandler(ExceptionType which)
+{
+    int type = kernel->machine->ReadRegister(2);
+	DEBUG(dbgSys, "Received Exception " << which << " type: " << type << "\n");
+    switch (which) {
+    case SyscallException:
+	{
+	    int id = kernel->currentThread->getID();
+	    int start = kernel->stats->totalTicks;
+
+	    kernel->stats->StartSyscall(id, type);
+	    Syscall(type);
+	    kernel->stats->EndSyscall(id, type,
+			kernel->stats->totalTicks - start, SyscallBytes(type));
+	}
+	return;
 	default:
 		cerr << "Unexpected user mode exception " << (int)which << "\n";
 		break;
     }
     ASSERTNOTREACHED();
 }
-
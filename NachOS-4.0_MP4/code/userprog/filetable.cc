@@ -0,0 +1,174 @@
+// filetable.cc
+//	Routines to manage a user program's table of open files.
+//
+// Copyright (c) 1992-1996 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "filetable.h"
+#include "openfile.h"
+#include "pipe.h"
+#include "syscall.h"
+
+#ifndef FILESYS_STUB
+
+//----------------------------------------------------------------------
+// FileTable::FileTable
+// 	Initialize a table with no open files.  The console slots are
+//	marked in use, so they are never handed out.
+//----------------------------------------------------------------------
+
+FileTable::FileTable()
+{
+    for (int i = 0; i < MaxOpenFiles; i++) {
+	file[i] = NULL;
+	pipe[i] = NULL;
+    }
+    writeEnds = 0;
+    freeSlots = ~0u & ~(1u << SysConsoleInput) & ~(1u << SysConsoleOutput);
+}
+
+//----------------------------------------------------------------------
+// FileTable::~FileTable
+// 	Close any files the program left open.
+//----------------------------------------------------------------------
+
+FileTable::~FileTable()
+{
+    CloseAll();
+}
+
+//----------------------------------------------------------------------
+// FileTable::Add
+// 	Give an open file the lowest free id.  Returns -1, and leaves
+//	the file to the caller, if the table is full.
+//----------------------------------------------------------------------
+
+int
+FileTable::Add(OpenFile *openFile)
+{
+    int id;
+
+    if (freeSlots == 0)
+	return -1;
+    id = __builtin_ctz(freeSlots);
+    freeSlots &= ~(1u << id);
+    file[id] = openFile;
+    openFile->AddId();
+    return id;
+}
+
+//----------------------------------------------------------------------
+// FileTable::Get
+// 	Return the open file for "id", or NULL if it isn't open.
+//----------------------------------------------------------------------
+
+OpenFile *
+FileTable::Get(int id)
+{
+    if (id < 0 || id >= MaxOpenFiles)
+	return NULL;
+    return file[id];
+}
+
+//----------------------------------------------------------------------
+// FileTable::AddPipe
+// 	Give the read end (or, if "writing", the write end) of "p" the
+//	lowest free id.  Returns -1 if the table is full.
+//----------------------------------------------------------------------
+
+int
+FileTable::AddPipe(PipeBuffer *p, bool writing)
+{
+    int id;
+
+    if (freeSlots == 0)
+	return -1;
+    id = __builtin_ctz(freeSlots);
+    freeSlots &= ~(1u << id);
+    pipe[id] = p;
+    if (writing)
+	writeEnds |= 1u << id;
+    p->AddEnd(writing);
+    return id;
+}
+
+//----------------------------------------------------------------------
+// FileTable::GetPipe
+// 	Return the pipe whose write end (if "writing") or read end "id"
+//	names, or NULL if it names something else.
+//----------------------------------------------------------------------
+
+PipeBuffer *
+FileTable::GetPipe(int id, bool writing)
+{
+    if (id < 0 || id >= MaxOpenFiles || pipe[id] == NULL)
+	return NULL;
+    if (((writeEnds & (1u << id)) != 0) != writing)
+	return NULL;
+    return pipe[id];
+}
+
+//----------------------------------------------------------------------
+// FileTable::Dup
+// 	Give the open file for "id" a second id as well.  The two share
+//	the file's seek position, and it stays open until both are
+//	closed.  Returns the new id, or -1 if "id" isn't open or the
+//	table is full.  A pipe end is duplicated the same way.
+//----------------------------------------------------------------------
+
+int
+FileTable::Dup(int id)
+{
+    OpenFile *openFile = Get(id);
+
+    if (id >= 0 && id < MaxOpenFiles && pipe[id] != NULL)
+	return AddPipe(pipe[id], (writeEnds & (1u << id)) != 0);
+    return (openFile == NULL) ? -1 : Add(openFile);
+}
+
+//----------------------------------------------------------------------
+// FileTable::Close
+// 	Free "id", and close its file if no other id refers to it.
+//	Returns FALSE if "id" isn't open.
+//----------------------------------------------------------------------
+
+bool
+FileTable::Close(int id)
+{
+    OpenFile *openFile = Get(id);
+
+    if (id >= 0 && id < MaxOpenFiles && pipe[id] != NULL) {
+	PipeBuffer *p = pipe[id];
+	bool writing = (writeEnds & (1u << id)) != 0;
+
+	pipe[id] = NULL;
+	writeEnds &= ~(1u << id);
+	freeSlots |= 1u << id;
+	if (p->RemoveEnd(writing))
+	    delete p;
+	return TRUE;
+    }
+    if (openFile == NULL)
+	return FALSE;
+    file[id] = NULL;
+    freeSlots |= 1u << id;
+    if (openFile->RemoveId())
+	delete openFile;
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// FileTable::CloseAll
+// 	Close every id; called when the program exits.
+//----------------------------------------------------------------------
+
+void
+FileTable::CloseAll()
+{
+    for (int i = 0; i < MaxOpenFiles; i++)
+	if (file[i] != NULL || pipe[i] != NULL)
+	    Close(i);
+}
+#endif // FILESYS_STUB
@@ -0,0 +1,61 @@
+// filetable.h
+//	Data structures for a user program's table of open files.
+//
+//	Each address space has its own table, so an OpenFileId is an
+//	index that only means something to the program that got it, and
+//	one program's opens neither limit nor disturb another's.  A
+//	bitmap of the free slots makes finding one O(1).
+//
+//	Slots 0 and 1 are SysConsoleInput and SysConsoleOutput, and are
+//	never handed out, so a successful Open still returns a positive
+//	id.  Dup makes a second id for the same open file, sharing its
+//	seek position; the file is closed when the last id is.
+//
+//	An id can also name one end of a pipe instead of an open file.
+//
+// Copyright (c) 1992-1996 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#ifndef FILETABLE_H
+#define FILETABLE_H
+
+#include "copyright.h"
+#include "utility.h"
+
+class OpenFile;
+class PipeBuffer;
+
+// The most files a user program can have open at once, counting the
+// two console slots; one bit each in FileTable::freeSlots
+
+const int MaxOpenFiles = 32;
+
+// The following class defines a user program's open files.
+
+class FileTable {
+  public:
+    FileTable();		// initialize an empty table
+    ~FileTable();		// close any files still open
+
+    int Add(OpenFile *file);	// give an open file an id; returns -1,
+				// leaving it open, if the table is full
+    OpenFile *Get(int id);	// the open file for an id, or NULL
+    int AddPipe(PipeBuffer *pipe, bool writing);
+				// give one end of a pipe an id; -1 if
+				// the table is full
+    PipeBuffer *GetPipe(int id, bool writing);
+				// the pipe whose read (or write) end an
+				// id names, or NULL
+    int Dup(int id);		// another id for the same file, or -1
+    bool Close(int id);		// give up an id; FALSE if it isn't open
+    void CloseAll();		// give up every id, e.g. at Exit
+
+  private:
+    OpenFile *file[MaxOpenFiles];	// open file for each id, or NULL
+    PipeBuffer *pipe[MaxOpenFiles];	// or the pipe it names an end of
+    unsigned int writeEnds;	// bit i is set if id i is a write end
+    unsigned int freeSlots;	// bit i is set if id i is free
+};
+
+#endif // FILETABLE_H
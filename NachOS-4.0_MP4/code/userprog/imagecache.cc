@@ -0,0 +1,281 @@
+// imagecache.cc
+//	Routines to read executable images and keep the most recently
+//	used ones in memory.
+//
+// Copyright (c) 1992-1996 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "imagecache.h"
+#include "openfile.h"
+#include "machine.h"
+#include "debug.h"
+
+//----------------------------------------------------------------------
+// SwapHeader
+// 	Do little endian to big endian conversion on the bytes in the 
+//	object file header, in case the file was generated on a little
+//	endian machine, and we're now running on a big endian machine.
+//----------------------------------------------------------------------
+
+static void 
+SwapHeader (NoffHeader *noffH)
+{
+    noffH->noffMagic = WordToHost(noffH->noffMagic);
+    noffH->code.size = WordToHost(noffH->code.size);
+    noffH->code.virtualAddr = WordToHost(noffH->code.virtualAddr);
+    noffH->code.inFileAddr = WordToHost(noffH->code.inFileAddr);
+#ifdef RDATA
+    noffH->readonlyData.size = WordToHost(noffH->readonlyData.size);
+    noffH->readonlyData.virtualAddr = 
+           WordToHost(noffH->readonlyData.virtualAddr);
+    noffH->readonlyData.inFileAddr = 
+           WordToHost(noffH->readonlyData.inFileAddr);
+#endif 
+    noffH->initData.size = WordToHost(noffH->initData.size);
+    noffH->initData.virtualAddr = WordToHost(noffH->initData.virtualAddr);
+    noffH->initData.inFileAddr = WordToHost(noffH->initData.inFileAddr);
+    noffH->uninitData.size = WordToHost(noffH->uninitData.size);
+    noffH->uninitData.virtualAddr = WordToHost(noffH->uninitData.virtualAddr);
+    noffH->uninitData.inFileAddr = WordToHost(noffH->uninitData.inFileAddr);
+
+#ifdef RDATA
+    DEBUG(dbgAddr, "code = " << noffH->code.size <<  
+                   " readonly = " << noffH->readonlyData.size <<
+                   " init = " << noffH->initData.size <<
+                   " uninit = " << noffH->uninitData.size << "\n");
+#endif
+}
+
+//----------------------------------------------------------------------
+// ReadSegment
+// 	Return the contents of one segment of an executable, or NULL if
+//	it is empty.
+//----------------------------------------------------------------------
+
+static char *
+ReadSegment(OpenFile *executable, Segment *seg)
+{
+    char *bytes;
+
+    if (seg->size <= 0)
+	return NULL;
+    bytes = new char[seg->size];
+    executable->ReadAt(bytes, seg->size, seg->inFileAddr);
+    return bytes;
+}
+
+//----------------------------------------------------------------------
+// ExecImage::ExecImage
+// 	Initialize an image with nothing in it yet.
+//
+//	"headerSector" is where the executable's file header is
+//----------------------------------------------------------------------
+
+ExecImage::ExecImage(int headerSector)
+{
+    sector = headerSector;
+    code = NULL;
+    initData = NULL;
+#ifdef RDATA
+    readonlyData = NULL;
+#endif
+    lastUsed = 0;
+}
+
+//----------------------------------------------------------------------
+// ExecImage::~ExecImage
+// 	De-allocate the segment contents.
+//----------------------------------------------------------------------
+
+ExecImage::~ExecImage()
+{
+    delete [] code;
+    delete [] initData;
+#ifdef RDATA
+    delete [] readonlyData;
+#endif
+}
+
+//----------------------------------------------------------------------
+// ExecImage::Read
+// 	Read the NOFF header of an executable, and the segments it
+//	describes.  Returns FALSE, with no segments read, if the file
+//	isn't in NOFF format.
+//
+//	All the segments' sectors are asked for before any is waited
+//	for, so when several programs are loading at once (each in its
+//	own thread; see Kernel::ExecAll) the disk queue holds all their
+//	reads together, and can serve them in one sweep.
+//----------------------------------------------------------------------
+
+bool
+ExecImage::Read(OpenFile *executable)
+{
+    executable->ReadAt((char *)&noffH, sizeof(noffH), 0);
+    if ((noffH.noffMagic != NOFFMAGIC) && 
+		(WordToHost(noffH.noffMagic) == NOFFMAGIC))
+    	SwapHeader(&noffH);
+    if (noffH.noffMagic != NOFFMAGIC)
+	return FALSE;
+
+#ifndef FILESYS_STUB
+    executable->Prefetch(noffH.code.inFileAddr, noffH.code.size);
+    executable->Prefetch(noffH.initData.inFileAddr, noffH.initData.size);
+#ifdef RDATA
+    executable->Prefetch(noffH.readonlyData.inFileAddr,
+			 noffH.readonlyData.size);
+#endif
+#endif
+
+    code = ReadSegment(executable, &noffH.code);
+    initData = ReadSegment(executable, &noffH.initData);
+#ifdef RDATA
+    readonlyData = ReadSegment(executable, &noffH.readonlyData);
+#endif
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// ImageCache::ImageCache
+// 	Initialize a cache with no images in it.
+//----------------------------------------------------------------------
+
+ImageCache::ImageCache()
+{
+    for (int i = 0; i < ImageCacheSize; i++)
+	image[i] = NULL;
+    clock = 0;
+    numHits = numMisses = 0;
+}
+
+//----------------------------------------------------------------------
+// ImageCache::~ImageCache
+// 	De-allocate the cache and all its images.
+//----------------------------------------------------------------------
+
+ImageCache::~ImageCache()
+{
+    for (int i = 0; i < ImageCacheSize; i++)
+	delete image[i];
+}
+
+//----------------------------------------------------------------------
+// ImageCache::Get
+// 	Return the image of an executable, reading it from the file if
+//	it isn't cached, and putting it in place of the least recently
+//	used image.  Returns NULL if the file isn't in NOFF format.
+//
+//	Reading the file may block, and another thread may read the same
+//	one meanwhile; the second copy is thrown away, so the cache never
+//	holds two images of a file.
+//
+//	"executable" is the open file to get the image of
+//----------------------------------------------------------------------
+
+ExecImage *
+ImageCache::Get(OpenFile *executable)
+{
+    ExecImage *fresh;
+    int i, victim;
+#ifdef FILESYS_STUB
+    int sector = -1;			// there is no way to tell files apart
+#else
+    int sector = executable->HeaderSector();
+#endif
+
+    clock++;
+    for (i = 0; i < ImageCacheSize; i++) {
+	if (image[i] != NULL && sector != -1 && image[i]->sector == sector) {
+	    numHits++;
+	    image[i]->lastUsed = clock;
+	    DEBUG(dbgAddr, "Image of file at sector " << sector << " is cached");
+	    return image[i];
+	}
+    }
+
+    numMisses++;
+    fresh = new ExecImage(sector);
+    if (!fresh->Read(executable)) {
+	delete fresh;
+	return NULL;
+    }
+    victim = 0;
+    for (i = 0; i < ImageCacheSize; i++) {
+	if (image[i] != NULL && sector != -1 && image[i]->sector == sector) {
+	    delete fresh;		// someone beat us to it
+	    image[i]->lastUsed = clock;
+	    return image[i];
+	}
+	if (image[i] == NULL || (image[victim] != NULL
+				 && image[i]->lastUsed < image[victim]->lastUsed))
+	    victim = i;
+    }
+    delete image[victim];
+    image[victim] = fresh;
+    fresh->lastUsed = clock;
+    return fresh;
+}
+
+//----------------------------------------------------------------------
+// ImageCache::Invalidate
+// 	Throw away the image of a file that is being written or removed,
+//	if there is one.
+//
+//	"sector" is where the file's header is
+//----------------------------------------------------------------------
+
+void
+ImageCache::Invalidate(int sector)
+{
+    for (int i = 0; i < ImageCacheSize; i++) {
+	if (image[i] != NULL && image[i]->sector == sector) {
+	    DEBUG(dbgAddr, "Image of file at sector " << sector << " is stale");
+	    delete image[i];
+	    image[i] = NULL;
+	}
+    }
+}
+
+//----------------------------------------------------------------------
+// ImageCache::Warm
+// 	Put an image an earlier run saved in an empty slot, as if it had
+//	been read from its file (see warmstart.h).  If there is no empty
+//	slot, or the file's image is cached already, it is deleted and
+//	FALSE returned.
+//----------------------------------------------------------------------
+
+bool
+ImageCache::Warm(ExecImage *fresh)
+{
+    int slot = -1;
+
+    for (int i = 0; i < ImageCacheSize; i++) {
+	if (image[i] == NULL) {
+	    if (slot == -1)
+		slot = i;
+	} else if (image[i]->sector == fresh->sector) {
+	    slot = -1;			// cached already
+	    break;
+	}
+    }
+    if (slot == -1) {
+	delete fresh;
+	return FALSE;
+    }
+    fresh->lastUsed = clock;
+    image[slot] = fresh;
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// ImageCache::PrintStats
+// 	Print how many executables were found in the cache.
+//----------------------------------------------------------------------
+
+void
+ImageCache::PrintStats()
+{
+    cout << "Image cache: hits " << numHits << ", misses " << numMisses << "\n";
+}
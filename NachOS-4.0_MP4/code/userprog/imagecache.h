@@ -0,0 +1,78 @@
+// imagecache.h
+//	Data structures for a cache of executable images, so that a
+//	program run again and again is read from the file system once.
+//
+//	An image is the program's NOFF header, already in host byte
+//	order, and the bytes of its code and data segments, so loading
+//	it is a copy into memory.  Images are found by the sector of the
+//	executable's file header.  Writing to the file, or removing it,
+//	throws its image away, so a cached image is always the file's
+//	current contents.  When the cache is full, the least recently
+//	used image is replaced.
+//
+// Copyright (c) 1992-1996 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#ifndef IMAGECACHE_H
+#define IMAGECACHE_H
+
+#include "copyright.h"
+#include "utility.h"
+#include "noff.h"
+
+class OpenFile;
+
+// The number of images kept
+
+const int ImageCacheSize = 8;
+
+// The following class defines one program's image.
+
+class ExecImage {
+  public:
+    ExecImage(int headerSector);	// an empty image
+    ~ExecImage();
+
+    bool Read(OpenFile *executable);	// fill it in from the file;
+					// FALSE if it isn't NOFF
+
+    int sector;				// its file header, or -1 if it
+					// can't be found again
+    NoffHeader noffH;			// in host byte order
+    char *code;				// contents of each segment,
+    char *initData;			// or NULL if it is empty
+#ifdef RDATA
+    char *readonlyData;
+#endif
+    int lastUsed;			// for replacement
+};
+
+// The following class defines the cache of images.
+
+class ImageCache {
+  public:
+    ImageCache();			// initialize an empty cache
+    ~ImageCache();			// de-allocate the cache
+
+    ExecImage *Get(OpenFile *executable);
+					// the image of an executable,
+					// reading it if it isn't cached;
+					// NULL if it isn't NOFF.  It stays
+					// good until the next Get.
+    void Invalidate(int sector);	// the file with its header at
+					// "sector" is changing
+    bool Warm(ExecImage *fresh);	// cache an image saved by an earlier
+					// run; FALSE (deleting it) if full
+    ExecImage *Image(int i) { return image[i]; }
+					// the image in slot "i", or NULL
+
+    void PrintStats();			// hits and misses
+
+  private:
+    ExecImage *image[ImageCacheSize];	// NULL for an empty slot
+    int clock;				// counts Gets, for lastUsed
+    int numHits, numMisses;
+};
+
+#endif // IMAGECACHE_H
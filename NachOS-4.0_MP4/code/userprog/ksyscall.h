@@ -34,6 +34,13 @@ int SysCreate(char *filename, int length)
 	// 0: failed
 	return kernel->interrupt->CreateFile(filename, length);
 }
+int SysRemove(char *filename)
+{
+	// return value
+	// 1: success
+	// 0: failed
+	return kernel->interrupt->RemoveFile(filename);
+}
 int SysOpen(char *filename)
 {
 	// return value
@@ -48,6 +55,47 @@ int SysClose(int id)
 	// 0: failed
 	return kernel->interrupt->CloseFile(id);
 }
+int SysDup(int id)
+{
+	// return value
+	// >0: the new id
+	// <0: failed
+	return kernel->interrupt->DupFile(id);
+}
+int SysPipe(int *ids)
+{
+	// return value
+	// 0: success, ids[0] and ids[1] are the read and write ends
+	// -1: failed
+	return kernel->interrupt->MakePipe(ids);
+}
+int SysSbrk(int increment)
+{
+	// return value
+	// >=0: the old end of the heap
+	// -1: failed
+	return kernel->currentThread->space->Sbrk(increment);
+}
+void SysCloseAll()
+{
+	kernel->currentThread->space->aio->WaitAll();
+	kernel->currentThread->space->files->CloseAll();
+}
+int SysAioStart(int buffer, int size, int position, int id, bool writing)
+{
+	// return value
+	// >=0: the request's handle
+	// -1: failed
+	return kernel->currentThread->space->aio->Start(buffer, size, position, id, writing);
+}
+int SysAioWait(int aio)
+{
+	return kernel->currentThread->space->aio->Wait(aio);
+}
+int SysAioPoll(int aio)
+{
+	return kernel->currentThread->space->aio->Poll(aio);
+}
 int SysWrite(char *buffer, int size, int id)
 {
 	return kernel->interrupt->WriteFile(buffer, size, id);
@@ -56,6 +104,39 @@ int SysRead(char *buffer, int size, int id)
 {
 	return kernel->interrupt->ReadFile(buffer, size, id);
 }
+int SysSeek(int position, int id)
+{
+	// return value
+	// 1: success
+	// 0: failed
+	return kernel->interrupt->SeekFile(position, id);
+}
+int SysPWrite(char *buffer, int size, int position, int id)
+{
+	return kernel->interrupt->WriteFileAt(buffer, size, position, id);
+}
+int SysPRead(char *buffer, int size, int position, int id)
+{
+	return kernel->interrupt->ReadFileAt(buffer, size, position, id);
+}
+int SysFsync(int id)
+{
+	// return value
+	// 0: success
+	// -1: failed
+	return kernel->interrupt->SyncFile(id);
+}
+int SysSync()
+{
+	return kernel->interrupt->SyncAll();
+}
+int SysAdvise(int id, int offset, int length, int hint)
+{
+	// return value
+	// 0: success
+	// -1: failed
+	return kernel->interrupt->AdviseFile(id, offset, length, hint);
+}
 #endif
 
 
@@ -0,0 +1,142 @@
+// pipe.cc
+//	Routines to pass bytes through a pipe's ring buffer.
+//
+// Copyright (c) 1992-1996 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "pipe.h"
+#include "synch.h"
+#include "memops.h"
+
+//----------------------------------------------------------------------
+// PipeBuffer::PipeBuffer
+// 	Initialize an empty pipe.  Its ends are added as ids are given
+//	to them.
+//----------------------------------------------------------------------
+
+PipeBuffer::PipeBuffer()
+{
+    head = count = 0;
+    readers = writers = 0;
+    lock = new Lock("pipe");
+    readable = new Condition("pipe readable");
+    writable = new Condition("pipe writable");
+}
+
+//----------------------------------------------------------------------
+// PipeBuffer::~PipeBuffer
+// 	De-allocate a pipe; no one may be waiting on it.
+//----------------------------------------------------------------------
+
+PipeBuffer::~PipeBuffer()
+{
+    delete readable;
+    delete writable;
+    delete lock;
+}
+
+//----------------------------------------------------------------------
+// PipeBuffer::Read
+// 	Wait until the pipe has something in it, or can't get anything
+//	more, then copy as much as there is, up to "numBytes", into
+//	"into".  Returns the number of bytes copied: 0 only at end of
+//	file, when the pipe is empty and has no writers.
+//
+//	The bytes may wrap around the end of the ring, so they are
+//	copied in at most two pieces.
+//----------------------------------------------------------------------
+
+int
+PipeBuffer::Read(char *into, int numBytes)
+{
+    int n, first;
+
+    if (numBytes <= 0)
+	return 0;
+    lock->Acquire();
+    while (count == 0 && writers > 0)
+	readable->Wait(lock);
+    n = min(numBytes, count);
+    first = min(n, PipeSize - head);
+    MemCopy(into, &buffer[head], first);
+    MemCopy(into + first, buffer, n - first);
+    head = (head + n) % PipeSize;
+    count -= n;
+    if (n > 0)
+	writable->Broadcast(lock);
+    lock->Release();
+    return n;
+}
+
+//----------------------------------------------------------------------
+// PipeBuffer::Write
+// 	Wait until the pipe has room, then copy as much of the
+//	"numBytes" bytes at "from" into it as fit.  Returns the number of
+//	bytes copied, or -1 if the pipe has no readers left.
+//----------------------------------------------------------------------
+
+int
+PipeBuffer::Write(char *from, int numBytes)
+{
+    int n, tail, first;
+
+    if (numBytes <= 0)
+	return 0;
+    lock->Acquire();
+    while (count == PipeSize && readers > 0)
+	writable->Wait(lock);
+    if (readers == 0) {
+	lock->Release();
+	return -1;
+    }
+    n = min(numBytes, PipeSize - count);
+    tail = (head + count) % PipeSize;
+    first = min(n, PipeSize - tail);
+    MemCopy(&buffer[tail], from, first);
+    MemCopy(buffer, from + first, n - first);
+    count += n;
+    readable->Broadcast(lock);
+    lock->Release();
+    return n;
+}
+
+//----------------------------------------------------------------------
+// PipeBuffer::AddEnd
+// 	Count one more id for the write end if "writing", else for the
+//	read end.
+//----------------------------------------------------------------------
+
+void
+PipeBuffer::AddEnd(bool writing)
+{
+    lock->Acquire();
+    if (writing)
+	writers++;
+    else
+	readers++;
+    lock->Release();
+}
+
+//----------------------------------------------------------------------
+// PipeBuffer::RemoveEnd
+// 	Count one fewer id for an end.  When the last id of an end goes,
+//	wake whoever is waiting at the other end, so they see it.
+//	Returns TRUE if neither end has any ids left.
+//----------------------------------------------------------------------
+
+bool
+PipeBuffer::RemoveEnd(bool writing)
+{
+    bool unused;
+
+    lock->Acquire();
+    if (writing && --writers == 0)
+	readable->Broadcast(lock);
+    else if (!writing && --readers == 0)
+	writable->Broadcast(lock);
+    unused = (readers == 0 && writers == 0);
+    lock->Release();
+    return unused;
+}
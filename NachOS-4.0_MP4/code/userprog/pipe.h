@@ -0,0 +1,63 @@
+// pipe.h
+//	Data structures for a pipe: a bounded ring buffer in the kernel,
+//	written at one end and read at the other, for user programs to
+//	pass data through without going near the disk.
+//
+//	Each end is an OpenFileId in a FileTable (see FileTable::AddPipe),
+//	and counts as one reference for each id naming it.  A Read blocks
+//	until there is at least one byte, then takes as many as there are
+//	(up to the size asked for); a Write blocks until there is room for
+//	at least one byte, then puts in as many as fit.  Once every write
+//	end is closed, a Read of an empty pipe returns 0 (end of file);
+//	once every read end is, a Write returns -1.
+//
+// Copyright (c) 1992-1996 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#ifndef PIPE_H
+#define PIPE_H
+
+#include "copyright.h"
+#include "utility.h"
+
+class Lock;
+class Condition;
+
+// Bytes a pipe holds before a Write blocks
+
+const int PipeSize = 512;
+
+// The following class defines a pipe.  (It isn't called Pipe, as that
+// is the name of the system call, declared in syscall.h.)
+
+class PipeBuffer {
+  public:
+    PipeBuffer();		// an empty pipe, with no ends yet
+    ~PipeBuffer();
+
+    int Read(char *into, int numBytes);
+				// take what is there, waiting for at
+				// least a byte; 0 at end of file
+    int Write(char *from, int numBytes);
+				// put in what fits, waiting for room for
+				// at least a byte; -1 if no one can read
+
+    void AddEnd(bool writing);	// one more id for the read or write end
+    bool RemoveEnd(bool writing);
+				// one fewer; TRUE if that was the last id
+				// of either end, and the pipe can go
+
+  private:
+    char buffer[PipeSize];	// the ring
+    int head;			// where the oldest byte is
+    int count;			// how many bytes are in it
+    int readers, writers;	// ids naming each end
+    Lock *lock;			// protects all of the above
+    Condition *readable;	// signalled when bytes arrive, or the
+				// last writer goes
+    Condition *writable;	// signalled when room is made, or the
+				// last reader goes
+};
+
+#endif // PIPE_H
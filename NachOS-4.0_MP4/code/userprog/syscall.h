@@ -34,6 +34,23 @@
 #define SC_ExecV	13
 #define SC_ThreadExit   14
 #define SC_ThreadJoin   15
+#define SC_ReadV	16
+#define SC_WriteV	17
+#define SC_Submit	18
+#define SC_PRead	19
+#define SC_PWrite	20
+#define SC_Dup		21
+#define SC_GetStats	22
+#define SC_Pipe		23
+#define SC_Sbrk		24
+#define SC_AioRead	25
+#define SC_AioWrite	26
+#define SC_AioWait	27
+#define SC_AioPoll	28
+#define SC_Fsync	29
+#define SC_Sync		30
+#define SC_Advise	31
+#define SC_GetMachineStats 32
 #define SC_Add		42
 #define SC_MSG		100
 
@@ -117,13 +134,38 @@ typedef int OpenFileId;
 int Create(char *name, int length);
 
 /* Remove a Nachos file, with name "name" */
+/* Return 1 on success, 0 on failure */
 int Remove(char *name);
 
 /* Open the Nachos file "name", and return an "OpenFileId" that can 
- * be used to read and write to the file.
+ * be used to read and write to the file.  Each program has its own
+ * OpenFileIds; files it leaves open are closed when it exits.
  */
 OpenFileId Open(char *name);
 
+/* Return a second OpenFileId for the same open file as "id", sharing
+ * its seek position; the file stays open until both are closed.
+ * Return a negative error code on failure.
+ */
+OpenFileId Dup(OpenFileId id);
+
+/* Make a pipe: a buffer in the kernel that bytes written to one end
+ * can be read from at the other.  Store the OpenFileId of the read end
+ * in fds[0] and that of the write end in fds[1]; Close them as any
+ * other.  A Read of the pipe waits for at least a byte and returns
+ * what is there; a Write waits until all of it has gone in.  Once all
+ * the write ends are closed, Read returns 0; once all the read ends
+ * are, Write fails.  Return 0 on success, -1 on failure.
+ */
+int Pipe(OpenFileId fds[2]);
+
+/* Grow the program's heap -- the memory above its stack -- by
+ * "increment" bytes, or shrink it if "increment" is negative.  Memory
+ * the heap gains is zeroed.  Return the old end of the heap, so that
+ * Sbrk(0) gives the current end, or -1 if there is no room.
+ */
+void *Sbrk(int increment);
+
 /* Write "size" bytes from "buffer" to the open file. 
  * Return the number of bytes actually read on success.
  * On failure, a negative error code is returned.
@@ -140,14 +182,149 @@ int Read(char *buffer, int size, OpenFileId id);
 
 /* Set the seek position of the open file "id"
  * to the byte "position".
+ * Return 1 on success, 0 if "id" or "position" is not valid.
  */
 int Seek(int position, OpenFileId id);
 
+/* Write or read "size" bytes at byte "position" of the open file,
+ * without using or changing its seek position, so that threads sharing
+ * one OpenFileId can each work on their own part of the file.
+ * Return the number of bytes actually written or read.
+ */
+int PWrite(char *buffer, int size, int position, OpenFileId id);
+int PRead(char *buffer, int size, int position, OpenFileId id);
+
 /* Close the file, we're done reading and writing to it.
  * Return 1 on success, negative error code on failure
  */
 int Close(OpenFileId id);
 
+/* Write what has been written to the open file -- or, for Sync, to
+ * any file -- from the kernel's buffer cache to the disk, and return
+ * once it is there.  Return 0 on success, -1 on failure.
+ */
+int Fsync(OpenFileId id);
+int Sync();
+
+/* Say how the "length" bytes of the open file from "offset" (to the
+ * end of the file, if "length" is 0) will be used, so that the kernel
+ * can read ahead and cache to suit:
+ *	AdviseNormal, AdviseSequential, AdviseRandom -- how the whole
+ *		file will be read: read ahead once it is seen reading in
+ *		order (the default), read ahead further, or not at all
+ *	AdviseWillNeed -- start reading the bytes into the cache now
+ *	AdviseDontNeed -- they won't be read again soon; reuse their
+ *		cache buffers first
+ * Return 0 on success, -1 on failure.
+ */
+#define AdviseNormal		0
+#define AdviseSequential	1
+#define AdviseRandom		2
+#define AdviseWillNeed		3
+#define AdviseDontNeed		4
+
+int Advise(OpenFileId id, int offset, int length, int hint);
+
+/* One piece of a buffer for ReadV and WriteV. */
+typedef struct {
+    char *buffer;
+    int size;
+} IoBuf;
+
+/* The most pieces ReadV and WriteV take, and requests Submit takes,
+ * in one call.
+ */
+#define MaxIoBufs	16
+
+/* Write the "count" pieces in "vec" to the open file, in order, with
+ * one system call.  Return the total number of bytes written, which
+ * is short if one piece could not be written in full; or a negative
+ * error code if nothing was written.
+ */
+int WriteV(IoBuf *vec, int count, OpenFileId id);
+
+/* Read from the open file into the "count" pieces in "vec", in order,
+ * with one system call.  Return the total number of bytes read, which
+ * is short at end of file; or a negative error code.
+ */
+int ReadV(IoBuf *vec, int count, OpenFileId id);
+
+/* One file operation for Submit.  "op" says which; "buffer" and
+ * "size" are only used by IoRead and IoWrite.  Submit sets "result"
+ * to what Read, Write or Close would have returned.
+ */
+#define IoRead		0
+#define IoWrite		1
+#define IoClose		2
+
+typedef struct {
+    int op;
+    char *buffer;
+    int size;
+    OpenFileId id;
+    int result;
+} IoRequest;
+
+/* Carry out the "count" requests in "req", in order, with one system
+ * call, so that a program doing many small file operations pays for
+ * one trap rather than one each.  Return the number carried out, or
+ * a negative error code if "req" is not valid.
+ */
+int Submit(IoRequest *req, int count);
+
+/* The use a thread has made of a system call, for GetStats.  Times
+ * are in simulated ticks, from the trap to the return to user mode.
+ */
+typedef struct {
+    int count;		/* calls made */
+    int ticks;		/* time spent in them, in all */
+    int maxTicks;	/* time spent in the longest one */
+    int bytes;		/* bytes read or written by them */
+} SyscallStats;
+
+/* Fill in "stats" with the calling thread's use so far of the system
+ * call with code "type" -- or of all of them together if "type" is -1,
+ * with "maxTicks" the longest of any -- so that a program can time
+ * itself.  The GetStats call itself is counted on entry.  Return 0 on
+ * success, or a negative error code.
+ */
+int GetStats(int type, SyscallStats *stats);
+
+/* The whole machine's counters, for GetMachineStats. */
+typedef struct {
+    int ticks;		/* simulated time since Nachos started */
+    int diskReads;	/* disk read requests so far */
+    int diskWrites;	/* disk write requests so far */
+} MachineStats;
+
+/* Fill in "stats" with the machine's counters now, so that a program
+ * can time a piece of work, and count the disk requests it caused,
+ * by taking them before and after.  Return 0 on success, or -1 if
+ * "stats" is not a valid address.
+ */
+int GetMachineStats(MachineStats *stats);
+
+/* Start reading or writing "size" bytes of the open file, from byte
+ * "position", to or from "buffer", and return at once with a handle
+ * for the request -- or -1 if it can't be started -- so that the
+ * program can compute, or start other requests, while the disk works.
+ * Leave "buffer" alone until the request is done.
+ */
+int AioRead(char *buffer, int size, int position, OpenFileId id);
+int AioWrite(char *buffer, int size, int position, OpenFileId id);
+
+/* Wait until request "aio" is done, and return the number of bytes it
+ * read or wrote (or -1 if there is no such request).  The handle is no
+ * good after this.
+ */
+int AioWait(int aio);
+
+/* Return 1 if request "aio" is done, 0 if it is still going, or -1 if
+ * there is no such request.  Either way, the program still has to
+ * AioWait for it.
+ */
+int AioPoll(int aio);
+
 
 /* User-level thread operations: Fork and Yield.  To allow multiple
  * threads to run within a user program. 
@@ -0,0 +1,140 @@
+// usermem.cc
+//	Routines to translate and copy system call arguments that live
+//	in user memory.  See usermem.h.
+//
+// Copyright (c) 1992-1996 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "main.h"
+#include "usermem.h"
+#include "addrspace.h"
+#include "memops.h"
+
+//----------------------------------------------------------------------
+// UserToIoVec
+// 	Break the user buffer of "size" bytes at virtual address
+//	"userAddr" into pieces of mainMemory, one per run of physically
+//	contiguous pages, so the kernel can read or write the buffer in
+//	place.
+//
+//	If the buffer needs more than "maxVec" pieces, only the first
+//	"maxVec" are returned; the caller can tell from the lengths.
+//
+//	Returns the number of pieces, or -1 if part of the buffer is not
+//	mapped (or, when "writing", is read-only).
+//
+//	"writing" -- TRUE if the kernel will store into the buffer
+//----------------------------------------------------------------------
+
+int
+UserToIoVec(int userAddr, int size, bool writing, IoVec *vec, int maxVec)
+{
+    AddrSpace *space = kernel->currentThread->space;
+    char *mainMemory = kernel->machine->mainMemory;
+    int numVec = 0;
+
+    ASSERT(space != NULL);
+    if (userAddr < 0 || size < 0) {
+	return -1;
+    }
+    while (size > 0) {
+	unsigned int paddr;
+	int chunk = min(size, PageSize - (userAddr % PageSize));
+
+	if (space->Translate(userAddr, &paddr, writing) != NoException) {
+	    return -1;
+	}
+	if (numVec > 0 && vec[numVec - 1].base + vec[numVec - 1].length
+			== &mainMemory[paddr]) {
+	    vec[numVec - 1].length += chunk;	// extends the last piece
+	} else if (numVec < maxVec) {
+	    vec[numVec].base = &mainMemory[paddr];
+	    vec[numVec].length = chunk;
+	    numVec++;
+	} else {
+	    break;				// out of room
+	}
+	if (writing) {
+	    kernel->machine->InvalidateDecodeCache(paddr, chunk);
+	}
+	userAddr += chunk;
+	size -= chunk;
+    }
+    return numVec;
+}
+
+//----------------------------------------------------------------------
+// CopyIn
+// 	Copy "size" bytes from user virtual address "userAddr" into the
+//	kernel "buffer".  Returns FALSE on a bad address.
+//----------------------------------------------------------------------
+
+bool
+CopyIn(int userAddr, char *buffer, int size)
+{
+    while (size > 0) {
+	IoVec vec;
+
+	if (UserToIoVec(userAddr, size, FALSE, &vec, 1) != 1) {
+	    return FALSE;
+	}
+	MemCopy(buffer, vec.base, vec.length);
+	buffer += vec.length;
+	userAddr += vec.length;
+	size -= vec.length;
+    }
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// CopyOut
+// 	Copy "size" bytes from the kernel "buffer" to user virtual
+//	address "userAddr".  Returns FALSE on a bad or read-only address.
+//----------------------------------------------------------------------
+
+bool
+CopyOut(char *buffer, int userAddr, int size)
+{
+    while (size > 0) {
+	IoVec vec;
+
+	if (UserToIoVec(userAddr, size, TRUE, &vec, 1) != 1) {
+	    return FALSE;
+	}
+	MemCopy(vec.base, buffer, vec.length);
+	buffer += vec.length;
+	userAddr += vec.length;
+	size -= vec.length;
+    }
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// CopyInString
+// 	Copy a NUL-terminated string from user virtual address
+//	"userAddr" into "buffer", which holds "maxLength" bytes.
+//
+//	Returns the length of the string (not counting the NUL), or -1
+//	on a bad address or if the string does not fit.
+//----------------------------------------------------------------------
+
+int
+CopyInString(int userAddr, char *buffer, int maxLength)
+{
+    AddrSpace *space = kernel->currentThread->space;
+
+    for (int i = 0; i < maxLength; i++) {
+	unsigned int paddr;
+
+	if (space->Translate(userAddr + i, &paddr, FALSE) != NoException) {
+	    return -1;
+	}
+	buffer[i] = kernel->machine->mainMemory[paddr];
+	if (buffer[i] == '\0') {
+	    return i;
+	}
+    }
+    return -1;			// too long
+}
@@ -0,0 +1,50 @@
+// usermem.h
+//	Routines for the kernel to get at the memory of the user program
+//	that made a system call.
+//
+//	User addresses are virtual, so they must be translated through
+//	the current address space's page table, one page at a time:
+//	consecutive virtual pages need not be consecutive in physical
+//	memory.
+//
+//	To avoid copying, a user buffer can also be described as a list
+//	of pieces of mainMemory (an "I/O vector"), each of which is
+//	physically contiguous and can be handed directly to the file
+//	system.
+//
+// Copyright (c) 1992-1996 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#ifndef USERMEM_H
+#define USERMEM_H
+
+#include "copyright.h"
+#include "utility.h"
+
+const int MaxUserString = 256;	// longest string (with its NUL) copied
+				// in from a user program, e.g. a path
+
+// One physically contiguous piece of a user buffer, as a host pointer
+// into mainMemory.
+
+class IoVec {
+  public:
+    char *base;			// start of the piece
+    int length;			// number of bytes in it
+};
+
+extern int UserToIoVec(int userAddr, int size, bool writing,
+			IoVec *vec, int maxVec);
+				// Describe a user buffer as at most
+				// "maxVec" contiguous pieces; returns
+				// how many, or -1 on a bad address
+extern bool CopyIn(int userAddr, char *buffer, int size);
+				// Copy "size" bytes from the user program
+extern bool CopyOut(char *buffer, int userAddr, int size);
+				// Copy "size" bytes to the user program
+extern int CopyInString(int userAddr, char *buffer, int maxLength);
+				// Copy a NUL-terminated string in;
+				// returns its length, or -1
+
+#endif // USERMEM_H